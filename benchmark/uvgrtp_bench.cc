@@ -0,0 +1,404 @@
+#include <uvgrtp/lib.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/* Throughput and latency benchmark of uvgRTP.
+ *
+ * Each case sends frames from one media stream to another of the same process over the
+ * loopback interface and prints one JSON object per line, so that the results can be
+ * collected and compared between releases. The one-way latency of a frame is the time
+ * from calling push_frame() until the complete frame is given to the receive hook, which
+ * includes the fragmentation, the sending, the reception and the reassembly of the frame.
+ *
+ * The cases are every combination of the formats, SRTP, pacing and system call clustering
+ * that is enabled on the command line, see usage(). With the impairment options, the frames
+ * are carried by the memory transport through an emulated link, so the loss paths of the
+ * receiver can be measured under the same conditions on every run */
+
+constexpr char LOCAL_ADDRESS[]   = "127.0.0.1";
+constexpr uint16_t SEND_PORT     = 9500;
+constexpr uint16_t RECEIVE_PORT  = 9502;
+
+// the RTP payload of one packet with the default MTU of 1492 bytes and IPv4
+constexpr size_t MEDIA_PAYLOAD = 1492 - 20 - 8 - 12;
+
+// how long the receiver is waited for after the last frame has been pushed
+constexpr int DRAIN_TIMEOUT_MS = 1000;
+
+struct options {
+    size_t frames = 5000;
+    size_t frame_size = 8000;
+    int fps = 1000;
+    std::vector<rtp_format_t> formats = { RTP_FORMAT_GENERIC, RTP_FORMAT_H264, RTP_FORMAT_H265, RTP_FORMAT_H266 };
+    std::vector<bool> srtp   = { false, true };
+    std::vector<bool> pacing = { false, true };
+    std::vector<bool> scl    = { false, true };
+
+    bool impaired = false;
+    uvgrtp::impairment impairment;
+};
+
+struct bench_case {
+    rtp_format_t fmt;
+    bool srtp;
+    bool pacing;
+    bool scl;
+};
+
+struct result {
+    size_t received = 0;
+    double push_seconds = 0;
+    double total_seconds = 0;
+    double cpu_seconds = 0;
+    std::vector<uint64_t> latencies_ns;
+};
+
+static void usage(const char *name)
+{
+    std::cerr << "Usage: " << name << " [options]" << std::endl
+              << "  --frames N       frames sent in each case (default 5000)" << std::endl
+              << "  --size BYTES     size of each frame (default 8000)" << std::endl
+              << "  --fps N          frame rate that the pacing spreads the packets over (default 1000)" << std::endl
+              << "  --format LIST    comma-separated formats: generic,h264,h265,h266 (default all)" << std::endl
+              << "  --srtp on|off|both, --pacing on|off|both, --scl on|off|both (default both)" << std::endl
+              << "  --loss P         random loss probability of the emulated link" << std::endl
+              << "  --burst P,R,L    Gilbert-Elliott losses: good to bad P, bad to good R, loss in the bad state L" << std::endl
+              << "  --reorder P      probability that a packet is held back by 1 ms" << std::endl
+              << "  --duplicate P    probability that a packet is delivered twice" << std::endl
+              << "  --delay US, --jitter US, --rate KBPS, --seed N   delay, jitter, rate and seed of the emulated link" << std::endl;
+}
+
+static const char *format_name(rtp_format_t fmt)
+{
+    switch (fmt) {
+        case RTP_FORMAT_H264: return "h264";
+        case RTP_FORMAT_H265: return "h265";
+        case RTP_FORMAT_H266: return "h266";
+        default:              return "generic";
+    }
+}
+
+static bool parse_switch(const std::string& value, std::vector<bool>& out)
+{
+    if (value == "on")        out = { true };
+    else if (value == "off")  out = { false };
+    else if (value == "both") out = { false, true };
+    else                      return false;
+    return true;
+}
+
+static bool parse_formats(const std::string& value, std::vector<rtp_format_t>& out)
+{
+    out.clear();
+    size_t start = 0;
+
+    while (start <= value.size()) {
+        size_t end = value.find(',', start);
+        std::string name = value.substr(start, end == std::string::npos ? std::string::npos : end - start);
+
+        if (name == "generic")   out.push_back(RTP_FORMAT_GENERIC);
+        else if (name == "h264") out.push_back(RTP_FORMAT_H264);
+        else if (name == "h265") out.push_back(RTP_FORMAT_H265);
+        else if (name == "h266") out.push_back(RTP_FORMAT_H266);
+        else                     return false;
+
+        if (end == std::string::npos)
+            break;
+        start = end + 1;
+    }
+    return !out.empty();
+}
+
+static bool parse_burst(const std::string& value, uvgrtp::impairment& out)
+{
+    return std::sscanf(value.c_str(), "%lf,%lf,%lf", &out.good_to_bad, &out.bad_to_good, &out.loss_bad) == 3;
+}
+
+static bool parse_options(int argc, char **argv, options& opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (i + 1 >= argc)
+            return false;
+
+        std::string value = argv[++i];
+
+        if (arg == "--frames")      opts.frames = std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--size")   opts.frame_size = std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--fps")    opts.fps = std::atoi(value.c_str());
+        else if (arg == "--format") { if (!parse_formats(value, opts.formats)) return false; }
+        else if (arg == "--srtp")   { if (!parse_switch(value, opts.srtp)) return false; }
+        else if (arg == "--pacing") { if (!parse_switch(value, opts.pacing)) return false; }
+        else if (arg == "--scl")    { if (!parse_switch(value, opts.scl)) return false; }
+        else if (arg == "--loss")      opts.impairment.loss_good = std::atof(value.c_str());
+        else if (arg == "--burst")     { if (!parse_burst(value, opts.impairment)) return false; }
+        else if (arg == "--reorder")   opts.impairment.reorder = std::atof(value.c_str());
+        else if (arg == "--duplicate") opts.impairment.duplicate = std::atof(value.c_str());
+        else if (arg == "--delay")     opts.impairment.delay_us = (uint32_t)std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--jitter")    opts.impairment.jitter_us = (uint32_t)std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--rate")      opts.impairment.rate_kbps = (uint32_t)std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--seed")      opts.impairment.seed = std::strtoull(value.c_str(), nullptr, 10);
+        else                        return false;
+
+        if (arg == "--loss" || arg == "--burst" || arg == "--reorder" || arg == "--duplicate" ||
+            arg == "--delay" || arg == "--jitter" || arg == "--rate" || arg == "--seed")
+            opts.impaired = true;
+    }
+    return opts.frames > 0 && opts.frame_size > 3 && opts.fps > 0;
+}
+
+// user and system time used by the process so far
+static double cpu_time()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0;
+
+    auto seconds = [](const FILETIME& t) {
+        return (double)(((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime) / 1e7;
+    };
+    return seconds(kernel) + seconds(user);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#endif
+}
+
+/* The number of RTP packets of one frame. The frames of the video formats are single NAL
+ * units, which are sent as fragmentation units when they do not fit in one packet */
+static size_t packets_per_frame(rtp_format_t fmt, size_t size)
+{
+    if (size <= MEDIA_PAYLOAD)
+        return 1;
+
+    size_t nal_header  = (fmt == RTP_FORMAT_H264) ? 1 : 2;
+    size_t fu_overhead = (fmt == RTP_FORMAT_H264) ? 2 : 3;
+
+    if (fmt == RTP_FORMAT_GENERIC)
+        return (size + MEDIA_PAYLOAD - 1) / MEDIA_PAYLOAD;
+
+    size_t fragment = MEDIA_PAYLOAD - fu_overhead;
+    return (size - nal_header + fragment - 1) / fragment;
+}
+
+// a frame of one NAL unit that contains no start codes
+static std::vector<uint8_t> create_frame(rtp_format_t fmt, size_t size)
+{
+    std::vector<uint8_t> frame(size, 0x55);
+
+    if (fmt == RTP_FORMAT_H264) {
+        frame[0] = 0x65;                // IDR slice
+    }
+    else if (fmt == RTP_FORMAT_H265) {
+        frame[0] = (19 << 1);           // IDR_W_RADL
+        frame[1] = 0x01;
+    }
+    else if (fmt == RTP_FORMAT_H266) {
+        frame[0] = 0x00;
+        frame[1] = (7 << 3) | 0x01;     // IDR_W_RADL
+    }
+    return frame;
+}
+
+static double percentile_us(std::vector<uint64_t>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+    return sorted[index] / 1000.0;
+}
+
+static bool run_case(uvgrtp::context& ctx, const options& opts, const bench_case& c, result& res)
+{
+    uvgrtp::session *sess = ctx.create_session(LOCAL_ADDRESS);
+    if (!sess)
+        return false;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (c.srtp)   flags |= RCE_SRTP | RCE_SRTP_KMNGMNT_USER;
+    if (c.pacing) flags |= RCE_PACE_FRAGMENT_SENDING;
+    if (c.scl)    flags |= RCE_SYSTEM_CALL_CLUSTERING;
+
+    uvgrtp::media_stream *sender   = sess->create_stream(RECEIVE_PORT, SEND_PORT, c.fmt, flags);
+    uvgrtp::media_stream *receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, c.fmt, flags);
+
+    std::vector<std::chrono::steady_clock::time_point> sent(opts.frames);
+    res.latencies_ns.assign(opts.frames, 0);
+    std::atomic<size_t> received(0);
+    std::atomic<int64_t> last_receive_ns(0);
+
+    bool ok = sender && receiver;
+
+    if (ok && c.srtp) {
+        uint8_t key[16]  = { 0x10, 0x21, 0x32, 0x43, 0x54, 0x65, 0x76, 0x87, 0x98, 0xa9, 0xba, 0xcb, 0xdc, 0xed, 0xfe, 0x0f };
+        uint8_t salt[14] = { 0x01, 0x12, 0x23, 0x34, 0x45, 0x56, 0x67, 0x78, 0x89, 0x9a, 0xab, 0xbc, 0xcd, 0xde };
+
+        ok = sender->add_srtp_ctx(key, salt) == RTP_OK && receiver->add_srtp_ctx(key, salt) == RTP_OK;
+    }
+
+    if (ok && c.pacing) {
+        ok = sender->configure_ctx(RCC_FPS_NUMERATOR, opts.fps) == RTP_OK &&
+             sender->configure_ctx(RCC_FPS_DENOMINATOR, 1) == RTP_OK;
+    }
+
+    if (ok) {
+        // the RTP timestamp of a frame is its index plus one
+        ok = receiver->install_receive_hook([&](uvgrtp::frame::rtp_frame *frame) {
+            auto now = std::chrono::steady_clock::now();
+            uint32_t index = frame->header.timestamp - 1;
+
+            if (index < opts.frames) {
+                res.latencies_ns[index] = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - sent[index]).count();
+                last_receive_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+                ++received;
+            }
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }) == RTP_OK;
+    }
+
+    if (ok) {
+        std::vector<uint8_t> frame = create_frame(c.fmt, opts.frame_size);
+        int rtp_flags = (c.fmt == RTP_FORMAT_GENERIC) ? RTP_NO_FLAGS : RTP_NO_H26X_SCL;
+
+        double cpu_start = cpu_time();
+        auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < opts.frames && ok; ++i) {
+            sent[i] = std::chrono::steady_clock::now();
+
+            rtp_error_t ret;
+            while ((ret = sender->push_frame(frame.data(), frame.size(), (uint32_t)(i + 1), rtp_flags)) == RTP_MEMORY_ERROR) {
+                // the send queue of the paced stream is full
+                std::this_thread::yield();
+                sent[i] = std::chrono::steady_clock::now();
+            }
+            ok = (ret == RTP_OK);
+        }
+        auto pushed = std::chrono::steady_clock::now();
+
+        size_t seen = received;
+        auto progress = pushed;
+        while (received < opts.frames && std::chrono::steady_clock::now() - progress < std::chrono::milliseconds(DRAIN_TIMEOUT_MS)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+            if (received != seen) {
+                seen = received;
+                progress = std::chrono::steady_clock::now();
+            }
+        }
+
+        auto last = std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(last_receive_ns.load())));
+        res.received      = received;
+        res.push_seconds  = std::chrono::duration<double>(pushed - start).count();
+        res.total_seconds = std::chrono::duration<double>(std::max(last, pushed) - start).count();
+        res.cpu_seconds   = cpu_time() - cpu_start;
+    }
+
+    if (sender)
+        sess->destroy_stream(sender);
+    if (receiver)
+        sess->destroy_stream(receiver);
+    ctx.destroy_session(sess);
+
+    return ok;
+}
+
+static void print_result(const options& opts, const bench_case& c, const result& res)
+{
+    std::vector<uint64_t> latencies;
+    latencies.reserve(res.received);
+    for (uint64_t latency : res.latencies_ns) {
+        if (latency)
+            latencies.push_back(latency);
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    double bits      = 8.0 * opts.frame_size * res.received;
+    double seconds   = std::max(res.total_seconds, 1e-9);
+    double packets   = (double)packets_per_frame(c.fmt, opts.frame_size) * res.received;
+
+    std::cout << "{\"format\":\"" << format_name(c.fmt) << "\""
+              << ",\"srtp\":" << (c.srtp ? "true" : "false")
+              << ",\"pacing\":" << (c.pacing ? "true" : "false")
+              << ",\"scl\":" << (c.scl ? "true" : "false")
+              << ",\"frame_size\":" << opts.frame_size
+              << ",\"frames\":" << opts.frames
+              << ",\"received\":" << res.received
+              << ",\"push_frames_per_s\":" << opts.frames / std::max(res.push_seconds, 1e-9)
+              << ",\"frames_per_s\":" << res.received / seconds
+              << ",\"packets_per_s\":" << packets / seconds
+              << ",\"gbit_per_s\":" << bits / seconds / 1e9
+              << ",\"latency_p50_us\":" << percentile_us(latencies, 0.50)
+              << ",\"latency_p99_us\":" << percentile_us(latencies, 0.99)
+              << ",\"latency_p999_us\":" << percentile_us(latencies, 0.999)
+              << ",\"cpu_s_per_gbit\":" << (bits > 0 ? res.cpu_seconds / (bits / 1e9) : 0)
+              << "}" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    options opts;
+    if (!parse_options(argc, argv, opts)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uvgrtp::context ctx;
+    int failed = 0;
+
+    if (opts.impaired && (ctx.set_transport(RTP_TRANSPORT_MEMORY) != RTP_OK ||
+            ctx.set_impairment(opts.impairment) != RTP_OK)) {
+        std::cerr << "The emulated link needs the memory transport of Linux and probabilities between 0 and 1" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    for (rtp_format_t fmt : opts.formats) {
+        for (bool srtp : opts.srtp) {
+            for (bool pacing : opts.pacing) {
+                for (bool scl : opts.scl) {
+                    bench_case c = { fmt, srtp, pacing, scl };
+
+                    if (srtp && !ctx.crypto_enabled()) {
+                        std::cerr << "Skipping the SRTP cases of " << format_name(fmt)
+                                  << ", uvgRTP was built without Crypto++" << std::endl;
+                        continue;
+                    }
+
+                    result res;
+                    if (!run_case(ctx, opts, c, res)) {
+                        std::cerr << "Failed to run the case " << format_name(fmt) << " srtp=" << srtp
+                                  << " pacing=" << pacing << " scl=" << scl << std::endl;
+                        ++failed;
+                        continue;
+                    }
+                    print_result(opts, c, res);
+                }
+            }
+        }
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,467 @@
+#include <uvgrtp/lib.hh>
+
+#include "../src/crypto.hh"
+#include "../src/formats/h264.hh"
+#include "../src/formats/h265.hh"
+#include "../src/formats/h266.hh"
+#include "../src/global.hh"
+#include "../src/pipeline.hh"
+#include "../src/rtp.hh"
+#include "../src/socket.hh"
+#include "../src/srtp/srtp.hh"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#endif
+
+/* Microbenchmarks of the code that every sent or received packet goes through.
+ *
+ * The video formats are benchmarked with a synthetic bitstream of one group of pictures:
+ * the parameter sets and an intra frame followed by inter frames, the sizes of which are
+ * drawn from a log-normal distribution around the given averages. The bitstreams are the
+ * same on every run, so the results can be compared between builds.
+ *
+ * The start code lookup and the reassembly of the fragmentation units are benchmarked
+ * alone. The start code lookup and the division into fragmentation units are private to
+ * the formats and they are measured through push_frame() to an address that nobody listens
+ * to: pushing an access unit includes the lookup, and pushing its NAL units that have been
+ * located by the caller does not */
+
+constexpr char REMOTE_ADDRESS[] = "127.0.0.1";
+constexpr uint16_t SEND_PORT    = 9600;
+constexpr uint16_t RECEIVE_PORT = 9602;
+
+constexpr size_t GOP_LENGTH       = 30;
+constexpr size_t INTRA_FRAME_SIZE = 60000;
+constexpr size_t INTER_FRAME_SIZE = 6000;
+
+constexpr size_t MEDIA_PAYLOAD = uvgrtp::MAX_IPV4_MEDIA_PAYLOAD;
+
+namespace {
+
+    struct access_unit {
+        std::vector<uint8_t> data;
+        std::vector<uvgrtp::frame::nal_unit> nal_units;
+    };
+
+    struct nal_types {
+        uint8_t parameter_sets[3];
+        size_t parameter_set_count;
+        uint8_t intra;
+        uint8_t inter;
+    };
+
+    nal_types get_nal_types(rtp_format_t fmt)
+    {
+        switch (fmt) {
+            case RTP_FORMAT_H264: return { { 7, 8, 0 }, 2, 5, 1 };       // SPS, PPS, IDR, non-IDR
+            case RTP_FORMAT_H265: return { { 32, 33, 34 }, 3, 19, 1 };   // VPS, SPS, PPS, IDR_W_RADL, TRAIL_R
+            default:              return { { 14, 15, 16 }, 3, 7, 0 };    // VPS, SPS, PPS, IDR_W_RADL, TRAIL
+        }
+    }
+
+    size_t nal_header_size(rtp_format_t fmt)
+    {
+        return (fmt == RTP_FORMAT_H264) ? 1 : 2;
+    }
+
+    void write_nal_header(rtp_format_t fmt, uint8_t type, uint8_t *out)
+    {
+        if (fmt == RTP_FORMAT_H264) {
+            out[0] = (3 << 5) | type;
+        }
+        else if (fmt == RTP_FORMAT_H265) {
+            out[0] = (uint8_t)(type << 1);
+            out[1] = 0x01;
+        }
+        else {
+            out[0] = 0x00;
+            out[1] = (uint8_t)((type << 3) | 0x01);
+        }
+    }
+
+    // append a NAL unit of "size" bytes with a four-byte start code and no start code emulations
+    void append_nal_unit(rtp_format_t fmt, uint8_t type, size_t size, std::mt19937& random, access_unit& au)
+    {
+        static const uint8_t start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+        au.data.insert(au.data.end(), start_code, start_code + sizeof(start_code));
+
+        size_t offset = au.data.size();
+        au.data.resize(offset + size);
+        write_nal_header(fmt, type, &au.data[offset]);
+
+        std::uniform_int_distribution<int> byte(1, 255);
+        for (size_t i = nal_header_size(fmt); i < size; ++i) {
+            au.data[offset + i] = (uint8_t)byte(random);
+        }
+        au.nal_units.push_back({ offset, size });
+    }
+
+    /* One group of pictures of "fmt". The intra frame starts with the parameter sets and each
+     * frame is one slice */
+    const std::vector<access_unit>& get_gop(rtp_format_t fmt)
+    {
+        static std::vector<access_unit> gops[3];
+        std::vector<access_unit>& gop = gops[fmt == RTP_FORMAT_H264 ? 0 : (fmt == RTP_FORMAT_H265 ? 1 : 2)];
+
+        if (!gop.empty())
+            return gop;
+
+        std::mt19937 random(1234);
+        std::lognormal_distribution<double> intra(std::log((double)INTRA_FRAME_SIZE), 0.2);
+        std::lognormal_distribution<double> inter(std::log((double)INTER_FRAME_SIZE), 0.5);
+        std::uniform_int_distribution<size_t> parameter_set(8, 40);
+        nal_types types = get_nal_types(fmt);
+
+        for (size_t i = 0; i < GOP_LENGTH; ++i) {
+            access_unit au;
+
+            if (i == 0) {
+                for (size_t p = 0; p < types.parameter_set_count; ++p) {
+                    append_nal_unit(fmt, types.parameter_sets[p], parameter_set(random), random, au);
+                }
+                append_nal_unit(fmt, types.intra, (size_t)intra(random), random, au);
+            }
+            else {
+                append_nal_unit(fmt, types.inter, std::max((size_t)64, (size_t)inter(random)), random, au);
+            }
+            gop.push_back(std::move(au));
+        }
+        return gop;
+    }
+
+    size_t gop_bytes(const std::vector<access_unit>& gop)
+    {
+        size_t bytes = 0;
+        for (auto& au : gop) {
+            bytes += au.data.size();
+        }
+        return bytes;
+    }
+
+    /* The RTP packets of one NAL unit of "size" bytes, which is sent as fragmentation units.
+     * The sequence numbers and the timestamp are set by the caller */
+    std::vector<std::vector<uint8_t>> create_fragments(rtp_format_t fmt, size_t size)
+    {
+        nal_types types = get_nal_types(fmt);
+        size_t header  = nal_header_size(fmt);
+        size_t fu_size = header + 1;
+        size_t fragment = MEDIA_PAYLOAD - fu_size;
+
+        std::vector<std::vector<uint8_t>> packets;
+
+        for (size_t pos = header; pos < size; pos += fragment) {
+            size_t len = std::min(fragment, size - pos);
+            bool first = (pos == header);
+            bool last  = (pos + len >= size);
+
+            std::vector<uint8_t> packet(12 + fu_size + len, 0x55);
+            packet[0] = 0x80;
+            packet[1] = 96 | (last ? 0x80 : 0x00);
+            packet[8] = 0x00; packet[9] = 0x00; packet[10] = 0x10; packet[11] = 0x92;
+
+            uint8_t *fu = &packet[12];
+            uint8_t flags = (first ? 0x80 : 0x00) | (last ? 0x40 : 0x00);
+
+            if (fmt == RTP_FORMAT_H264) {
+                fu[0] = (3 << 5) | 28;                  // FU-A
+                fu[1] = flags | types.intra;
+            }
+            else if (fmt == RTP_FORMAT_H265) {
+                write_nal_header(fmt, 49, fu);          // FU
+                fu[2] = flags | types.intra;
+            }
+            else {
+                write_nal_header(fmt, 29, fu);          // FU
+                fu[2] = flags | types.intra;
+            }
+            packets.push_back(std::move(packet));
+        }
+        return packets;
+    }
+
+    std::shared_ptr<uvgrtp::formats::h26x> create_format(rtp_format_t fmt, std::shared_ptr<uvgrtp::socket> socket,
+        std::shared_ptr<uvgrtp::rtp> rtp, int rce_flags)
+    {
+        switch (fmt) {
+            case RTP_FORMAT_H264: return std::make_shared<uvgrtp::formats::h264>(socket, rtp, rce_flags);
+            case RTP_FORMAT_H265: return std::make_shared<uvgrtp::formats::h265>(socket, rtp, rce_flags);
+            default:              return std::make_shared<uvgrtp::formats::h266>(socket, rtp, rce_flags);
+        }
+    }
+}
+
+// the start code lookup of the whole group of pictures
+static void BM_find_start_code(benchmark::State& state, rtp_format_t fmt)
+{
+    std::vector<uint8_t> bitstream;
+    for (auto& au : get_gop(fmt)) {
+        bitstream.insert(bitstream.end(), au.data.begin(), au.data.end());
+    }
+
+    auto rtp    = std::make_shared<uvgrtp::rtp>(fmt, std::make_shared<std::atomic<uint32_t>>(1), false);
+    auto socket = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto format = create_format(fmt, socket, rtp, 0);
+
+    size_t found = 0;
+    for (auto _ : state) {
+        uint8_t start_len = 0;
+        ssize_t offset = format->find_h26x_start_code(bitstream.data(), bitstream.size(), 0, start_len);
+
+        while (offset > -1) {
+            ++found;
+            offset = format->find_h26x_start_code(bitstream.data(), bitstream.size(), offset, start_len);
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetBytesProcessed((int64_t)state.iterations() * bitstream.size());
+}
+
+/* Pushing the access units of the group of pictures, with the start code lookup if
+ * "located" is false or with the NAL units given by the caller if it is true */
+static void BM_push_access_unit(benchmark::State& state, rtp_format_t fmt, bool located)
+{
+    const std::vector<access_unit>& gop = get_gop(fmt);
+
+    uvgrtp::context ctx;
+    uvgrtp::session *sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::media_stream *sender = sess ? sess->create_stream(SEND_PORT, fmt, RCE_SEND_ONLY) : nullptr;
+
+    if (!sender) {
+        state.SkipWithError("Failed to create the media stream");
+        return;
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        const access_unit& au = gop[i++ % gop.size()];
+        rtp_error_t ret = located ?
+            sender->push_frame((uint8_t *)au.data.data(), au.data.size(), au.nal_units, RTP_NO_FLAGS) :
+            sender->push_frame((uint8_t *)au.data.data(), au.data.size(), RTP_NO_FLAGS);
+
+        if (ret != RTP_OK) {
+            state.SkipWithError("Failed to push the frame");
+            break;
+        }
+    }
+    state.SetBytesProcessed((int64_t)(state.iterations() / gop.size()) * gop_bytes(gop));
+
+    sess->destroy_stream(sender);
+    ctx.destroy_session(sess);
+}
+
+// reassembling a NAL unit of "state.range(0)" bytes from its fragmentation units
+static void BM_reassembly(benchmark::State& state, rtp_format_t fmt)
+{
+    const size_t size = (size_t)state.range(0);
+    const int rce_flags = 0;
+
+    auto rtp    = std::make_shared<uvgrtp::rtp>(fmt, std::make_shared<std::atomic<uint32_t>>(1), false);
+    auto socket = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto format = create_format(fmt, socket, rtp, rce_flags);
+    auto pipeline = uvgrtp::make_pipeline(rce_flags, fmt, rtp, nullptr, nullptr, format.get(), nullptr);
+
+    std::vector<std::vector<uint8_t>> packets = create_fragments(fmt, size);
+    uint16_t seq = 0;
+    uint32_t ts  = 0;
+
+    for (auto _ : state) {
+        size_t frames = 0;
+        ts += 3000;
+
+        for (auto& packet : packets) {
+            uint16_t net_seq = htons(seq++);
+            uint32_t net_ts  = htonl(ts);
+            memcpy(&packet[2], &net_seq, sizeof(net_seq));
+            memcpy(&packet[4], &net_ts, sizeof(net_ts));
+
+            uvgrtp::frame::rtp_frame *out = nullptr;
+            bool buffer_taken = false;
+
+            if (pipeline->process(rce_flags, packet.data(), packet.size(), 0, &out, buffer_taken) == RTP_PKT_READY && out) {
+                (void)uvgrtp::frame::dealloc_frame(out);
+                ++frames;
+            }
+        }
+
+        if (frames != 1) {
+            state.SkipWithError("The NAL unit was not reassembled");
+            break;
+        }
+    }
+    state.SetBytesProcessed((int64_t)state.iterations() * size);
+}
+
+namespace {
+
+    std::shared_ptr<uvgrtp::srtp> create_srtp(int rce_flags)
+    {
+        uint8_t key[16]  = { 0x10, 0x21, 0x32, 0x43, 0x54, 0x65, 0x76, 0x87, 0x98, 0xa9, 0xba, 0xcb, 0xdc, 0xed, 0xfe, 0x0f };
+        uint8_t salt[14] = { 0x01, 0x12, 0x23, 0x34, 0x45, 0x56, 0x67, 0x78, 0x89, 0x9a, 0xab, 0xbc, 0xcd, 0xde };
+
+        auto srtp = std::make_shared<uvgrtp::srtp>(rce_flags);
+        if (srtp->init(uvgrtp::SRTP, rce_flags, key, key, salt, salt) != RTP_OK)
+            return nullptr;
+
+        return srtp;
+    }
+}
+
+// encrypting the payload of one RTP packet of "state.range(0)" bytes
+static void BM_srtp_encrypt(benchmark::State& state)
+{
+    const int rce_flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER;
+    std::shared_ptr<uvgrtp::srtp> srtp = uvgrtp::crypto::enabled() ? create_srtp(rce_flags) : nullptr;
+
+    if (!srtp) {
+        state.SkipWithError("SRTP is not available, build uvgRTP with Crypto++");
+        return;
+    }
+
+    uvgrtp::frame::rtp_frame header = {};
+    header.header.ssrc = htonl(4242);
+
+    std::vector<uint8_t> payload((size_t)state.range(0), 0x55);
+    uint16_t seq = 0;
+
+    for (auto _ : state) {
+        header.header.seq = htons(seq++);
+
+        uvgrtp::buf_vec buffers = {
+            { uvgrtp::RTP_HDR_SIZE, (uint8_t *)&header },
+            { payload.size(), payload.data() },
+        };
+
+        if (uvgrtp::srtp::send_packet_handler(srtp.get(), buffers) != RTP_OK) {
+            state.SkipWithError("Failed to encrypt the packet");
+            break;
+        }
+    }
+    state.SetBytesProcessed((int64_t)state.iterations() * payload.size());
+}
+
+// decrypting the payload of one received RTP packet of "state.range(0)" bytes
+static void BM_srtp_decrypt(benchmark::State& state)
+{
+    const int rce_flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER;
+    std::shared_ptr<uvgrtp::srtp> srtp = uvgrtp::crypto::enabled() ? create_srtp(rce_flags) : nullptr;
+
+    if (!srtp) {
+        state.SkipWithError("SRTP is not available, build uvgRTP with Crypto++");
+        return;
+    }
+
+    auto rtp = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_GENERIC, std::make_shared<std::atomic<uint32_t>>(1), false);
+
+    std::vector<uint8_t> packet(12 + (size_t)state.range(0), 0x55);
+    packet[0] = 0x80;
+    packet[1] = 96;
+    packet[8] = 0x00; packet[9] = 0x00; packet[10] = 0x10; packet[11] = 0x92;
+
+    uvgrtp::frame::rtp_frame *frame = nullptr;
+    if (rtp->packet_handler(nullptr, rce_flags, packet.data(), packet.size(), &frame) != RTP_PKT_MODIFIED || !frame) {
+        state.SkipWithError("Failed to parse the packet");
+        return;
+    }
+
+    // the payload is decrypted in place, so the same packet is decrypted over and over
+    for (auto _ : state) {
+        rtp_error_t ret = srtp->recv_packet_handler(srtp.get(), rce_flags, packet.data(), packet.size(), &frame);
+
+        if (ret != RTP_OK && ret != RTP_PKT_MODIFIED) {
+            state.SkipWithError("Failed to decrypt the packet");
+            break;
+        }
+    }
+    state.SetBytesProcessed((int64_t)state.iterations() * frame->payload_len);
+
+    (void)uvgrtp::frame::dealloc_frame(frame);
+}
+
+/* Generating and sending the RTCP report of a stream that receives from "state.range(0)"
+ * sources. Each source has sent a packet since the last report, so that every report has a
+ * report block for each source. The report is sent over the loopback interface */
+static void BM_rtcp_generate_report(benchmark::State& state)
+{
+    const size_t sources = (size_t)state.range(0);
+
+    uvgrtp::context ctx;
+    uvgrtp::session *sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::media_stream *receiver = sess ? sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_RTCP) : nullptr;
+
+    if (!receiver) {
+        state.SkipWithError("Failed to create the media stream");
+        if (sess)
+            ctx.destroy_session(sess);
+        return;
+    }
+
+    uvgrtp::rtcp *rtcp = receiver->get_rtcp();
+
+    std::vector<uvgrtp::frame::rtp_frame> packets(sources);
+    for (size_t i = 0; i < sources; ++i) {
+        packets[i].header.ssrc = (uint32_t)(1000 + i);
+    }
+
+    // the packets go through the RTCP receive statistics like in the reception of the stream
+    auto receive = [&]() {
+        for (auto& packet : packets) {
+            uvgrtp::frame::rtp_frame *out = &packet;
+            packet.header.seq++;
+            packet.header.timestamp += 3000;
+            (void)rtcp->recv_packet_handler_common(rtcp, 0, nullptr, 0, &out);
+        }
+    };
+
+    // the sources are on probation until they have sent enough packets in sequence
+    for (int i = 0; i < 4; ++i) {
+        receive();
+    }
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        receive();
+        state.ResumeTiming();
+
+        if (rtcp->generate_report() != RTP_OK) {
+            state.SkipWithError("Failed to generate the report");
+            break;
+        }
+    }
+
+    sess->destroy_stream(receiver);
+    ctx.destroy_session(sess);
+}
+
+BENCHMARK_CAPTURE(BM_find_start_code, h264, RTP_FORMAT_H264);
+BENCHMARK_CAPTURE(BM_find_start_code, h265, RTP_FORMAT_H265);
+BENCHMARK_CAPTURE(BM_find_start_code, h266, RTP_FORMAT_H266);
+
+BENCHMARK_CAPTURE(BM_push_access_unit, h264_scl, RTP_FORMAT_H264, false);
+BENCHMARK_CAPTURE(BM_push_access_unit, h264_located, RTP_FORMAT_H264, true);
+BENCHMARK_CAPTURE(BM_push_access_unit, h265_scl, RTP_FORMAT_H265, false);
+BENCHMARK_CAPTURE(BM_push_access_unit, h265_located, RTP_FORMAT_H265, true);
+BENCHMARK_CAPTURE(BM_push_access_unit, h266_scl, RTP_FORMAT_H266, false);
+BENCHMARK_CAPTURE(BM_push_access_unit, h266_located, RTP_FORMAT_H266, true);
+
+BENCHMARK_CAPTURE(BM_reassembly, h264, RTP_FORMAT_H264)->Arg(INTER_FRAME_SIZE)->Arg(INTRA_FRAME_SIZE);
+BENCHMARK_CAPTURE(BM_reassembly, h265, RTP_FORMAT_H265)->Arg(INTER_FRAME_SIZE)->Arg(INTRA_FRAME_SIZE);
+BENCHMARK_CAPTURE(BM_reassembly, h266, RTP_FORMAT_H266)->Arg(INTER_FRAME_SIZE)->Arg(INTRA_FRAME_SIZE);
+
+BENCHMARK(BM_srtp_encrypt)->Arg(160)->Arg(MEDIA_PAYLOAD);
+BENCHMARK(BM_srtp_decrypt)->Arg(160)->Arg(MEDIA_PAYLOAD);
+
+BENCHMARK(BM_rtcp_generate_report)->Arg(1)->Arg(16);
+
+BENCHMARK_MAIN();
@@ -3,5 +3,8 @@ include(CMakeFindDependencyMacro)
 
 find_dependency(Threads)
 
+# a build with UVGRTP_USE_OPENSSL links to OpenSSL::Crypto
+find_package(OpenSSL QUIET COMPONENTS Crypto)
+
 include("${CMAKE_CURRENT_LIST_DIR}/uvgrtpTargets.cmake")
 include("${CMAKE_CURRENT_LIST_DIR}/uvgrtpMacros.cmake")
\ No newline at end of file
@@ -9,6 +9,7 @@
 
 
 #include <chrono>
+#include <cstdint>
 
 namespace uvgrtp {
     namespace clock {
@@ -61,6 +62,44 @@ namespace uvgrtp {
             uint64_t diff_now(hrc_t then);
 
             uint64_t diff_now_us(hrc_t& then);
+
+            /* the hrc time of "system_ns", nanoseconds of the system clock such as rtp_frame::recv_time */
+            hrc_t from_system_ns(uint64_t system_ns);
+        }
+
+        /* nanoseconds of the system clock since the Unix epoch, the clock of rtp_frame::recv_time */
+        uint64_t system_ns();
+
+        /* the steady clock time of "system_ns", see above */
+        std::chrono::steady_clock::time_point steady_from_system_ns(uint64_t system_ns);
+
+        /* the clocks read on the data path, RTP_CLOCK_FLAGS */
+        void set_flags(int flags);
+        int get_flags();
+
+        /* Sample the clocks for the conversions of the arrival times of the batch of packets the calling
+         * thread is about to process, see RTP_CLOCK_BATCH_SAMPLE. The offsets between the clocks are
+         * kept until the next sample, so they also convert the packets that arrive during the batch */
+        void sample_batch();
+
+        /* coarse monotonic clock for the timeouts checked for each packet, see RTP_CLOCK_COARSE_TIMEOUTS.
+         * It has the epoch of the steady clock, so the two can be compared */
+        namespace coarse {
+            typedef std::chrono::steady_clock::time_point coarse_t;
+
+            coarse_t now();
+
+            /* the result is in milliseconds */
+            uint64_t diff_now(coarse_t then);
+        }
+
+        /* steady clock time from the time stamp counter, see RTP_CLOCK_TSC_PACING */
+        namespace tsc {
+            /* true if the CPU has an invariant time stamp counter */
+            bool available();
+
+            /* the steady clock time, from the TSC if it is available and enabled */
+            std::chrono::steady_clock::time_point now();
         }
 
         uint64_t ms_to_jiffies(uint64_t ms);
@@ -2,15 +2,141 @@
 
 #include "util.hh"
 
+#include <cstdint>
 #include <map>
 #include <string>
 #include <memory>
+#include <vector>
 
 
 namespace uvgrtp {
 
     class session;
     class socketfactory;
+    class io_engine;
+    class pacer;
+    class rtcp_scheduler;
+    class zrtp_cache;
+    class key_pool;
+    class thread_settings;
+    class audio_batch;
+    class memory_budget;
+    class media_stream;
+    class xdp_device;
+
+    /**
+     * \brief Network conditions emulated by the memory transport
+     *
+     * \details See uvgrtp::context::set_impairment(). The losses follow the Gilbert-Elliott model:
+     * before each datagram the link moves from the good to the bad state with probability
+     * "good_to_bad" and back with probability "bad_to_good", and the datagram is lost with the
+     * loss probability of the state. With the defaults, "loss_good" alone gives random losses
+     */
+    struct impairment {
+        /** Probability of moving from the good to the bad state */
+        double good_to_bad = 0;
+        /** Probability of moving from the bad to the good state */
+        double bad_to_good = 1;
+        /** Probability that a datagram is lost in the good state */
+        double loss_good = 0;
+        /** Probability that a datagram is lost in the bad state */
+        double loss_bad = 1;
+
+        /** Probability that a datagram is delivered twice */
+        double duplicate = 0;
+        /** Probability that a datagram is held back by "reorder_delay_us", so the datagrams after it overtake it */
+        double reorder = 0;
+        /** How long a reordered datagram is held back, in microseconds */
+        uint32_t reorder_delay_us = 1000;
+
+        /** Delay of every datagram, in microseconds */
+        uint32_t delay_us = 0;
+        /** Largest random delay added to "delay_us", drawn uniformly for each datagram. Jitter larger
+         * than the spacing of the datagrams also reorders them */
+        uint32_t jitter_us = 0;
+
+        /** Rate of the link in kilobits per second, 0 for no limit */
+        uint32_t rate_kbps = 0;
+        /** Longest time a datagram may wait for the link of "rate_kbps" before it is dropped, in microseconds */
+        uint32_t queue_us = 100000;
+
+        /** Seed of the random decisions, the same seed and datagrams give the same decisions */
+        uint64_t seed = 1;
+    };
+
+    /**
+     * \brief Scheduling, CPU affinity and name of a kind of internal threads
+     *
+     * \details See uvgrtp::context::configure_threads()
+     */
+    struct thread_config {
+        /** The CPUs the threads may run on, all CPUs if empty. Receive shards are
+         * spread over these CPUs one shard per CPU. Only supported on Linux and Windows */
+        std::vector<int> cpus;
+
+        /** Scheduling policy, see RTP_THREAD_POLICY */
+        int policy = RTP_SCHED_DEFAULT;
+
+        /** Priority of RTP_SCHED_FIFO and RTP_SCHED_RR, from 1 to 99. Ignored with the other policies */
+        int priority = 0;
+
+        /** Name of the threads shown by the debuggers and tools like top, at most 15 characters.
+         * Empty keeps the default name. Only supported on Linux */
+        std::string name;
+    };
+
+    /**
+     * \brief Low-latency options of a kind of media sockets
+     *
+     * \details See uvgrtp::context::configure_sockets()
+     */
+    struct socket_profile {
+        /** Microseconds the reads of the socket busy poll the receive queue of the device before
+         * sleeping (SO_BUSY_POLL), 0 disables. Raising it above net.core.busy_read requires
+         * CAP_NET_ADMIN, and the waits of the receiver threads only busy poll if net.core.busy_poll
+         * is also set. Only supported on Linux */
+        int busy_poll_us = 0;
+
+        /** Keep the interrupts of the device queue off while the socket is busy polled
+         * (SO_PREFER_BUSY_POLL, Linux 5.11) */
+        bool prefer_busy_poll = false;
+
+        /** Differentiated Services Code Point (0-63) of the sent datagrams, f.ex. 46 (EF) for
+         * audio and 34 (AF41) for video, -1 keeps the default */
+        int dscp = -1;
+
+        /** Priority of the sent datagrams in the queues of the host (SO_PRIORITY), 0-6 without
+         * CAP_NET_ADMIN, -1 keeps the default. Only supported on Linux */
+        int priority = -1;
+
+        /** Grow the receive buffer of the socket up to this many bytes when the kernel drops
+         * datagrams or the buffer holds less than 100 ms of the received traffic, 0 keeps the
+         * size of RCC_UDP_RCV_BUF_SIZE. The system limit net.core.rmem_max applies unless the
+         * process has CAP_NET_ADMIN. Only supported on Linux */
+        size_t max_receive_buffer = 0;
+    };
+
+    /**
+     * \brief One passed tracepoint of the data path
+     *
+     * \details See uvgrtp::context::install_trace_hook()
+     */
+    struct trace_event {
+        /** The tracepoint, see RTP_TRACE_POINT */
+        int point = 0;
+
+        /** SSRC of the stream, 0 if not known */
+        uint32_t ssrc = 0;
+
+        /** RTP timestamp of the frame, 0 if not known, see RTP_TRACE_POINT */
+        uint32_t timestamp = 0;
+
+        /** Number of packets or bytes, see RTP_TRACE_POINT */
+        uint64_t value = 0;
+
+        /** When the tracepoint was passed, in nanoseconds of std::chrono::steady_clock */
+        uint64_t time_ns = 0;
+    };
 
     /**
      * \brief Provides CNAME isolation and can be used to create uvgrtp::session objects
@@ -79,6 +205,24 @@ namespace uvgrtp {
             std::string& get_cname();
             /// \endcond
 
+            /**
+             * \brief Set the CNAME of the media streams of this context
+             *
+             * \details By default, the CNAME is generated from the host and login names when the
+             * first media stream of the context starts RTCP, so creating a context or a stream without
+             * RTCP does not look them up. Setting the CNAME skips the lookup altogether, which
+             * helps where resolving the names is slow. The streams that have already started RTCP
+             * keep their CNAME.
+             *
+             * \param cname The CNAME sent in the RTCP SDES packets
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_INVALID_VALUE     If "cname" is empty or longer than 255 bytes
+             */
+            rtp_error_t set_cname(const std::string& cname);
+
             /**
              * \brief Has Crypto++ been included in uvgRTP library
              *
@@ -87,13 +231,443 @@ namespace uvgrtp {
              */
             bool crypto_enabled() const;
 
-        private:
-            /* Generate CNAME for participant using host and login names */
-            std::string generate_cname() const;
+            /**
+             * \brief Receive the media streams of this context with a shared pool of threads
+             *
+             * \details By default, every socket that receives media has its own receiver and
+             * processing threads, which adds up to a lot of threads when there are hundreds
+             * of streams. After calling this, the sockets of streams created afterwards are
+             * multiplexed through "workers" epoll event loop threads, and the packets of a socket
+             * are processed in the event loop thread that read them. Because of this, a slow
+             * receive hook delays the reception of every socket of that thread.
+             *
+             * This must be called before creating the media streams and it can only be called once.
+             * Only supported on Linux.
+             *
+             * \param workers Number of event loop threads
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_INVALID_VALUE     If "workers" is 0
+             * \retval RTP_INITIALIZED       If the event loops have already been started
+             * \retval RTP_NOT_SUPPORTED     If the platform does not support the event loops
+             * \retval RTP_GENERIC_ERROR     If creating an event loop failed
+             */
+            rtp_error_t start_io_engine(size_t workers);
+
+            /**
+             * \brief Receive the media streams of this context from the event loop of the application
+             *
+             * \details Like start_io_engine(), but without threads of uvgRTP. The sockets of the
+             * streams created afterwards, and of their RTCP, are added to one epoll instance whose
+             * descriptor get_event_fd() returns. The application adds the descriptor to its own
+             * event loop, such as epoll, libuv or asio, and calls process_events() when it becomes
+             * readable. The packets are then read, processed and given to the receive hooks from the
+             * thread of the application, and pull_frame() returns the frames it completed.
+             *
+             * The RTCP reports and the other timers of the streams still run in their own threads, as
+             * do the sockets of the memory transport. This must be called before creating the media
+             * streams and it can only be called once, instead of start_io_engine(). Only supported on Linux.
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_INITIALIZED       If the event loops have already been started
+             * \retval RTP_NOT_SUPPORTED     If the platform does not support the event loops
+             * \retval RTP_GENERIC_ERROR     If creating the epoll instance failed
+             */
+            rtp_error_t start_external_event_loop();
+
+            /**
+             * \brief Descriptor to watch for reading in the event loop of the application
+             *
+             * \details The descriptor is readable while a socket of the context has packets that
+             * process_events() would read. It belongs to uvgRTP and must not be closed
+             *
+             * \return The descriptor, -1 if start_external_event_loop() has not been called
+             */
+            int get_event_fd() const;
+
+            /**
+             * \brief Read and process the received packets of the context without blocking
+             *
+             * \details Reads the sockets that have packets and processes them, calling the receive
+             * hooks of the streams from this thread. With a "budget", the call returns after about
+             * that many packets and the rest are left to the next call, so that one busy socket
+             * does not hold up the event loop. The descriptor of get_event_fd() stays readable
+             * while there are packets left. Calls from several threads are serialized
+             *
+             * \param budget Most packets to read, 0 to read all packets that have been received
+             *
+             * \return The number of packets read, 0 if start_external_event_loop() has not been called
+             */
+            size_t process_events(size_t budget);
+
+            /**
+             * \brief Receive each media port of this context with several sockets and threads
+             *
+             * \details By default, a port has one socket that is read and processed by one
+             * thread, which limits the reception of many streams multiplexed into one port to
+             * one core. After calling this, each media port bound afterwards gets "shards"
+             * sockets bound to it with SO_REUSEPORT, each with its own reception threads pinned
+             * to a core of its own. The kernel gives the packets of an SSRC always to the same
+             * socket, so the frames of a stream are reassembled by one thread without locking.
+             * The frames of all the shards are returned through the receive hooks and
+             * pull_frame() of the streams as before, from the thread of the shard.
+             *
+             * This must be called before creating the media streams. Only supported on Linux.
+             *
+             * \param shards Number of sockets for each port, 1 disables sharding
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_INVALID_VALUE     If "shards" is 0 or larger than 64
+             * \retval RTP_NOT_SUPPORTED     If the platform does not support sharding
+             */
+            rtp_error_t set_receive_shards(size_t shards);
+
+            /**
+             * \brief Carry the media packets between the streams of this process in memory
+             *
+             * \details With RTP_TRANSPORT_MEMORY, each media port bound afterwards is also reachable
+             * through a queue in memory. When a stream of this process sends media to a port that
+             * another stream of the process with the memory transport is bound to, the packets are
+             * copied straight to the queue of the receiving socket instead of being sent through the
+             * kernel, and the receiver reads them before the datagrams of its socket. This saves the
+             * system calls and the loopback interface when the stages of a pipeline, such as a
+             * transcoder feeding a packager, run in one process. The streams still bind their UDP
+             * sockets, so the packets from and to other processes go through the kernel as before.
+             *
+             * Only the RTP packets are carried in memory. RTCP, ZRTP, holepunching and the packets of
+             * send_user_packet() go through the kernel. A packet that does not fit into the queue of
+             * the receiver is also sent through the kernel, so the order of the packets is only kept
+             * while the receiver keeps up. Multicast addresses always use the kernel and the sockets
+             * of the memory transport are read by the reception threads of their streams instead of
+             * the I/O engine of start_io_engine().
+             *
+             * This must be called before creating the media streams. Only supported on Linux.
+             *
+             * With RTP_TRANSPORT_SHARED_MEMORY, the queue of each media port is also placed in a POSIX
+             * shared memory segment named after its address, such as /dev/shm/uvgrtp-4-7f000001-8888,
+             * so the streams of other processes of the host with the same transport send to it the same
+             * way. A sender maps the segment the first time it sends to the address and keeps it mapped,
+             * so the packets cost no system calls while the receiver keeps up. A port bound to the
+             * unspecified address is reached through the loopback address. Both processes have to run
+             * as the same user and the same version of uvgRTP.
+             *
+             * With RTP_TRANSPORT_XDP, the IPv4 media ports are received through an AF_XDP socket on
+             * the interface of set_xdp_interface(), see there.
+             *
+             * \param transport RTP_TRANSPORT_UDP, RTP_TRANSPORT_MEMORY, RTP_TRANSPORT_SHARED_MEMORY or RTP_TRANSPORT_XDP
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_INVALID_VALUE     If "transport" is not an RTP_TRANSPORT value, or RTP_TRANSPORT_XDP
+             *                               without set_xdp_interface()
+             * \retval RTP_NOT_SUPPORTED     If the platform or the build does not support the transport, or
+             *                               the XDP program could not be attached
+             */
+            rtp_error_t set_transport(int transport);
+
+            /**
+             * \brief Emulate loss, reordering, duplication, delay and rate limits in the memory transport
+             *
+             * \details The datagrams that RTP_TRANSPORT_MEMORY carries to the sockets bound after
+             * this go through an emulated link with the conditions of "config" before the receiver
+             * gets them, so that the loss recovery and the reassembly can be measured under
+             * repeatable conditions without a network emulator. Each receiving socket has a link of
+             * its own. The random decisions are drawn from a generator seeded with "config.seed" and
+             * the order in which the sockets were created, so the same datagrams meet the same losses,
+             * duplicates and reordering on every run. The delays follow the clock, and the datagrams
+             * are released by a thread of the link only when the config delays them.
+             *
+             * The datagrams sent through the kernel, such as RTCP or the datagrams that do not fit
+             * into the memory transport, are not impaired. Call this before creating the media
+             * streams. A default uvgrtp::impairment turns the emulation off again. Only supported on Linux.
+             *
+             * \param config The conditions of the link
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_INVALID_VALUE     If a probability is not between 0 and 1
+             * \retval RTP_NOT_SUPPORTED     If the platform does not support the memory transport
+             */
+            rtp_error_t set_impairment(const uvgrtp::impairment& config);
+
+            /**
+             * \brief Select the interface and receive queue of RTP_TRANSPORT_XDP
+             *
+             * \details With RTP_TRANSPORT_XDP, an XDP program is attached to "queue" of "interface". It
+             * redirects the IPv4 UDP datagrams sent to the media ports of the context to an AF_XDP socket,
+             * so they skip the network stack, and passes everything else, including the other queues, to
+             * the stack as before. The datagrams are read from the memory the socket shares with the
+             * driver by one thread of the context, configured as RTP_THREAD_RECEIVER, and handed to the
+             * reception threads of the streams. The datagrams to a host that the context has received from
+             * are written to the same memory with the Ethernet and IP headers of the received ones turned
+             * around, the others are sent through the kernel.
+             *
+             * The NIC should steer the media to "queue", f.ex. with an ethtool flow rule, or have only one
+             * queue. The interface must not have another XDP program. Loading the program needs
+             * CAP_NET_ADMIN and CAP_BPF or root, and uvgRTP must be built with UVGRTP_ENABLE_XDP.
+             * Call this before set_transport()
+             *
+             * \param interface Name of the network interface, f.ex. "eth0"
+             * \param queue     Receive queue of the interface
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             */
+            rtp_error_t set_xdp_interface(const std::string& interface, unsigned int queue);
+
+            /**
+             * \brief Configure the scheduling, CPU affinity and name of a kind of internal threads
+             *
+             * \details By default, the receiver and processing threads run with the highest SCHED_FIFO
+             * priorities the system allows them and the other threads with the default scheduling,
+             * on any CPU. With this, the threads of "type" can be kept on the CPUs near the network
+             * card and given a real-time priority above the encoder threads of the application.
+             *
+             * The configuration applies to the threads of this context started afterwards, so it
+             * should be called before creating the sessions. A real-time policy usually requires
+             * privileges, such as CAP_SYS_NICE on Linux. If applying the configuration fails, the
+             * thread is started with a warning.
+             *
+             * \param type Kind of threads, see RTP_THREAD_TYPE
+             * \param config Configuration of the threads
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_INVALID_VALUE     If "type" or "config.policy" is unknown, a CPU of "config.cpus"
+             *                               is out of range, "config.priority" is out of range for a
+             *                               real-time policy or "config.name" is too long
+             * \retval RTP_NOT_SUPPORTED     If "config.cpus" is not empty and the platform does not support affinity
+             */
+            rtp_error_t configure_threads(int type, const uvgrtp::thread_config& config);
+
+            /**
+             * \brief Configure the busy polling, traffic class and receive buffer of a kind of media sockets
+             *
+             * \details The profile of "type" is applied to the RTP sockets of the streams of that
+             * type created afterwards, including their receive shards, so it should be called before
+             * creating the sessions. Together with configure_threads(), busy polling the sockets from
+             * a receiver thread on a dedicated CPU takes the wake-up from an interrupt off the receive
+             * latency. The streams multiplexed into one socket share the profile of the stream created last.
+             * If the system refuses an option, the socket is used without it with a warning
+             *
+             * \param type Kind of sockets, see RTP_SOCKET_TYPE
+             * \param profile Options of the sockets
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_INVALID_VALUE     If "type" is unknown or a value of "profile" is out of range
+             */
+            rtp_error_t configure_sockets(int type, const uvgrtp::socket_profile& profile);
+
+            /**
+             * \brief Keep the ZRTP identity and retained secrets of this context in a file
+             *
+             * \details With a cache, ZRTP keeps the same ZID between sessions and remembers a
+             * secret for each remote endpoint it has completed a session with. The next session
+             * with the same endpoint uses Preshared mode, which skips the Diffie-Hellman exchange,
+             * if the endpoint has kept the secret as well. Otherwise the session falls back to
+             * Diffie-Hellman mode.
+             *
+             * The file is created if it does not exist. Anyone who can read it can
+             * impersonate this endpoint. This must be called before creating the sessions
+             * that use ZRTP.
+             *
+             * \param path Path of the cache file
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_INVALID_VALUE     If the file exists but it is not a ZRTP cache
+             */
+            rtp_error_t set_zrtp_cache_file(std::string path);
+
+            /**
+             * \brief Keep the ZRTP identity and retained secrets of this context in "cache"
+             *
+             * \details Same as set_zrtp_cache_file() with the storage provided by the application.
+             * Give nullptr to stop caching. This must be called before creating the sessions
+             * that use ZRTP.
+             *
+             * \param cache The cache, see uvgrtp::zrtp_cache
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             */
+            rtp_error_t set_zrtp_cache(std::shared_ptr<uvgrtp::zrtp_cache> cache);
 
-            /* CNAME is the same for all connections */
+            /**
+             * \brief Offer the EC25 key agreement in ZRTP
+             *
+             * \details By default, ZRTP uses the DH3k key agreement and its Hello message does not
+             * list any key agreement types, which keeps it compatible with earlier uvgRTP versions.
+             * After calling this, the sessions created afterwards also offer EC25 (ECDH on NIST P-256)
+             * and use it if the remote offers it too, which makes the key exchange much faster. Only
+             * enable it if the remotes run a uvgRTP version that supports EC25 or another ZRTP
+             * implementation, since the earlier uvgRTP versions cannot parse a Hello with the list.
+             *
+             * \param enable Whether EC25 is offered
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_NOT_SUPPORTED     If uvgRTP has been built without Crypto++
+             */
+            rtp_error_t set_zrtp_ec25(bool enable);
+
+            /**
+             * \brief Generate ZRTP key pairs ahead of time
+             *
+             * \details By default, each ZRTP session generates its Diffie-Hellman key pair when
+             * it starts, which takes tens of milliseconds for DH3k. After calling this, a thread of
+             * the context keeps "size" DH3k and EC25 key pairs ready and the sessions created
+             * afterwards take their key pair from it. A session generates its own key pair if the
+             * pool has run out. Each key pair is used only once. Call again with 0 to stop the thread.
+             *
+             * \param size Number of key pairs kept ready for each key agreement type
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_NOT_SUPPORTED     If uvgRTP has been built without Crypto++
+             */
+            rtp_error_t set_zrtp_key_pool(size_t size);
+
+            /**
+             * \brief Trace the frames and packets through the data path
+             *
+             * \details The tracepoints tell when the packets of a frame arrive, when the frame is
+             * complete and when the application pulls it, and on the sending side when the frame
+             * is pushed, paced and sent, see RTP_TRACE_POINT. "hook" is called synchronously from
+             * the thread that passed the tracepoint, so it should only record the event.
+             *
+             * The tracepoints are compiled in with the CMake option UVGRTP_ENABLE_TRACING. They
+             * are static, so the hook receives the events of every context of the process.
+             * Without a hook, a tracepoint costs one predictable branch. If the system has
+             * sys/sdt.h, the tracepoints are also USDT probes of the provider "uvgrtp", which
+             * tools such as bpftrace and perf can attach to without a hook.
+             *
+             * \param arg Optional argument that is passed to the hook when it is called, can be set to nullptr
+             * \param hook Function pointer to the hook, nullptr stops tracing
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_NOT_SUPPORTED     If uvgRTP has been built without UVGRTP_ENABLE_TRACING
+             */
+            rtp_error_t install_trace_hook(void *arg, void (*hook)(void *, const uvgrtp::trace_event *));
+
+            /**
+             * \brief Select the clocks that uvgRTP reads on its data path
+             *
+             * \details At high packet rates, reading the clocks for every packet adds up. By default,
+             * the timeouts checked for every packet are read from the coarse monotonic clock and the
+             * arrival times of the packets are converted to the other clocks once per batch of
+             * received packets, see RTP_CLOCK_FLAGS. RTP_CLOCK_TSC_PACING also times the pacing with
+             * the time stamp counter of the CPU. The clocks are shared by every context of the process.
+             *
+             * \param flags RTP_CLOCK_FLAGS combined with bitwise OR, RTP_CLOCK_PRECISE reads the standard clocks
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_INVALID_VALUE     If "flags" has unknown flags
+             */
+            rtp_error_t set_clock_flags(int flags);
+
+            /**
+             * \brief Send one audio frame for each of many media streams
+             *
+             * \details Each frame is sent as one RTP packet, as Opus and the G.711 family are framed,
+             * and the packet is built from the RTP header of the stream without the per-frame state that
+             * push_frame() sets up for fragmenting frames. The packets of the streams that share a
+             * socket, which are the streams of a session created on the same local port, go to the
+             * kernel with one sendmmsg(2) call, so a mixer that sends a 20 ms tick of thousands of
+             * streams makes a few system calls instead of one per stream. The frames are sent
+             * synchronously and can be reused once the call returns.
+             *
+             * A frame that does not fit into one packet and the frames of a stream of a video format,
+             * with ::RCE_ASYNC_SEND, FEC, congestion control, retransmissions, pacing, frame rate control
+             * or destinations of add_destination() are sent with push_frame() instead. A stream may
+             * be given at most once in a call.
+             *
+             * \param streams The media streams
+             * \param frames The frame of each stream
+             * \param sizes The size of each frame in bytes
+             * \param timestamps The RTP timestamp of each frame, or nullptr to timestamp the frames
+             * with the clocks of the streams as push_frame() does
+             * \param count Number of streams
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_INVALID_VALUE     If an array is nullptr, a stream or a frame is nullptr or
+             * empty or a stream is given more than once. The other frames are still sent
+             * \retval RTP_SEND_ERROR        If sending some of the frames failed
+             */
+            rtp_error_t push_audio_frames(uvgrtp::media_stream **streams, uint8_t **frames, size_t *sizes,
+                const uint32_t *timestamps, size_t count);
+
+            /**
+             * \brief Limit the memory all the media streams of the context hold for received frames
+             *
+             * \details Every stream charges the H26x frames it is reassembling both to its own
+             * budget, see ::RCC_MEMORY_BUDGET, and to the budget of the context. When a received
+             * fragment does not fit into either, the stream drops its own oldest incomplete frames
+             * until it fits, so one stream cannot take the memory of the others for long. The
+             * limit applies to the streams created before and after the call.
+             *
+             * \param bytes The limit in bytes, 0 for no limit
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             */
+            rtp_error_t set_memory_budget(size_t bytes);
+
+            /**
+             * \brief Get the bytes the media streams of the context hold for received frames
+             *
+             * \details See set_memory_budget() and uvgrtp::stream_stats::memory_usage
+             */
+            size_t get_memory_usage() const;
+
+        private:
+            /* The CNAME of get_cname(), which is kept by the socket factory */
             std::string cname_;
             std::shared_ptr<uvgrtp::socketfactory> sfp_;
+            std::shared_ptr<uvgrtp::io_engine> io_engine_;
+
+            /* Sends the paced packets of all streams, see RCE_PACE_FRAGMENT_SENDING */
+            std::shared_ptr<uvgrtp::pacer> pacer_;
+
+            /* Sends the periodic RTCP reports of all sessions */
+            std::shared_ptr<uvgrtp::rtcp_scheduler> rtcp_scheduler_;
+
+            /* Configurations of the threads of this context, see configure_threads() */
+            std::shared_ptr<uvgrtp::thread_settings> thread_settings_;
+
+            /* The arrays of push_audio_frames() */
+            std::shared_ptr<uvgrtp::audio_batch> audio_batch_;
+
+            /* The parent of the memory budgets of the streams, see set_memory_budget() */
+            std::shared_ptr<uvgrtp::memory_budget> memory_budget_;
+
+            /* The interface and queue of set_xdp_interface() and the AF_XDP transport on them */
+            std::string xdp_interface_;
+            unsigned int xdp_queue_ = 0;
+            std::shared_ptr<uvgrtp::xdp_device> xdp_device_;
         };
 }
 
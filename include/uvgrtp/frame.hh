@@ -30,7 +30,16 @@ namespace uvgrtp {
             RTCP_FT_BYE   = 203, /* Goodbye */
             RTCP_FT_APP   = 204, /* Application-specific message */
             RTCP_FT_RTPFB = 205, /* Transport layer FB message */
-            RTCP_FT_PSFB  = 206  /* Payload-specific FB message */
+            RTCP_FT_PSFB  = 206, /* Payload-specific FB message */
+            RTCP_FT_XR    = 207  /* Extended report, defined in RFC 3611 */
+        };
+
+        enum RTCP_XR_BLOCK_TYPE {
+            RTCP_XR_LOSS_RLE          = 1, /* Loss RLE report block */
+            RTCP_XR_RRT               = 4, /* Receiver reference time report block */
+            RTCP_XR_DLRR              = 5, /* DLRR report block */
+            RTCP_XR_STAT_SUMMARY      = 6, /* Statistics summary report block */
+            RTCP_XR_VOIP_METRICS      = 7  /* VoIP metrics report block */
         };
 
         enum RTCP_PSFB_FMT {
@@ -43,7 +52,8 @@ namespace uvgrtp {
         };
 
         enum RTCP_RTPFB_FMT {
-            RTCP_RTPFB_NACK   = 1 /* Generic NACK, defined in RFC 4585 section 6.2 */
+            RTCP_RTPFB_NACK   = 1,  /* Generic NACK, defined in RFC 4585 section 6.2 */
+            RTCP_RTPFB_TWCC   = 15  /* Transport-wide congestion control feedback, see draft-holmer-rmcat-transport-wide-cc-extensions-01 */
         };
 
         PACK(struct rtp_header {
@@ -76,15 +86,50 @@ namespace uvgrtp {
             *
             *   \details payload_len = total length - header length - padding length (if padded) 
             */
-            size_t payload_len = 0; 
+            size_t payload_len = 0;
             uint8_t* payload = nullptr;
 
+            /** \brief When the packet was received, in nanoseconds of the system clock since the Unix epoch
+            *
+            *   \details The time is the kernel receive timestamp of the datagram if RCC_TIMESTAMPING enables
+            *   RTP_TIMESTAMP_RECEIVE and the system supports it, otherwise the time the datagram was read from
+            *   the socket. For a frame reassembled from several packets, this is the time the last packet
+            *   of the frame was received. Zero if the frame was not received from a socket
+            */
+            uint64_t recv_time = 0;
+
             /// \cond DO_NOT_DOCUMENT
             uint8_t *dgram = nullptr;      /* pointer to the UDP datagram (for internal use only) */
             size_t   dgram_size = 0;       /* size of the UDP datagram */
+            bool     dgram_owned = false;  /* payload points into "dgram", which the frame releases */
             /// \endcond
         };
 
+        /** \brief Location of one NAL unit inside a frame given to uvgrtp::media_stream::push_frame()
+         *
+         * \details The NAL unit starts from its NAL unit header, which means that a possible
+         * start code in front of the NAL unit is not included in the offset or the size */
+        struct nal_unit {
+            /** \brief Offset of the NAL unit header from the beginning of the frame */
+            size_t offset = 0;
+            /** \brief Size of the NAL unit in bytes, without the start code */
+            size_t size = 0;
+        };
+
+        /** \brief Part of a fragmented H.264/H.265/H.266 NAL unit, see uvgrtp::media_stream::install_nal_chunk_hook() */
+        struct nal_chunk {
+            /** \brief RTP timestamp of the NAL unit */
+            uint32_t timestamp = 0;
+            /** \brief Offset of the chunk from the beginning of the NAL unit header */
+            size_t offset = 0;
+            /** \brief Data of the chunk, only valid while the hook is running */
+            const uint8_t *data = nullptr;
+            /** \brief Size of the chunk in bytes */
+            size_t len = 0;
+            /** \brief This chunk ends the NAL unit */
+            bool last = false;
+        };
+
         /** \brief Header of for all RTCP packets defined in <a href="https://www.rfc-editor.org/rfc/rfc3550#section-6" target="_blank">RFC 3550 section 6</a> */
         struct rtcp_header {
             /** \brief  This field identifies the version of RTP. The version defined by
@@ -174,6 +219,90 @@ namespace uvgrtp {
             size_t payload_len = 0;
         };
 
+        /** \brief Loss RLE report block, See <a href="https://www.rfc-editor.org/rfc/rfc3611#section-4.1" target="_blank">RFC 3611 section 4.1</a> */
+        struct rtcp_xr_loss_rle {
+            uint32_t ssrc = 0;
+            uint8_t  thinning = 0;
+            /** \brief The first sequence number of the block */
+            uint16_t begin_seq = 0;
+            /** \brief One past the last sequence number of the block */
+            uint16_t end_seq = 0;
+            /** \brief The run length and bit vector chunks. A run length chunk has the top bit clear, the
+             * next bit tells whether the packets of the run were received and the remaining 14 bits
+             * are the length of the run. A bit vector chunk has the top bit set and the 15 bits
+             * that follow tell from the most significant one down whether each packet was received */
+            std::vector<uint16_t> chunks;
+        };
+
+        /** \brief A sub-block of the DLRR report block, See <a href="https://www.rfc-editor.org/rfc/rfc3611#section-4.5" target="_blank">RFC 3611 section 4.5</a> */
+        struct rtcp_xr_dlrr_item {
+            uint32_t ssrc = 0;
+            /** \brief The middle 32 bits of the NTP timestamp of the last RRT block from "ssrc" */
+            uint32_t lrr = 0;
+            /** \brief Delay since the last RRT block in units of 1/65536 seconds */
+            uint32_t dlrr = 0;
+        };
+
+        /** \brief Statistics summary report block, See <a href="https://www.rfc-editor.org/rfc/rfc3611#section-4.6" target="_blank">RFC 3611 section 4.6</a> */
+        struct rtcp_xr_stat_summary {
+            uint32_t ssrc = 0;
+            /** \brief The L, D, J and ToH flags of the block */
+            uint8_t  flags = 0;
+            uint16_t begin_seq = 0;
+            uint16_t end_seq = 0;
+            uint32_t lost_packets = 0;
+            uint32_t dup_packets = 0;
+            /** \brief The jitter values are the relative transit times between consecutive packets in timestamp units */
+            uint32_t min_jitter = 0;
+            uint32_t max_jitter = 0;
+            uint32_t mean_jitter = 0;
+            uint32_t dev_jitter = 0;
+            uint8_t  min_ttl_or_hl = 0;
+            uint8_t  max_ttl_or_hl = 0;
+            uint8_t  mean_ttl_or_hl = 0;
+            uint8_t  dev_ttl_or_hl = 0;
+        };
+
+        /** \brief VoIP metrics report block, See <a href="https://www.rfc-editor.org/rfc/rfc3611#section-4.7" target="_blank">RFC 3611 section 4.7</a>.
+         * The levels, the R factors and the MOS values are 127 when they are not known */
+        struct rtcp_xr_voip_metrics {
+            uint32_t ssrc = 0;
+            uint8_t  loss_rate = 0;
+            uint8_t  discard_rate = 0;
+            uint8_t  burst_density = 0;
+            uint8_t  gap_density = 0;
+            uint16_t burst_duration = 0;
+            uint16_t gap_duration = 0;
+            uint16_t round_trip_delay = 0;
+            uint16_t end_system_delay = 0;
+            uint8_t  signal_level = 127;
+            uint8_t  noise_level = 127;
+            uint8_t  rerl = 127;
+            uint8_t  gmin = 16;
+            uint8_t  r_factor = 127;
+            uint8_t  ext_r_factor = 127;
+            uint8_t  mos_lq = 127;
+            uint8_t  mos_cq = 127;
+            uint8_t  rx_config = 0;
+            uint16_t jb_nominal = 0;
+            uint16_t jb_maximum = 0;
+            uint16_t jb_abs_max = 0;
+        };
+
+        /** \brief Extended report, See <a href="https://www.rfc-editor.org/rfc/rfc3611#section-2" target="_blank">RFC 3611 section 2</a>.
+         * The blocks are in the order of their types, not in the order they were in the packet */
+        struct rtcp_xr_packet {
+            struct rtcp_header header;
+            uint32_t ssrc = 0;
+            std::vector<rtcp_xr_loss_rle> loss_rle;
+            /** \brief Whether the packet had a receiver reference time block and its NTP timestamp */
+            bool has_rrt = false;
+            uint64_t rrt_ntp = 0;
+            std::vector<rtcp_xr_dlrr_item> dlrr;
+            std::vector<rtcp_xr_stat_summary> stat_summary;
+            std::vector<rtcp_xr_voip_metrics> voip_metrics;
+        };
+
         /** \brief Full Intra Request, See RFC 5104 section 4.3.1 */
         struct rtcp_fir {
             uint32_t ssrc = 0;
@@ -239,6 +368,9 @@ namespace uvgrtp {
 
 
         /* Deallocate RTP frame
+         *
+         * The frame and its payload are returned to uvgRTP's frame pool, so the payload
+         * must have been allocated by uvgRTP
          *
          * Return RTP_OK on successs
          * Return RTP_INVALID_VALUE if "frame" is nullptr */
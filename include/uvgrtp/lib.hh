@@ -11,5 +11,7 @@
 
 #include "clock.hh"         // time related functions
 #include "frame.hh"         // frame related functions
+#include "media_clock.hh"   // media clock interface
 #include "util.hh"          // types
 #include "version.hh"       // version
+#include "zrtp_cache.hh"    // ZRTP cache interface
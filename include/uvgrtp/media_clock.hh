@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace uvgrtp {
+
+    /**
+     * \brief A media clock of the application that the RTP timestamps are taken from
+     *
+     * \details By default, uvgRTP stamps each frame that is pushed without a timestamp with
+     * the time elapsed on the wall clock since the first frame, and the sender reports pair that
+     * timestamp with the NTP time of the system clock. If the capture pipeline has its own media
+     * clock, for example one disciplined by PTP, give it to uvgrtp::media_stream::set_media_clock().
+     * The RTP timestamps of the frames and the NTP and RTP times of the sender reports are then
+     * read from the same clock, so the streams that share it can be synchronized exactly.
+     *
+     * uvgRTP offers uvgrtp::function_media_clock and uvgrtp::counter_media_clock. Implement this
+     * interface to read the clock some other way. now() is called from the thread that sends the
+     * frames and from the RTCP thread, so it must be thread-safe.
+     */
+    class media_clock {
+        public:
+            virtual ~media_clock() {}
+
+            /**
+             * \brief Read the media clock
+             *
+             * \param clock_rate The clock rate of the RTP timestamps of the stream
+             * \param ntp The time of the clock as a 64-bit NTP timestamp
+             * \param units The same time in units of "clock_rate". The RTP timestamps of a stream
+             * are these units truncated to 32 bits plus the random offset of the stream
+             */
+            virtual void now(uint32_t clock_rate, uint64_t& ntp, uint64_t& units) = 0;
+    };
+
+    /**
+     * \brief A media clock read with a function that returns the time as a 64-bit NTP timestamp
+     *
+     * \details The units of the RTP clock are derived from the NTP time with integer arithmetic,
+     * so the RTP timestamps count exactly at the clock rate of the stream
+     */
+    class function_media_clock : public media_clock {
+        public:
+            function_media_clock(std::function<uint64_t()> ntp_now);
+
+            void now(uint32_t clock_rate, uint64_t& ntp, uint64_t& units);
+
+        private:
+            std::function<uint64_t()> ntp_now_;
+    };
+
+    /**
+     * \brief A media clock kept by a counter of the application, such as the samples of an audio device
+     *
+     * \details "counter" counts at "counter_rate" Hz. The RTP timestamps are the count converted to
+     * the clock rate of the stream, which is the count itself if the rates are equal. The NTP time
+     * of the count is the system time at which the clock was created plus the time the counter
+     * has advanced since then.
+     */
+    class counter_media_clock : public media_clock {
+        public:
+            counter_media_clock(std::shared_ptr<std::atomic<uint64_t>> counter, uint32_t counter_rate);
+
+            void now(uint32_t clock_rate, uint64_t& ntp, uint64_t& units);
+
+        private:
+            std::shared_ptr<std::atomic<uint64_t>> counter_;
+            uint32_t counter_rate_;
+
+            uint64_t start_ntp_;
+            uint64_t start_count_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
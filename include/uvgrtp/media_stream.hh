@@ -2,10 +2,14 @@
 
 #include "util.hh"
 
+#include <functional>
+#include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <string>
 #include <atomic>
+#include <vector>
 
 #ifndef _WIN32
 #include <sys/socket.h>
@@ -13,6 +17,21 @@
 #else
 #include <ws2ipdef.h>
 #endif
+
+/* The awaitables of async_pull_frame() and async_push_frame() are used with C++20 coroutines,
+ * the futures otherwise */
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define UVGRTP_HAVE_COROUTINES 1
+#endif
+#endif
+
+#ifdef UVGRTP_HAVE_COROUTINES
+#include <coroutine>
+#else
+#include <future>
+#endif
+
 namespace uvgrtp {
 
     // forward declarations
@@ -26,18 +45,165 @@ namespace uvgrtp {
 
     class reception_flow;
     class holepuncher;
+    class send_queue;
+    class copy_pool;
     class socket;
+    class media_clock;
     class socketfactory;
     class rtcp_reader;
+    class twcc_sender;
+    class path_mtu;
+    class packet_history;
+    class jitter_buffer;
+    class stream_metrics;
+    class memory_budget;
+    class forwarder;
+    class recorder;
+    class async_pulls;
+
+    struct send_request;
+    struct addressed_packet;
+    struct send_path;
 
     namespace frame {
         struct rtp_frame;
+        struct nal_unit;
+        struct nal_chunk;
     }
 
     namespace formats {
         class media;
     }
 
+    /**
+     * \brief Counters of the queue of received frames that wait for pull_frame()
+     *
+     * \details See RCC_DELIVERY_QUEUE_FRAMES and uvgrtp::media_stream::get_delivery_queue_stats()
+     */
+    struct delivery_queue_stats {
+        /** Frames waiting in the queue */
+        size_t queued_frames = 0;
+        /** Payload bytes of the frames waiting in the queue */
+        size_t queued_bytes = 0;
+        /** Frames dropped because the queue was full */
+        uint64_t dropped_frames = 0;
+        /** Payload bytes of the dropped frames */
+        uint64_t dropped_bytes = 0;
+    };
+
+    /**
+     * \brief One encoding of a frame given to uvgrtp::media_stream::push_simulcast_frames()
+     */
+    struct simulcast_frame {
+        /** The encoded frame, nullptr if the layer has no frame this time */
+        uint8_t *data = nullptr;
+        /** Length of the frame in bytes */
+        size_t len = 0;
+    };
+
+    /** Number of buckets in uvgrtp::stats_histogram */
+    constexpr size_t STATS_HISTOGRAM_BUCKETS = 32;
+
+    /**
+     * \brief Distribution of the values of one measurement of a stream
+     *
+     * \details The buckets grow in powers of two: bucket 0 counts the zero values and bucket
+     * i the values from 2^(i-1) to 2^i - 1. The last bucket also counts all the larger values
+     */
+    struct stats_histogram {
+        /** Number of values in each bucket */
+        uint64_t buckets[STATS_HISTOGRAM_BUCKETS] = {};
+        /** Number of values */
+        uint64_t count = 0;
+        /** Sum of the values, for the average */
+        uint64_t sum = 0;
+    };
+
+    /**
+     * \brief Counters of the data path of one stream, see uvgrtp::media_stream::get_stats()
+     *
+     * \details The counters start from zero when the stream is created and are never reset
+     */
+    struct stream_stats {
+        /** Frames given to push_frame() that were sent */
+        uint64_t sent_frames = 0;
+        /** Payload bytes of the sent frames */
+        uint64_t sent_bytes = 0;
+        /** RTP packets sent, including the repair packets of FEC */
+        uint64_t sent_packets = 0;
+        /** Frames that could not be sent */
+        uint64_t send_errors = 0;
+
+        /** RTP packets received from the remote participant */
+        uint64_t received_packets = 0;
+        /** Bytes of the received RTP packets, headers included */
+        uint64_t received_bytes = 0;
+        /** Frames given to the application */
+        uint64_t received_frames = 0;
+
+        /** Packets that were received twice */
+        uint64_t duplicate_packets = 0;
+        /** Packets of frames that had already been completed or dropped */
+        uint64_t late_packets = 0;
+        /** Incomplete frames dropped, including the late frames */
+        uint64_t dropped_frames = 0;
+        /** Frames dropped because they were not complete within RCC_PKT_MAX_DELAY */
+        uint64_t late_frames = 0;
+        /** Discardable frames left out at their first packet while the queue of pull_frame() was
+         * congested, see RCC_FRAME_MARKING_EXT_ID, and received frames of the layers above
+         * RCC_MAX_TEMPORAL_ID and RCC_MAX_LAYER_ID */
+        uint64_t skipped_frames = 0;
+        /** SRTP packets whose authentication tag did not match */
+        uint64_t srtp_auth_failures = 0;
+        /** SRTP packets dropped by the replay protection */
+        uint64_t srtp_replayed_packets = 0;
+        /** Times the receiving thread found the ring buffer full and had to wait. The ring
+         * buffer is shared by the streams multiplexed into one socket, see RCC_RING_BUFFER_SIZE */
+        uint64_t ring_full_events = 0;
+        /** Times the ring buffer filled past RCC_RING_BUFFER_WATERMARK */
+        uint64_t ring_watermark_events = 0;
+        /** Times the ring buffer was replaced with a larger one, see RCC_RING_BUFFER_MAX_SIZE */
+        uint64_t ring_resizes = 0;
+        /** Datagrams the kernel dropped because the receive buffer of the socket was full, see
+         * RCC_UDP_RCV_BUF_SIZE. Shared by the streams multiplexed into one socket. Only counted on Linux */
+        uint64_t kernel_drops = 0;
+        /** Incomplete frames dropped to keep within RCC_MEMORY_BUDGET or the budget of the context,
+         * also counted in dropped_frames */
+        uint64_t shed_frames = 0;
+        /** Second copies of packets dropped by the merge of the receive paths, see
+         * add_receive_path(). The copies are also counted in received_packets */
+        uint64_t merged_packets = 0;
+        /** Bytes the stream holds for the frames it is reassembling, see RCC_MEMORY_BUDGET */
+        uint64_t memory_usage = 0;
+
+        /** Time from the first received packet of a fragmented frame to its completion, in microseconds */
+        uvgrtp::stats_histogram reassembly_latency_us;
+        /** Frames waiting for pull_frame() when a received frame was added to the queue */
+        uvgrtp::stats_histogram queue_depth;
+        /** Packets given to the socket at once when a frame was sent */
+        uvgrtp::stats_histogram send_batch_size;
+        /** Time from when a packet was meant to leave to its kernel send timestamp, in microseconds.
+         * Only counted with RTP_TIMESTAMP_SEND of RCC_TIMESTAMPING */
+        uvgrtp::stats_histogram send_delay_us;
+
+        /** Time to find the stream of a received packet among the streams of the socket, in nanoseconds.
+         * The stage histograms are only counted for the packets and frames sampled with RCC_PROFILE_SAMPLING */
+        uvgrtp::stats_histogram stage_demux_ns;
+        /** Time to authenticate and decrypt a received SRTP packet, in nanoseconds */
+        uvgrtp::stats_histogram stage_srtp_ns;
+        /** Time to add a received packet to the frame it belongs to, in nanoseconds */
+        uvgrtp::stats_histogram stage_reassembly_ns;
+        /** Time to give a completed frame to the receive hook or the queue of pull_frame(), in nanoseconds */
+        uvgrtp::stats_histogram stage_delivery_ns;
+        /** Time from the start of a sent frame to when its packets are ready to be sent, in nanoseconds */
+        uvgrtp::stats_histogram stage_packetize_ns;
+        /** Time to send the packets of a frame to the destinations of add_destination(), in nanoseconds */
+        uvgrtp::stats_histogram stage_fanout_ns;
+        /** Time to give the packets of a frame to the socket, SRTP encryption included, in nanoseconds.
+         * Paced frames are not counted, since their time is mostly spent waiting */
+        uvgrtp::stats_histogram stage_send_ns;
+    };
+
     /**
      * \brief The media_stream is an entity which represents one RTP stream.
      *
@@ -136,6 +302,35 @@ namespace uvgrtp {
              */
             rtp_error_t push_frame(uint8_t *data, size_t data_len, int rtp_flags);
 
+            /**
+             * \brief Send data to remote participant and hand the buffer over to uvgRTP
+             *
+             * \details The frame is sent straight from "data" without copying it, like with
+             * push_frame(uint8_t *, size_t, int), but the application does not have to keep the buffer
+             * until the frame has been sent. uvgRTP calls "release" with "arg" and "data" once it no
+             * longer needs the buffer: before this call returns, or with ::RCE_ASYNC_SEND from the
+             * sender thread after the frame has been sent or the queue has been stopped. This lets the
+             * bindings of other languages give their buffers to uvgRTP without a copy.
+             *
+             * If this call fails, "release" is not called and the buffer stays with the application.
+             *
+             * \param data Pointer to data the that should be sent
+             * \param data_len Length of data
+             * \param rtp_flags Optional flags, see ::RTP_FLAGS for more details, except ::RTP_COPY
+             * \param arg Optional argument that is passed to "release", can be set to nullptr
+             * \param release Function that takes the buffer back
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If one of the parameters are invalid or ::RTP_COPY is given
+             * \retval  RTP_MEMORY_ERROR  If the data chunk is too large to be processed or the send queue is full
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the data to remote
+             * \retval  RTP_GENERIC_ERROR If an unspecified error occurred
+             */
+            rtp_error_t push_frame(uint8_t *data, size_t data_len, int rtp_flags,
+                void *arg, void (*release)(void *arg, uint8_t *data));
+
             /**
              * \brief Send data to remote participant with a custom timestamp
              *
@@ -290,6 +485,99 @@ namespace uvgrtp {
              */
             rtp_error_t push_frame(std::unique_ptr<uint8_t[]> data, size_t data_len, uint32_t ts, uint64_t ntp_ts, int rtp_flags);
 
+            /**
+             * \brief Send an H.264/H.265/H.266 frame whose NAL units have already been located
+             *
+             * \details Normally uvgRTP finds the NAL units of a frame by scanning it for start codes.
+             * If the application already knows where each NAL unit is, for example because the
+             * encoder reports it, it can give the locations with this function and uvgRTP skips the
+             * start code lookup. The NAL units are sent in the given order and aggregated or
+             * fragmented as usual.
+             *
+             * \param data Pointer to the frame, uvgRTP does not take ownership of the memory
+             * \param data_len Length of the frame
+             * \param nal_units Offsets and sizes of the NAL units in "data", see uvgrtp::frame::nal_unit
+             * \param rtp_flags Optional flags, see ::RTP_FLAGS for more details
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If one of the parameters are invalid or a NAL unit is outside the frame
+             * \retval  RTP_NOT_SUPPORTED If the media format of the stream is not H.264, H.265 or H.266
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the data to remote
+             * \retval  RTP_GENERIC_ERROR If an unspecified error occurred
+             */
+            rtp_error_t push_frame(uint8_t *data, size_t data_len, const std::vector<uvgrtp::frame::nal_unit>& nal_units, int rtp_flags);
+
+            /**
+             * \brief Send an H.264/H.265/H.266 frame whose NAL units have already been located,
+             * with a custom timestamp
+             *
+             * \details See the push_frame() overload without the timestamp for the NAL unit
+             * locations and push_frame(uint8_t *, size_t, uint32_t, int) for the timestamp.
+             *
+             * \param data Pointer to the frame, uvgRTP does not take ownership of the memory
+             * \param data_len Length of the frame
+             * \param nal_units Offsets and sizes of the NAL units in "data", see uvgrtp::frame::nal_unit
+             * \param ts 32-bit timestamp value for the data
+             * \param rtp_flags Optional flags, see ::RTP_FLAGS for more details
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If one of the parameters are invalid or a NAL unit is outside the frame
+             * \retval  RTP_NOT_SUPPORTED If the media format of the stream is not H.264, H.265 or H.266
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the data to remote
+             * \retval  RTP_GENERIC_ERROR If an unspecified error occurred
+             */
+            rtp_error_t push_frame(uint8_t *data, size_t data_len, const std::vector<uvgrtp::frame::nal_unit>& nal_units,
+                uint32_t ts, int rtp_flags);
+
+            /**
+             * \brief Send an uncompressed video frame given as pointers to its scan lines
+             *
+             * \details Only for streams of ::RTP_FORMAT_RAW_VIDEO. The packets are built straight
+             * from the lines, so the frame does not have to be contiguous in memory and the pixels
+             * are not copied, unless RTP_COPY is given. Each line must hold the number of bytes
+             * that ::RCC_VIDEO_WIDTH pixels take, and there must be ::RCC_VIDEO_HEIGHT lines.
+             * A contiguous frame can also be sent with push_frame().
+             *
+             * With ::RCE_ASYNC_SEND, the lines must stay valid until the completion hook is
+             * called with the first line.
+             *
+             * \param lines Pointers to the scan lines of the frame from top to bottom
+             * \param rtp_flags Optional flags, see ::RTP_FLAGS for more details
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If the lines do not match the video layout of the stream
+             * \retval  RTP_NOT_SUPPORTED If the media format of the stream is not ::RTP_FORMAT_RAW_VIDEO
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the data to remote
+             * \retval  RTP_GENERIC_ERROR If an unspecified error occurred
+             */
+            rtp_error_t push_scanlines(const std::vector<uint8_t *>& lines, int rtp_flags);
+
+            /**
+             * \brief Send an uncompressed video frame given as scan lines, with a custom timestamp
+             *
+             * \details See the push_scanlines() overload without the timestamp for the lines
+             * and push_frame(uint8_t *, size_t, uint32_t, int) for the timestamp.
+             *
+             * \param lines Pointers to the scan lines of the frame from top to bottom
+             * \param ts 32-bit timestamp value for the data
+             * \param rtp_flags Optional flags, see ::RTP_FLAGS for more details
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If the lines do not match the video layout of the stream
+             * \retval  RTP_NOT_SUPPORTED If the media format of the stream is not ::RTP_FORMAT_RAW_VIDEO
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the data to remote
+             * \retval  RTP_GENERIC_ERROR If an unspecified error occurred
+             */
+            rtp_error_t push_scanlines(const std::vector<uint8_t *>& lines, uint32_t ts, int rtp_flags);
+
             // Disabled for now
             //rtp_error_t push_user_packet(uint8_t* data, uint32_t len);
             //rtp_error_t install_user_receive_hook(void* arg, void (*hook)(void*, uint8_t* data, uint32_t len));
@@ -317,142 +605,1290 @@ namespace uvgrtp {
             uvgrtp::frame::rtp_frame *pull_frame(size_t timeout_ms);
 
             /**
-             * \brief Asynchronous way of getting frames
+             * \brief Poll many frames at once from the media stream object
              *
-             * \details Receive hook is an alternative to polling frames using uvgrtp::media_stream::pull_frame().
-             * Instead of application asking from uvgRTP if there are any new frames available, uvgRTP will notify
-             * the application when a frame has been received
+             * \details Waits for a frame for the specified time and then takes all the received
+             * frames, at most "max_frames", with one call. This saves the cost of one call per frame
+             * when a stream receives many small frames, for example audio. The frames are released
+             * with uvgrtp::frame::dealloc_frame() as usual
              *
-             * The hook should not be used for media processing as it will block the receiver from
-             * reading more frames. Instead, it should only be used as an interface between uvgRTP and
-             * the calling application where the frame hand-off happens.
+             * \param frames Array where the frames are written to
+             * \param max_frames How many frames fit in "frames"
+             * \param timeout_ms How long is a frame waited, in milliseconds
              *
-             * \param arg Optional argument that is passed to the hook when it is called, can be set to nullptr
-             * \param hook Function pointer to the receive hook that uvgRTP should call
+             * \return Number of frames written to "frames", 0 if no frame was received within the
+             * specified time limit or in case of an error
+             */
+            size_t pull_frames(uvgrtp::frame::rtp_frame **frames, size_t max_frames, size_t timeout_ms);
+
+            /**
+             * \brief Take the next received frame without blocking
+             *
+             * \details "handler" is called once with the next frame of the stream, from the
+             * processing thread of the reception, or from this call if a frame is already waiting.
+             * The pulls are completed in the order they were made, and the frames received while no
+             * pull is waiting are kept for the next pulls with the limits of RCC_DELIVERY_QUEUE_FRAMES.
+             * The frame is released with uvgrtp::frame::dealloc_frame() as usual. The pulls that
+             * wait when the stream is destroyed are completed with nullptr.
+             *
+             * The first call installs the receive hook of the stream, so the frames are no longer
+             * returned by pull_frame(). It fails if the application has already installed a receive
+             * hook or a batch receive hook. The reverse is not checked: installing a receive hook
+             * after the first call replaces the hook of the pulls, and the pulls that wait then are
+             * only completed with nullptr when the stream is destroyed.
+             * The handler must not block, since it holds up the reception of the socket
+             *
+             * \param handler Function that is given the frame
              *
              * \return RTP error code
              *
              * \retval RTP_OK On success
-             * \retval RTP_INVALID_VALUE If hook is nullptr */
-            rtp_error_t install_receive_hook(void *arg, void (*hook)(void *, uvgrtp::frame::rtp_frame *));
+             * \retval RTP_INVALID_VALUE If "handler" is empty or the stream has a receive hook of the application
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             */
+            rtp_error_t async_pull_frame(std::function<void(uvgrtp::frame::rtp_frame *)> handler);
 
             /**
-             * \brief Configure the media stream, see ::RTP_CTX_CONFIGURATION_FLAGS for more details
+             * \brief Send a frame and be told when it has been sent
+             *
+             * \details Same as push_frame(uint8_t *, size_t, int), but "done" is called with the
+             * result once the frame has been sent. With ::RCE_ASYNC_SEND, this call only queues the
+             * frame and "done" is called from the sender thread of the stream, which makes the
+             * stream usable from an event loop. "data" must stay valid until then unless RTP_COPY is
+             * given. Without ::RCE_ASYNC_SEND, the frame is sent and "done" called before this returns.
+             * "done" is not called if the frame could not be queued
+             *
+             * \param data Pointer to data the that should be sent
+             * \param data_len Length of data
+             * \param rtp_flags Optional flags, see ::RTP_FLAGS for more details
+             * \param done Function that is given the result of sending the frame
              *
              * \return RTP error code
              *
-             * \retval RTP_OK On success
-             * \retval RTP_INVALID_VALUE If the provided value is not valid for a given configuration flag
-             * \retval RTP_GENERIC_ERROR If setsockopt(2) failed
+             * \retval RTP_OK If the frame was queued or sent
+             * \retval RTP_INVALID_VALUE If "done" is empty or one of the parameters is invalid
+             * \retval RTP_MEMORY_ERROR If the send queue of ::RCE_ASYNC_SEND is full
+             * \retval RTP_SEND_ERROR If uvgRTP failed to send the data to remote
              */
-            rtp_error_t configure_ctx(int rcc_flag, ssize_t value);
+            rtp_error_t async_push_frame(uint8_t *data, size_t data_len, int rtp_flags,
+                std::function<void(rtp_error_t)> done);
 
+#ifdef UVGRTP_HAVE_COROUTINES
             /**
-             * \brief Get the values associated with configuration flags, see ::RTP_CTX_CONFIGURATION_FLAGS for more details
-             *
-             * \return Value of the configuration flag
+             * \brief Awaitable of async_pull_frame() for C++20 coroutines
              *
-             * \retval int value on success
-             * \retval -1 on error
+             * \details co_await gives the frame, nullptr if the stream was destroyed or has
+             * not been initialized. The coroutine is resumed on the processing thread of the
+             * reception unless the frame was already waiting
              */
-            int get_configuration_value(int rcc_flag);
+            class frame_awaitable {
+                public:
+                    explicit frame_awaitable(media_stream *stream) : stream_(stream) {}
 
-            /// \cond DO_NOT_DOCUMENT
+                    bool await_ready() const noexcept
+                    {
+                        return false;
+                    }
 
-            /* Get unique key of the media stream
-             * Used by session to index media streams */
-            uint32_t get_key() const;
+                    bool await_suspend(std::coroutine_handle<> handle)
+                    {
+                        handle_ = handle;
 
-            /// \endcond
+                        // whichever of the handler and this call comes second continues the coroutine
+                        if (stream_->async_pull_frame([this](uvgrtp::frame::rtp_frame *frame) {
+                                frame_ = frame;
+                                if (completed_.exchange(true))
+                                    handle_.resume();
+                            }) != RTP_OK)
+                            return false;
 
-            /**
-             * \brief Get pointer to the RTCP object of the media stream
-             *
-             * \details This object is used to control all RTCP-related functionality
-             * and RTCP documentation can be found from \ref uvgrtp::rtcp
-             *
-             * \return Pointer to RTCP object
-             *
-             * \retval uvgrtp::rtcp* If RTCP has been enabled (RCE_RTCP has been given to uvgrtp::session::create_stream())
-             * \retval nullptr        If RTCP has not been enabled
-             */
-            uvgrtp::rtcp *get_rtcp();
+                        return !completed_.exchange(true);
+                    }
+
+                    uvgrtp::frame::rtp_frame *await_resume() const noexcept
+                    {
+                        return frame_;
+                    }
+
+                private:
+                    media_stream *stream_;
+                    std::coroutine_handle<> handle_;
+                    uvgrtp::frame::rtp_frame *frame_ = nullptr;
+                    std::atomic<bool> completed_{false};
+            };
 
             /**
-             * \brief Get SSRC identifier. You can use the SSRC value for example to find the report 
-             * block belonging to this media_stream in RTCP sender/receiver report.
+             * \brief Awaitable of async_push_frame() for C++20 coroutines
              *
-             * \return SSRC value
+             * \details co_await gives the result of sending the frame. With ::RCE_ASYNC_SEND the
+             * coroutine is resumed on the sender thread of the stream
              */
-            uint32_t get_ssrc() const;
+            class send_awaitable {
+                public:
+                    send_awaitable(media_stream *stream, uint8_t *data, size_t data_len, int rtp_flags) :
+                        stream_(stream), data_(data), data_len_(data_len), rtp_flags_(rtp_flags) {}
 
-        private:
-            /* Initialize the connection by initializing the socket
-             * and binding ourselves to specified interface and creating
-             * an outgoing address */
-            rtp_error_t init_connection();
+                    bool await_ready() const noexcept
+                    {
+                        return false;
+                    }
 
-            /* Create the media object for the stream */
-            rtp_error_t create_media(rtp_format_t fmt);
+                    bool await_suspend(std::coroutine_handle<> handle)
+                    {
+                        handle_ = handle;
 
-            /* free all allocated resources */
-            rtp_error_t free_resources(rtp_error_t ret);
+                        rtp_error_t ret = stream_->async_push_frame(data_, data_len_, rtp_flags_, [this](rtp_error_t result) {
+                            result_ = result;
+                            if (completed_.exchange(true))
+                                handle_.resume();
+                        });
 
-            rtp_error_t init_srtp_with_zrtp(int rce_flags, int type, std::shared_ptr<uvgrtp::base_srtp> srtp,
-                                            std::shared_ptr<uvgrtp::zrtp> zrtp);
+                        if (ret != RTP_OK) {
+                            result_ = ret;
+                            return false;
+                        }
+                        return !completed_.exchange(true);
+                    }
 
-            rtp_error_t start_components();
+                    rtp_error_t await_resume() const noexcept
+                    {
+                        return result_;
+                    }
 
-            rtp_error_t install_packet_handlers();
+                private:
+                    media_stream *stream_;
+                    uint8_t *data_;
+                    size_t data_len_;
+                    int rtp_flags_;
+                    std::coroutine_handle<> handle_;
+                    rtp_error_t result_ = RTP_OK;
+                    std::atomic<bool> completed_{false};
+            };
 
-            uint32_t get_default_bandwidth_kbps(rtp_format_t fmt);
+            /**
+             * \brief Take the next received frame in a C++20 coroutine, see async_pull_frame(std::function<void(uvgrtp::frame::rtp_frame *)>)
+             *
+             * \return Awaitable that gives the frame
+             */
+            frame_awaitable async_pull_frame()
+            {
+                return frame_awaitable(this);
+            }
 
-            bool check_pull_preconditions();
-            rtp_error_t check_push_preconditions(int rtp_flags, bool smart_pointer);
+            /**
+             * \brief Send a frame in a C++20 coroutine, see async_push_frame(uint8_t *, size_t, int, std::function<void(rtp_error_t)>)
+             *
+             * \return Awaitable that gives the result of sending the frame
+             */
+            send_awaitable async_push_frame(uint8_t *data, size_t data_len, int rtp_flags)
+            {
+                return send_awaitable(this, data, data_len, rtp_flags);
+            }
+#else
+            /**
+             * \brief Take the next received frame with a future, see async_pull_frame(std::function<void(uvgrtp::frame::rtp_frame *)>)
+             *
+             * \return Future of the frame, nullptr if the stream was destroyed or has not been initialized
+             */
+            std::future<uvgrtp::frame::rtp_frame *> async_pull_frame()
+            {
+                auto promise = std::make_shared<std::promise<uvgrtp::frame::rtp_frame *>>();
+                std::future<uvgrtp::frame::rtp_frame *> future = promise->get_future();
 
-            inline uint8_t* copy_frame(uint8_t* original, size_t data_len);
+                if (async_pull_frame([promise](uvgrtp::frame::rtp_frame *frame) { promise->set_value(frame); }) != RTP_OK)
+                    promise->set_value(nullptr);
 
-            uint32_t key_;
+                return future;
+            }
 
-            std::shared_ptr<uvgrtp::srtp>   srtp_;
-            std::shared_ptr<uvgrtp::srtcp>  srtcp_;
-            std::shared_ptr<uvgrtp::socket> socket_;
-            std::shared_ptr<uvgrtp::rtp>    rtp_;
-            std::shared_ptr<uvgrtp::rtcp>   rtcp_;
-            std::shared_ptr<uvgrtp::zrtp>   zrtp_;
+            /**
+             * \brief Send a frame with a future, see async_push_frame(uint8_t *, size_t, int, std::function<void(rtp_error_t)>)
+             *
+             * \return Future of the result of sending the frame
+             */
+            std::future<rtp_error_t> async_push_frame(uint8_t *data, size_t data_len, int rtp_flags)
+            {
+                auto promise = std::make_shared<std::promise<rtp_error_t>>();
+                std::future<rtp_error_t> future = promise->get_future();
 
-            std::shared_ptr<uvgrtp::socketfactory> sfp_;
+                rtp_error_t ret = async_push_frame(data, data_len, rtp_flags, [promise](rtp_error_t result) {
+                    promise->set_value(result);
+                });
 
-            sockaddr_in remote_sockaddr_;
-            sockaddr_in6 remote_sockaddr_ip6_;
-            std::string remote_address_;
-            std::string local_address_;
-            uint16_t src_port_;
-            uint16_t dst_port_;
-            bool ipv6_;
-            rtp_format_t fmt_;
-            bool new_socket_;
+                if (ret != RTP_OK)
+                    promise->set_value(ret);
 
-            /* Media context config */
-            int rce_flags_ = 0;
+                return future;
+            }
+#endif
 
-            /* Has the media stream been initialized */
-            bool initialized_;
+            /**
+             * \brief Send the frames of the stream also to another receiver
+             *
+             * \details Each frame given to push_frame() is packetized once and the same packets are
+             * sent to the remote address of the stream and then to each added destination with one
+             * vector send per destination. A relay can this way send one feed to many receivers
+             * without a media stream and a push_frame() call per receiver. Adding a destination with
+             * the address and port of an earlier one replaces it.
+             *
+             * RTCP, congestion control, retransmissions and pacing only follow the remote participant
+             * of the stream. The packets of the destinations are sent right after the packets of the
+             * stream. A destination has the SSRC, sequence numbers and SRTP protection of the stream.
+             *
+             * \param address IP address of the destination, of the same family as the remote address of the stream
+             * \param port Port of the destination
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "address" is not a valid address of the family of the stream
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             * \retval RTP_NOT_SUPPORTED If the stream was created with RCE_RECEIVE_ONLY
+             */
+            rtp_error_t add_destination(const std::string& address, uint16_t port);
 
-            /* RTP packet reception flow. Dispatches packets to other components */
-            std::shared_ptr<uvgrtp::reception_flow> reception_flow_;
+            /**
+             * \brief Send the frames of the stream to another receiver as a stream of its own
+             *
+             * \details Same as add_destination() above, but the packets of the destination have the SSRC
+             * "ssrc" and sequence numbers that start from a random offset, so that several destinations
+             * look like independent streams to a receiver that gets more than one of them. With "key"
+             * and "salt", the packets of the destination are protected with an SRTP context of its own
+             * of the cipher suite of the stream, which requires ::RCE_SRTP. The context encrypts copies
+             * of the packets, so each destination with a key of its own costs a copy of the frame.
+             *
+             * An SRTP stream must give a key to a destination that has an SSRC of its own, because the
+             * packets of the stream cannot be changed once they have been protected.
+             *
+             * \param address IP address of the destination, of the same family as the remote address of the stream
+             * \param port Port of the destination
+             * \param ssrc SSRC of the packets of the destination, 0 keeps the SSRC and sequence numbers of the stream
+             * \param key SRTP master key of the destination or nullptr to send the packets protected for the stream
+             * \param salt SRTP master salt of the destination, nullptr if "key" is nullptr
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "address" is not valid, only one of "key" and "salt" is given or
+             * an SSRC is given to an SRTP stream without a key
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             * \retval RTP_NOT_SUPPORTED If the stream was created with RCE_RECEIVE_ONLY or a key is given to
+             * a stream without ::RCE_SRTP
+             */
+            rtp_error_t add_destination(const std::string& address, uint16_t port, uint32_t ssrc,
+                uint8_t *key, uint8_t *salt);
 
-            /* Media object associated with this media stream. */
-            std::unique_ptr<uvgrtp::formats::media> media_;
+            /**
+             * \brief Stop sending the frames of the stream to a destination of add_destination()
+             *
+             * \param address IP address of the destination
+             * \param port Port of the destination
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "address" is not valid
+             * \retval RTP_NOT_FOUND If the destination has not been added
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             */
+            rtp_error_t remove_destination(const std::string& address, uint16_t port);
 
-            /* Thread that keeps the holepunched connection open for unidirectional streams */
-            std::unique_ptr<uvgrtp::holepuncher> holepuncher_;
+            /**
+             * \brief Send only some of the scalable layers of the stream to a destination of add_destination()
+             *
+             * \details The frames of an H.265 or H.266 stream whose temporal ID is above "max_temporal_id"
+             * or whose nuh_layer_id is above "max_layer_id" are not sent to the destination. The IDs
+             * of a frame are those of its first slice. The stream itself and the other destinations
+             * still get all layers, see ::RCC_MAX_TEMPORAL_ID and ::RCC_MAX_LAYER_ID to leave the layers
+             * out of the whole stream. The sequence numbers of the destination move back over the frames
+             * left out, so the receiver does not take them for losses. Adding the destination again
+             * sends all layers to it.
+             *
+             * With ::RCE_SRTP, the destination must have an SRTP key of its own, because the
+             * sequence numbers of the packets protected for the stream cannot be changed.
+             *
+             * \param address IP address of the destination
+             * \param port Port of the destination
+             * \param max_temporal_id Highest temporal ID sent, from 0 to 7
+             * \param max_layer_id Highest nuh_layer_id sent, from 0 to 63
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "address" is not valid, an ID is out of range or the destination
+             * of an SRTP stream has no key of its own
+             * \retval RTP_NOT_FOUND If the destination has not been added
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             * \retval RTP_NOT_SUPPORTED If the format of the stream is not H.265 or H.266
+             */
+            rtp_error_t set_destination_layers(const std::string& address, uint16_t port,
+                uint8_t max_temporal_id, uint8_t max_layer_id);
 
-            std::string cname_;
+            /**
+             * \brief Send the packets of the stream over several network paths at once
+             *
+             * \details Adds a path that sends from a socket bound to "local_address", f.ex. the address
+             * of a second uplink, to "remote_address" and "remote_port". The socket of the stream is the
+             * first path. The packets of each frame are dealt to the paths by smooth weighted round robin,
+             * so a path with twice the weight of another sends twice its packets, and each path sends its
+             * share with one vector send. The throughput of the stream can so exceed that of any one link.
+             *
+             * With ::RCC_TWCC_EXT_ID, the share of a path adapts to the feedback of the receiver:
+             * it shrinks when more than 10% of the packets of the path are lost or their delay grows
+             * 50 ms over the lowest delay of the path, and grows back to the weight of the path when
+             * the path recovers. Each path keeps at least 5% of the weights, so that its feedback
+             * tells when it has recovered. A path that fails to send is left that least share. The
+             * delay trend of the bitrate estimate follows the first path. Without the extension the
+             * paths keep their weights.
+             *
+             * The packets of the paths arrive out of order, so the receiver should set
+             * ::RCC_REORDER_WINDOW_MS. The frames of a multipath stream are not paced and RTCP and
+             * retransmissions stay on the socket of the stream. The paths send over UDP also with the
+             * memory transport.
+             *
+             * \param local_address IP address of the local interface the path sends from, or an empty
+             * string to set the weight of the socket of the stream
+             * \param remote_address IP address the path sends to, or an empty string for the remote address of the stream
+             * \param remote_port Port the path sends to, or 0 for the remote port of the stream
+             * \param weight Relative share of the packets sent over the path, the socket of the stream has weight 1
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If an address is not of the family of the stream, the weight is 0,
+             * the local address already has a path or the stream has 16 paths already
+             * \retval RTP_BIND_ERROR If the socket of the path cannot be bound to "local_address"
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             * \retval RTP_NOT_SUPPORTED If the stream was created with RCE_RECEIVE_ONLY or has no remote address
+             */
+            rtp_error_t add_path(const std::string& local_address, const std::string& remote_address = "",
+                uint16_t remote_port = 0, uint32_t weight = 1);
 
-            ssize_t fps_numerator_ = 30;
+            /**
+             * \brief Stop sending over a path of add_path()
+             *
+             * \details The stream sends only from its own socket again once the last added path is removed
+             *
+             * \param local_address The local address the path was added with
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_NOT_FOUND If there is no path from "local_address"
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             */
+            rtp_error_t remove_path(const std::string& local_address);
+
+            /**
+             * \brief Receive the stream also over another network
+             *
+             * \details For seamless protection switching in the manner of SMPTE ST 2022-7, the sender
+             * sends the same RTP packets over two networks, f.ex. with add_destination(). This binds a
+             * socket to "local_address" and "local_port" on the second network and merges the packets
+             * that arrive on it with those of the socket of the stream. The first copy of each packet
+             * goes on to the depacketizer and the later copies are dropped before any other processing,
+             * so a packet lost on one network is covered by the other and each frame is reassembled
+             * once. The copies are told apart by their sequence numbers within ::RCC_REDUNDANCY_WINDOW,
+             * which is set to 4096 packets if it is not set.
+             *
+             * The receive paths feed the socket of the stream, so all the streams multiplexed into
+             * the socket receive the packets of the paths. The paths are read by the receiving thread
+             * of the socket, so they cannot be used with the I/O engine of the context or with receive
+             * shards. The copies are merged before SRTP, and the paths receive over UDP also with the
+             * memory transport. At most 4 paths can be added to a socket.
+             *
+             * \param local_address IP address of the local interface on the other network
+             * \param local_port Port the sender sends the copies to
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If the address is not of the family of the stream, the address
+             * and port already have a path or the socket has 4 paths already
+             * \retval RTP_BIND_ERROR If the socket of the path cannot be bound
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             * \retval RTP_NOT_SUPPORTED If the stream was created with RCE_SEND_ONLY, or its socket is
+             * served by the I/O engine or has receive shards
+             */
+            rtp_error_t add_receive_path(const std::string& local_address, uint16_t local_port);
+
+            /**
+             * \brief Stop receiving over a path of add_receive_path()
+             *
+             * \details The merge of ::RCC_REDUNDANCY_WINDOW keeps dropping the copies of the packets
+             * until it is set to 0
+             *
+             * \param local_address The local address the path was added with
+             * \param local_port The local port the path was added with
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_NOT_FOUND If there is no path on "local_address" and "local_port"
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             */
+            rtp_error_t remove_receive_path(const std::string& local_address, uint16_t local_port);
+
+            /**
+             * \brief Get the latest parameter sets received by an H26x stream
+             *
+             * \details The stream keeps the latest VPS, SPS and PPS it has received, so that the
+             * application does not have to look at the NAL units of every frame to give them to a
+             * decoder that starts in the middle of the stream. The sets are written in the order
+             * VPS, SPS and PPS, each with a four-byte start code. H.264 has no VPS. See also
+             * ::RCC_H26X_PARAMETER_SETS to have them prepended to the key frame that follows a join or a loss.
+             *
+             * \param parameter_sets The parameter sets in Annex B format
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_NOT_FOUND If no parameter set has been received yet
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             * \retval RTP_NOT_SUPPORTED If the format of the stream is not H.264, H.265 or H.266
+             */
+            rtp_error_t get_parameter_sets(std::vector<uint8_t>& parameter_sets);
+
+            /**
+             * \brief Forward the received RTP packets of the stream to the remote participant of another stream
+             *
+             * \details The packets are forwarded as they are received, without depacketizing them or
+             * copying their payload, which lets a selective forwarding unit relay a stream with the cost
+             * of a vector send per batch of packets. Each forwarded packet gets the SSRC of "target" and a
+             * sequence number and a timestamp that continue from those of "target"; the rest of the packet
+             * is sent straight from the reception buffer of this stream from the socket of "target" to its
+             * remote address. The packets processed together are sent to a target with one vector send.
+             *
+             * While the stream has forward targets, its packets are only forwarded and not returned as
+             * frames unless a hook of install_forward_hook() says so. "target" should not send frames of
+             * its own while it forwards, and the RTCP of both streams only covers their own packets.
+             * Adding a target again restarts its sequence numbers and timestamps from those of "target".
+             *
+             * Forwarding SRTP streams is not supported, because the authentication tag covers the
+             * rewritten header.
+             *
+             * \param target An initialized stream that is not ::RCE_RECEIVE_ONLY
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "target" is nullptr or this stream
+             * \retval RTP_NOT_INITIALIZED If this stream or "target" has not been initialized
+             * \retval RTP_NOT_SUPPORTED If this stream is ::RCE_SEND_ONLY, "target" is ::RCE_RECEIVE_ONLY
+             * or either of the streams uses ::RCE_SRTP
+             */
+            rtp_error_t add_forward_target(uvgrtp::media_stream *target);
+
+            /**
+             * \brief Stop forwarding the packets of the stream to a target of add_forward_target()
+             *
+             * \details Once the last target has been removed, the stream returns its frames again
+             * unless a forward hook has been installed
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_NOT_FOUND If "target" has not been added
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             */
+            rtp_error_t remove_forward_target(uvgrtp::media_stream *target);
+
+            /**
+             * \brief Inspect and rewrite the received RTP packets before they are forwarded
+             *
+             * \details The hook is called by the thread that processes the packets of the stream with
+             * each received RTP packet before anything else is done with it. The hook may rewrite the
+             * packet in place, for example to change the payload type or a header extension, but not
+             * change its size. The hook returns the ::RTP_FORWARD flags of what is done with the packet:
+             * ::RTP_FORWARD_SEND forwards it to the targets of add_forward_target(), ::RTP_FORWARD_DELIVER
+             * gives it to the depacketization of the stream, which returns its frames as usual, and
+             * ::RTP_FORWARD_DROP drops it. Without a hook the packets are forwarded only.
+             *
+             * The hook must not block. With uvgrtp::context::set_receive_shards() it may be called from several threads
+             * at the same time.
+             *
+             * \param arg Argument given to the hook
+             * \param hook The hook or nullptr to remove the hook
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             * \retval RTP_NOT_SUPPORTED If the stream is ::RCE_SEND_ONLY or uses ::RCE_SRTP
+             */
+            rtp_error_t install_forward_hook(void *arg, int (*hook)(void *arg, uint8_t *packet, size_t size));
+
+            /**
+             * \brief Receive the stream from a multicast group
+             *
+             * \details The socket of the stream joins "group" on the default interface. With a "source",
+             * the join is source-specific (IGMPv3 and MLDv2) and only the packets that "source" sends to
+             * the group are received; the sources of a group can be joined one by one.
+             *
+             * Many streams that share a socket, see ::RCC_REMOTE_SSRC, can each join their own group and
+             * are received with the same socket and thread. Once a stream of the socket has joined a group,
+             * the packets sent to a group are given to the stream that joined it whatever their SSRC,
+             * and the packets sent to groups that no stream has joined are dropped. The destinations of
+             * the packets are only known on Linux; elsewhere the packets are given to the streams by their
+             * SSRC as usual.
+             *
+             * \param group The IPv4 or IPv6 multicast address, of the family of the stream
+             * \param source The address of the sender or an empty string for any sender
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "group" or "source" is not valid or another stream of the socket has joined "group"
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             * \retval RTP_NOT_SUPPORTED If the stream is ::RCE_SEND_ONLY
+             * \retval RTP_GENERIC_ERROR If the system refuses the join
+             */
+            rtp_error_t join_multicast_group(const std::string& group, const std::string& source = "");
+
+            /**
+             * \brief Leave a group or a source of a group joined with join_multicast_group()
+             *
+             * \details The stream stops receiving the packets of the group once it has left all
+             * the sources of the group it joined
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "group" or "source" is not valid
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             * \retval RTP_GENERIC_ERROR If the stream has not joined the group or the source
+             */
+            rtp_error_t leave_multicast_group(const std::string& group, const std::string& source = "");
+
+            /**
+             * \brief Get the counters of the queue of received frames that wait for pull_frame()
+             *
+             * \details The frames are dropped from the queue when the application pulls them
+             * more slowly than they are received, see RCC_DELIVERY_QUEUE_FRAMES. The queue is
+             * shared by the streams multiplexed into one socket.
+             *
+             * \return Counters of the queue
+             */
+            uvgrtp::delivery_queue_stats get_delivery_queue_stats() const;
+
+            /**
+             * \brief Get the counters of the data path of the stream
+             *
+             * \details The counters tell how many packets and frames the stream has sent and
+             * received and why packets and frames have been dropped. They are updated with
+             * relaxed atomic operations as the packets are processed, so the values of a
+             * snapshot may be a few packets apart from each other.
+             *
+             * \return Counters of the stream
+             */
+            uvgrtp::stream_stats get_stats() const;
+
+            /**
+             * \brief Write the datagrams of the stream to a pcap file
+             *
+             * \details The datagrams sent and received through the socket of the stream are written
+             * to the file with their send and receive times, see RCC_TIMESTAMPING. The file has
+             * nanosecond timestamps and raw IP packets with the addresses and ports of the socket and
+             * can be opened with tools like Wireshark or replayed with replay_capture(). The datagrams
+             * are written as they are on the wire, so SRTP packets are encrypted. The streams that
+             * share the socket are captured together.
+             *
+             * A thread of the capture writes the file, so capturing does not slow down the sending
+             * and receiving. If the thread falls behind, datagrams are left out of the file. At most
+             * 2048 bytes of each datagram are kept.
+             *
+             * \param path The file to create, replaced if it exists
+             * \param directions Which datagrams are written, RTP_CAPTURE flags combined with bitwise OR
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "directions" is not valid
+             * \retval RTP_GENERIC_ERROR If the file cannot be created
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             */
+            rtp_error_t start_capture(const std::string& path, int directions);
+
+            /**
+             * \brief Stop the capture of start_capture() and close its file
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_NOT_INITIALIZED If there is no capture running
+             */
+            rtp_error_t stop_capture();
+
+            /**
+             * \brief Write the received frames of the stream to a file
+             *
+             * \details The payload of each complete frame is appended to "path" and an entry for it
+             * to the index file "path".idx, which starts with the 8 bytes "UVGRIDX1" followed by
+             * one 24-byte entry per frame: the offset of the frame in the file and its receive
+             * time in nanoseconds as 64-bit integers, then its size and RTP timestamp as 32-bit
+             * integers, all in the byte order of the system.
+             *
+             * The frames are queued to a thread of the recording that writes the files, so
+             * recording does not slow down the reception. Without ::RTP_RECORD_DELIVER the frames
+             * are not given to the application, and the recorder writes the frames as they are and
+             * releases them. If the thread falls behind, the frames that do not fit into its queue
+             * are given to the application instead of recorded.
+             *
+             * \param path The file to create, replaced if it exists
+             * \param flags RTP_RECORD flags combined with bitwise OR
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If "flags" is not valid
+             * \retval RTP_INITIALIZED If the stream is already being recorded
+             * \retval RTP_GENERIC_ERROR If the files cannot be created
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized or does not receive
+             */
+            rtp_error_t start_recording(const std::string& path, int flags);
+
+            /**
+             * \brief Write the queued frames of start_recording() and close its files
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_NOT_INITIALIZED If there is no recording running
+             */
+            rtp_error_t stop_recording();
+
+            /**
+             * \brief Give the datagrams of a pcap file to the stream as if they had been received
+             *
+             * \details The UDP datagrams of the file that were sent to the local port of the stream
+             * are processed as the received packets are, so the depacketization and SRTP can be
+             * measured with real traffic without a network. The file can be one written by
+             * start_capture() or a capture of tools like tcpdump. The socket is not read during
+             * the replay.
+             *
+             * \param path The pcap file to replay
+             * \param speed How many times faster than they were captured the datagrams are given, 1 keeps
+             * the original timing and 0 gives them as fast as they are processed
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK When all datagrams of the file have been given to the stream
+             * \retval RTP_INVALID_VALUE If "speed" is negative or the file is not a valid pcap file
+             * \retval RTP_GENERIC_ERROR If the file cannot be opened
+             * \retval RTP_NOT_SUPPORTED If the file has an unknown link type or the packets of the stream are read by the I/O engine
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized or does not receive
+             * \retval RTP_INTERRUPTED If the stream was destroyed during the replay
+             */
+            rtp_error_t replay_capture(const std::string& path, double speed);
+
+            /**
+             * \brief Send the access units of an H.264, H.265 or H.266 Annex-B file at the frame rate of the stream
+             *
+             * \details The file is mapped into memory and split into access units once, and the
+             * streams of the process that play the same file share the mapping. Each access unit
+             * is sent straight from the mapping with the NAL unit locations found when the file was
+             * opened, so the frames are neither copied nor scanned for start codes again. The
+             * access units are sent at the rate of ::RCC_FPS_NUMERATOR and ::RCC_FPS_DENOMINATOR,
+             * by the frame rate control of ::RCE_FRAME_RATE if it is enabled. The call returns when
+             * the file has been sent "loops" times or stop_file() is called.
+             *
+             * \param path The Annex-B file to send
+             * \param loops How many times the file is sent, 0 sends it until stop_file() is called
+             * \param rtp_flags Optional flags, see ::RTP_FLAGS for more details, except ::RTP_COPY
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK When the file has been sent "loops" times
+             * \retval RTP_INVALID_VALUE If ::RTP_COPY is given or the file has no access units
+             * \retval RTP_GENERIC_ERROR If the file cannot be opened
+             * \retval RTP_NOT_SUPPORTED If the format of the stream is not H.264, H.265 or H.266, or ::RCE_ASYNC_SEND is enabled
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             * \retval RTP_INTERRUPTED If stop_file() was called
+             * \retval RTP_SEND_ERROR If sending an access unit failed
+             */
+            rtp_error_t play_file(const std::string& path, size_t loops, int rtp_flags);
+
+            /**
+             * \brief Stop the play_file() call running on another thread
+             */
+            void stop_file();
+
+            /**
+             * \brief Asynchronous way of getting frames
+             *
+             * \details Receive hook is an alternative to polling frames using uvgrtp::media_stream::pull_frame().
+             * Instead of application asking from uvgRTP if there are any new frames available, uvgRTP will notify
+             * the application when a frame has been received
+             *
+             * The hook should not be used for media processing as it will block the receiver from
+             * reading more frames. Instead, it should only be used as an interface between uvgRTP and
+             * the calling application where the frame hand-off happens.
+             *
+             * The hook replaces the one of async_pull_frame(), so the pulls get no more frames.
+             *
+             * \param arg Optional argument that is passed to the hook when it is called, can be set to nullptr
+             * \param hook Function pointer to the receive hook that uvgRTP should call
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is nullptr */
+            rtp_error_t install_receive_hook(void *arg, void (*hook)(void *, uvgrtp::frame::rtp_frame *));
+
+            /**
+             * \brief Asynchronous way of getting frames
+             *
+             * \details Same as the hook with a function pointer above. The hook is stored with the
+             * other per-stream handlers, so a lambda can capture the state it needs directly
+             *
+             * \param hook C++ function that uvgRTP should call with each received frame
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is empty */
+            rtp_error_t install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame *)> hook);
+
+            /**
+             * \brief Asynchronous way of getting frames with a typed context
+             *
+             * \details Same as the hook with a function pointer above, but "context" is passed to the
+             * hook without a cast through void *
+             *
+             * \param context Object that is passed to the hook when it is called
+             * \param hook Function that uvgRTP should call with the context and each received frame
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is nullptr */
+            template <typename T>
+            rtp_error_t install_receive_hook(T *context, void (*hook)(T *, uvgrtp::frame::rtp_frame *))
+            {
+                if (!hook)
+                    return RTP_INVALID_VALUE;
+
+                return install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame *)>(
+                    [context, hook](uvgrtp::frame::rtp_frame *frame) { hook(context, frame); }));
+            }
+
+            /**
+             * \brief Asynchronous way of getting many frames at once
+             *
+             * \details Same as uvgrtp::media_stream::install_receive_hook(), but the frames that uvgRTP
+             * completes while processing one burst of received packets are given to the hook in one call.
+             * The hook takes the ownership of each frame in "frames", but not of the array itself, which
+             * is only valid during the call. Replaces a receive hook installed earlier
+             *
+             * \param arg Optional argument that is passed to the hook when it is called, can be set to nullptr
+             * \param hook Function pointer to the receive hook that uvgRTP should call with the frames and their count
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is nullptr */
+            rtp_error_t install_receive_batch_hook(void *arg, void (*hook)(void *, uvgrtp::frame::rtp_frame **, size_t));
+
+            /**
+             * \brief Asynchronous way of getting many frames at once
+             *
+             * \details Same as the batch hook with a function pointer above
+             *
+             * \param hook C++ function that uvgRTP should call with the frames and their count
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is empty */
+            rtp_error_t install_receive_batch_hook(std::function<void(uvgrtp::frame::rtp_frame **, size_t)> hook);
+
+            /**
+             * \brief Get fragmented NAL units piece by piece while they are being received
+             *
+             * \details When an H.264/H.265/H.266 NAL unit is fragmented into several RTP packets,
+             * it is normally returned only after its last fragment has arrived. With this hook,
+             * uvgRTP also calls "hook" every time the beginning of the NAL unit that has arrived
+             * without gaps grows, so that a decoder can start parsing the slice before the NAL
+             * unit is complete. The chunks of one NAL unit are given in order, start from the NAL
+             * unit header and do not include the start code. The complete NAL unit is still
+             * returned through pull_frame() or the receive hook as usual.
+             *
+             * The chunks are collected with the flat reassembly of ::RCE_H26X_FLAT_REASSEMBLY,
+             * which installing the hook enables. The hook is not called if the stream has
+             * ::RCE_H26X_DEPENDENCY_ENFORCEMENT, because the NAL unit might still be discarded.
+             *
+             * The hook is called from the receiving thread and it should return quickly. The data
+             * of a chunk is only valid until the hook returns.
+             *
+             * \param arg Optional argument that is passed to the hook when it is called, can be set to nullptr
+             * \param hook Function pointer to the chunk hook that uvgRTP should call
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is nullptr
+             * \retval RTP_NOT_SUPPORTED If the media format of the stream is not H.264, H.265 or H.266 */
+            rtp_error_t install_nal_chunk_hook(void *arg, void (*hook)(void *, const uvgrtp::frame::nal_chunk *));
+
+            /**
+             * \brief Receive uncompressed video frames directly to buffers of the application
+             *
+             * \details Only for streams of ::RTP_FORMAT_RAW_VIDEO. When the first packet of a frame
+             * arrives, uvgRTP calls "hook" with the RTP timestamp and the size of the frame, and
+             * the pixels of every packet are then copied straight to their line and offset in the
+             * returned buffer. The frame given to pull_frame() or the receive hook has this buffer
+             * as its payload and uvgrtp::frame::dealloc_frame() does not free it, so the
+             * application may reuse it once it is done with the frame. If the hook returns
+             * nullptr, uvgRTP uses a buffer of its own for that frame.
+             *
+             * If a frame is not completed within ::RCC_PKT_MAX_DELAY, it is dropped and its buffer
+             * is used for the next frame without calling the hook. The hook is called from the
+             * receiving thread and it should return quickly.
+             *
+             * \param arg Optional argument that is passed to the hook when it is called, can be set to nullptr
+             * \param hook Function pointer to the hook that gives the frame buffers
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is nullptr
+             * \retval RTP_NOT_SUPPORTED If the media format of the stream is not ::RTP_FORMAT_RAW_VIDEO */
+            rtp_error_t install_video_buffer_hook(void *arg, uint8_t *(*hook)(void *, uint32_t timestamp, size_t size));
+
+            /**
+             * \brief Get the target bitrate of the congestion control of the stream
+             *
+             * \details With ::RCC_TWCC_EXT_ID, the receiver reports the arrival times of the packets
+             * and uvgRTP estimates from them how fast the stream can be sent without building up
+             * queues in the network. The hook is called with the new target in bits per second
+             * whenever it changes by at least one percent, and the application should set the
+             * bitrate of its encoder accordingly. The hook is called from the thread that receives
+             * RTCP and it should return quickly.
+             *
+             * \param arg Optional argument that is passed to the hook when it is called, can be set to nullptr
+             * \param hook Function pointer to the hook that receives the target bitrate
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is nullptr */
+            rtp_error_t install_bitrate_hook(void *arg, void (*hook)(void *, uint32_t bitrate));
+
+            /**
+             * \brief Set the audio level of the frames that are sent after this call
+             *
+             * \details The level is sent in the audio level header extension element of RFC 6464,
+             * see ::RCC_AUDIO_LEVEL_EXT_ID. Until this is called, the frames are sent with the level
+             * of silence, 127.
+             *
+             * \param level The level of the audio in -dBov, from 0 to 127
+             * \param voice_activity Whether the audio contains speech
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If level is larger than 127 */
+            rtp_error_t set_audio_level(uint8_t level, bool voice_activity);
+
+            /**
+             * \brief Set the media identification of the stream in a BUNDLE group
+             *
+             * \details The MID, and the RID if it is not empty, are sent in the header extension elements of
+             * ::RCC_MID_EXT_ID and ::RCC_RID_EXT_ID. The packets received on the socket of the stream
+             * with the same MID, and RID, are given to this stream whatever their SSRC, see ::RCC_MID_EXT_ID.
+             * The IDs of the elements are set before or after this.
+             *
+             * \param mid The MID of the media description of the stream, at most 16 bytes
+             * \param rid The RtpStreamId of the stream, at most 16 bytes, empty for none
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If mid is empty, one of the values is too long, or another stream
+             * of the socket has the same MID and RID
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized */
+            rtp_error_t set_mid(const std::string& mid, const std::string& rid = "");
+
+            /**
+             * \brief Send another simulcast encoding of the stream with an SSRC of its own
+             *
+             * \details The layer shares the socket, the remote address, the pacing and RTCP of the
+             * stream. It has its own SSRC, sequence numbers and packetizer, and its packets carry the
+             * MID of set_mid() and "rid" if ::RCC_MID_EXT_ID and ::RCC_RID_EXT_ID are set. The RTCP
+             * reports of the stream have a sender report for each layer. The layer takes the payload
+             * type, clock rate, frame rate, pacing and header extensions the stream has when it is
+             * added, so the layers are added after configuring the stream. The layers are numbered from
+             * 1 in the order they are added, layer 0 being the stream itself, and their frames are sent
+             * with push_simulcast_frames().
+             *
+             * \param rid The RtpStreamId of the layer, at most 16 bytes
+             * \param ssrc SSRC of the layer, 0 for a random one
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If rid is empty, too long or already in use by the stream
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             * \retval RTP_NOT_SUPPORTED If the stream was created with RCE_RECEIVE_ONLY or ::RCE_SRTP, or it
+             * sends raw video */
+            rtp_error_t add_simulcast_layer(const std::string& rid, uint32_t ssrc = 0);
+
+            /**
+             * \brief Send the encodings of one frame of the stream and its simulcast layers
+             *
+             * \details The frame "i" of "frames" is sent with the layer "i" of add_simulcast_layer(). All
+             * encodings are packetized first and with ::RCE_PACE_FRAGMENT_SENDING their packets are then
+             * paced side by side, so the layers share one schedule instead of following each other.
+             * With ::RCE_ASYNC_SEND, the frames are queued as one and the buffers must stay valid until
+             * they have been sent.
+             *
+             * \param frames The encodings of the frame, at most one more than there are layers
+             * \param rtp_flags Flags of the frames, RTP_COPY is not supported
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If there are more frames than layers, or rtp_flags has RTP_COPY
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized
+             * \retval RTP_SEND_ERROR If sending a frame failed */
+            rtp_error_t push_simulcast_frames(const std::vector<uvgrtp::simulcast_frame>& frames, int rtp_flags);
+
+            /**
+             * \brief Take the RTP timestamps from a media clock of the application
+             *
+             * \details The frames pushed without a timestamp are stamped with the time of "clock" and
+             * the sender reports of RTCP give the NTP time and the RTP timestamp read from it at the
+             * same moment, so no conversion from the wall clock is done. The streams that share a
+             * clock, such as the audio and video of one capture, can then be synchronized exactly by
+             * the receiver. The frames pushed with a timestamp keep it. See uvgrtp::media_clock.
+             *
+             * \param clock The media clock, nullptr returns to the wall clock
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_NOT_INITIALIZED If the stream has not been initialized */
+            rtp_error_t set_media_clock(std::shared_ptr<uvgrtp::media_clock> clock);
+
+            /**
+             * \brief Install a hook that is called when the receiver asks for a key frame
+             *
+             * \details The receiver asks for a key frame with an RTCP Picture Loss Indication or
+             * Full Intra Request when it has lost a frame, see ::RCC_KEY_FRAME_REQUEST. The application
+             * should then make its encoder produce an IDR frame. The hook is called from the thread
+             * that receives RTCP and it should return quickly. Requires ::RCE_RTCP.
+             *
+             * \param arg Optional argument that is passed to the hook when it is called, can be set to nullptr
+             * \param hook Function pointer to the hook
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is nullptr or RCE_RTCP has not been given */
+            rtp_error_t install_key_frame_request_hook(void *arg, void (*hook)(void *));
+
+            /**
+             * \brief Install a completion hook for frames sent with ::RCE_ASYNC_SEND
+             *
+             * \details With ::RCE_ASYNC_SEND, push_frame() only queues the frame and the hook is
+             * called from the sender thread of the stream once the frame has been sent, with
+             * the result of sending it. For a frame given as a raw pointer without RTP_COPY,
+             * "data" is the pointer given to push_frame() and the application may reuse or free
+             * the buffer when the hook is called. For frames whose memory uvgRTP owns, that is
+             * smart pointers and frames copied with RTP_COPY, uvgRTP frees the memory itself and
+             * "data" is nullptr. Frames that are still queued when the stream is destroyed are
+             * completed with RTP_INTERRUPTED.
+             *
+             * If no timestamp is given to push_frame(), the timestamp of a queued frame is
+             * taken when it is sent.
+             *
+             * \param arg Optional argument that is passed to the hook when it is called, can be set to nullptr
+             * \param hook Function pointer to the completion hook that uvgRTP should call
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is nullptr
+             * \retval RTP_NOT_SUPPORTED If the stream was not created with ::RCE_ASYNC_SEND */
+            rtp_error_t install_send_complete_hook(void *arg, void (*hook)(void *, uint8_t *data, rtp_error_t result));
+
+            /**
+             * \brief Configure the media stream, see ::RTP_CTX_CONFIGURATION_FLAGS for more details
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If the provided value is not valid for a given configuration flag
+             * \retval RTP_GENERIC_ERROR If setsockopt(2) failed
+             */
+            rtp_error_t configure_ctx(int rcc_flag, ssize_t value);
+
+            /**
+             * \brief Get the values associated with configuration flags, see ::RTP_CTX_CONFIGURATION_FLAGS for more details
+             *
+             * \return Value of the configuration flag
+             *
+             * \retval int value on success
+             * \retval -1 on error
+             */
+            int get_configuration_value(int rcc_flag);
+
+            /// \cond DO_NOT_DOCUMENT
+
+            /* Get unique key of the media stream
+             * Used by session to index media streams */
+            uint32_t get_key() const;
+
+            /* Called by uvgrtp::context::push_audio_frames(): build the frame "data" as one RTP packet
+             * without a transaction, with the RTP timestamp "ts" if it is not nullptr, run the packet
+             * handlers of the socket for it and give the socket and the packet with its destination
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the frame has to be sent with push_frame()
+             * Return the error of push_frame() otherwise */
+            rtp_error_t prepare_audio_packet(uint8_t *data, size_t data_len, const uint32_t *ts,
+                uvgrtp::socket *& socket, uvgrtp::addressed_packet& packet);
+
+            /* The packet of prepare_audio_packet() has been sent with the result "ret" */
+            void audio_packet_sent(rtp_error_t ret, size_t data_len);
+
+            /// \endcond
+
+            /**
+             * \brief Get pointer to the RTCP object of the media stream
+             *
+             * \details This object is used to control all RTCP-related functionality
+             * and RTCP documentation can be found from \ref uvgrtp::rtcp
+             *
+             * \return Pointer to RTCP object
+             *
+             * \retval uvgrtp::rtcp* If RTCP has been enabled (RCE_RTCP has been given to uvgrtp::session::create_stream())
+             * \retval nullptr        If RTCP has not been enabled
+             */
+            uvgrtp::rtcp *get_rtcp();
+
+            /**
+             * \brief Get SSRC identifier. You can use the SSRC value for example to find the report 
+             * block belonging to this media_stream in RTCP sender/receiver report.
+             *
+             * \return SSRC value
+             */
+            uint32_t get_ssrc() const;
+
+        private:
+            /* Initialize the connection by initializing the socket
+             * and binding ourselves to specified interface and creating
+             * an outgoing address */
+            rtp_error_t init_connection();
+
+            /* Create the media object for the stream */
+            rtp_error_t create_media(rtp_format_t fmt);
+
+            /* free all allocated resources */
+            rtp_error_t free_resources(rtp_error_t ret);
+
+            rtp_error_t init_srtp_with_zrtp(int rce_flags, int type, std::shared_ptr<uvgrtp::base_srtp> srtp,
+                                            std::shared_ptr<uvgrtp::zrtp> zrtp);
+
+            rtp_error_t start_components();
+
+            rtp_error_t install_packet_handlers();
+
+            /* Build the pipeline of the received RTP packets once both the media object and
+             * the packet handlers exist, see uvgrtp::pipeline */
+            void install_pipeline();
+
+            /* Send the header extension element "element" with the ID "value" of "rcc_flag" and
+             * resize the payload of the packets to make room for it, see RCC_ABS_SEND_TIME_EXT_ID */
+            rtp_error_t set_header_extension(int rcc_flag, int element, ssize_t value);
+
+            /* Give the received packets of the MID and RID of set_mid() to this stream */
+            rtp_error_t update_mid_route();
+
+            /* Send the frames of push_simulcast_frames() */
+            rtp_error_t send_simulcast(uvgrtp::send_request& request);
+
+            uint32_t get_default_bandwidth_kbps(rtp_format_t fmt);
+
+            bool check_pull_preconditions();
+            rtp_error_t check_push_preconditions(int rtp_flags, bool smart_pointer);
+
+            /* Describe a frame given to push_frame(). A raw frame is copied here if RTP_COPY is set */
+            uvgrtp::send_request raw_frame_request(uint8_t *data, size_t data_len, int rtp_flags);
+            uvgrtp::send_request owned_frame_request(std::unique_ptr<uint8_t[]> data, size_t data_len, int rtp_flags);
+            uvgrtp::send_request scanline_request(const std::vector<uint8_t *>& lines, int rtp_flags);
+
+            /* Parse the address of a destination of add_destination() to "addr" or "addr6"
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "address" is not an address of the family of the stream */
+            rtp_error_t destination_address(const std::string& address, uint16_t port, sockaddr_in& addr,
+                sockaddr_in6& addr6);
+
+            /* Create the forwarder and install it into the reception flow if it does not exist yet */
+            rtp_error_t create_forwarder();
+
+            /* Parse the multicast address "group" of the family of the stream into "address" as
+             * socket::recv_destination() gives it
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "group" is not a multicast address */
+            rtp_error_t multicast_group_address(const std::string& group, in6_addr& address) const;
+
+            /* Send the frame now or give it to the send queue if RCE_ASYNC_SEND is set */
+            rtp_error_t queue_frame(uvgrtp::send_request&& request);
+
+            /* Packetize and send the frame, called from the sender thread with RCE_ASYNC_SEND */
+            rtp_error_t send_frame(uvgrtp::send_request& request);
+
+            uint32_t key_;
+
+            std::shared_ptr<uvgrtp::srtp>   srtp_;
+            std::shared_ptr<uvgrtp::srtcp>  srtcp_;
+            std::shared_ptr<uvgrtp::socket> socket_;
+            std::shared_ptr<uvgrtp::rtp>    rtp_;
+            std::shared_ptr<uvgrtp::rtcp>   rtcp_;
+            std::shared_ptr<uvgrtp::zrtp>   zrtp_;
+
+            std::shared_ptr<uvgrtp::socketfactory> sfp_;
+
+            sockaddr_in remote_sockaddr_;
+            sockaddr_in6 remote_sockaddr_ip6_;
+            std::string remote_address_;
+            std::string local_address_;
+            uint16_t src_port_;
+            uint16_t dst_port_;
+            bool ipv6_;
+            rtp_format_t fmt_;
+            bool new_socket_;
+
+            /* Media context config */
+            int rce_flags_ = 0;
+
+            /* Has the media stream been initialized */
+            bool initialized_;
+
+            /* Have the RTP packet handlers been installed, which waits for ZRTP if it is used */
+            bool packet_handlers_installed_;
+
+            /* RTP packet reception flow. Dispatches packets to other components */
+            std::shared_ptr<uvgrtp::reception_flow> reception_flow_;
+
+            /* Media object associated with this media stream. */
+            std::unique_ptr<uvgrtp::formats::media> media_;
+
+            /* Forwards the received packets to the streams of add_forward_target(), created with the first target or hook */
+            std::shared_ptr<uvgrtp::forwarder> forwarder_;
+
+            // see start_recording()
+            std::shared_ptr<uvgrtp::recorder> recorder_;
+
+            /* The groups of join_multicast_group() and their joined sources, an empty source for any source */
+            std::unordered_map<std::string, std::unordered_set<std::string>> joined_groups_;
+
+            /* Thread that keeps the holepunched connection open for unidirectional streams */
+            std::unique_ptr<uvgrtp::holepuncher> holepuncher_;
+
+            /* Frames waiting for the sender thread if RCE_ASYNC_SEND is set */
+            std::unique_ptr<uvgrtp::send_queue> send_queue_;
+
+            /* The buffers of the frames copied with RTP_COPY */
+            std::shared_ptr<uvgrtp::copy_pool> copy_pool_;
+
+            /* The pulls of async_pull_frame(), which installs the receive hook that feeds them once */
+            std::shared_ptr<uvgrtp::async_pulls> async_pulls_;
+            std::atomic<bool> async_pulling_;
+
+            // set by stop_file()
+            std::atomic<bool> stop_file_;
+
+            std::string cname_;
+
+            ssize_t fps_numerator_ = 30;
             ssize_t fps_denominator_ = 1;
+            size_t pacing_burst_ = 1;
+            ssize_t pacing_spin_us_ = 0;
+            int send_priority_ = 0;
+            size_t send_weight_ = 1;
+            size_t aggregation_deadline_us_ = 0;
+            size_t reorder_window_ms_ = 0;
+            size_t redundancy_window_ = 0;
+
+            // the MID and RID of set_mid()
+            std::string mid_;
+            std::string rid_;
+
+            /* The paths of add_path(), the socket of the stream first. Replaced as a whole, since the
+             * frame queue keeps the list it was given */
+            std::shared_ptr<const std::vector<uvgrtp::send_path>> paths_;
+
+            /* The sockets of add_receive_path() by their local address and port */
+            std::map<std::pair<std::string, uint16_t>, std::shared_ptr<uvgrtp::socket>> receive_paths_;
+
+            /* The layers of add_simulcast_layer(), each with the RTP state and packetizer of its SSRC */
+            struct simulcast_layer {
+                std::string rid;
+                std::shared_ptr<std::atomic<std::uint32_t>> ssrc;
+                std::shared_ptr<uvgrtp::rtp> rtp;
+                std::unique_ptr<uvgrtp::formats::media> media;
+            };
+            std::vector<simulcast_layer> simulcast_layers_;
+
+            // the MTU of RCC_MTU_SIZE and the path MTU of RCC_PATH_MTU_DISCOVERY
+            size_t mtu_size_;
+            size_t path_mtu_max_ = 0;
+            std::shared_ptr<uvgrtp::path_mtu> path_mtu_;
+
+            // the size limit of the GOP cache, see RCC_GOP_CACHE_SIZE
+            size_t gop_cache_size_ = 0;
+
+            size_t video_width_ = 0;
+            size_t video_height_ = 0;
+            size_t video_pgroup_size_ = 5;
+            size_t video_pgroup_pixels_ = 2;
             uint32_t bandwidth_ = 0;
+
+            /* Transport-wide congestion control, see RCC_TWCC_EXT_ID */
+            std::shared_ptr<uvgrtp::twcc_sender> twcc_;
+            uint8_t twcc_ext_id_ = 0;
+            uint32_t twcc_start_kbps_ = 1000;
+            uint32_t twcc_max_kbps_ = 0;
+
+            /* The highest temporal layer and layer sent and received, see RCC_MAX_TEMPORAL_ID and RCC_MAX_LAYER_ID */
+            uint8_t max_temporal_id_ = 7;
+            uint8_t max_layer_id_ = 63;
+
+            // RCC_H26X_PARAMETER_SETS
+            bool h26x_parameter_sets_ = false;
+
+            // RCC_H26X_MAX_FRAME_SIZE
+            size_t h26x_max_frame_size_ = 0;
+            int receive_priority_ = 0;
+
+            /* Selective retransmission, see RCC_NACK */
+            std::shared_ptr<uvgrtp::packet_history> packet_history_;
+            bool nack_ = false;
+            size_t nack_history_size_;
+
+            /* Forward error correction, see RCC_FEC_PAYLOAD_TYPE */
+            uint8_t fec_payload_type_ = 0;
+            int fec_overhead_ = 10;
+
+            /* Key frame requests, see RCC_KEY_FRAME_REQUEST */
+            int key_frame_request_ = 0;
+            size_t key_frame_interval_ms_ = 500;
+
+            /* Receive-side jitter buffer, see RCC_JITTER_BUFFER */
+            std::unique_ptr<uvgrtp::jitter_buffer> jitter_buffer_;
+            size_t jitter_buffer_max_delay_ms_ = 0;
+            size_t jitter_buffer_min_delay_ms_;
+
+            /* Counters of the data path, see get_stats() */
+            std::shared_ptr<uvgrtp::stream_metrics> metrics_;
+
+            /* The memory held for the received frames, charged to the budget of the context too, see RCC_MEMORY_BUDGET */
+            std::shared_ptr<uvgrtp::memory_budget> memory_budget_;
+
             std::shared_ptr<std::atomic<std::uint32_t>> ssrc_;
             std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc_;
 
@@ -13,6 +13,7 @@
 
 #include <bitset>
 #include <map>
+#include <set>
 #include <thread>
 #include <vector>
 #include <functional>
@@ -28,6 +29,10 @@ namespace uvgrtp {
     class socket;
     class socketfactory;
     class rtcp_reader;
+    class twcc_receiver;
+    class twcc_sender;
+    class packet_history;
+    class xr_history;
 
     typedef std::vector<std::pair<size_t, uint8_t*>> buf_vec; // also defined in socket.hh
 
@@ -44,33 +49,37 @@ namespace uvgrtp {
         bool sent_rtp_packet = false; // since last report
     };
 
+    /* The counters updated for each received RTP packet are atomic so that the receiving thread
+     * can update them without participants_mutex_. The receiving thread is their only writer,
+     * the report generator only reads them, apart from clearing received_rtp_packet */
     struct receiver_statistics {
         /* receiver stats */
-        uint32_t received_pkts = 0;  /* Number of packets received */
-        uint32_t lost_pkts = 0;   /* Number of dropped RTP packets */
-        uint32_t received_bytes = 0; /* Number of bytes received excluding RTP Header */
-        bool received_rtp_packet = false; // since last report
+        std::atomic<uint32_t> received_pkts{0};  /* Number of packets received */
+        std::atomic<uint32_t> lost_pkts{0};   /* Number of dropped RTP packets */
+        std::atomic<uint32_t> received_bytes{0}; /* Number of bytes received excluding RTP Header */
+        std::atomic<bool> received_rtp_packet{false}; // since last report
 
         uint32_t expected_pkts = 0;     /* Number of expected packets */
         uint32_t received_prior = 0;    /* Number of received packets in last report */
         uint32_t expected_prior = 0;    /* Number of expected packets in last report */
 
-        double jitter = 0;            /* The estimation of jitter (see RFC 3550 A.8) */
+        std::atomic<double> jitter{0};  /* The estimation of jitter (see RFC 3550 A.8) */
         uint32_t transit = 0;        /* TODO: */
 
 
         /* Receiver clock related stuff */
         uint64_t initial_ntp = 0;    /* Wallclock reading when the first RTP packet was received */
+        uint64_t initial_recv_time = 0; /* rtp_frame::recv_time of the first RTP packet received */
         uint32_t initial_rtp = 0;    /* RTP timestamp of the first RTP packet received */
         uint32_t clock_rate = 0;     /* Rate of the clock (used for jitter calculations) */
 
         uint32_t lsr = 0;                /* Middle 32 bits of the 64-bit NTP timestamp of previous SR */
         uvgrtp::clock::hrc::hrc_t sr_ts; /* When the last SR was received (used to calculate delay) */
 
-        uint16_t max_seq = 0;        /* Highest sequence number received */
-        uint32_t base_seq = 0;       /* First sequence number received */
+        std::atomic<uint16_t> max_seq{0};   /* Highest sequence number received */
+        std::atomic<uint32_t> base_seq{0};  /* First sequence number received */
         uint32_t bad_seq = 0;        /* TODO:  */
-        uint16_t cycles = 0;         /* Number of sequence cycles */
+        std::atomic<uint16_t> cycles{0};    /* Number of sequence cycles */
     };
 
     struct rtcp_participant {
@@ -85,6 +94,9 @@ namespace uvgrtp {
         uvgrtp::frame::rtcp_receiver_report *rr_frame = nullptr;
         uvgrtp::frame::rtcp_sdes_packet     *sdes_frame = nullptr;
         uvgrtp::frame::rtcp_app_packet      *app_frame = nullptr;
+
+        /* The receive history of the RTCP XR blocks, only if they have been enabled, see RCC_RTCP_XR */
+        std::shared_ptr<uvgrtp::xr_history> xr;
     };
 
     struct rtcp_app_packet {
@@ -228,11 +240,8 @@ namespace uvgrtp {
              * Return RTP_SSRC_COLLISION if our new SSRC has collided and we need to generate new SSRC */
             rtp_error_t reset_rtcp_state(uint32_t ssrc);
 
-            /* Update various session statistics */
-            void update_session_statistics(const uvgrtp::frame::rtp_frame *frame);
-
             /* Getter for interval_ms_, which is calculated by set_session_bandwidth
-             * Be aware that this interval is frequently re-calculated in rtcp_runner() */
+             * Be aware that this interval is frequently re-calculated in send_periodic_report() */
             uint32_t get_rtcp_interval_ms() const;
 
             /* Set total bandwidth for this session, called at the start 
@@ -371,6 +380,60 @@ namespace uvgrtp {
              */
             rtp_error_t install_app_hook(std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_app_packet>)> app_handler);
 
+            /**
+             * \brief Install an RTCP SDES packet hook that does not take the packet
+             *
+             * \details This function is called when an RTCP SDES packet is received. Unlike with
+             * install_sdes_hook(), the items are not copied: their data points to the received
+             * packet and the packet is only valid until the hook returns, so nothing is allocated
+             * for the items. Copy what you need to keep. Replaces the other SDES hooks
+             *
+             * \param sdes_handler C++ function pointer to the hook
+             *
+             * \retval RTP_OK on success
+             * \retval RTP_INVALID_VALUE If hook is nullptr
+             */
+            rtp_error_t install_sdes_view_hook(std::function<void(const uvgrtp::frame::rtcp_sdes_packet&)> sdes_handler);
+
+            /**
+             * \brief Install an RTCP APP packet hook that does not take the packet
+             *
+             * \details This function is called when an RTCP APP packet is received. Unlike with
+             * install_app_hook(), the payload is not copied: it points to the received packet and
+             * is only valid until the hook returns. Copy what you need to keep. Replaces the other
+             * APP hooks
+             *
+             * \param app_handler C++ function pointer to the hook
+             *
+             * \retval RTP_OK on success
+             * \retval RTP_INVALID_VALUE If hook is nullptr
+             */
+            rtp_error_t install_app_view_hook(std::function<void(const uvgrtp::frame::rtcp_app_packet&)> app_handler);
+
+            /**
+             * \brief Install an RTCP XR packet hook
+             *
+             * \details This function is called when an RTCP extended report (RFC 3611) is received.
+             * The packet is only valid until the hook returns. Which blocks are sent by this stream
+             * is set with RCC_RTCP_XR
+             *
+             * \param xr_handler C++ function pointer to the hook
+             *
+             * \retval RTP_OK on success
+             * \retval RTP_INVALID_VALUE If hook is nullptr
+             */
+            rtp_error_t install_xr_hook(std::function<void(const uvgrtp::frame::rtcp_xr_packet&)> xr_handler);
+
+            /**
+             * \brief Get the round-trip time to the remote measured with RTCP XR
+             *
+             * \details The round-trip time is measured from the DLRR blocks the remote sends
+             * as answers to the receiver reference time blocks of RTP_RTCP_XR_RRT
+             *
+             * \return The round-trip time in milliseconds or a negative value if it is not known
+             */
+            double get_round_trip_time_ms() const;
+
             /// \cond DO_NOT_DOCUMENT
             // These have been replaced by functions with unique_ptr in them
             rtp_error_t install_sender_hook(std::function<void(std::shared_ptr<uvgrtp::frame::rtcp_sender_report>)> sr_handler);
@@ -413,6 +476,10 @@ namespace uvgrtp {
             /* Update RTCP-related sender statistics */
             rtp_error_t update_sender_stats(size_t pkt_size);
 
+            /* Report the packets of the simulcast layer "ssrc", which are built by "rtp", with a sender
+             * report of its own after the report of the stream, see media_stream::add_simulcast_layer() */
+            void add_simulcast_source(std::shared_ptr<std::atomic<std::uint32_t>> ssrc, std::shared_ptr<uvgrtp::rtp> rtp);
+
             void set_socket(std::shared_ptr<uvgrtp::socket> socket);
 
             /* Update RTCP-related receiver statistics from RTP packets */
@@ -425,14 +492,59 @@ namespace uvgrtp {
             size_t rtcp_length_in_bytes(uint16_t length);
 
             void set_payload_size(size_t mtu_size);
+
+            /* Send transport-wide congestion control feedback of the packets carrying the header
+             * extension element "ext_id" and give the feedback received from the remote to "sender".
+             * A zero "ext_id" disables the feedback, see RCC_TWCC_EXT_ID */
+            void set_twcc(uint8_t ext_id, std::shared_ptr<uvgrtp::twcc_sender> sender);
+
+            /* Resend the packets that the remote asks for with Generic NACK from "history",
+             * a null "history" ignores the NACKs, see RCC_NACK */
+            void set_packet_history(std::shared_ptr<uvgrtp::packet_history> history);
+
+            /* Ask the sender "media_ssrc" to resend the packets "seqs" with Generic NACK
+             *
+             * Return RTP_OK on success
+             * Return RTP_MEMORY_ERROR or RTP_SEND_ERROR if sending failed */
+            rtp_error_t send_nack(uint32_t media_ssrc, const std::vector<uint16_t>& seqs);
+
+            /* Ask the sender "media_ssrc" for a key frame with PLI, or with FIR if "fir" is true
+             *
+             * Return RTP_OK on success
+             * Return RTP_MEMORY_ERROR or RTP_SEND_ERROR if sending failed */
+            rtp_error_t send_key_frame_request(uint32_t media_ssrc, bool fir);
+
+            /* The hook is called from the thread that receives RTCP when the remote asks for a
+             * key frame of this stream with PLI or with a new FIR */
+            void install_key_frame_request_hook(void *arg, void (*hook)(void *));
+
+            /* Return the interarrival jitter of the participant "ssrc" in milliseconds
+             * or a negative value if no packets have been received from it */
+            double get_jitter_ms(uint32_t ssrc);
+
+            /* When the feedback messages of send_fb_packet() are sent, see RTP_RTCP_FEEDBACK */
+            void set_feedback_mode(int mode);
+            int get_feedback_mode() const;
+
+            /* Which RTCP XR blocks the reports have, see RTP_RTCP_XR */
+            void set_xr_blocks(int blocks);
+            int get_xr_blocks() const;
             /// \endcond
 
         private:
 
             rtp_error_t set_sdes_items(const std::vector<uvgrtp::frame::rtcp_sdes_item>& items);
 
+            /* Set the CNAME of our SDES packets, which goes first in the items unless set_sdes_items()
+             * gave a CNAME of its own */
+            void set_cname(const std::string& cname);
+
+            /* Take the CNAME of the context if none has been set, so that every SDES packet has one
+             * even if start() was not called. Called with packet_mutex_ held, except in start() */
+            void ensure_cname();
+
             uint32_t size_of_ready_app_packets() const;
-            uint32_t size_of_apps_from_hook(std::vector< std::shared_ptr<rtcp_app_packet>> packets) const;
+            uint32_t size_of_apps_from_hook(const std::vector< std::shared_ptr<rtcp_app_packet>>& packets) const;
 
             uint32_t size_of_compound_packet(uint16_t reports,
                 bool sr_packet, bool rr_packet, bool sdes_packet, uint32_t app_size, bool bye_packet) const;
@@ -460,14 +572,70 @@ namespace uvgrtp {
                 uvgrtp::frame::rtcp_header& header);
             rtp_error_t handle_fb_packet(uint8_t* buffer, size_t& read_ptr, size_t packet_end,
                 uvgrtp::frame::rtcp_header& header);
+            rtp_error_t handle_xr_packet(uint8_t* buffer, size_t& read_ptr, size_t packet_end,
+                uvgrtp::frame::rtcp_header& header);
+
+            /* Fill the XR blocks of the next report and return the size of the XR packet,
+             * or 0 if the report has no XR. Called with packet_mutex_ held after reported_ is known */
+            uint32_t prepare_xr_packet();
+            bool construct_xr_packet(uint8_t* frame, size_t& ptr, uint32_t xr_size);
+
+            /* Called by the RTCP scheduler of the context. Send the periodic report, remove the
+             * participants that have timed out and return the randomized interval in milliseconds
+             * until the next report */
+            uint32_t send_periodic_report();
+
+            /* Add the periodic reports of this session to the RTCP scheduler of the context */
+            void schedule_reports();
+
+            /* Called by the RTCP scheduler every TWCC_FEEDBACK_INTERVAL_MS. Send the transport-wide
+             * congestion control feedback of the packets received since the previous call */
+            uint32_t send_twcc_feedback();
+
+            /* Add the feedback to the RTCP scheduler if it is enabled and not scheduled yet */
+            void schedule_twcc_feedback();
+
+            /* Size of the SRTCP index and authentication tag, which are counted in the length
+             * of the last packet of a compound packet */
+            size_t srtcp_trailer_size() const;
+
+            /* Send a feedback message with the feedback control information "fci" of "fci_len" bytes
+             *
+             * Return RTP_OK on success
+             * Return RTP_MEMORY_ERROR or RTP_SEND_ERROR if sending failed */
+            rtp_error_t send_fb_packet(uvgrtp::frame::RTCP_FRAME_TYPE type, uint8_t fmt, uint32_t media_ssrc,
+                const uint8_t *fci, size_t fci_len);
+
+            /* Queue the feedback message for an early packet or the next regular report following the
+             * rules of RFC 4585 section 3.5.2, see RTP_RTCP_FEEDBACK_EARLY */
+            rtp_error_t queue_fb_packet(uvgrtp::frame::RTCP_FRAME_TYPE type, uint8_t fmt, uint32_t media_ssrc,
+                const uint8_t *fci, size_t fci_len);
 
-            static void rtcp_runner(rtcp *rtcp);
+            /* Send the queued feedback messages in an early packet */
+            rtp_error_t send_early_feedback();
+
+            /* Build the compound report and send it, an early report does not end the interval
+             * in which one early packet may be sent */
+            rtp_error_t send_compound_report(bool early);
+
+            /* Call the hook of install_key_frame_request_hook() */
+            void key_frame_requested();
 
             /* when we start the RTCP instance, we don't know what the SSRC of the remote is
              * when an RTP packet is received, we must check if we've already received a packet
              * from this sender and if not, create new entry to receiver_stats_ map */
             bool is_participant(uint32_t ssrc) const;
 
+            /* Find the participant of a received RTP packet. Each receiving thread keeps the
+             * participant of its previous packet so that participants_mutex_ is taken again only
+             * when the packet is from another SSRC or participants_ has changed. The statistics of
+             * the participant are updated without locking, which relies on the packets of an SSRC
+             * being processed by one thread at a time. The shards of a port keep to this, since the
+             * kernel gives the packets of a source address always to the same shard.
+             *
+             * Return nullptr if "ssrc" is not a participant */
+            rtcp_participant *find_rx_participant(uint32_t ssrc);
+
             //TODO: Resolve collision??
             /* When we receive an RTP or RTCP packet, we need to check the source address and see if it's
              * the same address where we've received packets before.
@@ -487,13 +655,20 @@ namespace uvgrtp {
             /* Initialize the RTP Sequence related stuff of peer
              * This function assumes that the peer already exists in the participants_ map */
             rtp_error_t init_participant_seq(uint32_t ssrc, uint16_t base_seq);
+            void init_participant_seq(rtcp_participant *participant, uint16_t base_seq);
 
-            /* Update the SSRC's sequence related data in participants_ map
+            /* Update the sequence related data of the participant. Called by the receiving thread
+             * without participants_mutex_
              *
              * Return RTP_OK if the received packet was OK
+             * Return RTP_NOT_READY if the participant is still on probation
              * Return RTP_GENERIC_ERROR if it wasn't and
              * packet-related statistics should not be updated */
-            rtp_error_t update_participant_seq(uint32_t ssrc, uint16_t seq);
+            rtp_error_t update_participant_seq(rtcp_participant *participant, uint16_t seq);
+
+            /* Update various session statistics. Called by the receiving thread
+             * without participants_mutex_ */
+            void update_session_statistics(rtcp_participant *participant, const uvgrtp::frame::rtp_frame *frame);
 
             /* Update the RTCP bandwidth variables
              *
@@ -517,6 +692,14 @@ namespace uvgrtp {
             *  updates any other infos */
             rtp_error_t remove_timeout_ssrc(uint32_t ssrc);
 
+            /* Restart the silence of "ssrc" for the timeouts, or start it when "ssrc" is new */
+            void heard_from(uint32_t ssrc);
+
+            /* Stop following the silence of "ssrc" */
+            void forget_source(uint32_t ssrc);
+
+            static uint64_t steady_ms();
+
             /* Because struct statistics contains uvgRTP clock object we cannot
              * zero it out without compiler complaining about it so all the fields
              * must be set to zero manually */
@@ -527,7 +710,10 @@ namespace uvgrtp {
             /* Takes ownership of the frame */
             rtp_error_t send_rtcp_packet_to_participants(uint8_t* frame, uint32_t frame_size, bool encrypt);
 
-            void free_participant(std::unique_ptr<rtcp_participant> participant);
+            /* Does not take ownership of the frame, the compound reports are sent from "report_buffer_" */
+            rtp_error_t send_rtcp_packet(uint8_t* frame, uint32_t frame_size, bool encrypt);
+
+            void free_participant(std::shared_ptr<rtcp_participant> participant);
 
             void cleanup_participants();
 
@@ -612,7 +798,15 @@ namespace uvgrtp {
             /* The first value of RTP timestamp (aka t = 0) */
             uint32_t rtp_ts_start_;
 
-            std::map<uint32_t, std::unique_ptr<rtcp_participant>> participants_;
+            /* The participants are shared so that the receiving thread can keep using the
+             * participant it has found even if it is removed from the map at the same time */
+            std::map<uint32_t, std::shared_ptr<rtcp_participant>> participants_;
+
+            /* Increased whenever participants_ changes, see find_rx_participant() */
+            std::atomic<uint64_t> participants_version_;
+
+            /* Identifies this instance in the participants cached by the receiving threads */
+            const uint64_t instance_;
             uint8_t num_receivers_; // maximum is 32 at the moment (5 bits)
             bool ipv6_;
 
@@ -621,14 +815,48 @@ namespace uvgrtp {
             sockaddr_in6 socket_address_ipv6_;
 
 
-            /* Map for keeping track of sources for timeouts
-            *  First number is the sources ssrc
-            *  Second number is how many milliseconds it has been silent*/
-            std::map<uint32_t, uint32_t> ms_since_last_rep_;
+            /* When each source was last heard of, in milliseconds of the steady clock. The same
+             * pairs are kept ordered by the time in silence_order_ so that the timed out sources are
+             * found without going through all of them */
+            std::map<uint32_t, uint64_t> last_heard_ms_;
+            std::set<std::pair<uint64_t, uint32_t>> silence_order_;
+            std::mutex timeouts_mutex_;
+
+            /* The SSRCs of the participants whose received_rtp_packet has turned true since the
+             * last report, so that a report only goes through the participants it has blocks for */
+            std::vector<uint32_t> dirty_ssrcs_;
+            std::mutex dirty_mutex_;
+
+            /* A participant of a report and its values that are written under participants_mutex_ */
+            struct report_source {
+                uint32_t ssrc;
+                std::shared_ptr<rtcp_participant> participant;
+                uint32_t lsr;
+                uvgrtp::clock::hrc::hrc_t sr_ts;
+            };
+
+            /* Reused by each report, guarded by packet_mutex_ */
+            std::vector<uint32_t> report_ssrcs_;
+            std::vector<report_source> reported_;
 
             /* statistics for RTCP Sender and Receiver Reports */
             struct sender_statistics our_stats;
 
+            /* The simulcast layers of add_simulcast_source(), replaced as a whole with std::atomic_store
+             * because the sending thread counts their packets. "simulcast_reported_" has the layers
+             * that have sent since the previous report, guarded by packet_mutex_ */
+            struct simulcast_source {
+                std::shared_ptr<std::atomic<std::uint32_t>> ssrc;
+                std::shared_ptr<uvgrtp::rtp> rtp;
+                std::shared_ptr<sender_statistics> stats;
+            };
+            std::shared_ptr<const std::vector<simulcast_source>> simulcast_sources_;
+            std::atomic<bool> has_simulcast_{false};
+            std::vector<const simulcast_source *> simulcast_reported_;
+
+            /* The NTP timestamp and the matching RTP timestamp of a sender report of "rtp" */
+            void sender_report_times(uvgrtp::rtp& rtp, uint32_t clock_rate, uint64_t& ntp_ts, uint32_t& rtp_ts);
+
             /* If we expect frames from remote but haven't received anything from remote yet,
              * the participant resides in this vector until he's moved to participants_ */
             std::vector<std::unique_ptr<rtcp_participant>> initial_participants_;
@@ -650,6 +878,13 @@ namespace uvgrtp {
             std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_app_packet>)>      app_hook_u_;
             std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_fb_packet>)>       fb_hook_u_;
 
+            /* The view hooks and the frames they are given, reused for each packet under
+             * sdes_mutex_ and app_mutex_ */
+            std::function<void(const uvgrtp::frame::rtcp_sdes_packet&)> sdes_view_hook_;
+            std::function<void(const uvgrtp::frame::rtcp_app_packet&)>  app_view_hook_;
+            uvgrtp::frame::rtcp_sdes_packet sdes_view_;
+            uvgrtp::frame::rtcp_app_packet app_view_;
+
             std::mutex sr_mutex_;
             std::mutex rr_mutex_;
             std::mutex sdes_mutex_;
@@ -658,16 +893,67 @@ namespace uvgrtp {
             mutable std::mutex participants_mutex_;
 			std::mutex send_app_mutex_;
 
-            std::unique_ptr<std::thread> report_generator_;
+            /* Timer of the periodic reports in the RTCP scheduler and the
+             * interval until the report it fires next */
+            uint64_t report_timer_;
+            uint32_t report_interval_ms_;
+
+            /* RFC 4585 feedback timing, see set_feedback_mode(). The queued feedback messages,
+             * whether an early packet may be sent and the time of the next regular report are
+             * guarded by packet_mutex_. "early_timer_" is a one-shot timer of the early packet
+             * while it is waiting */
+            std::atomic<int> feedback_mode_;
+            std::vector<uint8_t> pending_fb_;
+            bool allow_early_;
+            std::chrono::steady_clock::time_point next_report_;
+            std::atomic<uint64_t> early_timer_;
+
+            /* Transport-wide congestion control, see set_twcc(). The sender is guarded by fb_mutex_
+             * and the feedback timer by twcc_mutex_ */
+            std::shared_ptr<uvgrtp::twcc_receiver> twcc_receiver_;
+            std::shared_ptr<uvgrtp::twcc_sender> twcc_sender_;
+            std::atomic<uint8_t> twcc_ext_id_;
+            std::mutex twcc_mutex_;
+            uint64_t twcc_timer_;
+
+            /* RTCP XR, see set_xr_blocks(). The received RRTs waiting for DLRR, the hook and the
+             * packet given to it are guarded by xr_mutex_, the blocks of the next report by packet_mutex_ */
+            struct xr_rrt {
+                uint32_t lrr;
+                uvgrtp::clock::hrc::hrc_t received;
+            };
+
+            struct xr_source_blocks {
+                uvgrtp::frame::rtcp_xr_loss_rle loss_rle;
+                uvgrtp::frame::rtcp_xr_stat_summary stat_summary;
+                uvgrtp::frame::rtcp_xr_voip_metrics voip_metrics;
+            };
+
+            std::atomic<int> xr_blocks_;
+            std::atomic<double> xr_rtt_ms_;
+            std::map<uint32_t, xr_rrt> xr_rrts_;
+            std::function<void(const uvgrtp::frame::rtcp_xr_packet&)> xr_hook_;
+            uvgrtp::frame::rtcp_xr_packet xr_view_;
+            std::mutex xr_mutex_;
+            std::vector<xr_source_blocks> xr_sources_;
+            size_t xr_source_count_;
+            std::vector<uvgrtp::frame::rtcp_xr_dlrr_item> xr_dlrr_;
+            bool xr_rrt_;
+
+            /* Packets resent for NACKs, guarded by fb_mutex_ */
+            std::shared_ptr<uvgrtp::packet_history> packet_history_;
+
+            /* Key frame requests, see install_key_frame_request_hook(). The hook and the last FIR
+             * sequence number of each sender are guarded by fb_mutex_ */
+            void *key_frame_hook_arg_;
+            void (*key_frame_hook_)(void *);
+            std::map<uint32_t, uint8_t> fir_seqs_;
+            std::atomic<uint8_t> fir_seq_;
+
             std::shared_ptr<uvgrtp::socket> rtcp_socket_;
             std::shared_ptr<uvgrtp::socketfactory> sfp_;
             std::shared_ptr<uvgrtp::rtcp_reader> rtcp_reader_;
 
-            bool is_active() const
-            {
-                return active_;
-            }
-
             bool active_;
 
             std::atomic<uint32_t> interval_ms_;
@@ -680,6 +966,11 @@ namespace uvgrtp {
             std::vector<uvgrtp::frame::rtcp_sdes_item> ourItems_; // always sent
             std::vector<uint32_t> bye_ssrcs_; // sent once
             
+            /* The compound packet of generate_report() and the APP packets of its hooks, kept between the
+             * reports under packet_mutex_ so that sending a report does not allocate */
+            std::vector<uint8_t> report_buffer_;
+            std::vector<std::shared_ptr<rtcp_app_packet>> outgoing_apps_;
+
             std::map<std::string, std::deque<rtcp_app_packet>> app_packets_; // sent one at a time per name
             // APPs for hook
             std::multimap<std::string, std::function <std::unique_ptr<uint8_t[]>(uint8_t& subtype, uint32_t& payload_len)>> outgoing_app_hooks_;
@@ -100,6 +100,31 @@ namespace uvgrtp {
              */
             rtp_error_t destroy_stream(uvgrtp::media_stream *stream);
 
+            /**
+             * \brief Bind the local ports of several media streams at once
+             *
+             * \details
+             *
+             * Reserves "pairs" contiguous pairs of ports between min_port and max_port, each
+             * an even RTP port followed by its RTCP port. The ports are bound to the local address
+             * of the session, or to any address if the session has none. A media stream created
+             * with one of the reserved RTP ports as its source port receives through the socket
+             * reserved for it, so creating a large number of streams does not search for free ports
+             * one by one. The reserved sockets that no stream takes are closed with the context.
+             *
+             * \param pairs       Number of RTP/RTCP port pairs
+             * \param first_port  The RTP port of the first pair is written here
+             * \param min_port    Lowest port of the range
+             * \param max_port    Highest port of the range
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK             On success
+             * \retval RTP_INVALID_VALUE  If the pairs do not fit in the range or the local address is multicast
+             * \retval RTP_BIND_ERROR     If the range has no room for the pairs
+             */
+            rtp_error_t reserve_ports(size_t pairs, uint16_t& first_port, uint16_t min_port = 1024, uint16_t max_port = 65535);
+
             /// \cond DO_NOT_DOCUMENT
             /* Get unique key of the session
              * Used by context to index sessions */
@@ -123,7 +123,8 @@ typedef enum RTP_FORMAT {
     // H263-1998 is unsupported in uvgRTP
     RTP_FORMAT_H264      = 106, ///< H.264/AVC, see RFC 6184
     RTP_FORMAT_H265      = 107, ///< H.265/HEVC, see RFC 7798
-    RTP_FORMAT_H266      = 108  ///< H.266/VVC
+    RTP_FORMAT_H266      = 108, ///< H.266/VVC
+    RTP_FORMAT_RAW_VIDEO = 109  ///< Uncompressed video, see RFC 4175 and RCC_VIDEO_WIDTH
     
 } rtp_format_t;
 
@@ -272,13 +273,79 @@ enum RTP_CTX_ENABLE_FLAGS {
     /** Force uvgRTP to send packets at certain framerate (default 30 fps) */
     RCE_FRAME_RATE                  = 1 << 19,
 
-    /** Paces the sending of frame fragments within frame interval (default 1/30 s) */
+    /** Paces the sending of frame fragments within frame interval (default 1/30 s).
+     * The packets are sent by a pacer thread that the streams of a context share,
+     * see RCC_PACING_BURST and RCC_PACING_SPIN */
     RCE_PACE_FRAGMENT_SENDING       = 1 << 20,
 
     RCE_RTCP_MUX                    = 1 << 21,
-    
+
+    /** Send the fragments of a frame using UDP Generic Segmentation Offload (UDP_SEGMENT).
+     *
+     * Equal-sized fragments are given to the kernel as one large buffer which is split into
+     * datagrams by the kernel or the network card. Sender side flag. On Windows 10 and newer, UDP
+     * Segmentation Offload (UDP_SEND_MSG_SIZE) is used instead. If the kernel does not support
+     * either, uvgRTP falls back to sending the fragments normally. */
+    RCE_UDP_GSO                     = 1 << 22,
+
+    /** Receive packets using UDP Generic Receive Offload (UDP_GRO).
+     *
+     * The kernel may coalesce several datagrams into one buffer which uvgRTP splits in place
+     * into the reception ring buffer. Receiver side flag. On Windows 10 and newer, UDP Receive
+     * Segment Coalescing (UDP_RECV_MAX_COALESCED_SIZE) is used instead. If the kernel does
+     * not support either, uvgRTP receives the datagrams one by one. */
+    RCE_UDP_GRO                     = 1 << 23,
+
+    /** Deliver received frames without copying their payload.
+     *
+     * The payload of the frame points to the buffer the packet was received into and
+     * the buffer is released when the frame is deallocated with uvgrtp::frame::dealloc_frame().
+     * The reception ring gets a new buffer in place of the borrowed one. Receiver side flag.
+     * Cannot be combined with RCE_UDP_GRO, which is then ignored. */
+    RCE_RECEIVE_ZERO_COPY           = 1 << 24,
+
+    /** Reassemble fragmented H.264/H.265/H.266 frames by copying each fragment to its final
+     * place in one output buffer as it arrives, instead of keeping the fragments until the
+     * frame is complete. Requires that all fragments of a frame except the last one are of
+     * the same size, which is how uvgRTP and most senders fragment. If a frame breaks this,
+     * it is dropped and the stream returns to the default reassembly. Receiver side flag. */
+    RCE_H26X_FLAT_REASSEMBLY        = 1 << 25,
+
+    /** Return whole H.264/H.265/H.266 access units instead of single NAL units. The NAL units
+     * with the same RTP timestamp are concatenated into one buffer with a start code in front
+     * of each NAL unit, and the buffer is returned once the packet with the marker bit has
+     * been received and all NAL units of the picture are complete. If the marker packet is
+     * lost or the sender does not set the marker bit, the access unit is returned when a NAL
+     * unit of the next picture arrives.
+     * The start codes are always added, so RCE_NO_H26X_PREPEND_SC is ignored. Receiver side flag. */
+    RCE_H26X_ACCESS_UNIT            = 1 << 26,
+
+    /** Send frames from a sender thread of the stream instead of the thread calling
+     * push_frame(). The frame is placed in a bounded send queue and push_frame() returns
+     * immediately, so packetization, encryption, pacing and the system calls do not block
+     * the caller. If the queue is full, push_frame() returns RTP_MEMORY_ERROR. Use
+     * uvgrtp::media_stream::install_send_complete_hook() to know when a buffer can be
+     * reused and RCC_SEND_QUEUE_SIZE to change the size of the queue. Sender side flag. */
+    RCE_ASYNC_SEND                  = 1 << 27,
+
+    /** Let the kernel pace the packets of RCE_PACE_FRAGMENT_SENDING. The whole frame is
+     * given to the kernel with one system call and each packet gets a launch time with
+     * SO_TXTIME, which the fq and etf qdiscs keep. If SO_TXTIME is not available, the rate
+     * of each frame is set with SO_MAX_PACING_RATE, which the fq qdisc keeps. If neither
+     * works, the frames are paced in user space. Other qdiscs send the packets at once.
+     * Sender side flag, Linux only. */
+    RCE_PACE_KERNEL                 = 1 << 28,
+
+    /** Protect SRTP and SRTCP packets with AES-GCM (RFC 7714) instead of AES-CM and HMAC-SHA1.
+     * The payload is encrypted and authenticated in one pass and every packet carries
+     * a 16-byte authentication tag. AEAD_AES_128_GCM is used by default and
+     * AEAD_AES_256_GCM with RCE_SRTP_KEYSIZE_256. Only the first 12 bytes of the
+     * master salt are used. Requires RCE_SRTP_KMNGMNT_USER and cannot be combined
+     * with RCE_SRTP_NULL_CIPHER or RCE_SRTP_KEYSIZE_192. */
+    RCE_SRTP_AES_GCM                = 1 << 29,
+
     /// \cond DO_NOT_DOCUMENT
-    RCE_LAST                        = 1 << 22
+    RCE_LAST                        = 1 << 30
    /// \endcond
 }; // maximum is 1 << 30 for int
 
@@ -399,9 +466,691 @@ enum RTP_CTX_CONFIGURATION_FLAGS {
     */
     RCC_POLL_TIMEOUT       = 13,
 
+    /** Set how many packets the receiver reads from the socket with one system call
+    *
+    * Default value is 1. With larger values, uvgRTP uses recvmmsg(2) to read several
+    * packets into the reception ring buffer at once, which reduces the number of system
+    * calls when receiving high bitrate streams. The maximum value is 64.
+    */
+    RCC_RECV_BATCH_SIZE    = 14,
+
+    /** Process received packets in the receiving thread
+    *
+    * Default value is 0. If set to 1, the socket's receiver thread dispatches each packet to
+    * the handlers itself instead of handing it over to a separate processing thread. This
+    * halves the number of reception threads and removes a thread wakeup from the reception
+    * latency, but frames are returned to the receive hook from the receiving thread, so a slow
+    * hook delays reading the socket. The setting applies to every stream sharing the socket.
+    */
+    RCC_INLINE_RECEPTION   = 15,
+
+    /** Set how many frames can wait in the send queue of RCE_ASYNC_SEND
+    *
+    * Default value is 8. When the queue is full, push_frame() fails with RTP_MEMORY_ERROR
+    * instead of blocking.
+    */
+    RCC_SEND_QUEUE_SIZE    = 16,
+
+    /** Set how many packets RCE_PACE_FRAGMENT_SENDING may send back-to-back
+    *
+    * Default value is 1. The packets of a paced frame are sent at the rate that fits the frame
+    * in 80% of the frame interval. With larger values, up to this many packets are sent with one
+    * system call when the token bucket of the stream allows it, which lowers the CPU cost of
+    * pacing at the price of short bursts. The maximum value is 64.
+    */
+    RCC_PACING_BURST       = 17,
+
+    /** Set how many microseconds at the end of each pacing wait are spun instead of slept
+    *
+    * Default value is 0. A sleep may end tens of microseconds late because of the timer slack of
+    * the OS. Spinning the final microseconds makes the packet times of RCE_PACE_FRAGMENT_SENDING
+    * more accurate, but keeps the pacer thread busy for that time.
+    */
+    RCC_PACING_SPIN        = 18,
+
+    /** Set the width of RTP_FORMAT_RAW_VIDEO frames in pixels
+    *
+    * Must be set on both the sender and the receiver together with RCC_VIDEO_HEIGHT. The width
+    * must be a multiple of RCC_VIDEO_PGROUP_PIXELS and at most 32767.
+    */
+    RCC_VIDEO_WIDTH        = 19,
+
+    /** Set the height of RTP_FORMAT_RAW_VIDEO frames in lines, at most 32767 */
+    RCC_VIDEO_HEIGHT       = 20,
+
+    /** Set the size of an RTP_FORMAT_RAW_VIDEO pixel group in bytes
+    *
+    * A pixel group is the smallest unit of whole samples, see RFC 4175 section 4.
+    * Default value is 5, which with RCC_VIDEO_PGROUP_PIXELS of 2 is YCbCr 4:2:2 with 10-bit samples.
+    */
+    RCC_VIDEO_PGROUP_SIZE  = 21,
+
+    /** Set how many pixels one RTP_FORMAT_RAW_VIDEO pixel group holds, default value is 2 */
+    RCC_VIDEO_PGROUP_PIXELS = 22,
+
+    /** Set how many threads authenticate and decrypt received SRTP packets of the stream
+    * in parallel with the processing thread
+    *
+    * Default value is 0, the packets are decrypted one by one in the processing thread.
+    * With a non-zero value, the SRTP packets that are waiting in the reception ring are
+    * split between the threads and released to the depacketizer in order, so one encrypted
+    * stream can use more than one core. Maximum is 64. Requires RCE_SRTP.
+    */
+    RCC_SRTP_DECRYPT_THREADS = 23,
+
+    /** Enable transport-wide congestion control with this header extension element ID
+    *
+    * Default value is 0, disabled. With an ID from 1 to 255, each sent packet carries a transport-wide
+    * sequence number in an RTP header extension and the receiver reports the arrival times of
+    * the packets in RTCP feedback every 50 ms. The sender estimates the available bandwidth from the
+    * feedback and gives it to the hook of uvgrtp::media_stream::install_bitrate_hook(). Must be set to
+    * the same ID on both the sender and the receiver, for example the one negotiated with SDP.
+    * Requires RCE_RTCP. The extension takes 8 bytes from the payload of each packet, see
+    * RCC_ABS_SEND_TIME_EXT_ID for the other elements and the IDs from 15 to 255.
+    */
+    RCC_TWCC_EXT_ID        = 24,
+
+    /** Set the bitrate in kbps that the congestion control of RCC_TWCC_EXT_ID starts from, default value is 1000 */
+    RCC_TWCC_START_BITRATE = 25,
+
+    /** Set the highest bitrate in kbps that the congestion control of RCC_TWCC_EXT_ID may estimate
+    *
+    * Default value is 0, which does not limit the estimate.
+    */
+    RCC_TWCC_MAX_BITRATE   = 26,
+
+    /** Enable selective retransmission of lost packets with RTCP Generic NACK
+    *
+    * Default value is 0, disabled. With 1, the sender keeps the last RCC_NACK_HISTORY_SIZE packets
+    * it has sent and resends the ones that the receiver asks for. A receiving H26x stream asks for
+    * the packets missing from the sequence numbers until RCC_PKT_MAX_DELAY, when the frames they belong
+    * to are dropped. Must be set on both the sender and the receiver. Requires RCE_RTCP.
+    */
+    RCC_NACK               = 27,
+
+    /** Set the number of sent packets kept for retransmission with RCC_NACK, default value is 1024 */
+    RCC_NACK_HISTORY_SIZE  = 28,
+
+    /** Enable forward error correction with XOR repair packets of this payload type
+    *
+    * Default value is 0, disabled. The sender follows the packets of each frame with the repair
+    * packets of RFC 5109 and the receiver rebuilds each lost packet that is the only one missing
+    * from the packets of a repair packet, without waiting for a round trip. Must be set to the same
+    * payload type on both ends, which must differ from the payload type of the media. Only supported
+    * by the H26x formats. The repair packets take 18 bytes from the payload of each packet.
+    */
+    RCC_FEC_PAYLOAD_TYPE   = 29,
+
+    /** Set the number of FEC repair packets as a percentage of the media packets, from 1 to 100
+    *
+    * Default value is 10. Each block of up to 48 packets of a frame gets at least one repair
+    * packet. The repair packets of a block are interleaved, so with 10% overhead the burst
+    * of lost packets that can be rebuilt is 10% of the block. Sender side only.
+    */
+    RCC_FEC_OVERHEAD       = 30,
+
+    /** Ask the sender for a key frame automatically when a received frame is lost
+    *
+    * Default value is 0, disabled. With 1, a receiving H26x stream sends an RTCP Picture Loss
+    * Indication (PLI) whenever it drops a frame that could not be completed within RCC_PKT_MAX_DELAY
+    * or, with RCE_H26X_DEPENDENCY_ENFORCEMENT, that references a lost frame. With 2, a Full Intra
+    * Request (FIR) is sent instead. The sender is told of the requests with
+    * uvgrtp::media_stream::install_key_frame_request_hook(). Requires RCE_RTCP.
+    */
+    RCC_KEY_FRAME_REQUEST  = 31,
+
+    /** Set the shortest time in milliseconds between the key frame requests of RCC_KEY_FRAME_REQUEST
+    *
+    * Default value is 500. The requests are throttled so that the losses before the
+    * key frame arrives do not make the sender send more key frames.
+    */
+    RCC_KEY_FRAME_REQUEST_INTERVAL = 32,
+
+    /** Hold the received frames in a jitter buffer for at most this many milliseconds
+    *
+    * Default value is 0, disabled. The frames are released to the receive hook and pull_frame()
+    * in the order of their timestamps and sequence numbers at their playout time, which is the
+    * timestamp of the frame mapped to the local clock plus a playout delay of three times the
+    * interarrival jitter, kept between RCC_JITTER_BUFFER_MIN_DELAY and this value. Without RCE_RTCP
+    * the jitter is not known and the delay is RCC_JITTER_BUFFER_MIN_DELAY. A frame that arrives after
+    * a later frame has been released is dropped.
+    */
+    RCC_JITTER_BUFFER      = 33,
+
+    /** Set the shortest playout delay of RCC_JITTER_BUFFER in milliseconds, default value is 10 */
+    RCC_JITTER_BUFFER_MIN_DELAY = 34,
+
+    /** Set how many received frames at most wait for pull_frame()
+    *
+    * Default value is 1024, 0 removes the limit. When a frame does not fit in the queue,
+    * frames are dropped according to RCC_DELIVERY_QUEUE_POLICY. The queue belongs to the
+    * socket, so the streams multiplexed into one socket share it. The frames given to
+    * the receive hook are not queued.
+    */
+    RCC_DELIVERY_QUEUE_FRAMES = 35,
+
+    /** Set how many payload bytes at most the frames waiting for pull_frame() take.
+    * Default value is 0, no limit. See RCC_DELIVERY_QUEUE_FRAMES */
+    RCC_DELIVERY_QUEUE_BYTES = 36,
+
+    /** Set which frames are dropped when the queue of RCC_DELIVERY_QUEUE_FRAMES is full,
+    * see RTP_DROP_POLICY. Default value is RTP_DROP_OLDEST */
+    RCC_DELIVERY_QUEUE_POLICY = 37,
+
+    /** Take the receive and send times of the datagrams from the kernel (SO_TIMESTAMPING), see
+    * RTP_TIMESTAMPING. Default value is 0, the times are read in user space.
+    *
+    * With RTP_TIMESTAMP_RECEIVE the kernel receive timestamp is given in uvgrtp::frame::rtp_frame::recv_time
+    * and used for the reassembly timeouts, the RTCP interarrival jitter and the arrival times of RCE_TWCC.
+    * With RTP_TIMESTAMP_SEND the send timestamps are compared with the times the packets were meant to
+    * leave and the difference is counted in uvgrtp::stream_stats::send_delay_us. The flag applies to
+    * the socket of the stream, so the streams multiplexed into one socket share it. Only supported on Linux
+    */
+    RCC_TIMESTAMPING = 38,
+
+    /** Let the ring buffer of RCC_RING_BUFFER_SIZE grow up to this many bytes when the processing
+    * of the received packets falls behind. When the ring fills past RCC_RING_BUFFER_WATERMARK, a
+    * background thread allocates a ring of twice the size and the reception moves on to it without
+    * waiting for the old ring to be processed. Default value is 0, the ring keeps its size */
+    RCC_RING_BUFFER_MAX_SIZE = 39,
+
+    /** Set how full the ring buffer may get, in percent, before the processing counts as falling
+    * behind, see uvgrtp::stream_stats::ring_watermark_events and RCC_RING_BUFFER_MAX_SIZE.
+    * Default value is 75 */
+    RCC_RING_BUFFER_WATERMARK = 40,
+
+    /** Set when the RTCP feedback messages of the stream, NACK, PLI and FIR, are sent, see
+    * RTP_RTCP_FEEDBACK. Default value is RTP_RTCP_FEEDBACK_IMMEDIATE. The transport-wide congestion
+    * control feedback of RCC_TWCC_EXT_ID is always sent on its own every 50 ms. Requires RCE_RTCP */
+    RCC_RTCP_FEEDBACK = 41,
+
+    /** Add RTCP extended report blocks (RFC 3611) to the reports of the stream, see RTP_RTCP_XR.
+    * A stream always answers the receiver reference time blocks it receives with DLRR, and the
+    * received extended reports are given to the hook of uvgrtp::rtcp::install_xr_hook(). Set this
+    * before the remote starts sending, the participants known before have no receive history
+    * for the loss RLE, statistics summary and VoIP metrics blocks. Requires RCE_RTCP */
+    RCC_RTCP_XR = 42,
+
+    /** Add the abs-send-time header extension element with this ID to each sent packet
+    *
+    * Default value is 0, disabled. The element carries the time the packet is sent as the 24-bit
+    * 6.18 fixed point seconds of the NTP clock, which a receiver can use to estimate the queuing
+    * delay. The paced packets of a frame get the time of their place in the pacing schedule.
+    * The IDs from 1 to 14 use the one-byte header extension of RFC 8285. An ID from 15 to 255 switches
+    * the whole extension of the stream to the two-byte form. The elements of a stream share one
+    * extension, which takes from 8 to at most 20 bytes from the payload of each packet. */
+    RCC_ABS_SEND_TIME_EXT_ID = 43,
+
+    /** Add the audio level header extension element of RFC 6464 with this ID to each sent packet
+    *
+    * Default value is 0, disabled. The level is given with uvgrtp::media_stream::set_audio_level().
+    * See RCC_ABS_SEND_TIME_EXT_ID for the range of the ID. */
+    RCC_AUDIO_LEVEL_EXT_ID = 44,
+
+    /** Add the frame marking header extension element of RFC 9626 with this ID to each sent packet
+    *
+    * Default value is 0, disabled. The element tells the receiver which packets start and end a
+    * frame. For the H26x formats it also tells whether the frame is an independent key frame and
+    * whether it is discardable, that is not used for reference, without the receiver looking at the
+    * NAL unit headers. H.265 and H.266 streams send the long form with the temporal and layer IDs.
+    *
+    * An H26x receiver with the same ID reads the element of the received packets. While the queue of
+    * pull_frame() is more than three quarters full, it leaves out the discardable frames at their
+    * first packet before reassembling them, see uvgrtp::stream_stats::skipped_frames.
+    * See RCC_ABS_SEND_TIME_EXT_ID for the range of the ID. */
+    RCC_FRAME_MARKING_EXT_ID = 45,
+
+    /** Send and receive only the temporal layers up to this temporal ID. Default value is 7, all layers.
+    *
+    * A sender does not packetize the NAL units of the higher temporal layers, so neither the remote
+    * participant nor the destinations of add_destination() get them, see also
+    * uvgrtp::media_stream::set_destination_layers(). A receiver leaves out the packets of the higher
+    * layers before reassembling them. The H.265 and H.266 streams read the temporal ID from the NAL unit
+    * and payload headers, nuh_temporal_id_plus1 minus one. The H.264 receivers read it from the frame
+    * marking of RCC_FRAME_MARKING_EXT_ID, if the sender gives it. */
+    RCC_MAX_TEMPORAL_ID = 46,
+
+    /** Send and receive only the layers up to this nuh_layer_id of H.265 and H.266, default value is 63,
+    * all layers. The NAL units of the higher layers are left out like with RCC_MAX_TEMPORAL_ID */
+    RCC_MAX_LAYER_ID = 47,
+
+    /** Prepend the latest received parameter sets to the first key frame an H26x receiver delivers
+    * after the start of the stream or after it dropped a frame. Default value is 0, disabled.
+    *
+    * A decoder that joins a stream in the middle or resumes after a loss then gets the VPS, SPS and PPS
+    * it needs in the same frame as the key frame, each with a start code. The sets that arrived in
+    * front of the key frame in the meantime are not prepended again. The sets are only prepended with
+    * the start codes, i.e. without RCE_NO_H26X_PREPEND_SC. The latest sets are also available from
+    * uvgrtp::media_stream::get_parameter_sets() whether or not this is enabled. */
+    RCC_H26X_PARAMETER_SETS = 48,
+
+    /** Limit the memory the stream holds for the H26x frames it is reassembling, in bytes. When a
+    * received fragment does not fit into the budget of the stream or the budget of its context, see
+    * uvgrtp::context::set_memory_budget(), the oldest incomplete frames of the stream are dropped
+    * until it fits, and the fragment is dropped with its frame if it does not fit even then. The frames
+    * dropped this way are counted in uvgrtp::stream_stats::shed_frames and the memory in use in
+    * uvgrtp::stream_stats::memory_usage. Default value is 0, no limit */
+    RCC_MEMORY_BUDGET = 49,
+
+    /** Reserve the H26x reassembly state of the receiver for frames of at most this many bytes. Default
+    * value is 0, the state is allocated as the frames arrive.
+    *
+    * The state of the frames that can be in reassembly within RCC_PKT_MAX_DELAY of each other at the
+    * frame rate of RCC_FPS_NUMERATOR and RCC_FPS_DENOMINATOR is allocated right away, as are the
+    * fragments of RCC_SESSION_BANDWIDTH for that time and the output frames, and the state of finished
+    * frames is reused instead of being released. The payload size follows from RCC_MTU_SIZE, so set this
+    * after those flags. Setting it again with larger parameters reserves more. With
+    * RCE_H26X_FLAT_REASSEMBLY, a frame whose fragments would make it larger is dropped */
+    RCC_H26X_MAX_FRAME_SIZE = 50,
+
+    /** Process the received packets of this stream ahead of the other streams multiplexed into
+    * the same socket. With 1, the packets of the stream and the multiplexed RTCP packets of the
+    * socket are taken out of the packets waiting in the reception ring first and their frames
+    * returned before the rest are processed, so a burst of video does not delay an audio stream
+    * sharing its socket. Default value is 0, the packets are processed in the order they arrived */
+    RCC_RECEIVE_PRIORITY = 51,
+
+    /** Set the priority (0-7) of the paced frames of this stream in the pacer of the context
+    *
+    * Default value is 0. When the packets of several RCE_PACE_FRAGMENT_SENDING streams are due
+    * at the same time, the bursts of the stream with the highest priority are sent first, so
+    * the packets of a higher priority stream are sent between the bursts of a large frame of
+    * the others instead of after it. Frames that are not paced are sent at once by the calling
+    * thread and RTCP packets by the RTCP thread, so they never wait for the pacer */
+    RCC_SEND_PRIORITY = 52,
+
+    /** Set the weight (1-100) of this stream among the paced streams of the same RCC_SEND_PRIORITY
+    *
+    * Default value is 1. When the pacer falls behind, the streams of one priority share it in
+    * proportion to their weights instead of in the order their packets became due */
+    RCC_SEND_WEIGHT = 53,
+
+    /** Hold the small NAL units of H26x frames for at most this many microseconds (0-1000000),
+    * so the NAL units of consecutive push_frame() calls are sent in one aggregation packet
+    *
+    * Default value is 0 (disabled). Useful when the parameter sets and slices of a picture are
+    * pushed separately with the same timestamp. The held NAL units are sent when the aggregation
+    * packet is full, when a frame with another timestamp is pushed or when the deadline expires.
+    * The NAL units are copied, so the frame may be released when push_frame() returns */
+    RCC_AGGREGATION_DEADLINE = 54,
+
+    /** Follow the path MTU to the remote address and grow the payloads up to this MTU (576-65535)
+    *
+    * Default value is 0 (disabled). The packets of the stream are sent with the Don't Fragment bit and
+    * the MTU the system has learned for the path is read once a second and after failed sends. The
+    * payload size changes between frames, starting from RCC_MTU_SIZE. The receiver must accept
+    * datagrams of this MTU, i.e. set RCC_MTU_SIZE to at least this value. Linux only */
+    RCC_PATH_MTU_DISCOVERY = 55,
+
+    /** Add the MID header extension element of BUNDLE (RFC 8843) with this ID to each sent packet
+    * and bind the received packets to the stream by their MID
+    *
+    * Default value is 0, disabled. The MID is given with uvgrtp::media_stream::set_mid(). Many streams
+    * can then share one socket without RCC_REMOTE_SSRC: the first packet of an SSRC that no stream of
+    * the socket receives from is given to the stream of its MID, and the SSRC becomes the remote SSRC
+    * of the stream. See RCC_ABS_SEND_TIME_EXT_ID for the range of the ID. */
+    RCC_MID_EXT_ID = 56,
+
+    /** Add the RtpStreamId header extension element of RFC 8852 with this ID to each sent packet
+    *
+    * Default value is 0, disabled. A stream with a RID in uvgrtp::media_stream::set_mid() only
+    * receives the packets that have both its MID and its RID, for example one simulcast encoding.
+    * See RCC_ABS_SEND_TIME_EXT_ID for the range of the ID. */
+    RCC_RID_EXT_ID = 57,
+
+    /** Keep the frames sent since the last key frame, at most this many bytes of them, and send
+    * them to each new destination of uvgrtp::media_stream::add_destination() before its first frame
+    *
+    * Default value is 0, disabled. The receiver can then start decoding right away instead of
+    * waiting for the next key frame. The cached packets are sent paced with the SSRC and sequence
+    * numbers of the destination, so that they lead into its first frame. A GOP larger than this is
+    * not cached. With RCE_SRTP, only the destinations with an SRTP key of their own get the cached
+    * frames. H.264, H.265 and H.266 only */
+    RCC_GOP_CACHE_SIZE = 58,
+
+    /** Time the stages of the data path for one in every this many packets and frames of the
+    * stream, see the stage histograms of uvgrtp::stream_stats
+    *
+    * Default value is 0, disabled. Receiving is divided into finding the stream of a packet,
+    * SRTP, reassembly and delivery, and sending into packetization, the destinations of
+    * add_destination() and the socket. A sampled packet costs two clock reads per stage and
+    * the others one counter increment, so a large value can be left on in production */
+    RCC_PROFILE_SAMPLING = 59,
+
+    /** Put the received RTP packets back in the order of their sequence numbers before they are
+    * depacketized, holding a packet that arrives ahead of a gap for at most this many milliseconds
+    *
+    * Default value is 0, disabled. For receiving the multipath streams of
+    * uvgrtp::media_stream::add_path(), whose paths have different delays. The missing packets
+    * are taken as lost when the packet after them has been held for the window, so the window
+    * should cover the difference of the delays of the paths. At most 1024 packets are held
+    * ahead of a gap. With the I/O engine or inline processing, the packets that are due are
+    * handed on when the next packets of the socket are processed. Setting the window drops
+    * the packets the earlier window was holding */
+    RCC_REORDER_WINDOW_MS = 60,
+
+    /** Drop the second copies of the received RTP packets, telling them apart by their sequence
+    * numbers within this many packets (64-32768) before the newest one
+    *
+    * Default value is 0, disabled, or 4096 once uvgrtp::media_stream::add_receive_path() has been
+    * called. For the streams that are sent over two networks at once. The window should cover the
+    * packets the stream sends during the difference of the delays of the networks, since a packet
+    * older than the window is dropped as well. Setting the window forgets the packets seen so far */
+    RCC_REDUNDANCY_WINDOW = 61,
+
     /// \cond DO_NOT_DOCUMENT
     RCC_LAST
     /// \endcond
 };
 
+/**
+ * \enum RTP_DROP_POLICY
+ *
+ * \brief Which received frames are dropped when the queue of pull_frame() is full, see RCC_DELIVERY_QUEUE_POLICY
+ */
+enum RTP_DROP_POLICY {
+    /** Drop the oldest frames to make room for the new one, which keeps the latency bounded */
+    RTP_DROP_OLDEST         = 0,
+
+    /** Drop the new frame */
+    RTP_DROP_NEWEST         = 1,
+
+    /** Drop the new frame unless it is an H.264, H.265 or H.266 key frame or parameter set,
+     * for which the oldest frames are dropped instead. After a dropped frame, the frames of the
+     * stream are dropped until the next key frame, because they cannot be decoded without it.
+     * With the other formats this is the same as RTP_DROP_NEWEST */
+    RTP_DROP_NON_KEY_FRAMES = 2,
+
+    /// \cond DO_NOT_DOCUMENT
+    RTP_DROP_LAST
+    /// \endcond
+};
+
+/**
+ * \enum RTP_RTCP_FEEDBACK
+ *
+ * \brief When and how the RTCP feedback messages of a stream are sent, see RCC_RTCP_FEEDBACK
+ */
+enum RTP_RTCP_FEEDBACK {
+    /** Send each feedback message right away in a reduced-size RTCP packet that has only the
+     * message (RFC 5506). Both ends must support reduced-size RTCP */
+    RTP_RTCP_FEEDBACK_IMMEDIATE          = 0,
+
+    /** Early feedback with the timing rules of RFC 4585 section 3.5: the first message after a regular
+     * report is sent in an early compound packet with a receiver report and SDES, after a random delay of
+     * up to half the report interval if the session has more than two members, and the messages that
+     * come before the next regular report are sent in it */
+    RTP_RTCP_FEEDBACK_EARLY              = 1,
+
+    /** The timing of RTP_RTCP_FEEDBACK_EARLY, but the early packet has only the feedback messages (RFC 5506) */
+    RTP_RTCP_FEEDBACK_EARLY_REDUCED_SIZE = 2,
+
+    /// \cond DO_NOT_DOCUMENT
+    RTP_RTCP_FEEDBACK_LAST
+    /// \endcond
+};
+
+/**
+ * \enum RTP_RTCP_XR
+ *
+ * \brief Which RTCP extended report blocks RCC_RTCP_XR adds to the reports, combined with bitwise OR
+ */
+enum RTP_RTCP_XR {
+    /** Which of the packets since the previous report were received, for the last 960 packets at most */
+    RTP_RTCP_XR_LOSS_RLE       = 1 << 0,
+
+    /** The lost and duplicate packets and the jitter since the previous report */
+    RTP_RTCP_XR_STAT_SUMMARY   = 1 << 1,
+
+    /** The loss rate, the burst and gap metrics of the losses and the round-trip delay */
+    RTP_RTCP_XR_VOIP_METRICS   = 1 << 2,
+
+    /** The receiver reference time, which the remote answers with DLRR so that the round-trip time
+     * is known without sending media, see uvgrtp::rtcp::get_round_trip_time_ms() */
+    RTP_RTCP_XR_RRT            = 1 << 3,
+
+    /// \cond DO_NOT_DOCUMENT
+    RTP_RTCP_XR_ALL            = (1 << 4) - 1
+    /// \endcond
+};
+
+/**
+ * \enum RTP_TIMESTAMPING
+ *
+ * \brief Which kernel timestamps RCC_TIMESTAMPING enables, combined with bitwise OR
+ */
+enum RTP_TIMESTAMPING {
+    /** Kernel software timestamps of the received datagrams */
+    RTP_TIMESTAMP_RECEIVE  = 1 << 0,
+
+    /** Kernel software timestamps of the sent datagrams */
+    RTP_TIMESTAMP_SEND     = 1 << 1,
+
+    /** Use the timestamps of the network card instead of the software timestamps where they are
+     * available. Hardware timestamping must also be enabled for the network interface, for example
+     * with hwstamp_ctl, and the card timestamps are only comparable to the system clock if the clock
+     * of the card is synchronized to it, for example with phc2sys */
+    RTP_TIMESTAMP_HARDWARE = 1 << 2,
+
+    /// \cond DO_NOT_DOCUMENT
+    RTP_TIMESTAMP_ALL      = RTP_TIMESTAMP_RECEIVE | RTP_TIMESTAMP_SEND | RTP_TIMESTAMP_HARDWARE
+    /// \endcond
+};
+
+/**
+ * \enum RTP_CAPTURE
+ *
+ * \brief Which datagrams uvgrtp::media_stream::start_capture() writes to the file, combined with bitwise OR
+ */
+enum RTP_CAPTURE {
+    /** The datagrams sent from the socket of the stream */
+    RTP_CAPTURE_SEND    = 1 << 0,
+
+    /** The datagrams received to the socket of the stream */
+    RTP_CAPTURE_RECEIVE = 1 << 1,
+
+    /// \cond DO_NOT_DOCUMENT
+    RTP_CAPTURE_ALL     = RTP_CAPTURE_SEND | RTP_CAPTURE_RECEIVE
+    /// \endcond
+};
+
+/**
+ * \enum RTP_RECORD
+ *
+ * \brief Flags of uvgrtp::media_stream::start_recording(), combined with bitwise OR
+ */
+enum RTP_RECORD {
+    /** Give the recorded frames to the application as well. The payload of each frame is then
+     * copied for the recording, otherwise the frames are written and released by the recorder */
+    RTP_RECORD_DELIVER = 1 << 0
+};
+
+/**
+ * \enum RTP_TRANSPORT
+ *
+ * \brief How the media streams of a context send their packets, see uvgrtp::context::set_transport()
+ */
+enum RTP_TRANSPORT {
+    /** UDP sockets of the kernel */
+    RTP_TRANSPORT_UDP    = 0,
+
+    /** Queues in memory between the streams of this process that use the memory transport,
+     * UDP between the others */
+    RTP_TRANSPORT_MEMORY = 1,
+
+    /** AF_XDP on the interface of uvgrtp::context::set_xdp_interface() for IPv4 media,
+     * UDP for the rest */
+    RTP_TRANSPORT_XDP    = 2,
+
+    /** Queues in shared memory between the streams of the processes of the host that use the
+     * shared memory transport, UDP between the others */
+    RTP_TRANSPORT_SHARED_MEMORY = 3
+};
+
+/**
+ * \enum RTP_FORWARD
+ *
+ * \brief What is done with a received RTP packet of a forwarding stream, returned by the
+ * hook of uvgrtp::media_stream::install_forward_hook()
+ */
+enum RTP_FORWARD {
+    /** Drop the packet */
+    RTP_FORWARD_DROP    = 0,
+
+    /** Send the packet to the forward targets of the stream */
+    RTP_FORWARD_SEND    = 1 << 0,
+
+    /** Give the packet also to the depacketization of the stream, which returns its frames as usual */
+    RTP_FORWARD_DELIVER = 1 << 1
+};
+
+/**
+ * \enum RTP_THREAD_TYPE
+ *
+ * \brief The kinds of internal threads of uvgRTP
+ *
+ * \details These are given to uvgrtp::context::configure_threads() to select the
+ * threads that a uvgrtp::thread_config applies to
+ */
+enum RTP_THREAD_TYPE {
+    /** Threads that read the media sockets, including the event loops of uvgrtp::context::start_io_engine().
+     * By default they run with the highest SCHED_FIFO priority */
+    RTP_THREAD_RECEIVER    = 0,
+
+    /** Threads that process the received packets into frames and call the receive hooks.
+     * By default they run with the second highest SCHED_FIFO priority */
+    RTP_THREAD_PROCESSOR   = 1,
+
+    /** Threads that release the frames of the jitter buffer, see RCC_JITTER_BUFFER */
+    RTP_THREAD_PLAYOUT     = 2,
+
+    /** Threads that read the RTCP sockets and send the RTCP reports */
+    RTP_THREAD_RTCP        = 3,
+
+    /** Not used anymore, the keep-alive packets of RCE_HOLEPUNCH_KEEPALIVE are sent by the
+     * ::RTP_THREAD_RTCP thread that sends the RTCP reports */
+    RTP_THREAD_HOLEPUNCHER = 4,
+
+    /** Threads that send the frames of RCE_ASYNC_SEND and RCE_PACE_FRAGMENT_SENDING */
+    RTP_THREAD_SENDER      = 5,
+
+    /// \cond DO_NOT_DOCUMENT
+    RTP_THREAD_LAST
+    /// \endcond
+};
+
+/**
+ * \enum RTP_THREAD_POLICY
+ *
+ * \brief Scheduling policies of the internal threads, see uvgrtp::thread_config
+ */
+enum RTP_THREAD_POLICY {
+    /** Keep the scheduling that uvgRTP uses for the threads by default */
+    RTP_SCHED_DEFAULT = 0,
+
+    /** Normal time-sharing scheduling, SCHED_OTHER */
+    RTP_SCHED_OTHER   = 1,
+
+    /** Real-time first in, first out scheduling with a priority, SCHED_FIFO */
+    RTP_SCHED_FIFO    = 2,
+
+    /** Real-time round-robin scheduling with a priority, SCHED_RR */
+    RTP_SCHED_RR      = 3,
+
+    /// \cond DO_NOT_DOCUMENT
+    RTP_SCHED_LAST
+    /// \endcond
+};
+
+/**
+ * \enum RTP_SOCKET_TYPE
+ *
+ * \brief The kinds of media sockets, see uvgrtp::context::configure_sockets()
+ */
+enum RTP_SOCKET_TYPE {
+    /** The sockets of the audio and RTP_FORMAT_GENERIC streams */
+    RTP_SOCKET_AUDIO = 0,
+
+    /** The sockets of the H26x and RTP_FORMAT_RAW_VIDEO streams */
+    RTP_SOCKET_VIDEO = 1,
+
+    /// \cond DO_NOT_DOCUMENT
+    RTP_SOCKET_LAST
+    /// \endcond
+};
+
+/**
+ * \enum RTP_TRACE_POINT
+ *
+ * \brief The tracepoints of the data path, see uvgrtp::context::install_trace_hook()
+ *
+ * \details The SSRC, timestamp and value of uvgrtp::trace_event are given below for each
+ * tracepoint. The SSRC and timestamp are zero where they are not known
+ */
+enum RTP_TRACE_POINT {
+    /** The receiver thread read packets from a socket. The value is the number of packets */
+    RTP_TRACE_PACKETS_READ      = 0,
+
+    /** The processing thread handled the packets read from a socket. The value is the number of packets */
+    RTP_TRACE_PACKETS_PROCESSED = 1,
+
+    /** The first fragment of a frame arrived. The event has the SSRC and RTP timestamp of
+     * the frame and the value is the sequence number of the fragment */
+    RTP_TRACE_FRAGMENT_FIRST    = 2,
+
+    /** A fragmented frame was reassembled. The value is the size of the frame */
+    RTP_TRACE_FRAME_COMPLETE    = 3,
+
+    /** The application took a frame with pull_frame() or pull_frames(). The value is the size of the frame */
+    RTP_TRACE_FRAME_PULLED      = 4,
+
+    /** The application gave a frame to push_frame(). The timestamp is the one given to push_frame(),
+     * if any, and the value is the size of the frame */
+    RTP_TRACE_FRAME_PUSHED      = 5,
+
+    /** The packets of a frame started to be paced, see RCE_PACE_FRAGMENT_SENDING. The value is the number of packets */
+    RTP_TRACE_PACING_START      = 6,
+
+    /** The last packets of a frame were given to the socket. The value is the number of packets */
+    RTP_TRACE_FRAME_SENT        = 7,
+
+    /** A sent packet was encrypted with SRTP. The timestamp is the sequence number of the
+     * packet and the value is the size of the payload */
+    RTP_TRACE_SRTP_ENCRYPT      = 8,
+
+    /// \cond DO_NOT_DOCUMENT
+    RTP_TRACE_LAST
+    /// \endcond
+};
+
+/**
+ * \enum RTP_CLOCK_FLAGS
+ *
+ * \brief The clocks that uvgRTP reads on its data path, see uvgrtp::context::set_clock_flags()
+ *
+ * \details The flags can be combined. Without any of them, the standard clocks are read every time
+ */
+enum RTP_CLOCK_FLAGS {
+    /** Read the standard clocks every time */
+    RTP_CLOCK_PRECISE         = 0,
+
+    /** Check the timeouts that are looked at for every packet, such as the garbage collection of
+     * the incomplete frames, with CLOCK_MONOTONIC_COARSE. It is read from memory without a system
+     * call but advances only once per timer tick, a few milliseconds. Only supported on Linux */
+    RTP_CLOCK_COARSE_TIMEOUTS = 1,
+
+    /** Time the pacing of RCE_PACE_FRAGMENT_SENDING with the time stamp counter of the CPU,
+     * calibrated against the steady clock. Only used on x86-64 CPUs with an invariant TSC */
+    RTP_CLOCK_TSC_PACING      = 2,
+
+    /** Convert the arrival times of the packets to the other clocks with one sample of the clocks
+     * for each batch of received packets instead of reading them for every packet */
+    RTP_CLOCK_BATCH_SAMPLE    = 4,
+
+    /// \cond DO_NOT_DOCUMENT
+    RTP_CLOCK_DEFAULT         = RTP_CLOCK_COARSE_TIMEOUTS | RTP_CLOCK_BATCH_SAMPLE,
+    RTP_CLOCK_LAST            = 8
+    /// \endcond
+};
+
 extern thread_local rtp_error_t rtp_errno;
@@ -1,11 +1,89 @@
 #ifndef UVGRTP_H
 #define UVGRTP_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+/* See uvgrtp::stats_histogram */
+#define UVGRTP_STATS_HISTOGRAM_BUCKETS 32
+
+typedef struct uvgrtp_stats_histogram {
+    uint64_t buckets[UVGRTP_STATS_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+} uvgrtp_stats_histogram;
+
+/* See uvgrtp::stream_stats */
+typedef struct uvgrtp_stream_stats {
+    uint64_t sent_frames;
+    uint64_t sent_bytes;
+    uint64_t sent_packets;
+    uint64_t send_errors;
+    uint64_t received_packets;
+    uint64_t received_bytes;
+    uint64_t received_frames;
+    uint64_t duplicate_packets;
+    uint64_t late_packets;
+    uint64_t dropped_frames;
+    uint64_t late_frames;
+    uint64_t skipped_frames;
+    uint64_t srtp_auth_failures;
+    uint64_t srtp_replayed_packets;
+    uint64_t ring_full_events;
+    uint64_t ring_watermark_events;
+    uint64_t ring_resizes;
+    uint64_t kernel_drops;
+    uint64_t shed_frames;
+    uint64_t merged_packets;
+    uint64_t memory_usage;
+    uvgrtp_stats_histogram reassembly_latency_us;
+    uvgrtp_stats_histogram queue_depth;
+    uvgrtp_stats_histogram send_batch_size;
+    uvgrtp_stats_histogram send_delay_us;
+    uvgrtp_stats_histogram stage_demux_ns;
+    uvgrtp_stats_histogram stage_srtp_ns;
+    uvgrtp_stats_histogram stage_reassembly_ns;
+    uvgrtp_stats_histogram stage_delivery_ns;
+    uvgrtp_stats_histogram stage_packetize_ns;
+    uvgrtp_stats_histogram stage_fanout_ns;
+    uvgrtp_stats_histogram stage_send_ns;
+} uvgrtp_stream_stats;
+
+/* A received frame, see uvgrtp::frame::rtp_frame
+ *
+ * The frames of uvgrtp_pull_frames() point to the buffers of uvgRTP and must be given back with
+ * uvgrtp_release_frames(). The frames of uvgrtp_pull_frame_into() are in the buffer of the caller
+ * and have no handle */
+typedef struct uvgrtp_frame {
+    uint8_t* payload;
+    size_t payload_len;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    uint16_t seq;
+    uint8_t payload_type;
+    uint8_t marker;
+    void* handle;
+} uvgrtp_frame;
+
+/* Takes back a buffer given to uvgrtp_push_frame_owned() once it has been sent */
+typedef void (*uvgrtp_release_hook)(void* arg, uint8_t* data);
+
+/* One frame of uvgrtp_push_frames(). "release" may be NULL, in which case the buffer stays with the
+ * caller like with uvgrtp_push_frame(). "result" is set to the rtp_error_t of the frame */
+typedef struct uvgrtp_push_request {
+    uint8_t* data;
+    size_t data_len;
+    int rtp_flags;
+    uvgrtp_release_hook release;
+    void* arg;
+    int result;
+} uvgrtp_push_request;
+
 void uvgrtp_create_ctx(void** uvgrtp_context);
 
 void uvgrtp_create_session(void* uvgrtp_context, void** uvgrtp_session, char* remote_address);
@@ -20,6 +98,38 @@ void uvgrtp_destroy_stream(void* uvgrtp_session, void* uvgrtp_stream);
 
 void uvgrtp_push_frame(void* uvgrtp_stream, uint8_t* data, size_t data_len, int rtp_flags);
 
+/* Send "data" without copying it and hand the buffer over to uvgRTP, which gives it back to "release"
+ * once the frame has been sent, see uvgrtp::media_stream::push_frame()
+ *
+ * Return the rtp_error_t of the call, the buffer stays with the caller if it is not RTP_OK */
+int uvgrtp_push_frame_owned(void* uvgrtp_stream, uint8_t* data, size_t data_len, int rtp_flags,
+    uvgrtp_release_hook release, void* arg);
+
+/* Send "count" frames with one call
+ *
+ * Return the number of frames that were sent or queued */
+size_t uvgrtp_push_frames(void* uvgrtp_stream, uvgrtp_push_request* requests, size_t count);
+
+/* Wait at most "timeout_ms" milliseconds for a frame and take all the received frames, at most
+ * "max_frames", without copying them, see uvgrtp::media_stream::pull_frames()
+ *
+ * Return the number of frames written to "frames" */
+size_t uvgrtp_pull_frames(void* uvgrtp_stream, uvgrtp_frame* frames, size_t max_frames, size_t timeout_ms);
+
+/* Give the frames of uvgrtp_pull_frames() back to uvgRTP */
+void uvgrtp_release_frames(uvgrtp_frame* frames, size_t count);
+
+/* Wait at most "timeout_ms" milliseconds for a frame and copy its payload to "buffer"
+ *
+ * Return RTP_OK (0) on success
+ * Return RTP_TIMEOUT if no frame was received in time
+ * Return RTP_MEMORY_ERROR if the payload does not fit to "buffer". The frame is then returned
+ * without copying it as with uvgrtp_pull_frames() and "payload_len" tells the size it needs */
+int uvgrtp_pull_frame_into(void* uvgrtp_stream, uint8_t* buffer, size_t buffer_len, uvgrtp_frame* frame,
+    size_t timeout_ms);
+
+void uvgrtp_get_stats(void* uvgrtp_stream, uvgrtp_stream_stats* stats);
+
 #ifdef __cplusplus
 }
 #endif
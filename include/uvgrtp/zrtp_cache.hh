@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace uvgrtp {
+
+    /// \brief Length of a ZRTP identifier (ZID) in bytes
+    constexpr size_t ZRTP_ZID_LENGTH = 12;
+
+    /// \brief Length of a ZRTP retained secret in bytes
+    constexpr size_t ZRTP_SECRET_LENGTH = 32;
+
+    /**
+     * \brief Retained secrets shared with one remote ZRTP endpoint
+     *
+     * \details rs1 is the secret of the latest ZRTP session with the remote endpoint and
+     * rs2 the one before it, see RFC 6189 section 4.6.1
+     */
+    struct zrtp_retained_secrets {
+        uint8_t rs1[ZRTP_SECRET_LENGTH];
+        uint8_t rs2[ZRTP_SECRET_LENGTH];
+
+        /// \brief Whether rs2 holds a secret. rs1 is always valid
+        bool rs2_valid;
+    };
+
+    /**
+     * \brief Persistent storage for the ZRTP identity of this endpoint and the secrets
+     * retained from earlier ZRTP sessions
+     *
+     * \details With a cache, ZRTP keeps the same ZID between sessions and mixes the retained
+     * secret into the keys of the next session with the same remote endpoint. If both
+     * endpoints have retained a secret, ZRTP uses Preshared mode which skips the
+     * Diffie-Hellman exchange entirely.
+     *
+     * uvgRTP offers a file-backed cache through uvgrtp::context::set_zrtp_cache_file().
+     * Implement this interface to keep the secrets somewhere else. The functions may be
+     * called from several threads at once.
+     */
+    class zrtp_cache {
+        public:
+            virtual ~zrtp_cache() {}
+
+            /**
+             * \brief Get the ZID of this endpoint
+             *
+             * \retval true   If "zid" was filled
+             * \retval false  If no ZID has been stored yet
+             */
+            virtual bool get_zid(uint8_t zid[ZRTP_ZID_LENGTH]) = 0;
+
+            /// \brief Store the ZID of this endpoint
+            virtual void set_zid(const uint8_t zid[ZRTP_ZID_LENGTH]) = 0;
+
+            /**
+             * \brief Get the secrets retained with the endpoint "remote_zid"
+             *
+             * \retval true   If "secrets" was filled
+             * \retval false  If no secret has been retained with the endpoint
+             */
+            virtual bool get_secrets(const uint8_t remote_zid[ZRTP_ZID_LENGTH], zrtp_retained_secrets& secrets) = 0;
+
+            /// \brief Store the secrets retained with the endpoint "remote_zid", replacing the old ones
+            virtual void set_secrets(const uint8_t remote_zid[ZRTP_ZID_LENGTH], const zrtp_retained_secrets& secrets) = 0;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,110 @@
+#include "arena.hh"
+
+#include "uvgrtp/util.hh"
+
+#include "debug.hh"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+uvgrtp::arena::arena() :
+    data_(nullptr),
+    size_(0),
+    huge_pages_(false)
+{
+}
+
+uvgrtp::arena::~arena()
+{
+    release();
+}
+
+uint8_t *uvgrtp::arena::allocate(size_t size)
+{
+    release();
+
+    if (size == 0)
+        return nullptr;
+
+#ifdef _WIN32
+    // the pages are committed, but physical memory is given to them only when they are touched
+    size_t mapped = align_up(size, CACHE_LINE_SIZE);
+    void *memory = VirtualAlloc(nullptr, mapped, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+    if (!memory) {
+        UVG_LOG_ERROR("Failed to allocate %zu bytes for a ring buffer", mapped);
+        return nullptr;
+    }
+#else
+    size_t mapped = align_up(size, (size_t)sysconf(_SC_PAGESIZE));
+    void *memory  = MAP_FAILED;
+
+#if defined(__linux__) && defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+    if (size >= HUGE_PAGE_SIZE) {
+        // the length of a hugetlbfs mapping must be a multiple of its page size
+        size_t huge = align_up(size, HUGE_PAGE_SIZE);
+        memory = mmap(nullptr, huge, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0);
+
+        if (memory != MAP_FAILED) {
+            mapped      = huge;
+            huge_pages_ = true;
+        } else {
+            UVG_LOG_DEBUG("No huge pages reserved for a ring buffer of %zu bytes", huge);
+        }
+    }
+#endif
+
+    if (memory == MAP_FAILED) {
+        memory = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (memory == MAP_FAILED) {
+            UVG_LOG_ERROR("Failed to map %zu bytes for a ring buffer", mapped);
+            return nullptr;
+        }
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (size >= HUGE_PAGE_SIZE) {
+            (void)madvise(memory, mapped, MADV_HUGEPAGE);
+        }
+#endif
+    }
+#endif
+
+    data_ = (uint8_t *)memory;
+    size_ = mapped;
+    return data_;
+}
+
+void uvgrtp::arena::release()
+{
+    if (!data_)
+        return;
+
+#ifdef _WIN32
+    (void)VirtualFree(data_, 0, MEM_RELEASE);
+#else
+    (void)munmap(data_, size_);
+#endif
+
+    data_       = nullptr;
+    size_       = 0;
+    huge_pages_ = false;
+}
+
+uint8_t *uvgrtp::arena::data() const
+{
+    return data_;
+}
+
+size_t uvgrtp::arena::size() const
+{
+    return size_;
+}
+
+bool uvgrtp::arena::huge_pages() const
+{
+    return huge_pages_;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace uvgrtp {
+
+    /* Size of the cache lines that the buffers of an arena are aligned to */
+    constexpr size_t CACHE_LINE_SIZE = 64;
+
+    /* An arena of one huge page or more is backed by huge pages when the system allows it */
+    constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    /* Round "size" up to a multiple of "alignment", which is a power of two */
+    constexpr size_t align_up(size_t size, size_t alignment)
+    {
+        return (size + alignment - 1) & ~(alignment - 1);
+    }
+
+    /* One large block of memory mapped directly from the system for a ring buffer.
+     *
+     * The block is aligned to a page, so the buffers at multiples of CACHE_LINE_SIZE from
+     * its start are aligned to cache lines. On Linux, a large block is backed by huge pages
+     * from the hugetlbfs pool if it has any, and otherwise transparent huge pages are
+     * requested for it, which cuts the TLB misses of the reception of a large ring.
+     *
+     * The pages are not touched when the block is allocated. The system places each page on
+     * the NUMA node of the thread that touches it first, so the block ends up local to the
+     * thread that writes the received packets to it, see uvgrtp::context::configure_threads() */
+    class arena {
+        public:
+            arena();
+            ~arena();
+
+            arena(const arena&) = delete;
+            arena& operator=(const arena&) = delete;
+
+            /* Replace the block with a new block of at least "size" bytes
+             *
+             * Return the block or nullptr if the allocation failed */
+            uint8_t *allocate(size_t size);
+
+            /* Return the block to the system */
+            void release();
+
+            uint8_t *data() const;
+            size_t size() const;
+
+            /* Whether the block is backed by the huge pages of hugetlbfs */
+            bool huge_pages() const;
+
+        private:
+            uint8_t *data_;
+            size_t size_;
+            bool huge_pages_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,75 @@
+#include "async_pulls.hh"
+
+#include "uvgrtp/frame.hh"
+
+uvgrtp::async_pulls::async_pulls() :
+    pulls_(),
+    frames_(),
+    closed_(false)
+{
+}
+
+uvgrtp::async_pulls::~async_pulls()
+{
+    close();
+}
+
+void uvgrtp::async_pulls::set_limits(size_t max_frames, size_t max_bytes, int policy)
+{
+    frames_.set_limits(max_frames, max_bytes);
+    frames_.set_policy(policy);
+}
+
+void uvgrtp::async_pulls::pull(std::function<void(uvgrtp::frame::rtp_frame *)> handler)
+{
+    uvgrtp::frame::rtp_frame *frame = nullptr;
+    {
+        std::lock_guard<std::mutex> lg(mutex_);
+
+        if (!closed_ && !(frame = frames_.pop())) {
+            pulls_.push_back(std::move(handler));
+            return;
+        }
+    }
+
+    handler(frame);
+}
+
+void uvgrtp::async_pulls::deliver(uvgrtp::frame::rtp_frame *frame)
+{
+    std::function<void(uvgrtp::frame::rtp_frame *)> handler;
+    {
+        std::lock_guard<std::mutex> lg(mutex_);
+
+        if (closed_) {
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            return;
+        }
+
+        if (pulls_.empty()) {
+            frames_.push(frame);
+            return;
+        }
+
+        handler = std::move(pulls_.front());
+        pulls_.pop_front();
+    }
+
+    handler(frame);
+}
+
+void uvgrtp::async_pulls::close()
+{
+    std::deque<std::function<void(uvgrtp::frame::rtp_frame *)>> pending;
+    {
+        std::lock_guard<std::mutex> lg(mutex_);
+
+        closed_ = true;
+        pending.swap(pulls_);
+        frames_.clear();
+    }
+
+    for (auto& handler : pending) {
+        handler(nullptr);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "delivery_queue.hh"
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace uvgrtp {
+
+    namespace frame {
+        struct rtp_frame;
+    }
+
+    /* The pulls of media_stream::async_pull_frame() that wait for a frame
+     *
+     * The stream gives its received frames to deliver() through its receive hook, from the
+     * processing thread of the reception flow. A frame goes to the oldest waiting pull, or
+     * to a queue of its own if no pull is waiting, which the next pull takes from. The queue
+     * has the limits and the drop policy of the delivery queue, so a stream whose pulls fall
+     * behind drops frames as pull_frame() would.
+     *
+     * The handlers are called without the lock held, so a handler may pull again */
+    class async_pulls {
+        public:
+            async_pulls();
+            ~async_pulls();
+
+            async_pulls(const async_pulls&) = delete;
+            async_pulls& operator=(const async_pulls&) = delete;
+
+            /* Limits of the frames that wait for a pull, see delivery_queue::set_limits() */
+            void set_limits(size_t max_frames, size_t max_bytes, int policy);
+
+            /* Give the oldest waiting frame to "handler", or keep the handler until the next frame
+             * is delivered. After close(), "handler" is called with nullptr */
+            void pull(std::function<void(uvgrtp::frame::rtp_frame *)> handler);
+
+            /* Give "frame" to the oldest pull, or queue it if there is none */
+            void deliver(uvgrtp::frame::rtp_frame *frame);
+
+            /* Complete the waiting pulls with nullptr and free the waiting frames */
+            void close();
+
+        private:
+            std::mutex mutex_;
+            std::deque<std::function<void(uvgrtp::frame::rtp_frame *)>> pulls_;
+            uvgrtp::delivery_queue frames_;
+            bool closed_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,96 @@
+#include "audio_batch.hh"
+
+#include "uvgrtp/media_stream.hh"
+
+#include "debug.hh"
+
+#include <algorithm>
+
+uvgrtp::audio_batch::audio_batch()
+{
+}
+
+uvgrtp::audio_batch::~audio_batch()
+{
+}
+
+rtp_error_t uvgrtp::audio_batch::push(uvgrtp::media_stream **streams, uint8_t **frames, size_t *sizes,
+    const uint32_t *timestamps, size_t count)
+{
+    if (!streams || !frames || !sizes)
+        return RTP_INVALID_VALUE;
+
+    rtp_error_t first = RTP_OK;
+
+    auto record = [&first](rtp_error_t ret) {
+        if (first == RTP_OK && ret != RTP_OK)
+            first = ret;
+    };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    seen_.clear();
+
+    for (size_t i = 0; i < count; ++i) {
+        uvgrtp::media_stream *stream = streams[i];
+
+        if (!stream || !frames[i] || !sizes[i]) {
+            record(RTP_INVALID_VALUE);
+            continue;
+        }
+
+        if (std::find(seen_.begin(), seen_.end(), stream) != seen_.end()) {
+            UVG_LOG_ERROR("A media stream was given more than once to push_audio_frames()");
+            record(RTP_INVALID_VALUE);
+            continue;
+        }
+        seen_.push_back(stream);
+
+        uvgrtp::socket *socket = nullptr;
+        uvgrtp::addressed_packet packet = {};
+        const uint32_t *ts = timestamps ? &timestamps[i] : nullptr;
+
+        rtp_error_t ret = stream->prepare_audio_packet(frames[i], sizes[i], ts, socket, packet);
+
+        if (ret == RTP_NOT_SUPPORTED) {
+            if (ts)
+                ret = stream->push_frame(frames[i], sizes[i], *ts, RTP_NO_FLAGS);
+            else
+                ret = stream->push_frame(frames[i], sizes[i], RTP_NO_FLAGS);
+
+            record(ret);
+            continue;
+        }
+
+        if (ret != RTP_OK) {
+            record(ret);
+            continue;
+        }
+
+        group& g = groups_[socket];
+        g.packets.push_back(packet);
+        g.entries.push_back({ stream, sizes[i] });
+    }
+
+    for (auto it = groups_.begin(); it != groups_.end();) {
+        group& g = it->second;
+
+        // the socket of a group that was not used in this call may have been destroyed
+        if (g.packets.empty()) {
+            it = groups_.erase(it);
+            continue;
+        }
+
+        rtp_error_t ret = it->first->sendto_each(g.packets, g.arrays);
+        record(ret);
+
+        for (auto& e : g.entries)
+            e.stream->audio_packet_sent(ret, e.size);
+
+        g.packets.clear();
+        g.entries.clear();
+        ++it;
+    }
+
+    return first;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "socket.hh"
+
+#include "uvgrtp/util.hh"
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace uvgrtp {
+
+    class media_stream;
+
+    /* The arrays of uvgrtp::context::push_audio_frames(). The packets are grouped by the socket
+     * they are sent from and each group is sent with one socket::sendto_each() call. The groups
+     * and their system call arrays are kept between the calls so that a mixer sending a tick of
+     * many streams does not allocate */
+    class audio_batch {
+        public:
+            audio_batch();
+            ~audio_batch();
+
+            /* See uvgrtp::context::push_audio_frames() */
+            rtp_error_t push(uvgrtp::media_stream **streams, uint8_t **frames, size_t *sizes,
+                const uint32_t *timestamps, size_t count);
+
+        private:
+            struct entry {
+                uvgrtp::media_stream *stream;
+                size_t size;
+            };
+
+            struct group {
+                std::vector<uvgrtp::addressed_packet> packets;
+                std::vector<entry> entries;
+                uvgrtp::send_arrays arrays;
+            };
+
+            std::unordered_map<uvgrtp::socket *, group> groups_;
+
+            /* The streams of the current call, a stream given twice would overwrite its own packet */
+            std::vector<uvgrtp::media_stream *> seen_;
+
+            /* push() is called by the threads of the application */
+            std::mutex mutex_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
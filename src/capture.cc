@@ -0,0 +1,485 @@
+#include "capture.hh"
+
+#include "debug.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+/* The pcap file format, see https://www.ietf.org/archive/id/draft-ietf-opsawg-pcap-01.html */
+constexpr uint32_t PCAP_MAGIC_MICROSECONDS = 0xa1b2c3d4;
+constexpr uint32_t PCAP_MAGIC_NANOSECONDS  = 0xa1b23c4d;
+constexpr uint16_t PCAP_VERSION_MAJOR      = 2;
+constexpr uint16_t PCAP_VERSION_MINOR      = 4;
+constexpr size_t PCAP_FILE_HEADER_SIZE     = 24;
+constexpr size_t PCAP_RECORD_HEADER_SIZE   = 16;
+
+/* Largest packet accepted from a capture file, anything larger means the file is corrupted */
+constexpr size_t PCAP_MAX_RECORD_SIZE      = 262144;
+
+constexpr uint32_t LINKTYPE_NULL      = 0;
+constexpr uint32_t LINKTYPE_ETHERNET  = 1;
+constexpr uint32_t LINKTYPE_RAW       = 101;
+constexpr uint32_t LINKTYPE_LINUX_SLL = 113;
+constexpr uint32_t LINKTYPE_IPV4      = 228;
+constexpr uint32_t LINKTYPE_IPV6      = 229;
+
+constexpr size_t IPV4_HEADER_SIZE = 20;
+constexpr size_t IPV6_HEADER_SIZE = 40;
+constexpr size_t UDP_HEADER_SIZE  = 8;
+
+constexpr uint8_t IP_PROTOCOL_UDP = 17;
+
+static void put_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint16_t ipv4_checksum(const uint8_t *header)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < IPV4_HEADER_SIZE; i += 2) {
+        sum += get_u16(header + i);
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+uvgrtp::capture_endpoint uvgrtp::capture_endpoint::from(const sockaddr_in& address)
+{
+    capture_endpoint endpoint;
+    memcpy(endpoint.addr, &address.sin_addr, 4);
+    endpoint.port = ntohs(address.sin_port);
+    return endpoint;
+}
+
+uvgrtp::capture_endpoint uvgrtp::capture_endpoint::from(const sockaddr_in6& address)
+{
+    capture_endpoint endpoint;
+    endpoint.ipv6 = true;
+    memcpy(endpoint.addr, &address.sin6_addr, 16);
+    endpoint.port = ntohs(address.sin6_port);
+    return endpoint;
+}
+
+uvgrtp::capture::capture() :
+    queue_(CAPTURE_QUEUE_SIZE),
+    file_(nullptr),
+    writer_(nullptr),
+    running_(false),
+    directions_(0),
+    dropped_(0),
+    written_(0)
+{
+    static_assert((CAPTURE_QUEUE_SIZE & (CAPTURE_QUEUE_SIZE - 1)) == 0, "the queue size must be a power of two");
+}
+
+uvgrtp::capture::~capture()
+{
+    stop();
+}
+
+rtp_error_t uvgrtp::capture::start(const std::string& path, int directions)
+{
+    if (directions == 0 || (directions & ~RTP_CAPTURE_ALL)) {
+        UVG_LOG_ERROR("Invalid capture directions: %d", directions);
+        return RTP_INVALID_VALUE;
+    }
+
+    if (running_)
+        return RTP_INITIALIZED;
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) {
+        UVG_LOG_ERROR("Failed to create the capture file %s", path.c_str());
+        return RTP_GENERIC_ERROR;
+    }
+
+    // the header is written in the byte order of this system, which the readers detect from the magic
+    uint8_t header[PCAP_FILE_HEADER_SIZE] = {};
+    uint32_t magic     = PCAP_MAGIC_NANOSECONDS;
+    uint16_t version[] = { PCAP_VERSION_MAJOR, PCAP_VERSION_MINOR };
+    uint32_t snaplen   = UINT16_MAX;
+    uint32_t link_type = LINKTYPE_RAW;
+
+    memcpy(header,      &magic,     sizeof(magic));
+    memcpy(header + 4,  version,    sizeof(version));
+    memcpy(header + 16, &snaplen,   sizeof(snaplen));
+    memcpy(header + 20, &link_type, sizeof(link_type));
+
+    if (std::fwrite(header, sizeof(header), 1, file_) != 1) {
+        UVG_LOG_ERROR("Failed to write the capture file %s", path.c_str());
+        std::fclose(file_);
+        file_ = nullptr;
+        return RTP_GENERIC_ERROR;
+    }
+
+    directions_ = directions;
+    running_    = true;
+    writer_     = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::capture::writer, this));
+
+    UVG_LOG_INFO("Capturing the datagrams of the socket to %s", path.c_str());
+    return RTP_OK;
+}
+
+void uvgrtp::capture::stop()
+{
+    directions_ = 0;
+    running_    = false;
+
+    if (writer_ && writer_->joinable())
+        writer_->join();
+    writer_ = nullptr;
+
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+
+        if (dropped_)
+            UVG_LOG_WARN("%lu datagrams were left out of the capture, the writer fell behind", (unsigned long)dropped_);
+    }
+}
+
+bool uvgrtp::capture::captures(int direction) const
+{
+    return (directions_.load(std::memory_order_relaxed) & direction) != 0;
+}
+
+uint64_t uvgrtp::capture::dropped() const
+{
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+uint64_t uvgrtp::capture::written() const
+{
+    return written_.load(std::memory_order_relaxed);
+}
+
+void uvgrtp::capture::record(int direction, uint64_t time_ns, const capture_endpoint& source,
+    const capture_endpoint& destination, const std::vector<std::pair<size_t, uint8_t *>>& buffers)
+{
+    if (!captures(direction))
+        return;
+
+    size_t position = 0;
+    slot *s = queue_.reserve(position);
+    if (!s) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    s->time_ns     = time_ns;
+    s->source      = source;
+    s->destination = destination;
+    s->length      = 0;
+    s->captured    = 0;
+
+    for (auto& buffer : buffers) {
+        size_t copied = std::min(buffer.first, CAPTURE_SNAPLEN - s->captured);
+
+        memcpy(s->data + s->captured, buffer.second, copied);
+        s->captured += copied;
+        s->length   += buffer.first;
+    }
+    queue_.publish(position);
+}
+
+void uvgrtp::capture::record(int direction, uint64_t time_ns, const capture_endpoint& source,
+    const capture_endpoint& destination, const uint8_t *data, size_t length)
+{
+    if (!captures(direction))
+        return;
+
+    size_t position = 0;
+    slot *s = queue_.reserve(position);
+    if (!s) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    s->time_ns     = time_ns;
+    s->source      = source;
+    s->destination = destination;
+    s->length      = length;
+    s->captured    = std::min(length, CAPTURE_SNAPLEN);
+
+    memcpy(s->data, data, s->captured);
+    queue_.publish(position);
+}
+
+void uvgrtp::capture::writer()
+{
+    for (;;) {
+        slot *s = queue_.front();
+
+        if (!s) {
+            // the queue is empty. The datagrams queued before stop() have been written
+            if (!running_)
+                break;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        write_record(*s);
+        queue_.pop();
+    }
+
+    std::fflush(file_);
+}
+
+void uvgrtp::capture::write_record(const slot& s)
+{
+    uint8_t headers[IPV6_HEADER_SIZE + UDP_HEADER_SIZE] = {};
+    size_t ip_size = s.source.ipv6 ? IPV6_HEADER_SIZE : IPV4_HEADER_SIZE;
+    size_t udp_length = std::min(s.length + UDP_HEADER_SIZE, (size_t)UINT16_MAX);
+
+    if (s.source.ipv6) {
+        headers[0] = 0x60;
+        put_u16(headers + 4, (uint16_t)udp_length);
+        headers[6] = IP_PROTOCOL_UDP;
+        headers[7] = 64;
+        memcpy(headers + 8,  s.source.addr, 16);
+        memcpy(headers + 24, s.destination.addr, 16);
+    } else {
+        headers[0] = 0x45;
+        put_u16(headers + 2, (uint16_t)std::min(udp_length + IPV4_HEADER_SIZE, (size_t)UINT16_MAX));
+        put_u16(headers + 6, 0x4000); // don't fragment
+        headers[8] = 64;
+        headers[9] = IP_PROTOCOL_UDP;
+        memcpy(headers + 12, s.source.addr, 4);
+        memcpy(headers + 16, s.destination.addr, 4);
+        put_u16(headers + 10, ipv4_checksum(headers));
+    }
+
+    // the UDP checksum is left out, as it is for datagrams captured before checksum offload
+    uint8_t *udp = headers + ip_size;
+    put_u16(udp,     s.source.port);
+    put_u16(udp + 2, s.destination.port);
+    put_u16(udp + 4, (uint16_t)udp_length);
+
+    uint32_t record[4] = {
+        (uint32_t)(s.time_ns / 1000000000),
+        (uint32_t)(s.time_ns % 1000000000),
+        (uint32_t)(ip_size + UDP_HEADER_SIZE + s.captured),
+        (uint32_t)(ip_size + UDP_HEADER_SIZE + s.length)
+    };
+
+    if (std::fwrite(record, sizeof(record), 1, file_) != 1 ||
+        std::fwrite(headers, ip_size + UDP_HEADER_SIZE, 1, file_) != 1 ||
+        (s.captured && std::fwrite(s.data, s.captured, 1, file_) != 1)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    written_.fetch_add(1, std::memory_order_relaxed);
+}
+
+uvgrtp::capture_reader::capture_reader() :
+    file_(nullptr),
+    swapped_(false),
+    nanoseconds_(false),
+    link_type_(0),
+    record_()
+{}
+
+uvgrtp::capture_reader::~capture_reader()
+{
+    if (file_)
+        std::fclose(file_);
+}
+
+uint32_t uvgrtp::capture_reader::read_u32(const uint8_t *data) const
+{
+    uint32_t value = 0;
+    memcpy(&value, data, sizeof(value));
+
+    if (swapped_) {
+        value = ((value & 0xff) << 24) | ((value & 0xff00) << 8) |
+                ((value >> 8) & 0xff00) | (value >> 24);
+    }
+    return value;
+}
+
+rtp_error_t uvgrtp::capture_reader::open(const std::string& path)
+{
+    if (file_) {
+        std::fclose(file_);
+    }
+
+    file_ = std::fopen(path.c_str(), "rb");
+    if (!file_) {
+        UVG_LOG_ERROR("Failed to open the capture file %s", path.c_str());
+        return RTP_GENERIC_ERROR;
+    }
+
+    uint8_t header[PCAP_FILE_HEADER_SIZE];
+    if (std::fread(header, sizeof(header), 1, file_) != 1) {
+        UVG_LOG_ERROR("%s is not a pcap file", path.c_str());
+        return RTP_INVALID_VALUE;
+    }
+
+    swapped_ = false;
+    uint32_t magic = read_u32(header);
+
+    if (magic != PCAP_MAGIC_MICROSECONDS && magic != PCAP_MAGIC_NANOSECONDS) {
+        swapped_ = true;
+        magic = read_u32(header);
+    }
+
+    if (magic != PCAP_MAGIC_MICROSECONDS && magic != PCAP_MAGIC_NANOSECONDS) {
+        UVG_LOG_ERROR("%s is not a pcap file", path.c_str());
+        return RTP_INVALID_VALUE;
+    }
+    nanoseconds_ = (magic == PCAP_MAGIC_NANOSECONDS);
+
+    // the upper bits of the link type tell whether the packets have the frame check sequence
+    link_type_ = read_u32(header + 20) & 0x0fffffff;
+
+    switch (link_type_) {
+        case LINKTYPE_NULL:
+        case LINKTYPE_ETHERNET:
+        case LINKTYPE_RAW:
+        case LINKTYPE_LINUX_SLL:
+        case LINKTYPE_IPV4:
+        case LINKTYPE_IPV6:
+            return RTP_OK;
+
+        default:
+            UVG_LOG_ERROR("The packets of %s have an unsupported link type %u", path.c_str(), link_type_);
+            return RTP_NOT_SUPPORTED;
+    }
+}
+
+rtp_error_t uvgrtp::capture_reader::next(captured_datagram& datagram)
+{
+    if (!file_)
+        return RTP_NOT_FOUND;
+
+    for (;;) {
+        uint8_t header[PCAP_RECORD_HEADER_SIZE];
+        size_t read = std::fread(header, 1, sizeof(header), file_);
+
+        if (read == 0)
+            return RTP_NOT_FOUND;
+
+        if (read != sizeof(header)) {
+            UVG_LOG_ERROR("The capture file ends in the middle of a packet");
+            return RTP_INVALID_VALUE;
+        }
+
+        uint64_t seconds  = read_u32(header);
+        uint64_t fraction = read_u32(header + 4);
+        size_t length     = read_u32(header + 8);
+        size_t original   = read_u32(header + 12);
+
+        if (length > PCAP_MAX_RECORD_SIZE) {
+            UVG_LOG_ERROR("The capture file has a packet of %zu bytes, the file is corrupted", length);
+            return RTP_INVALID_VALUE;
+        }
+
+        record_.resize(length);
+        if (length && std::fread(record_.data(), length, 1, file_) != 1) {
+            UVG_LOG_ERROR("The capture file ends in the middle of a packet");
+            return RTP_INVALID_VALUE;
+        }
+
+        if (!parse_packet(length, original, datagram))
+            continue;
+
+        datagram.time_ns = seconds * 1000000000 + (nanoseconds_ ? fraction : fraction * 1000);
+        return RTP_OK;
+    }
+}
+
+bool uvgrtp::capture_reader::parse_packet(size_t length, size_t original_length, captured_datagram& datagram)
+{
+    const uint8_t *p = record_.data();
+    size_t offset = 0;
+
+    switch (link_type_) {
+        case LINKTYPE_NULL:
+            offset = 4;
+            break;
+
+        case LINKTYPE_ETHERNET: {
+            offset = 14;
+            if (length < offset)
+                return false;
+
+            // skip the VLAN tags
+            uint16_t type = get_u16(p + 12);
+            while ((type == 0x8100 || type == 0x88a8) && length >= offset + 4) {
+                type = get_u16(p + offset + 2);
+                offset += 4;
+            }
+            if (type != 0x0800 && type != 0x86dd)
+                return false;
+            break;
+        }
+
+        case LINKTYPE_LINUX_SLL:
+            offset = 16;
+            if (length < offset)
+                return false;
+
+            if (get_u16(p + 14) != 0x0800 && get_u16(p + 14) != 0x86dd)
+                return false;
+            break;
+
+        default:
+            break;
+    }
+
+    if (length < offset + 1)
+        return false;
+
+    const uint8_t *ip = p + offset;
+    size_t available = length - offset;
+
+    if ((ip[0] >> 4) == 4) {
+        size_t header_size = (size_t)(ip[0] & 0x0f) * 4;
+
+        if (available < header_size || header_size < IPV4_HEADER_SIZE || ip[9] != IP_PROTOCOL_UDP)
+            return false;
+
+        // the fragments of a datagram are not put back together
+        if (get_u16(ip + 6) & 0x3fff)
+            return false;
+
+        offset += header_size;
+    } else if ((ip[0] >> 4) == 6) {
+        if (available < IPV6_HEADER_SIZE || ip[6] != IP_PROTOCOL_UDP)
+            return false;
+
+        offset += IPV6_HEADER_SIZE;
+    } else {
+        return false;
+    }
+
+    if (length < offset + UDP_HEADER_SIZE)
+        return false;
+
+    const uint8_t *udp = p + offset;
+    size_t udp_length  = get_u16(udp + 4);
+
+    if (udp_length < UDP_HEADER_SIZE)
+        return false;
+
+    size_t payload_length = udp_length - UDP_HEADER_SIZE;
+    size_t captured       = std::min(payload_length, length - offset - UDP_HEADER_SIZE);
+
+    datagram.source_port      = get_u16(udp);
+    datagram.destination_port = get_u16(udp + 2);
+    datagram.truncated        = captured < payload_length || length < original_length;
+    datagram.payload.assign(udp + UDP_HEADER_SIZE, udp + UDP_HEADER_SIZE + captured);
+    return true;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "mpsc_queue.hh"
+
+#include "uvgrtp/util.hh"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2ipdef.h>
+#else
+#include <netinet/in.h>
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* Bytes of a datagram kept in a capture, the rest of a longer datagram is left out */
+    const size_t CAPTURE_SNAPLEN = 2048;
+
+    /* How many datagrams can wait for the writer of a capture */
+    const size_t CAPTURE_QUEUE_SIZE = 4096;
+
+    /* The address of a captured datagram. "addr" is in network byte order and only
+     * its first four bytes are used for IPv4, "port" is in host byte order */
+    struct capture_endpoint {
+        bool ipv6 = false;
+        uint8_t addr[16] = {};
+        uint16_t port = 0;
+
+        static capture_endpoint from(const sockaddr_in& address);
+        static capture_endpoint from(const sockaddr_in6& address);
+    };
+
+    /* Writes the datagrams of a socket to a pcap file, see media_stream::start_capture().
+     *
+     * The file has nanosecond timestamps and raw IP packets, so the IP and UDP headers of
+     * each datagram are made up from its addresses. The socket threads queue the datagrams
+     * into a bounded lock-free queue and a thread of the capture writes them to the file,
+     * so capturing does not add system calls to the sending and receiving. A datagram is
+     * dropped from the capture if the queue is full, see dropped() */
+    class capture {
+        public:
+            capture();
+            ~capture();
+
+            capture(const capture&) = delete;
+            capture& operator=(const capture&) = delete;
+
+            /* Create the file "path" and start writing the datagrams of "directions"
+             * (RTP_CAPTURE) to it
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "directions" is not valid
+             * Return RTP_GENERIC_ERROR if the file cannot be created */
+            rtp_error_t start(const std::string& path, int directions);
+
+            /* Write the queued datagrams and close the file. The datagrams recorded
+             * afterwards are ignored */
+            void stop();
+
+            /* Whether the datagrams of "direction" are captured */
+            bool captures(int direction) const;
+
+            /* Queue the datagram made of "buffers" for the file. "time_ns" is in
+             * nanoseconds of the system clock. Never blocks and may be called from any thread */
+            void record(int direction, uint64_t time_ns, const capture_endpoint& source,
+                const capture_endpoint& destination, const std::vector<std::pair<size_t, uint8_t *>>& buffers);
+            void record(int direction, uint64_t time_ns, const capture_endpoint& source,
+                const capture_endpoint& destination, const uint8_t *data, size_t length);
+
+            /* Number of datagrams left out of the file because the queue was full */
+            uint64_t dropped() const;
+
+            /* Number of datagrams written to the file */
+            uint64_t written() const;
+
+        private:
+            /* A queued datagram */
+            struct slot {
+                uint64_t time_ns;
+                capture_endpoint source;
+                capture_endpoint destination;
+                size_t length;
+                size_t captured;
+                uint8_t data[CAPTURE_SNAPLEN];
+            };
+
+            void writer();
+            void write_record(const slot& s);
+
+            mpsc_queue<slot> queue_;
+
+            std::FILE *file_;
+            std::unique_ptr<std::thread> writer_;
+            std::atomic<bool> running_;
+            std::atomic<int> directions_;
+
+            std::atomic<uint64_t> dropped_;
+            std::atomic<uint64_t> written_;
+    };
+
+    /* A UDP datagram read from a capture file */
+    struct captured_datagram {
+        uint64_t time_ns = 0;
+        uint16_t source_port = 0;
+        uint16_t destination_port = 0;
+
+        /* The datagram was longer than what the file has of it */
+        bool truncated = false;
+
+        std::vector<uint8_t> payload;
+    };
+
+    /* Reads the UDP datagrams of a pcap file, see media_stream::replay_capture(). The files of
+     * capture and of tools like tcpdump and Wireshark are read if they have raw IP, Ethernet,
+     * Linux cooked or BSD loopback packets. Fragmented IP packets and other protocols are skipped */
+    class capture_reader {
+        public:
+            capture_reader();
+            ~capture_reader();
+
+            capture_reader(const capture_reader&) = delete;
+            capture_reader& operator=(const capture_reader&) = delete;
+
+            /* Open the pcap file "path"
+             *
+             * Return RTP_OK on success
+             * Return RTP_GENERIC_ERROR if the file cannot be opened
+             * Return RTP_INVALID_VALUE if the file is not a pcap file
+             * Return RTP_NOT_SUPPORTED if the file has packets of an unknown link type */
+            rtp_error_t open(const std::string& path);
+
+            /* Read the next UDP datagram of the file to "datagram"
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_FOUND if the file has no more datagrams
+             * Return RTP_INVALID_VALUE if the file is cut short or corrupted */
+            rtp_error_t next(captured_datagram& datagram);
+
+        private:
+            uint32_t read_u32(const uint8_t *data) const;
+
+            /* Find the UDP datagram in the packet of "record_", false if the packet has none */
+            bool parse_packet(size_t length, size_t original_length, captured_datagram& datagram);
+
+            std::FILE *file_;
+            bool swapped_;
+            bool nanoseconds_;
+            uint32_t link_type_;
+            std::vector<uint8_t> record_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
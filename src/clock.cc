@@ -1,12 +1,118 @@
 #include "uvgrtp/clock.hh"
+#include "uvgrtp/util.hh"
 
 #include "debug.hh"
 
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+
 #include <stdio.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#define UVGRTP_HAVE_TSC
+#endif
 
 static const uint64_t EPOCH = 2208988800ULL;
 static const uint64_t NTP_SCALE_FRAC = 4294967296ULL;
 
+/* How long the TSC is calibrated for at its first use and how often each thread
+ * anchors it to the steady clock again */
+static const int64_t TSC_CALIBRATION_NS = 2000000;
+static const int64_t TSC_RESYNC_NS      = 50000000;
+
+static std::atomic<int> clock_flags(RTP_CLOCK_DEFAULT);
+
+/* The clocks sampled by sample_batch() in this thread */
+struct batch_sample {
+    bool set = false;
+    uint64_t system_ns = 0;
+    uvgrtp::clock::hrc::hrc_t hrc;
+    std::chrono::steady_clock::time_point steady;
+};
+
+static thread_local batch_sample batch;
+
+static bool batch_sampled()
+{
+    return batch.set && (clock_flags.load(std::memory_order_relaxed) & RTP_CLOCK_BATCH_SAMPLE);
+}
+
+static int64_t steady_ns()
+{
+    return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef UVGRTP_HAVE_TSC
+static bool invariant_tsc()
+{
+    unsigned int regs[4] = { 0, 0, 0, 0 };
+
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if ((unsigned int)info[0] < 0x80000007)
+        return false;
+
+    __cpuid(info, 0x80000007);
+    regs[3] = (unsigned int)info[3];
+#else
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007)
+        return false;
+
+    __get_cpuid(0x80000007, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+
+    // CPUID 8000_0007h EDX bit 8, the TSC runs at a constant rate in all power states
+    return (regs[3] >> 8) & 1;
+}
+
+/* Nanoseconds per tick measured against the steady clock, zero if the TSC cannot be used */
+static double tsc_ns_per_tick()
+{
+    static const double ns_per_tick = []() {
+        if (!invariant_tsc())
+            return 0.0;
+
+        int64_t start_ns    = steady_ns();
+        uint64_t start_tick = __rdtsc();
+        int64_t end_ns      = start_ns;
+
+        while (end_ns - start_ns < TSC_CALIBRATION_NS) {
+            end_ns = steady_ns();
+        }
+        uint64_t end_tick = __rdtsc();
+
+        return end_tick > start_tick ? (double)(end_ns - start_ns) / (double)(end_tick - start_tick) : 0.0;
+    }();
+
+    return ns_per_tick;
+}
+
+/* The TSC of a thread is converted from its last anchor to the steady clock. The rate is
+ * refined at every new anchor over the whole time the thread has used the TSC */
+struct tsc_anchor {
+    bool set = false;
+    uint64_t first_tick = 0;
+    int64_t first_ns = 0;
+    uint64_t tick = 0;
+    int64_t ns = 0;
+    double ns_per_tick = 0;
+    uint64_t resync_ticks = 0;
+    int64_t last_ns = 0;
+};
+
+static thread_local tsc_anchor anchor;
+#endif
+
 static inline uint32_t ntp_diff_ms(uint64_t older, uint64_t newer)
 {
     if (older > newer)
@@ -85,6 +191,138 @@ uint64_t uvgrtp::clock::hrc::diff_now_us(hrc_t& then)
     return diff;
 }
 
+uvgrtp::clock::hrc::hrc_t uvgrtp::clock::hrc::from_system_ns(uint64_t system_ns)
+{
+    if (batch_sampled()) {
+        int64_t offset = (int64_t)(batch.system_ns - system_ns);
+        return batch.hrc - std::chrono::nanoseconds(offset);
+    }
+
+    // the age of the time is the same for both clocks
+    int64_t age = (int64_t)(uvgrtp::clock::system_ns() - system_ns);
+
+    return std::chrono::high_resolution_clock::now() - std::chrono::nanoseconds(age);
+}
+
+uint64_t uvgrtp::clock::system_ns()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::chrono::steady_clock::time_point uvgrtp::clock::steady_from_system_ns(uint64_t system_ns)
+{
+    if (batch_sampled()) {
+        int64_t offset = (int64_t)(batch.system_ns - system_ns);
+        return batch.steady - std::chrono::nanoseconds(offset);
+    }
+
+    int64_t age = (int64_t)(uvgrtp::clock::system_ns() - system_ns);
+
+    return std::chrono::steady_clock::now() - std::chrono::nanoseconds(age);
+}
+
+void uvgrtp::clock::set_flags(int flags)
+{
+    clock_flags.store(flags, std::memory_order_relaxed);
+}
+
+int uvgrtp::clock::get_flags()
+{
+    return clock_flags.load(std::memory_order_relaxed);
+}
+
+void uvgrtp::clock::sample_batch()
+{
+    if (!(clock_flags.load(std::memory_order_relaxed) & RTP_CLOCK_BATCH_SAMPLE))
+        return;
+
+    batch.system_ns = uvgrtp::clock::system_ns();
+    batch.steady    = std::chrono::steady_clock::now();
+
+    // with libstdc++ and libc++ the high-resolution clock is one of the other two
+    if (std::is_same<std::chrono::high_resolution_clock, std::chrono::system_clock>::value) {
+        batch.hrc = uvgrtp::clock::hrc::hrc_t(std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
+            std::chrono::nanoseconds(batch.system_ns)));
+    } else if (std::is_same<std::chrono::high_resolution_clock, std::chrono::steady_clock>::value) {
+        batch.hrc = uvgrtp::clock::hrc::hrc_t(std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
+            batch.steady.time_since_epoch()));
+    } else {
+        batch.hrc = std::chrono::high_resolution_clock::now();
+    }
+    batch.set = true;
+}
+
+uvgrtp::clock::coarse::coarse_t uvgrtp::clock::coarse::now()
+{
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+    if (clock_flags.load(std::memory_order_relaxed) & RTP_CLOCK_COARSE_TIMEOUTS) {
+        struct timespec ts;
+
+        // CLOCK_MONOTONIC_COARSE and the steady clock of the standard library have the same epoch
+        if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0) {
+            return coarse_t(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)));
+        }
+    }
+#endif
+    return std::chrono::steady_clock::now();
+}
+
+uint64_t uvgrtp::clock::coarse::diff_now(coarse_t then)
+{
+    auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(uvgrtp::clock::coarse::now() - then).count();
+
+    // a coarse time may be up to one tick behind a precise time taken just before it
+    return diff > 0 ? (uint64_t)diff : 0;
+}
+
+bool uvgrtp::clock::tsc::available()
+{
+#ifdef UVGRTP_HAVE_TSC
+    return tsc_ns_per_tick() > 0.0;
+#else
+    return false;
+#endif
+}
+
+std::chrono::steady_clock::time_point uvgrtp::clock::tsc::now()
+{
+#ifdef UVGRTP_HAVE_TSC
+    if ((clock_flags.load(std::memory_order_relaxed) & RTP_CLOCK_TSC_PACING) && tsc_ns_per_tick() > 0.0) {
+        uint64_t tick = __rdtsc();
+        int64_t ns    = 0;
+
+        if (!anchor.set || tick - anchor.tick >= anchor.resync_ticks) {
+            ns = steady_ns();
+
+            if (!anchor.set) {
+                anchor.first_tick  = tick;
+                anchor.first_ns    = ns;
+                anchor.ns_per_tick = tsc_ns_per_tick();
+                anchor.set         = true;
+            } else if (tick > anchor.first_tick) {
+                anchor.ns_per_tick = (double)(ns - anchor.first_ns) / (double)(tick - anchor.first_tick);
+            }
+
+            anchor.tick         = tick;
+            anchor.ns           = ns;
+            anchor.resync_ticks = (uint64_t)(TSC_RESYNC_NS / anchor.ns_per_tick);
+        } else {
+            ns = anchor.ns + (int64_t)((double)(tick - anchor.tick) * anchor.ns_per_tick);
+        }
+
+        // a new anchor may be slightly behind the times given from the previous one
+        ns = std::max(ns, anchor.last_ns);
+        anchor.last_ns = ns;
+
+        return std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(ns)));
+    }
+#endif
+    return std::chrono::steady_clock::now();
+}
+
 uint64_t uvgrtp::clock::ms_to_jiffies(uint64_t ms)
 {
     return (uint64_t)(((double)ms/1000)* 65536);
@@ -2,11 +2,22 @@
 
 #include "uvgrtp/version.hh"
 #include "uvgrtp/session.hh"
+#include "uvgrtp/clock.hh"
 
 #include "crypto.hh"
 #include "debug.hh"
-#include "hostname.hh"
 #include "socketfactory.hh"
+#include "io_engine.hh"
+#include "pacer.hh"
+#include "rtcp_scheduler.hh"
+#include "memory_budget.hh"
+#include "xdp.hh"
+#include "holepuncher.hh"
+#include "audio_batch.hh"
+#include "threads.hh"
+#include "trace.hh"
+#include "zrtp/file_cache.hh"
+#include "zrtp/key_pool.hh"
 
 #include <cstdlib>
 #include <cstring>
@@ -15,29 +26,32 @@
 
 thread_local rtp_error_t rtp_errno;
 
-static inline std::string generate_string(size_t length)
-{
-    auto randchar = []() -> char
-    {
-        const char charset[] =
-            "0123456789"
-            "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-            "abcdefghijklmnopqrstuvwxyz";
-        const size_t max_index = (sizeof(charset) - 1);
-        return charset[rand() % max_index];
-    };
-
-    std::string str(length, 0);
-    std::generate_n(str.begin(), length, randchar);
-    return str;
-}
-
 uvgrtp::context::context()
 {
     UVG_LOG_INFO("uvgRTP version: %s", uvgrtp::get_version().c_str());
 
-    cname_  = uvgrtp::context::generate_cname();
+    // the CNAME is generated when the first stream starts RTCP, since looking up the names may be slow
     sfp_ = std::make_shared<uvgrtp::socketfactory>(RCE_NO_FLAGS);
+    io_engine_ = std::make_shared<uvgrtp::io_engine>();
+    sfp_->set_io_engine(io_engine_);
+    pacer_ = std::make_shared<uvgrtp::pacer>();
+    sfp_->set_pacer(pacer_);
+    rtcp_scheduler_ = std::make_shared<uvgrtp::rtcp_scheduler>();
+    sfp_->set_rtcp_scheduler(rtcp_scheduler_);
+
+    // the keep-alives of all the streams are sent by the scheduler thread
+    sfp_->set_keepalive_timer(std::make_shared<uvgrtp::keepalive_timer>(rtcp_scheduler_));
+
+    memory_budget_ = std::make_shared<uvgrtp::memory_budget>();
+    sfp_->set_memory_budget(memory_budget_);
+
+    thread_settings_ = std::make_shared<uvgrtp::thread_settings>();
+    sfp_->set_thread_settings(thread_settings_);
+    io_engine_->set_thread_settings(thread_settings_);
+    pacer_->set_thread_settings(thread_settings_);
+    rtcp_scheduler_->set_thread_settings(thread_settings_);
+
+    audio_batch_ = std::make_shared<uvgrtp::audio_batch>();
 
 #ifdef _WIN32
     WSADATA wsd;
@@ -63,7 +77,7 @@ uvgrtp::session *uvgrtp::context::create_session(std::string address)
         return nullptr;
     }
 
-    return new uvgrtp::session(get_cname(), address, sfp_);
+    return new uvgrtp::session("", address, sfp_);
 }
 
 uvgrtp::session* uvgrtp::context::create_session(std::string remote_addr, std::string local_addr)
@@ -73,7 +87,7 @@ uvgrtp::session* uvgrtp::context::create_session(std::string remote_addr, std::s
         UVG_LOG_ERROR("Please specify at least one address for create_session");
         return nullptr;
     }
-    return new uvgrtp::session(get_cname(), remote_addr, local_addr, sfp_);
+    return new uvgrtp::session("", remote_addr, local_addr, sfp_);
 }
 
 rtp_error_t uvgrtp::context::destroy_session(uvgrtp::session *session)
@@ -86,26 +100,225 @@ rtp_error_t uvgrtp::context::destroy_session(uvgrtp::session *session)
     return RTP_OK;
 }
 
-std::string uvgrtp::context::generate_cname() const
+std::string& uvgrtp::context::get_cname()
 {
-    std::string host = uvgrtp::hostname::get_hostname();
-    std::string user = uvgrtp::hostname::get_username();
+    cname_ = sfp_->get_cname();
+    return cname_;
+}
 
-    if (host == "")
-        host = generate_string(10);
+rtp_error_t uvgrtp::context::set_cname(const std::string& cname)
+{
+    if (cname.empty() || cname.length() > 255) {
+        UVG_LOG_ERROR("The CNAME must be 1-255 bytes long");
+        return RTP_INVALID_VALUE;
+    }
 
-    if (user == "")
-        user = generate_string(10);
+    sfp_->set_cname(cname);
+    return RTP_OK;
+}
 
-    return host + "@" + user;
+bool uvgrtp::context::crypto_enabled() const
+{
+    return uvgrtp::crypto::enabled();
 }
 
-std::string& uvgrtp::context::get_cname()
+rtp_error_t uvgrtp::context::start_io_engine(size_t workers)
 {
-    return cname_;
+    return io_engine_->start(workers);
 }
 
-bool uvgrtp::context::crypto_enabled() const
+rtp_error_t uvgrtp::context::start_external_event_loop()
 {
-    return uvgrtp::crypto::enabled();
+    return io_engine_->start_external();
+}
+
+int uvgrtp::context::get_event_fd() const
+{
+    return io_engine_->get_event_fd();
+}
+
+size_t uvgrtp::context::process_events(size_t budget)
+{
+    return io_engine_->process_events(budget);
+}
+
+rtp_error_t uvgrtp::context::set_receive_shards(size_t shards)
+{
+    if (shards == 0 || shards > uvgrtp::MAX_RECEIVE_SHARDS)
+        return RTP_INVALID_VALUE;
+
+#ifdef __linux__
+    sfp_->set_receive_shards(shards);
+    return RTP_OK;
+#else
+    UVG_LOG_ERROR("Receive shards are only supported on Linux");
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+rtp_error_t uvgrtp::context::set_transport(int transport)
+{
+    if (transport != RTP_TRANSPORT_UDP && transport != RTP_TRANSPORT_MEMORY && transport != RTP_TRANSPORT_XDP &&
+        transport != RTP_TRANSPORT_SHARED_MEMORY)
+        return RTP_INVALID_VALUE;
+
+#ifdef __linux__
+    if (transport == RTP_TRANSPORT_XDP && !xdp_device_) {
+        if (xdp_interface_.empty()) {
+            UVG_LOG_ERROR("Select the interface of AF_XDP with set_xdp_interface() first");
+            return RTP_INVALID_VALUE;
+        }
+
+        std::shared_ptr<uvgrtp::xdp_device> device = std::make_shared<uvgrtp::xdp_device>();
+
+        rtp_error_t ret = device->init(xdp_interface_, xdp_queue_, thread_settings_);
+        if (ret != RTP_OK)
+            return ret;
+
+        xdp_device_ = device;
+        sfp_->set_xdp_device(xdp_device_);
+    }
+
+    sfp_->set_transport(transport);
+    return RTP_OK;
+#else
+    if (transport == RTP_TRANSPORT_UDP)
+        return RTP_OK;
+
+    UVG_LOG_ERROR("The memory transport and AF_XDP are only supported on Linux");
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+rtp_error_t uvgrtp::context::set_impairment(const uvgrtp::impairment& config)
+{
+    for (double probability : { config.good_to_bad, config.bad_to_good, config.loss_good, config.loss_bad,
+            config.duplicate, config.reorder }) {
+        if (!(probability >= 0 && probability <= 1))
+            return RTP_INVALID_VALUE;
+    }
+
+#ifdef __linux__
+    sfp_->set_impairment(config);
+    return RTP_OK;
+#else
+    UVG_LOG_ERROR("The memory transport is only supported on Linux");
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+rtp_error_t uvgrtp::context::set_xdp_interface(const std::string& interface, unsigned int queue)
+{
+    xdp_interface_ = interface;
+    xdp_queue_     = queue;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::context::configure_threads(int type, const uvgrtp::thread_config& config)
+{
+    if (type < RTP_THREAD_RECEIVER || type >= RTP_THREAD_LAST) {
+        UVG_LOG_ERROR("Unknown thread type %d", type);
+        return RTP_INVALID_VALUE;
+    }
+
+    rtp_error_t ret = uvgrtp::thread_settings::check(config);
+    if (ret != RTP_OK)
+        return ret;
+
+    thread_settings_->set(type, config);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::context::configure_sockets(int type, const uvgrtp::socket_profile& profile)
+{
+    if (type < RTP_SOCKET_AUDIO || type >= RTP_SOCKET_LAST) {
+        UVG_LOG_ERROR("Unknown socket type %d", type);
+        return RTP_INVALID_VALUE;
+    }
+
+    if (profile.busy_poll_us < 0 || profile.dscp < -1 || profile.dscp > 63 || profile.priority < -1) {
+        UVG_LOG_ERROR("Invalid socket profile");
+        return RTP_INVALID_VALUE;
+    }
+
+    sfp_->set_socket_profile(type, profile);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::context::set_clock_flags(int flags)
+{
+    if (flags < 0 || flags >= RTP_CLOCK_LAST) {
+        UVG_LOG_ERROR("Unknown clock flags %d", flags);
+        return RTP_INVALID_VALUE;
+    }
+
+    uvgrtp::clock::set_flags(flags);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::context::install_trace_hook(void *arg, void (*hook)(void *, const uvgrtp::trace_event *))
+{
+    rtp_error_t ret = uvgrtp::trace::install_hook(arg, hook);
+
+    if (ret == RTP_NOT_SUPPORTED)
+        UVG_LOG_ERROR("uvgRTP has been built without UVGRTP_ENABLE_TRACING");
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::context::push_audio_frames(uvgrtp::media_stream **streams, uint8_t **frames, size_t *sizes,
+    const uint32_t *timestamps, size_t count)
+{
+    return audio_batch_->push(streams, frames, sizes, timestamps, count);
+}
+
+rtp_error_t uvgrtp::context::set_memory_budget(size_t bytes)
+{
+    memory_budget_->set_limit(bytes);
+    return RTP_OK;
+}
+
+size_t uvgrtp::context::get_memory_usage() const
+{
+    return memory_budget_->used();
+}
+
+rtp_error_t uvgrtp::context::set_zrtp_cache_file(std::string path)
+{
+    auto cache = std::make_shared<uvgrtp::zrtp_file_cache>(path);
+    rtp_error_t ret = cache->load();
+
+    if (ret != RTP_OK)
+        return ret;
+
+    return set_zrtp_cache(cache);
+}
+
+rtp_error_t uvgrtp::context::set_zrtp_cache(std::shared_ptr<uvgrtp::zrtp_cache> cache)
+{
+    sfp_->set_zrtp_cache(cache);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::context::set_zrtp_ec25(bool enable)
+{
+    if (!crypto_enabled()) {
+        UVG_LOG_ERROR("uvgRTP has been built without Crypto++, ZRTP is not available");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    sfp_->set_zrtp_ec25(enable);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::context::set_zrtp_key_pool(size_t size)
+{
+    if (!crypto_enabled()) {
+        UVG_LOG_ERROR("uvgRTP has been built without Crypto++, ZRTP key pool is not available");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    /* Sessions that have already taken the old pool keep it until they are destroyed */
+    sfp_->set_key_pool(size ? std::make_shared<uvgrtp::key_pool>(size) : nullptr);
+    return RTP_OK;
 }
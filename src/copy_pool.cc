@@ -0,0 +1,145 @@
+#include "copy_pool.hh"
+
+#include "arena.hh"
+#include "debug.hh"
+
+#include <new>
+
+/* Every buffer starts with a prefix telling how it was allocated. The prefix is counted in
+ * the size of the class and is a cache line long to keep the copy aligned */
+constexpr size_t COPY_PREFIX_SIZE = uvgrtp::CACHE_LINE_SIZE;
+constexpr uint32_t NO_CLASS       = UINT32_MAX;
+constexpr size_t COPY_CLASSES     = uvgrtp::COPY_POOL_MAX_SHIFT - uvgrtp::COPY_POOL_MIN_SHIFT + 1;
+
+namespace {
+    struct copy_prefix {
+        uint32_t size_class;
+
+        // the mapping of a large buffer, nullptr if the buffer is from the heap
+        uvgrtp::arena *mapping;
+    };
+
+    static_assert(sizeof(copy_prefix) <= COPY_PREFIX_SIZE, "the prefix must fit before the copy");
+
+    uint32_t size_class(size_t len)
+    {
+        for (uint32_t c = 0; c < COPY_CLASSES; ++c) {
+            if (len + COPY_PREFIX_SIZE <= ((size_t)1 << (c + uvgrtp::COPY_POOL_MIN_SHIFT)))
+                return c;
+        }
+        return NO_CLASS;
+    }
+}
+
+void uvgrtp::copy_pool_deleter::operator()(uint8_t *buffer) const
+{
+    if (buffer && pool)
+        pool->release(buffer);
+}
+
+uvgrtp::copy_pool::copy_pool() :
+    allocated_(0),
+    reused_(0)
+{
+}
+
+uvgrtp::copy_pool::~copy_pool()
+{
+    for (auto& buffers : free_) {
+        for (uint8_t *memory : buffers) {
+            deallocate(memory);
+        }
+    }
+}
+
+uvgrtp::pooled_buffer uvgrtp::copy_pool::alloc(size_t len)
+{
+    uint32_t c = size_class(len);
+    uint8_t *memory = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (c != NO_CLASS && !free_[c].empty()) {
+            memory = free_[c].back();
+            free_[c].pop_back();
+            ++reused_;
+        } else {
+            ++allocated_;
+        }
+    }
+
+    if (!memory) {
+        size_t size = c != NO_CLASS ? (size_t)1 << (c + COPY_POOL_MIN_SHIFT) : COPY_PREFIX_SIZE + len;
+
+        if (!(memory = allocate(size, c)))
+            return pooled_buffer(nullptr, copy_pool_deleter{ nullptr });
+    }
+
+    return pooled_buffer(memory + COPY_PREFIX_SIZE, copy_pool_deleter{ shared_from_this() });
+}
+
+void uvgrtp::copy_pool::release(uint8_t *buffer)
+{
+    uint8_t *memory = buffer - COPY_PREFIX_SIZE;
+    uint32_t c = ((copy_prefix *)memory)->size_class;
+
+    if (c != NO_CLASS) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (free_[c].size() < COPY_POOL_FREE_BUFFERS) {
+            free_[c].push_back(memory);
+            return;
+        }
+    }
+
+    deallocate(memory);
+}
+
+size_t uvgrtp::copy_pool::allocated() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return allocated_;
+}
+
+size_t uvgrtp::copy_pool::reused() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reused_;
+}
+
+uint8_t *uvgrtp::copy_pool::allocate(size_t size, uint32_t size_class)
+{
+    uvgrtp::arena *mapping = nullptr;
+    uint8_t *memory = nullptr;
+
+    if (size >= HUGE_PAGE_SIZE) {
+        mapping = new (std::nothrow) uvgrtp::arena();
+
+        if (mapping && !(memory = mapping->allocate(size))) {
+            delete mapping;
+            mapping = nullptr;
+        }
+    }
+
+    if (!memory && !(memory = (uint8_t *)::operator new[](size, std::align_val_t(CACHE_LINE_SIZE), std::nothrow))) {
+        UVG_LOG_ERROR("Failed to allocate %zu bytes for a copy of a frame", size);
+        return nullptr;
+    }
+
+    copy_prefix *prefix = (copy_prefix *)memory;
+    prefix->size_class  = size_class;
+    prefix->mapping     = mapping;
+    return memory;
+}
+
+void uvgrtp::copy_pool::deallocate(uint8_t *memory)
+{
+    uvgrtp::arena *mapping = ((copy_prefix *)memory)->mapping;
+
+    // the prefix is in the mapping
+    if (mapping)
+        delete mapping;
+    else
+        ::operator delete[](memory, std::align_val_t(uvgrtp::CACHE_LINE_SIZE));
+}
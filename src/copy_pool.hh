@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* The smallest and the largest size class of the copy pool as powers of two. Copies larger
+     * than the largest class are allocated and freed each time */
+    constexpr size_t COPY_POOL_MIN_SHIFT = 12;
+    constexpr size_t COPY_POOL_MAX_SHIFT = 26;
+
+    /* How many free buffers a size class keeps for reuse */
+    constexpr size_t COPY_POOL_FREE_BUFFERS = 4;
+
+    class copy_pool;
+
+    /* Gives a buffer of the copy pool back to it. The pool stays alive while it has buffers out */
+    struct copy_pool_deleter {
+        std::shared_ptr<copy_pool> pool;
+
+        void operator()(uint8_t *buffer) const;
+    };
+
+    typedef std::unique_ptr<uint8_t[], copy_pool_deleter> pooled_buffer;
+
+    /* The buffers of the frames a stream copies with RTP_COPY.
+     *
+     * The buffers are kept in power-of-two size classes, so a stream that pushes frames of about
+     * the same size gets the buffers of its earlier frames back once they have been sent, instead
+     * of going to the system allocator and faulting in fresh pages for every frame. A buffer of a
+     * huge page or more is a uvgrtp::arena, so it is backed by huge pages where the system allows
+     * it. Each buffer has a hidden prefix telling how it was allocated, like the payloads of
+     * uvgrtp::frame_pool. The pool may be used from any thread */
+    class copy_pool : public std::enable_shared_from_this<copy_pool> {
+        public:
+            copy_pool();
+            ~copy_pool();
+
+            copy_pool(const copy_pool&) = delete;
+            copy_pool& operator=(const copy_pool&) = delete;
+
+            /* A buffer of at least "len" bytes, returned to the pool when it is destroyed
+             *
+             * Return nullptr if the memory could not be allocated */
+            pooled_buffer alloc(size_t len);
+
+            /* How many buffers have been allocated from the system and how many have been reused */
+            size_t allocated() const;
+            size_t reused() const;
+
+        private:
+            friend struct copy_pool_deleter;
+
+            /* Keep "buffer" for reuse or free it if its class is full */
+            void release(uint8_t *buffer);
+
+            /* Get "size" bytes of "size_class" from the system, the prefix included, nullptr on failure */
+            static uint8_t *allocate(size_t size, uint32_t size_class);
+            static void deallocate(uint8_t *memory);
+
+            mutable std::mutex mutex_;
+            std::vector<uint8_t *> free_[COPY_POOL_MAX_SHIFT - COPY_POOL_MIN_SHIFT + 1];
+
+            size_t allocated_;
+            size_t reused_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
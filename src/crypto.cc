@@ -2,6 +2,11 @@
 
 #include "debug.hh"
 
+#include <algorithm>
+#include <cstring>
+
+// the OpenSSL backend is in crypto_openssl.cc
+#if !defined(UVGRTP_CRYPTO_OPENSSL) || defined(__RTP_NO_CRYPTO__)
 
 /* ***************** hmac-sha1 ***************** */
 
@@ -19,6 +24,10 @@ uvgrtp::crypto::hmac::sha1::~sha1()
 {
 }
 
+uvgrtp::crypto::hmac::sha1::sha1(const sha1& other) = default;
+
+uvgrtp::crypto::hmac::sha1& uvgrtp::crypto::hmac::sha1::operator=(const sha1& other) = default;
+
 void uvgrtp::crypto::hmac::sha1::update(const uint8_t *data, size_t len)
 {
 #ifdef __RTP_CRYPTO__
@@ -74,6 +83,10 @@ uvgrtp::crypto::hmac::sha256::~sha256()
 {
 }
 
+uvgrtp::crypto::hmac::sha256::sha256(const sha256& other) = default;
+
+uvgrtp::crypto::hmac::sha256& uvgrtp::crypto::hmac::sha256::operator=(const sha256& other) = default;
+
 void uvgrtp::crypto::hmac::sha256::update(const uint8_t *data, size_t len)
 {
 #ifdef __RTP_CRYPTO__
@@ -148,10 +161,39 @@ uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size, const uint8_t
 #endif
 }
 
+uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size)
+#ifdef __RTP_CRYPTO__
+    :enc_(),
+    dec_()
+#endif
+{
+#ifdef __RTP_CRYPTO__
+    const uint8_t iv[CryptoPP::AES::BLOCKSIZE] = { 0 };
+
+    enc_.SetKeyWithIV(key, key_size, iv, sizeof(iv));
+    dec_.SetKeyWithIV(key, key_size, iv, sizeof(iv));
+#else
+    (void)key, (void)key_size;
+#endif
+}
+
 uvgrtp::crypto::aes::ctr::~ctr()
 {
 }
 
+void uvgrtp::crypto::aes::ctr::resynchronize(const uint8_t *iv)
+{
+#ifdef __RTP_CRYPTO__
+    enc_.Resynchronize(iv, CryptoPP::AES::BLOCKSIZE);
+    dec_.Resynchronize(iv, CryptoPP::AES::BLOCKSIZE);
+#else
+    (void)iv;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
 void uvgrtp::crypto::aes::ctr::encrypt(uint8_t *output, const uint8_t *input, size_t len)
 {
 #ifdef __RTP_CRYPTO__
@@ -176,6 +218,82 @@ void uvgrtp::crypto::aes::ctr::decrypt(uint8_t *output, const uint8_t *input, si
 #endif
 }
 
+/* ***************** aes-gcm ***************** */
+
+uvgrtp::crypto::aes::gcm::gcm(const uint8_t *key, size_t key_size)
+#ifdef __RTP_CRYPTO__
+    :enc_(),
+    dec_()
+#endif
+{
+#ifdef __RTP_CRYPTO__
+    /* GCM requires an IV with the key, the real one is given with each message */
+    const uint8_t iv[12] = { 0 };
+
+    enc_.SetKeyWithIV(key, key_size, iv, sizeof(iv));
+    dec_.SetKeyWithIV(key, key_size, iv, sizeof(iv));
+#else
+    (void)key, (void)key_size;
+#endif
+}
+
+uvgrtp::crypto::aes::gcm::~gcm()
+{
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt(const uint8_t *iv, size_t iv_len, const uint8_t *aad, size_t aad_len,
+    uint8_t *data, size_t len, uint8_t *tag, size_t tag_len)
+{
+#ifdef __RTP_CRYPTO__
+    enc_.Resynchronize(iv, (int)iv_len);
+    enc_.Update(aad, aad_len);
+    enc_.ProcessData(data, data, len);
+    enc_.TruncatedFinal(tag, tag_len);
+#else
+    (void)iv, (void)iv_len, (void)aad, (void)aad_len;
+    (void)data, (void)len, (void)tag, (void)tag_len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt(const uint8_t *iv, size_t iv_len, const std::vector<std::pair<size_t, uint8_t *>>& aad,
+    uint8_t *data, size_t len, uint8_t *tag, size_t tag_len)
+{
+#ifdef __RTP_CRYPTO__
+    enc_.Resynchronize(iv, (int)iv_len);
+    for (auto& buffer : aad) {
+        enc_.Update(buffer.second, buffer.first);
+    }
+    enc_.ProcessData(data, data, len);
+    enc_.TruncatedFinal(tag, tag_len);
+#else
+    (void)iv, (void)iv_len, (void)aad;
+    (void)data, (void)len, (void)tag, (void)tag_len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+bool uvgrtp::crypto::aes::gcm::decrypt(const uint8_t *iv, size_t iv_len, const uint8_t *aad, size_t aad_len,
+    uint8_t *data, size_t len, const uint8_t *tag, size_t tag_len)
+{
+#ifdef __RTP_CRYPTO__
+    dec_.Resynchronize(iv, (int)iv_len);
+    dec_.Update(aad, aad_len);
+    dec_.ProcessData(data, data, len);
+    return dec_.TruncatedVerify(tag, tag_len);
+#else
+    (void)iv, (void)iv_len, (void)aad, (void)aad_len;
+    (void)data, (void)len, (void)tag, (void)tag_len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
 uvgrtp::crypto::aes::cfb::cfb(const uint8_t *key, size_t key_size, const uint8_t *iv)
 #ifdef __RTP_CRYPTO__
     :enc_(key, key_size, iv),
@@ -368,6 +486,78 @@ void uvgrtp::crypto::dh::get_shared_secret(uint8_t *ss, size_t len)
 #endif
 }
 
+/* ***************** elliptic-curve diffie-hellman P-256 ***************** */
+
+uvgrtp::crypto::ecdh::ecdh()
+#ifdef __RTP_CRYPTO__
+    :prng_(),
+    dh_(CryptoPP::ASN1::secp256r1()),
+    sk_(dh_.PrivateKeyLength()),
+    pk_(dh_.PublicKeyLength()),
+    rpk_(dh_.PublicKeyLength())
+#endif
+{
+}
+
+uvgrtp::crypto::ecdh::~ecdh()
+{
+}
+
+void uvgrtp::crypto::ecdh::generate_keys()
+{
+#ifdef __RTP_CRYPTO__
+    dh_.GenerateKeyPair(prng_, sk_, pk_);
+#else
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+void uvgrtp::crypto::ecdh::get_pk(uint8_t *pk, size_t len)
+{
+#ifdef __RTP_CRYPTO__
+    // the point is encoded uncompressed, 0x04 || X || Y, and ZRTP leaves out the 0x04
+    memcpy(pk, pk_.data() + 1, std::min(len, pk_.size() - 1));
+#else
+    (void)pk, (void)len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+void uvgrtp::crypto::ecdh::set_remote_pk(uint8_t *pk, size_t len)
+{
+#ifdef __RTP_CRYPTO__
+    rpk_[0] = 0x04;
+    memcpy(rpk_.data() + 1, pk, std::min(len, rpk_.size() - 1));
+#else
+    (void)pk, (void)len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+bool uvgrtp::crypto::ecdh::get_shared_secret(uint8_t *ss, size_t len)
+{
+#ifdef __RTP_CRYPTO__
+    CryptoPP::SecByteBlock shared(dh_.AgreedValueLength());
+
+    // Agree() checks that the remote public key is a valid point
+    if (!dh_.Agree(shared, sk_, rpk_))
+        return false;
+
+    memcpy(ss, shared.data(), std::min(len, shared.size()));
+    return true;
+#else
+    (void)ss, (void)len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
 /* ***************** base32 ***************** */
 uvgrtp::crypto::b32::b32()
 #ifdef __RTP_CRYPTO__
@@ -475,3 +665,5 @@ bool uvgrtp::crypto::enabled()
     return false;
 #endif
 }
+
+#endif
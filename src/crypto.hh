@@ -1,10 +1,27 @@
 #pragma once
 
-#if __cplusplus >= 201703L || _MSC_VER >= 1911
+#if defined(UVGRTP_CRYPTO_OPENSSL) && !defined(__RTP_NO_CRYPTO__)
+
+/* The OpenSSL backend, selected with UVGRTP_USE_OPENSSL. The same code builds against BoringSSL.
+ * HMAC_CTX and EC_KEY are deprecated in OpenSSL 3 but they are the API the two libraries share */
+#define __RTP_CRYPTO__
+
+#ifndef OPENSSL_SUPPRESS_DEPRECATED
+#define OPENSSL_SUPPRESS_DEPRECATED
+#endif
+
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#elif __cplusplus >= 201703L || _MSC_VER >= 1911
 #if __has_include(<cryptopp/aes.h>) && \
     __has_include(<cryptopp/base32.h>) && \
     __has_include(<cryptopp/cryptlib.h>) && \
     __has_include(<cryptopp/dh.h>) && \
+    __has_include(<cryptopp/eccrypto.h>) && \
+    __has_include(<cryptopp/gcm.h>) && \
     __has_include(<cryptopp/hmac.h>) && \
     __has_include(<cryptopp/modes.h>) && \
     __has_include(<cryptopp/osrng.h>) && \
@@ -18,9 +35,12 @@
 #include <cryptopp/base32.h>
 #include <cryptopp/cryptlib.h>
 #include <cryptopp/dh.h>
+#include <cryptopp/eccrypto.h>
+#include <cryptopp/gcm.h>
 #include <cryptopp/hmac.h>
 #include <cryptopp/modes.h>
 #include <cryptopp/osrng.h>
+#include <cryptopp/oids.h>
 #include <cryptopp/sha.h>
 #include <cryptopp/crc.h>
 
@@ -33,9 +53,12 @@
 #include <cryptopp/base32.h>
 #include <cryptopp/cryptlib.h>
 #include <cryptopp/dh.h>
+#include <cryptopp/eccrypto.h>
+#include <cryptopp/gcm.h>
 #include <cryptopp/hmac.h>
 #include <cryptopp/modes.h>
 #include <cryptopp/osrng.h>
+#include <cryptopp/oids.h>
 #include <cryptopp/sha.h>
 #include <cryptopp/crc.h>
 
@@ -43,6 +66,7 @@
 #endif // __cplusplus
 
 #include <iostream>
+#include <vector>
 
 namespace uvgrtp {
 
@@ -55,6 +79,9 @@ namespace uvgrtp {
                     sha1(const uint8_t *key, size_t key_size);
                     ~sha1();
 
+                    sha1(const sha1& other);
+                    sha1& operator=(const sha1& other);
+
                     void update(const uint8_t *data, size_t len);
                     void final(uint8_t *digest);
 
@@ -62,7 +89,9 @@ namespace uvgrtp {
                     void final(uint8_t *digest, size_t size);
 
                 private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO__) && defined(UVGRTP_CRYPTO_OPENSSL)
+                    HMAC_CTX *ctx_;
+#elif defined(__RTP_CRYPTO__)
                     CryptoPP::HMAC<CryptoPP::SHA1> hmac_;
 #endif
             };
@@ -72,11 +101,17 @@ namespace uvgrtp {
                     sha256(const uint8_t *key, size_t key_size);
                     ~sha256();
 
+                    /* ZRTP reuses one variable for the MACs of different keys */
+                    sha256(const sha256& other);
+                    sha256& operator=(const sha256& other);
+
                     void update(const uint8_t *data, size_t len);
                     void final(uint8_t *digest);
 
                 private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO__) && defined(UVGRTP_CRYPTO_OPENSSL)
+                    HMAC_CTX *ctx_;
+#elif defined(__RTP_CRYPTO__)
                     CryptoPP::HMAC<CryptoPP::SHA256> hmac_;
 #endif
             };
@@ -87,11 +122,16 @@ namespace uvgrtp {
                 sha256();
                 ~sha256();
 
+                sha256(const sha256&) = delete;
+                sha256& operator=(const sha256&) = delete;
+
                 void update(const uint8_t *data, size_t len);
                 void final(uint8_t *digest);
 
             private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO__) && defined(UVGRTP_CRYPTO_OPENSSL)
+                EVP_MD_CTX *ctx_;
+#elif defined(__RTP_CRYPTO__)
                 CryptoPP::SHA256 sha_;
 #endif
         };
@@ -103,11 +143,17 @@ namespace uvgrtp {
                     ecb(const uint8_t *key, size_t key_size);
                     ~ecb();
 
+                    ecb(const ecb&) = delete;
+                    ecb& operator=(const ecb&) = delete;
+
                     void encrypt(uint8_t *output, const uint8_t *input, size_t len);
                     void decrypt(uint8_t *output, const uint8_t *input, size_t len);
 
                 private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO__) && defined(UVGRTP_CRYPTO_OPENSSL)
+                    EVP_CIPHER_CTX *enc_;
+                    EVP_CIPHER_CTX *dec_;
+#elif defined(__RTP_CRYPTO__)
                     CryptoPP::ECB_Mode<CryptoPP::AES>::Encryption enc_;
                     CryptoPP::ECB_Mode<CryptoPP::AES>::Decryption dec_;
 #endif
@@ -118,11 +164,17 @@ namespace uvgrtp {
                     cfb(const uint8_t *key, size_t key_size, const uint8_t *iv);
                     ~cfb();
 
+                    cfb(const cfb&) = delete;
+                    cfb& operator=(const cfb&) = delete;
+
                     void encrypt(uint8_t *output, const uint8_t *input, size_t len);
                     void decrypt(uint8_t *output, const uint8_t *input, size_t len);
 
                 private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO__) && defined(UVGRTP_CRYPTO_OPENSSL)
+                    EVP_CIPHER_CTX *enc_;
+                    EVP_CIPHER_CTX *dec_;
+#elif defined(__RTP_CRYPTO__)
                     CryptoPP::CFB_Mode<CryptoPP::AES>::Encryption enc_;
                     CryptoPP::CFB_Mode<CryptoPP::AES>::Decryption dec_;
 #endif
@@ -131,15 +183,65 @@ namespace uvgrtp {
             class ctr {
                 public:
                     ctr(const uint8_t *key, size_t key_size, const uint8_t *iv);
+
+                    /* Expand the key only, the IV of each message is given to resynchronize() */
+                    ctr(const uint8_t *key, size_t key_size);
                     ~ctr();
 
+                    ctr(const ctr&) = delete;
+                    ctr& operator=(const ctr&) = delete;
+
+                    /* Restart the key stream from "iv" without expanding the key again */
+                    void resynchronize(const uint8_t *iv);
+
                     void encrypt(uint8_t *output, const uint8_t *input, size_t len);
                     void decrypt(uint8_t *output, const uint8_t *input, size_t len);
 
                 private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO__) && defined(UVGRTP_CRYPTO_OPENSSL)
+                    /* the key stream is the same in both directions, so one context serves both */
+                    EVP_CIPHER_CTX *ctx_;
+#elif defined(__RTP_CRYPTO__)
                     CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption enc_;
                     CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption dec_;
+#endif
+            };
+
+            /* Authenticated encryption, the key is set once and each message
+             * only gives its IV. Both backends use AES-NI and PCLMULQDQ when available */
+            class gcm {
+                public:
+                    gcm(const uint8_t *key, size_t key_size);
+                    ~gcm();
+
+                    gcm(const gcm&) = delete;
+                    gcm& operator=(const gcm&) = delete;
+
+                    /* Encrypt "len" bytes of "data" in place and write the tag
+                     * of "tag_len" bytes that authenticates "aad" and the ciphertext */
+                    void encrypt(const uint8_t *iv, size_t iv_len, const uint8_t *aad, size_t aad_len,
+                        uint8_t *data, size_t len, uint8_t *tag, size_t tag_len);
+
+                    /* Gather version of encrypt(), the additional data is the concatenation
+                     * of the "aad" buffers */
+                    void encrypt(const uint8_t *iv, size_t iv_len, const std::vector<std::pair<size_t, uint8_t *>>& aad,
+                        uint8_t *data, size_t len, uint8_t *tag, size_t tag_len);
+
+                    /* Decrypt "len" bytes of "data" in place
+                     *
+                     * Return true if "tag" matches "aad" and the ciphertext */
+                    bool decrypt(const uint8_t *iv, size_t iv_len, const uint8_t *aad, size_t aad_len,
+                        uint8_t *data, size_t len, const uint8_t *tag, size_t tag_len);
+
+                private:
+#if defined(__RTP_CRYPTO__) && defined(UVGRTP_CRYPTO_OPENSSL)
+                    EVP_CIPHER_CTX *enc_;
+                    EVP_CIPHER_CTX *dec_;
+                    size_t enc_iv_len_;
+                    size_t dec_iv_len_;
+#elif defined(__RTP_CRYPTO__)
+                    CryptoPP::GCM<CryptoPP::AES>::Encryption enc_;
+                    CryptoPP::GCM<CryptoPP::AES>::Decryption dec_;
 #endif
             };
         }
@@ -150,29 +252,69 @@ namespace uvgrtp {
                 dh();
                 ~dh();
 
+                dh(const dh&) = delete;
+                dh& operator=(const dh&) = delete;
+
                 void generate_keys();
                 void get_pk(uint8_t *pk, size_t len);
                 void set_remote_pk(uint8_t *pk, size_t len);
                 void get_shared_secret(uint8_t *ss, size_t len);
 
             private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO__) && defined(UVGRTP_CRYPTO_OPENSSL)
+                BN_CTX *bn_ctx_;
+                BN_MONT_CTX *mont_;
+                BIGNUM *p_, *g_, *sk_, *pk_, *rpk_;
+#elif defined(__RTP_CRYPTO__)
                 CryptoPP::AutoSeededRandomPool prng_;
                 CryptoPP::DH dh_;
                 CryptoPP::Integer sk_, pk_, rpk_;
 #endif
         };
 
+        /* elliptic-curve diffie-hellman key derivation on NIST P-256
+         *
+         * The public key is the 64-byte X || Y of the point and the shared
+         * secret is the 32-byte X coordinate, as ZRTP key agreement EC25 expects */
+        class ecdh {
+            public:
+                ecdh();
+                ~ecdh();
+
+                ecdh(const ecdh&) = delete;
+                ecdh& operator=(const ecdh&) = delete;
+
+                void generate_keys();
+                void get_pk(uint8_t *pk, size_t len);
+                void set_remote_pk(uint8_t *pk, size_t len);
+
+                /* Return false if the remote public key is not a point on the curve */
+                bool get_shared_secret(uint8_t *ss, size_t len);
+
+            private:
+#if defined(__RTP_CRYPTO__) && defined(UVGRTP_CRYPTO_OPENSSL)
+                EC_KEY *key_;
+                uint8_t rpk_[65];
+#elif defined(__RTP_CRYPTO__)
+                CryptoPP::AutoSeededRandomPool prng_;
+                CryptoPP::ECDH<CryptoPP::ECP>::Domain dh_;
+                CryptoPP::SecByteBlock sk_, pk_, rpk_;
+#endif
+        };
+
         /* base32 */
         class b32 {
             public:
                 b32();
                 ~b32();
 
+                b32(const b32&) = delete;
+                b32& operator=(const b32&) = delete;
+
                 void encode(const uint8_t *input, uint8_t *output, size_t len);
 
             private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO__) && !defined(UVGRTP_CRYPTO_OPENSSL)
                 CryptoPP::Base32Encoder enc_;
 #endif
         };
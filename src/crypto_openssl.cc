@@ -0,0 +1,540 @@
+#include "crypto.hh"
+
+#include "debug.hh"
+
+#if defined(UVGRTP_CRYPTO_OPENSSL) && !defined(__RTP_NO_CRYPTO__)
+
+#include <openssl/ecdh.h>
+#include <openssl/obj_mac.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+/* The contexts are allocated and keyed once in the constructors. Each message
+ * only resets the IV or the state, so the key schedule is never computed again */
+
+namespace {
+    const EVP_CIPHER *aes_ecb(size_t key_size)
+    {
+        return key_size == 32 ? EVP_aes_256_ecb() : key_size == 24 ? EVP_aes_192_ecb() : EVP_aes_128_ecb();
+    }
+
+    const EVP_CIPHER *aes_cfb(size_t key_size)
+    {
+        return key_size == 32 ? EVP_aes_256_cfb128() : key_size == 24 ? EVP_aes_192_cfb128() : EVP_aes_128_cfb128();
+    }
+
+    const EVP_CIPHER *aes_ctr(size_t key_size)
+    {
+        return key_size == 32 ? EVP_aes_256_ctr() : key_size == 24 ? EVP_aes_192_ctr() : EVP_aes_128_ctr();
+    }
+
+    const EVP_CIPHER *aes_gcm(size_t key_size)
+    {
+        return key_size == 32 ? EVP_aes_256_gcm() : key_size == 24 ? EVP_aes_192_gcm() : EVP_aes_128_gcm();
+    }
+
+    /* The contexts cannot fail once they are keyed, so a failure here means the library is broken */
+    void check(int ret, const char *what)
+    {
+        if (ret <= 0) {
+            UVG_LOG_ERROR("OpenSSL failed: %s", what);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    void cipher(EVP_CIPHER_CTX *ctx, uint8_t *output, const uint8_t *input, size_t len)
+    {
+        int out_len = 0;
+
+        if (len > 0)
+            check(EVP_CipherUpdate(ctx, output, &out_len, input, (int)len), "EVP_CipherUpdate");
+    }
+
+    /* Restart the GCM context "ctx" with "iv". The IV length is changed only if it differs from the previous message */
+    void gcm_start(EVP_CIPHER_CTX *ctx, size_t& ctx_iv_len, const uint8_t *iv, size_t iv_len)
+    {
+        if (iv_len != ctx_iv_len) {
+            check(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, (int)iv_len, nullptr), "EVP_CTRL_GCM_SET_IVLEN");
+            ctx_iv_len = iv_len;
+        }
+        check(EVP_CipherInit_ex(ctx, nullptr, nullptr, nullptr, iv, -1), "EVP_CipherInit_ex");
+    }
+
+    void gcm_aad(EVP_CIPHER_CTX *ctx, const uint8_t *aad, size_t aad_len)
+    {
+        int out_len = 0;
+
+        if (aad_len > 0)
+            check(EVP_CipherUpdate(ctx, nullptr, &out_len, aad, (int)aad_len), "EVP_CipherUpdate");
+    }
+
+    void gcm_tag(EVP_CIPHER_CTX *ctx, uint8_t *end, uint8_t *tag, size_t tag_len)
+    {
+        int out_len = 0;
+
+        check(EVP_CipherFinal_ex(ctx, end, &out_len), "EVP_CipherFinal_ex");
+        check(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, (int)tag_len, tag), "EVP_CTRL_GCM_GET_TAG");
+    }
+
+    /* CRC-32 of IEEE 802.3, the same checksum that the Crypto++ backend computes */
+    const std::array<uint32_t, 256>& crc32_table()
+    {
+        static const std::array<uint32_t, 256> table = [] {
+            std::array<uint32_t, 256> t = {};
+
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+
+        return table;
+    }
+}
+
+/* ***************** hmac-sha1 ***************** */
+
+uvgrtp::crypto::hmac::sha1::sha1(const uint8_t *key, size_t key_size) :
+    ctx_(HMAC_CTX_new())
+{
+    check(ctx_ != nullptr, "HMAC_CTX_new");
+    check(HMAC_Init_ex(ctx_, key, (int)key_size, EVP_sha1(), nullptr), "HMAC_Init_ex");
+}
+
+uvgrtp::crypto::hmac::sha1::~sha1()
+{
+    HMAC_CTX_free(ctx_);
+}
+
+uvgrtp::crypto::hmac::sha1::sha1(const sha1& other) :
+    ctx_(HMAC_CTX_new())
+{
+    check(ctx_ && HMAC_CTX_copy(ctx_, other.ctx_), "HMAC_CTX_copy");
+}
+
+uvgrtp::crypto::hmac::sha1& uvgrtp::crypto::hmac::sha1::operator=(const sha1& other)
+{
+    if (this != &other)
+        check(HMAC_CTX_copy(ctx_, other.ctx_), "HMAC_CTX_copy");
+
+    return *this;
+}
+
+void uvgrtp::crypto::hmac::sha1::update(const uint8_t *data, size_t len)
+{
+    check(HMAC_Update(ctx_, data, len), "HMAC_Update");
+}
+
+void uvgrtp::crypto::hmac::sha1::final(uint8_t *digest)
+{
+    check(HMAC_Final(ctx_, digest, nullptr), "HMAC_Final");
+
+    // restart with the same key, as the Crypto++ backend does
+    check(HMAC_Init_ex(ctx_, nullptr, 0, nullptr, nullptr), "HMAC_Init_ex");
+}
+
+void uvgrtp::crypto::hmac::sha1::final(uint8_t *digest, size_t size)
+{
+    uint8_t d[20] = { 0 };
+
+    final(d);
+    memcpy(digest, d, size);
+}
+
+/* ***************** hmac-sha256 ***************** */
+
+uvgrtp::crypto::hmac::sha256::sha256(const uint8_t *key, size_t key_size) :
+    ctx_(HMAC_CTX_new())
+{
+    check(ctx_ != nullptr, "HMAC_CTX_new");
+    check(HMAC_Init_ex(ctx_, key, (int)key_size, EVP_sha256(), nullptr), "HMAC_Init_ex");
+}
+
+uvgrtp::crypto::hmac::sha256::~sha256()
+{
+    HMAC_CTX_free(ctx_);
+}
+
+uvgrtp::crypto::hmac::sha256::sha256(const sha256& other) :
+    ctx_(HMAC_CTX_new())
+{
+    check(ctx_ && HMAC_CTX_copy(ctx_, other.ctx_), "HMAC_CTX_copy");
+}
+
+uvgrtp::crypto::hmac::sha256& uvgrtp::crypto::hmac::sha256::operator=(const sha256& other)
+{
+    if (this != &other)
+        check(HMAC_CTX_copy(ctx_, other.ctx_), "HMAC_CTX_copy");
+
+    return *this;
+}
+
+void uvgrtp::crypto::hmac::sha256::update(const uint8_t *data, size_t len)
+{
+    check(HMAC_Update(ctx_, data, len), "HMAC_Update");
+}
+
+void uvgrtp::crypto::hmac::sha256::final(uint8_t *digest)
+{
+    check(HMAC_Final(ctx_, digest, nullptr), "HMAC_Final");
+    check(HMAC_Init_ex(ctx_, nullptr, 0, nullptr, nullptr), "HMAC_Init_ex");
+}
+
+/* ***************** sha256 ***************** */
+
+uvgrtp::crypto::sha256::sha256() :
+    ctx_(EVP_MD_CTX_new())
+{
+    check(ctx_ != nullptr, "EVP_MD_CTX_new");
+    check(EVP_DigestInit_ex(ctx_, EVP_sha256(), nullptr), "EVP_DigestInit_ex");
+}
+
+uvgrtp::crypto::sha256::~sha256()
+{
+    EVP_MD_CTX_free(ctx_);
+}
+
+void uvgrtp::crypto::sha256::update(const uint8_t *data, size_t len)
+{
+    check(EVP_DigestUpdate(ctx_, data, len), "EVP_DigestUpdate");
+}
+
+void uvgrtp::crypto::sha256::final(uint8_t *digest)
+{
+    check(EVP_DigestFinal_ex(ctx_, digest, nullptr), "EVP_DigestFinal_ex");
+    check(EVP_DigestInit_ex(ctx_, EVP_sha256(), nullptr), "EVP_DigestInit_ex");
+}
+
+/* ***************** aes-128 ***************** */
+
+uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size, const uint8_t *iv) :
+    ctx_(EVP_CIPHER_CTX_new())
+{
+    check(ctx_ != nullptr, "EVP_CIPHER_CTX_new");
+    check(EVP_EncryptInit_ex(ctx_, aes_ctr(key_size), nullptr, key, iv), "EVP_EncryptInit_ex");
+}
+
+uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size) :
+    ctr(key, key_size, nullptr)
+{
+}
+
+uvgrtp::crypto::aes::ctr::~ctr()
+{
+    EVP_CIPHER_CTX_free(ctx_);
+}
+
+void uvgrtp::crypto::aes::ctr::resynchronize(const uint8_t *iv)
+{
+    check(EVP_EncryptInit_ex(ctx_, nullptr, nullptr, nullptr, iv), "EVP_EncryptInit_ex");
+}
+
+void uvgrtp::crypto::aes::ctr::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    cipher(ctx_, output, input, len);
+}
+
+void uvgrtp::crypto::aes::ctr::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    cipher(ctx_, output, input, len);
+}
+
+/* ***************** aes-gcm ***************** */
+
+uvgrtp::crypto::aes::gcm::gcm(const uint8_t *key, size_t key_size) :
+    enc_(EVP_CIPHER_CTX_new()),
+    dec_(EVP_CIPHER_CTX_new()),
+    enc_iv_len_(12),
+    dec_iv_len_(12)
+{
+    check(enc_ != nullptr && dec_ != nullptr, "EVP_CIPHER_CTX_new");
+
+    /* the IV of each message is given to encrypt() and decrypt() */
+    check(EVP_EncryptInit_ex(enc_, aes_gcm(key_size), nullptr, key, nullptr), "EVP_EncryptInit_ex");
+    check(EVP_DecryptInit_ex(dec_, aes_gcm(key_size), nullptr, key, nullptr), "EVP_DecryptInit_ex");
+}
+
+uvgrtp::crypto::aes::gcm::~gcm()
+{
+    EVP_CIPHER_CTX_free(enc_);
+    EVP_CIPHER_CTX_free(dec_);
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt(const uint8_t *iv, size_t iv_len, const uint8_t *aad, size_t aad_len,
+    uint8_t *data, size_t len, uint8_t *tag, size_t tag_len)
+{
+    gcm_start(enc_, enc_iv_len_, iv, iv_len);
+    gcm_aad(enc_, aad, aad_len);
+    cipher(enc_, data, data, len);
+    gcm_tag(enc_, data + len, tag, tag_len);
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt(const uint8_t *iv, size_t iv_len, const std::vector<std::pair<size_t, uint8_t *>>& aad,
+    uint8_t *data, size_t len, uint8_t *tag, size_t tag_len)
+{
+    gcm_start(enc_, enc_iv_len_, iv, iv_len);
+    for (auto& buffer : aad) {
+        gcm_aad(enc_, buffer.second, buffer.first);
+    }
+    cipher(enc_, data, data, len);
+    gcm_tag(enc_, data + len, tag, tag_len);
+}
+
+bool uvgrtp::crypto::aes::gcm::decrypt(const uint8_t *iv, size_t iv_len, const uint8_t *aad, size_t aad_len,
+    uint8_t *data, size_t len, const uint8_t *tag, size_t tag_len)
+{
+    int out_len = 0;
+
+    gcm_start(dec_, dec_iv_len_, iv, iv_len);
+    gcm_aad(dec_, aad, aad_len);
+    cipher(dec_, data, data, len);
+
+    if (EVP_CIPHER_CTX_ctrl(dec_, EVP_CTRL_GCM_SET_TAG, (int)tag_len, (void *)tag) <= 0)
+        return false;
+
+    // GCM writes no output on final, it only compares the tag
+    return EVP_CipherFinal_ex(dec_, data + len, &out_len) > 0;
+}
+
+uvgrtp::crypto::aes::cfb::cfb(const uint8_t *key, size_t key_size, const uint8_t *iv) :
+    enc_(EVP_CIPHER_CTX_new()),
+    dec_(EVP_CIPHER_CTX_new())
+{
+    check(enc_ != nullptr && dec_ != nullptr, "EVP_CIPHER_CTX_new");
+    check(EVP_EncryptInit_ex(enc_, aes_cfb(key_size), nullptr, key, iv), "EVP_EncryptInit_ex");
+    check(EVP_DecryptInit_ex(dec_, aes_cfb(key_size), nullptr, key, iv), "EVP_DecryptInit_ex");
+}
+
+uvgrtp::crypto::aes::cfb::~cfb()
+{
+    EVP_CIPHER_CTX_free(enc_);
+    EVP_CIPHER_CTX_free(dec_);
+}
+
+void uvgrtp::crypto::aes::cfb::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    cipher(enc_, output, input, len);
+}
+
+void uvgrtp::crypto::aes::cfb::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    cipher(dec_, output, input, len);
+}
+
+uvgrtp::crypto::aes::ecb::ecb(const uint8_t *key, size_t key_size) :
+    enc_(EVP_CIPHER_CTX_new()),
+    dec_(EVP_CIPHER_CTX_new())
+{
+    check(enc_ != nullptr && dec_ != nullptr, "EVP_CIPHER_CTX_new");
+    check(EVP_EncryptInit_ex(enc_, aes_ecb(key_size), nullptr, key, nullptr), "EVP_EncryptInit_ex");
+    check(EVP_DecryptInit_ex(dec_, aes_ecb(key_size), nullptr, key, nullptr), "EVP_DecryptInit_ex");
+
+    // the input is always whole blocks
+    EVP_CIPHER_CTX_set_padding(enc_, 0);
+    EVP_CIPHER_CTX_set_padding(dec_, 0);
+}
+
+uvgrtp::crypto::aes::ecb::~ecb()
+{
+    EVP_CIPHER_CTX_free(enc_);
+    EVP_CIPHER_CTX_free(dec_);
+}
+
+void uvgrtp::crypto::aes::ecb::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    cipher(enc_, output, input, len);
+}
+
+void uvgrtp::crypto::aes::ecb::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    cipher(dec_, output, input, len);
+}
+
+/* ***************** diffie-hellman 3072 ***************** */
+
+uvgrtp::crypto::dh::dh() :
+    bn_ctx_(BN_CTX_new()),
+    mont_(BN_MONT_CTX_new()),
+    p_(BN_get_rfc3526_prime_3072(nullptr)),
+    g_(BN_new()),
+    sk_(BN_new()),
+    pk_(BN_new()),
+    rpk_(BN_new())
+{
+    check(bn_ctx_ && mont_ && p_ && g_ && sk_ && pk_ && rpk_, "BN_new");
+    check(BN_set_word(g_, 2), "BN_set_word");
+    check(BN_MONT_CTX_set(mont_, p_, bn_ctx_), "BN_MONT_CTX_set");
+}
+
+uvgrtp::crypto::dh::~dh()
+{
+    BN_clear_free(sk_);
+    BN_free(pk_);
+    BN_free(rpk_);
+    BN_free(g_);
+    BN_free(p_);
+    BN_MONT_CTX_free(mont_);
+    BN_CTX_free(bn_ctx_);
+}
+
+void uvgrtp::crypto::dh::generate_keys()
+{
+    BIGNUM *q = BN_new();
+
+    // the private key is in [1, q - 1], where q = (p - 1) / 2 is the order of g
+    check(q && BN_rshift1(q, p_), "BN_rshift1");
+    do {
+        check(BN_rand_range(sk_, q), "BN_rand_range");
+    } while (BN_is_zero(sk_));
+    BN_free(q);
+
+    check(BN_mod_exp_mont_consttime(pk_, g_, sk_, p_, bn_ctx_, mont_), "BN_mod_exp_mont_consttime");
+}
+
+void uvgrtp::crypto::dh::get_pk(uint8_t *pk, size_t len)
+{
+    check(BN_bn2binpad(pk_, pk, (int)len) >= 0, "BN_bn2binpad");
+}
+
+void uvgrtp::crypto::dh::set_remote_pk(uint8_t *pk, size_t len)
+{
+    check(BN_bin2bn(pk, (int)len, rpk_) != nullptr, "BN_bin2bn");
+}
+
+void uvgrtp::crypto::dh::get_shared_secret(uint8_t *ss, size_t len)
+{
+    BIGNUM *dhres = BN_new();
+
+    check(dhres && BN_mod_exp_mont_consttime(dhres, rpk_, sk_, p_, bn_ctx_, mont_), "BN_mod_exp_mont_consttime");
+    check(BN_bn2binpad(dhres, ss, (int)len) >= 0, "BN_bn2binpad");
+    BN_clear_free(dhres);
+}
+
+/* ***************** elliptic-curve diffie-hellman P-256 ***************** */
+
+uvgrtp::crypto::ecdh::ecdh() :
+    key_(EC_KEY_new_by_curve_name(NID_X9_62_prime256v1)),
+    rpk_()
+{
+    check(key_ != nullptr, "EC_KEY_new_by_curve_name");
+}
+
+uvgrtp::crypto::ecdh::~ecdh()
+{
+    EC_KEY_free(key_);
+}
+
+void uvgrtp::crypto::ecdh::generate_keys()
+{
+    check(EC_KEY_generate_key(key_), "EC_KEY_generate_key");
+}
+
+void uvgrtp::crypto::ecdh::get_pk(uint8_t *pk, size_t len)
+{
+    uint8_t point[65];
+
+    // the point is encoded uncompressed, 0x04 || X || Y, and ZRTP leaves out the 0x04
+    check(EC_POINT_point2oct(EC_KEY_get0_group(key_), EC_KEY_get0_public_key(key_),
+        POINT_CONVERSION_UNCOMPRESSED, point, sizeof(point), nullptr) == sizeof(point), "EC_POINT_point2oct");
+    memcpy(pk, point + 1, std::min(len, sizeof(point) - 1));
+}
+
+void uvgrtp::crypto::ecdh::set_remote_pk(uint8_t *pk, size_t len)
+{
+    rpk_[0] = 0x04;
+    memcpy(rpk_ + 1, pk, std::min(len, sizeof(rpk_) - 1));
+}
+
+bool uvgrtp::crypto::ecdh::get_shared_secret(uint8_t *ss, size_t len)
+{
+    const EC_GROUP *group = EC_KEY_get0_group(key_);
+    EC_POINT *remote = EC_POINT_new(group);
+    uint8_t shared[32];
+
+    // decoding fails if the remote public key is not a point on the curve
+    bool valid = remote && EC_POINT_oct2point(group, remote, rpk_, sizeof(rpk_), nullptr) > 0 &&
+        ECDH_compute_key(shared, sizeof(shared), remote, key_, nullptr) == (int)sizeof(shared);
+    EC_POINT_free(remote);
+
+    if (!valid)
+        return false;
+
+    memcpy(ss, shared, std::min(len, sizeof(shared)));
+    return true;
+}
+
+/* ***************** base32 ***************** */
+
+uvgrtp::crypto::b32::b32()
+{
+}
+
+uvgrtp::crypto::b32::~b32()
+{
+}
+
+void uvgrtp::crypto::b32::encode(const uint8_t *input, uint8_t *output, size_t len)
+{
+    // the default alphabet of the Crypto++ encoder, so both backends give the same strings
+    static const char alphabet[] = "ABCDEFGHIJKMNPQRSTUVWXYZ23456789";
+
+    uint32_t bits = 0;
+    size_t nbits = 0;
+    size_t written = 0;
+
+    for (size_t i = 0; i < len && written < len; ++i) {
+        bits = (bits << 8) | input[i];
+        nbits += 8;
+
+        while (nbits >= 5 && written < len) {
+            output[written++] = alphabet[(bits >> (nbits - 5)) & 0x1f];
+            nbits -= 5;
+        }
+    }
+
+    if (nbits > 0 && written < len)
+        output[written] = alphabet[(bits << (5 - nbits)) & 0x1f];
+}
+
+/* ***************** random ***************** */
+
+void uvgrtp::crypto::random::generate_random(uint8_t *out, size_t len)
+{
+    check(RAND_bytes(out, (int)len), "RAND_bytes");
+}
+
+/* ***************** crc32 ***************** */
+
+uint32_t uvgrtp::crypto::crc32::calculate_crc32(const uint8_t *input, size_t len)
+{
+    const std::array<uint32_t, 256>& table = crc32_table();
+    uint32_t crc = 0xffffffff;
+
+    for (size_t i = 0; i < len; ++i)
+        crc = table[(crc ^ input[i]) & 0xff] ^ (crc >> 8);
+
+    return crc ^ 0xffffffff;
+}
+
+void uvgrtp::crypto::crc32::get_crc32(const uint8_t *input, size_t len, uint32_t *output)
+{
+    *output = calculate_crc32(input, len);
+}
+
+bool uvgrtp::crypto::crc32::verify_crc32(const uint8_t *input, size_t len, uint32_t old_crc)
+{
+    return calculate_crc32(input, len) == old_crc;
+}
+
+bool uvgrtp::crypto::enabled()
+{
+    return true;
+}
+
+#endif
@@ -0,0 +1,278 @@
+#include "delivery_queue.hh"
+
+#include "uvgrtp/frame.hh"
+
+#include "debug.hh"
+
+#include <algorithm>
+
+uvgrtp::delivery_queue::delivery_queue() :
+    head_(nullptr),
+    tail_(nullptr),
+    frames_(0),
+    bytes_(0),
+    max_frames_(DEFAULT_DELIVERY_QUEUE_FRAMES),
+    max_bytes_(0),
+    policy_(RTP_DROP_OLDEST),
+    dropped_frames_(0),
+    dropped_bytes_(0),
+    classifiers_(),
+    awaiting_(0)
+{
+    // the list always has a node before the oldest frame, so that an empty queue has one node
+    tail_ = new node{ {nullptr}, nullptr, 0, 0 };
+    head_.store(tail_);
+}
+
+uvgrtp::delivery_queue::~delivery_queue()
+{
+    clear();
+    delete tail_;
+}
+
+void uvgrtp::delivery_queue::set_limits(size_t max_frames, size_t max_bytes)
+{
+    max_frames_ = max_frames;
+    max_bytes_  = max_bytes;
+}
+
+size_t uvgrtp::delivery_queue::get_max_frames() const
+{
+    return max_frames_;
+}
+
+size_t uvgrtp::delivery_queue::get_max_bytes() const
+{
+    return max_bytes_;
+}
+
+void uvgrtp::delivery_queue::set_policy(int policy)
+{
+    policy_ = policy;
+}
+
+int uvgrtp::delivery_queue::get_policy() const
+{
+    return policy_;
+}
+
+void uvgrtp::delivery_queue::set_key_frame_classifier(std::shared_ptr<std::atomic<std::uint32_t>> ssrc,
+    std::function<bool(const uvgrtp::frame::rtp_frame *)> classifier)
+{
+    std::lock_guard<std::mutex> lock(classifiers_mutex_);
+
+    for (auto& c : classifiers_) {
+        if (c.ssrc == ssrc) {
+            c.is_key_frame = classifier;
+            return;
+        }
+    }
+    classifiers_.push_back({ ssrc, classifier, false });
+}
+
+void uvgrtp::delivery_queue::remove_key_frame_classifier(std::shared_ptr<std::atomic<std::uint32_t>> ssrc)
+{
+    std::lock_guard<std::mutex> lock(classifiers_mutex_);
+
+    for (auto it = classifiers_.begin(); it != classifiers_.end(); ++it) {
+        if (it->ssrc == ssrc) {
+            if (it->awaiting_key_frame)
+                --awaiting_;
+
+            classifiers_.erase(it);
+            return;
+        }
+    }
+}
+
+bool uvgrtp::delivery_queue::fits(size_t size) const
+{
+    size_t max_frames = max_frames_;
+    size_t max_bytes  = max_bytes_;
+
+    return (max_frames == 0 || frames_ < (int64_t)max_frames) &&
+           (max_bytes == 0 || bytes_ + (int64_t)size <= (int64_t)max_bytes);
+}
+
+bool uvgrtp::delivery_queue::admit(const uvgrtp::frame::rtp_frame *frame, size_t size)
+{
+    int policy = policy_;
+
+    if (policy == RTP_DROP_NON_KEY_FRAMES && (awaiting_ > 0 || !fits(size))) {
+        std::lock_guard<std::mutex> lock(classifiers_mutex_);
+
+        classifier *source = nullptr;
+        for (auto& c : classifiers_) {
+            if (classifiers_.size() == 1 || c.ssrc->load() == frame->header.ssrc) {
+                source = &c;
+                break;
+            }
+        }
+
+        bool key_frame = source && source->is_key_frame && source->is_key_frame(frame);
+
+        // the frames after a dropped frame refer to it, so they go too until the next key frame
+        if (source && source->awaiting_key_frame) {
+            if (!key_frame)
+                return false;
+
+            source->awaiting_key_frame = false;
+            --awaiting_;
+        }
+
+        if (fits(size))
+            return true;
+
+        if (!key_frame) {
+            if (source) {
+                source->awaiting_key_frame = true;
+                ++awaiting_;
+            }
+            return false;
+        }
+
+        // a key frame replaces the frames before it
+        return drop_oldest(size);
+    }
+
+    if (fits(size))
+        return true;
+
+    if (policy == RTP_DROP_NEWEST)
+        return false;
+
+    return drop_oldest(size);
+}
+
+bool uvgrtp::delivery_queue::drop_oldest(size_t size)
+{
+    std::lock_guard<std::mutex> lock(consumer_mutex_);
+
+    while (!fits(size)) {
+        size_t old_size = 0;
+        uvgrtp::frame::rtp_frame *old = pop_locked(nullptr, &old_size);
+
+        if (!old)
+            return false;
+
+        dropped(old, old_size);
+    }
+    return true;
+}
+
+void uvgrtp::delivery_queue::dropped(uvgrtp::frame::rtp_frame *frame, size_t size)
+{
+    uint64_t count = ++dropped_frames_;
+    dropped_bytes_ += size;
+
+    // the first drop and then every thousandth, so that a slow application does not flood the log
+    if (count % 1000 == 1) {
+        UVG_LOG_WARN("The queue of received frames is full, %llu frames dropped so far", (unsigned long long)count);
+    }
+
+    (void)uvgrtp::frame::dealloc_frame(frame);
+}
+
+void uvgrtp::delivery_queue::push(uvgrtp::frame::rtp_frame *frame)
+{
+    push(frame, frame->header.ssrc);
+}
+
+void uvgrtp::delivery_queue::push(uvgrtp::frame::rtp_frame *frame, uint32_t source)
+{
+    size_t size = frame->payload_len;
+
+    if (!admit(frame, size)) {
+        dropped(frame, size);
+        return;
+    }
+
+    node *n = new node{ {nullptr}, frame, size, source };
+
+    node *prev = head_.exchange(n);
+    prev->next.store(n);
+
+    // counted after linking, so a consumer that sees the count also sees the frame
+    frames_ += 1;
+    bytes_  += (int64_t)size;
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::delivery_queue::pop_locked(const std::atomic<std::uint32_t> *ssrc, size_t *size)
+{
+    node *next = tail_->next.load();
+
+    if (!next || (ssrc && next->source != ssrc->load()))
+        return nullptr;
+
+    uvgrtp::frame::rtp_frame *frame = next->frame;
+    if (size)
+        *size = next->size;
+
+    frames_ -= 1;
+    bytes_  -= (int64_t)next->size;
+
+    // the node of the frame becomes the node before the oldest frame
+    delete tail_;
+    tail_ = next;
+    tail_->frame = nullptr;
+
+    return frame;
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::delivery_queue::pop(const std::atomic<std::uint32_t> *ssrc)
+{
+    std::lock_guard<std::mutex> lock(consumer_mutex_);
+    return pop_locked(ssrc);
+}
+
+size_t uvgrtp::delivery_queue::pop(uvgrtp::frame::rtp_frame **frames, size_t max_frames,
+    const std::atomic<std::uint32_t> *ssrc)
+{
+    std::lock_guard<std::mutex> lock(consumer_mutex_);
+
+    size_t count = 0;
+    while (count < max_frames && (frames[count] = pop_locked(ssrc)) != nullptr) {
+        ++count;
+    }
+    return count;
+}
+
+bool uvgrtp::delivery_queue::empty() const
+{
+    return frames_ <= 0;
+}
+
+void uvgrtp::delivery_queue::clear()
+{
+    std::lock_guard<std::mutex> lock(consumer_mutex_);
+
+    while (uvgrtp::frame::rtp_frame *frame = pop_locked(nullptr)) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }
+}
+
+size_t uvgrtp::delivery_queue::size() const
+{
+    return (size_t)std::max((int64_t)0, frames_.load(std::memory_order_relaxed));
+}
+
+bool uvgrtp::delivery_queue::congested() const
+{
+    size_t max_frames = max_frames_;
+    size_t max_bytes  = max_bytes_;
+
+    return (max_frames != 0 && frames_ * 100 >= (int64_t)(max_frames * DELIVERY_QUEUE_CONGESTION)) ||
+           (max_bytes  != 0 && bytes_  * 100 >= (int64_t)(max_bytes  * DELIVERY_QUEUE_CONGESTION));
+}
+
+uvgrtp::delivery_queue_stats uvgrtp::delivery_queue::get_stats() const
+{
+    uvgrtp::delivery_queue_stats stats;
+
+    stats.queued_frames  = (size_t)std::max((int64_t)0, frames_.load());
+    stats.queued_bytes   = (size_t)std::max((int64_t)0, bytes_.load());
+    stats.dropped_frames = dropped_frames_;
+    stats.dropped_bytes  = dropped_bytes_;
+
+    return stats;
+}
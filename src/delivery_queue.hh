@@ -0,0 +1,153 @@
+#pragma once
+
+#include "uvgrtp/media_stream.hh"
+#include "uvgrtp/util.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace uvgrtp {
+
+    namespace frame {
+        struct rtp_frame;
+    }
+
+    /* Default number of frames waiting for pull_frame(), see RCC_DELIVERY_QUEUE_FRAMES */
+    constexpr size_t DEFAULT_DELIVERY_QUEUE_FRAMES = 1024;
+
+    /* How full the queue may get, in percent of either limit, before it counts as congested */
+    constexpr size_t DELIVERY_QUEUE_CONGESTION = 75;
+
+    /* The received frames of a socket that wait for pull_frame().
+     *
+     * The frames are kept in a linked list where the producers, the processing threads of
+     * the socket and the jitter buffers, append with one atomic exchange, and the consumers
+     * take frames from the other end. The consumers are serialized with a lock of their own,
+     * which the producers take only to drop the oldest frames from a full queue, so waiting
+     * and pulling do not slow down the processing of the packets.
+     *
+     * The queue holds at most the configured number of frames and payload bytes. When a new
+     * frame does not fit, the drop policy decides which frames are freed, see RTP_DROP_POLICY.
+     * With several producers the limits may be exceeded by a frame per producer */
+    class delivery_queue {
+        public:
+            delivery_queue();
+            ~delivery_queue();
+
+            delivery_queue(const delivery_queue&) = delete;
+            delivery_queue& operator=(const delivery_queue&) = delete;
+
+            /* Limits of the queue, 0 for no limit */
+            void set_limits(size_t max_frames, size_t max_bytes);
+            size_t get_max_frames() const;
+            size_t get_max_bytes() const;
+
+            void set_policy(int policy);
+            int get_policy() const;
+
+            /* Tell the key frames of the source "ssrc" apart for RTP_DROP_NON_KEY_FRAMES.
+             * If there is only one classifier, it is used for the frames of every source */
+            void set_key_frame_classifier(std::shared_ptr<std::atomic<std::uint32_t>> ssrc,
+                std::function<bool(const uvgrtp::frame::rtp_frame *)> classifier);
+            void remove_key_frame_classifier(std::shared_ptr<std::atomic<std::uint32_t>> ssrc);
+
+            /* Add "frame" to the end of the queue. If the frame is dropped, it is freed */
+            void push(uvgrtp::frame::rtp_frame *frame);
+
+            /* Add "frame" for the stream that receives from "source", which is not the SSRC of the
+             * frame if the frame was given to the stream by its multicast group */
+            void push(uvgrtp::frame::rtp_frame *frame, uint32_t source);
+
+            /* Take the oldest frame from the queue. If "ssrc" is given, the frame is taken
+             * only if it is from that source
+             *
+             * Return nullptr if there is no such frame */
+            uvgrtp::frame::rtp_frame *pop(const std::atomic<std::uint32_t> *ssrc = nullptr);
+
+            /* Take up to "max_frames" of the oldest frames to "frames" with one lock. If "ssrc" is
+             * given, the frames are taken until a frame from another source is found
+             *
+             * Return the number of frames taken */
+            size_t pop(uvgrtp::frame::rtp_frame **frames, size_t max_frames, const std::atomic<std::uint32_t> *ssrc = nullptr);
+
+            bool empty() const;
+
+            /* Number of frames in the queue */
+            size_t size() const;
+
+            /* Is the queue filled past DELIVERY_QUEUE_CONGESTION of its limits, i.e. is the
+             * application falling behind. A queue without limits is never congested */
+            bool congested() const;
+
+            /* Free the frames in the queue */
+            void clear();
+
+            uvgrtp::delivery_queue_stats get_stats() const;
+
+        private:
+            struct node {
+                std::atomic<node *> next;
+                uvgrtp::frame::rtp_frame *frame;
+                size_t size;
+                uint32_t source; // see push()
+            };
+
+            struct classifier {
+                std::shared_ptr<std::atomic<std::uint32_t>> ssrc;
+                std::function<bool(const uvgrtp::frame::rtp_frame *)> is_key_frame;
+
+                /* A frame of the source has been dropped and the frames until its next
+                 * key frame cannot be decoded */
+                bool awaiting_key_frame;
+            };
+
+            /* Does a frame of "size" bytes fit in the queue */
+            bool fits(size_t size) const;
+
+            /* Make room for "frame" according to the policy
+             *
+             * Return false if "frame" should be dropped instead */
+            bool admit(const uvgrtp::frame::rtp_frame *frame, size_t size);
+
+            /* Drop the oldest frames until a frame of "size" bytes fits
+             *
+             * Return false if the frame does not fit even in an empty queue */
+            bool drop_oldest(size_t size);
+
+            /* pop() with consumer_mutex_ held. The payload size of the frame is written to "size" */
+            uvgrtp::frame::rtp_frame *pop_locked(const std::atomic<std::uint32_t> *ssrc, size_t *size = nullptr);
+
+            void dropped(uvgrtp::frame::rtp_frame *frame, size_t size);
+
+            /* The producers append after "head_" and the consumers take the node after "tail_",
+             * which is the node whose frame was taken last */
+            std::atomic<node *> head_;
+            node *tail_;
+            std::mutex consumer_mutex_;
+
+            /* Signed, because a consumer may take a frame before its producer has counted it */
+            std::atomic<int64_t> frames_;
+            std::atomic<int64_t> bytes_;
+
+            std::atomic<size_t> max_frames_;
+            std::atomic<size_t> max_bytes_;
+            std::atomic<int> policy_;
+
+            std::atomic<uint64_t> dropped_frames_;
+            std::atomic<uint64_t> dropped_bytes_;
+
+            std::mutex classifiers_mutex_;
+            std::vector<classifier> classifiers_;
+
+            /* Number of sources waiting for a key frame, so that the frames are only classified
+             * when the queue is full or a source is waiting */
+            std::atomic<size_t> awaiting_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
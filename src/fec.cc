@@ -0,0 +1,291 @@
+#include "fec.hh"
+
+#include "uvgrtp/frame.hh"
+
+#include "debug.hh"
+#include "global.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#endif
+
+/* How far behind the highest received sequence number packets are kept for recovery */
+constexpr int64_t FEC_WINDOW = 512;
+
+/* Most repair packets waiting for the packets they protect */
+constexpr size_t MAX_PENDING_REPAIRS = 256;
+
+/* XOR "len" bytes of "src" to "dst". The bytes are handled a word at a time so that
+ * the compiler can vectorize the loop, which is where the time of FEC goes */
+static void xor_bytes(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    size_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        uint64_t a, b;
+        std::memcpy(&a, dst + i, sizeof(a));
+        std::memcpy(&b, src + i, sizeof(b));
+        a ^= b;
+        std::memcpy(dst + i, &a, sizeof(a));
+    }
+
+    for (; i < len; ++i) {
+        dst[i] ^= src[i];
+    }
+}
+
+size_t uvgrtp::fec_repair_count(size_t packets, int overhead)
+{
+    // every block gets at least one repair packet
+    return std::min(packets, std::max((size_t)1, (packets * overhead + 99) / 100));
+}
+
+size_t uvgrtp::fec_protected_size(const uvgrtp::buf_vec& packet, size_t tail)
+{
+    size_t size = 0;
+
+    for (size_t i = 0; i + tail < packet.size(); ++i) {
+        size += packet[i].first;
+    }
+    return size - std::min(size, (size_t)RTP_HDR_SIZE);
+}
+
+size_t uvgrtp::write_fec_packet(const uvgrtp::pkt_vec& packets, size_t first, size_t count,
+    size_t stride, size_t tail, uint8_t *out)
+{
+    size_t protection_length = 0;
+    for (size_t i = 0; i < count; i += stride) {
+        protection_length = std::max(protection_length, fec_protected_size(packets[first + i], tail));
+    }
+
+    std::memset(out, 0, FEC_HEADER_SIZE + protection_length);
+
+    uint8_t *payload  = out + FEC_HEADER_SIZE;
+    uint16_t length   = 0;
+    uint32_t ts       = 0;
+    uint64_t mask     = 0;
+
+    for (size_t i = 0; i < count; i += stride) {
+        const uvgrtp::buf_vec& packet = packets[first + i];
+        const uint8_t *header = packet[0].second;
+
+        // the E and L bits are taken by the recovery of P, X and CC from the RTP header
+        out[0] ^= header[0] & 0x3f;
+        out[1] ^= header[1];
+        ts     ^= ntohl(*(uint32_t *)&header[4]);
+        length ^= (uint16_t)fec_protected_size(packet, tail);
+        mask   |= (uint64_t)1 << (FEC_MAX_BLOCK_SIZE - 1 - i);
+
+        size_t offset = 0;
+        for (size_t b = 0; b + tail < packet.size(); ++b) {
+            const uint8_t *data = packet[b].second;
+            size_t len = packet[b].first;
+
+            // skip the fixed RTP header at the start of the first buffer
+            if (b == 0) {
+                data += RTP_HDR_SIZE;
+                len  -= RTP_HDR_SIZE;
+            }
+            xor_bytes(payload + offset, data, len);
+            offset += len;
+        }
+    }
+
+    out[0] |= 0x40; // L, the long mask
+    out[2] = packets[first][0].second[2]; // SN base, the first protected packet
+    out[3] = packets[first][0].second[3];
+    *(uint32_t *)&out[4] = htonl(ts);
+    *(uint16_t *)&out[8] = htons(length);
+
+    *(uint16_t *)&out[10] = htons((uint16_t)protection_length);
+    *(uint16_t *)&out[12] = htons((uint16_t)(mask >> 32));
+
+    // the low half of the mask is not aligned to four bytes
+    uint32_t mask_low = htonl((uint32_t)mask);
+    memcpy(&out[14], &mask_low, sizeof(mask_low));
+
+    return FEC_HEADER_SIZE + protection_length;
+}
+
+uvgrtp::fec_decoder::fec_decoder() :
+    highest_(-1),
+    media_(),
+    repairs_()
+{
+}
+
+int64_t uvgrtp::fec_decoder::unwrap(uint16_t seq)
+{
+    if (highest_ < 0) {
+        highest_ = seq;
+        return seq;
+    }
+
+    int64_t extended = highest_ + (int16_t)(seq - (uint16_t)highest_);
+    highest_ = std::max(highest_, extended);
+
+    return extended;
+}
+
+void uvgrtp::fec_decoder::prune()
+{
+    while (!media_.empty() && media_.begin()->first < highest_ - FEC_WINDOW) {
+        media_.erase(media_.begin());
+    }
+
+    while (!repairs_.empty() &&
+        (repairs_.front().base < highest_ - FEC_WINDOW || repairs_.size() > MAX_PENDING_REPAIRS))
+    {
+        repairs_.pop_front();
+    }
+}
+
+void uvgrtp::fec_decoder::media_received(const uvgrtp::frame::rtp_frame *frame)
+{
+    int64_t seq = unwrap(frame->header.seq);
+
+    media_packet& packet = media_[seq];
+    packet.flags     = (uint8_t)((frame->header.padding << 5) | (frame->header.ext << 4) | frame->header.cc);
+    packet.marker_pt = (uint8_t)((frame->header.marker << 7) | frame->header.payload);
+    packet.timestamp = frame->header.timestamp;
+
+    // the bytes after the fixed RTP header as they were sent
+    packet.data.clear();
+    if (frame->header.cc) {
+        const uint8_t *csrc = (const uint8_t *)frame->csrc;
+        packet.data.insert(packet.data.end(), csrc, csrc + frame->header.cc * sizeof(uint32_t));
+    }
+
+    if (frame->ext) {
+        uint16_t ext_header[2] = { htons(frame->ext->type), htons((uint16_t)(frame->ext->len / sizeof(uint32_t))) };
+        packet.data.insert(packet.data.end(), (uint8_t *)ext_header, (uint8_t *)ext_header + sizeof(ext_header));
+        packet.data.insert(packet.data.end(), frame->ext->data, frame->ext->data + frame->ext->len);
+    }
+    packet.data.insert(packet.data.end(), frame->payload, frame->payload + frame->payload_len + frame->padding_len);
+
+    prune();
+}
+
+void uvgrtp::fec_decoder::fec_received(const uvgrtp::frame::rtp_frame *frame)
+{
+    int64_t seq = unwrap(frame->header.seq);
+    const uint8_t *fec = frame->payload;
+
+    if (frame->payload_len < FEC_HEADER_SIZE || !(fec[0] & 0x40)) {
+        UVG_LOG_DEBUG("Ignoring a repair packet that is too small or does not use the long mask");
+        return;
+    }
+
+    uint16_t protection_length = ntohs(*(uint16_t *)&fec[10]);
+    if (frame->payload_len < FEC_HEADER_SIZE + protection_length) {
+        UVG_LOG_DEBUG("Ignoring a truncated repair packet");
+        return;
+    }
+
+    // the low half of the mask is not aligned to four bytes
+    uint32_t mask_low = 0;
+    memcpy(&mask_low, &fec[14], sizeof(mask_low));
+
+    repair_packet repair;
+    repair.flags     = fec[0] & 0x3f;
+    repair.marker_pt = fec[1];
+    repair.timestamp = ntohl(*(uint32_t *)&fec[4]);
+    repair.length    = ntohs(*(uint16_t *)&fec[8]);
+    repair.ssrc      = frame->header.ssrc;
+    repair.mask      = ((uint64_t)ntohs(*(uint16_t *)&fec[12]) << 32) | ntohl(mask_low);
+
+    // the protected packets are before the repair packet in the sequence number space
+    uint16_t base = ntohs(*(uint16_t *)&fec[2]);
+    repair.base = seq - (uint16_t)(frame->header.seq - base);
+
+    repair.payload.assign(fec + FEC_HEADER_SIZE, fec + FEC_HEADER_SIZE + protection_length);
+    repairs_.push_back(std::move(repair));
+
+    prune();
+}
+
+void uvgrtp::fec_decoder::rebuild(const repair_packet& repair, int64_t seq, std::vector<uint8_t>& packet)
+{
+    uint8_t flags     = repair.flags;
+    uint8_t marker_pt = repair.marker_pt;
+    uint32_t ts       = repair.timestamp;
+    uint16_t length   = repair.length;
+
+    std::vector<uint8_t> data = repair.payload;
+
+    for (size_t i = 0; i < FEC_MAX_BLOCK_SIZE; ++i) {
+        if (!(repair.mask & ((uint64_t)1 << (FEC_MAX_BLOCK_SIZE - 1 - i))) || repair.base + (int64_t)i == seq)
+            continue;
+
+        const media_packet& media = media_[repair.base + i];
+        flags     ^= media.flags;
+        marker_pt ^= media.marker_pt;
+        ts        ^= media.timestamp;
+        length    ^= (uint16_t)media.data.size();
+        xor_bytes(data.data(), media.data.data(), std::min(data.size(), media.data.size()));
+    }
+
+    packet.clear();
+    if (length > data.size()) {
+        UVG_LOG_DEBUG("The rebuilt packet %lli is longer than the repair packet", (long long)seq);
+        return;
+    }
+
+    packet.resize(RTP_HDR_SIZE + length);
+    packet[0] = 0x80 | flags;
+    packet[1] = marker_pt;
+    *(uint16_t *)&packet[2] = htons((uint16_t)seq);
+    *(uint32_t *)&packet[4] = htonl(ts);
+    *(uint32_t *)&packet[8] = htonl(repair.ssrc);
+    std::memcpy(packet.data() + RTP_HDR_SIZE, data.data(), length);
+
+    // the rebuilt packet may complete the packets of another repair packet
+    media_packet& media = media_[seq];
+    media.flags     = flags;
+    media.marker_pt = marker_pt;
+    media.timestamp = ts;
+    media.data.assign(data.begin(), data.begin() + length);
+}
+
+void uvgrtp::fec_decoder::recover(std::vector<std::vector<uint8_t>>& packets)
+{
+    bool progress = true;
+
+    while (progress) {
+        progress = false;
+
+        for (auto it = repairs_.begin(); it != repairs_.end();) {
+            size_t missing = 0;
+            int64_t lost   = 0;
+
+            for (size_t i = 0; i < FEC_MAX_BLOCK_SIZE && missing < 2; ++i) {
+                if ((it->mask & ((uint64_t)1 << (FEC_MAX_BLOCK_SIZE - 1 - i))) &&
+                    media_.find(it->base + i) == media_.end())
+                {
+                    lost = it->base + i;
+                    ++missing;
+                }
+            }
+
+            if (missing == 1) {
+                std::vector<uint8_t> packet;
+                rebuild(*it, lost, packet);
+
+                if (!packet.empty()) {
+                    packets.push_back(std::move(packet));
+                    progress = true;
+                }
+            }
+
+            // the repair packet is of no further use once all of its packets are there
+            if (missing <= 1) {
+                it = repairs_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
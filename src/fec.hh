@@ -0,0 +1,107 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include "socket.hh"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace uvgrtp {
+
+    namespace frame {
+        struct rtp_frame;
+    }
+
+    /* Forward error correction with XOR parity packets, see RFC 5109
+     *
+     * The sender follows the media packets of each frame with repair packets. The frame is
+     * split into blocks of at most FEC_MAX_BLOCK_SIZE packets and the repair packets of a
+     * block are interleaved, so that repair packet j of m protects the packets j, j + m,
+     * j + 2m... of the block and a burst of up to m lost packets can be rebuilt. The repair
+     * packets are sent in the sequence number space of the media with their own payload type.
+     *
+     * A repair packet is the RTP header followed by the FEC header and the ULP level 0 header
+     * of RFC 5109 with a 48-bit mask, and the XOR of everything after the fixed RTP header
+     * of the protected packets. */
+
+    /* FEC header of 10 bytes and the level 0 header with the long mask */
+    constexpr size_t FEC_HEADER_SIZE = 18;
+
+    /* Most packets protected by one repair packet, the length of the long mask */
+    constexpr size_t FEC_MAX_BLOCK_SIZE = 48;
+
+    /* Default percentage of repair packets, see RCC_FEC_OVERHEAD */
+    constexpr int DEFAULT_FEC_OVERHEAD = 10;
+
+    /* Number of repair packets for a block of "packets" media packets */
+    size_t fec_repair_count(size_t packets, int overhead);
+
+    /* Number of bytes protected of a media packet, everything after the fixed RTP header
+     * in the first buffer of "packet" except the last "tail" buffers, f.ex. the SRTP
+     * authentication tag which is computed only when the packet is sent */
+    size_t fec_protected_size(const uvgrtp::buf_vec& packet, size_t tail);
+
+    /* Write the FEC header and the payload of a repair packet to "out". The packet protects
+     * "packets[first]" and every "stride"th packet after it from the "count" packets starting
+     * at "first". "out" must have room for FEC_HEADER_SIZE bytes and the largest protected size
+     *
+     * Return the size of the FEC header and payload */
+    size_t write_fec_packet(const uvgrtp::pkt_vec& packets, size_t first, size_t count, size_t stride,
+        size_t tail, uint8_t *out);
+
+    /* Keeps the recently received media and repair packets of a stream and rebuilds each lost
+     * media packet that is the only one missing from the packets of some repair packet */
+    class fec_decoder {
+        public:
+            fec_decoder();
+
+            /* Remember a received media packet */
+            void media_received(const uvgrtp::frame::rtp_frame *frame);
+
+            /* Remember a received repair packet. Malformed packets are ignored */
+            void fec_received(const uvgrtp::frame::rtp_frame *frame);
+
+            /* Rebuild the lost media packets that can be rebuilt and add them to "packets"
+             * as complete RTP packets in the order they are rebuilt */
+            void recover(std::vector<std::vector<uint8_t>>& packets);
+
+        private:
+            struct media_packet {
+                uint8_t flags = 0;      // P, X and CC of the RTP header
+                uint8_t marker_pt = 0;  // M and PT
+                uint32_t timestamp = 0;
+                std::vector<uint8_t> data;
+            };
+
+            struct repair_packet {
+                int64_t base = 0;
+                uint64_t mask = 0;
+                uint32_t ssrc = 0;
+                uint8_t flags = 0;
+                uint8_t marker_pt = 0;
+                uint32_t timestamp = 0;
+                uint16_t length = 0;
+                std::vector<uint8_t> payload;
+            };
+
+            /* Extend "seq" to 64 bits based on the sequence numbers received so far */
+            int64_t unwrap(uint16_t seq);
+
+            /* Forget the packets too old to be of use */
+            void prune();
+
+            /* Rebuild the packet "seq" from "repair", all other packets of which have been received */
+            void rebuild(const repair_packet& repair, int64_t seq, std::vector<uint8_t>& packet);
+
+            /* The highest sequence number received, -1 before the first packet */
+            int64_t highest_;
+
+            std::map<int64_t, media_packet> media_;
+            std::deque<repair_packet> repairs_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,240 @@
+#include "file_source.hh"
+
+#include "formats/start_code.hh"
+
+#include "debug.hh"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace {
+    /* The files mapped by the streams, so the streams playing the same file share its mapping */
+    struct file_cache {
+        std::mutex mutex;
+        std::map<std::pair<std::string, rtp_format_t>, std::weak_ptr<const uvgrtp::annexb_file>> files;
+    };
+
+    file_cache& get_file_cache()
+    {
+        static file_cache cache;
+        return cache;
+    }
+
+    /* Find the next start code at or after "pos". Return its position, including the
+     * leading zero of a four-byte start code, or "len" if there are no more */
+    size_t next_start_code(const uint8_t *data, size_t pos, size_t len, size_t& start_len)
+    {
+        while (pos + 3 <= len) {
+            // the blocks without a "00 00" pair cannot have a start code
+            pos = uvgrtp::formats::skip_start_code_free(data, pos, len);
+
+            size_t block_end = std::min(len - 2, pos + 64);
+            for (; pos < block_end; ++pos) {
+                if (data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 1) {
+                    start_len = (pos > 0 && data[pos - 1] == 0) ? 4 : 3;
+                    return pos + 3 - start_len;
+                }
+            }
+        }
+        return len;
+    }
+
+    /* Whether the NAL unit "nal" of "size" bytes is a slice, and if so, whether it is the
+     * first slice of a picture. Non-VCL NAL units that begin an access unit when they follow
+     * a slice are marked as first too */
+    void classify(rtp_format_t fmt, const uint8_t *nal, size_t size, bool& vcl, bool& first)
+    {
+        vcl = false;
+        first = false;
+
+        if (fmt == RTP_FORMAT_H264) {
+            if (size < 2)
+                return;
+
+            uint8_t type = nal[0] & 0x1f;
+            vcl   = type >= 1 && type <= 5;
+            // first_mb_in_slice is 0 if its Exp-Golomb code is the single bit 1
+            first = vcl ? (nal[1] & 0x80) != 0 : (type >= 6 && type <= 9) || (type >= 14 && type <= 18);
+        }
+        else if (fmt == RTP_FORMAT_H265) {
+            if (size < 3)
+                return;
+
+            uint8_t type = (nal[0] >> 1) & 0x3f;
+            vcl   = type <= 31;
+            // first_slice_segment_in_pic_flag
+            first = vcl ? (nal[2] & 0x80) != 0 :
+                (type >= 32 && type <= 35) || type == 39 || (type >= 41 && type <= 44) || (type >= 48 && type <= 55);
+        }
+        else if (fmt == RTP_FORMAT_H266) {
+            if (size < 3)
+                return;
+
+            uint8_t type = (nal[1] >> 3) & 0x1f;
+            vcl   = type <= 11;
+            // sh_picture_header_in_slice_header_flag, otherwise the picture header NAL unit begins the picture
+            first = vcl ? (nal[2] & 0x80) != 0 :
+                (type >= 12 && type <= 17) || type == 19 || type == 20 || type == 23;
+        }
+    }
+}
+
+uvgrtp::annexb_file::annexb_file() :
+    data_(nullptr),
+    size_(0),
+#ifdef _WIN32
+    file_(INVALID_HANDLE_VALUE),
+    mapping_(nullptr),
+#else
+    fd_(-1),
+#endif
+    access_units_()
+{
+}
+
+uvgrtp::annexb_file::~annexb_file()
+{
+#ifdef _WIN32
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mapping_)
+        CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE)
+        CloseHandle(file_);
+#else
+    if (data_)
+        munmap((void *)data_, size_);
+    if (fd_ != -1)
+        close(fd_);
+#endif
+}
+
+std::shared_ptr<const uvgrtp::annexb_file> uvgrtp::annexb_file::open(const std::string& path, rtp_format_t fmt,
+    rtp_error_t& ret)
+{
+    file_cache& cache = get_file_cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+
+    auto key = std::make_pair(path, fmt);
+    if (std::shared_ptr<const annexb_file> shared = cache.files[key].lock()) {
+        ret = RTP_OK;
+        return shared;
+    }
+
+    std::shared_ptr<annexb_file> file(new annexb_file());
+
+    if ((ret = file->map(path)) != RTP_OK) {
+        cache.files.erase(key);
+        return nullptr;
+    }
+
+    file->index(fmt);
+
+    if (file->access_units_.empty()) {
+        UVG_LOG_ERROR("No access units found in %s", path.c_str());
+        cache.files.erase(key);
+        ret = RTP_INVALID_VALUE;
+        return nullptr;
+    }
+
+    cache.files[key] = file;
+    ret = RTP_OK;
+    return file;
+}
+
+rtp_error_t uvgrtp::annexb_file::map(const std::string& path)
+{
+#ifdef _WIN32
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    LARGE_INTEGER size;
+    if (file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+        UVG_LOG_ERROR("Failed to open %s", path.c_str());
+        return RTP_GENERIC_ERROR;
+    }
+    size_ = (size_t)size.QuadPart;
+
+    if (!(mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr)) ||
+        !(data_ = (const uint8_t *)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0))) {
+        UVG_LOG_ERROR("Failed to map %s: %lu", path.c_str(), GetLastError());
+        return RTP_GENERIC_ERROR;
+    }
+#else
+    struct stat st;
+    if ((fd_ = ::open(path.c_str(), O_RDONLY)) == -1 || fstat(fd_, &st) == -1 || st.st_size == 0) {
+        UVG_LOG_ERROR("Failed to open %s", path.c_str());
+        return RTP_GENERIC_ERROR;
+    }
+    size_ = (size_t)st.st_size;
+
+    void *data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (data == MAP_FAILED) {
+        UVG_LOG_ERROR("Failed to map %s: %d", path.c_str(), errno);
+        return RTP_GENERIC_ERROR;
+    }
+    data_ = (const uint8_t *)data;
+
+    // the file is indexed from start to end once and after that read in the same order
+    (void)madvise(data, size_, MADV_SEQUENTIAL);
+#endif
+
+    return RTP_OK;
+}
+
+void uvgrtp::annexb_file::index(rtp_format_t fmt)
+{
+    size_t start_len = 0;
+    size_t pos = next_start_code(data_, 0, size_, start_len);
+
+    access_unit au;
+    bool has_vcl = false;
+
+    while (pos < size_) {
+        size_t nal_start = pos + start_len;
+        size_t next_len = 0;
+        size_t next = next_start_code(data_, nal_start, size_, next_len);
+
+        // the trailing zero bytes are not part of the NAL unit
+        size_t nal_end = next;
+        while (nal_end > nal_start && data_[nal_end - 1] == 0)
+            --nal_end;
+
+        bool vcl = false;
+        bool first = false;
+        classify(fmt, data_ + nal_start, nal_end - nal_start, vcl, first);
+
+        if (nal_end > nal_start) {
+            if (has_vcl && first) {
+                access_units_.push_back(std::move(au));
+                au = access_unit();
+                has_vcl = false;
+            }
+
+            if (au.nal_units.empty())
+                au.offset = pos;
+
+            au.nal_units.push_back({ nal_start - au.offset, nal_end - nal_start });
+            au.size = nal_end - au.offset;
+            has_vcl = has_vcl || vcl;
+        }
+
+        pos = next;
+        start_len = next_len;
+    }
+
+    if (!au.nal_units.empty())
+        access_units_.push_back(std::move(au));
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "uvgrtp/frame.hh"
+#include "uvgrtp/util.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* An H.264, H.265 or H.266 Annex-B file mapped into memory, see media_stream::play_file().
+     *
+     * The file is split into access units once when it is opened. The start codes are looked
+     * up with the vectorized pre-filter of the start code lookup, and a NAL unit begins a new
+     * access unit if it follows a slice and is an access unit delimiter, a parameter set, a
+     * prefix SEI or the first slice of a picture. The locations of the NAL units are kept with
+     * each access unit, so the frames are sent straight from the mapping without scanning them
+     * again. The mapping is read only and shared by all the streams that play the file */
+    class annexb_file {
+        public:
+            struct access_unit {
+                /* Offset and size of the access unit in the file, from its first start code
+                 * to the end of its last NAL unit */
+                size_t offset = 0;
+                size_t size = 0;
+
+                /* The NAL units of the access unit relative to "offset" */
+                std::vector<uvgrtp::frame::nal_unit> nal_units;
+            };
+
+            ~annexb_file();
+
+            annexb_file(const annexb_file&) = delete;
+            annexb_file& operator=(const annexb_file&) = delete;
+
+            /* Map "path" and index its access units as NAL units of "fmt". A file that is
+             * already mapped with the same format is shared instead of mapped again
+             *
+             * Return the file on success
+             * Return nullptr and set "ret" to RTP_GENERIC_ERROR if the file cannot be mapped
+             * Return nullptr and set "ret" to RTP_INVALID_VALUE if the file has no access units */
+            static std::shared_ptr<const annexb_file> open(const std::string& path, rtp_format_t fmt,
+                rtp_error_t& ret);
+
+            const uint8_t *data() const
+            {
+                return data_;
+            }
+
+            const std::vector<access_unit>& access_units() const
+            {
+                return access_units_;
+            }
+
+        private:
+            annexb_file();
+
+            rtp_error_t map(const std::string& path);
+            void index(rtp_format_t fmt);
+
+            const uint8_t *data_;
+            size_t size_;
+
+#ifdef _WIN32
+            void *file_;
+            void *mapping_;
+#else
+            int fd_;
+#endif
+
+            std::vector<access_unit> access_units_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
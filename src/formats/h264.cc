@@ -2,6 +2,7 @@
 
 #include "../frame_queue.hh"
 #include "../rtp.hh"
+#include "../frame_pool.hh"
 
 #include "debug.hh"
 
@@ -17,7 +18,8 @@
 #endif
 
 uvgrtp::formats::h264::h264(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int rce_flags) :
-    h26x(socket, rtp, rce_flags)
+    // H264 can have three byte start codes and therefore we must scan one byte at a time
+    h26x(socket, rtp, rce_flags, { HEADER_SIZE_H264_INDICATOR, HEADER_SIZE_H264_NAL, HEADER_SIZE_H264_FU, 1 })
 {
 }
 
@@ -25,26 +27,6 @@ uvgrtp::formats::h264::~h264()
 {
 }
 
-uint8_t uvgrtp::formats::h264::get_payload_header_size() const
-{
-    return HEADER_SIZE_H264_INDICATOR;
-}
-
-uint8_t uvgrtp::formats::h264::get_nal_header_size() const
-{
-    return HEADER_SIZE_H264_NAL;
-}
-
-uint8_t uvgrtp::formats::h264::get_fu_header_size() const
-{
-    return HEADER_SIZE_H264_FU;
-}
-
-uint8_t uvgrtp::formats::h264::get_start_code_range() const
-{
-    return 1; // H264 can have three byte start codes and therefore we must scan one byte at a time
-}
-
 uvgrtp::formats::FRAG_TYPE uvgrtp::formats::h264::get_fragment_type(uvgrtp::frame::rtp_frame* frame) const
 {
     bool first_frag = frame->payload[1] & 0x80;
@@ -90,6 +72,46 @@ uint8_t uvgrtp::formats::h264::get_nal_type(uint8_t* data) const
     return data[0] & 0x1f;
 }
 
+bool uvgrtp::formats::h264::is_key_nal_type(uint8_t nal_type) const
+{
+    // IDR slice, SPS and PPS
+    return nal_type == H264_IDR || nal_type == 7 || nal_type == 8;
+}
+
+int uvgrtp::formats::h264::parameter_set_index(uint8_t nal_type) const
+{
+    // SPS and PPS, H.264 has no VPS
+    if (nal_type == 7)
+        return 1;
+    if (nal_type == 8)
+        return 2;
+    return -1;
+}
+
+bool uvgrtp::formats::h264::get_nal_marking(const uint8_t* nal, uint8_t& flags, uint8_t& layer_id) const
+{
+    uint8_t nal_type = nal[0] & 0x1f;
+
+    // the coded slices, VCL NAL unit types 1 to 5
+    if (nal_type < 1 || nal_type > H264_IDR)
+        return false;
+
+    // a picture that is not used for reference has a zero nal_ref_idc
+    flags    = (uint8_t)((nal_type == H264_IDR ? uvgrtp::FRAME_MARKING_INDEPENDENT : 0) |
+        (((nal[0] >> 5) & 0x03) == 0 ? uvgrtp::FRAME_MARKING_DISCARDABLE : 0));
+    layer_id = 0;
+    return true;
+}
+
+bool uvgrtp::formats::h264::get_layer_ids(const uint8_t* header, uint8_t& tid, uint8_t& layer_id) const
+{
+    // the layers of SVC are not supported
+    (void)header;
+    (void)tid;
+    (void)layer_id;
+    return false;
+}
+
 void uvgrtp::formats::h264::clear_aggregation_info()
 {
     aggr_pkt_info_.nalus.clear();
@@ -152,18 +174,11 @@ rtp_error_t uvgrtp::formats::h264::finalize_aggregation_pkt()
 
 rtp_error_t uvgrtp::formats::h264::fu_division(uint8_t* data, size_t data_len, size_t payload_size)
 {
-    auto headers = (uvgrtp::formats::h264_headers*)fqueue_->get_media_headers();
-
-    headers->fu_indicator[0] = (data[0] & 0xe0) | H264_PKT_FRAG;
-
-    initialize_fu_headers(get_nal_type(data), headers->fu_headers);
+    uint8_t fu_indicator[HEADER_SIZE_H264_INDICATOR] = {
+        (uint8_t)((data[0] & 0xe0) | H264_PKT_FRAG)
+    };
 
-    uvgrtp::buf_vec* buffers = fqueue_->get_buffer_vector();
-    buffers->push_back(std::make_pair(sizeof(headers->fu_indicator), headers->fu_indicator));
-    buffers->push_back(std::make_pair(sizeof(uint8_t), &headers->fu_headers[0]));
-    buffers->push_back(std::make_pair(payload_size, nullptr));
-
-    return divide_frame_to_fus(data, data_len, payload_size, *buffers, headers->fu_headers);
+    return divide_frame_to_fus(data, data_len, payload_size, fu_indicator);
 }
 
 void uvgrtp::formats::h264::get_nal_header_from_fu_headers(size_t fptr, uint8_t* frame_payload, uint8_t* complete_payload)
@@ -182,7 +197,7 @@ uvgrtp::frame::rtp_frame* uvgrtp::formats::h264::allocate_rtp_frame_with_startco
         complete->payload_len += 3;
     }
 
-    complete->payload = new uint8_t[complete->payload_len];
+    complete->payload = uvgrtp::frame_pool::alloc_payload(complete->payload_len);
 
     if (add_start_code && complete->payload_len >= 3) {
         complete->payload[0] = 0;
@@ -199,14 +214,26 @@ uvgrtp::frame::rtp_frame* uvgrtp::formats::h264::allocate_rtp_frame_with_startco
 void uvgrtp::formats::h264::prepend_start_code(int rce_flags, uvgrtp::frame::rtp_frame** out)
 {
     if (!(rce_flags & RCE_NO_H26X_PREPEND_SC)) {
-        uint8_t* pl = new uint8_t[(*out)->payload_len + 3];
+        // the already parsed RTP header in front of the payload leaves room for the start code
+        if ((*out)->dgram_owned && (size_t)((*out)->payload - (*out)->dgram) >= 3) {
+            (*out)->payload     -= 3;
+            (*out)->payload_len += 3;
+
+            uint8_t* pl = (*out)->payload;
+            pl[0] = 0;
+            pl[1] = 0;
+            pl[2] = 1;
+            return;
+        }
+
+        uint8_t* pl = uvgrtp::frame_pool::alloc_payload((*out)->payload_len + 3);
 
         pl[0] = 0;
         pl[1] = 0;
         pl[2] = 1;
 
         std::memcpy(pl + 3, (*out)->payload, (*out)->payload_len);
-        delete[](*out)->payload;
+        uvgrtp::frame_pool::release_payload(*out);
 
         (*out)->payload = pl;
         (*out)->payload_len += 3;
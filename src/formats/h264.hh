@@ -35,16 +35,6 @@ namespace uvgrtp {
             uvgrtp::buf_vec aggr_pkt; /* crafted aggregation packet */
         };
 
-        struct h264_headers {
-            uint8_t fu_indicator[HEADER_SIZE_H264_INDICATOR];
-
-            /* there are three types of Fragmentation Unit headers:
-             *  - header for the first fragment
-             *  - header for all middle fragments
-             *  - header for the last fragment */
-            uint8_t fu_headers[3 * HEADER_SIZE_H264_FU];
-        };
-
         class h264 : public h26x {
             public:
                 h264(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int rce_flags);
@@ -67,11 +57,11 @@ namespace uvgrtp {
 
                 // get h264 nal type
                 virtual uint8_t get_nal_type(uint8_t* data) const;
+                virtual bool is_key_nal_type(uint8_t nal_type) const;
+                virtual int parameter_set_index(uint8_t nal_type) const;
+                virtual bool get_nal_marking(const uint8_t* nal, uint8_t& flags, uint8_t& layer_id) const;
+                virtual bool get_layer_ids(const uint8_t* header, uint8_t& tid, uint8_t& layer_id) const;
 
-                virtual uint8_t get_payload_header_size() const;
-                virtual uint8_t get_nal_header_size() const;
-                virtual uint8_t get_fu_header_size() const;
-                virtual uint8_t get_start_code_range() const;
 
                 virtual uvgrtp::formats::FRAG_TYPE get_fragment_type(uvgrtp::frame::rtp_frame* frame) const;
                 virtual uvgrtp::formats::NAL_TYPE  get_nal_type(uvgrtp::frame::rtp_frame* frame) const;
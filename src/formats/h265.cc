@@ -6,6 +6,7 @@
 
 #include "debug.hh"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
@@ -22,48 +23,73 @@
 
 uvgrtp::formats::h265::h265(std::shared_ptr<uvgrtp::socket> socket, 
     std::shared_ptr<uvgrtp::rtp> rtp, int rce_flags) :
-    h26x(socket, rtp, rce_flags)
-{}
+    h26x(socket, rtp, rce_flags, { HEADER_SIZE_H265_PAYLOAD, HEADER_SIZE_H265_NAL, HEADER_SIZE_H265_FU, 4 })
+{
+    // the frame marking carries the temporal and layer IDs of the NAL unit header
+    fqueue_->set_long_frame_marking(true);
+}
 
 uvgrtp::formats::h265::~h265()
 {}
 
-uint8_t uvgrtp::formats::h265::get_payload_header_size() const
+uvgrtp::formats::NAL_TYPE uvgrtp::formats::h265::get_nal_type(uvgrtp::frame::rtp_frame* frame) const
 {
-    return HEADER_SIZE_H265_PAYLOAD;
+    // see https://datatracker.ietf.org/doc/html/rfc7798#section-4.4.3
+    switch (frame->payload[2] & 0x3f) {
+    case H265_IDR_W_RADL: return uvgrtp::formats::NAL_TYPE::NT_INTRA;
+    case H265_TRAIL_R:    return uvgrtp::formats::NAL_TYPE::NT_INTER;
+    default: break;
+    }
+
+    return uvgrtp::formats::NAL_TYPE::NT_OTHER;
 }
 
-uint8_t uvgrtp::formats::h265::get_nal_header_size() const
+uint8_t uvgrtp::formats::h265::get_nal_type(uint8_t* data) const
 {
-    return HEADER_SIZE_H265_NAL;
+    // see https://datatracker.ietf.org/doc/html/rfc7798#section-1.1.4
+    return (data[0] >> 1) & 0x3f;
 }
 
-uint8_t uvgrtp::formats::h265::get_fu_header_size() const
+bool uvgrtp::formats::h265::is_key_nal_type(uint8_t nal_type) const
 {
-    return HEADER_SIZE_H265_FU;
+    // IRAP pictures (BLA, IDR and CRA) and VPS, SPS and PPS
+    return (nal_type >= 16 && nal_type <= 21) || (nal_type >= 32 && nal_type <= 34);
 }
 
-uint8_t uvgrtp::formats::h265::get_start_code_range() const
+int uvgrtp::formats::h265::parameter_set_index(uint8_t nal_type) const
 {
-    return 4;
+    // VPS, SPS and PPS
+    return (nal_type >= 32 && nal_type <= 34) ? nal_type - 32 : -1;
 }
 
-uvgrtp::formats::NAL_TYPE uvgrtp::formats::h265::get_nal_type(uvgrtp::frame::rtp_frame* frame) const
+bool uvgrtp::formats::h265::get_nal_marking(const uint8_t* nal, uint8_t& flags, uint8_t& layer_id) const
 {
-    // see https://datatracker.ietf.org/doc/html/rfc7798#section-4.4.3
-    switch (frame->payload[2] & 0x3f) {
-    case H265_IDR_W_RADL: return uvgrtp::formats::NAL_TYPE::NT_INTRA;
-    case H265_TRAIL_R:    return uvgrtp::formats::NAL_TYPE::NT_INTER;
-    default: break;
-    }
+    uint8_t nal_type = (nal[0] >> 1) & 0x3f;
+    uint8_t tid      = 0;
 
-    return uvgrtp::formats::NAL_TYPE::NT_OTHER;
+    if (nal_type > 31)
+        return false;
+
+    (void)get_layer_ids(nal, tid, layer_id);
+
+    // IRAP pictures are independent and the even types below 16 are sub-layer non-reference pictures
+    flags = (uint8_t)(tid & 0x07);
+    if (nal_type >= 16 && nal_type <= 23)
+        flags |= uvgrtp::FRAME_MARKING_INDEPENDENT;
+    if (nal_type <= 14 && nal_type % 2 == 0)
+        flags |= uvgrtp::FRAME_MARKING_DISCARDABLE;
+
+    return true;
 }
 
-uint8_t uvgrtp::formats::h265::get_nal_type(uint8_t* data) const
+bool uvgrtp::formats::h265::get_layer_ids(const uint8_t* header, uint8_t& tid, uint8_t& layer_id) const
 {
-    // see https://datatracker.ietf.org/doc/html/rfc7798#section-1.1.4
-    return (data[0] >> 1) & 0x3f;
+    uint8_t tid_plus1 = header[1] & 0x07;
+
+    // a zero nuh_temporal_id_plus1 is not allowed, such NAL units are taken to be of the base layer
+    tid      = tid_plus1 ? (uint8_t)(tid_plus1 - 1) : 0;
+    layer_id = (uint8_t)(((header[0] & 0x01) << 5) | (header[1] >> 3));
+    return true;
 }
 
 uvgrtp::formats::FRAG_TYPE uvgrtp::formats::h265::get_fragment_type(uvgrtp::frame::rtp_frame* frame) const
@@ -114,8 +140,22 @@ rtp_error_t uvgrtp::formats::h265::finalize_aggregation_pkt()
 
     /* create header for the packet and craft the aggregation packet
      * according to the format defined in RFC 7798 */
-    aggr_pkt_info_.payload_header[0] = H265_PKT_AGGR << 1;
-    aggr_pkt_info_.payload_header[1] = 1;
+    uint8_t tid      = uvgrtp::MAX_TEMPORAL_ID;
+    uint8_t layer_id = uvgrtp::MAX_LAYER_ID;
+
+    // the LayerId and TID of the payload header are the lowest of the aggregated NAL units
+    for (auto& nalu : aggr_pkt_info_.nalus) {
+        uint8_t nal_tid      = 0;
+        uint8_t nal_layer_id = 0;
+
+        if (nalu.first >= HEADER_SIZE_H265_NAL && get_layer_ids(nalu.second, nal_tid, nal_layer_id)) {
+            tid      = std::min(tid, nal_tid);
+            layer_id = std::min(layer_id, nal_layer_id);
+        }
+    }
+
+    aggr_pkt_info_.payload_header[0] = (uint8_t)((H265_PKT_AGGR << 1) | (layer_id >> 5));
+    aggr_pkt_info_.payload_header[1] = (uint8_t)(((layer_id & 0x1f) << 3) | ((tid + 1) & 0x07));
 
     aggr_pkt_info_.aggr_pkt.push_back(
         std::make_pair(HEADER_SIZE_H265_PAYLOAD, aggr_pkt_info_.payload_header)
@@ -164,19 +204,11 @@ rtp_error_t uvgrtp::formats::h265::add_aggregate_packet(uint8_t* data, size_t da
 
 rtp_error_t uvgrtp::formats::h265::fu_division(uint8_t* data, size_t data_len, size_t payload_size)
 {
-    auto headers = (uvgrtp::formats::h265_headers*)fqueue_->get_media_headers();
-    
-    headers->payload_header[0] = H265_PKT_FRAG << 1; /* fragmentation unit */
-    headers->payload_header[1] = 1;                  /* temporal id */
-
-    initialize_fu_headers(get_nal_type(data), headers->fu_headers);
-
-    uvgrtp::buf_vec* buffers = fqueue_->get_buffer_vector();
-
-    // the default structure of one fragment
-    buffers->push_back(std::make_pair(sizeof(headers->payload_header), headers->payload_header));
-    buffers->push_back(std::make_pair(sizeof(uint8_t), &headers->fu_headers[0])); // first fragment
-    buffers->push_back(std::make_pair(payload_size, nullptr));
+    // the F bit, LayerId and TID of the fragmented NAL unit
+    uint8_t payload_header[HEADER_SIZE_H265_PAYLOAD] = {
+        (uint8_t)((H265_PKT_FRAG << 1) | (data[0] & 0x81)), /* fragmentation unit */
+        data[1]
+    };
 
-    return divide_frame_to_fus(data, data_len, payload_size, *buffers, headers->fu_headers);
+    return divide_frame_to_fus(data, data_len, payload_size, payload_header);
 }
@@ -22,31 +22,14 @@
 
 
 uvgrtp::formats::h266::h266(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int rce_flags) :
-    h26x(socket, rtp, rce_flags)
-{}
-
-uvgrtp::formats::h266::~h266()
-{
-}
-
-uint8_t uvgrtp::formats::h266::get_payload_header_size() const
+    h26x(socket, rtp, rce_flags, { HEADER_SIZE_H266_PAYLOAD, HEADER_SIZE_H266_NAL, HEADER_SIZE_H266_FU, 4 })
 {
-    return HEADER_SIZE_H266_PAYLOAD;
+    // the frame marking carries the temporal and layer IDs of the NAL unit header
+    fqueue_->set_long_frame_marking(true);
 }
 
-uint8_t uvgrtp::formats::h266::get_nal_header_size() const
-{
-    return HEADER_SIZE_H266_NAL;
-}
-
-uint8_t uvgrtp::formats::h266::get_fu_header_size() const
-{
-    return HEADER_SIZE_H266_FU;
-}
-
-uint8_t uvgrtp::formats::h266::get_start_code_range() const
+uvgrtp::formats::h266::~h266()
 {
-    return 4;
 }
 
 uvgrtp::formats::NAL_TYPE uvgrtp::formats::h266::get_nal_type(uvgrtp::frame::rtp_frame* frame) const
@@ -68,6 +51,46 @@ uint8_t uvgrtp::formats::h266::get_nal_type(uint8_t* data) const
     return (data[1] >> 3) & 0x1f;
 }
 
+bool uvgrtp::formats::h266::is_key_nal_type(uint8_t nal_type) const
+{
+    // IRAP pictures (IDR and CRA), GDR and VPS, SPS and PPS
+    return (nal_type >= H266_IDR_W_RADL && nal_type <= 10) || (nal_type >= 14 && nal_type <= 16);
+}
+
+int uvgrtp::formats::h266::parameter_set_index(uint8_t nal_type) const
+{
+    // VPS, SPS and PPS
+    return (nal_type >= 14 && nal_type <= 16) ? nal_type - 14 : -1;
+}
+
+bool uvgrtp::formats::h266::get_nal_marking(const uint8_t* nal, uint8_t& flags, uint8_t& layer_id) const
+{
+    uint8_t nal_type = (nal[1] >> 3) & 0x1f;
+    uint8_t tid      = 0;
+
+    if (nal_type > 11)
+        return false;
+
+    (void)get_layer_ids(nal, tid, layer_id);
+
+    // the NAL unit header does not tell whether the picture is used for reference
+    flags = (uint8_t)(tid & 0x07);
+    if (nal_type >= H266_IDR_W_RADL && nal_type <= 9)
+        flags |= uvgrtp::FRAME_MARKING_INDEPENDENT;
+
+    return true;
+}
+
+bool uvgrtp::formats::h266::get_layer_ids(const uint8_t* header, uint8_t& tid, uint8_t& layer_id) const
+{
+    uint8_t tid_plus1 = header[1] & 0x07;
+
+    // a zero nuh_temporal_id_plus1 is not allowed, such NAL units are taken to be of the base layer
+    tid      = tid_plus1 ? (uint8_t)(tid_plus1 - 1) : 0;
+    layer_id = header[0] & 0x3f;
+    return true;
+}
+
 uvgrtp::formats::FRAG_TYPE uvgrtp::formats::h266::get_fragment_type(uvgrtp::frame::rtp_frame* frame) const
 {
     bool first_frag = frame->payload[2] & 0x80;
@@ -101,18 +124,10 @@ void uvgrtp::formats::h266::get_nal_header_from_fu_headers(size_t fptr, uint8_t*
 
 rtp_error_t uvgrtp::formats::h266::fu_division(uint8_t* data, size_t data_len, size_t payload_size)
 {
-    auto headers = (uvgrtp::formats::h266_headers*)fqueue_->get_media_headers();
-
-    headers->payload_header[0] = data[0];
-    headers->payload_header[1] = (H266_PKT_FRAG << 3) | (data[1] & 0x7);
-
-    initialize_fu_headers(get_nal_type(data), headers->fu_headers);
-
-    uvgrtp::buf_vec* buffers = fqueue_->get_buffer_vector();
-
-    buffers->push_back(std::make_pair(sizeof(headers->payload_header), headers->payload_header));
-    buffers->push_back(std::make_pair(sizeof(uint8_t), &headers->fu_headers[0]));
-    buffers->push_back(std::make_pair(payload_size, nullptr));
+    uint8_t payload_header[HEADER_SIZE_H266_PAYLOAD] = {
+        data[0],
+        (uint8_t)((H266_PKT_FRAG << 3) | (data[1] & 0x7))
+    };
 
-    return divide_frame_to_fus(data, data_len, payload_size, *buffers, headers->fu_headers);
+    return divide_frame_to_fus(data, data_len, payload_size, payload_header);
 }
\ No newline at end of file
@@ -4,7 +4,12 @@
 
 #include "rtp.hh"
 #include "frame_queue.hh"
+#include "frame_pool.hh"
+#include "memory_budget.hh"
+#include "start_code.hh"
 #include "debug.hh"
+#include "stream_metrics.hh"
+#include "trace.hh"
 
 
 #include <cstdint>
@@ -13,6 +18,7 @@
 #include <unordered_map>
 #include <queue>
 #include <algorithm>
+#include <mutex>
 
 
 #ifdef _WIN32
@@ -46,9 +52,40 @@ constexpr int GARBAGE_COLLECTION_INTERVAL_MS = 100;
 // any value less than 30 minutes is ok here, since that is how long it takes to go through all timestamps
 constexpr int TIME_TO_KEEP_TRACK_OF_PREVIOUS_FRAMES_MS = 5000;
 
-// how many RTP timestamps get saved for duplicate detection
-// there is 90 000 timestamps in one second -> 5 sec is 450 000
-constexpr int RECEIVED_FRAMES = 450000;
+// the smallest output buffer allocated for RCE_H26X_FLAT_REASSEMBLY
+constexpr size_t MIN_FLAT_BUFFER_SIZE = 64 * 1024;
+
+/* How many fragments the output buffer of RCE_H26X_FLAT_REASSEMBLY may reserve room for beyond
+ * the fragments received, so that a fragment far from the others cannot make it allocate more
+ * than the frame could need */
+constexpr size_t MAX_FLAT_GAP_FRAGMENTS = 1024;
+
+// how many sets of the sequence number tables of destroyed streams are kept for the new streams
+constexpr size_t MAX_POOLED_SEQ_TABLES = 8;
+
+namespace {
+    /* The tables indexed by the sequence number take almost 800 kB per stream. The tables of the
+     * destroyed streams are given to the streams created next, so that creating and destroying
+     * a stream does not allocate, clear and free them every time */
+    struct seq_tables {
+        std::vector<uint32_t> timestamps;
+        std::vector<bool> used;
+        std::vector<uvgrtp::frame::rtp_frame*> fragments;
+    };
+
+    struct seq_table_pool {
+        std::mutex mutex;
+        std::vector<seq_tables> tables;
+    };
+
+    // never destroyed, because the streams may be destroyed during static destruction
+    seq_table_pool& get_seq_table_pool()
+    {
+        static seq_table_pool *p = new seq_table_pool();
+        return *p;
+    }
+}
+
 
 static inline uint8_t determine_start_prefix_precense(uint32_t value, bool& additional_byte)
 {
@@ -97,22 +134,50 @@ static inline uint8_t determine_start_prefix_precense(uint32_t value, bool& addi
     return 0;
 }
 
-uvgrtp::formats::h26x::h26x(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int rce_flags) :
+uvgrtp::formats::h26x::h26x(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int rce_flags,
+    const h26x_layout& layout) :
     media(socket, rtp, rce_flags),
+    layout_(layout),
     queued_(), 
     frames_(), 
-    received_frames_(),
-    received_info_(),
-    fragments_(UINT16_MAX + 1, nullptr),
+    seq_timestamps_(),
+    seq_used_(),
+    fragments_(),
     dropped_ts_(),
     completed_ts_(),
     rtp_ctx_(rtp),
-    last_garbage_collection_(uvgrtp::clock::hrc::now()),
+    last_garbage_collection_(uvgrtp::clock::coarse::now()),
     discard_until_key_frame_(true)
-{}
+{
+    seq_table_pool& pool = get_seq_table_pool();
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+
+        if (!pool.tables.empty()) {
+            seq_timestamps_ = std::move(pool.tables.back().timestamps);
+            seq_used_       = std::move(pool.tables.back().used);
+            fragments_      = std::move(pool.tables.back().fragments);
+            pool.tables.pop_back();
+            return;
+        }
+    }
+
+    seq_timestamps_.resize(UINT16_MAX + 1, 0);
+    seq_used_.resize(UINT16_MAX + 1, false);
+    fragments_.resize(UINT16_MAX + 1, nullptr);
+}
 
 uvgrtp::formats::h26x::~h26x()
 {
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        stop_held_sender_ = true;
+    }
+    held_cv_.notify_one();
+
+    if (held_sender_ && held_sender_->joinable())
+        held_sender_->join();
+
     for (auto& frame : queued_)
     {
         (void)uvgrtp::frame::dealloc_frame(frame);
@@ -120,15 +185,36 @@ uvgrtp::formats::h26x::~h26x()
 
     queued_.clear();
 
-    for (auto& fragment : fragments_)
+    for (auto& frame : au_nals_)
+    {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }
+
+    for (auto& frame : frames_)
+    {
+        (void)free_flat_buffer(frame.second);
+        release_charge(frame.second);
+    }
+
+    // a fragment is stored only while its frame is being reassembled, so without frames there are none
+    for (size_t i = 0; !frames_.empty() && i < fragments_.size(); ++i)
     {
-        if (fragment != nullptr)
+        if (fragments_[i] != nullptr)
         {
-            (void)uvgrtp::frame::dealloc_frame(fragment);
+            (void)uvgrtp::frame::dealloc_frame(fragments_[i]);
+            fragments_[i] = nullptr;
         }
     }
 
-    fragments_.clear();
+    // the timestamps of the unused sequence numbers are never read, so only the used flags are cleared
+    std::fill(seq_used_.begin(), seq_used_.end(), false);
+
+    seq_table_pool& pool = get_seq_table_pool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    if (pool.tables.size() < MAX_POOLED_SEQ_TABLES) {
+        pool.tables.push_back({ std::move(seq_timestamps_), std::move(seq_used_), std::move(fragments_) });
+    }
 }
 
 /* NOTE: the area 0 - len (ie data[0] - data[len - 1]) must be addressable
@@ -167,6 +253,12 @@ ssize_t uvgrtp::formats::h26x::find_h26x_start_code(
 
         if (!prev_had_zero)
         {
+            // skip the long runs without any "00 00" pairs with the vectorized scanner first
+            if (!cur_has_zero)
+            {
+                pos = uvgrtp::formats::skip_start_code_free(data, pos, len);
+            }
+
             // since we know that start code prefix has zeros, we find the next dword that has zeros
             while (!cur_has_zero && pos + 8 <= len)
             {
@@ -317,6 +409,8 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(sockaddr_in& addr, sockaddr_
     if (!data || !data_len)
         return RTP_INVALID_VALUE;
 
+    std::lock_guard<std::mutex> lock(send_mutex_);
+
     if ((ret = fqueue_->init_transaction(data)) != RTP_OK) {
         UVG_LOG_ERROR("Invalid frame queue or failed to initialize transaction!");
         return ret;
@@ -347,6 +441,74 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(sockaddr_in& addr, sockaddr_
         return RTP_INVALID_VALUE;
     }
 
+    return send_nal_units(addr, addr6, data, nals, should_aggregate, payload_size);
+}
+
+rtp_error_t uvgrtp::formats::h26x::push_nal_units(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t* data, size_t data_len,
+    const std::vector<uvgrtp::frame::nal_unit>& nal_units, int rtp_flags)
+{
+    (void)data_len;
+    (void)rtp_flags;
+
+    rtp_error_t ret = RTP_OK;
+
+    std::lock_guard<std::mutex> lock(send_mutex_);
+
+    if ((ret = fqueue_->init_transaction(data)) != RTP_OK) {
+        UVG_LOG_ERROR("Invalid frame queue or failed to initialize transaction!");
+        return ret;
+    }
+
+    size_t payload_size = rtp_ctx_->get_payload_size();
+
+    std::vector<nal_info> nals;
+    nals.reserve(nal_units.size());
+
+    for (auto& unit : nal_units)
+    {
+        nal_info nal;
+        nal.offset = unit.offset;
+        nal.prefix_len = 0;
+        nal.size = unit.size;
+        nal.aggregate = false;
+
+        nals.push_back(nal);
+    }
+
+    bool should_aggregate = mark_aggregatable(nals, payload_size);
+
+    return send_nal_units(addr, addr6, data, nals, should_aggregate, payload_size);
+}
+
+rtp_error_t uvgrtp::formats::h26x::send_nal_units(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t* data,
+    std::vector<nal_info>& nals, bool should_aggregate, size_t payload_size)
+{
+    // the NAL units of the filtered layers are not packetized at all
+    if (filter_layers(data, nals)) {
+        if (nals.empty()) {
+            fqueue_->deinit_transaction();
+            return RTP_OK;
+        }
+        for (auto& nal : nals)
+            nal.aggregate = false;
+
+        should_aggregate = mark_aggregatable(nals, payload_size);
+    }
+
+    if (aggregation_deadline_.count())
+        return hold_nal_units(addr, addr6, data, nals, should_aggregate, payload_size);
+
+    return packetize(addr, addr6, data, nals, should_aggregate, payload_size);
+}
+
+rtp_error_t uvgrtp::formats::h26x::packetize(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t* data,
+    std::vector<nal_info>& nals, bool should_aggregate, size_t payload_size)
+{
+    rtp_error_t ret = RTP_OK;
+
+    if (fqueue_->frame_marking_enabled() || fqueue_->layer_filtering() || fqueue_->gop_caching())
+        mark_frame(data, nals);
+
     if (should_aggregate) // an aggregate packet is possible
     {
         // use aggregation function that also may just send the packets as Single NAL units 
@@ -399,6 +561,170 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(sockaddr_in& addr, sockaddr_
     return ret;
 }
 
+static bool same_destination(const sockaddr_in& a, const sockaddr_in6& a6, const sockaddr_in& b, const sockaddr_in6& b6)
+{
+    return a.sin_port == b.sin_port && a.sin_addr.s_addr == b.sin_addr.s_addr &&
+        a6.sin6_port == b6.sin6_port && !memcmp(&a6.sin6_addr, &b6.sin6_addr, sizeof(a6.sin6_addr));
+}
+
+rtp_error_t uvgrtp::formats::h26x::hold_nal_units(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t* data,
+    std::vector<nal_info>& nals, bool should_aggregate, size_t payload_size)
+{
+    rtp_error_t ret = RTP_OK;
+
+    uint32_t timestamp = rtp_ctx_->get_rtp_ts();
+    size_t capacity    = payload_size - get_payload_header_size();
+    size_t size        = 0;
+
+    // in an aggregation packet, each NAL unit is preceded by its size
+    for (auto& nal : nals)
+        size += sizeof(uint16_t) + nal.size;
+
+    bool holdable = size <= capacity;
+
+    if (!held_.nals.empty() && (!holdable || held_.timestamp != timestamp || held_.size + size > capacity ||
+        !same_destination(held_.addr, held_.addr6, addr, addr6)))
+    {
+        // the held NAL units go first, then the transaction of this frame is started again
+        fqueue_->deinit_transaction();
+
+        if ((ret = send_held_nal_units()) != RTP_OK)
+            return ret;
+
+        if ((ret = fqueue_->init_transaction(data)) != RTP_OK)
+            return ret;
+
+        fqueue_->set_timestamp(timestamp);
+    }
+
+    if (!holdable)
+        return packetize(addr, addr6, data, nals, should_aggregate, payload_size);
+
+    fqueue_->deinit_transaction();
+
+    if (held_.nals.empty()) {
+        held_.timestamp = timestamp;
+        held_.addr      = addr;
+        held_.addr6     = addr6;
+        held_.deadline  = std::chrono::steady_clock::now() + aggregation_deadline_;
+        held_cv_.notify_one();
+    }
+
+    for (auto& nal : nals) {
+        nal_info held = nal;
+        held.offset     = held_.data.size();
+        held.prefix_len = 0;
+        held.aggregate  = false;
+
+        held_.data.insert(held_.data.end(), data + nal.offset, data + nal.offset + nal.size);
+        held_.nals.push_back(held);
+    }
+    held_.size += size;
+
+    // no NAL unit would fit anymore
+    if (capacity - held_.size <= sizeof(uint16_t) + get_nal_header_size())
+        return send_held_nal_units();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::formats::h26x::send_held_nal_units()
+{
+    if (held_.nals.empty())
+        return RTP_OK;
+
+    rtp_error_t ret = fqueue_->init_transaction(held_.data.data());
+
+    if (ret == RTP_OK) {
+        fqueue_->set_timestamp(held_.timestamp);
+
+        size_t payload_size   = rtp_ctx_->get_payload_size();
+        bool should_aggregate = mark_aggregatable(held_.nals, payload_size);
+
+        ret = packetize(held_.addr, held_.addr6, held_.data.data(), held_.nals, should_aggregate, payload_size);
+    }
+
+    // the buffer is kept for the next NAL units
+    held_.data.clear();
+    held_.nals.clear();
+    held_.size = 0;
+
+    return ret;
+}
+
+void uvgrtp::formats::h26x::held_sender()
+{
+    std::unique_lock<std::mutex> lock(send_mutex_);
+
+    while (!stop_held_sender_) {
+        if (held_.nals.empty()) {
+            held_cv_.wait(lock);
+        } else if (std::chrono::steady_clock::now() < held_.deadline) {
+            held_cv_.wait_until(lock, held_.deadline);
+        } else if (send_held_nal_units() != RTP_OK) {
+            UVG_LOG_WARN("Failed to send the held NAL units");
+        }
+    }
+}
+
+rtp_error_t uvgrtp::formats::h26x::set_aggregation_deadline(size_t deadline_us)
+{
+    rtp_error_t ret = RTP_OK;
+    std::unique_ptr<std::thread> sender;
+
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        aggregation_deadline_ = std::chrono::microseconds(deadline_us);
+
+        if (deadline_us) {
+            if (!held_sender_) {
+                stop_held_sender_ = false;
+                held_sender_ = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::formats::h26x::held_sender, this));
+            }
+            return RTP_OK;
+        }
+
+        ret = send_held_nal_units();
+        stop_held_sender_ = true;
+        sender = std::move(held_sender_);
+    }
+    held_cv_.notify_one();
+
+    if (sender && sender->joinable())
+        sender->join();
+
+    return ret;
+}
+
+void uvgrtp::formats::h26x::mark_frame(uint8_t* data, const std::vector<nal_info>& nals)
+{
+    uint8_t frame_flags    = uvgrtp::FRAME_MARKING_INDEPENDENT | uvgrtp::FRAME_MARKING_DISCARDABLE;
+    uint8_t frame_layer_id = 0;
+    bool vcl = false;
+
+    // the frame is independent or discardable only if all of its slices are, the temporal
+    // and layer IDs are the same in all slices of a picture
+    for (auto& nal : nals) {
+        uint8_t flags    = 0;
+        uint8_t layer_id = 0;
+
+        if (nal.size < get_nal_header_size() || !get_nal_marking(data + nal.offset, flags, layer_id))
+            continue;
+
+        if (!vcl) {
+            frame_flags    = (uint8_t)(frame_flags | (flags & 0x07));
+            frame_layer_id = layer_id;
+            vcl = true;
+        }
+        frame_flags &= (uint8_t)(flags | 0x07);
+    }
+
+    if (!vcl)
+        frame_flags = 0;
+
+    fqueue_->set_frame_marking(frame_flags, frame_layer_id);
+}
+
 rtp_error_t uvgrtp::formats::h26x::add_aggregate_packet(uint8_t* data, size_t data_len)
 {
     // the default implementation is to just use single NAL units and don't do the aggregate packet
@@ -425,55 +751,43 @@ rtp_error_t uvgrtp::formats::h26x::single_nal_unit(uint8_t* data, size_t data_le
     return ret;
 }
 
-rtp_error_t uvgrtp::formats::h26x::divide_frame_to_fus(uint8_t* data, size_t& data_left, 
-    size_t payload_size, uvgrtp::buf_vec& buffers, uint8_t fu_headers[])
+rtp_error_t uvgrtp::formats::h26x::divide_frame_to_fus(uint8_t* data, size_t data_len,
+    size_t payload_size, const uint8_t* payload_header)
 {
-    if (data_left <= payload_size)
+    if (data_len <= payload_size)
     {
         UVG_LOG_ERROR("Cannot use FU division for packets smaller than payload size");
         return RTP_GENERIC_ERROR;
     }
 
-    rtp_error_t ret = RTP_OK;
-
     // the FU structure has both payload header and an fu header
-    size_t fu_payload_size = payload_size - get_payload_header_size() - get_fu_header_size();
+    const size_t header_size = get_payload_header_size() + get_fu_header_size();
+    size_t fu_payload_size = payload_size - header_size;
 
-    // skip NAL header of data since it is incorporated in payload and fu headers (which are repeated
-    // for each packet, but NAL header is only at the beginning of NAL unit)
-    size_t data_pos = get_nal_header_size();
-    data_left -= get_nal_header_size();
-
-    while (data_left > fu_payload_size) {
-
-        /* This seems to work by always using the payload headers in first and fu headers in the second index 
-         * of buffer (and modifying those) and replacing the payload in third, then sending all. 
-         * The headers for first fragment are already in buffers.at(1) */
-
-        // set the payload for this fragment
-        buffers.at(2).first = fu_payload_size;
-        buffers.at(2).second = &data[data_pos];
-
-        if ((ret = fqueue_->enqueue_message(buffers)) != RTP_OK) {
-            UVG_LOG_ERROR("Queueing the FU packet failed!");
-            return ret;
-        }
+    /* The payload header and FU header of the first, middle and last fragment, back to back.
+     * They are given per NAL unit, because one frame may have several fragmented NAL units */
+    uint8_t* headers = fqueue_->alloc_media_headers(3 * header_size);
+    if (!headers)
+    {
+        return RTP_MEMORY_ERROR;
+    }
 
-        data_pos += fu_payload_size;
-        data_left -= fu_payload_size;
+    uint8_t fu_headers[3];
+    initialize_fu_headers(get_nal_type(data), fu_headers);
 
-        buffers.at(1).second = &fu_headers[1]; // middle fragment header
+    for (size_t i = 0; i < 3; ++i)
+    {
+        std::memcpy(&headers[i * header_size], payload_header, get_payload_header_size());
+        headers[i * header_size + get_payload_header_size()] = fu_headers[i];
     }
 
-    buffers.at(1).second = &fu_headers[2]; // last fragment header
-
-    // set payload for the last fragment
-    buffers.at(2).first = data_left;
-    buffers.at(2).second = &data[data_pos];
+    // skip NAL header of data since it is incorporated in payload and fu headers (which are repeated
+    // for each packet, but NAL header is only at the beginning of NAL unit)
+    rtp_error_t ret = fqueue_->enqueue_fragments(headers, header_size, data + get_nal_header_size(),
+        data_len - get_nal_header_size(), fu_payload_size);
 
-    // send the last fragment
-    if ((ret = fqueue_->enqueue_message(buffers)) != RTP_OK) {
-        UVG_LOG_ERROR("Failed to send the last fragment of an H26x frame!");
+    if (ret != RTP_OK) {
+        UVG_LOG_ERROR("Queueing the FU packets failed!");
     }
 
     return ret;
@@ -497,7 +811,7 @@ uvgrtp::frame::rtp_frame* uvgrtp::formats::h26x::allocate_rtp_frame_with_startco
         complete->payload_len += 4;
     } 
     
-    complete->payload = new uint8_t[complete->payload_len];
+    complete->payload = uvgrtp::frame_pool::alloc_payload(complete->payload_len);
 
     if (add_start_code && complete->payload_len >= 4) {
         complete->payload[0] = 0;
@@ -515,7 +829,20 @@ uvgrtp::frame::rtp_frame* uvgrtp::formats::h26x::allocate_rtp_frame_with_startco
 void uvgrtp::formats::h26x::prepend_start_code(int rce_flags, uvgrtp::frame::rtp_frame** out)
 {
     if (!(rce_flags & RCE_NO_H26X_PREPEND_SC)) {
-        uint8_t* pl = new uint8_t[(*out)->payload_len + 4];
+        // the already parsed RTP header in front of the payload leaves room for the start code
+        if ((*out)->dgram_owned && (size_t)((*out)->payload - (*out)->dgram) >= 4) {
+            (*out)->payload     -= 4;
+            (*out)->payload_len += 4;
+
+            uint8_t* pl = (*out)->payload;
+            pl[0] = 0;
+            pl[1] = 0;
+            pl[2] = 0;
+            pl[3] = 1;
+            return;
+        }
+
+        uint8_t* pl = uvgrtp::frame_pool::alloc_payload((*out)->payload_len + 4);
 
         pl[0] = 0;
         pl[1] = 0;
@@ -523,7 +850,7 @@ void uvgrtp::formats::h26x::prepend_start_code(int rce_flags, uvgrtp::frame::rtp
         pl[3] = 1;
 
         std::memcpy(pl + 4, (*out)->payload, (*out)->payload_len);
-        delete[](*out)->payload;
+        uvgrtp::frame_pool::release_payload(*out);
 
         (*out)->payload = pl;
         (*out)->payload_len += 4;
@@ -552,16 +879,25 @@ size_t uvgrtp::formats::h26x::drop_frame(uint32_t ts)
         ts, s_seq, e_seq, frames_[ts].received_packet_seqs.size(), calculate_expected_fus(ts));
     */
 
-    for (auto& fragment_seq : frames_[ts].received_packet_seqs)
-    {
-        total_cleaned += fragments_[fragment_seq]->payload_len + sizeof(uvgrtp::frame::rtp_frame);
-        free_fragment(fragment_seq);
+    if (frames_[ts].flat) {
+        total_cleaned += free_flat_buffer(frames_[ts]);
+    } else {
+        frames_[ts].received_packet_seqs.for_each([&](uint16_t fragment_seq) {
+            total_cleaned += fragments_[fragment_seq]->payload_len + sizeof(uvgrtp::frame::rtp_frame);
+            free_fragment(fragment_seq);
+        });
     }
 
-    dropped_ts_[ts] = frames_.at(ts).sframe_time;
-    frames_.erase(ts);
+    release_charge(frames_[ts]);
+    mark_dropped(ts, frames_.at(ts).sframe_time);
+    erase_frame(ts);
+
+    if (metrics_)
+        metrics_->count(uvgrtp::stream_metrics::DROPPED_FRAMES);
 
     discard_until_key_frame_ = true;
+    need_parameter_sets_     = true;
+    request_key_frame();
 
     return total_cleaned;
 }
@@ -595,6 +931,7 @@ rtp_error_t uvgrtp::formats::h26x::handle_aggregation_packet(uvgrtp::frame::rtp_
         bool prepend_startcode = !(rce_flags & RCE_NO_H26X_PREPEND_SC);
         uvgrtp::frame::rtp_frame* retframe = 
             allocate_rtp_frame_with_startcode(prepend_startcode, (*out)->header, nalus[i].first, fptr);
+        retframe->recv_time = (*out)->recv_time;
         
         std::memcpy(
             retframe->payload + fptr,
@@ -610,145 +947,561 @@ rtp_error_t uvgrtp::formats::h26x::handle_aggregation_packet(uvgrtp::frame::rtp_
 
 bool uvgrtp::formats::h26x::is_duplicate_frame(uint32_t timestamp, uint16_t seq_num)
 {
-    if (received_info_.find(timestamp) != received_info_.end()) {
-        if (std::find(received_info_.at(timestamp).begin(), received_info_.at(timestamp).end(), seq_num) != received_info_.at(timestamp).end()) {
-            UVG_LOG_WARN("duplicate ts and seq num received, discarding frame");
-            return true;
-        }
-    }
-    pkt_stats stats = {timestamp, seq_num};
-
-    // Save the received ts and seq num
-    if (received_info_.find(timestamp) == received_info_.end()) {
-        received_info_.insert({timestamp, {seq_num}});
-    }
-    else {
-        received_info_.at(timestamp).push_back(seq_num);
+    if (seq_used_[seq_num] && seq_timestamps_[seq_num] == timestamp) {
+        UVG_LOG_WARN("duplicate ts and seq num received, discarding frame");
+        if (metrics_)
+            metrics_->count(uvgrtp::stream_metrics::DUPLICATE_PACKETS);
+        return true;
     }
-    received_frames_.push_back(stats);
 
-    if (received_frames_.size() > RECEIVED_FRAMES) {
-        received_info_.erase(received_frames_.front().ts);
-        received_frames_.pop_front();
-    }
+    // Save the received ts and seq num, this replaces the packet from one sequence number cycle ago
+    seq_timestamps_[seq_num] = timestamp;
+    seq_used_[seq_num]       = true;
     return false;
 }
 
-rtp_error_t uvgrtp::formats::h26x::packet_handler(void* args, int rce_flags, uint8_t* read_ptr, size_t size, uvgrtp::frame::rtp_frame** out)
+void uvgrtp::formats::h26x::mark_completed(uint32_t ts, uvgrtp::clock::hrc::hrc_t time)
 {
-    (void)args;
-    (void)read_ptr;
-    (void)size;
-    uvgrtp::frame::rtp_frame* frame = *out;
+    set_mark(completed_ts_, ts, time);
+    completed_expiry_.push_back({ time, ts });
 
-    if (is_duplicate_frame(frame->header.timestamp, frame->header.seq)) {
-        (void)uvgrtp::frame::dealloc_frame(*out);
-        *out = nullptr;
-        return RTP_GENERIC_ERROR;
-    }
+    if (metrics_)
+        metrics_->record(uvgrtp::stream_metrics::REASSEMBLY_LATENCY_US, uvgrtp::clock::hrc::diff_now_us(time));
+}
 
-    // aggregate, start, middle, end or single NAL
-    uvgrtp::formats::FRAG_TYPE frag_type = get_fragment_type(frame); 
+void uvgrtp::formats::h26x::mark_dropped(uint32_t ts, uvgrtp::clock::hrc::hrc_t time)
+{
+    set_mark(dropped_ts_, ts, time);
+    dropped_expiry_.push_back({ time, ts });
+}
 
-    // first we check that this packet does not belong to a frame that has been dropped or completed
-    if (dropped_ts_.find(frame->header.timestamp) != dropped_ts_.end()) {
-        UVG_LOG_DEBUG("Received an RTP packet belonging to a dropped frame! Timestamp: %lu, seq: %u",
-            frame->header.timestamp, frame->header.seq);
-        (void)uvgrtp::frame::dealloc_frame(frame); // free fragment memory
-        return RTP_GENERIC_ERROR;
-    }
+void uvgrtp::formats::h26x::set_congestion_check(std::function<bool()> congested)
+{
+    congested_ = congested;
+}
 
-    if (completed_ts_.find(frame->header.timestamp) != completed_ts_.end()) {
-        UVG_LOG_DEBUG("Received an RTP packet belonging to a completed frame! Timestamp: %lu, seq: %u",
-            frame->header.timestamp, frame->header.seq);
-        (void)uvgrtp::frame::dealloc_frame(frame); // free fragment memory
-        return RTP_GENERIC_ERROR;
-    }
+void uvgrtp::formats::h26x::set_layer_limits(uint8_t max_tid, uint8_t max_layer_id)
+{
+    max_temporal_id_.store(max_tid, std::memory_order_relaxed);
+    max_layer_id_.store(max_layer_id, std::memory_order_relaxed);
+}
 
-    if (frag_type == uvgrtp::formats::FRAG_TYPE::FT_AGGR) {
-        // handle aggregate packets (packets with multiple NAL units in them)
-        return handle_aggregation_packet(out, get_payload_header_size(), rce_flags);
-    }
-    else if (frag_type == uvgrtp::formats::FRAG_TYPE::FT_STAP_B) {
-        // Handle H264 STAP-B packet, RFC 6184 5.7.1
-        // DON is made up of the 16 bits after STAP-B header.
-        // Commented out to prevent werrors, DON is not currently used anywhere.
-        /* uint16_t don = ((uint16_t)frame->payload[1] << 8) | frame->payload[2]; */
+bool uvgrtp::formats::h26x::filter_layers(uint8_t* data, std::vector<nal_info>& nals)
+{
+    const uint8_t max_tid      = max_temporal_id_.load(std::memory_order_relaxed);
+    const uint8_t max_layer_id = max_layer_id_.load(std::memory_order_relaxed);
 
-        // payload_header_size + 2 comes from DON field in STAP-B packets being 16 bits long
-        return handle_aggregation_packet(out, get_payload_header_size()+2, rce_flags);
-    }
-    else if (frag_type == uvgrtp::formats::FRAG_TYPE::FT_NOT_FRAG) { // Single NAL unit
+    if (max_tid == uvgrtp::MAX_TEMPORAL_ID && max_layer_id == uvgrtp::MAX_LAYER_ID)
+        return false;
 
-        // TODO: Check if previous dependencies have been sent forward
+    const size_t count = nals.size();
 
-        // TODO: We should detect duplicate packets, but there are legitimate situations
-        //  where single NAL units have same timestamps
-        //completed_ts_[frame->header.timestamp] = std::chrono::high_resolution_clock::now();
+    nals.erase(std::remove_if(nals.begin(), nals.end(), [&](const nal_info& nal) {
+        uint8_t tid      = 0;
+        uint8_t layer_id = 0;
 
-        // nothing special needs to be done, just possibly add start codes back
-        prepend_start_code(rce_flags, out);
-        return RTP_PKT_READY;
-    }
-    else if (frag_type == uvgrtp::formats::FRAG_TYPE::FT_INVALID) {
-        // something is wrong
-        UVG_LOG_WARN("invalid frame received!");
-        (void)uvgrtp::frame::dealloc_frame(*out);
-        *out = nullptr;
-        return RTP_GENERIC_ERROR;
-    }
+        return nal.size >= get_nal_header_size() && get_layer_ids(data + nal.offset, tid, layer_id) &&
+            (tid > max_tid || layer_id > max_layer_id);
+    }), nals.end());
 
-    // We have received a fragment. Rest of the function deals with fragmented frames
+    return nals.size() != count;
+}
 
-    // Fragment timestamp, all fragments of the same frame have the same timestamp
-    uint32_t fragment_ts = frame->header.timestamp;
+bool uvgrtp::formats::h26x::skip_frame(const uvgrtp::frame::rtp_frame* frame)
+{
+    const uint32_t ts = frame->header.timestamp;
+
+    const uint8_t max_tid      = max_temporal_id_.load(std::memory_order_relaxed);
+    const uint8_t max_layer_id = max_layer_id_.load(std::memory_order_relaxed);
+
+    /* The layers of a NAL unit are in the payload header of every packet that carries it, so
+     * the packets of the higher layers are left out one by one, also when a picture of several
+     * layers shares one timestamp */
+    uint8_t tid      = 0;
+    uint8_t layer_id = 0;
+    bool layers      = frame->payload_len >= get_payload_header_size() &&
+        get_layer_ids(frame->payload, tid, layer_id);
+
+    if (layers && (tid > max_tid || layer_id > max_layer_id)) {
+        if (!layer_skipped_ || layer_skip_ts_ != ts) {
+            layer_skipped_ = true;
+            layer_skip_ts_ = ts;
+
+            if (metrics_)
+                metrics_->count(uvgrtp::stream_metrics::SKIPPED_FRAMES);
+        }
+        return true;
+    }
 
-    // Fragment sequence number, determines the order of the fragments within frame
-    uint16_t fragment_seq = frame->header.seq;      
+    uint8_t id = frame_marking_id_.load(std::memory_order_relaxed);
 
-    uvgrtp::formats::NAL_TYPE nal_type = get_nal_type(frame); // Intra, inter or some other type of frame
-    
-    // Initialize new frame if this is the first packet with this timestamp
-    if (frames_.find(fragment_ts) == frames_.end()) {
-        initialize_new_fragmented_frame(fragment_ts, nal_type);
-    }
-    else if (frames_[fragment_ts].received_packet_seqs.find(fragment_seq) !=
-        frames_[fragment_ts].received_packet_seqs.end()) {
+    if (!id || !frame->ext)
+        return false;
 
-        // we have already received this seq
-        UVG_LOG_DEBUG("Detected duplicate fragment, dropping! Fragment ts: %lu, Seq: %u", 
-            fragment_ts, fragment_seq);
-        (void)uvgrtp::frame::dealloc_frame(frame); // free fragment memory
-        *out = nullptr;
-        return RTP_GENERIC_ERROR;
-    }
+    size_t len = 0;
+    const uint8_t* marking = uvgrtp::find_header_extension(frame->ext, id, len);
 
-    const uint8_t sizeof_fu_headers = (uint8_t)get_payload_header_size() + 
-                                               get_fu_header_size();
+    if (!marking || len == 0)
+        return false;
 
-    if (frames_[fragment_ts].nal_type != nal_type)
-    {
-        UVG_LOG_ERROR("The fragment has different NAL type fragments before!");
-        (void)uvgrtp::frame::dealloc_frame(frame); // free fragment memory
-        return RTP_GENERIC_ERROR;
-    }
+    if (marking_decided_ && marking_ts_ == ts)
+        return marking_skip_;
 
-    // keep track of fragments belonging to this frame in case we need to delete them
-    frames_[fragment_ts].received_packet_seqs.insert(fragment_seq);
-    frames_[fragment_ts].total_size += (frame->payload_len - sizeof_fu_headers);
+    /* The layers below a temporal layer do not refer to it and no frame refers to a discardable
+     * one, so they can go without the decoder missing them. The temporal ID of the marking is
+     * only needed by the formats without layers in their headers. The frames already being
+     * reassembled are kept, their packets only came out of order */
+    bool skip = frames_.find(ts) == frames_.end() &&
+        ((!layers && (marking[0] & uvgrtp::FRAME_MARKING_TID_MASK) > max_tid) ||
+         ((marking[0] & uvgrtp::FRAME_MARKING_DISCARDABLE) && congested_ && congested_()));
 
-    if (fragments_[fragment_seq] != nullptr)
-    {
-        UVG_LOG_WARN("Found an existing fragment with same sequence number %u! Fragment ts: %lu, current ts: %lu",
-            fragment_seq, fragments_[fragment_seq]->header.timestamp, fragment_ts);
+    marking_decided_ = true;
+    marking_ts_      = ts;
+    marking_skip_    = skip;
 
-        free_fragment(fragment_seq);
+    if (skip) {
+        UVG_LOG_DEBUG("Leaving out the marked frame %lu, seq: %u", ts, frame->header.seq);
+        if (metrics_)
+            metrics_->count(uvgrtp::stream_metrics::SKIPPED_FRAMES);
     }
 
-    // save the fragment for later reconstruction
-    fragments_[fragment_seq] = frame;
+    return skip;
+}
 
-    // if this is first or last, save it to help with reconstruction
+// the start code is prepended to the received NAL units unless RCE_NO_H26X_PREPEND_SC is set
+static size_t start_code_length(const uint8_t* data, size_t len)
+{
+    if (len >= 4 && data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 1)
+        return 4;
+    if (len >= 3 && data[0] == 0 && data[1] == 0 && data[2] == 1)
+        return 3;
+    return 0;
+}
+
+bool uvgrtp::formats::h26x::is_key_frame(const uvgrtp::frame::rtp_frame* frame) const
+{
+    size_t start_len = start_code_length(frame->payload, frame->payload_len);
+
+    if (frame->payload_len - start_len < get_nal_header_size())
+        return false;
+
+    return is_key_nal_type(get_nal_type(frame->payload + start_len));
+}
+
+void uvgrtp::formats::h26x::set_parameter_set_prepending(bool prepend)
+{
+    prepend_parameter_sets_.store(prepend, std::memory_order_relaxed);
+}
+
+rtp_error_t uvgrtp::formats::h26x::get_parameter_sets(std::vector<uint8_t>& parameter_sets)
+{
+    std::lock_guard<std::mutex> lock(parameter_sets_mutex_);
+
+    parameter_sets.clear();
+
+    for (auto& set : parameter_sets_) {
+        if (set.empty())
+            continue;
+
+        parameter_sets.insert(parameter_sets.end(), { 0, 0, 0, 1 });
+        parameter_sets.insert(parameter_sets.end(), set.begin(), set.end());
+    }
+
+    return parameter_sets.empty() ? RTP_NOT_FOUND : RTP_OK;
+}
+
+void uvgrtp::formats::h26x::complete_nal_units(rtp_error_t ret, uvgrtp::frame::rtp_frame** out, size_t queued)
+{
+    if (ret == RTP_PKT_READY) {
+        check_parameter_sets(out);
+    } else if (ret == RTP_MULTIPLE_PKTS_READY) {
+        for (size_t i = queued; i < queued_.size(); ++i) {
+            check_parameter_sets(&queued_[i]);
+        }
+    }
+}
+
+void uvgrtp::formats::h26x::check_parameter_sets(uvgrtp::frame::rtp_frame** frame)
+{
+    uvgrtp::frame::rtp_frame* nal = *frame;
+    size_t start_len = start_code_length(nal->payload, nal->payload_len);
+
+    if (nal->payload_len - start_len < get_nal_header_size())
+        return;
+
+    uint8_t* data    = nal->payload + start_len;
+    size_t len       = nal->payload_len - start_len;
+    uint8_t nal_type = get_nal_type(data);
+    int index        = parameter_set_index(nal_type);
+
+    if (index >= 0) {
+        std::lock_guard<std::mutex> lock(parameter_sets_mutex_);
+        parameter_sets_[index].assign(data, data + len);
+
+        // a set that comes in front of the key frame is not prepended to it again
+        delivered_parameter_sets_ |= (uint8_t)(1 << index);
+        return;
+    }
+
+    if (!need_parameter_sets_ || !is_key_nal_type(nal_type))
+        return;
+
+    need_parameter_sets_ = false;
+    uint8_t delivered    = delivered_parameter_sets_;
+    delivered_parameter_sets_ = 0;
+
+    // without the start codes the application could not tell the prepended NAL units apart
+    if (!prepend_parameter_sets_.load(std::memory_order_relaxed) || start_len == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(parameter_sets_mutex_);
+
+    size_t size = 0;
+    for (int i = 0; i < 3; ++i) {
+        if (!(delivered & (1 << i)) && !parameter_sets_[i].empty())
+            size += 4 + parameter_sets_[i].size();
+    }
+
+    if (size == 0)
+        return;
+
+    // the sets are written in place if the datagram has room in front of the payload, otherwise the frame is copied
+    uint8_t* pl = nullptr;
+
+    if (nal->dgram_owned && (size_t)(nal->payload - nal->dgram) >= size) {
+        pl = nal->payload - size;
+    } else {
+        pl = uvgrtp::frame_pool::alloc_payload(size + nal->payload_len);
+        std::memcpy(pl + size, nal->payload, nal->payload_len);
+        uvgrtp::frame_pool::release_payload(nal);
+    }
+
+    size_t offset = 0;
+    for (int i = 0; i < 3; ++i) {
+        if ((delivered & (1 << i)) || parameter_sets_[i].empty())
+            continue;
+
+        pl[offset]     = 0;
+        pl[offset + 1] = 0;
+        pl[offset + 2] = 0;
+        pl[offset + 3] = 1;
+        std::memcpy(pl + offset + 4, parameter_sets_[i].data(), parameter_sets_[i].size());
+        offset += 4 + parameter_sets_[i].size();
+    }
+
+    nal->payload      = pl;
+    nal->payload_len += size;
+
+    UVG_LOG_DEBUG("Prepended %zu bytes of parameter sets to the key frame %lu", size, nal->header.timestamp);
+}
+
+rtp_error_t uvgrtp::formats::h26x::packet_handler(void* args, int rce_flags, uint8_t* read_ptr, size_t size, uvgrtp::frame::rtp_frame** out)
+{
+    (void)args;
+    (void)read_ptr;
+    (void)size;
+
+    if (!fec_enabled()) {
+        return handle_packet(rce_flags, out);
+    }
+
+    fec_packets_.clear();
+    recover_packets(rce_flags, *out, fec_packets_);
+    *out = nullptr;
+
+    // the completed frames of all the packets are given to the user through the frame getter
+    const size_t queued = queued_.size();
+
+    for (auto& packet : fec_packets_) {
+        uvgrtp::frame::rtp_frame *frame = packet;
+
+        if (handle_packet(rce_flags, &frame) == RTP_PKT_READY) {
+            queued_.push_back(frame);
+        }
+    }
+
+    return queued_.size() > queued ? RTP_MULTIPLE_PKTS_READY : RTP_OK;
+}
+
+rtp_error_t uvgrtp::formats::h26x::handle_packet(int rce_flags, uvgrtp::frame::rtp_frame** out)
+{
+    track_losses(*out);
+
+    if (skip_frame(*out)) {
+        (void)uvgrtp::frame::dealloc_frame(*out);
+        *out = nullptr;
+        return RTP_GENERIC_ERROR;
+    }
+
+    if (rce_flags & RCE_H26X_ACCESS_UNIT) {
+        return access_unit_handler(rce_flags, out);
+    }
+
+    const size_t queued = queued_.size();
+    rtp_error_t ret = nal_unit_handler(rce_flags, out);
+
+    complete_nal_units(ret, out, queued);
+    return ret;
+}
+
+rtp_error_t uvgrtp::formats::h26x::access_unit_handler(int rce_flags, uvgrtp::frame::rtp_frame** out)
+{
+    const uint32_t ts = (*out)->header.timestamp;
+    const bool marker = (*out)->header.marker;
+    const size_t queued = queued_.size();
+
+    // decoders need the start codes to find the NAL units of an access unit
+    rtp_error_t ret = nal_unit_handler(rce_flags & ~RCE_NO_H26X_PREPEND_SC, out);
+
+    complete_nal_units(ret, out, queued);
+
+    if (marker) {
+        au_marker_seen_ = true;
+        au_marker_ts_   = ts;
+    }
+
+    std::vector<uvgrtp::frame::rtp_frame*> completed;
+
+    if (ret == RTP_PKT_READY) {
+        completed.push_back(*out);
+        *out = nullptr;
+    } else if (ret == RTP_MULTIPLE_PKTS_READY) {
+        completed.assign(queued_.begin() + queued, queued_.end());
+        queued_.erase(queued_.begin() + queued, queued_.end());
+    } else {
+        return ret;
+    }
+
+    for (auto& nal : completed) {
+        // a NAL unit of the next picture, the marker packet of the pending one was lost
+        if (!au_nals_.empty() && nal->header.timestamp != au_ts_) {
+            flush_access_unit();
+        }
+
+        au_ts_    = nal->header.timestamp;
+        au_size_ += nal->payload_len;
+        au_nals_.push_back(nal);
+    }
+
+    // the marker has arrived and no NAL unit of the picture is being reassembled anymore
+    if (!au_nals_.empty() && au_marker_seen_ && au_marker_ts_ == au_ts_ &&
+        frames_.find(au_ts_) == frames_.end()) {
+        flush_access_unit();
+    }
+
+    return queued_.size() > queued ? RTP_MULTIPLE_PKTS_READY : RTP_OK;
+}
+
+void uvgrtp::formats::h26x::flush_access_unit()
+{
+    const bool marker = au_marker_seen_ && au_marker_ts_ == au_ts_;
+
+    if (marker) {
+        au_marker_seen_ = false;
+    }
+
+    if (au_nals_.size() == 1) {
+        queued_.push_back(au_nals_.front());
+    } else {
+        uvgrtp::frame::rtp_frame* au = uvgrtp::frame::alloc_rtp_frame();
+
+        au->header      = au_nals_.front()->header;
+        au->recv_time   = au_nals_.back()->recv_time;
+        au->payload     = uvgrtp::frame_pool::alloc_payload(au_size_);
+        au->payload_len = au_size_;
+
+        size_t offset = 0;
+        for (auto& nal : au_nals_) {
+            std::memcpy(au->payload + offset, nal->payload, nal->payload_len);
+            offset += nal->payload_len;
+
+            (void)uvgrtp::frame::dealloc_frame(nal);
+        }
+        queued_.push_back(au);
+    }
+
+    queued_.back()->header.marker = marker;
+
+    au_nals_.clear();
+    au_size_ = 0;
+}
+
+rtp_error_t uvgrtp::formats::h26x::nal_unit_handler(int rce_flags, uvgrtp::frame::rtp_frame** out)
+{
+    uvgrtp::frame::rtp_frame* frame = *out;
+
+    if (is_duplicate_frame(frame->header.timestamp, frame->header.seq)) {
+        (void)uvgrtp::frame::dealloc_frame(*out);
+        *out = nullptr;
+        return RTP_GENERIC_ERROR;
+    }
+
+    // aggregate, start, middle, end or single NAL
+    uvgrtp::formats::FRAG_TYPE frag_type = get_fragment_type(frame); 
+
+    // first we check that this packet does not belong to a frame that has been dropped or completed
+    if (dropped_ts_.find(frame->header.timestamp) != dropped_ts_.end()) {
+        UVG_LOG_DEBUG("Received an RTP packet belonging to a dropped frame! Timestamp: %lu, seq: %u",
+            frame->header.timestamp, frame->header.seq);
+        if (metrics_)
+            metrics_->count(uvgrtp::stream_metrics::LATE_PACKETS);
+        (void)uvgrtp::frame::dealloc_frame(frame); // free fragment memory
+        return RTP_GENERIC_ERROR;
+    }
+
+    if (completed_ts_.find(frame->header.timestamp) != completed_ts_.end()) {
+        UVG_LOG_DEBUG("Received an RTP packet belonging to a completed frame! Timestamp: %lu, seq: %u",
+            frame->header.timestamp, frame->header.seq);
+        if (metrics_)
+            metrics_->count(uvgrtp::stream_metrics::LATE_PACKETS);
+        (void)uvgrtp::frame::dealloc_frame(frame); // free fragment memory
+        return RTP_GENERIC_ERROR;
+    }
+
+    if (frag_type == uvgrtp::formats::FRAG_TYPE::FT_AGGR) {
+        // handle aggregate packets (packets with multiple NAL units in them)
+        return handle_aggregation_packet(out, get_payload_header_size(), rce_flags);
+    }
+    else if (frag_type == uvgrtp::formats::FRAG_TYPE::FT_STAP_B) {
+        // Handle H264 STAP-B packet, RFC 6184 5.7.1
+        // DON is made up of the 16 bits after STAP-B header.
+        // Commented out to prevent werrors, DON is not currently used anywhere.
+        /* uint16_t don = ((uint16_t)frame->payload[1] << 8) | frame->payload[2]; */
+
+        // payload_header_size + 2 comes from DON field in STAP-B packets being 16 bits long
+        return handle_aggregation_packet(out, get_payload_header_size()+2, rce_flags);
+    }
+    else if (frag_type == uvgrtp::formats::FRAG_TYPE::FT_NOT_FRAG) { // Single NAL unit
+
+        // TODO: Check if previous dependencies have been sent forward
+
+        // TODO: We should detect duplicate packets, but there are legitimate situations
+        //  where single NAL units have same timestamps
+        //completed_ts_[frame->header.timestamp] = std::chrono::high_resolution_clock::now();
+
+        // nothing special needs to be done, just possibly add start codes back
+        prepend_start_code(rce_flags, out);
+        return RTP_PKT_READY;
+    }
+    else if (frag_type == uvgrtp::formats::FRAG_TYPE::FT_INVALID) {
+        // something is wrong
+        UVG_LOG_WARN("invalid frame received!");
+        (void)uvgrtp::frame::dealloc_frame(*out);
+        *out = nullptr;
+        return RTP_GENERIC_ERROR;
+    }
+
+    // We have received a fragment. Rest of the function deals with fragmented frames
+
+    // Fragment timestamp, all fragments of the same frame have the same timestamp
+    uint32_t fragment_ts = frame->header.timestamp;
+
+    // Fragment sequence number, determines the order of the fragments within frame
+    uint16_t fragment_seq = frame->header.seq;      
+
+    uvgrtp::formats::NAL_TYPE nal_type = get_nal_type(frame); // Intra, inter or some other type of frame
+    
+    // Initialize new frame if this is the first packet with this timestamp
+    if (frames_.find(fragment_ts) == frames_.end()) {
+        initialize_new_fragmented_frame(fragment_ts, nal_type, rce_flags, frame->recv_time);
+        UVG_TRACE(FRAGMENT_FIRST, frame->header.ssrc, fragment_ts, fragment_seq);
+    }
+    else if (!frames_[fragment_ts].received_packet_seqs.fits(fragment_seq)) {
+
+        // a frame cannot span half of the sequence number space
+        UVG_LOG_WARN("Fragment %u is too far from the other fragments of frame %lu, dropping it",
+            fragment_seq, fragment_ts);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        *out = nullptr;
+        return RTP_GENERIC_ERROR;
+    }
+    else if (frames_[fragment_ts].received_packet_seqs.contains(fragment_seq)) {
+
+        // we have already received this seq
+        UVG_LOG_DEBUG("Detected duplicate fragment, dropping! Fragment ts: %lu, Seq: %u", 
+            fragment_ts, fragment_seq);
+        if (metrics_)
+            metrics_->count(uvgrtp::stream_metrics::DUPLICATE_PACKETS);
+        (void)uvgrtp::frame::dealloc_frame(frame); // free fragment memory
+        *out = nullptr;
+        return RTP_GENERIC_ERROR;
+    }
+
+    const uint8_t sizeof_fu_headers = (uint8_t)get_payload_header_size() + 
+                                               get_fu_header_size();
+
+    if (frames_[fragment_ts].nal_type != nal_type)
+    {
+        UVG_LOG_ERROR("The fragment has different NAL type fragments before!");
+        (void)uvgrtp::frame::dealloc_frame(frame); // free fragment memory
+        return RTP_GENERIC_ERROR;
+    }
+
+    const size_t charge = frame->payload_len + sizeof(uvgrtp::frame::rtp_frame);
+
+    if (memory_budget_ && !charge_fragment(fragment_ts, charge))
+    {
+        UVG_LOG_WARN("H26x frame %lu does not fit into the memory budget, dropping it", fragment_ts);
+
+        if (metrics_)
+            metrics_->count(uvgrtp::stream_metrics::SHED_FRAMES);
+
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        *out = nullptr;
+        drop_frame(fragment_ts);
+        return RTP_GENERIC_ERROR;
+    }
+    frames_[fragment_ts].charged += memory_budget_ ? charge : 0;
+
+    // keep track of fragments belonging to this frame in case we need to delete them
+    frames_[fragment_ts].received_packet_seqs.insert(fragment_seq);
+    frames_[fragment_ts].total_size += (frame->payload_len - sizeof_fu_headers);
+    frames_[fragment_ts].recv_time   = frame->recv_time;
+
+    // the fragment may be released below, so the header for the complete frame is copied
+    uvgrtp::frame::rtp_header header = frame->header;
+
+    if (frames_[fragment_ts].flat)
+    {
+        bool end_fragment = (frag_type == uvgrtp::formats::FRAG_TYPE::FT_END);
+
+        rtp_error_t ret = store_flat_fragment(frames_[fragment_ts], frame, end_fragment, sizeof_fu_headers);
+
+        if (ret == RTP_INVALID_VALUE)
+        {
+            UVG_LOG_WARN("H26x fragments are not of uniform size, dropping frame %lu and not using flat reassembly anymore",
+                fragment_ts);
+
+            flat_failed_ = true;
+            *out = nullptr;
+            drop_frame(fragment_ts);
+            return RTP_GENERIC_ERROR;
+        }
+        else if (ret != RTP_OK)
+        {
+            UVG_LOG_WARN("The fragments of H26x frame %lu do not make up a valid frame, dropping it", fragment_ts);
+
+            *out = nullptr;
+            drop_frame(fragment_ts);
+            return RTP_GENERIC_ERROR;
+        }
+        *out = nullptr;
+    }
+    else
+    {
+        if (fragments_[fragment_seq] != nullptr)
+        {
+            UVG_LOG_WARN("Found an existing fragment with same sequence number %u! Fragment ts: %lu, current ts: %lu",
+                fragment_seq, fragments_[fragment_seq]->header.timestamp, fragment_ts);
+
+            free_fragment(fragment_seq);
+        }
+
+        // save the fragment for later reconstruction
+        fragments_[fragment_seq] = frame;
+    }
+
+    // if this is first or last, save it to help with reconstruction
     if (frag_type == uvgrtp::formats::FRAG_TYPE::FT_START) {
         frames_[fragment_ts].s_seq = fragment_seq; 
         frames_[fragment_ts].start_received = true;
@@ -758,6 +1511,10 @@ rtp_error_t uvgrtp::formats::h26x::packet_handler(void* args, int rce_flags, uin
         frames_[fragment_ts].end_received = true;
     }
 
+    if (chunk_hook_ && frames_[fragment_ts].flat && !(rce_flags & RCE_H26X_DEPENDENCY_ENFORCEMENT)) {
+        deliver_nal_chunks(frames_[fragment_ts], fragment_ts);
+    }
+
     // have the first and last fragment arrived so we can possibly start reconstructing the frame?
     if (frames_[fragment_ts].start_received && frames_[fragment_ts].end_received) {
         size_t received = calculate_expected_fus(fragment_ts);
@@ -783,6 +1540,10 @@ rtp_error_t uvgrtp::formats::h26x::packet_handler(void* args, int rce_flags, uin
                 }
             }
 
+            if (frames_[fragment_ts].flat) {
+                return flat_reconstruction(out, rce_flags, fragment_ts, header);
+            }
+
             return reconstruction(out, rce_flags, fragment_ts, sizeof_fu_headers);
         }
     }
@@ -794,27 +1555,29 @@ rtp_error_t uvgrtp::formats::h26x::packet_handler(void* args, int rce_flags, uin
 
 void uvgrtp::formats::h26x::garbage_collect_lost_frames(size_t timout)
 {
-    if (uvgrtp::clock::hrc::diff_now(last_garbage_collection_) >= GARBAGE_COLLECTION_INTERVAL_MS) {
+    if (uvgrtp::clock::coarse::diff_now(last_garbage_collection_) >= GARBAGE_COLLECTION_INTERVAL_MS) {
         size_t total_cleaned = 0;
-        std::vector<uint32_t> to_remove;
 
-        // first find all frames that have been waiting for too long
-        for (auto& gc_frame : frames_) {
-            if (uvgrtp::clock::hrc::diff_now(gc_frame.second.sframe_time) > timout) {
-#ifndef __RTP_SILENT__
-                uint16_t s_seq = gc_frame.second.s_seq;
-                uint16_t e_seq = gc_frame.second.e_seq;
-                UVG_LOG_WARN("Found an old frame that has not been completed. Ts: %lu, Seq: %u <-> %u, received/expected: %lli/%lli",
-                    gc_frame.first, s_seq, e_seq, gc_frame.second.received_packet_seqs.size(), calculate_expected_fus(gc_frame.first));
-#endif
-                to_remove.push_back(gc_frame.first);
-            }
-        }
+        // first drop the frames that have been waiting for too long
+        while (!frame_expiry_.empty() && uvgrtp::clock::hrc::diff_now(frame_expiry_.front().time) > timout) {
+            expiry old_frame = frame_expiry_.front();
+            frame_expiry_.pop_front();
 
-        // remove old frames
-        for (auto& old_frame : to_remove) {
+            // the frame may have been completed or dropped already
+            auto gc_frame = frames_.find(old_frame.ts);
+            if (gc_frame == frames_.end() || gc_frame->second.sframe_time != old_frame.time) {
+                continue;
+            }
 
-            total_cleaned += drop_frame(old_frame);
+#ifndef __RTP_SILENT__
+            uint16_t s_seq = gc_frame->second.s_seq;
+            uint16_t e_seq = gc_frame->second.e_seq;
+            UVG_LOG_WARN("Found an old frame that has not been completed. Ts: %lu, Seq: %u <-> %u, received/expected: %lli/%lli",
+                gc_frame->first, s_seq, e_seq, gc_frame->second.received_packet_seqs.size(), calculate_expected_fus(gc_frame->first));
+#endif
+            if (metrics_)
+                metrics_->count(uvgrtp::stream_metrics::LATE_FRAMES);
+            total_cleaned += drop_frame(old_frame.ts);
         }
 
         if (total_cleaned > 0) {
@@ -822,47 +1585,209 @@ void uvgrtp::formats::h26x::garbage_collect_lost_frames(size_t timout)
         }
 
         // we keep track of old frames, so we don't send duplicate frames forward twice
-        std::vector<uint32_t> to_remove_completed;
-        for (auto& invalid : completed_ts_) {
-            if (uvgrtp::clock::hrc::diff_now(invalid.second) > TIME_TO_KEEP_TRACK_OF_PREVIOUS_FRAMES_MS)
-            {
-                to_remove_completed.push_back(invalid.first);
-            }
-        }
+        while (!completed_expiry_.empty() &&
+            uvgrtp::clock::hrc::diff_now(completed_expiry_.front().time) > TIME_TO_KEEP_TRACK_OF_PREVIOUS_FRAMES_MS) {
 
-        for (auto& old_invalid : to_remove_completed)
-        {
-            completed_ts_.erase(old_invalid);
+            auto completed = completed_ts_.find(completed_expiry_.front().ts);
+            if (completed != completed_ts_.end() && completed->second == completed_expiry_.front().time) {
+                erase_mark(completed_ts_, completed);
+            }
+            completed_expiry_.pop_front();
         }
 
         // we keep track of old dopped, so we don't send invalid frames forward again
-        to_remove_completed.clear();
-        for (auto& invalid : dropped_ts_) {
-            if (uvgrtp::clock::hrc::diff_now(invalid.second) > TIME_TO_KEEP_TRACK_OF_PREVIOUS_FRAMES_MS)
-            {
-                to_remove_completed.push_back(invalid.first);
+        while (!dropped_expiry_.empty() &&
+            uvgrtp::clock::hrc::diff_now(dropped_expiry_.front().time) > TIME_TO_KEEP_TRACK_OF_PREVIOUS_FRAMES_MS) {
+
+            auto dropped = dropped_ts_.find(dropped_expiry_.front().ts);
+            if (dropped != dropped_ts_.end() && dropped->second == dropped_expiry_.front().time) {
+                erase_mark(dropped_ts_, dropped);
             }
+            dropped_expiry_.pop_front();
         }
 
-        for (auto& old_invalid : to_remove_completed)
-        {
-            dropped_ts_.erase(old_invalid);
+        last_garbage_collection_ = uvgrtp::clock::coarse::now();
+    }
+}
+
+bool uvgrtp::formats::h26x::charge_fragment(uint32_t ts, size_t bytes)
+{
+    while (!memory_budget_->charge(bytes)) {
+        bool shed = false;
+
+        // the expiry queue is in the order the frames were started, so the oldest frame is found first
+        for (auto it = frame_expiry_.begin(); it != frame_expiry_.end();) {
+            auto oldest = frames_.find(it->ts);
+
+            if (oldest == frames_.end() || oldest->second.sframe_time != it->time) {
+                it = frame_expiry_.erase(it);
+                continue;
+            }
+
+            if (it->ts == ts) {
+                ++it;
+                continue;
+            }
+
+            uint32_t oldest_ts = it->ts;
+            frame_expiry_.erase(it);
+
+            UVG_LOG_DEBUG("Dropping the incomplete frame %lu to keep within the memory budget", oldest_ts);
+            if (metrics_)
+                metrics_->count(uvgrtp::stream_metrics::SHED_FRAMES);
+
+            drop_frame(oldest_ts);
+            shed = true;
+            break;
         }
 
-        last_garbage_collection_ = uvgrtp::clock::hrc::now();
+        if (!shed)
+            return false;
+    }
+
+    return true;
+}
+
+void uvgrtp::formats::h26x::release_charge(h26x_info_t& info)
+{
+    if (info.charged && memory_budget_)
+        memory_budget_->release(info.charged);
+
+    info.charged = 0;
+}
+
+void uvgrtp::formats::h26x::initialize_new_fragmented_frame(uint32_t ts, NAL_TYPE nal_type, int rce_flags, uint64_t recv_time)
+{
+    h26x_info_t& info = insert_frame(ts);
+
+    info.flat = ((rce_flags & RCE_H26X_FLAT_REASSEMBLY) || chunk_hook_) && !flat_failed_;
+    info.nal_type = nal_type;
+    info.s_seq = 0;
+    info.start_received = false;
+    info.e_seq = 0;
+    info.end_received = false;
+
+    // the frame is timed from when its first fragment was received, not from when it is processed
+    info.sframe_time = recv_time ? uvgrtp::clock::hrc::from_system_ns(recv_time) : uvgrtp::clock::hrc::now();
+    info.total_size = 0;
+
+    frame_expiry_.push_back({ info.sframe_time, ts });
+}
+
+uvgrtp::formats::h26x_info_t& uvgrtp::formats::h26x::insert_frame(uint32_t ts)
+{
+    auto existing = frames_.find(ts);
+    if (existing != frames_.end() || spare_frames_.empty()) {
+        return frames_[ts];
+    }
+
+    auto node = std::move(spare_frames_.back());
+    spare_frames_.pop_back();
+
+    node.key() = ts;
+    return frames_.insert(std::move(node)).position->second;
+}
+
+void uvgrtp::formats::h26x::erase_frame(uint32_t ts)
+{
+    auto it = frames_.find(ts);
+    if (it == frames_.end()) {
+        return;
+    }
+
+    if (spare_frames_.size() >= spare_frames_limit_) {
+        frames_.erase(it);
+        return;
+    }
+
+    // the buffers of the frame have been released or handed over, only the bitmap is kept
+    auto node = frames_.extract(it);
+    seq_bitmap seqs = std::move(node.mapped().received_packet_seqs);
+    seqs.clear();
+
+    node.mapped() = h26x_info_t();
+    node.mapped().received_packet_seqs = std::move(seqs);
+    spare_frames_.push_back(std::move(node));
+}
+
+void uvgrtp::formats::h26x::set_mark(std::unordered_map<uint32_t, uvgrtp::clock::hrc::hrc_t>& marks, uint32_t ts,
+    uvgrtp::clock::hrc::hrc_t time)
+{
+    auto existing = marks.find(ts);
+    if (existing != marks.end()) {
+        existing->second = time;
+        return;
+    }
+
+    if (spare_marks_.empty()) {
+        marks.emplace(ts, time);
+        return;
+    }
+
+    auto node = std::move(spare_marks_.back());
+    spare_marks_.pop_back();
+
+    node.key()    = ts;
+    node.mapped() = time;
+    marks.insert(std::move(node));
+}
+
+void uvgrtp::formats::h26x::erase_mark(std::unordered_map<uint32_t, uvgrtp::clock::hrc::hrc_t>& marks,
+    std::unordered_map<uint32_t, uvgrtp::clock::hrc::hrc_t>::iterator mark)
+{
+    if (spare_marks_.size() >= spare_marks_limit_) {
+        marks.erase(mark);
+        return;
     }
+
+    spare_marks_.push_back(marks.extract(mark));
 }
 
-void uvgrtp::formats::h26x::initialize_new_fragmented_frame(uint32_t ts, NAL_TYPE nal_type)
+void uvgrtp::formats::h26x::reserve_receive_state(size_t max_frame_size, double fps, size_t bytes_per_second)
 {
-    frames_[ts].nal_type = nal_type;
-    frames_[ts].s_seq = 0;
-    frames_[ts].start_received = false;
-    frames_[ts].e_seq = 0;
-    frames_[ts].end_received = false;
+    max_frame_size_ = max_frame_size;
+
+    if (max_frame_size == 0 || fps <= 0) {
+        return;
+    }
+
+    const size_t payload_size = std::max<size_t>(rtp_ctx_->get_payload_size(), 1);
+    const size_t max_delay    = rtp_ctx_->get_pkt_max_delay();
+
+    /* the frames that can be waiting for their fragments at the same time, and the frames
+     * that are remembered as completed or dropped for TIME_TO_KEEP_TRACK_OF_PREVIOUS_FRAMES_MS */
+    const size_t frames = (size_t)(fps * max_delay / 1000) + 2;
+    const size_t marks  = (size_t)(fps * TIME_TO_KEEP_TRACK_OF_PREVIOUS_FRAMES_MS / 1000) + 2;
+
+    // the fragments received within the delay, two of the largest frames if the bitrate is not known
+    const size_t bytes     = bytes_per_second ? bytes_per_second * max_delay / 1000 + max_frame_size : 2 * max_frame_size;
+    const size_t fragments = bytes / payload_size + frames;
+
+    frames_.reserve(frames);
+    completed_ts_.reserve(marks);
+    dropped_ts_.reserve(marks);
+
+    // build the nodes in a separate map so that they are complete with the bitmap of the largest frame
+    std::unordered_map<uint32_t, h26x_info_t> nodes;
+    for (size_t i = spare_frames_.size(); i < frames; ++i) {
+        nodes[(uint32_t)i].received_packet_seqs.reserve(max_frame_size / payload_size + 1);
+        spare_frames_.push_back(nodes.extract((uint32_t)i));
+    }
+
+    std::unordered_map<uint32_t, uvgrtp::clock::hrc::hrc_t> mark_nodes;
+    for (size_t i = spare_marks_.size(); i < 2 * marks; ++i) {
+        mark_nodes.emplace((uint32_t)i, uvgrtp::clock::hrc::hrc_t());
+        spare_marks_.push_back(mark_nodes.extract((uint32_t)i));
+    }
+
+    spare_frames_limit_ = std::max(spare_frames_limit_, frames);
+    spare_marks_limit_  = std::max(spare_marks_limit_, 2 * marks);
 
-    frames_[ts].sframe_time = uvgrtp::clock::hrc::now();
-    frames_[ts].total_size = 0;
+    // the fragments and the frames given to the application, whole or flat
+    uvgrtp::frame_pool::preallocate(fragments, payload_size + sizeof(uvgrtp::frame::rtp_header));
+    uvgrtp::frame_pool::preallocate(frames, max_frame_size + flat_headroom());
+
+    UVG_LOG_DEBUG("Reserved the reassembly of %zu frames, %zu fragments and %zu frame marks", frames, fragments, marks);
 }
 
 size_t uvgrtp::formats::h26x::calculate_expected_fus(uint32_t ts)
@@ -902,8 +1827,6 @@ void uvgrtp::formats::h26x::scl(uint8_t* data, size_t data_len, size_t packet_si
     uint8_t start_len = 0;
     ssize_t offset = find_h26x_start_code(data, data_len, 0, start_len);
 
-    packet_size -= get_payload_header_size(); // aggregate packet has a payload header
-
     while (offset > -1) {
         nal_info nal;
         nal.offset = size_t(offset);
@@ -916,9 +1839,6 @@ void uvgrtp::formats::h26x::scl(uint8_t* data, size_t data_len, size_t packet_si
         offset = find_h26x_start_code(data, data_len, offset, start_len);
     }
 
-    size_t aggregate_size = 0;
-    int aggregatable_packets = 0;
-
     // calculate the sizes of NAL units
     for (size_t i = 0; i < nals.size(); ++i)
     {
@@ -933,7 +1853,245 @@ void uvgrtp::formats::h26x::scl(uint8_t* data, size_t data_len, size_t packet_si
             // last NAL unit, the length is offset to end
             nals.at(i).size = data_len - nals[i].offset;
         }
+    }
+
+    can_be_aggregated = mark_aggregatable(nals, packet_size);
+}
+
+size_t uvgrtp::formats::h26x::flat_headroom() const
+{
+    // the longest start code is four bytes
+    return 4 + get_nal_header_size();
+}
+
+void uvgrtp::formats::h26x::reserve_flat_buffer(h26x_info_t& info, size_t size)
+{
+    if (size <= info.flat_capacity) {
+        return;
+    }
+
+    // start with the size of the previous frame, frames of one stream tend to be of similar size
+    size_t capacity = std::max(std::max(info.flat_capacity * 2, size),
+        std::max(last_flat_size_ + flat_headroom(), MIN_FLAT_BUFFER_SIZE));
+
+    uint8_t* buffer = uvgrtp::frame_pool::alloc_payload(capacity);
+
+    if (info.flat_buffer) {
+        std::memcpy(buffer, info.flat_buffer, info.flat_used);
+        uvgrtp::frame_pool::free_payload(info.flat_buffer);
+    }
+
+    info.flat_buffer   = buffer;
+    info.flat_capacity = capacity;
+}
+
+bool uvgrtp::formats::h26x::flat_size_allowed(const h26x_info_t& info, size_t size) const
+{
+    if (max_frame_size_ && size > max_frame_size_) {
+        return false;
+    }
+
+    return size <= (info.received_packet_seqs.size() + MAX_FLAT_GAP_FRAGMENTS) * info.fu_size;
+}
+
+rtp_error_t uvgrtp::formats::h26x::store_flat_fragment(h26x_info_t& info, uvgrtp::frame::rtp_frame* frame,
+    bool end_fragment, const uint8_t sizeof_fu_headers)
+{
+    const size_t headroom = flat_headroom();
+    size_t len = frame->payload_len - sizeof_fu_headers;
+
+    if (!info.flat_buffer) {
+        reserve_flat_buffer(info, headroom);
+        info.flat_used = headroom;
+
+        // every fragment carries the NAL unit header in its FU headers
+        get_nal_header_from_fu_headers(headroom - get_nal_header_size(), frame->payload, info.flat_buffer);
+    }
+
+    if (!end_fragment) {
+        if (info.fu_size == 0) {
+            info.fu_size = len;
+        } else if (len != info.fu_size) {
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            return RTP_INVALID_VALUE;
+        }
+    } else if (info.fu_size == 0) {
+        // a frame has one end fragment
+        if (info.flat_end) {
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            return RTP_GENERIC_ERROR;
+        }
+
+        // the place of the end fragment is not known before the size of other fragments is
+        info.flat_end = frame;
+        return RTP_OK;
+    } else if (len > info.fu_size) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return RTP_INVALID_VALUE;
+    }
+
+    if (info.flat_used == headroom) {
+        info.flat_base_seq = frame->header.seq;
+    }
+
+    int16_t index = (int16_t)(uint16_t)(frame->header.seq - info.flat_base_seq);
+
+    // the fragment is older than any copied so far, move the copied data forward to make room
+    if (index < 0) {
+        size_t shift = (size_t)-index * info.fu_size;
+
+        if (!flat_size_allowed(info, info.flat_used - headroom + shift)) {
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            return RTP_GENERIC_ERROR;
+        }
+
+        reserve_flat_buffer(info, info.flat_used + shift);
+        std::memmove(info.flat_buffer + headroom + shift, info.flat_buffer + headroom, info.flat_used - headroom);
+
+        info.flat_used    += shift;
+        info.flat_base_seq = frame->header.seq;
+        index = 0;
+    }
+
+    size_t offset = headroom + (size_t)index * info.fu_size;
+
+    if (!flat_size_allowed(info, offset + len - headroom)) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return RTP_GENERIC_ERROR;
+    }
+
+    reserve_flat_buffer(info, offset + len);
+    std::memcpy(info.flat_buffer + offset, frame->payload + sizeof_fu_headers, len);
+    info.flat_used = std::max(info.flat_used, offset + len);
 
+    (void)uvgrtp::frame::dealloc_frame(frame);
+
+    // now the pending end fragment can be placed too
+    if (info.flat_end) {
+        uvgrtp::frame::rtp_frame* end = info.flat_end;
+        info.flat_end = nullptr;
+
+        return store_flat_fragment(info, end, true, sizeof_fu_headers);
+    }
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::formats::h26x::flat_reconstruction(uvgrtp::frame::rtp_frame** out,
+    int rce_flags, uint32_t frame_timestamp, uvgrtp::frame::rtp_header& header)
+{
+    h26x_info_t& info = frames_.at(frame_timestamp);
+    const size_t headroom = flat_headroom();
+
+    if (info.flat_used - headroom != info.total_size) {
+        UVG_LOG_ERROR("Reassembled frame has %zu bytes, expected %zu", info.flat_used - headroom, info.total_size);
+        drop_frame(frame_timestamp);
+        return RTP_GENERIC_ERROR;
+    }
+
+    /* The frame owns the output buffer as its datagram, so the start code can be
+     * written in place to the room that was left in front of the NAL unit header */
+    uvgrtp::frame::rtp_frame* complete = uvgrtp::frame::alloc_rtp_frame();
+
+    complete->header      = header;
+    complete->recv_time   = info.recv_time;
+    complete->dgram       = info.flat_buffer;
+    complete->dgram_size  = info.flat_capacity;
+    complete->dgram_owned = true;
+    complete->payload     = info.flat_buffer + headroom - get_nal_header_size();
+    complete->payload_len = get_nal_header_size() + info.total_size;
+
+    info.flat_buffer   = nullptr;
+    info.flat_capacity = 0;
+    last_flat_size_    = info.total_size;
+
+    prepend_start_code(rce_flags, &complete);
+    *out = complete;
+    UVG_TRACE(FRAME_COMPLETE, header.ssrc, frame_timestamp, complete->payload_len);
+
+    // keep track of completed frames so we don't accept the same frame again
+    mark_completed(frame_timestamp, info.sframe_time);
+    release_charge(info);
+    erase_frame(frame_timestamp);
+    return RTP_PKT_READY;
+}
+
+rtp_error_t uvgrtp::formats::h26x::install_nal_chunk_hook(void *arg, void (*hook)(void *, const uvgrtp::frame::nal_chunk *))
+{
+    chunk_hook_arg_ = arg;
+    chunk_hook_     = hook;
+    return RTP_OK;
+}
+
+void uvgrtp::formats::h26x::deliver_nal_chunks(h26x_info_t& info, uint32_t ts)
+{
+    // the chunks are counted from the start fragment, which must begin the data area
+    if (!info.start_received || info.flat_base_seq != info.s_seq || info.flat_end) {
+        return;
+    }
+
+    if (info.chunk_delivered == 0) {
+        info.next_chunk_seq = info.s_seq;
+    }
+
+    const size_t nal_header_size = get_nal_header_size();
+    size_t available = info.chunk_delivered;
+    bool last = false;
+
+    while (!last && info.received_packet_seqs.contains(info.next_chunk_seq)) {
+        last = (info.end_received && info.next_chunk_seq == info.e_seq);
+
+        if (last) {
+            available = nal_header_size + info.flat_used - flat_headroom();
+        } else {
+            available = nal_header_size + (size_t)(uint16_t)(info.next_chunk_seq - info.s_seq + 1) * info.fu_size;
+        }
+        ++info.next_chunk_seq;
+    }
+
+    if (available == info.chunk_delivered) {
+        return;
+    }
+
+    uvgrtp::frame::nal_chunk chunk;
+    chunk.timestamp = ts;
+    chunk.offset    = info.chunk_delivered;
+    chunk.data      = info.flat_buffer + flat_headroom() - nal_header_size + info.chunk_delivered;
+    chunk.len       = available - info.chunk_delivered;
+    chunk.last      = last;
+
+    info.chunk_delivered = available;
+    chunk_hook_(chunk_hook_arg_, &chunk);
+}
+
+size_t uvgrtp::formats::h26x::free_flat_buffer(h26x_info_t& info)
+{
+    size_t freed = info.flat_capacity;
+
+    if (info.flat_buffer) {
+        uvgrtp::frame_pool::free_payload(info.flat_buffer);
+        info.flat_buffer = nullptr;
+    }
+    info.flat_capacity = 0;
+
+    if (info.flat_end) {
+        freed += info.flat_end->payload_len + sizeof(uvgrtp::frame::rtp_frame);
+        (void)uvgrtp::frame::dealloc_frame(info.flat_end);
+        info.flat_end = nullptr;
+    }
+
+    return freed;
+}
+
+bool uvgrtp::formats::h26x::mark_aggregatable(std::vector<nal_info>& nals, size_t packet_size)
+{
+    size_t aggregate_size = 0;
+    int aggregatable_packets = 0;
+
+    packet_size -= get_payload_header_size(); // aggregate packet has a payload header
+
+    for (size_t i = 0; i < nals.size(); ++i)
+    {
         // each NAL unit added to aggregate packet needs the size added which has to be taken into account
         // when calculating the aggregate packet 
         // (NOTE: This is not enough for MTAP in h264, but I doubt uvgRTP will support it)
@@ -945,7 +2103,7 @@ void uvgrtp::formats::h26x::scl(uint8_t* data, size_t data_len, size_t packet_si
         }
     }
 
-    can_be_aggregated = (aggregatable_packets >= 2);
+    return (aggregatable_packets >= 2);
 }
 
 rtp_error_t uvgrtp::formats::h26x::reconstruction(uvgrtp::frame::rtp_frame** out, 
@@ -953,15 +2111,13 @@ rtp_error_t uvgrtp::formats::h26x::reconstruction(uvgrtp::frame::rtp_frame** out
 {
     uvgrtp::frame::rtp_frame* frame = *out;
 
-    //LOG_DEBUG("Reconstructing frame. Ts: %lu, Seq: %u -> %u", frame_timestamp, 
-    //    frames_.at(frame_timestamp).s_seq, frames_.at(frame_timestamp).e_seq);
-
     // Reconstruction of frame from fragments
     size_t fptr = 0;
 
     // allocating the frame with start code ready saves a copy operation for the frame
     uvgrtp::frame::rtp_frame* complete = allocate_rtp_frame_with_startcode(!(rce_flags & RCE_NO_H26X_PREPEND_SC),
         frame->header, get_nal_header_size() + frames_[frame_timestamp].total_size, fptr);
+    complete->recv_time = frames_[frame_timestamp].recv_time;
 
     // construct the NAL header from fragment header of current fragment
     get_nal_header_from_fu_headers(fptr, frame->payload, complete->payload); // NAL header
@@ -988,9 +2144,11 @@ rtp_error_t uvgrtp::formats::h26x::reconstruction(uvgrtp::frame::rtp_frame** out
     }
 
     *out = complete;      // save result to output
+    UVG_TRACE(FRAME_COMPLETE, complete->header.ssrc, frame_timestamp, complete->payload_len);
 
     // keep track of completed frames so we don't accept the same frame again
-    completed_ts_[frame_timestamp] = frames_.at(frame_timestamp).sframe_time;
-    frames_.erase(frame_timestamp);  // erase data structures for this frame
+    mark_completed(frame_timestamp, frames_.at(frame_timestamp).sframe_time);
+    release_charge(frames_.at(frame_timestamp));
+    erase_frame(frame_timestamp);  // erase data structures for this frame
     return RTP_PKT_READY; // indicate that we have a frame ready
 }
@@ -7,9 +7,15 @@
 #include "media.hh"
 #include "../socket.hh"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <deque>
+#include <functional>
 #include <memory>
-#include <set>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <unordered_set>
 #ifdef _WIN32
 #include <ws2def.h>
@@ -45,6 +51,9 @@ namespace uvgrtp {
             /* clock reading when the first fragment is received */
             uvgrtp::clock::hrc::hrc_t sframe_time;
 
+            /* rtp_frame::recv_time of the latest fragment */
+            uint64_t recv_time = 0;
+
             uvgrtp::formats::NAL_TYPE nal_type = uvgrtp::formats::NAL_TYPE::NT_OTHER;
 
             bool start_received = false;
@@ -59,8 +68,28 @@ namespace uvgrtp {
             /* total size of all fragments */
             size_t total_size = 0;
 
+            // bytes charged to the memory budget of the stream for the fragments of the frame
+            size_t charged = 0;
+
             // needed for cleaning fragments in case the frame is dropped
-            std::set<uint16_t> received_packet_seqs;
+            seq_bitmap received_packet_seqs;
+
+            /* RCE_H26X_FLAT_REASSEMBLY: the fragments are copied to "flat_buffer" at offset
+             * (seq - flat_base_seq) * fu_size from the data area that starts after the room
+             * reserved for the start code and NAL unit header */
+            bool flat = false;
+            uint8_t* flat_buffer = nullptr;
+            size_t flat_capacity = 0;
+            size_t flat_used = 0;    // end of the furthest fragment copied so far
+            size_t fu_size = 0;      // fragment payload size, 0 until a non-end fragment has arrived
+            uint16_t flat_base_seq = 0;
+
+            // end fragment that arrived before the fragment size was known
+            uvgrtp::frame::rtp_frame* flat_end = nullptr;
+
+            // NAL chunk hook: how many bytes from the NAL unit header on have been given to the hook
+            size_t chunk_delivered = 0;
+            uint16_t next_chunk_seq = 0;
         } h26x_info_t;
 
         struct nal_info
@@ -71,9 +100,19 @@ namespace uvgrtp {
             bool aggregate = false;
         };
 
+        /* The header sizes of an H26x format. They are given to h26x by the format once, so
+         * that the per-packet paths read them from the object instead of calling virtual functions */
+        struct h26x_layout {
+            uint8_t payload_header;
+            uint8_t nal_header;
+            uint8_t fu_header;
+            uint8_t start_code_range; // the step of the start code search, 1 if three-byte start codes are possible
+        };
+
         class h26x : public media {
             public:
-                h26x(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int rce_flags);
+                h26x(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int rce_flags,
+                    const h26x_layout& layout);
                 virtual ~h26x();
 
                 /* Find H26x start code from "data"
@@ -90,6 +129,15 @@ namespace uvgrtp {
                  * Return RTP_INVALID_VALUE if one of the parameters is invalid */
                 rtp_error_t push_media_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t data_len, int rtp_flags);
 
+                /* Same as push_media_frame() but the NAL units have been located by the application,
+                 * so the start code lookup is skipped
+                 *
+                 * Return RTP_OK on success */
+                rtp_error_t push_nal_units(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t data_len,
+                    const std::vector<uvgrtp::frame::nal_unit>& nal_units, int rtp_flags);
+
+                rtp_error_t install_nal_chunk_hook(void *arg, void (*hook)(void *, const uvgrtp::frame::nal_chunk *));
+
                 /* If the packet handler must return more than one frame, it can install a frame getter
                  * that is called by the auxiliary handler caller if packet_handler() returns RTP_MULTIPLE_PKTS_READY
                  *
@@ -117,6 +165,43 @@ namespace uvgrtp {
                  * Return RTP_GENERIC_ERROR if the packet was corrupted in some way */
                 rtp_error_t packet_handler(void* args, int rce_flags, uint8_t* read_ptr, size_t size, uvgrtp::frame::rtp_frame** out);
 
+                /* Does the received "frame" start a point where decoding can begin, i.e.
+                 * is it an intra frame or a parameter set. Used for RTP_DROP_NON_KEY_FRAMES */
+                bool is_key_frame(const uvgrtp::frame::rtp_frame* frame) const;
+
+                /* Leave out the received frames that the frame marking of RCC_FRAME_MARKING_EXT_ID shows
+                 * discardable while "congested" returns true, i.e. while the application is falling behind */
+                void set_congestion_check(std::function<bool()> congested);
+
+                /* Send and receive only the NAL units of the temporal layers up to "max_tid" and of the
+                 * layers up to "max_layer_id", see RCC_MAX_TEMPORAL_ID and RCC_MAX_LAYER_ID */
+                void set_layer_limits(uint8_t max_tid, uint8_t max_layer_id);
+
+                /* Prepend the cached parameter sets to the first key frame delivered after the start of
+                 * the stream or after a frame was dropped, see RCC_H26X_PARAMETER_SETS */
+                void set_parameter_set_prepending(bool prepend);
+
+                /* Write the latest received VPS, SPS and PPS to "parameter_sets", each with a four-byte start code
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_NOT_FOUND if no parameter set has been received */
+                rtp_error_t get_parameter_sets(std::vector<uint8_t>& parameter_sets);
+
+                /* Reserve the reassembly state for frames of at most "max_frame_size" bytes at "fps"
+                 * frames per second and "bytes_per_second" bytes per second, zero if not known. The frames
+                 * within RCC_PKT_MAX_DELAY of each other get their state, fragments and output buffers
+                 * up front, and the state of the completed and dropped frames is reused afterwards,
+                 * see RCC_H26X_MAX_FRAME_SIZE */
+                void reserve_receive_state(size_t max_frame_size, double fps, size_t bytes_per_second);
+
+                /* Hold the NAL units of the frames that fit into an aggregation packet for at most
+                 * "deadline_us" microseconds, so the small NAL units of consecutive push_frame() calls
+                 * are sent together, see RCC_AGGREGATION_DEADLINE. Zero sends the held NAL units and
+                 * stops holding
+                 *
+                 * Return RTP_OK on success */
+                rtp_error_t set_aggregation_deadline(size_t deadline_us);
+
             protected:
 
                 /* Handles small packets. May support aggregate packets or not*/
@@ -132,9 +217,11 @@ namespace uvgrtp {
                 // constructs format specific RTP header with correct values
                 virtual rtp_error_t fu_division(uint8_t* data, size_t data_len, size_t payload_size) = 0;
 
-                // a helper function that handles the fu division.
-                rtp_error_t divide_frame_to_fus(uint8_t* data, size_t& data_left, size_t payload_size,
-                    uvgrtp::buf_vec& buffers, uint8_t fu_headers[]);
+                /* A helper function that handles the fu division. The headers of the first, middle
+                 * and last fragment are built once from "payload_header" and the FU headers,
+                 * and the fragments are then queued in one go */
+                rtp_error_t divide_frame_to_fus(uint8_t* data, size_t data_len, size_t payload_size,
+                    const uint8_t* payload_header);
 
                 void initialize_fu_headers(uint8_t nal_type, uint8_t fu_headers[]);
 
@@ -143,10 +230,32 @@ namespace uvgrtp {
                 /* Gets the format specific nal type from data*/
                 virtual uint8_t get_nal_type(uint8_t* data) const = 0;
 
-                virtual uint8_t get_payload_header_size() const = 0;
-                virtual uint8_t get_nal_header_size() const = 0;
-                virtual uint8_t get_fu_header_size() const = 0;
-                virtual uint8_t get_start_code_range() const = 0;
+                /* Is "nal_type" an intra or a parameter set NAL unit type */
+                virtual bool is_key_nal_type(uint8_t nal_type) const = 0;
+
+                /* Return the place of "nal_type" in the parameter set cache, 0 for VPS, 1 for SPS and 2 for PPS
+                 *
+                 * Return -1 if "nal_type" is not a parameter set */
+                virtual int parameter_set_index(uint8_t nal_type) const = 0;
+
+                /* Get the frame marking of the NAL unit with the header "nal", see RFC 9626: the
+                 * independent and discardable bits and the temporal ID in the bits of the first byte
+                 * of the frame marking element to "flags" and the layer ID to "layer_id"
+                 *
+                 * Return false if "nal" is not a VCL NAL unit, which does not mark the frame */
+                virtual bool get_nal_marking(const uint8_t* nal, uint8_t& flags, uint8_t& layer_id) const = 0;
+
+                /* Write the temporal ID and the layer ID of the NAL unit header or RTP payload header
+                 * "header" to "tid" and "layer_id". The payload header of an aggregation or a fragmentation
+                 * unit has the IDs of the NAL units it carries
+                 *
+                 * Return false if the format has no scalable layers in its headers */
+                virtual bool get_layer_ids(const uint8_t* header, uint8_t& tid, uint8_t& layer_id) const = 0;
+
+                uint8_t get_payload_header_size() const { return layout_.payload_header; }
+                uint8_t get_nal_header_size() const { return layout_.nal_header; }
+                uint8_t get_fu_header_size() const { return layout_.fu_header; }
+                uint8_t get_start_code_range() const { return layout_.start_code_range; }
                 virtual uvgrtp::formats::FRAG_TYPE get_fragment_type(uvgrtp::frame::rtp_frame* frame) const = 0;
                 virtual uvgrtp::formats::NAL_TYPE  get_nal_type(uvgrtp::frame::rtp_frame* frame) const = 0;
 
@@ -159,34 +268,161 @@ namespace uvgrtp {
 
         private:
 
+            /* Give the frame marking of the VCL NAL units of the frame to the frame queue */
+            void mark_frame(uint8_t* data, const std::vector<nal_info>& nals);
+
             bool is_frame_late(uvgrtp::formats::h26x_info_t& hinfo, size_t max_delay);
             size_t drop_frame(uint32_t ts);
 
+            /* Charge "bytes" for a fragment of the frame "ts" to the memory budget, dropping the oldest
+             * other incomplete frames until the charge fits, see RCC_MEMORY_BUDGET
+             *
+             * Return false if the charge does not fit even without the other frames */
+            bool charge_fragment(uint32_t ts, size_t bytes);
+
+            // give the memory charged for the frame "info" back to the budget
+            void release_charge(h26x_info_t& info);
+
+            /* Add the frame "ts" to "frames_", with a spare node of reserve_receive_state() if there is one */
+            h26x_info_t& insert_frame(uint32_t ts);
+
+            /* Remove the frame "ts" from "frames_" and keep its node for reuse if there is room */
+            void erase_frame(uint32_t ts);
+
+            // remember "time" for "ts" in "marks", which is completed_ts_ or dropped_ts_, with a spare node if possible
+            void set_mark(std::unordered_map<uint32_t, uvgrtp::clock::hrc::hrc_t>& marks, uint32_t ts,
+                uvgrtp::clock::hrc::hrc_t time);
+            void erase_mark(std::unordered_map<uint32_t, uvgrtp::clock::hrc::hrc_t>& marks,
+                std::unordered_map<uint32_t, uvgrtp::clock::hrc::hrc_t>::iterator mark);
+
             inline size_t calculate_expected_fus(uint32_t ts);
-            inline void initialize_new_fragmented_frame(uint32_t ts, NAL_TYPE nal_type);
+            inline void initialize_new_fragmented_frame(uint32_t ts, NAL_TYPE nal_type, int rce_flags, uint64_t recv_time);
 
             void free_fragment(uint16_t sequence_number);
 
             void scl(uint8_t* data, size_t data_len, size_t packet_size, 
                 std::vector<nal_info>& nals, bool& can_be_aggregated);
 
+            /* Mark the NAL units that fit into one aggregation packet of at most "packet_size" bytes
+             *
+             * Return true if at least two NAL units can be aggregated */
+            bool mark_aggregatable(std::vector<nal_info>& nals, size_t packet_size);
+
+            /* Queue the NAL units of a frame for sending and flush the queue, or hold them with
+             * hold_nal_units() if there is an aggregation deadline. The frame queue transaction
+             * must have been initialized */
+            rtp_error_t send_nal_units(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t* data,
+                std::vector<nal_info>& nals, bool should_aggregate, size_t payload_size);
+
+            // packetize the NAL units of the transaction and flush the queue
+            rtp_error_t packetize(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t* data,
+                std::vector<nal_info>& nals, bool should_aggregate, size_t payload_size);
+
+            /* Add the NAL units of the frame to the held ones if they fit into the aggregation packet
+             * with them. The held NAL units are sent first if the frame has another timestamp or
+             * does not fit, and a frame that does not fit into an aggregation packet by itself is
+             * sent right away. "send_mutex_" must be held */
+            rtp_error_t hold_nal_units(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t* data,
+                std::vector<nal_info>& nals, bool should_aggregate, size_t payload_size);
+
+            // send the held NAL units with their timestamp, "send_mutex_" must be held
+            rtp_error_t send_held_nal_units();
+
+            // send the held NAL units when their deadline expires
+            void held_sender();
+
             void garbage_collect_lost_frames(size_t timout);
 
             rtp_error_t reconstruction(uvgrtp::frame::rtp_frame** out,
                 int rce_flags, uint32_t frame_timestamp, const uint8_t sizeof_fu_headers);
 
+            /* RCE_H26X_FLAT_REASSEMBLY: copy the payload of "frame" to its place in the output
+             * buffer of the frame. Takes the ownership of "frame"
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the fragment sizes of the frame are not uniform
+             * Return RTP_GENERIC_ERROR if the frame has two end fragments or its fragments are too
+             * far apart for the output buffer, see flat_size_allowed() */
+            rtp_error_t store_flat_fragment(h26x_info_t& info, uvgrtp::frame::rtp_frame* frame,
+                bool end_fragment, const uint8_t sizeof_fu_headers);
+
+            // make sure the output buffer of "info" has room for "size" bytes
+            void reserve_flat_buffer(h26x_info_t& info, size_t size);
+
+            /* Whether the data area of the output buffer of "info" may be "size" bytes. It may not
+             * be larger than RCC_H26X_MAX_FRAME_SIZE, if set, or than the fragments received so far
+             * and MAX_FLAT_GAP_FRAGMENTS more */
+            bool flat_size_allowed(const h26x_info_t& info, size_t size) const;
+
+            // space reserved for the start code and NAL unit header in front of the fragment data
+            size_t flat_headroom() const;
+
+            // deliver the reassembled frame in the output buffer
+            rtp_error_t flat_reconstruction(uvgrtp::frame::rtp_frame** out,
+                int rce_flags, uint32_t frame_timestamp, uvgrtp::frame::rtp_header& header);
+
+            // release the output buffer and pending end fragment of "info"
+            size_t free_flat_buffer(h26x_info_t& info);
+
+            // give the part of the NAL unit that has arrived without gaps since the last call to the chunk hook
+            void deliver_nal_chunks(h26x_info_t& info, uint32_t ts);
+
+            // handle one received or rebuilt packet, packet_handler() without FEC
+            rtp_error_t handle_packet(int rce_flags, uvgrtp::frame::rtp_frame** out);
+
+            // reassemble one NAL unit from "frame", handle_packet() without RCE_H26X_ACCESS_UNIT
+            rtp_error_t nal_unit_handler(int rce_flags, uvgrtp::frame::rtp_frame** out);
+
+            /* RCE_H26X_ACCESS_UNIT: collect the NAL units completed by "frame" to the pending access
+             * unit and queue the access units that are complete
+             *
+             * Return RTP_MULTIPLE_PKTS_READY if one or more access units were queued
+             * Return RTP_OK if the packet was handled but no access unit is complete yet
+             * Otherwise return the error code of nal_unit_handler() */
+            rtp_error_t access_unit_handler(int rce_flags, uvgrtp::frame::rtp_frame** out);
+
+            // concatenate the NAL units of the pending access unit into one frame and queue it
+            void flush_access_unit();
+
+            /* Cache the parameter sets among the NAL units that nal_unit_handler() completed with "ret",
+             * "*out" or the frames queued after the first "queued" ones, and prepend the cached sets to
+             * the key frame that follows a join or a dropped frame */
+            void complete_nal_units(rtp_error_t ret, uvgrtp::frame::rtp_frame** out, size_t queued);
+
+            // cache "frame" if it is a parameter set or prepend the missing sets to it if it is the awaited key frame
+            void check_parameter_sets(uvgrtp::frame::rtp_frame** frame);
+
             bool is_duplicate_frame(uint32_t timestamp, uint16_t seq_num);
 
+            /* Is the received packet "frame" left out because of the layer limits or the frame marking,
+             * see set_layer_limits() and set_congestion_check(). The layers are read from the payload
+             * header of each packet. The frame marking is decided on at the first packet of a frame,
+             * so that a frame whose reassembly has started is not cut short */
+            bool skip_frame(const uvgrtp::frame::rtp_frame* frame);
+
+            /* Remove the NAL units of the layers above the limits of set_layer_limits() from "nals"
+             *
+             * Return true if some NAL unit was removed */
+            bool filter_layers(uint8_t* data, std::vector<nal_info>& nals);
+
+            // remember that the frame "ts" has been completed or dropped, until it expires
+            void mark_completed(uint32_t ts, uvgrtp::clock::hrc::hrc_t time);
+            void mark_dropped(uint32_t ts, uvgrtp::clock::hrc::hrc_t time);
+
+            const h26x_layout layout_;
+
             std::deque<uvgrtp::frame::rtp_frame*> queued_;
+
+            // the packets to handle after FEC recovery, see packet_handler()
+            std::vector<uvgrtp::frame::rtp_frame*> fec_packets_;
+
             std::unordered_map<uint32_t, h26x_info_t> frames_;
 
-            // Save received RTP frame stats, used to check for duplicates in is_duplicate_frame()
-            struct pkt_stats {
-                uint32_t ts;
-                uint16_t seq;
-            };
-            std::deque<pkt_stats> received_frames_;
-            std::unordered_map<uint32_t, std::vector<uint16_t>> received_info_;
+            /* The timestamp of the last packet received with each sequence number, used to check
+             * for duplicates in is_duplicate_frame(). A packet is a duplicate if the slot of its
+             * sequence number is in use and has the same timestamp */
+            std::vector<uint32_t> seq_timestamps_;
+            std::vector<bool> seq_used_;
 
             // Holds all possible fragments in sequence number order
             std::vector<uvgrtp::frame::rtp_frame*> fragments_;
@@ -195,11 +431,100 @@ namespace uvgrtp {
             std::unordered_map<uint32_t, uvgrtp::clock::hrc::hrc_t> dropped_ts_;
             std::unordered_map<uint32_t, uvgrtp::clock::hrc::hrc_t> completed_ts_;
 
+            /* Expiry queues for frames_, completed_ts_ and dropped_ts_ in the order the entries
+             * were added. The entries are added roughly in time order, so the garbage collection
+             * only has to look at the front of each queue instead of going through the maps.
+             * An entry whose map entry has since been removed or replaced is skipped */
+            struct expiry {
+                uvgrtp::clock::hrc::hrc_t time;
+                uint32_t ts;
+            };
+            std::deque<expiry> frame_expiry_;
+            std::deque<expiry> completed_expiry_;
+            std::deque<expiry> dropped_expiry_;
+
+            /* The map nodes of finished frames and expired marks kept for reuse, up to the limits
+             * set by reserve_receive_state(). Without it the limits are zero and nothing is kept */
+            std::vector<std::unordered_map<uint32_t, h26x_info_t>::node_type> spare_frames_;
+            std::vector<std::unordered_map<uint32_t, uvgrtp::clock::hrc::hrc_t>::node_type> spare_marks_;
+            size_t spare_frames_limit_ = 0;
+            size_t spare_marks_limit_ = 0;
+
+            // the largest frame given to reserve_receive_state(), zero if not known
+            size_t max_frame_size_ = 0;
+
             std::shared_ptr<uvgrtp::rtp> rtp_ctx_;
 
-            uvgrtp::clock::hrc::hrc_t last_garbage_collection_;
+            uvgrtp::clock::coarse::coarse_t last_garbage_collection_;
 
             bool discard_until_key_frame_ = true;
+
+            // set_congestion_check() and set_layer_limits()
+            std::function<bool()> congested_;
+            std::atomic<uint8_t> max_temporal_id_{ uvgrtp::MAX_TEMPORAL_ID };
+            std::atomic<uint8_t> max_layer_id_{ uvgrtp::MAX_LAYER_ID };
+
+            // the timestamp of the latest frame skip_frame() decided on by its marking and whether it was left out
+            bool marking_decided_ = false;
+            uint32_t marking_ts_ = 0;
+            bool marking_skip_ = false;
+
+            // the timestamp of the latest frame whose packets skip_frame() left out for their layers
+            bool layer_skipped_ = false;
+            uint32_t layer_skip_ts_ = 0;
+
+            /* The latest VPS, SPS and PPS without start codes. get_parameter_sets() reads them from
+             * the threads of the application */
+            std::mutex parameter_sets_mutex_;
+            std::vector<uint8_t> parameter_sets_[3];
+
+            /* RCC_H26X_PARAMETER_SETS: a key frame has not been delivered since the start or the latest
+             * dropped frame, and the bits of the parameter sets that have been delivered in the meantime */
+            std::atomic<bool> prepend_parameter_sets_{false};
+            bool need_parameter_sets_ = true;
+            uint8_t delivered_parameter_sets_ = 0;
+
+            // RCE_H26X_FLAT_REASSEMBLY: size of the previous reassembled frame, used as a size hint
+            size_t last_flat_size_ = 0;
+
+            // a frame did not have uniform fragment sizes, so flat reassembly is no longer used
+            bool flat_failed_ = false;
+
+            void* chunk_hook_arg_ = nullptr;
+            void (*chunk_hook_)(void*, const uvgrtp::frame::nal_chunk*) = nullptr;
+
+            // RCE_H26X_ACCESS_UNIT: the completed NAL units of the access unit being collected
+            std::vector<uvgrtp::frame::rtp_frame*> au_nals_;
+            size_t au_size_ = 0;
+            uint32_t au_ts_ = 0;
+
+            // timestamp of the latest packet with the marker bit, i.e. the last packet of its access unit
+            bool au_marker_seen_ = false;
+            uint32_t au_marker_ts_ = 0;
+
+            /* RCC_AGGREGATION_DEADLINE: the NAL units held for an aggregation packet. They are
+             * copied to "data", so the application may release its frame when push_frame() returns */
+            struct held_nal_units {
+                std::vector<uint8_t> data;
+                std::vector<nal_info> nals;
+
+                // the bytes the NAL units and their size fields take in the aggregation packet
+                size_t size = 0;
+
+                uint32_t timestamp = 0;
+                sockaddr_in addr = {};
+                sockaddr_in6 addr6 = {};
+                std::chrono::steady_clock::time_point deadline;
+            };
+            held_nal_units held_;
+            std::chrono::microseconds aggregation_deadline_{0};
+
+            /* The frames of the application and the held NAL units, which "held_sender_" sends
+             * when their deadline expires, are sent one at a time */
+            std::mutex send_mutex_;
+            std::condition_variable held_cv_;
+            std::unique_ptr<std::thread> held_sender_;
+            bool stop_held_sender_ = false;
         };
     }
 }
@@ -3,22 +3,44 @@
 #include "../socket.hh"
 #include "../rtp.hh"
 #include "../frame_queue.hh"
+#include "../frame_pool.hh"
+#include "../nack.hh"
+#include "../fec.hh"
+#include "../stream_metrics.hh"
+#include "../trace.hh"
 #include "debug.hh"
 
+#include <algorithm>
+#include <cstring>
 #include <map>
 #include <unordered_map>
 
+// smallest buffer a fragmented generic frame is reassembled to
+constexpr size_t MIN_GENERIC_FRAME_BUFFER = 64 * 1024;
 
+// how often the frames that will not be completed are looked for
+constexpr int GARBAGE_COLLECTION_INTERVAL_MS = 100;
 
-#define INVALID_SEQ 0xffffffff
+// initial capacity of a seq_bitmap, enough for a frame of 1024 fragments
+constexpr size_t INITIAL_SEQ_BITMAP_WORDS = 16;
+
+// 32768 sequence numbers, beyond that the distance of a sequence number to the base wraps
+constexpr size_t MAX_SEQ_BITMAP_WORDS = 512;
 
 uvgrtp::formats::media::media(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp_ctx, int rce_flags):
     socket_(socket), rtp_ctx_(rtp_ctx), rce_flags_(rce_flags), fqueue_(new uvgrtp::frame_queue(socket, rtp_ctx, rce_flags)), minfo_()
-{}
+{
+    minfo_.last_garbage_collection = uvgrtp::clock::coarse::now();
+}
 
 uvgrtp::formats::media::~media()
 {
     fqueue_ = nullptr;
+
+    for (auto& frame : minfo_.frames) {
+        uvgrtp::frame_pool::free_payload(frame.second.buffer);
+        (void)uvgrtp::frame::dealloc_frame(frame.second.pending_end);
+    }
 }
 
 rtp_error_t uvgrtp::formats::media::push_frame(sockaddr_in& addr, sockaddr_in6& addr6,
@@ -39,6 +61,101 @@ rtp_error_t uvgrtp::formats::media::push_frame(sockaddr_in& addr, sockaddr_in6&
     return push_media_frame(addr, addr6, data.get(), data_len, rtp_flags);
 }
 
+rtp_error_t uvgrtp::formats::media::push_frame(sockaddr_in& addr, sockaddr_in6& addr6,
+    uint8_t *data, size_t data_len, const std::vector<uvgrtp::frame::nal_unit>& nal_units, int rtp_flags)
+{
+    if (!data || !data_len || nal_units.empty())
+        return RTP_INVALID_VALUE;
+
+    for (auto& nal : nal_units) {
+        if (nal.size == 0 || nal.offset >= data_len || nal.size > data_len - nal.offset) {
+            UVG_LOG_ERROR("NAL unit at offset %zu with size %zu is not inside the frame of %zu bytes",
+                nal.offset, nal.size, data_len);
+            return RTP_INVALID_VALUE;
+        }
+    }
+
+    return push_nal_units(addr, addr6, data, data_len, nal_units, rtp_flags);
+}
+
+rtp_error_t uvgrtp::formats::media::push_nal_units(sockaddr_in& addr, sockaddr_in6& addr6,
+    uint8_t *data, size_t data_len, const std::vector<uvgrtp::frame::nal_unit>& nal_units, int rtp_flags)
+{
+    (void)addr, (void)addr6, (void)data, (void)data_len, (void)nal_units, (void)rtp_flags;
+
+    UVG_LOG_ERROR("NAL unit locations can only be given for H.264, H.265 and H.266 streams");
+    return RTP_NOT_SUPPORTED;
+}
+
+rtp_error_t uvgrtp::formats::media::push_frame(sockaddr_in& addr, sockaddr_in6& addr6,
+    const std::vector<uint8_t *>& lines, int rtp_flags)
+{
+    if (lines.empty())
+        return RTP_INVALID_VALUE;
+
+    for (auto& line : lines) {
+        if (!line)
+            return RTP_INVALID_VALUE;
+    }
+
+    return push_scanlines(addr, addr6, lines, rtp_flags);
+}
+
+rtp_error_t uvgrtp::formats::media::push_scanlines(sockaddr_in& addr, sockaddr_in6& addr6,
+    const std::vector<uint8_t *>& lines, int rtp_flags)
+{
+    (void)addr, (void)addr6, (void)lines, (void)rtp_flags;
+
+    UVG_LOG_ERROR("Scan lines can only be given for raw video streams");
+    return RTP_NOT_SUPPORTED;
+}
+
+rtp_error_t uvgrtp::formats::media::set_video_layout(size_t width, size_t height, size_t pgroup_size, size_t pgroup_pixels)
+{
+    (void)width, (void)height, (void)pgroup_size, (void)pgroup_pixels;
+
+    UVG_LOG_ERROR("The video layout can only be set for raw video streams");
+    return RTP_NOT_SUPPORTED;
+}
+
+rtp_error_t uvgrtp::formats::media::install_video_buffer_hook(void *arg, video_buffer_hook hook)
+{
+    (void)arg, (void)hook;
+
+    UVG_LOG_ERROR("Video frame buffers can only be given for raw video streams");
+    return RTP_NOT_SUPPORTED;
+}
+
+rtp_error_t uvgrtp::formats::media::set_aggregation_deadline(size_t deadline_us)
+{
+    if (!deadline_us)
+        return RTP_OK;
+
+    UVG_LOG_ERROR("Only H26x streams aggregate NAL units");
+    return RTP_NOT_SUPPORTED;
+}
+
+rtp_error_t uvgrtp::formats::media::install_nal_chunk_hook(void *arg, void (*hook)(void *, const uvgrtp::frame::nal_chunk *))
+{
+    (void)arg, (void)hook;
+
+    UVG_LOG_ERROR("NAL unit chunks can only be received from H.264, H.265 and H.266 streams");
+    return RTP_NOT_SUPPORTED;
+}
+
+uvgrtp::buf_vec *uvgrtp::formats::media::prepare_single_packet(uint8_t *data, size_t data_len)
+{
+    if (!fqueue_->single_supported(data_len))
+        return nullptr;
+
+    return &fqueue_->prepare_single(data, data_len, rce_flags_ & RCE_FRAGMENT_GENERIC);
+}
+
+void uvgrtp::formats::media::single_packet_sent()
+{
+    fqueue_->single_sent();
+}
+
 rtp_error_t uvgrtp::formats::media::push_media_frame(sockaddr_in& addr, sockaddr_in6& addr6,
     uint8_t *data, size_t data_len, int rtp_flags)
 {
@@ -46,6 +163,10 @@ rtp_error_t uvgrtp::formats::media::push_media_frame(sockaddr_in& addr, sockaddr
 
     rtp_error_t ret;
 
+    // a frame of one packet needs no transaction unless the stream sends it through more than the socket
+    if (fqueue_->single_supported(data_len))
+        return fqueue_->push_single(addr, addr6, data, data_len, rce_flags_ & RCE_FRAGMENT_GENERIC);
+
     if ((ret = fqueue_->init_transaction(data)) != RTP_OK) {
         UVG_LOG_ERROR("Invalid frame queue or failed to initialize transaction!");
         return ret;
@@ -98,6 +219,85 @@ rtp_error_t uvgrtp::formats::media::push_media_frame(sockaddr_in& addr, sockaddr
     return fqueue_->flush_queue(addr, addr6);
 }
 
+unsigned uvgrtp::formats::seq_bitmap::lowest_bit(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctzll(word);
+#else
+    unsigned bit = 0;
+    while (!(word & 1)) {
+        word >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+bool uvgrtp::formats::seq_bitmap::insert(uint16_t seq)
+{
+    if (words_.empty()) {
+        words_.reserve(INITIAL_SEQ_BITMAP_WORDS);
+        words_.push_back(0);
+        base_ = seq & ~63;
+    }
+
+    if (!fits(seq)) {
+        return false;
+    }
+
+    int16_t diff = (int16_t)(uint16_t)(seq - base_);
+
+    // the fragment is older than any received so far, make room in front of the bitmap
+    if (diff < 0) {
+        size_t new_words = ((size_t)-diff + 63) / 64;
+
+        words_.insert(words_.begin(), new_words, 0);
+        base_ = (uint16_t)(base_ - new_words * 64);
+        diff  = (int16_t)(uint16_t)(seq - base_);
+    }
+
+    size_t index = (size_t)diff / 64;
+    uint64_t bit = (uint64_t)1 << ((size_t)diff % 64);
+
+    if (index >= words_.size()) {
+        words_.resize(index + 1, 0);
+    }
+
+    if (words_[index] & bit) {
+        return false;
+    }
+
+    words_[index] |= bit;
+    ++count_;
+    return true;
+}
+
+bool uvgrtp::formats::seq_bitmap::contains(uint16_t seq) const
+{
+    int16_t diff = (int16_t)(uint16_t)(seq - base_);
+
+    if (words_.empty() || diff < 0 || (size_t)diff / 64 >= words_.size()) {
+        return false;
+    }
+
+    return (words_[(size_t)diff / 64] >> ((size_t)diff % 64)) & 1;
+}
+
+bool uvgrtp::formats::seq_bitmap::fits(uint16_t seq) const
+{
+    if (words_.empty()) {
+        return true;
+    }
+
+    int16_t diff = (int16_t)(uint16_t)(seq - base_);
+
+    if (diff < 0) {
+        return words_.size() + ((size_t)-diff + 63) / 64 <= MAX_SEQ_BITMAP_WORDS;
+    }
+
+    return (size_t)diff / 64 < MAX_SEQ_BITMAP_WORDS;
+}
+
 uvgrtp::formats::media_frame_info_t *uvgrtp::formats::media::get_media_frame_info()
 {
     return &minfo_;
@@ -105,14 +305,13 @@ uvgrtp::formats::media_frame_info_t *uvgrtp::formats::media::get_media_frame_inf
 
 rtp_error_t uvgrtp::formats::media::packet_handler(void* arg, int rce_flags, uint8_t* read_ptr, size_t size, frame::rtp_frame** out)
 {
-    (void)rce_flags;
     (void)read_ptr;
     (void)size;
     auto minfo   = (uvgrtp::formats::media_frame_info_t *)arg;
     auto frame   = *out;
     uint32_t ts  = frame->header.timestamp;
-    uint32_t seq = frame->header.seq;
-    uint32_t recv  = 0;
+    uint16_t seq = frame->header.seq;
+    bool end     = frame->header.marker;
 
     bool fragmentation = (rce_flags & RCE_FRAGMENT_GENERIC);
 
@@ -123,76 +322,427 @@ rtp_error_t uvgrtp::formats::media::packet_handler(void* arg, int rce_flags, uin
         return RTP_PKT_READY;
     }
 
-    if (minfo->frames.find(ts) != minfo->frames.end()) {
-        minfo->frames[ts].npkts++;
-        minfo->frames[ts].size += frame->payload_len;
+    auto it = minfo->frames.find(ts);
 
-        if (seq < minfo->frames[ts].s_seq)
-            minfo->frames[ts].fragments[seq + 0x10000] = frame;
-        else
-            minfo->frames[ts].fragments[seq] = frame;
+    if (it == minfo->frames.end()) {
+        if (end) {
+            return RTP_PKT_READY; // fragmentation is used, but there was only one packet for this frame
+        }
+
+        media_info_t& info = minfo->frames[ts];
+        info.start_time = frame->recv_time ? uvgrtp::clock::hrc::from_system_ns(frame->recv_time) : uvgrtp::clock::hrc::now();
+        UVG_TRACE(FRAGMENT_FIRST, frame->header.ssrc, ts, seq);
+        info.base_seq   = seq;
+        minfo->expiry_queue.push_back({ info.start_time, ts });
+
+        it = minfo->frames.find(ts);
+    }
 
-        *out = nullptr;
+    media_info_t& info = it->second;
+    *out = nullptr;
 
-        if (frame->header.marker)
-        {
-            minfo->frames[ts].e_seq = seq;
+    if (!info.received.insert(seq)) {
+        UVG_LOG_DEBUG("Received a duplicate fragment %u of frame %lu", seq, ts);
+        if (metrics_)
+            metrics_->count(uvgrtp::stream_metrics::DUPLICATE_PACKETS);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return RTP_OK;
+    }
+
+    if (end) {
+        info.end_received = true;
+        info.e_seq        = seq;
+    }
+
+    bool after_end = info.end_received && (int16_t)(uint16_t)(seq - info.e_seq) > 0;
+    uvgrtp::frame::rtp_header header = frame->header;
+    uint64_t recv_time = frame->recv_time;
+
+    if (after_end || store_fragment(info, frame, end) != RTP_OK) {
+        UVG_LOG_WARN("Fragments of generic frame %lu do not fit together, dropping the frame", ts);
+
+        if (after_end)
+            (void)uvgrtp::frame::dealloc_frame(frame);
+
+        (void)drop_frame(ts);
+        return RTP_OK;
+    }
+
+    if (info.end_received && !info.pending_end &&
+        info.received.size() == (size_t)(uint16_t)(info.e_seq - info.base_seq) + 1) {
+
+        // the fragments were copied to their places as they arrived, so the buffer is the frame
+        auto retframe = uvgrtp::frame::alloc_rtp_frame();
+
+        std::memcpy(&retframe->header, &header, sizeof(header));
+        retframe->payload     = info.buffer;
+        retframe->payload_len = info.used;
+        retframe->recv_time   = recv_time;
+
+        minfo->last_frame_size = info.used;
+        UVG_TRACE(FRAME_COMPLETE, header.ssrc, ts, info.used);
+
+        if (metrics_)
+            metrics_->record(uvgrtp::stream_metrics::REASSEMBLY_LATENCY_US, uvgrtp::clock::hrc::diff_now_us(info.start_time));
+
+        minfo->frames.erase(it);
+
+        *out = retframe;
+        return RTP_PKT_READY;
+    }
+
+    // make sure uvgRTP does not reserve increasing amounts of memory because some frames are not completed
+    garbage_collect_lost_frames(rtp_ctx_->get_pkt_max_delay());
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::formats::media::store_fragment(media_info_t& info, uvgrtp::frame::rtp_frame *frame, bool end)
+{
+    uint16_t seq = frame->header.seq;
+    size_t len   = frame->payload_len;
+
+    if (!end) {
+        if (info.frag_size == 0) {
+            info.frag_size = len;
+        } else if (len != info.frag_size) {
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            return RTP_INVALID_VALUE;
         }
-        else if (seq == minfo->frames[ts].s_seq - 1)
-        {
-            // try to detect if the start seq was ordered wrong
-            minfo->frames[ts].s_seq = seq;
+    } else if (info.frag_size == 0) {
+        // the place of the last fragment is known only after the size of the others
+        info.pending_end = frame;
+        return RTP_OK;
+    } else if (len > info.frag_size) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return RTP_INVALID_VALUE;
+    }
+
+    if (info.used == 0) {
+        info.base_seq = seq;
+    }
+
+    int16_t diff = (int16_t)(uint16_t)(seq - info.base_seq);
+
+    // the fragment is older than any copied so far, move the frame forward to make room for it
+    if (diff < 0) {
+        size_t shift = (size_t)-diff * info.frag_size;
+
+        if (info.used + shift > info.capacity) {
+            uint8_t *old_buffer = info.buffer;
+
+            info.buffer   = nullptr;
+            info.capacity = 0;
+            reserve_buffer(info, info.used + shift);
+
+            std::memcpy(info.buffer + shift, old_buffer, info.used);
+            uvgrtp::frame_pool::free_payload(old_buffer);
+        } else {
+            std::memmove(info.buffer + shift, info.buffer, info.used);
         }
 
-        if (minfo->frames[ts].e_seq != INVALID_SEQ && minfo->frames[ts].s_seq != INVALID_SEQ) {
-            if (minfo->frames[ts].s_seq > minfo->frames[ts].e_seq)
-            {
-                recv = UINT16_MAX - minfo->frames[ts].s_seq + minfo->frames[ts].e_seq + (uint32_t)2;
-            }
-            else
-            {
-                recv = minfo->frames[ts].e_seq - minfo->frames[ts].s_seq + (uint32_t)1;
-            }
+        info.used    += shift;
+        info.base_seq = seq;
+        diff          = 0;
+    }
+
+    size_t offset = (size_t)diff * info.frag_size;
+
+    if (offset + len > info.used) {
+        uint8_t *old_buffer = info.buffer;
+        size_t old_used     = info.used;
 
-            if (recv == minfo->frames[ts].npkts) {
-                auto retframe = uvgrtp::frame::alloc_rtp_frame(minfo->frames[ts].size);
-                size_t ptr    = 0;
-
-                std::memcpy(&retframe->header, &frame->header, sizeof(frame->header));
-
-                for (auto& frag : minfo->frames[ts].fragments) {
-                    std::memcpy(
-                        retframe->payload + ptr,
-                        frag.second->payload,
-                        frag.second->payload_len
-                    );
-                    ptr += frag.second->payload_len;
-                    (void)uvgrtp::frame::dealloc_frame(frag.second);
-                }
-
-                minfo->frames.erase(ts);
-                (void)uvgrtp::frame::dealloc_frame(*out);
-                *out = retframe;
-                return RTP_PKT_READY;
+        if (offset + len > info.capacity) {
+            info.buffer   = nullptr;
+            info.capacity = 0;
+            reserve_buffer(info, offset + len);
+
+            if (old_buffer) {
+                std::memcpy(info.buffer, old_buffer, old_used);
+                uvgrtp::frame_pool::free_payload(old_buffer);
             }
         }
-    } else {
-        if (!(frame->header.marker)) {
-            minfo->frames[ts].npkts          = 1;
-            minfo->frames[ts].s_seq          = seq;
-            minfo->frames[ts].e_seq          = INVALID_SEQ;
-            minfo->frames[ts].fragments[seq] = frame;
-            minfo->frames[ts].size           = frame->payload_len;
-            *out                             = nullptr;
-        } else {
-            return RTP_PKT_READY; // fragmentation is used, but there was only one packet for this frame
-        }
+        info.used = offset + len;
+    }
+
+    std::memcpy(info.buffer + offset, frame->payload, len);
+    (void)uvgrtp::frame::dealloc_frame(frame);
+
+    if (info.pending_end) {
+        uvgrtp::frame::rtp_frame *pending = info.pending_end;
+
+        info.pending_end = nullptr;
+        return store_fragment(info, pending, true);
     }
 
     return RTP_OK;
 }
 
+void uvgrtp::formats::media::reserve_buffer(media_info_t& info, size_t size)
+{
+    /* Growing the buffer copies the frame, so it is grown in large steps. Frames of a
+     * stream are usually about the same size, so the previous one is a good guess */
+    size_t capacity = std::max({ 2 * info.capacity, size, minfo_.last_frame_size, MIN_GENERIC_FRAME_BUFFER });
+
+    info.buffer   = uvgrtp::frame_pool::alloc_payload(capacity);
+    info.capacity = capacity;
+}
+
+size_t uvgrtp::formats::media::drop_frame(uint32_t ts)
+{
+    auto it = minfo_.frames.find(ts);
+    if (it == minfo_.frames.end()) {
+        return 0;
+    }
+
+    size_t freed = it->second.capacity;
+
+    uvgrtp::frame_pool::free_payload(it->second.buffer);
+
+    if (it->second.pending_end) {
+        freed += it->second.pending_end->payload_len;
+        (void)uvgrtp::frame::dealloc_frame(it->second.pending_end);
+    }
+
+    minfo_.frames.erase(it);
+
+    if (metrics_)
+        metrics_->count(uvgrtp::stream_metrics::DROPPED_FRAMES);
+
+    return freed;
+}
+
+void uvgrtp::formats::media::garbage_collect_lost_frames(size_t timeout)
+{
+    if (uvgrtp::clock::coarse::diff_now(minfo_.last_garbage_collection) < GARBAGE_COLLECTION_INTERVAL_MS) {
+        return;
+    }
+
+    size_t total_cleaned = 0;
+
+    while (!minfo_.expiry_queue.empty() &&
+        uvgrtp::clock::hrc::diff_now(minfo_.expiry_queue.front().time) > timeout) {
+        media_frame_info_t::expiry old_frame = minfo_.expiry_queue.front();
+        minfo_.expiry_queue.pop_front();
+
+        // the frame may have been completed or dropped already
+        auto gc_frame = minfo_.frames.find(old_frame.ts);
+        if (gc_frame == minfo_.frames.end() || gc_frame->second.start_time != old_frame.time) {
+            continue;
+        }
+
+        UVG_LOG_WARN("Found an old generic frame that has not been completed. Ts: %lu, fragments received: %zu",
+            old_frame.ts, gc_frame->second.received.size());
+        if (metrics_)
+            metrics_->count(uvgrtp::stream_metrics::LATE_FRAMES);
+        total_cleaned += drop_frame(old_frame.ts);
+    }
+
+    if (total_cleaned > 0) {
+        UVG_LOG_DEBUG("Garbage collection cleaned %zu bytes!", total_cleaned);
+    }
+
+    minfo_.last_garbage_collection = uvgrtp::clock::coarse::now();
+}
+
 void uvgrtp::formats::media::set_fps(ssize_t numerator, ssize_t denominator)
 {
     fqueue_->set_fps(numerator, denominator);
+}
+
+void uvgrtp::formats::media::set_pacer(std::shared_ptr<uvgrtp::pacer> pacer)
+{
+    fqueue_->set_pacer(pacer);
+}
+
+void uvgrtp::formats::media::set_pacing(size_t burst_packets, std::chrono::nanoseconds spin)
+{
+    fqueue_->set_pacing(burst_packets, spin);
+}
+
+void uvgrtp::formats::media::defer_pacing(bool defer)
+{
+    fqueue_->defer_pacing(defer);
+}
+
+rtp_error_t uvgrtp::formats::media::finish_pacing()
+{
+    return fqueue_->finish_pacing();
+}
+
+void uvgrtp::formats::media::set_send_priority(int priority, size_t weight)
+{
+    fqueue_->set_send_priority(priority, weight);
+}
+
+void uvgrtp::formats::media::set_path_mtu(std::shared_ptr<uvgrtp::path_mtu> path_mtu)
+{
+    fqueue_->set_path_mtu(path_mtu);
+}
+
+rtp_error_t uvgrtp::formats::media::set_twcc(std::shared_ptr<uvgrtp::twcc_sender> sender, uint8_t ext_id)
+{
+    return fqueue_->set_twcc(sender, ext_id);
+}
+
+rtp_error_t uvgrtp::formats::media::set_header_extension(uvgrtp::HEADER_EXTENSION extension, uint8_t id)
+{
+    rtp_error_t ret = fqueue_->set_header_extension(extension, id);
+
+    if (ret == RTP_OK && extension == uvgrtp::EXT_FRAME_MARKING) {
+        frame_marking_id_.store(id, std::memory_order_relaxed);
+    }
+    return ret;
+}
+
+rtp_error_t uvgrtp::formats::media::set_header_extension_value(uvgrtp::HEADER_EXTENSION extension, const std::string& value)
+{
+    return fqueue_->set_header_extension_value(extension, value);
+}
+
+size_t uvgrtp::formats::media::header_extension_size() const
+{
+    return fqueue_->header_extension_size();
+}
+
+uint8_t uvgrtp::formats::media::header_extension_id(uvgrtp::HEADER_EXTENSION extension) const
+{
+    return fqueue_->header_extension_id(extension);
+}
+
+void uvgrtp::formats::media::set_audio_level(uint8_t level, bool voice_activity)
+{
+    fqueue_->set_audio_level(level, voice_activity);
+}
+
+void uvgrtp::formats::media::set_paths(std::shared_ptr<const std::vector<uvgrtp::send_path>> paths)
+{
+    fqueue_->set_paths(paths);
+}
+
+void uvgrtp::formats::media::set_gop_cache(size_t limit)
+{
+    fqueue_->set_gop_cache(limit);
+}
+
+void uvgrtp::formats::media::set_packet_history(std::shared_ptr<uvgrtp::packet_history> history)
+{
+    fqueue_->set_packet_history(history);
+}
+
+void uvgrtp::formats::media::set_metrics(std::shared_ptr<uvgrtp::stream_metrics> metrics)
+{
+    metrics_ = metrics;
+    fqueue_->set_metrics(metrics);
+}
+
+void uvgrtp::formats::media::set_memory_budget(std::shared_ptr<uvgrtp::memory_budget> budget)
+{
+    memory_budget_ = budget;
+}
+
+void uvgrtp::formats::media::set_nack_sender(std::function<void(uint32_t, const std::vector<uint16_t>&)> sender)
+{
+    nack_sender_ = sender;
+    nack_        = sender ? std::make_shared<uvgrtp::nack_generator>() : nullptr;
+}
+
+rtp_error_t uvgrtp::formats::media::add_destination(const uvgrtp::fanout_destination& destination)
+{
+    return fqueue_->add_destination(destination);
+}
+
+rtp_error_t uvgrtp::formats::media::remove_destination(const sockaddr_in& addr, const sockaddr_in6& addr6)
+{
+    return fqueue_->remove_destination(addr, addr6);
+}
+
+rtp_error_t uvgrtp::formats::media::set_destination_layers(const sockaddr_in& addr, const sockaddr_in6& addr6,
+    uint8_t max_tid, uint8_t max_layer_id)
+{
+    return fqueue_->set_destination_layers(addr, addr6, max_tid, max_layer_id);
+}
+
+void uvgrtp::formats::media::set_fec(uint8_t payload_type, int overhead)
+{
+    fqueue_->set_fec(payload_type, overhead);
+
+    if (payload_type != fec_payload_type_) {
+        fec_payload_type_ = payload_type;
+        fec_ = payload_type ? std::unique_ptr<uvgrtp::fec_decoder>(new uvgrtp::fec_decoder()) : nullptr;
+    }
+}
+
+void uvgrtp::formats::media::recover_packets(int rce_flags, uvgrtp::frame::rtp_frame *frame,
+    std::vector<uvgrtp::frame::rtp_frame *>& packets)
+{
+    if (frame->header.payload == fec_payload_type_) {
+        // the repair packet takes a sequence number, so it must not be asked for
+        track_losses(frame);
+
+        fec_->fec_received(frame);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    } else {
+        fec_->media_received(frame);
+        packets.push_back(frame);
+    }
+
+    recovered_.clear();
+    fec_->recover(recovered_);
+
+    for (auto& packet : recovered_) {
+        uvgrtp::frame::rtp_frame *rebuilt = nullptr;
+
+        // the rebuilt packet is copied to a frame of its own
+        if (rtp_ctx_->packet_handler(nullptr, rce_flags & ~RCE_RECEIVE_ZERO_COPY,
+                packet.data(), packet.size(), &rebuilt) != RTP_PKT_MODIFIED) {
+            continue;
+        }
+        UVG_LOG_DEBUG("Rebuilt the lost packet %u", rebuilt->header.seq);
+        packets.push_back(rebuilt);
+    }
+}
+
+void uvgrtp::formats::media::set_key_frame_requester(std::function<void(uint32_t)> requester, size_t interval_ms)
+{
+    key_frame_requester_ = requester;
+    key_frame_interval_  = std::chrono::milliseconds(interval_ms);
+}
+
+void uvgrtp::formats::media::request_key_frame()
+{
+    if (!key_frame_requester_)
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+
+    // the encoder needs a round trip to respond, asking again meanwhile only adds key frames
+    if (last_key_frame_request_ != std::chrono::steady_clock::time_point() &&
+        now - last_key_frame_request_ < key_frame_interval_)
+    {
+        return;
+    }
+    last_key_frame_request_ = now;
+
+    UVG_LOG_DEBUG("Asking %lu for a key frame", media_ssrc_);
+    key_frame_requester_(media_ssrc_);
+}
+
+void uvgrtp::formats::media::track_losses(const uvgrtp::frame::rtp_frame *frame)
+{
+    media_ssrc_ = frame->header.ssrc;
+
+    if (!nack_)
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+
+    nack_->packet_received(frame->header.seq, now);
+    if (!nack_->missing())
+        return;
+
+    nacks_.clear();
+    nack_->get_nacks(now, rtp_ctx_->get_pkt_max_delay(), nacks_);
+
+    if (!nacks_.empty())
+        nack_sender_(frame->header.ssrc, nacks_);
 }
\ No newline at end of file
@@ -1,11 +1,19 @@
 #pragma once
 
 #include "uvgrtp/util.hh"
+#include "uvgrtp/clock.hh"
 
+#include "../header_extensions.hh"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #ifdef _WIN32
 #include <ws2def.h>
@@ -19,29 +27,129 @@ namespace uvgrtp {
     class socket;
     class rtp;
     class frame_queue;
+    class pacer;
+    class twcc_sender;
+    class path_mtu;
+    class packet_history;
+    class nack_generator;
+    class fec_decoder;
+    class stream_metrics;
+    class memory_budget;
+    struct fanout_destination;
+    struct send_path;
 
     namespace frame {
         struct rtp_frame;
+        struct nal_unit;
+        struct nal_chunk;
     }
 
     namespace formats {
 
         #define INVALID_TS            0xffffffff
 
-        /* TODO: This functionality has much in common with h26x fragmentation and 
-         * they could use same structures */ 
+        /* Gives the buffer that a received raw video frame is written to, see raw_video */
+        typedef uint8_t *(*video_buffer_hook)(void *arg, uint32_t timestamp, size_t size);
+
+        /* Set of the sequence numbers received for one fragmented frame.
+         *
+         * The sequence numbers of one frame are consecutive, so they are kept in a bitmap
+         * where bit "i" tells whether sequence number "base + i" has been received. The
+         * base is the first received sequence number rounded down to a multiple of 64 and it
+         * is moved back if a fragment arrives out of order before it. The arithmetic is done
+         * modulo 2^16 so the sequence numbers may wrap around within a frame. The bitmap is
+         * at most MAX_SEQ_BITMAP_WORDS long so that one frame spans less than 32768 sequence
+         * numbers and the distance to the base is never ambiguous */
+        class seq_bitmap {
+            public:
+                /* Return false if "seq" was already in the set or it does not fit in the bitmap */
+                bool insert(uint16_t seq);
+                bool contains(uint16_t seq) const;
+
+                /* Return true if "seq" can be inserted without the set spanning 32768 or more
+                 * sequence numbers */
+                bool fits(uint16_t seq) const;
+
+                size_t size() const
+                {
+                    return count_;
+                }
 
+                /* Empty the set, keeping the memory of the bitmap for the next frame */
+                void clear()
+                {
+                    base_  = 0;
+                    count_ = 0;
+                    words_.clear();
+                }
+
+                /* Make room for "sequence_numbers" consecutive sequence numbers */
+                void reserve(size_t sequence_numbers)
+                {
+                    words_.reserve(sequence_numbers / 64 + 2);
+                }
+
+                /* Call "func" for every sequence number in the set */
+                template <typename Func>
+                void for_each(Func func) const
+                {
+                    for (size_t i = 0; i < words_.size(); ++i) {
+                        for (uint64_t word = words_[i]; word; word &= word - 1) {
+                            func((uint16_t)(base_ + i * 64 + lowest_bit(word)));
+                        }
+                    }
+                }
+
+            private:
+                static unsigned lowest_bit(uint64_t word);
+
+                uint16_t base_ = 0;
+                size_t count_ = 0;
+                std::vector<uint64_t> words_;
+        };
+
+        /* A generic frame that is reassembled from RCE_FRAGMENT_GENERIC fragments.
+         *
+         * All fragments except the last one are of the same size, so each fragment is copied
+         * straight to offset (seq - base_seq) * frag_size of the output buffer when it arrives.
+         * There is no start marker in generic fragmentation, so the frame is considered to
+         * start from the oldest fragment received */
         typedef struct media_info {
-            uint32_t s_seq = 0;
-            uint32_t e_seq = 0;
-            size_t npkts = 0;
-            size_t size = 0;
-            std::map<uint32_t, uvgrtp::frame::rtp_frame *> fragments;
+            /* clock reading when the first fragment is received */
+            uvgrtp::clock::hrc::hrc_t start_time;
+
+            seq_bitmap received;
+            uint16_t base_seq = 0;
+
+            bool end_received = false;
+            uint16_t e_seq = 0;
+
+            size_t frag_size = 0;    // 0 until a fragment other than the last one has arrived
+
+            uint8_t *buffer = nullptr;
+            size_t capacity = 0;
+            size_t used = 0;         // end of the furthest fragment copied so far
+
+            // last fragment that arrived before the fragment size was known
+            uvgrtp::frame::rtp_frame *pending_end = nullptr;
         } media_info_t;
 
         typedef struct media_frame_info {
             std::unordered_map<uint32_t, media_info> frames;
-            std::unordered_set<uint32_t> dropped;
+
+            /* The frames in the order they were started, so that the lost frames are found
+             * from the front without going through the map. An entry whose frame has since
+             * been completed or replaced is skipped */
+            struct expiry {
+                uvgrtp::clock::hrc::hrc_t time;
+                uint32_t ts;
+            };
+            std::deque<expiry> expiry_queue;
+
+            uvgrtp::clock::coarse::coarse_t last_garbage_collection;
+
+            // size of the previous reassembled frame, used as a size hint for the next buffer
+            size_t last_frame_size = 0;
         } media_frame_info_t;
 
         class media {
@@ -57,6 +165,24 @@ namespace uvgrtp {
                 rtp_error_t push_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t data_len, int rtp_flags);
                 rtp_error_t push_frame(sockaddr_in& addr, sockaddr_in6& addr6, std::unique_ptr<uint8_t[]> data, size_t data_len, int rtp_flags);
 
+                /* Send a frame whose NAL units the application has already located. Forwards
+                 * the call to push_nal_units() after checking the parameters
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_INVALID_VALUE if a parameter is invalid
+                 * Return RTP_NOT_SUPPORTED if the media does not consist of NAL units */
+                rtp_error_t push_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t data_len,
+                    const std::vector<uvgrtp::frame::nal_unit>& nal_units, int rtp_flags);
+
+                /* Send a frame given as pointers to its scan lines. Forwards the call to
+                 * push_scanlines() after checking the parameters
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_INVALID_VALUE if a parameter is invalid
+                 * Return RTP_NOT_SUPPORTED if the media is not raw video */
+                rtp_error_t push_frame(sockaddr_in& addr, sockaddr_in6& addr6,
+                    const std::vector<uint8_t *>& lines, int rtp_flags);
+
                 /* Media-specific packet handler. The default handler, depending on what "rce_flags_" contains,
                  * may only return the received RTP packet or it may merge multiple packets together before
                  * returning a complete frame to the user.
@@ -69,21 +195,173 @@ namespace uvgrtp {
                  * Return RTP_GENERIC_ERROR if the packet was corrupted in some way */
                 rtp_error_t packet_handler(void* arg, int rce_flags, uint8_t* read_ptr, size_t size, frame::rtp_frame** out);
 
+                /* Install a hook that gets the received parts of fragmented NAL units.
+                 * The default implementation returns RTP_NOT_SUPPORTED, the H26x formats override it */
+                virtual rtp_error_t install_nal_chunk_hook(void *arg, void (*hook)(void *, const uvgrtp::frame::nal_chunk *));
+
+                /* Set the frame layout and the receive buffer hook of raw video.
+                 * The default implementations return RTP_NOT_SUPPORTED, raw_video overrides them */
+                virtual rtp_error_t set_video_layout(size_t width, size_t height, size_t pgroup_size, size_t pgroup_pixels);
+                virtual rtp_error_t install_video_buffer_hook(void *arg, video_buffer_hook hook);
+
+                /* Hold the small NAL units of consecutive frames for an aggregation packet, see RCC_AGGREGATION_DEADLINE.
+                 * The default implementation returns RTP_NOT_SUPPORTED, the H26x formats override it */
+                virtual rtp_error_t set_aggregation_deadline(size_t deadline_us);
+
                 /* Return pointer to the internal frame info structure which is relayed to packet handler */
                 media_frame_info_t *get_media_frame_info();
 
                 void set_fps(ssize_t enumarator, ssize_t denominator);
 
+                /* Give the pacer and pacing settings of RCE_PACE_FRAGMENT_SENDING to the frame queue */
+                void set_pacer(std::shared_ptr<uvgrtp::pacer> pacer);
+                void set_pacing(size_t burst_packets, std::chrono::nanoseconds spin);
+                void set_send_priority(int priority, size_t weight);
+
+                /* Pace the frames side by side with those of other media, see frame_queue::defer_pacing() */
+                void defer_pacing(bool defer);
+                rtp_error_t finish_pacing();
+
+                /* Resize the payloads to the path MTU at the start of each frame, see frame_queue::set_path_mtu() */
+                void set_path_mtu(std::shared_ptr<uvgrtp::path_mtu> path_mtu);
+
+                /* Number the sent packets for transport-wide congestion control, see frame_queue::set_twcc() */
+                rtp_error_t set_twcc(std::shared_ptr<uvgrtp::twcc_sender> sender, uint8_t ext_id);
+
+                /* Add an element to the header extension of the sent packets, see frame_queue::set_header_extension() */
+                rtp_error_t set_header_extension(uvgrtp::HEADER_EXTENSION extension, uint8_t id);
+
+                /* Set the MID or RID of the sent packets, see frame_queue::set_header_extension_value() */
+                rtp_error_t set_header_extension_value(uvgrtp::HEADER_EXTENSION extension, const std::string& value);
+
+                /* Return the bytes the header extension takes from each packet */
+                size_t header_extension_size() const;
+
+                /* Return the ID of the header extension element "extension", zero if it is not sent */
+                uint8_t header_extension_id(uvgrtp::HEADER_EXTENSION extension) const;
+
+                /* The audio level of the frames sent after this, see frame_queue::set_audio_level() */
+                void set_audio_level(uint8_t level, bool voice_activity);
+
+                /* Spread the packets over several paths, see frame_queue::set_paths() */
+                void set_paths(std::shared_ptr<const std::vector<uvgrtp::send_path>> paths);
+
+                /* Cache the frames since the last key frame for new destinations, see frame_queue::set_gop_cache() */
+                void set_gop_cache(size_t limit);
+
+                /* Keep the sent packets for retransmission, see frame_queue::set_packet_history() */
+                void set_packet_history(std::shared_ptr<uvgrtp::packet_history> history);
+
+                /* Ask for the lost packets with "sender", which is given the SSRC of the media
+                 * and the sequence numbers to ask for. An empty "sender" stops asking, see RCC_NACK */
+                void set_nack_sender(std::function<void(uint32_t, const std::vector<uint16_t>&)> sender);
+
+                /* Send the packets of each frame also to "destination" or stop sending them to the destination
+                 * with the address "addr" or "addr6", see frame_queue::add_destination() */
+                rtp_error_t add_destination(const uvgrtp::fanout_destination& destination);
+                rtp_error_t remove_destination(const sockaddr_in& addr, const sockaddr_in6& addr6);
+
+                /* Limit the layers sent to a destination, see frame_queue::set_destination_layers() */
+                rtp_error_t set_destination_layers(const sockaddr_in& addr, const sockaddr_in6& addr6,
+                    uint8_t max_tid, uint8_t max_layer_id);
+
+                /* Build the one-packet frame "data" of uvgrtp::context::push_audio_frames() without a
+                 * transaction, see frame_queue::prepare_single(). Return nullptr if the frame has to be
+                 * sent with push_frame(). The result is a uvgrtp::buf_vec */
+                std::vector<std::pair<size_t, uint8_t *>> *prepare_single_packet(uint8_t *data, size_t data_len);
+
+                /* The packet of prepare_single_packet() has been sent */
+                void single_packet_sent();
+
+                /* Send and receive the repair packets of forward error correction with the payload
+                 * type "payload_type", see frame_queue::set_fec(). A zero "payload_type" disables FEC */
+                void set_fec(uint8_t payload_type, int overhead);
+
+                /* Count the packets and frames of the stream in "metrics", see media_stream::get_stats() */
+                void set_metrics(std::shared_ptr<uvgrtp::stream_metrics> metrics);
+
+                /* Charge the received frames held by the stream to "budget", see RCC_MEMORY_BUDGET */
+                void set_memory_budget(std::shared_ptr<uvgrtp::memory_budget> budget);
+
+                /* Ask the sender for a key frame with "requester", which is given the SSRC of the
+                 * media, when a frame cannot be decoded. The requests are at least "interval_ms"
+                 * apart. An empty "requester" stops asking, see RCC_KEY_FRAME_REQUEST */
+                void set_key_frame_requester(std::function<void(uint32_t)> requester, size_t interval_ms);
+
             protected:
                 virtual rtp_error_t push_media_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t data_len, int rtp_flags);
 
+                /* Default implementation returns RTP_NOT_SUPPORTED, the H26x formats override it */
+                virtual rtp_error_t push_nal_units(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t data_len,
+                    const std::vector<uvgrtp::frame::nal_unit>& nal_units, int rtp_flags);
+
+                /* Default implementation returns RTP_NOT_SUPPORTED, raw_video overrides it */
+                virtual rtp_error_t push_scanlines(sockaddr_in& addr, sockaddr_in6& addr6,
+                    const std::vector<uint8_t *>& lines, int rtp_flags);
+
                 std::shared_ptr<uvgrtp::socket> socket_;
                 std::shared_ptr<uvgrtp::rtp> rtp_ctx_;
                 int rce_flags_;
                 std::unique_ptr<uvgrtp::frame_queue> fqueue_;
 
+                /* Counters of the stream, may be null */
+                std::shared_ptr<uvgrtp::stream_metrics> metrics_;
+
+                /* The memory budget of the stream, may be null */
+                std::shared_ptr<uvgrtp::memory_budget> memory_budget_;
+
+                /* Find the packets lost before "frame" and ask for them before the frames
+                 * they belong to are given up after RCC_PKT_MAX_DELAY, see set_nack_sender().
+                 * The SSRC of "frame" is remembered for the key frame requests */
+                void track_losses(const uvgrtp::frame::rtp_frame *frame);
+
+                /* A frame has been lost or cannot be decoded, see set_key_frame_requester() */
+                void request_key_frame();
+
+                /* Pass a received packet through FEC recovery. A media packet is added to "packets"
+                 * followed by the lost packets that could be rebuilt with it, which are then handled
+                 * like received ones. A repair packet is released and only the rebuilt packets are added */
+                void recover_packets(int rce_flags, uvgrtp::frame::rtp_frame *frame,
+                    std::vector<uvgrtp::frame::rtp_frame *>& packets);
+
+                bool fec_enabled() const
+                {
+                    return fec_payload_type_ != 0;
+                }
+
+                /* The ID of the frame marking element, which the received packets are expected to
+                 * carry with the same ID as the sent ones. Zero if frame marking is not used */
+                std::atomic<uint8_t> frame_marking_id_{0};
+
             private:
+                /* Copy "frame" to its place in the output buffer of "info" and release it
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_INVALID_VALUE if the fragment sizes of the frame are not uniform */
+                rtp_error_t store_fragment(media_info_t& info, uvgrtp::frame::rtp_frame *frame, bool end);
+
+                void reserve_buffer(media_info_t& info, size_t size);
+
+                /* Release the fragments of frame "ts" and return the number of bytes freed */
+                size_t drop_frame(uint32_t ts);
+
+                /* Drop the frames that have not been completed within RCC_PKT_MAX_DELAY */
+                void garbage_collect_lost_frames(size_t timeout);
+
                 media_frame_info_t minfo_;
+
+                std::shared_ptr<uvgrtp::nack_generator> nack_;
+                std::function<void(uint32_t, const std::vector<uint16_t>&)> nack_sender_;
+                std::vector<uint16_t> nacks_;
+
+                uint8_t fec_payload_type_ = 0;
+                std::unique_ptr<uvgrtp::fec_decoder> fec_;
+                std::vector<std::vector<uint8_t>> recovered_;
+
+                uint32_t media_ssrc_ = 0;
+                std::function<void(uint32_t)> key_frame_requester_;
+                std::chrono::milliseconds key_frame_interval_ = std::chrono::milliseconds(0);
+                std::chrono::steady_clock::time_point last_key_frame_request_;
         };
     }
 }
@@ -0,0 +1,413 @@
+#include "raw_video.hh"
+
+#include "../rtp.hh"
+#include "../frame_queue.hh"
+#include "../frame_pool.hh"
+#include "debug.hh"
+#include "stream_metrics.hh"
+
+#include <algorithm>
+#include <cstring>
+
+// how often the frames that will not be completed are looked for
+constexpr int GARBAGE_COLLECTION_INTERVAL_MS = 100;
+
+// line numbers and offsets are 15-bit fields of the segment header
+constexpr size_t MAX_RAW_VIDEO_DIMENSION = 0x7fff;
+
+static inline void write_u16(uint8_t *ptr, uint16_t value)
+{
+    ptr[0] = (uint8_t)(value >> 8);
+    ptr[1] = (uint8_t)(value & 0xff);
+}
+
+static inline uint16_t read_u16(const uint8_t *ptr)
+{
+    return (uint16_t)((ptr[0] << 8) | ptr[1]);
+}
+
+uvgrtp::formats::raw_video::raw_video(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int rce_flags) :
+    media(socket, rtp, rce_flags),
+    width_(0),
+    height_(0),
+    pgroup_size_(DEFAULT_PGROUP_SIZE),
+    pgroup_pixels_(DEFAULT_PGROUP_PIXELS),
+    ext_seq_(0),
+    prev_seq_(0),
+    frame_lines_(),
+    packet_(),
+    buffer_hook_arg_(nullptr),
+    buffer_hook_(nullptr),
+    spare_user_buffer_(nullptr),
+    frames_(),
+    last_garbage_collection_(uvgrtp::clock::coarse::now())
+{}
+
+uvgrtp::formats::raw_video::~raw_video()
+{
+    for (auto& frame : frames_) {
+        release_frame(frame.second);
+    }
+    frames_.clear();
+}
+
+rtp_error_t uvgrtp::formats::raw_video::set_video_layout(size_t width, size_t height, size_t pgroup_size, size_t pgroup_pixels)
+{
+    if (pgroup_size == 0 || pgroup_pixels == 0 ||
+        width > MAX_RAW_VIDEO_DIMENSION || height > MAX_RAW_VIDEO_DIMENSION) {
+        UVG_LOG_ERROR("Invalid video layout %zux%zu with %zu bytes per %zu pixels",
+            width, height, pgroup_size, pgroup_pixels);
+        return RTP_INVALID_VALUE;
+    }
+
+    // the frames being received have the old layout
+    for (auto& frame : frames_) {
+        release_frame(frame.second);
+    }
+    frames_.clear();
+    spare_user_buffer_ = nullptr;
+
+    width_         = width;
+    height_        = height;
+    pgroup_size_   = pgroup_size;
+    pgroup_pixels_ = pgroup_pixels;
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::formats::raw_video::install_video_buffer_hook(void *arg, video_buffer_hook hook)
+{
+    buffer_hook_arg_   = arg;
+    buffer_hook_       = hook;
+    spare_user_buffer_ = nullptr;
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::formats::raw_video::push_media_frame(sockaddr_in& addr, sockaddr_in6& addr6,
+    uint8_t *data, size_t data_len, int rtp_flags)
+{
+    (void)rtp_flags;
+
+    rtp_error_t ret;
+
+    if (!layout_ready()) {
+        UVG_LOG_ERROR("Set the video layout with RCC_VIDEO_WIDTH and RCC_VIDEO_HEIGHT before sending, "
+            "the width must be a multiple of RCC_VIDEO_PGROUP_PIXELS");
+        return RTP_INVALID_VALUE;
+    }
+
+    if (data_len != line_bytes() * height_) {
+        UVG_LOG_ERROR("Raw video frame is %zu bytes, %zu bytes expected", data_len, line_bytes() * height_);
+        return RTP_INVALID_VALUE;
+    }
+
+    if ((ret = fqueue_->init_transaction(data)) != RTP_OK) {
+        UVG_LOG_ERROR("Invalid frame queue or failed to initialize transaction!");
+        return ret;
+    }
+
+    // the lines are packetized the same way whether they are contiguous or not
+    frame_lines_.resize(height_);
+    for (size_t i = 0; i < height_; ++i) {
+        frame_lines_[i] = data + i * line_bytes();
+    }
+
+    return send_lines(addr, addr6, frame_lines_);
+}
+
+rtp_error_t uvgrtp::formats::raw_video::push_scanlines(sockaddr_in& addr, sockaddr_in6& addr6,
+    const std::vector<uint8_t *>& lines, int rtp_flags)
+{
+    (void)rtp_flags;
+
+    rtp_error_t ret;
+
+    if (!layout_ready()) {
+        UVG_LOG_ERROR("Set the video layout with RCC_VIDEO_WIDTH and RCC_VIDEO_HEIGHT before sending, "
+            "the width must be a multiple of RCC_VIDEO_PGROUP_PIXELS");
+        return RTP_INVALID_VALUE;
+    }
+
+    if (lines.size() != height_) {
+        UVG_LOG_ERROR("Raw video frame has %zu lines, %zu expected", lines.size(), height_);
+        return RTP_INVALID_VALUE;
+    }
+
+    if ((ret = fqueue_->init_transaction()) != RTP_OK) {
+        UVG_LOG_ERROR("Invalid frame queue or failed to initialize transaction!");
+        return ret;
+    }
+
+    return send_lines(addr, addr6, lines);
+}
+
+rtp_error_t uvgrtp::formats::raw_video::send_lines(sockaddr_in& addr, sockaddr_in6& addr6, const std::vector<uint8_t *>& lines)
+{
+    rtp_error_t ret;
+
+    const size_t payload_size = rtp_ctx_->get_payload_size();
+    const size_t line_len     = line_bytes();
+
+    if (payload_size < HEADER_SIZE_RAW_VIDEO_EXT_SEQ + HEADER_SIZE_RAW_VIDEO_SEGMENT + pgroup_size_) {
+        UVG_LOG_ERROR("Payload size %zu is too small for a pixel group of %zu bytes", payload_size, pgroup_size_);
+        (void)fqueue_->deinit_transaction();
+        return RTP_INVALID_VALUE;
+    }
+
+    uint16_t seq = rtp_ctx_->get_sequence();
+    size_t line  = 0;
+    size_t pos   = 0; // byte offset inside "line"
+
+    while (line < height_) {
+        size_t space = payload_size - HEADER_SIZE_RAW_VIDEO_EXT_SEQ;
+
+        /* The size of the payload header depends on how many segments fit in the packet,
+         * so the segments are chosen first and the header is written after that */
+        packet_.clear();
+        packet_.push_back({ 0, nullptr });
+
+        while (line < height_ && space >= HEADER_SIZE_RAW_VIDEO_SEGMENT + pgroup_size_) {
+            size_t len = std::min(line_len - pos,
+                (space - HEADER_SIZE_RAW_VIDEO_SEGMENT) / pgroup_size_ * pgroup_size_);
+
+            packet_.push_back({ len, lines[line] + pos });
+            space -= HEADER_SIZE_RAW_VIDEO_SEGMENT + len;
+
+            if ((pos += len) == line_len) {
+                ++line;
+                pos = 0;
+            }
+        }
+
+        size_t segments    = packet_.size() - 1;
+        size_t header_size = HEADER_SIZE_RAW_VIDEO_EXT_SEQ + segments * HEADER_SIZE_RAW_VIDEO_SEGMENT;
+        uint8_t *header    = fqueue_->alloc_media_headers(header_size);
+
+        if (!header) {
+            (void)fqueue_->deinit_transaction();
+            return RTP_MEMORY_ERROR;
+        }
+
+        // the extended sequence number is the RTP sequence number with 16 more bits on top
+        if (seq < prev_seq_)
+            ++ext_seq_;
+        prev_seq_ = seq++;
+
+        write_u16(header, ext_seq_);
+
+        /* Walk the segments back from the end of the packet to find their lines and offsets */
+        size_t seg_line = line;
+        size_t seg_pos  = pos;
+
+        for (size_t i = segments; i > 0; --i) {
+            size_t len = packet_[i].first;
+
+            if (seg_pos == 0) {
+                --seg_line;
+                seg_pos = line_len;
+            }
+            seg_pos -= len;
+
+            uint8_t *seg_header = header + HEADER_SIZE_RAW_VIDEO_EXT_SEQ + (i - 1) * HEADER_SIZE_RAW_VIDEO_SEGMENT;
+            uint16_t offset     = (uint16_t)(seg_pos / pgroup_size_ * pgroup_pixels_);
+
+            write_u16(seg_header,     (uint16_t)len);
+            write_u16(seg_header + 2, (uint16_t)seg_line);   // field bit is zero
+            write_u16(seg_header + 4, (uint16_t)(offset | ((i < segments) ? 0x8000 : 0)));
+        }
+
+        packet_[0] = { header_size, header };
+
+        if ((ret = fqueue_->enqueue_message(packet_, line == height_)) != RTP_OK) {
+            UVG_LOG_ERROR("Failed to enqueue raw video packet");
+            (void)fqueue_->deinit_transaction();
+            return ret;
+        }
+    }
+
+    return fqueue_->flush_queue(addr, addr6);
+}
+
+rtp_error_t uvgrtp::formats::raw_video::packet_handler(void* arg, int rce_flags, uint8_t* read_ptr, size_t size, frame::rtp_frame** out)
+{
+    (void)arg, (void)rce_flags, (void)read_ptr, (void)size;
+
+    uvgrtp::frame::rtp_frame *frame = *out;
+
+    // without a layout the pixels have nowhere to go, so the packets are returned as they are
+    if (!layout_ready()) {
+        return RTP_PKT_READY;
+    }
+
+    *out = nullptr;
+
+    const size_t line_len = line_bytes();
+    const uint8_t *ptr    = frame->payload;
+    size_t left           = frame->payload_len;
+
+    if (left < HEADER_SIZE_RAW_VIDEO_EXT_SEQ + HEADER_SIZE_RAW_VIDEO_SEGMENT) {
+        UVG_LOG_WARN("Received a raw video packet that is too small: %zu bytes", left);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return RTP_GENERIC_ERROR;
+    }
+
+    ptr  += HEADER_SIZE_RAW_VIDEO_EXT_SEQ;
+    left -= HEADER_SIZE_RAW_VIDEO_EXT_SEQ;
+
+    // find where the pixels start and check that each segment falls inside the frame
+    const uint8_t *segments = ptr;
+    size_t count = 0;
+    size_t total = 0;
+    bool more    = true;
+
+    while (more) {
+        if (left < HEADER_SIZE_RAW_VIDEO_SEGMENT) {
+            UVG_LOG_WARN("Truncated raw video payload header");
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            return RTP_GENERIC_ERROR;
+        }
+
+        size_t len    = read_u16(ptr);
+        bool field    = ptr[2] & 0x80;
+        size_t line   = read_u16(ptr + 2) & 0x7fff;
+        size_t offset = read_u16(ptr + 4) & 0x7fff;
+        more          = ptr[4] & 0x80;
+
+        if (field || line >= height_ || offset % pgroup_pixels_ != 0 || len % pgroup_size_ != 0 ||
+            offset / pgroup_pixels_ * pgroup_size_ + len > line_len) {
+            UVG_LOG_WARN("Raw video segment of %zu bytes at line %zu, offset %zu does not fit the frame",
+                len, line, offset);
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            return RTP_GENERIC_ERROR;
+        }
+
+        ptr   += HEADER_SIZE_RAW_VIDEO_SEGMENT;
+        left  -= HEADER_SIZE_RAW_VIDEO_SEGMENT;
+        total += len;
+        ++count;
+    }
+
+    if (total > left) {
+        UVG_LOG_WARN("Raw video segments have %zu bytes, but the packet only has %zu", total, left);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return RTP_GENERIC_ERROR;
+    }
+
+    uint32_t ts = frame->header.timestamp;
+    video_frame& vframe = get_frame(ts, frame->recv_time);
+
+    if (!vframe.received.insert(frame->header.seq)) {
+        UVG_LOG_DEBUG("Received a duplicate raw video packet %u of frame %lu", frame->header.seq, ts);
+        if (metrics_)
+            metrics_->count(uvgrtp::stream_metrics::DUPLICATE_PACKETS);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return RTP_OK;
+    }
+
+    // copy the pixels straight to their place in the frame
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t *seg_header = segments + i * HEADER_SIZE_RAW_VIDEO_SEGMENT;
+
+        size_t len    = read_u16(seg_header);
+        size_t line   = read_u16(seg_header + 2) & 0x7fff;
+        size_t offset = read_u16(seg_header + 4) & 0x7fff;
+
+        std::memcpy(vframe.buffer + line * line_len + offset / pgroup_pixels_ * pgroup_size_, ptr, len);
+
+        ptr += len;
+        vframe.received_bytes += len;
+    }
+
+    if (vframe.received_bytes >= line_len * height_) {
+        uvgrtp::frame::rtp_frame *complete = uvgrtp::frame::alloc_rtp_frame();
+
+        std::memcpy(&complete->header, &frame->header, sizeof(frame->header));
+        complete->payload     = vframe.buffer;
+        complete->payload_len = line_len * height_;
+        complete->recv_time   = frame->recv_time;
+
+        /* The application owns a buffer that came from the hook. Marking the payload as
+         * part of a datagram that does not exist keeps dealloc_frame() from freeing it */
+        if (vframe.user_buffer) {
+            complete->dgram       = nullptr;
+            complete->dgram_owned = true;
+        }
+
+        if (metrics_)
+            metrics_->record(uvgrtp::stream_metrics::REASSEMBLY_LATENCY_US, uvgrtp::clock::hrc::diff_now_us(vframe.start_time));
+
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        frames_.erase(ts);
+
+        *out = complete;
+        return RTP_PKT_READY;
+    }
+
+    (void)uvgrtp::frame::dealloc_frame(frame);
+
+    // make sure uvgRTP does not reserve increasing amounts of memory because some frames are not completed
+    garbage_collect_lost_frames(rtp_ctx_->get_pkt_max_delay());
+    return RTP_OK;
+}
+
+uvgrtp::formats::raw_video::video_frame& uvgrtp::formats::raw_video::get_frame(uint32_t ts, uint64_t recv_time)
+{
+    auto it = frames_.find(ts);
+    if (it != frames_.end()) {
+        return it->second;
+    }
+
+    video_frame& vframe = frames_[ts];
+    size_t frame_size   = line_bytes() * height_;
+
+    vframe.start_time = recv_time ? uvgrtp::clock::hrc::from_system_ns(recv_time) : uvgrtp::clock::hrc::now();
+
+    if (spare_user_buffer_) {
+        vframe.buffer      = spare_user_buffer_;
+        vframe.user_buffer = true;
+        spare_user_buffer_ = nullptr;
+    } else if (buffer_hook_ && (vframe.buffer = buffer_hook_(buffer_hook_arg_, ts, frame_size)) != nullptr) {
+        vframe.user_buffer = true;
+    } else {
+        vframe.buffer = uvgrtp::frame_pool::alloc_payload(frame_size);
+    }
+
+    return vframe;
+}
+
+void uvgrtp::formats::raw_video::release_frame(video_frame& vframe)
+{
+    if (vframe.user_buffer) {
+        spare_user_buffer_ = vframe.buffer;
+    } else {
+        uvgrtp::frame_pool::free_payload(vframe.buffer);
+    }
+    vframe.buffer = nullptr;
+}
+
+void uvgrtp::formats::raw_video::garbage_collect_lost_frames(size_t timeout)
+{
+    if (uvgrtp::clock::coarse::diff_now(last_garbage_collection_) < GARBAGE_COLLECTION_INTERVAL_MS) {
+        return;
+    }
+
+    for (auto it = frames_.begin(); it != frames_.end();) {
+        if (uvgrtp::clock::hrc::diff_now(it->second.start_time) > timeout) {
+            UVG_LOG_WARN("Found an old raw video frame that has not been completed. Ts: %lu, bytes received/expected: %zu/%zu",
+                it->first, it->second.received_bytes, line_bytes() * height_);
+
+            if (metrics_) {
+                metrics_->count(uvgrtp::stream_metrics::LATE_FRAMES);
+                metrics_->count(uvgrtp::stream_metrics::DROPPED_FRAMES);
+            }
+
+            release_frame(it->second);
+            it = frames_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    last_garbage_collection_ = uvgrtp::clock::coarse::now();
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "media.hh"
+
+#include "uvgrtp/clock.hh"
+#include "uvgrtp/util.hh"
+#include "uvgrtp/frame.hh"
+
+#include "socket.hh"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace uvgrtp {
+
+    namespace formats {
+
+        /* The payload header starts with the high 16 bits of the extended sequence number,
+         * followed by one segment header per scan line segment in the packet */
+        constexpr size_t HEADER_SIZE_RAW_VIDEO_EXT_SEQ = 2;
+        constexpr size_t HEADER_SIZE_RAW_VIDEO_SEGMENT = 6;
+
+        /* Default pixel group, two pixels of YCbCr 4:2:2 with 10-bit samples in five bytes */
+        constexpr size_t DEFAULT_PGROUP_SIZE   = 5;
+        constexpr size_t DEFAULT_PGROUP_PIXELS = 2;
+
+        /* Uncompressed video, see RFC 4175
+         *
+         * Each packet carries whole pixel groups from one or more scan lines. The packets are
+         * built from pointers to the scan lines of the frame, so the pixels are never copied
+         * on the sending side, and on the receiving side the pixels of each packet are copied
+         * straight to their line and offset in the output frame. Only progressive video is
+         * supported, the field bit is always zero. */
+        class raw_video : public media {
+            public:
+                raw_video(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int rce_flags);
+                ~raw_video();
+
+                /* Set the frame size in pixels and the pixel group in bytes and pixels
+                 *
+                 * The layout can be set one value at a time, so it is only checked to be complete
+                 * when a frame is sent or received, see layout_ready()
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_INVALID_VALUE if the pixel group is empty or the frame size does not
+                 * fit in the 15 bits of the segment header */
+                virtual rtp_error_t set_video_layout(size_t width, size_t height, size_t pgroup_size, size_t pgroup_pixels);
+
+                virtual rtp_error_t install_video_buffer_hook(void *arg, video_buffer_hook hook);
+
+                /* Place the pixels of a received packet to their frame and return the frame
+                 * in "out" when all of its pixels have arrived
+                 *
+                 * Return RTP_OK if the packet was handled but no frame was completed
+                 * Return RTP_PKT_READY if "out" holds a complete frame
+                 * Return RTP_GENERIC_ERROR if the packet is malformed */
+                rtp_error_t packet_handler(void* arg, int rce_flags, uint8_t* read_ptr, size_t size, frame::rtp_frame** out);
+
+            protected:
+                virtual rtp_error_t push_media_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t data_len, int rtp_flags);
+
+                virtual rtp_error_t push_scanlines(sockaddr_in& addr, sockaddr_in6& addr6,
+                    const std::vector<uint8_t *>& lines, int rtp_flags);
+
+            private:
+                struct video_frame {
+                    uint8_t *buffer = nullptr;
+                    bool user_buffer = false;    // the buffer came from the buffer hook
+
+                    size_t received_bytes = 0;
+                    seq_bitmap received;
+
+                    uvgrtp::clock::hrc::hrc_t start_time;
+                };
+
+                /* Packetize the scan lines in "lines" into one transaction and send it */
+                rtp_error_t send_lines(sockaddr_in& addr, sockaddr_in6& addr6, const std::vector<uint8_t *>& lines);
+
+                /* The frame size is known and it has a whole number of pixel groups per line */
+                bool layout_ready() const
+                {
+                    return width_ > 0 && height_ > 0 && width_ % pgroup_pixels_ == 0;
+                }
+
+                size_t line_bytes() const
+                {
+                    return width_ / pgroup_pixels_ * pgroup_size_;
+                }
+
+                video_frame& get_frame(uint32_t ts, uint64_t recv_time);
+                void release_frame(video_frame& frame);
+
+                /* Drop the frames that have not been completed within RCC_PKT_MAX_DELAY */
+                void garbage_collect_lost_frames(size_t timeout);
+
+                size_t width_;
+                size_t height_;
+                size_t pgroup_size_;
+                size_t pgroup_pixels_;
+
+                /* High 16 bits of the extended sequence number of the next packet and the
+                 * RTP sequence number of the previous packet, to notice when it wraps */
+                uint16_t ext_seq_;
+                uint16_t prev_seq_;
+
+                /* Line pointers of a contiguous frame given to push_frame(), reused between frames */
+                std::vector<uint8_t *> frame_lines_;
+                uvgrtp::buf_vec packet_;
+
+                void *buffer_hook_arg_;
+                video_buffer_hook buffer_hook_;
+
+                /* Application buffer of a dropped frame, used for the next frame instead
+                 * of asking the hook for a new one */
+                uint8_t *spare_user_buffer_;
+
+                std::unordered_map<uint32_t, video_frame> frames_;
+                uvgrtp::clock::coarse::coarse_t last_garbage_collection_;
+        };
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
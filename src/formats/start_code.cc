@@ -0,0 +1,144 @@
+#include "start_code.hh"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UVGRTP_SCAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define UVGRTP_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(UVGRTP_SCAN_X86) && (defined(__GNUC__) || defined(__clang__))
+#define UVGRTP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define UVGRTP_TARGET_AVX2
+#endif
+
+typedef size_t (*skip_func)(const uint8_t *data, size_t pos, size_t len);
+
+#if !defined(UVGRTP_SCAN_X86) && !defined(UVGRTP_SCAN_NEON)
+static size_t skip_scalar(const uint8_t *data, size_t pos, size_t len)
+{
+    (void)data, (void)len;
+    return pos;
+}
+#endif
+
+#ifdef UVGRTP_SCAN_X86
+/* The block is compared with itself shifted by one byte, so a pair at the last
+ * byte of the block is found too. This is why one byte more than the block is read */
+static size_t skip_sse2(const uint8_t *data, size_t pos, size_t len)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    while (pos + 32 + 1 <= len) {
+        const uint8_t *p = data + pos;
+
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(p +  0));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(p +  1));
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(p + 16));
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(p + 17));
+
+        __m128i pairs0 = _mm_and_si128(_mm_cmpeq_epi8(a0, zero), _mm_cmpeq_epi8(b0, zero));
+        __m128i pairs1 = _mm_and_si128(_mm_cmpeq_epi8(a1, zero), _mm_cmpeq_epi8(b1, zero));
+
+        if (_mm_movemask_epi8(_mm_or_si128(pairs0, pairs1)))
+            break;
+
+        pos += 32;
+    }
+
+    return pos;
+}
+
+UVGRTP_TARGET_AVX2
+static size_t skip_avx2(const uint8_t *data, size_t pos, size_t len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+
+    while (pos + 64 + 1 <= len) {
+        const uint8_t *p = data + pos;
+
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(p +  0));
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(p +  1));
+        __m256i a1 = _mm256_loadu_si256((const __m256i *)(p + 32));
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(p + 33));
+
+        __m256i pairs0 = _mm256_and_si256(_mm256_cmpeq_epi8(a0, zero), _mm256_cmpeq_epi8(b0, zero));
+        __m256i pairs1 = _mm256_and_si256(_mm256_cmpeq_epi8(a1, zero), _mm256_cmpeq_epi8(b1, zero));
+
+        if (_mm256_movemask_epi8(_mm256_or_si256(pairs0, pairs1)))
+            break;
+
+        pos += 64;
+    }
+
+    // finish the tail that is too short for a full AVX2 block
+    return skip_sse2(data, pos, len);
+}
+
+static bool cpu_has_avx2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // the OS must also save the AVX state (OSXSAVE and XCR0 bits 1 and 2)
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+#endif
+
+#ifdef UVGRTP_SCAN_NEON
+static size_t skip_neon(const uint8_t *data, size_t pos, size_t len)
+{
+    while (pos + 32 + 1 <= len) {
+        const uint8_t *p = data + pos;
+
+        uint8x16_t pairs0 = vandq_u8(vceqzq_u8(vld1q_u8(p +  0)), vceqzq_u8(vld1q_u8(p +  1)));
+        uint8x16_t pairs1 = vandq_u8(vceqzq_u8(vld1q_u8(p + 16)), vceqzq_u8(vld1q_u8(p + 17)));
+
+        if (vmaxvq_u8(vorrq_u8(pairs0, pairs1)))
+            break;
+
+        pos += 32;
+    }
+
+    return pos;
+}
+#endif
+
+static skip_func select_implementation()
+{
+#if defined(UVGRTP_SCAN_X86)
+    if (cpu_has_avx2())
+        return skip_avx2;
+    return skip_sse2;
+#elif defined(UVGRTP_SCAN_NEON)
+    return skip_neon;
+#else
+    return skip_scalar;
+#endif
+}
+
+size_t uvgrtp::formats::skip_start_code_free(const uint8_t *data, size_t pos, size_t len)
+{
+    static const skip_func skip = select_implementation();
+
+    return skip(data, pos, len);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace uvgrtp {
+    namespace formats {
+
+        /* Vectorized pre-filter for the H26x start code lookup.
+         *
+         * Every start code begins with two zero bytes, so a block of data that has no
+         * "00 00" pair in it cannot contain the beginning of a start code. Starting from
+         * "pos", skip blocks of 32 or 64 bytes (depending on the instruction set) until a
+         * block has a candidate pair or the end of the data is near. The pair that
+         * straddles the end of a block is checked with that block, so nothing is missed.
+         *
+         * The implementation is selected at runtime: AVX2 or SSE2 on x86 and NEON on
+         * AArch64. On other platforms "pos" is returned as is and the caller scans
+         * the data with the scalar code.
+         *
+         * Return the position of the first block that may contain a start code. The
+         * returned position is "pos" plus a multiple of 8 bytes and "data" is only read
+         * up to index "len" - 1 */
+        size_t skip_start_code_free(const uint8_t *data, size_t pos, size_t len);
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,155 @@
+#include "forwarder.hh"
+
+#include "global.hh"
+#include "debug.hh"
+
+#include <cstring>
+
+uvgrtp::forwarder::forwarder():
+    targets_(std::make_shared<const std::vector<std::shared_ptr<target>>>()),
+    hook_(nullptr),
+    has_pending_(false)
+{
+}
+
+uvgrtp::forwarder::~forwarder()
+{
+}
+
+void uvgrtp::forwarder::add_target(const void *key, std::shared_ptr<uvgrtp::socket> socket,
+    const sockaddr_in& addr, const sockaddr_in6& addr6,
+    std::shared_ptr<std::atomic<uint32_t>> ssrc, uint16_t seq, uint32_t ts)
+{
+    auto t = std::make_shared<target>();
+    t->key       = key;
+    t->socket    = socket;
+    t->addr      = addr;
+    t->addr6     = addr6;
+    t->ssrc      = ssrc;
+    t->first_seq = seq;
+    t->first_ts  = ts;
+    t->headers.resize(MAX_FORWARD_BATCH * RTP_HDR_SIZE);
+    t->packets.reserve(MAX_FORWARD_BATCH);
+
+    std::lock_guard<std::mutex> lock(targets_mutex_);
+
+    auto targets = std::make_shared<std::vector<std::shared_ptr<target>>>();
+
+    for (auto& old : *targets_) {
+        if (old->key != key)
+            targets->push_back(old);
+    }
+    targets->push_back(t);
+
+    std::atomic_store(&targets_, std::shared_ptr<const std::vector<std::shared_ptr<target>>>(targets));
+}
+
+rtp_error_t uvgrtp::forwarder::remove_target(const void *key)
+{
+    std::lock_guard<std::mutex> lock(targets_mutex_);
+
+    auto targets = std::make_shared<std::vector<std::shared_ptr<target>>>();
+
+    for (auto& old : *targets_) {
+        if (old->key != key)
+            targets->push_back(old);
+    }
+
+    if (targets->size() == targets_->size())
+        return RTP_NOT_FOUND;
+
+    // the packets already queued to the removed target are still sent by flush()
+    std::atomic_store(&targets_, std::shared_ptr<const std::vector<std::shared_ptr<target>>>(targets));
+    return RTP_OK;
+}
+
+void uvgrtp::forwarder::set_hook(void *arg, forward_hook hook)
+{
+    std::shared_ptr<const hook_entry> entry;
+
+    if (hook)
+        entry = std::make_shared<const hook_entry>(hook_entry{ arg, hook });
+
+    std::atomic_store(&hook_, entry);
+}
+
+int uvgrtp::forwarder::forward(uint8_t *packet, size_t size)
+{
+    int action = RTP_FORWARD_SEND;
+
+    std::shared_ptr<const hook_entry> hook = std::atomic_load(&hook_);
+    std::shared_ptr<const std::vector<std::shared_ptr<target>>> targets = std::atomic_load(&targets_);
+
+    // without targets and a hook the stream receives as if it did not forward
+    if (!hook && targets->empty())
+        return RTP_FORWARD_DELIVER;
+
+    if (hook)
+        action = hook->hook(hook->arg, packet, size);
+
+    if (!(action & RTP_FORWARD_SEND) || size < RTP_HDR_SIZE || targets->empty())
+        return action & ~RTP_FORWARD_SEND;
+
+    // the hook may have rewritten the header, so it is read after the hook
+    uint16_t seq = ntohs(*(uint16_t *)&packet[2]);
+    uint32_t ts  = ntohl(*(uint32_t *)&packet[4]);
+
+    std::lock_guard<std::mutex> lock(process_mutex_);
+
+    for (auto& t : *targets) {
+        if (!t->started) {
+            t->seq_offset = (uint16_t)(t->first_seq - seq);
+            t->ts_offset  = t->first_ts - ts;
+            t->started    = true;
+        }
+
+        if (!t->queued) {
+            pending_.push_back(t);
+            t->queued = true;
+        }
+
+        uint8_t *header = &t->headers[t->packets.size() * RTP_HDR_SIZE];
+
+        std::memcpy(header, packet, RTP_HDR_SIZE);
+        *(uint16_t *)&header[2] = htons((uint16_t)(seq + t->seq_offset));
+        *(uint32_t *)&header[4] = htonl(ts + t->ts_offset);
+        *(uint32_t *)&header[8] = htonl(t->ssrc->load(std::memory_order_relaxed));
+
+        t->packets.push_back({ { RTP_HDR_SIZE, header }, { size - RTP_HDR_SIZE, packet + RTP_HDR_SIZE } });
+
+        if (t->packets.size() == MAX_FORWARD_BATCH)
+            send(*t);
+    }
+
+    has_pending_.store(true, std::memory_order_relaxed);
+    return action;
+}
+
+bool uvgrtp::forwarder::pending() const
+{
+    return has_pending_.load(std::memory_order_relaxed);
+}
+
+void uvgrtp::forwarder::flush()
+{
+    std::lock_guard<std::mutex> lock(process_mutex_);
+
+    for (auto& t : pending_) {
+        if (!t->packets.empty())
+            send(*t);
+
+        t->queued = false;
+    }
+
+    pending_.clear();
+    has_pending_.store(false, std::memory_order_relaxed);
+}
+
+void uvgrtp::forwarder::send(target& t)
+{
+    if (t.socket->sendto_prepared(t.addr, t.addr6, t.packets, 0, t.arrays, false) != RTP_OK) {
+        UVG_LOG_DEBUG("Failed to forward %zu packets", t.packets.size());
+    }
+
+    t.packets.clear();
+}
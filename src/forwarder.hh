@@ -0,0 +1,111 @@
+#pragma once
+
+#include "socket.hh"
+
+#include "uvgrtp/util.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* How many forwarded packets of a target are sent with one vector send */
+    const size_t MAX_FORWARD_BATCH = 64;
+
+    /* See uvgrtp::media_stream::install_forward_hook() */
+    typedef int (*forward_hook)(void *arg, uint8_t *packet, size_t size);
+
+    /* Forwards the received RTP packets of one stream to the remote participants of other
+     * streams without depacketizing them, see uvgrtp::media_stream::add_forward_target().
+     *
+     * The packets are not copied. Each target gets a 12-byte RTP header of its own with its SSRC and
+     * the sequence number and timestamp of the packet shifted by the offsets of the target, and the
+     * rest of the packet is sent straight from the ring slot it was received to. The packets of a
+     * target are collected and sent with one vector send, and the reception flow keeps the slots of
+     * the waiting packets from being reused until flush() has sent them.
+     *
+     * forward() and flush() are called by the packet processing, the threads of a sharded socket
+     * share the forwarder of the stream under "process_mutex_" */
+    class forwarder {
+        public:
+            forwarder();
+            ~forwarder();
+
+            /* Forward the packets to "addr"/"addr6" from "socket" with the SSRC in "ssrc". The first
+             * forwarded packet gets sequence number "seq" and timestamp "ts", the rest keep their
+             * distance to it. "key" identifies the target, adding a target with the key of an earlier
+             * one replaces it */
+            void add_target(const void *key, std::shared_ptr<uvgrtp::socket> socket,
+                const sockaddr_in& addr, const sockaddr_in6& addr6,
+                std::shared_ptr<std::atomic<uint32_t>> ssrc, uint16_t seq, uint32_t ts);
+
+            /* Return RTP_OK on success
+             * Return RTP_NOT_FOUND if there is no target with "key" */
+            rtp_error_t remove_target(const void *key);
+
+            /* Give the packets to "hook" before forwarding them, nullptr removes the hook */
+            void set_hook(void *arg, forward_hook hook);
+
+            /* Called by the packet processing: run the hook and queue the RTP packet "packet" of "size"
+             * bytes to the targets. The packet must stay in place until pending() is false
+             *
+             * Return the RTP_FORWARD flags of what should be done with the packet. RTP_FORWARD_SEND
+             * is only returned if the packet was queued to at least one target. Without targets and
+             * a hook the packet is only delivered */
+            int forward(uint8_t *packet, size_t size);
+
+            /* Whether queued packets wait for flush() */
+            bool pending() const;
+
+            /* Send the queued packets of all targets */
+            void flush();
+
+        private:
+            struct target {
+                const void *key = nullptr;
+                std::shared_ptr<uvgrtp::socket> socket;
+                sockaddr_in addr = {};
+                sockaddr_in6 addr6 = {};
+                std::shared_ptr<std::atomic<uint32_t>> ssrc;
+                uint16_t first_seq = 0;
+                uint32_t first_ts = 0;
+
+                /* Set by the packet processing once the offsets have been taken from the first packet */
+                bool started = false;
+                uint16_t seq_offset = 0;
+                uint32_t ts_offset = 0;
+
+                /* Whether the target is in "pending_" */
+                bool queued = false;
+
+                /* The rewritten RTP headers of the queued packets, RTP_HDR_SIZE bytes each */
+                std::vector<uint8_t> headers;
+                uvgrtp::pkt_vec packets;
+                uvgrtp::send_arrays arrays;
+            };
+
+            struct hook_entry {
+                void *arg;
+                forward_hook hook;
+            };
+
+            /* Called with "process_mutex_" held */
+            void send(target& t);
+
+            /* Immutable list that add_target() and remove_target() replace under "targets_mutex_" */
+            std::shared_ptr<const std::vector<std::shared_ptr<target>>> targets_;
+            std::mutex targets_mutex_;
+
+            std::shared_ptr<const hook_entry> hook_;
+
+            /* The targets with queued packets, kept alive until they have been sent */
+            std::vector<std::shared_ptr<target>> pending_;
+            std::atomic<bool> has_pending_;
+            std::mutex process_mutex_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -2,14 +2,190 @@
 
 #include "uvgrtp/util.hh"
 
+#include "frame_pool.hh"
 #include "debug.hh"
 
 #include <cstring>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <new>
 
+/* Payload size classes are powers of two from 256 bytes to 8 MB. Larger payloads
+ * bypass the pool. Every payload buffer starts with a prefix holding its size class
+ * and the prefix is 16 bytes long to keep the payload suitably aligned */
+constexpr size_t MIN_CLASS_SHIFT     = 8;
+constexpr size_t PAYLOAD_CLASSES     = 16;
+constexpr uint32_t NO_CLASS          = UINT32_MAX;
+constexpr size_t PAYLOAD_PREFIX_SIZE = 16;
+
+/* How many released objects are kept per class if reserve() has not asked for more */
+constexpr size_t DEFAULT_POOL_LIMIT = 64;
+
+namespace {
+    struct object_cache {
+        std::mutex mtx;
+        std::vector<void *> free;
+        size_t limit = DEFAULT_POOL_LIMIT;
+    };
+
+    struct pool {
+        object_cache frames;
+        object_cache payloads[PAYLOAD_CLASSES];
+    };
+
+    /* The pool is never destroyed, because the application may release
+     * frames during static destruction */
+    pool& get_pool()
+    {
+        static pool *p = new pool();
+        return *p;
+    }
+
+    uint32_t size_class(size_t len)
+    {
+        for (uint32_t c = 0; c < PAYLOAD_CLASSES; ++c) {
+            if (len <= ((size_t)1 << (c + MIN_CLASS_SHIFT)))
+                return c;
+        }
+        return NO_CLASS;
+    }
+
+    void *take(object_cache& cache)
+    {
+        std::lock_guard<std::mutex> lg(cache.mtx);
+
+        if (cache.free.empty())
+            return nullptr;
+
+        void *object = cache.free.back();
+        cache.free.pop_back();
+        return object;
+    }
+
+    /* Return false if the cache is full and the object has to be released */
+    bool give(object_cache& cache, void *object)
+    {
+        std::lock_guard<std::mutex> lg(cache.mtx);
+
+        if (cache.free.size() >= cache.limit)
+            return false;
+
+        cache.free.push_back(object);
+        return true;
+    }
+
+    void raise_limit(object_cache& cache, size_t limit)
+    {
+        std::lock_guard<std::mutex> lg(cache.mtx);
+        cache.limit = std::max(cache.limit, limit);
+    }
+
+    /* Allocate objects of "size" bytes until "count" of them are free. The payload buffers
+     * are released with delete[] and the frame objects with operator delete, so they are
+     * allocated the same way */
+    void fill(object_cache& cache, size_t count, size_t size, bool array)
+    {
+        std::lock_guard<std::mutex> lg(cache.mtx);
+
+        cache.free.reserve(count);
+        while (cache.free.size() < count) {
+            cache.free.push_back(array ? (void *)new uint8_t[size] : ::operator new(size));
+        }
+    }
+}
+
+void uvgrtp::frame_pool::reserve(size_t frames, size_t payload_size)
+{
+    pool& p = get_pool();
+
+    raise_limit(p.frames, frames);
+
+    uint32_t c = size_class(payload_size);
+    if (c != NO_CLASS)
+        raise_limit(p.payloads[c], frames);
+}
+
+void uvgrtp::frame_pool::preallocate(size_t frames, size_t payload_size)
+{
+    pool& p = get_pool();
+
+    raise_limit(p.frames, frames);
+    fill(p.frames, frames, sizeof(uvgrtp::frame::rtp_frame), false);
+
+    uint32_t c = size_class(payload_size);
+    if (c != NO_CLASS) {
+        raise_limit(p.payloads[c], frames);
+        fill(p.payloads[c], frames, PAYLOAD_PREFIX_SIZE + ((size_t)1 << (c + MIN_CLASS_SHIFT)), true);
+    }
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::frame_pool::alloc_frame()
+{
+    void *mem = take(get_pool().frames);
+
+    if (!mem)
+        return new uvgrtp::frame::rtp_frame;
+
+    return new (mem) uvgrtp::frame::rtp_frame;
+}
+
+void uvgrtp::frame_pool::free_frame(uvgrtp::frame::rtp_frame *frame)
+{
+    if (!frame)
+        return;
+
+    frame->~rtp_frame();
+
+    if (!give(get_pool().frames, frame))
+        ::operator delete(frame);
+}
+
+uint8_t *uvgrtp::frame_pool::alloc_payload(size_t len)
+{
+    uint32_t c = size_class(len);
+    uint8_t *mem = nullptr;
+
+    if (c != NO_CLASS) {
+        mem = (uint8_t *)take(get_pool().payloads[c]);
+        len = (size_t)1 << (c + MIN_CLASS_SHIFT);
+    }
+
+    if (!mem)
+        mem = new uint8_t[PAYLOAD_PREFIX_SIZE + len];
+
+    std::memcpy(mem, &c, sizeof(c));
+    return mem + PAYLOAD_PREFIX_SIZE;
+}
+
+void uvgrtp::frame_pool::free_payload(uint8_t *payload)
+{
+    if (!payload)
+        return;
+
+    uint8_t *mem = payload - PAYLOAD_PREFIX_SIZE;
+    uint32_t c = NO_CLASS;
+    std::memcpy(&c, mem, sizeof(c));
+
+    if (c == NO_CLASS || !give(get_pool().payloads[c], mem))
+        delete[] mem;
+}
+
+void uvgrtp::frame_pool::release_payload(uvgrtp::frame::rtp_frame *frame)
+{
+    if (frame->dgram_owned) {
+        free_payload(frame->dgram);
+        frame->dgram       = nullptr;
+        frame->dgram_owned = false;
+    } else {
+        free_payload(frame->payload);
+    }
+    frame->payload = nullptr;
+}
 
 uvgrtp::frame::rtp_frame *uvgrtp::frame::alloc_rtp_frame()
 {
-    uvgrtp::frame::rtp_frame *frame = new uvgrtp::frame::rtp_frame;
+    uvgrtp::frame::rtp_frame *frame = uvgrtp::frame_pool::alloc_frame();
 
     frame->header.version   = 0;
     frame->header.padding   = 0;
@@ -33,7 +209,7 @@ uvgrtp::frame::rtp_frame *uvgrtp::frame::alloc_rtp_frame(size_t payload_len)
     if ((frame = uvgrtp::frame::alloc_rtp_frame()) == nullptr)
         return nullptr;
 
-    frame->payload     = new uint8_t[payload_len];
+    frame->payload     = uvgrtp::frame_pool::alloc_payload(payload_len);
     frame->payload_len = payload_len;
 
     return frame;
@@ -52,12 +228,11 @@ rtp_error_t uvgrtp::frame::dealloc_frame(uvgrtp::frame::rtp_frame *frame)
         delete frame->ext;
     }
 
-    else if (frame->payload)
-        delete[] frame->payload;
+    uvgrtp::frame_pool::release_payload(frame);
 
     //UVG_LOG_DEBUG("Deallocating frame, type %u", frame->type);
 
-    delete frame;
+    uvgrtp::frame_pool::free_frame(frame);
     return RTP_OK;
 }
 
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "uvgrtp/frame.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace uvgrtp {
+
+    /* Recycles the rtp_frame objects and payload buffers of received frames so that the
+     * processing thread does not have to go to the system allocator for every packet,
+     * and so that it does not contend with the application threads that release the
+     * frames with uvgrtp::frame::dealloc_frame().
+     *
+     * Payload buffers are kept in power-of-two size classes. Each buffer has a small
+     * hidden prefix telling its size class, so a payload allocated with alloc_payload()
+     * must only be released with free_payload(). Released objects are kept for reuse
+     * up to a limit per class and anything above that is returned to the system. */
+    namespace frame_pool {
+
+        /* Make room in the pool for "frames" frames with payloads of "payload_size" bytes.
+         * Called by reception_flow so that the pool follows the ring buffer size and MTU */
+        void reserve(size_t frames, size_t payload_size);
+
+        /* reserve() and fill the pool up to "frames" frames and payloads of "payload_size" bytes
+         * right away, so that the first frames of a stream do not go to the system allocator */
+        void preallocate(size_t frames, size_t payload_size);
+
+        /* Get a zero-initialized frame object without payload */
+        uvgrtp::frame::rtp_frame *alloc_frame();
+        void free_frame(uvgrtp::frame::rtp_frame *frame);
+
+        /* Get a payload buffer of at least "len" bytes */
+        uint8_t *alloc_payload(size_t len);
+        void free_payload(uint8_t *payload);
+
+        /* Release the payload of "frame". If the payload points into the datagram of the
+         * frame ("dgram_owned"), the datagram buffer is released instead */
+        void release_payload(uvgrtp::frame::rtp_frame *frame);
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -1,14 +1,17 @@
 #include "frame_queue.hh"
 
-#include "formats/h264.hh"
-#include "formats/h265.hh"
-#include "formats/h266.hh"
-
 #include "rtp.hh"
+#include "path_mtu.hh"
+#include "uvgrtp/clock.hh"
 #include "srtp/base.hh"
+#include "srtp/srtp.hh"
 
 #include "random.hh"
+#include "stream_metrics.hh"
+#include "trace.hh"
 #include "debug.hh"
+
+#include <algorithm>
 #include <thread>
 
 #ifdef _WIN32
@@ -23,20 +26,44 @@
 #include <cstring>
 #endif
 
+/* The share of a path shrinks by PATH_DECREASE when more than PATH_HIGH_LOSS of its packets are lost
+ * or its delay is PATH_QUEUE_DELAY_US over the lowest delay it has had, and grows back by PATH_INCREASE
+ * otherwise. The feedback of a path is judged once it covers PATH_FEEDBACK_PACKETS packets. A path
+ * keeps PATH_MIN_SHARE of the weights, so that its feedback tells when it has recovered */
+constexpr double   PATH_DECREASE         = 0.85;
+constexpr double   PATH_INCREASE         = 1.05;
+constexpr double   PATH_HIGH_LOSS        = 0.10;
+constexpr int64_t  PATH_QUEUE_DELAY_US   = 50000;
+constexpr uint32_t PATH_FEEDBACK_PACKETS = 20;
+constexpr double   PATH_MIN_SHARE        = 0.05;
 
 uvgrtp::frame_queue::frame_queue(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int rce_flags):
     active_(nullptr),
+    pool_(),
     dealloc_hook_(nullptr),
     max_mcount_(MAX_MSG_COUNT),
     max_ccount_(MAX_CHUNK_COUNT* max_mcount_),
     rtp_(rtp), 
     socket_(socket),
     rce_flags_(rce_flags),
+    fragment_kernel_(nullptr),
+    auth_tag_len_((rce_flags & RCE_SRTP_AUTHENTICATE_RTP) ? uvgrtp::srtp_auth_tag_length(rce_flags) : 0),
     fps_(false),
     frame_interval_(),
     fps_sync_point_(),
     frames_since_sync_(0)
-{}
+{
+    // encryption needs the payload in one buffer, so the fragments are copied
+    const bool copy = (rce_flags & RCE_SRTP) && !(rce_flags & RCE_SRTP_NULL_CIPHER);
+
+    if (copy) {
+        fragment_kernel_ = auth_tag_len_ ? &frame_queue::fragment_kernel<true, true>
+                                         : &frame_queue::fragment_kernel<true, false>;
+    } else {
+        fragment_kernel_ = auth_tag_len_ ? &frame_queue::fragment_kernel<false, true>
+                                         : &frame_queue::fragment_kernel<false, false>;
+    }
+}
 
 uvgrtp::frame_queue::~frame_queue()
 {
@@ -44,6 +71,38 @@ uvgrtp::frame_queue::~frame_queue()
     {
         (void)deinit_transaction();
     }
+
+    for (auto& transaction : pool_)
+    {
+        free_transaction(transaction);
+    }
+    pool_.clear();
+}
+
+uvgrtp::transaction_t *uvgrtp::frame_queue::create_transaction()
+{
+    transaction_t *transaction = new transaction_t;
+
+    transaction->header_stride = header_stride_;
+    transaction->rtp_headers   = new uint8_t[header_stride_ * max_mcount_];
+
+    if (auth_tag_len_)
+        transaction->rtp_auth_tags = new uint8_t[auth_tag_len_ * max_mcount_];
+    else
+        transaction->rtp_auth_tags = nullptr;
+
+    return transaction;
+}
+
+void uvgrtp::frame_queue::free_transaction(transaction_t *transaction)
+{
+    if (transaction->rtp_headers)
+        delete[] transaction->rtp_headers;
+
+    if (transaction->rtp_auth_tags)
+        delete[] transaction->rtp_auth_tags;
+
+    delete transaction;
 }
 
 rtp_error_t uvgrtp::frame_queue::init_transaction()
@@ -53,50 +112,45 @@ rtp_error_t uvgrtp::frame_queue::init_transaction()
         (void)deinit_transaction();
     }
 
-    active_      = new transaction_t;
-
-#ifndef _WIN32
-    active_->headers     = new struct mmsghdr[max_mcount_];
-    active_->chunks      = new struct iovec[max_ccount_];
-#else
-    active_->headers     = nullptr;
-    active_->chunks      = nullptr;
-#endif
-    active_->rtp_headers = new uvgrtp::frame::rtp_header[max_mcount_];
-
-    switch (rtp_->get_payload()) {
-        case RTP_FORMAT_H264:
-            active_->media_headers = new uvgrtp::formats::h264_headers;
-            break;
-
-        case RTP_FORMAT_H265:
-            active_->media_headers = new uvgrtp::formats::h265_headers;
-            break;
+    // the stages of the frame are timed if it is sampled, see RCC_PROFILE_SAMPLING
+    profiled_ = metrics_ && metrics_->sample(uvgrtp::stream_metrics::PROFILE_SEND);
+    if (profiled_) {
+        profile_start_ = std::chrono::steady_clock::now();
+        fanout_time_   = std::chrono::nanoseconds(0);
+    }
 
-        case RTP_FORMAT_H266:
-            active_->media_headers = new uvgrtp::formats::h266_headers;
-            break;
+    // the payload size only changes between frames
+    if (std::shared_ptr<uvgrtp::path_mtu> path_mtu = std::atomic_load(&path_mtu_))
+        path_mtu->update(*rtp_);
 
+    if (!pool_.empty()) {
+        active_ = pool_.back();
+        pool_.pop_back();
 
-        default:
-            break;
+        // the header extension of the stream has changed since the transaction was made
+        if (active_->header_stride != header_stride_) {
+            free_transaction(active_);
+            active_ = create_transaction();
+        }
+    } else {
+        active_ = create_transaction();
     }
 
     active_->hdr_ptr     = 0;
     active_->rtphdr_ptr  = 0;
     active_->rtpauth_ptr = 0;
 
+    active_->blocks_used  = 0;
+    active_->block_offset = 0;
+
     active_->data_raw     = nullptr;
     active_->data_smart   = nullptr;
     active_->dealloc_hook = dealloc_hook_;
 
-    if (rce_flags_ & RCE_SRTP_AUTHENTICATE_RTP)
-        active_->rtp_auth_tags = new uint8_t[10 * max_mcount_];
-    else
-        active_->rtp_auth_tags = nullptr;
+    frame_marking_[0] = 0;
+    frame_marking_[1] = 0;
 
     rtp_->fill_header((uint8_t *)&active_->rtp_common);
-    active_->buffers.clear();
 
     return RTP_OK;
 }
@@ -133,6 +187,12 @@ rtp_error_t uvgrtp::frame_queue::init_transaction(std::unique_ptr<uint8_t[]> dat
     return RTP_OK;
 }
 
+void uvgrtp::frame_queue::set_timestamp(uint32_t timestamp)
+{
+    if (active_)
+        active_->rtp_common.timestamp = htonl(timestamp);
+}
+
 rtp_error_t uvgrtp::frame_queue::deinit_transaction()
 {
     if (active_ == nullptr) {
@@ -140,47 +200,25 @@ rtp_error_t uvgrtp::frame_queue::deinit_transaction()
         return RTP_INVALID_VALUE;
     }
 
-    if (active_->headers)
-        delete[] active_->headers;
-
-    if (active_->chunks)
-        delete[] active_->chunks;
-
-    if (active_->rtp_headers)
-        delete[] active_->rtp_headers;
-
-    if (active_->rtp_auth_tags)
-        delete[] active_->rtp_auth_tags;
-
-    active_->headers = nullptr;
-    active_->chunks = nullptr;
-    active_->rtp_headers = nullptr;
-    active_->rtp_auth_tags = nullptr;
-
-    if (active_->media_headers)
-    {
-        switch (rtp_->get_payload()) {
-        case RTP_FORMAT_H264:
-            delete (uvgrtp::formats::h264_headers*)active_->media_headers;
-            active_->media_headers = nullptr;
-            break;
+    // the packets of a frame that could not be sent must not be reported as lost
+    if (twcc_) {
+        twcc_->discard_unsent();
+    }
 
-        case RTP_FORMAT_H265:
-            delete (uvgrtp::formats::h265_headers*)active_->media_headers;
-            active_->media_headers = nullptr;
-            break;
+    // keep the packet buffer vectors and their capacity for the next frame
+    for (auto& packet : active_->packets) {
+        active_->spare_packets.push_back(std::move(packet));
+    }
+    active_->packets.clear();
 
-        case RTP_FORMAT_H266:
-            delete (uvgrtp::formats::h266_headers*)active_->media_headers;
-            active_->media_headers = nullptr;
-            break;
+    active_->data_smart = nullptr;
+    active_->data_raw   = nullptr;
 
-        default:
-            break;
-        }
+    if (pool_.size() < TRANSACTION_POOL_SIZE) {
+        pool_.push_back(active_);
+    } else {
+        free_transaction(active_);
     }
-
-    delete active_;
     active_ = nullptr;
 
     return RTP_OK;
@@ -194,25 +232,20 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(uint8_t *message, size_t messag
       return RTP_INVALID_VALUE;
     }
 
-    /* Create buffer vector where the full packet is constructed
-     * and which is then pushed to "active_"'s pkt_vec structure */
-    uvgrtp::buf_vec tmp;
+    if (active_->rtphdr_ptr >= (size_t)max_mcount_) {
+        UVG_LOG_ERROR("Too many packets in one frame, at most %zd are supported", max_mcount_);
+        return RTP_MEMORY_ERROR;
+    }
 
-    /* update the RTP header at "rtpheaders_ptr_" */
-    update_rtp_header();
+    /* The RTP header is the first buffer of the packet */
+    uvgrtp::buf_vec& packet = begin_packet();
 
     if (set_m_bit)
-        ((uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr])[1] |= (1 << 7);
+        header_slot(active_->rtphdr_ptr - 1)[1] |= (1 << 7);
 
-    /* Push RTP header first and then push all payload buffers */
-    tmp.push_back({
-        sizeof(active_->rtp_headers[active_->rtphdr_ptr]),
-        (uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr++]
-    });
+    packet.push_back({ message_len, message });
 
-    tmp.push_back({ message_len, message });
-
-    enqueue_finalize(tmp);
+    end_packet(packet);
     return RTP_OK;
 }
 
@@ -222,6 +255,11 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(uint8_t *message, size_t messag
 }
 
 rtp_error_t uvgrtp::frame_queue::enqueue_message(buf_vec& buffers)
+{
+    return enqueue_message(buffers, false);
+}
+
+rtp_error_t uvgrtp::frame_queue::enqueue_message(buf_vec& buffers, bool set_m_bit)
 {
     if (!buffers.size())
     {
@@ -229,16 +267,13 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(buf_vec& buffers)
         return RTP_INVALID_VALUE;
     }
 
-    /* update the RTP header at "rtpheaders_ptr_" */
-    update_rtp_header();
-
-    /* Create buffer vector where the full packet is constructed
-     * and which is then pushed to "active_"'s pkt_vec structure */
-    uvgrtp::buf_vec tmp;
+    if (active_->rtphdr_ptr >= (size_t)max_mcount_) {
+        UVG_LOG_ERROR("Too many packets in one frame, at most %zd are supported", max_mcount_);
+        return RTP_MEMORY_ERROR;
+    }
 
-    /* Push RTP header first and then push all payload buffers */
-    tmp.push_back({     sizeof(active_->rtp_headers[active_->rtphdr_ptr]), 
-                   (uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr++]});
+    /* The RTP header is the first buffer of the packet, then all payload buffers */
+    uvgrtp::buf_vec& tmp = begin_packet();
 
     /* If SRTP with proper encryption is used and there are more than one buffer,
      * frame queue must be a copy of the input and ... */
@@ -250,9 +285,13 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(buf_vec& buffers)
             total += buffer.first;
         }
 
-        uint8_t* mem = new uint8_t[total];
+        uint8_t* mem = alloc_memory(total);
         uint8_t* ptr = mem;
 
+        if (!mem) {
+            return RTP_MEMORY_ERROR;
+        }
+
         // copy buffers to a single pointer
         for (auto& buffer : buffers) {
             memcpy(ptr, buffer.second, buffer.first);
@@ -267,7 +306,60 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(buf_vec& buffers)
         }
     }
 
-    enqueue_finalize(tmp);
+    if (set_m_bit)
+        header_slot(active_->rtphdr_ptr - 1)[1] |= (1 << 7);
+
+    end_packet(tmp);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::frame_queue::enqueue_fragments(uint8_t *headers, size_t header_size,
+    uint8_t *data, size_t data_len, size_t fragment_size)
+{
+    if (!headers || !data || data_len == 0 || fragment_size == 0)
+    {
+        UVG_LOG_ERROR("Tried to enqueue invalid fragments");
+        return RTP_INVALID_VALUE;
+    }
+
+    const size_t count = (data_len + fragment_size - 1) / fragment_size;
+
+    if (active_->rtphdr_ptr + count > (size_t)max_mcount_) {
+        UVG_LOG_ERROR("Too many packets in one frame, at most %zd are supported", max_mcount_);
+        return RTP_MEMORY_ERROR;
+    }
+
+    return (this->*fragment_kernel_)(headers, header_size, data, data_len, fragment_size, count);
+}
+
+template <bool Copy, bool Authenticate>
+rtp_error_t uvgrtp::frame_queue::fragment_kernel(uint8_t *headers, size_t header_size,
+    uint8_t *data, size_t data_len, size_t fragment_size, size_t count)
+{
+    size_t pos = 0;
+
+    for (size_t i = 0; i < count; ++i, pos += fragment_size) {
+        const size_t len    = std::min(fragment_size, data_len - pos);
+        uint8_t     *header = headers + header_size * ((i == 0) ? 0 : (i + 1 == count) ? 2 : 1);
+
+        uvgrtp::buf_vec& packet = begin_packet();
+
+        if (Copy) {
+            uint8_t *mem = alloc_memory(header_size + len);
+            if (!mem)
+                return RTP_MEMORY_ERROR;
+
+            std::memcpy(mem, header, header_size);
+            std::memcpy(mem + header_size, data + pos, len);
+            packet.push_back({ header_size + len, mem });
+        } else {
+            packet.push_back({ header_size, header });
+            packet.push_back({ len, data + pos });
+        }
+
+        finish_packet<Authenticate>(packet);
+    }
+
     return RTP_OK;
 }
 
@@ -281,8 +373,19 @@ rtp_error_t uvgrtp::frame_queue::flush_queue(sockaddr_in& addr, sockaddr_in6& ad
 
     /* set the marker bit of the last packet to 1 */
     if (active_->packets.size() > 1)
-        ((uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr - 1])[1] |= (1 << 7);
+        header_slot(active_->rtphdr_ptr - 1)[1] |= (1 << 7);
+
+    if (size_t offset = extensions_.offset(uvgrtp::EXT_FRAME_MARKING))
+        header_slot(active_->rtphdr_ptr - 1)[RTP_HDR_SIZE + offset] |= uvgrtp::FRAME_MARKING_END;
     
+    if (fec_payload_type_ && add_fec_packets() != RTP_OK) {
+        (void)deinit_transaction();
+        return RTP_MEMORY_ERROR;
+    }
+
+    if (profiled_)
+        metrics_->record_stage(uvgrtp::stream_metrics::STAGE_PACKETIZE_NS, profile_start_);
+
     std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
 
     if ((rce_flags_ & RCE_FRAME_RATE) && fps_)
@@ -324,43 +427,874 @@ rtp_error_t uvgrtp::frame_queue::flush_queue(sockaddr_in& addr, sockaddr_in6& ad
                 // if nothing is wrong, wait until it is time to send this frame
                 std::this_thread::sleep_for(wait_time);
             }
-            now = std::chrono::high_resolution_clock::now(); // update now in case we are using fragment pacing
         }
 
         ++frames_since_sync_;
     }
 
-    if ((rce_flags_ & RCE_PACE_FRAGMENT_SENDING) && fps_ && !force_sync_)
-    {
-        // allocate 80% of frame interval for pacing, rest for other processing
-        std::chrono::nanoseconds packet_interval = 8*frame_interval_/(10*active_->packets.size());
+    /* force_sync_ is only cleared by the frame rate synchronization above, so
+     * without RCE_FRAME_RATE it must not keep the frames from being paced */
+    bool syncing = force_sync_ && (rce_flags_ & RCE_FRAME_RATE);
 
-        for (size_t i = 0; i < active_->packets.size(); ++i)
-        {
-            std::chrono::high_resolution_clock::time_point next_packet = now + i * packet_interval;
+    // the paths of a multipath stream have queues of their own, so their packets are not paced
+    std::shared_ptr<const std::vector<uvgrtp::send_path>> paths = std::atomic_load(&paths_);
 
-            // sleep until next packet time
-            std::this_thread::sleep_for(next_packet - std::chrono::high_resolution_clock::now());
+    bool paced = (rce_flags_ & RCE_PACE_FRAGMENT_SENDING) && fps_ && !syncing && !paths;
+    rtp_error_t ret = RTP_OK;
 
-            //  send pkt vects
-            if (socket_->sendto(addr, addr6, active_->packets[i], 0) != RTP_OK) {
-                UVG_LOG_ERROR("Failed to send packet: %li", errno);
-                (void)deinit_transaction();
-                return RTP_SEND_ERROR;
-            }
+    /* The send times of the packets are not known exactly, so congestion control takes
+     * them from the pacing schedule. Unpaced packets are sent back to back */
+    std::chrono::steady_clock::time_point send_start = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds spacing = std::chrono::nanoseconds(0);
+    if (paced)
+        spacing = 8*frame_interval_/10 / (int64_t)active_->packets.size();
+
+    if (extensions_.offset(uvgrtp::EXT_ABS_SEND_TIME))
+        write_send_times(spacing);
+
+    std::shared_ptr<const std::vector<uvgrtp::fanout_destination>> destinations = cache_frame();
+
+    // the destinations with SRTP contexts of their own encrypt copies of the packets, so they are sent
+    // before the stream encrypts the packets in place
+    (void)send_fanout(destinations.get(), true);
+
+    if (paced)
+        UVG_TRACE(PACING_START, ntohl(active_->rtp_common.ssrc), ntohl(active_->rtp_common.timestamp), active_->packets.size());
+
+    if (paced && (rce_flags_ & RCE_PACE_KERNEL))
+    {
+        // if the kernel cannot pace the frame, it is paced in user space below
+        if ((ret = send_kernel_paced(addr, addr6)) == RTP_OK) {
+            (void)send_fanout(destinations.get(), false);
+            packets_sent(addr, addr6, send_start, spacing);
+            UVG_TRACE(FRAME_SENT, ntohl(active_->rtp_common.ssrc), ntohl(active_->rtp_common.timestamp), active_->packets.size());
+            return deinit_transaction();
         }
 
+        if (ret != RTP_NOT_SUPPORTED) {
+            UVG_LOG_ERROR("Failed to send kernel paced packets: %li", errno);
+            send_failed();
+            (void)deinit_transaction();
+            return RTP_SEND_ERROR;
+        }
+    }
+
+    if (paced && pacer_ && defer_pacing_)
+    {
+        // the frame is finished by finish_pacing() once the pacer has sent it
+        deferred_addr_         = addr;
+        deferred_addr6_        = addr6;
+        deferred_start_        = send_start;
+        deferred_spacing_      = spacing;
+        deferred_destinations_ = destinations;
+        deferred_              = true;
+
+        pacer_->start(deferred_job_, pacing_, socket_, deferred_addr_, deferred_addr6_, active_->packets,
+            active_->send_arrays, 8*frame_interval_/10);
+        return RTP_OK;
+    }
+
+    if (profiled_ && !(paced && pacer_))
+        profile_start_ = std::chrono::steady_clock::now();
+
+    if (paths)
+    {
+        if (send_paths(paths) != RTP_OK) {
+            UVG_LOG_ERROR("Failed to send the packets over the paths: %li", errno);
+            send_failed();
+            (void)deinit_transaction();
+            return RTP_SEND_ERROR;
+        }
+    }
+    else if (paced && pacer_)
+    {
+        // allocate 80% of frame interval for pacing, rest for other processing
+        if (pacer_->send(pacing_, socket_, addr, addr6, active_->packets, active_->send_arrays,
+                8*frame_interval_/10) != RTP_OK) {
+            UVG_LOG_ERROR("Failed to send paced packets: %li", errno);
+            send_failed();
+            (void)deinit_transaction();
+            return RTP_SEND_ERROR;
+        }
+    }
+    else if ((rce_flags_ & RCE_UDP_GSO) && active_->packets.size() > 1) {
+        if (socket_->sendto_gso(addr, addr6, active_->packets, 0, active_->send_arrays) != RTP_OK) {
+            UVG_LOG_ERROR("Failed to flush the message queue: %li", errno);
+            send_failed();
+            (void)deinit_transaction();
+            return RTP_SEND_ERROR;
+        }
     }
-    else if (socket_->sendto(addr, addr6, active_->packets, 0) != RTP_OK) {
+    else if (socket_->sendto(addr, addr6, active_->packets, 0, active_->send_arrays) != RTP_OK) {
         UVG_LOG_ERROR("Failed to flush the message queue: %li", errno);
+        send_failed();
         (void)deinit_transaction();
         return RTP_SEND_ERROR;
     }
 
-    //UVG_LOG_DEBUG("full message took %zu chunks and %zu messages", active_->chunk_ptr, active_->hdr_ptr);
+    if (profiled_ && !(paced && pacer_))
+        metrics_->record_stage(uvgrtp::stream_metrics::STAGE_SEND_NS, profile_start_);
+
+    (void)send_fanout(destinations.get(), false);
+    packets_sent(addr, addr6, send_start, (paced && pacer_) ? spacing : std::chrono::nanoseconds(0));
+    UVG_TRACE(FRAME_SENT, ntohl(active_->rtp_common.ssrc), ntohl(active_->rtp_common.timestamp), active_->packets.size());
     return deinit_transaction();
 }
 
+rtp_error_t uvgrtp::frame_queue::finish_pacing()
+{
+    if (!deferred_)
+        return RTP_OK;
+
+    deferred_ = false;
+    std::shared_ptr<const std::vector<uvgrtp::fanout_destination>> destinations = std::move(deferred_destinations_);
+
+    if (pacer_->wait(deferred_job_) != RTP_OK) {
+        UVG_LOG_ERROR("Failed to send paced packets: %li", errno);
+        send_failed();
+        (void)deinit_transaction();
+        return RTP_SEND_ERROR;
+    }
+
+    (void)send_fanout(destinations.get(), false);
+    packets_sent(deferred_addr_, deferred_addr6_, deferred_start_, deferred_spacing_);
+    UVG_TRACE(FRAME_SENT, ntohl(active_->rtp_common.ssrc), ntohl(active_->rtp_common.timestamp), active_->packets.size());
+    return deinit_transaction();
+}
+
+bool uvgrtp::frame_queue::single_supported(size_t len) const
+{
+    if (std::shared_ptr<uvgrtp::path_mtu> path_mtu = std::atomic_load(&path_mtu_))
+        path_mtu->update(*rtp_);
+
+    if (len == 0 || len > rtp_->get_payload_size())
+        return false;
+
+    if (fec_payload_type_ || twcc_ || history_)
+        return false;
+
+    if (rce_flags_ & (RCE_FRAME_RATE | RCE_PACE_FRAGMENT_SENDING))
+        return false;
+
+    if (gop_caching())
+        return false;
+
+    if (std::atomic_load(&paths_))
+        return false;
+
+    std::shared_ptr<const std::vector<uvgrtp::fanout_destination>> destinations = std::atomic_load(&fanout_);
+    return !destinations || destinations->empty();
+}
+
+uvgrtp::buf_vec& uvgrtp::frame_queue::prepare_single(uint8_t *data, size_t len, bool marker)
+{
+    rtp_->fill_header(single_header_);
+
+    if (marker)
+        single_header_[1] |= (1 << 7);
+
+    size_t header_len = RTP_HDR_SIZE;
+
+    if (extensions_.size()) {
+        // a one-packet frame starts and ends in the same packet
+        frame_marking_[0] = 0;
+        frame_marking_[1] = 0;
+        write_extension(single_header_, true);
+
+        if (size_t offset = extensions_.offset(uvgrtp::EXT_FRAME_MARKING))
+            single_header_[RTP_HDR_SIZE + offset] |= uvgrtp::FRAME_MARKING_END;
+
+        if (size_t offset = extensions_.offset(uvgrtp::EXT_ABS_SEND_TIME))
+            uvgrtp::write_abs_send_time(&single_header_[RTP_HDR_SIZE + offset], uvgrtp::clock::ntp::now());
+
+        header_len += extensions_.size();
+    }
+
+    single_packet_.clear();
+    single_packet_.push_back({ header_len, single_header_ });
+    single_packet_.push_back({ len, data });
+
+    if (rce_flags_ & RCE_SRTP_AUTHENTICATE_RTP) {
+        single_tag_.resize(auth_tag_len_);
+        single_packet_.push_back({ single_tag_.size(), single_tag_.data() });
+    }
+
+    rtp_->inc_sequence();
+    rtp_->inc_sent_pkts();
+
+    return single_packet_;
+}
+
+rtp_error_t uvgrtp::frame_queue::push_single(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t len, bool marker)
+{
+    if (socket_->sendto(addr, addr6, prepare_single(data, len, marker), 0) != RTP_OK) {
+        UVG_LOG_ERROR("Failed to send the packet of a frame: %li", errno);
+        send_failed();
+        return RTP_SEND_ERROR;
+    }
+
+    single_sent();
+    return RTP_OK;
+}
+
+void uvgrtp::frame_queue::send_failed()
+{
+    // the datagrams may be larger than the path MTU that the system has learned
+    if (std::shared_ptr<uvgrtp::path_mtu> path_mtu = std::atomic_load(&path_mtu_))
+        path_mtu->invalidate();
+}
+
+void uvgrtp::frame_queue::single_sent()
+{
+    if (metrics_) {
+        metrics_->count(uvgrtp::stream_metrics::SENT_PACKETS);
+        metrics_->record(uvgrtp::stream_metrics::SEND_BATCH_SIZE, 1);
+    }
+
+    if (socket_->timestamping() & RTP_TIMESTAMP_SEND)
+        (void)socket_->read_tx_timestamps();
+
+    UVG_TRACE(FRAME_SENT, ntohl(*(uint32_t *)&single_header_[8]), ntohl(*(uint32_t *)&single_header_[4]), 1);
+}
+
+rtp_error_t uvgrtp::frame_queue::send_kernel_paced(sockaddr_in& addr, sockaddr_in6& addr6)
+{
+    // allocate 80% of frame interval for pacing, rest for other processing
+    std::chrono::nanoseconds window = 8*frame_interval_/10;
+
+    if (socket_->txtime_enabled())
+    {
+        return socket_->sendto_txtime(addr, addr6, active_->packets, 0, active_->send_arrays,
+            window / active_->packets.size());
+    }
+
+    if (!max_pacing_rate_supported_)
+        return RTP_NOT_SUPPORTED;
+
+    uint64_t frame_bytes = 0;
+    for (auto& packet : active_->packets)
+    {
+        for (auto& buffer : packet)
+        {
+            frame_bytes += buffer.first;
+        }
+    }
+
+    uint64_t rate = (uint64_t)((double)frame_bytes / std::chrono::duration<double>(window).count());
+    if (socket_->set_max_pacing_rate(std::max(rate, (uint64_t)1)) != RTP_OK)
+    {
+        UVG_LOG_WARN("SO_MAX_PACING_RATE is not available, pacing in user space instead");
+        max_pacing_rate_supported_ = false;
+        return RTP_NOT_SUPPORTED;
+    }
+
+    return socket_->sendto(addr, addr6, active_->packets, 0, active_->send_arrays);
+}
+
+rtp_error_t uvgrtp::frame_queue::add_fec_packets()
+{
+    // the authentication tag is computed when the packet is sent, so it cannot be protected
+    const size_t tail  = (rce_flags_ & RCE_SRTP_AUTHENTICATE_RTP) ? 1 : 0;
+    const size_t media = active_->packets.size();
+
+    for (size_t start = 0; start < media; start += uvgrtp::FEC_MAX_BLOCK_SIZE) {
+        size_t block   = std::min(uvgrtp::FEC_MAX_BLOCK_SIZE, media - start);
+        size_t repairs = uvgrtp::fec_repair_count(block, fec_overhead_);
+
+        if (active_->rtphdr_ptr + repairs > (size_t)max_mcount_) {
+            UVG_LOG_ERROR("Too many packets in one frame for the repair packets");
+            return RTP_MEMORY_ERROR;
+        }
+
+        for (size_t j = 0; j < repairs; ++j) {
+            size_t size = uvgrtp::FEC_HEADER_SIZE;
+            for (size_t i = j; i < block; i += repairs) {
+                size = std::max(size, uvgrtp::FEC_HEADER_SIZE +
+                    uvgrtp::fec_protected_size(active_->packets[start + i], tail));
+            }
+
+            uint8_t *fec = alloc_memory(size);
+            if (!fec)
+                return RTP_MEMORY_ERROR;
+
+            (void)uvgrtp::write_fec_packet(active_->packets, start + j, block - j, repairs, tail, fec);
+
+            // without the header extension, a repair packet fits in the room reserved by RCC_FEC_PAYLOAD_TYPE
+            uvgrtp::buf_vec& packet = begin_packet(false);
+            header_slot(active_->rtphdr_ptr - 1)[1] = fec_payload_type_ & 0x7f;
+
+            packet.push_back({ size, fec });
+            end_packet(packet);
+        }
+    }
+
+    return RTP_OK;
+}
+
+static bool same_destination(const uvgrtp::fanout_destination& destination, const sockaddr_in& addr,
+    const sockaddr_in6& addr6)
+{
+    return destination.addr.sin_port == addr.sin_port &&
+        destination.addr.sin_addr.s_addr == addr.sin_addr.s_addr &&
+        destination.addr6.sin6_port == addr6.sin6_port &&
+        memcmp(&destination.addr6.sin6_addr, &addr6.sin6_addr, sizeof(addr6.sin6_addr)) == 0;
+}
+
+void uvgrtp::frame_queue::set_paths(std::shared_ptr<const std::vector<uvgrtp::send_path>> paths)
+{
+    std::atomic_store(&paths_, paths);
+}
+
+rtp_error_t uvgrtp::frame_queue::send_paths(const std::shared_ptr<const std::vector<uvgrtp::send_path>>& paths)
+{
+    // the paths start from their weights whenever they change
+    if (paths != state_paths_) {
+        state_paths_ = paths;
+        path_state_.assign(paths->size(), path_state());
+
+        for (size_t i = 0; i < paths->size(); ++i) {
+            path_state_[i].weight = (*paths)[i].weight;
+        }
+    }
+
+    update_path_weights();
+
+    // the packets are protected once by the handlers of the stream, the paths send them as they are
+    rtp_error_t ret = socket_->run_vec_handlers(active_->packets);
+    if (ret != RTP_OK)
+        return ret;
+
+    path_packets_.resize(paths->size());
+    for (auto& packets : path_packets_) {
+        packets.clear();
+    }
+
+    double total = 0;
+    for (auto& state : path_state_) {
+        total += state.weight;
+    }
+
+    size_t twcc_offset = twcc_ ? extensions_.offset(uvgrtp::EXT_TRANSPORT_WIDE_SEQ) : 0;
+
+    for (auto& packet : active_->packets) {
+        // smooth weighted round robin: each path gains its weight and the path with the most credit
+        // gets the packet, which spreads the packets of each path evenly over the frame
+        size_t chosen = 0;
+        for (size_t i = 0; i < path_state_.size(); ++i) {
+            path_state_[i].credit += path_state_[i].weight;
+
+            if (path_state_[i].credit > path_state_[chosen].credit)
+                chosen = i;
+        }
+        path_state_[chosen].credit -= total;
+        path_packets_[chosen].push_back(packet);
+
+        // FEC repair packets have no header extension
+        const uint8_t *header = packet[0].second;
+        if (twcc_offset && (header[0] & 0x10) && packet[0].first >= RTP_HDR_SIZE + twcc_offset + 2) {
+            const uint8_t *seq = header + RTP_HDR_SIZE + twcc_offset;
+            twcc_->set_path((uint16_t)((seq[0] << 8) | seq[1]), (uint8_t)chosen);
+        }
+    }
+
+    size_t used   = 0;
+    size_t failed = 0;
+
+    for (size_t i = 0; i < paths->size(); ++i) {
+        if (path_packets_[i].empty())
+            continue;
+
+        sockaddr_in addr   = (*paths)[i].addr;
+        sockaddr_in6 addr6 = (*paths)[i].addr6;
+        bool gso = (rce_flags_ & RCE_UDP_GSO) && path_packets_[i].size() > 1;
+
+        ++used;
+        if ((*paths)[i].socket->sendto_prepared(addr, addr6, path_packets_[i], 0, active_->send_arrays, gso) != RTP_OK) {
+            // a path that cannot send, f.ex. over an interface that went down, is left the least share
+            UVG_LOG_WARN("Failed to send over the path from %s", (*paths)[i].local_address.c_str());
+            path_state_[i].weight = std::min(path_state_[i].weight, total * PATH_MIN_SHARE);
+            ++failed;
+        }
+    }
+
+    // the frame is sent as long as some path took its share
+    return (failed == used) ? RTP_SEND_ERROR : RTP_OK;
+}
+
+void uvgrtp::frame_queue::update_path_weights()
+{
+    if (!twcc_)
+        return;
+
+    twcc_->take_path_feedback(path_feedback_);
+
+    double configured = 0;
+    for (size_t i = 0; i < path_state_.size(); ++i) {
+        configured += (*state_paths_)[i].weight;
+    }
+
+    for (size_t i = 0; i < path_state_.size() && i < path_feedback_.size(); ++i) {
+        path_state& state = path_state_[i];
+
+        state.feedback.sent         += path_feedback_[i].sent;
+        state.feedback.lost         += path_feedback_[i].lost;
+        state.feedback.delay_sum_us += path_feedback_[i].delay_sum_us;
+        state.feedback.delays       += path_feedback_[i].delays;
+
+        if (state.feedback.sent < PATH_FEEDBACK_PACKETS)
+            continue;
+
+        bool congested = state.feedback.lost > state.feedback.sent * PATH_HIGH_LOSS;
+
+        // the delays include the clock offset, so the path is compared with its own lowest delay
+        if (state.feedback.delays) {
+            int64_t delay_us = state.feedback.delay_sum_us / state.feedback.delays;
+
+            if (state.base_delay_us < 0 || delay_us < state.base_delay_us)
+                state.base_delay_us = delay_us;
+
+            congested = congested || delay_us - state.base_delay_us > PATH_QUEUE_DELAY_US;
+        }
+
+        double weight = (*state_paths_)[i].weight;
+
+        if (congested)
+            state.weight = std::max(state.weight * PATH_DECREASE, std::min(configured * PATH_MIN_SHARE, weight));
+        else
+            state.weight = std::min(state.weight * PATH_INCREASE, weight);
+
+        state.feedback = uvgrtp::twcc_sender::path_feedback();
+    }
+}
+
+rtp_error_t uvgrtp::frame_queue::add_destination(const uvgrtp::fanout_destination& destination)
+{
+    // the headers cannot be changed once the stream has encrypted and authenticated the packets
+    if (destination.ssrc && !destination.srtp && (rce_flags_ & RCE_SRTP)) {
+        UVG_LOG_ERROR("A destination with an SSRC of its own needs its own SRTP context");
+        return RTP_INVALID_VALUE;
+    }
+
+    std::lock_guard<std::mutex> lg(fanout_mutex_);
+
+    std::shared_ptr<std::vector<uvgrtp::fanout_destination>> destinations =
+        std::make_shared<std::vector<uvgrtp::fanout_destination>>();
+    bool replaced = false;
+
+    if (fanout_) {
+        for (auto& existing : *fanout_) {
+            if (!same_destination(existing, destination.addr, destination.addr6))
+                destinations->push_back(existing);
+            else
+                replaced = true;
+        }
+    }
+    destinations->push_back(destination);
+
+    // a destination that replaces an earlier one has already got the frames
+    if (!replaced && gop_caching())
+        return send_gop(destination, destinations);
+
+    store_destinations(destinations);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::frame_queue::remove_destination(const sockaddr_in& addr, const sockaddr_in6& addr6)
+{
+    std::lock_guard<std::mutex> lg(fanout_mutex_);
+
+    if (!fanout_)
+        return RTP_NOT_FOUND;
+
+    std::shared_ptr<std::vector<uvgrtp::fanout_destination>> destinations =
+        std::make_shared<std::vector<uvgrtp::fanout_destination>>();
+
+    for (auto& existing : *fanout_) {
+        if (!same_destination(existing, addr, addr6))
+            destinations->push_back(existing);
+    }
+
+    if (destinations->size() == fanout_->size())
+        return RTP_NOT_FOUND;
+
+    store_destinations(destinations);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::frame_queue::set_destination_layers(const sockaddr_in& addr, const sockaddr_in6& addr6,
+    uint8_t max_tid, uint8_t max_layer_id)
+{
+    std::lock_guard<std::mutex> lg(fanout_mutex_);
+
+    if (!fanout_)
+        return RTP_NOT_FOUND;
+
+    std::shared_ptr<std::vector<uvgrtp::fanout_destination>> destinations =
+        std::make_shared<std::vector<uvgrtp::fanout_destination>>(*fanout_);
+
+    for (auto& destination : *destinations) {
+        if (!same_destination(destination, addr, addr6))
+            continue;
+
+        // leaving out packets changes the sequence numbers, which the protected packets cannot have changed
+        if ((rce_flags_ & RCE_SRTP) && !destination.srtp) {
+            UVG_LOG_ERROR("The layers of a destination can only be limited if it has its own SRTP context");
+            return RTP_INVALID_VALUE;
+        }
+
+        destination.max_temporal_id = max_tid;
+        destination.max_layer_id    = max_layer_id;
+
+        if (!destination.skipped)
+            destination.skipped = std::make_shared<uint16_t>(0);
+
+        store_destinations(destinations);
+        return RTP_OK;
+    }
+
+    return RTP_NOT_FOUND;
+}
+
+void uvgrtp::frame_queue::store_destinations(std::shared_ptr<std::vector<uvgrtp::fanout_destination>> destinations)
+{
+    bool filtering = false;
+
+    for (auto& destination : *destinations) {
+        filtering |= destination.max_temporal_id < uvgrtp::MAX_TEMPORAL_ID ||
+            destination.max_layer_id < uvgrtp::MAX_LAYER_ID;
+    }
+    layer_filtering_.store(filtering, std::memory_order_relaxed);
+
+    if (destinations->empty())
+        std::atomic_store(&fanout_, std::shared_ptr<const std::vector<uvgrtp::fanout_destination>>());
+    else
+        std::atomic_store(&fanout_, std::shared_ptr<const std::vector<uvgrtp::fanout_destination>>(destinations));
+}
+
+void uvgrtp::frame_queue::set_gop_cache(size_t limit)
+{
+    std::lock_guard<std::mutex> lg(gop_mutex_);
+
+    // the frames are cached again from the next key frame
+    gop_.clear();
+    gop_bytes_    = 0;
+    gop_overflow_ = false;
+    gop_limit_.store(limit, std::memory_order_relaxed);
+}
+
+std::shared_ptr<const std::vector<uvgrtp::fanout_destination>> uvgrtp::frame_queue::cache_frame()
+{
+    size_t limit = gop_limit_.load(std::memory_order_relaxed);
+    if (!limit)
+        return std::atomic_load(&fanout_);
+
+    bool key_frame = (frame_marking_[0] & uvgrtp::FRAME_MARKING_INDEPENDENT) != 0;
+
+    std::lock_guard<std::mutex> lg(gop_mutex_);
+
+    if (key_frame) {
+        gop_.clear();
+        gop_bytes_    = 0;
+        gop_overflow_ = false;
+    }
+
+    // the frames before the first key frame cannot be decoded by a new receiver
+    if (!gop_overflow_ && (key_frame || !gop_.empty())) {
+        size_t size = 0;
+
+        for (auto& packet : active_->packets) {
+            for (auto& buffer : packet) {
+                size += buffer.first;
+            }
+        }
+
+        if (gop_bytes_ + size > limit) {
+            UVG_LOG_DEBUG("The GOP does not fit in the GOP cache, it is not cached");
+            gop_.clear();
+            gop_bytes_    = 0;
+            gop_overflow_ = true;
+        } else {
+            std::shared_ptr<uvgrtp::gop_frame> frame = std::make_shared<uvgrtp::gop_frame>();
+
+            frame->number = gop_frames_;
+            frame->data.reserve(size);
+            frame->packets.reserve(active_->packets.size());
+
+            for (auto& packet : active_->packets) {
+                frame->packets.push_back(packet.size());
+
+                for (auto& buffer : packet) {
+                    frame->buffers.push_back(buffer.first);
+                    frame->data.insert(frame->data.end(), buffer.second, buffer.second + buffer.first);
+                }
+            }
+
+            gop_.push_back(frame);
+            gop_bytes_ += size;
+        }
+    }
+    ++gop_frames_;
+
+    return std::atomic_load(&fanout_);
+}
+
+rtp_error_t uvgrtp::frame_queue::send_gop(const uvgrtp::fanout_destination& destination,
+    std::shared_ptr<std::vector<uvgrtp::fanout_destination>> destinations)
+{
+    // the cached packets have not been protected, and only a context of its own can protect them
+    if ((rce_flags_ & RCE_SRTP) && !destination.srtp) {
+        UVG_LOG_DEBUG("The GOP cache is only sent to the SRTP destinations with a context of their own");
+        store_destinations(destinations);
+        return RTP_OK;
+    }
+
+    std::vector<uint8_t> copy;
+    uvgrtp::pkt_vec packets;
+    uvgrtp::send_arrays arrays;
+    uint64_t next = 0;
+
+    while (true) {
+        std::vector<std::shared_ptr<const uvgrtp::gop_frame>> frames;
+
+        {
+            std::lock_guard<std::mutex> lg(gop_mutex_);
+
+            for (auto& frame : gop_) {
+                if (frame->number >= next)
+                    frames.push_back(frame);
+            }
+
+            // the frames cached after this are sent to the destination with the other destinations
+            if (frames.empty()) {
+                store_destinations(destinations);
+                return RTP_OK;
+            }
+        }
+
+        // the frames are sent outside the lock so that the stream is not held up by the pacing
+        for (auto& frame : frames) {
+            if (send_cached(destination, *frame, copy, packets, arrays) != RTP_OK)
+                UVG_LOG_ERROR("Failed to send a cached frame to a new destination");
+
+            next = frame->number + 1;
+        }
+    }
+}
+
+rtp_error_t uvgrtp::frame_queue::send_cached(const uvgrtp::fanout_destination& destination,
+    const uvgrtp::gop_frame& frame, std::vector<uint8_t>& copy, uvgrtp::pkt_vec& packets, uvgrtp::send_arrays& arrays)
+{
+    sockaddr_in addr   = destination.addr;
+    sockaddr_in6 addr6 = destination.addr6;
+
+    // the cached frame is shared by all new destinations, so the headers are rewritten in a copy of it
+    copy.assign(frame.data.begin(), frame.data.end());
+
+    uint8_t *data   = copy.data();
+    size_t buffer   = 0;
+    rtp_error_t ret = RTP_OK;
+
+    for (size_t i = 0; i < frame.packets.size() && ret == RTP_OK; ) {
+        packets.clear();
+
+        for (; i < frame.packets.size() && packets.size() < uvgrtp::GOP_BURST_PACKETS; ++i) {
+            packets.emplace_back();
+
+            for (size_t j = 0; j < frame.packets[i]; ++j, ++buffer) {
+                packets.back().push_back({ frame.buffers[buffer], data });
+                data += frame.buffers[buffer];
+            }
+
+            if (destination.ssrc)
+                rewrite_header(packets.back(), htonl(destination.ssrc), destination.seq_offset);
+        }
+
+        if (destination.srtp)
+            ret = uvgrtp::srtp::send_frame_handler(destination.srtp.get(), packets);
+
+        if (ret == RTP_OK) {
+            bool gso = (rce_flags_ & RCE_UDP_GSO) && packets.size() > 1;
+            ret = socket_->sendto_prepared(addr, addr6, packets, 0, arrays, gso);
+        }
+
+        if (ret == RTP_OK && metrics_)
+            metrics_->count(uvgrtp::stream_metrics::SENT_PACKETS, packets.size());
+
+        std::this_thread::sleep_for(std::chrono::microseconds(uvgrtp::GOP_BURST_SPACING_US));
+    }
+
+    return ret;
+}
+
+uint32_t uvgrtp::frame_queue::destination_ssrc(const uvgrtp::fanout_destination& destination) const
+{
+    return destination.ssrc ? htonl(destination.ssrc) : active_->rtp_common.ssrc;
+}
+
+uint16_t uvgrtp::frame_queue::destination_offset(const uvgrtp::fanout_destination& destination) const
+{
+    return (uint16_t)(destination.seq_offset - (destination.skipped ? *destination.skipped : 0));
+}
+
+bool uvgrtp::frame_queue::above_layers(const uvgrtp::fanout_destination& destination) const
+{
+    return (frame_marking_[0] & uvgrtp::FRAME_MARKING_TID_MASK) > destination.max_temporal_id ||
+        frame_marking_[1] > destination.max_layer_id;
+}
+
+rtp_error_t uvgrtp::frame_queue::send_fanout(const std::vector<uvgrtp::fanout_destination> *destinations,
+    bool own_srtp)
+{
+    if (!destinations || destinations->empty())
+        return RTP_OK;
+
+    rtp_error_t ret = RTP_OK;
+
+    std::chrono::steady_clock::time_point start;
+    if (profiled_)
+        start = std::chrono::steady_clock::now();
+
+    for (auto& destination : *destinations) {
+        if ((destination.srtp != nullptr) != own_srtp)
+            continue;
+
+        // the later packets of the destination take the sequence numbers of the packets left out
+        if (above_layers(destination)) {
+            *destination.skipped = (uint16_t)(*destination.skipped + active_->packets.size());
+            continue;
+        }
+
+        rtp_error_t result = own_srtp ? send_protected(destination) : send_rewritten(destination);
+        if (result != RTP_OK) {
+            UVG_LOG_ERROR("Failed to send a frame to a destination of the stream: %i", result);
+            ret = RTP_SEND_ERROR;
+        }
+    }
+
+    // both passes of the frame are counted as one, see packets_sent()
+    if (profiled_)
+        fanout_time_ += std::chrono::steady_clock::now() - start;
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::frame_queue::send_protected(const uvgrtp::fanout_destination& destination)
+{
+    const size_t blocks_used  = active_->blocks_used;
+    const size_t block_offset = active_->block_offset;
+
+    uvgrtp::pkt_vec& copies = active_->fanout_packets;
+    copies.resize(active_->packets.size());
+
+    rtp_error_t ret = RTP_OK;
+
+    for (size_t i = 0; i < active_->packets.size() && ret == RTP_OK; ++i) {
+        uvgrtp::buf_vec& copy = copies[i];
+        copy.clear();
+
+        for (auto& buffer : active_->packets[i]) {
+            uint8_t *memory = alloc_memory(buffer.first);
+            if (!memory) {
+                ret = RTP_MEMORY_ERROR;
+                break;
+            }
+
+            memcpy(memory, buffer.second, buffer.first);
+            copy.push_back({ buffer.first, memory });
+        }
+
+        if (ret == RTP_OK && (destination.ssrc || destination.skipped))
+            rewrite_header(copy, destination_ssrc(destination), destination_offset(destination));
+    }
+
+    if (ret == RTP_OK)
+        ret = uvgrtp::srtp::send_frame_handler(destination.srtp.get(), copies);
+
+    if (ret == RTP_OK)
+        ret = send_to(destination, copies);
+
+    // the copies have been sent, so their memory can be given out again
+    active_->blocks_used  = blocks_used;
+    active_->block_offset = block_offset;
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::frame_queue::send_rewritten(const uvgrtp::fanout_destination& destination)
+{
+    if (!destination.ssrc && !destination.skipped)
+        return send_to(destination, active_->packets);
+
+    const uint16_t offset = destination_offset(destination);
+
+    for (auto& packet : active_->packets) {
+        rewrite_header(packet, destination_ssrc(destination), offset);
+    }
+
+    rtp_error_t ret = send_to(destination, active_->packets);
+
+    for (auto& packet : active_->packets) {
+        rewrite_header(packet, active_->rtp_common.ssrc, (uint16_t)(0x10000 - offset));
+    }
+
+    return ret;
+}
+
+void uvgrtp::frame_queue::rewrite_header(uvgrtp::buf_vec& packet, uint32_t ssrc, uint16_t offset)
+{
+    uvgrtp::frame::rtp_header *header = (uvgrtp::frame::rtp_header *)packet[0].second;
+
+    header->ssrc = ssrc;
+    header->seq  = htons((uint16_t)(ntohs(header->seq) + offset));
+
+    // the sequence number base of a repair packet is the third and fourth byte of its FEC header
+    if (fec_payload_type_ && (((uint8_t *)header)[1] & 0x7f) == fec_payload_type_ && packet.size() > 1 &&
+        packet[1].first >= uvgrtp::FEC_HEADER_SIZE) {
+        uint8_t *base = packet[1].second + 2;
+        uint16_t seq  = (uint16_t)(((base[0] << 8) | base[1]) + offset);
+
+        base[0] = (uint8_t)(seq >> 8);
+        base[1] = (uint8_t)(seq & 0xff);
+    }
+}
+
+rtp_error_t uvgrtp::frame_queue::send_to(const uvgrtp::fanout_destination& destination, uvgrtp::pkt_vec& packets)
+{
+    sockaddr_in addr   = destination.addr;
+    sockaddr_in6 addr6 = destination.addr6;
+
+    bool gso = (rce_flags_ & RCE_UDP_GSO) && packets.size() > 1;
+
+    rtp_error_t ret = socket_->sendto_prepared(addr, addr6, packets, 0, active_->send_arrays, gso);
+
+    if (ret == RTP_OK && metrics_)
+        metrics_->count(uvgrtp::stream_metrics::SENT_PACKETS, packets.size());
+
+    return ret;
+}
+
+void uvgrtp::frame_queue::packets_sent(sockaddr_in& addr, sockaddr_in6& addr6,
+    std::chrono::steady_clock::time_point send_start, std::chrono::nanoseconds spacing)
+{
+    if (twcc_)
+        twcc_->packets_sent(send_start, spacing);
+
+    if (history_)
+        history_->packets_sent(addr, addr6, active_->packets);
+
+    if (metrics_) {
+        metrics_->count(uvgrtp::stream_metrics::SENT_PACKETS, active_->packets.size());
+        metrics_->record(uvgrtp::stream_metrics::SEND_BATCH_SIZE, active_->packets.size());
+    }
+
+    if (profiled_ && fanout_time_.count() > 0)
+        metrics_->record(uvgrtp::stream_metrics::STAGE_FANOUT_NS, (uint64_t)fanout_time_.count());
+
+    // the send timestamps of the earlier frames, a stream that does not receive has nobody else to read them
+    if (socket_->timestamping() & RTP_TIMESTAMP_SEND)
+        (void)socket_->read_tx_timestamps();
+}
+
 inline std::chrono::high_resolution_clock::time_point uvgrtp::frame_queue::this_frame_time()
 {
     return fps_sync_point_ +
@@ -369,24 +1303,100 @@ inline std::chrono::high_resolution_clock::time_point uvgrtp::frame_queue::this_
 
 void uvgrtp::frame_queue::update_rtp_header()
 {
-    memcpy(&active_->rtp_headers[active_->rtphdr_ptr], &active_->rtp_common, sizeof(active_->rtp_common));
-    rtp_->update_sequence((uint8_t *)(&active_->rtp_headers[active_->rtphdr_ptr]));
+    uint8_t *header = header_slot(active_->rtphdr_ptr);
+
+    memcpy(header, &active_->rtp_common, sizeof(active_->rtp_common));
+    rtp_->update_sequence(header);
+}
+
+rtp_error_t uvgrtp::frame_queue::set_twcc(std::shared_ptr<uvgrtp::twcc_sender> sender, uint8_t ext_id)
+{
+    rtp_error_t ret = set_header_extension(uvgrtp::EXT_TRANSPORT_WIDE_SEQ, sender ? ext_id : 0);
+
+    if (ret == RTP_OK)
+        twcc_ = sender;
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::frame_queue::set_header_extension(uvgrtp::HEADER_EXTENSION extension, uint8_t id)
+{
+    rtp_error_t ret = extensions_.set_id(extension, id);
+
+    header_stride_ = RTP_HDR_SIZE + extensions_.size();
+    return ret;
+}
+
+void uvgrtp::frame_queue::write_extension(uint8_t *header, bool first)
+{
+    uint8_t *ext = header + RTP_HDR_SIZE;
+
+    header[0] |= (1 << 4);
+    memcpy(ext, extensions_.layout(), extensions_.size());
+
+    if (size_t offset = extensions_.offset(uvgrtp::EXT_AUDIO_LEVEL))
+        ext[offset] = audio_level_.load(std::memory_order_relaxed);
+
+    if (size_t offset = extensions_.offset(uvgrtp::EXT_FRAME_MARKING)) {
+        ext[offset] = (uint8_t)(frame_marking_[0] | (first ? uvgrtp::FRAME_MARKING_START : 0));
+
+        // the TL0PICIDX of the long form is left out
+        if (extensions_.long_frame_marking())
+            ext[offset + 1] = frame_marking_[1];
+    }
+}
+
+void uvgrtp::frame_queue::write_send_times(std::chrono::nanoseconds spacing)
+{
+    const size_t offset = RTP_HDR_SIZE + extensions_.offset(uvgrtp::EXT_ABS_SEND_TIME);
+    const uint64_t now  = uvgrtp::clock::ntp::now();
+
+    // the spacing in the units of the NTP fraction, 2^32 per second
+    const uint64_t step = (uint64_t)((double)spacing.count() * 4.294967296);
+
+    for (size_t i = 0; i < active_->packets.size(); ++i) {
+        uvgrtp::buf_vec& packet = active_->packets[i];
+
+        // the repair packets of FEC have no extension
+        if (packet[0].first > RTP_HDR_SIZE)
+            uvgrtp::write_abs_send_time(packet[0].second + offset, now + i * step);
+    }
 }
 
-uvgrtp::buf_vec* uvgrtp::frame_queue::get_buffer_vector()
+uint8_t *uvgrtp::frame_queue::alloc_media_headers(size_t size)
 {
     if (!active_)
     {
         UVG_LOG_ERROR("No active transaction");
         return nullptr;
     }
-  
-    return &active_->buffers;
+
+    return alloc_memory(size);
 }
 
-void *uvgrtp::frame_queue::get_media_headers()
+uint8_t *uvgrtp::frame_queue::alloc_memory(size_t size)
 {
-    return active_->media_headers;
+    if (size > TRANSACTION_BLOCK_SIZE)
+    {
+        UVG_LOG_ERROR("Cannot allocate %zu bytes for a transaction, the limit is %zu", size, TRANSACTION_BLOCK_SIZE);
+        return nullptr;
+    }
+
+    // continue in a new block, the earlier ones are referenced by queued packets
+    if (active_->blocks_used == 0 || active_->block_offset + size > TRANSACTION_BLOCK_SIZE)
+    {
+        if (active_->blocks_used == active_->blocks.size())
+        {
+            active_->blocks.emplace_back(new uint8_t[TRANSACTION_BLOCK_SIZE]);
+        }
+        ++active_->blocks_used;
+        active_->block_offset = 0;
+    }
+
+    uint8_t *memory = active_->blocks[active_->blocks_used - 1].get() + active_->block_offset;
+    active_->block_offset += size;
+
+    return memory;
 }
 
 uint8_t *uvgrtp::frame_queue::get_active_dataptr()
@@ -407,16 +1417,72 @@ void uvgrtp::frame_queue::install_dealloc_hook(void (*dealloc_hook)(void *))
     dealloc_hook_ = dealloc_hook;
 }
 
-void uvgrtp::frame_queue::enqueue_finalize(uvgrtp::buf_vec& tmp)
+uvgrtp::buf_vec& uvgrtp::frame_queue::begin_packet(bool extension)
 {
-    if (rce_flags_ & RCE_SRTP_AUTHENTICATE_RTP) {
-        tmp.push_back({
-            UVG_AUTH_TAG_LENGTH,
-            (uint8_t*)&active_->rtp_auth_tags[10 * active_->rtpauth_ptr++]
+    if (active_->spare_packets.empty()) {
+        active_->packets.emplace_back();
+    } else {
+        active_->packets.push_back(std::move(active_->spare_packets.back()));
+        active_->spare_packets.pop_back();
+    }
+
+    uvgrtp::buf_vec& packet = active_->packets.back();
+    packet.clear();
+
+    /* update the RTP header at "rtpheaders_ptr_" */
+    update_rtp_header();
+
+    uint8_t *header   = header_slot(active_->rtphdr_ptr);
+    size_t header_len = RTP_HDR_SIZE;
+
+    twcc_ext_ = nullptr;
+
+    /* The extension is in the same buffer as the RTP header, so SRTP encrypts
+     * the payload alone and authenticates the extension with the header */
+    if (extension && extensions_.size()) {
+        write_extension(header, active_->rtphdr_ptr == 0);
+        header_len += extensions_.size();
+
+        if (twcc_)
+            twcc_ext_ = header + RTP_HDR_SIZE + extensions_.offset(uvgrtp::EXT_TRANSPORT_WIDE_SEQ);
+    }
+
+    packet.push_back({ header_len, header });
+    ++active_->rtphdr_ptr;
+
+    return packet;
+}
+
+void uvgrtp::frame_queue::end_packet(uvgrtp::buf_vec& packet)
+{
+    if (auth_tag_len_)
+        finish_packet<true>(packet);
+    else
+        finish_packet<false>(packet);
+}
+
+template <bool Authenticate>
+void uvgrtp::frame_queue::finish_packet(uvgrtp::buf_vec& packet)
+{
+    if (Authenticate) {
+        packet.push_back({
+            auth_tag_len_,
+            (uint8_t*)&active_->rtp_auth_tags[auth_tag_len_ * active_->rtpauth_ptr++]
             });
     }
 
-    active_->packets.push_back(tmp);
+    if (twcc_ext_) {
+        size_t packet_size = 0;
+        for (auto& buffer : packet) {
+            packet_size += buffer.first;
+        }
+        uint16_t seq = twcc_->add_packet(packet_size);
+
+        twcc_ext_[0] = (uint8_t)(seq >> 8);
+        twcc_ext_[1] = (uint8_t)(seq & 0xff);
+        twcc_ext_    = nullptr;
+    }
+
     rtp_->inc_sequence();
     rtp_->inc_sent_pkts();
 }
@@ -3,10 +3,17 @@
 #include "uvgrtp/frame.hh"
 #include "uvgrtp/util.hh"
 
+#include "global.hh"
+#include "pacer.hh"
 #include "socket.hh"
+#include "twcc.hh"
+#include "nack.hh"
+#include "fec.hh"
+#include "header_extensions.hh"
 
 #include <atomic>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <vector>
 #include <mutex>
@@ -23,42 +30,100 @@ const int MAX_MSG_COUNT   = 5000;
 const int MAX_QUEUED_MSGS =  10;
 const int MAX_CHUNK_COUNT =   4;
 
+// size of the blocks the extra memory of a transaction is handed out from
+const size_t TRANSACTION_BLOCK_SIZE = 16384;
+
+// number of sent transactions that are kept for reuse
+const size_t TRANSACTION_POOL_SIZE = MAX_QUEUED_MSGS;
+
 namespace uvgrtp {
+    class path_mtu;
     class rtp;
+    class srtp;
+    class stream_metrics;
+
+    /* A destination that the packets of each frame are also sent to, see media_stream::add_destination() */
+    struct fanout_destination {
+        sockaddr_in addr = {};
+        sockaddr_in6 addr6 = {};
+
+        /* The SSRC written to the packets of the destination and the offset added to their
+         * sequence numbers. A zero "ssrc" keeps the headers of the stream */
+        uint32_t ssrc = 0;
+        uint16_t seq_offset = 0;
+
+        /* The SRTP context the packets of the destination are protected with. If null, the
+         * destination gets the packets as they were protected for the stream */
+        std::shared_ptr<uvgrtp::srtp> srtp;
+
+        /* The highest temporal and layer IDs of the frames sent to the destination, see
+         * frame_queue::set_destination_layers(). The packets of the frames left out are added to
+         * "skipped", so that the sequence numbers of the destination have no gaps */
+        uint8_t max_temporal_id = uvgrtp::MAX_TEMPORAL_ID;
+        uint8_t max_layer_id = uvgrtp::MAX_LAYER_ID;
+        std::shared_ptr<uint16_t> skipped;
+    };
 
-    typedef struct transaction {
+    /* A path of a multipath stream: the socket the packets are sent from, the address they are
+     * sent to and the share of the packets it is given, see media_stream::add_path() */
+    struct send_path {
+        std::string local_address;
+        std::shared_ptr<uvgrtp::socket> socket;
+        sockaddr_in addr = {};
+        sockaddr_in6 addr6 = {};
+        uint32_t weight = 1;
+    };
+
+    /* Most paths of one stream, the feedback keeps the path of a packet in a byte */
+    constexpr size_t MAX_SEND_PATHS = 16;
+
+    /* The cached frames a destination gets when it is added are sent GOP_BURST_PACKETS packets
+     * at a time, GOP_BURST_SPACING_US apart, see frame_queue::set_gop_cache() */
+    constexpr size_t GOP_BURST_PACKETS  = 32;
+    constexpr int GOP_BURST_SPACING_US = 1000;
+
+    /* The packets of one frame of the GOP cache. The buffers of the packets are copied one after
+     * another to "data", "buffers" has their sizes and "packets" the number of buffers of each packet */
+    struct gop_frame {
+        uint64_t number = 0;
+        std::vector<uint8_t> data;
+        std::vector<size_t> buffers;
+        std::vector<size_t> packets;
+    };
 
-        /* To provide true scatter/gather I/O, each transaction has a buf_vec
-         * structure which may contain differents buffers and their sizes.
-         *
-         * This can be used, for example, for storing media-specific headers
-         * which are then passed (along with the actual media) to enqueue_message() */
-        uvgrtp::buf_vec buffers;
+    typedef struct transaction {
 
         /* Each RTP frame of a transaction is constructed using buf_vec structure and
          * each buf_vec structure is pushed to pkt_vec */
         uvgrtp::pkt_vec packets;
 
+        /* Buffer vectors of the packets of earlier frames, so that building the
+         * packets of a frame does not have to allocate */
+        uvgrtp::pkt_vec spare_packets;
+
+        /* The socket builds the system call messages here */
+        uvgrtp::send_arrays send_arrays;
+
+        /* The copies of the packets built for a destination with its own SRTP context */
+        uvgrtp::pkt_vec fanout_packets;
+
         /* All packets of a transaction share the common RTP header only differing in sequence number.
          * Keeping a separate common RTP header and then just copying this is cleaner than initializing
          * RTP header for each packet */
         uvgrtp::frame::rtp_header rtp_common;
-        uvgrtp::frame::rtp_header *rtp_headers = nullptr;
 
-#ifndef _WIN32
-        struct mmsghdr *headers = nullptr;
-        struct iovec   *chunks = nullptr;
-#else
-        char *headers = nullptr;
-        char *chunks = nullptr;
-#endif
+        /* The RTP headers of the packets, "header_stride" bytes each. The slot of a packet has room for
+         * the header extension of the stream right after the header, so the header and the extension
+         * are written with a few stores and sent as one buffer */
+        uint8_t *rtp_headers = nullptr;
+        size_t header_stride = 0;
 
-        /* Media may need space for additional buffers,
-         * this pointer is initialized with uvgrtp::MEDIA_TYPE::media_headers
-         * when the transaction is initialized for the first time
-         *
-         * See src/formats/hevc.hh for example */
-        void *media_headers = nullptr;
+        /* Memory that must stay valid until the packets have been sent, f.ex. the FU headers
+         * of H26x and the payload copies made for SRTP. It is given out of "blocks" by
+         * alloc_memory(), "blocks_used" blocks are in use and "block_offset" bytes of the last one */
+        std::vector<std::unique_ptr<uint8_t[]>> blocks;
+        size_t blocks_used = 0;
+        size_t block_offset = 0;
 
         /* Pointer to RTP authentication (if enabled) */
         uint8_t *rtp_auth_tags = nullptr;
@@ -87,6 +152,10 @@ namespace uvgrtp {
             rtp_error_t init_transaction(uint8_t *data);
             rtp_error_t init_transaction(std::unique_ptr<uint8_t[]> data);
 
+            /* Stamp the packets of the active transaction with "timestamp" instead of
+             * the timestamp of the stream, e.g. for NAL units held since an earlier frame */
+            void set_timestamp(uint32_t timestamp);
+
             /* Releases all memory associated with transaction
              *
              * Return RTP_OK on success
@@ -107,6 +176,7 @@ namespace uvgrtp {
              * Return RTP_INVALID_VALUE if one of the parameters is invalid
              * Return RTP_MEMORY_ERROR if the maximum amount of chunks/messages is exceeded */
             rtp_error_t enqueue_message(buf_vec& buffers);
+            rtp_error_t enqueue_message(buf_vec& buffers, bool set_m_bit);
 
             /* Flush the message queue
              *
@@ -115,19 +185,31 @@ namespace uvgrtp {
              * return RTP_SEND_ERROR if send fails */
             rtp_error_t flush_queue(sockaddr_in& addr, sockaddr_in6& addr6);
 
-            /* Media may have extra headers (f.ex. NAL and FU headers for HEVC).
-             * These headers must be valid until the message is sent (ie. they cannot be saved to
-             * caller's stack).
+            /* Cache a fragmented message to frame queue. "data" is split into packets of
+             * "fragment_size" bytes (the last one may be smaller) and each packet is prefixed
+             * with a media header of "header_size" bytes from "headers", which holds the header
+             * of the first, middle and last packet back to back. "headers" must stay valid
+             * until the message is sent, see alloc_media_headers()
              *
-             * buf_vec is the place to store these extra headers (see src/formats/hevc.cc) */
-            uvgrtp::buf_vec* get_buffer_vector();
+             * The packets are built directly in one loop, so this is faster than calling
+             * enqueue_message() for each fragment
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if one of the parameters is invalid
+             * Return RTP_MEMORY_ERROR if the maximum amount of messages is exceeded */
+            rtp_error_t enqueue_fragments(uint8_t *headers, size_t header_size,
+                uint8_t *data, size_t data_len, size_t fragment_size);
 
-            /* Each media may allocate extra buffers for the transaction struct if need be
+            /* Media may have extra headers (f.ex. payload and FU headers for HEVC).
+             * These headers must be valid until the message is sent (ie. they cannot be saved to
+             * caller's stack).
              *
+             * Get "size" bytes of memory for media headers that stays valid until the active
+             * transaction has been sent. The memory is reused by later transactions
              *
-             * Return pointer to media headers if they're set
-             * Return nullptr if they're not set */
-            void *get_media_headers();
+             * Return pointer to the memory on success
+             * Return nullptr if there is no active transaction or "size" is too large */
+            uint8_t *alloc_media_headers(size_t size);
 
             /* Update the active task's current packet's sequence number */
             void update_rtp_header();
@@ -163,9 +245,330 @@ namespace uvgrtp {
                 force_sync_ = true;
             }
 
+            /* Set the pacer that sends the packets of RCE_PACE_FRAGMENT_SENDING frames */
+            void set_pacer(std::shared_ptr<uvgrtp::pacer> pacer)
+            {
+                pacer_ = pacer;
+            }
+
+            /* Set the burst size in packets and the spin time of the pacing, see pacing_bucket */
+            void set_pacing(size_t burst_packets, std::chrono::nanoseconds spin)
+            {
+                pacing_.burst_packets = burst_packets;
+                pacing_.spin          = spin;
+            }
+
+            /* Set the priority and the weight of the paced frames in the pacer, see pacing_bucket */
+            void set_send_priority(int priority, size_t weight)
+            {
+                pacing_.priority = priority;
+                pacing_.weight   = weight;
+            }
+
+            /* Resize the payloads to the path MTU of "path_mtu" at the start of each frame,
+             * a null "path_mtu" keeps the current payload size */
+            void set_path_mtu(std::shared_ptr<uvgrtp::path_mtu> path_mtu)
+            {
+                std::atomic_store(&path_mtu_, path_mtu);
+            }
+
+            /* Add the transport-wide sequence number of "sender" to each packet as the header
+             * extension element "ext_id". A null "sender" stops adding the extension
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if another element of the header extension has "ext_id" */
+            rtp_error_t set_twcc(std::shared_ptr<uvgrtp::twcc_sender> sender, uint8_t ext_id);
+
+            /* Add the element "extension" to the header extension of each packet with the ID "id",
+             * a zero "id" removes it. The transport-wide sequence number is added with set_twcc()
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if another element already has "id" */
+            rtp_error_t set_header_extension(uvgrtp::HEADER_EXTENSION extension, uint8_t id);
+
+            /* Set the MID or RID of the sent packets, see header_extensions::set_value() */
+            rtp_error_t set_header_extension_value(uvgrtp::HEADER_EXTENSION extension, const std::string& value)
+            {
+                rtp_error_t ret = extensions_.set_value(extension, value);
+
+                header_stride_ = RTP_HDR_SIZE + extensions_.size();
+                return ret;
+            }
+
+            /* Send the long form of frame marking, see header_extensions::set_long_frame_marking() */
+            void set_long_frame_marking(bool long_form)
+            {
+                extensions_.set_long_frame_marking(long_form);
+                header_stride_ = RTP_HDR_SIZE + extensions_.size();
+            }
+
+            /* Return the bytes the header extension takes from each packet, zero without one */
+            size_t header_extension_size() const
+            {
+                return extensions_.size();
+            }
+
+            uint8_t header_extension_id(uvgrtp::HEADER_EXTENSION extension) const
+            {
+                return extensions_.get_id(extension);
+            }
+
+            /* Mark the packets of the active transaction with the frame marking bits "flags" and the
+             * layer ID "layer_id". The start and end of frame bits are set by the frame queue */
+            void set_frame_marking(uint8_t flags, uint8_t layer_id)
+            {
+                frame_marking_[0] = flags & ~(uvgrtp::FRAME_MARKING_START | uvgrtp::FRAME_MARKING_END);
+                frame_marking_[1] = layer_id;
+            }
+
+            /* Whether the packets carry the frame marking element, so the media knows to set it */
+            bool frame_marking_enabled() const
+            {
+                return extensions_.offset(uvgrtp::EXT_FRAME_MARKING) != 0;
+            }
+
+            /* The audio level element of the frames that are sent after this, see RFC 6464 */
+            void set_audio_level(uint8_t level, bool voice_activity)
+            {
+                audio_level_.store((uint8_t)((voice_activity ? 0x80 : 0) | (level & 0x7f)), std::memory_order_relaxed);
+            }
+
+            /* Copy the sent packets to "history" for retransmission, see RCC_NACK.
+             * A null "history" stops copying */
+            void set_packet_history(std::shared_ptr<uvgrtp::packet_history> history)
+            {
+                history_ = history;
+            }
+
+            /* Count the sent packets in "metrics", see media_stream::get_stats() */
+            void set_metrics(std::shared_ptr<uvgrtp::stream_metrics> metrics)
+            {
+                metrics_ = metrics;
+            }
+
+            /* Also send the packets of each frame to "destination", replacing an earlier destination
+             * with the same address. The frame is packetized once and each destination gets it
+             * with one vector send, after the addresses given to flush_queue(). A new destination
+             * first gets the frames of the GOP cache, see set_gop_cache()
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the destination rewrites the SSRC of an SRTP stream
+             * without an SRTP context of its own */
+            rtp_error_t add_destination(const uvgrtp::fanout_destination& destination);
+
+            /* Spread the packets of each frame over "paths" instead of sending them from the socket
+             * of the stream. The packets are dealt to the paths by weighted round robin and sent with
+             * one vector send per path. With transport-wide congestion control, the share of a path
+             * shrinks when the feedback shows it losing packets or queuing them and grows back to its
+             * weight when it recovers, see update_path_weights(). The frames are not paced. A null
+             * "paths" sends from the socket of the stream again */
+            void set_paths(std::shared_ptr<const std::vector<uvgrtp::send_path>> paths);
+
+            /* Keep copies of the packets of the frames sent since the last key frame, at most
+             * "limit" bytes of them, and send them to each new destination of add_destination() before
+             * its first frame, so that the receiver can start decoding without waiting for the next key
+             * frame. The key frames are those that the media marks independent with set_frame_marking().
+             * A GOP larger than "limit" is not cached. A zero "limit" stops caching */
+            void set_gop_cache(size_t limit);
+
+            /* Whether the media has to mark the key frames with set_frame_marking(), see set_gop_cache() */
+            bool gop_caching() const
+            {
+                return gop_limit_.load(std::memory_order_relaxed) != 0;
+            }
+
+            /* Stop sending to the destination added with the address "addr" or "addr6"
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_FOUND if there is no such destination */
+            rtp_error_t remove_destination(const sockaddr_in& addr, const sockaddr_in6& addr6);
+
+            /* Send to the destination with the address "addr" or "addr6" only the frames whose temporal
+             * and layer IDs, as given by set_frame_marking(), are at most "max_tid" and "max_layer_id".
+             * The packets of the other frames are not sent to it and the sequence numbers of the later
+             * packets are moved back over them
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_FOUND if there is no such destination
+             * Return RTP_INVALID_VALUE if the packets of the destination are protected for the stream,
+             * so their sequence numbers cannot be changed */
+            rtp_error_t set_destination_layers(const sockaddr_in& addr, const sockaddr_in6& addr6,
+                uint8_t max_tid, uint8_t max_layer_id);
+
+            /* Whether some destination only gets some of the layers, so the media has to give the
+             * layers of each frame with set_frame_marking() */
+            bool layer_filtering() const
+            {
+                return layer_filtering_.load(std::memory_order_relaxed);
+            }
+
+            /* Follow the packets of each frame with "overhead" percent of repair packets of
+             * the payload type "payload_type", see fec.hh. A zero "payload_type" stops adding them */
+            void set_fec(uint8_t payload_type, int overhead)
+            {
+                fec_payload_type_ = payload_type;
+                fec_overhead_     = overhead;
+            }
+
+            /* Give the paced frames to the pacer without waiting for them to be sent, so that the
+             * frames of several frame queues are paced side by side. flush_queue() then returns once
+             * the pacer has the frame and finish_pacing() must be called before the next frame */
+            void defer_pacing(bool defer)
+            {
+                defer_pacing_ = defer;
+            }
+
+            /* Wait until the pacer has sent the frame that flush_queue() gave it with defer_pacing()
+             * and finish it. Does nothing if no frame is being paced
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR if sending failed */
+            rtp_error_t finish_pacing();
+
+            /* Whether a frame of "len" bytes can be sent as one packet without a transaction, see
+             * prepare_single(). The payload size is first updated to the path MTU, see set_path_mtu(),
+             * because the frame starts here. The frames of a stream with FEC, congestion control, retransmissions,
+             * frame rate control, pacing, the GOP cache or destinations of add_destination() need the transaction */
+            bool single_supported(size_t len) const;
+
+            /* Write the next RTP header of the stream for the one-packet frame "data" and return the
+             * packet of the header, "data" and the room for the SRTP authentication tag. The packet is
+             * built into buffers of the frame queue that the next call reuses, so a stream that sends
+             * small frames builds no transaction and allocates nothing. The packet handlers of the
+             * socket have not been run for it */
+            uvgrtp::buf_vec& prepare_single(uint8_t *data, size_t len, bool marker);
+
+            /* Send the frame "data" as the packet of prepare_single()
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR if sending failed */
+            rtp_error_t push_single(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t len, bool marker);
+
+            /* The packet of prepare_single() has been sent */
+            void single_sent();
+
         private:
 
-            void enqueue_finalize(uvgrtp::buf_vec& tmp);
+            /* Start a new packet with the next RTP header in the active transaction. The buffer
+             * vector of the packet is reused from an earlier frame when possible. Without
+             * "extension", the packet gets no header extension and is not numbered for
+             * congestion control */
+            uvgrtp::buf_vec& begin_packet(bool extension = true);
+
+            /* Return the RTP header slot of the packet "index" of the active transaction */
+            uint8_t *header_slot(size_t index)
+            {
+                return active_->rtp_headers + index * active_->header_stride;
+            }
+
+            /* Copy the header extension of the stream behind the RTP header "header" and write the
+             * values known when the packet is built. "first" is the first packet of the frame */
+            void write_extension(uint8_t *header, bool first);
+
+            /* Write the abs-send-time of the packets of the active transaction, the packet "i" is
+             * sent "i" times "spacing" after now */
+            void write_send_times(std::chrono::nanoseconds spacing);
+
+            /* Get "size" bytes from the blocks of the active transaction, see transaction_t */
+            uint8_t *alloc_memory(size_t size);
+
+            /* Add the authentication tag to "packet" if needed and update the counters */
+            void end_packet(uvgrtp::buf_vec& packet);
+
+            /* end_packet() for a stream that does or does not authenticate its RTP packets */
+            template <bool Authenticate>
+            void finish_packet(uvgrtp::buf_vec& packet);
+
+            /* The packet loop of enqueue_fragments() for the flags of the stream, chosen once in the
+             * constructor so that the loop has no branches on the flags. "Copy" copies each fragment
+             * after its header for SRTP encryption and "Authenticate" adds the authentication tag */
+            template <bool Copy, bool Authenticate>
+            rtp_error_t fragment_kernel(uint8_t *headers, size_t header_size, uint8_t *data, size_t data_len,
+                size_t fragment_size, size_t count);
+
+            /* Allocate the arrays of a transaction. Sent transactions are kept in "pool_"
+             * and reused by init_transaction(), so a stream that sends steadily does not allocate */
+            transaction_t *create_transaction();
+            void free_transaction(transaction_t *transaction);
+
+            /* Give the whole active transaction to the kernel to pace, see RCE_PACE_KERNEL.
+             * The launch times of SO_TXTIME are used if the socket has it enabled and otherwise
+             * the rate of the frame is set with SO_MAX_PACING_RATE
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the kernel cannot pace the frame
+             * Return RTP_SEND_ERROR if sending failed */
+            rtp_error_t send_kernel_paced(sockaddr_in& addr, sockaddr_in6& addr6);
+
+            /* Add the repair packets of the media packets of the active transaction, see set_fec()
+             *
+             * Return RTP_OK on success
+             * Return RTP_MEMORY_ERROR if the transaction has no room for the repair packets */
+            rtp_error_t add_fec_packets();
+
+            /* Copy the packets of the active transaction to the GOP cache if it is enabled and return
+             * the destinations the frame is sent to. The cache and the destinations are read under
+             * "gop_mutex_", so a destination being added gets the frame either from the cache or with
+             * the other destinations, see send_gop() */
+            std::shared_ptr<const std::vector<uvgrtp::fanout_destination>> cache_frame();
+
+            /* Send the cached frames to the new "destination" and then store "destinations", which
+             * include it. The frames cached while the earlier ones are sent follow them
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR if sending failed */
+            rtp_error_t send_gop(const uvgrtp::fanout_destination& destination,
+                std::shared_ptr<std::vector<uvgrtp::fanout_destination>> destinations);
+
+            /* Send the packets of "frame" to "destination", "copy", "packets" and "arrays" are the
+             * buffers of send_gop() */
+            rtp_error_t send_cached(const uvgrtp::fanout_destination& destination, const uvgrtp::gop_frame& frame,
+                std::vector<uint8_t>& copy, uvgrtp::pkt_vec& packets, uvgrtp::send_arrays& arrays);
+
+            /* Send the packets of the active transaction to "destinations" that have their own SRTP
+             * context if "own_srtp" is set and to the others if not. The destinations with an SRTP
+             * context need the packets before the stream encrypts them
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR if sending to some destination failed */
+            rtp_error_t send_fanout(const std::vector<uvgrtp::fanout_destination> *destinations, bool own_srtp);
+
+            /* Send copies of the packets with the headers of "destination" protected with its SRTP
+             * context. The copies use the memory of the transaction only until they have been sent */
+            rtp_error_t send_protected(const uvgrtp::fanout_destination& destination);
+
+            /* Send the packets with the headers of "destination", which are restored afterwards */
+            rtp_error_t send_rewritten(const uvgrtp::fanout_destination& destination);
+
+            /* The SSRC in network byte order and the sequence number offset of the packets of "destination" */
+            uint32_t destination_ssrc(const uvgrtp::fanout_destination& destination) const;
+            uint16_t destination_offset(const uvgrtp::fanout_destination& destination) const;
+
+            /* Are the frame marking layers of the active transaction above the limits of "destination" */
+            bool above_layers(const uvgrtp::fanout_destination& destination) const;
+
+            /* Protect the packets of the active transaction once and send each path its share of them */
+            rtp_error_t send_paths(const std::shared_ptr<const std::vector<uvgrtp::send_path>>& paths);
+
+            /* Adapt the shares of the paths to the feedback of transport-wide congestion control */
+            void update_path_weights();
+
+            /* Replace the destinations with "destinations", fanout_mutex_ must be held */
+            void store_destinations(std::shared_ptr<std::vector<uvgrtp::fanout_destination>> destinations);
+
+            /* Set the SSRC of the RTP header of "packet" to "ssrc" (network byte order) and add "offset"
+             * to its sequence number and to the sequence number base of a repair packet of FEC */
+            void rewrite_header(uvgrtp::buf_vec& packet, uint32_t ssrc, uint16_t offset);
+
+            /* Give "packets" to the socket for "destination" without the packet handlers */
+            rtp_error_t send_to(const uvgrtp::fanout_destination& destination, uvgrtp::pkt_vec& packets);
+
+            /* Sending the frame failed, see set_path_mtu() */
+            void send_failed();
+
+            /* The active transaction has been sent, see set_twcc() and set_packet_history() */
+            void packets_sent(sockaddr_in& addr, sockaddr_in6& addr6,
+                std::chrono::steady_clock::time_point send_start, std::chrono::nanoseconds spacing);
 
             inline std::chrono::high_resolution_clock::time_point this_frame_time();
 
@@ -173,6 +576,9 @@ namespace uvgrtp {
 
             transaction_t *active_;
 
+            /* Transactions that have been sent and wait to be reused, at most TRANSACTION_POOL_SIZE */
+            std::vector<transaction_t *> pool_;
+
             /* Deallocation hook is stored here and copied to transaction upon initialization */
             void (*dealloc_hook_)(void *);
 
@@ -184,6 +590,11 @@ namespace uvgrtp {
 
             int rce_flags_;
 
+            /* The fragment_kernel() of "rce_flags_" and the length of the authentication tag of
+             * RCE_SRTP_AUTHENTICATE_RTP, zero without it */
+            rtp_error_t (frame_queue::*fragment_kernel_)(uint8_t *, size_t, uint8_t *, size_t, size_t, size_t);
+            size_t auth_tag_len_;
+
             bool fps_ = false;
             std::chrono::nanoseconds frame_interval_;
 
@@ -191,6 +602,94 @@ namespace uvgrtp {
             uint64_t frames_since_sync_ = 0;
 
             bool force_sync_ = false;
+
+            std::shared_ptr<uvgrtp::pacer> pacer_;
+            uvgrtp::pacing_bucket pacing_;
+
+            /* The frame being paced after flush_queue() has returned, see defer_pacing() */
+            bool defer_pacing_ = false;
+            bool deferred_ = false;
+            uvgrtp::pacer::job deferred_job_;
+            sockaddr_in deferred_addr_ = {};
+            sockaddr_in6 deferred_addr6_ = {};
+            std::chrono::steady_clock::time_point deferred_start_;
+            std::chrono::nanoseconds deferred_spacing_ = std::chrono::nanoseconds(0);
+            std::shared_ptr<const std::vector<uvgrtp::fanout_destination>> deferred_destinations_;
+
+            /* Cleared if setting SO_MAX_PACING_RATE fails, see send_kernel_paced() */
+            bool max_pacing_rate_supported_ = true;
+
+            /* The header extension of the sent packets and the size of the header slots it
+             * needs, see transaction_t */
+            uvgrtp::header_extensions extensions_;
+            size_t header_stride_ = RTP_HDR_SIZE;
+
+            /* The frame marking of the active transaction and the audio level, see set_frame_marking()
+             * and set_audio_level() */
+            uint8_t frame_marking_[2] = {};
+            std::atomic<uint8_t> audio_level_{127};
+
+            /* Transport-wide congestion control, see set_twcc(). The sequence number of the packet
+             * being built is written to "twcc_ext_" by end_packet() when the size of the packet is known */
+            std::shared_ptr<uvgrtp::twcc_sender> twcc_;
+            uint8_t *twcc_ext_ = nullptr;
+
+            /* The packets are copied after sending, when SRTP has encrypted them in place */
+            std::shared_ptr<uvgrtp::packet_history> history_;
+
+            uint8_t fec_payload_type_ = 0;
+            int fec_overhead_ = uvgrtp::DEFAULT_FEC_OVERHEAD;
+
+            std::shared_ptr<uvgrtp::stream_metrics> metrics_;
+
+            /* Set while a frame sampled by RCC_PROFILE_SAMPLING is sent. "profile_start_" is the
+             * start of the stage being timed and "fanout_time_" the time spent in send_fanout() */
+            bool profiled_ = false;
+            std::chrono::steady_clock::time_point profile_start_;
+            std::chrono::steady_clock::duration fanout_time_ = std::chrono::steady_clock::duration(0);
+
+            /* RCC_PATH_MTU_DISCOVERY, replaced with std::atomic_store while frames are sent */
+            std::shared_ptr<uvgrtp::path_mtu> path_mtu_;
+
+            /* The paths of set_paths(), replaced as a whole with std::atomic_store. The state of the
+             * weighted round robin is kept for "state_paths_", the paths it was built for: the current
+             * weight and credit of each path and the feedback counted for it so far */
+            struct path_state {
+                double weight = 0;
+                double credit = 0;
+                int64_t base_delay_us = -1;
+                uvgrtp::twcc_sender::path_feedback feedback;
+            };
+
+            std::shared_ptr<const std::vector<uvgrtp::send_path>> paths_;
+            std::shared_ptr<const std::vector<uvgrtp::send_path>> state_paths_;
+            std::vector<path_state> path_state_;
+            std::vector<uvgrtp::pkt_vec> path_packets_;
+            std::vector<uvgrtp::twcc_sender::path_feedback> path_feedback_;
+
+            /* The destinations of add_destination(), replaced as a whole with std::atomic_store so
+             * that a frame being sent keeps the list it loaded. "fanout_mutex_" serializes the writers */
+            std::shared_ptr<const std::vector<uvgrtp::fanout_destination>> fanout_;
+            std::mutex fanout_mutex_;
+
+            // some destination has layer limits, see set_destination_layers()
+            std::atomic<bool> layer_filtering_{false};
+
+            /* The GOP cache of set_gop_cache(): the frames from the last key frame on, their size in
+             * bytes and the number of the next frame. "gop_overflow_" is set when the GOP outgrew
+             * "gop_limit_" and the frames are not cached until the next key frame */
+            std::vector<std::shared_ptr<const uvgrtp::gop_frame>> gop_;
+            size_t gop_bytes_ = 0;
+            uint64_t gop_frames_ = 0;
+            bool gop_overflow_ = false;
+            std::atomic<size_t> gop_limit_{0};
+            std::mutex gop_mutex_;
+
+            /* The packet of prepare_single(): its RTP header and header extension, authentication tag
+             * and buffer vector */
+            uint8_t single_header_[RTP_HDR_SIZE + uvgrtp::MAX_HEADER_EXTENSION_SIZE] = {};
+            std::vector<uint8_t> single_tag_;
+            uvgrtp::buf_vec single_packet_;
     };
 }
 
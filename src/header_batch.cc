@@ -0,0 +1,146 @@
+#include "header_batch.hh"
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UVGRTP_HEADERS_X86 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define UVGRTP_HEADERS_NEON 1
+#include <arm_neon.h>
+#endif
+
+constexpr size_t RTP_FIXED_HEADER_SIZE = 12;
+
+static inline uint32_t read_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+/* Fill the fields of packet "i" from the first word of its header in host order and
+ * check that its CSRCs and header extension fit into the packet */
+static inline void finish_header(uvgrtp::header_batch& batch, size_t i, uint32_t first,
+    const uint8_t *packet, size_t size)
+{
+    uint8_t flags   = (uint8_t)(first >> 24);
+    uint8_t version = flags >> 6;
+
+    batch.version[i] = version;
+    batch.marker[i]  = (first >> 23) & 0x01;
+    batch.payload[i] = (first >> 16) & 0x7f;
+    batch.seq[i]     = (uint16_t)(first & 0xffff);
+
+    size_t header_size = RTP_FIXED_HEADER_SIZE + (flags & 0x0f) * sizeof(uint32_t);
+
+    if (version != 0x2 || header_size > size) {
+        batch.header_size[i] = 0;
+        return;
+    }
+
+    if (flags & 0x10) {
+        if (header_size + 4 > size) {
+            batch.header_size[i] = 0;
+            return;
+        }
+        header_size += 4 + (((size_t)packet[header_size + 2] << 8) | packet[header_size + 3]) * sizeof(uint32_t);
+    }
+
+    batch.header_size[i] = (header_size <= size && header_size <= UINT16_MAX) ? (uint16_t)header_size : 0;
+}
+
+static inline void parse_scalar(uvgrtp::header_batch& batch, size_t i, const uint8_t *packet, size_t size)
+{
+    if (size < RTP_FIXED_HEADER_SIZE) {
+        batch.ssrc[i]        = 0;
+        batch.timestamp[i]   = 0;
+        batch.seq[i]         = 0;
+        batch.version[i]     = 0;
+        batch.marker[i]      = 0;
+        batch.payload[i]     = 0;
+        batch.header_size[i] = 0;
+        return;
+    }
+
+    batch.timestamp[i] = read_be32(packet + 4);
+    batch.ssrc[i]      = read_be32(packet + 8);
+    finish_header(batch, i, read_be32(packet), packet, size);
+}
+
+#ifdef UVGRTP_HEADERS_X86
+// byte swap the four words of "x": swap the bytes of each half and then the halves
+static inline __m128i bswap32_sse2(__m128i x)
+{
+    __m128i halves = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(halves, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+/* Parse four packets of at least 16 bytes: the first four words of each packet are transposed so
+ * that each register holds the same word of the four packets, and the words are swapped at once */
+static void parse_four_sse2(uvgrtp::header_batch& batch, size_t i, uint8_t *const *packets, const size_t *sizes)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)packets[0]);
+    __m128i r1 = _mm_loadu_si128((const __m128i *)packets[1]);
+    __m128i r2 = _mm_loadu_si128((const __m128i *)packets[2]);
+    __m128i r3 = _mm_loadu_si128((const __m128i *)packets[3]);
+
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+    __m128i first = bswap32_sse2(_mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *)&batch.timestamp[i], bswap32_sse2(_mm_unpackhi_epi64(t0, t1)));
+    _mm_storeu_si128((__m128i *)&batch.ssrc[i],      bswap32_sse2(_mm_unpacklo_epi64(t2, t3)));
+
+    uint32_t words[4];
+    _mm_storeu_si128((__m128i *)words, first);
+
+    for (size_t k = 0; k < 4; ++k) {
+        finish_header(batch, i + k, words[k], packets[k], sizes[k]);
+    }
+}
+#endif
+
+#ifdef UVGRTP_HEADERS_NEON
+static void parse_one_neon(uvgrtp::header_batch& batch, size_t i, const uint8_t *packet, size_t size)
+{
+    uint32_t words[4];
+    vst1q_u32(words, vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(packet))));
+
+    batch.timestamp[i] = words[1];
+    batch.ssrc[i]      = words[2];
+    finish_header(batch, i, words[0], packet, size);
+}
+#endif
+
+void uvgrtp::parse_headers(uint8_t *const *packets, const size_t *sizes, size_t count, header_batch& batch)
+{
+    if (count > MAX_HEADER_BATCH)
+        count = MAX_HEADER_BATCH;
+
+    size_t i = 0;
+
+#ifdef UVGRTP_HEADERS_X86
+    for (; i + 4 <= count; i += 4) {
+        if (sizes[i] >= 16 && sizes[i + 1] >= 16 && sizes[i + 2] >= 16 && sizes[i + 3] >= 16) {
+            parse_four_sse2(batch, i, &packets[i], &sizes[i]);
+        } else {
+            for (size_t k = i; k < i + 4; ++k) {
+                parse_scalar(batch, k, packets[k], sizes[k]);
+            }
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+#ifdef UVGRTP_HEADERS_NEON
+        if (sizes[i] >= 16) {
+            parse_one_neon(batch, i, packets[i], sizes[i]);
+            continue;
+        }
+#endif
+        parse_scalar(batch, i, packets[i], sizes[i]);
+    }
+
+    batch.count = count;
+}
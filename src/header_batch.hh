@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace uvgrtp {
+
+    /* Most packets parsed into one header_batch */
+    constexpr size_t MAX_HEADER_BATCH = 64;
+
+    /* The fixed header fields of a batch of received packets as a structure of arrays, RFC 3550 section 5.1
+     *
+     * The packets of a batch are parsed in one go before any of them is handled, so that the demultiplexing
+     * and the statistics of the batch read the SSRCs and the other fields from these arrays instead of
+     * parsing the header of each packet where it is needed. The three words of the fixed header are
+     * loaded and byte swapped four packets at a time with SSE2, or one packet at a time with NEON.
+     *
+     * The fields are filled for every packet of at least 12 bytes, whatever protocol it is, so the RTCP
+     * SSRC and the ZRTP magic cookie are found in "timestamp". The fields of shorter packets are zero */
+    struct header_batch {
+        size_t count = 0;
+
+        uint32_t ssrc[MAX_HEADER_BATCH];      // octets 8-11
+        uint32_t timestamp[MAX_HEADER_BATCH]; // octets 4-7
+        uint16_t seq[MAX_HEADER_BATCH];
+        uint8_t  version[MAX_HEADER_BATCH];
+        uint8_t  marker[MAX_HEADER_BATCH];
+        uint8_t  payload[MAX_HEADER_BATCH];   // the payload type, or the packet type of RTCP with the marker
+
+        /* The size of the RTP header with the CSRCs and the header extension. Zero if the packet is not
+         * a valid RTP packet: too short, not version 2 or with CSRCs or an extension that do not fit.
+         * The padding is not checked here, because the last byte of an SRTP packet is encrypted */
+        uint16_t header_size[MAX_HEADER_BATCH];
+    };
+
+    /* Parse the headers of "count" packets, at most MAX_HEADER_BATCH, to "batch". A packet of at
+     * least 16 bytes may be read as 16 bytes even if its header is shorter */
+    void parse_headers(uint8_t *const *packets, const size_t *sizes, size_t count, header_batch& batch);
+}
+
+namespace uvg_rtp = uvgrtp;
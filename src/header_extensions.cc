@@ -0,0 +1,195 @@
+#include "header_extensions.hh"
+
+#include <cstring>
+
+/* The profiles of the one-byte and the two-byte header forms, RFC 8285 sections 4.2 and 4.3.
+ * The low four bits of the two-byte profile are application bits */
+constexpr uint16_t ONE_BYTE_HEADER_PROFILE = 0xbede;
+constexpr uint16_t TWO_BYTE_HEADER_PROFILE = 0x1000;
+
+/* The largest ID of the one-byte form, 15 is reserved */
+constexpr uint8_t MAX_ONE_BYTE_ID = 14;
+
+static size_t value_length(uvgrtp::HEADER_EXTENSION extension, bool long_frame_marking,
+    const std::string& mid, const std::string& rid)
+{
+    switch (extension) {
+        case uvgrtp::EXT_ABS_SEND_TIME:      return 3;
+        case uvgrtp::EXT_TRANSPORT_WIDE_SEQ: return 2;
+        case uvgrtp::EXT_AUDIO_LEVEL:        return 1;
+        case uvgrtp::EXT_FRAME_MARKING:      return long_frame_marking ? 2 : 1;
+        case uvgrtp::EXT_MID:                return mid.size();
+        case uvgrtp::EXT_RID:                return rid.size();
+        default:                             return 0;
+    }
+}
+
+void uvgrtp::write_abs_send_time(uint8_t *value, uint64_t ntp)
+{
+    // the six lowest bits of the seconds and the 18 highest bits of the fraction
+    uint32_t time = (uint32_t)(ntp >> 14) & 0xffffff;
+
+    value[0] = (uint8_t)(time >> 16);
+    value[1] = (uint8_t)(time >> 8);
+    value[2] = (uint8_t)(time & 0xff);
+}
+
+const uint8_t *uvgrtp::find_header_extension(const uvgrtp::frame::ext_header *ext, uint8_t id, size_t& len)
+{
+    if (!ext || !ext->data || id == 0)
+        return nullptr;
+
+    bool one_byte = ext->type == ONE_BYTE_HEADER_PROFILE;
+
+    if (!one_byte && (ext->type & 0xfff0) != TWO_BYTE_HEADER_PROFILE)
+        return nullptr;
+
+    size_t i = 0;
+    while (i < ext->len) {
+        uint8_t byte = ext->data[i];
+
+        // padding between the elements
+        if (byte == 0) {
+            ++i;
+            continue;
+        }
+
+        uint8_t element_id = 0;
+        size_t  element_len = 0;
+
+        if (one_byte) {
+            // the length field of an element is its length minus one and ID 15 ends the extension
+            element_id  = byte >> 4;
+            element_len = (byte & 0x0f) + 1;
+
+            if (element_id == 15)
+                return nullptr;
+            ++i;
+        } else {
+            if (i + 2 > ext->len)
+                return nullptr;
+
+            element_id  = byte;
+            element_len = ext->data[i + 1];
+            i += 2;
+        }
+
+        if (i + element_len > ext->len)
+            return nullptr;
+
+        if (element_id == id) {
+            len = element_len;
+            return &ext->data[i];
+        }
+        i += element_len;
+    }
+
+    return nullptr;
+}
+
+uvgrtp::header_extensions::header_extensions():
+    ids_(),
+    long_frame_marking_(false),
+    mid_(),
+    rid_(),
+    layout_(),
+    size_(0),
+    offsets_()
+{
+}
+
+rtp_error_t uvgrtp::header_extensions::set_id(HEADER_EXTENSION extension, uint8_t id)
+{
+    if (extension >= EXT_COUNT)
+        return RTP_INVALID_VALUE;
+
+    for (int i = 0; i < EXT_COUNT; ++i) {
+        if (id != 0 && i != extension && ids_[i] == id)
+            return RTP_INVALID_VALUE;
+    }
+
+    ids_[extension] = id;
+    update();
+
+    return RTP_OK;
+}
+
+uint8_t uvgrtp::header_extensions::get_id(HEADER_EXTENSION extension) const
+{
+    return (extension < EXT_COUNT) ? ids_[extension] : 0;
+}
+
+rtp_error_t uvgrtp::header_extensions::set_value(HEADER_EXTENSION extension, const std::string& value)
+{
+    if (value.size() > MAX_HEADER_EXTENSION_STRING)
+        return RTP_INVALID_VALUE;
+
+    if (extension == EXT_MID) {
+        mid_ = value;
+    } else if (extension == EXT_RID) {
+        rid_ = value;
+    } else {
+        return RTP_INVALID_VALUE;
+    }
+
+    update();
+    return RTP_OK;
+}
+
+void uvgrtp::header_extensions::set_long_frame_marking(bool long_form)
+{
+    long_frame_marking_ = long_form;
+    update();
+}
+
+void uvgrtp::header_extensions::update()
+{
+    bool two_byte = false;
+    bool any      = false;
+
+    for (int i = 0; i < EXT_COUNT; ++i) {
+        if (!value_length((HEADER_EXTENSION)i, long_frame_marking_, mid_, rid_))
+            continue;
+
+        two_byte |= ids_[i] > MAX_ONE_BYTE_ID;
+        any      |= ids_[i] != 0;
+    }
+
+    std::memset(layout_, 0, sizeof(layout_));
+    std::memset(offsets_, 0, sizeof(offsets_));
+    size_ = 0;
+
+    if (!any)
+        return;
+
+    uint16_t profile = two_byte ? TWO_BYTE_HEADER_PROFILE : ONE_BYTE_HEADER_PROFILE;
+    size_t pos = 4;
+
+    for (int i = 0; i < EXT_COUNT; ++i) {
+        size_t len = value_length((HEADER_EXTENSION)i, long_frame_marking_, mid_, rid_);
+
+        if (!ids_[i] || !len)
+            continue;
+
+        if (two_byte) {
+            layout_[pos++] = ids_[i];
+            layout_[pos++] = (uint8_t)len;
+        } else {
+            layout_[pos++] = (uint8_t)((ids_[i] << 4) | (len - 1));
+        }
+
+        offsets_[i] = pos;
+
+        if (i == EXT_MID || i == EXT_RID)
+            std::memcpy(&layout_[pos], (i == EXT_MID) ? mid_.data() : rid_.data(), len);
+        pos += len;
+    }
+
+    // the extension is padded with zero bytes to whole words, its length is given in words
+    size_ = (pos + 3) & ~(size_t)3;
+
+    layout_[0] = (uint8_t)(profile >> 8);
+    layout_[1] = (uint8_t)(profile & 0xff);
+    layout_[2] = (uint8_t)(((size_ - 4) / 4) >> 8);
+    layout_[3] = (uint8_t)(((size_ - 4) / 4) & 0xff);
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "uvgrtp/frame.hh"
+#include "uvgrtp/util.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace uvgrtp {
+
+    /* RTP header extensions of the sent packets, RFC 8285
+     *
+     * The elements of a stream are registered with their IDs and laid out once, so that every packet
+     * carries the same extension with the elements at fixed offsets. The send path copies the layout
+     * behind the RTP header of each packet and only stores the values. The one-byte header form is
+     * used while all IDs are at most 14 and the two-byte form if some ID is larger. */
+
+    enum HEADER_EXTENSION {
+        EXT_ABS_SEND_TIME      = 0, /* 6.18 fixed point NTP send time, see webrtc.org/experiments/rtp-hdrext/abs-send-time */
+        EXT_TRANSPORT_WIDE_SEQ = 1, /* Transport-wide sequence number, see twcc.hh */
+        EXT_AUDIO_LEVEL        = 2, /* Audio level and voice activity, see RFC 6464 */
+        EXT_FRAME_MARKING      = 3, /* Frame marking, see RFC 9626 */
+        EXT_MID                = 4, /* Media identification of BUNDLE, see RFC 8843 section 15.1 */
+        EXT_RID                = 5, /* RTP stream identifier, see RFC 8852 */
+        EXT_COUNT              = 6
+    };
+
+    /* The longest MID and RID, the most the one-byte form can carry */
+    constexpr size_t MAX_HEADER_EXTENSION_STRING = 16;
+
+    /* The largest extension of the send path: the extension header and the two-byte headers
+     * and values of all elements, padded to whole words */
+    constexpr size_t MAX_HEADER_EXTENSION_SIZE = 56;
+
+    /* The bits of the first byte of the frame marking element, RFC 9626 section 3 */
+    constexpr uint8_t FRAME_MARKING_START       = 0x80;
+    constexpr uint8_t FRAME_MARKING_END         = 0x40;
+    constexpr uint8_t FRAME_MARKING_INDEPENDENT = 0x20;
+    constexpr uint8_t FRAME_MARKING_DISCARDABLE = 0x10;
+    constexpr uint8_t FRAME_MARKING_BASE_SYNC   = 0x08;
+
+    /* The temporal ID in the low three bits of the first byte, zero in the short form */
+    constexpr uint8_t FRAME_MARKING_TID_MASK    = 0x07;
+
+    /* The largest temporal ID of the frame marking and the largest nuh_layer_id of H.265 and H.266 */
+    constexpr uint8_t MAX_TEMPORAL_ID           = 7;
+    constexpr uint8_t MAX_LAYER_ID              = 63;
+
+    /* Write the abs-send-time value of the NTP timestamp "ntp" to the three bytes of "value" */
+    void write_abs_send_time(uint8_t *value, uint64_t ntp);
+
+    /* Find the element "id" from the header extension "ext" of a received packet, in either the
+     * one-byte or the two-byte form
+     *
+     * Return a pointer to the data of the element and set "len" to its length on success
+     * Return nullptr if the extension has no such element */
+    const uint8_t *find_header_extension(const uvgrtp::frame::ext_header *ext, uint8_t id, size_t& len);
+
+    class header_extensions {
+        public:
+            header_extensions();
+
+            /* Add the element "extension" to each packet with the ID "id", or remove it with a zero "id"
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if another element already has "id" */
+            rtp_error_t set_id(HEADER_EXTENSION extension, uint8_t id);
+
+            /* Return the ID of "extension", zero if it is not sent */
+            uint8_t get_id(HEADER_EXTENSION extension) const;
+
+            /* Set the value of the MID or RID element, which is the same in every packet. The element
+             * is left out while its value is empty
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "extension" has no string value or "value" is too long */
+            rtp_error_t set_value(HEADER_EXTENSION extension, const std::string& value);
+
+            /* Send the two-byte long form of frame marking with the temporal and layer IDs of
+             * H.265 and H.266 instead of the one-byte short form */
+            void set_long_frame_marking(bool long_form);
+
+            bool long_frame_marking() const
+            {
+                return long_frame_marking_;
+            }
+
+            /* Return the size of the extension in bytes behind the RTP header, a multiple of four.
+             * Zero if no element is sent */
+            size_t size() const
+            {
+                return size_;
+            }
+
+            /* Return the extension with the headers of the elements and zero values */
+            const uint8_t *layout() const
+            {
+                return layout_;
+            }
+
+            /* Return the offset of the value of "extension" in the extension, zero if it is not sent */
+            size_t offset(HEADER_EXTENSION extension) const
+            {
+                return offsets_[extension];
+            }
+
+        private:
+            /* Lay out the elements again after a change */
+            void update();
+
+            uint8_t ids_[EXT_COUNT];
+            bool long_frame_marking_;
+
+            /* The values of the MID and RID elements, laid out with the element headers */
+            std::string mid_;
+            std::string rid_;
+
+            uint8_t layout_[MAX_HEADER_EXTENSION_SIZE];
+            size_t size_;
+            size_t offsets_[EXT_COUNT];
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
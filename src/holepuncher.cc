@@ -2,19 +2,24 @@
 
 #include "uvgrtp/clock.hh"
 
-#include "socket.hh"
+#include "rtcp_scheduler.hh"
 #include "debug.hh"
 
+#include <algorithm>
 
-#define THRESHOLD 2000
-
-uvgrtp::holepuncher::holepuncher(std::shared_ptr<uvgrtp::socket> socket):
+uvgrtp::holepuncher::holepuncher(std::shared_ptr<uvgrtp::socket> socket,
+    std::shared_ptr<uvgrtp::keepalive_timer> timer):
     socket_(socket),
+    timer_(timer),
     last_dgram_sent_(0),
     remote_sockaddr_({}),
     remote_sockaddr_ip6_({}),
+    payload_(0b11000000),
+    datagram_(),
     active_(false)
-{}
+{
+    datagram_.push_back({ 1, &payload_ });
+}
 
 uvgrtp::holepuncher::~holepuncher()
 {
@@ -23,17 +28,23 @@ uvgrtp::holepuncher::~holepuncher()
 
 rtp_error_t uvgrtp::holepuncher::start()
 {
-    active_ = true;
-    runner_ = std::unique_ptr<std::thread> (new std::thread(&uvgrtp::holepuncher::keepalive, this));
+    if (!timer_)
+        return RTP_NOT_INITIALIZED;
+
+    if (!active_) {
+        UVG_LOG_DEBUG("Starting holepuncher");
+        active_ = true;
+        timer_->add(this);
+    }
     return RTP_OK;
 }
 
 rtp_error_t uvgrtp::holepuncher::stop()
 {
-    active_ = false;
-    if (runner_ && runner_->joinable())
-    {
-        runner_->join();
+    if (active_) {
+        UVG_LOG_DEBUG("Stopping holepuncher");
+        timer_->remove(this);
+        active_ = false;
     }
     return RTP_OK;
 }
@@ -45,31 +56,91 @@ rtp_error_t uvgrtp::holepuncher::set_remote_address(sockaddr_in& addr, sockaddr_
     return RTP_OK;
 }
 
-
 void uvgrtp::holepuncher::notify()
 {
     last_dgram_sent_ = uvgrtp::clock::ntp::now();
 }
 
-void uvgrtp::holepuncher::keepalive()
+uvgrtp::keepalive_timer::keepalive_timer(std::shared_ptr<uvgrtp::rtcp_scheduler> scheduler):
+    scheduler_(scheduler),
+    punchers_(),
+    groups_(),
+    timer_(0)
+{
+}
+
+uvgrtp::keepalive_timer::~keepalive_timer()
+{
+    if (timer_)
+        scheduler_->remove(timer_);
+}
+
+void uvgrtp::keepalive_timer::add(uvgrtp::holepuncher *puncher)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    punchers_.push_back(puncher);
+
+    if (!timer_)
+        timer_ = scheduler_->add([this]() { return check(); }, KEEPALIVE_CHECK_MS);
+}
+
+void uvgrtp::keepalive_timer::remove(uvgrtp::holepuncher *puncher)
 {
-    UVG_LOG_DEBUG("Starting holepuncher");
+    uint64_t timer = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        punchers_.erase(std::remove(punchers_.begin(), punchers_.end(), puncher), punchers_.end());
+
+        if (punchers_.empty()) {
+            timer  = timer_;
+            timer_ = 0;
+        }
+    }
+
+    // a check that is running waits for the mutex, so the timer is removed without it
+    if (timer)
+        scheduler_->remove(timer);
+}
+
+uint32_t uvgrtp::keepalive_timer::check()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
 
     /* RFC 6263 https://datatracker.ietf.org/doc/html/rfc6263
      * The RFC above describes several methods of implementing keep-alive. One of them (described in section 4.1) is
      * sending empty (0-Byte) packets, which is implemented here.
      * Another method (section 4.3) is multiplexing RTCP and RTP packets into a single socket, which keeps the connection
-     * alive at all times with RTCP packets. This will be implemented into uvgRTP in the future. */
-    while (active_) {
-        if (uvgrtp::clock::ntp::diff_now(last_dgram_sent_) < THRESHOLD) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+     * alive at all times with RTCP packets. */
+    uint64_t now = uvgrtp::clock::ntp::now();
+
+    for (auto puncher : punchers_) {
+        if (uvgrtp::clock::ntp::diff_now(puncher->last_dgram_sent_) < KEEPALIVE_THRESHOLD_MS)
             continue;
+
+        groups_[puncher->socket_.get()].packets.push_back(
+            { &puncher->datagram_, &puncher->remote_sockaddr_, &puncher->remote_sockaddr_ip6_ });
+        puncher->last_dgram_sent_ = now;
+    }
+
+    for (auto it = groups_.begin(); it != groups_.end();) {
+        group& g = it->second;
+
+        // the socket of a group that was not used in this check may have been destroyed
+        if (g.packets.empty()) {
+            it = groups_.erase(it);
+            continue;
+        }
+
+        UVG_LOG_DEBUG("Sending %zu keep-alives", g.packets.size());
+        if (it->first->sendto_each(g.packets, g.arrays) != RTP_OK) {
+            UVG_LOG_DEBUG("Failed to send the keep-alives");
         }
 
-        UVG_LOG_DEBUG("Sending keep-alive");
-        uint8_t payload = 0b11000000;
-        socket_->sendto(remote_sockaddr_, remote_sockaddr_ip6_, &payload, 1, 0);
-        last_dgram_sent_ = uvgrtp::clock::ntp::now();
+        g.packets.clear();
+        ++it;
     }
-    UVG_LOG_DEBUG("Stopping holepuncher");
+
+    return KEEPALIVE_CHECK_MS;
 }
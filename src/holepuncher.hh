@@ -1,10 +1,14 @@
 #pragma once
 
+#include "socket.hh"
+
 #include "uvgrtp/util.hh"
 
 #include <atomic>
 #include <memory>
-#include <thread>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #ifdef _WIN32
 #include <ws2def.h>
 #include <ws2ipdef.h>
@@ -14,20 +18,21 @@
 
 namespace uvgrtp {
 
-    class socket;
+    class rtcp_scheduler;
+    class keepalive_timer;
 
     class holepuncher {
         public:
-            holepuncher(std::shared_ptr<uvgrtp::socket> socket);
+            holepuncher(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::keepalive_timer> timer);
             ~holepuncher();
 
-            /* Create new thread object and start the holepuncher
+            /* Start sending the keep-alive datagrams with the timer of the context
              *
              * Return RTP_OK on success
-             * Return RTP_MEMORY_ERROR if allocation fails */
+             * Return RTP_NOT_INITIALIZED if the holepuncher has no timer */
             rtp_error_t start();
 
-            /* Stop the holepuncher */
+            /* Stop the holepuncher. When this returns, the timer does not use the holepuncher anymore */
             rtp_error_t stop();
             rtp_error_t set_remote_address(sockaddr_in& addr, sockaddr_in6& addr6);
 
@@ -36,15 +41,58 @@ namespace uvgrtp {
             void notify();
 
         private:
-            void keepalive();
+            friend class keepalive_timer;
 
             std::shared_ptr<uvgrtp::socket> socket_;
+            std::shared_ptr<uvgrtp::keepalive_timer> timer_;
             std::atomic<uint64_t> last_dgram_sent_;
             sockaddr_in remote_sockaddr_;
             sockaddr_in6 remote_sockaddr_ip6_;
 
+            /* The one-byte keep-alive datagram */
+            uint8_t payload_;
+            uvgrtp::buf_vec datagram_;
+
             bool active_;
-            std::unique_ptr<std::thread> runner_;
+    };
+
+    /* Sends the keep-alive datagrams of all the holepunchers of a context with one timer of the
+     * RTCP scheduler instead of a thread for each stream. Every KEEPALIVE_CHECK_MS the timer finds
+     * the holepunchers whose streams have not sent anything for KEEPALIVE_THRESHOLD_MS, and the
+     * datagrams of the holepunchers that share a socket are sent with one socket::sendto_each().
+     * The timer is removed from the scheduler while there are no holepunchers */
+    class keepalive_timer {
+        public:
+            keepalive_timer(std::shared_ptr<uvgrtp::rtcp_scheduler> scheduler);
+            ~keepalive_timer();
+
+            void add(uvgrtp::holepuncher *puncher);
+
+            /* Forget "puncher". When this returns, its datagram is not being sent */
+            void remove(uvgrtp::holepuncher *puncher);
+
+            static constexpr uint32_t KEEPALIVE_CHECK_MS     = 500;
+            static constexpr uint32_t KEEPALIVE_THRESHOLD_MS = 2000;
+
+        private:
+            struct group {
+                std::vector<uvgrtp::addressed_packet> packets;
+                uvgrtp::send_arrays arrays;
+            };
+
+            /* Send the datagrams that are due, called by the scheduler */
+            uint32_t check();
+
+            std::shared_ptr<uvgrtp::rtcp_scheduler> scheduler_;
+
+            std::mutex mutex_;
+            std::vector<uvgrtp::holepuncher *> punchers_;
+
+            /* The datagrams of one check by the socket they are sent from, kept between the checks */
+            std::unordered_map<uvgrtp::socket *, group> groups_;
+
+            /* The ID of the timer of the scheduler, 0 while there is none */
+            uint64_t timer_;
     };
 }
 
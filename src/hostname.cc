@@ -12,8 +12,28 @@
 #include <errno.h>
 #endif
 
+#include <algorithm>
+#include <cstdlib>
+
 #define NAME_MAXLEN 512
 
+static inline std::string generate_string(size_t length)
+{
+    auto randchar = []() -> char
+    {
+        const char charset[] =
+            "0123456789"
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+            "abcdefghijklmnopqrstuvwxyz";
+        const size_t max_index = (sizeof(charset) - 1);
+        return charset[rand() % max_index];
+    };
+
+    std::string str(length, 0);
+    std::generate_n(str.begin(), length, randchar);
+    return str;
+}
+
 std::string uvgrtp::hostname::get_hostname()
 {
 #ifdef _WIN32
@@ -59,3 +79,17 @@ std::string uvgrtp::hostname::get_username()
     return std::string(username);
 #endif
 }
+
+std::string uvgrtp::hostname::generate_cname()
+{
+    std::string host = uvgrtp::hostname::get_hostname();
+    std::string user = uvgrtp::hostname::get_username();
+
+    if (host == "")
+        host = generate_string(10);
+
+    if (user == "")
+        user = generate_string(10);
+
+    return host + "@" + user;
+}
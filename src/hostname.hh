@@ -6,6 +6,10 @@ namespace uvgrtp {
     namespace hostname {
         std::string get_hostname();
         std::string get_username();
+
+        /* Generate a CNAME from the host and login names, a random string stands in for
+         * the names that cannot be found */
+        std::string generate_cname();
     }
 }
 
@@ -0,0 +1,165 @@
+#include "impaired_link.hh"
+
+#include "debug.hh"
+
+#include <algorithm>
+#include <cstring>
+
+uvgrtp::impaired_link::impaired_link(const uvgrtp::impairment& config, uint64_t seed, output out) :
+    config_(config),
+    out_(std::move(out)),
+    random_(seed),
+    timed_(config.delay_us > 0 || config.jitter_us > 0 || config.reorder > 0 || config.rate_kbps > 0),
+    link_free_(std::chrono::steady_clock::now())
+{
+    if (timed_)
+        thread_ = std::thread(&uvgrtp::impaired_link::release, this);
+}
+
+uvgrtp::impaired_link::~impaired_link()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_one();
+
+    if (thread_.joinable())
+        thread_.join();
+}
+
+double uvgrtp::impaired_link::uniform()
+{
+    return (double)(random_() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+bool uvgrtp::impaired_link::chance(double probability)
+{
+    // no number is drawn for the conditions that are not set, so adding one does not change the others
+    if (probability <= 0)
+        return false;
+
+    return uniform() < probability;
+}
+
+bool uvgrtp::impaired_link::lose()
+{
+    if (bad_)
+        bad_ = !chance(config_.bad_to_good);
+    else
+        bad_ = chance(config_.good_to_bad);
+
+    return chance(bad_ ? config_.loss_bad : config_.loss_good);
+}
+
+void uvgrtp::impaired_link::submit(const struct sockaddr *sender, socklen_t sender_len,
+    const std::vector<std::pair<size_t, uint8_t *>>& buffers)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (lose())
+        return;
+
+    int copies = chance(config_.duplicate) ? 2 : 1;
+
+    if (!timed_) {
+        lock.unlock();
+
+        for (int i = 0; i < copies; ++i) {
+            if (!out_(sender, sender_len, buffers)) {
+                UVG_LOG_DEBUG("The receiver of the impaired link is full, a datagram was dropped");
+            }
+        }
+        return;
+    }
+
+    size_t length = 0;
+    for (auto& buffer : buffers) {
+        length += buffer.first;
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    bool notify = false;
+
+    for (int i = 0; i < copies; ++i) {
+        // the random delays are drawn before the rate limit, which depends on the clock, may drop the datagram
+        std::chrono::steady_clock::time_point due = now;
+        std::chrono::nanoseconds delay = std::chrono::microseconds(config_.delay_us);
+
+        if (config_.jitter_us)
+            delay += std::chrono::nanoseconds((int64_t)(uniform() * config_.jitter_us * 1000));
+
+        if (chance(config_.reorder))
+            delay += std::chrono::microseconds(config_.reorder_delay_us);
+
+        if (config_.rate_kbps) {
+            // the datagram waits for the ones before it to leave the link, or is dropped if the queue is too long
+            std::chrono::steady_clock::time_point start = std::max(now, link_free_);
+            if (start - now > std::chrono::microseconds(config_.queue_us))
+                continue;
+
+            // kilobits per second are bits per millisecond
+            link_free_ = start + std::chrono::nanoseconds((uint64_t)length * 8 * 1000000 / config_.rate_kbps);
+            due = link_free_;
+        }
+
+        due += delay;
+
+        held_datagram held;
+        std::memcpy(&held.sender, sender, std::min((size_t)sender_len, sizeof(held.sender)));
+        held.sender_len = sender_len;
+        held.data.reserve(length);
+
+        for (auto& buffer : buffers) {
+            held.data.insert(held.data.end(), buffer.second, buffer.second + buffer.first);
+        }
+
+        // the thread only has to wake up if the datagram is released before the others
+        notify = notify || line_.empty() || due < line_.begin()->first;
+        line_.emplace(due, std::move(held));
+    }
+
+    lock.unlock();
+
+    if (notify)
+        cond_.notify_one();
+}
+
+void uvgrtp::impaired_link::release()
+{
+    std::vector<held_datagram> due;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (!stop_) {
+        if (line_.empty()) {
+            cond_.wait(lock);
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point first = line_.begin()->first;
+        if (first > std::chrono::steady_clock::now()) {
+            cond_.wait_until(lock, first);
+            continue;
+        }
+
+        // the datagrams of the same time keep the order they were submitted in
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        while (!line_.empty() && line_.begin()->first <= now) {
+            due.push_back(std::move(line_.begin()->second));
+            line_.erase(line_.begin());
+        }
+
+        lock.unlock();
+
+        for (auto& datagram : due) {
+            std::vector<std::pair<size_t, uint8_t *>> buffers = { { datagram.data.size(), datagram.data.data() } };
+
+            if (!out_((const struct sockaddr *)&datagram.sender, datagram.sender_len, buffers)) {
+                UVG_LOG_DEBUG("The receiver of the impaired link is full, a datagram was dropped");
+            }
+        }
+        due.clear();
+
+        lock.lock();
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "uvgrtp/context.hh"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2ipdef.h>
+#include <WS2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* An emulated network link in front of the queue of a memory transport, see
+     * uvgrtp::context::set_impairment().
+     *
+     * The fate of each datagram is decided when it is submitted: the Gilbert-Elliott state of
+     * the link, the loss, the duplication, the time it waits for the rate of the link, the
+     * jitter and the reordering. The decisions are drawn from one generator in the order the
+     * datagrams arrive, so they only depend on the seed and the datagrams. A link without delays
+     * hands the datagrams on right away, otherwise they wait in a delay line ordered by their
+     * release time for the thread of the link, which hands them on when they are due */
+    class impaired_link {
+        public:
+            /* The receiving end of the link, returns false if the datagram could not be taken */
+            typedef std::function<bool(const struct sockaddr *, socklen_t,
+                const std::vector<std::pair<size_t, uint8_t *>>&)> output;
+
+            impaired_link(const uvgrtp::impairment& config, uint64_t seed, output out);
+            ~impaired_link();
+
+            impaired_link(const impaired_link&) = delete;
+            impaired_link& operator=(const impaired_link&) = delete;
+
+            /* Send the datagram made of "buffers" over the link. The datagram is copied if it is
+             * delayed. Lost datagrams are taken as well, like the network would */
+            void submit(const struct sockaddr *sender, socklen_t sender_len,
+                const std::vector<std::pair<size_t, uint8_t *>>& buffers);
+
+        private:
+            struct held_datagram {
+                sockaddr_in6 sender;
+                socklen_t sender_len;
+                std::vector<uint8_t> data;
+            };
+
+            /* A uniform number from [0, 1). The bits are taken straight from the generator, since
+             * the distributions of the standard library differ between the implementations */
+            double uniform();
+            bool chance(double probability);
+
+            /* Decide whether the next datagram is lost, the state of the link changes first */
+            bool lose();
+
+            /* Release the delayed datagrams when they are due */
+            void release();
+
+            const uvgrtp::impairment config_;
+            output out_;
+
+            std::mt19937_64 random_;
+            bool bad_ = false;
+
+            /* True if the datagrams are delayed by the config, so the thread is running */
+            bool timed_;
+
+            /* When the link of "rate_kbps" has sent the datagrams before, it sends the next one after that */
+            std::chrono::steady_clock::time_point link_free_;
+
+            std::mutex mutex_;
+            std::condition_variable cond_;
+            std::multimap<std::chrono::steady_clock::time_point, held_datagram> line_;
+            bool stop_ = false;
+            std::thread thread_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,322 @@
+#include "io_engine.hh"
+
+#include "reception_flow.hh"
+#include "debug.hh"
+#include "threads.hh"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+/* How many events one epoll_wait() call returns at most */
+constexpr int MAX_EPOLL_EVENTS = 64;
+
+/* How often the event loops check whether they should exit */
+constexpr int EVENT_LOOP_TIMEOUT_MS = 100;
+
+/* The worker whose flows the current thread is calling, so that a flow can remove itself */
+static thread_local const void *dispatching_worker = nullptr;
+
+uvgrtp::io_engine::io_engine() :
+    workers_(),
+    fd_to_worker_(),
+    thread_settings_(nullptr),
+    should_stop_(true),
+    active_(false),
+    external_(false)
+{
+}
+
+uvgrtp::io_engine::~io_engine()
+{
+    stop();
+}
+
+rtp_error_t uvgrtp::io_engine::start(size_t workers)
+{
+    std::lock_guard<std::mutex> lg(engine_mutex_);
+
+    if (workers == 0) {
+        UVG_LOG_ERROR("The I/O engine needs at least one worker");
+        return RTP_INVALID_VALUE;
+    }
+
+    if (active_) {
+        return RTP_INITIALIZED;
+    }
+
+    rtp_error_t ret = create_workers(workers);
+    if (ret != RTP_OK) {
+        return ret;
+    }
+
+    should_stop_ = false;
+
+    for (auto& w : workers_) {
+        w->thread = uvgrtp::start_thread(thread_settings_, RTP_THREAD_RECEIVER, -1, &uvgrtp::io_engine::event_loop, this, w.get());
+    }
+
+    UVG_LOG_DEBUG("Started I/O engine with %zu workers", workers);
+    active_ = true;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::io_engine::start_external()
+{
+    std::lock_guard<std::mutex> lg(engine_mutex_);
+
+    if (active_) {
+        return RTP_INITIALIZED;
+    }
+
+    rtp_error_t ret = create_workers(1);
+    if (ret != RTP_OK) {
+        return ret;
+    }
+
+    UVG_LOG_DEBUG("Started I/O engine for an external event loop");
+    should_stop_ = false;
+    external_    = true;
+    active_      = true;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::io_engine::create_workers(size_t workers)
+{
+#ifdef __linux__
+    for (size_t i = 0; i < workers; ++i) {
+        std::unique_ptr<worker> w = std::unique_ptr<worker>(new worker());
+
+        if ((w->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+            UVG_LOG_ERROR("epoll_create1(2) failed: %s", strerror(errno));
+            break;
+        }
+        workers_.push_back(std::move(w));
+    }
+
+    if (workers_.size() != workers) {
+        for (auto& w : workers_) {
+            close(w->epoll_fd);
+        }
+        workers_.clear();
+        return RTP_GENERIC_ERROR;
+    }
+    return RTP_OK;
+#else
+    (void)workers;
+    UVG_LOG_ERROR("The I/O engine is only supported on Linux");
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+rtp_error_t uvgrtp::io_engine::stop()
+{
+    std::lock_guard<std::mutex> lg(engine_mutex_);
+
+    if (!active_) {
+        return RTP_OK;
+    }
+    should_stop_ = true;
+
+    for (auto& w : workers_) {
+        if (w->thread && w->thread->joinable()) {
+            w->thread->join();
+        }
+#ifdef __linux__
+        close(w->epoll_fd);
+#endif
+    }
+
+    workers_.clear();
+    fd_to_worker_.clear();
+    active_   = false;
+    external_ = false;
+    return RTP_OK;
+}
+
+void uvgrtp::io_engine::set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings)
+{
+    std::lock_guard<std::mutex> lg(engine_mutex_);
+    thread_settings_ = settings;
+}
+
+bool uvgrtp::io_engine::is_active() const
+{
+    return active_;
+}
+
+size_t uvgrtp::io_engine::get_workers() const
+{
+    return external_ ? 0 : workers_.size();
+}
+
+int uvgrtp::io_engine::get_event_fd() const
+{
+    if (!active_ || !external_) {
+        return -1;
+    }
+    return workers_.front()->epoll_fd;
+}
+
+size_t uvgrtp::io_engine::process_events(size_t budget)
+{
+    worker *w = nullptr;
+    {
+        std::lock_guard<std::mutex> lg(engine_mutex_);
+
+        if (!active_ || !external_) {
+            return 0;
+        }
+        w = workers_.front().get();
+    }
+
+#ifdef __linux__
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int fds[MAX_EPOLL_EVENTS];
+
+    std::lock_guard<std::mutex> lg(w->flows_mutex);
+
+    int nfds = epoll_wait(w->epoll_fd, events, MAX_EPOLL_EVENTS, 0);
+    if (nfds < 0) {
+        if (errno != EINTR)
+            UVG_LOG_ERROR("epoll_wait(2) failed: %s", strerror(errno));
+        return 0;
+    }
+
+    for (int i = 0; i < nfds; ++i) {
+        fds[i] = events[i].data.fd;
+    }
+    return call_flows(w, fds, nfds, budget);
+#else
+    (void)budget;
+    return 0;
+#endif
+}
+
+size_t uvgrtp::io_engine::call_flows(worker *w, const int *fds, int count, size_t budget)
+{
+    size_t packets = 0;
+    dispatching_worker = w;
+
+    for (int i = 0; i < count && (budget == 0 || packets < budget); ++i) {
+        // the socket may have been removed after epoll_wait() returned
+        auto it = w->flows.find(fds[i]);
+
+        if (it != w->flows.end()) {
+            packets += it->second->handle_readable(budget == 0 ? 0 : budget - packets);
+        }
+    }
+
+    dispatching_worker = nullptr;
+    return packets;
+}
+
+rtp_error_t uvgrtp::io_engine::add_flow(int fd, uvgrtp::io_handler *flow)
+{
+#ifdef __linux__
+    worker *w = nullptr;
+    {
+        std::lock_guard<std::mutex> lg(engine_mutex_);
+
+        if (!active_) {
+            return RTP_NOT_INITIALIZED;
+        }
+
+        // give the socket to the worker that has the fewest sockets
+        w = std::min_element(workers_.begin(), workers_.end(),
+            [](const std::unique_ptr<worker>& a, const std::unique_ptr<worker>& b) {
+                return a->sockets < b->sockets;
+            })->get();
+
+        ++w->sockets;
+        fd_to_worker_[fd] = w;
+    }
+
+    /* The engine lock is never held while taking the lock of a worker, because the
+     * worker calls the flows with its own lock held and a flow may remove itself */
+    {
+        std::lock_guard<std::mutex> flg(w->flows_mutex);
+        w->flows[fd] = flow;
+    }
+
+    struct epoll_event ev = {};
+    ev.events  = EPOLLIN;
+    ev.data.fd = fd;
+
+    if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        UVG_LOG_ERROR("epoll_ctl(2) failed: %s", strerror(errno));
+        (void)remove_flow(fd);
+        return RTP_GENERIC_ERROR;
+    }
+
+    return RTP_OK;
+#else
+    (void)fd;
+    (void)flow;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+rtp_error_t uvgrtp::io_engine::remove_flow(int fd)
+{
+    worker *w = nullptr;
+    {
+        std::lock_guard<std::mutex> lg(engine_mutex_);
+
+        auto it = fd_to_worker_.find(fd);
+        if (it == fd_to_worker_.end()) {
+            return RTP_NOT_FOUND;
+        }
+        w = it->second;
+        --w->sockets;
+        fd_to_worker_.erase(it);
+    }
+
+#ifdef __linux__
+    (void)epoll_ctl(w->epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+
+    // the worker holds its lock while it calls the flows, so taking it here waits until
+    // the callback has returned. The flow may also remove itself from within the callback
+    if (dispatching_worker == w) {
+        w->flows.erase(fd);
+    } else {
+        std::lock_guard<std::mutex> flg(w->flows_mutex);
+        w->flows.erase(fd);
+    }
+    return RTP_OK;
+}
+
+void uvgrtp::io_engine::event_loop(worker *w)
+{
+#ifdef __linux__
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int fds[MAX_EPOLL_EVENTS];
+
+    while (!should_stop_) {
+        int nfds = epoll_wait(w->epoll_fd, events, MAX_EPOLL_EVENTS, EVENT_LOOP_TIMEOUT_MS);
+
+        if (nfds < 0) {
+            if (errno == EINTR)
+                continue;
+
+            UVG_LOG_ERROR("epoll_wait(2) failed: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < nfds; ++i) {
+            fds[i] = events[i].data.fd;
+        }
+
+        std::lock_guard<std::mutex> lg(w->flows_mutex);
+        (void)call_flows(w, fds, nfds, 0);
+    }
+#else
+    (void)w;
+#endif
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include <vector>
+#include <memory>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+namespace uvgrtp {
+    class thread_settings;
+
+    /* A reader of a socket whose read events the I/O engine delivers, the reception_flow of a
+     * media socket or the rtcp_reader of an RTCP socket */
+    class io_handler {
+        public:
+            virtual ~io_handler() {}
+
+            /* Called by the I/O engine when the socket has data to read. Read and process at most
+             * about "budget" packets, or everything the socket has if "budget" is 0. The engine is
+             * level-triggered, so what is left is read on the next event
+             *
+             * Return the number of packets read */
+            virtual size_t handle_readable(size_t budget) = 0;
+    };
+
+    /* The I/O engine multiplexes the reception of all sockets of a context through a small,
+     * fixed number of event loop threads instead of giving every reception_flow its own
+     * receiver and processor threads.
+     *
+     * Each worker has its own epoll instance and a socket is assigned to the worker that
+     * has the fewest sockets. When a socket becomes readable, the worker calls the
+     * io_handler of the socket, which reads everything the socket has and hands the
+     * packets to the packet handlers or the RTCP instances from the worker thread. Because a socket only belongs
+     * to one worker, the packets of one socket are never processed by two threads at once.
+     *
+     * Started with start_external(), the engine has no threads. The sockets are added to one
+     * epoll instance, whose descriptor the application watches in its own event loop, and the
+     * application calls process_events() when it becomes readable to read and process the
+     * packets from its own thread.
+     *
+     * The engine is only available on Linux. On other platforms start() fails and the
+     * reception flows keep using their own threads. */
+    class io_engine {
+        public:
+            io_engine();
+            ~io_engine();
+
+            /* Start the event loop threads
+             *
+             * Param workers number of event loop threads
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "workers" is 0
+             * Return RTP_INITIALIZED if the engine is already running
+             * Return RTP_NOT_SUPPORTED if the platform does not support the engine
+             * Return RTP_GENERIC_ERROR if creating an event loop failed */
+            rtp_error_t start(size_t workers);
+
+            /* Start the engine without event loop threads, see process_events()
+             *
+             * Return RTP_OK on success
+             * Return RTP_INITIALIZED if the engine is already running
+             * Return RTP_NOT_SUPPORTED if the platform does not support the engine
+             * Return RTP_GENERIC_ERROR if creating the epoll instance failed */
+            rtp_error_t start_external();
+
+            /* Descriptor that is readable when process_events() has something to do,
+             * -1 unless the engine has been started with start_external() */
+            int get_event_fd() const;
+
+            /* Read and process the packets of the readable sockets without blocking, at most about
+             * "budget" packets or all of them if "budget" is 0. Calls from several threads are serialized
+             *
+             * Return the number of packets read */
+            size_t process_events(size_t budget);
+
+            /* Stop the event loop threads and wait until they have exited
+             *
+             * Return RTP_OK on success */
+            rtp_error_t stop();
+
+            /* Configuration of the event loop threads started afterwards */
+            void set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings);
+
+            bool is_active() const;
+            size_t get_workers() const;
+
+            /* Start delivering the read events of socket "fd" to "flow"
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_INITIALIZED if the engine is not running
+             * Return RTP_GENERIC_ERROR if the socket could not be added to an event loop */
+            rtp_error_t add_flow(int fd, uvgrtp::io_handler *flow);
+
+            /* Stop delivering the read events of socket "fd". When this returns, the
+             * reception flow of the socket is not being called and it will not be called
+             * anymore, unless this is called from the reception flow callback itself
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_FOUND if the socket has not been added */
+            rtp_error_t remove_flow(int fd);
+
+        private:
+            struct worker {
+                int epoll_fd = -1;
+                std::unique_ptr<std::thread> thread;
+
+                /* Number of sockets assigned to this worker, protected by the engine lock */
+                size_t sockets = 0;
+
+                /* Held while the events of one epoll_wait() call are dispatched */
+                std::mutex flows_mutex;
+                std::map<int, uvgrtp::io_handler *> flows;
+            };
+
+            void event_loop(worker *w);
+
+            /* Call the flows of the readable sockets "fds" of "w" until "budget" packets have
+             * been read, called with the lock of "w" held. Return the number of read packets */
+            size_t call_flows(worker *w, const int *fds, int count, size_t budget);
+
+            /* Create the epoll instances of "workers" workers, called with the engine lock held */
+            rtp_error_t create_workers(size_t workers);
+
+            std::vector<std::unique_ptr<worker>> workers_;
+            std::map<int, worker *> fd_to_worker_;
+            std::mutex engine_mutex_;
+            std::shared_ptr<uvgrtp::thread_settings> thread_settings_;
+            std::atomic<bool> should_stop_;
+            bool active_;
+            bool external_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,233 @@
+#include "jitter_buffer.hh"
+
+#include "uvgrtp/frame.hh"
+
+#include "debug.hh"
+#include "threads.hh"
+
+#include <algorithm>
+#include <cmath>
+
+/* The playout delay is this many times the interarrival jitter, which covers
+ * nearly all of the variation of the transit time */
+constexpr double JITTER_DELAY_FACTOR = 3.0;
+
+/* The smallest transit time is looked for again in windows of this length, so that
+ * the mapping of the timestamps follows the drift of the sender's clock */
+constexpr double TRANSIT_WINDOW_MS = 5000.0;
+
+/* A larger jump of the timestamp is a new timeline rather than late or early frames */
+constexpr double MAX_TIMESTAMP_JUMP_MS = 10000.0;
+
+/* Most frames buffered, the oldest frame is released early if a new one does not fit */
+constexpr size_t MAX_BUFFERED_FRAMES = 1024;
+
+uvgrtp::jitter_buffer::jitter_buffer(std::function<void(uvgrtp::frame::rtp_frame *)> deliver,
+    std::function<double(uint32_t)> jitter_ms, uint32_t clock_rate,
+    std::shared_ptr<uvgrtp::thread_settings> settings) :
+    deliver_(deliver),
+    jitter_ms_(jitter_ms),
+    frames_(),
+    start_(uvgrtp::clock::hrc::now()),
+    clock_rate_(clock_rate),
+    min_delay_ms_((double)uvgrtp::DEFAULT_JITTER_BUFFER_MIN_DELAY),
+    max_delay_ms_((double)uvgrtp::DEFAULT_JITTER_BUFFER_MIN_DELAY),
+    resets_(0),
+    ssrc_(0),
+    synced_(false),
+    first_timestamp_(0),
+    highest_timestamp_(0),
+    highest_seq_(0),
+    base_transit_(0),
+    window_transit_(0),
+    window_start_(0),
+    released_(),
+    has_released_(false),
+    late_frames_(0),
+    active_(true),
+    thread_(uvgrtp::start_thread(settings, RTP_THREAD_PLAYOUT, -1, &uvgrtp::jitter_buffer::releaser, this))
+{
+}
+
+uvgrtp::jitter_buffer::~jitter_buffer()
+{
+    stop();
+}
+
+void uvgrtp::jitter_buffer::set_clock_rate(uint32_t clock_rate)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (clock_rate_ != clock_rate) {
+        clock_rate_ = clock_rate;
+        synced_     = false;
+    }
+}
+
+void uvgrtp::jitter_buffer::set_delay(size_t min_delay_ms, size_t max_delay_ms)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        min_delay_ms_ = (double)min_delay_ms;
+        max_delay_ms_ = (double)std::max(min_delay_ms, max_delay_ms);
+    }
+    cond_.notify_one();
+}
+
+double uvgrtp::jitter_buffer::get_delay_ms()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return playout_delay();
+}
+
+double uvgrtp::jitter_buffer::now_ms() const
+{
+    return std::chrono::duration<double, std::milli>(uvgrtp::clock::hrc::now() - start_).count();
+}
+
+double uvgrtp::jitter_buffer::playout_delay()
+{
+    double jitter = synced_ && jitter_ms_ ? jitter_ms_(ssrc_) : -1.0;
+
+    // until the first report of the jitter, the shortest delay is used
+    if (jitter < 0) {
+        return min_delay_ms_;
+    }
+
+    return std::min(max_delay_ms_, std::max(min_delay_ms_, JITTER_DELAY_FACTOR * jitter));
+}
+
+double uvgrtp::jitter_buffer::playout_time(const frame_key& key)
+{
+    // the frames from before a reset have lost their timing and are played out right away
+    if (std::get<0>(key) != resets_ || !synced_) {
+        return 0;
+    }
+
+    double timestamp_ms = (double)(std::get<1>(key) - first_timestamp_) * 1000.0 / clock_rate_;
+    return timestamp_ms + base_transit_ + playout_delay();
+}
+
+void uvgrtp::jitter_buffer::reset(const uvgrtp::frame::rtp_frame *frame)
+{
+    ++resets_;
+
+    ssrc_               = frame->header.ssrc;
+    first_timestamp_    = frame->header.timestamp;
+    highest_timestamp_  = frame->header.timestamp;
+    highest_seq_        = frame->header.seq;
+
+    base_transit_   = now_ms();
+    window_transit_ = base_transit_;
+    window_start_   = base_transit_;
+
+    synced_ = true;
+}
+
+void uvgrtp::jitter_buffer::frame_received(uvgrtp::frame::rtp_frame *frame)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (!active_) {
+        lock.unlock();
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return;
+    }
+
+    int64_t timestamp = highest_timestamp_ + (int32_t)(frame->header.timestamp - (uint32_t)highest_timestamp_);
+    int64_t seq       = highest_seq_ + (int16_t)(frame->header.seq - (uint16_t)highest_seq_);
+
+    if (!synced_ || frame->header.ssrc != ssrc_ ||
+        std::abs((double)(timestamp - highest_timestamp_) * 1000.0 / clock_rate_) > MAX_TIMESTAMP_JUMP_MS)
+    {
+        reset(frame);
+        timestamp = highest_timestamp_;
+        seq       = highest_seq_;
+    }
+
+    frame_key key(resets_, timestamp, seq);
+
+    if (has_released_ && key <= released_) {
+        ++late_frames_;
+        UVG_LOG_DEBUG("Dropping a frame that arrived after its playout time, %zu late frames so far", late_frames_);
+
+        lock.unlock();
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return;
+    }
+
+    highest_timestamp_ = std::max(highest_timestamp_, timestamp);
+    highest_seq_       = std::max(highest_seq_, seq);
+
+    // the frame that arrived the fastest relative to its timestamp sets the mapping to the local clock
+    double now     = now_ms();
+    double transit = now - (double)(timestamp - first_timestamp_) * 1000.0 / clock_rate_;
+
+    base_transit_   = std::min(base_transit_, transit);
+    window_transit_ = std::min(window_transit_, transit);
+
+    if (now - window_start_ >= TRANSIT_WINDOW_MS) {
+        base_transit_   = window_transit_;
+        window_transit_ = transit;
+        window_start_   = now;
+    }
+
+    if (!frames_.emplace(key, frame).second) {
+        lock.unlock();
+        UVG_LOG_DEBUG("Dropping a duplicate frame");
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return;
+    }
+
+    lock.unlock();
+    cond_.notify_one();
+}
+
+void uvgrtp::jitter_buffer::releaser()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (active_) {
+        if (frames_.empty()) {
+            cond_.wait(lock);
+            continue;
+        }
+
+        auto head = frames_.begin();
+        double wait_ms = playout_time(head->first) - now_ms();
+
+        if (wait_ms > 0 && frames_.size() <= MAX_BUFFERED_FRAMES) {
+            cond_.wait_for(lock, std::chrono::duration<double, std::milli>(wait_ms));
+            continue;
+        }
+
+        uvgrtp::frame::rtp_frame *frame = head->second;
+        released_     = head->first;
+        has_released_ = true;
+        frames_.erase(head);
+
+        // the frames are delivered one at a time from this thread, so they stay in order
+        lock.unlock();
+        deliver_(frame);
+        lock.lock();
+    }
+}
+
+void uvgrtp::jitter_buffer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = false;
+    }
+    cond_.notify_all();
+
+    if (thread_ && thread_->joinable()) {
+        thread_->join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& frame : frames_) {
+        (void)uvgrtp::frame::dealloc_frame(frame.second);
+    }
+    frames_.clear();
+}
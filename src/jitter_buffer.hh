@@ -0,0 +1,121 @@
+#pragma once
+
+#include "uvgrtp/clock.hh"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+namespace uvgrtp {
+
+    namespace frame {
+        struct rtp_frame;
+    }
+
+    class thread_settings;
+
+    /* Default shortest playout delay in milliseconds, see RCC_JITTER_BUFFER_MIN_DELAY */
+    constexpr size_t DEFAULT_JITTER_BUFFER_MIN_DELAY = 10;
+
+    /* Holds the received frames of a stream until their playout time and releases them
+     * in the order of their RTP timestamps and sequence numbers.
+     *
+     * The playout time of a frame is its RTP timestamp mapped to the local clock with the
+     * smallest transit time seen recently, plus the playout delay. The delay follows the
+     * RTCP interarrival jitter of the source, kept between the minimum and maximum delay,
+     * so that it grows when the network gets worse and shrinks again when it settles.
+     * A frame that arrives after a later frame has been released is too late for playout
+     * and it is dropped.
+     *
+     * The frames are released from a thread of the buffer, one at a time */
+    class jitter_buffer {
+        public:
+            /* "deliver" is given the released frames and "jitter_ms" returns the interarrival
+             * jitter of a source in milliseconds or a negative value if it is not known. The
+             * releasing thread is configured with "settings" */
+            jitter_buffer(std::function<void(uvgrtp::frame::rtp_frame *)> deliver,
+                std::function<double(uint32_t)> jitter_ms, uint32_t clock_rate,
+                std::shared_ptr<uvgrtp::thread_settings> settings = nullptr);
+            ~jitter_buffer();
+
+            void set_clock_rate(uint32_t clock_rate);
+            void set_delay(size_t min_delay_ms, size_t max_delay_ms);
+
+            /* Add a received frame to the buffer. The buffer owns the frame until it is released */
+            void frame_received(uvgrtp::frame::rtp_frame *frame);
+
+            /* Stop the releasing thread and free the frames in the buffer. The frames
+             * received after this are freed right away */
+            void stop();
+
+            /* The current playout delay in milliseconds */
+            double get_delay_ms();
+
+        private:
+            void releaser();
+
+            /* Playout delay based on the jitter of the current source. Called with mutex_ held */
+            double playout_delay();
+
+            /* Buffered frames by the reset count of the buffer, extended RTP timestamp and
+             * extended sequence number of the frame */
+            typedef std::tuple<uint64_t, int64_t, int64_t> frame_key;
+
+            /* Time since the creation of the buffer when the frame "key" is played out.
+             * Called with mutex_ held */
+            double playout_time(const frame_key& key);
+
+            /* Forget the timing of the current source when the source or its timeline changes.
+             * The buffered frames are released right away. Called with mutex_ held */
+            void reset(const uvgrtp::frame::rtp_frame *frame);
+
+            /* Current time in milliseconds since the creation of the buffer */
+            double now_ms() const;
+
+            std::function<void(uvgrtp::frame::rtp_frame *)> deliver_;
+            std::function<double(uint32_t)> jitter_ms_;
+
+            std::mutex mutex_;
+            std::condition_variable cond_;
+
+            std::map<frame_key, uvgrtp::frame::rtp_frame *> frames_;
+
+            uvgrtp::clock::hrc::hrc_t start_;
+
+            uint32_t clock_rate_;
+            double min_delay_ms_;
+            double max_delay_ms_;
+
+            uint64_t resets_;
+            uint32_t ssrc_;
+            bool synced_;
+
+            /* The first timestamp and the highest extended timestamp and sequence number */
+            int64_t first_timestamp_;
+            int64_t highest_timestamp_;
+            int64_t highest_seq_;
+
+            /* The smallest difference of the arrival time and the timestamp in milliseconds,
+             * which maps the timestamps to the local clock, and the smallest difference of
+             * the current window that replaces it when the window ends */
+            double base_transit_;
+            double window_transit_;
+            double window_start_;
+
+            /* The frame released last, a frame that sorts before it arrives too late */
+            frame_key released_;
+            bool has_released_;
+
+            size_t late_frames_;
+
+            bool active_;
+            std::unique_ptr<std::thread> thread_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
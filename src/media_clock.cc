@@ -0,0 +1,47 @@
+#include "uvgrtp/media_clock.hh"
+
+#include "uvgrtp/clock.hh"
+
+/* "value" counted at "from_rate" in units of "to_rate", without overflowing for values of decades */
+static uint64_t convert_rate(uint64_t value, uint64_t from_rate, uint64_t to_rate)
+{
+    if (from_rate == to_rate || from_rate == 0)
+        return value;
+
+    return (value / from_rate) * to_rate + (value % from_rate) * to_rate / from_rate;
+}
+
+uvgrtp::function_media_clock::function_media_clock(std::function<uint64_t()> ntp_now):
+    ntp_now_(ntp_now)
+{
+}
+
+void uvgrtp::function_media_clock::now(uint32_t clock_rate, uint64_t& ntp, uint64_t& units)
+{
+    ntp = ntp_now_ ? ntp_now_() : uvgrtp::clock::ntp::now();
+
+    // the seconds and the 32-bit fraction of the NTP time converted separately
+    units = (ntp >> 32) * clock_rate + (((ntp & 0xffffffff) * clock_rate) >> 32);
+}
+
+uvgrtp::counter_media_clock::counter_media_clock(std::shared_ptr<std::atomic<uint64_t>> counter, uint32_t counter_rate):
+    counter_(counter),
+    counter_rate_(counter_rate),
+    start_ntp_(uvgrtp::clock::ntp::now()),
+    start_count_(counter ? counter->load(std::memory_order_acquire) : 0)
+{
+}
+
+void uvgrtp::counter_media_clock::now(uint32_t clock_rate, uint64_t& ntp, uint64_t& units)
+{
+    uint64_t count = counter_ ? counter_->load(std::memory_order_acquire) : 0;
+    uint64_t ticks = count - start_count_;
+
+    units = convert_rate(count, counter_rate_, clock_rate);
+
+    // the time the counter has advanced as a 32.32 fixed point number of seconds
+    ntp = start_ntp_;
+    if (counter_rate_) {
+        ntp += ((ticks / counter_rate_) << 32) + (((ticks % counter_rate_) << 32) / counter_rate_);
+    }
+}
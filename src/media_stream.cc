@@ -5,6 +5,7 @@
 #include "formats/h264.hh"
 #include "formats/h265.hh"
 #include "formats/h266.hh"
+#include "formats/raw_video.hh"
 #include "debug.hh"
 #include "random.hh"
 #include "rtp.hh"
@@ -13,12 +14,31 @@
 #include "rtcp_reader.hh"
 
 #include "holepuncher.hh"
+#include "send_queue.hh"
+#include "copy_pool.hh"
+#include "pipeline.hh"
 #include "reception_flow.hh"
 #include "srtp/srtcp.hh"
 #include "srtp/srtp.hh"
 #include "formats/media.hh"
 #include "global.hh"
 #include "socketfactory.hh"
+#include "twcc.hh"
+#include "nack.hh"
+#include "fec.hh"
+#include "frame_queue.hh"
+#include "forwarder.hh"
+#include "jitter_buffer.hh"
+#include "memory_budget.hh"
+#include "capture.hh"
+#include "recorder.hh"
+#include "reorder_buffer.hh"
+#include "redundancy_merge.hh"
+#include "stream_metrics.hh"
+#include "trace.hh"
+#include "async_pulls.hh"
+#include "file_source.hh"
+#include "path_mtu.hh"
 #ifdef _WIN32
 #include <Ws2tcpip.h>
 #else
@@ -53,12 +73,24 @@ uvgrtp::media_stream::media_stream(std::string cname, std::string remote_addr,
     new_socket_(false),
     rce_flags_(rce_flags),
     initialized_(false),
+    packet_handlers_installed_(false),
     reception_flow_(nullptr),
     media_(nullptr),
     holepuncher_(nullptr),
+    send_queue_(nullptr),
+    copy_pool_(std::make_shared<uvgrtp::copy_pool>()),
+    async_pulls_(std::make_shared<uvgrtp::async_pulls>()),
+    async_pulling_(false),
+    stop_file_(false),
     cname_(cname),
     fps_numerator_(30),
     fps_denominator_(1),
+    mtu_size_(uvgrtp::DEFAULT_MTU_SIZE),
+    nack_history_size_(uvgrtp::DEFAULT_NACK_HISTORY_SIZE),
+    jitter_buffer_(nullptr),
+    jitter_buffer_min_delay_ms_(uvgrtp::DEFAULT_JITTER_BUFFER_MIN_DELAY),
+    metrics_(std::make_shared<uvgrtp::stream_metrics>()),
+    memory_budget_(std::make_shared<uvgrtp::memory_budget>(sfp->get_memory_budget())),
     ssrc_(std::make_shared<std::atomic<std::uint32_t>>(uvgrtp::random::generate_32())),
     remote_ssrc_(std::make_shared<std::atomic<std::uint32_t>>(ssrc_.get()->load() + 1)),
     snd_buf_size_(-1),
@@ -68,6 +100,12 @@ uvgrtp::media_stream::media_stream(std::string cname, std::string remote_addr,
 
 uvgrtp::media_stream::~media_stream()
 {
+    // the queued frames are completed before the components they are sent with go away
+    send_queue_ = nullptr;
+
+    if (media_ && aggregation_deadline_us_)
+        (void)media_->set_aggregation_deadline(0);
+
     // TODO: I would take a close look at what happens when pull_frame is called
     // and media stream is destroyed. Note that this is the only way to stop pull
     // frame without waiting
@@ -80,6 +118,22 @@ uvgrtp::media_stream::~media_stream()
         rtcp_->stop();
     }
     reception_flow_->remove_handlers(remote_ssrc_);
+    reception_flow_->get_delivery_queue().remove_key_frame_classifier(remote_ssrc_);
+
+    for (auto& path : receive_paths_) {
+        reception_flow_->remove_receive_path(path.second);
+    }
+
+    // the recording is closed with the stream, not when the last snapshot of the handlers goes
+    if (recorder_) {
+        recorder_->stop();
+    }
+
+    // the jitter buffer gives its frames to the hooks that are cleared next
+    if (jitter_buffer_) {
+        jitter_buffer_->stop();
+    }
+
     // Clear this media stream from the reception_flow
     if ( reception_flow_ && (reception_flow_->clear_stream_from_flow(remote_ssrc_)) == 1) {
         reception_flow_->stop();
@@ -88,6 +142,9 @@ uvgrtp::media_stream::~media_stream()
         }
     }
 
+    // the receive hook that feeds the pulls has been removed with the handlers
+    async_pulls_->close();
+
     (void)free_resources(RTP_OK);
 }
 
@@ -139,7 +196,7 @@ rtp_error_t uvgrtp::media_stream::init_connection()
         else {
             remote_sockaddr_ = uvgrtp::socket::create_sockaddr(AF_INET, remote_address_, dst_port_);
         }
-        holepuncher_ = std::unique_ptr<uvgrtp::holepuncher>(new uvgrtp::holepuncher(socket_));
+        holepuncher_ = std::unique_ptr<uvgrtp::holepuncher>(new uvgrtp::holepuncher(socket_, sfp_->get_keepalive_timer()));
         holepuncher_->set_remote_address(remote_sockaddr_, remote_sockaddr_ip6_);
     }
     if (rce_flags_ & RCE_RECEIVE_ONLY) {
@@ -176,6 +233,10 @@ rtp_error_t uvgrtp::media_stream::init_connection()
         return ret;
     }
 
+    bool video = fmt_ == RTP_FORMAT_H264 || fmt_ == RTP_FORMAT_H265 || fmt_ == RTP_FORMAT_H266 ||
+        fmt_ == RTP_FORMAT_RAW_VIDEO;
+    sfp_->apply_socket_profile(socket_, video ? RTP_SOCKET_VIDEO : RTP_SOCKET_AUDIO);
+
     return ret;
 }
 
@@ -224,6 +285,18 @@ rtp_error_t uvgrtp::media_stream::create_media(rtp_format_t fmt)
             media_.reset(format_266);
             break;
         }
+        case RTP_FORMAT_RAW_VIDEO:
+        {
+            uvgrtp::formats::raw_video* format_raw = new uvgrtp::formats::raw_video(socket_, rtp_, rce_flags_);
+            reception_flow_->install_handler(
+                5, remote_ssrc_,
+                std::bind(&uvgrtp::formats::raw_video::packet_handler, format_raw, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
+                    std::placeholders::_4, std::placeholders::_5), nullptr
+            );
+
+            media_.reset(format_raw);
+            break;
+        }
         case RTP_FORMAT_OPUS:
         case RTP_FORMAT_PCMU:
         case RTP_FORMAT_GSM:
@@ -264,13 +337,40 @@ rtp_error_t uvgrtp::media_stream::create_media(rtp_format_t fmt)
         }
     }
 
+    if (fmt == RTP_FORMAT_H264 || fmt == RTP_FORMAT_H265 || fmt == RTP_FORMAT_H266) {
+        uvgrtp::formats::h26x *h26x = static_cast<uvgrtp::formats::h26x *>(media_.get());
+
+        reception_flow_->get_delivery_queue().set_key_frame_classifier(remote_ssrc_,
+            [h26x](const uvgrtp::frame::rtp_frame *frame) {
+                return h26x->is_key_frame(frame);
+            });
+
+        // the reception flow outlives the handlers of its streams
+        uvgrtp::reception_flow *flow = reception_flow_.get();
+        h26x->set_congestion_check([flow]() {
+            return flow->get_delivery_queue().congested();
+        });
+    }
+
     // set default values for fps
     media_->set_fps(fps_numerator_, fps_denominator_);
+    media_->set_pacer(sfp_->get_pacer());
+    media_->set_pacing(pacing_burst_, std::chrono::microseconds(pacing_spin_us_));
+    media_->set_send_priority(send_priority_, send_weight_);
+    media_->set_metrics(metrics_);
+
+    if (aggregation_deadline_us_)
+        (void)media_->set_aggregation_deadline(aggregation_deadline_us_);
+    media_->set_memory_budget(memory_budget_);
+
+    install_pipeline();
     return RTP_OK;
 }
 
 rtp_error_t uvgrtp::media_stream::free_resources(rtp_error_t ret)
 {
+    send_queue_ = nullptr;
+
     if ((rce_flags_ & RCE_HOLEPUNCH_KEEPALIVE) && holepuncher_)
     {
         holepuncher_->stop();
@@ -282,13 +382,11 @@ rtp_error_t uvgrtp::media_stream::free_resources(rtp_error_t ret)
     srtcp_          = nullptr;
     //reception_flow_ = nullptr;
     holepuncher_    = nullptr;
+    simulcast_layers_.clear();
+    paths_          = nullptr;
     media_          = nullptr;
     socket_         = nullptr;
 
-    if (zrtp_) {
-        zrtp_->set_zrtp_busy(false);
-    }
-
     return ret;
 }
 
@@ -312,18 +410,42 @@ rtp_error_t uvgrtp::media_stream::install_packet_handlers()
                     std::placeholders::_4, std::placeholders::_5), nullptr);
         }
     if (rce_flags_ & RCE_SRTP) {
-        socket_->install_handler(ssrc_, srtp_.get(), srtp_->send_packet_handler);
+        socket_->install_handler(ssrc_, srtp_.get(), srtp_->send_packet_handler, srtp_->send_frame_handler);
         reception_flow_->install_handler(
             4, remote_ssrc_,
             std::bind(&uvgrtp::srtp::recv_packet_handler, srtp_, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
                 std::placeholders::_4, std::placeholders::_5), srtp_.get());
     }
+    packet_handlers_installed_ = true;
+    install_pipeline();
     return RTP_OK;
 }
 
+void uvgrtp::media_stream::install_pipeline()
+{
+    if (!media_ || !packet_handlers_installed_)
+        return;
+
+    // the generic media handler is given the reassembly state of the stream, see create_media()
+    void *media_args = nullptr;
+    if (fmt_ != RTP_FORMAT_H264 && fmt_ != RTP_FORMAT_H265 && fmt_ != RTP_FORMAT_H266 &&
+        fmt_ != RTP_FORMAT_RAW_VIDEO) {
+        media_args = media_->get_media_frame_info();
+    }
+
+    reception_flow_->install_pipeline(remote_ssrc_,
+        uvgrtp::make_pipeline(rce_flags_, fmt_, rtp_, srtp_, rtcp_, media_.get(), media_args));
+}
+
 rtp_error_t uvgrtp::media_stream::init(std::shared_ptr<uvgrtp::zrtp> zrtp)
 {
     zrtp_ = zrtp;
+
+    /* Multistream Mode streams negotiate their keys with their own ZRTP state
+     * so that they do not have to wait for each other */
+    if (zrtp_ && (rce_flags_ & RCE_ZRTP_MULTISTREAM_MODE))
+        zrtp_ = zrtp_->create_stream();
+
     if (init_connection() != RTP_OK) {
         UVG_LOG_ERROR("Failed to initialize the underlying socket");
         return free_resources(RTP_GENERIC_ERROR);
@@ -340,6 +462,9 @@ rtp_error_t uvgrtp::media_stream::init(std::shared_ptr<uvgrtp::zrtp> zrtp)
     srtp_ = std::shared_ptr<uvgrtp::srtp>(new uvgrtp::srtp(rce_flags_));
     srtcp_ = std::shared_ptr<uvgrtp::srtcp>(new uvgrtp::srtcp());
 
+    srtp_->set_metrics(metrics_);
+    reception_flow_->install_metrics(remote_ssrc_, metrics_);
+
     socket_->install_handler(ssrc_, rtcp_.get(), rtcp_->send_packet_handler_vec);
 
     /* If we are using ZRTP, we only install the ZRTP handler first. Rest of the handlers are installed after ZRTP is
@@ -397,20 +522,7 @@ rtp_error_t uvgrtp::media_stream::start_zrtp()
             }
         }
     }
-    /* If ZRTP is already performing an MSM negotiation, wait for it to complete before starting a new one */
-    if (!perform_dh) {
-        auto start = std::chrono::system_clock::now();
-        while (zrtp_->is_zrtp_busy()) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            if (std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now() - start).count() > 10)
-            {
-                UVG_LOG_ERROR("Giving up on MSM after 10 seconds");
-                return free_resources(RTP_TIMEOUT);
-            }
-        }
-    }
 
-    zrtp_->set_zrtp_busy(true);
     rtp_error_t ret = RTP_OK;
     if ((ret = zrtp_->init(rtp_->get_ssrc(), socket_, remote_sockaddr_, remote_sockaddr_ip6_, perform_dh, ipv6_)) != RTP_OK) {
         UVG_LOG_WARN("Failed to initialize ZRTP for media stream!");
@@ -423,8 +535,8 @@ rtp_error_t uvgrtp::media_stream::start_zrtp()
     if ((ret = init_srtp_with_zrtp(rce_flags_, SRTCP, srtcp_, zrtp_)) != RTP_OK)
         return free_resources(ret);
 
-    zrtp_->set_zrtp_busy(false);
-    zrtp_->dh_has_finished(); // only after the DH stream has gotten its keys, do we let non-DH stream perform ZRTP
+    if (perform_dh)
+        zrtp_->dh_has_finished(); // only after the DH stream has gotten its keys, do we let non-DH stream perform ZRTP
     install_packet_handlers();
 
     return RTP_OK;
@@ -510,13 +622,26 @@ rtp_error_t uvgrtp::media_stream::start_components()
 
     if (rce_flags_ & RCE_SRTP_AUTHENTICATE_RTP) {
         if (ipv6_) {
-            rtp_->set_payload_size(MAX_IPV6_MEDIA_PAYLOAD - UVG_AUTH_TAG_LENGTH);
+            rtp_->set_payload_size(MAX_IPV6_MEDIA_PAYLOAD - uvgrtp::srtp_auth_tag_length(rce_flags_));
         }
         else {
-            rtp_->set_payload_size(MAX_IPV4_MEDIA_PAYLOAD - UVG_AUTH_TAG_LENGTH);
+            rtp_->set_payload_size(MAX_IPV4_MEDIA_PAYLOAD - uvgrtp::srtp_auth_tag_length(rce_flags_));
         }
     }
 
+    if ((rce_flags_ & RCE_PACE_KERNEL) && socket_->enable_txtime() != RTP_OK) {
+        UVG_LOG_WARN("SO_TXTIME is not available, pacing with SO_MAX_PACING_RATE instead");
+    }
+
+    if (rce_flags_ & RCE_ASYNC_SEND) {
+        send_queue_ = std::unique_ptr<uvgrtp::send_queue>(new uvgrtp::send_queue(
+            std::bind(&uvgrtp::media_stream::send_frame, this, std::placeholders::_1), DEFAULT_SEND_QUEUE_SIZE));
+        send_queue_->set_thread_settings(sfp_->get_thread_settings());
+
+        if (send_queue_->start() != RTP_OK)
+            return free_resources(RTP_MEMORY_ERROR);
+    }
+
     initialized_ = true;
     return reception_flow_->start(socket_, rce_flags_);
 }
@@ -526,21 +651,56 @@ rtp_error_t uvgrtp::media_stream::push_frame(uint8_t *data, size_t data_len, int
     rtp_error_t ret = check_push_preconditions(rtp_flags, false);
     if (ret == RTP_OK)
     {
-        if (rce_flags_ & RCE_HOLEPUNCH_KEEPALIVE)
-            holepuncher_->notify();
+        ret = queue_frame(raw_frame_request(data, data_len, rtp_flags));
+    }
 
-        if (rtp_flags & RTP_COPY)
-        {
-            data = copy_frame(data, data_len);
-            std::unique_ptr<uint8_t[]> data_copy(data);
-            ret = media_->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, std::move(data_copy), data_len, rtp_flags);
-        }
-        else
-        {
-            ret = media_->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, data, data_len, rtp_flags);
-        }
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::push_frame(uint8_t *data, size_t data_len, int rtp_flags,
+    void *arg, void (*release)(void *, uint8_t *))
+{
+    if (!release || (rtp_flags & RTP_COPY))
+        return RTP_INVALID_VALUE;
+
+    rtp_error_t ret = check_push_preconditions(rtp_flags, false);
+    if (ret != RTP_OK)
+        return ret;
+
+    uvgrtp::send_request request = raw_frame_request(data, data_len, rtp_flags);
+
+    if (send_queue_) {
+        request.release     = release;
+        request.release_arg = arg;
     }
 
+    // without the send queue the frame has been sent when queue_frame() returns
+    if ((ret = queue_frame(std::move(request))) == RTP_OK && !send_queue_)
+        release(arg, data);
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::async_push_frame(uint8_t *data, size_t data_len, int rtp_flags,
+    std::function<void(rtp_error_t)> done)
+{
+    if (!done)
+        return RTP_INVALID_VALUE;
+
+    rtp_error_t ret = check_push_preconditions(rtp_flags, false);
+    if (ret != RTP_OK)
+        return ret;
+
+    uvgrtp::send_request request = raw_frame_request(data, data_len, rtp_flags);
+
+    if (send_queue_) {
+        request.done = done;
+    }
+
+    // without the send queue the frame has been sent when queue_frame() returns
+    if ((ret = queue_frame(std::move(request))) == RTP_OK && !send_queue_)
+        done(RTP_OK);
+
     return ret;
 }
 
@@ -549,11 +709,8 @@ rtp_error_t uvgrtp::media_stream::push_frame(std::unique_ptr<uint8_t[]> data, si
     rtp_error_t ret = check_push_preconditions(rtp_flags, true);
     if (ret == RTP_OK)
     {
-        if (rce_flags_ & RCE_HOLEPUNCH_KEEPALIVE)
-            holepuncher_->notify();
-
         // making a copy of a smart pointer does not make sense
-        ret = media_->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, std::move(data), data_len, rtp_flags);
+        ret = queue_frame(owned_frame_request(std::move(data), data_len, rtp_flags));
     }
 
     return ret;
@@ -564,21 +721,11 @@ rtp_error_t uvgrtp::media_stream::push_frame(uint8_t *data, size_t data_len, uin
     rtp_error_t ret = check_push_preconditions(rtp_flags, false);
     if (ret == RTP_OK)
     {
-        if (rce_flags_ & RCE_HOLEPUNCH_KEEPALIVE)
-            holepuncher_->notify();
+        uvgrtp::send_request request = raw_frame_request(data, data_len, rtp_flags);
+        request.has_ts = true;
+        request.ts     = ts;
 
-        rtp_->set_timestamp(ts);
-        if (rtp_flags & RTP_COPY)
-        {
-            data = copy_frame(data, data_len);
-            std::unique_ptr<uint8_t[]> data_copy(data);
-            ret = media_->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, std::move(data_copy), data_len, rtp_flags);
-        }
-        else
-        {
-            ret = media_->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, data, data_len, rtp_flags);
-        }
-        rtp_->set_timestamp(INVALID_TS);
+        ret = queue_frame(std::move(request));
     }
 
     return ret;
@@ -589,22 +736,13 @@ rtp_error_t uvgrtp::media_stream::push_frame(uint8_t* data, size_t data_len, uin
     rtp_error_t ret = check_push_preconditions(rtp_flags, false);
     if (ret == RTP_OK)
     {
-        if (rce_flags_ & RCE_HOLEPUNCH_KEEPALIVE)
-            holepuncher_->notify();
+        uvgrtp::send_request request = raw_frame_request(data, data_len, rtp_flags);
+        request.has_ts     = true;
+        request.ts         = ts;
+        request.has_ntp_ts = true;
+        request.ntp_ts     = ntp_ts;
 
-        rtp_->set_timestamp(ts);
-        rtp_->set_sampling_ntp(ntp_ts);
-        if (rtp_flags & RTP_COPY)
-        {
-            data = copy_frame(data, data_len);
-            std::unique_ptr<uint8_t[]> data_copy(data);
-            ret = media_->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, std::move(data_copy), data_len, rtp_flags);
-        }
-        else
-        {
-            ret = media_->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, data, data_len, rtp_flags);
-        }
-        rtp_->set_timestamp(INVALID_TS);
+        ret = queue_frame(std::move(request));
     }
 
     return ret;
@@ -615,13 +753,12 @@ rtp_error_t uvgrtp::media_stream::push_frame(std::unique_ptr<uint8_t[]> data, si
     rtp_error_t ret = check_push_preconditions(rtp_flags, true);
     if (ret == RTP_OK)
     {
-        if (rce_flags_ & RCE_HOLEPUNCH_KEEPALIVE)
-            holepuncher_->notify();
-
         // making a copy of a smart pointer does not make sense
-        rtp_->set_timestamp(ts);
-        ret = media_->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, std::move(data), data_len, rtp_flags);
-        rtp_->set_timestamp(INVALID_TS);
+        uvgrtp::send_request request = owned_frame_request(std::move(data), data_len, rtp_flags);
+        request.has_ts = true;
+        request.ts     = ts;
+
+        ret = queue_frame(std::move(request));
     }
 
     return ret;
@@ -632,18 +769,276 @@ rtp_error_t uvgrtp::media_stream::push_frame(std::unique_ptr<uint8_t[]> data, si
     rtp_error_t ret = check_push_preconditions(rtp_flags, true);
     if (ret == RTP_OK)
     {
-        if (rce_flags_ & RCE_HOLEPUNCH_KEEPALIVE)
-            holepuncher_->notify();
-
         // making a copy of a smart pointer does not make sense
-        rtp_->set_timestamp(ts);
-        rtp_->set_sampling_ntp(ntp_ts);
-        ret = media_->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, std::move(data), data_len, rtp_flags);
+        uvgrtp::send_request request = owned_frame_request(std::move(data), data_len, rtp_flags);
+        request.has_ts     = true;
+        request.ts         = ts;
+        request.has_ntp_ts = true;
+        request.ntp_ts     = ntp_ts;
+
+        ret = queue_frame(std::move(request));
+    }
+
+    return ret;
+}
+rtp_error_t uvgrtp::media_stream::push_frame(uint8_t *data, size_t data_len,
+    const std::vector<uvgrtp::frame::nal_unit>& nal_units, int rtp_flags)
+{
+    rtp_error_t ret = check_push_preconditions(rtp_flags, false);
+    if (ret == RTP_OK)
+    {
+        // the offsets are the same in the copy
+        uvgrtp::send_request request = raw_frame_request(data, data_len, rtp_flags);
+        request.has_nal_units = true;
+        request.nal_units     = nal_units;
+
+        ret = queue_frame(std::move(request));
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::push_frame(uint8_t *data, size_t data_len,
+    const std::vector<uvgrtp::frame::nal_unit>& nal_units, uint32_t ts, int rtp_flags)
+{
+    rtp_error_t ret = check_push_preconditions(rtp_flags, false);
+    if (ret == RTP_OK)
+    {
+        uvgrtp::send_request request = raw_frame_request(data, data_len, rtp_flags);
+        request.has_nal_units = true;
+        request.nal_units     = nal_units;
+        request.has_ts        = true;
+        request.ts            = ts;
+
+        ret = queue_frame(std::move(request));
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::push_scanlines(const std::vector<uint8_t *>& lines, int rtp_flags)
+{
+    rtp_error_t ret = check_push_preconditions(rtp_flags, false);
+    if (ret == RTP_OK)
+    {
+        ret = queue_frame(scanline_request(lines, rtp_flags));
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::push_scanlines(const std::vector<uint8_t *>& lines, uint32_t ts, int rtp_flags)
+{
+    rtp_error_t ret = check_push_preconditions(rtp_flags, false);
+    if (ret == RTP_OK)
+    {
+        uvgrtp::send_request request = scanline_request(lines, rtp_flags);
+        request.has_ts = true;
+        request.ts     = ts;
+
+        ret = queue_frame(std::move(request));
+    }
+
+    return ret;
+}
+
+uvgrtp::send_request uvgrtp::media_stream::scanline_request(const std::vector<uint8_t *>& lines, int rtp_flags)
+{
+    uvgrtp::send_request request;
+    request.rtp_flags = rtp_flags;
+
+    if (lines.empty())
+        return request;
+
+    request.data = lines[0];
+
+    /* A copy of the lines is one contiguous frame, which the raw video format
+     * packetizes the same way as separate lines */
+    size_t line_len = (size_t)video_width_ / std::max(video_pgroup_pixels_, (size_t)1) * video_pgroup_size_;
+
+    if ((rtp_flags & RTP_COPY) && line_len > 0) {
+        request.data = nullptr;
+        request.len  = line_len * lines.size();
+        request.copy = copy_pool_->alloc(request.len);
+
+        if (!request.copy) {
+            request.copy_failed = true;
+            return request;
+        }
+
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (lines[i])
+                memcpy(request.copy.get() + i * line_len, lines[i], line_len);
+        }
+        return request;
+    }
+
+    request.has_lines = true;
+    request.lines     = lines;
+    return request;
+}
+
+uvgrtp::send_request uvgrtp::media_stream::raw_frame_request(uint8_t *data, size_t data_len, int rtp_flags)
+{
+    uvgrtp::send_request request;
+    request.len       = data_len;
+    request.rtp_flags = rtp_flags;
+
+    // the copy is made here so that the application may reuse its buffer even if the frame is queued
+    if ((rtp_flags & RTP_COPY) && data && data_len > 0) {
+        if ((request.copy = copy_pool_->alloc(data_len)))
+            memcpy(request.copy.get(), data, data_len);
+        else
+            request.copy_failed = true;
+    } else {
+        request.data = data;
+    }
+
+    return request;
+}
+
+uvgrtp::send_request uvgrtp::media_stream::owned_frame_request(std::unique_ptr<uint8_t[]> data, size_t data_len, int rtp_flags)
+{
+    uvgrtp::send_request request;
+    request.owned     = std::move(data);
+    request.len       = data_len;
+    request.rtp_flags = rtp_flags;
+
+    return request;
+}
+
+rtp_error_t uvgrtp::media_stream::queue_frame(uvgrtp::send_request&& request)
+{
+    if (request.copy_failed) {
+        UVG_LOG_ERROR("Failed to copy a frame of %zu bytes", request.len);
+        return RTP_MEMORY_ERROR;
+    }
+
+    UVG_TRACE(FRAME_PUSHED, ssrc_->load(), request.has_ts ? request.ts : 0, request.len);
+
+    if (rce_flags_ & RCE_HOLEPUNCH_KEEPALIVE)
+        holepuncher_->notify();
+
+    if (send_queue_)
+        return send_queue_->enqueue(std::move(request));
+
+    return send_frame(request);
+}
+
+rtp_error_t uvgrtp::media_stream::prepare_audio_packet(uint8_t *data, size_t data_len, const uint32_t *ts,
+    uvgrtp::socket *& socket, uvgrtp::addressed_packet& packet)
+{
+    rtp_error_t ret = check_push_preconditions(RTP_NO_FLAGS, false);
+    if (ret != RTP_OK)
+        return ret;
+
+    if (!data || !data_len)
+        return RTP_INVALID_VALUE;
+
+    // video is packetized by its format and the sender thread owns the sending of RCE_ASYNC_SEND
+    if (!media_ || send_queue_ || fmt_ == RTP_FORMAT_H264 || fmt_ == RTP_FORMAT_H265 ||
+        fmt_ == RTP_FORMAT_H266 || fmt_ == RTP_FORMAT_RAW_VIDEO)
+        return RTP_NOT_SUPPORTED;
+
+    if (ts)
+        rtp_->set_timestamp(*ts);
+
+    uvgrtp::buf_vec *buffers = media_->prepare_single_packet(data, data_len);
+
+    if (ts)
+        rtp_->set_timestamp(INVALID_TS);
+
+    if (!buffers)
+        return RTP_NOT_SUPPORTED;
+
+    UVG_TRACE(FRAME_PUSHED, ssrc_->load(), ts ? *ts : 0, data_len);
+
+    if (rce_flags_ & RCE_HOLEPUNCH_KEEPALIVE)
+        holepuncher_->notify();
+
+    if ((ret = socket_->run_handlers(*buffers)) != RTP_OK) {
+        metrics_->count(uvgrtp::stream_metrics::SEND_ERRORS);
+        return ret;
+    }
+
+    socket = socket_.get();
+    packet = { buffers, &remote_sockaddr_, &remote_sockaddr_ip6_ };
+    return RTP_OK;
+}
+
+void uvgrtp::media_stream::audio_packet_sent(rtp_error_t ret, size_t data_len)
+{
+    if (ret == RTP_OK) {
+        media_->single_packet_sent();
+        metrics_->count(uvgrtp::stream_metrics::SENT_FRAMES);
+        metrics_->count(uvgrtp::stream_metrics::SENT_BYTES, data_len);
+    } else {
+        metrics_->count(uvgrtp::stream_metrics::SEND_ERRORS);
+    }
+}
+
+rtp_error_t uvgrtp::media_stream::send_frame(uvgrtp::send_request& request)
+{
+    rtp_error_t ret = RTP_OK;
+
+    if (!request.simulcast.empty())
+        return send_simulcast(request);
+
+    if (request.has_ts)
+        rtp_->set_timestamp(request.ts);
+
+    if (request.has_ntp_ts)
+        rtp_->set_sampling_ntp(request.ntp_ts);
+
+    if (request.has_lines) {
+        ret = media_->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, request.lines, request.rtp_flags);
+    }
+    else if (request.has_nal_units) {
+        uint8_t *data = request.copy ? request.copy.get() : request.owned ? request.owned.get() : request.data;
+        ret = media_->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, data, request.len, request.nal_units, request.rtp_flags);
+    }
+    else if (request.owned) {
+        ret = media_->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, std::move(request.owned), request.len, request.rtp_flags);
+    }
+    else {
+        // the transaction is done with the copy when push_frame() returns, and it goes back to the pool with the request
+        uint8_t *data = request.copy ? request.copy.get() : request.data;
+        ret = media_->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, data, request.len, request.rtp_flags);
+    }
+
+    if (request.has_ts)
         rtp_->set_timestamp(INVALID_TS);
+
+    if (ret == RTP_OK) {
+        metrics_->count(uvgrtp::stream_metrics::SENT_FRAMES);
+        metrics_->count(uvgrtp::stream_metrics::SENT_BYTES, request.len);
+    } else {
+        metrics_->count(uvgrtp::stream_metrics::SEND_ERRORS);
     }
 
     return ret;
 }
+
+rtp_error_t uvgrtp::media_stream::install_send_complete_hook(void *arg, void (*hook)(void *, uint8_t *, rtp_error_t))
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (!hook) {
+        return RTP_INVALID_VALUE;
+    }
+
+    if (!send_queue_) {
+        UVG_LOG_ERROR("The completion hook requires RCE_ASYNC_SEND");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    send_queue_->install_complete_hook(arg, hook);
+    return RTP_OK;
+}
+
 /* Disabled for now
 rtp_error_t uvgrtp::media_stream::push_user_packet(uint8_t* data, uint32_t len)
 {
@@ -677,6 +1072,15 @@ rtp_error_t uvgrtp::media_stream::install_user_receive_hook(void* arg, void (*ho
 
 }*/
 
+/* The frames given to the application pass RTP_TRACE_FRAME_PULLED */
+static inline uvgrtp::frame::rtp_frame *trace_pulled(uvgrtp::frame::rtp_frame *frame)
+{
+    if (frame)
+        UVG_TRACE(FRAME_PULLED, frame->header.ssrc, frame->header.timestamp, frame->payload_len);
+
+    return frame;
+}
+
 uvgrtp::frame::rtp_frame *uvgrtp::media_stream::pull_frame()
 {
     if (!check_pull_preconditions()) {
@@ -684,9 +1088,9 @@ uvgrtp::frame::rtp_frame *uvgrtp::media_stream::pull_frame()
     }
     // If the remote_ssrc is set, only pull frames that come from this ssrc
     if (remote_ssrc_.get()->load() != ssrc_.get()->load() + 1) {
-        return reception_flow_->pull_frame(remote_ssrc_);
+        return trace_pulled(reception_flow_->pull_frame(remote_ssrc_));
     }
-    return reception_flow_->pull_frame();
+    return trace_pulled(reception_flow_->pull_frame());
 
 }
 
@@ -697,207 +1101,1678 @@ uvgrtp::frame::rtp_frame *uvgrtp::media_stream::pull_frame(size_t timeout_ms)
     }
     // If the remote_ssrc is set, only pull frames that come from this ssrc
     if (remote_ssrc_.get()->load() != ssrc_.get()->load() + 1) {
-        return reception_flow_->pull_frame(timeout_ms, remote_ssrc_);
+        return trace_pulled(reception_flow_->pull_frame(timeout_ms, remote_ssrc_));
     }
-    return reception_flow_->pull_frame(timeout_ms);
+    return trace_pulled(reception_flow_->pull_frame(timeout_ms));
 
 }
 
-bool uvgrtp::media_stream::check_pull_preconditions()
+size_t uvgrtp::media_stream::pull_frames(uvgrtp::frame::rtp_frame **frames, size_t max_frames, size_t timeout_ms)
 {
-    if (!initialized_) {
-        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
-        rtp_errno = RTP_NOT_INITIALIZED;
-        return false;
+    if (!frames || max_frames == 0 || !check_pull_preconditions()) {
+        return 0;
+    }
+    // If the remote_ssrc is set, only pull frames that come from this ssrc
+    size_t pulled = 0;
+    if (remote_ssrc_.get()->load() != ssrc_.get()->load() + 1) {
+        pulled = reception_flow_->pull_frames(frames, max_frames, timeout_ms, remote_ssrc_);
+    } else {
+        pulled = reception_flow_->pull_frames(frames, max_frames, timeout_ms, nullptr);
     }
 
-    return true;
+    for (size_t i = 0; i < pulled; ++i) {
+        (void)trace_pulled(frames[i]);
+    }
+    return pulled;
 }
 
-rtp_error_t uvgrtp::media_stream::check_push_preconditions(int rtp_flags, bool smart_pointer)
+rtp_error_t uvgrtp::media_stream::async_pull_frame(std::function<void(uvgrtp::frame::rtp_frame *)> handler)
 {
-    if (!initialized_) {
-        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
-        return RTP_NOT_INITIALIZED;
-    }
-
-    if (remote_address_ == "" && dst_port_ != 0)
-    {
-        UVG_LOG_ERROR("Cannot push frame if remote address and port have not been provided!");
+    if (!handler) {
         return RTP_INVALID_VALUE;
     }
 
-    if (rtp_flags & RTP_OBSOLETE)
-    {
-        UVG_LOG_WARN("Detected an obsolete RTP flag, consider updating your flags");
+    if (!check_pull_preconditions()) {
+        return RTP_NOT_INITIALIZED;
     }
 
-    if (rce_flags_ & RCE_RECEIVE_ONLY)
-    {
-        UVG_LOG_WARN("Stream is designated as RECEIVE ONLY");
-        return RTP_GENERIC_ERROR;
-    }
+    if (!async_pulling_.exchange(true)) {
+        uvgrtp::delivery_queue& queue = reception_flow_->get_delivery_queue();
+        async_pulls_->set_limits(queue.get_max_frames(), queue.get_max_bytes(), queue.get_policy());
+
+        /* The hook only holds the pulls, which outlive the stream until the hook is removed.
+         * A receive hook of the application is not replaced, as it would no longer get the frames */
+        std::shared_ptr<uvgrtp::async_pulls> pulls = async_pulls_;
+        rtp_error_t ret = reception_flow_->install_receive_hook([pulls](uvgrtp::frame::rtp_frame *frame) {
+            pulls->deliver(trace_pulled(frame));
+        }, remote_ssrc_.get()->load(), false);
+
+        if (ret != RTP_OK) {
+            UVG_LOG_ERROR("The stream has a receive hook, frames cannot be pulled asynchronously");
+            async_pulling_ = false;
+            return ret;
+        }
+
+        // frames that arrived before the hook was installed go to the pulls too
+        const std::atomic<std::uint32_t> *ssrc = nullptr;
+        if (remote_ssrc_.get()->load() != ssrc_.get()->load() + 1) {
+            ssrc = remote_ssrc_.get();
+        }
+
+        while (uvgrtp::frame::rtp_frame *frame = queue.pop(ssrc)) {
+            async_pulls_->deliver(trace_pulled(frame));
+        }
+    }
+
+    async_pulls_->pull(std::move(handler));
+    return RTP_OK;
+}
+
+uvgrtp::delivery_queue_stats uvgrtp::media_stream::get_delivery_queue_stats() const
+{
+    if (!reception_flow_)
+        return uvgrtp::delivery_queue_stats();
+
+    return reception_flow_->get_delivery_queue().get_stats();
+}
+
+uvgrtp::stream_stats uvgrtp::media_stream::get_stats() const
+{
+    uvgrtp::stream_stats stats;
+    metrics_->snapshot(stats);
+
+    if (reception_flow_) {
+        stats.ring_full_events      = reception_flow_->get_ring_full_events();
+        stats.ring_watermark_events = reception_flow_->get_ring_watermark_events();
+        stats.ring_resizes          = reception_flow_->get_ring_resizes();
+        stats.kernel_drops          = reception_flow_->get_kernel_drops();
+    }
+
+    stats.memory_usage = memory_budget_->used();
+
+    return stats;
+}
+
+rtp_error_t uvgrtp::media_stream::start_capture(const std::string& path, int directions)
+{
+    if (!initialized_ || !socket_)
+        return RTP_NOT_INITIALIZED;
+
+    return socket_->start_capture(path, directions);
+}
+
+rtp_error_t uvgrtp::media_stream::stop_capture()
+{
+    if (!initialized_ || !socket_)
+        return RTP_NOT_INITIALIZED;
+
+    return socket_->stop_capture();
+}
+
+rtp_error_t uvgrtp::media_stream::start_recording(const std::string& path, int flags)
+{
+    if (!initialized_ || !reception_flow_)
+        return RTP_NOT_INITIALIZED;
+
+    if (recorder_)
+        return RTP_INITIALIZED;
+
+    auto recorder = std::make_shared<uvgrtp::recorder>();
+
+    rtp_error_t ret = recorder->start(path, flags);
+    if (ret != RTP_OK)
+        return ret;
+
+    recorder_ = recorder;
+    return reception_flow_->install_recorder(remote_ssrc_, recorder_);
+}
+
+rtp_error_t uvgrtp::media_stream::stop_recording()
+{
+    if (!initialized_ || !reception_flow_ || !recorder_)
+        return RTP_NOT_INITIALIZED;
+
+    (void)reception_flow_->install_recorder(remote_ssrc_, nullptr);
+
+    recorder_->stop();
+    recorder_ = nullptr;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::destination_address(const std::string& address, uint16_t port,
+    sockaddr_in& addr, sockaddr_in6& addr6)
+{
+    int family = socket_->check_family(address);
+
+    if (family != (ipv6_ ? 2 : 1)) {
+        UVG_LOG_ERROR("The destination %s is not an address of the family of the stream", address.c_str());
+        return RTP_INVALID_VALUE;
+    }
+
+    if (ipv6_)
+        addr6 = uvgrtp::socket::create_ip6_sockaddr(address, port);
+    else
+        addr = uvgrtp::socket::create_sockaddr(AF_INET, address, port);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::add_destination(const std::string& address, uint16_t port)
+{
+    return add_destination(address, port, 0, nullptr, nullptr);
+}
+
+rtp_error_t uvgrtp::media_stream::add_destination(const std::string& address, uint16_t port, uint32_t ssrc,
+    uint8_t *key, uint8_t *salt)
+{
+    if (!initialized_ || !media_)
+        return RTP_NOT_INITIALIZED;
+
+    if (rce_flags_ & RCE_RECEIVE_ONLY) {
+        UVG_LOG_ERROR("A RECEIVE_ONLY stream cannot send to destinations");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    if (!key != !salt)
+        return RTP_INVALID_VALUE;
+
+    uvgrtp::fanout_destination destination;
+
+    rtp_error_t ret = destination_address(address, port, destination.addr, destination.addr6);
+    if (ret != RTP_OK)
+        return ret;
+
+    if (ssrc) {
+        destination.ssrc       = ssrc;
+        destination.seq_offset = (uint16_t)uvgrtp::random::generate_32();
+    }
+
+    if (key) {
+        if (!(rce_flags_ & RCE_SRTP)) {
+            UVG_LOG_ERROR("An SRTP key can only be given to the destinations of an SRTP stream");
+            return RTP_NOT_SUPPORTED;
+        }
+
+        destination.srtp = std::make_shared<uvgrtp::srtp>(rce_flags_);
+
+        if ((ret = destination.srtp->init(SRTP, rce_flags_, key, key, salt, salt)) != RTP_OK) {
+            UVG_LOG_ERROR("Failed to initialize the SRTP context of the destination");
+            return ret;
+        }
+    }
+
+    return media_->add_destination(destination);
+}
+
+rtp_error_t uvgrtp::media_stream::remove_destination(const std::string& address, uint16_t port)
+{
+    if (!initialized_ || !media_)
+        return RTP_NOT_INITIALIZED;
+
+    sockaddr_in addr   = {};
+    sockaddr_in6 addr6 = {};
+
+    rtp_error_t ret = destination_address(address, port, addr, addr6);
+    if (ret != RTP_OK)
+        return ret;
+
+    return media_->remove_destination(addr, addr6);
+}
+
+rtp_error_t uvgrtp::media_stream::set_destination_layers(const std::string& address, uint16_t port,
+    uint8_t max_temporal_id, uint8_t max_layer_id)
+{
+    if (!initialized_ || !media_)
+        return RTP_NOT_INITIALIZED;
+
+    if (fmt_ != RTP_FORMAT_H265 && fmt_ != RTP_FORMAT_H266) {
+        UVG_LOG_ERROR("Only the H.265 and H.266 formats have scalable layers");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    if (max_temporal_id > uvgrtp::MAX_TEMPORAL_ID || max_layer_id > uvgrtp::MAX_LAYER_ID)
+        return RTP_INVALID_VALUE;
+
+    sockaddr_in addr   = {};
+    sockaddr_in6 addr6 = {};
+
+    rtp_error_t ret = destination_address(address, port, addr, addr6);
+    if (ret != RTP_OK)
+        return ret;
+
+    return media_->set_destination_layers(addr, addr6, max_temporal_id, max_layer_id);
+}
+
+rtp_error_t uvgrtp::media_stream::add_path(const std::string& local_address, const std::string& remote_address,
+    uint16_t remote_port, uint32_t weight)
+{
+    if (!initialized_ || !media_)
+        return RTP_NOT_INITIALIZED;
+
+    if (rce_flags_ & RCE_RECEIVE_ONLY) {
+        UVG_LOG_ERROR("A RECEIVE_ONLY stream cannot send over paths");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    if (remote_address_ == "" || dst_port_ == 0) {
+        UVG_LOG_ERROR("The paths need the remote address of the stream");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    if (weight == 0)
+        return RTP_INVALID_VALUE;
+
+    std::vector<uvgrtp::send_path> paths;
+
+    if (paths_) {
+        paths = *paths_;
+    } else {
+        uvgrtp::send_path own;
+        own.local_address = local_address_;
+        own.socket        = socket_;
+        own.addr          = remote_sockaddr_;
+        own.addr6         = remote_sockaddr_ip6_;
+        paths.push_back(own);
+    }
+
+    if (local_address.empty()) {
+        if (!remote_address.empty() || remote_port)
+            return RTP_INVALID_VALUE;
+
+        paths[0].weight = weight;
+    } else {
+        if (paths.size() == uvgrtp::MAX_SEND_PATHS) {
+            UVG_LOG_ERROR("A stream can send over at most %zu paths", uvgrtp::MAX_SEND_PATHS);
+            return RTP_INVALID_VALUE;
+        }
+
+        for (size_t i = 1; i < paths.size(); ++i) {
+            if (paths[i].local_address == local_address)
+                return RTP_INVALID_VALUE;
+        }
+
+        uvgrtp::send_path path;
+        path.local_address = local_address;
+        path.weight        = weight;
+
+        rtp_error_t ret = destination_address(remote_address.empty() ? remote_address_ : remote_address,
+            remote_port ? remote_port : dst_port_, path.addr, path.addr6);
+        if (ret != RTP_OK)
+            return ret;
+
+        if (socket_->check_family(local_address) != (ipv6_ ? 2 : 1)) {
+            UVG_LOG_ERROR("The local address %s is not an address of the family of the stream", local_address.c_str());
+            return RTP_INVALID_VALUE;
+        }
+
+        // the path only sends, so its socket is bound to any port of the interface
+        path.socket = std::make_shared<uvgrtp::socket>(rce_flags_);
+
+        if ((ret = path.socket->init(ipv6_ ? AF_INET6 : AF_INET, SOCK_DGRAM, 0)) != RTP_OK)
+            return ret;
+
+        if (ipv6_) {
+            sockaddr_in6 local = uvgrtp::socket::create_ip6_sockaddr(local_address, 0);
+            ret = path.socket->bind_ip6(local);
+        } else {
+            sockaddr_in local = uvgrtp::socket::create_sockaddr(AF_INET, local_address, 0);
+            ret = path.socket->bind(local);
+        }
+
+        if (ret != RTP_OK) {
+            UVG_LOG_ERROR("Failed to bind the socket of the path to %s", local_address.c_str());
+            return RTP_BIND_ERROR;
+        }
+
+        bool video = fmt_ == RTP_FORMAT_H264 || fmt_ == RTP_FORMAT_H265 || fmt_ == RTP_FORMAT_H266 ||
+            fmt_ == RTP_FORMAT_RAW_VIDEO;
+        sfp_->apply_socket_profile(path.socket, video ? RTP_SOCKET_VIDEO : RTP_SOCKET_AUDIO);
+
+        paths.push_back(path);
+    }
+
+    paths_ = std::make_shared<const std::vector<uvgrtp::send_path>>(std::move(paths));
+    media_->set_paths(paths_);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::remove_path(const std::string& local_address)
+{
+    if (!initialized_ || !media_)
+        return RTP_NOT_INITIALIZED;
+
+    if (!paths_ || local_address.empty())
+        return RTP_NOT_FOUND;
+
+    std::vector<uvgrtp::send_path> paths;
+
+    // the socket of the stream is always the first path
+    paths.push_back(paths_->front());
+    for (size_t i = 1; i < paths_->size(); ++i) {
+        if ((*paths_)[i].local_address != local_address)
+            paths.push_back((*paths_)[i]);
+    }
+
+    if (paths.size() == paths_->size())
+        return RTP_NOT_FOUND;
+
+    if (paths.size() == 1)
+        paths_ = nullptr;
+    else
+        paths_ = std::make_shared<const std::vector<uvgrtp::send_path>>(std::move(paths));
+
+    media_->set_paths(paths_);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::add_receive_path(const std::string& local_address, uint16_t local_port)
+{
+    if (!initialized_ || !reception_flow_)
+        return RTP_NOT_INITIALIZED;
+
+    if (rce_flags_ & RCE_SEND_ONLY) {
+        UVG_LOG_ERROR("A SEND_ONLY stream cannot receive over paths");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    if (local_address.empty() || local_port == 0)
+        return RTP_INVALID_VALUE;
+
+    if (receive_paths_.find({ local_address, local_port }) != receive_paths_.end())
+        return RTP_INVALID_VALUE;
+
+    if (socket_->check_family(local_address) != (ipv6_ ? 2 : 1)) {
+        UVG_LOG_ERROR("The local address %s is not an address of the family of the stream", local_address.c_str());
+        return RTP_INVALID_VALUE;
+    }
+
+    std::shared_ptr<uvgrtp::socket> socket = std::make_shared<uvgrtp::socket>(rce_flags_);
+    rtp_error_t ret = RTP_OK;
+
+    if ((ret = socket->init(ipv6_ ? AF_INET6 : AF_INET, SOCK_DGRAM, 0)) != RTP_OK)
+        return ret;
+
+    if (ipv6_) {
+        sockaddr_in6 local = uvgrtp::socket::create_ip6_sockaddr(local_address, local_port);
+        ret = socket->bind_ip6(local);
+    } else {
+        sockaddr_in local = uvgrtp::socket::create_sockaddr(AF_INET, local_address, local_port);
+        ret = socket->bind(local);
+    }
+
+    if (ret != RTP_OK) {
+        UVG_LOG_ERROR("Failed to bind the socket of the receive path to %s:%u", local_address.c_str(), local_port);
+        return RTP_BIND_ERROR;
+    }
+
+    bool video = fmt_ == RTP_FORMAT_H264 || fmt_ == RTP_FORMAT_H265 || fmt_ == RTP_FORMAT_H266 ||
+        fmt_ == RTP_FORMAT_RAW_VIDEO;
+    sfp_->apply_socket_profile(socket, video ? RTP_SOCKET_VIDEO : RTP_SOCKET_AUDIO);
+
+    if ((ret = reception_flow_->add_receive_path(socket)) != RTP_OK)
+        return ret;
+
+    if (!redundancy_window_)
+        (void)configure_ctx(RCC_REDUNDANCY_WINDOW, uvgrtp::DEFAULT_REDUNDANCY_WINDOW);
+
+    receive_paths_[{ local_address, local_port }] = socket;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::remove_receive_path(const std::string& local_address, uint16_t local_port)
+{
+    if (!initialized_ || !reception_flow_)
+        return RTP_NOT_INITIALIZED;
+
+    auto path = receive_paths_.find({ local_address, local_port });
+    if (path == receive_paths_.end())
+        return RTP_NOT_FOUND;
+
+    reception_flow_->remove_receive_path(path->second);
+    receive_paths_.erase(path);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::get_parameter_sets(std::vector<uint8_t>& parameter_sets)
+{
+    if (!initialized_ || !media_)
+        return RTP_NOT_INITIALIZED;
+
+    if (fmt_ != RTP_FORMAT_H264 && fmt_ != RTP_FORMAT_H265 && fmt_ != RTP_FORMAT_H266) {
+        UVG_LOG_ERROR("The parameter sets are only supported by the H26x formats");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    return static_cast<uvgrtp::formats::h26x *>(media_.get())->get_parameter_sets(parameter_sets);
+}
+
+rtp_error_t uvgrtp::media_stream::add_forward_target(uvgrtp::media_stream *target)
+{
+    if (!target || target == this)
+        return RTP_INVALID_VALUE;
+
+    if (!initialized_ || !reception_flow_ || !target->initialized_ || !target->socket_)
+        return RTP_NOT_INITIALIZED;
+
+    if ((rce_flags_ & RCE_SEND_ONLY) || (target->rce_flags_ & RCE_RECEIVE_ONLY)) {
+        UVG_LOG_ERROR("Packets can only be forwarded from a receiving stream to a sending stream");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    if ((rce_flags_ & RCE_SRTP) || (target->rce_flags_ & RCE_SRTP)) {
+        UVG_LOG_ERROR("SRTP streams cannot forward packets");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    rtp_error_t ret = create_forwarder();
+    if (ret != RTP_OK)
+        return ret;
+
+    forwarder_->add_target(target, target->socket_, target->remote_sockaddr_, target->remote_sockaddr_ip6_,
+        target->ssrc_, target->rtp_->get_sequence(), target->rtp_->get_rtp_ts());
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::remove_forward_target(uvgrtp::media_stream *target)
+{
+    if (!initialized_)
+        return RTP_NOT_INITIALIZED;
+
+    if (!forwarder_)
+        return RTP_NOT_FOUND;
+
+    return forwarder_->remove_target(target);
+}
+
+rtp_error_t uvgrtp::media_stream::install_forward_hook(void *arg, int (*hook)(void *arg, uint8_t *packet, size_t size))
+{
+    if (!initialized_ || !reception_flow_)
+        return RTP_NOT_INITIALIZED;
+
+    if ((rce_flags_ & RCE_SEND_ONLY) || (rce_flags_ & RCE_SRTP))
+        return RTP_NOT_SUPPORTED;
+
+    rtp_error_t ret = create_forwarder();
+    if (ret != RTP_OK)
+        return ret;
+
+    forwarder_->set_hook(arg, hook);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::multicast_group_address(const std::string& group, in6_addr& address) const
+{
+    if (ipv6_) {
+        address = uvgrtp::socket::create_ip6_sockaddr(group, 0).sin6_addr;
+    } else {
+        address = uvgrtp::socket::mapped_address(uvgrtp::socket::create_sockaddr(AF_INET, group, 0));
+    }
+
+    return uvgrtp::socket::is_multicast(address) ? RTP_OK : RTP_INVALID_VALUE;
+}
+
+rtp_error_t uvgrtp::media_stream::join_multicast_group(const std::string& group, const std::string& source)
+{
+    if (!initialized_ || !reception_flow_)
+        return RTP_NOT_INITIALIZED;
+
+    if (rce_flags_ & RCE_SEND_ONLY)
+        return RTP_NOT_SUPPORTED;
+
+    in6_addr address;
+    rtp_error_t ret = multicast_group_address(group, address);
+    if (ret != RTP_OK)
+        return ret;
+
+    // without the destinations the packets of the groups are given to the streams by their SSRC
+    bool destinations = socket_->enable_destination_addresses() == RTP_OK;
+
+    if (destinations && (ret = reception_flow_->add_group(remote_ssrc_, address)) != RTP_OK) {
+        UVG_LOG_ERROR("Another stream of the socket has joined %s", group.c_str());
+        return ret;
+    }
+
+    if ((ret = socket_->join_group(group, source)) != RTP_OK) {
+        if (destinations && joined_groups_.find(group) == joined_groups_.end())
+            reception_flow_->remove_group(remote_ssrc_, address);
+        return ret;
+    }
+
+    joined_groups_[group].insert(source);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::leave_multicast_group(const std::string& group, const std::string& source)
+{
+    if (!initialized_ || !reception_flow_)
+        return RTP_NOT_INITIALIZED;
+
+    in6_addr address;
+    rtp_error_t ret = multicast_group_address(group, address);
+    if (ret != RTP_OK)
+        return ret;
+
+    if ((ret = socket_->leave_group(group, source)) != RTP_OK)
+        return ret;
+
+    auto it = joined_groups_.find(group);
+    if (it != joined_groups_.end()) {
+        it->second.erase(source);
+
+        if (it->second.empty()) {
+            joined_groups_.erase(it);
+            reception_flow_->remove_group(remote_ssrc_, address);
+        }
+    }
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::create_forwarder()
+{
+    if (forwarder_)
+        return RTP_OK;
+
+    forwarder_ = std::make_shared<uvgrtp::forwarder>();
+    return reception_flow_->install_forwarder(remote_ssrc_, forwarder_);
+}
+
+rtp_error_t uvgrtp::media_stream::replay_capture(const std::string& path, double speed)
+{
+    if (!initialized_ || !reception_flow_)
+        return RTP_NOT_INITIALIZED;
+
+    if (speed < 0) {
+        UVG_LOG_ERROR("The replay speed cannot be negative");
+        return RTP_INVALID_VALUE;
+    }
+
+    uvgrtp::capture_reader reader;
+
+    rtp_error_t ret = reader.open(path);
+    if (ret != RTP_OK)
+        return ret;
+
+    return reception_flow_->replay(reader, src_port_, speed);
+}
+
+rtp_error_t uvgrtp::media_stream::play_file(const std::string& path, size_t loops, int rtp_flags)
+{
+    if (!initialized_)
+        return RTP_NOT_INITIALIZED;
+
+    if (fmt_ != RTP_FORMAT_H264 && fmt_ != RTP_FORMAT_H265 && fmt_ != RTP_FORMAT_H266)
+        return RTP_NOT_SUPPORTED;
+
+    // the frames of the sender thread would outlive the mapping
+    if (send_queue_) {
+        UVG_LOG_ERROR("Playing a file is not supported with RCE_ASYNC_SEND");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    if (rtp_flags & RTP_COPY)
+        return RTP_INVALID_VALUE;
+
+    rtp_error_t ret = RTP_OK;
+    std::shared_ptr<const uvgrtp::annexb_file> file = uvgrtp::annexb_file::open(path, fmt_, ret);
+    if (!file)
+        return ret;
+
+    // with RCE_FRAME_RATE the frame queue keeps the rate, otherwise the frames are timed here
+    const bool timed = !(rce_flags_ & RCE_FRAME_RATE) && fps_numerator_ > 0 && fps_denominator_ > 0;
+    const std::chrono::nanoseconds interval(timed ? 1000000000LL * fps_denominator_ / fps_numerator_ : 0);
+    std::chrono::steady_clock::time_point due = std::chrono::steady_clock::now();
+
+    stop_file_ = false;
+
+    for (size_t loop = 0; loops == 0 || loop < loops; ++loop) {
+        for (auto& au : file->access_units()) {
+            if (stop_file_)
+                return RTP_INTERRUPTED;
+
+            if (timed) {
+                std::this_thread::sleep_until(due);
+                due += interval;
+            }
+
+            // the mapping is read only, the frame queue only reads the NAL units given to it
+            if ((ret = push_frame((uint8_t *)file->data() + au.offset, au.size, au.nal_units, rtp_flags)) != RTP_OK)
+                return ret;
+        }
+    }
+
+    return RTP_OK;
+}
+
+void uvgrtp::media_stream::stop_file()
+{
+    stop_file_ = true;
+}
+
+bool uvgrtp::media_stream::check_pull_preconditions()
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        rtp_errno = RTP_NOT_INITIALIZED;
+        return false;
+    }
+
+    return true;
+}
+
+rtp_error_t uvgrtp::media_stream::check_push_preconditions(int rtp_flags, bool smart_pointer)
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (remote_address_ == "" && dst_port_ != 0)
+    {
+        UVG_LOG_ERROR("Cannot push frame if remote address and port have not been provided!");
+        return RTP_INVALID_VALUE;
+    }
+
+    if (rtp_flags & RTP_OBSOLETE)
+    {
+        UVG_LOG_WARN("Detected an obsolete RTP flag, consider updating your flags");
+    }
+
+    if (rce_flags_ & RCE_RECEIVE_ONLY)
+    {
+        UVG_LOG_WARN("Stream is designated as RECEIVE ONLY");
+        return RTP_GENERIC_ERROR;
+    }
 
     if (smart_pointer && (rtp_flags & RTP_COPY))
     {
         UVG_LOG_ERROR("Copying a smart pointer does not make sense since the original would be lost");
     }
 
-    return RTP_OK;
-}
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::install_receive_hook(void *arg, void (*hook)(void *, uvgrtp::frame::rtp_frame *))
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (!hook) {
+        return RTP_INVALID_VALUE;
+    }
+    return reception_flow_->install_receive_hook([arg, hook](uvgrtp::frame::rtp_frame *frame) {
+        hook(arg, frame);
+    }, remote_ssrc_.get()->load());
+}
+
+rtp_error_t uvgrtp::media_stream::install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame *)> hook)
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (!hook) {
+        return RTP_INVALID_VALUE;
+    }
+    return reception_flow_->install_receive_hook(hook, remote_ssrc_.get()->load());
+}
+
+rtp_error_t uvgrtp::media_stream::install_receive_batch_hook(void *arg, void (*hook)(void *, uvgrtp::frame::rtp_frame **, size_t))
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (!hook) {
+        return RTP_INVALID_VALUE;
+    }
+    return reception_flow_->install_receive_batch_hook([arg, hook](uvgrtp::frame::rtp_frame **frames, size_t count) {
+        hook(arg, frames, count);
+    }, remote_ssrc_.get()->load());
+}
+
+rtp_error_t uvgrtp::media_stream::install_receive_batch_hook(std::function<void(uvgrtp::frame::rtp_frame **, size_t)> hook)
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (!hook) {
+        return RTP_INVALID_VALUE;
+    }
+    return reception_flow_->install_receive_batch_hook(hook, remote_ssrc_.get()->load());
+}
+
+rtp_error_t uvgrtp::media_stream::install_nal_chunk_hook(void *arg, void (*hook)(void *, const uvgrtp::frame::nal_chunk *))
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (!hook) {
+        return RTP_INVALID_VALUE;
+    }
+    return media_->install_nal_chunk_hook(arg, hook);
+}
+
+rtp_error_t uvgrtp::media_stream::install_video_buffer_hook(void *arg, uint8_t *(*hook)(void *, uint32_t, size_t))
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (!hook) {
+        return RTP_INVALID_VALUE;
+    }
+    return media_->install_video_buffer_hook(arg, hook);
+}
+
+rtp_error_t uvgrtp::media_stream::install_bitrate_hook(void *arg, void (*hook)(void *, uint32_t))
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (!hook) {
+        return RTP_INVALID_VALUE;
+    }
+
+    if (!twcc_) {
+        twcc_ = std::make_shared<uvgrtp::twcc_sender>();
+        twcc_->set_bitrates(twcc_start_kbps_ * 1000, twcc_max_kbps_ * 1000);
+    }
+    twcc_->install_bitrate_hook(arg, hook);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::set_audio_level(uint8_t level, bool voice_activity)
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (level > 127) {
+        return RTP_INVALID_VALUE;
+    }
+
+    media_->set_audio_level(level, voice_activity);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::set_mid(const std::string& mid, const std::string& rid)
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (mid.empty() || mid.size() > uvgrtp::MAX_HEADER_EXTENSION_STRING ||
+        rid.size() > uvgrtp::MAX_HEADER_EXTENSION_STRING) {
+        return RTP_INVALID_VALUE;
+    }
+
+    std::string old_mid = mid_;
+    std::string old_rid = rid_;
+
+    mid_ = mid;
+    rid_ = rid;
+
+    rtp_error_t ret = update_mid_route();
+    if (ret != RTP_OK) {
+        mid_ = old_mid;
+        rid_ = old_rid;
+        return ret;
+    }
+
+    size_t old_size = media_->header_extension_size();
+
+    (void)media_->set_header_extension_value(uvgrtp::EXT_MID, mid_);
+    (void)media_->set_header_extension_value(uvgrtp::EXT_RID, rid_);
+
+    // make room for the header extension in each packet
+    rtp_->set_payload_size(rtp_->get_payload_size() + old_size - media_->header_extension_size());
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::update_mid_route()
+{
+    uint8_t mid_id = media_->header_extension_id(uvgrtp::EXT_MID);
+
+    if (!mid_id || mid_.empty()) {
+        reception_flow_->remove_mid(remote_ssrc_);
+        return RTP_OK;
+    }
+
+    return reception_flow_->add_mid(remote_ssrc_, mid_id, mid_, media_->header_extension_id(uvgrtp::EXT_RID), rid_);
+}
+
+rtp_error_t uvgrtp::media_stream::add_simulcast_layer(const std::string& rid, uint32_t ssrc)
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (rce_flags_ & RCE_RECEIVE_ONLY) {
+        UVG_LOG_ERROR("A RECEIVE_ONLY stream cannot send simulcast layers");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    // the SRTP context of the stream follows the rollovers of one sequence number space
+    if ((rce_flags_ & RCE_SRTP) || fmt_ == RTP_FORMAT_RAW_VIDEO) {
+        UVG_LOG_ERROR("Simulcast layers are not supported with SRTP or raw video");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    if (rid.empty() || rid.size() > uvgrtp::MAX_HEADER_EXTENSION_STRING || rid == rid_)
+        return RTP_INVALID_VALUE;
+
+    for (auto& existing : simulcast_layers_) {
+        if (existing.rid == rid)
+            return RTP_INVALID_VALUE;
+    }
+
+    simulcast_layer layer;
+    layer.rid  = rid;
+    layer.ssrc = std::make_shared<std::atomic<std::uint32_t>>(ssrc ? ssrc : uvgrtp::random::generate_32());
+    layer.rtp  = std::shared_ptr<uvgrtp::rtp>(new uvgrtp::rtp(fmt_, layer.ssrc, ipv6_));
+
+    layer.rtp->set_dynamic_payload(rtp_->get_dynamic_payload());
+    layer.rtp->set_clock_rate(rtp_->get_clock_rate());
+
+    // the layer only sends, so its packetizer has no reception handlers
+    switch (fmt_) {
+        case RTP_FORMAT_H264:
+            layer.media.reset(new uvgrtp::formats::h264(socket_, layer.rtp, rce_flags_));
+            break;
+        case RTP_FORMAT_H265:
+            layer.media.reset(new uvgrtp::formats::h265(socket_, layer.rtp, rce_flags_));
+            break;
+        case RTP_FORMAT_H266:
+            layer.media.reset(new uvgrtp::formats::h266(socket_, layer.rtp, rce_flags_));
+            break;
+        default:
+            layer.media.reset(new uvgrtp::formats::media(socket_, layer.rtp, rce_flags_));
+            break;
+    }
+
+    layer.media->set_fps(fps_numerator_, fps_denominator_);
+    layer.media->set_pacer(sfp_->get_pacer());
+    layer.media->set_pacing(pacing_burst_, std::chrono::microseconds(pacing_spin_us_));
+    layer.media->set_send_priority(send_priority_, send_weight_);
+    layer.media->set_metrics(metrics_);
+    layer.media->set_memory_budget(memory_budget_);
+
+    // the packets of the layer carry the header extension elements of the stream
+    for (int element = 0; element < uvgrtp::EXT_COUNT; ++element) {
+        uvgrtp::HEADER_EXTENSION extension = (uvgrtp::HEADER_EXTENSION)element;
+        uint8_t id = media_->header_extension_id(extension);
+
+        if (id && extension == uvgrtp::EXT_TRANSPORT_WIDE_SEQ)
+            (void)layer.media->set_twcc(twcc_, id);
+        else if (id)
+            (void)layer.media->set_header_extension(extension, id);
+    }
+    (void)layer.media->set_header_extension_value(uvgrtp::EXT_MID, mid_);
+    (void)layer.media->set_header_extension_value(uvgrtp::EXT_RID, rid);
+
+    layer.rtp->set_payload_size(rtp_->get_payload_size() + media_->header_extension_size() -
+        layer.media->header_extension_size());
+
+    rtcp_->add_simulcast_source(layer.ssrc, layer.rtp);
+    simulcast_layers_.push_back(std::move(layer));
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::push_simulcast_frames(const std::vector<uvgrtp::simulcast_frame>& frames, int rtp_flags)
+{
+    rtp_error_t ret = check_push_preconditions(rtp_flags, false);
+    if (ret != RTP_OK)
+        return ret;
+
+    if (frames.size() > simulcast_layers_.size() + 1 || (rtp_flags & RTP_COPY))
+        return RTP_INVALID_VALUE;
+
+    uvgrtp::send_request request;
+    request.rtp_flags = rtp_flags;
+
+    for (auto& frame : frames) {
+        request.simulcast.push_back({ frame.data, frame.len });
+        request.len += frame.len;
+    }
+
+    return queue_frame(std::move(request));
+}
+
+rtp_error_t uvgrtp::media_stream::send_simulcast(uvgrtp::send_request& request)
+{
+    // with pacing, every layer gives its frame to the pacer before any of them is waited for
+    bool paced = (rce_flags_ & RCE_PACE_FRAGMENT_SENDING) != 0;
+    rtp_error_t ret = RTP_OK;
+
+    for (size_t i = 0; i < request.simulcast.size(); ++i) {
+        if (!request.simulcast[i].first || !request.simulcast[i].second)
+            continue;
+
+        uvgrtp::formats::media *media = i ? simulcast_layers_[i - 1].media.get() : media_.get();
+
+        media->defer_pacing(paced);
+        rtp_error_t result = media->push_frame(remote_sockaddr_, remote_sockaddr_ip6_, request.simulcast[i].first,
+            request.simulcast[i].second, request.rtp_flags);
+        media->defer_pacing(false);
+
+        if (result != RTP_OK) {
+            metrics_->count(uvgrtp::stream_metrics::SEND_ERRORS);
+            ret = result;
+        }
+    }
+
+    for (size_t i = 0; i < request.simulcast.size(); ++i) {
+        if (!request.simulcast[i].first || !request.simulcast[i].second)
+            continue;
+
+        uvgrtp::formats::media *media = i ? simulcast_layers_[i - 1].media.get() : media_.get();
+
+        if (media->finish_pacing() != RTP_OK) {
+            metrics_->count(uvgrtp::stream_metrics::SEND_ERRORS);
+            ret = RTP_SEND_ERROR;
+            continue;
+        }
+
+        metrics_->count(uvgrtp::stream_metrics::SENT_FRAMES);
+        metrics_->count(uvgrtp::stream_metrics::SENT_BYTES, request.simulcast[i].second);
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::set_media_clock(std::shared_ptr<uvgrtp::media_clock> clock)
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    rtp_->set_media_clock(clock);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::set_header_extension(int rcc_flag, int element, ssize_t value)
+{
+    uvgrtp::HEADER_EXTENSION extension = (uvgrtp::HEADER_EXTENSION)element;
+
+    if (value < 0 || value > UINT8_MAX)
+        return RTP_INVALID_VALUE;
+
+    size_t old_size = media_->header_extension_size();
+
+    rtp_error_t ret = (extension == uvgrtp::EXT_TRANSPORT_WIDE_SEQ) ?
+        media_->set_twcc(value ? twcc_ : nullptr, (uint8_t)value) :
+        media_->set_header_extension(extension, (uint8_t)value);
+
+    if (ret != RTP_OK) {
+        UVG_LOG_ERROR("The header extension ID %zd of RCC flag %d is already in use", value, rcc_flag);
+        return ret;
+    }
+
+    // make room for the header extension in each packet
+    size_t new_size = media_->header_extension_size();
+    rtp_->set_payload_size(rtp_->get_payload_size() + old_size - new_size);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::install_key_frame_request_hook(void *arg, void (*hook)(void *))
+{
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (!hook || !(rce_flags_ & RCE_RTCP)) {
+        return RTP_INVALID_VALUE;
+    }
+
+    rtcp_->install_key_frame_request_hook(arg, hook);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::media_stream::configure_ctx(int rcc_flag, ssize_t value)
+{
+    rtp_error_t ret = RTP_OK;
+
+    if (rcc_flag == RCC_SSRC) {
+        if (value <= 0 || value > (ssize_t)UINT32_MAX)
+            return RTP_INVALID_VALUE;
+
+        *ssrc_ = (uint32_t)value;
+        return ret;
+    }
+    else if (rcc_flag == RCC_REMOTE_SSRC) {
+        if (value <= 0 || value > (ssize_t)UINT32_MAX)
+            return RTP_INVALID_VALUE;
+        if (reception_flow_) {
+            reception_flow_->update_remote_ssrc(remote_ssrc_.get()->load(), (uint32_t)value);
+        }
+        *remote_ssrc_ = (uint32_t)value;
+        
+        return ret;
+    }
+    else if (rcc_flag == RCC_POLL_TIMEOUT) {
+        if (reception_flow_) {
+            reception_flow_->set_poll_timeout_ms((int)value);
+        }
+        return ret;
+    }
+
+    if (!initialized_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    switch (rcc_flag) {
+        case RCC_UDP_SND_BUF_SIZE: {
+            if (value <= 0)
+                return RTP_INVALID_VALUE;
+
+            int buf_size = (int)value;
+            snd_buf_size_ = buf_size;
+            ret = socket_->setsockopt(SOL_SOCKET, SO_SNDBUF, (const char*)&buf_size, sizeof(int));
+            break;
+        }
+        case RCC_UDP_RCV_BUF_SIZE: {
+            if (value <= 0)
+                return RTP_INVALID_VALUE;
+
+            int buf_size = (int)value;
+            rcv_buf_size_ = buf_size;
+            ret = socket_->setsockopt(SOL_SOCKET, SO_RCVBUF, (const char*)&buf_size, sizeof(int));
+            break;
+        }
+        case RCC_RING_BUFFER_SIZE: {
+            if (value <= 0)
+                return RTP_INVALID_VALUE;
+
+            reception_flow_->set_buffer_size(value);
+            break;
+        }
+        case RCC_PKT_MAX_DELAY: {
+            if (value <= 0)
+                return RTP_INVALID_VALUE;
+
+            rtp_->set_pkt_max_delay(value);
+            break;
+        }
+        case RCC_DYN_PAYLOAD_TYPE: {
+            if (value <= 0 || (ssize_t)UINT8_MAX < value)
+                return RTP_INVALID_VALUE;
+
+            rtp_->set_dynamic_payload((uint8_t)value);
+            break;
+        }
+        case RCC_CLOCK_RATE: {
+            if (value <= 0 || (ssize_t)UINT32_MAX < value)
+                return RTP_INVALID_VALUE;
+
+            rtp_->set_clock_rate((uint32_t)value);
+
+            if (jitter_buffer_) {
+                jitter_buffer_->set_clock_rate((uint32_t)value);
+            }
+            break;
+        }
+        case RCC_MTU_SIZE: {
+            ssize_t hdr      = IPV4_HDR_SIZE + UDP_HDR_SIZE + RTP_HDR_SIZE;
+            if (rce_flags_ & RCE_SRTP_AUTHENTICATE_RTP)
+                hdr += uvgrtp::srtp_auth_tag_length(rce_flags_);
+            hdr += (ssize_t)media_->header_extension_size();
+            if (fec_payload_type_)
+                hdr += uvgrtp::FEC_HEADER_SIZE;
+
+            if (value <= hdr)
+                return RTP_INVALID_VALUE;
+
+            if (value > (ssize_t)UINT16_MAX) {
+                UVG_LOG_ERROR("Payload size (%zd) is larger than maximum UDP datagram size (%u)",
+                        value, UINT16_MAX);
+                return RTP_INVALID_VALUE;
+            }
+
+            rtp_->set_payload_size(value - hdr);
+            mtu_size_ = (size_t)value;
+
+            if (path_mtu_)
+                path_mtu_->set_mtu(mtu_size_);
+
+            // auth tag is always included with SRTP and RTCP has a header for each packet within a compound frame
+            rtcp_->set_payload_size(          value - (IPV4_HDR_SIZE + UDP_HDR_SIZE)); 
+
+            reception_flow_->set_payload_size(value - (IPV4_HDR_SIZE + UDP_HDR_SIZE)); // largest packet we can get from socket
+            break;
+        }
+        case RCC_FPS_NUMERATOR: {
+            fps_numerator_ = value;
+
+            if (value > 0 && (rce_flags_ & RCE_SYSTEM_CALL_CLUSTERING)) {
+                UVG_LOG_WARN("Setting FPS numerator will disable System Call Clustering (SCC)");
+            }
+
+            media_->set_fps(fps_numerator_, fps_denominator_);
+            break;
+        }
+        case RCC_FPS_DENOMINATOR: {
+            fps_denominator_ = value;
+
+            if (value > 0 && (rce_flags_ & RCE_SYSTEM_CALL_CLUSTERING)) {
+                UVG_LOG_WARN("Setting FPS denominator will disable System Call Clustering (SCC)");
+            }
+
+            media_->set_fps(fps_numerator_, fps_denominator_);
+            break;
+        }
+        case RCC_PACING_BURST: {
+            if (value <= 0 || value > 64)
+                return RTP_INVALID_VALUE;
+
+            pacing_burst_ = (size_t)value;
+            media_->set_pacing(pacing_burst_, std::chrono::microseconds(pacing_spin_us_));
+            break;
+        }
+        case RCC_PACING_SPIN: {
+            if (value < 0 || value > 1000000)
+                return RTP_INVALID_VALUE;
+
+            pacing_spin_us_ = value;
+            media_->set_pacing(pacing_burst_, std::chrono::microseconds(pacing_spin_us_));
+            break;
+        }
+        case RCC_SEND_PRIORITY: {
+            if (value < 0 || value > 7)
+                return RTP_INVALID_VALUE;
+
+            send_priority_ = (int)value;
+            media_->set_send_priority(send_priority_, send_weight_);
+            break;
+        }
+        case RCC_SEND_WEIGHT: {
+            if (value <= 0 || value > 100)
+                return RTP_INVALID_VALUE;
+
+            send_weight_ = (size_t)value;
+            media_->set_send_priority(send_priority_, send_weight_);
+            break;
+        }
+        case RCC_PATH_MTU_DISCOVERY: {
+            if (value != 0 && (value < (ssize_t)uvgrtp::MIN_IPV4_PATH_MTU || value > (ssize_t)UINT16_MAX))
+                return RTP_INVALID_VALUE;
+
+            if (path_mtu_) {
+                // the payloads go back to the size of RCC_MTU_SIZE
+                media_->set_path_mtu(nullptr);
+                rtp_->set_payload_size(rtp_->get_payload_size() + mtu_size_ - path_mtu_->mtu());
+                path_mtu_ = nullptr;
+            }
+
+            if (value) {
+                auto path_mtu = std::make_shared<uvgrtp::path_mtu>(remote_sockaddr_, remote_sockaddr_ip6_,
+                    ipv6_, (size_t)value, mtu_size_);
+
+                if ((ret = path_mtu->start()) != RTP_OK || (ret = socket_->set_dont_fragment(true)) != RTP_OK) {
+                    UVG_LOG_ERROR("Path MTU discovery is not supported on this system");
+                    return ret;
+                }
+                path_mtu_ = path_mtu;
+                media_->set_path_mtu(path_mtu_);
+            } else {
+                (void)socket_->set_dont_fragment(false);
+            }
+            path_mtu_max_ = (size_t)value;
+            break;
+        }
+        case RCC_AGGREGATION_DEADLINE: {
+            if (value < 0 || value > 1000000)
+                return RTP_INVALID_VALUE;
+
+            if ((ret = media_->set_aggregation_deadline((size_t)value)) != RTP_OK)
+                return ret;
+
+            aggregation_deadline_us_ = (size_t)value;
+            break;
+        }
+        case RCC_VIDEO_WIDTH:
+        case RCC_VIDEO_HEIGHT:
+        case RCC_VIDEO_PGROUP_SIZE:
+        case RCC_VIDEO_PGROUP_PIXELS: {
+            if (value < 0 || value > (ssize_t)UINT16_MAX)
+                return RTP_INVALID_VALUE;
+
+            size_t layout[4] = { video_width_, video_height_, video_pgroup_size_, video_pgroup_pixels_ };
+            layout[rcc_flag - RCC_VIDEO_WIDTH] = (size_t)value;
+
+            if ((ret = media_->set_video_layout(layout[0], layout[1], layout[2], layout[3])) != RTP_OK)
+                return ret;
+
+            video_width_         = layout[0];
+            video_height_        = layout[1];
+            video_pgroup_size_   = layout[2];
+            video_pgroup_pixels_ = layout[3];
+            break;
+        }
+        case RCC_SESSION_BANDWIDTH: {
+            bandwidth_ = (uint32_t)value;
+            // TODO: Is there a max value for bandwidth?
+            if (value <= 0) {
+                UVG_LOG_WARN("Bandwidth cannot be negative");
+                return RTP_INVALID_VALUE;
+            }
+            if (rtcp_) {
+                rtcp_->set_session_bandwidth(bandwidth_);
+            }
+            break;
+        }
+        case RCC_SRTP_DECRYPT_THREADS: {
+            if (!(rce_flags_ & RCE_SRTP) || !srtp_) {
+                UVG_LOG_ERROR("RCC_SRTP_DECRYPT_THREADS requires RCE_SRTP");
+                return RTP_INVALID_VALUE;
+            }
+
+            if (value < 0 || (ret = srtp_->set_decrypt_threads((size_t)value)) != RTP_OK)
+                return RTP_INVALID_VALUE;
 
-uint8_t* uvgrtp::media_stream::copy_frame(uint8_t* original, size_t data_len)
-{
-    uint8_t* copy = new uint8_t[data_len];
-    memcpy(copy, original, data_len);
-    return copy;
-}
+            if (value == 0) {
+                reception_flow_->install_srtp_batch_handler(remote_ssrc_, nullptr);
+            } else {
+                reception_flow_->install_srtp_batch_handler(remote_ssrc_,
+                    std::bind(&uvgrtp::srtp::recv_batch_handler, srtp_, std::placeholders::_1, std::placeholders::_2));
+            }
+            break;
+        }
+        case RCC_TWCC_EXT_ID: {
+            if (value < 0 || value > UINT8_MAX)
+                return RTP_INVALID_VALUE;
 
-rtp_error_t uvgrtp::media_stream::install_receive_hook(void *arg, void (*hook)(void *, uvgrtp::frame::rtp_frame *))
-{
-    if (!initialized_) {
-        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
-        return RTP_NOT_INITIALIZED;
-    }
+            if (value != 0 && !(rce_flags_ & RCE_RTCP)) {
+                UVG_LOG_ERROR("RCC_TWCC_EXT_ID requires RCE_RTCP");
+                return RTP_INVALID_VALUE;
+            }
 
-    if (!hook) {
-        return RTP_INVALID_VALUE;
-    }
-    return reception_flow_->install_receive_hook(arg, hook, remote_ssrc_.get()->load());
-}
+            if (!twcc_) {
+                twcc_ = std::make_shared<uvgrtp::twcc_sender>();
+                twcc_->set_bitrates(twcc_start_kbps_ * 1000, twcc_max_kbps_ * 1000);
+            }
 
-rtp_error_t uvgrtp::media_stream::configure_ctx(int rcc_flag, ssize_t value)
-{
-    rtp_error_t ret = RTP_OK;
+            if ((ret = set_header_extension(rcc_flag, uvgrtp::EXT_TRANSPORT_WIDE_SEQ, value)) != RTP_OK)
+                return ret;
 
-    if (rcc_flag == RCC_SSRC) {
-        if (value <= 0 || value > (ssize_t)UINT32_MAX)
-            return RTP_INVALID_VALUE;
+            twcc_ext_id_ = (uint8_t)value;
+            rtcp_->set_twcc(twcc_ext_id_, twcc_);
+            break;
+        }
+        case RCC_ABS_SEND_TIME_EXT_ID:
+            return set_header_extension(rcc_flag, uvgrtp::EXT_ABS_SEND_TIME, value);
+        case RCC_AUDIO_LEVEL_EXT_ID:
+            return set_header_extension(rcc_flag, uvgrtp::EXT_AUDIO_LEVEL, value);
+        case RCC_FRAME_MARKING_EXT_ID:
+            return set_header_extension(rcc_flag, uvgrtp::EXT_FRAME_MARKING, value);
+        case RCC_MID_EXT_ID:
+        case RCC_RID_EXT_ID: {
+            uvgrtp::HEADER_EXTENSION extension = (rcc_flag == RCC_MID_EXT_ID) ? uvgrtp::EXT_MID : uvgrtp::EXT_RID;
+
+            if ((ret = set_header_extension(rcc_flag, extension, value)) != RTP_OK)
+                return ret;
 
-        *ssrc_ = (uint32_t)value;
-        return ret;
-    }
-    else if (rcc_flag == RCC_REMOTE_SSRC) {
-        if (value <= 0 || value > (ssize_t)UINT32_MAX)
-            return RTP_INVALID_VALUE;
-        if (reception_flow_) {
-            reception_flow_->update_remote_ssrc(remote_ssrc_.get()->load(), (uint32_t)value);
+            return update_mid_route();
         }
-        *remote_ssrc_ = (uint32_t)value;
-        
-        return ret;
-    }
-    else if (rcc_flag == RCC_POLL_TIMEOUT) {
-        if (reception_flow_) {
-            reception_flow_->set_poll_timeout_ms((int)value);
+        case RCC_MAX_TEMPORAL_ID:
+        case RCC_MAX_LAYER_ID: {
+            if (value < 0 || value > ((rcc_flag == RCC_MAX_TEMPORAL_ID) ? uvgrtp::MAX_TEMPORAL_ID : uvgrtp::MAX_LAYER_ID))
+                return RTP_INVALID_VALUE;
+
+            if (fmt_ != RTP_FORMAT_H264 && fmt_ != RTP_FORMAT_H265 && fmt_ != RTP_FORMAT_H266) {
+                UVG_LOG_ERROR("The layer limits are only supported by the H26x formats");
+                return RTP_NOT_SUPPORTED;
+            }
+
+            if (rcc_flag == RCC_MAX_TEMPORAL_ID) {
+                max_temporal_id_ = (uint8_t)value;
+            } else {
+                max_layer_id_ = (uint8_t)value;
+            }
+
+            static_cast<uvgrtp::formats::h26x *>(media_.get())->set_layer_limits(max_temporal_id_, max_layer_id_);
+            break;
         }
-        return ret;
-    }
+        case RCC_H26X_PARAMETER_SETS: {
+            if (value != 0 && value != 1)
+                return RTP_INVALID_VALUE;
 
-    if (!initialized_) {
-        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
-        return RTP_NOT_INITIALIZED;
-    }
+            if (fmt_ != RTP_FORMAT_H264 && fmt_ != RTP_FORMAT_H265 && fmt_ != RTP_FORMAT_H266) {
+                UVG_LOG_ERROR("The parameter sets are only supported by the H26x formats");
+                return RTP_NOT_SUPPORTED;
+            }
 
-    switch (rcc_flag) {
-        case RCC_UDP_SND_BUF_SIZE: {
-            if (value <= 0)
+            h26x_parameter_sets_ = (value == 1);
+            static_cast<uvgrtp::formats::h26x *>(media_.get())->set_parameter_set_prepending(h26x_parameter_sets_);
+            break;
+        }
+        case RCC_MEMORY_BUDGET: {
+            if (value < 0)
                 return RTP_INVALID_VALUE;
 
-            int buf_size = (int)value;
-            snd_buf_size_ = buf_size;
-            ret = socket_->setsockopt(SOL_SOCKET, SO_SNDBUF, (const char*)&buf_size, sizeof(int));
+            memory_budget_->set_limit((size_t)value);
             break;
         }
-        case RCC_UDP_RCV_BUF_SIZE: {
-            if (value <= 0)
+        case RCC_H26X_MAX_FRAME_SIZE: {
+            if (value < 0)
                 return RTP_INVALID_VALUE;
 
-            int buf_size = (int)value;
-            rcv_buf_size_ = buf_size;
-            ret = socket_->setsockopt(SOL_SOCKET, SO_RCVBUF, (const char*)&buf_size, sizeof(int));
+            if (fmt_ != RTP_FORMAT_H264 && fmt_ != RTP_FORMAT_H265 && fmt_ != RTP_FORMAT_H266) {
+                UVG_LOG_ERROR("The reassembly state is only reserved by the H26x formats");
+                return RTP_NOT_SUPPORTED;
+            }
+
+            h26x_max_frame_size_ = (size_t)value;
+            static_cast<uvgrtp::formats::h26x *>(media_.get())->reserve_receive_state(h26x_max_frame_size_,
+                (double)fps_numerator_ / fps_denominator_, (size_t)bandwidth_ * 1000 / 8);
             break;
         }
-        case RCC_RING_BUFFER_SIZE: {
-            if (value <= 0)
+        case RCC_RECEIVE_PRIORITY: {
+            if (value < 0 || value > 1)
                 return RTP_INVALID_VALUE;
 
-            reception_flow_->set_buffer_size(value);
+            receive_priority_ = (int)value;
+            ret = reception_flow_->set_priority(remote_ssrc_, receive_priority_);
             break;
         }
-        case RCC_PKT_MAX_DELAY: {
-            if (value <= 0)
+        case RCC_TWCC_START_BITRATE:
+        case RCC_TWCC_MAX_BITRATE: {
+            if (value < 0 || value > (ssize_t)(UINT32_MAX / 1000) || (rcc_flag == RCC_TWCC_START_BITRATE && value == 0))
                 return RTP_INVALID_VALUE;
 
-            rtp_->set_pkt_max_delay(value);
+            if (rcc_flag == RCC_TWCC_START_BITRATE) {
+                twcc_start_kbps_ = (uint32_t)value;
+            } else {
+                twcc_max_kbps_ = (uint32_t)value;
+            }
+
+            if (twcc_) {
+                twcc_->set_bitrates(twcc_start_kbps_ * 1000, twcc_max_kbps_ * 1000);
+            }
             break;
         }
-        case RCC_DYN_PAYLOAD_TYPE: {
-            if (value <= 0 || (ssize_t)UINT8_MAX < value)
+        case RCC_NACK: {
+            if (value != 0 && value != 1)
                 return RTP_INVALID_VALUE;
 
-            rtp_->set_dynamic_payload((uint8_t)value);
+            if (value == 1 && !(rce_flags_ & RCE_RTCP)) {
+                UVG_LOG_ERROR("RCC_NACK requires RCE_RTCP");
+                return RTP_INVALID_VALUE;
+            }
+            nack_ = (value == 1);
+
+            if (nack_ && !packet_history_) {
+                packet_history_ = std::make_shared<uvgrtp::packet_history>(socket_, nack_history_size_);
+            }
+
+            std::shared_ptr<uvgrtp::rtcp> rtcp = rtcp_;
+            media_->set_packet_history(nack_ ? packet_history_ : nullptr);
+            media_->set_nack_sender(nack_ ? [rtcp](uint32_t ssrc, const std::vector<uint16_t>& seqs) {
+                (void)rtcp->send_nack(ssrc, seqs);
+            } : std::function<void(uint32_t, const std::vector<uint16_t>&)>());
+            rtcp_->set_packet_history(nack_ ? packet_history_ : nullptr);
             break;
         }
-        case RCC_CLOCK_RATE: {
-            if (value <= 0 || (ssize_t)UINT32_MAX < value)
+        case RCC_GOP_CACHE_SIZE: {
+            if (value < 0)
                 return RTP_INVALID_VALUE;
 
-            rtp_->set_clock_rate((uint32_t)value);
+            if (fmt_ != RTP_FORMAT_H264 && fmt_ != RTP_FORMAT_H265 && fmt_ != RTP_FORMAT_H266) {
+                UVG_LOG_ERROR("RCC_GOP_CACHE_SIZE is only supported by the H26x formats");
+                return RTP_NOT_SUPPORTED;
+            }
+
+            gop_cache_size_ = (size_t)value;
+            media_->set_gop_cache(gop_cache_size_);
             break;
         }
-        case RCC_MTU_SIZE: {
-            ssize_t hdr      = IPV4_HDR_SIZE + UDP_HDR_SIZE + RTP_HDR_SIZE;
-            if (rce_flags_ & RCE_SRTP_AUTHENTICATE_RTP)
-                hdr += UVG_AUTH_TAG_LENGTH;
+        case RCC_PROFILE_SAMPLING: {
+            if (value < 0)
+                return RTP_INVALID_VALUE;
 
-            if (value <= hdr)
+            metrics_->set_profile_interval((uint32_t)value);
+
+            // the reception flow only reads the clock while one of its streams is profiled
+            reception_flow_->install_metrics(remote_ssrc_, metrics_);
+            break;
+        }
+        case RCC_REORDER_WINDOW_MS: {
+            if (value < 0 || value > (ssize_t)UINT16_MAX)
                 return RTP_INVALID_VALUE;
 
-            if (value > (ssize_t)UINT16_MAX) {
-                UVG_LOG_ERROR("Payload size (%zd) is larger than maximum UDP datagram size (%u)",
-                        value, UINT16_MAX);
+            reorder_window_ms_ = (size_t)value;
+            reception_flow_->install_reorder_buffer(remote_ssrc_, reorder_window_ms_ ?
+                std::make_shared<uvgrtp::reorder_buffer>(std::chrono::milliseconds(reorder_window_ms_)) : nullptr);
+            break;
+        }
+        case RCC_REDUNDANCY_WINDOW: {
+            if (value != 0 && (value < 64 || value > (ssize_t)uvgrtp::MAX_REDUNDANCY_WINDOW))
+                return RTP_INVALID_VALUE;
+
+            redundancy_window_ = (size_t)value;
+            reception_flow_->install_merge(remote_ssrc_, redundancy_window_ ?
+                std::make_shared<uvgrtp::redundancy_merge>(redundancy_window_) : nullptr);
+            break;
+        }
+        case RCC_NACK_HISTORY_SIZE: {
+            if (value <= 0 || value > UINT16_MAX + 1)
                 return RTP_INVALID_VALUE;
+
+            nack_history_size_ = (size_t)value;
+
+            if (packet_history_) {
+                packet_history_->set_size(nack_history_size_);
             }
+            break;
+        }
+        case RCC_FEC_PAYLOAD_TYPE: {
+            if (value < 0 || value > 127 || (value != 0 && value == rtp_->get_dynamic_payload()))
+                return RTP_INVALID_VALUE;
 
-            rtp_->set_payload_size(value - hdr);
+            if (fmt_ != RTP_FORMAT_H264 && fmt_ != RTP_FORMAT_H265 && fmt_ != RTP_FORMAT_H266) {
+                UVG_LOG_ERROR("RCC_FEC_PAYLOAD_TYPE is only supported by the H26x formats");
+                return RTP_NOT_SUPPORTED;
+            }
 
-            // auth tag is always included with SRTP and RTCP has a header for each packet within a compound frame
-            rtcp_->set_payload_size(          value - (IPV4_HDR_SIZE + UDP_HDR_SIZE)); 
+            // a repair packet carries the FEC header in front of the largest protected payload
+            if (value != 0 && fec_payload_type_ == 0) {
+                rtp_->set_payload_size(rtp_->get_payload_size() - uvgrtp::FEC_HEADER_SIZE);
+            } else if (value == 0 && fec_payload_type_ != 0) {
+                rtp_->set_payload_size(rtp_->get_payload_size() + uvgrtp::FEC_HEADER_SIZE);
+            }
+            fec_payload_type_ = (uint8_t)value;
 
-            reception_flow_->set_payload_size(value - (IPV4_HDR_SIZE + UDP_HDR_SIZE)); // largest packet we can get from socket
+            media_->set_fec(fec_payload_type_, fec_overhead_);
             break;
         }
-        case RCC_FPS_NUMERATOR: {
-            fps_numerator_ = value;
+        case RCC_FEC_OVERHEAD: {
+            if (value < 1 || value > 100)
+                return RTP_INVALID_VALUE;
 
-            if (value > 0 && (rce_flags_ & RCE_SYSTEM_CALL_CLUSTERING)) {
-                UVG_LOG_WARN("Setting FPS numerator will disable System Call Clustering (SCC)");
+            fec_overhead_ = (int)value;
+            media_->set_fec(fec_payload_type_, fec_overhead_);
+            break;
+        }
+        case RCC_KEY_FRAME_REQUEST:
+        case RCC_KEY_FRAME_REQUEST_INTERVAL: {
+            if (rcc_flag == RCC_KEY_FRAME_REQUEST) {
+                if (value < 0 || value > 2)
+                    return RTP_INVALID_VALUE;
+
+                if (value != 0 && !(rce_flags_ & RCE_RTCP)) {
+                    UVG_LOG_ERROR("RCC_KEY_FRAME_REQUEST requires RCE_RTCP");
+                    return RTP_INVALID_VALUE;
+                }
+                key_frame_request_ = (int)value;
+            } else {
+                if (value < 0 || value > (ssize_t)UINT32_MAX)
+                    return RTP_INVALID_VALUE;
+
+                key_frame_interval_ms_ = (size_t)value;
             }
 
-            media_->set_fps(fps_numerator_, fps_denominator_);
+            std::shared_ptr<uvgrtp::rtcp> rtcp = rtcp_;
+            bool fir = (key_frame_request_ == 2);
+
+            media_->set_key_frame_requester(key_frame_request_ ? [rtcp, fir](uint32_t ssrc) {
+                (void)rtcp->send_key_frame_request(ssrc, fir);
+            } : std::function<void(uint32_t)>(), key_frame_interval_ms_);
             break;
         }
-        case RCC_FPS_DENOMINATOR: {
-            fps_denominator_ = value;
+        case RCC_JITTER_BUFFER:
+        case RCC_JITTER_BUFFER_MIN_DELAY: {
+            if (value < 0 || value > (ssize_t)UINT16_MAX)
+                return RTP_INVALID_VALUE;
 
-            if (value > 0 && (rce_flags_ & RCE_SYSTEM_CALL_CLUSTERING)) {
-                UVG_LOG_WARN("Setting FPS denominator will disable System Call Clustering (SCC)");
+            if (rcc_flag == RCC_JITTER_BUFFER) {
+                jitter_buffer_max_delay_ms_ = (size_t)value;
+            } else {
+                jitter_buffer_min_delay_ms_ = (size_t)value;
             }
 
-            media_->set_fps(fps_numerator_, fps_denominator_);
+            if (!jitter_buffer_ && jitter_buffer_max_delay_ms_ == 0)
+                break;
+
+            if (!jitter_buffer_) {
+                std::shared_ptr<uvgrtp::reception_flow> flow = reception_flow_;
+                std::shared_ptr<uvgrtp::rtcp> rtcp = (rce_flags_ & RCE_RTCP) ? rtcp_ : nullptr;
+
+                jitter_buffer_.reset(new uvgrtp::jitter_buffer([flow](uvgrtp::frame::rtp_frame *frame) {
+                    flow->return_frame(frame);
+                }, rtcp ? [rtcp](uint32_t ssrc) {
+                    return rtcp->get_jitter_ms(ssrc);
+                } : std::function<double(uint32_t)>(), rtp_->get_clock_rate(), sfp_->get_thread_settings()));
+            }
+
+            /* The buffer is kept when it is disabled, since the reception thread may be giving it
+             * a frame. Without delay it releases the frames it has right away */
+            if (jitter_buffer_max_delay_ms_) {
+                jitter_buffer_->set_delay(std::min(jitter_buffer_min_delay_ms_, jitter_buffer_max_delay_ms_),
+                    jitter_buffer_max_delay_ms_);
+
+                uvgrtp::jitter_buffer *buffer = jitter_buffer_.get();
+                reception_flow_->install_playout_handler(remote_ssrc_, [buffer](uvgrtp::frame::rtp_frame *frame) {
+                    buffer->frame_received(frame);
+                });
+            } else {
+                reception_flow_->install_playout_handler(remote_ssrc_, nullptr);
+                jitter_buffer_->set_delay(0, 0);
+            }
             break;
         }
-        case RCC_SESSION_BANDWIDTH: {
-            bandwidth_ = (uint32_t)value;
-            // TODO: Is there a max value for bandwidth?
-            if (value <= 0) {
-                UVG_LOG_WARN("Bandwidth cannot be negative");
+        case RCC_DELIVERY_QUEUE_FRAMES:
+        case RCC_DELIVERY_QUEUE_BYTES: {
+            if (value < 0)
                 return RTP_INVALID_VALUE;
+
+            uvgrtp::delivery_queue& queue = reception_flow_->get_delivery_queue();
+
+            if (rcc_flag == RCC_DELIVERY_QUEUE_FRAMES) {
+                queue.set_limits((size_t)value, queue.get_max_bytes());
+            } else {
+                queue.set_limits(queue.get_max_frames(), (size_t)value);
             }
-            if (rtcp_) {
-                rtcp_->set_session_bandwidth(bandwidth_);
+            break;
+        }
+        case RCC_DELIVERY_QUEUE_POLICY: {
+            if (value < RTP_DROP_OLDEST || value >= RTP_DROP_LAST)
+                return RTP_INVALID_VALUE;
+
+            reception_flow_->get_delivery_queue().set_policy((int)value);
+            break;
+        }
+        case RCC_RECV_BATCH_SIZE: {
+            if (value <= 0 || value > (ssize_t)INT32_MAX)
+                return RTP_INVALID_VALUE;
+
+            ret = reception_flow_->set_recv_batch_size((int)value);
+            break;
+        }
+        case RCC_INLINE_RECEPTION: {
+            if (value != 0 && value != 1)
+                return RTP_INVALID_VALUE;
+
+            reception_flow_->set_inline_processing(value == 1);
+            break;
+        }
+        case RCC_SEND_QUEUE_SIZE: {
+            if (value <= 0)
+                return RTP_INVALID_VALUE;
+
+            if (!send_queue_) {
+                UVG_LOG_ERROR("Send queue size requires RCE_ASYNC_SEND");
+                return RTP_NOT_SUPPORTED;
+            }
+
+            send_queue_->set_capacity((size_t)value);
+            break;
+        }
+        case RCC_TIMESTAMPING: {
+            if (value < 0 || value > RTP_TIMESTAMP_ALL)
+                return RTP_INVALID_VALUE;
+
+            if ((ret = socket_->enable_timestamping((int)value)) != RTP_OK) {
+                UVG_LOG_ERROR("Kernel timestamps are not supported by the system");
+                break;
+            }
+            socket_->set_metrics(metrics_);
+            break;
+        }
+        case RCC_RING_BUFFER_MAX_SIZE: {
+            if (value < 0)
+                return RTP_INVALID_VALUE;
+
+            reception_flow_->set_max_buffer_size(value);
+            break;
+        }
+        case RCC_RING_BUFFER_WATERMARK: {
+            if (value <= 0 || value > 100)
+                return RTP_INVALID_VALUE;
+
+            reception_flow_->set_ring_watermark((int)value);
+            break;
+        }
+        case RCC_RTCP_FEEDBACK: {
+            if (value < 0 || value >= RTP_RTCP_FEEDBACK_LAST)
+                return RTP_INVALID_VALUE;
+
+            if (!(rce_flags_ & RCE_RTCP) || !rtcp_) {
+                UVG_LOG_ERROR("RCC_RTCP_FEEDBACK requires RCE_RTCP");
+                return RTP_INVALID_VALUE;
+            }
+
+            rtcp_->set_feedback_mode((int)value);
+            break;
+        }
+        case RCC_RTCP_XR: {
+            if (value < 0 || value > RTP_RTCP_XR_ALL)
+                return RTP_INVALID_VALUE;
+
+            if (!(rce_flags_ & RCE_RTCP) || !rtcp_) {
+                UVG_LOG_ERROR("RCC_RTCP_XR requires RCE_RTCP");
+                return RTP_INVALID_VALUE;
             }
+
+            rtcp_->set_xr_blocks((int)value);
             break;
         }
         case RCC_SSRC: {
@@ -971,6 +2846,156 @@ int uvgrtp::media_stream::get_configuration_value(int rcc_flag)
         case RCC_POLL_TIMEOUT: {
             return reception_flow_->get_poll_timeout_ms();
         }
+        case RCC_RECV_BATCH_SIZE: {
+            return reception_flow_->get_recv_batch_size();
+        }
+        case RCC_SRTP_DECRYPT_THREADS: {
+            if (!srtp_)
+                return 0;
+
+            return (int)srtp_->get_decrypt_threads();
+        }
+        case RCC_INLINE_RECEPTION: {
+            return reception_flow_->get_inline_processing() ? 1 : 0;
+        }
+        case RCC_PACING_BURST: {
+            return (int)pacing_burst_;
+        }
+        case RCC_PACING_SPIN: {
+            return (int)pacing_spin_us_;
+        }
+        case RCC_SEND_PRIORITY: {
+            return send_priority_;
+        }
+        case RCC_SEND_WEIGHT: {
+            return (int)send_weight_;
+        }
+        case RCC_AGGREGATION_DEADLINE: {
+            return (int)aggregation_deadline_us_;
+        }
+        case RCC_PATH_MTU_DISCOVERY: {
+            return (int)path_mtu_max_;
+        }
+        case RCC_TWCC_EXT_ID: {
+            return (int)twcc_ext_id_;
+        }
+        case RCC_TWCC_START_BITRATE: {
+            return (int)twcc_start_kbps_;
+        }
+        case RCC_TWCC_MAX_BITRATE: {
+            return (int)twcc_max_kbps_;
+        }
+        case RCC_NACK: {
+            return nack_ ? 1 : 0;
+        }
+        case RCC_GOP_CACHE_SIZE: {
+            return (int)gop_cache_size_;
+        }
+        case RCC_PROFILE_SAMPLING: {
+            return (int)metrics_->profile_interval();
+        }
+        case RCC_REORDER_WINDOW_MS: {
+            return (int)reorder_window_ms_;
+        }
+        case RCC_REDUNDANCY_WINDOW: {
+            return (int)redundancy_window_;
+        }
+        case RCC_NACK_HISTORY_SIZE: {
+            return (int)nack_history_size_;
+        }
+        case RCC_FEC_PAYLOAD_TYPE: {
+            return (int)fec_payload_type_;
+        }
+        case RCC_FEC_OVERHEAD: {
+            return fec_overhead_;
+        }
+        case RCC_KEY_FRAME_REQUEST: {
+            return key_frame_request_;
+        }
+        case RCC_KEY_FRAME_REQUEST_INTERVAL: {
+            return (int)key_frame_interval_ms_;
+        }
+        case RCC_JITTER_BUFFER: {
+            return (int)jitter_buffer_max_delay_ms_;
+        }
+        case RCC_JITTER_BUFFER_MIN_DELAY: {
+            return (int)jitter_buffer_min_delay_ms_;
+        }
+        case RCC_DELIVERY_QUEUE_FRAMES: {
+            return (int)reception_flow_->get_delivery_queue().get_max_frames();
+        }
+        case RCC_DELIVERY_QUEUE_BYTES: {
+            return (int)reception_flow_->get_delivery_queue().get_max_bytes();
+        }
+        case RCC_DELIVERY_QUEUE_POLICY: {
+            return reception_flow_->get_delivery_queue().get_policy();
+        }
+        case RCC_VIDEO_WIDTH: {
+            return (int)video_width_;
+        }
+        case RCC_VIDEO_HEIGHT: {
+            return (int)video_height_;
+        }
+        case RCC_VIDEO_PGROUP_SIZE: {
+            return (int)video_pgroup_size_;
+        }
+        case RCC_VIDEO_PGROUP_PIXELS: {
+            return (int)video_pgroup_pixels_;
+        }
+        case RCC_SEND_QUEUE_SIZE: {
+            if (!send_queue_)
+                return -1;
+
+            return (int)send_queue_->get_capacity();
+        }
+        case RCC_TIMESTAMPING: {
+            return socket_->timestamping();
+        }
+        case RCC_RING_BUFFER_MAX_SIZE: {
+            return (int)reception_flow_->get_max_buffer_size();
+        }
+        case RCC_RING_BUFFER_WATERMARK: {
+            return reception_flow_->get_ring_watermark();
+        }
+        case RCC_RTCP_FEEDBACK: {
+            return rtcp_ ? rtcp_->get_feedback_mode() : (int)RTP_RTCP_FEEDBACK_IMMEDIATE;
+        }
+        case RCC_RTCP_XR: {
+            return rtcp_ ? rtcp_->get_xr_blocks() : 0;
+        }
+        case RCC_ABS_SEND_TIME_EXT_ID: {
+            return (int)media_->header_extension_id(uvgrtp::EXT_ABS_SEND_TIME);
+        }
+        case RCC_AUDIO_LEVEL_EXT_ID: {
+            return (int)media_->header_extension_id(uvgrtp::EXT_AUDIO_LEVEL);
+        }
+        case RCC_FRAME_MARKING_EXT_ID: {
+            return (int)media_->header_extension_id(uvgrtp::EXT_FRAME_MARKING);
+        }
+        case RCC_MID_EXT_ID: {
+            return (int)media_->header_extension_id(uvgrtp::EXT_MID);
+        }
+        case RCC_RID_EXT_ID: {
+            return (int)media_->header_extension_id(uvgrtp::EXT_RID);
+        }
+        case RCC_MAX_TEMPORAL_ID: {
+            return (int)max_temporal_id_;
+        }
+        case RCC_MAX_LAYER_ID: {
+            return (int)max_layer_id_;
+        }
+        case RCC_H26X_PARAMETER_SETS: {
+            return (int)h26x_parameter_sets_;
+        }
+        case RCC_MEMORY_BUDGET: {
+            return (int)memory_budget_->get_limit();
+        }
+        case RCC_H26X_MAX_FRAME_SIZE: {
+            return (int)h26x_max_frame_size_;
+        }
+        case RCC_RECEIVE_PRIORITY: {
+            return receive_priority_;
+        }
         default:
             ret = -1;
     }
@@ -1109,6 +3134,9 @@ uint32_t uvgrtp::media_stream::get_default_bandwidth_kbps(rtp_format_t fmt)
         case RTP_FORMAT_H266:
             bandwidth = 2000;
             break;
+        case RTP_FORMAT_RAW_VIDEO:
+            bandwidth = 1000000;
+            break;
         case RTP_FORMAT_OPUS:
             bandwidth = 24;
             break;
@@ -0,0 +1,34 @@
+#include "memory_budget.hh"
+
+uvgrtp::memory_budget::memory_budget(std::shared_ptr<memory_budget> parent):
+    parent_(parent),
+    limit_(0),
+    used_(0)
+{
+}
+
+bool uvgrtp::memory_budget::charge(size_t bytes)
+{
+    const size_t limit = limit_.load(std::memory_order_relaxed);
+    const size_t used  = used_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+    if (limit != 0 && used > limit) {
+        used_.fetch_sub(bytes, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (parent_ && !parent_->charge(bytes)) {
+        used_.fetch_sub(bytes, std::memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+void uvgrtp::memory_budget::release(size_t bytes)
+{
+    used_.fetch_sub(bytes, std::memory_order_relaxed);
+
+    if (parent_)
+        parent_->release(bytes);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace uvgrtp {
+
+    /* The bytes of received media a stream or a context holds, see RCC_MEMORY_BUDGET and
+     * uvgrtp::context::set_memory_budget()
+     *
+     * The budget of a stream has the budget of its context as the parent, so every charge to the
+     * stream is also a charge to the context. A charge that would take either over its limit fails
+     * and nothing is charged, and it is up to the caller to free something and try again. The
+     * counters are atomics, so the streams of a context charge the context from their own threads */
+    class memory_budget {
+        public:
+            memory_budget(std::shared_ptr<memory_budget> parent = nullptr);
+
+            /* Set the limit in bytes, zero for no limit. Lowering the limit does not free anything,
+             * the next charges fail until enough has been released */
+            void set_limit(size_t bytes)
+            {
+                limit_.store(bytes, std::memory_order_relaxed);
+            }
+
+            size_t get_limit() const
+            {
+                return limit_.load(std::memory_order_relaxed);
+            }
+
+            /* Return the bytes charged and not yet released */
+            size_t used() const
+            {
+                return used_.load(std::memory_order_relaxed);
+            }
+
+            /* Charge "bytes" to this budget and its parent
+             *
+             * Return false if either would go over its limit, nothing is charged then */
+            bool charge(size_t bytes);
+
+            /* Release "bytes" charged earlier */
+            void release(size_t bytes);
+
+        private:
+            std::shared_ptr<memory_budget> parent_;
+            std::atomic<size_t> limit_;
+            std::atomic<size_t> used_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,608 @@
+#include "memory_transport.hh"
+
+#include "impaired_link.hh"
+#include "debug.hh"
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+/* The header at the start of a shared segment, the queue follows it */
+struct uvgrtp::memory_transport::shared_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t queue_size;
+    uint64_t datagram_size;
+
+    // set by the owner once the queue is ready and when it closes the segment
+    std::atomic<uint32_t> ready;
+    std::atomic<uint32_t> closed;
+
+    alignas(64) std::atomic<bool> signaled;
+};
+
+static const uint32_t SHARED_MAGIC   = 0x75767331; // "uvs1"
+static const uint32_t SHARED_VERSION = 1;
+
+/* An attached transport and the address it was attached with */
+struct memory_registration {
+    bool ipv6;
+    sockaddr_in address;
+    sockaddr_in6 address6;
+    const uvgrtp::memory_transport *owner;
+    std::weak_ptr<uvgrtp::memory_transport> transport;
+};
+
+/* A transport of another process that was looked up, nullptr if there was none when it was "checked".
+ * The next lookup of a missing transport is done "interval" after the last one */
+struct shared_peer {
+    std::shared_ptr<uvgrtp::memory_transport> transport;
+    std::chrono::steady_clock::time_point checked;
+    std::chrono::milliseconds interval;
+};
+
+/* The attached transports of the process indexed by their port in host byte order, and the
+ * shared transports of the other processes indexed by their address */
+struct memory_registry {
+    std::mutex mutex;
+    std::unordered_multimap<uint16_t, memory_registration> transports;
+    std::map<std::array<uint8_t, 19>, shared_peer> peers;
+};
+
+static memory_registry& get_registry()
+{
+    // never destroyed, so that the sockets closed at exit can still detach
+    static memory_registry *registry = new memory_registry();
+    return *registry;
+}
+
+static bool matches(const memory_registration& r, const sockaddr_in& address)
+{
+    return !r.ipv6 && (r.address.sin_addr.s_addr == htonl(INADDR_ANY) ||
+        r.address.sin_addr.s_addr == address.sin_addr.s_addr);
+}
+
+static bool matches(const memory_registration& r, const sockaddr_in6& address)
+{
+    return r.ipv6 && (memcmp(&r.address6.sin6_addr, &in6addr_any, sizeof(in6_addr)) == 0 ||
+        memcmp(&r.address6.sin6_addr, &address.sin6_addr, sizeof(in6_addr)) == 0);
+}
+
+template <typename Address>
+static std::shared_ptr<uvgrtp::memory_transport> find_registered(const Address& address, uint16_t port)
+{
+    memory_registry& registry = get_registry();
+    std::lock_guard<std::mutex> lg(registry.mutex);
+
+    auto range = registry.transports.equal_range(port);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (matches(it->second, address))
+            return it->second.transport.lock();
+    }
+    return nullptr;
+}
+
+uvgrtp::memory_transport::memory_transport() :
+    queue_(nullptr),
+    wake_fd_(-1),
+    local_signaled_(false),
+    signaled_(&local_signaled_),
+    share_(false),
+    owner_(false),
+    segment_(nullptr),
+    segment_size_(0),
+    segment_id_(0),
+    name_(),
+    signal_fd_(-1),
+    wake_address_(),
+    wake_address_len_(0)
+{
+    static_assert((MEMORY_QUEUE_SIZE & (MEMORY_QUEUE_SIZE - 1)) == 0, "the queue size must be a power of two");
+}
+
+uvgrtp::memory_transport::~memory_transport()
+{
+    // a mapped segment of another process is never attached, and it is dropped under the lock of the registry
+    if (!segment_ || owner_)
+        detach();
+
+    // the thread of the link may still queue datagrams and wake the reader
+    link_.reset();
+    queue_.reset();
+
+#ifdef __linux__
+    if (segment_) {
+        if (owner_) {
+            segment_->closed.store(1, std::memory_order_release);
+
+            // a later socket of the same address may have replaced the segment already
+            int fd = shm_open(name_.c_str(), O_RDONLY | O_CLOEXEC, 0);
+            struct stat st = {};
+            if (fd >= 0 && fstat(fd, &st) == 0 && (uint64_t)st.st_ino == segment_id_)
+                shm_unlink(name_.c_str());
+            if (fd >= 0)
+                close(fd);
+        }
+        munmap(segment_, segment_size_);
+    }
+
+    if (signal_fd_ >= 0 && signal_fd_ != wake_fd_)
+        close(signal_fd_);
+
+    if (wake_fd_ >= 0)
+        close(wake_fd_);
+#endif
+}
+
+rtp_error_t uvgrtp::memory_transport::init()
+{
+#ifdef __linux__
+    if ((wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        UVG_LOG_ERROR("Failed to create an eventfd: %s", strerror(errno));
+        return RTP_GENERIC_ERROR;
+    }
+
+    queue_.reset(new mpsc_queue<datagram>(MEMORY_QUEUE_SIZE));
+    return RTP_OK;
+#else
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+void uvgrtp::memory_transport::share()
+{
+    share_ = true;
+}
+
+void uvgrtp::memory_transport::impair(const uvgrtp::impairment& config, uint64_t seed)
+{
+    link_.reset(new uvgrtp::impaired_link(config, seed,
+        [this](const struct sockaddr *sender, socklen_t sender_len, const std::vector<std::pair<size_t, uint8_t *>>& buffers) {
+            return enqueue(sender, sender_len, buffers);
+        }));
+}
+
+void uvgrtp::memory_transport::attach(std::shared_ptr<memory_transport> transport, const sockaddr_in& address)
+{
+    if (transport->share_ && transport->publish(key_of(address, address.sin_addr.s_addr == htonl(INADDR_ANY))) != RTP_OK) {
+        UVG_LOG_WARN("Only the datagrams of this process are received in memory on port %u", ntohs(address.sin_port));
+    }
+
+    memory_registration r = {};
+    r.ipv6      = false;
+    r.address   = address;
+    r.owner     = transport.get();
+    r.transport = transport;
+
+    memory_registry& registry = get_registry();
+    std::lock_guard<std::mutex> lg(registry.mutex);
+    registry.transports.insert({ ntohs(address.sin_port), r });
+}
+
+void uvgrtp::memory_transport::attach(std::shared_ptr<memory_transport> transport, const sockaddr_in6& address)
+{
+    if (transport->share_ &&
+        transport->publish(key_of(address, memcmp(&address.sin6_addr, &in6addr_any, sizeof(in6_addr)) == 0)) != RTP_OK) {
+        UVG_LOG_WARN("Only the datagrams of this process are received in memory on port %u", ntohs(address.sin6_port));
+    }
+
+    memory_registration r = {};
+    r.ipv6      = true;
+    r.address6  = address;
+    r.owner     = transport.get();
+    r.transport = transport;
+
+    memory_registry& registry = get_registry();
+    std::lock_guard<std::mutex> lg(registry.mutex);
+    registry.transports.insert({ ntohs(address.sin6_port), r });
+}
+
+void uvgrtp::memory_transport::detach()
+{
+    memory_registry& registry = get_registry();
+    std::lock_guard<std::mutex> lg(registry.mutex);
+
+    for (auto it = registry.transports.begin(); it != registry.transports.end();) {
+        if (it->second.owner == this)
+            it = registry.transports.erase(it);
+        else
+            ++it;
+    }
+}
+
+std::shared_ptr<uvgrtp::memory_transport> uvgrtp::memory_transport::find(const sockaddr_in& address)
+{
+    return find_registered(address, ntohs(address.sin_port));
+}
+
+std::shared_ptr<uvgrtp::memory_transport> uvgrtp::memory_transport::find(const sockaddr_in6& address)
+{
+    return find_registered(address, ntohs(address.sin6_port));
+}
+
+std::shared_ptr<uvgrtp::memory_transport> uvgrtp::memory_transport::find_shared(const sockaddr_in& address)
+{
+    std::shared_ptr<memory_transport> transport = find_cached(key_of(address, false));
+
+    if (!transport && (ntohl(address.sin_addr.s_addr) >> 24) == 127)
+        transport = find_cached(key_of(address, true));
+
+    return transport;
+}
+
+std::shared_ptr<uvgrtp::memory_transport> uvgrtp::memory_transport::find_shared(const sockaddr_in6& address)
+{
+    std::shared_ptr<memory_transport> transport = find_cached(key_of(address, false));
+
+    if (!transport && IN6_IS_ADDR_LOOPBACK(&address.sin6_addr))
+        transport = find_cached(key_of(address, true));
+
+    return transport;
+}
+
+std::shared_ptr<uvgrtp::memory_transport> uvgrtp::memory_transport::find_cached(const shared_key& key)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    // a closed transport is dropped after the lock is released
+    std::shared_ptr<memory_transport> stale;
+
+    memory_registry& registry = get_registry();
+    std::lock_guard<std::mutex> lg(registry.mutex);
+
+    std::chrono::milliseconds interval(SHARED_LOOKUP_MIN_INTERVAL_MS);
+
+    auto it = registry.peers.find(key);
+    if (it != registry.peers.end()) {
+        if (it->second.transport && !it->second.transport->closed())
+            return it->second.transport;
+
+        if (!it->second.transport) {
+            if (now - it->second.checked < it->second.interval)
+                return nullptr;
+
+            interval = std::min(it->second.interval * 2, std::chrono::milliseconds(SHARED_LOOKUP_INTERVAL_MS));
+        }
+
+        stale = std::move(it->second.transport);
+    }
+
+    std::shared_ptr<memory_transport> transport = open_shared(key);
+    registry.peers[key] = { transport, now, interval };
+    return transport;
+}
+
+uvgrtp::memory_transport::shared_key uvgrtp::memory_transport::key_of(const sockaddr_in& address, bool any)
+{
+    shared_key key = {};
+    key[0] = any ? 0x84 : 0x04;
+
+    if (!any)
+        memcpy(&key[1], &address.sin_addr, sizeof(address.sin_addr));
+
+    memcpy(&key[17], &address.sin_port, sizeof(address.sin_port));
+    return key;
+}
+
+uvgrtp::memory_transport::shared_key uvgrtp::memory_transport::key_of(const sockaddr_in6& address, bool any)
+{
+    shared_key key = {};
+    key[0] = any ? 0x86 : 0x06;
+
+    if (!any)
+        memcpy(&key[1], &address.sin6_addr, sizeof(address.sin6_addr));
+
+    memcpy(&key[17], &address.sin6_port, sizeof(address.sin6_port));
+    return key;
+}
+
+std::string uvgrtp::memory_transport::name_of(const shared_key& key)
+{
+    size_t address_len = (key[0] & 0x0F) == 4 ? 4 : 16;
+    uint16_t port = (uint16_t)((key[17] << 8) | key[18]);
+
+    // e.g. "/uvgrtp-4-7f000001-8888" or "/uvgrtp-6-any-8888"
+    std::string name = "/uvgrtp-" + std::to_string(key[0] & 0x0F) + "-";
+
+    if (key[0] & 0x80) {
+        name += "any";
+    } else {
+        char hex[3];
+        for (size_t i = 0; i < address_len; ++i) {
+            snprintf(hex, sizeof(hex), "%02x", key[1 + i]);
+            name += hex;
+        }
+    }
+
+    return name + "-" + std::to_string(port);
+}
+
+rtp_error_t uvgrtp::memory_transport::publish(const shared_key& key)
+{
+#ifdef __linux__
+    std::string name = name_of(key);
+    size_t offset    = (sizeof(shared_header) + 63) & ~(size_t)63;
+    size_t size      = offset + mpsc_queue<datagram>::memory_size(MEMORY_QUEUE_SIZE);
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+    if (fd < 0 && errno == EEXIST) {
+        // the segment of a process that did not close its socket, which its senders may still have mapped
+        int stale_fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+        struct stat st = {};
+
+        if (stale_fd >= 0 && fstat(stale_fd, &st) == 0 && (size_t)st.st_size >= sizeof(shared_header)) {
+            void *stale = mmap(nullptr, sizeof(shared_header), PROT_READ | PROT_WRITE, MAP_SHARED, stale_fd, 0);
+            if (stale != MAP_FAILED) {
+                if (((shared_header *)stale)->magic == SHARED_MAGIC)
+                    ((shared_header *)stale)->closed.store(1, std::memory_order_release);
+                munmap(stale, sizeof(shared_header));
+            }
+        }
+        if (stale_fd >= 0)
+            close(stale_fd);
+
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    }
+
+    if (fd < 0) {
+        UVG_LOG_ERROR("Failed to create the shared memory segment %s: %s", name.c_str(), strerror(errno));
+        return RTP_GENERIC_ERROR;
+    }
+
+    struct stat st = {};
+    void *memory   = MAP_FAILED;
+
+    if (ftruncate(fd, (off_t)size) == 0 && fstat(fd, &st) == 0)
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (memory == MAP_FAILED) {
+        UVG_LOG_ERROR("Failed to map the shared memory segment %s: %s", name.c_str(), strerror(errno));
+        shm_unlink(name.c_str());
+        return RTP_GENERIC_ERROR;
+    }
+
+    // the wakeup socket has the name of the segment in the abstract namespace, without the slash
+    sockaddr_un address = {};
+    address.sun_family  = AF_UNIX;
+    memcpy(address.sun_path + 1, name.c_str() + 1, name.size() - 1);
+    socklen_t address_len = (socklen_t)(offsetof(sockaddr_un, sun_path) + name.size());
+
+    int wake_fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (wake_fd < 0 || ::bind(wake_fd, (struct sockaddr *)&address, address_len) < 0) {
+        UVG_LOG_ERROR("Failed to create the wakeup socket of %s: %s", name.c_str(), strerror(errno));
+        if (wake_fd >= 0)
+            close(wake_fd);
+        munmap(memory, size);
+        shm_unlink(name.c_str());
+        return RTP_GENERIC_ERROR;
+    }
+
+    shared_header *header = new (memory) shared_header();
+    header->magic         = SHARED_MAGIC;
+    header->version       = SHARED_VERSION;
+    header->queue_size    = MEMORY_QUEUE_SIZE;
+    header->datagram_size = sizeof(datagram);
+    header->closed.store(0, std::memory_order_relaxed);
+    header->signaled.store(false, std::memory_order_relaxed);
+
+    // nothing is queued before the transport is attached, so the queue of the process can be replaced
+    queue_.reset(new mpsc_queue<datagram>((uint8_t *)memory + offset, MEMORY_QUEUE_SIZE, true));
+    signaled_ = &header->signaled;
+
+    close(wake_fd_);
+    wake_fd_   = wake_fd;
+    signal_fd_ = wake_fd;
+    memcpy(&wake_address_, &address, address_len);
+    wake_address_len_ = address_len;
+
+    owner_        = true;
+    segment_      = header;
+    segment_size_ = size;
+    segment_id_   = (uint64_t)st.st_ino;
+    name_         = name;
+
+    header->ready.store(1, std::memory_order_release);
+    return RTP_OK;
+#else
+    (void)key;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+std::shared_ptr<uvgrtp::memory_transport> uvgrtp::memory_transport::open_shared(const shared_key& key)
+{
+#ifdef __linux__
+    std::string name = name_of(key);
+    size_t offset    = (sizeof(shared_header) + 63) & ~(size_t)63;
+    size_t size      = offset + mpsc_queue<datagram>::memory_size(MEMORY_QUEUE_SIZE);
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0)
+        return nullptr;
+
+    // a segment of another version of the library has another size or header
+    struct stat st = {};
+    void *memory   = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == size)
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (memory == MAP_FAILED)
+        return nullptr;
+
+    shared_header *header = (shared_header *)memory;
+
+    if (header->magic != SHARED_MAGIC || header->version != SHARED_VERSION || header->queue_size != MEMORY_QUEUE_SIZE ||
+        header->datagram_size != sizeof(datagram) || !header->ready.load(std::memory_order_acquire) ||
+        header->closed.load(std::memory_order_acquire)) {
+        munmap(memory, size);
+        return nullptr;
+    }
+
+    std::shared_ptr<memory_transport> transport = std::make_shared<memory_transport>();
+    transport->segment_      = header;
+    transport->segment_size_ = size;
+    transport->name_         = name;
+    transport->queue_.reset(new mpsc_queue<datagram>((uint8_t *)memory + offset, MEMORY_QUEUE_SIZE, false));
+    transport->signaled_     = &header->signaled;
+
+    if ((transport->signal_fd_ = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+        UVG_LOG_ERROR("Failed to create a socket to wake %s: %s", name.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    sockaddr_un address = {};
+    address.sun_family  = AF_UNIX;
+    memcpy(address.sun_path + 1, name.c_str() + 1, name.size() - 1);
+
+    memcpy(&transport->wake_address_, &address, sizeof(address));
+    transport->wake_address_len_ = (socklen_t)(offsetof(sockaddr_un, sun_path) + name.size());
+
+    UVG_LOG_DEBUG("Sending to %s in shared memory", name.c_str());
+    return transport;
+#else
+    (void)key;
+    return nullptr;
+#endif
+}
+
+bool uvgrtp::memory_transport::closed() const
+{
+    return segment_ && segment_->closed.load(std::memory_order_acquire);
+}
+
+bool uvgrtp::memory_transport::deliver(const struct sockaddr *sender, socklen_t sender_len,
+    const std::vector<std::pair<size_t, uint8_t *>>& buffers)
+{
+    size_t length = 0;
+    for (auto& buffer : buffers) {
+        length += buffer.first;
+    }
+
+    if (length > MEMORY_DATAGRAM_SIZE || sender_len > sizeof(sockaddr_in6))
+        return false;
+
+    // the link takes the datagram even if it is lost or dropped later, like the network would
+    if (link_) {
+        link_->submit(sender, sender_len, buffers);
+        return true;
+    }
+
+    return enqueue(sender, sender_len, buffers);
+}
+
+bool uvgrtp::memory_transport::enqueue(const struct sockaddr *sender, socklen_t sender_len,
+    const std::vector<std::pair<size_t, uint8_t *>>& buffers)
+{
+    size_t position = 0;
+    datagram *d = queue_->reserve(position);
+    if (!d)
+        return false;
+
+    memcpy(&d->sender, sender, sender_len);
+    d->sender_len = sender_len;
+    d->length     = 0;
+
+    for (auto& buffer : buffers) {
+        memcpy(d->data + d->length, buffer.second, buffer.first);
+        d->length += buffer.first;
+    }
+
+    queue_->publish(position);
+    signal();
+    return true;
+}
+
+void uvgrtp::memory_transport::signal()
+{
+    // the datagram must be visible before "signaled_" is read, the reader does the opposite
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (signaled_->load(std::memory_order_relaxed) || signaled_->exchange(true))
+        return;
+
+#ifdef __linux__
+    if (segment_) {
+        // a full socket already has a wakeup waiting and a refused one has no reader left
+        char wakeup = 0;
+        if (::sendto(signal_fd_, &wakeup, sizeof(wakeup), MSG_DONTWAIT, (const struct sockaddr *)&wake_address_,
+                wake_address_len_) < 0 && errno != EAGAIN && errno != ECONNREFUSED) {
+            UVG_LOG_ERROR("Failed to wake the reader of %s: %s", name_.c_str(), strerror(errno));
+        }
+        return;
+    }
+
+    uint64_t one = 1;
+    if (write(wake_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        UVG_LOG_ERROR("Failed to wake the reader of the memory transport: %s", strerror(errno));
+    }
+#endif
+}
+
+int uvgrtp::memory_transport::receive(uint8_t *buf, size_t buf_len, struct sockaddr *sender, socklen_t *sender_len)
+{
+    datagram *d = queue_->front();
+
+    if (!d) {
+        /* The queue is empty, so let the next datagram wake the reader again. The wakeups are emptied
+         * even if "signaled_" is not set, since a sender may have written one after they were last
+         * emptied. A datagram queued before "signaled_" was cleared is found by the second look */
+#ifdef __linux__
+        if (segment_) {
+            char wakeups[64];
+            while (::recv(wake_fd_, wakeups, sizeof(wakeups), MSG_DONTWAIT) > 0)
+                ;
+        } else {
+            uint64_t count = 0;
+            if (read(wake_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                UVG_LOG_ERROR("Failed to read the eventfd of the memory transport: %s", strerror(errno));
+            }
+        }
+#endif
+        signaled_->store(false, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (!(d = queue_->front()))
+            return -1;
+    }
+
+    size_t copied = std::min(d->length, buf_len);
+    if (copied < d->length) {
+        UVG_LOG_WARN("A datagram of %zu bytes was cut to the %zu bytes of the receive buffer", d->length, buf_len);
+    }
+    memcpy(buf, d->data, copied);
+
+    if (sender && sender_len) {
+        socklen_t name_len = std::min(*sender_len, d->sender_len);
+        memcpy(sender, &d->sender, name_len);
+        *sender_len = d->sender_len;
+    }
+
+    int length = (int)copied;
+    queue_->pop();
+    return length;
+}
+
+int uvgrtp::memory_transport::wake_fd() const
+{
+    return wake_fd_;
+}
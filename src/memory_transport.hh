@@ -0,0 +1,190 @@
+#pragma once
+
+#include "mpsc_queue.hh"
+
+#include "uvgrtp/util.hh"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2ipdef.h>
+#include <WS2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* Longest datagram the memory transport carries, longer ones are sent through the kernel */
+    const size_t MEMORY_DATAGRAM_SIZE = 2048;
+
+    /* How many datagrams can wait for the receiving socket */
+    const size_t MEMORY_QUEUE_SIZE = 1024;
+
+    /* How long a sender of the shared memory transport takes an address without a receiver
+     * in another process as such before it looks again. The wait starts from the shortest one
+     * and doubles after each failed lookup, so a receiver that appears soon after the first
+     * lookup is found soon */
+    const int SHARED_LOOKUP_MIN_INTERVAL_MS = 1;
+    const int SHARED_LOOKUP_INTERVAL_MS = 1000;
+
+    class impaired_link;
+    struct impairment;
+
+    /* The receiving end of the in-process transport of a socket, see uvgrtp::context::set_transport().
+     *
+     * A socket of the memory transport attaches to a process-wide registry under the address it is
+     * bound to. A socket of the same process sending to that address copies the datagram straight to
+     * the bounded lock-free queue of the receiving socket instead of going through the kernel, and
+     * the reception thread of the receiver reads it from the queue as if it had come from the
+     * socket. The eventfd of wake_fd() is written only when the queue turns non-empty for a reader
+     * that may be sleeping in poll(2), so a busy pipeline costs no system calls per datagram.
+     *
+     * A shared transport, see RTP_TRANSPORT_SHARED_MEMORY, also creates a POSIX shared memory
+     * segment named after the address when it is attached and places its queue there, so the
+     * senders of other processes on the host can map the segment and queue their datagrams the
+     * same way. Since an eventfd cannot be opened by another process, the reader of a shared
+     * transport is woken through a unix datagram socket of the abstract namespace with the same
+     * name instead, which is written under the same rule as the eventfd */
+    class memory_transport {
+        public:
+            memory_transport();
+            ~memory_transport();
+
+            memory_transport(const memory_transport&) = delete;
+            memory_transport& operator=(const memory_transport&) = delete;
+
+            /* Create the eventfd of wake_fd()
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the platform has no eventfd
+             * Return RTP_GENERIC_ERROR if creating the eventfd failed */
+            rtp_error_t init();
+
+            /* Let the datagrams delivered to this transport go through an emulated link with the
+             * conditions of "config", see uvgrtp::impaired_link. Must be called before attach() */
+            void impair(const uvgrtp::impairment& config, uint64_t seed);
+
+            /* Let the processes of the host send to this transport through shared memory once it
+             * is attached. Must be called after init() and before attach() */
+            void share();
+
+            bool shared() const
+            {
+                return share_;
+            }
+
+            /* Let the datagrams sent to "address" in this process be delivered to "transport". An
+             * address with the unspecified IP gets the datagrams sent to any IP with its port.
+             *
+             * A shared transport is published to the other processes under "address" as well. If
+             * that fails, the transport only receives the datagrams of this process */
+            static void attach(std::shared_ptr<memory_transport> transport, const sockaddr_in& address);
+            static void attach(std::shared_ptr<memory_transport> transport, const sockaddr_in6& address);
+
+            /* Remove the transport from the registry, the datagrams sent to it go through the kernel again */
+            void detach();
+
+            /* The attached transport that receives the datagrams sent to "address", nullptr if there is none */
+            static std::shared_ptr<memory_transport> find(const sockaddr_in& address);
+            static std::shared_ptr<memory_transport> find(const sockaddr_in6& address);
+
+            /* The shared transport of another process that receives the datagrams sent to "address",
+             * nullptr if there is none. A transport bound to the unspecified IP is found through
+             * the loopback address. The answer is cached, an address without a transport is looked
+             * up again after at most SHARED_LOOKUP_INTERVAL_MS and a transport that has been closed
+             * right away */
+            static std::shared_ptr<memory_transport> find_shared(const sockaddr_in& address);
+            static std::shared_ptr<memory_transport> find_shared(const sockaddr_in6& address);
+
+            /* Queue the datagram made of "buffers" sent from "sender". Never blocks and may be called
+             * from any thread
+             *
+             * Return false if the datagram is too long or the queue is full, in which case it should
+             * be sent through the kernel */
+            bool deliver(const struct sockaddr *sender, socklen_t sender_len,
+                const std::vector<std::pair<size_t, uint8_t *>>& buffers);
+
+            /* Called by the reading thread: take the oldest queued datagram to "buf", which is cut
+             * to "buf_len" bytes if it is longer, and write the sender to "sender" if it is not nullptr
+             *
+             * Return the length of the datagram or -1 if the queue is empty */
+            int receive(uint8_t *buf, size_t buf_len, struct sockaddr *sender, socklen_t *sender_len);
+
+            /* The file descriptor that is readable when datagrams may be queued, -1 before init() */
+            int wake_fd() const;
+
+        private:
+            struct datagram {
+                sockaddr_in6 sender;
+                socklen_t sender_len;
+                size_t length;
+                uint8_t data[MEMORY_DATAGRAM_SIZE];
+            };
+
+            /* The version and address of a shared segment, the first byte is 4 or 6 with 0x80 set
+             * for the unspecified address, followed by the address and the port */
+            typedef std::array<uint8_t, 19> shared_key;
+
+            struct shared_header;
+
+            static shared_key key_of(const sockaddr_in& address, bool any);
+            static shared_key key_of(const sockaddr_in6& address, bool any);
+            static std::string name_of(const shared_key& key);
+
+            /* Called by attach(): create the segment of "key" and move the queue there */
+            rtp_error_t publish(const shared_key& key);
+
+            /* Map the segment of another process for sending, nullptr if there is none */
+            static std::shared_ptr<memory_transport> open_shared(const shared_key& key);
+
+            /* The cached transport of open_shared() */
+            static std::shared_ptr<memory_transport> find_cached(const shared_key& key);
+
+            /* Whether the owner of the mapped segment has closed it */
+            bool closed() const;
+
+            /* Copy the datagram to the queue, returns false if the queue is full */
+            bool enqueue(const struct sockaddr *sender, socklen_t sender_len,
+                const std::vector<std::pair<size_t, uint8_t *>>& buffers);
+
+            /* Wake the reader if it may be waiting for the queue */
+            void signal();
+
+            std::unique_ptr<mpsc_queue<datagram>> queue_;
+
+            int wake_fd_;
+
+            /* Set by the senders when they wake the reader and cleared by the reader when it has found the
+             * queue empty, so each datagram does not need a system call of its own. Points to
+             * "local_signaled_" or to the header of the shared segment */
+            std::atomic<bool> local_signaled_;
+            std::atomic<bool> *signaled_;
+
+            /* The shared segment this transport owns or has mapped, nullptr if there is none */
+            bool share_;
+            bool owner_;
+            shared_header *segment_;
+            size_t segment_size_;
+            uint64_t segment_id_;
+            std::string name_;
+
+            /* The unix socket the senders of a shared segment write to, and its address */
+            int signal_fd_;
+            sockaddr_storage wake_address_;
+            socklen_t wake_address_len_;
+
+            /* The link of impair(), nullptr if the datagrams are queued as they are delivered */
+            std::unique_ptr<uvgrtp::impaired_link> link_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+namespace uvgrtp {
+
+    /* A bounded lock-free queue of many producers and one consumer, after the bounded queue
+     * of Dmitry Vyukov. The elements are allocated with the queue and filled in place: a
+     * producer reserves an element, writes it and publishes it to the consumer, which reads
+     * it in place and pops it. A producer that has reserved an element does not hold back the
+     * other producers, but the consumer waits for the elements to be published in order */
+    template <typename T>
+    class mpsc_queue {
+        public:
+            /* "size" must be a power of two */
+            explicit mpsc_queue(size_t size) :
+                owned_(new block[(memory_size(size) + sizeof(block) - 1) / sizeof(block)]),
+                dequeue_pos_(0)
+            {
+                place(owned_.get(), size, true);
+            }
+
+            /* A queue in "memory" of memory_size("size") bytes aligned to 64 bytes, such as a segment
+             * shared with other processes, which have the producers of the same queue. The queue is
+             * initialized if "initialize" is true, otherwise it is taken as it is */
+            mpsc_queue(void *memory, size_t size, bool initialize) :
+                dequeue_pos_(0)
+            {
+                place(memory, size, initialize);
+            }
+
+            ~mpsc_queue()
+            {
+                // the elements of a queue in given memory belong to whoever owns the memory
+                if (!owned_)
+                    return;
+
+                for (size_t i = 0; i <= mask_; ++i) {
+                    cells_[i].~cell();
+                }
+            }
+
+            mpsc_queue(const mpsc_queue&) = delete;
+            mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+            /* How many bytes a queue of "size" elements takes */
+            static constexpr size_t memory_size(size_t size)
+            {
+                return sizeof(head) + size * sizeof(cell);
+            }
+
+            /* Reserve the next free element and write its position to "position" for publish()
+             *
+             * Return the element or nullptr if the queue is full */
+            T *reserve(size_t& position)
+            {
+                size_t pos = head_->enqueue_pos.load(std::memory_order_relaxed);
+
+                for (;;) {
+                    cell *c = &cells_[pos & mask_];
+                    size_t sequence = c->sequence.load(std::memory_order_acquire);
+                    intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+                    if (diff == 0) {
+                        if (head_->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            position = pos;
+                            return &c->value;
+                        }
+                    } else if (diff < 0) {
+                        // the consumer has not yet popped the element published a whole queue ago
+                        return nullptr;
+                    } else {
+                        pos = head_->enqueue_pos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            /* Give the element reserved at "position" to the consumer */
+            void publish(size_t position)
+            {
+                cells_[position & mask_].sequence.store(position + 1, std::memory_order_release);
+            }
+
+            /* Called by the consumer: the oldest published element, nullptr if there is none */
+            T *front()
+            {
+                cell *c = &cells_[dequeue_pos_ & mask_];
+
+                if (c->sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1)
+                    return nullptr;
+
+                return &c->value;
+            }
+
+            /* Called by the consumer: free the element of front() for the producers */
+            void pop()
+            {
+                cells_[dequeue_pos_ & mask_].sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+                ++dequeue_pos_;
+            }
+
+        private:
+            // the position shared by the producers, which may be in another process
+            struct head {
+                alignas(64) std::atomic<size_t> enqueue_pos;
+            };
+
+            struct cell {
+                std::atomic<size_t> sequence;
+                T value;
+            };
+
+            struct alignas(64) block {
+                uint8_t bytes[64];
+            };
+
+            static_assert(std::atomic<size_t>::is_always_lock_free, "the queue may be shared between processes");
+
+            void place(void *memory, size_t size, bool initialize)
+            {
+                head_  = (head *)memory;
+                cells_ = (cell *)((uint8_t *)memory + sizeof(head));
+                mask_  = size - 1;
+
+                if (!initialize)
+                    return;
+
+                new (head_) head();
+                head_->enqueue_pos.store(0, std::memory_order_relaxed);
+
+                for (size_t i = 0; i < size; ++i) {
+                    new (&cells_[i]) cell;
+                    cells_[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            std::unique_ptr<block[]> owned_;
+
+            head *head_;
+            cell *cells_;
+            size_t mask_;
+
+            alignas(64) size_t dequeue_pos_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
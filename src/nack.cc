@@ -0,0 +1,154 @@
+#include "nack.hh"
+
+#include "debug.hh"
+#include "global.hh"
+
+/* A packet is resent at most once in this time even if it is asked for more often */
+constexpr int NACK_RESEND_INTERVAL_MS = 10;
+
+/* How long the receiver waits for a retransmission before asking again, and how many times it asks */
+constexpr int NACK_RETRY_INTERVAL_MS = 30;
+constexpr int NACK_MAX_RETRIES       = 3;
+
+/* A larger jump of the sequence number is a restart of the sender rather than lost packets */
+constexpr int64_t MAX_NACK_GAP = 1000;
+
+uvgrtp::packet_history::packet_history(std::shared_ptr<uvgrtp::socket> socket, size_t size) :
+    socket_(socket),
+    packets_(size),
+    addr_({}),
+    addr6_({})
+{
+}
+
+void uvgrtp::packet_history::set_size(size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    packets_.clear();
+    packets_.resize(size);
+}
+
+size_t uvgrtp::packet_history::get_size()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return packets_.size();
+}
+
+void uvgrtp::packet_history::packets_sent(const sockaddr_in& addr, const sockaddr_in6& addr6,
+    const uvgrtp::pkt_vec& packets)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (packets_.empty())
+        return;
+
+    addr_  = addr;
+    addr6_ = addr6;
+
+    for (auto& buffers : packets) {
+        if (buffers.empty() || buffers[0].first < RTP_HDR_SIZE)
+            continue;
+
+        uint16_t seq = ntohs(*(uint16_t *)&buffers[0].second[2]);
+        sent_packet& packet = packets_[seq % packets_.size()];
+
+        // the capacity of the slot is kept, so the history stops allocating once it is full
+        packet.data.clear();
+        for (auto& buffer : buffers) {
+            packet.data.insert(packet.data.end(), buffer.second, buffer.second + buffer.first);
+        }
+        packet.valid  = true;
+        packet.seq    = seq;
+        packet.resent = std::chrono::steady_clock::time_point();
+    }
+}
+
+size_t uvgrtp::packet_history::resend(const std::vector<uint16_t>& seqs)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (packets_.empty())
+        return 0;
+
+    auto now = std::chrono::steady_clock::now();
+    size_t resent = 0;
+
+    for (uint16_t seq : seqs) {
+        sent_packet& packet = packets_[seq % packets_.size()];
+
+        if (!packet.valid || packet.seq != seq ||
+            now - packet.resent < std::chrono::milliseconds(NACK_RESEND_INTERVAL_MS))
+        {
+            continue;
+        }
+
+        if (socket_->sendto(addr_, addr6_, packet.data.data(), packet.data.size(), 0) != RTP_OK) {
+            UVG_LOG_ERROR("Failed to resend packet %u", seq);
+            break;
+        }
+        packet.resent = now;
+        ++resent;
+    }
+
+    return resent;
+}
+
+uvgrtp::nack_generator::nack_generator() :
+    highest_(-1),
+    missing_()
+{
+}
+
+void uvgrtp::nack_generator::packet_received(uint16_t seq, std::chrono::steady_clock::time_point now)
+{
+    if (highest_ < 0) {
+        highest_ = seq;
+        return;
+    }
+
+    int64_t extended = highest_ + (int16_t)(seq - (uint16_t)highest_);
+
+    // a late or retransmitted packet
+    if (extended <= highest_) {
+        missing_.erase(extended);
+        return;
+    }
+
+    if (extended - highest_ > MAX_NACK_GAP) {
+        UVG_LOG_DEBUG("Sequence number jumped by %lli, not asking for the packets in between",
+            (long long)(extended - highest_));
+        missing_.clear();
+    } else {
+        for (int64_t i = highest_ + 1; i < extended; ++i) {
+            missing_[i].detected = now;
+        }
+    }
+    highest_ = extended;
+}
+
+void uvgrtp::nack_generator::get_nacks(std::chrono::steady_clock::time_point now, size_t max_delay_ms,
+    std::vector<uint16_t>& seqs)
+{
+    for (auto it = missing_.begin(); it != missing_.end();) {
+        missing_packet& packet = it->second;
+
+        bool retry = packet.requests == 0 ||
+            now - packet.requested >= std::chrono::milliseconds(NACK_RETRY_INTERVAL_MS);
+
+        // the receiver has given up the frame of the packet or the sender does not have it
+        if ((retry && packet.requests >= NACK_MAX_RETRIES) ||
+            now - packet.detected > std::chrono::milliseconds(max_delay_ms))
+        {
+            it = missing_.erase(it);
+            continue;
+        }
+
+        if (retry) {
+            seqs.push_back((uint16_t)it->first);
+            packet.requested = now;
+            ++packet.requests;
+        }
+        ++it;
+    }
+}
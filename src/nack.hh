@@ -0,0 +1,95 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include "socket.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* Selective retransmission with Generic NACK, see RFC 4585 section 6.2.1
+     *
+     * The receiver asks for the packets missing from the sequence number space with NACK
+     * feedback and the sender sends them again from a history of the packets it has sent.
+     * The packets are resent exactly as they were sent, so with SRTP the retransmission
+     * passes the replay protection of the receiver, which has never seen the packet. */
+
+    /* Default number of packets kept for retransmission, see RCC_NACK_HISTORY_SIZE */
+    constexpr size_t DEFAULT_NACK_HISTORY_SIZE = 1024;
+
+    /* The sent packets of one stream, by RTP sequence number */
+    class packet_history {
+        public:
+            packet_history(std::shared_ptr<uvgrtp::socket> socket, size_t size);
+
+            /* Keep the last "size" packets. The packets in the history are forgotten */
+            void set_size(size_t size);
+            size_t get_size();
+
+            /* Copy the sent "packets" to the history, "addr" and "addr6" are the destination */
+            void packets_sent(const sockaddr_in& addr, const sockaddr_in6& addr6, const uvgrtp::pkt_vec& packets);
+
+            /* Send the packets "seqs" that are still in the history again. A packet is resent
+             * at most once in NACK_RESEND_INTERVAL_MS, so that repeated NACKs do not multiply
+             * the retransmissions
+             *
+             * Return the number of packets resent */
+            size_t resend(const std::vector<uint16_t>& seqs);
+
+        private:
+            struct sent_packet {
+                bool valid = false;
+                uint16_t seq = 0;
+                std::vector<uint8_t> data;
+                std::chrono::steady_clock::time_point resent;
+            };
+
+            std::mutex mutex_;
+            std::shared_ptr<uvgrtp::socket> socket_;
+
+            std::vector<sent_packet> packets_;
+
+            sockaddr_in addr_;
+            sockaddr_in6 addr6_;
+    };
+
+    /* Finds the packets missing from the received sequence numbers of one stream and
+     * decides when to ask for them. A missing packet is asked for right away and again
+     * every NACK_RETRY_INTERVAL_MS until it arrives, it has been asked for NACK_MAX_RETRIES
+     * times or the packets have waited longer than the receiver keeps them */
+    class nack_generator {
+        public:
+            nack_generator();
+
+            /* Update the missing packets with a received packet */
+            void packet_received(uint16_t seq, std::chrono::steady_clock::time_point now);
+
+            /* Get the sequence numbers to ask for now to "seqs", "max_delay_ms" is RCC_PKT_MAX_DELAY */
+            void get_nacks(std::chrono::steady_clock::time_point now, size_t max_delay_ms, std::vector<uint16_t>& seqs);
+
+            size_t missing() const
+            {
+                return missing_.size();
+            }
+
+        private:
+            struct missing_packet {
+                std::chrono::steady_clock::time_point detected;
+                std::chrono::steady_clock::time_point requested;
+                int requests = 0;
+            };
+
+            /* The highest sequence number received, extended to 64 bits, -1 before the first packet */
+            int64_t highest_;
+
+            std::map<int64_t, missing_packet> missing_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,272 @@
+#include "pacer.hh"
+
+#include "uvgrtp/clock.hh"
+
+#include "debug.hh"
+#include "threads.hh"
+
+#include <algorithm>
+
+static size_t packet_size(const uvgrtp::buf_vec& packet)
+{
+    size_t size = 0;
+    for (auto& buffer : packet) {
+        size += buffer.first;
+    }
+    return size;
+}
+
+uvgrtp::pacer::pacer() :
+    jobs_(),
+    jobs_added_(false),
+    virtual_time_(0.0),
+    active_(false),
+    thread_(nullptr),
+    thread_settings_(nullptr)
+{
+}
+
+uvgrtp::pacer::~pacer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = false;
+    }
+    cond_.notify_all();
+
+    if (thread_ && thread_->joinable()) {
+        thread_->join();
+    }
+}
+
+rtp_error_t uvgrtp::pacer::send(uvgrtp::pacing_bucket& bucket, std::shared_ptr<uvgrtp::socket> socket,
+    sockaddr_in& addr, sockaddr_in6& addr6, uvgrtp::pkt_vec& packets,
+    uvgrtp::send_arrays& arrays, std::chrono::nanoseconds window)
+{
+    job j;
+    start(j, bucket, socket, addr, addr6, packets, arrays, window);
+    return wait(j);
+}
+
+void uvgrtp::pacer::start(job& j, uvgrtp::pacing_bucket& bucket, std::shared_ptr<uvgrtp::socket> socket,
+    sockaddr_in& addr, sockaddr_in6& addr6, uvgrtp::pkt_vec& packets,
+    uvgrtp::send_arrays& arrays, std::chrono::nanoseconds window)
+{
+    size_t frame_bytes = 0;
+    size_t largest = 0;
+
+    for (auto& packet : packets) {
+        size_t size = packet_size(packet);
+        frame_bytes += size;
+        largest = std::max(largest, size);
+    }
+
+    double seconds = std::chrono::duration<double>(window).count();
+    if (packets.empty() || seconds <= 0.0) {
+        j.result = socket->sendto(addr, addr6, packets, 0, arrays);
+        j.done   = true;
+        return;
+    }
+
+    std::chrono::steady_clock::time_point now = uvgrtp::clock::tsc::now();
+    double depth = (double)std::max(largest, bucket.burst_packets * frame_bytes / packets.size());
+
+    /* Tokens saved while the stream was idle are kept up to the size of the bucket,
+     * so the first burst of a frame leaves at once. The rate is then set so that the
+     * rest of the frame fits in the window */
+    if (bucket.rate > 0.0)
+        bucket.tokens += std::chrono::duration<double>(now - bucket.last_fill).count() * bucket.rate;
+    else
+        bucket.tokens = depth;
+
+    bucket.rate      = (double)frame_bytes / seconds;
+    bucket.depth     = depth;
+    bucket.tokens    = std::min(bucket.tokens, depth);
+    bucket.last_fill = now;
+
+    j = { &bucket, socket, &addr, &addr6, &packets, &arrays, 0, now, RTP_OK, false };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!thread_) {
+        active_ = true;
+        thread_ = uvgrtp::start_thread(thread_settings_, RTP_THREAD_SENDER, -1, &uvgrtp::pacer::runner, this);
+    }
+
+    // a stream that has been idle starts from the current virtual time instead of catching up
+    bucket.virtual_time = std::max(bucket.virtual_time, virtual_time_);
+
+    jobs_.push_back(&j);
+    jobs_added_ = true;
+    cond_.notify_all();
+}
+
+rtp_error_t uvgrtp::pacer::wait(job& j)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    done_cond_.wait(lock, [&j] { return j.done; });
+    return j.result;
+}
+
+void uvgrtp::pacer::set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread_settings_ = settings;
+}
+
+void uvgrtp::pacer::runner()
+{
+    UVG_LOG_DEBUG("Starting pacer");
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (active_) {
+        if (jobs_.empty()) {
+            cond_.wait(lock, [this] { return !jobs_.empty() || !active_; });
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point now = uvgrtp::clock::tsc::now();
+        job *j = next_job(now);
+
+        if (j->due > now) {
+            jobs_added_ = false;
+            wait_until(lock, j->due, j->bucket->spin);
+
+            // a frame that was added during the wait may be due before this one
+            if (jobs_added_ || !active_)
+                continue;
+
+            now = uvgrtp::clock::tsc::now();
+        }
+
+        virtual_time_ = j->bucket->virtual_time;
+
+        size_t bytes = 0;
+
+        lock.unlock();
+        bool finished = send_burst(*j, now, bytes);
+        lock.lock();
+
+        j->bucket->virtual_time += (double)bytes / (double)j->bucket->weight.load(std::memory_order_relaxed);
+
+        if (finished) {
+            jobs_.erase(std::find(jobs_.begin(), jobs_.end(), j));
+            j->done = true;
+            done_cond_.notify_all();
+        }
+    }
+
+    // the owner of a frame outlives the pacer, but never leave anyone waiting
+    for (auto& j : jobs_) {
+        j->result = RTP_INTERRUPTED;
+        j->done = true;
+    }
+    jobs_.clear();
+    done_cond_.notify_all();
+
+    UVG_LOG_DEBUG("Stopping pacer");
+}
+
+uvgrtp::pacer::job *uvgrtp::pacer::next_job(std::chrono::steady_clock::time_point now)
+{
+    job *due = nullptr;
+    job *earliest = nullptr;
+    int due_priority = 0;
+
+    for (auto& j : jobs_) {
+        if (!earliest || j->due < earliest->due)
+            earliest = j;
+
+        if (j->due > now)
+            continue;
+
+        int priority = j->bucket->priority.load(std::memory_order_relaxed);
+
+        if (!due || priority > due_priority ||
+            (priority == due_priority && j->bucket->virtual_time < due->bucket->virtual_time)) {
+            due = j;
+            due_priority = priority;
+        }
+    }
+
+    // if nothing is due yet, wait for the first one
+    return due ? due : earliest;
+}
+
+bool uvgrtp::pacer::send_burst(job& j, std::chrono::steady_clock::time_point now, size_t& bytes)
+{
+    uvgrtp::pacing_bucket& bucket = *j.bucket;
+    uvgrtp::pkt_vec& packets = *j.packets;
+
+    bucket.tokens = std::min(bucket.depth,
+        bucket.tokens + std::chrono::duration<double>(now - bucket.last_fill).count() * bucket.rate);
+    bucket.last_fill = now;
+
+    // the packet that is due is always sent, the rest of the burst only if the bucket allows
+    size_t count = 0;
+    bytes = 0;
+    while (j.next + count < packets.size() && count < bucket.burst_packets) {
+        size_t size = packet_size(packets[j.next + count]);
+
+        if (count > 0 && bucket.tokens < (double)size)
+            break;
+
+        bucket.tokens -= (double)size;
+        bytes += size;
+        ++count;
+    }
+
+    rtp_error_t ret = RTP_OK;
+    if (count == 1) {
+        ret = j.socket->sendto(*j.addr, *j.addr6, packets[j.next], 0);
+    }
+    else {
+        bucket.burst.resize(count);
+        std::copy(packets.begin() + j.next, packets.begin() + j.next + count, bucket.burst.begin());
+        ret = j.socket->sendto(*j.addr, *j.addr6, bucket.burst, 0, *j.arrays);
+    }
+
+    if (ret != RTP_OK) {
+        UVG_LOG_ERROR("Failed to send paced packets");
+        j.result = RTP_SEND_ERROR;
+        return true;
+    }
+
+    j.next += count;
+    if (j.next == packets.size())
+        return true;
+
+    double missing = (double)packet_size(packets[j.next]) - bucket.tokens;
+    j.due = now;
+
+    if (missing > 0.0)
+        j.due += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::duration<double>(missing / bucket.rate));
+
+    return false;
+}
+
+void uvgrtp::pacer::wait_until(std::unique_lock<std::mutex>& lock,
+    std::chrono::steady_clock::time_point deadline, std::chrono::nanoseconds spin)
+{
+    std::chrono::steady_clock::time_point sleep_end = deadline - spin;
+
+    if (uvgrtp::clock::tsc::now() < sleep_end) {
+        cond_.wait_until(lock, sleep_end, [this] { return jobs_added_ || !active_; });
+
+        if (jobs_added_ || !active_)
+            return;
+    }
+
+    if (spin.count() <= 0)
+        return;
+
+    // the sleep is only accurate to the timer slack of the OS, so the rest is spun
+    lock.unlock();
+    while (uvgrtp::clock::tsc::now() < deadline) {
+        std::this_thread::yield();
+    }
+    lock.lock();
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include "socket.hh"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace uvgrtp {
+
+    class thread_settings;
+
+    /* Pacing settings and the token bucket of one stream, see RCE_PACE_FRAGMENT_SENDING.
+     * Only the pacer thread touches the bucket while a frame of the stream is being paced,
+     * except for the scheduling fields below */
+    struct pacing_bucket {
+        /* Bytes per second the bucket is filled with, set for each frame */
+        double rate = 0.0;
+
+        /* Bytes that may be sent right now. May go slightly negative when a packet
+         * is sent as soon as it is due */
+        double tokens = 0.0;
+
+        /* Size of the bucket, the largest burst that can be sent at once */
+        double depth = 0.0;
+
+        std::chrono::steady_clock::time_point last_fill;
+
+        /* Packets sent back-to-back with one system call, see RCC_PACING_BURST */
+        size_t burst_packets = 1;
+
+        /* The final part of each wait that is spun instead of slept, see RCC_PACING_SPIN */
+        std::chrono::nanoseconds spin = std::chrono::nanoseconds(0);
+
+        /* Packets of the current burst, kept here so that its capacity is reused */
+        uvgrtp::pkt_vec burst;
+
+        /* When the bursts of several streams are due, those of the highest priority are sent
+         * first and the rest share the pacer by weight, see RCC_SEND_PRIORITY and RCC_SEND_WEIGHT.
+         * The stream may change them while the pacer thread is sending its frame */
+        std::atomic<int> priority{ 0 };
+        std::atomic<size_t> weight{ 1 };
+
+        /* Start tag of the stream's next burst in the weighted fair queueing of the pacer,
+         * bytes sent divided by the weight. Guarded by the mutex of the pacer */
+        double virtual_time = 0.0;
+    };
+
+    /* Sends the packets of paced frames for all the streams of a context from one thread.
+     *
+     * Each stream has a token bucket that is filled at the rate needed to send the frame
+     * within the pacing window, so the packets leave at a constant rate instead of as one
+     * burst. Up to "burst_packets" packets are sent together if the bucket allows.
+     * Because the deadlines are absolute, the sleep and scheduling latencies do not add
+     * up over a frame. The pacer sleeps until the final "spin" nanoseconds of a wait and
+     * yields the processor in a loop for the rest, which trades CPU time for timing
+     * accuracy.
+     *
+     * When several streams are paced at once, the thread always sends the packets that
+     * are due first, so the streams are interleaved instead of queueing behind each other.
+     * If the bursts of several streams are due at the same time, the streams with the highest
+     * priority go first and the rest are served in weighted fair order: the stream with the
+     * smallest start tag, the bytes it has sent divided by its weight, sends the next burst.
+     * The thread is started when the first frame is paced. */
+    class pacer {
+        public:
+            pacer();
+            ~pacer();
+
+            /* Send "packets" to "addr" through the pacer thread within "window" and return when
+             * the last packet has been sent. "bucket" carries the stream's pacing state
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR if sending a packet failed */
+            rtp_error_t send(uvgrtp::pacing_bucket& bucket, std::shared_ptr<uvgrtp::socket> socket,
+                sockaddr_in& addr, sockaddr_in6& addr6, uvgrtp::pkt_vec& packets,
+                uvgrtp::send_arrays& arrays, std::chrono::nanoseconds window);
+
+            /* A frame given to the pacer thread */
+            struct job {
+                uvgrtp::pacing_bucket *bucket = nullptr;
+                std::shared_ptr<uvgrtp::socket> socket;
+                sockaddr_in *addr = nullptr;
+                sockaddr_in6 *addr6 = nullptr;
+                uvgrtp::pkt_vec *packets = nullptr;
+                uvgrtp::send_arrays *arrays = nullptr;
+
+                size_t next = 0;
+                std::chrono::steady_clock::time_point due;
+
+                rtp_error_t result = RTP_OK;
+                bool done = true;
+            };
+
+            /* Start sending "packets" like send() but return at once, so that the frames of several
+             * streams can be paced side by side. "j" and what it refers to must stay valid until
+             * wait() has returned for it */
+            void start(job& j, uvgrtp::pacing_bucket& bucket, std::shared_ptr<uvgrtp::socket> socket,
+                sockaddr_in& addr, sockaddr_in6& addr6, uvgrtp::pkt_vec& packets,
+                uvgrtp::send_arrays& arrays, std::chrono::nanoseconds window);
+
+            /* Wait until the frame of start() has been sent
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR if sending a packet failed */
+            rtp_error_t wait(job& j);
+
+            /* Configuration of the pacer thread if it has not been started yet */
+            void set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings);
+
+        private:
+
+            void runner();
+
+            /* Pick the job to send next at "now", see the class comment. Called with mutex_ held */
+            job *next_job(std::chrono::steady_clock::time_point now);
+
+            /* Send the next burst of "j" and compute when the following one is due. The size
+             * of the burst is written to "bytes". Called without mutex_ held
+             *
+             * Return true when the frame has been sent or sending has failed */
+            bool send_burst(job& j, std::chrono::steady_clock::time_point now, size_t& bytes);
+
+            /* Wait until "deadline", sleeping the part before the spin window. Return early
+             * if a frame has been added during the sleep. Called with "lock" held */
+            void wait_until(std::unique_lock<std::mutex>& lock,
+                std::chrono::steady_clock::time_point deadline, std::chrono::nanoseconds spin);
+
+            std::mutex mutex_;
+            std::condition_variable cond_;
+            std::condition_variable done_cond_;
+
+            std::vector<job *> jobs_;
+            bool jobs_added_;
+
+            /* Start tag of the last burst sent, the virtual time of the weighted fair queueing */
+            double virtual_time_;
+
+            bool active_;
+            std::unique_ptr<std::thread> thread_;
+            std::shared_ptr<uvgrtp::thread_settings> thread_settings_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
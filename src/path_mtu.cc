@@ -0,0 +1,119 @@
+#include "path_mtu.hh"
+
+#include "rtp.hh"
+#include "debug.hh"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+uvgrtp::path_mtu::path_mtu(const sockaddr_in& addr, const sockaddr_in6& addr6, bool ipv6, size_t max_mtu, size_t mtu) :
+    addr_(addr),
+    addr6_(addr6),
+    ipv6_(ipv6),
+    max_mtu_(max_mtu),
+    mtu_(mtu),
+    stale_(true),
+    next_query_(),
+    socket_(-1)
+{
+}
+
+uvgrtp::path_mtu::~path_mtu()
+{
+#ifdef __linux__
+    if (socket_ != -1)
+        ::close(socket_);
+#endif
+}
+
+rtp_error_t uvgrtp::path_mtu::start()
+{
+#if defined(__linux__) && defined(IP_MTU) && defined(IPV6_MTU)
+    if ((socket_ = ::socket(ipv6_ ? AF_INET6 : AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0) {
+        log_platform_error("socket() failed");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    if (query() == 0) {
+        ::close(socket_);
+        socket_ = -1;
+        return RTP_NOT_SUPPORTED;
+    }
+    return RTP_OK;
+#else
+    UVG_LOG_ERROR("The system does not report the path MTU of a destination");
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+size_t uvgrtp::path_mtu::query()
+{
+#if defined(__linux__) && defined(IP_MTU) && defined(IPV6_MTU)
+    /* A connected UDP socket caches its route, so it is connected again for the
+     * route that has the path MTU the system has learned since the last query */
+    int ret = ipv6_ ? ::connect(socket_, (const sockaddr *)&addr6_, sizeof(addr6_))
+                    : ::connect(socket_, (const sockaddr *)&addr_, sizeof(addr_));
+    if (ret < 0) {
+        log_platform_error("connect() failed");
+        return 0;
+    }
+
+    int mtu = 0;
+    socklen_t len = sizeof(mtu);
+
+    ret = ipv6_ ? ::getsockopt(socket_, IPPROTO_IPV6, IPV6_MTU, &mtu, &len)
+                : ::getsockopt(socket_, IPPROTO_IP, IP_MTU, &mtu, &len);
+    if (ret < 0 || mtu <= 0) {
+        log_platform_error("getsockopt() for the path MTU failed");
+        return 0;
+    }
+
+    size_t min_mtu = ipv6_ ? MIN_IPV6_PATH_MTU : MIN_IPV4_PATH_MTU;
+    return std::max(min_mtu, std::min((size_t)mtu, max_mtu_));
+#else
+    return 0;
+#endif
+}
+
+void uvgrtp::path_mtu::update(uvgrtp::rtp& rtp)
+{
+    uvgrtp::clock::coarse::coarse_t now = uvgrtp::clock::coarse::now();
+
+    if (!stale_.exchange(false) && now < next_query_)
+        return;
+
+    next_query_ = now + std::chrono::milliseconds(PATH_MTU_QUERY_INTERVAL_MS);
+
+    size_t mtu = query();
+    size_t old = mtu_;
+
+    // the payload must keep room for at least one byte
+    if (mtu == 0 || mtu == old || rtp.get_payload_size() + mtu <= old)
+        return;
+
+    rtp.set_payload_size(rtp.get_payload_size() + mtu - old);
+    mtu_ = mtu;
+
+    UVG_LOG_INFO("Path MTU changed from %zu to %zu bytes, payload size is now %zu bytes",
+        old, mtu, rtp.get_payload_size());
+}
+
+void uvgrtp::path_mtu::invalidate()
+{
+    stale_ = true;
+}
+
+size_t uvgrtp::path_mtu::mtu() const
+{
+    return mtu_;
+}
+
+void uvgrtp::path_mtu::set_mtu(size_t mtu)
+{
+    mtu_   = mtu;
+    stale_ = true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "uvgrtp/clock.hh"
+#include "uvgrtp/util.hh"
+
+#include <atomic>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <ws2def.h>
+#include <ws2ipdef.h>
+#else
+#include <netinet/in.h>
+#endif
+
+namespace uvgrtp {
+    class rtp;
+
+    /* How often the path MTU of the destination is read from the system */
+    constexpr int PATH_MTU_QUERY_INTERVAL_MS = 1000;
+
+    /* The smallest MTU that every IPv4 and IPv6 path must carry */
+    constexpr size_t MIN_IPV4_PATH_MTU = 576;
+    constexpr size_t MIN_IPV6_PATH_MTU = 1280;
+
+    /* Follows the path MTU of the destination of a stream, see RCC_PATH_MTU_DISCOVERY.
+     *
+     * The datagrams of the stream are sent with the Don't Fragment bit, so a router on a narrower
+     * path answers with ICMP "Fragmentation Needed" or "Packet Too Big" and the system lowers the
+     * path MTU it keeps for the destination. The path MTU is read with IP_MTU or IPV6_MTU from a
+     * socket connected to the destination, which sends nothing. The frame queue calls update() at
+     * the start of each frame, so the payload size of the stream only changes between frames */
+    class path_mtu {
+        public:
+            /* "max_mtu" is the largest MTU the payloads may grow to and "mtu" the MTU
+             * that the current payload size of the stream was computed from */
+            path_mtu(const sockaddr_in& addr, const sockaddr_in6& addr6, bool ipv6, size_t max_mtu, size_t mtu);
+            ~path_mtu();
+
+            path_mtu(const path_mtu&) = delete;
+            path_mtu& operator=(const path_mtu&) = delete;
+
+            /* Open the socket the path MTU is read from
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the system cannot report the path MTU */
+            rtp_error_t start();
+
+            /* Read the path MTU if it has not been read for PATH_MTU_QUERY_INTERVAL_MS or a send
+             * has failed since, and resize the payloads of "rtp" by the change of the MTU */
+            void update(uvgrtp::rtp& rtp);
+
+            /* Read the path MTU at the start of the next frame. Called when sending fails,
+             * which happens when a datagram is larger than the path MTU the system knows */
+            void invalidate();
+
+            /* The MTU that the payload size of the stream follows */
+            size_t mtu() const;
+
+            /* The application has set the MTU of the stream with RCC_MTU_SIZE */
+            void set_mtu(size_t mtu);
+
+        private:
+            /* Return the path MTU to the destination limited to the range of the stream, 0 on error */
+            size_t query();
+
+            sockaddr_in addr_;
+            sockaddr_in6 addr6_;
+            bool ipv6_;
+            size_t max_mtu_;
+
+            std::atomic<size_t> mtu_;
+            std::atomic<bool> stale_;
+            uvgrtp::clock::coarse::coarse_t next_query_;
+
+            // only opened on Linux, other systems do not report the path MTU of a destination
+            int socket_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
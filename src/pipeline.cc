@@ -0,0 +1,94 @@
+#include "pipeline.hh"
+
+#include "uvgrtp/frame.hh"
+#include "uvgrtp/rtcp.hh"
+
+#include "formats/h26x.hh"
+#include "formats/media.hh"
+#include "formats/raw_video.hh"
+#include "srtp/srtp.hh"
+#include "rtp.hh"
+
+rtp_error_t uvgrtp::stages::srtp_stage::process(rtp_error_t ret, int rce_flags, uint8_t *ptr, size_t size,
+    uvgrtp::frame::rtp_frame **out)
+{
+    if (ret != RTP_PKT_MODIFIED)
+        return ret;
+
+    return srtp->recv_packet_handler(srtp.get(), rce_flags, ptr, size, out);
+}
+
+rtp_error_t uvgrtp::stages::rtcp_stage::process(rtp_error_t ret, int rce_flags, uint8_t *ptr, size_t size,
+    uvgrtp::frame::rtp_frame **out)
+{
+    (void)ret;
+    return rtcp->recv_packet_handler_common(rtcp.get(), rce_flags, ptr, size, out);
+}
+
+template <typename... Stages>
+rtp_error_t uvgrtp::static_pipeline<Stages...>::process(int rce_flags, uint8_t *ptr, size_t size, uint64_t recv_time,
+    uvgrtp::frame::rtp_frame **out, bool& buffer_taken)
+{
+    rtp_error_t ret = rtp_->packet_handler(nullptr, rce_flags, ptr, size, out);
+
+    // in zero-copy mode the RTP handler hands the slot buffer over to the frame
+    buffer_taken = (ret == RTP_PKT_MODIFIED && *out && (*out)->dgram == ptr);
+
+    if (ret == RTP_PKT_MODIFIED && *out)
+        (*out)->recv_time = recv_time;
+
+    return run_stages(ret, rce_flags, ptr, size, out, std::index_sequence_for<Stages...>());
+}
+
+namespace {
+
+    /* Create the pipeline of "Media" with or without the SRTP and RTCP stages */
+    template <typename Media>
+    std::shared_ptr<uvgrtp::pipeline> make_media_pipeline(int rce_flags,
+        std::shared_ptr<uvgrtp::rtp> rtp, std::shared_ptr<uvgrtp::srtp> srtp, std::shared_ptr<uvgrtp::rtcp> rtcp,
+        Media *format, void *media_args)
+    {
+        using namespace uvgrtp::stages;
+
+        media_stage<Media> media = { format, media_args };
+        bool use_srtp = (rce_flags & RCE_SRTP) && srtp;
+        bool use_rtcp = (rce_flags & RCE_RTCP) && rtcp;
+
+        if (use_srtp && use_rtcp) {
+            return std::make_shared<uvgrtp::static_pipeline<srtp_stage, rtcp_stage, media_stage<Media>>>(
+                rtp, srtp_stage{ srtp }, rtcp_stage{ rtcp }, media);
+        }
+        if (use_srtp) {
+            return std::make_shared<uvgrtp::static_pipeline<srtp_stage, media_stage<Media>>>(
+                rtp, srtp_stage{ srtp }, media);
+        }
+        if (use_rtcp) {
+            return std::make_shared<uvgrtp::static_pipeline<rtcp_stage, media_stage<Media>>>(
+                rtp, rtcp_stage{ rtcp }, media);
+        }
+        return std::make_shared<uvgrtp::static_pipeline<media_stage<Media>>>(rtp, media);
+    }
+}
+
+std::shared_ptr<uvgrtp::pipeline> uvgrtp::make_pipeline(int rce_flags, rtp_format_t fmt,
+    std::shared_ptr<uvgrtp::rtp> rtp, std::shared_ptr<uvgrtp::srtp> srtp, std::shared_ptr<uvgrtp::rtcp> rtcp,
+    uvgrtp::formats::media *media, void *media_args)
+{
+    if (!rtp || !media)
+        return nullptr;
+
+    switch (fmt) {
+        case RTP_FORMAT_H264:
+        case RTP_FORMAT_H265:
+        case RTP_FORMAT_H266:
+            return make_media_pipeline(rce_flags, rtp, srtp, rtcp,
+                static_cast<uvgrtp::formats::h26x *>(media), media_args);
+
+        case RTP_FORMAT_RAW_VIDEO:
+            return make_media_pipeline(rce_flags, rtp, srtp, rtcp,
+                static_cast<uvgrtp::formats::raw_video *>(media), media_args);
+
+        default:
+            return make_media_pipeline(rce_flags, rtp, srtp, rtcp, media, media_args);
+    }
+}
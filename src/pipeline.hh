@@ -0,0 +1,139 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+
+namespace uvgrtp {
+
+    namespace frame {
+        struct rtp_frame;
+    }
+
+    namespace formats {
+        class media;
+        class h26x;
+    }
+
+    class rtp;
+    class srtp;
+    class rtcp;
+
+    /* The processing of the received RTP packets of one stream.
+     *
+     * Without a pipeline, the reception flow calls the RTP, SRTP, RTCP and media handlers of
+     * the stream one after the other through std::function and checks the RCE flags for each
+     * packet. A pipeline is built once for the flags and the format of the stream, so the
+     * stages are known at compile time and a packet costs one virtual call */
+    class pipeline {
+        public:
+            virtual ~pipeline() {}
+
+            /* Process the RTP packet "ptr" of "size" bytes that was received at "recv_time",
+             * see uvgrtp::frame::rtp_frame::recv_time
+             *
+             * "buffer_taken" is set if the frame written to "out" took over the buffer of the packet
+             *
+             * Return what the last handler of the stream returned, see reception_flow */
+            virtual rtp_error_t process(int rce_flags, uint8_t *ptr, size_t size, uint64_t recv_time,
+                uvgrtp::frame::rtp_frame **out, bool& buffer_taken) = 0;
+
+            /* Take the next complete frame after process() returned RTP_MULTIPLE_PKTS_READY
+             *
+             * Return RTP_PKT_READY if "out" contains a frame
+             * Return RTP_NOT_FOUND if there are no more frames */
+            virtual rtp_error_t next_frame(uvgrtp::frame::rtp_frame **out) = 0;
+    };
+
+    namespace stages {
+
+        /* The stages are given what the previous stage returned and return what the stream
+         * returns if they are last, so each stage decides itself whether it runs */
+
+        /* Decrypt and authenticate the packet, RCE_SRTP */
+        struct srtp_stage {
+            std::shared_ptr<uvgrtp::srtp> srtp;
+
+            rtp_error_t process(rtp_error_t ret, int rce_flags, uint8_t *ptr, size_t size, uvgrtp::frame::rtp_frame **out);
+        };
+
+        /* Update the reception statistics of the source, RCE_RTCP */
+        struct rtcp_stage {
+            std::shared_ptr<uvgrtp::rtcp> rtcp;
+
+            rtp_error_t process(rtp_error_t ret, int rce_flags, uint8_t *ptr, size_t size, uvgrtp::frame::rtp_frame **out);
+        };
+
+        /* Depacketize the frame with the format "F", the packet_handler() of which is called directly */
+        template <typename F>
+        struct media_stage {
+            F *format;
+            void *args;
+
+            rtp_error_t process(rtp_error_t ret, int rce_flags, uint8_t *ptr, size_t size, uvgrtp::frame::rtp_frame **out)
+            {
+                if ((ret != RTP_PKT_MODIFIED && ret != RTP_PKT_NOT_HANDLED) || !*out)
+                    return ret;
+
+                return format->packet_handler(args, rce_flags, ptr, size, out);
+            }
+
+            rtp_error_t next_frame(uvgrtp::frame::rtp_frame **out)
+            {
+                if constexpr (std::is_base_of<uvgrtp::formats::h26x, F>::value) {
+                    return format->frame_getter(out);
+                } else {
+                    (void)out;
+                    return RTP_NOT_FOUND;
+                }
+            }
+        };
+    }
+
+    /* A pipeline of the RTP header validation followed by "Stages", the last of which is a media_stage */
+    template <typename... Stages>
+    class static_pipeline : public pipeline {
+        public:
+            static_pipeline(std::shared_ptr<uvgrtp::rtp> rtp, Stages... stages) :
+                rtp_(rtp),
+                stages_(stages...)
+            {
+            }
+
+            virtual rtp_error_t process(int rce_flags, uint8_t *ptr, size_t size, uint64_t recv_time,
+                uvgrtp::frame::rtp_frame **out, bool& buffer_taken);
+
+            virtual rtp_error_t next_frame(uvgrtp::frame::rtp_frame **out)
+            {
+                return std::get<sizeof...(Stages) - 1>(stages_).next_frame(out);
+            }
+
+        private:
+            template <size_t... I>
+            rtp_error_t run_stages(rtp_error_t ret, int rce_flags, uint8_t *ptr, size_t size,
+                uvgrtp::frame::rtp_frame **out, std::index_sequence<I...>)
+            {
+                // the stages are called in order and each is given the result of the one before it
+                ((ret = std::get<I>(stages_).process(ret, rce_flags, ptr, size, out)), ...);
+                return ret;
+            }
+
+            std::shared_ptr<uvgrtp::rtp> rtp_;
+            std::tuple<Stages...> stages_;
+    };
+
+    /* Build the pipeline of a stream with the flags "rce_flags", the format "fmt" and the
+     * components of the stream. "media_args" is what the media handler of the format is given
+     *
+     * Return nullptr if there is no pipeline for the combination, in which case the handlers
+     * of the stream are called one by one */
+    std::shared_ptr<uvgrtp::pipeline> make_pipeline(int rce_flags, rtp_format_t fmt,
+        std::shared_ptr<uvgrtp::rtp> rtp, std::shared_ptr<uvgrtp::srtp> srtp, std::shared_ptr<uvgrtp::rtcp> rtcp,
+        uvgrtp::formats::media *media, void *media_args);
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -1,16 +1,29 @@
 #include "reception_flow.hh"
 
 #include "uvgrtp/util.hh"
+#include "uvgrtp/clock.hh"
 #include "uvgrtp/frame.hh"
 
+#include "capture.hh"
 #include "socket.hh"
+#include "io_engine.hh"
+#include "frame_pool.hh"
+#include "stream_metrics.hh"
+#include "forwarder.hh"
+#include "recorder.hh"
+#include "reorder_buffer.hh"
+#include "redundancy_merge.hh"
+#include "trace.hh"
 #include "debug.hh"
 #include "random.hh"
+#include "threads.hh"
 #include "uvgrtp/rtcp.hh"
 
 #include "global.hh"
+#include "header_extensions.hh"
 
 #include <chrono>
+#include <algorithm>
 
 #ifndef _WIN32
 #include <errno.h>
@@ -30,82 +43,204 @@
 
 constexpr size_t DEFAULT_INITIAL_BUFFER_SIZE = 4194304;
 
+/* Fill level of the ring in percent that counts as the processing falling behind */
+constexpr int DEFAULT_RING_WATERMARK = 75;
+
+/* The kernel coalesces at most 64 datagrams into one UDP GRO buffer
+ * and the coalesced buffer can be as large as the largest UDP datagram */
+constexpr size_t GRO_MAX_SEGMENTS = 64;
+constexpr size_t GRO_MAX_SIZE     = 65535;
+
+/* How many times the processing thread checks the ring for new packets before it
+ * goes to sleep. The limit adapts between these values depending on whether
+ * spinning has recently found new packets */
+constexpr int MIN_SPIN_COUNT = 16;
+constexpr int MAX_SPIN_COUNT = 4096;
+
+/* How many times the receiver yields waiting for room in a full ring before it starts to sleep
+ * between the checks. A real-time receiver that only yields would keep a processor of lower
+ * priority from running on the same core */
+constexpr int RING_FULL_SPIN_COUNT = 64;
+constexpr auto RING_FULL_SLEEP     = std::chrono::microseconds(50);
+
+/* Most SRTP packets collected before they are given to the batch handler */
+constexpr size_t MAX_SRTP_BATCH_SIZE = 256;
+
+/* Most complete frames collected while processing packets before they are returned */
+constexpr size_t MAX_READY_FRAMES = 64;
+
 uvgrtp::reception_flow::reception_flow(bool ipv6) :
-    frames_({}),
-    hooks_({}),
+    frames_(),
     should_stop_(true),
     receiver_(nullptr),
     user_hook_arg_(nullptr),
     user_hook_(nullptr),
     packet_handlers_({}),
+    demux_(),
+    has_priorities_(false),
+    has_profiling_(false),
+    groups_(),
+    group_demux_(),
+    has_groups_(false),
+    mids_(),
+    mid_routes_(std::make_shared<const std::vector<mid_route>>()),
+    has_mids_(false),
+    shards_(),
+    lead_(nullptr),
+    core_(-1),
+    srtp_batch_(),
+    srtp_results_(),
+    srtp_batch_handlers_(nullptr),
+    forwarding_(),
+    forward_held_(0),
+    headers_(),
+    header_ring_(nullptr),
+    header_slots_(),
+    header_packets_(),
+    header_sizes_(),
+    header_next_(0),
+    ready_frames_(),
+    ready_handlers_(),
     poll_timeout_ms_(100),
-    ring_buffer_(),
-    ring_read_index_(-1), // invalid first index that will increase to a valid one
-    last_ring_write_index_(-1),
+    recv_batch_size_(1),
+    inline_processing_(false),
+    io_engine_(nullptr),
+    thread_settings_(nullptr),
+    engine_driven_(false),
+    zero_copy_(false),
+    write_ring_(nullptr),
+    read_ring_(nullptr),
+    grown_ring_(nullptr),
+    ring_slots_(0),
+    processor_parked_(false),
     socket_(),
+    rce_flags_(0),
     buffer_size_kbytes_(DEFAULT_INITIAL_BUFFER_SIZE),
     payload_size_(MAX_IPV4_PAYLOAD),
+    max_buffer_size_(0),
+    ring_watermark_(DEFAULT_RING_WATERMARK),
+    above_watermark_(false),
+    resize_requested_(false),
     active_(false),
-    ipv6_(ipv6)
+    ipv6_(ipv6),
+    gro_(false),
+    replay_job_(nullptr),
+    replay_pending_(false),
+    ring_full_events_(0),
+    ring_watermark_events_(0),
+    ring_resizes_(0)
 {
     create_ring_buffer();
 }
 
 uvgrtp::reception_flow::~reception_flow()
 {
-    hooks_.clear();
     destroy_ring_buffer();
     clear_frames();
 }
 
 void uvgrtp::reception_flow::clear_frames()
 {
-    frames_mtx_.lock();
-    for (auto& frame : frames_)
-    {
-        (void)uvgrtp::frame::dealloc_frame(frame);
-    }
-
     frames_.clear();
-    frames_mtx_.unlock();
 }
 
-void uvgrtp::reception_flow::create_ring_buffer()
+uvgrtp::reception_flow::ring* uvgrtp::reception_flow::create_ring(size_t elements)
 {
-    destroy_ring_buffer();
-    size_t elements = buffer_size_kbytes_ / payload_size_;
+    ring* r = new ring();
 
-    for (size_t i = 0; i < elements; ++i)
+    // every slot may turn into a received frame, so let the frame pool keep as many around
+    uvgrtp::frame_pool::reserve(elements, payload_size_);
+
+    // in zero-copy mode the frames take the slot buffers with them, so each is allocated separately
+    if (zero_copy_)
     {
-        uint8_t* data = new uint8_t[payload_size_];
-        if (data)
-        {
-            ring_buffer_.push_back({ data, 0});
-        }
-        else
+        for (size_t i = 0; i < elements; ++i)
         {
-            UVG_LOG_ERROR("Failed to allocate memory for ring buffer");
+            r->slots.push_back({ uvgrtp::frame_pool::alloc_payload(payload_size_), 0, 0, {} });
         }
+        return r;
+    }
+
+    // the slots are not touched here, so that their pages are placed on the NUMA node of the receiver thread
+    r->slot_size = uvgrtp::align_up(payload_size_, uvgrtp::CACHE_LINE_SIZE);
+
+    uint8_t* memory = r->memory.allocate(elements * r->slot_size);
+    if (!memory)
+    {
+        UVG_LOG_ERROR("Failed to allocate a ring buffer of %zu slots", elements);
+        return r;
+    }
+
+    for (size_t i = 0; i < elements; ++i)
+    {
+        r->slots.push_back({ memory + i * r->slot_size, 0, 0, {} });
     }
+    return r;
 }
 
-void uvgrtp::reception_flow::destroy_ring_buffer()
+void uvgrtp::reception_flow::destroy_ring(ring* r)
 {
-    for (size_t i = 0; i < ring_buffer_.size(); ++i)
+    if (zero_copy_)
     {
-        if (ring_buffer_.at(i).data)
+        for (auto& slot : r->slots)
         {
-            delete[] ring_buffer_.at(i).data;
+            uvgrtp::frame_pool::free_payload(slot.data);
         }
     }
-    ring_buffer_.clear();
+
+    delete r;
+}
+
+void uvgrtp::reception_flow::create_ring_buffer()
+{
+    destroy_ring_buffer();
+
+    write_ring_ = read_ring_ = create_ring(buffer_size_kbytes_ / payload_size_);
+    ring_slots_ = write_ring_->slots.size();
+}
+
+void uvgrtp::reception_flow::destroy_ring_buffer()
+{
+    // the processor may not have followed the receiver to its newest rings yet
+    for (ring* r = read_ring_; r != nullptr; ) {
+        ring* next = r->next;
+        destroy_ring(r);
+        r = next;
+    }
+
+    if (ring* grown = grown_ring_.exchange(nullptr))
+        destroy_ring(grown);
+
+    write_ring_ = read_ring_ = nullptr;
+    above_watermark_ = false;
+}
+
+void uvgrtp::reception_flow::reset_ring_buffer()
+{
+    while (read_ring_ != write_ring_) {
+        ring* next = read_ring_->next;
+        destroy_ring(read_ring_);
+        read_ring_ = next;
+    }
+
+    for (auto& slot : write_ring_->slots) {
+        slot.read = 0;
+    }
+
+    write_ring_->read_index  = -1;
+    write_ring_->write_index = -1;
+    write_ring_->next        = nullptr;
+    above_watermark_         = false;
 }
 
 void uvgrtp::reception_flow::set_buffer_size(const ssize_t& value)
 {
-    std::lock_guard<std::mutex> lg(ring_mutex_);
-    buffer_size_kbytes_ = value;
-    create_ring_buffer();
+    // the ring has a fixed capacity while the threads are running, so they are restarted
+    resize_ring_buffer(value, payload_size_);
+
+    for (auto& shard : shards_) {
+        shard.flow->set_buffer_size(value);
+    }
 }
 
 ssize_t uvgrtp::reception_flow::get_buffer_size() const
@@ -113,15 +248,74 @@ ssize_t uvgrtp::reception_flow::get_buffer_size() const
     return buffer_size_kbytes_;
 }
 
+void uvgrtp::reception_flow::set_max_buffer_size(const ssize_t& value)
+{
+    for (auto& shard : shards_) {
+        shard.flow->set_max_buffer_size(value);
+    }
+
+    // the resizer thread is created in start(), so the threads are restarted
+    bool restart = active_;
+
+    if (restart)
+        stop();
+
+    max_buffer_size_ = value;
+
+    if (restart)
+        start(socket_, rce_flags_);
+}
+
+ssize_t uvgrtp::reception_flow::get_max_buffer_size() const
+{
+    return max_buffer_size_;
+}
+
+void uvgrtp::reception_flow::set_ring_watermark(int percent)
+{
+    ring_watermark_ = percent;
+
+    for (auto& shard : shards_) {
+        shard.flow->set_ring_watermark(percent);
+    }
+}
+
+int uvgrtp::reception_flow::get_ring_watermark() const
+{
+    return ring_watermark_;
+}
+
 void uvgrtp::reception_flow::set_payload_size(const size_t& value)
 {
-    payload_size_ = value;
+    resize_ring_buffer(buffer_size_kbytes_, value);
+
+    for (auto& shard : shards_) {
+        shard.flow->set_payload_size(value);
+    }
+}
+
+void uvgrtp::reception_flow::resize_ring_buffer(ssize_t buffer_size, size_t payload_size)
+{
+    bool restart = active_;
+
+    if (restart)
+        stop();
+
+    buffer_size_kbytes_ = buffer_size;
+    payload_size_       = payload_size;
     create_ring_buffer();
+
+    if (restart)
+        start(socket_, rce_flags_);
 }
 
 void uvgrtp::reception_flow::set_poll_timeout_ms(int timeout_ms)
 {
     poll_timeout_ms_ = timeout_ms;
+
+    for (auto& shard : shards_) {
+        shard.flow->set_poll_timeout_ms(timeout_ms);
+    }
 }
 
 int uvgrtp::reception_flow::get_poll_timeout_ms()
@@ -129,6 +323,178 @@ int uvgrtp::reception_flow::get_poll_timeout_ms()
     return poll_timeout_ms_;
 }
 
+rtp_error_t uvgrtp::reception_flow::set_recv_batch_size(int batch_size)
+{
+    if (batch_size <= 0 || batch_size > MAX_RECV_BATCH_SIZE) {
+        UVG_LOG_ERROR("Receive batch size must be between 1 and %d", MAX_RECV_BATCH_SIZE);
+        return RTP_INVALID_VALUE;
+    }
+
+    recv_batch_size_ = batch_size;
+
+    for (auto& shard : shards_) {
+        (void)shard.flow->set_recv_batch_size(batch_size);
+    }
+    return RTP_OK;
+}
+
+int uvgrtp::reception_flow::get_recv_batch_size() const
+{
+    return recv_batch_size_;
+}
+
+void uvgrtp::reception_flow::set_inline_processing(bool enabled)
+{
+    for (auto& shard : shards_) {
+        shard.flow->set_inline_processing(enabled);
+    }
+
+    if (inline_processing_ == enabled)
+        return;
+
+    // the threads are created in start(), so they are restarted for the new mode to take effect
+    bool restart = active_;
+
+    if (restart)
+        stop();
+
+    inline_processing_ = enabled;
+    reset_ring_buffer();
+
+    if (restart)
+        start(socket_, rce_flags_);
+}
+
+bool uvgrtp::reception_flow::get_inline_processing() const
+{
+    return inline_processing_;
+}
+
+void uvgrtp::reception_flow::set_io_engine(std::shared_ptr<uvgrtp::io_engine> engine)
+{
+    io_engine_ = engine;
+}
+
+void uvgrtp::reception_flow::set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings)
+{
+    thread_settings_ = settings;
+}
+
+void uvgrtp::reception_flow::set_core(int core)
+{
+    core_ = core;
+}
+
+void uvgrtp::reception_flow::add_shard(std::shared_ptr<uvgrtp::socket> socket, int core)
+{
+    std::unique_ptr<reception_flow> flow(new reception_flow(ipv6_));
+
+    flow->lead_               = this;
+    flow->core_               = core;
+    flow->io_engine_          = io_engine_;
+    flow->thread_settings_    = thread_settings_;
+    flow->poll_timeout_ms_    = poll_timeout_ms_;
+    flow->recv_batch_size_    = recv_batch_size_;
+    flow->inline_processing_  = inline_processing_;
+    flow->buffer_size_kbytes_ = buffer_size_kbytes_;
+    flow->payload_size_       = payload_size_;
+    flow->max_buffer_size_    = max_buffer_size_;
+    flow->ring_watermark_     = ring_watermark_;
+    flow->create_ring_buffer();
+
+    {
+        std::lock_guard<std::mutex> lg(handlers_mutex_);
+        flow->demux_.publish(packet_handlers_);
+    }
+    {
+        std::lock_guard<std::mutex> lg(handlers_mutex_);
+        publish_groups();
+        publish_mids();
+    }
+
+    std::lock_guard<std::mutex> lg(active_mutex_);
+    if (active_) {
+        (void)flow->start(socket, rce_flags_);
+    }
+    shards_.push_back({ std::move(flow), socket });
+}
+
+rtp_error_t uvgrtp::reception_flow::add_receive_path(std::shared_ptr<uvgrtp::socket> socket)
+{
+    std::lock_guard<std::mutex> lg(active_mutex_);
+
+    // the copies of a packet must be read by the thread that reads the socket of the flow
+    if (engine_driven_ || !shards_.empty()) {
+        UVG_LOG_ERROR("Receive paths are not supported with the I/O engine or receive shards");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    std::vector<std::shared_ptr<uvgrtp::socket>> paths;
+    if (receive_paths_)
+        paths = *receive_paths_;
+
+    if (paths.size() == MAX_RECEIVE_PATHS) {
+        UVG_LOG_ERROR("A socket can have at most %zu receive paths", MAX_RECEIVE_PATHS);
+        return RTP_INVALID_VALUE;
+    }
+
+    paths.push_back(socket);
+    std::atomic_store(&receive_paths_,
+        std::shared_ptr<const std::vector<std::shared_ptr<uvgrtp::socket>>>(
+            std::make_shared<const std::vector<std::shared_ptr<uvgrtp::socket>>>(std::move(paths))));
+    return RTP_OK;
+}
+
+void uvgrtp::reception_flow::remove_receive_path(std::shared_ptr<uvgrtp::socket> socket)
+{
+    std::lock_guard<std::mutex> lg(active_mutex_);
+
+    if (!receive_paths_)
+        return;
+
+    std::vector<std::shared_ptr<uvgrtp::socket>> paths;
+    for (auto& path : *receive_paths_) {
+        if (path != socket)
+            paths.push_back(path);
+    }
+
+    std::atomic_store(&receive_paths_, paths.empty() ? nullptr :
+        std::shared_ptr<const std::vector<std::shared_ptr<uvgrtp::socket>>>(
+            std::make_shared<const std::vector<std::shared_ptr<uvgrtp::socket>>>(std::move(paths))));
+}
+
+std::vector<std::shared_ptr<uvgrtp::socket>> uvgrtp::reception_flow::get_shard_sockets()
+{
+    std::lock_guard<std::mutex> lg(active_mutex_);
+
+    std::vector<std::shared_ptr<uvgrtp::socket>> sockets;
+    for (auto& shard : shards_)
+        sockets.push_back(shard.socket);
+
+    return sockets;
+}
+
+void uvgrtp::reception_flow::publish_handlers()
+{
+    bool priorities = false;
+    bool profiling = false;
+    for (auto& entry : packet_handlers_) {
+        entry.second.remote_ssrc = entry.first;
+        priorities = priorities || entry.second.priority > 0;
+        profiling = profiling || (entry.second.metrics && entry.second.metrics->profile_interval() > 0);
+    }
+
+    demux_.publish(packet_handlers_);
+    has_priorities_ = priorities;
+    has_profiling_ = profiling;
+
+    for (auto& shard : shards_) {
+        shard.flow->demux_.publish(packet_handlers_);
+        shard.flow->has_priorities_ = priorities;
+        shard.flow->has_profiling_ = profiling;
+    }
+}
+
 rtp_error_t uvgrtp::reception_flow::start(std::shared_ptr<uvgrtp::socket> socket, int rce_flags)
 {
     std::lock_guard<std::mutex> lg(active_mutex_);
@@ -136,24 +502,68 @@ rtp_error_t uvgrtp::reception_flow::start(std::shared_ptr<uvgrtp::socket> socket
         return RTP_OK;
     }
     should_stop_ = false;
+    socket_      = socket;
+    rce_flags_   = rce_flags;
+
+    for (auto& shard : shards_) {
+        (void)shard.flow->start(shard.socket, rce_flags);
+    }
+
+    if ((rce_flags & RCE_RECEIVE_ZERO_COPY) && !zero_copy_) {
+        destroy_ring_buffer();
+        zero_copy_ = true;
+        create_ring_buffer();
+    }
+
+    if ((rce_flags & RCE_UDP_GRO) && zero_copy_) {
+        UVG_LOG_WARN("UDP GRO cannot be used with zero-copy receive, not enabling it");
+    } else if (rce_flags & RCE_UDP_GRO) {
+        size_t gro_slots = std::max(GRO_MAX_SEGMENTS, GRO_MAX_SIZE / payload_size_ + 1);
+
+        if (write_ring_->slots.size() < 2 * gro_slots) {
+            UVG_LOG_WARN("Reception ring buffer is too small for UDP GRO, not enabling it");
+        } else if (socket->enable_gro() != RTP_OK) {
+            UVG_LOG_WARN("UDP GRO is not supported by the system, receiving datagrams one by one");
+        } else {
+            gro_ = true;
+        }
+    }
+
+    // the datagrams dropped by the kernel are counted from the control messages of the received ones
+    if (socket->enable_drop_counting() != RTP_OK) {
+        UVG_LOG_DEBUG("The system does not count the datagrams dropped from the socket");
+    }
+
+    if (max_buffer_size_ > 0 && (size_t)max_buffer_size_ / payload_size_ > ring_slots_) {
+        resize_requested_ = false;
+        resizer_ = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::reception_flow::resizer, this));
+    }
+
+    // if the context has an I/O engine, its event loops read and process the packets of this socket.
+    // The engine polls only the socket itself, so a socket with the memory transport or receive paths
+    // keeps its own threads
+    if (io_engine_ && io_engine_->is_active() && socket->memory_wake_fd() < 0 && !receive_paths_) {
+        if (io_engine_->add_flow((int)socket->get_raw_socket(), this) == RTP_OK) {
+            engine_driven_ = true;
+            active_        = true;
+            return RTP_OK;
+        }
+        UVG_LOG_WARN("Failed to add the socket to the I/O engine, using own reception threads");
+    }
 
     UVG_LOG_DEBUG("Creating receiving threads and setting priorities");
-    processor_ = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::reception_flow::process_packet, this, rce_flags));
-    receiver_ = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::reception_flow::receiver, this, socket));
-
-    // set receiver thread priority to maximum
-#ifndef WIN32
-    struct sched_param params;
-    params.sched_priority = sched_get_priority_max(SCHED_FIFO);
-    pthread_setschedparam(receiver_->native_handle(), SCHED_FIFO, &params);
-    params.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
-    pthread_setschedparam(processor_->native_handle(), SCHED_FIFO, &params);
-#else
 
-    SetThreadPriority(receiver_->native_handle(), REALTIME_PRIORITY_CLASS);
-    SetThreadPriority(processor_->native_handle(), ABOVE_NORMAL_PRIORITY_CLASS);
+    stop_event_.reset();
+
+    // in inline mode the receiver thread processes the packets itself. The threads of
+    // a shard stay on the core that handles the packets of its SSRCs
+    if (!inline_processing_) {
+        processor_ = uvgrtp::start_thread(thread_settings_, RTP_THREAD_PROCESSOR, core_,
+            &uvgrtp::reception_flow::process_packet, this, rce_flags);
+    }
+    receiver_ = uvgrtp::start_thread(thread_settings_, RTP_THREAD_RECEIVER, core_,
+        &uvgrtp::reception_flow::receiver, this, socket, rce_flags);
 
-#endif
     active_ = true;
     return RTP_ERROR::RTP_OK;
 }
@@ -165,10 +575,35 @@ rtp_error_t uvgrtp::reception_flow::stop()
         return RTP_OK;
     }
     should_stop_ = true;
-    process_cond_.notify_all();
+
+    for (auto& shard : shards_) {
+        (void)shard.flow->stop();
+    }
+
+    if (engine_driven_) {
+        (void)io_engine_->remove_flow((int)socket_->get_raw_socket());
+        engine_driven_ = false;
+    }
+
+    {
+        std::lock_guard<std::mutex> wlg(wait_mtx_);
+        process_cond_.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> rlg(resize_mtx_);
+        resize_cond_.notify_all();
+    }
+
+    if (resizer_ != nullptr && resizer_->joinable())
+    {
+        resizer_->join();
+    }
+    resizer_ = nullptr;
 
     if (receiver_ != nullptr && receiver_->joinable())
     {
+        stop_event_.signal();
         receiver_->join();
     }
 
@@ -176,69 +611,128 @@ rtp_error_t uvgrtp::reception_flow::stop()
     {
         processor_->join();
     }
+    processor_ = nullptr;
+
+    // a replay that the receiver did not get to is not run, release its caller
+    {
+        std::lock_guard<std::mutex> rlg(replay_mtx_);
+        if (replay_job_) {
+            replay_job_->result = RTP_INTERRUPTED;
+            replay_job_->done   = true;
+            replay_job_         = nullptr;
+        }
+        replay_pending_ = false;
+        replay_cond_.notify_all();
+    }
 
     clear_frames();
     active_ = false;
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::reception_flow::install_receive_hook(
-    void *arg,
-    void (*hook)(void *, uvgrtp::frame::rtp_frame *),
-    uint32_t remote_ssrc
-)
+rtp_error_t uvgrtp::reception_flow::install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame *)> hook,
+    uint32_t remote_ssrc)
+{
+    return install_receive_hook(hook, remote_ssrc, true);
+}
+
+rtp_error_t uvgrtp::reception_flow::install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame *)> hook,
+    uint32_t remote_ssrc, bool replace)
 {
-    std::lock_guard<std::mutex> lg(hooks_mutex_);
     if (!hook)
         return RTP_INVALID_VALUE;
 
-    receive_pkt_hook new_hook = { arg, hook };
-    hooks_[remote_ssrc] = new_hook;
+    std::lock_guard<std::mutex> lg(handlers_mutex_);
+
+    if (!replace) {
+        auto it = packet_handlers_.find(remote_ssrc);
+
+        if (it != packet_handlers_.end() && (it->second.hook.frame || it->second.hook.batch))
+            return RTP_INVALID_VALUE;
+    }
+
+    packet_handlers_[remote_ssrc].hook = { hook, nullptr };
+    publish_handlers();
 
     return RTP_OK;
 }
 
-uvgrtp::frame::rtp_frame *uvgrtp::reception_flow::pull_frame()
+rtp_error_t uvgrtp::reception_flow::install_receive_batch_hook(std::function<void(uvgrtp::frame::rtp_frame **, size_t)> hook,
+    uint32_t remote_ssrc)
+{
+    if (!hook)
+        return RTP_INVALID_VALUE;
+
+    std::lock_guard<std::mutex> lg(handlers_mutex_);
+    packet_handlers_[remote_ssrc].hook = { nullptr, hook };
+    publish_handlers();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::reception_flow::replay(uvgrtp::capture_reader& reader, uint16_t port, double speed)
 {
-    while (frames_.empty() && !should_stop_)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        std::lock_guard<std::mutex> lg(active_mutex_);
+        if (!active_)
+            return RTP_NOT_INITIALIZED;
+
+        if (engine_driven_)
+            return RTP_NOT_SUPPORTED;
     }
 
+    replay_job job = { &reader, port, speed, RTP_OK, false };
+
+    // the rings have one writer, so the replay is given to the receiver thread, one at a time
+    std::unique_lock<std::mutex> lk(replay_mtx_);
+    replay_cond_.wait(lk, [this] {
+        return replay_job_ == nullptr || should_stop_;
+    });
+
     if (should_stop_)
-        return nullptr;
+        return RTP_INTERRUPTED;
+
+    replay_job_     = &job;
+    replay_pending_ = true;
+
+    replay_cond_.wait(lk, [&job] {
+        return job.done;
+    });
+    return job.result;
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::reception_flow::pull_frame()
+{
     uvgrtp::frame::rtp_frame* frame = nullptr;
-    frames_mtx_.lock();
-    if (!frames_.empty()) {
-        frame = frames_.front();
-        frames_.erase(frames_.begin());
+
+    while (!(frame = frames_.pop()) && !should_stop_)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
     }
-    frames_mtx_.unlock();
 
+    if (should_stop_ && frame) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        return nullptr;
+    }
     return frame;
 }
 
 uvgrtp::frame::rtp_frame *uvgrtp::reception_flow::pull_frame(ssize_t timeout_ms)
 {
     auto start_time = std::chrono::high_resolution_clock::now();
+    uvgrtp::frame::rtp_frame* frame = nullptr;
 
-    while (frames_.empty() && 
+    while (!(frame = frames_.pop()) &&
         !should_stop_ &&
         timeout_ms > std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count())
     {
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
 
-    if (should_stop_ || frames_.empty())
+    if (should_stop_ && frame) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
         return nullptr;
-    uvgrtp::frame::rtp_frame* frame = nullptr;
-    frames_mtx_.lock();
-    if (!frames_.empty()) {
-        frame = frames_.front();
-        frames_.pop_front();
     }
-    frames_mtx_.unlock();
-
     return frame;
 }
 
@@ -252,20 +746,8 @@ uvgrtp::frame::rtp_frame* uvgrtp::reception_flow::pull_frame(std::shared_ptr<std
     if (should_stop_)
         return nullptr;
 
-    // Check if the source ssrc in the frame matches the remote ssrc that we want to pull frames from
-    uvgrtp::frame::rtp_frame* frame = nullptr;
-    frames_mtx_.lock();
-    if (!frames_.empty()) {
-        frame = frames_.front();
-        if ( frame && frame->header.ssrc == remote_ssrc.get()->load()) {
-            frames_.erase(frames_.begin());
-        }
-        else {
-            frame = nullptr;
-        }
-    }
-    frames_mtx_.unlock();
-    return frame;
+    // Only take the frame if the source ssrc in the frame matches the remote ssrc that we want to pull frames from
+    return frames_.pop(remote_ssrc.get());
 }
 
 uvgrtp::frame::rtp_frame* uvgrtp::reception_flow::pull_frame(ssize_t timeout_ms, std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc)
@@ -281,31 +763,48 @@ uvgrtp::frame::rtp_frame* uvgrtp::reception_flow::pull_frame(ssize_t timeout_ms,
 
     if (should_stop_ || frames_.empty())
         return nullptr;
-    // Check if the source ssrc in the frame matches the remote ssrc that we want to pull frames from
-    uvgrtp::frame::rtp_frame* frame = nullptr;
-    frames_mtx_.lock();
-    if (!frames_.empty()) {
-        frame = frames_.front();
-        if (frame && frame->header.ssrc == remote_ssrc.get()->load()) {
-            frames_.pop_front();
-        }
-        else {
-            frame = nullptr;
-        }
-    }
-    frames_mtx_.unlock();
-    return frame;
+
+    // Only take the frame if the source ssrc in the frame matches the remote ssrc that we want to pull frames from
+    return frames_.pop(remote_ssrc.get());
 }
 
-rtp_error_t uvgrtp::reception_flow::install_handler(int type, std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
-    std::function<rtp_error_t(void*, int, uint8_t*, size_t, frame::rtp_frame** out)> handler, void* args)
+size_t uvgrtp::reception_flow::pull_frames(uvgrtp::frame::rtp_frame **frames, size_t max_frames, ssize_t timeout_ms,
+    std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc)
 {
-    uint32_t ssrc = remote_ssrc.get()->load();
-    handlers_mutex_.lock();
-    switch (type) {
-        case 1: {
-            packet_handlers_[ssrc].rtp.handler = handler;
-            packet_handlers_[ssrc].rtp.args = args;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    size_t count = 0;
+
+    while (!(count = frames_.pop(frames, max_frames, remote_ssrc.get())) &&
+        !should_stop_ &&
+        timeout_ms > std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time).count())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (should_stop_) {
+        for (size_t i = 0; i < count; ++i) {
+            (void)uvgrtp::frame::dealloc_frame(frames[i]);
+        }
+        return 0;
+    }
+    return count;
+}
+
+uvgrtp::delivery_queue& uvgrtp::reception_flow::get_delivery_queue()
+{
+    // the frames of the shards are queued by the lead
+    return lead_ ? lead_->get_delivery_queue() : frames_;
+}
+
+rtp_error_t uvgrtp::reception_flow::install_handler(int type, std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+    std::function<rtp_error_t(void*, int, uint8_t*, size_t, frame::rtp_frame** out)> handler, void* args)
+{
+    uint32_t ssrc = remote_ssrc.get()->load();
+    handlers_mutex_.lock();
+    switch (type) {
+        case 1: {
+            packet_handlers_[ssrc].rtp.handler = handler;
+            packet_handlers_[ssrc].rtp.args = args;
             break;
         }
         case 2: {
@@ -338,6 +837,7 @@ rtp_error_t uvgrtp::reception_flow::install_handler(int type, std::shared_ptr<st
             break;
         }
     }
+    publish_handlers();
     handlers_mutex_.unlock();
     return RTP_OK;
 }
@@ -347,14 +847,351 @@ rtp_error_t uvgrtp::reception_flow::install_getter(std::shared_ptr<std::atomic<s
 {
     handlers_mutex_.lock();
     packet_handlers_[remote_ssrc.get()->load() ].getter = getter;
+    publish_handlers();
+    handlers_mutex_.unlock();
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::reception_flow::install_srtp_batch_handler(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+    std::function<void(std::vector<uvgrtp::frame::rtp_frame *>&, std::vector<rtp_error_t>&)> handler)
+{
+    handlers_mutex_.lock();
+    packet_handlers_[remote_ssrc.get()->load()].srtp_batch = handler;
+    publish_handlers();
+    handlers_mutex_.unlock();
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::reception_flow::install_playout_handler(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+    std::function<void(uvgrtp::frame::rtp_frame *)> handler)
+{
+    handlers_mutex_.lock();
+    packet_handlers_[remote_ssrc.get()->load()].playout = handler;
+    publish_handlers();
+    handlers_mutex_.unlock();
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::reception_flow::install_pipeline(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+    std::shared_ptr<uvgrtp::pipeline> pipeline)
+{
+    handlers_mutex_.lock();
+    packet_handlers_[remote_ssrc.get()->load()].pipeline = pipeline;
+    publish_handlers();
+    handlers_mutex_.unlock();
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::reception_flow::set_priority(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+    int priority)
+{
+    handlers_mutex_.lock();
+    packet_handlers_[remote_ssrc.get()->load()].priority = priority;
+    publish_handlers();
+    handlers_mutex_.unlock();
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::reception_flow::install_recorder(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+    std::shared_ptr<uvgrtp::recorder> recorder)
+{
+    handlers_mutex_.lock();
+    packet_handlers_[remote_ssrc.get()->load()].recorder = recorder;
+    publish_handlers();
+    handlers_mutex_.unlock();
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::reception_flow::install_reorder_buffer(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+    std::shared_ptr<uvgrtp::reorder_buffer> buffer)
+{
+    handlers_mutex_.lock();
+    packet_handlers_[remote_ssrc.get()->load()].reorder = buffer;
+    publish_handlers();
+    handlers_mutex_.unlock();
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::reception_flow::install_merge(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+    std::shared_ptr<uvgrtp::redundancy_merge> merge)
+{
+    handlers_mutex_.lock();
+    packet_handlers_[remote_ssrc.get()->load()].merge = merge;
+    publish_handlers();
+    handlers_mutex_.unlock();
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::reception_flow::install_metrics(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+    std::shared_ptr<uvgrtp::stream_metrics> metrics)
+{
+    handlers_mutex_.lock();
+    packet_handlers_[remote_ssrc.get()->load()].metrics = metrics;
+    publish_handlers();
     handlers_mutex_.unlock();
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::reception_flow::install_forwarder(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+    std::shared_ptr<uvgrtp::forwarder> forwarder)
+{
+    handlers_mutex_.lock();
+    packet_handlers_[remote_ssrc.get()->load()].forwarder = forwarder;
+    publish_handlers();
+    handlers_mutex_.unlock();
+    return RTP_OK;
+}
+
+uint64_t uvgrtp::reception_flow::get_ring_full_events() const
+{
+    uint64_t events = ring_full_events_.load(std::memory_order_relaxed);
+
+    for (auto& shard : shards_) {
+        events += shard.flow->get_ring_full_events();
+    }
+    return events;
+}
+
+uint64_t uvgrtp::reception_flow::get_ring_watermark_events() const
+{
+    uint64_t events = ring_watermark_events_.load(std::memory_order_relaxed);
+
+    for (auto& shard : shards_) {
+        events += shard.flow->get_ring_watermark_events();
+    }
+    return events;
+}
+
+uint64_t uvgrtp::reception_flow::get_ring_resizes() const
+{
+    uint64_t resizes = ring_resizes_.load(std::memory_order_relaxed);
+
+    for (auto& shard : shards_) {
+        resizes += shard.flow->get_ring_resizes();
+    }
+    return resizes;
+}
+
+uint64_t uvgrtp::reception_flow::get_kernel_drops() const
+{
+    uint64_t drops = socket_ ? socket_->kernel_drops() : 0;
+
+    for (auto& shard : shards_) {
+        drops += shard.socket->kernel_drops();
+    }
+    return drops;
+}
+
+// the fold of a group address is unique for IPv4 groups, IPv6 groups are compared whole
+static uint32_t fold_address(const in6_addr& address)
+{
+    uint32_t words[4];
+    memcpy(words, &address, sizeof(words));
+
+    return words[0] ^ words[1] ^ words[2] ^ words[3];
+}
+
+rtp_error_t uvgrtp::reception_flow::add_group(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc, const in6_addr& group)
+{
+    std::lock_guard<std::mutex> lg(handlers_mutex_);
+    uint32_t ssrc = remote_ssrc.get()->load();
+
+    for (auto& route : groups_) {
+        if (memcmp(&route.group, &group, sizeof(group)) == 0)
+            return route.remote_ssrc == ssrc ? RTP_OK : RTP_INVALID_VALUE;
+    }
+
+    groups_.push_back({ group, ssrc });
+    publish_groups();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::reception_flow::remove_group(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc, const in6_addr& group)
+{
+    std::lock_guard<std::mutex> lg(handlers_mutex_);
+    uint32_t ssrc = remote_ssrc.get()->load();
+
+    for (auto it = groups_.begin(); it != groups_.end(); ++it) {
+        if (it->remote_ssrc == ssrc && memcmp(&it->group, &group, sizeof(group)) == 0) {
+            groups_.erase(it);
+            publish_groups();
+            return RTP_OK;
+        }
+    }
+
+    return RTP_NOT_FOUND;
+}
+
+void uvgrtp::reception_flow::publish_groups()
+{
+    std::unordered_map<uint32_t, std::vector<group_route>> routes;
+
+    for (auto& route : groups_) {
+        routes[fold_address(route.group)].push_back(route);
+    }
+
+    group_demux_.publish(routes);
+    has_groups_.store(!groups_.empty(), std::memory_order_release);
+
+    for (auto& shard : shards_) {
+        shard.flow->group_demux_.publish(routes);
+        shard.flow->has_groups_.store(!groups_.empty(), std::memory_order_release);
+    }
+}
+
+rtp_error_t uvgrtp::reception_flow::add_mid(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+    uint8_t mid_id, const std::string& mid, uint8_t rid_id, const std::string& rid)
+{
+    std::lock_guard<std::mutex> lg(handlers_mutex_);
+
+    for (auto& route : mids_) {
+        if (route.remote_ssrc != remote_ssrc && route.mid == mid && route.rid == rid)
+            return RTP_INVALID_VALUE;
+    }
+
+    mids_.erase(std::remove_if(mids_.begin(), mids_.end(),
+        [&remote_ssrc](const mid_route& route) { return route.remote_ssrc == remote_ssrc; }), mids_.end());
+
+    mids_.push_back({ remote_ssrc, mid_id, mid, rid_id, rid });
+    publish_mids();
+
+    return RTP_OK;
+}
+
+void uvgrtp::reception_flow::remove_mid(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc)
+{
+    std::lock_guard<std::mutex> lg(handlers_mutex_);
+    size_t count = mids_.size();
+
+    mids_.erase(std::remove_if(mids_.begin(), mids_.end(),
+        [&remote_ssrc](const mid_route& route) { return route.remote_ssrc == remote_ssrc; }), mids_.end());
+
+    if (mids_.size() != count)
+        publish_mids();
+}
+
+void uvgrtp::reception_flow::publish_mids()
+{
+    /* The routes with a RID are tried first, so that a simulcast encoding goes to
+     * its own stream rather than to a stream that takes the whole MID */
+    auto routes = std::make_shared<std::vector<mid_route>>(mids_);
+    std::stable_partition(routes->begin(), routes->end(),
+        [](const mid_route& route) { return !route.rid.empty(); });
+
+    std::shared_ptr<const std::vector<mid_route>> published = routes;
+
+    std::atomic_store(&mid_routes_, published);
+    has_mids_.store(!mids_.empty(), std::memory_order_release);
+
+    for (auto& shard : shards_) {
+        std::atomic_store(&shard.flow->mid_routes_, published);
+        shard.flow->has_mids_.store(!mids_.empty(), std::memory_order_release);
+    }
+}
+
+uvgrtp::handler *uvgrtp::reception_flow::find_mid_handlers(ssrc_demux<handler>::snapshot *table,
+    const Buffer& slot, size_t h)
+{
+    const uint8_t *ptr = slot.data;
+
+    // the parsed header size covers the CSRCs and the extension, so they are within the packet
+    if (!headers_.header_size[h] || !(ptr[0] & 0x10))
+        return nullptr;
+
+    size_t offset = RTP_HDR_SIZE + 4 * (size_t)(ptr[0] & 0x0f);
+
+    uvgrtp::frame::ext_header ext;
+    ext.type = (uint16_t)((ptr[offset] << 8) | ptr[offset + 1]);
+    ext.len  = (uint16_t)(((ptr[offset + 2] << 8) | ptr[offset + 3]) * 4);
+    ext.data = (uint8_t *)ptr + offset + 4;
+
+    std::shared_ptr<const std::vector<mid_route>> routes = std::atomic_load(&mid_routes_);
+
+    for (auto& route : *routes) {
+        size_t len = 0;
+        const uint8_t *mid = uvgrtp::find_header_extension(&ext, route.mid_id, len);
+
+        if (!mid || len != route.mid.size() || memcmp(mid, route.mid.data(), len))
+            continue;
+
+        if (!route.rid.empty()) {
+            const uint8_t *rid = uvgrtp::find_header_extension(&ext, route.rid_id, len);
+
+            if (!rid || len != route.rid.size() || memcmp(rid, route.rid.data(), len))
+                continue;
+        }
+
+        uint32_t old_ssrc = route.remote_ssrc->load();
+        handler *handlers = table->find(old_ssrc);
+
+        if (handlers && (lead_ ? lead_ : this)->bind_ssrc(route.remote_ssrc, old_ssrc, headers_.ssrc[h])) {
+            UVG_LOG_DEBUG("Bound SSRC %u to the stream of MID %s", headers_.ssrc[h], route.mid.c_str());
+
+            /* The snapshot still has the handlers under the old SSRC and only this thread reads it.
+             * The frame of this packet is queued for the new SSRC like the ones that follow */
+            handlers->remote_ssrc = headers_.ssrc[h];
+        }
+        return handlers;
+    }
+
+    return nullptr;
+}
+
+bool uvgrtp::reception_flow::bind_ssrc(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+    uint32_t old_ssrc, uint32_t ssrc)
+{
+    // the processing thread must not wait for a thread that may be waiting for it
+    std::unique_lock<std::mutex> lock(handlers_mutex_, std::try_to_lock);
+
+    if (!lock.owns_lock() || remote_ssrc->load() != old_ssrc || packet_handlers_.count(ssrc))
+        return false;
+
+    auto it = packet_handlers_.find(old_ssrc);
+    if (it == packet_handlers_.end())
+        return false;
+
+    handler handlers = it->second;
+    packet_handlers_.erase(it);
+    packet_handlers_.insert({ ssrc, handlers });
+
+    for (auto& route : groups_) {
+        if (route.remote_ssrc == old_ssrc)
+            route.remote_ssrc = ssrc;
+    }
+
+    remote_ssrc->store(ssrc);
+    publish_handlers();
+    publish_groups();
+
+    return true;
+}
+
+uvgrtp::handler *uvgrtp::reception_flow::find_group_handlers(ssrc_demux<handler>::snapshot *table,
+    const in6_addr& destination)
+{
+    ssrc_demux<std::vector<group_route>>::snapshot *groups = group_demux_.enter();
+    std::vector<group_route> *routes = groups->find(fold_address(destination));
+    handler *handlers = nullptr;
+
+    if (routes) {
+        for (auto& route : *routes) {
+            if (memcmp(&route.group, &destination, sizeof(destination)) == 0) {
+                handlers = table->size() == 1 ? table->first() : table->find(route.remote_ssrc);
+                break;
+            }
+        }
+    }
+
+    group_demux_.leave();
+    return handlers;
+}
+
 rtp_error_t uvgrtp::reception_flow::remove_handlers(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc)
 {
     std::lock_guard<std::mutex> lg(handlers_mutex_);
     size_t removed = packet_handlers_.erase(remote_ssrc.get()->load());
+    publish_handlers();
     if (removed == 1) {
         return RTP_OK;
     }
@@ -363,31 +1200,92 @@ rtp_error_t uvgrtp::reception_flow::remove_handlers(std::shared_ptr<std::atomic<
 
 void uvgrtp::reception_flow::return_frame(uvgrtp::frame::rtp_frame *frame)
 {
-    uint32_t ssrc = frame->header.ssrc;
-
-    // 1. Check if there is only one hook installed -> no socket muxing
-    // 2. Multiple handlers -> check if there exists a hook that this ssrc belongs to
-    // 3. If neither is found, push the frame to the queue
-    if (hooks_.size() == 1) {
-        /* No socket multiplexing: All packets are given to this hook */
-        receive_pkt_hook pkt_hook = hooks_.begin()->second;
-        recv_hook hook = pkt_hook.hook;
-        void* arg = pkt_hook.arg;
-        hook(arg, frame);
-    }
-    else if (hooks_.find(ssrc) != hooks_.end()) {
-        /* Socket multiplexing: Hook found */
-        receive_pkt_hook pkt_hook = hooks_[ssrc];
-        recv_hook hook = pkt_hook.hook;
-        void* arg = pkt_hook.arg;
-        hook(arg, frame);
+    // the frames of all shards are given to the user through the hooks and queue of the lead
+    if (lead_) {
+        lead_->return_frame(frame);
+        return;
     }
-    else {
-        frames_mtx_.lock();
-        frames_.push_back(frame);
-        frames_mtx_.unlock();
+
+    receive_pkt_hook hook;
+    std::shared_ptr<uvgrtp::stream_metrics> metrics;
+    {
+        std::lock_guard<std::mutex> lg(handlers_mutex_);
+
+        // 1. Check if there is only one stream -> no socket muxing, all frames go to its hook
+        // 2. Multiple streams -> check if there exists a stream that this ssrc belongs to
+        // 3. If neither has a hook, push the frame to the queue
+        auto it = packet_handlers_.size() == 1 ? packet_handlers_.begin()
+            : packet_handlers_.find(frame->header.ssrc);
+
+        if (it != packet_handlers_.end()) {
+            hook    = it->second.hook;
+            metrics = it->second.metrics;
+        }
+    }
+
+    if (hook.batch) {
+        hook.batch(&frame, 1);
+    } else if (hook.frame) {
+        hook.frame(frame);
+    } else {
+        if (metrics)
+            metrics->record(uvgrtp::stream_metrics::QUEUE_DEPTH, frames_.size());
+        frames_.push(frame);
+    }
+}
+
+void uvgrtp::reception_flow::flush_ready_frames()
+{
+    size_t count = ready_frames_.size();
+    size_t i = 0;
+    const bool profiling = has_profiling_.load(std::memory_order_relaxed);
+
+    while (i < count) {
+        const receive_pkt_hook& hook = ready_handlers_[i]->hook;
+        uvgrtp::stream_metrics *metrics = ready_handlers_[i]->metrics.get();
+
+        const bool profiled = profiling && metrics && metrics->sample(uvgrtp::stream_metrics::PROFILE_FRAME);
+        std::chrono::steady_clock::time_point start;
+        if (profiled)
+            start = std::chrono::steady_clock::now();
+
+        if (hook.batch) {
+            // the following frames of the same stream go to the hook with this one
+            size_t end = i + 1;
+            while (end < count && ready_handlers_[end] == ready_handlers_[i]) {
+                ++end;
+            }
+
+            hook.batch(&ready_frames_[i], end - i);
+
+            if (profiled) {
+                metrics->record(uvgrtp::stream_metrics::STAGE_DELIVERY_NS,
+                    (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count() / (end - i));
+            }
+            i = end;
+            continue;
+        }
+
+        if (hook.frame) {
+            hook.frame(ready_frames_[i]);
+        } else {
+            uvgrtp::delivery_queue& queue = get_delivery_queue();
+
+            if (metrics)
+                metrics->record(uvgrtp::stream_metrics::QUEUE_DEPTH, queue.size());
+            queue.push(ready_frames_[i], ready_handlers_[i]->remote_ssrc);
+        }
+
+        if (profiled)
+            metrics->record_stage(uvgrtp::stream_metrics::STAGE_DELIVERY_NS, start);
+        ++i;
     }
+
+    ready_frames_.clear();
+    ready_handlers_.clear();
 }
+
 /* User packets disabled for now
 rtp_error_t uvgrtp::reception_flow::install_user_hook(void* arg, void (*hook)(void*, uint8_t* data, uint32_t len))
 {
@@ -415,313 +1313,1151 @@ void uvgrtp::reception_flow::return_user_pkt(uint8_t* pkt, uint32_t len)
     }
 }
 */
-void uvgrtp::reception_flow::receiver(std::shared_ptr<uvgrtp::socket> socket)
+void uvgrtp::reception_flow::receiver(std::shared_ptr<uvgrtp::socket> socket, int rce_flags)
 {
     int read_packets = 0;
 
     while (!should_stop_) {
 
-        // First we wait using poll until there is data in the socket
+        if (replay_pending_) {
+            serve_replay(rce_flags);
+        }
+
+#ifdef _WIN32
+        // the datagrams of the Registered I/O of the socket are waited for on its completion queue
+        rtp_error_t registered = socket->wait_registered_io(poll_timeout_ms_);
+
+        if (registered != RTP_NOT_SUPPORTED) {
+            if (registered == RTP_OK) {
+                read_packets += read_available_packets(socket, rce_flags);
+
+                if (!inline_processing_) {
+                    wake_processor();
+                }
+            } else if (registered != RTP_INTERRUPTED) {
+                UVG_LOG_ERROR("Waiting for Registered I/O failed");
+                break;
+            }
+            continue;
+        }
+#endif
+
+        // First we wait using poll until there is data in the socket or in its memory transport
 
 #ifdef _WIN32
-        LPWSAPOLLFD pfds = new pollfd();
+        WSAPOLLFD pfds[3 + MAX_RECEIVE_PATHS] = {};
 #else
-        pollfd* pfds = new pollfd();
+        pollfd pfds[3 + MAX_RECEIVE_PATHS] = {};
 #endif
 
-        size_t read_fds = socket->get_raw_socket();
-        pfds->fd = read_fds;
-        pfds->events = POLLIN;
+        pfds[0].fd = socket->get_raw_socket();
+        pfds[0].events = POLLIN;
+
+        int wake_fd = socket->memory_wake_fd();
+        pfds[1].fd = wake_fd;
+        pfds[1].events = POLLIN;
+
+        // stop() wakes the poll through the stop event, which is placed after the sockets that are polled
+        unsigned long nfds = wake_fd >= 0 ? 2 : 1;
+
+        // the sockets of the receive paths are polled with the socket of the flow
+        std::shared_ptr<const std::vector<std::shared_ptr<uvgrtp::socket>>> paths = std::atomic_load(&receive_paths_);
+        unsigned long first_path = nfds;
+
+        if (paths) {
+            for (auto& path : *paths) {
+                pfds[nfds].fd     = path->get_raw_socket();
+                pfds[nfds].events = POLLIN;
+                ++nfds;
+            }
+        }
+
+        if (stop_event_.fd() >= 0) {
+            pfds[nfds].fd     = stop_event_.fd();
+            pfds[nfds].events = POLLIN;
+            ++nfds;
+        }
 
         // exits after poll_timeout_ms_ time if no data has been received to check whether we should exit
 #ifdef _WIN32
-        if (WSAPoll(pfds, 1, poll_timeout_ms_) < 0) {
+        if (WSAPoll(pfds, nfds, poll_timeout_ms_) < 0) {
 #else
-        if (poll(pfds, 1, poll_timeout_ms_) < 0) {
+        if (poll(pfds, (nfds_t)nfds, poll_timeout_ms_) < 0) {
 #endif
             UVG_LOG_ERROR("poll(2) failed");
-            if (pfds)
-            {
-                delete pfds;
-                pfds = nullptr;
-            }
             break;
         }
 
-        if (pfds->revents & POLLIN) {
-
-            // we write as many packets as socket has in the buffer
-            while (!should_stop_)
-            {
-                ssize_t next_write_index = next_buffer_location(last_ring_write_index_);
-
-                //increase_buffer_size(next_write_index);
-
-                rtp_error_t ret = RTP_OK;
-                //sockaddr_in sender = {};
-                //sockaddr_in6 sender6 = {};
-                
-                // get the potential packet
-                ret = socket->recvfrom(ring_buffer_[next_write_index].data, payload_size_,
-                    MSG_DONTWAIT, &ring_buffer_[next_write_index].read);
+        // the send timestamps of RTP_TIMESTAMP_SEND wait in the error queue of the socket
+        if (pfds[0].revents & POLLERR) {
+            (void)socket->read_tx_timestamps();
+        }
 
+        bool readable = false;
 
-                if (ret == RTP_INTERRUPTED)
-                {
-                    break;
-                }
-                else if (ring_buffer_[next_write_index].read == 0)
-                {
-                    UVG_LOG_WARN("Failed to read anything from socket");
-                    break;
-                }
-                else if (ret != RTP_OK) {
-                    UVG_LOG_ERROR("recvfrom(2) failed! Reception flow cannot continue %d!", ret);
-                    should_stop_ = true;
-                    break;
-                }
+        if ((pfds[0].revents & POLLIN) || (wake_fd >= 0 && (pfds[1].revents & POLLIN))) {
+            read_packets += read_available_packets(socket, rce_flags);
+            readable = true;
+        }
 
-                ++read_packets;
-                // Save the IP adderss that this packet came from into the buffer
-                //ring_buffer_[next_write_index].from6 = sender6;
-                //ring_buffer_[next_write_index].from = sender;
-                // finally we update the ring buffer so processing (reading) knows that there is a new frame
-                last_ring_write_index_ = next_write_index;
+        for (unsigned long i = first_path; paths && i < first_path + paths->size(); ++i) {
+            if (pfds[i].revents & POLLIN) {
+                read_packets += read_available_packets((*paths)[i - first_path], rce_flags);
+                readable = true;
             }
-
-            // start processing the packets by waking the processing thread
-            process_cond_.notify_one();
         }
 
-        if (pfds)
-        {
-            delete pfds;
-            pfds = nullptr;
+        // start processing the packets by waking the processing thread if it has gone to sleep
+        if (readable && !inline_processing_) {
+            wake_processor();
         }
     }
 
     UVG_LOG_DEBUG("Total read packets from buffer: %li", read_packets);
 }
 
-void uvgrtp::reception_flow::process_packet(int rce_flags)
+int uvgrtp::reception_flow::read_available_packets(std::shared_ptr<uvgrtp::socket> socket, int rce_flags, size_t budget)
 {
-    std::unique_lock<std::mutex> lk(wait_mtx_);
+    int read_packets = 0;
 
-    int processed_packets = 0;
+    uint8_t* batch_buffers[MAX_RECV_BATCH_SIZE];
+    int batch_lengths[MAX_RECV_BATCH_SIZE];
 
-    while (!should_stop_)
+    // a wait for room in a full ring is counted once, see get_ring_full_events()
+    bool waiting = false;
+    int full_spins = 0;
+
+    // we write as many packets as socket has in the buffer
+    while (!should_stop_ && (budget == 0 || (size_t)read_packets < budget))
     {
-        // go to sleep waiting for something to process
-        process_cond_.wait(lk); 
+        take_grown_ring();
 
-        if (should_stop_)
-        {
-            break;
+        ring* r = write_ring_;
+        ssize_t next_write_index = next_buffer_location(r, r->write_index);
+        size_t slots = free_slots(next_write_index);
+
+        if (slots == 0) {
+            if (!waiting) {
+                ring_full_events_.fetch_add(1, std::memory_order_relaxed);
+                waiting = true;
+                check_watermark();
+            }
+
+            // the ring is full, leave the packets in the socket until processing has made room
+            wait_for_room(full_spins);
+            continue;
         }
 
-        // process all available reads in one go
-        while (ring_read_index_ != last_ring_write_index_)
-        {
-            // first update the read location
-            ring_read_index_ = next_buffer_location(ring_read_index_);
-
-            if (ring_buffer_[ring_read_index_].read > 0)
-            {
-                /* When processing a packet, the following checks are done
-                 * 1. If there is only a single set of handlers installed, there is no socket multiplexing. All packets
-                 *    to to this handler
-                 * 2. Check the SSRC of the packets. This field is in the same place for RTP and ZRTP, octets 8-11. For RTCP, it is
-                 *    in octets 4-7
-                 * 3. If there is no SSRC match for any of the handlers, this either a holepuncher or a user packet.
-                 * 4. SSRC match found -> Determine which protocol this packet belongs to. RTCP packets can be told apart from RTP packets via 
-                 *    bits 8-15. ZRTP packets can be told apart from others via their 2 first bits being 0 and the Magic Cookie
-                 *    field being 0x5a525450. Holepuncher packets contain 0x00 payload. However, holepunching is
-                 *    not needed if RTCP is enabled. 
-                 * 5. After determining the correct protocol, hand out the packet to the correct handler(s) if it exists. */
-                
-                uint8_t* ptr = (uint8_t*)ring_buffer_[ring_read_index_].data;
-                //sockaddr_in from = ring_buffer_[ring_read_index_].from;
-                //sockaddr_in6 from6 = ring_buffer_[ring_read_index_].from6;
-                uint32_t rtp_ssrc = ntohl(*(uint32_t*)&ptr[8]);
-                uint32_t rtcp_ssrc = ntohl(*(uint32_t*)&ptr[4]);
-                bool rtcp_pkt = false;
-
-                handler* handlers = nullptr;
-                if (packet_handlers_.size() == 1) {
-                    /* No socket multiplexing: All packets are given to this handler */
-                    handlers = &packet_handlers_.begin()->second;
-                }
-                else if (packet_handlers_.find(rtcp_ssrc) != packet_handlers_.end()) {
-                    /* Socket multiplexing: RTCP packet */
-                    handlers = &packet_handlers_[rtcp_ssrc];
-                    rtcp_pkt = true;
-                }
-                else if (packet_handlers_.find(rtp_ssrc) != packet_handlers_.end()) {
-                    /* Socket multiplexing: RTP/ZRTP packet */
-                    handlers = &packet_handlers_[rtp_ssrc];
-                }
-                size_t size = (size_t)ring_buffer_[ring_read_index_].read;
-                uint8_t version = (*(uint8_t*)&ptr[0] >> 6) & 0x3;
-
-                if (handlers != nullptr) {
-                    /* SSRC match or SSRC 0 is found -> call handlers */
-                    rtp_error_t retval;
-                    uvgrtp::frame::rtp_frame* frame = nullptr;
-
-                    /* -------------------- Protocol checks -------------------- */
-                    /* Checks in the following order:
-                     * 1. SSRC is in octets 4-7                         -> RTCP packet
-                     * 2. Version 0 and Magic Cookie is 0x5a525450      -> ZRTP packet
-                     * 3. Version is 2                                  -> RTP packet     (or SRTP)
-                     * 4. Version is 3                                  -> Keep-Alive/Holepuncher 
-                     * 5. Otherwise                                     -> User packet, DISABLED */
-                    if (rtcp_pkt && (rce_flags & RCE_RTCP_MUX)) {
-                        uint8_t pt = (uint8_t)ptr[1]; // Packet type
-                        if (pt >= 200 && pt <= 204) {
-                            if (handlers->rtcp.handler != nullptr) {
-                                retval = handlers->rtcp.handler(nullptr, rce_flags, &ptr[0], size, &frame);
-                            }
-                        }
-                    }
-                    // Magic Cookie 0x5a525450
-                    else if (version == 0x0 && ntohl(*(uint32_t*)&ptr[4]) == 0x5a525450) {
-                        if (handlers->zrtp.handler != nullptr) {
-                            retval = handlers->zrtp.handler(nullptr, rce_flags, &ptr[0], size, &frame);
-                        }
-                    }
-                    else if (version == 0x2) {
-                        retval = RTP_PKT_MODIFIED;
-
-                        /* Create RTP header */
-                        if (handlers->rtp.handler != nullptr) {
-                            retval = handlers->rtp.handler(nullptr, rce_flags, &ptr[0], size, &frame);
-                        }
-                        else {
-                            /* Received a packet but RTP handler is not installed.
-                             * This should only happen when ZRTP is enabled. If the remote stream is done first, they start sending
-                             * media already before we have handled the last ZRTP ConfACK packet. This should not be a problem
-                             * as we only lose the first frame or a few at worst. If this causes issues, the sender
-                             * may, for example, sleep for 50 or so milliseconds to give us time to complete ZRTP negotiation. */
-                            UVG_LOG_DEBUG("RTP handler is not (yet?) installed");
-                        }
-
-                        /* If SRTP is enabled -> send through SRTP handler */
-                        if (rce_flags & RCE_SRTP && retval == RTP_PKT_MODIFIED) {
-                            if (handlers->srtp.handler != nullptr) {
-                                retval = handlers->srtp.handler(handlers->srtp.args, rce_flags, &ptr[0], size, &frame);
-                            }
-                        }
-                        /* Update RTCP session statistics */
-                        if (rce_flags & RCE_RTCP) {
-                            if (handlers->rtcp_common.handler != nullptr) {
-                                retval = handlers->rtcp_common.handler(handlers->rtcp_common.args, rce_flags, &ptr[0], size, &frame);
-                            }
-                        }
-
-                        /* If packet is ok, hand over to media handler */
-                        if (retval == RTP_PKT_MODIFIED || retval == RTP_PKT_NOT_HANDLED) {
-                            if (handlers->media.handler && frame) {
-                                retval = handlers->media.handler(handlers->media.args, rce_flags, &ptr[0], size, &frame);
-                            }
-                            /* Last, if one or more packets are ready, return them to the user */
-                            if (retval == RTP_PKT_READY) {
-                                return_frame(frame);
-                            }
-                            else if (retval == RTP_MULTIPLE_PKTS_READY && handlers->getter != nullptr) {
-                                while (handlers->getter(&frame) == RTP_PKT_READY) {
-                                    return_frame(frame);
-                                }
-                            }
-                        }
+        rtp_error_t ret = RTP_OK;
+        int packets = 1;
+        bool destinations = socket->destination_addresses();
+        //sockaddr_in sender = {};
+        //sockaddr_in6 sender6 = {};
+
+        // a batch is written to consecutive free slots
+        int batch_size = recv_batch_size_;
+        if (slots < (size_t)batch_size) {
+            batch_size = (int)slots;
+        }
+        if (budget != 0 && budget - read_packets < (size_t)batch_size) {
+            batch_size = (int)(budget - read_packets);
+        }
+
+        if (gro_) {
+            // a coalesced buffer is split into consecutive slots, so there must be room for the
+            // largest possible buffer. If the ring end is near, leave the rest of the slots empty
+            size_t gro_slots = std::max(GRO_MAX_SEGMENTS, GRO_MAX_SIZE / payload_size_ + 1);
+
+            if (slots < gro_slots) {
+                if (next_write_index != 0 && slots == r->slots.size() - next_write_index) {
+                    for (size_t i = next_write_index; i < r->slots.size(); ++i) {
+                        r->slots[i].read = 0;
                     }
-                    /* No SSRC match found -> Holepuncher or user packet */
-                    else if (version == 0x3) {
-                        UVG_LOG_DEBUG("Holepuncher packet");
+                    r->write_index = r->slots.size() - 1;
+                } else {
+                    if (!waiting) {
+                        ring_full_events_.fetch_add(1, std::memory_order_relaxed);
+                        waiting = true;
                     }
-                    /* DISABLED else {
-                        return_user_pkt(&ptr[0], (uint32_t)size);
-                    }*/
+                    wait_for_room(full_spins);
                 }
-                else {
-                    /* No SSRC match found -> Holepuncher or user packet */
-                    if (version == 0x3) {
-                        UVG_LOG_DEBUG("Holepuncher packet");
-                    }
-                    /* DISABLED else {
-                        return_user_pkt(&ptr[0], (uint32_t)size);
-                    }*/
+                continue;
+            }
+
+            uint8_t* base = r->memory.data() + next_write_index * r->slot_size;
+            int bytes = 0;
+            int segment_size = 0;
+
+            // get the potential coalesced packets
+            ret = socket->recv_gro(base, std::min(slots * r->slot_size, GRO_MAX_SIZE),
+                MSG_DONTWAIT, &bytes, &segment_size);
+
+            r->slots[next_write_index].data = base;
+            r->slots[next_write_index].read = bytes;
+
+            if (ret == RTP_OK && bytes > 0) {
+                if (segment_size <= 0 || segment_size > bytes)
+                    segment_size = bytes;
+
+                // point the slots to the datagrams inside the coalesced buffer
+                packets = 0;
+                for (int offset = 0; offset < bytes && (size_t)packets < slots; offset += segment_size) {
+                    r->slots[next_write_index + packets].data = base + offset;
+                    r->slots[next_write_index + packets].read = std::min(segment_size, bytes - offset);
+                    r->slots[next_write_index + packets].recv_time = socket->recv_time(0);
+                    if (destinations)
+                        r->slots[next_write_index + packets].destination = socket->recv_destination(0);
+                    ++packets;
                 }
-                // to make sure we don't process this packet again
-                ring_buffer_[ring_read_index_].read = 0;
-                ++processed_packets;
             }
-            else
-            {
+        }
+        else if (batch_size > 1) {
+            for (int i = 0; i < batch_size; ++i) {
+                batch_buffers[i] = r->slots[next_write_index + i].data;
+            }
+
+            // get as many potential packets as fit into the batch
+            ret = socket->recvmmsg(batch_buffers, payload_size_, batch_lengths, batch_size,
+                MSG_DONTWAIT, &packets);
+
+            for (int i = 0; i < packets; ++i) {
+                r->slots[next_write_index + i].read = batch_lengths[i];
+                r->slots[next_write_index + i].recv_time = socket->recv_time(i);
+                if (destinations)
+                    r->slots[next_write_index + i].destination = socket->recv_destination(i);
+            }
+        }
+        else {
+            // get the potential packet
+            ret = socket->recvfrom(r->slots[next_write_index].data, payload_size_,
+                MSG_DONTWAIT, &r->slots[next_write_index].read);
+            r->slots[next_write_index].recv_time = socket->recv_time(0);
+            if (destinations)
+                r->slots[next_write_index].destination = socket->recv_destination(0);
+        }
+
+        if (ret == RTP_INTERRUPTED)
+        {
+            break;
+        }
+        else if (ret != RTP_OK) {
+            UVG_LOG_ERROR("recvfrom(2) failed! Reception flow cannot continue %d!", ret);
+            should_stop_ = true;
+            break;
+        }
+        else if (r->slots[next_write_index].read == 0)
+        {
+            UVG_LOG_WARN("Failed to read anything from socket");
+            break;
+        }
+
+        read_packets += packets;
+        waiting = false;
+        full_spins = 0;
+        UVG_TRACE(PACKETS_READ, 0, 0, packets);
+        // Save the IP adderss that this packet came from into the buffer
+        //r->slots[next_write_index].from6 = sender6;
+        //r->slots[next_write_index].from = sender;
+        // finally we update the ring buffer so processing (reading) knows that there are new frames
+        r->write_index = next_write_index + packets - 1;
+        check_watermark();
+
+        if (inline_processing_ || engine_driven_) {
+            // no handoff, the packets are dispatched to the handlers from this thread
+            process_available_packets(rce_flags);
+        }
+    }
+
+    // the kernel charges each datagram about the size of its buffer, so the traffic is counted in slots
+    if (read_packets > 0)
+        socket->tune_receive_buffer((size_t)read_packets, payload_size_);
+
+    return read_packets;
+}
+
+void uvgrtp::reception_flow::serve_replay(int rce_flags)
+{
+    replay_job *job = nullptr;
+    {
+        std::lock_guard<std::mutex> lg(replay_mtx_);
+        job = replay_job_;
+    }
+
+    if (!job)
+        return;
+
+    rtp_error_t ret = run_replay(*job, rce_flags);
+
+    std::lock_guard<std::mutex> lg(replay_mtx_);
+    job->result     = ret;
+    job->done       = true;
+    replay_job_     = nullptr;
+    replay_pending_ = false;
+    replay_cond_.notify_all();
+}
+
+rtp_error_t uvgrtp::reception_flow::run_replay(replay_job& job, int rce_flags)
+{
+    uvgrtp::captured_datagram datagram;
+    rtp_error_t ret = RTP_OK;
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t first_time = 0;
+    bool first = true;
+
+    size_t replayed = 0;
+    size_t skipped  = 0;
+    int full_spins  = 0;
+
+    while ((ret = job.reader->next(datagram)) == RTP_OK) {
+        if (datagram.destination_port != job.port)
+            continue;
+
+        // a datagram that the capture has only part of would be discarded as malformed or corrupted
+        if (datagram.truncated || datagram.payload.empty() || datagram.payload.size() > payload_size_) {
+            ++skipped;
+            continue;
+        }
+
+        if (job.speed > 0) {
+            if (first) {
+                first_time = datagram.time_ns;
+                first      = false;
+            }
+
+            uint64_t offset = datagram.time_ns > first_time ? datagram.time_ns - first_time : 0;
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds((int64_t)((double)offset / job.speed)));
+        }
+
+        ring* r = nullptr;
+        ssize_t next_write_index = 0;
+
+        for (;;) {
+            if (should_stop_)
+                return RTP_INTERRUPTED;
+
+            take_grown_ring();
+
+            r = write_ring_;
+            next_write_index = next_buffer_location(r, r->write_index);
+
+            if (free_slots(next_write_index) > 0)
+                break;
+
+            wait_for_room(full_spins);
+        }
+        full_spins = 0;
+
+        // UDP GRO may have left the slot pointing inside the buffer of another slot
+        Buffer& slot = r->slots[next_write_index];
+        if (!zero_copy_)
+            slot.data = r->memory.data() + next_write_index * r->slot_size;
+
+        memcpy(slot.data, datagram.payload.data(), datagram.payload.size());
+        slot.read      = (int)datagram.payload.size();
+        slot.recv_time = uvgrtp::clock::system_ns();
+
+        r->write_index = next_write_index;
+        ++replayed;
+        check_watermark();
+
+        if (inline_processing_) {
+            process_available_packets(rce_flags);
+        } else {
+            wake_processor();
+        }
+    }
+
+    if (skipped) {
+        UVG_LOG_WARN("Skipped %zu truncated or too large datagrams of the capture", skipped);
+    }
+    UVG_LOG_DEBUG("Replayed %zu datagrams", replayed);
+
+    return ret == RTP_NOT_FOUND ? RTP_OK : ret;
+}
+
+void uvgrtp::reception_flow::take_grown_ring()
+{
+    if (ring* grown = grown_ring_.exchange(nullptr)) {
+        write_ring_->next.store(grown, std::memory_order_release);
+        write_ring_ = grown;
+        ring_slots_ = grown->slots.size();
+        ring_resizes_.fetch_add(1, std::memory_order_relaxed);
+
+        UVG_LOG_DEBUG("Reception ring buffer grown to %zu slots", grown->slots.size());
+    }
+}
+
+size_t uvgrtp::reception_flow::handle_readable(size_t budget)
+{
+    if (should_stop_)
+        return 0;
+
+    (void)socket_->read_tx_timestamps();
+    return (size_t)read_available_packets(socket_, rce_flags_, budget);
+}
+
+void uvgrtp::reception_flow::process_packet(int rce_flags)
+{
+    int processed_packets = 0;
+    int spin_count = MIN_SPIN_COUNT;
+
+    while (!should_stop_)
+    {
+        // check for new packets for a while before going to sleep so that the
+        // receiver does not have to wake us up for every burst of packets
+        int spins = 0;
+        while (!packets_waiting() && !should_stop_ && spins < spin_count)
+        {
+            std::this_thread::yield();
+            ++spins;
+        }
+
+        if (packets_waiting())
+        {
+            spin_count = std::min(spin_count * 2, MAX_SPIN_COUNT);
+        }
+        else
+        {
+            spin_count = std::max(spin_count / 2, MIN_SPIN_COUNT);
+
+            // go to sleep waiting for something to process
+            std::unique_lock<std::mutex> lk(wait_mtx_);
+            processor_parked_ = true;
+
+            // the packets held by the reorder buffers are handed on when they are due, see RCC_REORDER_WINDOW_MS
+            if (reordering_.empty()) {
+                process_cond_.wait(lk, [this] {
+                    return should_stop_ || packets_waiting();
+                });
+            } else {
+                process_cond_.wait_until(lk, reorder_deadline_, [this] {
+                    return should_stop_ || packets_waiting();
+                });
+            }
+            processor_parked_ = false;
+        }
+
+        if (should_stop_)
+        {
+            break;
+        }
+
+        processed_packets += process_available_packets(rce_flags);
+    }
+
+    UVG_LOG_DEBUG("Total processed packets: %li", processed_packets);
+}
+
+int uvgrtp::reception_flow::process_available_packets(int rce_flags)
+{
+    /* The handlers are looked up from a snapshot that the install and remove
+     * functions replace, so the packets are handled without taking handlers_mutex_ */
+    ssrc_demux<handler>::snapshot *table = demux_.enter();
+
+    // the arrival times of the packets are converted to the other clocks with one sample per batch
+    uvgrtp::clock::sample_batch();
+
+    // the packets of the high priority streams are taken ahead of the others, see RCC_RECEIVE_PRIORITY
+    int processed_packets = 0;
+    if (has_priorities_.load(std::memory_order_relaxed))
+        processed_packets = process_priority_packets(table, rce_flags);
+
+    ring* r = read_ring_;
+    headers_.count = 0;
+
+    /* The slot under processing. While forwarded packets wait to be sent from their slots,
+     * the read index given to the receiver stays at the first of them */
+    ssize_t position = r->read_index;
+
+    // process all available reads in one go
+    for (;;)
+    {
+        if (position == r->write_index)
+        {
+            // the receiver links the next ring after its last write to this one, so when the
+            // link is seen and this ring is empty, it is finished
+            ring* next = r->next.load(std::memory_order_acquire);
+            if (!next)
+                break;
+
+            if (position != r->write_index)
+                continue;
+
+            // the batched SRTP packets and the forwarded packets may still point to the slots
+            flush_srtp_batch(rce_flags);
+            flush_forwarding(r, position);
+
+            read_ring_ = next;
+            destroy_ring(r);
+            r = next;
+            position = r->read_index;
+            continue;
+        }
+
+        // first update the read location
+        ssize_t read_index = next_buffer_location(r, position);
+        position = read_index;
+
+        if (forwarding_.empty())
+            r->read_index = read_index;
+        else if (++forward_held_ >= MAX_FORWARD_BATCH)
+            flush_forwarding(r, read_index);
+
+        Buffer& slot = r->slots[read_index];
+
+        if (header_ring_ != r || header_next_ >= headers_.count || header_slots_[header_next_] != read_index)
+            parse_headers_ahead(r, read_index);
+
+        const size_t h = header_next_++;
+
+        if (slot.read > 0)
+        {
+            process_slot(table, slot, h, rce_flags);
+            ++processed_packets;
+        }
+        // empty slots are left at the ring end by the UDP GRO receiver and they are skipped silently
+        else if (slot.read < 0)
+        {
 #ifndef NDEBUG 
 #ifndef __RTP_SILENT__
-                ssize_t write = last_ring_write_index_;
-                ssize_t read = ring_read_index_;
-                UVG_LOG_DEBUG("Found invalid frame in read buffer: %li. R: %lli, W: %lli", 
-                    ring_buffer_[ring_read_index_].read, read, write);
+            ssize_t write = r->write_index;
+            UVG_LOG_DEBUG("Found invalid frame in read buffer: %li. R: %lli, W: %lli", 
+                slot.read, read_index, write);
 #endif
 #endif
+        }
+    }
+
+    flush_srtp_batch(rce_flags);
+    flush_forwarding(r, position);
+    expire_reordered(table, rce_flags);
+    flush_ready_frames();
+    demux_.leave();
+
+    if (processed_packets > 0)
+        UVG_TRACE(PACKETS_PROCESSED, 0, 0, processed_packets);
+
+    return processed_packets;
+}
+
+uvgrtp::handler* uvgrtp::reception_flow::find_handlers(ssrc_demux<handler>::snapshot *table, const Buffer& slot,
+    size_t h, bool& rtcp_pkt)
+{
+    const uint8_t* ptr = slot.data;
+    uint32_t rtp_ssrc = headers_.ssrc[h];
+    uint32_t rtcp_ssrc = headers_.timestamp[h];
+
+    handler* handlers = nullptr;
+    rtcp_pkt = false;
+
+    if (has_groups_.load(std::memory_order_acquire) && uvgrtp::socket::is_multicast(slot.destination)) {
+        /* Multicast groups sharing the socket: the packet goes to the stream of its group.
+         * RTCP and RTP are told apart by the packet type, see RFC 5761 section 4 */
+        handlers = find_group_handlers(table, slot.destination);
+        rtcp_pkt = ptr[1] >= 200 && ptr[1] <= 204;
+    }
+    else if (table->size() == 1) {
+        /* No socket multiplexing: All packets are given to this handler */
+        handlers = table->first();
+    }
+    else if ((handlers = table->find(rtcp_ssrc)) != nullptr) {
+        /* Socket multiplexing: RTCP packet */
+        rtcp_pkt = true;
+    }
+    else if ((handlers = table->find(rtp_ssrc)) == nullptr && has_mids_.load(std::memory_order_acquire)) {
+        /* Socket multiplexing: RTP packet of an SSRC that is bound to a stream by its MID */
+        handlers = find_mid_handlers(table, slot, h);
+    }
+    return handlers;
+}
+
+void uvgrtp::reception_flow::process_slot(ssrc_demux<handler>::snapshot *table, Buffer& slot, size_t h, int rce_flags)
+{
+    /* When processing a packet, the following checks are done
+     * 1. If there is only a single set of handlers installed, there is no socket multiplexing. All packets
+     *    to to this handler
+     * 2. Check the SSRC of the packets. This field is in the same place for RTP and ZRTP, octets 8-11. For RTCP, it is
+     *    in octets 4-7
+     * 3. If there is no SSRC match for any of the handlers, this either a holepuncher or a user packet.
+     * 4. SSRC match found -> Determine which protocol this packet belongs to. RTCP packets can be told apart from RTP packets via 
+     *    bits 8-15. ZRTP packets can be told apart from others via their 2 first bits being 0 and the Magic Cookie
+     *    field being 0x5a525450. Holepuncher packets contain 0x00 payload. However, holepunching is
+     *    not needed if RTCP is enabled. 
+     * 5. After determining the correct protocol, hand out the packet to the correct handler(s) if it exists. */
+    
+    uint8_t* ptr = (uint8_t*)slot.data;
+    //sockaddr_in from = slot.from;
+    //sockaddr_in6 from6 = slot.from6;
+    uint32_t rtcp_ssrc = headers_.timestamp[h];
+    bool rtcp_pkt = false;
+
+    // the clock is only read while a stream of the flow is profiled, see RCC_PROFILE_SAMPLING
+    const bool profiling = has_profiling_.load(std::memory_order_relaxed);
+    std::chrono::steady_clock::time_point start;
+    if (profiling)
+        start = std::chrono::steady_clock::now();
+
+    handler* handlers = find_handlers(table, slot, h, rtcp_pkt);
+    size_t size = (size_t)slot.read;
+
+    profiled_ = profiling && handlers && handlers->metrics &&
+        handlers->metrics->sample(uvgrtp::stream_metrics::PROFILE_PACKET);
+    if (profiled_)
+        handlers->metrics->record_stage(uvgrtp::stream_metrics::STAGE_DEMUX_NS, start);
+    uint8_t version = headers_.version[h];
+
+    /* In zero-copy mode the RTP handler hands the slot buffer over to the frame */
+    bool buffer_taken = false;
+
+    if (handlers != nullptr) {
+        /* SSRC match or SSRC 0 is found -> call handlers */
+        rtp_error_t retval;
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+
+        // the packets that go through the RTP handlers below are counted as received
+        if (handlers->metrics && version == 0x2 && !(rtcp_pkt && (rce_flags & RCE_RTCP_MUX))) {
+            handlers->metrics->count(uvgrtp::stream_metrics::RECEIVED_PACKETS);
+            handlers->metrics->count(uvgrtp::stream_metrics::RECEIVED_BYTES, size);
+        }
+
+        /* -------------------- Protocol checks -------------------- */
+        /* Checks in the following order:
+         * 1. SSRC is in octets 4-7                         -> RTCP packet
+         * 2. Version 0 and Magic Cookie is 0x5a525450      -> ZRTP packet
+         * 3. Version is 2                                  -> RTP packet     (or SRTP)
+         * 4. Version is 3                                  -> Keep-Alive/Holepuncher 
+         * 5. Otherwise                                     -> User packet, DISABLED */
+        if (rtcp_pkt && (rce_flags & RCE_RTCP_MUX)) {
+            uint8_t pt = (uint8_t)ptr[1]; // Packet type
+            if (pt >= 200 && pt <= 204) {
+                if (handlers->rtcp.handler != nullptr) {
+                    retval = handlers->rtcp.handler(nullptr, rce_flags, &ptr[0], size, &frame);
+                }
+            }
+        }
+        // Magic Cookie 0x5a525450
+        else if (version == 0x0 && rtcp_ssrc == 0x5a525450) {
+            if (handlers->zrtp.handler != nullptr) {
+                retval = handlers->zrtp.handler(nullptr, rce_flags, &ptr[0], size, &frame);
+            }
+        }
+        else if (version == 0x2 && headers_.header_size[h] == 0) {
+            UVG_LOG_DEBUG("Received RTP packet with an invalid header");
+        }
+        else if (version == 0x2 && handlers->merge && !handlers->merge->accept(headers_.seq[h])) {
+            // the copy of a packet that has already arrived over another path
+            if (handlers->metrics)
+                handlers->metrics->count(uvgrtp::stream_metrics::MERGED_PACKETS);
+        }
+        else if (version == 0x2 && handlers->forwarder && !forward_packet(handlers, ptr, size, rce_flags)) {
+            // forwarded only, the packet does not reach the handlers of the stream
+        }
+        else if (version == 0x2 && handlers->pipeline && !handlers->srtp_batch && !handlers->reorder) {
+            // the stages of the pipeline are not told apart, it is counted as reassembly
+            if (profiled_)
+                start = std::chrono::steady_clock::now();
+
+            retval = handlers->pipeline->process(rce_flags, &ptr[0], size,
+                slot.recv_time, &frame, buffer_taken);
+
+            if (profiled_)
+                handlers->metrics->record_stage(uvgrtp::stream_metrics::STAGE_REASSEMBLY_NS, start);
+            complete_frames(handlers, retval, frame);
+        }
+        else if (version == 0x2) {
+            retval = RTP_PKT_MODIFIED;
+
+            /* Create RTP header */
+            if (handlers->rtp.handler != nullptr) {
+                retval = handlers->rtp.handler(nullptr, rce_flags, &ptr[0], size, &frame);
+                buffer_taken = (retval == RTP_PKT_MODIFIED && frame && frame->dgram == ptr);
+
+                if (retval == RTP_PKT_MODIFIED && frame)
+                    frame->recv_time = slot.recv_time;
+            }
+            else {
+                /* Received a packet but RTP handler is not installed.
+                 * This should only happen when ZRTP is enabled. If the remote stream is done first, they start sending
+                 * media already before we have handled the last ZRTP ConfACK packet. This should not be a problem
+                 * as we only lose the first frame or a few at worst. If this causes issues, the sender
+                 * may, for example, sleep for 50 or so milliseconds to give us time to complete ZRTP negotiation. */
+                UVG_LOG_DEBUG("RTP handler is not (yet?) installed");
+            }
+
+            /* If SRTP is enabled -> send through SRTP handler. With a batch handler the
+             * packet waits for the rest of the batch, the frame no longer needs the ring slot */
+            if (rce_flags & RCE_SRTP && retval == RTP_PKT_MODIFIED) {
+                if (handlers->srtp_batch && frame) {
+                    if (srtp_batch_handlers_ != handlers)
+                        flush_srtp_batch(rce_flags);
+
+                    srtp_batch_handlers_ = handlers;
+                    srtp_batch_.push_back(frame);
+                    srtp_batch_profiled_ = srtp_batch_profiled_ || profiled_;
+
+                    if (srtp_batch_.size() >= MAX_SRTP_BATCH_SIZE)
+                        flush_srtp_batch(rce_flags);
+                }
+                else {
+                    if (handlers->srtp.handler != nullptr) {
+                        if (profiled_)
+                            start = std::chrono::steady_clock::now();
+
+                        retval = handlers->srtp.handler(handlers->srtp.args, rce_flags, &ptr[0], size, &frame);
+
+                        if (profiled_)
+                            handlers->metrics->record_stage(uvgrtp::stream_metrics::STAGE_SRTP_NS, start);
+                    }
+                    finish_rtp_packet(handlers, rce_flags, retval, frame, &ptr[0], size);
+                }
+            }
+            else {
+                finish_rtp_packet(handlers, rce_flags, retval, frame, &ptr[0], size);
+            }
+        }
+        /* No SSRC match found -> Holepuncher or user packet */
+        else if (version == 0x3) {
+            UVG_LOG_DEBUG("Holepuncher packet");
+        }
+        /* DISABLED else {
+            return_user_pkt(&ptr[0], (uint32_t)size);
+        }*/
+    }
+    else {
+        /* No SSRC match found -> Holepuncher or user packet */
+        if (version == 0x3) {
+            UVG_LOG_DEBUG("Holepuncher packet");
+        }
+        /* DISABLED else {
+            return_user_pkt(&ptr[0], (uint32_t)size);
+        }*/
+    }
+    // the borrowed buffer is released with the frame, so the slot gets a new one
+    if (buffer_taken) {
+        slot.data = uvgrtp::frame_pool::alloc_payload(payload_size_);
+    }
+
+    // to make sure we don't process this packet again
+    slot.read = 0;
+}
+
+int uvgrtp::reception_flow::process_priority_packets(ssrc_demux<handler>::snapshot *table, int rce_flags)
+{
+    ring* r = read_ring_;
+    const ssize_t written = r->write_index.load(std::memory_order_acquire);
+
+    if (r->read_index == written)
+        return 0;
+
+    int processed_packets = 0;
+    ssize_t index = next_buffer_location(r, r->read_index);
+
+    for (;;) {
+        parse_headers_ahead(r, index);
+        const size_t count = headers_.count;
+
+        for (size_t h = 0; h < count; ++h) {
+            Buffer& slot = r->slots[header_slots_[h]];
+            bool rtcp_pkt = false;
+
+            if (slot.read <= 0)
+                continue;
+
+            // the forwarded packets keep their slots until they are sent, so they wait for the main pass
+            handler* handlers = find_handlers(table, slot, h, rtcp_pkt);
+            if (!handlers || handlers->forwarder)
+                continue;
+
+            if (handlers->priority > 0 || (rtcp_pkt && (rce_flags & RCE_RTCP_MUX))) {
+                process_slot(table, slot, h, rce_flags);
+                ++processed_packets;
             }
         }
+
+        ssize_t last = header_slots_[count - 1];
+        if (last == written)
+            break;
+
+        index = next_buffer_location(r, last);
     }
 
-    UVG_LOG_DEBUG("Total processed packets: %li", processed_packets);
+    // the frames of the high priority streams are returned before the rest is processed
+    flush_srtp_batch(rce_flags);
+    flush_ready_frames();
+
+    // the main pass parses the headers again from its own position
+    header_ring_ = nullptr;
+    return processed_packets;
 }
 
-ssize_t uvgrtp::reception_flow::next_buffer_location(ssize_t current_location)
+void uvgrtp::reception_flow::parse_headers_ahead(ring* r, ssize_t index)
 {
-/*
-#ifndef NDEBUG
-    if (current_location + 1 == ring_buffer_.size())
-    {
-        ssize_t read = ring_read_index_;
-        ssize_t write = last_ring_write_index_;
-        UVG_LOG_DEBUG("Ring buffer (%lli) rotation. R: %lli, W: %lli", ring_buffer_.size(), read, write);
+    const ssize_t written = r->write_index.load(std::memory_order_acquire);
+    size_t count = 0;
+
+    for (;;) {
+        const Buffer& slot = r->slots[index];
+
+        header_slots_[count]   = index;
+        header_packets_[count] = slot.data;
+        header_sizes_[count]   = (slot.read > 0) ? (size_t)slot.read : 0;
+        ++count;
+
+        if (index == written || count == MAX_HEADER_BATCH)
+            break;
+
+        index = next_buffer_location(r, index);
     }
-#endif // !NDEBUG
-*/
 
-    // rotates to beginning after buffer end
-    return (current_location + 1) % ring_buffer_.size();
+    uvgrtp::parse_headers(header_packets_, header_sizes_, count, headers_);
+    header_ring_ = r;
+    header_next_ = 0;
 }
 
-void uvgrtp::reception_flow::increase_buffer_size(ssize_t next_write_index)
+void uvgrtp::reception_flow::finish_rtp_packet(handler* handlers, int rce_flags, rtp_error_t retval,
+    uvgrtp::frame::rtp_frame* frame, uint8_t* ptr, size_t size)
 {
-    // create new buffer spaces if the process/read hasn't freed any spots on the ring buffer
-    if (next_write_index == ring_read_index_)
-    {
-        // increase the buffer size by 25%
-        ssize_t increase = ring_buffer_.size() / 4;
-        if (increase == 0) // just so there is some increase
-            ++increase;
-
-        UVG_LOG_DEBUG("Reception buffer ran out, increasing the buffer size: %lli -> %lli",
-            ring_buffer_.size(), ring_buffer_.size() + increase);
-        for (unsigned int i = 0; i < increase; ++i)
+    /* Update RTCP session statistics */
+    if (rce_flags & RCE_RTCP) {
+        if (handlers->rtcp_common.handler != nullptr) {
+            retval = handlers->rtcp_common.handler(handlers->rtcp_common.args, rce_flags, ptr, size, &frame);
+        }
+    }
+
+    /* If packet is ok, hand over to media handler */
+    if (retval != RTP_PKT_MODIFIED && retval != RTP_PKT_NOT_HANDLED)
+        return;
+
+    if (!handlers->reorder || !frame) {
+        deliver_media(handlers, rce_flags, retval, frame, ptr, size);
+        return;
+    }
+
+    // the packets handed on by the reorder buffer own their datagrams, which the media handler is given
+    uvgrtp::reorder_buffer *reorder = handlers->reorder.get();
+
+    reorder_ready_.clear();
+    reorder->push(frame, std::chrono::steady_clock::now(), reorder_ready_);
+
+    for (uvgrtp::frame::rtp_frame* ready : reorder_ready_) {
+        deliver_media(handlers, rce_flags, retval, ready, ready->dgram, ready->dgram_size);
+    }
+
+    if (reorder->holding()) {
+        if (std::find(reordering_.begin(), reordering_.end(), handlers->remote_ssrc) == reordering_.end())
+            reordering_.push_back(handlers->remote_ssrc);
+
+        reorder_deadline_ = std::min(reorder_deadline_, reorder->deadline());
+    }
+}
+
+void uvgrtp::reception_flow::deliver_media(handler* handlers, int rce_flags, rtp_error_t retval,
+    uvgrtp::frame::rtp_frame* frame, uint8_t* ptr, size_t size)
+{
+    if (handlers->media.handler && frame) {
+        std::chrono::steady_clock::time_point start;
+        if (profiled_)
+            start = std::chrono::steady_clock::now();
+
+        retval = handlers->media.handler(handlers->media.args, rce_flags, ptr, size, &frame);
+
+        if (profiled_)
+            handlers->metrics->record_stage(uvgrtp::stream_metrics::STAGE_REASSEMBLY_NS, start);
+    }
+    /* Last, if one or more packets are ready, return them to the user or to the jitter buffer */
+    complete_frames(handlers, retval, frame);
+}
+
+void uvgrtp::reception_flow::expire_reordered(ssrc_demux<handler>::snapshot *table, int rce_flags)
+{
+    if (reordering_.empty())
+        return;
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now < reorder_deadline_)
+        return;
+
+    reorder_deadline_ = std::chrono::steady_clock::time_point::max();
+
+    for (size_t i = 0; i < reordering_.size(); ) {
+        handler* handlers = table->find(reordering_[i]);
+
+        // the packets of a buffer that has been removed are freed with it
+        if (!handlers || !handlers->reorder || !handlers->reorder->holding()) {
+            reordering_.erase(reordering_.begin() + i);
+            continue;
+        }
+
+        // the sampled packet has been finished, the expired packets are not timed
+        profiled_ = false;
+
+        reorder_ready_.clear();
+        handlers->reorder->expire(now, reorder_ready_);
+
+        for (uvgrtp::frame::rtp_frame* ready : reorder_ready_) {
+            deliver_media(handlers, rce_flags, RTP_PKT_MODIFIED, ready, ready->dgram, ready->dgram_size);
+        }
+
+        if (handlers->reorder->holding()) {
+            reorder_deadline_ = std::min(reorder_deadline_, handlers->reorder->deadline());
+            ++i;
+        } else {
+            reordering_.erase(reordering_.begin() + i);
+        }
+    }
+}
+
+void uvgrtp::reception_flow::complete_frames(handler* handlers, rtp_error_t retval, uvgrtp::frame::rtp_frame* frame)
+{
+    /* If one or more packets are ready, return them to the user or to the jitter buffer */
+    if (retval == RTP_PKT_READY) {
+        if (handlers->metrics)
+            handlers->metrics->count(uvgrtp::stream_metrics::RECEIVED_FRAMES);
+
+        if (handlers->recorder && handlers->recorder->record(frame)) {
+            // the recorder writes and releases the frame
+        } else if (handlers->playout) {
+            handlers->playout(frame);
+        } else {
+            ready_frames_.push_back(frame);
+            ready_handlers_.push_back(handlers);
+        }
+    }
+    else if (retval == RTP_MULTIPLE_PKTS_READY) {
+        while (handlers->pipeline ? handlers->pipeline->next_frame(&frame) == RTP_PKT_READY
+            : (handlers->getter != nullptr && handlers->getter(&frame) == RTP_PKT_READY)) {
+            if (handlers->metrics)
+                handlers->metrics->count(uvgrtp::stream_metrics::RECEIVED_FRAMES);
+
+            if (handlers->recorder && handlers->recorder->record(frame)) {
+                // the recorder writes and releases the frame
+            } else if (handlers->playout) {
+                handlers->playout(frame);
+            } else {
+                ready_frames_.push_back(frame);
+                ready_handlers_.push_back(handlers);
+            }
+        }
+    }
+
+    if (ready_frames_.size() >= MAX_READY_FRAMES)
+        flush_ready_frames();
+}
+
+bool uvgrtp::reception_flow::forward_packet(handler* handlers, uint8_t* ptr, size_t size, int rce_flags)
+{
+    uvgrtp::forwarder* forwarder = handlers->forwarder.get();
+
+    int action = forwarder->forward(ptr, size);
+
+    if (action & RTP_FORWARD_SEND) {
+        // the shards of the socket share the forwarder, so each flow holds its own slots
+        if (std::find(forwarding_.begin(), forwarding_.end(), forwarder) == forwarding_.end())
+            forwarding_.push_back(forwarder);
+
+        /* In zero-copy mode a delivered packet may take the slot buffer over and release it
+         * with its frame, so the packet is sent before it goes to the handlers */
+        if ((action & RTP_FORWARD_DELIVER) && (rce_flags & RCE_RECEIVE_ZERO_COPY))
+            forwarder->flush();
+    }
+
+    return action & RTP_FORWARD_DELIVER;
+}
+
+void uvgrtp::reception_flow::flush_forwarding(ring* r, ssize_t position)
+{
+    if (forwarding_.empty())
+        return;
+
+    for (auto forwarder : forwarding_) {
+        forwarder->flush();
+    }
+
+    forwarding_.clear();
+    forward_held_ = 0;
+    r->read_index = position;
+}
+
+void uvgrtp::reception_flow::flush_srtp_batch(int rce_flags)
+{
+    if (srtp_batch_.empty())
+        return;
+
+    handler* handlers = srtp_batch_handlers_;
+
+    // a batch with a sampled packet is timed as a whole and counted as the average of its packets
+    const bool batch_profiled = srtp_batch_profiled_;
+    std::chrono::steady_clock::time_point start;
+    if (batch_profiled)
+        start = std::chrono::steady_clock::now();
+
+    handlers->srtp_batch(srtp_batch_, srtp_results_);
+
+    if (batch_profiled) {
+        handlers->metrics->record(uvgrtp::stream_metrics::STAGE_SRTP_NS,
+            (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count() / srtp_batch_.size());
+    }
+
+    // the ring slots may have been reused, so the handlers get the datagrams of the frames.
+    // Only the first packet of a sampled batch is timed in reassembly
+    const bool packet_profiled = profiled_;
+    for (size_t i = 0; i < srtp_batch_.size(); ++i) {
+        uvgrtp::frame::rtp_frame* frame = srtp_batch_[i];
+        profiled_ = batch_profiled && i == 0;
+        finish_rtp_packet(handlers, rce_flags, srtp_results_[i], frame, frame->dgram, frame->dgram_size);
+    }
+    profiled_ = packet_profiled;
+
+    srtp_batch_.clear();
+    srtp_batch_handlers_ = nullptr;
+    srtp_batch_profiled_ = false;
+}
+
+size_t uvgrtp::reception_flow::free_slots(ssize_t next_write_index) const
+{
+    ssize_t size = (ssize_t)write_ring_->slots.size();
+    ssize_t read = write_ring_->read_index;
+
+    // before anything has been processed, the processor is about to read slot 0
+    if (read < 0)
+        read = size - 1;
+
+    // the slot at read index may still be under processing, so it is not free
+    if (read >= next_write_index)
+        return (size_t)(read - next_write_index);
+
+    return (size_t)(size - next_write_index);
+}
+
+void uvgrtp::reception_flow::wait_for_room(int& spins)
+{
+    wake_processor();
+
+    if (++spins < RING_FULL_SPIN_COUNT)
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for(RING_FULL_SLEEP);
+}
+
+bool uvgrtp::reception_flow::packets_waiting() const
+{
+    const ring* r = read_ring_;
+    return r->read_index != r->write_index || r->next.load(std::memory_order_acquire) != nullptr;
+}
+
+void uvgrtp::reception_flow::check_watermark()
+{
+    const ring* r = write_ring_;
+    ssize_t size = (ssize_t)r->slots.size();
+
+    // the slots between the read and the write index wait for processing
+    ssize_t used = (r->write_index - r->read_index + size) % size;
+    bool above = used * 100 >= size * ring_watermark_;
+
+    if (above && !above_watermark_)
+        ring_watermark_events_.fetch_add(1, std::memory_order_relaxed);
+
+    above_watermark_ = above;
+
+    // the resizer clears the request when the receiver has taken the ring it allocated
+    if (above && resizer_ && !resize_requested_.exchange(true)) {
+        std::lock_guard<std::mutex> lg(resize_mtx_);
+        resize_cond_.notify_one();
+    }
+}
+
+void uvgrtp::reception_flow::resizer()
+{
+    size_t max_slots = (size_t)max_buffer_size_ / payload_size_;
+
+    while (!should_stop_) {
         {
-            ring_buffer_.insert(ring_buffer_.begin() + next_write_index, { new uint8_t[payload_size_] , -1 });
+            std::unique_lock<std::mutex> lk(resize_mtx_);
+            resize_cond_.wait(lk, [this] {
+                return should_stop_ || resize_requested_;
+            });
+        }
+
+        if (should_stop_)
+            break;
+
+        size_t slots = std::min(2 * ring_slots_.load(), max_slots);
+        ring* grown = create_ring(slots);
+
+        if (grown->slots.empty()) {
+            // resize_requested_ stays set, so the ring is not grown any further
+            destroy_ring(grown);
+            break;
         }
+        grown_ring_ = grown;
+
+        UVG_LOG_INFO("Reception ring buffer fell behind, growing it to %zu bytes", slots * payload_size_);
+
+        // this is the largest ring, so resize_requested_ is left set
+        if (slots >= max_slots)
+            break;
 
-        // this works, because we have just added increase amount of spaces
-        ring_read_index_ += increase;
+        // wait for the receiver to take the ring before it may ask for the next one
+        while (grown_ring_ && !should_stop_) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        resize_requested_ = false;
     }
 }
 
+void uvgrtp::reception_flow::wake_processor()
+{
+    if (processor_parked_)
+    {
+        std::lock_guard<std::mutex> lg(wait_mtx_);
+        process_cond_.notify_one();
+    }
+}
+
+ssize_t uvgrtp::reception_flow::next_buffer_location(const ring* r, ssize_t current_location)
+{
+/*
+#ifndef NDEBUG
+    if (current_location + 1 == r->slots.size())
+    {
+        ssize_t read = r->read_index;
+        ssize_t write = r->write_index;
+        UVG_LOG_DEBUG("Ring buffer (%lli) rotation. R: %lli, W: %lli", r->slots.size(), read, write);
+    }
+#endif // !NDEBUG
+*/
+
+    // rotates to beginning after buffer end
+    return (current_location + 1) % (ssize_t)r->slots.size();
+}
+
 int uvgrtp::reception_flow::clear_stream_from_flow(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc)
 {
-    std::scoped_lock hlg(hooks_mutex_, handlers_mutex_);
+    std::lock_guard<std::mutex> lg(handlers_mutex_);
     uint32_t ssrc = remote_ssrc.get()->load();
     // Clear all the data structures
-    hooks_.erase(ssrc);
     packet_handlers_.erase(ssrc);
+    publish_handlers();
+
+    size_t group_count = groups_.size();
+    groups_.erase(std::remove_if(groups_.begin(), groups_.end(),
+        [ssrc](const group_route& route) { return route.remote_ssrc == ssrc; }), groups_.end());
+
+    if (groups_.size() != group_count)
+        publish_groups();
+
+    size_t mid_count = mids_.size();
+    mids_.erase(std::remove_if(mids_.begin(), mids_.end(),
+        [&remote_ssrc](const mid_route& route) { return route.remote_ssrc == remote_ssrc; }), mids_.end());
+
+    if (mids_.size() != mid_count)
+        publish_mids();
     
     // If all the data structures are empty, return 1 which means that there is no streams left for this reception_flow
     // and it can be safely deleted
-    if (hooks_.empty() && packet_handlers_.empty()) {
+    if (packet_handlers_.empty()) {
         return 1;
     }
     return 0;
@@ -729,16 +2465,18 @@ int uvgrtp::reception_flow::clear_stream_from_flow(std::shared_ptr<std::atomic<s
 
 rtp_error_t uvgrtp::reception_flow::update_remote_ssrc(uint32_t old_remote_ssrc, uint32_t new_remote_ssrc)
 {
-    std::scoped_lock hlg(hooks_mutex_, handlers_mutex_);
+    std::lock_guard<std::mutex> lg(handlers_mutex_);
     if (packet_handlers_.find(old_remote_ssrc) != packet_handlers_.end()) {
         handler handlers = packet_handlers_[old_remote_ssrc];
         packet_handlers_.erase(old_remote_ssrc);
         packet_handlers_.insert({new_remote_ssrc, handlers});
-    }
-    if (hooks_.find(old_remote_ssrc) != hooks_.end()) {
-        receive_pkt_hook hook = hooks_[old_remote_ssrc];
-        hooks_.erase(old_remote_ssrc);
-        hooks_.insert({new_remote_ssrc, hook});
+        publish_handlers();
+
+        for (auto& route : groups_) {
+            if (route.remote_ssrc == old_remote_ssrc)
+                route.remote_ssrc = new_remote_ssrc;
+        }
+        publish_groups();
     }
     return RTP_OK;
 }
\ No newline at end of file
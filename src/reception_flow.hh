@@ -2,6 +2,15 @@
 
 #include "uvgrtp/util.hh"
 
+#include "arena.hh"
+#include "delivery_queue.hh"
+#include "header_batch.hh"
+#include "io_engine.hh"
+#include "pipeline.hh"
+#include "ssrc_demux.hh"
+#include "threads.hh"
+
+#include <chrono>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -12,10 +21,12 @@
 #include <atomic>
 #include <deque>
 #include <map>
+#include <string>
 
 #ifdef _WIN32
 #include <ws2ipdef.h>
 #else
+#include <netinet/in.h>
 #include <netinet/ip.h>
 #include <sys/socket.h>
 #endif
@@ -27,15 +38,25 @@ namespace uvgrtp {
     }
 
     class socket;
+    class capture_reader;
     class rtcp;
+    class io_engine;
+    class thread_settings;
+    class stream_metrics;
+    class forwarder;
+    class recorder;
+    class reorder_buffer;
+    class redundancy_merge;
 
-    typedef void (*recv_hook)(void* arg, uvgrtp::frame::rtp_frame* frame);
+    /* Most sockets a flow receives the copies of its streams from, see add_receive_path() */
+    constexpr size_t MAX_RECEIVE_PATHS = 4;
 
     typedef void (*user_hook)(void* arg, uint8_t* data, uint32_t len);
 
+    /* The receive hook of a stream, at most one of these is set */
     struct receive_pkt_hook {
-        void* arg = nullptr;
-        recv_hook hook = nullptr;
+        std::function<void(uvgrtp::frame::rtp_frame *)> frame;
+        std::function<void(uvgrtp::frame::rtp_frame **, size_t)> batch;
     };
 
     typedef rtp_error_t (*frame_getter)(void *, uvgrtp::frame::rtp_frame **);
@@ -52,6 +73,47 @@ namespace uvgrtp {
         packet_handler media;
         packet_handler rtcp_common;
         std::function<rtp_error_t(uvgrtp::frame::rtp_frame ** out)> getter;
+
+        /* If set, SRTP packets are collected into batches and verified and decrypted
+         * with one call instead of the "srtp" handler, see RCC_SRTP_DECRYPT_THREADS */
+        std::function<void(std::vector<uvgrtp::frame::rtp_frame *>&, std::vector<rtp_error_t>&)> srtp_batch;
+
+        /* If set, the complete frames are given to this instead of the user, see RCC_JITTER_BUFFER */
+        std::function<void(uvgrtp::frame::rtp_frame *)> playout;
+
+        /* The complete frames are given to this or, if it is not set, queued for pull_frame().
+         * The hook is published with the other handlers, so the frames are dispatched without locks */
+        receive_pkt_hook hook;
+
+        /* If set, the RTP packets are processed with this instead of the handlers above,
+         * unless the SRTP packets are collected for "srtp_batch" */
+        std::shared_ptr<uvgrtp::pipeline> pipeline;
+
+        /* If set, the received packets and frames of the stream are counted here */
+        std::shared_ptr<uvgrtp::stream_metrics> metrics;
+
+        /* If set, the RTP packets of the stream are given to this before the handlers above and
+         * only reach them if the forwarder returns RTP_FORWARD_DELIVER */
+        std::shared_ptr<uvgrtp::forwarder> forwarder;
+
+        /* If set, the complete frames are given to this before the application and only reach
+         * the application if the recorder does not take them, see media_stream::start_recording() */
+        std::shared_ptr<uvgrtp::recorder> recorder;
+
+        /* If set, the RTP packets are put back in order with this before the media handler, see
+         * RCC_REORDER_WINDOW_MS. The packets then go through the handlers above instead of "pipeline" */
+        std::shared_ptr<uvgrtp::reorder_buffer> reorder;
+
+        /* If set, the second copies of the RTP packets that arrive over the receive paths are
+         * dropped with this before any other handler, see media_stream::add_receive_path() */
+        std::shared_ptr<uvgrtp::redundancy_merge> merge;
+
+        /* The remote SSRC the handlers are installed with, set when they are published */
+        uint32_t remote_ssrc = 0;
+
+        /* The packets of a stream with a priority above 0 are processed ahead of the others
+         * that are waiting in the ring, see RCC_RECEIVE_PRIORITY */
+        int priority = 0;
     };
 
     /* This class handles the reception processing of received RTP packets. It 
@@ -83,7 +145,7 @@ namespace uvgrtp {
      * packet is assumed to be a user packet, in which case it is handed over to 
      * a user packet handler, provided that there is one installed. */
 
-    class reception_flow{
+    class reception_flow : public uvgrtp::io_handler {
         public:
             reception_flow(bool ipv6);
             ~reception_flow();
@@ -104,13 +166,110 @@ namespace uvgrtp {
             rtp_error_t install_getter(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
                 std::function<rtp_error_t(uvgrtp::frame::rtp_frame**)> getter);
 
+            /* Install a handler that is given batches of SRTP packets instead of the SRTP handler
+             * being called for each packet. An empty function removes the batch handler */
+            rtp_error_t install_srtp_batch_handler(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+                std::function<void(std::vector<uvgrtp::frame::rtp_frame *>&, std::vector<rtp_error_t>&)> handler);
+
+            /* Install a handler that takes the complete frames of the stream before they are returned
+             * to the user. The handler returns them later with return_frame(). An empty function
+             * removes the handler */
+            rtp_error_t install_playout_handler(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+                std::function<void(uvgrtp::frame::rtp_frame *)> handler);
+
+            /* Install the pipeline that processes the RTP packets of the stream, see uvgrtp::pipeline.
+             * nullptr removes the pipeline */
+            rtp_error_t install_pipeline(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+                std::shared_ptr<uvgrtp::pipeline> pipeline);
+
+            /* Process the packets of the stream ahead of the other streams of the socket if "priority"
+             * is above 0, see RCC_RECEIVE_PRIORITY */
+            rtp_error_t set_priority(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc, int priority);
+
+            /* Give the complete frames of the stream to "recorder", nullptr stops the recording */
+            rtp_error_t install_recorder(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+                std::shared_ptr<uvgrtp::recorder> recorder);
+
+            /* Count the received packets and frames of the stream in "metrics", see media_stream::get_stats() */
+            rtp_error_t install_metrics(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+                std::shared_ptr<uvgrtp::stream_metrics> metrics);
+
+            /* Put the RTP packets of the stream back in order with "buffer" before they are depacketized,
+             * nullptr removes the buffer, see RCC_REORDER_WINDOW_MS */
+            rtp_error_t install_reorder_buffer(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+                std::shared_ptr<uvgrtp::reorder_buffer> buffer);
+
+            /* Drop the second copies of the RTP packets of the stream with "merge", nullptr removes
+             * the merge, see RCC_REDUNDANCY_WINDOW */
+            rtp_error_t install_merge(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+                std::shared_ptr<uvgrtp::redundancy_merge> merge);
+
+            /* Forward the RTP packets of the stream with "forwarder" without depacketizing them,
+             * nullptr removes the forwarder, see media_stream::add_forward_target() */
+            rtp_error_t install_forwarder(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+                std::shared_ptr<uvgrtp::forwarder> forwarder);
+
+            /* Give the packets sent to the multicast group "group" to the stream of "remote_ssrc", whatever
+             * their SSRC, so that many groups can share the socket and its threads. Once a group has been
+             * added, the packets sent to the other groups are dropped. The destinations of the packets
+             * are known only if the socket tells them, see socket::enable_destination_addresses()
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if another stream has added the group */
+            rtp_error_t add_group(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc, const in6_addr& group);
+
+            /* Stop giving the packets of "group" to the stream of "remote_ssrc"
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_FOUND if the stream has not added the group */
+            rtp_error_t remove_group(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc, const in6_addr& group);
+
+            /* Give the packets whose MID header extension element, and RID element if "rid" is not empty,
+             * match to the stream of "remote_ssrc", so that the SSRCs of the streams sharing the socket need
+             * not be known in advance, RFC 8843 section 9.2. The elements have the IDs "mid_id" and "rid_id".
+             * The first packet of an SSRC that no stream receives from binds the SSRC to the stream of its
+             * MID, and "remote_ssrc" is set to it like with update_remote_ssrc(). A stream has one MID,
+             * adding another replaces it
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if another stream has added the same MID and RID */
+            rtp_error_t add_mid(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+                uint8_t mid_id, const std::string& mid, uint8_t rid_id, const std::string& rid);
+
+            /* Stop binding SSRCs to the stream of "remote_ssrc" by their MID */
+            void remove_mid(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc);
+
+            /* Number of times the receiver threads of the socket and its shards have found the
+             * ring buffer full and waited for the processing to make room */
+            uint64_t get_ring_full_events() const;
+
+            /* Number of times the rings of the socket and its shards have filled past the
+             * watermark, see set_ring_watermark() */
+            uint64_t get_ring_watermark_events() const;
+
+            /* Number of times the rings of the socket and its shards have been replaced with larger ones */
+            uint64_t get_ring_resizes() const;
+
+            /* Number of datagrams the kernel dropped from the sockets of this flow and its shards
+             * because their receive buffers were full, see uvgrtp::socket::kernel_drops() */
+            uint64_t get_kernel_drops() const;
+
             /* Remove all handlers associated with this SSRC */
             rtp_error_t remove_handlers(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc);
 
             /* Install receive hook in reception flow
              * Return RTP_OK on success
-             * Return RTP_INVALID_VALUE if "hook" is nullptr */
-            rtp_error_t install_receive_hook(void *arg, void (*hook)(void *, uvgrtp::frame::rtp_frame *), uint32_t remote_ssrc);
+             * Return RTP_INVALID_VALUE if "hook" is empty */
+            rtp_error_t install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame *)> hook, uint32_t remote_ssrc);
+
+            /* Same as install_receive_hook(), but if "replace" is false, a receive hook the stream
+             * already has is kept and RTP_INVALID_VALUE is returned instead */
+            rtp_error_t install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame *)> hook, uint32_t remote_ssrc,
+                bool replace);
+
+            /* Same as install_receive_hook(), but the frames processed together are given to "hook" at once */
+            rtp_error_t install_receive_batch_hook(std::function<void(uvgrtp::frame::rtp_frame **, size_t)> hook,
+                uint32_t remote_ssrc);
 
             /* Start the RTP reception flow. Start querying for received packets and processing them.
              *
@@ -124,6 +283,19 @@ namespace uvgrtp {
              * Return RTP_OK on success */
             rtp_error_t stop();
 
+            /* Give the UDP datagrams of "reader" that were sent to "port" to the packet processing
+             * as if the socket had received them. The gaps between the datagrams are kept, shortened
+             * "speed" times, and if "speed" is 0 the datagrams are given as fast as they are processed.
+             * The receiver thread writes the datagrams to the ring and reads the socket again after
+             * the replay. Blocks until all datagrams have been given to the processing
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_INITIALIZED if the flow has not been started
+             * Return RTP_NOT_SUPPORTED if the packets of the flow are read by the I/O engine
+             * Return RTP_INTERRUPTED if the flow was stopped before the replay finished
+             * Return RTP_INVALID_VALUE if the capture file is corrupted */
+            rtp_error_t replay(uvgrtp::capture_reader& reader, uint16_t port, double speed);
+
             /* Fetch frame from the frame queue that contains all received frame.
              * pull_frame() will block until there is a frame that can be returned.
              * If "timeout" is given, pull_frame() will block only for however long
@@ -138,6 +310,16 @@ namespace uvgrtp {
             uvgrtp::frame::rtp_frame* pull_frame(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc);
             uvgrtp::frame::rtp_frame* pull_frame(ssize_t timeout_ms, std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc);
 
+            /* Wait up to "timeout_ms" for a frame and take up to "max_frames" frames to "frames".
+             * If "remote_ssrc" is given, only the frames of that source are taken
+             *
+             * Return the number of frames taken */
+            size_t pull_frames(uvgrtp::frame::rtp_frame **frames, size_t max_frames, ssize_t timeout_ms,
+                std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc);
+
+            /* The queue of the frames that wait for pull_frame() */
+            uvgrtp::delivery_queue& get_delivery_queue();
+
             /* Clear the packet handlers associated with this REMOTE SSRC
              * Also clear the hooks associated with this remote_ssrc
              * 
@@ -154,86 +336,427 @@ namespace uvgrtp {
             /// \cond DO_NOT_DOCUMENT
             void set_buffer_size(const ssize_t& value);
             ssize_t get_buffer_size() const;
+
+            /* Let the ring grow up to "value" bytes in the background when it fills past the
+             * watermark, 0 keeps the ring at its size */
+            void set_max_buffer_size(const ssize_t& value);
+            ssize_t get_max_buffer_size() const;
+
+            /* Fill level of the ring in percent at which it counts as falling behind */
+            void set_ring_watermark(int percent);
+            int get_ring_watermark() const;
             void set_payload_size(const size_t& value);
             void set_poll_timeout_ms(int timeout_ms);
             int get_poll_timeout_ms();
+            rtp_error_t set_recv_batch_size(int batch_size);
+            int get_recv_batch_size() const;
+            void set_inline_processing(bool enabled);
+            bool get_inline_processing() const;
+
+            /* If the engine is running when the flow is started, the socket is read and
+             * its packets processed by the engine's event loops instead of own threads */
+            void set_io_engine(std::shared_ptr<uvgrtp::io_engine> engine);
+
+            /* Configurations of the reception threads started afterwards */
+            void set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings);
+
+            /* Called by the I/O engine when the socket has data to read */
+            size_t handle_readable(size_t budget) override;
+
+            /* Receive also from "socket", which is bound to the same port with SO_REUSEPORT.
+             * The packets of the socket are read and processed by threads of their own
+             * pinned to "core", or unpinned if "core" is negative, and dispatched with the
+             * handlers of this flow. The frames are returned through this flow */
+            void add_shard(std::shared_ptr<uvgrtp::socket> socket, int core);
+
+            /* Receive also from "socket", which is bound to an address of another network. Its
+             * datagrams are read by the receiver thread of this flow into the same ring as those of
+             * the socket of the flow, so the copies of a packet that arrive over both are processed
+             * by one thread. A socket added while the flow is running is polled within the poll
+             * timeout. Not supported for a flow driven by the I/O engine or with shards */
+            rtp_error_t add_receive_path(std::shared_ptr<uvgrtp::socket> socket);
+            void remove_receive_path(std::shared_ptr<uvgrtp::socket> socket);
+
+            /* The sockets of add_shard() */
+            std::vector<std::shared_ptr<uvgrtp::socket>> get_shard_sockets();
+
+            /* Pin the reception threads of this flow to "core" when they are started */
+            void set_core(int core);
+
+            /* Return a processed RTP frame to user either through frame queue or receive hook.
+             * The hook is looked up under handlers_mutex_, the frames completed by the packet
+             * processing are returned with the handlers they were processed with instead */
+            void return_frame(uvgrtp::frame::rtp_frame *frame);
 
             // DISABLED rtp_error_t install_user_hook(void* arg, void (*hook)(void*, uint8_t* data, uint32_t len));
             /// \endcond
 
         private:
-            /* RTP packet receiver thread */
-            void receiver(std::shared_ptr<uvgrtp::socket> socket);
+            struct ring;
+            struct Buffer;
+
+            /* RTP packet receiver thread. In inline mode this thread also processes the packets */
+            void receiver(std::shared_ptr<uvgrtp::socket> socket, int rce_flags);
 
             /* RTP packet dispatcher thread */
             void process_packet(int rce_flags);
 
-            /* Return a processed RTP frame to user either through frame queue or receive hook */
-            void return_frame(uvgrtp::frame::rtp_frame *frame);
+            /* A replay given to the receiver thread, see replay() */
+            struct replay_job {
+                uvgrtp::capture_reader *reader;
+                uint16_t port;
+                double speed;
+                rtp_error_t result;
+                bool done;
+            };
+
+            /* Called by the receiver thread: run the replay that waits for it, if there is one */
+            void serve_replay(int rce_flags);
+
+            /* Write the datagrams of the replay to the ring. Return the result of replay() */
+            rtp_error_t run_replay(replay_job& job, int rce_flags);
+
+            /* Called by the receiver: move on to the larger ring if the resizer has one ready,
+             * the processor follows after it has finished the packets of the current ring */
+            void take_grown_ring();
+
+            /* Read everything the socket has into the ring, or about "budget" packets if it is not 0.
+             * Return the number of read packets */
+            int read_available_packets(std::shared_ptr<uvgrtp::socket> socket, int rce_flags, size_t budget = 0);
+
+            /* Hand all packets between the read and write index of the ring over to the
+             * handlers. Return the number of processed packets */
+            int process_available_packets(int rce_flags);
+
+            /* Find the handlers of the packet in "slot" from its parsed headers "h". "rtcp_pkt" tells
+             * whether the SSRC of the packet was found as the one of an RTCP packet */
+            handler* find_handlers(ssrc_demux<handler>::snapshot *table, const Buffer& slot, size_t h, bool& rtcp_pkt);
+
+            /* Give the packet in "slot" to its handlers and mark the slot processed */
+            void process_slot(ssrc_demux<handler>::snapshot *table, Buffer& slot, size_t h, int rce_flags);
+
+            /* Process the packets of the high priority streams and the multiplexed RTCP packets
+             * of the read ring and return their frames, leaving the other packets to the main pass.
+             * Return the number of processed packets */
+            int process_priority_packets(ssrc_demux<handler>::snapshot *table, int rce_flags);
+
+            /* Update the RTCP statistics with an RTP packet that has passed the SRTP handler
+             * and give it to the media handler */
+            void finish_rtp_packet(handler* handlers, int rce_flags, rtp_error_t retval,
+                uvgrtp::frame::rtp_frame* frame, uint8_t* ptr, size_t size);
+
+            /* Give an RTP packet to the media handler of "handlers" and its frames to complete_frames() */
+            void deliver_media(handler* handlers, int rce_flags, rtp_error_t retval,
+                uvgrtp::frame::rtp_frame* frame, uint8_t* ptr, size_t size);
+
+            /* Hand on the packets that the reorder buffers have held for their window and find
+             * when the next held packet is due, see RCC_REORDER_WINDOW_MS */
+            void expire_reordered(ssrc_demux<handler>::snapshot *table, int rce_flags);
+
+            /* Verify and decrypt the collected SRTP packets and finish them in order */
+            void flush_srtp_batch(int rce_flags);
+
+            /* Give an RTP packet to the forwarder of "handlers". Return whether the packet
+             * should also be given to the handlers of the stream */
+            bool forward_packet(handler* handlers, uint8_t* ptr, size_t size, int rce_flags);
+
+            /* Send the packets queued to the forwarders and let the receiver reuse the slots up to
+             * "position" of ring "r", which the queued packets kept from being reused */
+            void flush_forwarding(ring* r, ssize_t position);
+
+            /* Give the frames that the stream of "handlers" completed to the jitter buffer or the user */
+            void complete_frames(handler* handlers, rtp_error_t retval, uvgrtp::frame::rtp_frame* frame);
+
+            /* Return the frames completed while processing the available packets. The consecutive
+             * frames of a stream with a batch hook are given to the hook in one call */
+            void flush_ready_frames();
+
+            /* Parse the headers of the written slots of ring "r" from "index" on, at most
+             * MAX_HEADER_BATCH of them, see header_batch.hh */
+            void parse_headers_ahead(ring* r, ssize_t index);
 
             //void return_user_pkt(uint8_t* pkt, uint32_t len);
 
-            inline void increase_buffer_size(ssize_t next_write_index);
+            inline ssize_t next_buffer_location(const ring* r, ssize_t current_location);
+
+            /* Return how many consecutive slots starting from "next_write_index" the receiver
+             * can write to without overwriting unprocessed packets or going over the ring end */
+            size_t free_slots(ssize_t next_write_index) const;
+
+            /* Called by the processor: whether the ring it reads has packets or has been replaced */
+            bool packets_waiting() const;
+
+            /* Called by the receiver after writing to the ring: count the ring filling past the
+             * watermark and ask the resizer for a larger ring if the ring may still grow */
+            void check_watermark();
 
-            inline ssize_t next_buffer_location(ssize_t current_location);
+            /* Background thread that allocates the larger rings that check_watermark() asks for */
+            void resizer();
+
+            /* Wake up the processing thread if it is sleeping */
+            void wake_processor();
+
+            /* Called by the receiver when the ring is full. "spins" counts the calls of one wait */
+            void wait_for_room(int& spins);
+
+            /* Publish packet_handlers_ to the packet processing of this flow and its shards.
+             * Called with handlers_mutex_ held */
+            void publish_handlers();
+
+            /* Stop the threads if they are running, reallocate the ring and start them again */
+            void resize_ring_buffer(ssize_t buffer_size, size_t payload_size);
+
+            /* Allocate a ring of "elements" slots. The ring has no slots if the allocation fails */
+            ring* create_ring(size_t elements);
+            void destroy_ring(ring* r);
 
             void create_ring_buffer();
             void destroy_ring_buffer();
 
+            /* Drop the packets of the rings and start again from the beginning of the newest ring.
+             * Called when the threads are not running */
+            void reset_ring_buffer();
+
             void clear_frames();
 
             /* If receive hook has not been installed, frames are pushed to "frames_"
              * and they can be retrieved using pull_frame() */
-            std::deque<uvgrtp::frame::rtp_frame *> frames_;
-            std::mutex frames_mtx_;
-
-            //void *recv_hook_arg_;
-            //void (*recv_hook_)(void *arg, uvgrtp::frame::rtp_frame *frame);
-
-            std::unordered_map<uint32_t, receive_pkt_hook> hooks_;
+            uvgrtp::delivery_queue frames_;
 
             std::mutex flow_mutex_;
-            bool should_stop_;
+            std::atomic<bool> should_stop_;
 
             std::unique_ptr<std::thread> receiver_;
+
+            // wakes the receiver thread from poll(2) when the flow is stopped
+            uvgrtp::stop_event stop_event_;
             std::unique_ptr<std::thread> processor_;
+            std::unique_ptr<std::thread> resizer_;
 
             // from/from6 is the IP address that this packet came from
             struct Buffer
             {
                 uint8_t* data;
                 int read;
+                uint64_t recv_time; // see uvgrtp::frame::rtp_frame::recv_time
+                in6_addr destination; // see socket::recv_destination(), set if the flow has groups
                 //sockaddr_in6 from6;
                 //sockaddr_in from;
             };
 
+            /* The ring buffer between the receiver and the processor. The ring is a single-producer/
+             * single-consumer queue: only the receiver thread writes "write_index" and only the processor
+             * thread writes "read_index". They are kept on separate cache lines so that the two threads
+             * do not invalidate each other's cache when updating them.
+             *
+             * A ring is never resized. To grow, the receiver moves on to a larger ring and sets "next"
+             * after its last write to the old one. The processor finishes the packets of the old ring,
+             * follows "next" and releases the old ring, so neither thread waits for the other */
+            struct ring
+            {
+                /* All slots are allocated from one contiguous arena so that coalesced UDP GRO
+                 * datagrams can be split into consecutive slots in place. The slots are "slot_size"
+                 * bytes apart, which is the payload size rounded up to whole cache lines */
+                uvgrtp::arena memory;
+                size_t slot_size = 0;
+                std::vector<Buffer> slots;
+
+                alignas(64) std::atomic<ssize_t> read_index{ -1 }; // invalid first index that will increase to a valid one
+                alignas(64) std::atomic<ssize_t> write_index{ -1 };
+                std::atomic<ring*> next{ nullptr };
+            };
+
             void* user_hook_arg_;
             void (*user_hook_)(void* arg, uint8_t* data, uint32_t len);
 
-            // Map different types of handlers by remote SSRC
+            // Map different types of handlers by remote SSRC, guarded by handlers_mutex_
             std::unordered_map<uint32_t, handler> packet_handlers_;
 
+            /* Copy of packet_handlers_ that the packets are dispatched with */
+            ssrc_demux<handler> demux_;
+
+            /* Set while a stream of the flow has a priority, see process_priority_packets() */
+            std::atomic<bool> has_priorities_;
+
+            /* Set while a stream of the flow is profiled, see RCC_PROFILE_SAMPLING. "profiled_" is set
+             * while a sampled packet is processed and "srtp_batch_profiled_" while the SRTP batch
+             * has a sampled packet */
+            std::atomic<bool> has_profiling_;
+            bool profiled_ = false;
+            bool srtp_batch_profiled_ = false;
+
+            /* A multicast group and the remote SSRC of the stream that its packets are given to */
+            struct group_route {
+                in6_addr group;
+                uint32_t remote_ssrc;
+            };
+
+            /* Publish the groups to the processing of this flow and its shards */
+            void publish_groups();
+
+            /* The handlers of the stream that added the group "destination", nullptr if there is none */
+            handler *find_group_handlers(ssrc_demux<handler>::snapshot *table, const in6_addr& destination);
+
+            /* The groups of add_group(), guarded by handlers_mutex_ */
+            std::vector<group_route> groups_;
+
+            /* Copy of groups_ by the 32-bit fold of the group address that the packets are
+             * dispatched with. "has_groups_" is set while there are groups */
+            ssrc_demux<std::vector<group_route>> group_demux_;
+            std::atomic<bool> has_groups_;
+
+            /* The MID and RID of a stream of add_mid() */
+            struct mid_route {
+                std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc;
+                uint8_t mid_id;
+                std::string mid;
+                uint8_t rid_id;
+                std::string rid;
+            };
+
+            /* Publish the MIDs to the processing of this flow and its shards */
+            void publish_mids();
+
+            /* The handlers of the stream of the MID of a packet whose SSRC no stream receives from,
+             * which binds the SSRC to the stream. nullptr if the MID has no stream */
+            handler *find_mid_handlers(ssrc_demux<handler>::snapshot *table, const Buffer& slot, size_t h);
+
+            /* Move the handlers of the stream of "remote_ssrc" to "ssrc" for find_mid_handlers().
+             * Return false if the handlers are being changed at the same time, the next packet tries again */
+            bool bind_ssrc(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc, uint32_t old_ssrc, uint32_t ssrc);
+
+            /* The MIDs of add_mid(), guarded by handlers_mutex_ */
+            std::vector<mid_route> mids_;
+
+            /* Copy of mids_ that the packets are dispatched with. "has_mids_" is set while there are MIDs */
+            std::shared_ptr<const std::vector<mid_route>> mid_routes_;
+            std::atomic<bool> has_mids_;
+
+            /* Flows of the other sockets of a sharded port, see add_shard(). A shard has
+             * no handlers or hooks of its own and "lead_" is the flow that it belongs to */
+            struct shard {
+                std::unique_ptr<reception_flow> flow;
+                std::shared_ptr<uvgrtp::socket> socket;
+            };
+            std::vector<shard> shards_;
+            reception_flow* lead_;
+
+            /* CPU core of the reception threads, -1 if they are not pinned */
+            int core_;
+
+            /* SRTP packets of one stream waiting for its batch handler, only
+             * touched by the thread that processes the packets */
+            std::vector<uvgrtp::frame::rtp_frame *> srtp_batch_;
+            std::vector<rtp_error_t> srtp_results_;
+            handler* srtp_batch_handlers_;
+
+            /* The sockets of add_receive_path(), replaced as a whole under active_mutex_ and read by the
+             * receiver thread */
+            std::shared_ptr<const std::vector<std::shared_ptr<uvgrtp::socket>>> receive_paths_;
+
+            /* The remote SSRCs of the streams whose reorder buffers hold packets, when the first of
+             * them is due and the packets being handed on, only touched by the thread that processes
+             * the packets */
+            std::vector<uint32_t> reordering_;
+            std::chrono::steady_clock::time_point reorder_deadline_ = std::chrono::steady_clock::time_point::max();
+            std::vector<uvgrtp::frame::rtp_frame *> reorder_ready_;
+
+            /* Forwarders with queued packets and the number of processed slots that the receiver has
+             * not been allowed to reuse since, only touched by the thread that processes the packets */
+            std::vector<uvgrtp::forwarder *> forwarding_;
+            size_t forward_held_;
+
+            /* The headers of the slots being processed, parsed in one go so that the demultiplexing and
+             * the statistics read them from arrays. "header_slots_" are the slot indexes of "header_ring_"
+             * they were parsed from and "header_next_" the next one to process, only touched by the
+             * thread that processes the packets */
+            uvgrtp::header_batch headers_;
+            ring* header_ring_;
+            ssize_t header_slots_[MAX_HEADER_BATCH];
+            uint8_t* header_packets_[MAX_HEADER_BATCH];
+            size_t header_sizes_[MAX_HEADER_BATCH];
+            size_t header_next_;
+
+            /* Frames completed by the thread that processes the packets and the handlers of
+             * their streams, returned at once before the handler snapshot is left */
+            std::vector<uvgrtp::frame::rtp_frame *> ready_frames_;
+            std::vector<handler *> ready_handlers_;
+
             int poll_timeout_ms_;
 
-            std::vector<Buffer> ring_buffer_;
+            /* How many packets are read from the socket with one recvmmsg() call */
+            int recv_batch_size_;
+
+            /* Packets are processed in the receiver thread and no processor thread is created */
+            bool inline_processing_;
+
+            std::shared_ptr<uvgrtp::io_engine> io_engine_;
+            std::shared_ptr<uvgrtp::thread_settings> thread_settings_;
+
+            /* The socket has been given to the I/O engine and this flow has no threads running */
+            bool engine_driven_;
+
+            /* RCE_RECEIVE_ZERO_COPY: ring slots are separate frame pool buffers that
+             * received frames may take over */
+            bool zero_copy_;
+
+            /* The ring that the receiver writes to and the ring that the processor reads from.
+             * They are the same ring except after the receiver has moved on to a larger ring,
+             * in which case the rings in between are linked with ring::next. The processor
+             * releases the rings it has finished */
+            ring* write_ring_;
+            ring* read_ring_;
+
+            /* A larger ring allocated by the resizer thread and not yet taken by the receiver */
+            std::atomic<ring*> grown_ring_;
+
+            /* Number of slots of the ring that the receiver writes to */
+            std::atomic<size_t> ring_slots_;
+
             std::mutex handlers_mutex_;
-            std::mutex ring_mutex_;
             std::mutex active_mutex_;
-            std::mutex hooks_mutex_;
 
-            // these uphold the ring buffer details
-            std::atomic<ssize_t> ring_read_index_;
-            std::atomic<ssize_t> last_ring_write_index_;
+            /* The processor thread spins for a while before it goes to sleep. The receiver
+             * only notifies the condition variable if the processor is sleeping */
+            alignas(64) std::atomic<bool> processor_parked_;
 
             std::mutex wait_mtx_; // for waking up the processing thread (read)
 
             std::condition_variable process_cond_;
             std::shared_ptr<uvgrtp::socket> socket_;
+            int rce_flags_;
 
             ssize_t buffer_size_kbytes_;
             size_t payload_size_;
+
+            /* The ring grows up to "max_buffer_size_" bytes when it fills past "ring_watermark_"
+             * percent, see check_watermark(). The receiver sets "resize_requested_" and the
+             * resizer clears it when the ring it allocated has been published in "grown_ring_" */
+            ssize_t max_buffer_size_;
+            int ring_watermark_;
+            bool above_watermark_;
+            std::atomic<bool> resize_requested_;
+            std::mutex resize_mtx_;
+            std::condition_variable resize_cond_;
             bool active_;
             bool ipv6_;
+
+            /* UDP Generic Receive Offload has been enabled for the socket */
+            bool gro_;
+
+            /* The replay waiting for the receiver thread or being run by it. "replay_pending_" lets
+             * the receiver check for a replay without taking the mutex */
+            std::mutex replay_mtx_;
+            std::condition_variable replay_cond_;
+            replay_job *replay_job_;
+            std::atomic<bool> replay_pending_;
+
+            /* Written by the receiver thread, see get_ring_full_events() */
+            std::atomic<uint64_t> ring_full_events_;
+            std::atomic<uint64_t> ring_watermark_events_;
+
+            /* Written by the receiver thread when it moves on to a larger ring */
+            std::atomic<uint64_t> ring_resizes_;
     };
 }
 
@@ -0,0 +1,273 @@
+#include "recorder.hh"
+
+#include "debug.hh"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+uvgrtp::recorder::recorder() :
+    queue_(RECORDER_QUEUE_SIZE),
+#ifdef _WIN32
+    file_(nullptr),
+#else
+    fd_(-1),
+    allocated_(0),
+#endif
+    index_(nullptr),
+    offset_(0),
+    batch_(RECORDER_BATCH_SIZE),
+    writer_(nullptr),
+    running_(false),
+    recording_(0),
+    deliver_(false),
+    dropped_(0),
+    written_(0)
+{
+    static_assert((RECORDER_QUEUE_SIZE & (RECORDER_QUEUE_SIZE - 1)) == 0, "the queue size must be a power of two");
+}
+
+uvgrtp::recorder::~recorder()
+{
+    stop();
+}
+
+rtp_error_t uvgrtp::recorder::start(const std::string& path, int flags)
+{
+    if (flags & ~RTP_RECORD_DELIVER) {
+        UVG_LOG_ERROR("Invalid recording flags: %d", flags);
+        return RTP_INVALID_VALUE;
+    }
+
+    if (running_)
+        return RTP_INITIALIZED;
+
+#ifdef _WIN32
+    file_ = std::fopen(path.c_str(), "wb");
+    bool created = file_ != nullptr;
+#else
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool created = fd_ != -1;
+#endif
+    std::string index_path = path + ".idx";
+
+    if (!created || !(index_ = std::fopen(index_path.c_str(), "wb")) ||
+        std::fwrite(&RECORDER_INDEX_MAGIC, sizeof(RECORDER_INDEX_MAGIC), 1, index_) != 1) {
+        UVG_LOG_ERROR("Failed to create the recording %s", path.c_str());
+        stop();
+        return RTP_GENERIC_ERROR;
+    }
+
+    offset_  = 0;
+    deliver_ = (flags & RTP_RECORD_DELIVER) != 0;
+    running_ = true;
+    writer_  = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::recorder::writer, this));
+
+    UVG_LOG_INFO("Recording the frames of the stream to %s", path.c_str());
+    return RTP_OK;
+}
+
+void uvgrtp::recorder::stop()
+{
+    running_ = false;
+
+    // a frame that is being queued is queued before the writer finishes
+    while (recording_.load() > 0)
+        std::this_thread::yield();
+
+    if (writer_ && writer_->joinable())
+        writer_->join();
+    writer_ = nullptr;
+
+#ifdef _WIN32
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+#else
+    if (fd_ != -1) {
+        // the preallocated space after the last frame is not part of the recording
+        if (ftruncate(fd_, (off_t)offset_) != 0)
+            UVG_LOG_WARN("Failed to trim the recording: %d", errno);
+
+        close(fd_);
+        fd_ = -1;
+        allocated_ = 0;
+    }
+#endif
+
+    if (index_) {
+        std::fclose(index_);
+        index_ = nullptr;
+
+        if (dropped_)
+            UVG_LOG_WARN("%lu frames were left out of the recording, the writer fell behind", (unsigned long)dropped_);
+    }
+}
+
+uint64_t uvgrtp::recorder::dropped() const
+{
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+uint64_t uvgrtp::recorder::written() const
+{
+    return written_.load(std::memory_order_relaxed);
+}
+
+bool uvgrtp::recorder::record(uvgrtp::frame::rtp_frame *frame)
+{
+    recording_.fetch_add(1);
+
+    if (!running_.load()) {
+        recording_.fetch_sub(1);
+        return false;
+    }
+
+    size_t position = 0;
+    slot *s = queue_.reserve(position);
+    if (!s) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        recording_.fetch_sub(1);
+        return false;
+    }
+
+    s->timestamp = frame->header.timestamp;
+    s->recv_time = frame->recv_time;
+
+    if (deliver_) {
+        s->frame = nullptr;
+        s->copy.assign(frame->payload, frame->payload + frame->payload_len);
+    } else {
+        s->frame = frame;
+    }
+    queue_.publish(position);
+    recording_.fetch_sub(1);
+
+    return !deliver_;
+}
+
+void uvgrtp::recorder::writer()
+{
+    for (;;) {
+        size_t count = 0;
+
+        while (count < batch_.size()) {
+            slot *s = queue_.front();
+            if (!s)
+                break;
+
+            std::swap(batch_[count++], *s);
+            queue_.pop();
+        }
+
+        if (count > 0) {
+            write_batch(count);
+            continue;
+        }
+
+        // the queue is empty. The frames queued before stop() have been written
+        if (!running_)
+            break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::fflush(index_);
+}
+
+void uvgrtp::recorder::write_batch(size_t count)
+{
+    size_t bytes = 0;
+
+#ifdef _WIN32
+    for (size_t i = 0; i < count; ++i) {
+        const slot& s = batch_[i];
+        const uint8_t *data = s.frame ? s.frame->payload : s.copy.data();
+        size_t size = s.frame ? s.frame->payload_len : s.copy.size();
+
+        if (size > 0 && std::fwrite(data, size, 1, file_) != 1) {
+            UVG_LOG_ERROR("Failed to write the recording");
+            count = i;
+            break;
+        }
+        bytes += size;
+    }
+#else
+    struct iovec iov[RECORDER_BATCH_SIZE];
+
+    for (size_t i = 0; i < count; ++i) {
+        const slot& s = batch_[i];
+
+        iov[i].iov_base = s.frame ? s.frame->payload : (uint8_t *)s.copy.data();
+        iov[i].iov_len  = s.frame ? s.frame->payload_len : s.copy.size();
+        bytes += iov[i].iov_len;
+    }
+
+#ifdef __linux__
+    // the file is extended in large steps, so the file system does not allocate space for every write
+    if (offset_ + bytes > allocated_) {
+        uint64_t size = ((offset_ + bytes) / RECORDER_PREALLOCATION + 1) * RECORDER_PREALLOCATION;
+
+        if (fallocate(fd_, FALLOC_FL_KEEP_SIZE, (off_t)allocated_, (off_t)(size - allocated_)) == 0)
+            allocated_ = size;
+    }
+#endif
+
+    size_t done = 0;
+    size_t first = 0;
+
+    while (first < count) {
+        ssize_t ret = pwritev(fd_, &iov[first], (int)(count - first), (off_t)(offset_ + done));
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+
+            UVG_LOG_ERROR("Failed to write the recording: %d", errno);
+            break;
+        }
+
+        // a partial write continues from the first byte that was not written
+        done += (size_t)ret;
+        while (first < count && (size_t)ret >= iov[first].iov_len) {
+            ret -= (ssize_t)iov[first].iov_len;
+            ++first;
+        }
+
+        if (first < count) {
+            iov[first].iov_base = (uint8_t *)iov[first].iov_base + ret;
+            iov[first].iov_len -= (size_t)ret;
+        }
+    }
+
+    // only the frames that were written in full are in the index
+    count = first;
+    bytes = done;
+#endif
+
+    uint64_t offset = offset_;
+    for (size_t i = 0; i < count; ++i) {
+        slot& s = batch_[i];
+        uint32_t size = (uint32_t)(s.frame ? s.frame->payload_len : s.copy.size());
+        recorder_index_entry entry = { offset, s.recv_time, size, s.timestamp };
+
+        (void)std::fwrite(&entry, sizeof(entry), 1, index_);
+        offset += size;
+    }
+    offset_ += bytes;
+    written_.fetch_add(count, std::memory_order_relaxed);
+
+    for (auto& s : batch_) {
+        if (s.frame) {
+            (void)uvgrtp::frame::dealloc_frame(s.frame);
+            s.frame = nullptr;
+        }
+    }
+}
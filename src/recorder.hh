@@ -0,0 +1,117 @@
+#pragma once
+
+#include "mpsc_queue.hh"
+
+#include "uvgrtp/frame.hh"
+#include "uvgrtp/util.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* How many frames can wait for the writer of a recording */
+    const size_t RECORDER_QUEUE_SIZE = 1024;
+
+    /* How many frames the writer of a recording writes with one call */
+    const size_t RECORDER_BATCH_SIZE = 64;
+
+    /* The file of a recording grows in steps of this many bytes, so it is not extended by every write */
+    const size_t RECORDER_PREALLOCATION = 64 * 1024 * 1024;
+
+    /* Magic of the index file of a recording, "UVGRIDX1" */
+    const uint64_t RECORDER_INDEX_MAGIC = 0x3158444952475655ULL;
+
+    /* An entry of the index file of a recording, in the byte order of the system that wrote it */
+    struct recorder_index_entry {
+        uint64_t offset;
+        uint64_t recv_time;
+        uint32_t size;
+        uint32_t timestamp;
+    };
+
+    /* Writes the received frames of a stream to a file, see media_stream::start_recording().
+     *
+     * The processing thread of the stream queues the frames into a bounded lock-free queue and
+     * a thread of the recorder appends their payloads to the file and an entry for each to the
+     * index file, so recording does not add copies or system calls to the reception. Without
+     * RTP_RECORD_DELIVER the queued frame itself is written and released by the writer. With it,
+     * the payload is copied into the queue and the frame is still given to the application. A
+     * frame is left out of the recording if the queue is full, see dropped() */
+    class recorder {
+        public:
+            recorder();
+            ~recorder();
+
+            recorder(const recorder&) = delete;
+            recorder& operator=(const recorder&) = delete;
+
+            /* Create the file "path" and its index "path".idx and start the writer
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "flags" is not valid
+             * Return RTP_GENERIC_ERROR if the files cannot be created */
+            rtp_error_t start(const std::string& path, int flags);
+
+            /* Write the queued frames, trim the preallocated space off the file and close the files */
+            void stop();
+
+            /* Queue "frame" for the file. Return true if the recorder took the frame,
+             * false if it must still be given to the application. Never blocks */
+            bool record(uvgrtp::frame::rtp_frame *frame);
+
+            /* Number of frames left out of the recording because the queue was full */
+            uint64_t dropped() const;
+
+            /* Number of frames written to the file */
+            uint64_t written() const;
+
+        private:
+            /* A queued frame. "frame" is set if the recorder owns the frame, otherwise
+             * the payload is in "copy", whose capacity is reused */
+            struct slot {
+                uvgrtp::frame::rtp_frame *frame = nullptr;
+                std::vector<uint8_t> copy;
+                uint32_t timestamp = 0;
+                uint64_t recv_time = 0;
+            };
+
+            void writer();
+
+            /* Write the payloads of the first "count" frames of "batch_" with one call,
+             * add them to the index and release the frames the recorder owns */
+            void write_batch(size_t count);
+
+            mpsc_queue<slot> queue_;
+
+#ifdef _WIN32
+            std::FILE *file_;
+#else
+            int fd_;
+            uint64_t allocated_;
+#endif
+            std::FILE *index_;
+            uint64_t offset_;
+
+            /* The frames taken from the queue for the next write. The slots are swapped with
+             * those of the queue, so the buffers of the copies go around without allocations */
+            std::vector<slot> batch_;
+
+            std::unique_ptr<std::thread> writer_;
+            std::atomic<bool> running_;
+
+            /* Number of record() calls in progress, stop() waits for them before the writer finishes */
+            std::atomic<int> recording_;
+            bool deliver_;
+
+            std::atomic<uint64_t> dropped_;
+            std::atomic<uint64_t> written_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
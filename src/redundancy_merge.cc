@@ -0,0 +1,43 @@
+#include "redundancy_merge.hh"
+
+uvgrtp::redundancy_merge::redundancy_merge(size_t window) :
+    window_(window),
+    mask_(0),
+    seen_(),
+    highest_(-1)
+{
+    size_t slots = 1;
+    while (slots < window_)
+        slots <<= 1;
+
+    mask_ = slots - 1;
+    seen_.resize(slots, -1);
+}
+
+bool uvgrtp::redundancy_merge::accept(uint16_t seq)
+{
+    int64_t extended;
+
+    if (highest_ < 0) {
+        // the numbering starts one cycle in, so the packets just before the first one are not negative
+        extended = (int64_t)seq + 0x10000;
+        highest_ = extended;
+    } else {
+        extended = highest_ + (int16_t)(seq - (uint16_t)highest_);
+
+        if (extended > highest_) {
+            highest_ = extended;
+        } else if (highest_ - extended >= (int64_t)window_) {
+            return false;
+        }
+    }
+
+    // a slot that the window has moved past holds an older number, so it does not have to be cleared
+    int64_t& slot = seen_[(size_t)extended & mask_];
+
+    if (slot == extended)
+        return false;
+
+    slot = extended;
+    return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* Largest RCC_REDUNDANCY_WINDOW, half of the sequence number space so that
+     * the sequence numbers can be told apart in both directions */
+    constexpr size_t MAX_REDUNDANCY_WINDOW = 32768;
+
+    /* The window of the merge when a receive path is added without RCC_REDUNDANCY_WINDOW */
+    constexpr size_t DEFAULT_REDUNDANCY_WINDOW = 4096;
+
+    /* Merges the copies of a stream that arrive over several networks into one, see
+     * media_stream::add_receive_path() and RCC_REDUNDANCY_WINDOW.
+     *
+     * The first copy of each sequence number is let through and the later ones are dropped.
+     * A ring indexed by the sequence number remembers which of the last "window" packets
+     * before the newest one have been seen, so a packet is looked up and marked in constant
+     * time. Packets older than the window are dropped, since it is not known whether their
+     * other copy has been let through already.
+     *
+     * The merge is used by the thread that processes the packets of the stream */
+    class redundancy_merge {
+        public:
+            explicit redundancy_merge(size_t window);
+
+            redundancy_merge(const redundancy_merge&) = delete;
+            redundancy_merge& operator=(const redundancy_merge&) = delete;
+
+            /* Return true if "seq" is the first copy of its packet within the window and
+             * mark it seen. Otherwise the packet should be dropped */
+            bool accept(uint16_t seq);
+
+            size_t window() const
+            {
+                return window_;
+            }
+
+        private:
+            size_t window_;
+            size_t mask_;
+
+            /* The extended sequence number of the packet last seen in each slot, -1 if none */
+            std::vector<int64_t> seen_;
+
+            /* The extended sequence number of the newest packet, -1 before the first packet */
+            int64_t highest_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
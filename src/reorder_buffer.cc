@@ -0,0 +1,146 @@
+#include "reorder_buffer.hh"
+
+#include "uvgrtp/frame.hh"
+
+#include <algorithm>
+
+uvgrtp::reorder_buffer::reorder_buffer(std::chrono::milliseconds window) :
+    window_(window),
+    slots_(REORDER_CAPACITY),
+    held_(0),
+    next_(-1),
+    arrivals_()
+{
+}
+
+uvgrtp::reorder_buffer::~reorder_buffer()
+{
+    for (auto& slot : slots_) {
+        if (slot.frame)
+            (void)uvgrtp::frame::dealloc_frame(slot.frame);
+    }
+}
+
+int64_t uvgrtp::reorder_buffer::unwrap(uint16_t seq) const
+{
+    return next_ + (int16_t)(seq - (uint16_t)next_);
+}
+
+void uvgrtp::reorder_buffer::push(uvgrtp::frame::rtp_frame *frame, std::chrono::steady_clock::time_point now,
+    std::vector<uvgrtp::frame::rtp_frame *>& ready)
+{
+    if (next_ < 0)
+        next_ = frame->header.seq;
+
+    int64_t seq = unwrap(frame->header.seq);
+
+    // a late or duplicate packet is handed on as it would be without the buffer
+    if (seq < next_) {
+        ready.push_back(frame);
+        return;
+    }
+
+    if (seq == next_) {
+        ready.push_back(frame);
+        ++next_;
+        drain(ready);
+        return;
+    }
+
+    slot& held = slots_[seq & (REORDER_CAPACITY - 1)];
+    if (held.frame && held.seq == seq) {
+        ready.push_back(frame);
+        return;
+    }
+
+    // the packets that do not fit ahead of the gap push the oldest ones out
+    if (seq - next_ >= (int64_t)REORDER_CAPACITY) {
+        skip_to(seq - (int64_t)REORDER_CAPACITY + 1, ready);
+        drain(ready);
+
+        if (seq == next_) {
+            ready.push_back(frame);
+            ++next_;
+            drain(ready);
+            return;
+        }
+    }
+
+    held.frame = frame;
+    held.seq   = seq;
+    ++held_;
+
+    arrivals_.emplace_back(now, seq);
+}
+
+void uvgrtp::reorder_buffer::expire(std::chrono::steady_clock::time_point now,
+    std::vector<uvgrtp::frame::rtp_frame *>& ready)
+{
+    while (!arrivals_.empty()) {
+        int64_t seq = arrivals_.front().second;
+        const slot& held = slots_[seq & (REORDER_CAPACITY - 1)];
+
+        if (!held.frame || held.seq != seq) {
+            arrivals_.pop_front();
+            continue;
+        }
+
+        if (arrivals_.front().first + window_ > now)
+            break;
+
+        // the packets missing before the oldest one are taken as lost
+        skip_to(seq, ready);
+        drain(ready);
+    }
+}
+
+std::chrono::steady_clock::time_point uvgrtp::reorder_buffer::deadline()
+{
+    while (!arrivals_.empty()) {
+        int64_t seq = arrivals_.front().second;
+        const slot& held = slots_[seq & (REORDER_CAPACITY - 1)];
+
+        if (held.frame && held.seq == seq)
+            return arrivals_.front().first + window_;
+
+        arrivals_.pop_front();
+    }
+
+    return std::chrono::steady_clock::time_point::max();
+}
+
+void uvgrtp::reorder_buffer::skip_to(int64_t seq, std::vector<uvgrtp::frame::rtp_frame *>& ready)
+{
+    // all held packets are within the capacity from the next one, so a long jump looks at each slot once
+    int64_t end = std::min(seq, next_ + (int64_t)REORDER_CAPACITY);
+
+    for (int64_t s = next_; s < end && held_ > 0; ++s) {
+        slot& held = slots_[s & (REORDER_CAPACITY - 1)];
+
+        if (held.frame && held.seq == s) {
+            ready.push_back(held.frame);
+            held.frame = nullptr;
+            --held_;
+        }
+    }
+
+    next_ = std::max(next_, seq);
+}
+
+void uvgrtp::reorder_buffer::drain(std::vector<uvgrtp::frame::rtp_frame *>& ready)
+{
+    while (held_ > 0) {
+        slot& held = slots_[next_ & (REORDER_CAPACITY - 1)];
+
+        if (!held.frame || held.seq != next_)
+            break;
+
+        ready.push_back(held.frame);
+        held.frame = nullptr;
+        --held_;
+        ++next_;
+    }
+
+    if (held_ == 0)
+        arrivals_.clear();
+}
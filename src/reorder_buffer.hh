@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace uvgrtp {
+
+    namespace frame {
+        struct rtp_frame;
+    }
+
+    /* Most packets held ahead of a gap, must be a power of two */
+    constexpr size_t REORDER_CAPACITY = 1024;
+
+    /* Puts the received packets of a stream back in the order of their sequence numbers before
+     * they are depacketized, see RCC_REORDER_WINDOW_MS.
+     *
+     * The packets are handed on in order. A packet that arrives ahead of a gap is held until the
+     * missing packets arrive or it has been held for the window, when the missing packets are
+     * taken as lost and the packets after them are handed on. A packet that arrives after its
+     * place has been passed is handed on right away, like without the buffer. The buffer holds at
+     * most REORDER_CAPACITY packets ahead of the first missing one.
+     *
+     * The buffer is used by the thread that processes the packets of the stream */
+    class reorder_buffer {
+        public:
+            explicit reorder_buffer(std::chrono::milliseconds window);
+            ~reorder_buffer();
+
+            reorder_buffer(const reorder_buffer&) = delete;
+            reorder_buffer& operator=(const reorder_buffer&) = delete;
+
+            /* Add the packet "frame" that arrived at "now" and append the packets that can be handed
+             * on, in order, to "ready". The buffer owns the packets it holds */
+            void push(uvgrtp::frame::rtp_frame *frame, std::chrono::steady_clock::time_point now,
+                std::vector<uvgrtp::frame::rtp_frame *>& ready);
+
+            /* Hand on the packets that have been held for the window at "now", and those in
+             * order after them, to "ready" */
+            void expire(std::chrono::steady_clock::time_point now, std::vector<uvgrtp::frame::rtp_frame *>& ready);
+
+            /* Whether the buffer holds packets */
+            bool holding() const
+            {
+                return held_ > 0;
+            }
+
+            /* When the oldest packet held has to be handed on, time_point::max() if none is held */
+            std::chrono::steady_clock::time_point deadline();
+
+            std::chrono::milliseconds window() const
+            {
+                return window_;
+            }
+
+        private:
+            struct slot {
+                uvgrtp::frame::rtp_frame *frame = nullptr;
+                int64_t seq = -1;
+            };
+
+            /* Extend "seq" to 64 bits around the next sequence number to hand on */
+            int64_t unwrap(uint16_t seq) const;
+
+            /* Hand on the held packets before "seq", skipping the missing ones, so that "seq" is next */
+            void skip_to(int64_t seq, std::vector<uvgrtp::frame::rtp_frame *>& ready);
+
+            /* Hand on the held packets that follow the last one handed on without a gap */
+            void drain(std::vector<uvgrtp::frame::rtp_frame *>& ready);
+
+            std::chrono::milliseconds window_;
+
+            std::vector<slot> slots_;
+            size_t held_;
+
+            /* The sequence number of the next packet to hand on, -1 before the first packet */
+            int64_t next_;
+
+            /* The held packets in the order they arrived, with the time they arrived. Packets that
+             * have been handed on are left here and skipped when they come up */
+            std::deque<std::pair<std::chrono::steady_clock::time_point, int64_t>> arrivals_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,315 @@
+#include "rio.hh"
+
+#include "debug.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+/* The completions dequeued with one call */
+constexpr ULONG RIO_COMPLETION_BATCH = 64;
+#endif
+
+uvgrtp::rio::rio()
+#ifdef _WIN32
+    :
+    table_(),
+    region_(nullptr),
+    region_size_(0),
+    slot_size_(0),
+    buffer_(RIO_INVALID_BUFFERID),
+    send_cq_(RIO_INVALID_CQ),
+    recv_cq_(RIO_INVALID_CQ),
+    queue_(RIO_INVALID_RQ),
+    recv_event_(nullptr),
+    receiving_(false),
+    send_free_()
+#endif
+{
+}
+
+uvgrtp::rio::~rio()
+{
+#ifdef _WIN32
+    // the request queue goes away with the socket, which is closed before the completion queues
+    if (send_cq_ != RIO_INVALID_CQ)
+        table_.RIOCloseCompletionQueue(send_cq_);
+
+    if (recv_cq_ != RIO_INVALID_CQ)
+        table_.RIOCloseCompletionQueue(recv_cq_);
+
+    if (recv_event_)
+        CloseHandle(recv_event_);
+
+    if (buffer_ != RIO_INVALID_BUFFERID)
+        table_.RIODeregisterBuffer(buffer_);
+
+    if (region_)
+        VirtualFree(region_, 0, MEM_RELEASE);
+#endif
+}
+
+#ifdef _WIN32
+rtp_error_t uvgrtp::rio::init(SOCKET socket, size_t slot_size)
+{
+#ifdef UVGRTP_HAVE_RIO
+    GUID id     = WSAID_MULTIPLE_RIO;
+    DWORD bytes = 0;
+
+    table_.cbSize = sizeof(table_);
+
+    if (WSAIoctl(socket, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER, &id, sizeof(id), &table_,
+            sizeof(table_), &bytes, nullptr, nullptr) == SOCKET_ERROR) {
+        UVG_LOG_WARN("Registered I/O is not available: %d", WSAGetLastError());
+        return RTP_NOT_SUPPORTED;
+    }
+
+    // the slots of both directions followed by the addresses of the slots
+    slot_size_   = slot_size;
+    region_size_ = (RIO_SEND_SLOTS + RIO_RECV_SLOTS) * (slot_size_ + sizeof(SOCKADDR_INET));
+
+    if (!(region_ = (char *)VirtualAlloc(nullptr, region_size_, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE))) {
+        UVG_LOG_ERROR("Failed to allocate %zu bytes for Registered I/O", region_size_);
+        return RTP_MEMORY_ERROR;
+    }
+
+    if ((buffer_ = table_.RIORegisterBuffer(region_, (DWORD)region_size_)) == RIO_INVALID_BUFFERID) {
+        UVG_LOG_ERROR("RIORegisterBuffer() failed: %d", WSAGetLastError());
+        return RTP_MEMORY_ERROR;
+    }
+
+    // the sends are polled when the slots run out, the receives wake the thread that reads the socket
+    if ((send_cq_ = table_.RIOCreateCompletionQueue((DWORD)RIO_SEND_SLOTS, nullptr)) == RIO_INVALID_CQ) {
+        UVG_LOG_ERROR("RIOCreateCompletionQueue() failed: %d", WSAGetLastError());
+        return RTP_NOT_SUPPORTED;
+    }
+
+    if (!(recv_event_ = CreateEvent(nullptr, FALSE, FALSE, nullptr))) {
+        UVG_LOG_ERROR("CreateEvent() failed: %lu", GetLastError());
+        return RTP_GENERIC_ERROR;
+    }
+
+    RIO_NOTIFICATION_COMPLETION notification = {};
+    notification.Type              = RIO_EVENT_COMPLETION;
+    notification.Event.EventHandle = recv_event_;
+    notification.Event.NotifyReset = TRUE;
+
+    if ((recv_cq_ = table_.RIOCreateCompletionQueue((DWORD)RIO_RECV_SLOTS, &notification)) == RIO_INVALID_CQ) {
+        UVG_LOG_ERROR("RIOCreateCompletionQueue() failed: %d", WSAGetLastError());
+        return RTP_NOT_SUPPORTED;
+    }
+
+    if ((queue_ = table_.RIOCreateRequestQueue(socket, (ULONG)RIO_RECV_SLOTS, 1, (ULONG)RIO_SEND_SLOTS, 1,
+            recv_cq_, send_cq_, nullptr)) == RIO_INVALID_RQ) {
+        UVG_LOG_WARN("RIOCreateRequestQueue() failed: %d", WSAGetLastError());
+        return RTP_NOT_SUPPORTED;
+    }
+
+    send_free_.reserve(RIO_SEND_SLOTS);
+    for (size_t i = RIO_SEND_SLOTS; i > 0; --i) {
+        send_free_.push_back((ULONG)(i - 1));
+    }
+
+    return RTP_OK;
+#else
+    (void)socket, (void)slot_size;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+RIO_BUF uvgrtp::rio::slot(size_t index, ULONG length) const
+{
+    RIO_BUF buf;
+    buf.BufferId = buffer_;
+    buf.Offset   = (ULONG)(index * slot_size_);
+    buf.Length   = length;
+    return buf;
+}
+
+RIO_BUF uvgrtp::rio::address(size_t index) const
+{
+    RIO_BUF buf;
+    buf.BufferId = buffer_;
+    buf.Offset   = (ULONG)((RIO_SEND_SLOTS + RIO_RECV_SLOTS) * slot_size_ + index * sizeof(SOCKADDR_INET));
+    buf.Length   = sizeof(SOCKADDR_INET);
+    return buf;
+}
+
+rtp_error_t uvgrtp::rio::reap_sends(bool wait)
+{
+    RIORESULT results[RIO_COMPLETION_BATCH];
+
+    while (true) {
+        ULONG count = table_.RIODequeueCompletion(send_cq_, results, RIO_COMPLETION_BATCH);
+
+        if (count == RIO_CORRUPT_CQ) {
+            UVG_LOG_ERROR("The send completion queue of Registered I/O is corrupt");
+            return RTP_SEND_ERROR;
+        }
+
+        for (ULONG i = 0; i < count; ++i) {
+            if (results[i].Status != 0)
+                UVG_LOG_DEBUG("RIOSendEx() completed with error %ld", results[i].Status);
+
+            send_free_.push_back((ULONG)results[i].RequestContext);
+        }
+
+        if (count > 0 || !wait)
+            return RTP_OK;
+
+        // the deferred sends may be what the queue is waiting for
+        table_.RIOSendEx(queue_, nullptr, 0, nullptr, nullptr, nullptr, nullptr, RIO_MSG_COMMIT_ONLY, nullptr);
+        std::this_thread::yield();
+    }
+}
+
+rtp_error_t uvgrtp::rio::send(const sockaddr *addr, int addr_len, const buf_vec *packets, size_t count,
+    int *bytes_sent)
+{
+    for (size_t i = 0; i < count; ++i) {
+        size_t length = 0;
+        for (auto& buffer : packets[i]) {
+            length += buffer.first;
+        }
+
+        if (length > slot_size_)
+            return RTP_INVALID_VALUE;
+    }
+
+    std::lock_guard<std::mutex> lg(send_mutex_);
+
+    int sent = 0;
+    rtp_error_t ret = reap_sends(false);
+
+    for (size_t i = 0; i < count && ret == RTP_OK; ++i) {
+        if (send_free_.empty() && (ret = reap_sends(true)) != RTP_OK)
+            break;
+
+        ULONG index = send_free_.back();
+        send_free_.pop_back();
+
+        char *data = region_ + index * slot_size_;
+        ULONG length = 0;
+
+        for (auto& buffer : packets[i]) {
+            memcpy(data + length, buffer.second, buffer.first);
+            length += (ULONG)buffer.first;
+        }
+
+        RIO_BUF remote = address(index);
+        memcpy(region_ + remote.Offset, addr, std::min((size_t)addr_len, sizeof(SOCKADDR_INET)));
+
+        RIO_BUF buf = slot(index, length);
+
+        // the packets of the frame go to the kernel together with the last one
+        DWORD flags = (i + 1 < count) ? RIO_MSG_DEFER : 0;
+
+        if (!table_.RIOSendEx(queue_, &buf, 1, nullptr, &remote, nullptr, nullptr, flags, (PVOID)(ULONG_PTR)index)) {
+            UVG_LOG_ERROR("RIOSendEx() failed: %d", WSAGetLastError());
+            send_free_.push_back(index);
+
+            // what has been deferred is still sent
+            table_.RIOSendEx(queue_, nullptr, 0, nullptr, nullptr, nullptr, nullptr, RIO_MSG_COMMIT_ONLY, nullptr);
+            ret = RTP_SEND_ERROR;
+            break;
+        }
+        sent += (int)length;
+    }
+
+    if (bytes_sent)
+        *bytes_sent = ret == RTP_OK ? sent : -1;
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::rio::start_receiving()
+{
+    std::lock_guard<std::mutex> lg(recv_mutex_);
+
+    if (receiving_)
+        return RTP_OK;
+
+    for (size_t i = 0; i < RIO_RECV_SLOTS; ++i) {
+        size_t index = RIO_SEND_SLOTS + i;
+
+        RIO_BUF buf    = slot(index, (ULONG)slot_size_);
+        RIO_BUF remote = address(index);
+
+        DWORD flags = (i + 1 < RIO_RECV_SLOTS) ? RIO_MSG_DEFER : 0;
+
+        if (!table_.RIOReceiveEx(queue_, &buf, 1, nullptr, &remote, nullptr, nullptr, flags, (PVOID)(ULONG_PTR)index)) {
+            UVG_LOG_ERROR("RIOReceiveEx() failed: %d", WSAGetLastError());
+            return RTP_GENERIC_ERROR;
+        }
+    }
+
+    receiving_ = true;
+    return RTP_OK;
+}
+
+bool uvgrtp::rio::receiving() const
+{
+    return receiving_;
+}
+
+rtp_error_t uvgrtp::rio::wait(int timeout_ms)
+{
+    // the event is set right away if the queue already has completions
+    INT ret = table_.RIONotify(recv_cq_);
+    if (ret != ERROR_SUCCESS && ret != WSAEALREADY) {
+        UVG_LOG_ERROR("RIONotify() failed: %d", ret);
+        return RTP_GENERIC_ERROR;
+    }
+
+    if (WaitForSingleObject(recv_event_, timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms) != WAIT_OBJECT_0)
+        return RTP_INTERRUPTED;
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rio::receive(uint8_t **buffers, size_t buf_len, int *lengths, SOCKADDR_INET *senders,
+    int count, int *received)
+{
+    std::lock_guard<std::mutex> lg(recv_mutex_);
+
+    RIORESULT results[RIO_COMPLETION_BATCH];
+    ULONG dequeued = table_.RIODequeueCompletion(recv_cq_, results,
+        std::min((ULONG)count, RIO_COMPLETION_BATCH));
+
+    if (dequeued == RIO_CORRUPT_CQ) {
+        UVG_LOG_ERROR("The receive completion queue of Registered I/O is corrupt");
+        *received = 0;
+        return RTP_GENERIC_ERROR;
+    }
+
+    int n = 0;
+
+    for (ULONG i = 0; i < dequeued; ++i) {
+        size_t index = (size_t)results[i].RequestContext;
+
+        RIO_BUF buf    = slot(index, (ULONG)slot_size_);
+        RIO_BUF remote = address(index);
+
+        if (results[i].Status == 0) {
+            size_t length = std::min((size_t)results[i].BytesTransferred, buf_len);
+
+            memcpy(buffers[n], region_ + buf.Offset, length);
+            lengths[n] = (int)length;
+
+            if (senders)
+                memcpy(&senders[n], region_ + remote.Offset, sizeof(SOCKADDR_INET));
+            ++n;
+        }
+
+        // the slot is posted again right away, the kernel gets them all with the last one
+        DWORD flags = (i + 1 < dequeued) ? RIO_MSG_DEFER : 0;
+
+        if (!table_.RIOReceiveEx(queue_, &buf, 1, nullptr, &remote, nullptr, nullptr, flags, (PVOID)(ULONG_PTR)index))
+            UVG_LOG_ERROR("RIOReceiveEx() failed: %d", WSAGetLastError());
+    }
+
+    *received = n;
+    return n > 0 ? RTP_OK : RTP_INTERRUPTED;
+}
+#endif
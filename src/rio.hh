@@ -0,0 +1,126 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <mswsock.h>
+#include <ws2ipdef.h>
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace uvgrtp {
+
+    typedef std::vector<std::pair<size_t, uint8_t *>> buf_vec; // also defined in socket.hh
+
+    /* How many datagrams the Registered I/O of a socket has in flight in each direction, and
+     * the largest datagram. Larger datagrams are sent with WSASendTo() and dropped on reception */
+    const size_t RIO_SEND_SLOTS = 512;
+    const size_t RIO_RECV_SLOTS = 512;
+    const size_t RIO_SLOT_SIZE  = 4096;
+
+    /* Windows Registered I/O (RIO) of one socket that uvgrtp::socket uses to send and receive
+     * batches of datagrams, the counterpart of uvgrtp::uring on Windows
+     *
+     * The datagrams are sent from and received to slots of one registered buffer, so the kernel
+     * does not lock and map the pages of each datagram. A RIO operation takes one buffer, so the
+     * buffers of a packet are gathered into its slot. The packets of a frame are queued with
+     * RIO_MSG_DEFER and handed to the kernel with the last one, and the completions of the sends
+     * are reaped from a polled completion queue when the slots run out.
+     *
+     * Once start_receiving() has been called, every slot of the receive side is kept posted and
+     * the datagrams do not show up in WSAPoll() anymore: the thread that reads the socket waits
+     * for the completion queue with wait() and reads it with receive().
+     *
+     * The sends and the receives can be issued from different threads, but the calls of one
+     * direction are serialized. Only used if uvgRTP has been built with UVGRTP_ENABLE_RIO on
+     * Windows and the socket has been created with WSA_FLAG_REGISTERED_IO, otherwise init() fails */
+    class rio {
+        public:
+            rio();
+            ~rio();
+
+            rio(const rio&) = delete;
+            rio& operator=(const rio&) = delete;
+
+#ifdef _WIN32
+            /* Load the RIO functions, register the slots of datagrams of at most "slot_size" bytes
+             * and create the completion queues and the request queue of "socket"
+             *
+             * Return RTP_OK on success
+             * Return RTP_MEMORY_ERROR if the slots could not be allocated or registered
+             * Return RTP_NOT_SUPPORTED if the socket or the system does not support RIO */
+            rtp_error_t init(SOCKET socket, size_t slot_size);
+
+            /* Send "count" packets of "packets" to "addr", each packet gathered into its slot.
+             * The number of bytes queued is written to "bytes_sent"
+             *
+             * Return RTP_OK if all packets were queued
+             * Return RTP_INVALID_VALUE if a packet does not fit into a slot, nothing is sent then
+             * Return RTP_SEND_ERROR if the kernel refused a request */
+            rtp_error_t send(const sockaddr *addr, int addr_len, const buf_vec *packets, size_t count,
+                int *bytes_sent);
+
+            /* Post the receives of all slots. Must be called once before wait() and receive()
+             *
+             * Return RTP_OK on success
+             * Return RTP_GENERIC_ERROR if the kernel refused a request */
+            rtp_error_t start_receiving();
+
+            /* Return true once start_receiving() has succeeded */
+            bool receiving() const;
+
+            /* Wait at most "timeout_ms" milliseconds for received datagrams
+             *
+             * Return RTP_OK if there are datagrams to receive
+             * Return RTP_INTERRUPTED if the wait timed out */
+            rtp_error_t wait(int timeout_ms);
+
+            /* Copy up to "count" received datagrams to "buffers" of "buf_len" bytes and post their
+             * slots again. Their sizes are written to "lengths" and, if "senders" is not nullptr,
+             * their sources to "senders". Does not block
+             *
+             * Return RTP_OK and write the number of datagrams to "received"
+             * Return RTP_INTERRUPTED if no datagram has been received */
+            rtp_error_t receive(uint8_t **buffers, size_t buf_len, int *lengths, SOCKADDR_INET *senders,
+                int count, int *received);
+
+        private:
+            // the slot of "index" and the address next to it
+            RIO_BUF slot(size_t index, ULONG length) const;
+            RIO_BUF address(size_t index) const;
+
+            // give the slots of the completed sends back to "send_free_", wait for one if "wait" is set
+            rtp_error_t reap_sends(bool wait);
+
+            RIO_EXTENSION_FUNCTION_TABLE table_;
+
+            char *region_;
+            size_t region_size_;
+            size_t slot_size_;
+            RIO_BUFFERID buffer_;
+
+            RIO_CQ send_cq_;
+            RIO_CQ recv_cq_;
+            RIO_RQ queue_;
+            HANDLE recv_event_;
+
+            std::atomic<bool> receiving_;
+
+            /* Held while sending, protects "send_free_" and the send completion queue */
+            std::mutex send_mutex_;
+            std::vector<ULONG> send_free_;
+
+            /* Held while receiving, protects the receive completion queue */
+            std::mutex recv_mutex_;
+#endif
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
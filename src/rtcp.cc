@@ -12,6 +12,11 @@
 #include "rtcp_packets.hh"
 #include "socketfactory.hh"
 #include "rtcp_reader.hh"
+#include "rtcp_scheduler.hh"
+#include "random.hh"
+#include "twcc.hh"
+#include "nack.hh"
+#include "rtcp_xr.hh"
 
 #include "global.hh"
 
@@ -45,6 +50,26 @@ constexpr int ESTIMATED_MAX_RECEPTION_TIME_MS = 10;
 
 const uint32_t MAX_SUPPORTED_PARTICIPANTS = 31;
 
+/* Participants each receiving thread keeps for find_rx_participant() */
+constexpr size_t RX_PARTICIPANT_CACHE_SIZE = 8;
+
+namespace {
+    struct rx_participant_entry {
+        uint64_t instance = 0;
+        uint32_t ssrc     = 0;
+        uint64_t version  = 0;
+        std::shared_ptr<uvgrtp::rtcp_participant> participant;
+    };
+
+    /* Identifies the RTCP instances of the cache, 0 is an empty entry. An address
+     * could be reused by a later instance so it is not used for this */
+    std::atomic<uint64_t> rtcp_instances(0);
+
+    /* Each thread has its own cache, as the threads of a sharded port
+     * process the packets of the same stream at the same time */
+    thread_local rx_participant_entry rx_participants[RX_PARTICIPANT_CACHE_SIZE];
+}
+
 uvgrtp::rtcp::rtcp(std::shared_ptr<uvgrtp::rtp> rtp, std::shared_ptr<std::atomic_uint> ssrc, std::shared_ptr<std::atomic<uint32_t>> remote_ssrc,
     std::string cname, std::shared_ptr<uvgrtp::socketfactory> sfp, int rce_flags) :
     rce_flags_(rce_flags), our_role_(RECEIVER),
@@ -53,6 +78,8 @@ uvgrtp::rtcp::rtcp(std::shared_ptr<uvgrtp::rtp> rtp, std::shared_ptr<std::atomic
     we_sent_(false), local_addr_(""), remote_addr_(""), local_port_(0), dst_port_(0),
     avg_rtcp_pkt_pize_(0), avg_rtcp_size_(64), rtcp_pkt_count_(0), rtcp_byte_count_(0),
     rtcp_pkt_sent_count_(0), initial_(true), ssrc_(ssrc), remote_ssrc_(remote_ssrc),
+    participants_version_(0),
+    instance_(rtcp_instances.fetch_add(1, std::memory_order_relaxed) + 1),
     num_receivers_(0),
     ipv6_(false),
     socket_address_({}),
@@ -85,29 +112,66 @@ uvgrtp::rtcp::rtcp(std::shared_ptr<uvgrtp::rtp> rtp, std::shared_ptr<std::atomic
     clock_start_  = 0;
     rtp_ts_start_ = 0;
 
-    report_generator_   = nullptr;
+    report_timer_       = 0;
+    report_interval_ms_ = 0;
+
+    feedback_mode_ = RTP_RTCP_FEEDBACK_IMMEDIATE;
+    allow_early_   = true;
+    early_timer_   = 0;
+
+    twcc_receiver_ = std::make_shared<uvgrtp::twcc_receiver>();
+    twcc_ext_id_   = 0;
+    twcc_timer_    = 0;
+
+    xr_blocks_       = 0;
+    xr_rtt_ms_       = -1;
+    xr_hook_         = nullptr;
+    xr_source_count_ = 0;
+    xr_rrt_          = false;
+
+    key_frame_hook_arg_ = nullptr;
+    key_frame_hook_     = nullptr;
+    fir_seq_            = 0;
     srtcp_        = nullptr;
     members_ = 1;
 
     zero_stats(&our_stats);
 
+    cnameItem_.type = 1;
+    cnameItem_.length = 0;
+    cnameItem_.data = (uint8_t*)cname_;
+
+    // without a CNAME, the one of the context is taken when RTCP is started or the first SDES is built
+    if (!cname.empty())
+        set_cname(cname);
+}
+
+void uvgrtp::rtcp::set_cname(const std::string& cname)
+{
     if (cname.length() > 255)
     {
         UVG_LOG_ERROR("Our CName is too long");
+        return;
     }
-    else
-    {
-        // items should not have null termination
-        const char* c = cname.c_str();
-        memcpy(cname_, c, cname.length());
-        uint8_t length = (uint8_t)cname.length();
 
-        cnameItem_.type = 1;
-        cnameItem_.length = length;
-        cnameItem_.data = (uint8_t*)cname_;
+    // items should not have null termination
+    memcpy(cname_, cname.c_str(), cname.length());
+    cnameItem_.length = (uint8_t)cname.length();
 
-        ourItems_.push_back(cnameItem_);
+    // the items of set_sdes_items() may carry a CNAME of their own
+    for (auto& item : ourItems_)
+    {
+        if (item.type == 1)
+            return;
     }
+
+    ourItems_.insert(ourItems_.begin(), cnameItem_);
+}
+
+void uvgrtp::rtcp::ensure_cname()
+{
+    if (cnameItem_.length == 0 && sfp_)
+        set_cname(sfp_->get_cname());
 }
 
 uvgrtp::rtcp::rtcp(std::shared_ptr<uvgrtp::rtp> rtp, std::shared_ptr<std::atomic_uint> ssrc, std::shared_ptr<std::atomic<uint32_t>> remote_ssrc,
@@ -140,6 +204,7 @@ void uvgrtp::rtcp::cleanup_participants()
         free_participant(std::move(participant.second));
     }
     participants_.clear();
+    participants_version_.fetch_add(1, std::memory_order_release);
     participants_mutex_.unlock();
 
     for (auto& participant : initial_participants_)
@@ -165,7 +230,7 @@ uvgrtp::rtcp_app_packet::~rtcp_app_packet() {
     delete[] name;
 }
 
-void uvgrtp::rtcp::free_participant(std::unique_ptr<rtcp_participant> participant)
+void uvgrtp::rtcp::free_participant(std::shared_ptr<rtcp_participant> participant)
 {
     if (participant->sr_frame)
     {
@@ -202,6 +267,9 @@ void uvgrtp::rtcp::free_participant(std::unique_ptr<rtcp_participant> participan
 
 rtp_error_t uvgrtp::rtcp::start()
 {
+    // looking up the CNAME may be slow, so it is done here rather than when the first report is sent
+    ensure_cname();
+
     active_ = true;
     ipv6_ = sfp_->get_ipv6();
     if ((rce_flags_ & RCE_RTCP_MUX)) {
@@ -211,7 +279,7 @@ rtp_error_t uvgrtp::rtcp::start()
         else {
             socket_address_ = uvgrtp::socket::create_sockaddr(AF_INET, remote_addr_, dst_port_);
         }
-        report_generator_.reset(new std::thread(rtcp_runner, this));
+        schedule_reports();
         return RTP_OK;
     }
 
@@ -255,7 +323,7 @@ rtp_error_t uvgrtp::rtcp::start()
     else {
         socket_address_ = uvgrtp::socket::create_sockaddr(AF_INET, remote_addr_, dst_port_);
     }
-    report_generator_.reset(new std::thread(rtcp_runner, this));
+    schedule_reports();
     rtcp_reader_->start();
 
     return RTP_OK;
@@ -283,10 +351,22 @@ rtp_error_t uvgrtp::rtcp::stop()
         return RTP_OK;
     }
     active_ = false;
-    if (report_generator_ && report_generator_->joinable())
+    if (report_timer_)
+    {
+        UVG_LOG_DEBUG("Removing RTCP reports from the scheduler");
+        sfp_->get_rtcp_scheduler()->remove(report_timer_);
+        report_timer_ = 0;
+    }
+    twcc_mutex_.lock();
+    if (twcc_timer_)
     {
-        UVG_LOG_DEBUG("Waiting for RTCP loop to exit");
-        report_generator_->join();
+        sfp_->get_rtcp_scheduler()->remove(twcc_timer_);
+        twcc_timer_ = 0;
+    }
+    twcc_mutex_.unlock();
+    if (uint64_t early_timer = early_timer_.exchange(0))
+    {
+        sfp_->get_rtcp_scheduler()->remove(early_timer);
     }
     if (!(rce_flags_ & RCE_RTCP_MUX)) {
         if (rtcp_reader_ && rtcp_reader_->clear_rtcp_from_reader(remote_ssrc_) == 1) {
@@ -297,58 +377,508 @@ rtp_error_t uvgrtp::rtcp::stop()
     return ret;
 }
 
-void uvgrtp::rtcp::rtcp_runner(rtcp* rtcp)
+void uvgrtp::rtcp::schedule_reports()
 {
     UVG_LOG_INFO("RTCP instance created!");
 
     // RFC 3550 says to wait half interval before sending first report
-    int initial_sleep_ms = rtcp->get_rtcp_interval_ms() / 2;
-    UVG_LOG_DEBUG("Sleeping for %i ms before sending first RTCP report", initial_sleep_ms);
-    std::this_thread::sleep_for(std::chrono::milliseconds(initial_sleep_ms));
+    uint32_t initial_delay_ms = get_rtcp_interval_ms() / 2;
+    UVG_LOG_DEBUG("Waiting for %u ms before sending first RTCP report", initial_delay_ms);
+
+    report_interval_ms_ = get_rtcp_interval_ms();
+
+    packet_mutex_.lock();
+    next_report_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(initial_delay_ms);
+    packet_mutex_.unlock();
+
+    report_timer_ = sfp_->get_rtcp_scheduler()->add([this]() { return send_periodic_report(); },
+        initial_delay_ms);
+
+    schedule_twcc_feedback();
+}
+
+void uvgrtp::rtcp::schedule_twcc_feedback()
+{
+    std::lock_guard<std::mutex> lock(twcc_mutex_);
+
+    if (twcc_timer_ || !twcc_ext_id_)
+        return;
+
+    twcc_timer_ = sfp_->get_rtcp_scheduler()->add([this]() { return send_twcc_feedback(); },
+        uvgrtp::TWCC_FEEDBACK_INTERVAL_MS);
+}
+
+void uvgrtp::rtcp::set_twcc(uint8_t ext_id, std::shared_ptr<uvgrtp::twcc_sender> sender)
+{
+    fb_mutex_.lock();
+    twcc_sender_ = sender;
+    fb_mutex_.unlock();
+
+    twcc_ext_id_ = ext_id;
+
+    if (active_)
+        schedule_twcc_feedback();
+}
+
+uint32_t uvgrtp::rtcp::send_twcc_feedback()
+{
+    uint32_t size = 0;
+    while (uint8_t *frame = twcc_receiver_->create_feedback(*ssrc_.get(), srtcp_trailer_size(), size))
+    {
+        std::lock_guard<std::mutex> lock(packet_mutex_);
+        rtcp_pkt_sent_count_++;
+
+        if (send_rtcp_packet_to_participants(frame, size, true) != RTP_OK)
+        {
+            UVG_LOG_DEBUG("Failed to send TWCC feedback");
+            break;
+        }
+    }
+
+    return uvgrtp::TWCC_FEEDBACK_INTERVAL_MS;
+}
+
+size_t uvgrtp::rtcp::srtcp_trailer_size() const
+{
+    if (!(rce_flags_ & RCE_SRTP))
+        return 0;
+
+    return UVG_SRTCP_INDEX_LENGTH + uvgrtp::srtp_auth_tag_length(rce_flags_);
+}
+
+void uvgrtp::rtcp::set_packet_history(std::shared_ptr<uvgrtp::packet_history> history)
+{
+    std::lock_guard<std::mutex> lock(fb_mutex_);
+    packet_history_ = history;
+}
+
+rtp_error_t uvgrtp::rtcp::send_nack(uint32_t media_ssrc, const std::vector<uint16_t>& seqs)
+{
+    /* Each FCI entry asks for the packet "pid" and, with the bitmask "blp", for the 16 packets after it */
+    std::vector<std::pair<uint16_t, uint16_t>> entries;
+
+    for (uint16_t seq : seqs) {
+        uint16_t offset = entries.empty() ? 0 : (uint16_t)(seq - entries.back().first);
+
+        if (offset >= 1 && offset <= 16) {
+            entries.back().second |= (uint16_t)(1 << (offset - 1));
+        } else {
+            entries.push_back({ seq, 0 });
+        }
+    }
+
+    const size_t header_size = RTCP_HEADER_SIZE + 2 * SSRC_CSRC_SIZE;
+    const size_t overhead    = header_size + srtcp_trailer_size() + 4;
+    const size_t max_entries = mtu_size_ > overhead ? (mtu_size_ - overhead) / 4 : 1;
 
-    uint32_t current_interval_ms = rtcp->get_rtcp_interval_ms();
     rtp_error_t ret = RTP_OK;
-    
-    // keep track of report numbers
-    int report_number = 0;
+    std::vector<uint8_t> fci;
 
-    while (rtcp->is_active())
+    UVG_LOG_DEBUG("Sending a NACK for %zu packets", seqs.size());
+
+    for (size_t first = 0; first < entries.size() && ret == RTP_OK; first += max_entries) {
+        size_t count = std::min(max_entries, entries.size() - first);
+
+        fci.resize(4 * count);
+        for (size_t i = 0; i < count; ++i) {
+            *(uint16_t *)&fci[4 * i]     = htons(entries[first + i].first);
+            *(uint16_t *)&fci[4 * i + 2] = htons(entries[first + i].second);
+        }
+        ret = send_fb_packet(uvgrtp::frame::RTCP_FT_RTPFB, uvgrtp::frame::RTCP_RTPFB_NACK, media_ssrc,
+            fci.data(), fci.size());
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::rtcp::send_key_frame_request(uint32_t media_ssrc, bool fir)
+{
+    if (!fir) {
+        UVG_LOG_DEBUG("Sending a PLI to %lu", media_ssrc);
+        return send_fb_packet(uvgrtp::frame::RTCP_FT_PSFB, uvgrtp::frame::RTCP_PSFB_PLI, media_ssrc, nullptr, 0);
+    }
+
+    /* The FCI of FIR names the sender and tells a new request from a repeated one with the
+     * sequence number, the media source SSRC of the header is not used, RFC 5104 section 4.3.1 */
+    uint8_t fci[SSRC_CSRC_SIZE + 4] = { 0 };
+    *(uint32_t *)&fci[0] = htonl(media_ssrc);
+    fci[SSRC_CSRC_SIZE]  = fir_seq_++;
+
+    UVG_LOG_DEBUG("Sending a FIR to %lu", media_ssrc);
+    return send_fb_packet(uvgrtp::frame::RTCP_FT_PSFB, uvgrtp::frame::RTCP_PSFB_FIR, 0, fci, sizeof(fci));
+}
+
+void uvgrtp::rtcp::install_key_frame_request_hook(void *arg, void (*hook)(void *))
+{
+    std::lock_guard<std::mutex> lock(fb_mutex_);
+    key_frame_hook_arg_ = arg;
+    key_frame_hook_     = hook;
+}
+
+double uvgrtp::rtcp::get_jitter_ms(uint32_t ssrc)
+{
+    std::lock_guard<std::mutex> prtcp_lock(participants_mutex_);
+
+    auto it = participants_.find(ssrc);
+    if (it == participants_.end() || it->second->stats.clock_rate == 0 ||
+        it->second->stats.received_pkts.load(std::memory_order_relaxed) == 0)
     {
-        ++report_number;
-        UVG_LOG_DEBUG("Sending RTCP report number %i", report_number);
+        return -1.0;
+    }
 
-        if ((ret = rtcp->generate_report()) != RTP_OK && ret != RTP_NOT_READY)
+    // the jitter is estimated in timestamp units
+    return it->second->stats.jitter.load(std::memory_order_relaxed) * 1000.0 / it->second->stats.clock_rate;
+}
+
+void uvgrtp::rtcp::key_frame_requested()
+{
+    fb_mutex_.lock();
+    void *arg = key_frame_hook_arg_;
+    void (*hook)(void *) = key_frame_hook_;
+    fb_mutex_.unlock();
+
+    if (hook)
+        hook(arg);
+}
+
+void uvgrtp::rtcp::set_feedback_mode(int mode)
+{
+    feedback_mode_ = mode;
+}
+
+int uvgrtp::rtcp::get_feedback_mode() const
+{
+    return feedback_mode_;
+}
+
+void uvgrtp::rtcp::set_xr_blocks(int blocks)
+{
+    xr_blocks_ = blocks;
+}
+
+int uvgrtp::rtcp::get_xr_blocks() const
+{
+    return xr_blocks_;
+}
+
+double uvgrtp::rtcp::get_round_trip_time_ms() const
+{
+    return xr_rtt_ms_.load(std::memory_order_relaxed);
+}
+
+rtp_error_t uvgrtp::rtcp::install_xr_hook(std::function<void(const uvgrtp::frame::rtcp_xr_packet&)> xr_handler)
+{
+    if (!xr_handler)
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    std::lock_guard<std::mutex> lock(xr_mutex_);
+    xr_hook_ = xr_handler;
+
+    return RTP_OK;
+}
+
+uint32_t uvgrtp::rtcp::prepare_xr_packet()
+{
+    int blocks = xr_blocks_.load(std::memory_order_relaxed);
+
+    xr_source_count_ = 0;
+    xr_rrt_ = (blocks & RTP_RTCP_XR_RRT) != 0;
+
+    // each received RRT is answered once
+    xr_dlrr_.clear();
+    {
+        std::lock_guard<std::mutex> lock(xr_mutex_);
+        for (auto& rrt : xr_rrts_)
+        {
+            uint64_t diff = uvgrtp::clock::hrc::diff_now(rrt.second.received);
+            xr_dlrr_.push_back({ rrt.first, rrt.second.lrr, (uint32_t)uvgrtp::clock::ms_to_jiffies(diff) });
+        }
+        xr_rrts_.clear();
+    }
+
+    uint32_t size = 0;
+
+    if (blocks & (RTP_RTCP_XR_LOSS_RLE | RTP_RTCP_XR_STAT_SUMMARY | RTP_RTCP_XR_VOIP_METRICS))
+    {
+        double rtt_ms = xr_rtt_ms_.load(std::memory_order_relaxed);
+        uint16_t round_trip_ms = (uint16_t)(rtt_ms > 0 ? std::min(rtt_ms, 65535.0) : 0);
+
+        for (auto& p : reported_)
         {
-            UVG_LOG_INFO("Failed to send RTCP status report!");
-        }
-
-        //Here we check if there are any timed out sources
-        //This vector collects the ssrcs of timed out sources
-        std::vector<uint32_t> ssrcs_to_be_removed = {};
-        for (auto it = rtcp->ms_since_last_rep_.begin(); it != rtcp->ms_since_last_rep_.end(); ++it) {
-            double timeout_interval_s = rtcp->rtcp_interval(int(rtcp->members_), 1, rtcp->rtcp_bandwidth_,
-                true, (double)rtcp->avg_rtcp_size_, false, false);
-            it->second += uint32_t(current_interval_ms);
-            if (it->second > 5*1000*timeout_interval_s) {
-                ssrcs_to_be_removed.push_back(it->first);
+            if (!p.participant->xr)
+            {
+                continue;
+            }
+
+            if (xr_sources_.size() == xr_source_count_)
+            {
+                xr_sources_.emplace_back();
+            }
+
+            xr_source_blocks& source = xr_sources_[xr_source_count_];
+            if (!p.participant->xr->take_report(p.ssrc, round_trip_ms, source.loss_rle,
+                source.stat_summary, source.voip_metrics))
+            {
+                continue;
+            }
+            ++xr_source_count_;
+
+            if (blocks & RTP_RTCP_XR_LOSS_RLE)
+            {
+                size += get_xr_loss_rle_block_size(source.loss_rle.chunks.size());
+            }
+            if (blocks & RTP_RTCP_XR_STAT_SUMMARY)
+            {
+                size += XR_STAT_SUMMARY_BLOCK_SIZE;
+            }
+            if (blocks & RTP_RTCP_XR_VOIP_METRICS)
+            {
+                size += XR_VOIP_METRICS_BLOCK_SIZE;
             }
         }
-        //If some ssrcs are timed out, remove them
-        for (auto rm : ssrcs_to_be_removed) {
-            rtcp->remove_timeout_ssrc(rm);
-            rtcp->ms_since_last_rep_.erase(rm);
+    }
+
+    if (xr_rrt_)
+    {
+        size += XR_RRT_BLOCK_SIZE;
+    }
+
+    if (!xr_dlrr_.empty())
+    {
+        size += get_xr_dlrr_block_size(xr_dlrr_.size());
+    }
+
+    return size ? RTCP_HEADER_SIZE + SSRC_CSRC_SIZE + size : 0;
+}
+
+bool uvgrtp::rtcp::construct_xr_packet(uint8_t* frame, size_t& ptr, uint32_t xr_size)
+{
+    int blocks = xr_blocks_.load(std::memory_order_relaxed);
+
+    if (!construct_rtcp_header(frame, ptr, xr_size, 0, uvgrtp::frame::RTCP_FT_XR) ||
+        !construct_ssrc(frame, ptr, *ssrc_.get()))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < xr_source_count_; ++i)
+    {
+        if (blocks & RTP_RTCP_XR_LOSS_RLE)
+        {
+            construct_xr_loss_rle_block(frame, ptr, xr_sources_[i].loss_rle);
+        }
+        if (blocks & RTP_RTCP_XR_STAT_SUMMARY)
+        {
+            construct_xr_stat_summary_block(frame, ptr, xr_sources_[i].stat_summary);
+        }
+        if (blocks & RTP_RTCP_XR_VOIP_METRICS)
+        {
+            construct_xr_voip_metrics_block(frame, ptr, xr_sources_[i].voip_metrics);
+        }
+    }
+
+    if (xr_rrt_)
+    {
+        construct_xr_rrt_block(frame, ptr, uvgrtp::clock::ntp::now());
+    }
+
+    if (!xr_dlrr_.empty())
+    {
+        construct_xr_dlrr_block(frame, ptr, xr_dlrr_);
+    }
+
+    return true;
+}
+
+rtp_error_t uvgrtp::rtcp::send_fb_packet(uvgrtp::frame::RTCP_FRAME_TYPE type, uint8_t fmt, uint32_t media_ssrc,
+    const uint8_t *fci, size_t fci_len)
+{
+    if (feedback_mode_ != RTP_RTCP_FEEDBACK_IMMEDIATE)
+    {
+        return queue_fb_packet(type, fmt, media_ssrc, fci, fci_len);
+    }
+
+    const size_t trailer = srtcp_trailer_size();
+    const size_t body    = RTCP_HEADER_SIZE + 2 * SSRC_CSRC_SIZE + fci_len;
+    const size_t padding = (4 - (body + trailer) % 4) % 4;
+    const uint32_t size  = (uint32_t)(body + padding + trailer);
+
+    uint8_t *frame = new uint8_t[size];
+    memset(frame, 0, size);
+
+    size_t ptr = 0;
+    if (!construct_rtcp_header(frame, ptr, size, fmt, type) ||
+        !construct_ssrc(frame, ptr, *ssrc_.get()) ||
+        !construct_ssrc(frame, ptr, media_ssrc))
+    {
+        delete[] frame;
+        return RTP_MEMORY_ERROR;
+    }
+
+    if (fci_len) {
+        memcpy(&frame[ptr], fci, fci_len);
+    }
+
+    std::lock_guard<std::mutex> lock(packet_mutex_);
+    rtcp_pkt_sent_count_++;
+
+    ensure_cname();
+
+    return send_rtcp_packet_to_participants(frame, size, true);
+}
+
+rtp_error_t uvgrtp::rtcp::queue_fb_packet(uvgrtp::frame::RTCP_FRAME_TYPE type, uint8_t fmt, uint32_t media_ssrc,
+    const uint8_t *fci, size_t fci_len)
+{
+    // the SRTCP trailer is added to the packet the message is sent in
+    const size_t body    = RTCP_HEADER_SIZE + 2 * SSRC_CSRC_SIZE + fci_len;
+    const uint32_t size  = (uint32_t)(body + (4 - body % 4) % 4);
+
+    std::unique_lock<std::mutex> lock(packet_mutex_);
+
+    size_t start = pending_fb_.size();
+    pending_fb_.resize(start + size);
+
+    uint8_t *frame = &pending_fb_[start];
+    size_t ptr = 0;
+    if (!construct_rtcp_header(frame, ptr, size, fmt, type) ||
+        !construct_ssrc(frame, ptr, *ssrc_.get()) ||
+        !construct_ssrc(frame, ptr, media_ssrc))
+    {
+        pending_fb_.resize(start);
+        return RTP_MEMORY_ERROR;
+    }
+
+    if (fci_len) {
+        memcpy(&frame[ptr], fci, fci_len);
+    }
+
+    // a repeated request is not queued twice
+    for (size_t i = 0; i < start; i += 4 * (ntohs(*(uint16_t *)&pending_fb_[i + 2]) + 1)) {
+        if (start - i >= size && memcmp(&pending_fb_[i], frame, size) == 0) {
+            pending_fb_.resize(start);
+            return RTP_OK;
+        }
+    }
+
+    /* RFC 4585 section 3.5.2: one early packet may be sent between two regular reports, and
+     * the messages that come after it, or when the regular report is due sooner than the
+     * early packet could be dithered, wait for the regular report */
+    if (!allow_early_ || early_timer_ || !active_)
+    {
+        return RTP_OK;
+    }
+
+    participants_mutex_.lock();
+    bool point_to_point = participants_.size() <= 1;
+    participants_mutex_.unlock();
+
+    uint32_t dither_max_ms = point_to_point ? 0 : report_interval_ms_ / 2;
+    if (std::chrono::steady_clock::now() + std::chrono::milliseconds(dither_max_ms) >= next_report_)
+    {
+        return RTP_OK;
+    }
+
+    allow_early_ = false;
+
+    if (dither_max_ms == 0)
+    {
+        lock.unlock();
+        return send_early_feedback();
+    }
+
+    uint32_t dither_ms = uvgrtp::random::generate_32() % (dither_max_ms + 1);
+
+    early_timer_ = sfp_->get_rtcp_scheduler()->add([this]() {
+        // the timer is set under packet_mutex_ after it has been added
+        packet_mutex_.lock();
+        early_timer_ = 0;
+        packet_mutex_.unlock();
+
+        if (send_early_feedback() != RTP_OK)
+        {
+            UVG_LOG_DEBUG("Failed to send early RTCP feedback");
         }
+        return uvgrtp::rtcp_scheduler::STOP;
+    }, dither_ms);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::send_early_feedback()
+{
+    if (feedback_mode_ == RTP_RTCP_FEEDBACK_EARLY)
+    {
+        return send_compound_report(true);
+    }
+
+    std::lock_guard<std::mutex> lock(packet_mutex_);
 
-        // Number of senders is hard set to 1, because it is not updated anywhere.
-        // TODO: Keep track of senders and update it here too
-        // Same goes for we_sent also, it is always set to true. TODO: fix this
-        double interval_s = rtcp->rtcp_interval(int(rtcp->members_), 1, rtcp->rtcp_bandwidth_,
-            true, (double)rtcp->avg_rtcp_size_, true, true);
-        current_interval_ms = (uint32_t)round(1000 * interval_s);
+    if (pending_fb_.empty())
+    {
+        return RTP_OK;
+    }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(current_interval_ms));
+    const uint32_t size = (uint32_t)(pending_fb_.size() + srtcp_trailer_size());
+    if (report_buffer_.size() < size)
+    {
+        report_buffer_.resize(size);
     }
-    UVG_LOG_DEBUG("Exited RTCP loop");
+
+    memcpy(report_buffer_.data(), pending_fb_.data(), pending_fb_.size());
+    memset(report_buffer_.data() + pending_fb_.size(), 0, size - pending_fb_.size());
+    pending_fb_.clear();
+
+    rtcp_pkt_sent_count_++;
+    return send_rtcp_packet(report_buffer_.data(), size, true);
+}
+
+uint32_t uvgrtp::rtcp::send_periodic_report()
+{
+    rtp_error_t ret = RTP_OK;
+
+    UVG_LOG_DEBUG("Sending RTCP report number %u", rtcp_pkt_sent_count_ + 1);
+
+    if ((ret = generate_report()) != RTP_OK && ret != RTP_NOT_READY)
+    {
+        UVG_LOG_INFO("Failed to send RTCP status report!");
+    }
+
+    // only the sources that have been silent the longest are looked at, see silence_order_
+    double timeout_interval_s = rtcp_interval(int(members_), 1, rtcp_bandwidth_,
+        true, (double)avg_rtcp_size_, false, false);
+    uint64_t timeout_ms = (uint64_t)(5 * 1000 * timeout_interval_s);
+    uint64_t now_ms = steady_ms();
+
+    std::vector<uint32_t> ssrcs_to_be_removed = {};
+    timeouts_mutex_.lock();
+    while (!silence_order_.empty() && now_ms - silence_order_.begin()->first > timeout_ms) {
+        uint32_t rm = silence_order_.begin()->second;
+        silence_order_.erase(silence_order_.begin());
+        last_heard_ms_.erase(rm);
+        ssrcs_to_be_removed.push_back(rm);
+    }
+    timeouts_mutex_.unlock();
+
+    //If some ssrcs are timed out, remove them
+    for (auto rm : ssrcs_to_be_removed) {
+        remove_timeout_ssrc(rm);
+    }
+
+    // Number of senders is hard set to 1, because it is not updated anywhere.
+    // TODO: Keep track of senders and update it here too
+    // Same goes for we_sent also, it is always set to true. TODO: fix this
+    double interval_s = rtcp_interval(int(members_), 1, rtcp_bandwidth_,
+        true, (double)avg_rtcp_size_, true, true);
+    report_interval_ms_ = (uint32_t)round(1000 * interval_s);
+
+    packet_mutex_.lock();
+    next_report_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(report_interval_ms_);
+    packet_mutex_.unlock();
+
+    return report_interval_ms_;
 }
 
 rtp_error_t uvgrtp::rtcp::set_sdes_items(const std::vector<uvgrtp::frame::rtcp_sdes_item>& items)
@@ -373,8 +903,11 @@ rtp_error_t uvgrtp::rtcp::set_sdes_items(const std::vector<uvgrtp::frame::rtcp_s
         }
     }
 
-    ourItems_.clear();
     if (!hasCname)
+        ensure_cname();
+
+    ourItems_.clear();
+    if (!hasCname && cnameItem_.length > 0)
     {
         ourItems_.push_back(cnameItem_);
     }
@@ -432,6 +965,12 @@ rtp_error_t uvgrtp::rtcp::add_participant(uint32_t ssrc)
     participants_[ssrc]->sr_frame    = nullptr;
     participants_[ssrc]->sdes_frame  = nullptr;
     participants_[ssrc]->app_frame   = nullptr;
+
+    if (xr_blocks_ & (RTP_RTCP_XR_LOSS_RLE | RTP_RTCP_XR_STAT_SUMMARY | RTP_RTCP_XR_VOIP_METRICS))
+    {
+        participants_[ssrc]->xr = std::make_shared<uvgrtp::xr_history>();
+    }
+    participants_version_.fetch_add(1, std::memory_order_release);
     participants_mutex_.unlock();
 
     return RTP_OK;
@@ -455,14 +994,20 @@ rtp_error_t uvgrtp::rtcp::remove_all_hooks()
     sdes_hook_   = nullptr;
     sdes_hook_f_ = nullptr;
     sdes_hook_u_ = nullptr;
+    sdes_view_hook_ = nullptr;
     sdes_mutex_.unlock();
 
     app_mutex_.lock();
     app_hook_   = nullptr;
     app_hook_f_ = nullptr;
     app_hook_u_ = nullptr;
+    app_view_hook_ = nullptr;
     app_mutex_.unlock();
 
+    xr_mutex_.lock();
+    xr_hook_ = nullptr;
+    xr_mutex_.unlock();
+
     send_app_mutex_.lock();
     outgoing_app_hooks_.clear();
     send_app_mutex_.unlock();
@@ -592,6 +1137,7 @@ rtp_error_t uvgrtp::rtcp::install_sdes_hook(void (*hook)(uvgrtp::frame::rtcp_sde
     sdes_hook_   = hook;
     sdes_hook_f_ = nullptr;
     sdes_hook_u_ = nullptr;
+    sdes_view_hook_ = nullptr;
     sdes_mutex_.unlock();
 
     return RTP_OK;
@@ -608,6 +1154,7 @@ rtp_error_t uvgrtp::rtcp::install_sdes_hook(std::function<void(std::shared_ptr<u
     sdes_hook_   = nullptr;
     sdes_hook_f_ = sdes_handler;
     sdes_hook_u_ = nullptr;
+    sdes_view_hook_ = nullptr;
     sdes_mutex_.unlock();
 
     return RTP_OK;
@@ -624,6 +1171,7 @@ rtp_error_t uvgrtp::rtcp::install_sdes_hook(std::function<void(std::unique_ptr<u
     sdes_hook_   = nullptr;
     sdes_hook_f_ = nullptr;
     sdes_hook_u_ = sdes_handler;
+    sdes_view_hook_ = nullptr;
     sdes_mutex_.unlock();
 
     return RTP_OK;
@@ -640,6 +1188,7 @@ rtp_error_t uvgrtp::rtcp::install_app_hook(void (*hook)(uvgrtp::frame::rtcp_app_
     app_hook_   = hook;
     app_hook_f_ = nullptr;
     app_hook_u_ = nullptr;
+    app_view_hook_ = nullptr;
     app_mutex_.unlock();
 
     return RTP_OK;
@@ -656,6 +1205,7 @@ rtp_error_t uvgrtp::rtcp::install_app_hook(std::function<void(std::shared_ptr<uv
     app_hook_   = nullptr;
     app_hook_f_ = app_handler;
     app_hook_u_ = nullptr;
+    app_view_hook_ = nullptr;
     app_mutex_.unlock();
 
     return RTP_OK;
@@ -686,6 +1236,41 @@ rtp_error_t uvgrtp::rtcp::install_app_hook(std::function<void(std::unique_ptr<uv
     app_hook_   = nullptr;
     app_hook_f_ = nullptr;
     app_hook_u_ = app_handler;
+    app_view_hook_ = nullptr;
+    app_mutex_.unlock();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::install_sdes_view_hook(std::function<void(const uvgrtp::frame::rtcp_sdes_packet&)> sdes_handler)
+{
+    if (!sdes_handler)
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    sdes_mutex_.lock();
+    sdes_hook_   = nullptr;
+    sdes_hook_f_ = nullptr;
+    sdes_hook_u_ = nullptr;
+    sdes_view_hook_ = sdes_handler;
+    sdes_mutex_.unlock();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::install_app_view_hook(std::function<void(const uvgrtp::frame::rtcp_app_packet&)> app_handler)
+{
+    if (!app_handler)
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    app_mutex_.lock();
+    app_hook_   = nullptr;
+    app_hook_f_ = nullptr;
+    app_hook_u_ = nullptr;
+    app_view_hook_ = app_handler;
     app_mutex_.unlock();
 
     return RTP_OK;
@@ -817,10 +1402,35 @@ void uvgrtp::rtcp::zero_stats(uvgrtp::receiver_statistics *stats)
     stats->cycles   = 0;
 }
 
-bool uvgrtp::rtcp::is_participant(uint32_t ssrc) const
+bool uvgrtp::rtcp::is_participant(uint32_t ssrc) const
+{
+    std::lock_guard<std::mutex> prtcp_lock(participants_mutex_);
+    return participants_.find(ssrc) != participants_.end();
+}
+
+uvgrtp::rtcp_participant *uvgrtp::rtcp::find_rx_participant(uint32_t ssrc)
 {
+    rx_participant_entry& entry = rx_participants[instance_ % RX_PARTICIPANT_CACHE_SIZE];
+
+    if (entry.instance == instance_ && entry.ssrc == ssrc &&
+        entry.version == participants_version_.load(std::memory_order_acquire))
+    {
+        return entry.participant.get();
+    }
+
     std::lock_guard<std::mutex> prtcp_lock(participants_mutex_);
-    return participants_.find(ssrc) != participants_.end();
+    auto it = participants_.find(ssrc);
+    if (it == participants_.end())
+    {
+        return nullptr;
+    }
+
+    entry.instance    = instance_;
+    entry.ssrc        = ssrc;
+    entry.version     = participants_version_.load(std::memory_order_relaxed);
+    entry.participant = it->second;
+
+    return entry.participant.get();
 }
 
 void uvgrtp::rtcp::set_ts_info(uint64_t clock_start, uint32_t clock_rate, uint32_t rtp_ts_start)
@@ -857,12 +1467,7 @@ rtp_error_t uvgrtp::rtcp::init_new_participant(const uvgrtp::frame::rtp_frame *f
         return ret;
     }
 
-    if (ms_since_last_rep_.find(sender_ssrc) != ms_since_last_rep_.end()) {
-        ms_since_last_rep_.at(sender_ssrc) = 0;
-    }
-    else {
-        ms_since_last_rep_.insert({ sender_ssrc, 0 });
-    }
+    heard_from(sender_ssrc);
     
     if ((ret = uvgrtp::rtcp::add_participant(frame->header.ssrc)) != RTP_OK)
     {
@@ -884,6 +1489,7 @@ rtp_error_t uvgrtp::rtcp::init_new_participant(const uvgrtp::frame::rtp_frame *f
      * Save the timestamp and current NTP timestamp so we can do jitter calculations later on */
     participants_[frame->header.ssrc]->stats.initial_rtp = frame->header.timestamp;
     participants_[frame->header.ssrc]->stats.initial_ntp = uvgrtp::clock::ntp::now();
+    participants_[frame->header.ssrc]->stats.initial_recv_time = frame->recv_time;
     participants_mutex_.unlock();
 
     senders_++;
@@ -919,66 +1525,65 @@ rtp_error_t uvgrtp::rtcp::init_participant_seq(uint32_t ssrc, uint16_t base_seq)
         return RTP_NOT_FOUND;
     }
 
-    participants_[ssrc]->stats.base_seq = base_seq;
-    participants_[ssrc]->stats.max_seq  = base_seq;
-    participants_[ssrc]->stats.bad_seq  = (RTP_SEQ_MOD + 1)%UINT32_MAX;
+    init_participant_seq(participants_[ssrc].get(), base_seq);
 
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::rtcp::update_participant_seq(uint32_t ssrc, uint16_t seq)
+void uvgrtp::rtcp::init_participant_seq(rtcp_participant *participant, uint16_t base_seq)
 {
-    std::unique_lock<std::mutex> prtcp_lock(participants_mutex_);
-    if (participants_.find(ssrc) == participants_.end())
-    {
-        UVG_LOG_ERROR("Did not find participant SSRC when updating seq");
-        return RTP_GENERIC_ERROR;
-    }
+    participant->stats.base_seq.store(base_seq, std::memory_order_relaxed);
+    participant->stats.max_seq.store(base_seq, std::memory_order_relaxed);
+    participant->stats.bad_seq = (RTP_SEQ_MOD + 1)%UINT32_MAX;
+}
 
-    uint16_t udelta = seq - participants_[ssrc]->stats.max_seq;
+rtp_error_t uvgrtp::rtcp::update_participant_seq(rtcp_participant *participant, uint16_t seq)
+{
+    /* The receiving thread is the only writer of the counters so they are
+     * read and written separately instead of with atomic read-modify-writes */
+    receiver_statistics& stats = participant->stats;
+    uint16_t max_seq = stats.max_seq.load(std::memory_order_relaxed);
+    uint16_t udelta = seq - max_seq;
 
     /* Source is not valid until MIN_SEQUENTIAL packets with
     * sequential sequence numbers have been received.  */
-    if (participants_[ssrc]->probation)
+    if (participant->probation)
     {
        /* packet is in sequence */
-       if (seq == participants_[ssrc]->stats.max_seq + 1)
+       if (seq == max_seq + 1)
        {
-           participants_[ssrc]->probation--;
-           participants_[ssrc]->stats.max_seq = seq;
-           if (!participants_[ssrc]->probation)
+           participant->probation--;
+           stats.max_seq.store(seq, std::memory_order_relaxed);
+           if (!participant->probation)
            {
-               prtcp_lock.unlock();
-               uvgrtp::rtcp::init_participant_seq(ssrc, seq);
+               init_participant_seq(participant, seq);
                return RTP_OK;
            }
        } else {
-           participants_[ssrc]->probation = MIN_SEQUENTIAL - 1;
-           participants_[ssrc]->stats.max_seq = seq;
+           participant->probation = MIN_SEQUENTIAL - 1;
+           stats.max_seq.store(seq, std::memory_order_relaxed);
        }
 
        return RTP_NOT_READY;
     } else if (udelta < MAX_DROPOUT) {
        /* in order, with permissible gap */
-       if (seq < participants_[ssrc]->stats.max_seq)
+       if (seq < max_seq)
        {
            /* Sequence number wrapped - count another 64K cycle.  */
-           participants_[ssrc]->stats.cycles += 1;
+           stats.cycles.store(stats.cycles.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
        }
-       participants_[ssrc]->stats.max_seq = seq;
+       stats.max_seq.store(seq, std::memory_order_relaxed);
     } else if (udelta <= RTP_SEQ_MOD - MAX_MISORDER) {
        /* the sequence number made a very large jump */
-       if (seq == participants_[ssrc]->stats.bad_seq)
+       if (seq == stats.bad_seq)
        {
            /* Two sequential packets -- assume that the other side
             * restarted without telling us so just re-sync
             * (i.e., pretend this was the first packet).  */
-           prtcp_lock.unlock();
-           uvgrtp::rtcp::init_participant_seq(ssrc, seq);
-           prtcp_lock.lock();
+           init_participant_seq(participant, seq);
        } else {
-           participants_[ssrc]->stats.bad_seq = (seq + 1) & (RTP_SEQ_MOD - 1);
-           UVG_LOG_ERROR("Invalid sequence number. Seq jump: %u -> %u", participants_[ssrc]->stats.max_seq, seq);
+           stats.bad_seq = (seq + 1) & (RTP_SEQ_MOD - 1);
+           UVG_LOG_ERROR("Invalid sequence number. Seq jump: %u -> %u", max_seq, seq);
            return RTP_GENERIC_ERROR;
        }
     } else {
@@ -1007,35 +1612,57 @@ bool uvgrtp::rtcp::collision_detected(uint32_t ssrc) const
     return participants_.find(ssrc) == participants_.end();
 }
 
-void uvgrtp::rtcp::update_session_statistics(const uvgrtp::frame::rtp_frame *frame)
+void uvgrtp::rtcp::update_session_statistics(rtcp_participant *participant, const uvgrtp::frame::rtp_frame *frame)
 {
-    std::lock_guard<std::mutex> prtcp_lock(participants_mutex_);
-    participants_[frame->header.ssrc]->stats.received_rtp_packet = true;
+    receiver_statistics& stats = participant->stats;
+
+    // the first packet since the last report puts the participant into the next report
+    if (!stats.received_rtp_packet.exchange(true, std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(dirty_mutex_);
+        dirty_ssrcs_.push_back(frame->header.ssrc);
+    }
 
-    participants_[frame->header.ssrc]->stats.received_pkts  += 1;
-    participants_[frame->header.ssrc]->stats.received_bytes += (uint32_t)frame->payload_len;
+    uint32_t received_pkts = stats.received_pkts.load(std::memory_order_relaxed) + 1;
+    stats.received_pkts.store(received_pkts, std::memory_order_relaxed);
+    stats.received_bytes.store(stats.received_bytes.load(std::memory_order_relaxed) +
+        (uint32_t)frame->payload_len, std::memory_order_relaxed);
 
     /* calculate number of dropped packets */
-    int extended_max = (static_cast<int>(participants_[frame->header.ssrc]->stats.cycles) << 16) + 
-        participants_[frame->header.ssrc]->stats.max_seq;
-    int expected     = extended_max - participants_[frame->header.ssrc]->stats.base_seq + 1;
+    int extended_max = (static_cast<int>(stats.cycles.load(std::memory_order_relaxed)) << 16) +
+        stats.max_seq.load(std::memory_order_relaxed);
+    int expected     = extended_max - (int)stats.base_seq.load(std::memory_order_relaxed) + 1;
+
+    int dropped = expected - (int)received_pkts;
+    stats.lost_pkts.store(dropped >= 0 ? dropped : 0, std::memory_order_relaxed);
 
-    int dropped = expected - participants_[frame->header.ssrc]->stats.received_pkts;
-    participants_[frame->header.ssrc]->stats.lost_pkts = dropped >= 0 ? dropped : 0;
+    // the arrival time expressed as an RTP timestamp. The receive times of the packets are used
+    // if they are known, so the time the packet waited to be processed is not counted as jitter
+    uint32_t arrival = 0;
 
-    // the arrival time expressed as an RTP timestamp
-    uint32_t arrival = participants_[frame->header.ssrc]->stats.initial_rtp +
-        (uint32_t)uvgrtp::clock::ntp::diff_now(participants_[frame->header.ssrc]->stats.initial_ntp)*
-        (participants_[frame->header.ssrc]->stats.clock_rate / 1000);
+    if (frame->recv_time && stats.initial_recv_time && frame->recv_time >= stats.initial_recv_time) {
+        uint64_t elapsed_us = (frame->recv_time - stats.initial_recv_time) / 1000;
+        arrival = stats.initial_rtp + (uint32_t)(elapsed_us * stats.clock_rate / 1000000);
+    } else {
+        arrival = stats.initial_rtp +
+            (uint32_t)uvgrtp::clock::ntp::diff_now(stats.initial_ntp)*
+            (stats.clock_rate / 1000);
+    }
 
     // calculate interarrival jitter. See RFC 3550 A.8
     uint32_t transit = arrival - frame->header.timestamp; // A.8: int transit = arrival - r->ts
-    uint32_t trans_difference = std::abs((int)(transit - participants_[frame->header.ssrc]->stats.transit));
+    uint32_t trans_difference = std::abs((int)(transit - stats.transit));
 
     // update statistics
-    participants_[frame->header.ssrc]->stats.transit = transit;
-    participants_[frame->header.ssrc]->stats.jitter += (1.f / 16.f) * 
-        ((double)trans_difference - participants_[frame->header.ssrc]->stats.jitter);
+    stats.transit = transit;
+    double jitter = stats.jitter.load(std::memory_order_relaxed);
+    stats.jitter.store(jitter + (1.f / 16.f) * ((double)trans_difference - jitter), std::memory_order_relaxed);
+
+    // as with the report blocks, the history starts when the source has passed the probation
+    if (participant->xr && !participant->probation)
+    {
+        participant->xr->packet_received(frame->header.seq, trans_difference);
+    }
 }
 
 /* RTCP packet handler is responsible for doing two things:
@@ -1056,6 +1683,15 @@ rtp_error_t uvgrtp::rtcp::recv_packet_handler_common(void *arg, int rce_flags, u
     uvgrtp::frame::rtp_frame *frame = *out;
     uvgrtp::rtcp *rtcp              = (uvgrtp::rtcp *)arg;
 
+    uint8_t twcc_ext_id = rtcp->twcc_ext_id_.load(std::memory_order_relaxed);
+    uint16_t twcc_seq   = 0;
+
+    if (twcc_ext_id && uvgrtp::read_twcc_extension(frame->ext, twcc_ext_id, twcc_seq))
+    {
+        rtcp->twcc_receiver_->packet_received(frame->header.ssrc, twcc_seq, frame->recv_time ?
+            uvgrtp::clock::steady_from_system_ns(frame->recv_time) : std::chrono::steady_clock::now());
+    }
+
     /* If this is the first packet from remote, move the participant from initial_participants_
      * to participants_, initialize its state and put it on probation until enough valid
      * packets from them have been received
@@ -1063,14 +1699,16 @@ rtp_error_t uvgrtp::rtcp::recv_packet_handler_common(void *arg, int rce_flags, u
      * Otherwise update and monitor the received sequence numbers to determine whether something
      * has gone awry with the sender's sequence number calculations/delivery of packets */
     rtp_error_t ret = RTP_OK;
-    if (!rtcp->is_participant(frame->header.ssrc))
+    uvgrtp::rtcp_participant *participant = rtcp->find_rx_participant(frame->header.ssrc);
+    if (!participant)
     {
-        if ((rtcp->init_new_participant(frame)) != RTP_OK)
+        if ((rtcp->init_new_participant(frame)) != RTP_OK ||
+            !(participant = rtcp->find_rx_participant(frame->header.ssrc)))
         {
             UVG_LOG_ERROR("Failed to initiate new participant");
             return RTP_GENERIC_ERROR;
         }
-    } else if ((ret = rtcp->update_participant_seq(frame->header.ssrc, frame->header.seq)) != RTP_OK) {
+    } else if ((ret = rtcp->update_participant_seq(participant, frame->header.seq)) != RTP_OK) {
         if (ret == RTP_NOT_READY) {
             return RTP_OK;
         }
@@ -1081,7 +1719,7 @@ rtp_error_t uvgrtp::rtcp::recv_packet_handler_common(void *arg, int rce_flags, u
     }
 
     /* Finally update the jitter/transit/received/dropped bytes/pkts statistics */
-    rtcp->update_session_statistics(frame);
+    rtcp->update_session_statistics(participant, frame);
 
     /* Even though RTCP collects information from the packet, this is not the packet's final destination.
      * Thus return RTP_PKT_NOT_HANDLED to indicate that the packet should be passed on to other handlers */
@@ -1090,6 +1728,7 @@ rtp_error_t uvgrtp::rtcp::recv_packet_handler_common(void *arg, int rce_flags, u
 
 rtp_error_t uvgrtp::rtcp::send_packet_handler_vec(void *arg, uvgrtp::buf_vec& buffers)
 {
+    uvgrtp::rtcp *rtcp = (uvgrtp::rtcp *)arg;
     ssize_t pkt_size = -RTP_HDR_SIZE;
 
     for (auto& buffer : buffers)
@@ -1102,7 +1741,39 @@ rtp_error_t uvgrtp::rtcp::send_packet_handler_vec(void *arg, uvgrtp::buf_vec& bu
         return RTP_INVALID_VALUE;
     }
 
-    return ((uvgrtp::rtcp *)arg)->update_sender_stats(pkt_size);
+    // the packets of the simulcast layers are counted to their own sender reports
+    if (rtcp->has_simulcast_.load(std::memory_order_relaxed))
+    {
+        uint32_t ssrc = ntohl(((uvgrtp::frame::rtp_header *)buffers.at(0).second)->ssrc);
+        std::shared_ptr<const std::vector<simulcast_source>> sources = std::atomic_load(&rtcp->simulcast_sources_);
+
+        for (auto& source : *sources)
+        {
+            if (source.ssrc->load(std::memory_order_relaxed) == ssrc)
+            {
+                source.stats->sent_pkts  += 1;
+                source.stats->sent_bytes += (uint32_t)pkt_size;
+                source.stats->sent_rtp_packet = true;
+                return RTP_OK;
+            }
+        }
+    }
+
+    return rtcp->update_sender_stats(pkt_size);
+}
+
+void uvgrtp::rtcp::add_simulcast_source(std::shared_ptr<std::atomic<std::uint32_t>> ssrc, std::shared_ptr<uvgrtp::rtp> rtp)
+{
+    std::lock_guard<std::mutex> lock(packet_mutex_);
+
+    std::shared_ptr<std::vector<simulcast_source>> sources = std::make_shared<std::vector<simulcast_source>>();
+    if (simulcast_sources_)
+        *sources = *simulcast_sources_;
+
+    sources->push_back({ ssrc, rtp, std::make_shared<sender_statistics>() });
+
+    std::atomic_store(&simulcast_sources_, std::shared_ptr<const std::vector<simulcast_source>>(sources));
+    has_simulcast_.store(true, std::memory_order_relaxed);
 }
 
 size_t uvgrtp::rtcp::rtcp_length_in_bytes(uint16_t length)
@@ -1130,6 +1801,9 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(void* args, int rce_flags, uint
 
     int packets = 0;
 
+    /* Feedback messages may be sent alone, see RFC 5506 */
+    bool feedback_only = true;
+
     update_rtcp_bandwidth(size);
     update_avg_rtcp_size(size);
 
@@ -1143,7 +1817,7 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(void* args, int rce_flags, uint
         sender_ssrc = ntohl(*(uint32_t*)& buffer[read_ptr + RTCP_HEADER_SIZE]);
         
         if (srtcp_ && (ret = srtcp_->handle_rtcp_decryption(rce_flags_, sender_ssrc, 
-            buffer + RTCP_HEADER_SIZE + SSRC_CSRC_SIZE, size)) != RTP_OK)
+            buffer, size)) != RTP_OK)
         {
             UVG_LOG_ERROR("Failed at decryption");
             return ret;
@@ -1193,19 +1867,19 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(void* args, int rce_flags, uint
         }
 
         /* Update the timeout map */
-        if (ms_since_last_rep_.find(sender_ssrc) != ms_since_last_rep_.end()) {
-            ms_since_last_rep_.at(sender_ssrc) = 0;
-        }
-        else {            
-            ms_since_last_rep_.insert({ sender_ssrc, 0 });
-        }
-        if (header.pkt_type > uvgrtp::frame::RTCP_FT_APP ||
+        heard_from(sender_ssrc);
+        if (header.pkt_type > uvgrtp::frame::RTCP_FT_XR ||
             header.pkt_type < uvgrtp::frame::RTCP_FT_SR)
         {
             UVG_LOG_ERROR("Invalid packet type (%u)!", header.pkt_type);
             return RTP_INVALID_VALUE;
         }
 
+        if (header.pkt_type != uvgrtp::frame::RTCP_FT_RTPFB && header.pkt_type != uvgrtp::frame::RTCP_FT_PSFB)
+        {
+            feedback_only = false;
+        }
+
         ret = RTP_INVALID_VALUE;
 
         switch (header.pkt_type)
@@ -1238,6 +1912,10 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(void* args, int rce_flags, uint
                 ret = handle_fb_packet(buffer, read_ptr, packet_end, header);
                 break;
 
+            case uvgrtp::frame::RTCP_FT_XR:
+                ret = handle_xr_packet(buffer, read_ptr, packet_end, header);
+                break;
+
             default:
                 UVG_LOG_WARN("Unknown packet received, type %d", header.pkt_type);
                 break;
@@ -1257,7 +1935,7 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(void* args, int rce_flags, uint
     {
         UVG_LOG_DEBUG("Received a compound RTCP frame with %i packets and size: %li", packets, size);
     }
-    else
+    else if (!feedback_only)
     {
         UVG_LOG_WARN("Received RTCP packet was not a compound packet!");
     }
@@ -1435,13 +2113,25 @@ rtp_error_t uvgrtp::rtcp::handle_sdes_packet(uint8_t* packet, size_t& read_ptr,
         add_participant(sender_ssrc);
     }
 
-    auto frame = new uvgrtp::frame::rtcp_sdes_packet;
+    std::lock_guard<std::mutex> sdes_lock(sdes_mutex_);
+
+    /* A view hook is given items that point to the received packet, so the packet is parsed
+     * into the same frame each time. The other hooks own the frame and the copied items */
+    bool view = (bool)sdes_view_hook_;
+    uvgrtp::frame::rtcp_sdes_packet* frame = view ? &sdes_view_ : new uvgrtp::frame::rtcp_sdes_packet;
     frame->header = header;
+    size_t chunks = 0;
 
     // Read SDES chunks
     while (read_ptr + SSRC_CSRC_SIZE <= packet_end)
     {
-        uvgrtp::frame::rtcp_sdes_chunk chunk;
+        if (chunks == frame->chunks.size())
+        {
+            frame->chunks.emplace_back();
+        }
+
+        uvgrtp::frame::rtcp_sdes_chunk& chunk = frame->chunks[chunks++];
+        chunk.items.clear();
         read_ssrc(packet, read_ptr, chunk.ssrc);
 
         // Read chunk items, 2 makes sure we at least get item type and length
@@ -1454,9 +2144,15 @@ rtp_error_t uvgrtp::rtcp::handle_sdes_packet(uint8_t* packet, size_t& read_ptr,
 
             if (read_ptr + item.length <= packet_end)
             {
-                item.data = new uint8_t[item.length];
-
-                memcpy(item.data, &packet[read_ptr], item.length);
+                if (view)
+                {
+                    item.data = &packet[read_ptr];
+                }
+                else
+                {
+                    item.data = new uint8_t[item.length];
+                    memcpy(item.data, &packet[read_ptr], item.length);
+                }
                 read_ptr += item.length;
             }
 
@@ -1467,12 +2163,12 @@ rtp_error_t uvgrtp::rtcp::handle_sdes_packet(uint8_t* packet, size_t& read_ptr,
         {
             read_ptr += (4 - read_ptr % 4);
         }
-
-        frame->chunks.push_back(chunk);
     }
+    frame->chunks.resize(chunks);
 
-    sdes_mutex_.lock();
-    if (sdes_hook_) {
+    if (view) {
+        sdes_view_hook_(*frame);
+    } else if (sdes_hook_) {
         sdes_hook_(frame);
     } else if (sdes_hook_f_) {
         sdes_hook_f_(std::shared_ptr<uvgrtp::frame::rtcp_sdes_packet>(frame));
@@ -1497,8 +2193,6 @@ rtp_error_t uvgrtp::rtcp::handle_sdes_packet(uint8_t* packet, size_t& read_ptr,
 
         participants_[sender_ssrc]->sdes_frame = frame;
     }
-    sdes_mutex_.unlock();
-
 
     return RTP_OK;
 }
@@ -1525,8 +2219,9 @@ rtp_error_t uvgrtp::rtcp::handle_bye_packet(uint8_t* packet, size_t& read_ptr,
         participants_mutex_.lock();
         free_participant(std::move(participants_[ssrc]));
         participants_.erase(ssrc);
-        ms_since_last_rep_.erase(ssrc);
+        participants_version_.fetch_add(1, std::memory_order_release);
         participants_mutex_.unlock();
+        forget_source(ssrc);
     }
     // TODO: RFC3550 6.2.1: add a delay for deleting the member. This way if straggler packets
     // are received after deletion, deleted member wont be recreated
@@ -1541,24 +2236,35 @@ rtp_error_t uvgrtp::rtcp::handle_bye_packet(uint8_t* packet, size_t& read_ptr,
 rtp_error_t uvgrtp::rtcp::handle_app_packet(uint8_t* packet, size_t& read_ptr,
     size_t packet_end, uvgrtp::frame::rtcp_header& header)
 {
-    auto frame = new uvgrtp::frame::rtcp_app_packet;
-    frame->header = header;
-    read_ssrc(packet, read_ptr, frame->ssrc);
+    uint32_t sender_ssrc = 0;
+    read_ssrc(packet, read_ptr, sender_ssrc);
 
     /* Deallocate previous frame from the buffer if it exists, it's going to get overwritten */
-    if (!is_participant(frame->ssrc))
+    if (!is_participant(sender_ssrc))
     {
         UVG_LOG_WARN("Got an APP packet from an unknown participant");
-        add_participant(frame->ssrc);
+        add_participant(sender_ssrc);
     }
 
+    std::lock_guard<std::mutex> app_lock(app_mutex_);
+
+    // a view hook is given the payload in the received packet, the other hooks own a copy
+    bool view = (bool)app_view_hook_;
+    uvgrtp::frame::rtcp_app_packet* frame = view ? &app_view_ : new uvgrtp::frame::rtcp_app_packet;
+    frame->header = header;
+    frame->ssrc = sender_ssrc;
+
     // copy app name and application-dependent data from network packet to RTCP structures
     memcpy(frame->name, &packet[read_ptr], APP_NAME_SIZE);
     read_ptr += APP_NAME_SIZE;
 
     frame->payload_len = packet_end - read_ptr;
 
-    if (frame->payload_len > 0)
+    if (frame->payload_len > 0 && view)
+    {
+        frame->payload = &packet[read_ptr];
+    }
+    else if (frame->payload_len > 0)
     {
         // application data is saved to payload
         frame->payload = new uint8_t[frame->payload_len];
@@ -1569,8 +2275,9 @@ rtp_error_t uvgrtp::rtcp::handle_app_packet(uint8_t* packet, size_t& read_ptr,
         frame->payload = nullptr;
     }
 
-    app_mutex_.lock();
-    if (app_hook_) {
+    if (view) {
+        app_view_hook_(*frame);
+    } else if (app_hook_) {
         app_hook_(frame);
     } else if (app_hook_f_) {
         app_hook_f_(std::shared_ptr<uvgrtp::frame::rtcp_app_packet>(frame));
@@ -1586,7 +2293,59 @@ rtp_error_t uvgrtp::rtcp::handle_app_packet(uint8_t* packet, size_t& read_ptr,
 
         participants_[frame->ssrc]->app_frame = frame;
     }
-    app_mutex_.unlock();
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::rtcp::handle_xr_packet(uint8_t* buffer, size_t& read_ptr, size_t packet_end,
+    uvgrtp::frame::rtcp_header& header)
+{
+    if (read_ptr + SSRC_CSRC_SIZE > packet_end)
+    {
+        UVG_LOG_ERROR("Received an RTCP XR packet without an SSRC");
+        return RTP_INVALID_VALUE;
+    }
+
+    uint32_t sender_ssrc = 0;
+    read_ssrc(buffer, read_ptr, sender_ssrc);
+
+    std::lock_guard<std::mutex> lock(xr_mutex_);
+
+    if (!read_xr_blocks(buffer, read_ptr, packet_end, xr_view_))
+    {
+        return RTP_INVALID_VALUE;
+    }
+    xr_view_.header = header;
+    xr_view_.ssrc   = sender_ssrc;
+
+    // the middle 32 bits of the NTP timestamps, as with LSR
+    if (xr_view_.has_rrt)
+    {
+        xr_rrts_[sender_ssrc] = { (uint32_t)(xr_view_.rrt_ntp >> 16), uvgrtp::clock::hrc::now() };
+    }
+
+    uint32_t our_ssrc = *ssrc_.get();
+    for (auto& item : xr_view_.dlrr)
+    {
+        if (item.ssrc != our_ssrc || item.lrr == 0)
+        {
+            continue;
+        }
+
+        uint32_t now = (uint32_t)(uvgrtp::clock::ntp::now() >> 16);
+        uint32_t rtt = now - item.lrr - item.dlrr;
+
+        // a remote with a clock that does not advance evenly could give a negative time
+        if ((int32_t)rtt >= 0)
+        {
+            xr_rtt_ms_ = rtt * 1000.0 / 65536.0;
+        }
+    }
+
+    if (xr_hook_)
+    {
+        xr_hook_(xr_view_);
+    }
 
     return RTP_OK;
 }
@@ -1609,7 +2368,22 @@ rtp_error_t uvgrtp::rtcp::handle_fb_packet(uint8_t* packet, size_t& read_ptr,
         switch (header.fmt)
         {
             case uvgrtp::frame::RTCP_PSFB_PLI:
+            {
+                if (packet_end < read_ptr + SSRC_CSRC_SIZE)
+                {
+                    UVG_LOG_ERROR("Received a PLI packet that is too small");
+                    delete frame;
+                    return RTP_INVALID_VALUE;
+                }
+                read_ssrc(packet, read_ptr, frame->media_ssrc);
+
+                if (frame->media_ssrc == *ssrc_.get())
+                {
+                    UVG_LOG_DEBUG("Received a PLI from %lu", frame->sender_ssrc);
+                    key_frame_requested();
+                }
                 break;
+            }
 
             case uvgrtp::frame::RTCP_PSFB_SLI:
                 break;
@@ -1618,7 +2392,44 @@ rtp_error_t uvgrtp::rtcp::handle_fb_packet(uint8_t* packet, size_t& read_ptr,
                 break;
 
             case uvgrtp::frame::RTCP_PSFB_FIR:
+            {
+                size_t fci_end = packet_end - std::min(packet_end, srtcp_trailer_size());
+
+                if (fci_end < read_ptr + SSRC_CSRC_SIZE)
+                {
+                    UVG_LOG_ERROR("Received a FIR packet that is too small");
+                    delete frame;
+                    return RTP_INVALID_VALUE;
+                }
+                read_ssrc(packet, read_ptr, frame->media_ssrc);
+
+                bool requested = false;
+                for (; read_ptr + SSRC_CSRC_SIZE + 4 <= fci_end; read_ptr += SSRC_CSRC_SIZE + 4)
+                {
+                    uint32_t ssrc = ntohl(*(uint32_t*)&packet[read_ptr]);
+                    uint8_t seq   = packet[read_ptr + SSRC_CSRC_SIZE];
+
+                    // a repeated request has the same sequence number as the one already served
+                    if (ssrc == *ssrc_.get())
+                    {
+                        std::lock_guard<std::mutex> lock(fb_mutex_);
+                        auto last = fir_seqs_.find(frame->sender_ssrc);
+
+                        if (last == fir_seqs_.end() || last->second != seq)
+                        {
+                            fir_seqs_[frame->sender_ssrc] = seq;
+                            requested = true;
+                        }
+                    }
+                }
+
+                if (requested)
+                {
+                    UVG_LOG_DEBUG("Received a FIR from %lu", frame->sender_ssrc);
+                    key_frame_requested();
+                }
                 break;
+            }
 
             case uvgrtp::frame::RTCP_PSFB_TSTR:
                 break;
@@ -1636,7 +2447,65 @@ rtp_error_t uvgrtp::rtcp::handle_fb_packet(uint8_t* packet, size_t& read_ptr,
         switch (header.fmt)
         {
         case uvgrtp::frame::RTCP_RTPFB_NACK:
+        {
+            // the SRTCP trailer is counted in the length, see send_nack()
+            size_t fci_end = packet_end - std::min(packet_end, srtcp_trailer_size());
+
+            if (fci_end < read_ptr + SSRC_CSRC_SIZE)
+            {
+                UVG_LOG_ERROR("Received a NACK packet that is too small");
+                delete frame;
+                return RTP_INVALID_VALUE;
+            }
+            read_ssrc(packet, read_ptr, frame->media_ssrc);
+
+            std::vector<uint16_t> seqs;
+            for (; read_ptr + 4 <= fci_end; read_ptr += 4)
+            {
+                uint16_t pid = ntohs(*(uint16_t*)&packet[read_ptr]);
+                uint16_t blp = ntohs(*(uint16_t*)&packet[read_ptr + 2]);
+
+                seqs.push_back(pid);
+                for (uint16_t i = 0; i < 16; ++i)
+                {
+                    if (blp & (1 << i))
+                        seqs.push_back((uint16_t)(pid + i + 1));
+                }
+            }
+
+            fb_mutex_.lock();
+            std::shared_ptr<uvgrtp::packet_history> history = packet_history_;
+            fb_mutex_.unlock();
+
+            if (history)
+            {
+                size_t resent = history->resend(seqs);
+                (void)resent;
+                UVG_LOG_DEBUG("Resent %zu of the %zu packets asked for", resent, seqs.size());
+            }
+            break;
+        }
+
+        case uvgrtp::frame::RTCP_RTPFB_TWCC:
+        {
+            if (packet_end < read_ptr + SSRC_CSRC_SIZE)
+            {
+                UVG_LOG_ERROR("Received a TWCC feedback packet that is too small");
+                delete frame;
+                return RTP_INVALID_VALUE;
+            }
+            read_ssrc(packet, read_ptr, frame->media_ssrc);
+
+            fb_mutex_.lock();
+            std::shared_ptr<uvgrtp::twcc_sender> sender = twcc_sender_;
+            fb_mutex_.unlock();
+
+            if (sender && sender->feedback_received(&packet[read_ptr], packet_end - read_ptr) != RTP_OK)
+            {
+                UVG_LOG_WARN("Received a malformed TWCC feedback packet");
+            }
             break;
+        }
 
         default:
             UVG_LOG_WARN("Unknown RTCP RTPFB packet received, type %d", header.fmt);
@@ -1647,6 +2516,8 @@ rtp_error_t uvgrtp::rtcp::handle_fb_packet(uint8_t* packet, size_t& read_ptr,
     fb_mutex_.lock();
     if (fb_hook_u_) {
         fb_hook_u_(std::unique_ptr<uvgrtp::frame::rtcp_fb_packet>(frame));
+    } else {
+        delete frame;
     }
     fb_mutex_.unlock();
     return RTP_OK;
@@ -1660,13 +2531,20 @@ rtp_error_t uvgrtp::rtcp::send_rtcp_packet_to_participants(uint8_t* frame, uint3
         return RTP_GENERIC_ERROR;
     }
 
+    rtp_error_t ret = send_rtcp_packet(frame, frame_size, encrypt);
+
+    delete[] frame;
+    return ret;
+}
+
+rtp_error_t uvgrtp::rtcp::send_rtcp_packet(uint8_t* frame, uint32_t frame_size, bool encrypt)
+{
     rtp_error_t ret = RTP_OK;
 
     if (encrypt && srtcp_ && 
         (ret = srtcp_->handle_rtcp_encryption(rce_flags_, rtcp_pkt_sent_count_, *ssrc_.get(), frame, frame_size)) != RTP_OK)
     {
         UVG_LOG_DEBUG("Encryption failed. Not sending packet");
-        delete[] frame;
         return ret;
     }
 
@@ -1686,8 +2564,7 @@ rtp_error_t uvgrtp::rtcp::send_rtcp_packet_to_participants(uint8_t* frame, uint3
     {
         UVG_LOG_ERROR("Tried to send RTCP packet when socket does not exist!");
     }
-    
-    delete[] frame;
+
     return ret;
 }
 
@@ -1706,7 +2583,7 @@ uint32_t uvgrtp::rtcp::size_of_ready_app_packets() const
     return app_size;
 }
 
-uint32_t uvgrtp::rtcp::size_of_apps_from_hook(std::vector<std::shared_ptr<rtcp_app_packet>> packets) const
+uint32_t uvgrtp::rtcp::size_of_apps_from_hook(const std::vector<std::shared_ptr<rtcp_app_packet>>& packets) const
 {
     uint32_t app_size = 0;
     for (auto& pkt : packets)
@@ -1758,7 +2635,27 @@ uint32_t uvgrtp::rtcp::size_of_compound_packet(uint16_t reports,
     return compound_packet_size;
 }
 
+void uvgrtp::rtcp::sender_report_times(uvgrtp::rtp& rtp, uint32_t clock_rate, uint64_t& ntp_ts, uint32_t& rtp_ts)
+{
+    // with a media clock, both times of the report are read from it at once
+    if (rtp.get_media_clock_time(ntp_ts, rtp_ts))
+        return;
+
+    // This is the timestamp when the LAST rtp frame was sampled
+    uint64_t sampling_ntp_ts = rtp.get_sampling_ntp();
+    ntp_ts = uvgrtp::clock::ntp::now();
+
+    uint64_t diff_ms = uvgrtp::clock::ntp::diff(sampling_ntp_ts, ntp_ts);
+
+    rtp_ts = rtp.get_rtp_ts() + (uint32_t)(diff_ms * (double(clock_rate) / 1000));
+}
+
 rtp_error_t uvgrtp::rtcp::generate_report()
+{
+    return send_compound_report(false);
+}
+
+rtp_error_t uvgrtp::rtcp::send_compound_report(bool early)
 {
     /* Check the participants_ map. If there is no other participants, don't send report */
     if (participants_.empty()) {
@@ -1770,23 +2667,43 @@ rtp_error_t uvgrtp::rtcp::generate_report()
     std::lock_guard<std::mutex> lock(packet_mutex_);
     rtcp_pkt_sent_count_++;
 
+    // a regular report starts the interval of the next early packet
+    if (!early)
+    {
+        allow_early_ = true;
+    }
+
     bool sr_packet = our_role_ == SENDER && our_stats.sent_rtp_packet;
     bool rr_packet = our_role_ == RECEIVER || our_stats.sent_rtp_packet == 0;
     bool sdes_packet = true;
     uint32_t app_packets_size = size_of_ready_app_packets();
     bool bye_packet = !bye_ssrcs_.empty();
 
-    // Unique lock unlocks when exiting the scope
-    std::unique_lock<std::mutex> prtcp_lock(participants_mutex_);
-    uint8_t reports = 0;
-    for (auto& p : participants_)
+    /* Only the participants that have sent RTP since the last report are looked up. The values that the
+     * RTCP thread writes under participants_mutex_ are copied here, and the report blocks are built from
+     * them and the atomic counters after the lock has been released */
     {
-        if (p.second->stats.received_rtp_packet)
+        std::lock_guard<std::mutex> dirty_lock(dirty_mutex_);
+        report_ssrcs_.swap(dirty_ssrcs_);
+    }
+    reported_.clear();
+    participants_mutex_.lock();
+    for (uint32_t report_ssrc : report_ssrcs_)
+    {
+        auto it = participants_.find(report_ssrc);
+
+        // a participant is listed again if it sent after the previous report took it
+        if (it != participants_.end() &&
+            it->second->stats.received_rtp_packet.exchange(false, std::memory_order_relaxed))
         {
-            ++reports;
+            reported_.push_back({ report_ssrc, it->second, it->second->stats.lsr, it->second->stats.sr_ts });
         }
     }
-    std::vector< std::shared_ptr<rtcp_app_packet>> outgoing_apps_;
+    participants_mutex_.unlock();
+    report_ssrcs_.clear();
+
+    uint8_t reports = (uint8_t)reported_.size();
+    outgoing_apps_.clear();
     if (hooked_app_) {
         std::lock_guard<std::mutex> grd(send_app_mutex_);
         for (auto& p : outgoing_app_hooks_) {
@@ -1809,13 +2726,42 @@ rtp_error_t uvgrtp::rtcp::generate_report()
         UVG_LOG_WARN("Failed to get compound packet size");
         return RTP_GENERIC_ERROR;
     }
-    else if (compound_packet_size > mtu_size_)
+
+    // the layers are taken here so that the size of the packet stays as computed
+    std::shared_ptr<const std::vector<simulcast_source>> sources = std::atomic_load(&simulcast_sources_);
+    simulcast_reported_.clear();
+    if (sources)
+    {
+        for (auto& source : *sources)
+        {
+            if (source.stats->sent_rtp_packet)
+            {
+                simulcast_reported_.push_back(&source);
+            }
+        }
+    }
+    compound_packet_size += (uint32_t)simulcast_reported_.size() * get_sr_packet_size(RCE_NO_FLAGS, 0);
+
+    // the extended report follows SDES, RFC 3611 section 2
+    uint32_t xr_size = prepare_xr_packet();
+    compound_packet_size += xr_size;
+
+    // the queued feedback messages follow SDES, RFC 4585 section 3.1
+    compound_packet_size += (uint32_t)pending_fb_.size();
+
+    if (compound_packet_size > mtu_size_)
     {
         UVG_LOG_WARN("Generate RTCP packet is too large %lli/%lli, reports should be circled, but not implemented!",
             compound_packet_size, mtu_size_);
     }
 
-    uint8_t* frame = new uint8_t[compound_packet_size];
+    // the reports are built into the same buffer each time, it only grows to the largest report
+    if (report_buffer_.size() < compound_packet_size)
+    {
+        report_buffer_.resize(compound_packet_size);
+    }
+
+    uint8_t* frame = report_buffer_.data();
     memset(frame, 0, compound_packet_size);
 
     // see https://datatracker.ietf.org/doc/html/rfc3550#section-6.4.1
@@ -1833,15 +2779,9 @@ rtp_error_t uvgrtp::rtcp::generate_report()
           clock_start_ = uvgrtp::clock::ntp::now();
         }
 
-        // This is the timestamp when the LAST rtp frame was sampled
-        uint64_t sampling_ntp_ts = rtp_ptr_->get_sampling_ntp();
-        uint64_t ntp_ts = uvgrtp::clock::ntp::now();
-
-        uint64_t diff_ms = uvgrtp::clock::ntp::diff(sampling_ntp_ts, ntp_ts);
-
-        uint32_t rtp_ts = rtp_ptr_->get_rtp_ts();
-
-        uint32_t reporting_rtp_ts = rtp_ts + (uint32_t)(diff_ms * (double(clock_rate_) / 1000));
+        uint64_t ntp_ts = 0;
+        uint32_t reporting_rtp_ts = 0;
+        sender_report_times(*rtp_ptr_, clock_rate_, ntp_ts, reporting_rtp_ts);
 
         if (!construct_rtcp_header(frame, write_ptr, sender_report_size, reports, uvgrtp::frame::RTCP_FT_SR) ||
             !construct_ssrc(frame, write_ptr, ssrc) ||
@@ -1871,63 +2811,79 @@ rtp_error_t uvgrtp::rtcp::generate_report()
     }
 
     // the report blocks for sender or receiver report. Both have same reports.
-    for (auto& p : participants_)
-    {
-        // only add report blocks if we have received data from them
-        if (p.second->stats.received_rtp_packet)
-        {
-            uint32_t dropped_packets = p.second->stats.lost_pkts;
-            
-            /* RFC3550 page 83, Appendix A.3 */
-            /* Determine number of packets lost and expected */
-            uint32_t extended_max = ((p.second->stats.cycles) << 16) + p.second->stats.max_seq;
-            uint32_t expected = extended_max - p.second->stats.base_seq + 1;
-
-            /* Calculate number of packets lost */
-            uint32_t lost = expected - p.second->stats.received_pkts;
-            // clamp lost at 0x7fffff for positive loss and 0x800000 for negative loss
-            if (lost > 8388608) {
-                lost = 8388608;
-            }
-            else if (lost < 8388607) {
-                lost = 8388607;
-            }
-            uint32_t expected_interval = expected - p.second->stats.expected_prior;
-            p.second->stats.expected_prior = expected;
-            uint32_t received_interval = p.second->stats.received_pkts - p.second->stats.received_prior;
-            p.second->stats.received_prior = p.second->stats.received_pkts;
-            int32_t lost_interval = expected_interval - received_interval;
-            
-            /* Calculate fractions of packets lost during last reporting interval */
-            uint32_t fraction = 0;
-            if (expected_interval == 0 || lost_interval <= 0) {
-                fraction = 0; 
-            }
-            else { 
-                fraction = (lost_interval << 8) / expected_interval; 
-                if (fraction > 255) {
-                    fraction = 255;
-                }
+    for (auto& p : reported_)
+    {
+        /* The receiving thread may update the counters while they are read so they are
+         * taken once here. The snapshot may mix two packets, which is within the accuracy
+         * of the report anyway */
+        uint32_t dropped_packets = p.participant->stats.lost_pkts.load(std::memory_order_relaxed);
+        uint32_t received_pkts   = p.participant->stats.received_pkts.load(std::memory_order_relaxed);
+        uint16_t cycles          = p.participant->stats.cycles.load(std::memory_order_relaxed);
+        uint16_t max_seq         = p.participant->stats.max_seq.load(std::memory_order_relaxed);
+        uint32_t jitter          = (uint32_t)p.participant->stats.jitter.load(std::memory_order_relaxed);
+
+        /* RFC3550 page 83, Appendix A.3 */
+        /* Determine number of packets lost and expected */
+        uint32_t extended_max = (uint32_t(cycles) << 16) + max_seq;
+        uint32_t expected = extended_max - p.participant->stats.base_seq.load(std::memory_order_relaxed) + 1;
+
+        /* Calculate number of packets lost */
+        uint32_t lost = expected - received_pkts;
+        // clamp lost at 0x7fffff for positive loss and 0x800000 for negative loss
+        if (lost > 8388608) {
+            lost = 8388608;
+        }
+        else if (lost < 8388607) {
+            lost = 8388607;
+        }
+        uint32_t expected_interval = expected - p.participant->stats.expected_prior;
+        p.participant->stats.expected_prior = expected;
+        uint32_t received_interval = received_pkts - p.participant->stats.received_prior;
+        p.participant->stats.received_prior = received_pkts;
+        int32_t lost_interval = expected_interval - received_interval;
+        
+        /* Calculate fractions of packets lost during last reporting interval */
+        uint32_t fraction = 0;
+        if (expected_interval == 0 || lost_interval <= 0) {
+            fraction = 0; 
+        }
+        else { 
+            fraction = (lost_interval << 8) / expected_interval; 
+            if (fraction > 255) {
+                fraction = 255;
             }
+        }
 
-            uint64_t diff = (u_long)uvgrtp::clock::hrc::diff_now(p.second->stats.sr_ts);
-            uint32_t dlrs = (uint32_t)uvgrtp::clock::ms_to_jiffies(diff);
+        uint64_t diff = (u_long)uvgrtp::clock::hrc::diff_now(p.sr_ts);
+        uint32_t dlrs = (uint32_t)uvgrtp::clock::ms_to_jiffies(diff);
 
-            /* calculate delay of last SR only if SR has been received at least once */
-            if (p.second->stats.lsr == 0)
-            {
-                dlrs = 0;
-            }
+        /* calculate delay of last SR only if SR has been received at least once */
+        if (p.lsr == 0)
+        {
+            dlrs = 0;
+        }
+
+        construct_report_block(frame, write_ptr, p.ssrc, uint8_t(fraction), dropped_packets,
+            cycles, max_seq, jitter, p.lsr, dlrs);
+    }
 
-            construct_report_block(frame, write_ptr, p.first, uint8_t(fraction), dropped_packets,
-                p.second->stats.cycles, p.second->stats.max_seq, (uint32_t)p.second->stats.jitter, 
-                p.second->stats.lsr, dlrs);
+    // each simulcast layer has a sender report of its own after the report of the stream, see RFC 8108
+    for (const simulcast_source *source : simulcast_reported_)
+    {
+        uint64_t ntp_ts = 0;
+        uint32_t rtp_ts = 0;
+        sender_report_times(*source->rtp, source->rtp->get_clock_rate(), ntp_ts, rtp_ts);
 
-            // we only send reports if there is something to report since last report
-            p.second->stats.received_rtp_packet = false;
+        if (!construct_rtcp_header(frame, write_ptr, get_sr_packet_size(RCE_NO_FLAGS, 0), 0, uvgrtp::frame::RTCP_FT_SR) ||
+            !construct_ssrc(frame, write_ptr, source->ssrc->load()) ||
+            !construct_sender_info(frame, write_ptr, ntp_ts, rtp_ts, source->stats->sent_pkts, source->stats->sent_bytes))
+        {
+            UVG_LOG_ERROR("Failed to construct the SR of a simulcast layer");
+            return RTP_GENERIC_ERROR;
         }
+
+        source->stats->sent_rtp_packet = false;
     }
-    prtcp_lock.unlock(); // End of critical section involving participants_
 
     if (sdes_packet)
     {
@@ -1941,11 +2897,16 @@ rtp_error_t uvgrtp::rtcp::generate_report()
             !construct_sdes_chunk(frame, write_ptr, chunk))
         {
             UVG_LOG_ERROR("Failed to add SDES packet");
-            delete[] frame;
             return RTP_GENERIC_ERROR;
         }
     }
 
+    if (xr_size != 0 && !construct_xr_packet(frame, write_ptr, xr_size))
+    {
+        UVG_LOG_ERROR("Failed to construct XR packet");
+        return RTP_GENERIC_ERROR;
+    }
+
     if (app_packets_size != 0)
     {
         if (hooked_app_) {
@@ -1953,8 +2914,7 @@ rtp_error_t uvgrtp::rtcp::generate_report()
                 if(!construct_app_block(frame, write_ptr, pkt->subtype & 0x1f, *ssrc_.get(), pkt->name, std::move(pkt->payload), pkt->payload_len))
                 {
                     UVG_LOG_ERROR("Failed to construct APP packet");
-                    delete[] frame;
-                    return RTP_GENERIC_ERROR;
+                            return RTP_GENERIC_ERROR;
                 }
             }
         }
@@ -1969,8 +2929,7 @@ rtp_error_t uvgrtp::rtcp::generate_report()
                     if (!construct_app_block(frame, write_ptr, next_packet.subtype & 0x1f, *ssrc_.get(), next_packet.name, std::move(next_packet.payload), next_packet.payload_len))
                     {
                         UVG_LOG_ERROR("Failed to construct APP packet");
-                        delete[] frame;
-                        app_name.second.pop_front();
+                                    app_name.second.pop_front();
                         return RTP_GENERIC_ERROR;
                     }
                     app_name.second.pop_front();
@@ -1979,6 +2938,13 @@ rtp_error_t uvgrtp::rtcp::generate_report()
         }
     }
 
+    if (!pending_fb_.empty())
+    {
+        memcpy(&frame[write_ptr], pending_fb_.data(), pending_fb_.size());
+        write_ptr += pending_fb_.size();
+        pending_fb_.clear();
+    }
+
     // BYE is last if it is sent
     if (bye_packet)
     {
@@ -1990,7 +2956,6 @@ rtp_error_t uvgrtp::rtcp::generate_report()
         {
             bye_ssrcs_.clear();
             UVG_LOG_ERROR("Failed to construct BYE");
-            delete[] frame;
             return RTP_GENERIC_ERROR;
         }
 
@@ -2000,7 +2965,8 @@ rtp_error_t uvgrtp::rtcp::generate_report()
 
     UVG_LOG_DEBUG("Sending RTCP report compound packet, Total size: %lli",
         compound_packet_size);
-    return send_rtcp_packet_to_participants(frame, compound_packet_size, true);
+    outgoing_apps_.clear();
+    return send_rtcp_packet(frame, compound_packet_size, true);
 }
 
 rtp_error_t uvgrtp::rtcp::send_sdes_packet(const std::vector<uvgrtp::frame::rtcp_sdes_item>& items)
@@ -2094,11 +3060,50 @@ void uvgrtp::rtcp::set_session_bandwidth(uint32_t kbps)
     }
 }
 
+uint64_t uvgrtp::rtcp::steady_ms()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void uvgrtp::rtcp::heard_from(uint32_t ssrc)
+{
+    uint64_t now_ms = steady_ms();
+    std::lock_guard<std::mutex> lock(timeouts_mutex_);
+
+    auto it = last_heard_ms_.find(ssrc);
+    if (it != last_heard_ms_.end()) {
+        if (it->second == now_ms) {
+            return;
+        }
+        silence_order_.erase({ it->second, ssrc });
+        it->second = now_ms;
+    }
+    else {
+        last_heard_ms_.insert({ ssrc, now_ms });
+    }
+    silence_order_.insert({ now_ms, ssrc });
+}
+
+void uvgrtp::rtcp::forget_source(uint32_t ssrc)
+{
+    std::lock_guard<std::mutex> lock(timeouts_mutex_);
+
+    auto it = last_heard_ms_.find(ssrc);
+    if (it != last_heard_ms_.end()) {
+        silence_order_.erase({ it->second, ssrc });
+        last_heard_ms_.erase(it);
+    }
+}
+
 rtp_error_t uvgrtp::rtcp::remove_timeout_ssrc(uint32_t ssrc)
 {
     UVG_LOG_INFO("Destroying timed out source, ssrc: %lu", ssrc);
+    participants_mutex_.lock();
     free_participant(std::move(participants_[ssrc]));
     participants_.erase(ssrc);
+    participants_version_.fetch_add(1, std::memory_order_release);
+    participants_mutex_.unlock();
 
     if (members_ >= 1) {
         members_ -= 1;
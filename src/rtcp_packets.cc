@@ -19,7 +19,7 @@ uint32_t uvgrtp::get_rr_packet_size(int rce_flags, uint16_t reports)
         + (size_t)REPORT_BLOCK_SIZE * reports;
     if (rce_flags & RCE_SRTP)
     {
-        size += UVG_SRTCP_INDEX_LENGTH + UVG_AUTH_TAG_LENGTH;
+        size += UVG_SRTCP_INDEX_LENGTH + uvgrtp::srtp_auth_tag_length(rce_flags);
     }
 
     return size;
@@ -53,6 +53,17 @@ uint32_t uvgrtp::get_bye_packet_size(const std::vector<uint32_t>& ssrcs)
     return RTCP_HEADER_SIZE + (uint32_t)ssrcs.size() * SSRC_CSRC_SIZE;
 }
 
+uint32_t uvgrtp::get_xr_loss_rle_block_size(size_t chunks)
+{
+    // an odd number of chunks is padded with a null chunk
+    return XR_BLOCK_HEADER_SIZE + SSRC_CSRC_SIZE + 4 + (uint32_t)((chunks + 1) / 2) * 4;
+}
+
+uint32_t uvgrtp::get_xr_dlrr_block_size(size_t items)
+{
+    return XR_BLOCK_HEADER_SIZE + (uint32_t)items * XR_DLRR_ITEM_SIZE;
+}
+
 bool uvgrtp::construct_rtcp_header(uint8_t* frame, size_t& ptr, size_t packet_size,
     uint8_t secondField, uvgrtp::frame::RTCP_FRAME_TYPE frame_type)
 {
@@ -172,3 +183,222 @@ bool uvgrtp::construct_app_block(uint8_t* frame, size_t& write_ptr, uint8_t sec_
         construct_ssrc(frame, write_ptr, ssrc) &&
         construct_app_packet(frame, write_ptr, name, std::move(payload), payload_len);
 }
+
+static void construct_xr_block_header(uint8_t* frame, size_t& ptr, uint8_t block_type, uint8_t type_specific,
+    uint32_t block_size)
+{
+    // |     BT      | type-specific |         block length          |
+    frame[ptr]     = block_type;
+    frame[ptr + 1] = type_specific;
+    *(uint16_t*)&frame[ptr + 2] = htons((uint16_t)(block_size / sizeof(uint32_t) - 1));
+    ptr += uvgrtp::XR_BLOCK_HEADER_SIZE;
+}
+
+bool uvgrtp::construct_xr_loss_rle_block(uint8_t* frame, size_t& ptr, const uvgrtp::frame::rtcp_xr_loss_rle& block)
+{
+    uint32_t block_size = get_xr_loss_rle_block_size(block.chunks.size());
+
+    construct_xr_block_header(frame, ptr, uvgrtp::frame::RTCP_XR_LOSS_RLE, block.thinning & 0x0f, block_size);
+    SET_NEXT_FIELD_32(frame, ptr, htonl(block.ssrc));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(block.begin_seq) << 16 | block.end_seq));
+
+    for (uint16_t chunk : block.chunks)
+    {
+        *(uint16_t*)&frame[ptr] = htons(chunk);
+        ptr += 2;
+    }
+
+    if (block.chunks.size() % 2)
+    {
+        *(uint16_t*)&frame[ptr] = 0;
+        ptr += 2;
+    }
+
+    return true;
+}
+
+bool uvgrtp::construct_xr_rrt_block(uint8_t* frame, size_t& ptr, uint64_t ntp_ts)
+{
+    construct_xr_block_header(frame, ptr, uvgrtp::frame::RTCP_XR_RRT, 0, XR_RRT_BLOCK_SIZE);
+    SET_NEXT_FIELD_32(frame, ptr, htonl(ntp_ts >> 32));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(ntp_ts & 0xffffffff));
+
+    return true;
+}
+
+bool uvgrtp::construct_xr_dlrr_block(uint8_t* frame, size_t& ptr, const std::vector<uvgrtp::frame::rtcp_xr_dlrr_item>& items)
+{
+    construct_xr_block_header(frame, ptr, uvgrtp::frame::RTCP_XR_DLRR, 0, get_xr_dlrr_block_size(items.size()));
+
+    for (auto& item : items)
+    {
+        SET_NEXT_FIELD_32(frame, ptr, htonl(item.ssrc));
+        SET_NEXT_FIELD_32(frame, ptr, htonl(item.lrr));
+        SET_NEXT_FIELD_32(frame, ptr, htonl(item.dlrr));
+    }
+
+    return true;
+}
+
+bool uvgrtp::construct_xr_stat_summary_block(uint8_t* frame, size_t& ptr, const uvgrtp::frame::rtcp_xr_stat_summary& block)
+{
+    construct_xr_block_header(frame, ptr, uvgrtp::frame::RTCP_XR_STAT_SUMMARY, block.flags, XR_STAT_SUMMARY_BLOCK_SIZE);
+    SET_NEXT_FIELD_32(frame, ptr, htonl(block.ssrc));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(block.begin_seq) << 16 | block.end_seq));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(block.lost_packets));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(block.dup_packets));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(block.min_jitter));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(block.max_jitter));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(block.mean_jitter));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(block.dev_jitter));
+    frame[ptr++] = block.min_ttl_or_hl;
+    frame[ptr++] = block.max_ttl_or_hl;
+    frame[ptr++] = block.mean_ttl_or_hl;
+    frame[ptr++] = block.dev_ttl_or_hl;
+
+    return true;
+}
+
+bool uvgrtp::construct_xr_voip_metrics_block(uint8_t* frame, size_t& ptr, const uvgrtp::frame::rtcp_xr_voip_metrics& block)
+{
+    construct_xr_block_header(frame, ptr, uvgrtp::frame::RTCP_XR_VOIP_METRICS, 0, XR_VOIP_METRICS_BLOCK_SIZE);
+    SET_NEXT_FIELD_32(frame, ptr, htonl(block.ssrc));
+    frame[ptr++] = block.loss_rate;
+    frame[ptr++] = block.discard_rate;
+    frame[ptr++] = block.burst_density;
+    frame[ptr++] = block.gap_density;
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(block.burst_duration) << 16 | block.gap_duration));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(block.round_trip_delay) << 16 | block.end_system_delay));
+    frame[ptr++] = block.signal_level;
+    frame[ptr++] = block.noise_level;
+    frame[ptr++] = block.rerl;
+    frame[ptr++] = block.gmin;
+    frame[ptr++] = block.r_factor;
+    frame[ptr++] = block.ext_r_factor;
+    frame[ptr++] = block.mos_lq;
+    frame[ptr++] = block.mos_cq;
+    frame[ptr++] = block.rx_config;
+    frame[ptr++] = 0; // reserved
+    *(uint16_t*)&frame[ptr] = htons(block.jb_nominal);
+    ptr += 2;
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(block.jb_maximum) << 16 | block.jb_abs_max));
+
+    return true;
+}
+
+static uint32_t read_32(const uint8_t* frame, size_t ptr)
+{
+    return ntohl(*(uint32_t*)&frame[ptr]);
+}
+
+static uint16_t read_16(const uint8_t* frame, size_t ptr)
+{
+    return ntohs(*(uint16_t*)&frame[ptr]);
+}
+
+bool uvgrtp::read_xr_blocks(const uint8_t* frame, size_t ptr, size_t packet_end, uvgrtp::frame::rtcp_xr_packet& xr)
+{
+    xr.loss_rle.clear();
+    xr.has_rrt = false;
+    xr.rrt_ntp = 0;
+    xr.dlrr.clear();
+    xr.stat_summary.clear();
+    xr.voip_metrics.clear();
+
+    while (ptr + XR_BLOCK_HEADER_SIZE <= packet_end)
+    {
+        uint8_t block_type    = frame[ptr];
+        uint8_t type_specific = frame[ptr + 1];
+        size_t block_size     = ((size_t)read_16(frame, ptr + 2) + 1) * sizeof(uint32_t);
+        size_t block_end      = ptr + block_size;
+
+        if (block_end > packet_end)
+        {
+            UVG_LOG_ERROR("RTCP XR block does not fit into the packet");
+            return false;
+        }
+
+        ptr += XR_BLOCK_HEADER_SIZE;
+
+        if (block_type == uvgrtp::frame::RTCP_XR_LOSS_RLE && block_size >= get_xr_loss_rle_block_size(0))
+        {
+            uvgrtp::frame::rtcp_xr_loss_rle block;
+            block.thinning  = type_specific & 0x0f;
+            block.ssrc      = read_32(frame, ptr);
+            block.begin_seq = read_16(frame, ptr + 4);
+            block.end_seq   = read_16(frame, ptr + 6);
+
+            // the null chunks are only padding
+            for (size_t chunk = ptr + 8; chunk + 2 <= block_end; chunk += 2)
+            {
+                uint16_t value = read_16(frame, chunk);
+                if (value != 0)
+                {
+                    block.chunks.push_back(value);
+                }
+            }
+            xr.loss_rle.push_back(std::move(block));
+        }
+        else if (block_type == uvgrtp::frame::RTCP_XR_RRT && block_size >= XR_RRT_BLOCK_SIZE)
+        {
+            xr.has_rrt = true;
+            xr.rrt_ntp = (uint64_t(read_32(frame, ptr)) << 32) | read_32(frame, ptr + 4);
+        }
+        else if (block_type == uvgrtp::frame::RTCP_XR_DLRR)
+        {
+            for (size_t item = ptr; item + XR_DLRR_ITEM_SIZE <= block_end; item += XR_DLRR_ITEM_SIZE)
+            {
+                xr.dlrr.push_back({ read_32(frame, item), read_32(frame, item + 4), read_32(frame, item + 8) });
+            }
+        }
+        else if (block_type == uvgrtp::frame::RTCP_XR_STAT_SUMMARY && block_size >= XR_STAT_SUMMARY_BLOCK_SIZE)
+        {
+            uvgrtp::frame::rtcp_xr_stat_summary block;
+            block.flags          = type_specific;
+            block.ssrc           = read_32(frame, ptr);
+            block.begin_seq      = read_16(frame, ptr + 4);
+            block.end_seq        = read_16(frame, ptr + 6);
+            block.lost_packets   = read_32(frame, ptr + 8);
+            block.dup_packets    = read_32(frame, ptr + 12);
+            block.min_jitter     = read_32(frame, ptr + 16);
+            block.max_jitter     = read_32(frame, ptr + 20);
+            block.mean_jitter    = read_32(frame, ptr + 24);
+            block.dev_jitter     = read_32(frame, ptr + 28);
+            block.min_ttl_or_hl  = frame[ptr + 32];
+            block.max_ttl_or_hl  = frame[ptr + 33];
+            block.mean_ttl_or_hl = frame[ptr + 34];
+            block.dev_ttl_or_hl  = frame[ptr + 35];
+            xr.stat_summary.push_back(block);
+        }
+        else if (block_type == uvgrtp::frame::RTCP_XR_VOIP_METRICS && block_size >= XR_VOIP_METRICS_BLOCK_SIZE)
+        {
+            uvgrtp::frame::rtcp_xr_voip_metrics block;
+            block.ssrc             = read_32(frame, ptr);
+            block.loss_rate        = frame[ptr + 4];
+            block.discard_rate     = frame[ptr + 5];
+            block.burst_density    = frame[ptr + 6];
+            block.gap_density      = frame[ptr + 7];
+            block.burst_duration   = read_16(frame, ptr + 8);
+            block.gap_duration     = read_16(frame, ptr + 10);
+            block.round_trip_delay = read_16(frame, ptr + 12);
+            block.end_system_delay = read_16(frame, ptr + 14);
+            block.signal_level     = frame[ptr + 16];
+            block.noise_level      = frame[ptr + 17];
+            block.rerl             = frame[ptr + 18];
+            block.gmin             = frame[ptr + 19];
+            block.r_factor         = frame[ptr + 20];
+            block.ext_r_factor     = frame[ptr + 21];
+            block.mos_lq           = frame[ptr + 22];
+            block.mos_cq           = frame[ptr + 23];
+            block.rx_config        = frame[ptr + 24];
+            block.jb_nominal       = read_16(frame, ptr + 26);
+            block.jb_maximum       = read_16(frame, ptr + 28);
+            block.jb_abs_max       = read_16(frame, ptr + 30);
+            xr.voip_metrics.push_back(block);
+        }
+
+        ptr = block_end;
+    }
+
+    return true;
+}
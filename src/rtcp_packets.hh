@@ -13,11 +13,20 @@ namespace uvgrtp
     const uint16_t REPORT_BLOCK_SIZE = 24;
     const uint16_t APP_NAME_SIZE = 4;
 
+    // RTCP XR, RFC 3611
+    const uint16_t XR_BLOCK_HEADER_SIZE = 4;
+    const uint16_t XR_RRT_BLOCK_SIZE = 12;
+    const uint16_t XR_DLRR_ITEM_SIZE = 12;
+    const uint16_t XR_STAT_SUMMARY_BLOCK_SIZE = 40;
+    const uint16_t XR_VOIP_METRICS_BLOCK_SIZE = 36;
+
     uint32_t get_sr_packet_size(int rce_flags, uint16_t reports);
     uint32_t get_rr_packet_size(int rce_flags, uint16_t reports);
     uint32_t get_sdes_packet_size(const std::vector<uvgrtp::frame::rtcp_sdes_item>& items);
     uint32_t get_app_packet_size(uint32_t payload_len);
     uint32_t get_bye_packet_size(const std::vector<uint32_t>& ssrcs);
+    uint32_t get_xr_loss_rle_block_size(size_t chunks);
+    uint32_t get_xr_dlrr_block_size(size_t items);
 
     // Add the RTCP header
     bool construct_rtcp_header(uint8_t* frame, size_t& ptr, size_t packet_size,
@@ -48,4 +57,16 @@ namespace uvgrtp
     // APP block construction
     bool construct_app_block(uint8_t* frame, size_t& write_ptr, uint8_t sec_field, uint32_t ssrc, const char* name, std::unique_ptr<uint8_t[]> payload, size_t payload_len);
 
-}
\ No newline at end of file
+
+    // XR report blocks, the XR packet itself is the RTCP header and our ssrc followed by the blocks
+    bool construct_xr_loss_rle_block(uint8_t* frame, size_t& ptr, const uvgrtp::frame::rtcp_xr_loss_rle& block);
+    bool construct_xr_rrt_block(uint8_t* frame, size_t& ptr, uint64_t ntp_ts);
+    bool construct_xr_dlrr_block(uint8_t* frame, size_t& ptr, const std::vector<uvgrtp::frame::rtcp_xr_dlrr_item>& items);
+    bool construct_xr_stat_summary_block(uint8_t* frame, size_t& ptr, const uvgrtp::frame::rtcp_xr_stat_summary& block);
+    bool construct_xr_voip_metrics_block(uint8_t* frame, size_t& ptr, const uvgrtp::frame::rtcp_xr_voip_metrics& block);
+
+    // Read the XR report blocks between "ptr" and "packet_end", the blocks of unknown types are skipped.
+    // Return false if a block does not fit into the packet
+    bool read_xr_blocks(const uint8_t* frame, size_t ptr, size_t packet_end, uvgrtp::frame::rtcp_xr_packet& xr);
+
+}
@@ -6,25 +6,43 @@
 #include "uvgrtp/rtcp.hh"
 #include "socketfactory.hh"
 #include "socket.hh"
+#include "threads.hh"
 #include "global.hh"
 #include "debug.hh"
 
 #ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
 #include <sys/time.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #else
 #include <ws2ipdef.h>
+#define MSG_DONTWAIT 0
 #endif
 
-const int MAX_PACKET = 65536;
+#include <algorithm>
+
+/* Large enough for any RTCP compound packet that fits into a jumbo frame */
+const int MAX_PACKET = 9216;
 
 uvgrtp::rtcp_reader::rtcp_reader() :
     active_(false),
     socket_(nullptr),
-    rtcps_map_({})
+    rtcps_map_({}),
+    thread_settings_(nullptr),
+    routes_(std::make_shared<const route_list>()),
+    stale_routes_(false),
+    io_engine_(nullptr),
+    in_engine_(false),
+    batch_memory_((size_t)RTCP_RECV_BATCH_SIZE * MAX_PACKET)
 {
     report_reader_ = nullptr;
+
+    for (int i = 0; i < RTCP_RECV_BATCH_SIZE; ++i) {
+        batch_buffers_[i] = &batch_memory_[(size_t)i * MAX_PACKET];
+        batch_lengths_[i] = 0;
+    }
 }
 
 uvgrtp::rtcp_reader::~rtcp_reader()
@@ -39,17 +57,48 @@ rtp_error_t uvgrtp::rtcp_reader::start()
     if (active_) {
         return RTP_OK;
     }
-    report_reader_.reset(new std::thread(&uvgrtp::rtcp_reader::rtcp_report_reader, this));
+
+    // with a running I/O engine the event loops of the context read the RTCP socket too
+    if (io_engine_ && io_engine_->is_active()) {
+        active_ = true;
+
+        if (io_engine_->add_flow((int)socket_->get_raw_socket(), this) == RTP_OK) {
+            in_engine_ = true;
+            return RTP_OK;
+        }
+        UVG_LOG_WARN("Failed to add the RTCP socket to the I/O engine, using a reader thread");
+    }
+
     active_ = true;
+    stop_event_.reset();
+    report_reader_ = uvgrtp::start_thread(thread_settings_, RTP_THREAD_RTCP, -1,
+        &uvgrtp::rtcp_reader::rtcp_report_reader, this);
     return RTP_OK;
 }
 
+void uvgrtp::rtcp_reader::set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings)
+{
+    thread_settings_ = settings;
+}
+
+void uvgrtp::rtcp_reader::set_io_engine(std::shared_ptr<uvgrtp::io_engine> engine)
+{
+    io_engine_ = engine;
+}
+
 rtp_error_t uvgrtp::rtcp_reader::stop()
 {
     active_ = false;
+
+    if (in_engine_) {
+        (void)io_engine_->remove_flow((int)socket_->get_raw_socket());
+        in_engine_ = false;
+    }
+
     if (report_reader_ && report_reader_->joinable())
     {
         UVG_LOG_DEBUG("Waiting for RTCP reader to exit");
+        stop_event_.signal();
         report_reader_->join();
     }
     return RTP_OK;
@@ -58,7 +107,6 @@ rtp_error_t uvgrtp::rtcp_reader::stop()
 void uvgrtp::rtcp_reader::rtcp_report_reader() {
 
     UVG_LOG_INFO("RTCP report reader created!");
-    std::unique_ptr<uint8_t[]> buffer = std::unique_ptr<uint8_t[]>(new uint8_t[MAX_PACKET]);
 
     rtp_error_t ret = RTP_OK;
     int max_poll_timeout_ms = 100;
@@ -66,28 +114,34 @@ void uvgrtp::rtcp_reader::rtcp_report_reader() {
     temp.push_back(socket_);
 
     while (active_) {
+#ifndef _WIN32
+        // the stop event wakes the reader right away when it is stopped
+        if (stop_event_.fd() >= 0) {
+            pollfd pfds[2] = {};
+            pfds[0].fd     = socket_->get_raw_socket();
+            pfds[0].events = POLLIN;
+            pfds[1].fd     = stop_event_.fd();
+            pfds[1].events = POLLIN;
+
+            if (::poll(pfds, 2, max_poll_timeout_ms) < 0 && errno != EINTR) {
+                UVG_LOG_ERROR("poll(2) failed");
+                break;
+            }
+
+            if (pfds[0].revents & POLLIN)
+                read_and_dispatch(0);
+            continue;
+        }
+#endif
         int nread = 0;
-        ret = uvgrtp::poll::poll(temp, buffer.get(), MAX_PACKET, max_poll_timeout_ms, &nread);
+        ret = uvgrtp::poll::poll(temp, batch_buffers_[0], MAX_PACKET, max_poll_timeout_ms, &nread);
 
         if (ret == RTP_OK && nread > 0)
         {
-            uint32_t sender_ssrc = ntohl(*(uint32_t*)&buffer.get()[0 + RTCP_HEADER_SIZE]);
-            map_mutex_.lock();
-            if (rtcps_map_.size() == 1) {
-                auto& ptr = rtcps_map_.begin()->second;
-                (void)ptr->handle_incoming_packet(nullptr, 0, buffer.get(), (size_t)nread, nullptr);
-            }
-            else {
-                for (auto& p : rtcps_map_) {
-                    std::shared_ptr<uvgrtp::rtcp> rtcp_ptr = p.second;
-                    if (sender_ssrc == p.first.get()->load()) {
-                        (void)rtcp_ptr->handle_incoming_packet(nullptr, 0, buffer.get(), (size_t)nread, nullptr);
-                    }
-                }
-            }
-            map_mutex_.unlock();
+            batch_lengths_[0] = nread;
+            read_and_dispatch(1);
         }
-        else if (ret == RTP_INTERRUPTED) {
+        else if (ret == RTP_OK || ret == RTP_INTERRUPTED) {
             /* do nothing */
         }
         else {
@@ -98,6 +152,94 @@ void uvgrtp::rtcp_reader::rtcp_report_reader() {
     UVG_LOG_DEBUG("Exited RTCP report reader loop");
 }
 
+size_t uvgrtp::rtcp_reader::handle_readable(size_t budget)
+{
+    if (!active_)
+        return 0;
+
+    // the engine is level-triggered, so whatever is left after a full batch is read on the next event
+    if (budget != 0 && budget < (size_t)RTCP_RECV_BATCH_SIZE)
+        return (size_t)read_and_dispatch(0, (int)budget);
+
+    return (size_t)read_and_dispatch(0);
+}
+
+int uvgrtp::rtcp_reader::read_and_dispatch(int received, int max_packets)
+{
+    int packets = 0;
+
+    if (received < max_packets && socket_->recvmmsg(batch_buffers_ + received, MAX_PACKET,
+        batch_lengths_ + received, max_packets - received, MSG_DONTWAIT, &packets) == RTP_OK) {
+        received += packets;
+    }
+
+    if (received == 0)
+        return 0;
+
+    std::shared_ptr<const route_list> routes = std::atomic_load(&routes_);
+
+    for (int i = 0; i < received; ++i) {
+        if (batch_lengths_[i] > 0)
+            dispatch(batch_buffers_[i], (size_t)batch_lengths_[i], *routes);
+    }
+
+    if (stale_routes_.exchange(false)) {
+        std::lock_guard<std::mutex> lock(map_mutex_);
+        update_routes();
+    }
+    return received;
+}
+
+void uvgrtp::rtcp_reader::dispatch(uint8_t *packet, size_t size, const route_list& routes)
+{
+    // without multiplexing every packet of the socket belongs to the only RTCP object
+    if (routes.size() == 1) {
+        (void)routes.front().rtcp->handle_incoming_packet(nullptr, 0, packet, size, nullptr);
+        return;
+    }
+
+    if (size < RTCP_HEADER_SIZE + sizeof(uint32_t))
+        return;
+
+    uint32_t sender_ssrc = ntohl(*(uint32_t*)&packet[RTCP_HEADER_SIZE]);
+
+    auto range = std::equal_range(routes.begin(), routes.end(), route{ sender_ssrc, nullptr, nullptr },
+        [](const route& a, const route& b) { return a.ssrc < b.ssrc; });
+
+    bool found = false;
+
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->remote_ssrc->load() == sender_ssrc) {
+            (void)it->rtcp->handle_incoming_packet(nullptr, 0, packet, size, nullptr);
+            found = true;
+        }
+    }
+
+    if (found)
+        return;
+
+    // the remote SSRC of a stream may have been set after the list was built
+    for (auto& r : routes) {
+        if (r.ssrc != sender_ssrc && r.remote_ssrc->load() == sender_ssrc) {
+            (void)r.rtcp->handle_incoming_packet(nullptr, 0, packet, size, nullptr);
+            stale_routes_ = true;
+        }
+    }
+}
+
+void uvgrtp::rtcp_reader::update_routes()
+{
+    auto routes = std::make_shared<route_list>();
+    routes->reserve(rtcps_map_.size());
+
+    for (auto& p : rtcps_map_) {
+        routes->push_back({ p.first->load(), p.first, p.second });
+    }
+
+    std::sort(routes->begin(), routes->end(), [](const route& a, const route& b) { return a.ssrc < b.ssrc; });
+    std::atomic_store(&routes_, std::shared_ptr<const route_list>(routes));
+}
+
 rtp_error_t uvgrtp::rtcp_reader::set_socket(std::shared_ptr<uvgrtp::socket> socket)
 {
     socket_ = socket;
@@ -108,6 +250,7 @@ rtp_error_t uvgrtp::rtcp_reader::map_ssrc_to_rtcp(std::shared_ptr<std::atomic<ui
 {
     map_mutex_.lock();
     rtcps_map_[ssrc] = rtcp;
+    update_routes();
     map_mutex_.unlock();
     return RTP_OK;
 }
@@ -118,8 +261,10 @@ int uvgrtp::rtcp_reader::clear_rtcp_from_reader(std::shared_ptr<std::atomic<std:
     if (rtcps_map_.find(remote_ssrc) != rtcps_map_.end()) {
         rtcps_map_.erase(remote_ssrc);
     }
+    update_routes();
+    bool empty = rtcps_map_.empty();
     map_mutex_.unlock();
-    if (rtcps_map_.empty()) {
+    if (empty) {
         stop();
         return 1;
     }
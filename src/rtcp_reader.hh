@@ -4,6 +4,9 @@
 #include "uvgrtp/util.hh"
 #include "uvgrtp/frame.hh"
 
+#include "io_engine.hh"
+#include "threads.hh"
+
 #ifdef _WIN32
 #include <ws2ipdef.h>
 #else
@@ -17,25 +20,35 @@
 #include <thread>
 #include <functional>
 #include <mutex>
+#include <atomic>
 
 
 namespace uvgrtp {
     class socketfactory;
     class rtcp;
     class socket;
+    class thread_settings;
+
+    /* Datagrams read from the RTCP socket with one recvmmsg() call */
+    const int RTCP_RECV_BATCH_SIZE = 16;
 
     /* Every RTCP socket will have an RTCP reader that receives packets and distributes them to the correct RTCP
      * objects. RTCP objects are mapped via REMOTE SSRCs, the SSRC that they will be receiving packets from.
      * If NO socket multiplexing is done, this will be 0 by default. If there IS socket multiplexing, this will be the 
      * remote SSRC of the media stream, set via the RCC_REMOTE_SSRC context flag.
+     *
+     * The reader takes all the datagrams the socket has with one recvmmsg() call and looks up the
+     * RTCP objects of each from an immutable list sorted by the remote SSRCs, which the reader reads
+     * without a lock. If the I/O engine of the context is running when the reader is started, the
+     * socket is read by the engine instead of a thread of the reader.
      */
-    class rtcp_reader {
+    class rtcp_reader : public uvgrtp::io_handler {
 
         public: 
             rtcp_reader();
             ~rtcp_reader();
 
-            /* Start the report reader thread
+            /* Start the report reader thread, or give the socket to the I/O engine if it is running
              *
              * Return RTP_OK on success */
 
@@ -52,6 +65,12 @@ namespace uvgrtp {
              * Return true on success */
             rtp_error_t set_socket(std::shared_ptr<uvgrtp::socket> socket);
 
+            /* Configuration of the report reader thread started afterwards */
+            void set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings);
+
+            /* The I/O engine of the context, used if it is running when the reader is started */
+            void set_io_engine(std::shared_ptr<uvgrtp::io_engine> engine);
+
             /* Map a new RTCP object into a remote SSRC
              *
              * Param ssrc SSRC of the REMOTE stream that the given RTCP will receive from
@@ -67,16 +86,52 @@ namespace uvgrtp {
              * means that the reader will be stopped and RTCP is free to clear the port */
             int clear_rtcp_from_reader(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc);
 
+            /* Called by the I/O engine when the socket has data to read */
+            size_t handle_readable(size_t budget) override;
+
         private:
+            /* An RTCP object and the value its remote SSRC had when the list was built */
+            struct route {
+                uint32_t ssrc;
+                std::shared_ptr<std::atomic<uint32_t>> remote_ssrc;
+                std::shared_ptr<uvgrtp::rtcp> rtcp;
+            };
+
+            typedef std::vector<route> route_list;
 
             void rtcp_report_reader();
 
-            bool active_;
+            /* Read the rest of the datagrams after the first "received" ones, at most "max_packets"
+             * in all, and dispatch all of them. Return the number of dispatched datagrams */
+            int read_and_dispatch(int received, int max_packets = RTCP_RECV_BATCH_SIZE);
+
+            void dispatch(uint8_t *packet, size_t size, const route_list& routes);
+
+            /* Build "routes_" from "rtcps_map_", called with "map_mutex_" held */
+            void update_routes();
+
+            std::atomic<bool> active_;
             std::shared_ptr<uvgrtp::socket> socket_;
             std::map<std::shared_ptr<std::atomic<uint32_t>>, std::shared_ptr<uvgrtp::rtcp>> rtcps_map_;
             std::unique_ptr<std::thread> report_reader_;
+            uvgrtp::stop_event stop_event_;
+            std::shared_ptr<uvgrtp::thread_settings> thread_settings_;
             std::mutex map_mutex_;
+
+            /* The list of the RTCP objects that the reader uses, replaced under "map_mutex_".
+             * A remote SSRC may have been configured after the list was built, which the reader
+             * notices by the list not having the sender of a packet and tells with "stale_routes_" */
+            std::shared_ptr<const route_list> routes_;
+            std::atomic<bool> stale_routes_;
+
+            std::shared_ptr<uvgrtp::io_engine> io_engine_;
+            bool in_engine_;
+
+            /* The datagrams of one batch, only used by the thread that reads the socket */
+            std::vector<uint8_t> batch_memory_;
+            uint8_t *batch_buffers_[RTCP_RECV_BATCH_SIZE];
+            int batch_lengths_[RTCP_RECV_BATCH_SIZE];
     };
 
 
-}
\ No newline at end of file
+}
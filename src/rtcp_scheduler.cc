@@ -0,0 +1,153 @@
+#include "rtcp_scheduler.hh"
+
+#include "threads.hh"
+
+uvgrtp::rtcp_scheduler::rtcp_scheduler() :
+    wheel_(WHEEL_SLOTS),
+    current_slot_(0),
+    next_tick_(),
+    slots_(),
+    next_id_(1),
+    running_(0),
+    active_(false),
+    thread_(nullptr),
+    thread_settings_(nullptr)
+{
+}
+
+uvgrtp::rtcp_scheduler::~rtcp_scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = false;
+    }
+    cond_.notify_all();
+
+    if (thread_ && thread_->joinable()) {
+        thread_->join();
+    }
+}
+
+uint64_t uvgrtp::rtcp_scheduler::add(std::function<uint32_t()> report, uint32_t delay_ms)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!thread_) {
+        active_ = true;
+        thread_ = uvgrtp::start_thread(thread_settings_, RTP_THREAD_RTCP, -1, &uvgrtp::rtcp_scheduler::runner, this);
+    }
+
+    /* The wheel does not turn while it is empty */
+    if (slots_.empty()) {
+        next_tick_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(TICK_MS);
+    }
+
+    uint64_t id = next_id_++;
+    insert({ id, 0, std::move(report) }, delay_ms);
+    cond_.notify_one();
+
+    return id;
+}
+
+void uvgrtp::rtcp_scheduler::remove(uint64_t id)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    auto it = slots_.find(id);
+    if (it == slots_.end()) {
+        return;
+    }
+
+    std::list<timer>& slot = wheel_[it->second];
+    for (auto t = slot.begin(); t != slot.end(); ++t) {
+        if (t->id == id) {
+            slot.erase(t);
+            break;
+        }
+    }
+    slots_.erase(it);
+
+    done_cond_.wait(lock, [this, id] { return running_ != id; });
+}
+
+void uvgrtp::rtcp_scheduler::set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread_settings_ = settings;
+}
+
+void uvgrtp::rtcp_scheduler::insert(timer&& t, uint32_t delay_ms)
+{
+    size_t ticks = (delay_ms + TICK_MS - 1) / TICK_MS;
+    if (ticks == 0) {
+        ticks = 1;
+    }
+
+    size_t slot = (current_slot_ + ticks) % WHEEL_SLOTS;
+    t.rounds    = (ticks - 1) / WHEEL_SLOTS;
+
+    slots_[t.id] = slot;
+    wheel_[slot].push_back(std::move(t));
+}
+
+void uvgrtp::rtcp_scheduler::runner()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (active_) {
+        if (slots_.empty()) {
+            cond_.wait(lock, [this] { return !active_ || !slots_.empty(); });
+            continue;
+        }
+
+        if (std::chrono::steady_clock::now() < next_tick_) {
+            cond_.wait_until(lock, next_tick_);
+            continue;
+        }
+
+        /* If the report functions have taken longer than a tick, the ticks
+         * are caught up without waiting */
+        next_tick_   += std::chrono::milliseconds(TICK_MS);
+        current_slot_ = (current_slot_ + 1) % WHEEL_SLOTS;
+
+        std::list<timer> due;
+        std::list<timer>& slot = wheel_[current_slot_];
+
+        for (auto t = slot.begin(); t != slot.end();) {
+            auto next = std::next(t);
+
+            if (t->rounds > 0) {
+                --t->rounds;
+            } else {
+                due.splice(due.end(), slot, t);
+            }
+            t = next;
+        }
+
+        while (!due.empty() && active_) {
+            timer& t = due.front();
+
+            /* The timer may have been removed while an earlier one was being called */
+            if (slots_.find(t.id) == slots_.end()) {
+                due.pop_front();
+                continue;
+            }
+
+            running_ = t.id;
+            lock.unlock();
+
+            uint32_t delay_ms = t.report();
+
+            lock.lock();
+            running_ = 0;
+            done_cond_.notify_all();
+
+            if (delay_ms == STOP) {
+                slots_.erase(t.id);
+            } else if (slots_.find(t.id) != slots_.end()) {
+                insert(std::move(t), delay_ms);
+            }
+            due.pop_front();
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace uvgrtp {
+
+    class thread_settings;
+
+    /* Calls the RTCP report functions of all the sessions of a context from one thread.
+     *
+     * The timers are kept in a hashed timer wheel of WHEEL_SLOTS slots that are TICK_MS
+     * apart. A timer due further away than one revolution waits for the extra rounds in
+     * its slot, so adding, removing and firing a timer do not depend on the number of
+     * timers. Each report function returns the delay of its next call, which lets every
+     * session keep its own randomized RFC 3550 interval.
+     *
+     * The report functions are called one at a time, so they must not block. The thread
+     * is started when the first timer is added and it sleeps while there are no timers. */
+    class rtcp_scheduler {
+        public:
+            rtcp_scheduler();
+            ~rtcp_scheduler();
+
+            /* Call "report" after "delay_ms" milliseconds and then again after the number
+             * of milliseconds it returns, until the timer is removed or "report" returns STOP
+             *
+             * Return the ID of the timer */
+            uint64_t add(std::function<uint32_t()> report, uint32_t delay_ms);
+
+            /* Remove the timer "id". If its report function is being called, wait until it
+             * returns so that the caller can free the state the function uses. Must not be
+             * called from a report function */
+            void remove(uint64_t id);
+
+            /* Configuration of the scheduler thread if it has not been started yet */
+            void set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings);
+
+            /* Returned by a report function that is not called again */
+            static constexpr uint32_t STOP        = UINT32_MAX;
+
+            static constexpr uint32_t TICK_MS     = 10;
+            static constexpr size_t   WHEEL_SLOTS = 512;
+
+        private:
+            struct timer {
+                uint64_t id;
+
+                /* Revolutions of the wheel left before the timer fires */
+                size_t rounds;
+
+                std::function<uint32_t()> report;
+            };
+
+            void runner();
+
+            /* Put "t" in the slot "delay_ms" from the current one. Called with mutex_ held */
+            void insert(timer&& t, uint32_t delay_ms);
+
+            std::mutex mutex_;
+            std::condition_variable cond_;
+            std::condition_variable done_cond_;
+
+            std::vector<std::list<timer>> wheel_;
+            size_t current_slot_;
+            std::chrono::steady_clock::time_point next_tick_;
+
+            /* Slot of each timer that has not been removed. A timer whose
+             * report function is being called is not in its slot */
+            std::unordered_map<uint64_t, size_t> slots_;
+
+            uint64_t next_id_;
+            uint64_t running_;
+
+            bool active_;
+            std::unique_ptr<std::thread> thread_;
+            std::shared_ptr<uvgrtp::thread_settings> thread_settings_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
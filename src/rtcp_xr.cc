@@ -0,0 +1,265 @@
+#include "rtcp_xr.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// the flags of the statistics summary block: lost, duplicate and jitter reported, no TTL or hop limit
+constexpr uint8_t XR_STAT_FLAGS = 0x80 | 0x40 | 0x20;
+
+static int64_t steady_now_ms()
+{
+    return (int64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uvgrtp::xr_history::xr_history():
+    highest_(0),
+    duplicates_(0),
+    started_(false),
+    first_seq_(0),
+    first_ms_(0),
+    seen_epoch_(0),
+    epoch_(0),
+    reported_(false),
+    next_begin_(0),
+    reported_duplicates_(0),
+    pkt_(0),
+    lost_(0),
+    c11_(0),
+    c13_(0),
+    c14_(0),
+    c22_(0),
+    c23_(0),
+    c33_(0),
+    counted_(0),
+    counted_lost_(0)
+{
+    for (auto& word : bits_) {
+        word.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool uvgrtp::xr_history::received(uint32_t ext_seq) const
+{
+    uint32_t index = ext_seq % XR_HISTORY_SIZE;
+    return (bits_[index / 64].load(std::memory_order_relaxed) >> (index % 64)) & 1;
+}
+
+void uvgrtp::xr_history::set_received(uint32_t ext_seq, bool value)
+{
+    uint32_t index = ext_seq % XR_HISTORY_SIZE;
+    uint64_t mask  = uint64_t(1) << (index % 64);
+    uint64_t word  = bits_[index / 64].load(std::memory_order_relaxed);
+
+    bits_[index / 64].store(value ? (word | mask) : (word & ~mask), std::memory_order_relaxed);
+}
+
+void uvgrtp::xr_history::packet_received(uint16_t seq, uint32_t transit_difference)
+{
+    if (!started_.load(std::memory_order_relaxed)) {
+        first_seq_ = seq;
+        first_ms_  = steady_now_ms();
+        set_received(seq, true);
+        highest_.store(seq, std::memory_order_relaxed);
+
+        // the first packet has no transit time to compare to
+        started_.store(true, std::memory_order_release);
+        return;
+    }
+
+    uint32_t highest = highest_.load(std::memory_order_relaxed);
+    int16_t delta    = (int16_t)(seq - (uint16_t)highest);
+    uint32_t ext_seq = highest + (int32_t)delta;
+
+    if (delta > 0) {
+        // the slots of the skipped sequence numbers still tell about the packets of the previous round
+        if ((uint32_t)delta >= XR_HISTORY_SIZE) {
+            for (auto& word : bits_) {
+                word.store(0, std::memory_order_relaxed);
+            }
+        } else {
+            for (uint32_t skipped = highest + 1; skipped != ext_seq; ++skipped) {
+                set_received(skipped, false);
+            }
+        }
+        set_received(ext_seq, true);
+        highest_.store(ext_seq, std::memory_order_release);
+    } else if (highest - ext_seq < XR_HISTORY_SIZE) {
+        if (received(ext_seq)) {
+            duplicates_.store(duplicates_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } else {
+            set_received(ext_seq, true);
+        }
+    }
+
+    uint32_t epoch  = epoch_.load(std::memory_order_acquire);
+    jitter_set& set = jitter_[epoch & 1];
+
+    if (epoch != seen_epoch_ || set.epoch.load(std::memory_order_relaxed) != epoch) {
+        set.count.store(0, std::memory_order_relaxed);
+        set.min.store(transit_difference, std::memory_order_relaxed);
+        set.max.store(transit_difference, std::memory_order_relaxed);
+        set.sum.store(0, std::memory_order_relaxed);
+        set.sum_sq.store(0, std::memory_order_relaxed);
+        set.epoch.store(epoch, std::memory_order_relaxed);
+        seen_epoch_ = epoch;
+    }
+
+    double value = transit_difference;
+
+    set.count.store(set.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    set.min.store(std::min(set.min.load(std::memory_order_relaxed), transit_difference), std::memory_order_relaxed);
+    set.max.store(std::max(set.max.load(std::memory_order_relaxed), transit_difference), std::memory_order_relaxed);
+    set.sum.store(set.sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    set.sum_sq.store(set.sum_sq.load(std::memory_order_relaxed) + value * value, std::memory_order_relaxed);
+}
+
+void uvgrtp::xr_history::count_burst(bool lost)
+{
+    ++counted_;
+
+    if (!lost) {
+        ++pkt_;
+        return;
+    }
+
+    ++counted_lost_;
+
+    if (pkt_ >= XR_GMIN) {
+        if (lost_ == 1) {
+            ++c14_;
+        } else {
+            ++c13_;
+        }
+        lost_ = 1;
+        c11_ += pkt_;
+    } else {
+        ++lost_;
+        if (pkt_ == 0) {
+            ++c33_;
+        } else {
+            ++c23_;
+            c22_ += pkt_ - 1;
+        }
+    }
+    pkt_ = 0;
+}
+
+bool uvgrtp::xr_history::take_report(uint32_t ssrc, uint16_t round_trip_ms, uvgrtp::frame::rtcp_xr_loss_rle& loss_rle,
+    uvgrtp::frame::rtcp_xr_stat_summary& stat_summary, uvgrtp::frame::rtcp_xr_voip_metrics& voip)
+{
+    if (!started_.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    uint32_t end   = highest_.load(std::memory_order_acquire) + 1;
+    uint32_t begin = reported_ ? next_begin_ : first_seq_;
+
+    // a resynchronized sequence or a long gap leaves only the latest packets in the history
+    if ((int32_t)(end - begin) < 0) {
+        begin = end;
+    } else if (end - begin > XR_HISTORY_SIZE / 2) {
+        begin = end - XR_HISTORY_SIZE / 2;
+    }
+
+    /* statistics summary and the burst and gap counts of the packets since the previous report */
+    uint32_t lost = 0;
+    for (uint32_t seq = begin; seq != end; ++seq) {
+        bool packet_lost = !received(seq);
+        lost += packet_lost;
+        count_burst(packet_lost);
+    }
+
+    uint32_t duplicates = duplicates_.load(std::memory_order_relaxed);
+
+    uint32_t epoch = epoch_.load(std::memory_order_relaxed);
+    epoch_.store(epoch + 1, std::memory_order_release);
+
+    const jitter_set& set = jitter_[epoch & 1];
+    uint32_t count = (set.epoch.load(std::memory_order_relaxed) == epoch) ? set.count.load(std::memory_order_relaxed) : 0;
+
+    stat_summary.ssrc         = ssrc;
+    stat_summary.flags        = XR_STAT_FLAGS;
+    stat_summary.begin_seq    = (uint16_t)begin;
+    stat_summary.end_seq      = (uint16_t)end;
+    stat_summary.lost_packets = lost;
+    stat_summary.dup_packets  = duplicates - reported_duplicates_;
+    stat_summary.min_jitter   = 0;
+    stat_summary.max_jitter   = 0;
+    stat_summary.mean_jitter  = 0;
+    stat_summary.dev_jitter   = 0;
+
+    if (count > 0) {
+        double mean     = set.sum.load(std::memory_order_relaxed) / count;
+        double variance = set.sum_sq.load(std::memory_order_relaxed) / count - mean * mean;
+
+        stat_summary.min_jitter  = set.min.load(std::memory_order_relaxed);
+        stat_summary.max_jitter  = set.max.load(std::memory_order_relaxed);
+        stat_summary.mean_jitter = (uint32_t)mean;
+        stat_summary.dev_jitter  = (uint32_t)std::sqrt(variance > 0 ? variance : 0);
+    }
+
+    /* loss RLE of the latest packets of the same range */
+    uint32_t rle_begin = (end - begin > XR_MAX_RLE_PACKETS) ? end - XR_MAX_RLE_PACKETS : begin;
+
+    loss_rle.ssrc      = ssrc;
+    loss_rle.thinning  = 0;
+    loss_rle.begin_seq = (uint16_t)rle_begin;
+    loss_rle.end_seq   = (uint16_t)end;
+    loss_rle.chunks.clear();
+
+    for (uint32_t seq = rle_begin; seq != end;) {
+        bool value   = received(seq);
+        uint32_t run = 1;
+
+        while (seq + run != end && run < 0x3fff && received(seq + run) == value) {
+            ++run;
+        }
+
+        if (run >= 15) {
+            // run length chunk
+            loss_rle.chunks.push_back((uint16_t)((value ? 0x4000 : 0) | run));
+            seq += run;
+        } else {
+            // bit vector chunk, the bits after the end of the range are left zero
+            uint16_t chunk = 0x8000;
+            for (int bit = 14; bit >= 0 && seq != end; --bit, ++seq) {
+                if (received(seq)) {
+                    chunk |= (uint16_t)(1 << bit);
+                }
+            }
+            loss_rle.chunks.push_back(chunk);
+        }
+    }
+
+    /* VoIP metrics, the burst and gap metrics cover all the packets counted so far */
+    uint32_t c11 = c11_ + (pkt_ >= XR_GMIN ? pkt_ : 0);
+    uint32_t c31 = c13_;
+    uint32_t c32 = c23_;
+    double ctotal = (double)c11 + c14_ + c13_ + c22_ + c23_ + c31 + c32 + c33_;
+
+    double p32 = (c31 + c32 + c33_) ? (double)c32 / (c31 + c32 + c33_) : 0;
+    double p23 = (c22_ + c23_) ? 1 - (double)c22_ / (c22_ + c23_) : 1;
+
+    double packet_ms = counted_ ? (double)(steady_now_ms() - first_ms_) / counted_ : 0;
+    double gap_ms    = c13_ ? (c11 + c14_ + c13_) * packet_ms / c13_ : counted_ * packet_ms;
+    double burst_ms  = c13_ ? ctotal * packet_ms / c13_ - gap_ms : 0;
+
+    voip.ssrc             = ssrc;
+    voip.loss_rate        = (uint8_t)(counted_ ? std::min<uint32_t>(255, (uint32_t)(256.0 * counted_lost_ / counted_)) : 0);
+    voip.discard_rate     = 0;
+    voip.burst_density    = (uint8_t)((p23 + p32 > 0 && c13_) ? std::min(255.0, 256 * p23 / (p23 + p32)) : 0);
+    voip.gap_density      = (uint8_t)((c11 + c14_) ? std::min(255.0, 256.0 * c14_ / (c11 + c14_)) : 0);
+    voip.burst_duration   = (uint16_t)std::min(65535.0, std::max(0.0, burst_ms));
+    voip.gap_duration     = (uint16_t)std::min(65535.0, std::max(0.0, gap_ms));
+    voip.round_trip_delay = round_trip_ms;
+    voip.end_system_delay = 0;
+    voip.gmin             = XR_GMIN;
+
+    reported_            = true;
+    next_begin_          = end;
+    reported_duplicates_ = duplicates;
+
+    return true;
+}
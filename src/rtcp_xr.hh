@@ -0,0 +1,93 @@
+#pragma once
+
+#include "uvgrtp/frame.hh"
+
+#include <atomic>
+#include <cstdint>
+
+namespace uvgrtp {
+
+    /* How many of the latest sequence numbers the receive history remembers. The blocks of one
+     * report cover at most half of them, so that the receiving thread can move on while they are read */
+    constexpr uint32_t XR_HISTORY_SIZE = 4096;
+
+    /* Most packets described by one loss RLE block, 64 bit vector chunks */
+    constexpr uint32_t XR_MAX_RLE_PACKETS = 960;
+
+    /* The gap threshold of the burst metrics, see RFC 3611 section 4.7.2 */
+    constexpr uint8_t XR_GMIN = 16;
+
+    /* The receive history of one source for the RTCP XR report blocks, RFC 3611
+     *
+     * packet_received() is called by the receiving thread. It keeps a bitmap of the received sequence
+     * numbers, the number of duplicates and the jitter statistics. That thread is the only writer of
+     * them, so they are atomics written with plain stores. take_report() is called by the report
+     * generator, which only reads them and keeps the state of the burst and gap metrics between
+     * the reports.
+     *
+     * The jitter statistics are collected into two sets. Each report switches the set, so the
+     * receiving thread does not write the set the generator is reading, apart from the packet
+     * it may be handling at the moment of the switch */
+    class xr_history {
+        public:
+            xr_history();
+
+            /* Record the packet "seq". "transit_difference" is the difference of its relative transit
+             * time to the previous packet in timestamp units, see RFC 3550 A.8 */
+            void packet_received(uint16_t seq, uint32_t transit_difference);
+
+            /* Fill the blocks of the source "ssrc" with the packets received since the previous report.
+             * The chunks of "loss_rle" are reused, so after the first reports nothing is allocated
+             *
+             * Return false if nothing has been received yet */
+            bool take_report(uint32_t ssrc, uint16_t round_trip_ms, uvgrtp::frame::rtcp_xr_loss_rle& loss_rle,
+                uvgrtp::frame::rtcp_xr_stat_summary& stat_summary, uvgrtp::frame::rtcp_xr_voip_metrics& voip);
+
+        private:
+            struct jitter_set {
+                std::atomic<uint32_t> epoch{0};
+                std::atomic<uint32_t> count{0};
+                std::atomic<uint32_t> min{0};
+                std::atomic<uint32_t> max{0};
+                std::atomic<double> sum{0};
+                std::atomic<double> sum_sq{0};
+            };
+
+            bool received(uint32_t ext_seq) const;
+            void set_received(uint32_t ext_seq, bool value);
+
+            /* Feed one packet to the burst and gap state machine of RFC 3611 section 4.7.2 */
+            void count_burst(bool lost);
+
+            /* Written by the receiving thread */
+            std::atomic<uint64_t> bits_[XR_HISTORY_SIZE / 64];
+            std::atomic<uint32_t> highest_;
+            std::atomic<uint32_t> duplicates_;
+            std::atomic<bool> started_;
+            uint32_t first_seq_;
+            int64_t first_ms_;
+            uint32_t seen_epoch_;
+            jitter_set jitter_[2];
+
+            /* Written by the report generator */
+            std::atomic<uint32_t> epoch_;
+            bool reported_;
+            uint32_t next_begin_;
+            uint32_t reported_duplicates_;
+
+            /* Burst and gap state: the packets received since the last loss, the losses of the
+             * current burst, the transition counts of the Markov model and the packets counted */
+            uint32_t pkt_;
+            uint32_t lost_;
+            uint32_t c11_;
+            uint32_t c13_;
+            uint32_t c14_;
+            uint32_t c22_;
+            uint32_t c23_;
+            uint32_t c33_;
+            uint32_t counted_;
+            uint32_t counted_lost_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -1,10 +1,12 @@
 #include "rtp.hh"
 
 #include "uvgrtp/frame.hh"
+#include "uvgrtp/media_clock.hh"
 
 #include "debug.hh"
 #include "random.hh"
 #include "memory.hh"
+#include "frame_pool.hh"
 
 #include "global.hh"
 
@@ -29,6 +31,7 @@ uvgrtp::rtp::rtp(rtp_format_t fmt, std::shared_ptr<std::atomic<std::uint32_t>> s
     wc_start_2(),
     sent_pkts_(0),
     timestamp_(INVALID_TS),
+    media_clock_(nullptr),
     sampling_ntp_(0),
     rtp_ts_(0),
     delay_(PKT_MAX_DELAY_MS)
@@ -97,6 +100,7 @@ void uvgrtp::rtp::set_default_clock_rate(rtp_format_t fmt)
         case RTP_FORMAT_H264:
         case RTP_FORMAT_H265:
         case RTP_FORMAT_H266:
+        case RTP_FORMAT_RAW_VIDEO:
             clock_rate_ = 90000;
             break;
         case RTP_FORMAT_L8:   // variable, user should set this
@@ -160,7 +164,21 @@ void uvgrtp::rtp::fill_header(uint8_t *buffer)
     *(uint16_t *)&buffer[2] = htons(seq_);
     *(uint32_t *)&buffer[8] = htonl(*ssrc_.get());
 
-    if (timestamp_ == INVALID_TS) {
+    std::shared_ptr<uvgrtp::media_clock> media_clock = timestamp_ == INVALID_TS ? std::atomic_load(&media_clock_) : nullptr;
+
+    if (media_clock) {
+        uint64_t ntp   = 0;
+        uint64_t units = 0;
+
+        // the frame is stamped with the media clock as it is, so the sender reports map it exactly
+        media_clock->now(clock_rate_, ntp, units);
+
+        rtp_ts_       = ts_ + (uint32_t)units;
+        sampling_ntp_ = ntp;
+
+        *(uint32_t *)&buffer[4] = htonl((u_long)rtp_ts_);
+    }
+    else if (timestamp_ == INVALID_TS) {
 
         auto t1 = std::chrono::high_resolution_clock::now();
         std::chrono::microseconds time_since_start = 
@@ -181,6 +199,25 @@ void uvgrtp::rtp::fill_header(uint8_t *buffer)
     }
 }
 
+void uvgrtp::rtp::set_media_clock(std::shared_ptr<uvgrtp::media_clock> clock)
+{
+    std::atomic_store(&media_clock_, clock);
+}
+
+bool uvgrtp::rtp::get_media_clock_time(uint64_t& ntp, uint32_t& rtp_ts) const
+{
+    std::shared_ptr<uvgrtp::media_clock> media_clock = std::atomic_load(&media_clock_);
+
+    if (!media_clock)
+        return false;
+
+    uint64_t units = 0;
+    media_clock->now(clock_rate_, ntp, units);
+    rtp_ts = ts_ + (uint32_t)units;
+
+    return true;
+}
+
 void uvgrtp::rtp::set_timestamp(uint64_t timestamp)
 {
     timestamp_= timestamp;
@@ -235,7 +272,6 @@ uint32_t uvgrtp::rtp::get_rtp_ts() const {
 
 rtp_error_t uvgrtp::rtp::packet_handler(void* args, int rce_flags, uint8_t* packet, size_t size, uvgrtp::frame::rtp_frame **out)
 {
-    (void)rce_flags;
     (void)args;
 
     /* not an RTP frame */
@@ -323,9 +359,22 @@ rtp_error_t uvgrtp::rtp::packet_handler(void* args, int rce_flags, uint8_t* pack
         (*out)->padding_len  = padding_len;
     }
 
-    (*out)->payload    = (uint8_t *)memdup(ptr, (*out)->payload_len);
-    (*out)->dgram      = (uint8_t *)packet;
-    (*out)->dgram_size = size;
+    (*out)->dgram       = (uint8_t *)packet;
+    (*out)->dgram_size  = size;
+    (*out)->dgram_owned = true;
+
+    if (rce_flags & RCE_RECEIVE_ZERO_COPY) {
+        // the frame takes the receive buffer and reception_flow gives the ring a new one
+        (*out)->payload = ptr;
+    } else {
+        /* Copy the whole datagram instead of just the payload. The parsed RTP header
+         * in front of the payload leaves room for the H26x start code, so it can be
+         * written in place instead of copying the NAL unit again */
+        (*out)->dgram = uvgrtp::frame_pool::alloc_payload(size);
+        std::memcpy((*out)->dgram, packet, size);
+
+        (*out)->payload = (*out)->dgram + (ptr - packet);
+    }
 
     return RTP_PKT_MODIFIED;
 }
@@ -9,6 +9,8 @@
 
 namespace uvgrtp {
 
+    class media_clock;
+
     namespace frame
     {
         struct rtp_frame;
@@ -40,6 +42,15 @@ namespace uvgrtp {
             void set_pkt_max_delay(size_t delay);
             void set_sampling_ntp(uint64_t ntp_ts);
 
+            /* Take the timestamps of the frames without one and of the sender reports from "clock",
+             * or from the wall clock if it is nullptr */
+            void set_media_clock(std::shared_ptr<uvgrtp::media_clock> clock);
+
+            /* Read the NTP time and the RTP timestamp of this moment from the media clock for a sender report
+             *
+             * Return false if the stream has no media clock */
+            bool get_media_clock_time(uint64_t& ntp, uint32_t& rtp_ts) const;
+
             void fill_header(uint8_t *buffer);
             void update_sequence(uint8_t *buffer);
 
@@ -65,6 +76,9 @@ namespace uvgrtp {
             /* Use custom timestamp for the outgoing RTP packets */
             uint64_t timestamp_;
 
+            /* The media clock of the application, see set_media_clock() */
+            std::shared_ptr<uvgrtp::media_clock> media_clock_;
+
             /* custom NTP timestamp of when the RTP packet was SAMPLED */
             uint64_t sampling_ntp_;
 
@@ -0,0 +1,150 @@
+#include "send_queue.hh"
+
+#include "debug.hh"
+#include "threads.hh"
+
+uvgrtp::send_queue::send_queue(std::function<rtp_error_t(send_request&)> send, size_t capacity) :
+    send_(send),
+    queue_(),
+    capacity_(capacity),
+    hook_arg_(nullptr),
+    hook_(nullptr),
+    active_(false),
+    runner_(nullptr),
+    thread_settings_(nullptr)
+{
+}
+
+uvgrtp::send_queue::~send_queue()
+{
+    stop();
+}
+
+rtp_error_t uvgrtp::send_queue::start()
+{
+    active_ = true;
+    runner_ = uvgrtp::start_thread(thread_settings_, RTP_THREAD_SENDER, -1, &uvgrtp::send_queue::sender, this);
+    return RTP_OK;
+}
+
+void uvgrtp::send_queue::set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings)
+{
+    thread_settings_ = settings;
+}
+
+void uvgrtp::send_queue::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = false;
+    }
+    cond_.notify_all();
+
+    if (runner_ && runner_->joinable()) {
+        runner_->join();
+    }
+
+    std::deque<send_request> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending.swap(queue_);
+    }
+
+    for (auto& request : pending) {
+        complete(request, RTP_INTERRUPTED);
+    }
+}
+
+rtp_error_t uvgrtp::send_queue::enqueue(send_request&& request)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!active_) {
+            UVG_LOG_ERROR("Send queue is not running, cannot queue the frame");
+            return RTP_NOT_INITIALIZED;
+        }
+
+        if (queue_.size() >= capacity_) {
+            UVG_LOG_DEBUG("Send queue is full, %zu frames waiting", queue_.size());
+            return RTP_MEMORY_ERROR;
+        }
+        queue_.push_back(std::move(request));
+    }
+    cond_.notify_one();
+
+    return RTP_OK;
+}
+
+void uvgrtp::send_queue::install_complete_hook(void *arg, send_complete_hook hook)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    hook_arg_ = arg;
+    hook_     = hook;
+}
+
+void uvgrtp::send_queue::set_capacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+}
+
+size_t uvgrtp::send_queue::get_capacity() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return capacity_;
+}
+
+void uvgrtp::send_queue::sender()
+{
+    UVG_LOG_DEBUG("Starting send queue");
+
+    while (true) {
+        send_request request;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return !queue_.empty() || !active_; });
+
+            if (!active_)
+                break;
+
+            request = std::move(queue_.front());
+            queue_.pop_front();
+        }
+
+        rtp_error_t ret = send_(request);
+        if (ret != RTP_OK) {
+            UVG_LOG_WARN("Failed to send a queued frame: %d", (int)ret);
+        }
+        complete(request, ret);
+    }
+
+    UVG_LOG_DEBUG("Stopping send queue");
+}
+
+void uvgrtp::send_queue::complete(send_request& request, rtp_error_t result)
+{
+    void *arg;
+    send_complete_hook hook;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        arg  = hook_arg_;
+        hook = hook_;
+    }
+
+    // buffers that uvgRTP owns are released here, the application only gets its own buffer back
+    request.owned = nullptr;
+    request.copy  = nullptr;
+
+    if (hook) {
+        hook(arg, request.data, result);
+    }
+
+    if (request.release) {
+        request.release(request.release_arg, request.data);
+    }
+
+    if (request.done) {
+        request.done(result);
+    }
+}
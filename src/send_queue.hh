@@ -0,0 +1,128 @@
+#pragma once
+
+#include "uvgrtp/frame.hh"
+#include "uvgrtp/util.hh"
+
+#include "copy_pool.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace uvgrtp {
+
+    class thread_settings;
+
+    /* Default number of frames that can wait in the send queue, see RCC_SEND_QUEUE_SIZE */
+    constexpr size_t DEFAULT_SEND_QUEUE_SIZE = 8;
+
+    typedef void (*send_complete_hook)(void *arg, uint8_t *data, rtp_error_t result);
+
+    /* One frame given to push_frame() that waits to be sent */
+    struct send_request {
+        /* Buffer of the application that uvgRTP does not own. Returned to the
+         * application with the completion hook once the frame has been sent */
+        uint8_t *data = nullptr;
+
+        /* Buffer uvgRTP owns, given as a smart pointer */
+        std::unique_ptr<uint8_t[]> owned;
+
+        /* Copy of the frame made with RTP_COPY, returned to the pool of the stream with the request */
+        uvgrtp::pooled_buffer copy;
+
+        /* RTP_COPY was given but the copy could not be allocated, the frame is not sent */
+        bool copy_failed = false;
+
+        /* Buffer handed over by the application, given to "release" once it has been sent.
+         * "data" points to it */
+        void (*release)(void *, uint8_t *) = nullptr;
+        void *release_arg = nullptr;
+
+        /* Given the result once the frame has been sent, set by media_stream::async_push_frame() */
+        std::function<void(rtp_error_t)> done;
+
+        size_t len = 0;
+        int rtp_flags = 0;
+
+        bool has_ts = false;
+        uint32_t ts = 0;
+
+        bool has_ntp_ts = false;
+        uint64_t ntp_ts = 0;
+
+        bool has_nal_units = false;
+        std::vector<uvgrtp::frame::nal_unit> nal_units;
+
+        /* Scan lines of a raw video frame given to push_scanlines(), "data" is the first line */
+        bool has_lines = false;
+        std::vector<uint8_t *> lines;
+
+        /* The encodings and their lengths of push_simulcast_frames(), one for each layer */
+        std::vector<std::pair<uint8_t *, size_t>> simulcast;
+    };
+
+    /* Bounded queue of frames and a sender thread that packetizes and sends them,
+     * so that the thread calling push_frame() does not wait for the network or pacing.
+     *
+     * The queue never blocks the caller: if it is full, enqueue() fails and the
+     * application can drop the frame or try again later. After each frame, the
+     * completion hook is called from the sender thread with the result */
+    class send_queue {
+        public:
+            send_queue(std::function<rtp_error_t(send_request&)> send, size_t capacity);
+            ~send_queue();
+
+            /* Create the sender thread
+             *
+             * Return RTP_OK on success
+             * Return RTP_MEMORY_ERROR if allocation fails */
+            rtp_error_t start();
+
+            /* Stop the sender thread after the frame that is being sent. The frames that are
+             * still in the queue are completed with RTP_INTERRUPTED */
+            void stop();
+
+            /* Queue a frame for sending
+             *
+             * Return RTP_OK on success
+             * Return RTP_MEMORY_ERROR if the queue is full
+             * Return RTP_NOT_INITIALIZED if the sender thread is not running */
+            rtp_error_t enqueue(send_request&& request);
+
+            void install_complete_hook(void *arg, send_complete_hook hook);
+
+            void set_capacity(size_t capacity);
+
+            /* Configuration of the sender thread started afterwards */
+            void set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings);
+            size_t get_capacity() const;
+
+        private:
+            void sender();
+
+            /* Call the completion hook of the frame without holding the lock */
+            void complete(send_request& request, rtp_error_t result);
+
+            std::function<rtp_error_t(send_request&)> send_;
+
+            std::deque<send_request> queue_;
+            size_t capacity_;
+
+            mutable std::mutex mutex_;
+            std::condition_variable cond_;
+
+            void *hook_arg_;
+            send_complete_hook hook_;
+
+            std::atomic<bool> active_;
+            std::unique_ptr<std::thread> runner_;
+            std::shared_ptr<uvgrtp::thread_settings> thread_settings_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -18,6 +18,12 @@ uvgrtp::session::session(std::string cname, std::string addr, std::shared_ptr<uv
     sf_(sfp)
 {
     sf_->set_local_interface(generic_address_);
+
+    if (zrtp_) {
+        zrtp_->set_cache(sf_->get_zrtp_cache());
+        zrtp_->set_key_pool(sf_->get_key_pool());
+        zrtp_->set_ec25(sf_->get_zrtp_ec25());
+    }
 }
 
 uvgrtp::session::session(std::string cname, std::string remote_addr, std::string local_addr, std::shared_ptr<uvgrtp::socketfactory> sfp):
@@ -31,6 +37,12 @@ uvgrtp::session::session(std::string cname, std::string remote_addr, std::string
     sf_(sfp)
 {
     sf_->set_local_interface(local_addr);
+
+    if (zrtp_) {
+        zrtp_->set_cache(sf_->get_zrtp_cache());
+        zrtp_->set_key_pool(sf_->get_key_pool());
+        zrtp_->set_ec25(sf_->get_zrtp_ec25());
+    }
 }
 
 uvgrtp::session::~session()
@@ -107,7 +119,20 @@ uvgrtp::media_stream* uvgrtp::session::create_stream(uint16_t src_port, uint16_t
         rtp_errno = RTP_INVALID_VALUE;
         return  nullptr;
     }
-    
+
+    if (rce_flags & RCE_SRTP) {
+        if ((rce_flags & RCE_SRTP_AES_GCM) && !(rce_flags & RCE_SRTP_KMNGMNT_USER)) {
+            UVG_LOG_ERROR("AES-GCM is only supported with user-managed keys");
+            rtp_errno = RTP_INVALID_VALUE;
+            return nullptr;
+        }
+
+        /* The stream reserves room for the tag based on its flags. AES-GCM
+         * authenticates every packet, the tag is added in the same place */
+        if (rce_flags & (RCE_SRTP_REPLAY_PROTECTION | RCE_SRTP_AES_GCM))
+            rce_flags |= RCE_SRTP_AUTHENTICATE_RTP;
+    }
+
     uvgrtp::media_stream* stream =
         new uvgrtp::media_stream(cname_, remote_address_, local_address_, src_port, dst_port, fmt, sf_, rce_flags);
 
@@ -122,12 +147,12 @@ uvgrtp::media_stream* uvgrtp::session::create_stream(uint16_t src_port, uint16_t
         session_mtx_.lock();
         if (!zrtp_) {
             zrtp_ = std::shared_ptr<uvgrtp::zrtp>(new uvgrtp::zrtp());
+            zrtp_->set_cache(sf_->get_zrtp_cache());
+            zrtp_->set_key_pool(sf_->get_key_pool());
+            zrtp_->set_ec25(sf_->get_zrtp_ec25());
         }
         session_mtx_.unlock();
 
-        if (rce_flags & RCE_SRTP_REPLAY_PROTECTION)
-            rce_flags |= RCE_SRTP_AUTHENTICATE_RTP;
-
         /* With flags RCE_SRTP_KMNGMNT_ZRTP enabled, start ZRTP negotiation automatically.  NOTE! This only works when
          * not doing socket multiplexing. 
          * 
@@ -202,6 +227,11 @@ rtp_error_t uvgrtp::session::destroy_stream(uvgrtp::media_stream *stream)
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::session::reserve_ports(size_t pairs, uint16_t& first_port, uint16_t min_port, uint16_t max_port)
+{
+    return sf_->reserve_ports(local_address_, pairs, min_port, max_port, first_port);
+}
+
 std::string& uvgrtp::session::get_key()
 {
     return remote_address_;
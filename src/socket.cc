@@ -1,11 +1,19 @@
 #include "socket.hh"
 
+#include "uvgrtp/clock.hh"
 #include "uvgrtp/util.hh"
 
+#include "capture.hh"
 #include "debug.hh"
 #include "memory.hh"
+#include "memory_transport.hh"
+#include "xdp.hh"
+#include "stream_metrics.hh"
+#include "uring.hh"
+#include "rio.hh"
 
 #include <thread>
+#include <algorithm>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -21,6 +29,12 @@
 #include <netinet/in.h>
 #include <sys/types.h>
 #include <netdb.h>
+#ifdef __linux__
+#include <netinet/udp.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <time.h>
+#endif
 #endif
 
 #if defined(__MINGW32__) || defined(__MINGW64__)
@@ -29,28 +43,89 @@ using namespace uvgrtp;
 using namespace mingw;
 #endif
 
+#include <climits>
 #include <cstring>
 #include <cassert>
 
 
 #define WSABUF_SIZE 256
 
+#if (defined(__linux__) && defined(UDP_SEGMENT)) || (defined(_WIN32) && defined(UDP_SEND_MSG_SIZE))
+#define UVGRTP_HAVE_SEGMENTATION 1
+
+/* Kernel limits for one UDP GSO buffer, see UDP_MAX_SEGMENTS in linux/udp.h.
+ * Windows USO has the same limits */
+constexpr size_t MAX_GSO_SEGMENTS = 64;
+constexpr size_t MAX_GSO_SIZE     = 65507;
+#endif
+
+namespace {
+    /* A send running the packet handlers, counted to the epoch it started in, see remove_handler() */
+    class handler_run {
+        public:
+            handler_run(std::atomic<uint32_t>& epoch, std::atomic<uint64_t> (&runs)[2]) :
+                runs_(runs[epoch.load() & 1])
+            {
+                runs_.fetch_add(1);
+            }
+
+            ~handler_run()
+            {
+                runs_.fetch_sub(1, std::memory_order_release);
+            }
+
+        private:
+            std::atomic<uint64_t>& runs_;
+    };
+}
+
 uvgrtp::socket::socket(int rce_flags) :
     socket_(0),
     local_address_(),
     local_ip6_address_(),
     ipv6_(false),
     rce_flags_(rce_flags),
+    gso_supported_(true),
+    txtime_enabled_(false),
+    timestamping_(0),
+    recv_times_(),
+    count_drops_(false),
+    kernel_drops_(0),
+    destinations_(false),
+    recv_destinations_(),
+    tx_times_(nullptr),
+    tx_key_(0),
+    capturing_(false),
+    capture_(nullptr),
+    memory_(nullptr),
+    send_uring_(nullptr),
+    recv_uring_(nullptr),
+    rio_(nullptr),
+    handler_epoch_(0),
+    handler_runs_{ {0}, {0} },
 #ifdef _WIN32
-    buffers_()
+    buffers_(),
+    wsa_recvmsg_(nullptr)
 #else
     header_(),
-    chunks_()
+    chunks_(),
+    recv_headers_(),
+    recv_chunks_(),
+    recv_control_(),
+    recv_names_()
 #endif
 {}
 
 uvgrtp::socket::~socket()
 {
+    (void)stop_capture();
+
+    if (memory_)
+        memory_->detach();
+
+    if (xdp_port_)
+        xdp_->remove_port(xdp_port_);
+
     UVG_LOG_DEBUG("Socket total sent packets is %lu and received packets is %lu", sent_packets_, received_packets_);
 
 #ifndef _WIN32
@@ -70,7 +145,15 @@ rtp_error_t uvgrtp::socket::init(short family, int type, int protocol)
     }
 
 #ifdef _WIN32
-    if ((socket_ = ::socket(family, type, protocol)) == INVALID_SOCKET) {
+    socket_ = INVALID_SOCKET;
+
+#ifdef UVGRTP_HAVE_RIO
+    // Registered I/O needs a socket created for it, which otherwise works as any other
+    if (type == SOCK_DGRAM)
+        socket_ = WSASocketW(family, type, protocol, nullptr, 0, WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+#endif
+
+    if (socket_ == INVALID_SOCKET && (socket_ = ::socket(family, type, protocol)) == INVALID_SOCKET) {
         win_get_last_error();
 #else
     if ((socket_ = ::socket(family, type, protocol)) < 0) {
@@ -84,6 +167,17 @@ rtp_error_t uvgrtp::socket::init(short family, int type, int protocol)
     DWORD dwBytesReturned = 0;
 
     WSAIoctl(socket_, _WSAIOW(IOC_VENDOR, 12), &bNewBehavior, sizeof(bNewBehavior), NULL, 0, &dwBytesReturned, NULL, NULL);
+
+#ifdef UVGRTP_HAVE_RIO
+    if (type == SOCK_DGRAM) {
+        rio_ = std::unique_ptr<uvgrtp::rio>(new uvgrtp::rio());
+
+        if (rio_->init(socket_, uvgrtp::RIO_SLOT_SIZE) != RTP_OK) {
+            UVG_LOG_WARN("Registered I/O is not available, using WSASendTo() and WSARecvFrom()");
+            rio_ = nullptr;
+        }
+    }
+#endif
 #endif
 
     return RTP_OK;
@@ -133,6 +227,16 @@ rtp_error_t uvgrtp::socket::bind(sockaddr_in& local_address)
             UVG_LOG_ERROR("Binding to port %u failed!", ntohs(local_address_.sin_port));
             return RTP_BIND_ERROR;
         }
+
+        if (xdp_) {
+            if (xdp_->add_port(local_address_.sin_port, memory_) == RTP_OK) {
+                xdp_port_ = local_address_.sin_port;
+            } else {
+                UVG_LOG_WARN("Failed to receive port %u with AF_XDP, using UDP only", ntohs(local_address_.sin_port));
+            }
+        } else if (memory_) {
+            uvgrtp::memory_transport::attach(memory_, local_address_);
+        }
     } else {
         // Multicast address
         // Reuse address to enabled receiving the same stream multiple times
@@ -202,6 +306,10 @@ rtp_error_t uvgrtp::socket::bind_ip6(sockaddr_in6& local_address)
             UVG_LOG_ERROR("Binding to port %u failed!", ntohs(local_ip6_address_.sin6_port));
             return RTP_BIND_ERROR;
         }
+
+        // AF_XDP only carries IPv4, the queue of an IPv6 socket stays empty
+        if (memory_ && !xdp_)
+            uvgrtp::memory_transport::attach(memory_, local_ip6_address_);
     } else {
         // Multicast address
         // Reuse address to enabled receiving the same stream multiple times
@@ -389,15 +497,23 @@ socket_t& uvgrtp::socket::get_raw_socket()
 
 rtp_error_t uvgrtp::socket::install_handler(std::shared_ptr<std::atomic<std::uint32_t>> local_ssrc, void* arg, packet_handler_vec handler)
 {
-    handlers_mutex_.lock();
+    return install_handler(local_ssrc, arg, handler, nullptr);
+}
+
+rtp_error_t uvgrtp::socket::install_handler(std::shared_ptr<std::atomic<std::uint32_t>> local_ssrc, void* arg,
+    packet_handler_vec handler, packet_handler_pkt batch_handler)
+{
     if (!handler)
         return RTP_INVALID_VALUE;
 
-
     socket_packet_handler hndlr;
     hndlr.arg = arg;
     hndlr.handler = handler;
+    hndlr.batch_handler = batch_handler;
+
+    handlers_mutex_.lock();
     vec_handlers_.insert({local_ssrc, hndlr});
+    publish_handlers();
     handlers_mutex_.unlock();
 
     return RTP_OK;
@@ -406,17 +522,49 @@ rtp_error_t uvgrtp::socket::install_handler(std::shared_ptr<std::atomic<std::uin
 rtp_error_t uvgrtp::socket::remove_handler(std::shared_ptr<std::atomic<std::uint32_t>> local_ssrc)
 
 {
-    handlers_mutex_.lock();
+    std::lock_guard<std::mutex> lock(handlers_mutex_);
     vec_handlers_.erase(local_ssrc);
-    handlers_mutex_.unlock();
+    publish_handlers();
+
+    /* A send that took an earlier copy of the handlers started before the new copy was published, so it
+     * counts to the current epoch or, if it read the epoch just before a flip of an earlier removal, to
+     * the other one. The epoch is flipped twice, and after each flip the sends of the old parity are
+     * waited for. Sends starting meanwhile count to the new parity and take the new copy */
+    for (int i = 0; i < 2; ++i) {
+        uint32_t previous = handler_epoch_.fetch_add(1) & 1;
+
+        while (handler_runs_[previous].load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+    }
+
     return RTP_OK;
 }
 
+void uvgrtp::socket::publish_handlers()
+{
+    std::shared_ptr<const std::vector<socket_packet_handler>> handlers = nullptr;
+
+    if (!vec_handlers_.empty()) {
+        std::vector<socket_packet_handler> list;
+        list.reserve(vec_handlers_.size());
+
+        for (auto& handler : vec_handlers_) {
+            list.push_back(handler.second);
+        }
+        handlers = std::make_shared<const std::vector<socket_packet_handler>>(std::move(list));
+    }
+
+    std::atomic_store(&handlers_, handlers);
+}
+
 rtp_error_t uvgrtp::socket::__sendto(sockaddr_in& addr, sockaddr_in6& addr6, bool ipv6, uint8_t *buf, size_t buf_len, int send_flags, int *bytes_sent)
 {
     int nsend = 0;
 
 #ifndef _WIN32
+    save_tx_times(1, nullptr);
+
     if (ipv6) {
         nsend = ::sendto(socket_, buf, buf_len, send_flags, (const struct sockaddr*)&addr6, sizeof(addr6));
     }
@@ -425,6 +573,7 @@ rtp_error_t uvgrtp::socket::__sendto(sockaddr_in& addr, sockaddr_in6& addr6, boo
     }
     if (nsend == -1) {
         UVG_LOG_ERROR("Failed to send data: %s", strerror(errno));
+        forget_tx_times(1);
 
         if (bytes_sent) {
             *bytes_sent = -1;
@@ -460,6 +609,9 @@ rtp_error_t uvgrtp::socket::__sendto(sockaddr_in& addr, sockaddr_in6& addr6, boo
     nsend = sent_bytes;
 #endif
 
+    if (capturing_.load(std::memory_order_relaxed))
+        capture_sent(addr, addr6, buf, buf_len);
+
     if (bytes_sent) {
         *bytes_sent = nsend;
     }
@@ -489,6 +641,30 @@ rtp_error_t uvgrtp::socket::__sendtov(
     int send_flags, int *bytes_sent
 )
 {
+    if (memory_) {
+        std::shared_ptr<uvgrtp::memory_transport> peer = memory_peer(addr, addr6);
+
+        if ((peer && send_in_memory(*peer, addr, addr6, buffers)) || send_xdp(addr, buffers)) {
+            int length = 0;
+            for (auto& buffer : buffers) {
+                length += (int)buffer.first;
+            }
+
+            if (capturing_.load(std::memory_order_relaxed))
+                capture_sent(addr, addr6, buffers);
+
+            set_bytes(bytes_sent, length);
+            return RTP_OK;
+        }
+    }
+
+    rtp_error_t registered = RTP_OK;
+    if (send_registered(addr, addr6, ipv6, &buffers, 1, bytes_sent, registered)) {
+        if (registered == RTP_OK && capturing_.load(std::memory_order_relaxed))
+            capture_sent(addr, addr6, buffers);
+        return registered;
+    }
+
 #ifndef _WIN32
     int sent_bytes = 0;
 
@@ -511,8 +687,11 @@ rtp_error_t uvgrtp::socket::__sendtov(
     header_.msg_hdr.msg_control    = 0;
     header_.msg_hdr.msg_controllen = 0;
 
+    save_tx_times(1, nullptr);
+
     if (sendmmsg(socket_, &header_, 1, send_flags) < 0) {
         UVG_LOG_ERROR("Failed to send RTP frame: %s!", strerror(errno));
+        forget_tx_times(1);
         set_bytes(bytes_sent, -1);
         return RTP_SEND_ERROR;
     }
@@ -556,6 +735,9 @@ rtp_error_t uvgrtp::socket::__sendtov(
 
 #endif
 
+    if (capturing_.load(std::memory_order_relaxed))
+        capture_sent(addr, addr6, buffers);
+
 #ifndef NDEBUG
     ++sent_packets_;
 #endif // !NDEBUG
@@ -568,13 +750,9 @@ rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, sockaddr_in6& addr6, buf_v
 {
     rtp_error_t ret = RTP_OK;
 
-    for (auto& handler : vec_handlers_) {
-        std::lock_guard<std::mutex> lg(handlers_mutex_);
-        if ((ret = (*handler.second.handler)(handler.second.arg, buffers)) != RTP_OK) {
-            UVG_LOG_ERROR("Malformed packet");
-            return ret;
-        }
-    }
+    if ((ret = run_handlers(buffers)) != RTP_OK)
+        return ret;
+
     // buf_vec
     return __sendtov(addr, addr6, ipv6_, buffers, send_flags, nullptr);
 }
@@ -588,12 +766,9 @@ rtp_error_t uvgrtp::socket::sendto(
 {
     rtp_error_t ret = RTP_OK;
 
-    for (auto& handler : vec_handlers_) {
-        if ((ret = (*handler.second.handler)(handler.second.arg, buffers)) != RTP_OK) {
-            UVG_LOG_ERROR("Malformed packet");
-            return ret;
-        }
-    }
+    if ((ret = run_handlers(buffers)) != RTP_OK)
+        return ret;
+
     // buf_vec
     return __sendtov(addr, addr6, ipv6_, buffers, send_flags, bytes_sent);
 }
@@ -603,20 +778,41 @@ rtp_error_t uvgrtp::socket::__sendtov(
     sockaddr_in6& addr6,
     bool ipv6,
     uvgrtp::pkt_vec& buffers,
-    int send_flags, int *bytes_sent
+    int send_flags, int *bytes_sent,
+    send_arrays& arrays
 )
 {
     rtp_error_t return_value = RTP_OK;
     int sent_bytes = 0;
 
+    // the packets of the frame are queued to the Registered I/O and handed to the kernel at once
+    if (send_registered(addr, addr6, ipv6, buffers.data(), buffers.size(), bytes_sent, return_value)) {
+#ifndef NDEBUG
+        sent_packets_ += buffers.size();
+#endif // !NDEBUG
+        return return_value;
+    }
+
 #ifndef _WIN32
 
-    struct mmsghdr *headers = new struct mmsghdr[buffers.size()];
-    struct mmsghdr *hptr = headers;
+    size_t total_chunks = 0;
+    for (auto& buffer : buffers) {
+        total_chunks += buffer.size();
+    }
+
+    // the buffers of all packets go to one array that keeps its capacity between frames
+    arrays.headers.resize(buffers.size());
+    arrays.chunks.resize(total_chunks);
+
+    std::vector<struct mmsghdr>& headers = arrays.headers;
+    struct mmsghdr *hptr = headers.data();
+    struct iovec *cptr = arrays.chunks.data();
 
     for (size_t i = 0; i < buffers.size(); ++i) {
-        headers[i].msg_hdr.msg_iov        = new struct iovec[buffers[i].size()];
+        headers[i].msg_hdr.msg_iov        = cptr;
         headers[i].msg_hdr.msg_iovlen     = buffers[i].size();
+        headers[i].msg_hdr.msg_flags      = 0;
+        cptr += buffers[i].size();
         if (ipv6) {
             headers[i].msg_hdr.msg_name = (void*)&addr6;
             headers[i].msg_hdr.msg_namelen = sizeof(addr6);
@@ -635,12 +831,58 @@ rtp_error_t uvgrtp::socket::__sendtov(
         }
     }
 
+    // the launch times of sendto_txtime(), also used by save_tx_times()
+    const uint64_t *launch = nullptr;
+
+#if defined(__linux__) && defined(SCM_TXTIME)
+    if (!arrays.txtimes.empty() && arrays.txtimes.size() == buffers.size()) {
+        launch = arrays.txtimes.data();
+
+        const size_t space = CMSG_SPACE(sizeof(uint64_t));
+        arrays.control.assign(space * buffers.size(), 0);
+
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            headers[i].msg_hdr.msg_control    = arrays.control.data() + i * space;
+            headers[i].msg_hdr.msg_controllen = space;
+
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&headers[i].msg_hdr);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type  = SCM_TXTIME;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(uint64_t));
+            memcpy(CMSG_DATA(cmsg), &arrays.txtimes[i], sizeof(uint64_t));
+        }
+    }
+#endif
+
     ssize_t npkts = (rce_flags_ & RCE_SYSTEM_CALL_CLUSTERING) ? 1024 : 1;
     ssize_t bptr  = buffers.size();
 
+#ifdef UVGRTP_HAVE_IO_URING
+    // queue the whole frame into the ring and submit it with one system call
+    if (uring_ready(send_uring_)) {
+        npkts = send_uring_->get_entries();
+
+        while (bptr > 0 && return_value == RTP_OK) {
+            unsigned count = (unsigned)std::min(bptr, npkts);
+
+            save_tx_times(count, launch ? launch + (hptr - headers.data()) : nullptr);
+
+            if ((return_value = send_uring_->sendmsg(socket_, hptr, count, send_flags)) != RTP_OK)
+                forget_tx_times(count);
+
+            bptr -= count;
+            hptr += count;
+        }
+        bptr = 0;
+    }
+#endif
+
     while (bptr > npkts) {
+        save_tx_times((size_t)npkts, launch ? launch + (hptr - headers.data()) : nullptr);
+
         if (sendmmsg(socket_, hptr, npkts, send_flags) < 0) {
             log_platform_error("sendmmsg(2) failed");
+            forget_tx_times((size_t)npkts);
             return_value = RTP_SEND_ERROR;
             break;
         }
@@ -649,24 +891,21 @@ rtp_error_t uvgrtp::socket::__sendtov(
         hptr += npkts;
     }
 
-    if (return_value == RTP_OK)
+    if (return_value == RTP_OK && bptr > 0)
     {
+        save_tx_times((size_t)bptr, launch ? launch + (hptr - headers.data()) : nullptr);
+
         if (sendmmsg(socket_, hptr, bptr, send_flags) < 0) {
             log_platform_error("sendmmsg(2) failed");
+            forget_tx_times((size_t)bptr);
             return_value = RTP_SEND_ERROR;
         }
     }
-
-    for (size_t i = 0; i < buffers.size(); ++i)
-    {
-        if (headers[i].msg_hdr.msg_iov)
-        {
-            delete[] headers[i].msg_hdr.msg_iov;
-        }
-    }
-    delete[] headers;
+    arrays.txtimes.clear();
 
 #else
+    (void)arrays;
+
     INT ret = 0;
     WSABUF wsa_bufs[WSABUF_SIZE];
 
@@ -748,172 +987,530 @@ send_:
     return return_value;
 }
 
-rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags)
+rtp_error_t uvgrtp::socket::run_vec_handlers(pkt_vec& buffers)
 {
+    handler_run run(handler_epoch_, handler_runs_);
     rtp_error_t ret = RTP_OK;
-    for (auto& buffer : buffers) {
-        std::lock_guard<std::mutex> lg(handlers_mutex_);
-        for (auto& handler : vec_handlers_) {
-            if ((ret = (*handler.second.handler)(handler.second.arg, buffer)) != RTP_OK) {
+    std::shared_ptr<const std::vector<socket_packet_handler>> handlers = std::atomic_load(&handlers_);
+
+    if (!handlers)
+        return RTP_OK;
+
+    for (auto& handler : *handlers) {
+        if (handler.batch_handler) {
+            if ((ret = (*handler.batch_handler)(handler.arg, buffers)) != RTP_OK) {
+                UVG_LOG_ERROR("Malformed packet");
+                return ret;
+            }
+            continue;
+        }
+
+        for (auto& buffer : buffers) {
+            if ((ret = (*handler.handler)(handler.arg, buffer)) != RTP_OK) {
                 UVG_LOG_ERROR("Malformed packet");
                 return ret;
             }
         }
     }
-    return __sendtov(addr, addr6, ipv6_, buffers, send_flags, nullptr);
+    return RTP_OK;
 }
 
-rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags, int *bytes_sent)
+rtp_error_t uvgrtp::socket::run_handlers(buf_vec& buffers)
 {
+    handler_run run(handler_epoch_, handler_runs_);
     rtp_error_t ret = RTP_OK;
+    std::shared_ptr<const std::vector<socket_packet_handler>> handlers = std::atomic_load(&handlers_);
 
-    for (auto& buffer : buffers) {
-        std::lock_guard<std::mutex> lg(handlers_mutex_);
-        for (auto& handler : vec_handlers_) {
-            if ((ret = (*handler.second.handler)(handler.second.arg, buffer)) != RTP_OK) {
-                UVG_LOG_ERROR("Malformed packet");
-                return ret;
-            }
+    if (!handlers)
+        return RTP_OK;
+
+    for (auto& handler : *handlers) {
+        if ((ret = (*handler.handler)(handler.arg, buffers)) != RTP_OK) {
+            UVG_LOG_ERROR("Malformed packet");
+            return ret;
         }
     }
-    return __sendtov(addr, addr6, ipv6_, buffers, send_flags, bytes_sent);
+    return RTP_OK;
 }
 
-rtp_error_t uvgrtp::socket::__recv(uint8_t *buf, size_t buf_len, int recv_flags, int *bytes_read)
+rtp_error_t uvgrtp::socket::sendto_each(std::vector<addressed_packet>& packets, send_arrays& arrays)
 {
-    if (!buf || !buf_len) {
-        set_bytes(bytes_read, -1);
-        return RTP_INVALID_VALUE;
-    }
+    rtp_error_t ret = RTP_OK;
 
 #ifndef _WIN32
-    int32_t ret = ::recv(socket_, buf, buf_len, recv_flags);
-
-    if (ret == -1) {
-        if (errno == EAGAIN || errno == EINTR) {
-            set_bytes(bytes_read, 0);
-            return RTP_INTERRUPTED;
+    // the memory transport picks the route of each datagram by its address, so those go one by one
+    if (!memory_) {
+        size_t total_chunks = 0;
+        for (auto& packet : packets) {
+            total_chunks += packet.buffers->size();
         }
-        UVG_LOG_ERROR("recv(2) failed: %s", strerror(errno));
 
-        set_bytes(bytes_read, -1);
-        return RTP_GENERIC_ERROR;
-    }
+        arrays.headers.resize(packets.size());
+        arrays.chunks.resize(total_chunks);
 
-    set_bytes(bytes_read, ret);
-#else
-    (void)recv_flags;
+        std::vector<struct mmsghdr>& headers = arrays.headers;
+        struct iovec *cptr = arrays.chunks.data();
 
-    WSABUF DataBuf;
-    DataBuf.len = (u_long)buf_len;
-    DataBuf.buf = (char *)buf;
-    DWORD bytes_received = 0; 
-    DWORD d_recv_flags = 0;
+        for (size_t i = 0; i < packets.size(); ++i) {
+            buf_vec& buffers = *packets[i].buffers;
 
-    int rc = ::WSARecv(socket_, &DataBuf, 1, &bytes_received, &d_recv_flags, NULL, NULL);
-    if (rc == SOCKET_ERROR) {
-        int err = WSAGetLastError();
-        if (err == WSA_IO_PENDING || err == WSAEWOULDBLOCK) {
-            set_bytes(bytes_read, 0);
-            return RTP_INTERRUPTED;
+            headers[i].msg_hdr.msg_iov        = cptr;
+            headers[i].msg_hdr.msg_iovlen     = buffers.size();
+            headers[i].msg_hdr.msg_flags      = 0;
+            headers[i].msg_hdr.msg_control    = 0;
+            headers[i].msg_hdr.msg_controllen = 0;
+            cptr += buffers.size();
+
+            if (ipv6_) {
+                headers[i].msg_hdr.msg_name    = (void *)packets[i].addr6;
+                headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in6);
+            } else {
+                headers[i].msg_hdr.msg_name    = (void *)packets[i].addr;
+                headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            }
+
+            for (size_t k = 0; k < buffers.size(); ++k) {
+                headers[i].msg_hdr.msg_iov[k].iov_len  = buffers[k].first;
+                headers[i].msg_hdr.msg_iov[k].iov_base = buffers[k].second;
+            }
         }
 
-        log_platform_error("WSARecv() failed");
-        set_bytes(bytes_read, -1);
-        return RTP_GENERIC_ERROR;
-    }
+        for (size_t sent = 0; sent < packets.size(); ) {
+            unsigned count = (unsigned)std::min(packets.size() - sent, (size_t)1024);
 
-    set_bytes(bytes_read, bytes_received);
-#endif
+            save_tx_times(count, nullptr);
+
+            int result = sendmmsg(socket_, &headers[sent], count, 0);
+            if (result <= 0) {
+                log_platform_error("sendmmsg(2) failed");
+                forget_tx_times(count);
+                ret = RTP_SEND_ERROR;
+                break;
+            }
+
+            // the datagrams that the kernel did not take are sent with the next call
+            if ((unsigned)result < count)
+                forget_tx_times(count - (unsigned)result);
+
+            sent += (size_t)result;
+        }
 
 #ifndef NDEBUG
-    ++received_packets_;
+        sent_packets_ += packets.size();
 #endif // !NDEBUG
 
-    return RTP_OK;
+        if (ret == RTP_OK && capturing_.load(std::memory_order_relaxed)) {
+            for (auto& packet : packets) {
+                capture_sent(*packet.addr, *packet.addr6, *packet.buffers);
+            }
+        }
+        return ret;
+    }
+#else
+    (void)arrays;
+#endif
+
+    for (auto& packet : packets) {
+        if ((ret = __sendtov(*packet.addr, *packet.addr6, ipv6_, *packet.buffers, 0, nullptr)) != RTP_OK)
+            break;
+    }
+    return ret;
 }
 
-rtp_error_t uvgrtp::socket::recv(uint8_t *buf, size_t buf_len, int recv_flags)
+rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags)
 {
-    return uvgrtp::socket::__recv(buf, buf_len, recv_flags, nullptr);
+    send_arrays arrays;
+    return sendto(addr, addr6, buffers, send_flags, arrays);
 }
 
-rtp_error_t uvgrtp::socket::recv(uint8_t *buf, size_t buf_len, int recv_flags, int *bytes_read)
+rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags, send_arrays& arrays)
 {
-    return uvgrtp::socket::__recv(buf, buf_len, recv_flags, bytes_read);
+    rtp_error_t ret = run_vec_handlers(buffers);
+    if (ret != RTP_OK)
+        return ret;
+
+    return send_frames(addr, addr6, buffers, send_flags, nullptr, arrays, false);
 }
 
-rtp_error_t uvgrtp::socket::__recvfrom(uint8_t *buf, size_t buf_len, int recv_flags, sockaddr_in *sender, int *bytes_read)
+rtp_error_t uvgrtp::socket::sendto(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags, int *bytes_sent)
 {
-    socklen_t *len_ptr = nullptr;
-    socklen_t len      = sizeof(sockaddr_in);
+    rtp_error_t ret = run_vec_handlers(buffers);
+    if (ret != RTP_OK)
+        return ret;
 
-    if (sender)
-        len_ptr = &len;
+    send_arrays arrays;
+    return send_frames(addr, addr6, buffers, send_flags, bytes_sent, arrays, false);
+}
 
-#ifndef _WIN32
-    int32_t ret = ::recvfrom(socket_, buf, buf_len, recv_flags, (struct sockaddr *)sender, len_ptr);
+rtp_error_t uvgrtp::socket::sendto_gso(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags)
+{
+    send_arrays arrays;
+    return sendto_gso(addr, addr6, buffers, send_flags, arrays);
+}
 
-    if (ret == -1) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            set_bytes(bytes_read, 0);
-            return RTP_INTERRUPTED;
-        }
-        UVG_LOG_ERROR("recvfrom failed: %s", strerror(errno));
+rtp_error_t uvgrtp::socket::sendto_gso(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags, send_arrays& arrays)
+{
+    rtp_error_t ret = run_vec_handlers(buffers);
+    if (ret != RTP_OK)
+        return ret;
 
-        set_bytes(bytes_read, -1);
-        return RTP_GENERIC_ERROR;
-    }
+    return send_frames(addr, addr6, buffers, send_flags, nullptr, arrays, true);
+}
 
-    set_bytes(bytes_read, ret);
-#else
+rtp_error_t uvgrtp::socket::sendto_prepared(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags,
+    send_arrays& arrays, bool gso)
+{
+    return send_frames(addr, addr6, buffers, send_flags, nullptr, arrays, gso);
+}
 
-    (void)recv_flags;
+rtp_error_t uvgrtp::socket::send_frames(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags,
+    int *bytes_sent, send_arrays& arrays, bool gso)
+{
+    auto send = [&](pkt_vec& frames) {
+        if (gso && gso_supported_)
+            return __sendtov_gso(addr, addr6, ipv6_, frames, send_flags, bytes_sent, arrays);
+        return __sendtov(addr, addr6, ipv6_, frames, send_flags, bytes_sent, arrays);
+    };
 
-    WSABUF DataBuf;
-    DataBuf.len = (u_long)buf_len;
-    DataBuf.buf = (char *)buf;
-    DWORD bytes_received = 0;
-    DWORD d_recv_flags = 0;
+    rtp_error_t ret = RTP_OK;
+    size_t delivered = 0;
+    int delivered_bytes = 0;
 
-    int rc = ::WSARecvFrom(socket_, &DataBuf, 1, &bytes_received, &d_recv_flags, (SOCKADDR *)sender, (int *)len_ptr, NULL, NULL);
+    if (memory_) {
+        std::shared_ptr<uvgrtp::memory_transport> peer = memory_peer(addr, addr6);
 
-    if (WSAGetLastError() == WSAEWOULDBLOCK)
-        return RTP_INTERRUPTED;
+        for (; (peer || xdp_port_) && delivered < buffers.size(); ++delivered) {
+            if (!(peer && send_in_memory(*peer, addr, addr6, buffers[delivered])) && !send_xdp(addr, buffers[delivered]))
+                break;
 
-    int err = 0;
-    if ((rc == SOCKET_ERROR) && (WSA_IO_PENDING != (err = WSAGetLastError()))) {
-        /* win_get_last_error(); */
-        set_bytes(bytes_read, -1);
-        return RTP_GENERIC_ERROR;
+            for (auto& buffer : buffers[delivered]) {
+                delivered_bytes += (int)buffer.first;
+            }
+        }
     }
 
-    set_bytes(bytes_read, bytes_received);
-#endif
+    if (delivered == buffers.size()) {
+        // the frames are already at the receiver, so the launch times of sendto_txtime() do not apply
+        arrays.txtimes.clear();
+        set_bytes(bytes_sent, delivered_bytes);
+    } else if (delivered == 0) {
+        ret = send(buffers);
+    } else {
+        // the frames that did not fit into the queue of the receiver follow through the kernel
+        pkt_vec rest(buffers.begin() + delivered, buffers.end());
+        arrays.txtimes.clear();
 
-#ifndef NDEBUG
-    ++received_packets_;
-#endif // !NDEBUG
+        if ((ret = send(rest)) == RTP_OK && bytes_sent)
+            *bytes_sent += delivered_bytes;
+    }
 
-    return RTP_OK;
+    if (ret == RTP_OK && capturing_.load(std::memory_order_relaxed))
+        capture_sent(addr, addr6, buffers);
+
+    return ret;
 }
 
-rtp_error_t uvgrtp::socket::__recvfrom_ip6(uint8_t* buf, size_t buf_len, int recv_flags, sockaddr_in6* sender, int* bytes_read)
+rtp_error_t uvgrtp::socket::sendto_txtime(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags,
+    send_arrays& arrays, std::chrono::nanoseconds interval)
 {
-    socklen_t* len_ptr = nullptr;
-    socklen_t len = sizeof(sockaddr_in6);
-
-    if (sender)
-        len_ptr = &len;
+#if defined(__linux__) && defined(SO_TXTIME)
+    if (!txtime_enabled_)
+        return RTP_NOT_SUPPORTED;
+
+    // SO_TXTIME was enabled with CLOCK_MONOTONIC, so the launch times use the same clock
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t launch = (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+
+    arrays.txtimes.resize(buffers.size());
+    for (auto& txtime : arrays.txtimes) {
+        txtime  = launch;
+        launch += (uint64_t)interval.count();
+    }
 
-#ifndef _WIN32
-    int32_t ret = ::recvfrom(socket_, buf, buf_len, recv_flags, (struct sockaddr*)sender, len_ptr);
+    return sendto(addr, addr6, buffers, send_flags, arrays);
+#else
+    (void)addr, (void)addr6, (void)buffers, (void)send_flags, (void)arrays, (void)interval;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
 
-    if (ret == -1) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            set_bytes(bytes_read, 0);
-            return RTP_INTERRUPTED;
-        }
+rtp_error_t uvgrtp::socket::__sendtov_gso(
+    sockaddr_in& addr,
+    sockaddr_in6& addr6,
+    bool ipv6,
+    uvgrtp::pkt_vec& buffers,
+    int send_flags, int *bytes_sent,
+    send_arrays& arrays
+)
+{
+#ifdef UVGRTP_HAVE_SEGMENTATION
+    int sent_bytes = 0;
+    size_t pkt = 0;
+
+#ifndef _WIN32
+    std::vector<struct iovec>& chunks = arrays.chunks;
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+#else
+    // the packets of a frame are already handed to the kernel at once through the Registered I/O
+    if (rio_)
+        return __sendtov(addr, addr6, ipv6, buffers, send_flags, bytes_sent, arrays);
+
+    std::vector<WSABUF>& chunks = arrays.chunks;
+    char control[WSA_CMSG_SPACE(sizeof(DWORD))];
+#endif
+
+    while (pkt < buffers.size()) {
+
+        /* GSO was found not to work, send the rest of the packets normally */
+        if (!gso_supported_) {
+            int rest_bytes = 0;
+            uvgrtp::pkt_vec rest(buffers.begin() + pkt, buffers.end());
+
+            rtp_error_t ret = __sendtov(addr, addr6, ipv6, rest, send_flags, &rest_bytes, arrays);
+            set_bytes(bytes_sent, (ret == RTP_OK) ? sent_bytes + rest_bytes : -1);
+            return ret;
+        }
+
+        /* Collect packets of equal size into one GSO buffer. The kernel
+         * splits the buffer at segment size so only the last segment may be shorter */
+        size_t segment_size = 0;
+        for (auto& buffer : buffers[pkt])
+            segment_size += buffer.first;
+
+        size_t total_size = segment_size;
+        size_t end        = pkt + 1;
+
+        while (end < buffers.size() && end - pkt < MAX_GSO_SEGMENTS) {
+            size_t size = 0;
+            for (auto& buffer : buffers[end])
+                size += buffer.first;
+
+            if (size > segment_size || total_size + size > MAX_GSO_SIZE)
+                break;
+
+            total_size += size;
+            ++end;
+
+            if (size < segment_size)
+                break;
+        }
+
+        chunks.clear();
+        for (size_t i = pkt; i < end; ++i) {
+            for (auto& buffer : buffers[i]) {
+#ifndef _WIN32
+                chunks.push_back({ buffer.second, buffer.first });
+#else
+                chunks.push_back({ (ULONG)buffer.first, (CHAR *)buffer.second });
+#endif
+            }
+        }
+
+#ifndef _WIN32
+        struct msghdr msg = {};
+        if (ipv6) {
+            msg.msg_name    = (void *)&addr6;
+            msg.msg_namelen = sizeof(addr6);
+        } else {
+            msg.msg_name    = (void *)&addr;
+            msg.msg_namelen = sizeof(addr);
+        }
+        msg.msg_iov    = chunks.data();
+        msg.msg_iovlen = chunks.size();
+
+        if (end - pkt > 1) {
+            uint16_t gso_size = (uint16_t)segment_size;
+
+            msg.msg_control    = control;
+            msg.msg_controllen = sizeof(control);
+
+            struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level     = IPPROTO_UDP;
+            cm->cmsg_type      = UDP_SEGMENT;
+            cm->cmsg_len       = CMSG_LEN(sizeof(uint16_t));
+            memcpy(CMSG_DATA(cm), &gso_size, sizeof(uint16_t));
+        }
+
+        save_tx_times(1, nullptr);
+
+        ssize_t ret = ::sendmsg(socket_, &msg, send_flags);
+
+        if (ret < 0) {
+            forget_tx_times(1);
+
+            if (end - pkt > 1 && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP)) {
+                UVG_LOG_WARN("UDP GSO is not supported by the system, falling back to normal sending");
+                gso_supported_ = false;
+                continue;
+            }
+
+            log_platform_error("sendmsg(2) failed");
+            set_bytes(bytes_sent, -1);
+            return RTP_SEND_ERROR;
+        }
+
+        sent_bytes += (int)ret;
+#else
+        WSAMSG msg = {};
+        if (ipv6) {
+            msg.name    = (LPSOCKADDR)&addr6;
+            msg.namelen = sizeof(addr6);
+        } else {
+            msg.name    = (LPSOCKADDR)&addr;
+            msg.namelen = sizeof(addr);
+        }
+        msg.lpBuffers     = chunks.data();
+        msg.dwBufferCount = (DWORD)chunks.size();
+
+        // UDP Segmentation Offload splits the buffer as UDP_SEGMENT does on Linux
+        if (end - pkt > 1) {
+            DWORD uso_size = (DWORD)segment_size;
+
+            memset(control, 0, sizeof(control));
+            msg.Control.buf = control;
+            msg.Control.len = sizeof(control);
+
+            WSACMSGHDR *cm = WSA_CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level = IPPROTO_UDP;
+            cm->cmsg_type  = UDP_SEND_MSG_SIZE;
+            cm->cmsg_len   = WSA_CMSG_LEN(sizeof(DWORD));
+            memcpy(WSA_CMSG_DATA(cm), &uso_size, sizeof(DWORD));
+        }
+
+        DWORD sent_dw = 0;
+
+        if (WSASendMsg(socket_, &msg, (DWORD)send_flags, &sent_dw, nullptr, nullptr) == SOCKET_ERROR) {
+            int error = WSAGetLastError();
+
+            if (end - pkt > 1 && (error == WSAEINVAL || error == WSAEOPNOTSUPP || error == WSAENOPROTOOPT)) {
+                UVG_LOG_WARN("UDP segmentation offload is not supported by the system, falling back to normal sending");
+                gso_supported_ = false;
+                continue;
+            }
+
+            log_platform_error("WSASendMsg() failed");
+            set_bytes(bytes_sent, -1);
+            return RTP_SEND_ERROR;
+        }
+
+        sent_bytes += (int)sent_dw;
+#endif
+        pkt         = end;
+    }
+
+#ifndef NDEBUG
+    sent_packets_ += buffers.size();
+#endif // !NDEBUG
+
+    set_bytes(bytes_sent, sent_bytes);
+    return RTP_OK;
+#else
+    gso_supported_ = false;
+    return __sendtov(addr, addr6, ipv6, buffers, send_flags, bytes_sent, arrays);
+#endif
+}
+
+rtp_error_t uvgrtp::socket::__recv(uint8_t *buf, size_t buf_len, int recv_flags, int *bytes_read)
+{
+    if (!buf || !buf_len) {
+        set_bytes(bytes_read, -1);
+        return RTP_INVALID_VALUE;
+    }
+
+#ifndef _WIN32
+    int32_t ret = memory_ ? memory_->receive(buf, buf_len, nullptr, nullptr) : -1;
+
+    if (ret == -1)
+        ret = ::recv(socket_, buf, buf_len, recv_flags);
+
+    if (ret == -1) {
+        if (errno == EAGAIN || errno == EINTR) {
+            set_bytes(bytes_read, 0);
+            return RTP_INTERRUPTED;
+        }
+        UVG_LOG_ERROR("recv(2) failed: %s", strerror(errno));
+
+        set_bytes(bytes_read, -1);
+        return RTP_GENERIC_ERROR;
+    }
+
+    set_bytes(bytes_read, ret);
+
+    if (capturing_.load(std::memory_order_relaxed))
+        capture_received(buf, (size_t)ret, nullptr, uvgrtp::clock::system_ns());
+#else
+    (void)recv_flags;
+
+    rtp_error_t registered = RTP_OK;
+    if (recv_registered(buf, buf_len, nullptr, nullptr, bytes_read, registered))
+        return registered;
+
+    WSABUF DataBuf;
+    DataBuf.len = (u_long)buf_len;
+    DataBuf.buf = (char *)buf;
+    DWORD bytes_received = 0; 
+    DWORD d_recv_flags = 0;
+
+    int rc = ::WSARecv(socket_, &DataBuf, 1, &bytes_received, &d_recv_flags, NULL, NULL);
+    if (rc == SOCKET_ERROR) {
+        int err = WSAGetLastError();
+        if (err == WSA_IO_PENDING || err == WSAEWOULDBLOCK) {
+            set_bytes(bytes_read, 0);
+            return RTP_INTERRUPTED;
+        }
+
+        log_platform_error("WSARecv() failed");
+        set_bytes(bytes_read, -1);
+        return RTP_GENERIC_ERROR;
+    }
+
+    set_bytes(bytes_read, bytes_received);
+
+    if (capturing_.load(std::memory_order_relaxed))
+        capture_received(buf, (size_t)bytes_received, nullptr, uvgrtp::clock::system_ns());
+#endif
+
+#ifndef NDEBUG
+    ++received_packets_;
+#endif // !NDEBUG
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::socket::recv(uint8_t *buf, size_t buf_len, int recv_flags)
+{
+    return uvgrtp::socket::__recv(buf, buf_len, recv_flags, nullptr);
+}
+
+rtp_error_t uvgrtp::socket::recv(uint8_t *buf, size_t buf_len, int recv_flags, int *bytes_read)
+{
+    return uvgrtp::socket::__recv(buf, buf_len, recv_flags, bytes_read);
+}
+
+rtp_error_t uvgrtp::socket::__recvfrom(uint8_t *buf, size_t buf_len, int recv_flags, sockaddr_in *sender, int *bytes_read)
+{
+    socklen_t *len_ptr = nullptr;
+    socklen_t len      = sizeof(sockaddr_in);
+
+    if (sender)
+        len_ptr = &len;
+
+    // the capture wants to know who sent the datagram even if the caller does not
+    sockaddr_in captured_sender = {};
+    if (!sender && capturing_.load(std::memory_order_relaxed)) {
+        sender  = &captured_sender;
+        len_ptr = &len;
+    }
+
+#ifndef _WIN32
+    int32_t ret = (int32_t)recv_datagram(buf, buf_len, recv_flags, (struct sockaddr *)sender, len_ptr);
+
+    if (ret == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            set_bytes(bytes_read, 0);
+            return RTP_INTERRUPTED;
+        }
         UVG_LOG_ERROR("recvfrom failed: %s", strerror(errno));
 
         set_bytes(bytes_read, -1);
@@ -921,17 +1518,24 @@ rtp_error_t uvgrtp::socket::__recvfrom_ip6(uint8_t* buf, size_t buf_len, int rec
     }
 
     set_bytes(bytes_read, ret);
+
+    if (capturing_.load(std::memory_order_relaxed))
+        capture_received(buf, (size_t)ret, (const struct sockaddr *)sender, recv_times_[0]);
 #else
 
     (void)recv_flags;
 
+    rtp_error_t registered = RTP_OK;
+    if (recv_registered(buf, buf_len, (struct sockaddr *)sender, len_ptr, bytes_read, registered))
+        return registered;
+
     WSABUF DataBuf;
     DataBuf.len = (u_long)buf_len;
-    DataBuf.buf = (char*)buf;
+    DataBuf.buf = (char *)buf;
     DWORD bytes_received = 0;
     DWORD d_recv_flags = 0;
 
-    int rc = ::WSARecvFrom(socket_, &DataBuf, 1, &bytes_received, &d_recv_flags, (SOCKADDR*)sender, (int*)len_ptr, NULL, NULL);
+    int rc = ::WSARecvFrom(socket_, &DataBuf, 1, &bytes_received, &d_recv_flags, (SOCKADDR *)sender, (int *)len_ptr, NULL, NULL);
 
     if (WSAGetLastError() == WSAEWOULDBLOCK)
         return RTP_INTERRUPTED;
@@ -944,6 +1548,10 @@ rtp_error_t uvgrtp::socket::__recvfrom_ip6(uint8_t* buf, size_t buf_len, int rec
     }
 
     set_bytes(bytes_read, bytes_received);
+    recv_times_[0] = uvgrtp::clock::system_ns();
+
+    if (capturing_.load(std::memory_order_relaxed))
+        capture_received(buf, (size_t)bytes_received, (const struct sockaddr *)sender, recv_times_[0]);
 #endif
 
 #ifndef NDEBUG
@@ -953,29 +1561,1386 @@ rtp_error_t uvgrtp::socket::__recvfrom_ip6(uint8_t* buf, size_t buf_len, int rec
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int recv_flags, sockaddr_in *sender,
-    sockaddr_in6 *sender6, int *bytes_read)
+rtp_error_t uvgrtp::socket::__recvfrom_ip6(uint8_t* buf, size_t buf_len, int recv_flags, sockaddr_in6* sender, int* bytes_read)
 {
-    if (ipv6_) {
-        return __recvfrom_ip6(buf, buf_len, recv_flags, sender6, bytes_read);
+    socklen_t* len_ptr = nullptr;
+    socklen_t len = sizeof(sockaddr_in6);
+
+    if (sender)
+        len_ptr = &len;
+
+    // the capture wants to know who sent the datagram even if the caller does not
+    sockaddr_in6 captured_sender = {};
+    if (!sender && capturing_.load(std::memory_order_relaxed)) {
+        sender  = &captured_sender;
+        len_ptr = &len;
     }
-    return __recvfrom(buf, buf_len, recv_flags, sender, bytes_read);
+
+#ifndef _WIN32
+    int32_t ret = (int32_t)recv_datagram(buf, buf_len, recv_flags, (struct sockaddr*)sender, len_ptr);
+
+    if (ret == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            set_bytes(bytes_read, 0);
+            return RTP_INTERRUPTED;
+        }
+        UVG_LOG_ERROR("recvfrom failed: %s", strerror(errno));
+
+        set_bytes(bytes_read, -1);
+        return RTP_GENERIC_ERROR;
+    }
+
+    set_bytes(bytes_read, ret);
+
+    if (capturing_.load(std::memory_order_relaxed))
+        capture_received(buf, (size_t)ret, (const struct sockaddr *)sender, recv_times_[0]);
+#else
+
+    (void)recv_flags;
+
+    rtp_error_t registered = RTP_OK;
+    if (recv_registered(buf, buf_len, (struct sockaddr *)sender, len_ptr, bytes_read, registered))
+        return registered;
+
+    WSABUF DataBuf;
+    DataBuf.len = (u_long)buf_len;
+    DataBuf.buf = (char*)buf;
+    DWORD bytes_received = 0;
+    DWORD d_recv_flags = 0;
+
+    int rc = ::WSARecvFrom(socket_, &DataBuf, 1, &bytes_received, &d_recv_flags, (SOCKADDR*)sender, (int*)len_ptr, NULL, NULL);
+
+    if (WSAGetLastError() == WSAEWOULDBLOCK)
+        return RTP_INTERRUPTED;
+
+    int err = 0;
+    if ((rc == SOCKET_ERROR) && (WSA_IO_PENDING != (err = WSAGetLastError()))) {
+        /* win_get_last_error(); */
+        set_bytes(bytes_read, -1);
+        return RTP_GENERIC_ERROR;
+    }
+
+    set_bytes(bytes_read, bytes_received);
+    recv_times_[0] = uvgrtp::clock::system_ns();
+
+    if (capturing_.load(std::memory_order_relaxed))
+        capture_received(buf, (size_t)bytes_received, (const struct sockaddr *)sender, recv_times_[0]);
+#endif
+
+#ifndef NDEBUG
+    ++received_packets_;
+#endif // !NDEBUG
+
+    return RTP_OK;
 }
 
-rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int recv_flags, int *bytes_read)
+#ifndef _WIN32
+ssize_t uvgrtp::socket::recv_datagram(uint8_t *buf, size_t buf_len, int recv_flags, struct sockaddr *sender, socklen_t *len)
 {
-    if (ipv6_) {
-        return __recvfrom_ip6(buf, buf_len, recv_flags, nullptr, bytes_read);
+    // the datagrams of the memory transport are taken first, the socket is still read when it has none
+    if (memory_) {
+        int ret = memory_->receive(buf, buf_len, sender, len);
+
+        if (ret >= 0) {
+            recv_times_[0] = uvgrtp::clock::system_ns();
+            return ret;
+        }
     }
-    return __recvfrom(buf, buf_len, recv_flags, nullptr, bytes_read);
+
+#ifdef __linux__
+    if (receive_control()) {
+        struct iovec chunk = { buf, buf_len };
+
+        struct msghdr msg  = {};
+        msg.msg_name       = sender;
+        msg.msg_namelen    = len ? *len : 0;
+        msg.msg_iov        = &chunk;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = recv_control_[0];
+        msg.msg_controllen = RECV_CONTROL_SIZE;
+
+        ssize_t ret = ::recvmsg(socket_, &msg, recv_flags);
+
+        if (ret >= 0) {
+            if (len)
+                *len = msg.msg_namelen;
+
+            uint64_t timestamp = read_control(&msg, 0);
+            recv_times_[0] = timestamp ? timestamp : uvgrtp::clock::system_ns();
+        }
+        return ret;
+    }
+#endif
+
+    ssize_t ret = ::recvfrom(socket_, buf, buf_len, recv_flags, sender, len);
+
+    if (ret >= 0)
+        recv_times_[0] = uvgrtp::clock::system_ns();
+
+    return ret;
 }
 
-rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int recv_flags, sockaddr_in *sender)
+bool uvgrtp::socket::receive_control() const
 {
-    return __recvfrom(buf, buf_len, recv_flags, sender, nullptr);
+    return (timestamping_ & RTP_TIMESTAMP_RECEIVE) || count_drops_ || destinations_;
 }
 
-rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int recv_flags)
+uint64_t uvgrtp::socket::read_control(const struct msghdr *msg, int index)
 {
-    return __recvfrom(buf, buf_len, recv_flags, nullptr, nullptr);
+    uint64_t timestamp = 0;
+
+#ifdef __linux__
+    if (!msg->msg_control)
+        return 0;
+
+    if (destinations_.load(std::memory_order_relaxed))
+        memset(&recv_destinations_[index], 0, sizeof(in6_addr));
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(msg); cm != nullptr; cm = CMSG_NXTHDR((struct msghdr *)msg, cm)) {
+        // the group or unicast address the datagram was sent to
+        if (cm->cmsg_level == IPPROTO_IP && cm->cmsg_type == IP_PKTINFO) {
+            struct in_pktinfo info;
+            memcpy(&info, CMSG_DATA(cm), sizeof(info));
+
+            sockaddr_in destination = {};
+            destination.sin_addr = info.ipi_addr;
+            recv_destinations_[index] = mapped_address(destination);
+            continue;
+        }
+
+        if (cm->cmsg_level == IPPROTO_IPV6 && cm->cmsg_type == IPV6_PKTINFO) {
+            struct in6_pktinfo info;
+            memcpy(&info, CMSG_DATA(cm), sizeof(info));
+
+            recv_destinations_[index] = info.ipi6_addr;
+            continue;
+        }
+
+        if (cm->cmsg_level != SOL_SOCKET)
+            continue;
+
+#ifdef SO_RXQ_OVFL
+        // the kernel tells the number of datagrams dropped so far, if there have been any
+        if (cm->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t drops = 0;
+            memcpy(&drops, CMSG_DATA(cm), sizeof(drops));
+            kernel_drops_.store(drops, std::memory_order_relaxed);
+        }
+#endif
+
+#ifdef SO_TIMESTAMPING
+        if (cm->cmsg_type == SCM_TIMESTAMPING && (timestamping_ & RTP_TIMESTAMP_RECEIVE)) {
+
+            // the software timestamp is first and the hardware timestamp last
+            struct scm_timestamping timestamps;
+            memcpy(&timestamps, CMSG_DATA(cm), sizeof(timestamps));
+
+            const struct timespec *ts = &timestamps.ts[0];
+            if ((timestamping_ & RTP_TIMESTAMP_HARDWARE) && (timestamps.ts[2].tv_sec || timestamps.ts[2].tv_nsec))
+                ts = &timestamps.ts[2];
+
+            timestamp = (uint64_t)ts->tv_sec * 1000000000 + (uint64_t)ts->tv_nsec;
+        }
+#endif
+    }
+#else
+    (void)msg;
+    (void)index;
+#endif
+    return timestamp;
+}
+#endif
+
+uint64_t uvgrtp::socket::recv_time(int i) const
+{
+    return recv_times_[i];
+}
+
+rtp_error_t uvgrtp::socket::enable_drop_counting()
+{
+#if defined(__linux__) && defined(SO_RXQ_OVFL)
+    int enable = 1;
+
+    if (::setsockopt(socket_, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable)) < 0) {
+        log_platform_error("setsockopt(SO_RXQ_OVFL) failed");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    count_drops_ = true;
+    return RTP_OK;
+#else
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+uint64_t uvgrtp::socket::kernel_drops() const
+{
+    return kernel_drops_.load(std::memory_order_relaxed);
+}
+
+rtp_error_t uvgrtp::socket::join_group(const std::string& group, const std::string& source)
+{
+    return change_membership(group, source, true);
+}
+
+rtp_error_t uvgrtp::socket::leave_group(const std::string& group, const std::string& source)
+{
+    return change_membership(group, source, false);
+}
+
+rtp_error_t uvgrtp::socket::change_membership(const std::string& group, const std::string& source, bool join)
+{
+    int level = ipv6_ ? IPPROTO_IPV6 : IPPROTO_IP;
+
+    // the protocol-independent requests of RFC 3678 cover both families and the source filters
+    struct group_req group_request = {};
+    struct group_source_req source_request = {};
+
+    if (ipv6_) {
+        sockaddr_in6 group_addr = create_ip6_sockaddr(group, 0);
+        if (!is_multicast(group_addr)) {
+            UVG_LOG_ERROR("%s is not an IPv6 multicast address", group.c_str());
+            return RTP_INVALID_VALUE;
+        }
+
+        memcpy(&group_request.gr_group, &group_addr, sizeof(group_addr));
+        memcpy(&source_request.gsr_group, &group_addr, sizeof(group_addr));
+
+        if (!source.empty()) {
+            sockaddr_in6 source_addr = create_ip6_sockaddr(source, 0);
+            memcpy(&source_request.gsr_source, &source_addr, sizeof(source_addr));
+        }
+    } else {
+        sockaddr_in group_addr = create_sockaddr(AF_INET, group, 0);
+        if (!is_multicast(group_addr)) {
+            UVG_LOG_ERROR("%s is not an IPv4 multicast address", group.c_str());
+            return RTP_INVALID_VALUE;
+        }
+
+        memcpy(&group_request.gr_group, &group_addr, sizeof(group_addr));
+        memcpy(&source_request.gsr_group, &group_addr, sizeof(group_addr));
+
+        if (!source.empty()) {
+            sockaddr_in source_addr = create_sockaddr(AF_INET, source, 0);
+            memcpy(&source_request.gsr_source, &source_addr, sizeof(source_addr));
+        }
+    }
+
+    int result = 0;
+    {
+        std::lock_guard<std::mutex> lg(conf_mutex_);
+
+        if (source.empty()) {
+            result = ::setsockopt(socket_, level, join ? MCAST_JOIN_GROUP : MCAST_LEAVE_GROUP,
+                (const char *)&group_request, sizeof(group_request));
+        } else {
+            result = ::setsockopt(socket_, level, join ? MCAST_JOIN_SOURCE_GROUP : MCAST_LEAVE_SOURCE_GROUP,
+                (const char *)&source_request, sizeof(source_request));
+        }
+    }
+
+    if (result < 0) {
+        log_platform_error(join ? "Multicast join failed" : "Multicast leave failed");
+        return RTP_GENERIC_ERROR;
+    }
+
+    UVG_LOG_DEBUG("%s multicast group %s%s%s", join ? "Joined" : "Left", group.c_str(),
+        source.empty() ? "" : " from ", source.c_str());
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::socket::enable_destination_addresses()
+{
+#ifdef __linux__
+    int enable = 1;
+    int result = ipv6_ ?
+        ::setsockopt(socket_, IPPROTO_IPV6, IPV6_RECVPKTINFO, &enable, sizeof(enable)) :
+        ::setsockopt(socket_, IPPROTO_IP, IP_PKTINFO, &enable, sizeof(enable));
+
+    if (result < 0) {
+        log_platform_error("setsockopt(IP_PKTINFO) failed");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    destinations_ = true;
+    return RTP_OK;
+#else
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+bool uvgrtp::socket::destination_addresses() const
+{
+    return destinations_.load(std::memory_order_relaxed);
+}
+
+const in6_addr& uvgrtp::socket::recv_destination(int i) const
+{
+    return recv_destinations_[i];
+}
+
+in6_addr uvgrtp::socket::mapped_address(const sockaddr_in& address)
+{
+    in6_addr mapped = {};
+    uint8_t *bytes = (uint8_t *)&mapped;
+
+    bytes[10] = 0xff;
+    bytes[11] = 0xff;
+    memcpy(&bytes[12], &address.sin_addr, 4);
+
+    return mapped;
+}
+
+bool uvgrtp::socket::is_multicast(const in6_addr& address)
+{
+    const uint8_t *bytes = (const uint8_t *)&address;
+    static const uint8_t V4_MAPPED_PREFIX[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+
+    if (memcmp(bytes, V4_MAPPED_PREFIX, sizeof(V4_MAPPED_PREFIX)) == 0)
+        return (bytes[12] & 0xf0) == 0xe0;
+
+    return bytes[0] == 0xff;
+}
+
+rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int recv_flags, sockaddr_in *sender,
+    sockaddr_in6 *sender6, int *bytes_read)
+{
+    if (ipv6_) {
+        return __recvfrom_ip6(buf, buf_len, recv_flags, sender6, bytes_read);
+    }
+    return __recvfrom(buf, buf_len, recv_flags, sender, bytes_read);
+}
+
+rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int recv_flags, int *bytes_read)
+{
+    if (ipv6_) {
+        return __recvfrom_ip6(buf, buf_len, recv_flags, nullptr, bytes_read);
+    }
+    return __recvfrom(buf, buf_len, recv_flags, nullptr, bytes_read);
+}
+
+rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int recv_flags, sockaddr_in *sender)
+{
+    return __recvfrom(buf, buf_len, recv_flags, sender, nullptr);
+}
+
+rtp_error_t uvgrtp::socket::recvfrom(uint8_t *buf, size_t buf_len, int recv_flags)
+{
+    return __recvfrom(buf, buf_len, recv_flags, nullptr, nullptr);
+}
+
+rtp_error_t uvgrtp::socket::recvmmsg(uint8_t **buffers, size_t buf_len, int *bytes_read, int count,
+    int recv_flags, int *packets_read)
+{
+    if (!buffers || !bytes_read || !buf_len || count <= 0) {
+        set_bytes(packets_read, -1);
+        return RTP_INVALID_VALUE;
+    }
+
+    if (count > MAX_RECV_BATCH_SIZE)
+        count = MAX_RECV_BATCH_SIZE;
+
+#ifndef _WIN32
+    for (int i = 0; i < count; ++i) {
+        recv_chunks_[i].iov_base                = buffers[i];
+        recv_chunks_[i].iov_len                 = buf_len;
+        recv_headers_[i].msg_hdr.msg_name       = nullptr;
+        recv_headers_[i].msg_hdr.msg_namelen    = 0;
+        recv_headers_[i].msg_hdr.msg_iov        = &recv_chunks_[i];
+        recv_headers_[i].msg_hdr.msg_iovlen     = 1;
+        recv_headers_[i].msg_hdr.msg_control    = nullptr;
+        recv_headers_[i].msg_hdr.msg_controllen = 0;
+        recv_headers_[i].msg_hdr.msg_flags      = 0;
+        recv_headers_[i].msg_len                = 0;
+
+        if (receive_control()) {
+            recv_headers_[i].msg_hdr.msg_control    = recv_control_[i];
+            recv_headers_[i].msg_hdr.msg_controllen = RECV_CONTROL_SIZE;
+        }
+
+        if (capturing_.load(std::memory_order_relaxed)) {
+            recv_headers_[i].msg_hdr.msg_name    = &recv_names_[i];
+            recv_headers_[i].msg_hdr.msg_namelen = sizeof(recv_names_[i]);
+        }
+    }
+
+    // a batch of the memory transport is returned alone, the socket is read once its queue is empty
+    if (memory_) {
+        int received = 0;
+        uint64_t now = uvgrtp::clock::system_ns();
+
+        for (; received < count; ++received) {
+            socklen_t name_len = sizeof(recv_names_[received]);
+            int length = memory_->receive(buffers[received], buf_len, (struct sockaddr *)&recv_names_[received], &name_len);
+
+            if (length < 0)
+                break;
+
+            bytes_read[received]  = length;
+            recv_times_[received] = now;
+
+            if (capturing_.load(std::memory_order_relaxed))
+                capture_received(buffers[received], (size_t)length, (const struct sockaddr *)&recv_names_[received], now);
+        }
+
+        if (received > 0) {
+#ifndef NDEBUG
+            received_packets_ += received;
+#endif // !NDEBUG
+
+            set_bytes(packets_read, received);
+            return RTP_OK;
+        }
+    }
+
+#ifdef UVGRTP_HAVE_IO_URING
+    if (uring_ready(recv_uring_)) {
+        int received = 0;
+        rtp_error_t ret = recv_uring_->recvmsg(socket_, recv_headers_, (unsigned int)count, recv_flags, &received);
+
+        uint64_t now = uvgrtp::clock::system_ns();
+        for (int i = 0; i < received; ++i) {
+            bytes_read[i] = (int)recv_headers_[i].msg_len;
+
+            uint64_t timestamp = read_control(&recv_headers_[i].msg_hdr, i);
+            recv_times_[i] = timestamp ? timestamp : now;
+
+            if (capturing_.load(std::memory_order_relaxed))
+                capture_received(buffers[i], (size_t)bytes_read[i], (const struct sockaddr *)recv_headers_[i].msg_hdr.msg_name,
+                    recv_times_[i]);
+        }
+
+#ifndef NDEBUG
+        if (received > 0)
+            received_packets_ += received;
+#endif // !NDEBUG
+
+        set_bytes(packets_read, received);
+        return ret;
+    }
+#endif
+
+#ifdef UVGRTP_HAVE_RECVMMSG
+    int ret = ::recvmmsg(socket_, recv_headers_, (unsigned int)count, recv_flags, nullptr);
+#else
+    int ret = uvgrtp::recvmmsg(socket_, recv_headers_, (unsigned int)count, recv_flags, nullptr);
+#endif
+
+    if (ret == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            set_bytes(packets_read, 0);
+            return RTP_INTERRUPTED;
+        }
+        UVG_LOG_ERROR("recvmmsg(2) failed: %s", strerror(errno));
+
+        set_bytes(packets_read, -1);
+        return RTP_GENERIC_ERROR;
+    }
+
+    uint64_t now = uvgrtp::clock::system_ns();
+    for (int i = 0; i < ret; ++i) {
+        bytes_read[i] = (int)recv_headers_[i].msg_len;
+
+        uint64_t timestamp = read_control(&recv_headers_[i].msg_hdr, i);
+        recv_times_[i] = timestamp ? timestamp : now;
+
+        if (capturing_.load(std::memory_order_relaxed))
+            capture_received(buffers[i], (size_t)bytes_read[i], (const struct sockaddr *)recv_headers_[i].msg_hdr.msg_name,
+                recv_times_[i]);
+    }
+
+#ifndef NDEBUG
+    received_packets_ += ret;
+#endif // !NDEBUG
+
+    set_bytes(packets_read, ret);
+#else
+    int received = 0;
+
+    if (rio_ && rio_->receiving()) {
+        SOCKADDR_INET senders[MAX_RECV_BATCH_SIZE];
+        bool capturing = capturing_.load(std::memory_order_relaxed);
+
+        rtp_error_t ret = rio_->receive(buffers, buf_len, bytes_read, capturing ? senders : nullptr, count, &received);
+
+        uint64_t now = uvgrtp::clock::system_ns();
+        for (int i = 0; i < received; ++i) {
+            recv_times_[i] = now;
+
+            if (capturing)
+                capture_received(buffers[i], (size_t)bytes_read[i], (const struct sockaddr *)&senders[i], now);
+        }
+
+#ifndef NDEBUG
+        received_packets_ += received;
+#endif // !NDEBUG
+
+        set_bytes(packets_read, ret == RTP_GENERIC_ERROR ? -1 : received);
+        return ret;
+    }
+
+    for (; received < count; ++received) {
+
+        /* Do not block waiting for the rest of the batch if the socket has been emptied */
+        if (received > 0) {
+            u_long available = 0;
+            if (ioctlsocket(socket_, FIONREAD, &available) == SOCKET_ERROR || available == 0)
+                break;
+        }
+
+        rtp_error_t ret = recvfrom(buffers[received], buf_len, recv_flags, &bytes_read[received]);
+
+        if (ret == RTP_INTERRUPTED)
+            break;
+
+        if (ret == RTP_OK)
+            recv_times_[received] = recv_times_[0];
+
+        if (ret != RTP_OK) {
+            if (received > 0)
+                break;
+
+            set_bytes(packets_read, -1);
+            return ret;
+        }
+    }
+
+    if (received == 0) {
+        set_bytes(packets_read, 0);
+        return RTP_INTERRUPTED;
+    }
+
+    set_bytes(packets_read, received);
+#endif
+
+    return RTP_OK;
+}
+
+bool uvgrtp::socket::uring_ready(std::unique_ptr<uvgrtp::uring>& ring)
+{
+    if (!ring) {
+        ring = std::unique_ptr<uvgrtp::uring>(new uvgrtp::uring());
+
+        /* If the ring cannot be created, the empty ring is kept so that
+         * creating it is not attempted again for every batch */
+        if (ring->init(MAX_RECV_BATCH_SIZE) != RTP_OK) {
+            UVG_LOG_WARN("io_uring is not available, using sendmmsg(2) and recvmmsg(2)");
+        }
+    }
+
+    return ring->get_entries() > 0;
+}
+
+rtp_error_t uvgrtp::socket::enable_gro()
+{
+#if defined(__linux__) && defined(UDP_GRO)
+    int enable = 1;
+    if (::setsockopt(socket_, IPPROTO_UDP, UDP_GRO, &enable, sizeof(enable)) < 0) {
+        log_platform_error("setsockopt(UDP_GRO) failed");
+        return RTP_NOT_SUPPORTED;
+    }
+    return RTP_OK;
+#elif defined(_WIN32) && defined(UDP_RECV_MAX_COALESCED_SIZE) && defined(UDP_COALESCED_INFO)
+    // the datagrams of the Registered I/O go to slots that are smaller than a coalesced datagram
+    if (rio_)
+        return RTP_NOT_SUPPORTED;
+
+    GUID id     = WSAID_WSARECVMSG;
+    DWORD bytes = 0;
+
+    if (WSAIoctl(socket_, SIO_GET_EXTENSION_FUNCTION_POINTER, &id, sizeof(id), &wsa_recvmsg_,
+            sizeof(wsa_recvmsg_), &bytes, nullptr, nullptr) == SOCKET_ERROR) {
+        log_platform_error("WSAIoctl(WSAID_WSARECVMSG) failed");
+        wsa_recvmsg_ = nullptr;
+        return RTP_NOT_SUPPORTED;
+    }
+
+    // as much as the reception flow gives to recv_gro() at a time
+    DWORD max_size = UINT16_MAX;
+    if (::setsockopt(socket_, IPPROTO_UDP, UDP_RECV_MAX_COALESCED_SIZE, (const char *)&max_size, sizeof(max_size)) == SOCKET_ERROR) {
+        log_platform_error("setsockopt(UDP_RECV_MAX_COALESCED_SIZE) failed");
+        wsa_recvmsg_ = nullptr;
+        return RTP_NOT_SUPPORTED;
+    }
+    return RTP_OK;
+#else
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+rtp_error_t uvgrtp::socket::enable_txtime()
+{
+#if defined(__linux__) && defined(SO_TXTIME)
+    struct sock_txtime config = {};
+    config.clockid = CLOCK_MONOTONIC;
+    config.flags   = 0;
+
+    if (::setsockopt(socket_, SOL_SOCKET, SO_TXTIME, &config, sizeof(config)) < 0) {
+        log_platform_error("setsockopt(SO_TXTIME) failed");
+        return RTP_NOT_SUPPORTED;
+    }
+    txtime_enabled_ = true;
+    return RTP_OK;
+#else
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+bool uvgrtp::socket::txtime_enabled() const
+{
+    return txtime_enabled_;
+}
+
+rtp_error_t uvgrtp::socket::set_busy_poll(int usec, bool prefer)
+{
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+    if (::setsockopt(socket_, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0) {
+        log_platform_error("setsockopt(SO_BUSY_POLL) failed");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    if (prefer) {
+#ifdef SO_PREFER_BUSY_POLL
+        int enable = 1;
+
+        if (::setsockopt(socket_, SOL_SOCKET, SO_PREFER_BUSY_POLL, &enable, sizeof(enable)) < 0) {
+            log_platform_error("setsockopt(SO_PREFER_BUSY_POLL) failed");
+            return RTP_NOT_SUPPORTED;
+        }
+#else
+        return RTP_NOT_SUPPORTED;
+#endif
+    }
+    return RTP_OK;
+#else
+    (void)usec;
+    (void)prefer;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+rtp_error_t uvgrtp::socket::set_traffic_class(int dscp, int priority)
+{
+#ifdef _WIN32
+    // Windows marks the datagrams through the QoS API only
+    (void)dscp;
+    (void)priority;
+    return RTP_NOT_SUPPORTED;
+#else
+    if (dscp >= 0) {
+        // the two lowest bits of the field are left to ECN
+        int tos = dscp << 2;
+        int ret = ipv6_ ? ::setsockopt(socket_, IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof(tos))
+                        : ::setsockopt(socket_, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+        if (ret < 0) {
+            log_platform_error("setsockopt() for the DSCP failed");
+            return RTP_NOT_SUPPORTED;
+        }
+    }
+
+    if (priority >= 0) {
+#if defined(__linux__) && defined(SO_PRIORITY)
+        if (::setsockopt(socket_, SOL_SOCKET, SO_PRIORITY, &priority, sizeof(priority)) < 0) {
+            log_platform_error("setsockopt(SO_PRIORITY) failed");
+            return RTP_NOT_SUPPORTED;
+        }
+#else
+        return RTP_NOT_SUPPORTED;
+#endif
+    }
+    return RTP_OK;
+#endif
+}
+
+rtp_error_t uvgrtp::socket::set_receive_buffer_autotuning(size_t max_bytes)
+{
+    // the drops are counted from the control messages of the received datagrams
+    if (max_bytes && !count_drops_ && enable_drop_counting() != RTP_OK)
+        return RTP_NOT_SUPPORTED;
+
+    rcvbuf_max_ = max_bytes;
+    return RTP_OK;
+}
+
+void uvgrtp::socket::tune_receive_buffer(size_t packets, size_t slot_size)
+{
+    size_t max_bytes = rcvbuf_max_.load(std::memory_order_relaxed);
+    if (!max_bytes)
+        return;
+
+    tune_packets_ += packets;
+
+    auto now = uvgrtp::clock::coarse::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - tune_start_).count();
+
+    if (elapsed < RECEIVE_BUFFER_TUNING_INTERVAL_MS)
+        return;
+
+    // the first interval only starts the counting
+    bool first = tune_start_ == std::chrono::steady_clock::time_point();
+    uint32_t drops = kernel_drops_.load(std::memory_order_relaxed);
+    bool dropped = drops != tune_drops_;
+    uint64_t traffic = (uint64_t)tune_packets_ * slot_size * RECEIVE_BUFFER_WINDOW_MS / elapsed;
+
+    tune_start_   = now;
+    tune_drops_   = drops;
+    tune_packets_ = 0;
+
+    if (first)
+        return;
+
+#ifdef __linux__
+    int current = 0;
+    socklen_t len = sizeof(current);
+
+    // Linux reports the doubled size it reserves for its bookkeeping
+    if (::getsockopt(socket_, SOL_SOCKET, SO_RCVBUF, &current, &len) < 0)
+        return;
+    current /= 2;
+
+    size_t wanted = std::max((size_t)current, (size_t)traffic);
+    if (dropped)
+        wanted = std::max(wanted, (size_t)current * 2);
+
+    wanted = std::min(wanted, std::min(max_bytes, (size_t)INT_MAX / 2));
+    if (wanted <= (size_t)current)
+        return;
+
+    // SO_RCVBUFFORCE goes past net.core.rmem_max with CAP_NET_ADMIN, SO_RCVBUF is capped by it
+    int size = (int)wanted;
+    if (::setsockopt(socket_, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0 &&
+        ::setsockopt(socket_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0) {
+        log_platform_error("setsockopt(SO_RCVBUF) failed");
+        return;
+    }
+
+    UVG_LOG_DEBUG("Receive buffer grown from %d to %d bytes, %s", current, size,
+        dropped ? "the kernel dropped datagrams" : "the traffic has grown");
+#else
+    (void)dropped;
+    (void)traffic;
+#endif
+}
+
+rtp_error_t uvgrtp::socket::set_dont_fragment(bool enable)
+{
+#if defined(__linux__) && defined(IP_MTU_DISCOVER) && defined(IPV6_DONTFRAG)
+    int ret;
+
+    if (ipv6_) {
+        int value = enable ? IPV6_PMTUDISC_DO : IPV6_PMTUDISC_WANT;
+        int dontfrag = enable ? 1 : 0;
+
+        ret = ::setsockopt(socket_, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &value, sizeof(value));
+        if (ret == 0)
+            ret = ::setsockopt(socket_, IPPROTO_IPV6, IPV6_DONTFRAG, &dontfrag, sizeof(dontfrag));
+    } else {
+        int value = enable ? IP_PMTUDISC_DO : IP_PMTUDISC_WANT;
+        ret = ::setsockopt(socket_, IPPROTO_IP, IP_MTU_DISCOVER, &value, sizeof(value));
+    }
+
+    if (ret < 0) {
+        log_platform_error("setsockopt() for the Don't Fragment bit failed");
+        return RTP_NOT_SUPPORTED;
+    }
+    return RTP_OK;
+#else
+    (void)enable;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+rtp_error_t uvgrtp::socket::set_max_pacing_rate(uint64_t bytes_per_second)
+{
+#if defined(__linux__) && defined(SO_MAX_PACING_RATE)
+    if (::setsockopt(socket_, SOL_SOCKET, SO_MAX_PACING_RATE, &bytes_per_second, sizeof(bytes_per_second)) < 0) {
+
+        // kernels older than 4.13 only take a 32-bit rate
+        uint32_t rate = (uint32_t)std::min(bytes_per_second, (uint64_t)UINT32_MAX);
+        if (::setsockopt(socket_, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate)) < 0) {
+            log_platform_error("setsockopt(SO_MAX_PACING_RATE) failed");
+            return RTP_NOT_SUPPORTED;
+        }
+    }
+    return RTP_OK;
+#else
+    (void)bytes_per_second;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+rtp_error_t uvgrtp::socket::enable_timestamping(int flags)
+{
+    if (flags & ~RTP_TIMESTAMP_ALL)
+        return RTP_INVALID_VALUE;
+
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+    unsigned int options = 0;
+
+    if (flags & RTP_TIMESTAMP_RECEIVE) {
+        options |= SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+
+        if (flags & RTP_TIMESTAMP_HARDWARE)
+            options |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    }
+
+    // the send timestamps only carry the key of the datagram, not the datagram itself
+    if (flags & RTP_TIMESTAMP_SEND) {
+        options |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+            SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+
+        if (flags & RTP_TIMESTAMP_HARDWARE)
+            options |= SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    }
+
+    std::lock_guard<std::mutex> lg(tx_mutex_);
+
+    if ((flags & RTP_TIMESTAMP_SEND) && !tx_times_) {
+        tx_times_ = std::unique_ptr<std::atomic<uint64_t>[]>(new std::atomic<uint64_t>[TX_TIMESTAMP_SLOTS]);
+
+        for (size_t i = 0; i < TX_TIMESTAMP_SLOTS; ++i) {
+            tx_times_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    if (::setsockopt(socket_, SOL_SOCKET, SO_TIMESTAMPING, &options, sizeof(options)) < 0) {
+        log_platform_error("setsockopt(SO_TIMESTAMPING) failed");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    // setting SOF_TIMESTAMPING_OPT_ID starts the keys of the datagrams from zero
+    tx_key_       = 0;
+    timestamping_ = flags;
+    return RTP_OK;
+#else
+    return flags ? RTP_NOT_SUPPORTED : RTP_OK;
+#endif
+}
+
+int uvgrtp::socket::timestamping() const
+{
+    return timestamping_;
+}
+
+void uvgrtp::socket::save_tx_times(size_t messages, const uint64_t *launch_times)
+{
+    if (!(timestamping_ & RTP_TIMESTAMP_SEND) || !tx_times_)
+        return;
+
+    uint32_t key = tx_key_.fetch_add((uint32_t)messages, std::memory_order_relaxed);
+    uint64_t now = uvgrtp::clock::system_ns();
+    int64_t offset = 0;
+
+#if defined(__linux__)
+    // the launch times are in CLOCK_MONOTONIC, see sendto_txtime()
+    if (launch_times) {
+        struct timespec monotonic;
+        clock_gettime(CLOCK_MONOTONIC, &monotonic);
+        offset = (int64_t)now - ((int64_t)monotonic.tv_sec * 1000000000 + (int64_t)monotonic.tv_nsec);
+    }
+#endif
+
+    for (size_t i = 0; i < messages; ++i) {
+        uint64_t time = launch_times ? (uint64_t)((int64_t)launch_times[i] + offset) : now;
+        tx_times_[(key + i) % TX_TIMESTAMP_SLOTS].store(time, std::memory_order_relaxed);
+    }
+}
+
+void uvgrtp::socket::forget_tx_times(size_t messages)
+{
+    if ((timestamping_ & RTP_TIMESTAMP_SEND) && tx_times_)
+        tx_key_.fetch_sub((uint32_t)messages, std::memory_order_relaxed);
+}
+
+size_t uvgrtp::socket::read_tx_timestamps()
+{
+    size_t timestamps = 0;
+
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+    if (!(timestamping_ & RTP_TIMESTAMP_SEND))
+        return 0;
+
+    // another thread is already emptying the queue
+    std::unique_lock<std::mutex> lk(tx_mutex_, std::try_to_lock);
+    if (!lk.owns_lock() || !tx_times_)
+        return 0;
+
+    while (true) {
+        alignas(struct cmsghdr) uint8_t control[RECV_CONTROL_SIZE];
+        uint8_t data[64];
+        struct iovec chunk = { data, sizeof(data) };
+
+        struct msghdr msg  = {};
+        msg.msg_iov        = &chunk;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (::recvmsg(socket_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            break;
+
+        uint64_t sent = 0;
+        bool has_key  = false;
+        uint32_t key  = 0;
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING) {
+                struct scm_timestamping ts;
+                memcpy(&ts, CMSG_DATA(cm), sizeof(ts));
+
+                const struct timespec *t = &ts.ts[0];
+                if ((timestamping_ & RTP_TIMESTAMP_HARDWARE) && (ts.ts[2].tv_sec || ts.ts[2].tv_nsec))
+                    t = &ts.ts[2];
+
+                sent = (uint64_t)t->tv_sec * 1000000000 + (uint64_t)t->tv_nsec;
+            }
+            else if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                     (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+                struct sock_extended_err err;
+                memcpy(&err, CMSG_DATA(cm), sizeof(err));
+
+                if (err.ee_errno == ENOMSG && err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+                    key     = err.ee_data;
+                    has_key = true;
+                }
+            }
+        }
+
+        if (sent && has_key) {
+            uint64_t intended = tx_times_[key % TX_TIMESTAMP_SLOTS].load(std::memory_order_relaxed);
+
+            if (metrics_ && intended)
+                metrics_->record(uvgrtp::stream_metrics::SEND_DELAY_US, sent > intended ? (sent - intended) / 1000 : 0);
+        }
+        ++timestamps;
+    }
+#endif
+
+    return timestamps;
+}
+
+void uvgrtp::socket::set_metrics(std::shared_ptr<uvgrtp::stream_metrics> metrics)
+{
+    std::lock_guard<std::mutex> lg(tx_mutex_);
+    metrics_ = metrics;
+}
+
+rtp_error_t uvgrtp::socket::start_capture(const std::string& path, int directions)
+{
+    std::shared_ptr<uvgrtp::capture> started = std::make_shared<uvgrtp::capture>();
+
+    rtp_error_t ret = started->start(path, directions);
+    if (ret != RTP_OK)
+        return ret;
+
+    (void)stop_capture();
+
+    std::atomic_store(&capture_, started);
+    capturing_ = true;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::socket::stop_capture()
+{
+    capturing_ = false;
+
+    std::shared_ptr<uvgrtp::capture> stopped = std::atomic_exchange(&capture_, std::shared_ptr<uvgrtp::capture>());
+    if (!stopped)
+        return RTP_NOT_INITIALIZED;
+
+    // a thread that loaded the capture before it was removed may still record into it, which stop() ignores
+    stopped->stop();
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::socket::enable_memory_transport(const uvgrtp::impairment *impairment, uint64_t seed, bool shared)
+{
+    std::shared_ptr<uvgrtp::memory_transport> transport = std::make_shared<uvgrtp::memory_transport>();
+
+    rtp_error_t ret = transport->init();
+    if (ret != RTP_OK)
+        return ret;
+
+    if (impairment)
+        transport->impair(*impairment, seed);
+
+    if (shared)
+        transport->share();
+
+    memory_ = transport;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::socket::enable_xdp(std::shared_ptr<uvgrtp::xdp_device> device)
+{
+    rtp_error_t ret = enable_memory_transport();
+    if (ret != RTP_OK)
+        return ret;
+
+    xdp_ = device;
+    return RTP_OK;
+}
+
+int uvgrtp::socket::memory_wake_fd() const
+{
+    return memory_ ? memory_->wake_fd() : -1;
+}
+
+rtp_error_t uvgrtp::socket::wait_registered_io(int timeout_ms)
+{
+#ifdef _WIN32
+    if (!rio_)
+        return RTP_NOT_SUPPORTED;
+
+    rtp_error_t ret = RTP_OK;
+    if (!rio_->receiving() && (ret = rio_->start_receiving()) != RTP_OK)
+        return ret;
+
+    return rio_->wait(timeout_ms);
+#else
+    (void)timeout_ms;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+bool uvgrtp::socket::send_registered(sockaddr_in& addr, sockaddr_in6& addr6, bool ipv6, const buf_vec *packets,
+    size_t count, int *bytes_sent, rtp_error_t& ret)
+{
+#ifdef _WIN32
+    if (!rio_)
+        return false;
+
+    if (ipv6)
+        ret = rio_->send((const struct sockaddr *)&addr6, sizeof(addr6), packets, count, bytes_sent);
+    else
+        ret = rio_->send((const struct sockaddr *)&addr, sizeof(addr), packets, count, bytes_sent);
+
+    if (ret == RTP_INVALID_VALUE)
+        return false;
+
+    if (ret != RTP_OK) {
+        if (ipv6_) {
+            UVG_LOG_ERROR("Failed to send to %s", sockaddr_ip6_to_string(addr6).c_str());
+        }
+        else {
+            UVG_LOG_ERROR("Failed to send to %s", sockaddr_to_string(addr).c_str());
+        }
+    }
+    return true;
+#else
+    (void)addr, (void)addr6, (void)ipv6, (void)packets, (void)count, (void)bytes_sent, (void)ret;
+    return false;
+#endif
+}
+
+bool uvgrtp::socket::recv_registered(uint8_t *buf, size_t buf_len, sockaddr *sender, socklen_t *sender_len,
+    int *bytes_read, rtp_error_t& ret)
+{
+#ifdef _WIN32
+    if (!rio_ || !rio_->receiving())
+        return false;
+
+    SOCKADDR_INET source;
+    int length = 0;
+    int received = 0;
+
+    if ((ret = rio_->receive(&buf, buf_len, &length, &source, 1, &received)) != RTP_OK) {
+        set_bytes(bytes_read, ret == RTP_INTERRUPTED ? 0 : -1);
+        return true;
+    }
+
+    size_t source_len = source.si_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+    if (sender && sender_len && *sender_len >= source_len) {
+        memcpy(sender, &source, source_len);
+        *sender_len = (socklen_t)source_len;
+    }
+
+    set_bytes(bytes_read, length);
+    recv_times_[0] = uvgrtp::clock::system_ns();
+
+    if (capturing_.load(std::memory_order_relaxed))
+        capture_received(buf, (size_t)length, (const struct sockaddr *)&source, recv_times_[0]);
+
+#ifndef NDEBUG
+    ++received_packets_;
+#endif // !NDEBUG
+
+    return true;
+#else
+    (void)buf, (void)buf_len, (void)sender, (void)sender_len, (void)bytes_read, (void)ret;
+    return false;
+#endif
+}
+
+std::shared_ptr<uvgrtp::memory_transport> uvgrtp::socket::memory_peer(const sockaddr_in& addr, const sockaddr_in6& addr6) const
+{
+    // a multicast group may have receivers outside the process, so its datagrams go through the kernel
+    std::shared_ptr<uvgrtp::memory_transport> peer = nullptr;
+
+    if (ipv6_) {
+        if (addr6.sin6_addr.s6_addr[0] == 0xFF)
+            return nullptr;
+        if (!(peer = uvgrtp::memory_transport::find(addr6)) && memory_->shared())
+            peer = uvgrtp::memory_transport::find_shared(addr6);
+        return peer;
+    }
+
+    if ((ntohl(addr.sin_addr.s_addr) & 0xF0000000) == 0xE0000000)
+        return nullptr;
+    if (!(peer = uvgrtp::memory_transport::find(addr)) && memory_->shared())
+        peer = uvgrtp::memory_transport::find_shared(addr);
+    return peer;
+}
+
+bool uvgrtp::socket::send_in_memory(uvgrtp::memory_transport& peer, const sockaddr_in& addr, const sockaddr_in6& addr6,
+    const buf_vec& buffers)
+{
+    /* The receiver sees the datagram coming from the address of this socket, or from the address it was
+     * sent to if this socket is bound to any address, as the kernel would show a datagram sent within the host */
+    if (ipv6_) {
+        sockaddr_in6 sender = local_ip6_address_;
+        sender.sin6_family  = AF_INET6;
+
+        if (memcmp(&sender.sin6_addr, &in6addr_any, sizeof(sender.sin6_addr)) == 0)
+            sender.sin6_addr = addr6.sin6_addr;
+
+        return peer.deliver((const struct sockaddr *)&sender, sizeof(sender), buffers);
+    }
+
+    sockaddr_in sender = local_address_;
+    sender.sin_family  = AF_INET;
+
+    if (sender.sin_addr.s_addr == htonl(INADDR_ANY))
+        sender.sin_addr = addr.sin_addr;
+
+    return peer.deliver((const struct sockaddr *)&sender, sizeof(sender), buffers);
+}
+
+bool uvgrtp::socket::send_xdp(const sockaddr_in& addr, const buf_vec& buffers)
+{
+    if (!xdp_port_ || ipv6_ || (ntohl(addr.sin_addr.s_addr) & 0xF0000000) == 0xE0000000)
+        return false;
+
+    return xdp_->send(xdp_port_, addr, buffers);
+}
+
+uvgrtp::capture_endpoint uvgrtp::socket::local_endpoint() const
+{
+    if (ipv6_)
+        return uvgrtp::capture_endpoint::from(local_ip6_address_);
+
+    return uvgrtp::capture_endpoint::from(local_address_);
+}
+
+void uvgrtp::socket::capture_sent(sockaddr_in& addr, sockaddr_in6& addr6, const uint8_t *buf, size_t buf_len)
+{
+    std::shared_ptr<uvgrtp::capture> capture = std::atomic_load(&capture_);
+    if (!capture)
+        return;
+
+    uvgrtp::capture_endpoint remote = ipv6_ ? uvgrtp::capture_endpoint::from(addr6) : uvgrtp::capture_endpoint::from(addr);
+    capture->record(RTP_CAPTURE_SEND, uvgrtp::clock::system_ns(), local_endpoint(), remote, buf, buf_len);
+}
+
+void uvgrtp::socket::capture_sent(sockaddr_in& addr, sockaddr_in6& addr6, const buf_vec& buffers)
+{
+    std::shared_ptr<uvgrtp::capture> capture = std::atomic_load(&capture_);
+    if (!capture)
+        return;
+
+    uvgrtp::capture_endpoint remote = ipv6_ ? uvgrtp::capture_endpoint::from(addr6) : uvgrtp::capture_endpoint::from(addr);
+    capture->record(RTP_CAPTURE_SEND, uvgrtp::clock::system_ns(), local_endpoint(), remote, buffers);
+}
+
+void uvgrtp::socket::capture_sent(sockaddr_in& addr, sockaddr_in6& addr6, const pkt_vec& buffers)
+{
+    std::shared_ptr<uvgrtp::capture> capture = std::atomic_load(&capture_);
+    if (!capture)
+        return;
+
+    uvgrtp::capture_endpoint local  = local_endpoint();
+    uvgrtp::capture_endpoint remote = ipv6_ ? uvgrtp::capture_endpoint::from(addr6) : uvgrtp::capture_endpoint::from(addr);
+    uint64_t now = uvgrtp::clock::system_ns();
+
+    for (auto& buffer : buffers) {
+        capture->record(RTP_CAPTURE_SEND, now, local, remote, buffer);
+    }
+}
+
+void uvgrtp::socket::capture_received(const uint8_t *buf, size_t length, const struct sockaddr *sender, uint64_t time_ns)
+{
+    std::shared_ptr<uvgrtp::capture> capture = std::atomic_load(&capture_);
+    if (!capture)
+        return;
+
+    uvgrtp::capture_endpoint remote;
+    remote.ipv6 = ipv6_;
+
+    if (sender && sender->sa_family == AF_INET6)
+        remote = uvgrtp::capture_endpoint::from(*(const sockaddr_in6 *)sender);
+    else if (sender && sender->sa_family == AF_INET)
+        remote = uvgrtp::capture_endpoint::from(*(const sockaddr_in *)sender);
+
+    capture->record(RTP_CAPTURE_RECEIVE, time_ns, remote, local_endpoint(), buf, length);
+}
+
+rtp_error_t uvgrtp::socket::recv_gro(uint8_t *buf, size_t buf_len, int recv_flags, int *bytes_read, int *segment_size)
+{
+    set_bytes(segment_size, 0);
+
+#if defined(__linux__) && defined(UDP_GRO)
+    if (!buf || !buf_len) {
+        set_bytes(bytes_read, -1);
+        return RTP_INVALID_VALUE;
+    }
+
+    // a datagram of the memory transport is never coalesced
+    if (memory_) {
+        socklen_t name_len = sizeof(recv_names_[0]);
+        int length = memory_->receive(buf, buf_len, (struct sockaddr *)&recv_names_[0], &name_len);
+
+        if (length >= 0) {
+            recv_times_[0] = uvgrtp::clock::system_ns();
+            set_bytes(bytes_read, length);
+
+            if (capturing_.load(std::memory_order_relaxed))
+                capture_received(buf, (size_t)length, (const struct sockaddr *)&recv_names_[0], recv_times_[0]);
+
+#ifndef NDEBUG
+            ++received_packets_;
+#endif // !NDEBUG
+
+            return RTP_OK;
+        }
+    }
+
+    struct iovec chunk = { buf, buf_len };
+
+    struct msghdr msg  = {};
+    msg.msg_iov        = &chunk;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = recv_control_[0];
+    msg.msg_controllen = RECV_CONTROL_SIZE;
+
+    if (capturing_.load(std::memory_order_relaxed)) {
+        msg.msg_name    = &recv_names_[0];
+        msg.msg_namelen = sizeof(recv_names_[0]);
+    }
+
+    ssize_t ret = ::recvmsg(socket_, &msg, recv_flags);
+
+    if (ret == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            set_bytes(bytes_read, 0);
+            return RTP_INTERRUPTED;
+        }
+        UVG_LOG_ERROR("recvmsg(2) failed: %s", strerror(errno));
+
+        set_bytes(bytes_read, -1);
+        return RTP_GENERIC_ERROR;
+    }
+
+    if (msg.msg_flags & MSG_TRUNC) {
+        UVG_LOG_WARN("Coalesced UDP datagram was truncated, the receive buffer is too small");
+    }
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level == IPPROTO_UDP && cm->cmsg_type == UDP_GRO) {
+            int gso_size = 0;
+            memcpy(&gso_size, CMSG_DATA(cm), sizeof(int));
+            set_bytes(segment_size, gso_size);
+        }
+    }
+
+    // the coalesced datagrams share the timestamp of the first one
+    uint64_t timestamp = read_control(&msg, 0);
+    recv_times_[0] = timestamp ? timestamp : uvgrtp::clock::system_ns();
+
+    set_bytes(bytes_read, (int)ret);
+
+    // the capture has the datagrams as they were sent, not the coalesced buffer
+    if (capturing_.load(std::memory_order_relaxed)) {
+        size_t segment = (segment_size && *segment_size > 0) ? (size_t)*segment_size : (size_t)ret;
+
+        for (size_t offset = 0; offset < (size_t)ret; offset += segment) {
+            capture_received(buf + offset, std::min(segment, (size_t)ret - offset),
+                (const struct sockaddr *)msg.msg_name, recv_times_[0]);
+        }
+    }
+
+#ifndef NDEBUG
+    ++received_packets_;
+#endif // !NDEBUG
+
+    return RTP_OK;
+#elif defined(_WIN32) && defined(UDP_RECV_MAX_COALESCED_SIZE) && defined(UDP_COALESCED_INFO)
+    if (!wsa_recvmsg_)
+        return recvfrom(buf, buf_len, recv_flags, bytes_read);
+
+    if (!buf || !buf_len) {
+        set_bytes(bytes_read, -1);
+        return RTP_INVALID_VALUE;
+    }
+
+    WSABUF chunk;
+    chunk.len = (ULONG)buf_len;
+    chunk.buf = (CHAR *)buf;
+
+    char control[WSA_CMSG_SPACE(sizeof(DWORD))] = {};
+    sockaddr_in6 sender = {};
+
+    WSAMSG msg        = {};
+    msg.name          = (LPSOCKADDR)&sender;
+    msg.namelen       = sizeof(sender);
+    msg.lpBuffers     = &chunk;
+    msg.dwBufferCount = 1;
+    msg.Control.buf   = control;
+    msg.Control.len   = sizeof(control);
+
+    DWORD received = 0;
+
+    if (wsa_recvmsg_(socket_, &msg, &received, nullptr, nullptr) == SOCKET_ERROR) {
+        int error = WSAGetLastError();
+
+        if (error == WSAEWOULDBLOCK) {
+            set_bytes(bytes_read, 0);
+            return RTP_INTERRUPTED;
+        }
+
+        if (error != WSAEMSGSIZE) {
+            log_platform_error("WSARecvMsg() failed");
+            set_bytes(bytes_read, -1);
+            return RTP_GENERIC_ERROR;
+        }
+        UVG_LOG_WARN("Coalesced UDP datagram was truncated, the receive buffer is too small");
+    }
+
+    for (WSACMSGHDR *cm = WSA_CMSG_FIRSTHDR(&msg); cm != nullptr; cm = WSA_CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level == IPPROTO_UDP && cm->cmsg_type == UDP_COALESCED_INFO) {
+            DWORD coalesced_size = 0;
+            memcpy(&coalesced_size, WSA_CMSG_DATA(cm), sizeof(DWORD));
+            set_bytes(segment_size, (int)coalesced_size);
+        }
+    }
+
+    recv_times_[0] = uvgrtp::clock::system_ns();
+    set_bytes(bytes_read, (int)received);
+
+    if (capturing_.load(std::memory_order_relaxed)) {
+        size_t segment = (segment_size && *segment_size > 0) ? (size_t)*segment_size : (size_t)received;
+
+        for (size_t offset = 0; offset < (size_t)received; offset += segment) {
+            capture_received(buf + offset, std::min(segment, (size_t)received - offset),
+                (const struct sockaddr *)&sender, recv_times_[0]);
+        }
+    }
+
+#ifndef NDEBUG
+    ++received_packets_;
+#endif // !NDEBUG
+
+    return RTP_OK;
+#else
+    return recvfrom(buf, buf_len, recv_flags, bytes_read);
+#endif
 }
@@ -17,9 +17,10 @@
 #include <netinet/in.h>
 #endif
 
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <string>
-#include <atomic>
 #include <memory>
 #include <mutex>
 #include <map>
@@ -32,6 +33,15 @@ typedef int socket_t;
 
 namespace uvgrtp {
 
+    class uring;
+    class rio;
+    class stream_metrics;
+    class capture;
+    struct capture_endpoint;
+    class memory_transport;
+    struct impairment;
+    class xdp_device;
+
 #ifdef _WIN32
     typedef unsigned int socklen_t;
 #endif
@@ -58,8 +68,42 @@ namespace uvgrtp {
     }
 #endif
 
+#if !defined(_WIN32) && !defined(UVGRTP_HAVE_RECVMMSG)
+    static inline
+    int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+        int flags, struct timespec *timeout)
+    {
+        (void)timeout;
+        unsigned int i = 0;
+        for (; i < vlen; i++) {
+            ssize_t ret = recvmsg(sockfd, &msgvec[i].msg_hdr, flags);
+            if (ret < 0)
+                break;
+            msgvec[i].msg_len = (unsigned int)ret;
+        }
+        if (i == 0)
+            return -1;
+        return int(i);
+    }
+#endif
+
     const int MAX_BUFFER_COUNT = 256;
 
+    /* Maximum number of datagrams read from the socket with one recvmmsg() call */
+    const int MAX_RECV_BATCH_SIZE = 64;
+
+    /* Room for the control messages of one received datagram: the timestamps of
+     * SO_TIMESTAMPING, the segment size of UDP GRO, the drop count and the destination address */
+    const size_t RECV_CONTROL_SIZE = 192;
+
+    /* How many datagrams sent with RTP_TIMESTAMP_SEND can wait for their timestamp */
+    const size_t TX_TIMESTAMP_SLOTS = 1024;
+
+    /* How often the receive buffer autotuning checks the drops and the traffic of the socket,
+     * and how many milliseconds of the traffic the receive buffer should hold */
+    const int RECEIVE_BUFFER_TUNING_INTERVAL_MS = 1000;
+    const int RECEIVE_BUFFER_WINDOW_MS = 100;
+
     /* Vector of buffers that contain a full RTP frame */
     typedef std::vector<std::pair<size_t, uint8_t *>> buf_vec;
 
@@ -68,9 +112,40 @@ namespace uvgrtp {
 
     typedef rtp_error_t (*packet_handler_vec)(void *, buf_vec&);
 
+    /* Handler that processes all RTP frames of a send operation with one call */
+    typedef rtp_error_t (*packet_handler_pkt)(void *, pkt_vec&);
+
+    /* Arrays that the socket builds the system call messages for a vector of RTP frames
+     * into. The frame queue keeps one with each transaction so that sending a frame
+     * does not have to allocate */
+    struct send_arrays {
+#ifndef _WIN32
+        std::vector<struct mmsghdr> headers;
+        std::vector<struct iovec> chunks;
+
+        /* Launch times of the frames and the SCM_TXTIME control messages they are
+         * sent in, see sendto_txtime(). The launch times are used for one send only */
+        std::vector<uint64_t> txtimes;
+        std::vector<uint8_t> control;
+#else
+        // the buffers of the segments of __sendtov_gso()
+        std::vector<WSABUF> chunks;
+#endif
+    };
+
+    /* A datagram of socket::sendto_each() and the address it is sent to */
+    struct addressed_packet {
+        buf_vec *buffers;
+        sockaddr_in *addr;
+        sockaddr_in6 *addr6;
+    };
+
     struct socket_packet_handler {
         void *arg = nullptr;
         packet_handler_vec handler = nullptr;
+
+        /* If set, used instead of "handler" when a vector of RTP frames is sent */
+        packet_handler_pkt batch_handler = nullptr;
     };
 
     class socket {
@@ -125,6 +200,56 @@ namespace uvgrtp {
             rtp_error_t sendto(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags);
             rtp_error_t sendto(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags, int *bytes_sent);
 
+            /* Same as sendto() for a vector of RTP frames, but the system call messages are built
+             * into "arrays", which keeps its capacity between calls */
+            rtp_error_t sendto(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags, send_arrays& arrays);
+
+            /* Same as sendto() for a vector of RTP frames, but equal-sized frames are given
+             * to the kernel as one buffer using UDP Generic Segmentation Offload (UDP_SEGMENT)
+             *
+             * If GSO is not available on this system, the frames are sent as with sendto()
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR on error */
+            rtp_error_t sendto_gso(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags);
+            rtp_error_t sendto_gso(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags, send_arrays& arrays);
+
+            /* Same as sendto() for a vector of RTP frames, but the packet handlers are not called. For
+             * frames that have already been through the handlers, f.ex. a frame sent to many destinations.
+             * Equal-sized frames are sent with UDP GSO as with sendto_gso() if "gso" is set */
+            rtp_error_t sendto_prepared(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags,
+                send_arrays& arrays, bool gso);
+
+            /* Run the packet handlers (SRTP, RTCP statistics) on the datagram "buffers" without sending it,
+             * for sendto_each()
+             *
+             * Return RTP_OK on success
+             * Return the error of the failed handler otherwise */
+            rtp_error_t run_handlers(buf_vec& buffers);
+
+            /* Call the vector handlers (SRTP, RTCP statistics) for each frame of "buffers" without
+             * sending them, for frames sent with sendto_prepared() from other sockets */
+            rtp_error_t run_vec_handlers(pkt_vec& buffers);
+
+            /* Send each datagram of "packets" to its own address with as few sendmmsg(2) calls as
+             * possible, for the packets of many streams that share this socket. The packet handlers are
+             * not called, see run_handlers(). The system call messages are built into "arrays"
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR on error */
+            rtp_error_t sendto_each(std::vector<addressed_packet>& packets, send_arrays& arrays);
+
+            /* Same as sendto() for a vector of RTP frames, but each frame gets a launch time
+             * with SCM_TXTIME so that the qdisc sends them "interval" apart, starting now.
+             * The whole vector is given to the kernel at once and the call does not wait.
+             * Requires that enable_txtime() has succeeded
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if SO_TXTIME has not been enabled
+             * Return RTP_SEND_ERROR on error */
+            rtp_error_t sendto_txtime(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags,
+                send_arrays& arrays, std::chrono::nanoseconds interval);
+
             /* Same as recv(2), receives a message from socket (remote address not known)
              *
              * Write the amount of bytes read to "bytes_read" if it's not NULL
@@ -149,6 +274,215 @@ namespace uvgrtp {
             rtp_error_t recvfrom(uint8_t *buf, size_t buf_len, int recv_flags, int *bytes_read);
             rtp_error_t recvfrom(uint8_t *buf, size_t buf_len, int recv_flags);
 
+            /* Same as recvmmsg(2), receives up to "count" datagrams from the socket with one call
+             *
+             * "buffers" must hold "count" pointers to buffers that are each "buf_len" bytes long
+             * and the size of each received datagram is written to the corresponding entry of "bytes_read".
+             * At most MAX_RECV_BATCH_SIZE datagrams are read at a time. On Windows the datagrams
+             * are read one by one until the socket has no more data available.
+             *
+             * Write the amount of datagrams read to "packets_read" if it's not NULL
+             *
+             * Return RTP_OK on success and write the amount of datagrams read to "packets_read"
+             * Return RTP_INTERRUPTED if there was nothing to read and set "packets_read" to 0
+             * Return RTP_GENERIC_ERROR on error and set "packets_read" to -1 */
+            rtp_error_t recvmmsg(uint8_t **buffers, size_t buf_len, int *bytes_read, int count,
+                int recv_flags, int *packets_read);
+
+            /* Same as recv(2) for a socket that has UDP Generic Receive Offload (UDP_GRO) or, on Windows,
+             * UDP Receive Segment Coalescing enabled
+             *
+             * The kernel may coalesce several datagrams of the same flow into "buf". In that case the
+             * size of each coalesced datagram is written to "segment_size". All
+             * datagrams are "segment_size" bytes long except the last one, which may be shorter.
+             * If "buf" contains only one datagram, "segment_size" is set to 0.
+             *
+             * Return RTP_OK on success and write the amount of bytes received to "bytes_read"
+             * Return RTP_INTERRUPTED if there was nothing to read and set "bytes_read" to 0
+             * Return RTP_GENERIC_ERROR on error and set "bytes_read" to -1 */
+            rtp_error_t recv_gro(uint8_t *buf, size_t buf_len, int recv_flags, int *bytes_read, int *segment_size);
+
+            /* Enable UDP Generic Receive Offload for the socket, or UDP Receive Segment Coalescing
+             * (UDP_RECV_MAX_COALESCED_SIZE) on Windows
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the system does not support UDP_GRO */
+            rtp_error_t enable_gro();
+
+            /* Enable launch times (SO_TXTIME) for the datagrams of the socket, see sendto_txtime().
+             * The launch times are kept by the fq and etf qdiscs, other qdiscs send at once
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the system does not support SO_TXTIME */
+            rtp_error_t enable_txtime();
+            bool txtime_enabled() const;
+
+            /* Send the datagrams of the socket with the Don't Fragment bit (IP_MTU_DISCOVER, IPV6_DONTFRAG),
+             * so the system refuses a datagram larger than the path MTU it knows instead of fragmenting
+             * it, see path_mtu. Disabling returns the socket to the default of the system
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the system cannot send without fragmentation */
+            rtp_error_t set_dont_fragment(bool enable);
+
+            /* Busy poll the receive queue of the device for "usec" microseconds when reading the
+             * socket (SO_BUSY_POLL) and with "prefer", keep the interrupts off while the socket is
+             * polled (SO_PREFER_BUSY_POLL), see uvgrtp::socket_profile
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the system does not support busy polling or refuses the time */
+            rtp_error_t set_busy_poll(int usec, bool prefer);
+
+            /* Mark the sent datagrams with the Differentiated Services Code Point "dscp" (IP_TOS,
+             * IPV6_TCLASS) and give them the queueing priority "priority" (SO_PRIORITY).
+             * A negative value keeps the default
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the system refuses a value */
+            rtp_error_t set_traffic_class(int dscp, int priority);
+
+            /* Let tune_receive_buffer() grow the receive buffer (SO_RCVBUF) up to "max_bytes"
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the system does not count the dropped datagrams */
+            rtp_error_t set_receive_buffer_autotuning(size_t max_bytes);
+
+            /* Called by the thread that reads the socket after reading "packets" datagrams into
+             * slots of "slot_size" bytes. Once every RECEIVE_BUFFER_TUNING_INTERVAL_MS, the receive
+             * buffer is doubled if the kernel has dropped datagrams and grown to hold
+             * RECEIVE_BUFFER_WINDOW_MS of the traffic, up to the limit of set_receive_buffer_autotuning() */
+            void tune_receive_buffer(size_t packets, size_t slot_size);
+
+            /* Limit the rate the fq qdisc sends the datagrams of the socket at (SO_MAX_PACING_RATE)
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the system does not support SO_MAX_PACING_RATE */
+            rtp_error_t set_max_pacing_rate(uint64_t bytes_per_second);
+
+            /* Enable the kernel timestamps "flags" (RTP_TIMESTAMPING) of the datagrams of the socket
+             * with SO_TIMESTAMPING, 0 disables them. See recv_time() and read_tx_timestamps()
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "flags" contains unknown flags
+             * Return RTP_NOT_SUPPORTED if the system does not support SO_TIMESTAMPING */
+            rtp_error_t enable_timestamping(int flags);
+            int timestamping() const;
+
+            /* The receive time of datagram "i" of the last recvfrom(), recvmmsg() or recv_gro() call in
+             * nanoseconds of the system clock, see uvgrtp::frame::rtp_frame::recv_time. This is the kernel
+             * timestamp if RTP_TIMESTAMP_RECEIVE is enabled and the kernel gave one, otherwise the time
+             * the call returned. Only the thread that reads the socket may call this */
+            uint64_t recv_time(int i) const;
+
+            /* Let the kernel report the number of datagrams it has dropped from the socket because
+             * the receive buffer was full (SO_RXQ_OVFL), see kernel_drops()
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the system does not support SO_RXQ_OVFL */
+            rtp_error_t enable_drop_counting();
+
+            /* Number of datagrams the kernel has dropped from the socket, as reported with the
+             * latest received datagram. 0 if enable_drop_counting() has not succeeded */
+            uint64_t kernel_drops() const;
+
+            /* Join the multicast group "group" on the default interface. If "source" is not empty, only
+             * the datagrams that "source" sends to the group are received (source-specific multicast,
+             * IGMPv3 and MLDv2). A socket may join many groups and the sources of a group one by one
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "group" is not a multicast address of the family of the socket
+             * Return RTP_GENERIC_ERROR if the kernel refuses the join */
+            rtp_error_t join_group(const std::string& group, const std::string& source);
+
+            /* Leave a group or a source of a group joined with join_group()
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "group" is not a multicast address of the family of the socket
+             * Return RTP_GENERIC_ERROR if the socket has not joined the group or the source */
+            rtp_error_t leave_group(const std::string& group, const std::string& source);
+
+            /* Let the kernel tell the destination address of each received datagram (IP_PKTINFO and
+             * IPV6_RECVPKTINFO), so that the datagrams of the groups sharing the socket can be told
+             * apart, see recv_destination()
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the system does not support it */
+            rtp_error_t enable_destination_addresses();
+
+            /* Whether enable_destination_addresses() has succeeded */
+            bool destination_addresses() const;
+
+            /* The destination address of datagram "i" of the last recvfrom(), recvmmsg() or recv_gro() call,
+             * with an IPv4 address mapped to IPv6 (::ffff:a.b.c.d). All zeros if the kernel did not tell it.
+             * Only the thread that reads the socket may call this */
+            const in6_addr& recv_destination(int i) const;
+
+            /* "address" as the IPv6 address in which recv_destination() gives it */
+            static in6_addr mapped_address(const sockaddr_in& address);
+
+            /* Read the send timestamps of RTP_TIMESTAMP_SEND from the error queue of the socket. For each
+             * datagram, the time from when it was meant to leave to its send timestamp is counted in the
+             * metrics given to set_metrics(). The datagrams were meant to leave when they were given to
+             * the kernel or at their launch time, see sendto_txtime()
+             *
+             * The timestamps must be read for poll(2) not to report the socket having an error
+             *
+             * Return the number of timestamps read */
+            size_t read_tx_timestamps();
+
+            /* Count the send delays of read_tx_timestamps() in "metrics", see media_stream::get_stats() */
+            void set_metrics(std::shared_ptr<uvgrtp::stream_metrics> metrics);
+
+            /* Write the datagrams of "directions" (RTP_CAPTURE) that are sent and received through the
+             * socket to the pcap file "path", see uvgrtp::capture. A running capture is stopped first
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "directions" is not valid
+             * Return RTP_GENERIC_ERROR if the file cannot be created */
+            rtp_error_t start_capture(const std::string& path, int directions);
+
+            /* Stop the capture of start_capture() and close its file
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_INITIALIZED if there is no capture running */
+            rtp_error_t stop_capture();
+
+            /* Deliver the datagrams of the vector sends to the sockets of this process that have the memory
+             * transport through it instead of the kernel, and receive the datagrams they send to this socket
+             * the same way, see uvgrtp::memory_transport. Must be called before binding the socket. If
+             * "impairment" is not nullptr, the datagrams received in memory go through an emulated link
+             * with its conditions and the random decisions of "seed", see uvgrtp::impaired_link. If "shared"
+             * is true, the sockets of the other processes of the host are reached through shared memory as well
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the platform does not support the memory transport
+             * Return RTP_GENERIC_ERROR if creating the transport failed */
+            rtp_error_t enable_memory_transport(const uvgrtp::impairment *impairment = nullptr, uint64_t seed = 0,
+                bool shared = false);
+
+            /* Receive the IPv4 datagrams of the port of the socket through the AF_XDP socket of "device" and
+             * send the datagrams to the hosts it has received from through it, see uvgrtp::xdp_device. The
+             * datagrams are received through the queue of a memory transport that is not reachable with
+             * find(), so memory_wake_fd() is polled for them. Must be called before binding the socket
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the platform does not support it
+             * Return RTP_GENERIC_ERROR if creating the queue failed */
+            rtp_error_t enable_xdp(std::shared_ptr<uvgrtp::xdp_device> device);
+
+            /* The file descriptor that is readable when the memory transport may have datagrams, polled
+             * together with get_raw_socket(). -1 if the memory transport is not enabled */
+            int memory_wake_fd() const;
+
+            /* Wait at most "timeout_ms" milliseconds for the datagrams received through the Registered
+             * I/O of the socket on Windows, see uvgrtp::rio. The first call posts the receives, after
+             * which the datagrams are only read through RIO and get_raw_socket() is not polled for them
+             *
+             * Return RTP_OK if there are datagrams to receive
+             * Return RTP_INTERRUPTED if the wait timed out
+             * Return RTP_NOT_SUPPORTED if the socket does not use Registered I/O */
+            rtp_error_t wait_registered_io(int timeout_ms);
+
             /* Create sockaddr_in (IPv4) object using the provided information
              * NOTE: "family" must be AF_INET */
             static sockaddr_in create_sockaddr(short family, unsigned host, short port);
@@ -180,11 +514,23 @@ namespace uvgrtp {
              * "arg" is an optional parameter that can be passed to the handler when it's called */
             rtp_error_t install_handler(std::shared_ptr<std::atomic<std::uint32_t>> local_ssrc, void *arg, packet_handler_vec handler);
 
+            /* Same as above, but "batch_handler" is given all frames of a vector send at once,
+             * so it can process them together instead of one frame per call */
+            rtp_error_t install_handler(std::shared_ptr<std::atomic<std::uint32_t>> local_ssrc, void *arg,
+                packet_handler_vec handler, packet_handler_pkt batch_handler);
+
+            /* Remove the handlers of "local_ssrc"
+             *
+             * Waits until the sends that may be running the handlers have finished, so the argument
+             * of a handler can be freed once this returns. Must not be called from a handler */
             rtp_error_t remove_handler(std::shared_ptr<std::atomic<std::uint32_t>> local_ssrc);
 
             static bool is_multicast(sockaddr_in& local_address);
             static bool is_multicast(sockaddr_in6& local_address);
 
+            /* Whether "address", as given by recv_destination(), is a multicast address */
+            static bool is_multicast(const in6_addr& address);
+
 
         private:
 
@@ -198,7 +544,66 @@ namespace uvgrtp {
 
             /* __sendtov() does the same as __sendto but it combines multiple buffers into one frame and sends them */
             rtp_error_t __sendtov(sockaddr_in& addr, sockaddr_in6& addr6, bool ipv6, buf_vec& buffers, int send_flags, int *bytes_sent);
-            rtp_error_t __sendtov(sockaddr_in& addr, sockaddr_in6& addr6, bool ipv6, uvgrtp::pkt_vec& buffers, int send_flags, int *bytes_sent);
+            rtp_error_t __sendtov(sockaddr_in& addr, sockaddr_in6& addr6, bool ipv6, uvgrtp::pkt_vec& buffers,
+                int send_flags, int *bytes_sent, send_arrays& arrays);
+
+            /* __sendtov_gso() sends frames of equal size with one sendmsg() call using UDP_SEGMENT */
+            rtp_error_t __sendtov_gso(sockaddr_in& addr, sockaddr_in6& addr6, bool ipv6, uvgrtp::pkt_vec& buffers,
+                int send_flags, int *bytes_sent, send_arrays& arrays);
+
+            /* Send the frames of a vector send: through the memory transport or AF_XDP as far as they take
+             * them and the rest through the kernel, with UDP GSO if "gso" is set */
+            rtp_error_t send_frames(sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags,
+                int *bytes_sent, send_arrays& arrays, bool gso);
+
+            /* The memory transport of the socket of this process that the datagrams to "addr" or "addr6"
+             * go to, nullptr if there is none */
+            std::shared_ptr<uvgrtp::memory_transport> memory_peer(const sockaddr_in& addr, const sockaddr_in6& addr6) const;
+
+            /* Send "buffers" through the AF_XDP transport if the socket has one and "addr" has been heard from
+             *
+             * Return false if the datagram should be sent through the kernel */
+            bool send_xdp(const sockaddr_in& addr, const buf_vec& buffers);
+
+            /* Queue "buffers" to "peer" as a datagram sent from this socket to "addr" or "addr6"
+             *
+             * Return false if the datagram must be sent through the kernel */
+            bool send_in_memory(uvgrtp::memory_transport& peer, const sockaddr_in& addr, const sockaddr_in6& addr6,
+                const buf_vec& buffers);
+
+            /* Remember when the next "messages" datagrams are meant to leave for read_tx_timestamps().
+             * "launch_times" are the CLOCK_MONOTONIC launch times of sendto_txtime() or nullptr.
+             * Called before the datagrams are given to the kernel, which may timestamp them at once */
+            void save_tx_times(size_t messages, const uint64_t *launch_times);
+
+            /* The last "messages" datagrams of save_tx_times() could not be sent */
+            void forget_tx_times(size_t messages);
+
+            /* Give the sent datagrams to the capture, called after they have been given to the kernel */
+            void capture_sent(sockaddr_in& addr, sockaddr_in6& addr6, const uint8_t *buf, size_t buf_len);
+            void capture_sent(sockaddr_in& addr, sockaddr_in6& addr6, const buf_vec& buffers);
+            void capture_sent(sockaddr_in& addr, sockaddr_in6& addr6, const pkt_vec& buffers);
+
+            /* Give the datagram received from "sender" at "time_ns" to the capture. "sender" is
+             * nullptr if the address is not known */
+            void capture_received(const uint8_t *buf, size_t length, const struct sockaddr *sender, uint64_t time_ns);
+
+            uvgrtp::capture_endpoint local_endpoint() const;
+
+#ifndef _WIN32
+            /* Same as recvfrom(2), but also sets recv_time() of the datagram */
+            ssize_t recv_datagram(uint8_t *buf, size_t buf_len, int recv_flags, struct sockaddr *sender, socklen_t *len);
+
+            /* Whether the received datagrams carry control messages that read_control() wants */
+            bool receive_control() const;
+
+            /* Return the kernel receive timestamp in the control messages of "msg", 0 if there is
+             * none, and update kernel_drops() and recv_destination() of datagram "index" from them */
+            uint64_t read_control(const struct msghdr *msg, int index);
+#endif
+
+            /* Join or leave a group, see join_group() */
+            rtp_error_t change_membership(const std::string& group, const std::string& source, bool join);
 
             socket_t socket_;
             //sockaddr_in remote_address_;
@@ -209,15 +614,103 @@ namespace uvgrtp {
 
             int rce_flags_;
 
+            /* Cleared if the kernel refuses UDP_SEGMENT */
+            std::atomic<bool> gso_supported_;
+
+            /* Set once enable_txtime() has succeeded */
+            std::atomic<bool> txtime_enabled_;
+
+            /* The RTP_TIMESTAMPING flags given to enable_timestamping() */
+            std::atomic<int> timestamping_;
+
+            /* Written by the thread that reads the socket, see recv_time() */
+            uint64_t recv_times_[MAX_RECV_BATCH_SIZE];
+
+            /* Set once enable_drop_counting() has succeeded, see kernel_drops() */
+            std::atomic<bool> count_drops_;
+            std::atomic<uint32_t> kernel_drops_;
+
+            /* The limit of set_receive_buffer_autotuning(), 0 if the buffer is not tuned. The rest
+             * is touched by the thread that reads the socket, see tune_receive_buffer() */
+            std::atomic<size_t> rcvbuf_max_{0};
+            size_t tune_packets_ = 0;
+            uint32_t tune_drops_ = 0;
+            std::chrono::steady_clock::time_point tune_start_;
+
+            /* Set once enable_destination_addresses() has succeeded. The addresses are
+             * written by the thread that reads the socket, see recv_destination() */
+            std::atomic<bool> destinations_;
+            in6_addr recv_destinations_[MAX_RECV_BATCH_SIZE];
+
+            /* The times the datagrams were meant to leave in nanoseconds of the system clock, indexed
+             * by the key that the kernel gives the datagrams in the order they are sent (SOF_TIMESTAMPING_OPT_ID) */
+            std::unique_ptr<std::atomic<uint64_t>[]> tx_times_;
+            std::atomic<uint32_t> tx_key_;
+
+            /* The capture of start_capture(), replaced as a whole with std::atomic_store so that a
+             * thread that is recording a datagram keeps the capture it loaded. "capturing_" is
+             * checked first so that a socket without a capture does not touch the pointer */
+            std::atomic<bool> capturing_;
+            std::shared_ptr<uvgrtp::capture> capture_;
+
+            /* The memory transport of enable_memory_transport(), set before the socket is bound */
+            std::shared_ptr<uvgrtp::memory_transport> memory_;
+
+            /* The AF_XDP transport of enable_xdp() and the port it receives, in network byte order,
+             * once the socket is bound. The datagrams it receives are queued to "memory_" */
+            std::shared_ptr<uvgrtp::xdp_device> xdp_;
+            uint16_t xdp_port_ = 0;
+
+            /* Held while reading the send timestamps, protects metrics_ */
+            std::mutex tx_mutex_;
+            std::shared_ptr<uvgrtp::stream_metrics> metrics_;
+
+            /* io_uring instances for sending and receiving batches of datagrams, created on first use.
+             * Only used if uvgRTP has been built with UVGRTP_ENABLE_IO_URING */
+            bool uring_ready(std::unique_ptr<uvgrtp::uring>& ring);
+
+            std::unique_ptr<uvgrtp::uring> send_uring_;
+            std::unique_ptr<uvgrtp::uring> recv_uring_;
+
+            /* The Registered I/O of the socket, created with the socket if uvgRTP has been built with
+             * UVGRTP_ENABLE_RIO on Windows and nullptr if it is not available. Its receives are used
+             * once wait_registered_io() has been called */
+            std::unique_ptr<uvgrtp::rio> rio_;
+
+            /* Send "count" packets to "addr" or "addr6" through "rio_"
+             *
+             * Return false if the socket has no RIO or a packet does not fit into a slot of it,
+             * otherwise the result of the send is written to "ret" */
+            bool send_registered(sockaddr_in& addr, sockaddr_in6& addr6, bool ipv6, const buf_vec *packets,
+                size_t count, int *bytes_sent, rtp_error_t& ret);
+
+            /* Read one datagram for __recv() or __recvfrom() through "rio_" once it is receiving,
+             * the sender is copied to "sender" if it fits into "sender_len" bytes
+             *
+             * Return false if the socket is not read through RIO */
+            bool recv_registered(uint8_t *buf, size_t buf_len, sockaddr *sender, socklen_t *sender_len,
+                int *bytes_read, rtp_error_t& ret);
+
+            /* Replace "handlers_" with the handlers of "vec_handlers_". Called with handlers_mutex_ held */
+            void publish_handlers();
+
             std::mutex handlers_mutex_;
             std::mutex conf_mutex_;
 
-            /* __sendto() calls these handlers in order before sending the packet */
-            std::multimap<std::shared_ptr<std::atomic<std::uint32_t>>, socket_packet_handler> buf_handlers_;
-
-            /* __sendtov() calls these handlers in order before sending the packet */
+            /* The handlers of install_handler() by the SSRC of their stream, guarded by handlers_mutex_ */
             std::multimap<std::shared_ptr<std::atomic<std::uint32_t>>, socket_packet_handler> vec_handlers_;
 
+            /* Copy of "vec_handlers_" that the sends call in order before sending the packets. The handlers
+             * only change when streams are set up or torn down, so the sends take the copy without locking
+             * handlers_mutex_ and a change replaces it as a whole */
+            std::shared_ptr<const std::vector<socket_packet_handler>> handlers_;
+
+            /* Sends running the handlers, counted by the parity of "handler_epoch_" when they started.
+             * remove_handler() flips the epoch and waits for the sends of the old parity to finish,
+             * so that no send is calling the removed handler when it returns */
+            std::atomic<uint32_t> handler_epoch_;
+            std::atomic<uint64_t> handler_runs_[2];
+
 #ifndef NDEBUG
             uint64_t sent_packets_ = 0;
             uint64_t received_packets_ = 0;
@@ -225,9 +718,20 @@ namespace uvgrtp {
 
 #ifdef _WIN32
             WSABUF buffers_[MAX_BUFFER_COUNT];
+
+            /* WSARecvMsg() of the socket, loaded by enable_gro() for UDP Receive Segment Coalescing */
+            LPFN_WSARECVMSG wsa_recvmsg_;
 #else
             struct mmsghdr header_;
             struct iovec   chunks_[MAX_BUFFER_COUNT];
+
+            /* used by recvmmsg() */
+            struct mmsghdr recv_headers_[MAX_RECV_BATCH_SIZE];
+            struct iovec   recv_chunks_[MAX_RECV_BATCH_SIZE];
+            alignas(struct cmsghdr) uint8_t recv_control_[MAX_RECV_BATCH_SIZE][RECV_CONTROL_SIZE];
+
+            /* The sender addresses of recvmmsg(), only asked for when the datagrams are captured */
+            sockaddr_in6 recv_names_[MAX_RECV_BATCH_SIZE];
 #endif
     };
 }
@@ -4,6 +4,7 @@
 #include "rtcp_reader.hh"
 #include "random.hh"
 #include "global.hh"
+#include "hostname.hh"
 #include "debug.hh"
 
 
@@ -19,10 +20,15 @@
 #include <poll.h>
 #include <pthread.h>
 
+#ifdef __linux__
+#include <linux/filter.h>
+#endif
+
 #endif
 #include <algorithm>
 #include <cstring>
 #include <iterator>
+#include <thread>
 
 constexpr size_t DEFAULT_INITIAL_BUFFER_SIZE = 4194304;
 
@@ -33,7 +39,16 @@ uvgrtp::socketfactory::socketfactory(int rce_flags) :
     ipv6_(false),
     used_sockets_({}),
     reception_flows_({}),
-    rtcp_readers_to_ports_({})
+    rtcp_readers_({}),
+    io_engine_(nullptr),
+    pacer_(nullptr),
+    rtcp_scheduler_(nullptr),
+    keepalive_timer_(nullptr),
+    memory_budget_(nullptr),
+    thread_settings_(nullptr),
+    shards_(1),
+    transport_(RTP_TRANSPORT_UDP),
+    xdp_device_(nullptr)
 {
 }
 
@@ -61,20 +76,12 @@ rtp_error_t uvgrtp::socketfactory::set_local_interface(std::string local_addr)
     return RTP_OK;
 }
 
-std::shared_ptr<uvgrtp::socket> uvgrtp::socketfactory::create_new_socket(int type, uint16_t port)
+std::shared_ptr<uvgrtp::socket> uvgrtp::socketfactory::open_socket(int type, uint16_t port)
 {
-    rtp_error_t ret = RTP_OK;
     std::shared_ptr<uvgrtp::socket> socket = std::make_shared<uvgrtp::socket>(rce_flags_);
 
-    if (ipv6_) {
-        if ((ret = socket->init(AF_INET6, SOCK_DGRAM, 0)) != RTP_OK) {
-            return nullptr;
-        }
-    }
-    else {
-        if ((ret = socket->init(AF_INET, SOCK_DGRAM, 0)) != RTP_OK) {
-            return nullptr;
-        }
+    if (socket->init(ipv6_ ? AF_INET6 : AF_INET, SOCK_DGRAM, 0) != RTP_OK) {
+        return nullptr;
     }
 #ifdef _WIN32
     /* Make the socket non-blocking */
@@ -85,27 +92,58 @@ std::shared_ptr<uvgrtp::socket> uvgrtp::socketfactory::create_new_socket(int typ
     }
 #endif
 
-    if (ret == RTP_OK) {
-        used_sockets_.push_back(socket);
-        if (port != 0) {
-            bind_socket(socket, port);
-        }
+    used_sockets_.insert(socket);
 
-        // If the socket is a type 2 (non-RTCP) socket, install a reception_flow
-        if (type == 2) {
-            std::shared_ptr<uvgrtp::reception_flow> flow = std::shared_ptr<uvgrtp::reception_flow>(new uvgrtp::reception_flow(ipv6_));
-            std::pair pair = std::make_pair(flow, socket);
-            reception_flows_.insert(pair);
+    // If the socket is a type 2 (non-RTCP) socket, install a reception_flow. The flow is
+    // installed before binding, so that the shards of the port can be given to it
+    if (type == 2) {
+        if (transport_ == RTP_TRANSPORT_MEMORY || transport_ == RTP_TRANSPORT_SHARED_MEMORY) {
+            std::shared_ptr<const uvgrtp::impairment> impairment = std::atomic_load(&impairment_);
+            uint64_t seed = impairment ? impairment->seed + impaired_sockets_++ : 0;
+
+            if (socket->enable_memory_transport(impairment.get(), seed, transport_ == RTP_TRANSPORT_SHARED_MEMORY) != RTP_OK)
+                UVG_LOG_WARN("Failed to enable the memory transport, the socket uses UDP only");
         }
-        else if (type == 1) {
-            // RTCP socket
-            std::shared_ptr<uvgrtp::rtcp_reader> reader = std::shared_ptr<uvgrtp::rtcp_reader>(new uvgrtp::rtcp_reader());
-            rtcp_readers_to_ports_[reader] = port;
+
+        if (transport_ == RTP_TRANSPORT_XDP && xdp_device_ && socket->enable_xdp(xdp_device_) != RTP_OK) {
+            UVG_LOG_WARN("Failed to enable AF_XDP, the socket uses UDP only");
         }
-        return socket;
+
+        std::shared_ptr<uvgrtp::reception_flow> flow = std::shared_ptr<uvgrtp::reception_flow>(new uvgrtp::reception_flow(ipv6_));
+        flow->set_io_engine(io_engine_);
+        flow->set_thread_settings(thread_settings_);
+        reception_flows_[socket] = flow;
     }
-    
-    return nullptr;
+    else if (type == 1) {
+        // RTCP socket
+        std::shared_ptr<uvgrtp::rtcp_reader> reader = std::shared_ptr<uvgrtp::rtcp_reader>(new uvgrtp::rtcp_reader());
+        reader->set_io_engine(io_engine_);
+        reader->set_thread_settings(thread_settings_);
+        rtcp_readers_[port] = reader;
+    }
+    return socket;
+}
+
+void uvgrtp::socketfactory::forget_socket(uint16_t port, std::shared_ptr<uvgrtp::socket> socket)
+{
+    auto used = used_ports_.find(port);
+    if (port != 0 && used != used_ports_.end() && used->second == socket) {
+        used_ports_.erase(used);
+    }
+    if (reception_flows_.erase(socket) == 0) {
+        rtcp_readers_.erase(port);
+    }
+    used_sockets_.erase(socket);
+}
+
+std::shared_ptr<uvgrtp::socket> uvgrtp::socketfactory::create_new_socket(int type, uint16_t port)
+{
+    std::shared_ptr<uvgrtp::socket> socket = open_socket(type, port);
+
+    if (socket && port != 0) {
+        bind_socket(socket, port);
+    }
+    return socket;
 }
 
 rtp_error_t uvgrtp::socketfactory::bind_socket(std::shared_ptr<uvgrtp::socket> soc, uint16_t port)
@@ -124,8 +162,10 @@ rtp_error_t uvgrtp::socketfactory::bind_socket(std::shared_ptr<uvgrtp::socket> s
             UVG_LOG_INFO("The used address %s is a multicast address", local_address_.c_str());
             ret = soc->bind_ip6(bind_addr6);
         }
-        else if (!is_port_in_use(port)) {
-            ret = soc->bind_ip6(bind_addr6);
+        else if (!is_port_in_use(port) && (ret = prepare_shards(soc)) == RTP_OK &&
+            (ret = soc->bind_ip6(bind_addr6)) == RTP_OK)
+        {
+            create_shards(soc, {}, bind_addr6);
         }
     }
     else {
@@ -134,8 +174,10 @@ rtp_error_t uvgrtp::socketfactory::bind_socket(std::shared_ptr<uvgrtp::socket> s
             UVG_LOG_INFO("The used address %s is a multicast address", local_address_.c_str());
             ret = soc->bind(bind_addr);
         }
-        else if (!is_port_in_use(port)) {
-            ret = soc->bind(bind_addr);
+        else if (!is_port_in_use(port) && (ret = prepare_shards(soc)) == RTP_OK &&
+            (ret = soc->bind(bind_addr)) == RTP_OK)
+        {
+            create_shards(soc, bind_addr, {});
         }
     }
     if (ret == RTP_OK) {
@@ -148,17 +190,31 @@ rtp_error_t uvgrtp::socketfactory::bind_socket(std::shared_ptr<uvgrtp::socket> s
 
 rtp_error_t uvgrtp::socketfactory::bind_socket_anyip(std::shared_ptr<uvgrtp::socket> soc, uint16_t port)
 {
-    rtp_error_t ret = RTP_OK;
     std::lock_guard<std::mutex> lg(conf_mutex_);
+    return bind_socket_anyip_locked(soc, port);
+}
+
+rtp_error_t uvgrtp::socketfactory::bind_socket_anyip_locked(std::shared_ptr<uvgrtp::socket> soc, uint16_t port)
+{
+    rtp_error_t ret = RTP_OK;
 
     if (!is_port_in_use(port)) {
 
+        if ((ret = prepare_shards(soc)) != RTP_OK) {
+            return ret;
+        }
+
         if (ipv6_) {
             sockaddr_in6 bind_addr6 = uvgrtp::socket::create_ip6_sockaddr_any(port);
-            ret = soc->bind_ip6(bind_addr6);
+            if ((ret = soc->bind_ip6(bind_addr6)) == RTP_OK) {
+                create_shards(soc, {}, bind_addr6);
+            }
         }
         else {
-            ret = soc->bind(AF_INET, INADDR_ANY, port);
+            sockaddr_in bind_addr = uvgrtp::socket::create_sockaddr(AF_INET, INADDR_ANY, port);
+            if ((ret = soc->bind(bind_addr)) == RTP_OK) {
+                create_shards(soc, bind_addr, {});
+            }
         }
         if (ret == RTP_OK) {
             used_ports_.insert({ port, soc });
@@ -168,6 +224,103 @@ rtp_error_t uvgrtp::socketfactory::bind_socket_anyip(std::shared_ptr<uvgrtp::soc
     return ret;
 }
 
+rtp_error_t uvgrtp::socketfactory::bind_reserved(std::shared_ptr<uvgrtp::socket> soc,
+    const std::string& local_address, uint16_t port)
+{
+    if (local_address.empty()) {
+        return bind_socket_anyip_locked(soc, port);
+    }
+
+    rtp_error_t ret = RTP_OK;
+
+    if (ipv6_) {
+        sockaddr_in6 bind_addr6 = uvgrtp::socket::create_ip6_sockaddr(local_address, port);
+        if ((ret = prepare_shards(soc)) == RTP_OK && (ret = soc->bind_ip6(bind_addr6)) == RTP_OK) {
+            create_shards(soc, {}, bind_addr6);
+        }
+    }
+    else {
+        sockaddr_in bind_addr = uvgrtp::socket::create_sockaddr(AF_INET, local_address, port);
+        if ((ret = prepare_shards(soc)) == RTP_OK && (ret = soc->bind(bind_addr)) == RTP_OK) {
+            create_shards(soc, bind_addr, {});
+        }
+    }
+    if (ret == RTP_OK) {
+        used_ports_.insert({ port, soc });
+    }
+    return ret;
+}
+
+rtp_error_t uvgrtp::socketfactory::reserve_ports(const std::string& local_address, size_t pairs,
+    uint16_t min_port, uint16_t max_port, uint16_t& first_port)
+{
+    // the RTP ports are even
+    uint32_t start = (uint32_t)min_port + (min_port & 1);
+
+    if (pairs == 0 || max_port < min_port || start + 2 * pairs - 1 > max_port) {
+        UVG_LOG_ERROR("%zu port pairs do not fit between ports %u and %u", pairs, min_port, max_port);
+        return RTP_INVALID_VALUE;
+    }
+
+    if (!local_address.empty()) {
+        bool multicast = false;
+        if (ipv6_) {
+            sockaddr_in6 addr6 = uvgrtp::socket::create_ip6_sockaddr(local_address, 0);
+            multicast = uvgrtp::socket::is_multicast(addr6);
+        }
+        else {
+            sockaddr_in addr = uvgrtp::socket::create_sockaddr(AF_INET, local_address, 0);
+            multicast = uvgrtp::socket::is_multicast(addr);
+        }
+
+        if (multicast) {
+            UVG_LOG_ERROR("Ports of a multicast address cannot be reserved");
+            return RTP_INVALID_VALUE;
+        }
+    }
+
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+
+    std::vector<std::pair<uint16_t, std::shared_ptr<uvgrtp::socket>>> bound;
+    bound.reserve(2 * pairs);
+
+    while (start + 2 * pairs - 1 <= max_port) {
+        uint32_t port = start;
+
+        // the sockets are bound in port order, so the first failure tells where the next try starts
+        for (; port < start + 2 * pairs; ++port) {
+            if (is_port_in_use((uint16_t)port))
+                break;
+
+            std::shared_ptr<uvgrtp::socket> socket = open_socket((port & 1) ? 1 : 2, (uint16_t)port);
+            if (!socket)
+                break;
+
+            if (bind_reserved(socket, local_address, (uint16_t)port) != RTP_OK) {
+                forget_socket((uint16_t)port, socket);
+                break;
+            }
+            bound.push_back({ (uint16_t)port, socket });
+        }
+
+        if (bound.size() == 2 * pairs) {
+            first_port = (uint16_t)start;
+            UVG_LOG_DEBUG("Reserved ports %u-%u for %zu streams", start, port - 1, pairs);
+            return RTP_OK;
+        }
+
+        for (auto& b : bound) {
+            forget_socket(b.first, b.second);
+        }
+        bound.clear();
+
+        start = port + 1 + ((port + 1) & 1);
+    }
+
+    UVG_LOG_ERROR("No %zu free port pairs between ports %u and %u", pairs, min_port, max_port);
+    return RTP_BIND_ERROR;
+}
+
 std::shared_ptr<uvgrtp::socket> uvgrtp::socketfactory::get_socket_ptr(int type, uint16_t port)
 {
     std::lock_guard<std::mutex> lg(conf_mutex_);
@@ -181,29 +334,290 @@ std::shared_ptr<uvgrtp::socket> uvgrtp::socketfactory::get_socket_ptr(int type,
 std::shared_ptr<uvgrtp::reception_flow> uvgrtp::socketfactory::get_reception_flow_ptr(std::shared_ptr<uvgrtp::socket> socket) 
 {
     std::lock_guard<std::mutex> lg(conf_mutex_);
-    for (const auto& ptr : reception_flows_) {
-        if (ptr.second == socket) {
-            return ptr.first;
-        }
-    }
-    return nullptr;
+    auto flow = reception_flows_.find(socket);
+    return (flow != reception_flows_.end()) ? flow->second : nullptr;
 }
 
 std::shared_ptr<uvgrtp::rtcp_reader> uvgrtp::socketfactory::install_rtcp_reader(uint16_t port)
 {
     std::shared_ptr<uvgrtp::rtcp_reader> reader = std::shared_ptr<uvgrtp::rtcp_reader>(new uvgrtp::rtcp_reader());
-    rtcp_readers_to_ports_[reader] = port;
+    reader->set_io_engine(io_engine_);
+    reader->set_thread_settings(thread_settings_);
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    rtcp_readers_[port] = reader;
     return reader;
 }
 
 std::shared_ptr <uvgrtp::rtcp_reader> uvgrtp::socketfactory::get_rtcp_reader(uint16_t port)
 {
-    for (auto& p : rtcp_readers_to_ports_) {
-        if (p.second == port) {
-            return p.first;
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    auto reader = rtcp_readers_.find(port);
+    return (reader != rtcp_readers_.end()) ? reader->second : nullptr;
+}
+
+void uvgrtp::socketfactory::set_receive_shards(size_t shards)
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    shards_ = shards;
+}
+
+void uvgrtp::socketfactory::set_transport(int transport)
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    transport_ = transport;
+}
+
+void uvgrtp::socketfactory::set_impairment(const uvgrtp::impairment& config)
+{
+    // the default conditions leave the link as it is, so the datagrams skip the emulation
+    bool impaired = config.good_to_bad > 0 || config.loss_good > 0 || config.duplicate > 0 ||
+        config.reorder > 0 || config.delay_us > 0 || config.jitter_us > 0 || config.rate_kbps > 0;
+
+    std::atomic_store(&impairment_, impaired ?
+        std::make_shared<const uvgrtp::impairment>(config) : std::shared_ptr<const uvgrtp::impairment>());
+}
+
+void uvgrtp::socketfactory::set_xdp_device(std::shared_ptr<uvgrtp::xdp_device> device)
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    xdp_device_ = device;
+}
+
+rtp_error_t uvgrtp::socketfactory::prepare_shards(std::shared_ptr<uvgrtp::socket> soc)
+{
+#ifdef __linux__
+    if (shards_ <= 1)
+        return RTP_OK;
+
+    // only the media sockets are sharded, they have a reception flow
+    if (reception_flows_.find(soc) != reception_flows_.end()) {
+        int enable = 1;
+        return soc->setsockopt(SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+    }
+#else
+    (void)soc;
+#endif
+    return RTP_OK;
+}
+
+void uvgrtp::socketfactory::create_shards(std::shared_ptr<uvgrtp::socket> soc, const sockaddr_in& addr,
+    const sockaddr_in6& addr6)
+{
+#ifdef __linux__
+    if (shards_ <= 1)
+        return;
+
+    auto found = reception_flows_.find(soc);
+    if (found == reception_flows_.end())
+        return;
+
+    std::shared_ptr<uvgrtp::reception_flow> flow = found->second;
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t sockets = 1;
+    flow->set_core(0);
+
+    for (; sockets < shards_; ++sockets) {
+        std::shared_ptr<uvgrtp::socket> shard = std::make_shared<uvgrtp::socket>(rce_flags_);
+
+        int enable = 1;
+        int buf_size = DEFAULT_INITIAL_BUFFER_SIZE;
+        sockaddr_in bind_addr = addr;
+        sockaddr_in6 bind_addr6 = addr6;
+
+        if (shard->init(ipv6_ ? AF_INET6 : AF_INET, SOCK_DGRAM, 0) != RTP_OK ||
+            shard->setsockopt(SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) != RTP_OK ||
+            shard->setsockopt(SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size)) != RTP_OK ||
+            (ipv6_ ? shard->bind_ip6(bind_addr6) : shard->bind(bind_addr)) != RTP_OK)
+        {
+            UVG_LOG_WARN("Failed to create receive shard %u, receiving with %u shards", sockets, sockets);
+            break;
         }
+        flow->add_shard(shard, (int)(sockets % cores));
     }
-    return nullptr;
+
+    /* The kernel picks the socket of a packet by the index that this program returns, which
+     * is the SSRC of the packet modulo the number of sockets. The program sees the UDP payload,
+     * where the SSRC of RTCP is at octet 4 and the SSRC of RTP and ZRTP at octet 8. Unlike the
+     * default hash of the addresses, this keeps the streams of one remote address apart */
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 1),              // packet type of RTCP
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K,   200, 0, 3),
+        BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K,   204, 2, 0),
+        BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, 4),              // SSRC of the RTCP sender
+        BPF_STMT(BPF_JMP | BPF_JA,            1),
+        BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, 8),              // SSRC of RTP
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K,   sockets),
+        BPF_STMT(BPF_RET | BPF_A,             0),
+    };
+    struct sock_fprog program = { (unsigned short)(sizeof(code) / sizeof(code[0])), code };
+
+    if (soc->setsockopt(SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) != RTP_OK) {
+        UVG_LOG_WARN("Failed to steer the shards by SSRC, the packets are spread by their addresses");
+    }
+#else
+    (void)soc;
+    (void)addr;
+    (void)addr6;
+#endif
+}
+
+void uvgrtp::socketfactory::set_io_engine(std::shared_ptr<uvgrtp::io_engine> engine)
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    io_engine_ = engine;
+}
+
+void uvgrtp::socketfactory::set_pacer(std::shared_ptr<uvgrtp::pacer> pacer)
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    pacer_ = pacer;
+}
+
+std::shared_ptr<uvgrtp::pacer> uvgrtp::socketfactory::get_pacer()
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    return pacer_;
+}
+
+void uvgrtp::socketfactory::set_rtcp_scheduler(std::shared_ptr<uvgrtp::rtcp_scheduler> scheduler)
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    rtcp_scheduler_ = scheduler;
+}
+
+std::shared_ptr<uvgrtp::rtcp_scheduler> uvgrtp::socketfactory::get_rtcp_scheduler()
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    return rtcp_scheduler_;
+}
+
+void uvgrtp::socketfactory::set_keepalive_timer(std::shared_ptr<uvgrtp::keepalive_timer> timer)
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    keepalive_timer_ = timer;
+}
+
+std::shared_ptr<uvgrtp::keepalive_timer> uvgrtp::socketfactory::get_keepalive_timer()
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    return keepalive_timer_;
+}
+
+void uvgrtp::socketfactory::set_memory_budget(std::shared_ptr<uvgrtp::memory_budget> budget)
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    memory_budget_ = budget;
+}
+
+std::shared_ptr<uvgrtp::memory_budget> uvgrtp::socketfactory::get_memory_budget()
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    return memory_budget_;
+}
+
+void uvgrtp::socketfactory::set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings)
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    thread_settings_ = settings;
+}
+
+std::shared_ptr<uvgrtp::thread_settings> uvgrtp::socketfactory::get_thread_settings()
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    return thread_settings_;
+}
+
+void uvgrtp::socketfactory::set_zrtp_cache(std::shared_ptr<uvgrtp::zrtp_cache> cache)
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    zrtp_cache_ = cache;
+}
+
+std::shared_ptr<uvgrtp::zrtp_cache> uvgrtp::socketfactory::get_zrtp_cache()
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    return zrtp_cache_;
+}
+
+void uvgrtp::socketfactory::set_socket_profile(int type, const uvgrtp::socket_profile& profile)
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    socket_profiles_[type] = profile;
+}
+
+void uvgrtp::socketfactory::apply_socket_profile(std::shared_ptr<uvgrtp::socket> soc, int type)
+{
+    std::vector<std::shared_ptr<uvgrtp::socket>> sockets = { soc };
+    uvgrtp::socket_profile profile;
+    {
+        std::lock_guard<std::mutex> lg(conf_mutex_);
+        profile = socket_profiles_[type];
+
+        auto found = reception_flows_.find(soc);
+        if (found != reception_flows_.end()) {
+            for (auto& shard : found->second->get_shard_sockets())
+                sockets.push_back(shard);
+        }
+    }
+
+    // only the socket that sends has a traffic class
+    if ((profile.dscp >= 0 || profile.priority >= 0) &&
+        soc->set_traffic_class(profile.dscp, profile.priority) != RTP_OK) {
+        UVG_LOG_WARN("Failed to set the traffic class of the socket, sending with the default one");
+    }
+
+    for (auto& socket : sockets) {
+        if (profile.busy_poll_us > 0 &&
+            socket->set_busy_poll(profile.busy_poll_us, profile.prefer_busy_poll) != RTP_OK) {
+            UVG_LOG_WARN("Failed to enable busy polling, receiving with interrupts");
+        }
+
+        if (profile.max_receive_buffer > 0 &&
+            socket->set_receive_buffer_autotuning(profile.max_receive_buffer) != RTP_OK) {
+            UVG_LOG_WARN("Failed to enable the receive buffer autotuning");
+        }
+    }
+}
+
+void uvgrtp::socketfactory::set_key_pool(std::shared_ptr<uvgrtp::key_pool> pool)
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    key_pool_ = pool;
+}
+
+std::shared_ptr<uvgrtp::key_pool> uvgrtp::socketfactory::get_key_pool()
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    return key_pool_;
+}
+
+void uvgrtp::socketfactory::set_zrtp_ec25(bool enable)
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    zrtp_ec25_ = enable;
+}
+
+bool uvgrtp::socketfactory::get_zrtp_ec25()
+{
+    std::lock_guard<std::mutex> lg(conf_mutex_);
+    return zrtp_ec25_;
+}
+
+void uvgrtp::socketfactory::set_cname(const std::string& cname)
+{
+    std::lock_guard<std::mutex> lg(cname_mutex_);
+    cname_ = cname;
+}
+
+std::string uvgrtp::socketfactory::get_cname()
+{
+    std::lock_guard<std::mutex> lg(cname_mutex_);
+
+    if (cname_.empty())
+        cname_ = uvgrtp::hostname::generate_cname();
+
+    return cname_;
 }
 
 bool uvgrtp::socketfactory::get_ipv6() const
@@ -226,21 +640,8 @@ bool uvgrtp::socketfactory::clear_port(uint16_t port, std::shared_ptr<uvgrtp::so
     if (port != 0) {
         used_ports_.erase(port);
     }
-    for (auto& p : rtcp_readers_to_ports_) {
-        if (p.second == port) {
-            rtcp_readers_to_ports_.erase(p.first);
-            break;
-        }
-    }
-    auto it = std::find(used_sockets_.begin(), used_sockets_.end(), socket);
-    if (it != used_sockets_.end()) {
-        used_sockets_.erase(it);
-    }
-    for (auto& p : reception_flows_) {
-        if (p.second == socket) {
-            reception_flows_.erase(p.first);
-            break;
-        }
-    }
+    rtcp_readers_.erase(port);
+    used_sockets_.erase(socket);
+    reception_flows_.erase(socket);
     return true;
 }
@@ -1,18 +1,32 @@
 #pragma once
 
+#include "uvgrtp/context.hh"
 #include "uvgrtp/util.hh"
 #include "reception_flow.hh"
 #include <string>
 #include <memory>
 #include <vector>
 #include <functional>
-#include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace uvgrtp {
 
     class socket;
     class reception_flow;
     class rtcp_reader;
+    class io_engine;
+    class pacer;
+    class rtcp_scheduler;
+    class keepalive_timer;
+    class memory_budget;
+    class xdp_device;
+    class zrtp_cache;
+    class key_pool;
+    class thread_settings;
+
+    /* Most sockets of a sharded port, see uvgrtp::context::set_receive_shards() */
+    constexpr size_t MAX_RECEIVE_SHARDS = 64;
 
     /* This class keeps track of all the sockets that uvgRTP is using. 
      * Each socket will have either a reception_flow or an rtcp_reader depending on what the socket
@@ -61,6 +75,19 @@ namespace uvgrtp {
              * Return RTP OK on success */
             rtp_error_t bind_socket_anyip(std::shared_ptr<uvgrtp::socket> soc, uint16_t port);
 
+            /* Bind the sockets of "pairs" media streams in one go. Each stream gets an RTP socket on an
+             * even port and an RTCP socket on the odd port after it, and the pairs are contiguous.
+             * The range starts from the lowest even port between "min_port" and "max_port" for which
+             * all the sockets could be bound to "local_address", or to any address if it is empty.
+             * The streams created on the ports afterwards use the bound sockets
+             *
+             * Param first_port the RTP port of the first pair
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the range does not fit the pairs
+             * Return RTP_BIND_ERROR if no range of free ports was found */
+            rtp_error_t reserve_ports(const std::string& local_address, size_t pairs, uint16_t min_port,
+                uint16_t max_port, uint16_t& first_port);
+
             /* Get the socket bound to the given port
              *
              * Param port socket with wanted port
@@ -93,6 +120,71 @@ namespace uvgrtp {
              * true on success */
             bool clear_port(uint16_t port, std::shared_ptr<uvgrtp::socket> socket);
 
+            /* Open "shards" sockets for each media port bound after this, see
+             * uvgrtp::context::set_receive_shards() */
+            void set_receive_shards(size_t shards);
+
+            /* Set the RTP_TRANSPORT of the media sockets opened after this, see
+             * uvgrtp::context::set_transport() */
+            void set_transport(int transport);
+
+            /* Emulate the link of "config" in the memory transport of the media sockets opened
+             * after this, see uvgrtp::context::set_impairment() */
+            void set_impairment(const uvgrtp::impairment& config);
+
+            /* Set the AF_XDP transport of the media sockets of RTP_TRANSPORT_XDP */
+            void set_xdp_device(std::shared_ptr<uvgrtp::xdp_device> device);
+
+            /* Set the I/O engine that is given to every reception_flow created after this */
+            void set_io_engine(std::shared_ptr<uvgrtp::io_engine> engine);
+
+            /* Set the pacer shared by the media streams of the context */
+            void set_pacer(std::shared_ptr<uvgrtp::pacer> pacer);
+            std::shared_ptr<uvgrtp::pacer> get_pacer();
+
+            /* Set the scheduler of the periodic RTCP reports of the context */
+            void set_rtcp_scheduler(std::shared_ptr<uvgrtp::rtcp_scheduler> scheduler);
+            std::shared_ptr<uvgrtp::rtcp_scheduler> get_rtcp_scheduler();
+
+            /* Set the timer of the keep-alives of RCE_HOLEPUNCH_KEEPALIVE of the context */
+            void set_keepalive_timer(std::shared_ptr<uvgrtp::keepalive_timer> timer);
+            std::shared_ptr<uvgrtp::keepalive_timer> get_keepalive_timer();
+
+            /* Set the memory budget of the context, the parent of the budgets of its media streams */
+            void set_memory_budget(std::shared_ptr<uvgrtp::memory_budget> budget);
+            std::shared_ptr<uvgrtp::memory_budget> get_memory_budget();
+
+            /* Set the thread configurations of the context, given to every reception_flow
+             * and rtcp_reader created after this */
+            void set_thread_settings(std::shared_ptr<uvgrtp::thread_settings> settings);
+            std::shared_ptr<uvgrtp::thread_settings> get_thread_settings();
+
+            /* Set the ZRTP cache given to the sessions of the context */
+            void set_zrtp_cache(std::shared_ptr<uvgrtp::zrtp_cache> cache);
+            std::shared_ptr<uvgrtp::zrtp_cache> get_zrtp_cache();
+
+            /* Set the profile of the media sockets of "type", see uvgrtp::context::configure_sockets() */
+            void set_socket_profile(int type, const uvgrtp::socket_profile& profile);
+
+            /* Apply the profile of "type" to the media socket "soc" and its receive shards.
+             * The options the system refuses are left out with a warning */
+            void apply_socket_profile(std::shared_ptr<uvgrtp::socket> soc, int type);
+
+            /* Set the CNAME of the streams of the context, see uvgrtp::context::set_cname() */
+            void set_cname(const std::string& cname);
+
+            /* Get the CNAME of the streams of the context. It is generated from the host and login
+             * names on the first call if none has been set, since looking them up may be slow */
+            std::string get_cname();
+
+            /* Set the pool of ZRTP key pairs given to the sessions of the context */
+            void set_key_pool(std::shared_ptr<uvgrtp::key_pool> pool);
+            std::shared_ptr<uvgrtp::key_pool> get_key_pool();
+
+            /* Set whether the ZRTP sessions of the context offer EC25, see uvgrtp::context::set_zrtp_ec25() */
+            void set_zrtp_ec25(bool enable);
+            bool get_zrtp_ec25();
+
             /// \cond DO_NOT_DOCUMENT
             bool get_ipv6() const;
             bool is_port_in_use(uint16_t port);
@@ -100,15 +192,69 @@ namespace uvgrtp {
 
         private:
 
+            /* Create a socket of "type", see create_new_socket(), and its reception flow or RTCP
+             * reader without binding it. Called with conf_mutex_ held */
+            std::shared_ptr<uvgrtp::socket> open_socket(int type, uint16_t port);
+
+            /* Forget "socket" of "port" and its reception flow or RTCP reader. Called with conf_mutex_ held */
+            void forget_socket(uint16_t port, std::shared_ptr<uvgrtp::socket> socket);
+
+            /* bind_socket_anyip() with conf_mutex_ held */
+            rtp_error_t bind_socket_anyip_locked(std::shared_ptr<uvgrtp::socket> soc, uint16_t port);
+
+            /* Bind "soc" to "local_address", or to any address if it is empty, for reserve_ports().
+             * Called with conf_mutex_ held */
+            rtp_error_t bind_reserved(std::shared_ptr<uvgrtp::socket> soc, const std::string& local_address,
+                uint16_t port);
+
+            /* Set SO_REUSEPORT on "soc" if the port is to be sharded. Called before binding it */
+            rtp_error_t prepare_shards(std::shared_ptr<uvgrtp::socket> soc);
+
+            /* Bind "shards_ - 1" more sockets to the address of "soc", steer the packets
+             * between them and give the sockets to the reception flow of "soc" */
+            void create_shards(std::shared_ptr<uvgrtp::socket> soc, const sockaddr_in& addr,
+                const sockaddr_in6& addr6);
+
             std::mutex conf_mutex_;
 
             int rce_flags_;
             std::string local_address_;
-            std::map<uint16_t, std::shared_ptr<uvgrtp::socket>> used_ports_;
+
+            /* The sockets are indexed by their port and the reception flows and RTCP readers by
+             * their socket and port, so finding them does not depend on the number of streams */
+            std::unordered_map<uint16_t, std::shared_ptr<uvgrtp::socket>> used_ports_;
             bool ipv6_;
-            std::vector<std::shared_ptr<uvgrtp::socket>> used_sockets_;
-            std::map<std::shared_ptr<uvgrtp::reception_flow>, std::shared_ptr<uvgrtp::socket>> reception_flows_;
-            std::map<std::shared_ptr<uvgrtp::rtcp_reader>, uint16_t> rtcp_readers_to_ports_;
+            std::unordered_set<std::shared_ptr<uvgrtp::socket>> used_sockets_;
+            std::unordered_map<std::shared_ptr<uvgrtp::socket>, std::shared_ptr<uvgrtp::reception_flow>> reception_flows_;
+            std::unordered_map<uint16_t, std::shared_ptr<uvgrtp::rtcp_reader>> rtcp_readers_;
+            std::shared_ptr<uvgrtp::io_engine> io_engine_;
+            std::shared_ptr<uvgrtp::pacer> pacer_;
+            std::shared_ptr<uvgrtp::rtcp_scheduler> rtcp_scheduler_;
+            std::shared_ptr<uvgrtp::keepalive_timer> keepalive_timer_;
+            std::shared_ptr<uvgrtp::memory_budget> memory_budget_;
+            std::shared_ptr<uvgrtp::zrtp_cache> zrtp_cache_;
+            std::shared_ptr<uvgrtp::key_pool> key_pool_;
+            bool zrtp_ec25_ = false;
+            std::shared_ptr<uvgrtp::thread_settings> thread_settings_;
+
+            /* Sockets opened for each media port with SO_REUSEPORT, 1 when not sharded */
+            size_t shards_;
+
+            /* The profiles of configure_sockets(), indexed by RTP_SOCKET_TYPE */
+            uvgrtp::socket_profile socket_profiles_[RTP_SOCKET_LAST];
+
+            /* The RTP_TRANSPORT of the media sockets */
+            int transport_;
+            std::shared_ptr<uvgrtp::xdp_device> xdp_device_;
+
+            /* The CNAME of get_cname(), empty until it is set or first needed */
+            std::mutex cname_mutex_;
+            std::string cname_;
+
+            /* The conditions of set_impairment(), nullptr if the memory transport is not impaired.
+             * Each impaired socket adds one to the seed, so the sockets draw different decisions */
+            std::shared_ptr<const uvgrtp::impairment> impairment_;
+            std::atomic<uint64_t> impaired_sockets_{0};
 
     };
 }
\ No newline at end of file
@@ -9,7 +9,8 @@
 uvgrtp::base_srtp::base_srtp():
     local_srtp_ctx_(std::shared_ptr<srtp_ctx_t>(new srtp_ctx_t)),
     remote_srtp_ctx_(std::shared_ptr<srtp_ctx_t>(new srtp_ctx_t)),
-    use_null_cipher_(false)
+    use_null_cipher_(false),
+    use_gcm_(false)
 {}
 
 uvgrtp::base_srtp::~base_srtp()
@@ -34,8 +35,8 @@ std::shared_ptr<uvgrtp::srtp_ctx_t> uvgrtp::base_srtp::get_remote_ctx()
     return remote_srtp_ctx_;
 }
 
-rtp_error_t uvgrtp::base_srtp::derive_key(int label, size_t key_size, 
-    uint8_t *key, uint8_t *salt, uint8_t *out, size_t out_len)
+rtp_error_t uvgrtp::base_srtp::derive_key(int label, uvgrtp::crypto::aes::ecb& prf,
+    uint8_t *salt, uint8_t *out, size_t out_len)
 {
     uint8_t input[UVG_IV_LENGTH]    = { 0 };
     uint8_t ks[AES256_KEY_SIZE] = { 0 };
@@ -49,14 +50,13 @@ rtp_error_t uvgrtp::base_srtp::derive_key(int label, size_t key_size,
      * ECB encryption is fine for encrypting short messages. However, using a different encryption method for
      * encrypting the keys too might be a more secure solution and should be explored. */
 
-    uvgrtp::crypto::aes::ecb ecb(key, key_size); // srtp_ctx_->n_e);
-    ecb.encrypt(ks, input, UVG_IV_LENGTH);
+    prf.encrypt(ks, input, UVG_IV_LENGTH);
 
     memcpy(out, ks, out_len);
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::base_srtp::create_iv(uint8_t *out, uint32_t ssrc, uint64_t index, uint8_t *salt)
+rtp_error_t uvgrtp::base_srtp::create_iv(uint8_t *out, uint32_t ssrc, uint64_t index, const uint8_t *salt) const
 {
     if (!out || !salt)
         return RTP_INVALID_VALUE;
@@ -77,20 +77,91 @@ rtp_error_t uvgrtp::base_srtp::create_iv(uint8_t *out, uint32_t ssrc, uint64_t i
     return RTP_OK;
 }
 
-bool uvgrtp::base_srtp::is_replayed_packet(uint8_t *digest)
+rtp_error_t uvgrtp::base_srtp::create_gcm_iv(uint8_t *out, uint32_t ssrc, uint64_t index, const uint8_t *salt) const
 {
-    if (!(remote_srtp_ctx_->rce_flags & RCE_SRTP_REPLAY_PROTECTION))
+    if (!out || !salt)
+        return RTP_INVALID_VALUE;
+
+    out[0] = 0;
+    out[1] = 0;
+
+    for (int i = 0; i < 4; i++)
+        out[2 + i] = (uint8_t)(ssrc >> (24 - 8 * i));
+
+    for (int i = 0; i < 6; i++)
+        out[6 + i] = (uint8_t)(index >> (40 - 8 * i));
+
+    for (int i = 0; i < UVG_GCM_IV_LENGTH; i++)
+        out[i] ^= salt[i];
+
+    return RTP_OK;
+}
+
+uvgrtp::replay_window::replay_window():
+    bits_(),
+    highest_(0),
+    initialized_(false)
+{}
+
+bool uvgrtp::replay_window::test(uint64_t index) const
+{
+    index %= UVG_REPLAY_WINDOW_SIZE;
+    return (bits_[index / 64] >> (index % 64)) & 1;
+}
+
+void uvgrtp::replay_window::set(uint64_t index)
+{
+    index %= UVG_REPLAY_WINDOW_SIZE;
+    bits_[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+void uvgrtp::replay_window::clear(uint64_t index)
+{
+    index %= UVG_REPLAY_WINDOW_SIZE;
+    bits_[index / 64] &= ~((uint64_t)1 << (index % 64));
+}
+
+bool uvgrtp::replay_window::check_and_update(uint64_t index)
+{
+    if (!initialized_) {
+        initialized_ = true;
+        highest_     = index;
+        set(index);
+        return false;
+    }
+
+    if (index > highest_) {
+        /* The bits are a ring indexed by the packet index, so moving the window
+         * forward only clears the bits of the indices that were skipped */
+        if (index - highest_ >= UVG_REPLAY_WINDOW_SIZE) {
+            bits_.fill(0);
+        } else {
+            for (uint64_t i = highest_ + 1; i < index; ++i)
+                clear(i);
+        }
+
+        highest_ = index;
+        set(index);
         return false;
+    }
 
-    uint64_t truncated;
-    memcpy(&truncated, digest, sizeof(uint64_t));
+    if (highest_ - index >= UVG_REPLAY_WINDOW_SIZE || test(index))
+        return true;
+
+    set(index);
+    return false;
+}
+
+bool uvgrtp::base_srtp::is_replayed_packet(uint64_t index)
+{
+    if (!(remote_srtp_ctx_->rce_flags & RCE_SRTP_REPLAY_PROTECTION))
+        return false;
 
-    if (replay_list_.find(truncated) != replay_list_.end()) {
+    if (replay_window_.check_and_update(index)) {
         UVG_LOG_ERROR("Replayed packet received, discarding!");
         return true;
     }
 
-    replay_list_.insert(truncated);
     return false;
 }
 
@@ -101,6 +172,12 @@ rtp_error_t uvgrtp::base_srtp::init(int type, int rce_flags, uint8_t* local_key,
         return RTP_INVALID_VALUE;
 
     use_null_cipher_ = (rce_flags & RCE_SRTP_NULL_CIPHER);
+    use_gcm_         = (rce_flags & RCE_SRTP_AES_GCM);
+
+    if (use_gcm_ && (use_null_cipher_ || (rce_flags & RCE_SRTP_KEYSIZE_192))) {
+        UVG_LOG_ERROR("AES-GCM is only defined for 128 and 256-bit keys and cannot be used with the NULL cipher");
+        return RTP_INVALID_VALUE;
+    }
 
     init_srtp_context(local_srtp_ctx_,  type, rce_flags, local_key,  local_salt);
     init_srtp_context(remote_srtp_ctx_, type, rce_flags, remote_key, remote_salt);
@@ -129,7 +206,7 @@ rtp_error_t uvgrtp::base_srtp::init_srtp_context(std::shared_ptr<uvgrtp::srtp_ct
     context->roc = 0;
     context->rts = 0;
     context->type = type;
-    context->hmac = HMAC_SHA1;
+    context->hmac = (rce_flags & RCE_SRTP_AES_GCM) ? AEAD_GCM : HMAC_SHA1;
 
     size_t key_size = get_key_size(rce_flags);
 
@@ -177,34 +254,45 @@ rtp_error_t uvgrtp::base_srtp::init_srtp_context(std::shared_ptr<uvgrtp::srtp_ct
     context->master_key = new uint8_t[key_size];
     memcpy(context->master_key, key, key_size);
     memcpy(context->master_salt, salt, UVG_SALT_LENGTH);
+
+    /* The GCM master salt is 96 bits, the key derivation pads it with zeros */
+    if (rce_flags & RCE_SRTP_AES_GCM)
+        memset(&context->master_salt[UVG_GCM_SALT_LENGTH], 0, UVG_SALT_LENGTH - UVG_GCM_SALT_LENGTH);
     context->enc_key = new uint8_t[key_size]; // session key
 
-    /* Derive session keys */
+    /* Derive session keys, the AES key schedule of the master key is shared by all three */
+    uvgrtp::crypto::aes::ecb prf(context->master_key, key_size);
+
     (void)derive_key(
         label_enc,
-        key_size,
-        context->master_key,
+        prf,
         context->master_salt,
         context->enc_key,
         key_size
     );
     (void)derive_key(
         label_auth,
-        key_size,
-        context->master_key,
+        prf,
         context->master_salt,
         context->auth_key,
         UVG_AUTH_LENGTH
     );
     (void)derive_key(
         label_salt,
-        key_size,
-        context->master_key,
+        prf,
         context->master_salt,
         context->salt_key,
-        UVG_SALT_LENGTH
+        (rce_flags & RCE_SRTP_AES_GCM) ? UVG_GCM_SALT_LENGTH : UVG_SALT_LENGTH
     );
 
+    if (rce_flags & RCE_SRTP_AES_GCM) {
+        context->gcm = std::make_shared<uvgrtp::crypto::aes::gcm>(context->enc_key, key_size);
+    }
+    else {
+        context->ctr = std::make_shared<uvgrtp::crypto::aes::ctr>(context->enc_key, key_size);
+        context->hmac_sha1 = std::make_shared<uvgrtp::crypto::hmac::sha1>(context->auth_key, UVG_AUTH_LENGTH);
+    }
+
     return RTP_OK;
 }
 
@@ -11,8 +11,8 @@
 #include <arpa/inet.h>
 #endif
 
+#include <array>
 #include <cstdint>
-#include <unordered_set>
 #include <vector>
 #include <memory>
 
@@ -32,8 +32,35 @@ enum {
 #define UVG_AUTH_TAG_LENGTH     10
 #define UVG_SRTCP_INDEX_LENGTH   4
 
+/* AES-GCM, see RFC 7714 */
+#define UVG_GCM_SALT_LENGTH     12 /* 96 bits */
+#define UVG_GCM_IV_LENGTH       12
+#define UVG_GCM_TAG_LENGTH      16
+
+/* Size of the replay window in packets, see RFC 3711 section 3.3.2 */
+#define UVG_REPLAY_WINDOW_SIZE  1024
+
 namespace uvgrtp {
 
+    namespace crypto {
+        namespace aes {
+            class ctr;
+            class ecb;
+            class gcm;
+        }
+
+        namespace hmac {
+            class sha1;
+        }
+    }
+
+    /* Length of the authentication tag of SRTP and SRTCP packets.
+     * HMAC-SHA1 is truncated to 80 bits, AES-GCM always uses a 128-bit tag */
+    inline size_t srtp_auth_tag_length(int rce_flags)
+    {
+        return (rce_flags & RCE_SRTP_AES_GCM) ? UVG_GCM_TAG_LENGTH : UVG_AUTH_TAG_LENGTH;
+    }
+
     /* Vector of buffers that contain a full RTP frame */
     typedef std::vector<std::pair<size_t, uint8_t *>> buf_vec;
 
@@ -50,6 +77,7 @@ namespace uvgrtp {
 
     enum HTYPE {
         HMAC_SHA1 = 0,
+        AEAD_GCM  = 1  /* authentication is done by the AES-GCM cipher */
     };
 
     enum LABELS {
@@ -93,8 +121,38 @@ namespace uvgrtp {
         uint8_t *replay = nullptr; /* list of recently received and authenticated SRTP packets */
 
         int rce_flags = 0; /* context configuration flags */
+
+        /* Ciphers keyed with the session keys when the context is initialized,
+         * so each packet only sets its IV. The HMAC keeps its padded key between packets.
+         * AES-GCM replaces both with RCE_SRTP_AES_GCM */
+        std::shared_ptr<uvgrtp::crypto::aes::ctr> ctr;
+        std::shared_ptr<uvgrtp::crypto::hmac::sha1> hmac_sha1;
+        std::shared_ptr<uvgrtp::crypto::aes::gcm> gcm;
     } srtp_ctx_t;
 
+    /* Sliding replay window of RFC 3711 section 3.3.2
+     *
+     * Remembers which of the last UVG_REPLAY_WINDOW_SIZE indices before the highest received
+     * index have been seen, one bit per index. Older packets are rejected, because it is
+     * not known whether they have been received already */
+    class replay_window {
+        public:
+            replay_window();
+
+            /* Return true if "index" has been received or it is too old for the window.
+             * Otherwise mark it received and return false */
+            bool check_and_update(uint64_t index);
+
+        private:
+            bool test(uint64_t index) const;
+            void set(uint64_t index);
+            void clear(uint64_t index);
+
+            std::array<uint64_t, UVG_REPLAY_WINDOW_SIZE / 64> bits_;
+            uint64_t highest_;
+            bool initialized_;
+    };
+
     class base_srtp {
         public:
             base_srtp();
@@ -118,9 +176,10 @@ namespace uvgrtp {
             std::shared_ptr<srtp_ctx_t> get_local_ctx();
             std::shared_ptr<srtp_ctx_t> get_remote_ctx();
 
-            /* Returns true if the packet having this HMAC digest is replayed
+            /* Returns true if the authenticated packet with this index (ROC || SEQ for SRTP,
+             * SRTCP index for SRTCP) is replayed or older than the replay window
              * Returns false if replay protection has not been enabled */
-            bool is_replayed_packet(uint8_t *digest);
+            bool is_replayed_packet(uint64_t index);
 
             uint32_t get_key_size(int rce_flags) const;
 
@@ -130,7 +189,14 @@ namespace uvgrtp {
              *
              * Return RTP_OK on success and place the iv to "out"
              * Return RTP_INVALID_VALUE if one of the parameters is invalid */
-            rtp_error_t create_iv(uint8_t *out, uint32_t ssrc, uint64_t index, uint8_t *salt);
+            rtp_error_t create_iv(uint8_t *out, uint32_t ssrc, uint64_t index, const uint8_t *salt) const;
+
+            /* Create the 12-byte AES-GCM IV of RFC 7714: 00 00 || SSRC || 48-bit index, XORed
+             * with the session salt. The index is ROC || SEQ for SRTP and the SRTCP index for SRTCP
+             *
+             * Return RTP_OK on success and place the iv to "out"
+             * Return RTP_INVALID_VALUE if one of the parameters is invalid */
+            rtp_error_t create_gcm_iv(uint8_t *out, uint32_t ssrc, uint64_t index, const uint8_t *salt) const;
 
             /* SRTP context containing all session information and keys */
             std::shared_ptr<srtp_ctx_t> local_srtp_ctx_;  // for encryption
@@ -140,18 +206,21 @@ namespace uvgrtp {
              * encrypted but other security mechanisms described in RFC 3711 may be used */
             bool use_null_cipher_;
 
+            /* Is AES-GCM used instead of AES-CM and HMAC-SHA1? */
+            bool use_gcm_;
+
         private:
 
             rtp_error_t init_srtp_context(std::shared_ptr<srtp_ctx_t> context, int type, int rce_flags,
                 uint8_t* key, uint8_t* salt);
 
-            rtp_error_t derive_key(int label, size_t key_size, uint8_t *key, uint8_t *salt, uint8_t *out, size_t len);
+            rtp_error_t derive_key(int label, uvgrtp::crypto::aes::ecb& prf, uint8_t *salt, uint8_t *out, size_t len);
 
             void cleanup_context(std::shared_ptr<srtp_ctx_t> context);
 
-            /* Map containing all authentication tags of received packets (separate for SRTP and SRTCP)
+            /* Indices of recently received packets (separate for SRTP and SRTCP)
              * Used to implement replay protection */
-            std::unordered_set<uint64_t> replay_list_;
+            replay_window replay_window_;
     };
 }
 
@@ -8,6 +8,11 @@
 
 #define SET_FIELD_32(a, i, v)      do { *(uint32_t *)&(a)[i] = (v); } while (0)
 
+/* The RTCP header and sender SSRC and the E flag with the SRTCP index are the additional
+ * data of AES-GCM, the smallest packet has no payload after them */
+constexpr size_t RTCP_GCM_AAD_SIZE = 8 + UVG_SRTCP_INDEX_LENGTH;
+constexpr size_t RTCP_GCM_MIN_SIZE = 8 + UVG_GCM_TAG_LENGTH + UVG_SRTCP_INDEX_LENGTH;
+
 uvgrtp::srtcp::srtcp()
 {
 }
@@ -21,6 +26,9 @@ rtp_error_t uvgrtp::srtcp::handle_rtcp_encryption(int rce_flags, uint32_t packet
 {
     auto ret = RTP_OK;
 
+    if ((rce_flags & RCE_SRTP) && use_gcm_)
+        return encrypt_gcm(ssrc, packet_number, frame, frame_size);
+
     /* Encrypt the packet if NULL cipher has not been enabled,
      * calculate authentication tag for the packet and add SRTCP index at the end */
     if (rce_flags & RCE_SRTP) {
@@ -46,6 +54,10 @@ rtp_error_t uvgrtp::srtcp::handle_rtcp_decryption(int rce_flags, uint32_t ssrc,
     uint8_t* packet, size_t packet_size)
 {
     auto ret = RTP_OK;
+
+    if ((rce_flags & RCE_SRTP) && use_gcm_)
+        return decrypt_gcm(ssrc, packet, packet_size);
+
     auto srtpi = (*(uint32_t*)&packet[packet_size - UVG_SRTCP_INDEX_LENGTH - UVG_AUTH_TAG_LENGTH]);
 
     if (rce_flags & RCE_SRTP) {
@@ -54,6 +66,10 @@ rtp_error_t uvgrtp::srtcp::handle_rtcp_decryption(int rce_flags, uint32_t ssrc,
             return RTP_AUTH_TAG_MISMATCH;
         }
 
+        // the index is only trusted once the tag has been verified
+        if (is_replayed_packet(srtpi & 0x7fffffff))
+            return RTP_INVALID_VALUE;
+
         if (((srtpi >> 31) & 0x1) && !(rce_flags & RCE_SRTP_NULL_CIPHER)) {
             if (decrypt(ssrc, srtpi & 0x7fffffff, packet, packet_size) != RTP_OK) {
                 UVG_LOG_ERROR("Failed to decrypt RTCP Sender Report");
@@ -77,15 +93,84 @@ rtp_error_t uvgrtp::srtcp::encrypt(uint32_t ssrc, uint64_t seq, uint8_t *buffer,
         return RTP_INVALID_VALUE;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(local_srtp_ctx_->enc_key, local_srtp_ctx_->n_e, iv);
-    ctr.encrypt(buffer, buffer, len);
+    local_srtp_ctx_->ctr->resynchronize(iv);
+    local_srtp_ctx_->ctr->encrypt(buffer, buffer, len);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::srtcp::encrypt_gcm(uint32_t ssrc, uint32_t packet_number, uint8_t *frame, size_t frame_size)
+{
+    if (frame_size < RTCP_GCM_MIN_SIZE) {
+        UVG_LOG_ERROR("RTCP packet is too small to be encrypted");
+        return RTP_INVALID_VALUE;
+    }
+
+    uint8_t iv[UVG_GCM_IV_LENGTH] = { 0 };
+    uint8_t aad[RTCP_GCM_AAD_SIZE] = { 0 };
+    uint32_t srtcp_index = htonl((1u << 31) | (packet_number & 0x7fffffff));
+
+    if (create_gcm_iv(iv, ssrc, packet_number & 0x7fffffff, local_srtp_ctx_->salt_key) != RTP_OK) {
+        UVG_LOG_ERROR("Failed to create IV, unable to encrypt the RTCP packet!");
+        return RTP_INVALID_VALUE;
+    }
+
+    /* [header and sender SSRC | ciphertext | tag | E + SRTCP index], the index is
+     * authenticated with the header but not encrypted */
+    memcpy(&frame[frame_size - UVG_SRTCP_INDEX_LENGTH], &srtcp_index, UVG_SRTCP_INDEX_LENGTH);
+    memcpy(aad, frame, 8);
+    memcpy(&aad[8], &srtcp_index, UVG_SRTCP_INDEX_LENGTH);
+
+    local_srtp_ctx_->gcm->encrypt(iv, UVG_GCM_IV_LENGTH, aad, sizeof(aad),
+        &frame[8], frame_size - RTCP_GCM_MIN_SIZE,
+        &frame[frame_size - UVG_SRTCP_INDEX_LENGTH - UVG_GCM_TAG_LENGTH], UVG_GCM_TAG_LENGTH);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::srtcp::decrypt_gcm(uint32_t ssrc, uint8_t *packet, size_t packet_size)
+{
+    if (packet_size < RTCP_GCM_MIN_SIZE) {
+        UVG_LOG_ERROR("Received SRTCP packet that has too small size");
+        return RTP_INVALID_VALUE;
+    }
+
+    uint8_t iv[UVG_GCM_IV_LENGTH] = { 0 };
+    uint8_t aad[RTCP_GCM_AAD_SIZE] = { 0 };
+    uint8_t *tag = &packet[packet_size - UVG_SRTCP_INDEX_LENGTH - UVG_GCM_TAG_LENGTH];
+    uint32_t srtcp_index = 0;
+
+    memcpy(&srtcp_index, &packet[packet_size - UVG_SRTCP_INDEX_LENGTH], UVG_SRTCP_INDEX_LENGTH);
+    srtcp_index = ntohl(srtcp_index);
+
+    if (!((srtcp_index >> 31) & 0x1)) {
+        UVG_LOG_ERROR("Received unencrypted SRTCP packet while AES-GCM is used");
+        return RTP_AUTH_TAG_MISMATCH;
+    }
+
+    if (create_gcm_iv(iv, ssrc, srtcp_index & 0x7fffffff, remote_srtp_ctx_->salt_key) != RTP_OK) {
+        UVG_LOG_ERROR("Failed to create IV, unable to decrypt the RTCP packet!");
+        return RTP_INVALID_VALUE;
+    }
+
+    memcpy(aad, packet, 8);
+    memcpy(&aad[8], &packet[packet_size - UVG_SRTCP_INDEX_LENGTH], UVG_SRTCP_INDEX_LENGTH);
+
+    if (!remote_srtp_ctx_->gcm->decrypt(iv, UVG_GCM_IV_LENGTH, aad, sizeof(aad),
+            &packet[8], packet_size - RTCP_GCM_MIN_SIZE, tag, UVG_GCM_TAG_LENGTH)) {
+        UVG_LOG_ERROR("SRTCP authentication tag mismatch!");
+        return RTP_AUTH_TAG_MISMATCH;
+    }
+
+    if (is_replayed_packet(srtcp_index & 0x7fffffff))
+        return RTP_INVALID_VALUE;
 
     return RTP_OK;
 }
 
 rtp_error_t uvgrtp::srtcp::add_auth_tag(uint8_t *buffer, size_t len)
 {
-    auto hmac_sha1 = uvgrtp::crypto::hmac::sha1(local_srtp_ctx_->auth_key, UVG_AES_KEY_LENGTH);
+    auto& hmac_sha1 = *local_srtp_ctx_->hmac_sha1;
 
     hmac_sha1.update(buffer, len - UVG_AUTH_TAG_LENGTH);
     hmac_sha1.update((uint8_t *)&local_srtp_ctx_->roc, sizeof(local_srtp_ctx_->roc));
@@ -97,7 +182,7 @@ rtp_error_t uvgrtp::srtcp::add_auth_tag(uint8_t *buffer, size_t len)
 rtp_error_t uvgrtp::srtcp::verify_auth_tag(uint8_t *buffer, size_t len)
 {
     uint8_t digest[10] = { 0 };
-    auto hmac_sha1     = uvgrtp::crypto::hmac::sha1(remote_srtp_ctx_->auth_key, UVG_AES_KEY_LENGTH);
+    auto& hmac_sha1    = *remote_srtp_ctx_->hmac_sha1;
 
     hmac_sha1.update(buffer, len - UVG_AUTH_TAG_LENGTH);
     hmac_sha1.update((uint8_t *)&remote_srtp_ctx_->roc, sizeof(remote_srtp_ctx_->roc));
@@ -108,11 +193,6 @@ rtp_error_t uvgrtp::srtcp::verify_auth_tag(uint8_t *buffer, size_t len)
         return RTP_AUTH_TAG_MISMATCH;
     }
 
-    if (is_replayed_packet(digest)) {
-        UVG_LOG_ERROR("Replayed packet received, discarding!");
-        return RTP_INVALID_VALUE;
-    }
-
     return RTP_OK;
 }
 
@@ -125,9 +205,9 @@ rtp_error_t uvgrtp::srtcp::decrypt(uint32_t ssrc, uint32_t seq, uint8_t *buffer,
         return RTP_INVALID_VALUE;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(remote_srtp_ctx_->enc_key, remote_srtp_ctx_->n_e, iv);
+    remote_srtp_ctx_->ctr->resynchronize(iv);
 
     /* skip header and sender ssrc */
-    ctr.decrypt(&buffer[8], &buffer[8], size - 8 - UVG_AUTH_TAG_LENGTH - UVG_SRTCP_INDEX_LENGTH);
+    remote_srtp_ctx_->ctr->decrypt(&buffer[8], &buffer[8], size - 8 - UVG_AUTH_TAG_LENGTH - UVG_SRTCP_INDEX_LENGTH);
     return RTP_OK;
 }
@@ -29,6 +29,10 @@ namespace uvgrtp {
         rtp_error_t encrypt(uint32_t ssrc, uint64_t seq, uint8_t* buffer, size_t len);
         rtp_error_t decrypt(uint32_t ssrc, uint32_t seq, uint8_t* buffer, size_t len);
 
+        /* Encrypt and authenticate the packet with AES-GCM, see RFC 7714 section 9 */
+        rtp_error_t encrypt_gcm(uint32_t ssrc, uint32_t packet_number, uint8_t* frame, size_t frame_size);
+        rtp_error_t decrypt_gcm(uint32_t ssrc, uint8_t* packet, size_t packet_size);
+
         rtp_error_t add_auth_tag(uint8_t* buffer, size_t len);
         rtp_error_t verify_auth_tag(uint8_t* buffer, size_t len);
     };
@@ -4,6 +4,8 @@
 
 #include "../debug.hh"
 #include "../crypto.hh"
+#include "../stream_metrics.hh"
+#include "../trace.hh"
 #include "base.hh"
 #include "global.hh"
 
@@ -14,7 +16,7 @@
 #define MAX_OFF 10000
 
 uvgrtp::srtp::srtp(int rce_flags):base_srtp(),
-      authenticate_rtp_(rce_flags& RCE_SRTP_AUTHENTICATE_RTP)
+      authenticate_rtp_((rce_flags & RCE_SRTP_AUTHENTICATE_RTP) || (rce_flags & RCE_SRTP_AES_GCM))
 {}
 
 uvgrtp::srtp::~srtp()
@@ -40,58 +42,40 @@ rtp_error_t uvgrtp::srtp::encrypt(uint32_t ssrc, uint16_t seq, uint8_t *buffer,
         return RTP_INVALID_VALUE;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(local_srtp_ctx_->enc_key, local_srtp_ctx_->n_e, iv);
-    ctr.encrypt(buffer, buffer, len);
+    local_srtp_ctx_->ctr->resynchronize(iv);
+    local_srtp_ctx_->ctr->encrypt(buffer, buffer, len);
 
     return RTP_OK;
 }
 
-rtp_error_t uvgrtp::srtp::recv_packet_handler(void* args, int rce_flags, uint8_t* read_ptr, size_t size, uvgrtp::frame::rtp_frame** out)
+rtp_error_t uvgrtp::srtp::encrypt_gcm(uint32_t ssrc, uint16_t seq, uvgrtp::buf_vec& buffers)
 {
-    (void)rce_flags;
-    (void)read_ptr;
-    (void)size;
-
-    auto srtp  = (uvgrtp::srtp *)args;
-    auto remote_ctx   = srtp->get_remote_ctx();
-    auto frame = *out;
+    uint8_t iv[UVG_GCM_IV_LENGTH] = { 0 };
+    uint64_t index = (((uint64_t)local_srtp_ctx_->roc) << 16) + seq;
 
-    if (frame->dgram_size < RTP_HDR_SIZE || 
-        (srtp->authenticate_rtp() && frame->dgram_size < RTP_HDR_SIZE + UVG_AUTH_TAG_LENGTH))
+    if (seq == 0xffff)
     {
-        UVG_LOG_ERROR("Received SRTP packet that has too small size");
-        return RTP_GENERIC_ERROR;
+        local_srtp_ctx_->roc++;
+        UVG_LOG_DEBUG("SRTP encryption rollover, rollovers so far: %lu", local_srtp_ctx_->roc);
     }
 
-    /* Calculate authentication tag for the packet and compare it against the one we received */
-    if (srtp->authenticate_rtp()) {
-        uint8_t digest[10] = { 0 };
-        auto hmac_sha1     = uvgrtp::crypto::hmac::sha1(remote_ctx->auth_key, UVG_AUTH_LENGTH);
-
-        hmac_sha1.update(frame->dgram, frame->dgram_size - UVG_AUTH_TAG_LENGTH);
-        hmac_sha1.update((uint8_t *)&remote_ctx->roc, sizeof(remote_ctx->roc));
-        hmac_sha1.final((uint8_t *)digest, UVG_AUTH_TAG_LENGTH);
-
-        if (memcmp(digest, &frame->dgram[frame->dgram_size - UVG_AUTH_TAG_LENGTH], UVG_AUTH_TAG_LENGTH)) {
-            UVG_LOG_ERROR("Authentication tag mismatch!");
-            return RTP_GENERIC_ERROR;
-        }
-
-        if (srtp->is_replayed_packet(digest)) {
-            UVG_LOG_ERROR("Replayed packet received, discarding!");
-            return RTP_GENERIC_ERROR;
-        }
-        frame->payload_len -= UVG_AUTH_TAG_LENGTH;
+    if (create_gcm_iv(iv, ssrc, index, local_srtp_ctx_->salt_key) != RTP_OK) {
+        UVG_LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
+        return RTP_INVALID_VALUE;
     }
 
-    if (srtp->use_null_cipher())
-        return RTP_PKT_NOT_HANDLED;
+    /* [RTP header, ..., payload, tag], everything in front of the payload is authenticated */
+    auto& data = buffers.at(buffers.size() - 2);
+    auto& tag  = buffers.back();
 
-    uint16_t seq          = frame->header.seq;
-    uint32_t ssrc         = frame->header.ssrc;
-    uint32_t ts           = frame->header.timestamp;
-    uint64_t index        = 0;
+    aad_.assign(buffers.begin(), buffers.end() - 2);
+    local_srtp_ctx_->gcm->encrypt(iv, UVG_GCM_IV_LENGTH, aad_, data.second, data.first, tag.second, tag.first);
 
+    return RTP_OK;
+}
+
+uint64_t uvgrtp::srtp::estimate_remote_index(uint16_t seq, uint32_t ts) const
+{
     /* as the sequence number approaches 0xffff and is close to wrapping around,
      * special care must be taken to use correct rollover counter as it's
      * possible that packets come out of order around this overflow boundary
@@ -103,72 +87,292 @@ rtp_error_t uvgrtp::srtp::recv_packet_handler(void* args, int rce_flags, uint8_t
      * because if the difference is more than 1, the input frame would be larger than 90 MB.
      *
      * Here the assumption is that the offset for an incorrectly ordered packet is at most 10k packets*/
-    if (ts == remote_ctx->rts && (uint16_t)(seq + MAX_OFF) < MAX_OFF)
+    if (ts == remote_srtp_ctx_->rts && (uint16_t)(seq + MAX_OFF) < MAX_OFF)
     {
-        index = (((uint64_t)remote_ctx->roc - 1) << 16) + seq;
+        return (((uint64_t)remote_srtp_ctx_->roc - 1) << 16) + seq;
     }
-    else
+
+    return (((uint64_t)remote_srtp_ctx_->roc) << 16) + seq;
+}
+
+void uvgrtp::srtp::update_remote_rollover(uint16_t seq, uint32_t ts)
+{
+    /* Sequence number has wrapped around, update rollover Counter */
+    if (seq == 0xffff && !use_null_cipher_) {
+        remote_srtp_ctx_->roc++;
+        remote_srtp_ctx_->rts = ts;
+        UVG_LOG_DEBUG("SRTP decryption rollover, rollovers so far: %lu", remote_srtp_ctx_->roc);
+    }
+}
+
+uvgrtp::srtp::receive_ciphers uvgrtp::srtp::get_context_ciphers() const
+{
+    return { remote_srtp_ctx_->ctr, remote_srtp_ctx_->hmac_sha1, remote_srtp_ctx_->gcm };
+}
+
+rtp_error_t uvgrtp::srtp::unprotect(uvgrtp::frame::rtp_frame *frame, uint64_t index, uint32_t roc,
+    const receive_ciphers& ciphers) const
+{
+    if (frame->dgram_size < RTP_HDR_SIZE || 
+        (authenticate_rtp() && frame->dgram_size < RTP_HDR_SIZE + UVG_AUTH_TAG_LENGTH))
     {
-        index = (((uint64_t)remote_ctx->roc) << 16) + seq;
+        UVG_LOG_ERROR("Received SRTP packet that has too small size");
+        return RTP_GENERIC_ERROR;
     }
 
-    /* Sequence number has wrapped around, update rollover Counter */
-    if (seq == 0xffff) {
-        remote_ctx->roc++;
-        remote_ctx->rts = ts;
-        UVG_LOG_DEBUG("SRTP decryption rollover, rollovers so far: %lu", remote_ctx->roc);
+    /* AES-GCM decrypts and verifies the packet in one pass. The parsed RTP header,
+     * including CSRCs and the extension, is the additional data */
+    if (use_gcm_) {
+        size_t header_len = frame->payload - frame->dgram;
+
+        if (frame->dgram_size < header_len + UVG_GCM_TAG_LENGTH) {
+            UVG_LOG_ERROR("Received SRTP packet that has too small size");
+            return RTP_GENERIC_ERROR;
+        }
+
+        uint8_t iv[UVG_GCM_IV_LENGTH] = { 0 };
+        uint8_t *tag  = &frame->dgram[frame->dgram_size - UVG_GCM_TAG_LENGTH];
+
+        if (create_gcm_iv(iv, frame->header.ssrc, index, remote_srtp_ctx_->salt_key) != RTP_OK) {
+            UVG_LOG_ERROR("Failed to create IV, unable to decrypt the RTP packet!");
+            return RTP_GENERIC_ERROR;
+        }
+
+        frame->payload_len = frame->dgram_size - header_len - UVG_GCM_TAG_LENGTH;
+
+        if (!ciphers.gcm->decrypt(iv, UVG_GCM_IV_LENGTH, frame->dgram, header_len,
+                frame->payload, frame->payload_len, tag, UVG_GCM_TAG_LENGTH)) {
+            UVG_LOG_ERROR("Authentication tag mismatch!");
+            if (metrics_)
+                metrics_->count(uvgrtp::stream_metrics::SRTP_AUTH_FAILURES);
+            return RTP_GENERIC_ERROR;
+        }
+
+        return RTP_PKT_MODIFIED;
+    }
+
+    /* Calculate authentication tag for the packet and compare it against the one we received */
+    if (authenticate_rtp()) {
+        uint8_t digest[10] = { 0 };
+        auto& hmac_sha1    = *ciphers.hmac_sha1;
+
+        hmac_sha1.update(frame->dgram, frame->dgram_size - UVG_AUTH_TAG_LENGTH);
+        hmac_sha1.update((uint8_t *)&roc, sizeof(roc));
+        hmac_sha1.final((uint8_t *)digest, UVG_AUTH_TAG_LENGTH);
+
+        if (memcmp(digest, &frame->dgram[frame->dgram_size - UVG_AUTH_TAG_LENGTH], UVG_AUTH_TAG_LENGTH)) {
+            UVG_LOG_ERROR("Authentication tag mismatch!");
+            if (metrics_)
+                metrics_->count(uvgrtp::stream_metrics::SRTP_AUTH_FAILURES);
+            return RTP_GENERIC_ERROR;
+        }
+        frame->payload_len -= UVG_AUTH_TAG_LENGTH;
     }
 
+    if (use_null_cipher_)
+        return RTP_PKT_NOT_HANDLED;
+
     uint8_t iv[UVG_IV_LENGTH] = { 0 };
-    if (srtp->create_iv(iv, ssrc, index, remote_ctx->salt_key) != RTP_OK) {
+    if (create_iv(iv, frame->header.ssrc, index, remote_srtp_ctx_->salt_key) != RTP_OK) {
         UVG_LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
         return RTP_GENERIC_ERROR;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(remote_ctx->enc_key, remote_ctx->n_e, iv);
-    ctr.decrypt(frame->payload, frame->payload, frame->payload_len);
+    ciphers.ctr->resynchronize(iv);
+    ciphers.ctr->decrypt(frame->payload, frame->payload, frame->payload_len);
 
     return RTP_PKT_MODIFIED;
 }
 
-rtp_error_t uvgrtp::srtp::send_packet_handler(void *arg, uvgrtp::buf_vec& buffers)
+rtp_error_t uvgrtp::srtp::recv_packet_handler(void* args, int rce_flags, uint8_t* read_ptr, size_t size, uvgrtp::frame::rtp_frame** out)
+{
+    (void)rce_flags;
+    (void)read_ptr;
+    (void)size;
+
+    auto srtp  = (uvgrtp::srtp *)args;
+    auto frame = *out;
+
+    uint32_t roc    = srtp->remote_srtp_ctx_->roc;
+    uint64_t index  = srtp->estimate_remote_index(frame->header.seq, frame->header.timestamp);
+    rtp_error_t ret = srtp->unprotect(frame, index, roc, srtp->get_context_ciphers());
+
+    if (ret == RTP_GENERIC_ERROR)
+        return ret;
+
+    if (srtp->authenticate_rtp() && srtp->is_replayed_packet(index)) {
+        UVG_LOG_ERROR("Replayed packet received, discarding!");
+        if (srtp->metrics_)
+            srtp->metrics_->count(uvgrtp::stream_metrics::SRTP_REPLAYED_PACKETS);
+        return RTP_GENERIC_ERROR;
+    }
+
+    srtp->update_remote_rollover(frame->header.seq, frame->header.timestamp);
+    return ret;
+}
+
+rtp_error_t uvgrtp::srtp::set_decrypt_threads(size_t threads)
+{
+    if (threads > MAX_DECRYPT_THREADS)
+        return RTP_INVALID_VALUE;
+
+    pool_.resize(threads);
+    worker_ciphers_.clear();
+    return RTP_OK;
+}
+
+size_t uvgrtp::srtp::get_decrypt_threads() const
+{
+    return pool_.size();
+}
+
+void uvgrtp::srtp::set_metrics(std::shared_ptr<uvgrtp::stream_metrics> metrics)
+{
+    metrics_ = metrics;
+}
+
+void uvgrtp::srtp::recv_batch_handler(std::vector<uvgrtp::frame::rtp_frame *>& frames, std::vector<rtp_error_t>& results)
+{
+    const size_t count = frames.size();
+
+    /* The ciphers are keyed once per worker. The keys are known when the first packet arrives */
+    if (worker_ciphers_.size() != pool_.size() + 1) {
+        const size_t key_size = remote_srtp_ctx_->n_e;
+
+        worker_ciphers_.assign(1, get_context_ciphers());
+        for (size_t i = 0; i < pool_.size(); ++i) {
+            receive_ciphers ciphers;
+
+            if (use_gcm_) {
+                ciphers.gcm = std::make_shared<uvgrtp::crypto::aes::gcm>(remote_srtp_ctx_->enc_key, key_size);
+            } else {
+                ciphers.ctr = std::make_shared<uvgrtp::crypto::aes::ctr>(remote_srtp_ctx_->enc_key, key_size);
+                ciphers.hmac_sha1 = std::make_shared<uvgrtp::crypto::hmac::sha1>(remote_srtp_ctx_->auth_key, UVG_AUTH_LENGTH);
+            }
+            worker_ciphers_.push_back(ciphers);
+        }
+    }
+
+    results.assign(count, RTP_PKT_NOT_HANDLED);
+    batch_index_.resize(count);
+    batch_roc_.resize(count);
+    batch_done_.assign(count, false);
+
+    /* The index of each packet depends on the rollovers before it, so it is estimated
+     * in order. A packet that ends a rollover is verified right away, so that a forged
+     * packet cannot move the ROC of the packets after it */
+    for (size_t i = 0; i < count; ++i) {
+        auto frame = frames[i];
+
+        batch_roc_[i]   = remote_srtp_ctx_->roc;
+        batch_index_[i] = estimate_remote_index(frame->header.seq, frame->header.timestamp);
+
+        if (frame->header.seq == 0xffff) {
+            results[i]     = unprotect(frame, batch_index_[i], batch_roc_[i], worker_ciphers_[0]);
+            batch_done_[i] = true;
+
+            if (results[i] != RTP_GENERIC_ERROR)
+                update_remote_rollover(frame->header.seq, frame->header.timestamp);
+        }
+    }
+
+    pool_.run(count, [this, &frames, &results](size_t begin, size_t end, size_t worker) {
+        for (size_t i = begin; i < end; ++i) {
+            if (!batch_done_[i])
+                results[i] = unprotect(frames[i], batch_index_[i], batch_roc_[i], worker_ciphers_[worker]);
+        }
+    });
+
+    // the replay window is updated in order, as with packets that are handled one by one
+    for (size_t i = 0; i < count; ++i) {
+        if (results[i] != RTP_GENERIC_ERROR && authenticate_rtp() && is_replayed_packet(batch_index_[i])) {
+            UVG_LOG_ERROR("Replayed packet received, discarding!");
+            if (metrics_)
+                metrics_->count(uvgrtp::stream_metrics::SRTP_REPLAYED_PACKETS);
+            results[i] = RTP_GENERIC_ERROR;
+        }
+    }
+}
+
+rtp_error_t uvgrtp::srtp::encrypt_packet(uvgrtp::buf_vec& buffers)
 {
-    auto srtp       = (uvgrtp::srtp *)arg;
     auto frame      = (uvgrtp::frame::rtp_frame *)buffers.at(0).second;
-    auto local_ctx   = srtp->get_local_ctx();
-    auto off        = srtp->authenticate_rtp() ? 2 : 1;
+    auto off        = authenticate_rtp() ? 2 : 1;
     auto data       = buffers.at(buffers.size() - off);
-    auto hmac_sha1  = uvgrtp::crypto::hmac::sha1(local_ctx->auth_key, UVG_AUTH_LENGTH);
     rtp_error_t ret = RTP_OK;
 
-    if (srtp->use_null_cipher())
-        goto authenticate;
+    UVG_TRACE(SRTP_ENCRYPT, ntohl(frame->header.ssrc), ntohs(frame->header.seq), data.first);
+
+    if (use_gcm_)
+        return encrypt_gcm(ntohl(frame->header.ssrc), ntohs(frame->header.seq), buffers);
 
-    ret = srtp->encrypt(
+    if (use_null_cipher())
+        return RTP_OK;
+
+    ret = encrypt(
         ntohl(frame->header.ssrc),
         ntohs(frame->header.seq),
         data.second,
         data.first
     );
 
-    if (ret != RTP_OK) {
+    if (ret != RTP_OK)
         UVG_LOG_ERROR("Failed to encrypt RTP packet!");
-        return ret;
-    }
 
-authenticate:
-    if (!srtp->authenticate_rtp())
-        return RTP_OK;
+    return ret;
+}
+
+void uvgrtp::srtp::authenticate_packet(uvgrtp::buf_vec& buffers, uint32_t roc)
+{
+    auto& hmac_sha1 = *local_srtp_ctx_->hmac_sha1;
 
     for (size_t i = 0; i < buffers.size() - 1; ++i)
         hmac_sha1.update((uint8_t *)buffers[i].second, buffers[i].first);
 
-    hmac_sha1.update((uint8_t *)&local_ctx->roc, sizeof(local_ctx->roc));
+    hmac_sha1.update((uint8_t *)&roc, sizeof(roc));
     hmac_sha1.final((uint8_t *)buffers[buffers.size() - 1].second, UVG_AUTH_TAG_LENGTH);
+}
+
+rtp_error_t uvgrtp::srtp::send_packet_handler(void *arg, uvgrtp::buf_vec& buffers)
+{
+    auto srtp       = (uvgrtp::srtp *)arg;
+    uint32_t roc    = srtp->local_srtp_ctx_->roc;
+    rtp_error_t ret = srtp->encrypt_packet(buffers);
+
+    if (ret == RTP_OK && srtp->authenticate_rtp() && !srtp->use_gcm_)
+        srtp->authenticate_packet(buffers, roc);
 
     return ret;
 }
 
+rtp_error_t uvgrtp::srtp::send_frame_handler(void *arg, std::vector<uvgrtp::buf_vec>& packets)
+{
+    auto srtp       = (uvgrtp::srtp *)arg;
+    uint32_t roc    = srtp->local_srtp_ctx_->roc;
+    rtp_error_t ret = RTP_OK;
+
+    for (auto& packet : packets) {
+        if ((ret = srtp->encrypt_packet(packet)) != RTP_OK)
+            return ret;
+    }
+
+    if (!srtp->authenticate_rtp() || srtp->use_gcm_)
+        return RTP_OK;
+
+    /* encryption has already moved the ROC past the frame, so follow the
+     * rollovers again to authenticate each packet with its own ROC */
+    for (auto& packet : packets) {
+        auto frame = (uvgrtp::frame::rtp_frame *)packet.at(0).second;
+
+        srtp->authenticate_packet(packet, roc);
+
+        if (!srtp->use_null_cipher() && ntohs(frame->header.seq) == 0xffff)
+            ++roc;
+    }
+
+    return RTP_OK;
+}
+
 bool uvgrtp::srtp::authenticate_rtp() const
 {
     return authenticate_rtp_;
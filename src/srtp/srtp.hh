@@ -2,12 +2,22 @@
 
 #include "base.hh"
 
+#include "../worker_pool.hh"
+
+#include <memory>
+#include <vector>
+
 namespace uvgrtp {
 
+    /* Most worker threads one stream can use for decrypting, see RCC_SRTP_DECRYPT_THREADS */
+    constexpr size_t MAX_DECRYPT_THREADS = 64;
+
     namespace frame {
         struct rtp_frame;
     }
 
+    class stream_metrics;
+
     class srtp : public base_srtp {
         public:
             srtp(int rce_flags);
@@ -19,19 +29,96 @@ namespace uvgrtp {
             /* Encrypt the payload of an RTP packet and add authentication tag (if enabled) */
             static rtp_error_t send_packet_handler(void *arg, buf_vec& buffers);
 
+            /* Encrypt and authenticate all packets of a frame. All payloads are encrypted
+             * first and then all tags are computed, so the cipher and the HMAC each stay
+             * hot in the cache for the whole frame instead of alternating per packet */
+            static rtp_error_t send_frame_handler(void *arg, std::vector<buf_vec>& packets);
+
+            /* Verify and decrypt a batch of received packets of this stream and place the result
+             * recv_packet_handler() would have returned for each packet to "results".
+             *
+             * The packets are independent once their index is known, so they are processed
+             * by the decryption threads in parallel. The ROC and the replay window are still
+             * updated in the order of the packets */
+            void recv_batch_handler(std::vector<uvgrtp::frame::rtp_frame *>& frames, std::vector<rtp_error_t>& results);
+
+            /* Set the number of threads that decrypt in addition to the reception thread
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "threads" is larger than MAX_DECRYPT_THREADS */
+            rtp_error_t set_decrypt_threads(size_t threads);
+            size_t get_decrypt_threads() const;
+
+            /* Count the rejected packets in "metrics", see media_stream::get_stats() */
+            void set_metrics(std::shared_ptr<uvgrtp::stream_metrics> metrics);
+
         private:
             /* TODO:  */
             rtp_error_t encrypt(uint32_t ssrc, uint16_t seq, uint8_t* buffer, size_t len);
 
+            /* Encrypt the payload of one outgoing packet, or encrypt and authenticate it with AES-GCM */
+            rtp_error_t encrypt_packet(buf_vec& buffers);
+
+            /* Write the HMAC-SHA1 tag of one outgoing packet to its last buffer. "roc" is
+             * the rollover counter the packet was encrypted with */
+            void authenticate_packet(buf_vec& buffers, uint32_t roc);
+
+            /* Encrypt the payload of the packet in "buffers" with AES-GCM and write the tag
+             * to the last buffer. The buffers before the payload are the additional data */
+            rtp_error_t encrypt_gcm(uint32_t ssrc, uint16_t seq, buf_vec& buffers);
+
+            /* Decryption state of one thread, the ciphers cannot be shared between threads */
+            struct receive_ciphers {
+                std::shared_ptr<uvgrtp::crypto::aes::ctr> ctr;
+                std::shared_ptr<uvgrtp::crypto::hmac::sha1> hmac_sha1;
+                std::shared_ptr<uvgrtp::crypto::aes::gcm> gcm;
+            };
+
+            /* Return the SRTP index (ROC || SEQ) of a received packet */
+            uint64_t estimate_remote_index(uint16_t seq, uint32_t ts) const;
+
+            /* Move to the next ROC after the packet with the last sequence number has been verified */
+            void update_remote_rollover(uint16_t seq, uint32_t ts);
+
+            /* The ciphers of the remote context, used by the reception thread */
+            receive_ciphers get_context_ciphers() const;
+
+            /* Verify and decrypt one received packet with "ciphers". Does not change the state
+             * of the context, so packets can be unprotected in parallel
+             *
+             * Return RTP_PKT_MODIFIED if the payload was decrypted
+             * Return RTP_PKT_NOT_HANDLED if the NULL cipher is used
+             * Return RTP_GENERIC_ERROR if the packet is too small or its tag does not match */
+            rtp_error_t unprotect(uvgrtp::frame::rtp_frame *frame, uint64_t index, uint32_t roc,
+                const receive_ciphers& ciphers) const;
+
+
             /* Has RTP packet authentication been enabled? */
             bool authenticate_rtp() const;
 
             /* By default RTP packet authentication is disabled but by
              * giving RCE_SRTP_AUTHENTICATE_RTP to create_stream() user can enable it.
              *
-             * The authentication tag will occupy the last 8 bytes of the RTP packet */
+             * The authentication tag will occupy the last 10 bytes of the RTP packet,
+             * or the last 16 bytes with AES-GCM which always authenticates the packets */
             bool authenticate_rtp_;
 
+            /* Additional data buffers of the packet being encrypted with AES-GCM */
+            buf_vec aad_;
+
+            uvgrtp::worker_pool pool_;
+
+            /* Ciphers of the reception thread and each decryption thread */
+            std::vector<receive_ciphers> worker_ciphers_;
+
+            /* Index, ROC and whether the packet is already done for each packet of a batch */
+            std::vector<uint64_t> batch_index_;
+            std::vector<uint32_t> batch_roc_;
+            std::vector<bool> batch_done_;
+
+            /* Updated from the decryption threads too, the counters are atomic */
+            std::shared_ptr<uvgrtp::stream_metrics> metrics_;
+
     };
 }
 
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* Finds the entry of an SSRC for the thread that processes the received packets without
+     * locks, so that a socket shared by many streams costs one probe per looked up SSRC.
+     *
+     * The entries are kept in an immutable snapshot with a small open-addressing table of
+     * SSRCs and the entries next to it. A change to the entries builds a new snapshot and
+     * swaps it in atomically. The reader announces the snapshot it uses with a hazard pointer
+     * and a replaced snapshot is freed once the reader does not use it anymore.
+     *
+     * There is one reader at a time, which is the case for the packets of a reception flow.
+     * The writers must be serialized by the caller */
+    template <typename T>
+    class ssrc_demux {
+        public:
+            class snapshot {
+                public:
+                    /* Return the entry of "ssrc" or nullptr if there is none */
+                    T *find(uint32_t ssrc)
+                    {
+                        if (entries_.empty())
+                            return nullptr;
+
+                        for (size_t i = hash(ssrc);; i = (i + 1) & mask_) {
+                            const slot& s = slots_[i];
+
+                            if (s.index == 0)
+                                return nullptr;
+
+                            if (s.ssrc == ssrc)
+                                return &entries_[s.index - 1];
+                        }
+                    }
+
+                    size_t size() const
+                    {
+                        return entries_.size();
+                    }
+
+                    /* The only entry when there is one */
+                    T *first()
+                    {
+                        return entries_.empty() ? nullptr : &entries_[0];
+                    }
+
+                private:
+                    friend class ssrc_demux;
+
+                    explicit snapshot(const std::unordered_map<uint32_t, T>& entries) :
+                        slots_(),
+                        entries_(),
+                        mask_(0),
+                        shift_(0)
+                    {
+                        // at most half of the slots are in use, so the probe sequences stay short
+                        size_t bits = 3;
+                        while (((size_t)1 << bits) < entries.size() * 2) {
+                            ++bits;
+                        }
+
+                        slots_.resize((size_t)1 << bits);
+                        mask_  = slots_.size() - 1;
+                        shift_ = 32 - bits;
+
+                        entries_.reserve(entries.size());
+                        for (auto& entry : entries) {
+                            entries_.push_back(entry.second);
+
+                            size_t i = hash(entry.first);
+                            while (slots_[i].index != 0) {
+                                i = (i + 1) & mask_;
+                            }
+                            slots_[i].ssrc  = entry.first;
+                            slots_[i].index = (uint32_t)entries_.size();
+                        }
+                    }
+
+                    size_t hash(uint32_t ssrc) const
+                    {
+                        // Fibonacci hashing spreads sequential SSRCs over the table
+                        return (size_t)((ssrc * 2654435769u) >> shift_) & mask_;
+                    }
+
+                    struct slot {
+                        uint32_t ssrc = 0;
+                        uint32_t index = 0; // index of the entry + 1, 0 for an empty slot
+                    };
+
+                    std::vector<slot> slots_;
+                    std::vector<T> entries_;
+                    size_t mask_;
+                    uint32_t shift_;
+            };
+
+            ssrc_demux() :
+                current_(new snapshot({})),
+                hazard_(nullptr),
+                retired_()
+            {
+            }
+
+            ~ssrc_demux()
+            {
+                delete current_.load();
+            }
+
+            ssrc_demux(const ssrc_demux&) = delete;
+            ssrc_demux& operator=(const ssrc_demux&) = delete;
+
+            /* Replace the entries with "entries" */
+            void publish(const std::unordered_map<uint32_t, T>& entries)
+            {
+                retired_.emplace_back(current_.exchange(new snapshot(entries)));
+
+                // the reader may still be using the snapshot that it has announced
+                snapshot *used = hazard_.load();
+                for (auto it = retired_.begin(); it != retired_.end();) {
+                    if (it->get() != used) {
+                        it = retired_.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+
+            /* Get the current snapshot for the reader. It stays valid until leave() */
+            snapshot *enter()
+            {
+                snapshot *s = current_.load();
+
+                // the snapshot may have been replaced and freed before it was announced
+                while (true) {
+                    hazard_.store(s);
+
+                    snapshot *again = current_.load();
+                    if (again == s)
+                        return s;
+                    s = again;
+                }
+            }
+
+            void leave()
+            {
+                hazard_.store(nullptr);
+            }
+
+        private:
+            std::atomic<snapshot *> current_;
+            std::atomic<snapshot *> hazard_;
+
+            /* Replaced snapshots that the reader may still be using */
+            std::vector<std::unique_ptr<snapshot>> retired_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
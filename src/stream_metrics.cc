@@ -0,0 +1,66 @@
+#include "stream_metrics.hh"
+
+uvgrtp::stream_metrics::stream_metrics()
+{
+    for (auto& c : counters_) {
+        c.store(0, std::memory_order_relaxed);
+    }
+
+    for (auto& h : histograms_) {
+        for (auto& b : h.buckets) {
+            b.store(0, std::memory_order_relaxed);
+        }
+        h.count.store(0, std::memory_order_relaxed);
+        h.sum.store(0, std::memory_order_relaxed);
+    }
+
+    profile_interval_.store(0, std::memory_order_relaxed);
+    for (auto& s : samples_) {
+        s.store(0, std::memory_order_relaxed);
+    }
+}
+
+void uvgrtp::stream_metrics::copy(const atomic_histogram& from, uvgrtp::stats_histogram& to) const
+{
+    for (size_t i = 0; i < STATS_HISTOGRAM_BUCKETS; ++i) {
+        to.buckets[i] = from.buckets[i].load(std::memory_order_relaxed);
+    }
+    to.count = from.count.load(std::memory_order_relaxed);
+    to.sum   = from.sum.load(std::memory_order_relaxed);
+}
+
+void uvgrtp::stream_metrics::snapshot(uvgrtp::stream_stats& stats) const
+{
+    auto get = [this](counter c) {
+        return counters_[c].load(std::memory_order_relaxed);
+    };
+
+    stats.sent_frames           = get(SENT_FRAMES);
+    stats.sent_bytes            = get(SENT_BYTES);
+    stats.sent_packets          = get(SENT_PACKETS);
+    stats.send_errors           = get(SEND_ERRORS);
+    stats.received_packets      = get(RECEIVED_PACKETS);
+    stats.received_bytes        = get(RECEIVED_BYTES);
+    stats.received_frames       = get(RECEIVED_FRAMES);
+    stats.duplicate_packets     = get(DUPLICATE_PACKETS);
+    stats.late_packets          = get(LATE_PACKETS);
+    stats.dropped_frames        = get(DROPPED_FRAMES);
+    stats.late_frames           = get(LATE_FRAMES);
+    stats.skipped_frames        = get(SKIPPED_FRAMES);
+    stats.srtp_auth_failures    = get(SRTP_AUTH_FAILURES);
+    stats.srtp_replayed_packets = get(SRTP_REPLAYED_PACKETS);
+    stats.shed_frames           = get(SHED_FRAMES);
+    stats.merged_packets        = get(MERGED_PACKETS);
+
+    copy(histograms_[REASSEMBLY_LATENCY_US], stats.reassembly_latency_us);
+    copy(histograms_[QUEUE_DEPTH],           stats.queue_depth);
+    copy(histograms_[SEND_BATCH_SIZE],       stats.send_batch_size);
+    copy(histograms_[SEND_DELAY_US],         stats.send_delay_us);
+    copy(histograms_[STAGE_DEMUX_NS],        stats.stage_demux_ns);
+    copy(histograms_[STAGE_SRTP_NS],         stats.stage_srtp_ns);
+    copy(histograms_[STAGE_REASSEMBLY_NS],   stats.stage_reassembly_ns);
+    copy(histograms_[STAGE_DELIVERY_NS],     stats.stage_delivery_ns);
+    copy(histograms_[STAGE_PACKETIZE_NS],    stats.stage_packetize_ns);
+    copy(histograms_[STAGE_FANOUT_NS],       stats.stage_fanout_ns);
+    copy(histograms_[STAGE_SEND_NS],         stats.stage_send_ns);
+}
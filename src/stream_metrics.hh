@@ -0,0 +1,148 @@
+#pragma once
+
+#include "uvgrtp/media_stream.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace uvgrtp {
+
+    /* The counters of the data path of one stream, see media_stream::get_stats().
+     *
+     * The components of the stream update the counters as they process the packets. Each
+     * update is one relaxed atomic addition, so the counters can be updated from the sending,
+     * receiving and decrypting threads at the same time without locks and left on when the
+     * stream is not being inspected */
+    class stream_metrics {
+        public:
+            enum counter {
+                SENT_FRAMES,
+                SENT_BYTES,
+                SENT_PACKETS,
+                SEND_ERRORS,
+                RECEIVED_PACKETS,
+                RECEIVED_BYTES,
+                RECEIVED_FRAMES,
+                DUPLICATE_PACKETS,
+                LATE_PACKETS,
+                DROPPED_FRAMES,
+                LATE_FRAMES,
+                SKIPPED_FRAMES,
+                SRTP_AUTH_FAILURES,
+                SRTP_REPLAYED_PACKETS,
+                SHED_FRAMES,
+                MERGED_PACKETS,
+                NUM_COUNTERS
+            };
+
+            enum histogram {
+                REASSEMBLY_LATENCY_US,
+                QUEUE_DEPTH,
+                SEND_BATCH_SIZE,
+                SEND_DELAY_US,
+                STAGE_DEMUX_NS,
+                STAGE_SRTP_NS,
+                STAGE_REASSEMBLY_NS,
+                STAGE_DELIVERY_NS,
+                STAGE_PACKETIZE_NS,
+                STAGE_FANOUT_NS,
+                STAGE_SEND_NS,
+                NUM_HISTOGRAMS
+            };
+
+            /* The points where the stages of the data path are sampled, see sample() */
+            enum profile_point {
+                PROFILE_PACKET,
+                PROFILE_FRAME,
+                PROFILE_SEND,
+                NUM_PROFILE_POINTS
+            };
+
+            stream_metrics();
+
+            void count(counter c, uint64_t n = 1)
+            {
+                counters_[c].fetch_add(n, std::memory_order_relaxed);
+            }
+
+            void record(histogram h, uint64_t value)
+            {
+                atomic_histogram& hist = histograms_[h];
+
+                hist.buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+                hist.count.fetch_add(1, std::memory_order_relaxed);
+                hist.sum.fetch_add(value, std::memory_order_relaxed);
+            }
+
+            /* Time the stages of one in every "interval" packets and frames, 0 disables the
+             * profiling, see RCC_PROFILE_SAMPLING */
+            void set_profile_interval(uint32_t interval)
+            {
+                profile_interval_.store(interval, std::memory_order_relaxed);
+            }
+
+            uint32_t profile_interval() const
+            {
+                return profile_interval_.load(std::memory_order_relaxed);
+            }
+
+            /* Returns true if the packet or frame at "point" should be timed. Each point counts
+             * its own calls, so the sampling of one does not skew the others */
+            bool sample(profile_point point)
+            {
+                uint32_t interval = profile_interval_.load(std::memory_order_relaxed);
+                if (interval == 0)
+                    return false;
+
+                return samples_[point].fetch_add(1, std::memory_order_relaxed) % interval == 0;
+            }
+
+            /* Record the nanoseconds since "start" in the histogram of a stage */
+            void record_stage(histogram h, std::chrono::steady_clock::time_point start)
+            {
+                record(h, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+            }
+
+            /* The bucket of "value" in stats_histogram */
+            static size_t bucket(uint64_t value)
+            {
+                if (value == 0)
+                    return 0;
+
+                // the bucket is the number of significant bits of the value
+#if defined(__GNUC__) || defined(__clang__)
+                size_t bits = 64 - (size_t)__builtin_clzll(value);
+#else
+                size_t bits = 0;
+                for (uint64_t v = value; v != 0; v >>= 1) {
+                    ++bits;
+                }
+#endif
+                return bits < STATS_HISTOGRAM_BUCKETS ? bits : STATS_HISTOGRAM_BUCKETS - 1;
+            }
+
+            /* Copy the counters to "stats". The counters of other components, such as the
+             * ring buffer of the socket, are not touched */
+            void snapshot(uvgrtp::stream_stats& stats) const;
+
+        private:
+            struct atomic_histogram {
+                std::atomic<uint64_t> buckets[STATS_HISTOGRAM_BUCKETS];
+                std::atomic<uint64_t> count;
+                std::atomic<uint64_t> sum;
+            };
+
+            void copy(const atomic_histogram& from, uvgrtp::stats_histogram& to) const;
+
+            std::atomic<uint64_t> counters_[NUM_COUNTERS];
+            atomic_histogram histograms_[NUM_HISTOGRAMS];
+
+            std::atomic<uint32_t> profile_interval_;
+            std::atomic<uint64_t> samples_[NUM_PROFILE_POINTS];
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
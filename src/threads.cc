@@ -0,0 +1,237 @@
+#include "threads.hh"
+
+#include "debug.hh"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include <string>
+
+/* Linux limits the names of the threads to 15 characters */
+constexpr size_t MAX_THREAD_NAME = 15;
+
+/* Priorities of the real-time policies on the platforms that do not define their own range */
+constexpr int MIN_THREAD_PRIORITY = 1;
+constexpr int MAX_THREAD_PRIORITY = 99;
+
+static const char *DEFAULT_THREAD_NAMES[RTP_THREAD_LAST] = {
+    "uvgrtp-recv",
+    "uvgrtp-proc",
+    "uvgrtp-playout",
+    "uvgrtp-rtcp",
+    "uvgrtp-punch",
+    "uvgrtp-send"
+};
+
+uvgrtp::thread_settings::thread_settings() :
+    mutex_(),
+    configs_()
+{
+}
+
+rtp_error_t uvgrtp::thread_settings::check(const uvgrtp::thread_config& config)
+{
+    if (config.policy < RTP_SCHED_DEFAULT || config.policy >= RTP_SCHED_LAST) {
+        UVG_LOG_ERROR("Unknown scheduling policy %d", config.policy);
+        return RTP_INVALID_VALUE;
+    }
+
+    if (config.policy == RTP_SCHED_FIFO || config.policy == RTP_SCHED_RR) {
+#ifndef _WIN32
+        int policy = config.policy == RTP_SCHED_FIFO ? SCHED_FIFO : SCHED_RR;
+        int min_priority = sched_get_priority_min(policy);
+        int max_priority = sched_get_priority_max(policy);
+#else
+        int min_priority = MIN_THREAD_PRIORITY;
+        int max_priority = MAX_THREAD_PRIORITY;
+#endif
+        if (config.priority < min_priority || config.priority > max_priority) {
+            UVG_LOG_ERROR("Thread priority %d is not between %d and %d", config.priority, min_priority, max_priority);
+            return RTP_INVALID_VALUE;
+        }
+    }
+
+    if (config.name.size() > MAX_THREAD_NAME) {
+        UVG_LOG_ERROR("Thread name \"%s\" is longer than %zu characters", config.name.c_str(), MAX_THREAD_NAME);
+        return RTP_INVALID_VALUE;
+    }
+
+#if defined(__linux__)
+    const int cpu_count = CPU_SETSIZE;
+#elif defined(_WIN32)
+    const int cpu_count = (int)(sizeof(DWORD_PTR) * 8);
+#else
+    if (!config.cpus.empty()) {
+        UVG_LOG_ERROR("CPU affinity of the threads is not supported on this platform");
+        return RTP_NOT_SUPPORTED;
+    }
+    const int cpu_count = 0;
+#endif
+
+    for (int cpu : config.cpus) {
+        if (cpu < 0 || cpu >= cpu_count) {
+            UVG_LOG_ERROR("CPU %d is not between 0 and %d", cpu, cpu_count - 1);
+            return RTP_INVALID_VALUE;
+        }
+    }
+
+    return RTP_OK;
+}
+
+void uvgrtp::thread_settings::set(int type, const uvgrtp::thread_config& config)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    configs_[type] = config;
+}
+
+uvgrtp::thread_config uvgrtp::thread_settings::get(int type)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return configs_[type];
+}
+
+void uvgrtp::configure_thread(std::thread& thread, const std::shared_ptr<uvgrtp::thread_settings>& settings,
+    int type, int core)
+{
+    uvgrtp::thread_config config = settings ? settings->get(type) : uvgrtp::thread_config();
+    std::string name = config.name.empty() ? DEFAULT_THREAD_NAMES[type] : config.name;
+
+#ifdef __linux__
+    if (pthread_setname_np(thread.native_handle(), name.c_str()) != 0) {
+        UVG_LOG_DEBUG("Failed to name the thread %s", name.c_str());
+    }
+
+    if (!config.cpus.empty() || core >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+
+        if (config.cpus.empty()) {
+            CPU_SET(core, &cpus);
+        } else if (core >= 0) {
+            CPU_SET(config.cpus[core % config.cpus.size()], &cpus);
+        } else {
+            for (int cpu : config.cpus) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+
+        if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus) != 0) {
+            UVG_LOG_WARN("Failed to set the CPU affinity of the thread %s", name.c_str());
+        }
+    }
+#elif defined(_WIN32)
+    if (!config.cpus.empty() || core >= 0) {
+        DWORD_PTR mask = 0;
+
+        if (config.cpus.empty()) {
+            mask = (DWORD_PTR)1 << core;
+        } else if (core >= 0) {
+            mask = (DWORD_PTR)1 << config.cpus[core % config.cpus.size()];
+        } else {
+            for (int cpu : config.cpus) {
+                mask |= (DWORD_PTR)1 << cpu;
+            }
+        }
+
+        if (SetThreadAffinityMask(thread.native_handle(), mask) == 0) {
+            UVG_LOG_WARN("Failed to set the CPU affinity of the thread %s", name.c_str());
+        }
+    }
+#endif
+
+    int policy   = config.policy;
+    int priority = config.priority;
+
+    // by default the reception runs above everything else, the receiver before the processor
+    if (policy == RTP_SCHED_DEFAULT) {
+        if (type != RTP_THREAD_RECEIVER && type != RTP_THREAD_PROCESSOR)
+            return;
+
+        policy = RTP_SCHED_FIFO;
+#ifndef _WIN32
+        priority = sched_get_priority_max(SCHED_FIFO) - (type == RTP_THREAD_PROCESSOR ? 1 : 0);
+#else
+        priority = type == RTP_THREAD_PROCESSOR ? MAX_THREAD_PRIORITY / 2 : MAX_THREAD_PRIORITY;
+#endif
+    }
+
+#ifndef _WIN32
+    struct sched_param params;
+    int sched_policy = SCHED_OTHER;
+    params.sched_priority = 0;
+
+    if (policy == RTP_SCHED_FIFO || policy == RTP_SCHED_RR) {
+        sched_policy = policy == RTP_SCHED_FIFO ? SCHED_FIFO : SCHED_RR;
+        params.sched_priority = priority;
+    }
+
+    bool failed = pthread_setschedparam(thread.native_handle(), sched_policy, &params) != 0;
+#else
+    // Windows has no real-time policies, the priority picks one of the highest priority levels
+    int level = THREAD_PRIORITY_NORMAL;
+
+    if (policy == RTP_SCHED_FIFO || policy == RTP_SCHED_RR) {
+        level = priority > MAX_THREAD_PRIORITY / 2 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST;
+    }
+
+    bool failed = !SetThreadPriority(thread.native_handle(), level);
+#endif
+
+    // the default scheduling is applied on a best effort basis, the configured one is reported
+    if (failed) {
+        if (config.policy != RTP_SCHED_DEFAULT) {
+            UVG_LOG_WARN("Failed to set the scheduling of the thread %s, check the privileges", name.c_str());
+        } else {
+            UVG_LOG_DEBUG("Failed to set the default scheduling of the thread %s", name.c_str());
+        }
+    }
+}
+
+uvgrtp::stop_event::stop_event() :
+    fd_(-1)
+{
+#ifdef __linux__
+    if ((fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        UVG_LOG_WARN("Failed to create an eventfd, stopping the threads waits for their poll timeout");
+    }
+#endif
+}
+
+uvgrtp::stop_event::~stop_event()
+{
+#ifdef __linux__
+    if (fd_ >= 0)
+        close(fd_);
+#endif
+}
+
+void uvgrtp::stop_event::signal()
+{
+#ifdef __linux__
+    uint64_t one = 1;
+
+    if (fd_ >= 0 && write(fd_, &one, sizeof(one)) < 0) {
+        UVG_LOG_DEBUG("Failed to signal the stop eventfd");
+    }
+#endif
+}
+
+void uvgrtp::stop_event::reset()
+{
+#ifdef __linux__
+    uint64_t count = 0;
+
+    if (fd_ >= 0) {
+        // fails with EAGAIN if the event was not signaled
+        ssize_t ret = read(fd_, &count, sizeof(count));
+        (void)ret;
+    }
+#endif
+}
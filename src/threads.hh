@@ -0,0 +1,70 @@
+#pragma once
+
+#include "uvgrtp/context.hh"
+#include "uvgrtp/util.hh"
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace uvgrtp {
+
+    /* The thread configurations of a context, one for each RTP_THREAD_TYPE. The components of
+     * the context share this and apply the configuration of their kind to the threads they start */
+    class thread_settings {
+        public:
+            thread_settings();
+
+            /* Check that "config" can be applied on this platform */
+            static rtp_error_t check(const uvgrtp::thread_config& config);
+
+            void set(int type, const uvgrtp::thread_config& config);
+            uvgrtp::thread_config get(int type);
+
+        private:
+            std::mutex mutex_;
+            uvgrtp::thread_config configs_[RTP_THREAD_LAST];
+    };
+
+    /* Wakes a thread that waits in poll(2) when it should exit, so that stopping the thread does not
+     * take until the poll timeout. The thread polls fd() along with its sockets. Without eventfd,
+     * i.e. outside Linux, fd() is -1 and the thread notices the stop at its next timeout */
+    class stop_event {
+        public:
+            stop_event();
+            ~stop_event();
+
+            int fd() const
+            {
+                return fd_;
+            }
+
+            // wake the thread, fd() stays readable until reset()
+            void signal();
+
+            // make fd() non-readable again before the thread is restarted
+            void reset();
+
+        private:
+            int fd_;
+    };
+
+    /* Apply the configuration of "type" from "settings" to "thread", or the defaults of "type"
+     * if there are no settings. If "core" is not negative, the thread is pinned to one CPU,
+     * which is "core" itself or the CPU at that index of the configured CPUs */
+    void configure_thread(std::thread& thread, const std::shared_ptr<uvgrtp::thread_settings>& settings,
+        int type, int core = -1);
+
+    /* Start a thread running "args" and configure it as a thread of "type" */
+    template <typename... Args>
+    std::unique_ptr<std::thread> start_thread(const std::shared_ptr<uvgrtp::thread_settings>& settings,
+        int type, int core, Args&&... args)
+    {
+        std::unique_ptr<std::thread> thread(new std::thread(std::forward<Args>(args)...));
+        configure_thread(*thread, settings, type, core);
+        return thread;
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
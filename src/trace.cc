@@ -0,0 +1,51 @@
+#include "trace.hh"
+
+#include <chrono>
+#include <memory>
+
+namespace {
+
+    struct installed_hook {
+        void *arg;
+        uvgrtp::trace::trace_hook hook;
+    };
+
+    /* Replaced as a whole, so a thread in emit() keeps the hook it loaded until it returns */
+    std::shared_ptr<installed_hook> current_hook;
+}
+
+std::atomic<bool> uvgrtp::trace::hook_installed(false);
+
+rtp_error_t uvgrtp::trace::install_hook(void *arg, trace_hook hook)
+{
+#ifdef UVGRTP_TRACING
+    std::shared_ptr<installed_hook> installed = nullptr;
+    if (hook)
+        installed = std::make_shared<installed_hook>(installed_hook{ arg, hook });
+
+    std::atomic_store(&current_hook, installed);
+    hook_installed.store(hook != nullptr, std::memory_order_relaxed);
+    return RTP_OK;
+#else
+    (void)arg;
+    (void)hook;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+void uvgrtp::trace::emit(int point, uint32_t ssrc, uint32_t timestamp, uint64_t value)
+{
+    std::shared_ptr<installed_hook> installed = std::atomic_load(&current_hook);
+    if (!installed)
+        return;
+
+    uvgrtp::trace_event event;
+    event.point     = point;
+    event.ssrc      = ssrc;
+    event.timestamp = timestamp;
+    event.value     = value;
+    event.time_ns   = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    installed->hook(installed->arg, &event);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "uvgrtp/context.hh"
+#include "uvgrtp/util.hh"
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef UVGRTP_HAVE_SDT
+#include <sys/sdt.h>
+#endif
+
+namespace uvgrtp {
+    namespace trace {
+
+        typedef void (*trace_hook)(void *, const uvgrtp::trace_event *);
+
+        /* Set by install_hook() when there is a hook to call, see UVG_TRACE */
+        extern std::atomic<bool> hook_installed;
+
+        /* Set the hook that the tracepoints call, nullptr removes it
+         *
+         * Return RTP_OK on success
+         * Return RTP_NOT_SUPPORTED if the tracepoints have not been compiled in */
+        rtp_error_t install_hook(void *arg, trace_hook hook);
+
+        /* Give the event of the tracepoint "point" to the installed hook */
+        void emit(int point, uint32_t ssrc, uint32_t timestamp, uint64_t value);
+
+        inline bool active()
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return __builtin_expect(hook_installed.load(std::memory_order_relaxed), false);
+#else
+            return hook_installed.load(std::memory_order_relaxed);
+#endif
+        }
+    }
+}
+
+/* Pass the tracepoint RTP_TRACE_<point>, see uvgrtp::context::install_trace_hook().
+ *
+ * With the CMake option UVGRTP_ENABLE_TRACING, a tracepoint is a relaxed load and a branch
+ * that is predicted not taken, plus a USDT probe if sys/sdt.h is available. Without it, the
+ * tracepoints and their arguments are compiled out */
+#ifdef UVGRTP_TRACING
+
+#ifdef UVGRTP_HAVE_SDT
+#define UVG_TRACE_PROBE(point, ssrc, timestamp, value) \
+    DTRACE_PROBE3(uvgrtp, point, (uint32_t)(ssrc), (uint32_t)(timestamp), (uint64_t)(value))
+#else
+#define UVG_TRACE_PROBE(point, ssrc, timestamp, value) do {} while (0)
+#endif
+
+#define UVG_TRACE(point, ssrc, timestamp, value) \
+    do { \
+        UVG_TRACE_PROBE(point, ssrc, timestamp, value); \
+        if (uvgrtp::trace::active()) \
+            uvgrtp::trace::emit(RTP_TRACE_##point, (uint32_t)(ssrc), (uint32_t)(timestamp), (uint64_t)(value)); \
+    } while (0)
+
+#else
+
+#define UVG_TRACE(point, ssrc, timestamp, value) do {} while (0)
+
+#endif
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,614 @@
+#include "twcc.hh"
+
+#include "header_extensions.hh"
+#include "rtcp_packets.hh"
+#include "debug.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/* One-byte header extension profile, see RFC 8285 section 4.2 */
+constexpr uint16_t ONE_BYTE_HEADER_PROFILE = 0xbede;
+
+/* The reference time of the feedback is in multiples of 64 ms and the deltas in multiples of 250 us */
+constexpr int64_t REFERENCE_TIME_US = 64000;
+constexpr int64_t DELTA_TICK_US     = 250;
+
+/* Number of sent packets remembered for the feedback, must be a power of two */
+constexpr size_t HISTORY_SIZE = 1 << 14;
+
+/* Packets sent within this time of the first packet of a group belong to the same group */
+constexpr int64_t BURST_US = 5000;
+
+/* Trendline filter and overuse detector, see draft-ietf-rmcat-gcc-02 section 5 */
+constexpr size_t TRENDLINE_WINDOW    = 20;
+constexpr double TRENDLINE_SMOOTHING = 0.9;
+constexpr double TRENDLINE_GAIN      = 4.0;
+constexpr size_t MAX_DELTAS          = 60;
+constexpr double OVERUSE_TIME_MS     = 10.0;
+constexpr double THRESHOLD_K_UP      = 0.0087;
+constexpr double THRESHOLD_K_DOWN    = 0.039;
+constexpr double INITIAL_THRESHOLD   = 12.5;
+constexpr double MIN_THRESHOLD       = 6.0;
+constexpr double MAX_THRESHOLD       = 600.0;
+
+/* Rate control */
+constexpr double  DECREASE_FACTOR       = 0.85;
+constexpr double  INCREASE_PER_SECOND   = 1.08;
+constexpr int64_t DECREASE_INTERVAL_US  = 200000;
+constexpr int64_t ACKED_WINDOW_US       = 500000;
+constexpr int64_t MIN_ACKED_SPAN_US     = 100000;
+constexpr size_t  MIN_LOSS_PACKETS      = 20;
+constexpr double  HIGH_LOSS             = 0.10;
+constexpr double  LOW_LOSS              = 0.02;
+constexpr uint32_t MIN_BITRATE           = 50000;
+constexpr uint32_t DEFAULT_START_BITRATE = 1000000;
+
+static inline uint16_t read_u16(const uint8_t *ptr)
+{
+    return (uint16_t)((ptr[0] << 8) | ptr[1]);
+}
+
+void uvgrtp::write_twcc_extension(uint8_t *buffer, uint8_t id, uint16_t seq)
+{
+    buffer[0] = ONE_BYTE_HEADER_PROFILE >> 8;
+    buffer[1] = ONE_BYTE_HEADER_PROFILE & 0xff;
+    buffer[2] = 0;
+    buffer[3] = 1;
+
+    // the length field of an element is its length minus one
+    buffer[4] = (uint8_t)((id << 4) | 1);
+    buffer[5] = (uint8_t)(seq >> 8);
+    buffer[6] = (uint8_t)(seq & 0xff);
+    buffer[7] = 0;
+}
+
+bool uvgrtp::read_twcc_extension(const uvgrtp::frame::ext_header *ext, uint8_t id, uint16_t& seq)
+{
+    size_t len = 0;
+    const uint8_t *value = uvgrtp::find_header_extension(ext, id, len);
+
+    if (!value || len != 2)
+        return false;
+
+    seq = read_u16(value);
+    return true;
+}
+
+uvgrtp::twcc_receiver::twcc_receiver() :
+    media_ssrc_(0),
+    arrivals_(),
+    max_seq_(-1),
+    next_seq_(-1),
+    feedback_count_(0),
+    epoch_(std::chrono::steady_clock::now())
+{
+}
+
+int64_t uvgrtp::twcc_receiver::unwrap(uint16_t seq)
+{
+    if (max_seq_ < 0)
+        return seq;
+
+    return max_seq_ + (int16_t)(seq - (uint16_t)max_seq_);
+}
+
+void uvgrtp::twcc_receiver::packet_received(uint32_t media_ssrc, uint16_t seq,
+    std::chrono::steady_clock::time_point arrival)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    int64_t unwrapped = unwrap(seq);
+
+    // the packet has already been reported as lost
+    if (next_seq_ >= 0 && unwrapped < next_seq_)
+        return;
+
+    media_ssrc_ = media_ssrc;
+    arrivals_[unwrapped] = std::chrono::duration_cast<std::chrono::microseconds>(arrival - epoch_).count();
+    max_seq_ = std::max(max_seq_, unwrapped);
+}
+
+uint8_t *uvgrtp::twcc_receiver::create_feedback(uint32_t sender_ssrc, size_t trailer, uint32_t& size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (arrivals_.empty())
+        return nullptr;
+
+    int64_t base  = (next_seq_ >= 0) ? next_seq_ : arrivals_.begin()->first;
+    int64_t last  = std::min(arrivals_.rbegin()->first, base + (int64_t)TWCC_MAX_FEEDBACK_STATUSES - 1);
+    size_t  count = (size_t)(last - base + 1);
+
+    int64_t reference = arrivals_.begin()->second / REFERENCE_TIME_US;
+    int64_t current   = reference * REFERENCE_TIME_US;
+
+    // status symbols: 0 not received, 1 received with a small delta, 2 received with a large delta
+    std::vector<uint8_t> symbols(count, 0);
+    std::vector<int16_t> deltas;
+    size_t delta_bytes = 0;
+
+    auto it = arrivals_.begin();
+    for (; it != arrivals_.end() && it->first <= last; ++it) {
+        int64_t ticks = (int64_t)std::llround((double)(it->second - current) / DELTA_TICK_US);
+        ticks = std::max<int64_t>(INT16_MIN, std::min<int64_t>(INT16_MAX, ticks));
+
+        bool small = ticks >= 0 && ticks <= UINT8_MAX;
+        symbols[it->first - base] = small ? 1 : 2;
+        delta_bytes += small ? 1 : 2;
+
+        deltas.push_back((int16_t)ticks);
+        current += ticks * DELTA_TICK_US;
+    }
+    arrivals_.erase(arrivals_.begin(), it);
+    next_seq_ = last + 1;
+
+    /* RTCP header, SSRCs of the sender and the media source, base sequence number, status count,
+     * reference time and feedback count, then two-bit status vector chunks of 7 packets each */
+    const size_t chunks  = (count + 6) / 7;
+    const size_t body    = RTCP_HEADER_SIZE + 2 * SSRC_CSRC_SIZE + 8 + 2 * chunks + delta_bytes;
+    const size_t padding = (4 - (body + trailer) % 4) % 4;
+
+    size = (uint32_t)(body + padding + trailer);
+
+    uint8_t *frame = new uint8_t[size];
+    memset(frame, 0, size);
+
+    size_t ptr = 0;
+    if (!construct_rtcp_header(frame, ptr, size, uvgrtp::frame::RTCP_RTPFB_TWCC, uvgrtp::frame::RTCP_FT_RTPFB) ||
+        !construct_ssrc(frame, ptr, sender_ssrc) ||
+        !construct_ssrc(frame, ptr, media_ssrc_))
+    {
+        delete[] frame;
+        return nullptr;
+    }
+
+    uint16_t base_seq = (uint16_t)base;
+    frame[ptr++] = (uint8_t)(base_seq >> 8);
+    frame[ptr++] = (uint8_t)(base_seq & 0xff);
+    frame[ptr++] = (uint8_t)(count >> 8);
+    frame[ptr++] = (uint8_t)(count & 0xff);
+    frame[ptr++] = (uint8_t)((reference >> 16) & 0xff);
+    frame[ptr++] = (uint8_t)((reference >> 8) & 0xff);
+    frame[ptr++] = (uint8_t)(reference & 0xff);
+    frame[ptr++] = feedback_count_++;
+
+    for (size_t c = 0; c < chunks; ++c) {
+        uint16_t chunk = 0xc000;
+
+        for (size_t k = 0; k < 7 && c * 7 + k < count; ++k) {
+            chunk |= (uint16_t)(symbols[c * 7 + k] << (12 - 2 * k));
+        }
+        frame[ptr++] = (uint8_t)(chunk >> 8);
+        frame[ptr++] = (uint8_t)(chunk & 0xff);
+    }
+
+    for (int16_t delta : deltas) {
+        if (delta >= 0 && delta <= UINT8_MAX) {
+            frame[ptr++] = (uint8_t)delta;
+        } else {
+            frame[ptr++] = (uint8_t)((uint16_t)delta >> 8);
+            frame[ptr++] = (uint8_t)((uint16_t)delta & 0xff);
+        }
+    }
+
+    return frame;
+}
+
+uvgrtp::twcc_sender::twcc_sender() :
+    history_(HISTORY_SIZE),
+    next_seq_(0),
+    first_unsent_(0),
+    unsent_(0),
+    accumulated_delay_(0),
+    smoothed_delay_(0),
+    delay_window_(),
+    first_arrival_us_(-1),
+    num_deltas_(0),
+    prev_trend_(0),
+    threshold_(INITIAL_THRESHOLD),
+    last_threshold_update_us_(-1),
+    time_over_using_(-1),
+    overuse_counter_(0),
+    usage_(USAGE_NORMAL),
+    acked_(),
+    acked_bytes_(0),
+    paths_(),
+    loss_sent_(0),
+    loss_lost_(0),
+    delay_bps_(0),
+    loss_bps_(0),
+    min_bps_(0),
+    max_bps_(0),
+    target_bps_(0),
+    reported_bps_(0),
+    last_update_us_(-1),
+    last_loss_update_us_(-1),
+    last_decrease_us_(-1),
+    epoch_(std::chrono::steady_clock::now()),
+    hook_arg_(nullptr),
+    hook_(nullptr)
+{
+    set_bitrates(DEFAULT_START_BITRATE, 0);
+}
+
+void uvgrtp::twcc_sender::set_bitrates(uint32_t start_bps, uint32_t max_bps)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    max_bps_ = max_bps ? max_bps : UINT32_MAX;
+    min_bps_ = std::min(MIN_BITRATE, max_bps_);
+
+    target_bps_   = std::max(min_bps_, std::min(max_bps_, start_bps));
+    delay_bps_    = target_bps_;
+    loss_bps_     = max_bps_;
+    reported_bps_ = 0;
+}
+
+void uvgrtp::twcc_sender::install_bitrate_hook(void *arg, void (*hook)(void *, uint32_t))
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    hook_arg_ = arg;
+    hook_     = hook;
+}
+
+uint32_t uvgrtp::twcc_sender::get_target_bitrate()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return target_bps_;
+}
+
+uint16_t uvgrtp::twcc_sender::add_packet(size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    uint16_t seq = next_seq_++;
+    sent_packet& packet = history_[seq & (HISTORY_SIZE - 1)];
+
+    packet.seq     = seq;
+    packet.size    = (uint32_t)size;
+    packet.send_us = -1;
+    packet.path    = 0;
+
+    if (unsent_ == 0)
+        first_unsent_ = seq;
+    ++unsent_;
+
+    return seq;
+}
+
+void uvgrtp::twcc_sender::packets_sent(std::chrono::steady_clock::time_point start, std::chrono::nanoseconds spacing)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    int64_t start_us   = std::chrono::duration_cast<std::chrono::microseconds>(start - epoch_).count();
+    double  spacing_us = (double)spacing.count() / 1000;
+
+    for (size_t i = 0; i < unsent_; ++i) {
+        history_[(uint16_t)(first_unsent_ + i) & (HISTORY_SIZE - 1)].send_us = start_us + (int64_t)(i * spacing_us);
+    }
+    unsent_ = 0;
+}
+
+void uvgrtp::twcc_sender::discard_unsent()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    unsent_ = 0;
+}
+
+void uvgrtp::twcc_sender::set_path(uint16_t seq, uint8_t path)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    sent_packet& packet = history_[seq & (HISTORY_SIZE - 1)];
+    if (packet.seq == seq)
+        packet.path = path;
+}
+
+void uvgrtp::twcc_sender::take_path_feedback(std::vector<path_feedback>& feedback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    feedback.assign(paths_.begin(), paths_.end());
+    std::fill(paths_.begin(), paths_.end(), path_feedback());
+}
+
+rtp_error_t uvgrtp::twcc_sender::feedback_received(const uint8_t *fci, size_t len)
+{
+    if (!fci || len < 8)
+        return RTP_INVALID_VALUE;
+
+    uint16_t base_seq = read_u16(&fci[0]);
+    uint16_t count    = read_u16(&fci[2]);
+
+    int64_t reference = (fci[4] << 16) | (fci[5] << 8) | fci[6];
+    if (reference & 0x800000)
+        reference -= 0x1000000;
+
+    size_t ptr = 8;
+    std::vector<uint8_t> symbols;
+    symbols.reserve(count);
+
+    while (symbols.size() < count) {
+        if (ptr + 2 > len)
+            return RTP_INVALID_VALUE;
+
+        uint16_t chunk = read_u16(&fci[ptr]);
+        ptr += 2;
+
+        if (!(chunk & 0x8000)) {
+            // run length chunk
+            uint8_t symbol = (chunk >> 13) & 0x3;
+            for (size_t run = chunk & 0x1fff; run > 0 && symbols.size() < count; --run)
+                symbols.push_back(symbol);
+        } else if (!(chunk & 0x4000)) {
+            // status vector chunk of 14 one-bit symbols
+            for (int k = 13; k >= 0 && symbols.size() < count; --k)
+                symbols.push_back((chunk >> k) & 0x1);
+        } else {
+            // status vector chunk of 7 two-bit symbols
+            for (int k = 12; k >= 0 && symbols.size() < count; k -= 2)
+                symbols.push_back((chunk >> k) & 0x3);
+        }
+    }
+
+    std::vector<int64_t> arrivals(count, -1);
+    int64_t arrival_us = reference * REFERENCE_TIME_US;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (symbols[i] == 0)
+            continue;
+
+        if (symbols[i] == 1 && ptr + 1 <= len) {
+            arrival_us += fci[ptr] * DELTA_TICK_US;
+            ptr += 1;
+        } else if (symbols[i] == 2 && ptr + 2 <= len) {
+            arrival_us += (int16_t)read_u16(&fci[ptr]) * DELTA_TICK_US;
+            ptr += 2;
+        } else {
+            return RTP_INVALID_VALUE;
+        }
+        arrivals[i] = arrival_us;
+    }
+
+    void *hook_arg = nullptr;
+    void (*hook)(void *, uint32_t) = nullptr;
+    uint32_t target = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        size_t sent = 0;
+        size_t lost = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            uint16_t seq = (uint16_t)(base_seq + i);
+            const sent_packet& packet = history_[seq & (HISTORY_SIZE - 1)];
+
+            // the packet is too old or was never sent
+            if (packet.seq != seq || packet.send_us < 0)
+                continue;
+
+            if (packet.path >= paths_.size())
+                paths_.resize(packet.path + 1);
+
+            path_feedback& path = paths_[packet.path];
+            ++path.sent;
+
+            ++sent;
+            if (arrivals[i] < 0) {
+                ++path.lost;
+                ++lost;
+                continue;
+            }
+
+            path.delay_sum_us += arrivals[i] - packet.send_us;
+            ++path.delays;
+
+            // the delays of the paths differ, so the delay trend only follows the first path
+            if (packet.path == 0)
+                group_packet(packet.send_us, arrivals[i]);
+
+            acked_.push_back({ arrivals[i], packet.size });
+            acked_bytes_ += packet.size;
+        }
+
+        while (!acked_.empty() && acked_.front().first < acked_.back().first - ACKED_WINDOW_US) {
+            acked_bytes_ -= acked_.front().second;
+            acked_.pop_front();
+        }
+
+        int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - epoch_).count();
+
+        if (update_target(now_us, sent, lost)) {
+            hook_arg = hook_arg_;
+            hook     = hook_;
+            target   = target_bps_;
+        }
+    }
+
+    // the hook is called without the lock so that it may query the estimate
+    if (hook)
+        hook(hook_arg, target);
+
+    return RTP_OK;
+}
+
+void uvgrtp::twcc_sender::group_packet(int64_t send_us, int64_t arrival_us)
+{
+    if (current_group_.first_send_us < 0) {
+        current_group_ = { send_us, send_us, arrival_us };
+        return;
+    }
+
+    if (send_us - current_group_.first_send_us <= BURST_US) {
+        current_group_.last_send_us    = std::max(current_group_.last_send_us, send_us);
+        current_group_.last_arrival_us = std::max(current_group_.last_arrival_us, arrival_us);
+        return;
+    }
+
+    if (previous_group_.first_send_us >= 0) {
+        update_trendline(current_group_.last_send_us - previous_group_.last_send_us,
+            current_group_.last_arrival_us - previous_group_.last_arrival_us, current_group_.last_arrival_us);
+    }
+    previous_group_ = current_group_;
+    current_group_  = { send_us, send_us, arrival_us };
+}
+
+void uvgrtp::twcc_sender::update_trendline(int64_t send_delta_us, int64_t arrival_delta_us, int64_t arrival_us)
+{
+    double delay_ms = (double)(arrival_delta_us - send_delta_us) / 1000;
+
+    num_deltas_ = std::min(num_deltas_ + 1, (size_t)1000);
+    if (first_arrival_us_ < 0)
+        first_arrival_us_ = arrival_us;
+
+    accumulated_delay_ += delay_ms;
+    smoothed_delay_     = TRENDLINE_SMOOTHING * smoothed_delay_ + (1 - TRENDLINE_SMOOTHING) * accumulated_delay_;
+
+    delay_window_.push_back({ (double)(arrival_us - first_arrival_us_) / 1000, smoothed_delay_ });
+    if (delay_window_.size() > TRENDLINE_WINDOW)
+        delay_window_.pop_front();
+
+    // the slope of the smoothed delay over the window by linear regression
+    double trend = prev_trend_;
+    if (delay_window_.size() == TRENDLINE_WINDOW) {
+        double mean_x = 0;
+        double mean_y = 0;
+
+        for (auto& point : delay_window_) {
+            mean_x += point.first;
+            mean_y += point.second;
+        }
+        mean_x /= delay_window_.size();
+        mean_y /= delay_window_.size();
+
+        double numerator   = 0;
+        double denominator = 0;
+
+        for (auto& point : delay_window_) {
+            numerator   += (point.first - mean_x) * (point.second - mean_y);
+            denominator += (point.first - mean_x) * (point.first - mean_x);
+        }
+
+        if (denominator != 0)
+            trend = numerator / denominator;
+    }
+
+    detect_overuse(trend, (double)send_delta_us / 1000, arrival_us);
+}
+
+void uvgrtp::twcc_sender::detect_overuse(double trend, double send_delta_ms, int64_t arrival_us)
+{
+    double modified_trend = (double)std::min(num_deltas_, MAX_DELTAS) * trend * TRENDLINE_GAIN;
+
+    if (modified_trend > threshold_) {
+        if (time_over_using_ < 0)
+            time_over_using_ = send_delta_ms / 2;
+        else
+            time_over_using_ += send_delta_ms;
+
+        ++overuse_counter_;
+
+        // the delay must keep growing for a while before the link is considered overused
+        if (time_over_using_ > OVERUSE_TIME_MS && overuse_counter_ > 1 && trend >= prev_trend_) {
+            time_over_using_ = 0;
+            overuse_counter_ = 0;
+            usage_           = USAGE_OVERUSING;
+        }
+    } else if (modified_trend < -threshold_) {
+        time_over_using_ = -1;
+        overuse_counter_ = 0;
+        usage_           = USAGE_UNDERUSING;
+    } else {
+        time_over_using_ = -1;
+        overuse_counter_ = 0;
+        usage_           = USAGE_NORMAL;
+    }
+    prev_trend_ = trend;
+
+    /* The threshold follows the trend so that the estimate is not starved by concurrent
+     * TCP flows, but sudden spikes do not move it */
+    if (last_threshold_update_us_ < 0)
+        last_threshold_update_us_ = arrival_us;
+
+    double abs_trend = std::fabs(modified_trend);
+    if (abs_trend > threshold_ + 15) {
+        last_threshold_update_us_ = arrival_us;
+        return;
+    }
+
+    double k  = (abs_trend < threshold_) ? THRESHOLD_K_DOWN : THRESHOLD_K_UP;
+    double dt = std::max(0.0, std::min((double)(arrival_us - last_threshold_update_us_) / 1000, 100.0));
+
+    threshold_ += k * (abs_trend - threshold_) * dt;
+    threshold_  = std::max(MIN_THRESHOLD, std::min(MAX_THRESHOLD, threshold_));
+    last_threshold_update_us_ = arrival_us;
+}
+
+bool uvgrtp::twcc_sender::update_target(int64_t now_us, size_t sent, size_t lost)
+{
+    double dt_s = (last_update_us_ < 0) ? 0 : std::min((double)(now_us - last_update_us_) / 1000000, 1.0);
+    last_update_us_ = now_us;
+
+    double acked_bps = 0;
+    if (acked_.size() >= 2) {
+        int64_t span = acked_.back().first - acked_.front().first;
+
+        if (span >= MIN_ACKED_SPAN_US)
+            acked_bps = (double)acked_bytes_ * 8 * 1000000 / (double)span;
+    }
+
+    switch (usage_) {
+        case USAGE_OVERUSING:
+            if (last_decrease_us_ < 0 || now_us - last_decrease_us_ >= DECREASE_INTERVAL_US) {
+                double base = (acked_bps > 0) ? std::min(acked_bps, delay_bps_) : delay_bps_;
+
+                delay_bps_        = DECREASE_FACTOR * base;
+                last_decrease_us_ = now_us;
+            }
+            break;
+
+        case USAGE_UNDERUSING:
+            // the queues are draining, hold the rate until they are empty
+            break;
+
+        case USAGE_NORMAL:
+            delay_bps_ *= std::pow(INCREASE_PER_SECOND, dt_s);
+
+            // do not run away from what the application actually sends
+            if (acked_bps > 0)
+                delay_bps_ = std::min(delay_bps_, 1.5 * acked_bps + 10000);
+            break;
+    }
+
+    loss_sent_ += sent;
+    loss_lost_ += lost;
+
+    if (loss_sent_ >= MIN_LOSS_PACKETS) {
+        double fraction = (double)loss_lost_ / (double)loss_sent_;
+        double loss_dt  = (last_loss_update_us_ < 0) ? 0 :
+            std::min((double)(now_us - last_loss_update_us_) / 1000000, 1.0);
+
+        if (fraction > HIGH_LOSS)
+            loss_bps_ = std::min(loss_bps_, (double)target_bps_) * (1 - 0.5 * fraction);
+        else if (fraction < LOW_LOSS)
+            loss_bps_ *= std::pow(INCREASE_PER_SECOND, loss_dt);
+
+        last_loss_update_us_ = now_us;
+        loss_sent_ = 0;
+        loss_lost_ = 0;
+    }
+
+    delay_bps_ = std::max((double)min_bps_, std::min((double)max_bps_, delay_bps_));
+    loss_bps_  = std::max((double)min_bps_, std::min((double)max_bps_, loss_bps_));
+    target_bps_ = (uint32_t)std::min(delay_bps_, loss_bps_);
+
+    if (reported_bps_ == 0 || (uint64_t)std::abs((int64_t)target_bps_ - (int64_t)reported_bps_) * 100 >= reported_bps_) {
+        reported_bps_ = target_bps_;
+        return true;
+    }
+    return false;
+}
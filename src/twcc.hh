@@ -0,0 +1,220 @@
+#pragma once
+
+#include "uvgrtp/frame.hh"
+#include "uvgrtp/util.hh"
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* Transport-wide congestion control, see draft-holmer-rmcat-transport-wide-cc-extensions-01
+     *
+     * The sender numbers every packet of the stream with a transport-wide sequence number carried
+     * in a one-byte RTP header extension (RFC 8285). The receiver reports the arrival time of each
+     * numbered packet in RTPFB feedback messages and the sender estimates the available bandwidth
+     * from how the queuing delay and the losses develop, see twcc_sender. */
+
+    /* The header extension of a packet that only carries the sequence number: the one-byte header
+     * profile 0xBEDE and a length of one word, followed by the element and one byte of padding.
+     * The sent packets get the element in the extension of the stream, see header_extensions */
+    constexpr size_t TWCC_EXTENSION_SIZE = 8;
+
+    /* How often the receiver sends feedback */
+    constexpr uint32_t TWCC_FEEDBACK_INTERVAL_MS = 50;
+
+    /* Most packets reported in one feedback message, so that the message fits in one datagram */
+    constexpr size_t TWCC_MAX_FEEDBACK_STATUSES = 500;
+
+    /* Write the header extension carrying "seq" with the element ID "id" to "buffer" */
+    void write_twcc_extension(uint8_t *buffer, uint8_t id, uint16_t seq);
+
+    /* Find the transport-wide sequence number with the element ID "id" from the header
+     * extension of a received packet, in either header form. Return true if it was found */
+    bool read_twcc_extension(const uvgrtp::frame::ext_header *ext, uint8_t id, uint16_t& seq);
+
+    /* Collects the arrival times of the received packets and builds the feedback messages */
+    class twcc_receiver {
+        public:
+            twcc_receiver();
+
+            /* Record the arrival of the packet "seq" of the stream "media_ssrc" */
+            void packet_received(uint32_t media_ssrc, uint16_t seq, std::chrono::steady_clock::time_point arrival);
+
+            /* Build a feedback message of the packets received since the previous message. At most
+             * TWCC_MAX_FEEDBACK_STATUSES packets are reported in one message, so this is called until
+             * it returns nullptr. "trailer" bytes are reserved at the end for SRTCP and, as with the
+             * receiver reports, counted in the length of the message
+             *
+             * Return the message, allocated with new[], and its size in "size"
+             * Return nullptr if there is nothing to report */
+            uint8_t *create_feedback(uint32_t sender_ssrc, size_t trailer, uint32_t& size);
+
+        private:
+            /* Extend "seq" to 64 bits based on the sequence numbers received so far */
+            int64_t unwrap(uint16_t seq);
+
+            std::mutex mutex_;
+
+            uint32_t media_ssrc_;
+
+            /* Arrival times in microseconds by unwrapped sequence number, for the packets not reported yet */
+            std::map<int64_t, int64_t> arrivals_;
+
+            /* The highest sequence number received and the first one of the next feedback, -1 before the first packet */
+            int64_t max_seq_;
+            int64_t next_seq_;
+
+            uint8_t feedback_count_;
+            std::chrono::steady_clock::time_point epoch_;
+    };
+
+    /* Numbers the sent packets and estimates the available bandwidth from the feedback
+     *
+     * The delay-based estimate follows Google Congestion Control (draft-ietf-rmcat-gcc-02).
+     * The packets are grouped into bursts of 5 ms and the change of the one-way delay between
+     * the groups is fed to a trendline filter. When the slope of the delay exceeds an adaptive
+     * threshold, the link is overused and the target is set to 85% of the bitrate that the
+     * receiver has acknowledged. Otherwise the target grows by 8% a second. A loss-based limit
+     * is lowered when more than 10% of the packets are lost and raised when less than 2% are.
+     * The target is the smaller of the two. */
+    class twcc_sender {
+        public:
+            twcc_sender();
+
+            /* Restart the estimate from "start_bps" and limit it to "max_bps", both in bits per
+             * second. A zero "max_bps" does not limit the estimate */
+            void set_bitrates(uint32_t start_bps, uint32_t max_bps);
+
+            /* The hook is called with the new target bitrate in bits per second from the thread
+             * that receives RTCP whenever the target changes by at least one percent */
+            void install_bitrate_hook(void *arg, void (*hook)(void *, uint32_t));
+
+            uint32_t get_target_bitrate();
+
+            /* Give the next transport-wide sequence number to a packet of "size" bytes */
+            uint16_t add_packet(size_t size);
+
+            /* The packets numbered since the previous call have been sent, the first one at
+             * "start" and the rest "spacing" apart */
+            void packets_sent(std::chrono::steady_clock::time_point start, std::chrono::nanoseconds spacing);
+
+            /* Forget the packets that were numbered but could not be sent, so that they
+             * are not counted as lost */
+            void discard_unsent();
+
+            /* The packet "seq" was sent over the path "path" of a multipath stream, see
+             * frame_queue::set_paths(). The packets are on the first path by default */
+            void set_path(uint16_t seq, uint8_t path);
+
+            /* What the feedback has told of one path since the previous take_path_feedback() */
+            struct path_feedback {
+                uint32_t sent = 0;
+                uint32_t lost = 0;
+
+                /* The sum of the one-way delays of the received packets and their count. The delays
+                 * include the offset between the clocks of the sender and the receiver, which is the
+                 * same for all paths, so only their changes and differences mean something */
+                int64_t delay_sum_us = 0;
+                uint32_t delays = 0;
+            };
+
+            /* Move the feedback of each path to "feedback", indexed by path, and start counting again */
+            void take_path_feedback(std::vector<path_feedback>& feedback);
+
+            /* Update the estimate from the feedback control information of a feedback message,
+             * which starts after the media source SSRC
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the message is malformed */
+            rtp_error_t feedback_received(const uint8_t *fci, size_t len);
+
+        private:
+            struct sent_packet {
+                uint16_t seq = 0;
+                uint32_t size = 0;
+                int64_t send_us = -1;   // -1 if the packet has not been sent
+                uint8_t path = 0;
+            };
+
+            struct packet_group {
+                int64_t first_send_us = -1;
+                int64_t last_send_us = 0;
+                int64_t last_arrival_us = 0;
+            };
+
+            enum bandwidth_usage {
+                USAGE_NORMAL,
+                USAGE_UNDERUSING,
+                USAGE_OVERUSING
+            };
+
+            /* Feed a packet of the feedback to the packet groups */
+            void group_packet(int64_t send_us, int64_t arrival_us);
+
+            /* Update the trendline of the delay with the delay change between two groups */
+            void update_trendline(int64_t send_delta_us, int64_t arrival_delta_us, int64_t arrival_us);
+
+            /* Detect overuse from the trend and adapt the threshold */
+            void detect_overuse(double trend, double send_delta_ms, int64_t arrival_us);
+
+            /* Update the target bitrates after a feedback message. Return true if the hook should be called */
+            bool update_target(int64_t now_us, size_t sent, size_t lost);
+
+            std::mutex mutex_;
+
+            /* The last HISTORY_SIZE packets by sequence number */
+            std::vector<sent_packet> history_;
+            uint16_t next_seq_;
+            uint16_t first_unsent_;
+            size_t unsent_;
+
+            /* Packet groups and the trendline filter */
+            packet_group current_group_;
+            packet_group previous_group_;
+            double accumulated_delay_;
+            double smoothed_delay_;
+            std::deque<std::pair<double, double>> delay_window_;
+            int64_t first_arrival_us_;
+            size_t num_deltas_;
+            double prev_trend_;
+
+            /* Overuse detector */
+            double threshold_;
+            int64_t last_threshold_update_us_;
+            double time_over_using_;
+            int overuse_counter_;
+            bandwidth_usage usage_;
+
+            /* Bytes acknowledged by the receiver in the last ACKED_WINDOW_US by arrival time */
+            std::deque<std::pair<int64_t, uint32_t>> acked_;
+            uint64_t acked_bytes_;
+
+            /* The feedback of the paths not taken yet, see take_path_feedback() */
+            std::vector<path_feedback> paths_;
+
+            /* Losses counted since the loss-based limit was last updated */
+            size_t loss_sent_;
+            size_t loss_lost_;
+
+            double delay_bps_;
+            double loss_bps_;
+            uint32_t min_bps_;
+            uint32_t max_bps_;
+            uint32_t target_bps_;
+            uint32_t reported_bps_;
+            int64_t last_update_us_;
+            int64_t last_loss_update_us_;
+            int64_t last_decrease_us_;
+
+            std::chrono::steady_clock::time_point epoch_;
+
+            void *hook_arg_;
+            void (*hook_)(void *, uint32_t);
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,274 @@
+#include "uring.hh"
+
+#include "debug.hh"
+
+#ifdef UVGRTP_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+/* Upper limit for the size of one ring */
+constexpr unsigned MAX_URING_ENTRIES = 256;
+
+uvgrtp::uring::uring() :
+    ring_fd_(-1),
+    entries_(0),
+    sq_ring_(nullptr),
+    cq_ring_(nullptr),
+    sq_ring_size_(0),
+    cq_ring_size_(0),
+    sq_tail_(nullptr),
+    sq_mask_(nullptr),
+    sq_array_(nullptr),
+    cq_head_(nullptr),
+    cq_tail_(nullptr),
+    cq_mask_(nullptr),
+    sqes_(nullptr),
+    cqes_(nullptr),
+    sqes_size_(0)
+{
+}
+
+uvgrtp::uring::~uring()
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    if (sqes_)
+        munmap(sqes_, sqes_size_);
+
+    if (cq_ring_ && cq_ring_ != sq_ring_)
+        munmap(cq_ring_, cq_ring_size_);
+
+    if (sq_ring_)
+        munmap(sq_ring_, sq_ring_size_);
+
+    if (ring_fd_ >= 0)
+        close(ring_fd_);
+#endif
+}
+
+rtp_error_t uvgrtp::uring::init(unsigned entries)
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    entries = std::min(std::max(entries, 1u), MAX_URING_ENTRIES);
+
+    if ((ring_fd_ = (int)syscall(__NR_io_uring_setup, entries, &params)) < 0) {
+        UVG_LOG_WARN("io_uring_setup(2) failed: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes  + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    // newer kernels map both queues with one call
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring_fd_, IORING_OFF_SQ_RING);
+
+    if (sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        UVG_LOG_ERROR("Failed to map io_uring submission queue: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            ring_fd_, IORING_OFF_CQ_RING);
+
+        if (cq_ring_ == MAP_FAILED) {
+            cq_ring_ = nullptr;
+            UVG_LOG_ERROR("Failed to map io_uring completion queue: %s", strerror(errno));
+            return RTP_NOT_SUPPORTED;
+        }
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring_fd_, IORING_OFF_SQES);
+
+    if (sqes == MAP_FAILED) {
+        UVG_LOG_ERROR("Failed to map io_uring submission queue entries: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+    sqes_ = (struct io_uring_sqe *)sqes;
+
+    uint8_t *sq = (uint8_t *)sq_ring_;
+    uint8_t *cq = (uint8_t *)cq_ring_;
+
+    sq_tail_  = (unsigned *)(sq + params.sq_off.tail);
+    sq_mask_  = (unsigned *)(sq + params.sq_off.ring_mask);
+    sq_array_ = (unsigned *)(sq + params.sq_off.array);
+    cq_head_  = (unsigned *)(cq + params.cq_off.head);
+    cq_tail_  = (unsigned *)(cq + params.cq_off.tail);
+    cq_mask_  = (unsigned *)(cq + params.cq_off.ring_mask);
+    cqes_     = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    entries_ = params.sq_entries;
+    return RTP_OK;
+#else
+    (void)entries;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+unsigned uvgrtp::uring::get_entries() const
+{
+    return entries_;
+}
+
+#ifndef _WIN32
+rtp_error_t uvgrtp::uring::sendmsg(int fd, struct mmsghdr *msgs, unsigned count, int flags)
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    int results[MAX_URING_ENTRIES];
+    unsigned tail = *sq_tail_;
+
+    count = std::min(count, entries_);
+
+    for (unsigned i = 0; i < count; ++i) {
+        unsigned index = tail & *sq_mask_;
+        struct io_uring_sqe *sqe = &sqes_[index];
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode    = IORING_OP_SENDMSG;
+        sqe->fd        = fd;
+        sqe->addr      = (uint64_t)(uintptr_t)&msgs[i].msg_hdr;
+        sqe->len       = 1;
+        sqe->msg_flags = (uint32_t)flags;
+        sqe->user_data = i;
+
+        sq_array_[index] = index;
+        ++tail;
+    }
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+    rtp_error_t ret = submit_and_wait(count, results);
+    if (ret != RTP_OK)
+        return ret;
+
+    for (unsigned i = 0; i < count; ++i) {
+        if (results[i] < 0) {
+            UVG_LOG_ERROR("io_uring sendmsg failed: %s", strerror(-results[i]));
+            return RTP_SEND_ERROR;
+        }
+        msgs[i].msg_len = (unsigned)results[i];
+    }
+    return RTP_OK;
+#else
+    (void)fd, (void)msgs, (void)count, (void)flags;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+rtp_error_t uvgrtp::uring::recvmsg(int fd, struct mmsghdr *msgs, unsigned count, int flags, int *received)
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    int results[MAX_URING_ENTRIES];
+    unsigned tail = *sq_tail_;
+
+    count = std::min(count, entries_);
+
+    for (unsigned i = 0; i < count; ++i) {
+        unsigned index = tail & *sq_mask_;
+        struct io_uring_sqe *sqe = &sqes_[index];
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode    = IORING_OP_RECVMSG;
+        sqe->fd        = fd;
+        sqe->addr      = (uint64_t)(uintptr_t)&msgs[i].msg_hdr;
+        sqe->len       = 1;
+        sqe->msg_flags = (uint32_t)flags;
+        sqe->user_data = i;
+
+        // the datagrams must end up in consecutive buffers, so stop at the first empty read
+        if (i + 1 < count)
+            sqe->flags |= IOSQE_IO_LINK;
+
+        sq_array_[index] = index;
+        ++tail;
+    }
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+    rtp_error_t ret = submit_and_wait(count, results);
+    if (ret != RTP_OK)
+        return ret;
+
+    int packets = 0;
+    for (; packets < (int)count && results[packets] >= 0; ++packets) {
+        msgs[packets].msg_len = (unsigned)results[packets];
+    }
+
+    if (packets == 0) {
+        int error = -results[0];
+
+        if (error == EAGAIN || error == EWOULDBLOCK || error == EINTR || error == ECANCELED) {
+            *received = 0;
+            return RTP_INTERRUPTED;
+        }
+        UVG_LOG_ERROR("io_uring recvmsg failed: %s", strerror(error));
+
+        *received = -1;
+        return RTP_GENERIC_ERROR;
+    }
+
+    *received = packets;
+    return RTP_OK;
+#else
+    (void)fd, (void)msgs, (void)count, (void)flags;
+    *received = -1;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+#endif
+
+rtp_error_t uvgrtp::uring::submit_and_wait(unsigned count, int *results)
+{
+#ifdef UVGRTP_HAVE_IO_URING
+    unsigned submitted = 0;
+    unsigned completed = 0;
+
+    while (completed < count) {
+        int ret = (int)syscall(__NR_io_uring_enter, ring_fd_, count - submitted, count - completed,
+            IORING_ENTER_GETEVENTS, nullptr, 0);
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+
+            UVG_LOG_ERROR("io_uring_enter(2) failed: %s", strerror(errno));
+            return RTP_GENERIC_ERROR;
+        }
+        submitted += (unsigned)ret;
+
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; ++head) {
+            struct io_uring_cqe *cqe = &cqes_[head & *cq_mask_];
+
+            if (cqe->user_data < count) {
+                results[cqe->user_data] = cqe->res;
+                ++completed;
+            }
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+
+    return RTP_OK;
+#else
+    (void)count, (void)results;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
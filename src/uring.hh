@@ -0,0 +1,85 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace uvgrtp {
+
+    /* Small wrapper around a Linux io_uring instance that uvgrtp::socket uses to send and
+     * receive batches of datagrams. The ring is driven directly through the io_uring system
+     * calls so no extra library is needed.
+     *
+     * The whole batch is queued as submission queue entries and submitted with one
+     * io_uring_enter(2) call, which also waits for the completions. The ring is only used
+     * if uvgRTP has been built with UVGRTP_ENABLE_IO_URING, otherwise init() fails
+     * and the socket keeps using sendmmsg(2) and recvmmsg(2).
+     *
+     * A ring is not thread-safe, so the socket has separate rings for sending and receiving. */
+    class uring {
+        public:
+            uring();
+            ~uring();
+
+            /* Create the ring with room for "entries" operations that are in flight at the same time
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if io_uring is not available */
+            rtp_error_t init(unsigned entries);
+
+            /* Maximum number of messages one send or receive call processes, 0 if init() has failed */
+            unsigned get_entries() const;
+
+#ifndef _WIN32
+            /* Send "count" messages to socket "fd" with sendmsg operations. The size of each sent
+             * message is written to its "msg_len". At most get_entries() messages are sent
+             *
+             * Return RTP_OK if all messages were sent
+             * Return RTP_SEND_ERROR if sending of one or more messages failed */
+            rtp_error_t sendmsg(int fd, struct mmsghdr *msgs, unsigned count, int flags);
+
+            /* Receive up to "count" messages from socket "fd" with linked recvmsg operations,
+             * so the first one that finds no data cancels the rest. The size of each
+             * received message is written to its "msg_len". At most get_entries() messages are read
+             *
+             * Return RTP_OK and write the number of received messages to "received"
+             * Return RTP_INTERRUPTED if there was nothing to read
+             * Return RTP_GENERIC_ERROR on error */
+            rtp_error_t recvmsg(int fd, struct mmsghdr *msgs, unsigned count, int flags, int *received);
+#endif
+
+        private:
+            /* Submit "count" prepared entries and wait until all of them have completed.
+             * The result of entry "i" is written to "results[i]" */
+            rtp_error_t submit_and_wait(unsigned count, int *results);
+
+            int ring_fd_;
+            unsigned entries_;
+
+            void *sq_ring_;
+            void *cq_ring_;
+            size_t sq_ring_size_;
+            size_t cq_ring_size_;
+
+            unsigned *sq_tail_;
+            unsigned *sq_mask_;
+            unsigned *sq_array_;
+            unsigned *cq_head_;
+            unsigned *cq_tail_;
+            unsigned *cq_mask_;
+
+            io_uring_sqe *sqes_;
+            io_uring_cqe *cqes_;
+            size_t sqes_size_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,102 @@
+#include "worker_pool.hh"
+
+uvgrtp::worker_pool::worker_pool() :
+    threads_(),
+    task_(nullptr),
+    count_(0),
+    generation_(0),
+    pending_(0),
+    active_(false)
+{
+}
+
+uvgrtp::worker_pool::~worker_pool()
+{
+    resize(0);
+}
+
+void uvgrtp::worker_pool::resize(size_t threads)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = false;
+    }
+    cond_.notify_all();
+
+    for (auto& thread : threads_) {
+        if (thread.joinable())
+            thread.join();
+    }
+    threads_.clear();
+
+    // the threads read the size of the pool under the lock, so it is held until all exist
+    std::lock_guard<std::mutex> lock(mutex_);
+    active_ = true;
+    for (size_t i = 1; i <= threads; ++i) {
+        threads_.emplace_back(&uvgrtp::worker_pool::worker, this, i, generation_);
+    }
+}
+
+size_t uvgrtp::worker_pool::size() const
+{
+    return threads_.size();
+}
+
+void uvgrtp::worker_pool::get_range(size_t count, size_t workers, size_t worker, size_t& begin, size_t& end)
+{
+    begin = count * worker / workers;
+    end   = count * (worker + 1) / workers;
+}
+
+void uvgrtp::worker_pool::run(size_t count, const std::function<void(size_t, size_t, size_t)>& task)
+{
+    const size_t workers = threads_.size() + 1;
+
+    // small batches are not worth waking up the threads for
+    if (workers == 1 || count < workers) {
+        task(0, count, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_    = &task;
+        count_   = count;
+        pending_ = threads_.size();
+        ++generation_;
+    }
+    cond_.notify_all();
+
+    size_t begin, end;
+    get_range(count, workers, 0, begin, end);
+    task(begin, end, 0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cond_.wait(lock, [this] { return pending_ == 0; });
+    task_ = nullptr;
+}
+
+void uvgrtp::worker_pool::worker(size_t index, uint64_t seen)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true) {
+        cond_.wait(lock, [this, seen] { return !active_ || generation_ != seen; });
+
+        if (!active_)
+            break;
+
+        seen = generation_;
+        const size_t workers = threads_.size() + 1;
+        size_t begin, end;
+        get_range(count_, workers, index, begin, end);
+
+        auto task = task_;
+        lock.unlock();
+        (*task)(begin, end, index);
+        lock.lock();
+
+        if (--pending_ == 0)
+            done_cond_.notify_one();
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* A fixed set of threads that split independent work items with the calling thread.
+     *
+     * run() divides the items into one contiguous range per thread, the caller included,
+     * and returns when all ranges are done, so the results can be used in order right
+     * after the call. With no threads, the caller processes all items itself */
+    class worker_pool {
+        public:
+            worker_pool();
+            ~worker_pool();
+
+            /* Stop the current threads and start "threads" new ones, 0 stops all of them.
+             * Must not be called during run() */
+            void resize(size_t threads);
+
+            /* Number of threads in addition to the caller */
+            size_t size() const;
+
+            /* Call "task" for ranges [begin, end) that cover [0, count) in parallel.
+             * "worker" is 0 for the calling thread and 1 to size() for the threads,
+             * so that each of them can use its own state */
+            void run(size_t count, const std::function<void(size_t begin, size_t end, size_t worker)>& task);
+
+        private:
+            /* "seen" is the generation when the thread was created, so a run() that starts
+             * before the thread first takes the lock is not missed */
+            void worker(size_t index, uint64_t seen);
+
+            /* The range of "worker" when "count" items are split between "workers" threads */
+            static void get_range(size_t count, size_t workers, size_t worker, size_t& begin, size_t& end);
+
+            std::mutex mutex_;
+            std::condition_variable cond_;
+            std::condition_variable done_cond_;
+
+            std::vector<std::thread> threads_;
+
+            const std::function<void(size_t, size_t, size_t)> *task_;
+            size_t count_;
+
+            /* Incremented for each run() so that the threads know there is new work */
+            uint64_t generation_;
+            size_t pending_;
+            bool active_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <iostream>
 #include <string>
+#include <cstring>
 
 #include <uvgrtp/lib.hh>
 #include <uvgrtp/wrapper_c.hh>
@@ -65,4 +67,177 @@ uvgrtp_push_frame(void* uvgrtp_stream, uint8_t* data, size_t data_len, int rtp_f
 {
     uvgrtp::media_stream* uvg_stream_ptr = (uvgrtp::media_stream*)uvgrtp_stream;
     uvg_stream_ptr->push_frame(data, data_len, rtp_flags);
-}
\ No newline at end of file
+}
+
+int
+uvgrtp_push_frame_owned(void* uvgrtp_stream, uint8_t* data, size_t data_len, int rtp_flags,
+    uvgrtp_release_hook release, void* arg)
+{
+    if (!uvgrtp_stream)
+        return RTP_INVALID_VALUE;
+
+    uvgrtp::media_stream* uvg_stream_ptr = (uvgrtp::media_stream*)uvgrtp_stream;
+    return uvg_stream_ptr->push_frame(data, data_len, rtp_flags, arg, release);
+}
+
+size_t
+uvgrtp_push_frames(void* uvgrtp_stream, uvgrtp_push_request* requests, size_t count)
+{
+    if (!uvgrtp_stream || !requests)
+        return 0;
+
+    uvgrtp::media_stream* uvg_stream_ptr = (uvgrtp::media_stream*)uvgrtp_stream;
+    size_t pushed = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        uvgrtp_push_request& request = requests[i];
+
+        if (request.release) {
+            request.result = uvg_stream_ptr->push_frame(request.data, request.data_len, request.rtp_flags,
+                request.arg, request.release);
+        } else {
+            request.result = uvg_stream_ptr->push_frame(request.data, request.data_len, request.rtp_flags);
+        }
+
+        if (request.result == RTP_OK)
+            ++pushed;
+    }
+
+    return pushed;
+}
+
+static void
+uvgrtp_fill_frame(uvgrtp_frame* to, uvgrtp::frame::rtp_frame* from)
+{
+    to->payload      = from->payload;
+    to->payload_len  = from->payload_len;
+    to->timestamp    = from->header.timestamp;
+    to->ssrc         = from->header.ssrc;
+    to->seq          = from->header.seq;
+    to->payload_type = from->header.payload;
+    to->marker       = from->header.marker;
+    to->handle       = from;
+}
+
+size_t
+uvgrtp_pull_frames(void* uvgrtp_stream, uvgrtp_frame* frames, size_t max_frames, size_t timeout_ms)
+{
+    if (!uvgrtp_stream || !frames)
+        return 0;
+
+    uvgrtp::media_stream* uvg_stream_ptr = (uvgrtp::media_stream*)uvgrtp_stream;
+
+    // the frames are taken in chunks so that nothing is allocated, only the first chunk is waited for
+    constexpr size_t CHUNK = 64;
+    uvgrtp::frame::rtp_frame* chunk[CHUNK];
+    size_t pulled = 0;
+
+    while (pulled < max_frames) {
+        size_t n = uvg_stream_ptr->pull_frames(chunk, std::min(CHUNK, max_frames - pulled),
+            pulled ? 0 : timeout_ms);
+
+        for (size_t i = 0; i < n; ++i) {
+            uvgrtp_fill_frame(&frames[pulled++], chunk[i]);
+        }
+
+        if (n < CHUNK)
+            break;
+    }
+
+    return pulled;
+}
+
+void
+uvgrtp_release_frames(uvgrtp_frame* frames, size_t count)
+{
+    if (!frames)
+        return;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (frames[i].handle) {
+            (void)uvgrtp::frame::dealloc_frame((uvgrtp::frame::rtp_frame*)frames[i].handle);
+            frames[i].handle = nullptr;
+        }
+    }
+}
+
+int
+uvgrtp_pull_frame_into(void* uvgrtp_stream, uint8_t* buffer, size_t buffer_len, uvgrtp_frame* frame,
+    size_t timeout_ms)
+{
+    if (!uvgrtp_stream || !frame)
+        return RTP_INVALID_VALUE;
+
+    uvgrtp::media_stream* uvg_stream_ptr = (uvgrtp::media_stream*)uvgrtp_stream;
+    uvgrtp::frame::rtp_frame* received = nullptr;
+
+    if (uvg_stream_ptr->pull_frames(&received, 1, timeout_ms) == 0)
+        return RTP_TIMEOUT;
+
+    uvgrtp_fill_frame(frame, received);
+
+    if (!buffer || received->payload_len > buffer_len)
+        return RTP_MEMORY_ERROR;
+
+    std::memcpy(buffer, received->payload, received->payload_len);
+    frame->payload = buffer;
+    frame->handle  = nullptr;
+
+    (void)uvgrtp::frame::dealloc_frame(received);
+    return RTP_OK;
+}
+
+static void
+uvgrtp_copy_histogram(uvgrtp_stats_histogram* to, const uvgrtp::stats_histogram& from)
+{
+    static_assert(UVGRTP_STATS_HISTOGRAM_BUCKETS == uvgrtp::STATS_HISTOGRAM_BUCKETS,
+        "the histograms of the C API must match the ones of media_stream");
+
+    std::memcpy(to->buckets, from.buckets, sizeof(to->buckets));
+    to->count = from.count;
+    to->sum   = from.sum;
+}
+
+void
+uvgrtp_get_stats(void* uvgrtp_stream, uvgrtp_stream_stats* stats)
+{
+    if (!uvgrtp_stream || !stats)
+        return;
+
+    uvgrtp::media_stream* uvg_stream_ptr = (uvgrtp::media_stream*)uvgrtp_stream;
+    uvgrtp::stream_stats s = uvg_stream_ptr->get_stats();
+
+    stats->sent_frames           = s.sent_frames;
+    stats->sent_bytes            = s.sent_bytes;
+    stats->sent_packets          = s.sent_packets;
+    stats->send_errors           = s.send_errors;
+    stats->received_packets      = s.received_packets;
+    stats->received_bytes        = s.received_bytes;
+    stats->received_frames       = s.received_frames;
+    stats->duplicate_packets     = s.duplicate_packets;
+    stats->late_packets          = s.late_packets;
+    stats->dropped_frames        = s.dropped_frames;
+    stats->late_frames           = s.late_frames;
+    stats->skipped_frames        = s.skipped_frames;
+    stats->srtp_auth_failures    = s.srtp_auth_failures;
+    stats->srtp_replayed_packets = s.srtp_replayed_packets;
+    stats->ring_full_events      = s.ring_full_events;
+    stats->ring_watermark_events = s.ring_watermark_events;
+    stats->ring_resizes          = s.ring_resizes;
+    stats->kernel_drops          = s.kernel_drops;
+    stats->shed_frames           = s.shed_frames;
+    stats->merged_packets        = s.merged_packets;
+    stats->memory_usage          = s.memory_usage;
+
+    uvgrtp_copy_histogram(&stats->reassembly_latency_us, s.reassembly_latency_us);
+    uvgrtp_copy_histogram(&stats->queue_depth,           s.queue_depth);
+    uvgrtp_copy_histogram(&stats->send_batch_size,       s.send_batch_size);
+    uvgrtp_copy_histogram(&stats->send_delay_us,         s.send_delay_us);
+    uvgrtp_copy_histogram(&stats->stage_demux_ns,        s.stage_demux_ns);
+    uvgrtp_copy_histogram(&stats->stage_srtp_ns,         s.stage_srtp_ns);
+    uvgrtp_copy_histogram(&stats->stage_reassembly_ns,   s.stage_reassembly_ns);
+    uvgrtp_copy_histogram(&stats->stage_delivery_ns,     s.stage_delivery_ns);
+    uvgrtp_copy_histogram(&stats->stage_packetize_ns,    s.stage_packetize_ns);
+    uvgrtp_copy_histogram(&stats->stage_fanout_ns,       s.stage_fanout_ns);
+    uvgrtp_copy_histogram(&stats->stage_send_ns,         s.stage_send_ns);
+}
@@ -0,0 +1,618 @@
+#include "xdp.hh"
+
+#include "memory_transport.hh"
+#include "debug.hh"
+
+#ifdef UVGRTP_HAVE_XDP
+#include <linux/bpf.h>
+#include <linux/if_xdp.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+/* The frames of the UMEM, the first half is received to and the second half sent from */
+constexpr size_t XDP_FRAME_SIZE  = 2048;
+constexpr size_t XDP_RING_SIZE   = 2048;
+constexpr size_t XDP_RX_FRAMES   = XDP_RING_SIZE;
+constexpr size_t XDP_TX_FRAMES   = XDP_RING_SIZE;
+
+/* The Ethernet, IPv4 and UDP headers in front of the payload. The program only redirects
+ * the datagrams without IP options, so the headers always have this size */
+constexpr size_t XDP_HEADERS_SIZE = 14 + 20 + 8;
+
+constexpr int XDP_POLL_TIMEOUT_MS = 100;
+
+#ifdef UVGRTP_HAVE_XDP
+static int sys_bpf(int cmd, union bpf_attr& attr)
+{
+    return (int)syscall(__NR_bpf, cmd, &attr, sizeof(attr));
+}
+
+static struct bpf_insn bpf_instruction(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm)
+{
+    struct bpf_insn insn;
+    memset(&insn, 0, sizeof(insn));
+
+    insn.code    = code;
+    insn.dst_reg = dst & 0x0f;
+    insn.src_reg = src & 0x0f;
+    insn.off     = off;
+    insn.imm     = imm;
+    return insn;
+}
+
+static uint16_t ip_checksum(const uint8_t *header, size_t len)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        sum += ((uint32_t)header[i] << 8) | header[i + 1];
+    }
+
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return htons((uint16_t)~sum);
+}
+#endif
+
+uvgrtp::xdp_device::xdp_device():
+    fd_(-1),
+    ifindex_(0),
+    zero_copy_(false),
+    umem_(nullptr),
+    umem_size_(0),
+    ports_fd_(-1),
+    sockets_fd_(-1),
+    program_fd_(-1),
+    link_fd_(-1),
+    active_(false),
+    receiver_(nullptr),
+    payload_(1)
+{
+}
+
+uvgrtp::xdp_device::~xdp_device()
+{
+#ifdef UVGRTP_HAVE_XDP
+    if (receiver_) {
+        active_ = false;
+        stop_event_.signal();
+        receiver_->join();
+    }
+
+    // closing the link detaches the program from the interface
+    for (int fd : { link_fd_, program_fd_, sockets_fd_, ports_fd_ }) {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    for (ring *r : { &fill_, &completion_, &rx_, &tx_ }) {
+        if (r->map)
+            munmap(r->map, r->map_size);
+    }
+
+    if (fd_ >= 0)
+        close(fd_);
+
+    if (umem_)
+        munmap(umem_, umem_size_);
+#endif
+}
+
+rtp_error_t uvgrtp::xdp_device::init(const std::string& interface, unsigned queue,
+    std::shared_ptr<uvgrtp::thread_settings> settings)
+{
+#ifdef UVGRTP_HAVE_XDP
+    if ((ifindex_ = if_nametoindex(interface.c_str())) == 0) {
+        UVG_LOG_ERROR("No interface %s for AF_XDP", interface.c_str());
+        return RTP_INVALID_VALUE;
+    }
+
+    rtp_error_t ret = RTP_OK;
+    if ((ret = create_socket(queue)) != RTP_OK || (ret = load_program(queue)) != RTP_OK)
+        return ret;
+
+    UVG_LOG_INFO("AF_XDP on %s queue %u in %s mode", interface.c_str(), queue, zero_copy_ ? "zero-copy" : "copy");
+
+    active_   = true;
+    receiver_ = uvgrtp::start_thread(settings, RTP_THREAD_RECEIVER, -1, &uvgrtp::xdp_device::receiver, this);
+    return RTP_OK;
+#else
+    (void)interface;
+    (void)queue;
+    (void)settings;
+
+    UVG_LOG_ERROR("uvgRTP has been built without AF_XDP, see UVGRTP_ENABLE_XDP");
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+#ifdef UVGRTP_HAVE_XDP
+rtp_error_t uvgrtp::xdp_device::create_socket(unsigned queue)
+{
+    if ((fd_ = ::socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0)) < 0) {
+        UVG_LOG_ERROR("Failed to create an AF_XDP socket: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+
+    umem_size_ = (XDP_RX_FRAMES + XDP_TX_FRAMES) * XDP_FRAME_SIZE;
+    void *umem = mmap(nullptr, umem_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+
+    if (umem == MAP_FAILED) {
+        UVG_LOG_ERROR("Failed to allocate the UMEM: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+    umem_ = (uint8_t *)umem;
+
+    struct xdp_umem_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.addr       = (uint64_t)(uintptr_t)umem_;
+    reg.len        = umem_size_;
+    reg.chunk_size = XDP_FRAME_SIZE;
+    reg.headroom   = 0;
+
+    if (setsockopt(fd_, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) {
+        UVG_LOG_ERROR("Failed to register the UMEM: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+
+    int entries = (int)XDP_RING_SIZE;
+    for (int ring : { XDP_UMEM_FILL_RING, XDP_UMEM_COMPLETION_RING, XDP_RX_RING, XDP_TX_RING }) {
+        if (setsockopt(fd_, SOL_XDP, ring, &entries, sizeof(entries)) < 0) {
+            UVG_LOG_ERROR("Failed to set the size of an AF_XDP ring: %s", strerror(errno));
+            return RTP_NOT_SUPPORTED;
+        }
+    }
+
+    struct xdp_mmap_offsets offsets;
+    socklen_t len = sizeof(offsets);
+
+    if (getsockopt(fd_, SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &len) < 0) {
+        UVG_LOG_ERROR("Failed to get the offsets of the AF_XDP rings: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+
+    rtp_error_t ret = RTP_OK;
+    if ((ret = map_ring(fill_, offsets.fr, XDP_RING_SIZE, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING)) != RTP_OK ||
+        (ret = map_ring(completion_, offsets.cr, XDP_RING_SIZE, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING)) != RTP_OK ||
+        (ret = map_ring(rx_, offsets.rx, XDP_RING_SIZE, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING)) != RTP_OK ||
+        (ret = map_ring(tx_, offsets.tx, XDP_RING_SIZE, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING)) != RTP_OK) {
+        return ret;
+    }
+
+    // the kernel receives to the frames of the fill ring, so all the receive frames are given to it
+    uint64_t *fill = (uint64_t *)fill_.descs;
+    for (size_t i = 0; i < XDP_RX_FRAMES; ++i) {
+        fill[i & fill_.mask] = i * XDP_FRAME_SIZE;
+    }
+    __atomic_store_n(fill_.producer, (uint32_t)XDP_RX_FRAMES, __ATOMIC_RELEASE);
+
+    tx_free_.reserve(XDP_TX_FRAMES);
+    for (size_t i = 0; i < XDP_TX_FRAMES; ++i) {
+        tx_free_.push_back((XDP_RX_FRAMES + i) * XDP_FRAME_SIZE);
+    }
+
+    struct sockaddr_xdp address;
+    memset(&address, 0, sizeof(address));
+    address.sxdp_family   = AF_XDP;
+    address.sxdp_ifindex  = ifindex_;
+    address.sxdp_queue_id = queue;
+    address.sxdp_flags    = XDP_USE_NEED_WAKEUP | XDP_ZEROCOPY;
+
+    // drivers without zero-copy support copy the frames to and from the UMEM
+    zero_copy_ = true;
+    if (bind(fd_, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        address.sxdp_flags = XDP_USE_NEED_WAKEUP | XDP_COPY;
+        zero_copy_ = false;
+
+        if (bind(fd_, (struct sockaddr *)&address, sizeof(address)) < 0) {
+            UVG_LOG_ERROR("Failed to bind the AF_XDP socket to queue %u: %s", queue, strerror(errno));
+            return RTP_NOT_SUPPORTED;
+        }
+    }
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::xdp_device::map_ring(ring& r, const xdp_ring_offset& offsets, size_t entries, size_t desc_size, uint64_t pgoff)
+{
+    r.map_size = offsets.desc + entries * desc_size;
+    r.map      = mmap(nullptr, r.map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, (off_t)pgoff);
+
+    if (r.map == MAP_FAILED) {
+        r.map = nullptr;
+        UVG_LOG_ERROR("Failed to map an AF_XDP ring: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+
+    uint8_t *base = (uint8_t *)r.map;
+    r.producer = (uint32_t *)(base + offsets.producer);
+    r.consumer = (uint32_t *)(base + offsets.consumer);
+    r.flags    = (uint32_t *)(base + offsets.flags);
+    r.descs    = base + offsets.desc;
+    r.mask     = (uint32_t)entries - 1;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::xdp_device::load_program(unsigned queue)
+{
+    union bpf_attr attr;
+
+    // the ports of the sockets and the AF_XDP socket the datagrams sent to them are redirected to
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type    = BPF_MAP_TYPE_HASH;
+    attr.key_size    = sizeof(uint32_t);
+    attr.value_size  = sizeof(uint32_t);
+    attr.max_entries = MAX_XDP_PORTS;
+    strncpy(attr.map_name, "uvgrtp_ports", sizeof(attr.map_name) - 1);
+
+    if ((ports_fd_ = sys_bpf(BPF_MAP_CREATE, attr)) < 0) {
+        UVG_LOG_ERROR("Failed to create the port map of the XDP program: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type    = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size    = sizeof(uint32_t);
+    attr.value_size  = sizeof(uint32_t);
+    attr.max_entries = 1;
+    strncpy(attr.map_name, "uvgrtp_xsks", sizeof(attr.map_name) - 1);
+
+    if ((sockets_fd_ = sys_bpf(BPF_MAP_CREATE, attr)) < 0) {
+        UVG_LOG_ERROR("Failed to create the socket map of the XDP program: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+
+    uint32_t key = 0;
+    uint32_t fd  = (uint32_t)fd_;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = sockets_fd_;
+    attr.key    = (uint64_t)(uintptr_t)&key;
+    attr.value  = (uint64_t)(uintptr_t)&fd;
+
+    if (sys_bpf(BPF_MAP_UPDATE_ELEM, attr) < 0) {
+        UVG_LOG_ERROR("Failed to add the AF_XDP socket to the XDP program: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+
+    /* The fields are compared as they are loaded from the packet, in network byte order. r2 and r3
+     * point to the start and end of the packet and the headers of an IPv4 UDP datagram without
+     * options are checked before its destination port is looked up from the port map */
+    const int32_t ether_ip      = htons(0x0800);
+    const int32_t fragment_mask = htons(0x3fff);
+    const int16_t pass          = -1;
+
+    std::vector<struct bpf_insn> program = {
+        bpf_instruction(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_1, offsetof(struct xdp_md, data), 0),
+        bpf_instruction(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_1, offsetof(struct xdp_md, data_end), 0),
+        bpf_instruction(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_4, BPF_REG_1, offsetof(struct xdp_md, rx_queue_index), 0),
+        bpf_instruction(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_4, 0, pass, (int32_t)queue),
+        bpf_instruction(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_5, BPF_REG_2, 0, 0),
+        bpf_instruction(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_5, 0, 0, (int32_t)XDP_HEADERS_SIZE),
+        bpf_instruction(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_5, BPF_REG_3, pass, 0),
+        bpf_instruction(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, 12, 0),    // EtherType
+        bpf_instruction(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, pass, ether_ip),
+        bpf_instruction(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, 14, 0),    // version and IHL
+        bpf_instruction(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, pass, 0x45),
+        bpf_instruction(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, 23, 0),    // protocol
+        bpf_instruction(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, pass, IPPROTO_UDP),
+        bpf_instruction(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, 20, 0),    // fragment offset
+        bpf_instruction(BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_5, 0, 0, fragment_mask),
+        bpf_instruction(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, pass, 0),
+        bpf_instruction(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, 36, 0),    // UDP destination port
+        bpf_instruction(BPF_STX | BPF_MEM | BPF_W, BPF_REG_10, BPF_REG_5, -4, 0),
+        bpf_instruction(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_10, 0, 0),
+        bpf_instruction(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_2, 0, 0, -4),
+        bpf_instruction(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, ports_fd_),
+        bpf_instruction(0, 0, 0, 0, 0),
+        bpf_instruction(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem),
+        bpf_instruction(BPF_JMP | BPF_JEQ | BPF_K, BPF_REG_0, 0, pass, 0),
+        bpf_instruction(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, sockets_fd_),
+        bpf_instruction(0, 0, 0, 0, 0),
+        bpf_instruction(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_2, 0, 0, 0),
+        bpf_instruction(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS),   // if the socket is gone
+        bpf_instruction(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+        bpf_instruction(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+    };
+
+    // the jumps to the end go past the redirect
+    const int16_t end = (int16_t)program.size();
+    for (int16_t i = 0; i < end; ++i) {
+        if (BPF_CLASS(program[i].code) == BPF_JMP && program[i].off == pass)
+            program[i].off = end - i - 1;
+    }
+
+    program.push_back(bpf_instruction(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS));
+    program.push_back(bpf_instruction(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+
+    static const char license[] = "BSD";
+    char log[4096] = {};
+
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type            = BPF_PROG_TYPE_XDP;
+    attr.expected_attach_type = BPF_XDP;
+    attr.insn_cnt             = (uint32_t)program.size();
+    attr.insns                = (uint64_t)(uintptr_t)program.data();
+    attr.license              = (uint64_t)(uintptr_t)license;
+    attr.log_buf              = (uint64_t)(uintptr_t)log;
+    attr.log_size             = sizeof(log);
+    attr.log_level            = 1;
+    strncpy(attr.prog_name, "uvgrtp_rtp", sizeof(attr.prog_name) - 1);
+
+    if ((program_fd_ = sys_bpf(BPF_PROG_LOAD, attr)) < 0) {
+        UVG_LOG_ERROR("Failed to load the XDP program: %s", strerror(errno));
+        UVG_LOG_DEBUG("%s", log);
+        return RTP_NOT_SUPPORTED;
+    }
+
+    // the link fails if the interface already has a program, which is kept
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd        = program_fd_;
+    attr.link_create.target_ifindex = ifindex_;
+    attr.link_create.attach_type    = BPF_XDP;
+
+    if ((link_fd_ = sys_bpf(BPF_LINK_CREATE, attr)) < 0) {
+        UVG_LOG_ERROR("Failed to attach the XDP program: %s", strerror(errno));
+        return RTP_NOT_SUPPORTED;
+    }
+
+    return RTP_OK;
+}
+#endif
+
+rtp_error_t uvgrtp::xdp_device::add_port(uint16_t port, std::shared_ptr<uvgrtp::memory_transport> receiver)
+{
+#ifdef UVGRTP_HAVE_XDP
+    std::lock_guard<std::mutex> lg(ports_mutex_);
+
+    if (ports_.size() >= MAX_XDP_PORTS && ports_.find(port) == ports_.end())
+        return RTP_MEMORY_ERROR;
+
+    uint32_t key   = port;
+    uint32_t value = 1;
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = ports_fd_;
+    attr.key    = (uint64_t)(uintptr_t)&key;
+    attr.value  = (uint64_t)(uintptr_t)&value;
+
+    if (sys_bpf(BPF_MAP_UPDATE_ELEM, attr) < 0) {
+        UVG_LOG_ERROR("Failed to redirect port %u to AF_XDP: %s", ntohs(port), strerror(errno));
+        return RTP_GENERIC_ERROR;
+    }
+
+    ports_[port] = receiver;
+    return RTP_OK;
+#else
+    (void)port;
+    (void)receiver;
+    return RTP_NOT_SUPPORTED;
+#endif
+}
+
+void uvgrtp::xdp_device::remove_port(uint16_t port)
+{
+#ifdef UVGRTP_HAVE_XDP
+    std::lock_guard<std::mutex> lg(ports_mutex_);
+
+    if (ports_.erase(port) == 0)
+        return;
+
+    uint32_t key = port;
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = ports_fd_;
+    attr.key    = (uint64_t)(uintptr_t)&key;
+
+    (void)sys_bpf(BPF_MAP_DELETE_ELEM, attr);
+#else
+    (void)port;
+#endif
+}
+
+void uvgrtp::xdp_device::receiver()
+{
+#ifdef UVGRTP_HAVE_XDP
+    struct xdp_desc *descs = (struct xdp_desc *)rx_.descs;
+    uint64_t *fill         = (uint64_t *)fill_.descs;
+
+    while (active_) {
+        struct pollfd pfds[2] = {};
+        pfds[0].fd     = fd_;
+        pfds[0].events = POLLIN;
+        pfds[1].fd     = stop_event_.fd();
+        pfds[1].events = POLLIN;
+
+        if (poll(pfds, stop_event_.fd() >= 0 ? 2 : 1, XDP_POLL_TIMEOUT_MS) < 0 && errno != EINTR) {
+            UVG_LOG_ERROR("poll(2) of the AF_XDP socket failed: %s", strerror(errno));
+            break;
+        }
+
+        uint32_t consumer = *rx_.consumer;
+        uint32_t producer = __atomic_load_n(rx_.producer, __ATOMIC_ACQUIRE);
+
+        if (consumer == producer)
+            continue;
+
+        // every received frame came from the fill ring, so there is always room to give it back
+        uint32_t fill_producer = *fill_.producer;
+        {
+            std::lock_guard<std::mutex> lg(ports_mutex_);
+
+            for (; consumer != producer; ++consumer) {
+                const struct xdp_desc& desc = descs[consumer & rx_.mask];
+                deliver(umem_ + desc.addr, desc.len);
+
+                fill[fill_producer++ & fill_.mask] = desc.addr & ~(uint64_t)(XDP_FRAME_SIZE - 1);
+            }
+        }
+
+        __atomic_store_n(rx_.consumer, consumer, __ATOMIC_RELEASE);
+        __atomic_store_n(fill_.producer, fill_producer, __ATOMIC_RELEASE);
+
+        if (__atomic_load_n(fill_.flags, __ATOMIC_ACQUIRE) & XDP_RING_NEED_WAKEUP)
+            (void)recvfrom(fd_, nullptr, 0, MSG_DONTWAIT, nullptr, nullptr);
+    }
+#endif
+}
+
+void uvgrtp::xdp_device::deliver(uint8_t *frame, size_t len)
+{
+#ifdef UVGRTP_HAVE_XDP
+    if (len < XDP_HEADERS_SIZE)
+        return;
+
+    const uint8_t *ip  = frame + 14;
+    const uint8_t *udp = ip + 20;
+
+    uint16_t port;
+    memcpy(&port, udp + 2, sizeof(port));
+
+    auto receiver = ports_.find(port);
+    if (receiver == ports_.end())
+        return;
+
+    size_t udp_len = ((size_t)udp[4] << 8) | udp[5];
+    if (udp_len < 8 || XDP_HEADERS_SIZE - 8 + udp_len > len)
+        return;
+
+    sockaddr_in sender = {};
+    sender.sin_family = AF_INET;
+    memcpy(&sender.sin_port, udp, sizeof(sender.sin_port));
+    memcpy(&sender.sin_addr.s_addr, ip + 12, sizeof(sender.sin_addr.s_addr));
+
+    // the reply goes back the way the datagram came
+    path learned;
+    memcpy(learned.local_mac, frame, sizeof(learned.local_mac));
+    memcpy(learned.remote_mac, frame + 6, sizeof(learned.remote_mac));
+    memcpy(&learned.local_ip, ip + 16, sizeof(learned.local_ip));
+    {
+        std::lock_guard<std::mutex> lg(paths_mutex_);
+        paths_[sender.sin_addr.s_addr] = learned;
+    }
+
+    payload_[0] = { udp_len - 8, frame + XDP_HEADERS_SIZE };
+    if (!receiver->second->deliver((const struct sockaddr *)&sender, sizeof(sender), payload_)) {
+        UVG_LOG_DEBUG("The queue of port %u is full, dropping a datagram", ntohs(port));
+    }
+#else
+    (void)frame;
+    (void)len;
+#endif
+}
+
+bool uvgrtp::xdp_device::send(uint16_t port, const sockaddr_in& addr, const std::vector<std::pair<size_t, uint8_t *>>& buffers)
+{
+#ifdef UVGRTP_HAVE_XDP
+    size_t len = 0;
+    for (auto& buffer : buffers) {
+        len += buffer.first;
+    }
+
+    if (XDP_HEADERS_SIZE + len > XDP_FRAME_SIZE)
+        return false;
+
+    path route;
+    {
+        std::lock_guard<std::mutex> lg(paths_mutex_);
+
+        auto known = paths_.find(addr.sin_addr.s_addr);
+        if (known == paths_.end())
+            return false;
+        route = known->second;
+    }
+
+    std::lock_guard<std::mutex> lg(tx_mutex_);
+    reap_completions();
+
+    uint32_t producer = *tx_.producer;
+    if (tx_free_.empty() || producer - __atomic_load_n(tx_.consumer, __ATOMIC_ACQUIRE) >= XDP_RING_SIZE)
+        return false;
+
+    uint64_t offset = tx_free_.back();
+    tx_free_.pop_back();
+
+    uint8_t *frame = umem_ + offset;
+    uint8_t *ip    = frame + 14;
+    uint8_t *udp   = ip + 20;
+
+    memcpy(frame, route.remote_mac, 6);
+    memcpy(frame + 6, route.local_mac, 6);
+    frame[12] = 0x08;
+    frame[13] = 0x00;
+
+    uint16_t ip_len  = htons((uint16_t)(20 + 8 + len));
+    uint16_t udp_len = htons((uint16_t)(8 + len));
+
+    ip[0] = 0x45;
+    ip[1] = 0;
+    memcpy(ip + 2, &ip_len, 2);
+    memset(ip + 4, 0, 2);    // identification, not needed as the datagram is not fragmented
+    ip[6] = 0x40;            // don't fragment
+    ip[7] = 0;
+    ip[8] = 64;
+    ip[9] = IPPROTO_UDP;
+    memset(ip + 10, 0, 2);
+    memcpy(ip + 12, &route.local_ip, 4);
+    memcpy(ip + 16, &addr.sin_addr.s_addr, 4);
+
+    uint16_t checksum = ip_checksum(ip, 20);
+    memcpy(ip + 10, &checksum, 2);
+
+    // the UDP checksum is optional with IPv4 and left out
+    memcpy(udp, &port, 2);
+    memcpy(udp + 2, &addr.sin_port, 2);
+    memcpy(udp + 4, &udp_len, 2);
+    memset(udp + 6, 0, 2);
+
+    uint8_t *payload = udp + 8;
+    for (auto& buffer : buffers) {
+        memcpy(payload, buffer.second, buffer.first);
+        payload += buffer.first;
+    }
+
+    struct xdp_desc& desc = ((struct xdp_desc *)tx_.descs)[producer & tx_.mask];
+    desc.addr    = offset;
+    desc.len     = (uint32_t)(XDP_HEADERS_SIZE + len);
+    desc.options = 0;
+
+    __atomic_store_n(tx_.producer, producer + 1, __ATOMIC_RELEASE);
+
+    // in copy mode the kernel only sends when it is asked to
+    if (!zero_copy_ || (__atomic_load_n(tx_.flags, __ATOMIC_ACQUIRE) & XDP_RING_NEED_WAKEUP))
+        (void)sendto(fd_, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+
+    return true;
+#else
+    (void)port;
+    (void)addr;
+    (void)buffers;
+    return false;
+#endif
+}
+
+void uvgrtp::xdp_device::reap_completions()
+{
+#ifdef UVGRTP_HAVE_XDP
+    uint64_t *completed = (uint64_t *)completion_.descs;
+
+    uint32_t consumer = *completion_.consumer;
+    uint32_t producer = __atomic_load_n(completion_.producer, __ATOMIC_ACQUIRE);
+
+    for (; consumer != producer; ++consumer) {
+        tx_free_.push_back(completed[consumer & completion_.mask]);
+    }
+
+    __atomic_store_n(completion_.consumer, consumer, __ATOMIC_RELEASE);
+#endif
+}
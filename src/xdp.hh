@@ -0,0 +1,154 @@
+#pragma once
+
+#include "threads.hh"
+
+#include "uvgrtp/util.hh"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct xdp_ring_offset;
+
+namespace uvgrtp {
+
+    class memory_transport;
+
+    /* How many ports of a context can be steered to the AF_XDP socket */
+    const size_t MAX_XDP_PORTS = 64;
+
+    /* The AF_XDP transport of a context on one receive queue of one interface, see
+     * uvgrtp::context::set_xdp_interface()
+     *
+     * An XDP program attached to the queue redirects the IPv4 UDP datagrams sent to the ports of the
+     * media sockets of the context to an AF_XDP socket, and passes everything else, the other ports,
+     * fragments, IP options and the other queues, on to the network stack. The program is built from
+     * a few instructions and loaded with the bpf(2) system call, so no BPF toolchain or library is
+     * needed, and it is detached when the device is destroyed.
+     *
+     * The datagrams are read from the RX ring of the UMEM, the memory the socket shares with the
+     * driver, by the thread of the device, which copies them to the memory transport queue of the
+     * socket of their port, see uvgrtp::memory_transport. The reception threads of the sockets read
+     * the queues as they read the memory transport. The frames are then given back to the fill ring.
+     *
+     * A datagram is sent by writing it to a frame of the UMEM with the Ethernet, IP and UDP headers
+     * and putting the frame on the TX ring. The headers are those of the datagrams received from
+     * the destination turned around, so the path need not be resolved: until the destination has
+     * been heard from, send() fails and the datagram is sent through the kernel.
+     *
+     * Only used if uvgRTP has been built with UVGRTP_ENABLE_XDP, otherwise init() fails */
+    class xdp_device {
+        public:
+            xdp_device();
+            ~xdp_device();
+
+            xdp_device(const xdp_device&) = delete;
+            xdp_device& operator=(const xdp_device&) = delete;
+
+            /* Create the socket and its UMEM, load the program and attach it to "queue" of "interface",
+             * and start the thread that reads the socket with the settings of RTP_THREAD_RECEIVER
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if there is no such interface
+             * Return RTP_NOT_SUPPORTED if the system or the build does not support AF_XDP */
+            rtp_error_t init(const std::string& interface, unsigned queue,
+                std::shared_ptr<uvgrtp::thread_settings> settings);
+
+            /* Queue the datagrams sent to "port", in network byte order, to "receiver"
+             *
+             * Return RTP_OK on success
+             * Return RTP_MEMORY_ERROR if MAX_XDP_PORTS ports are already received
+             * Return RTP_GENERIC_ERROR if the kernel refuses the update of the program */
+            rtp_error_t add_port(uint16_t port, std::shared_ptr<uvgrtp::memory_transport> receiver);
+
+            /* Give the datagrams of "port" to the network stack again */
+            void remove_port(uint16_t port);
+
+            /* Send the datagram of "buffers" from "port" to "addr", ports in network byte order.
+             * May be called from any thread
+             *
+             * Return false if "addr" has not been heard from, the datagram does not fit into a frame
+             * or the TX ring is full, in which case it should be sent through the kernel */
+            bool send(uint16_t port, const sockaddr_in& addr, const std::vector<std::pair<size_t, uint8_t *>>& buffers);
+
+        private:
+            struct ring {
+                uint32_t *producer = nullptr;
+                uint32_t *consumer = nullptr;
+                uint32_t *flags    = nullptr;
+                void *descs        = nullptr;
+                uint32_t mask      = 0;
+                void *map          = nullptr;
+                size_t map_size    = 0;
+            };
+
+            /* The addresses on the wire of the datagrams that are sent to a host heard from */
+            struct path {
+                uint8_t local_mac[6];
+                uint8_t remote_mac[6];
+                uint32_t local_ip;
+            };
+
+            rtp_error_t create_socket(unsigned queue);
+            rtp_error_t map_ring(ring& r, const xdp_ring_offset& offsets, size_t entries, size_t desc_size, uint64_t pgoff);
+            rtp_error_t load_program(unsigned queue);
+
+            /* The thread of the device: wait for the RX ring and deliver the datagrams on it */
+            void receiver();
+            void deliver(uint8_t *frame, size_t len);
+
+            // give the frames of the completed sends back to "tx_free_"
+            void reap_completions();
+
+            int fd_;
+            unsigned ifindex_;
+            bool zero_copy_;
+
+            uint8_t *umem_;
+            size_t umem_size_;
+
+            ring fill_;
+            ring completion_;
+            ring rx_;
+            ring tx_;
+
+            int ports_fd_;
+            int sockets_fd_;
+            int program_fd_;
+            int link_fd_;
+
+            std::atomic<bool> active_;
+            uvgrtp::stop_event stop_event_;
+            std::unique_ptr<std::thread> receiver_;
+
+            /* Held while the ports change and while the thread delivers a batch */
+            std::mutex ports_mutex_;
+            std::unordered_map<uint16_t, std::shared_ptr<uvgrtp::memory_transport>> ports_;
+
+            // the payload of the datagram being delivered, kept so that delivering does not allocate
+            std::vector<std::pair<size_t, uint8_t *>> payload_;
+
+            /* Held while sending, protects the TX and completion rings and "tx_free_" */
+            std::mutex tx_mutex_;
+            std::vector<uint64_t> tx_free_;
+
+            /* The paths learned from the received datagrams, keyed by the IPv4 address of the
+             * sender in network byte order */
+            std::mutex paths_mutex_;
+            std::unordered_map<uint32_t, path> paths_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -6,6 +6,7 @@
 #include "zrtp/dh_kxchng.hh"
 #include "zrtp/hello.hh"
 #include "zrtp/hello_ack.hh"
+#include "zrtp/key_pool.hh"
 
 #include "socket.hh"
 #include "crypto.hh"
@@ -18,8 +19,8 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #endif
+#include <algorithm>
 #include <cstring>
-#include <thread>
 
 using namespace uvgrtp::zrtp_msg;
 
@@ -46,20 +47,32 @@ uvgrtp::zrtp::zrtp():
     hello_len_(0),
     commit_len_(0),
     dh_len_(0),
-    zrtp_busy_(false)
+    msg_received_(false),
+    dh_finished_(false),
+    dh_session_(nullptr)
 {
     cctx_.sha256 = new uvgrtp::crypto::sha256;
     cctx_.dh     = new uvgrtp::crypto::dh;
+    cctx_.ecdh   = new uvgrtp::crypto::ecdh;
 }
 
 uvgrtp::zrtp::~zrtp()
 {
     delete cctx_.sha256;
     delete cctx_.dh;
+    delete cctx_.ecdh;
 
     cleanup_session();
 }
 
+std::shared_ptr<uvgrtp::zrtp> uvgrtp::zrtp::create_stream()
+{
+    auto stream = std::make_shared<uvgrtp::zrtp>();
+    stream->dh_session_ = shared_from_this();
+
+    return stream;
+}
+
 void uvgrtp::zrtp::cleanup_session()
 {
     if (session_.r_msg.commit.second)
@@ -97,9 +110,52 @@ void uvgrtp::zrtp::cleanup_session()
     }
 }
 
+void uvgrtp::zrtp::wait_for_message(long int timeout_ms)
+{
+    if (timeout_ms <= 0)
+        return;
+
+    std::unique_lock<std::mutex> lock(msg_mutex_);
+    msg_cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return msg_received_; });
+    msg_received_ = false;
+}
+
+void uvgrtp::zrtp::message_received()
+{
+    {
+        std::lock_guard<std::mutex> lock(msg_mutex_);
+        msg_received_ = true;
+    }
+    msg_cond_.notify_all();
+}
+
+void uvgrtp::zrtp::set_cache(std::shared_ptr<uvgrtp::zrtp_cache> cache)
+{
+    cache_ = cache;
+    session_.retain_secrets = (cache != nullptr);
+}
+
+void uvgrtp::zrtp::set_key_pool(std::shared_ptr<uvgrtp::key_pool> pool)
+{
+    key_pool_ = pool;
+}
+
+void uvgrtp::zrtp::set_ec25(bool enable)
+{
+    session_.offer_ec25 = enable;
+}
+
 void uvgrtp::zrtp::generate_zid()
 {
+    /* Remote finds the secrets it has retained with us by our ZID,
+     * so it must stay the same as long as the cache is used */
+    if (cache_ && cache_->get_zid(session_.o_zid))
+        return;
+
     uvgrtp::crypto::random::generate_random(session_.o_zid, 12);
+
+    if (cache_)
+        cache_->set_zid(session_.o_zid);
 }
 
 /* ZRTP Key Derivation Function (KDF) (Section 4.5.2)
@@ -114,7 +170,12 @@ void uvgrtp::zrtp::generate_zid()
  */
 void uvgrtp::zrtp::derive_key(const char *label, uint32_t key_len, uint8_t *out_key)
 {
-    auto hmac_sha256 = uvgrtp::crypto::hmac::sha256(session_.secrets.s0, 32);
+    kdf(session_.secrets.s0, label, key_len, out_key);
+}
+
+void uvgrtp::zrtp::kdf(const uint8_t *ki, const char *label, uint32_t key_len, uint8_t *out_key)
+{
+    auto hmac_sha256 = uvgrtp::crypto::hmac::sha256(ki, 32);
     uint8_t tmp[32]  = { 0 };
     uint32_t length  = htonl(key_len);
     uint32_t counter = 0x1;
@@ -147,26 +208,210 @@ void uvgrtp::zrtp::derive_key(const char *label, uint32_t key_len, uint8_t *out_
     }
 }
 
+uint32_t uvgrtp::zrtp::select_key_agreement() const
+{
+    /* EC25 is much faster than DH3k and its messages are smaller,
+     * so it is used whenever both Hellos offer it */
+    if (!session_.offer_ec25)
+        return DH3k;
+
+    for (auto& key_agreement : session_.capabilities.key_agreements) {
+        if (key_agreement == EC25)
+            return EC25;
+    }
+
+    return DH3k;
+}
+
+void uvgrtp::zrtp::generate_key_pair()
+{
+    /* A pooled context replaces ours, so the key pair of the previous session is dropped */
+    if (session_.key_agreement_type == EC25) {
+        std::unique_ptr<uvgrtp::crypto::ecdh> pooled = key_pool_ ? key_pool_->take_ecdh() : nullptr;
+
+        if (pooled) {
+            delete cctx_.ecdh;
+            cctx_.ecdh = pooled.release();
+        } else {
+            cctx_.ecdh->generate_keys();
+        }
+        cctx_.ecdh->get_pk(session_.dh_ctx.public_key, pv_length(EC25));
+    } else {
+        std::unique_ptr<uvgrtp::crypto::dh> pooled = key_pool_ ? key_pool_->take_dh() : nullptr;
+
+        if (pooled) {
+            delete cctx_.dh;
+            cctx_.dh = pooled.release();
+        } else {
+            cctx_.dh->generate_keys();
+        }
+        cctx_.dh->get_pk(session_.dh_ctx.public_key, 384);
+    }
+}
+
 void uvgrtp::zrtp::generate_secrets()
 {
-    cctx_.dh->generate_keys();
-    cctx_.dh->get_pk(session_.dh_ctx.public_key, 384);
+    uvgrtp::zrtp_retained_secrets retained;
+    zrtp_secrets_t& secrets = session_.secrets;
 
-    /* uvgRTP does not support Preshared mode (for now at least) so
-     * there will be no shared secrets between the endpoints.
-     *
-     * Generate random data for the retained secret values that are sent
-     * in the DHPart1/DHPart2 message and, due to mismatch, ignored by remote */
-    uvgrtp::crypto::random::generate_random(session_.secrets.rs1,  32);
-    uvgrtp::crypto::random::generate_random(session_.secrets.rs2,  32);
-    uvgrtp::crypto::random::generate_random(session_.secrets.raux, 32);
-    uvgrtp::crypto::random::generate_random(session_.secrets.rpbx, 32);
+    /* Generate random data for the retained secret values that we do not have.
+     * They are sent in the DHPart1/DHPart2 message and, due to mismatch, ignored by remote */
+    uvgrtp::crypto::random::generate_random(secrets.rs1,  32);
+    uvgrtp::crypto::random::generate_random(secrets.rs2,  32);
+    uvgrtp::crypto::random::generate_random(secrets.raux, 32);
+    uvgrtp::crypto::random::generate_random(secrets.rpbx, 32);
+
+    secrets.rs1_retained = false;
+    secrets.rs2_retained = false;
+    secrets.s1 = nullptr;
+
+    if (!cache_ || !cache_->get_secrets(session_.r_zid, retained))
+        return;
+
+    memcpy(secrets.rs1, retained.rs1, 32);
+    secrets.rs1_retained = true;
+
+    if (retained.rs2_valid) {
+        memcpy(secrets.rs2, retained.rs2, 32);
+        secrets.rs2_retained = true;
+    }
+    memset(&retained, 0, sizeof(retained));
+}
+
+void uvgrtp::zrtp::select_retained_secret()
+{
+    zrtp_secrets_t& secrets = session_.secrets;
+    secrets.s1 = nullptr;
+
+    if (!secrets.rs1_retained)
+        return;
+
+    /* Remote has calculated its IDs using its own role */
+    const char *role = (session_.role == INITIATOR) ? "Responder" : "Initiator";
+    const uvgrtp::zrtp_msg::zrtp_dh *dh = session_.r_msg.dh.second;
+
+    uint8_t mac_full[32];
+    uint8_t rs1_id[8];
+    uint8_t rs2_id[8];
+
+    auto hmac_sha256 = uvgrtp::crypto::hmac::sha256(secrets.rs1, 32);
+    hmac_sha256.update((uint8_t *)role, 9);
+    hmac_sha256.final(mac_full);
+    memcpy(rs1_id, mac_full, 8);
+
+    hmac_sha256 = uvgrtp::crypto::hmac::sha256(secrets.rs2, 32);
+    hmac_sha256.update((uint8_t *)role, 9);
+    hmac_sha256.final(mac_full);
+    memcpy(rs2_id, mac_full, 8);
+
+    bool rs2_matches_rs1 = secrets.rs2_retained && !memcmp(rs2_id, dh->rs1_id, 8);
+    bool rs1_matches_rs2 = !memcmp(rs1_id, dh->rs2_id, 8);
+
+    /* Both parties must pick the same secret, so the order is fixed by role: rs1 of the
+     * initiator is compared against rs1 and rs2 of the responder, and only then rs2 of
+     * the initiator against rs1 of the responder */
+    if (!memcmp(rs1_id, dh->rs1_id, 8))
+        secrets.s1 = secrets.rs1;
+    else if (session_.role == INITIATOR)
+        secrets.s1 = rs1_matches_rs2 ? secrets.rs1 : (rs2_matches_rs1 ? secrets.rs2 : nullptr);
+    else
+        secrets.s1 = rs2_matches_rs1 ? secrets.rs2 : (rs1_matches_rs2 ? secrets.rs1 : nullptr);
+
+    /* Section 4.3.2, a cache mismatch may be a man-in-the-middle attack */
+    if (!secrets.s1)
+        UVG_LOG_WARN("Remote does not have the secret retained from the previous ZRTP session");
+}
+
+bool uvgrtp::zrtp::select_preshared_secret()
+{
+    zrtp_secrets_t& secrets = session_.secrets;
+    uint8_t *candidates[2] = { secrets.rs1, secrets.rs2_retained ? secrets.rs2 : nullptr };
+    uint8_t key[32];
+    uint8_t key_id[8];
+
+    secrets.s1 = nullptr;
+
+    for (auto& candidate : candidates) {
+        if (!candidate)
+            continue;
+
+        preshared_key(candidate, key, key_id);
+
+        if (!memcmp(key_id, session_.hash_ctx.r_hvi + 16, 8)) {
+            secrets.s1 = candidate;
+            break;
+        }
+    }
+
+    memset(key, 0, sizeof(key));
+    return secrets.s1 != nullptr;
+}
+
+/* Preshared key and its keyID (Section 4.4.2)
+ *
+ * preshared_key = hash(len(s1) || s1 || len(s2) || s2 || len(s3) || s3)
+ * keyID         = MAC(preshared_key, "Prsh")
+ *
+ * Where s1 is the retained secret and s2 and s3 are null */
+void uvgrtp::zrtp::preshared_key(const uint8_t *secret, uint8_t *key, uint8_t *key_id)
+{
+    uint8_t mac_full[32];
+    uint32_t length = htonl(32);
+    uint32_t null_length = 0;
+
+    cctx_.sha256->update((uint8_t *)&length,      sizeof(length));
+    cctx_.sha256->update(secret,                  32);
+    cctx_.sha256->update((uint8_t *)&null_length, sizeof(null_length));
+    cctx_.sha256->update((uint8_t *)&null_length, sizeof(null_length));
+    cctx_.sha256->final(key);
+
+    auto hmac_sha256 = uvgrtp::crypto::hmac::sha256(key, 32);
+    hmac_sha256.update((uint8_t *)"Prsh", 4);
+    hmac_sha256.final(mac_full);
+    memcpy(key_id, mac_full, 8);
+}
+
+void uvgrtp::zrtp::update_retained_secrets()
+{
+    if (!cache_)
+        return;
+
+    /* Section 4.9, neither party keeps the new secret if the other one will not */
+    if (!session_.remote_retains) {
+        UVG_LOG_DEBUG("Remote does not retain the secret of this ZRTP session");
+        return;
+    }
+
+    /* The new rs1 replaces the old one, which becomes rs2 */
+    uvgrtp::zrtp_retained_secrets retained = {};
+    derive_key("retained secret", 256, retained.rs1);
+
+    if (session_.secrets.rs1_retained) {
+        memcpy(retained.rs2, session_.secrets.rs1, 32);
+        retained.rs2_valid = true;
+    }
+
+    cache_->set_secrets(session_.r_zid, retained);
+    memset(&retained, 0, sizeof(retained));
 }
 
-void uvgrtp::zrtp::generate_shared_secrets_dh()
+rtp_error_t uvgrtp::zrtp::generate_shared_secrets_dh()
 {
-    cctx_.dh->set_remote_pk(session_.dh_ctx.remote_public, 384);
-    cctx_.dh->get_shared_secret(session_.dh_ctx.dh_result, 384);
+    size_t result_len = dh_result_length(session_.key_agreement_type);
+
+    select_retained_secret();
+
+    if (session_.key_agreement_type == EC25) {
+        cctx_.ecdh->set_remote_pk(session_.dh_ctx.remote_public, pv_length(EC25));
+
+        if (!cctx_.ecdh->get_shared_secret(session_.dh_ctx.dh_result, result_len)) {
+            UVG_LOG_ERROR("Remote EC25 public value is not a point on the curve");
+            return RTP_INVALID_VALUE;
+        }
+    } else {
+        cctx_.dh->set_remote_pk(session_.dh_ctx.remote_public, 384);
+        cctx_.dh->get_shared_secret(session_.dh_ctx.dh_result, 384);
+    }
 
     /* Section 4.4.1.4, calculation of total_hash includes:
      *    - Hello   (responder)
@@ -196,8 +441,8 @@ void uvgrtp::zrtp::generate_shared_secrets_dh()
      *    - ZID of initiator
      *    - ZID of responder
      *    - total hash (calculated above)
-     *    - len(s1) (0x0)
-     *    - s1 (null)
+     *    - len(s1) (0x20 if a retained secret matched, otherwise 0x0)
+     *    - s1 (the matched retained secret or null)
      *    - len(s2) (0x0)
      *    - s2 (null)
      *    - len(s3) (0x0)
@@ -207,7 +452,7 @@ void uvgrtp::zrtp::generate_shared_secrets_dh()
     const char *kdf = "ZRTP-HMAC-KDF";
 
     cctx_.sha256->update((uint8_t *)&value,                    sizeof(value));              /* counter */
-    cctx_.sha256->update((uint8_t *)session_.dh_ctx.dh_result, sizeof(session_.dh_ctx.dh_result));
+    cctx_.sha256->update((uint8_t *)session_.dh_ctx.dh_result, result_len);
     cctx_.sha256->update((uint8_t *)kdf,                       13);
 
     if (session_.role == INITIATOR) {
@@ -220,8 +465,13 @@ void uvgrtp::zrtp::generate_shared_secrets_dh()
 
     cctx_.sha256->update((uint8_t *)session_.hash_ctx.total_hash, sizeof(session_.hash_ctx.total_hash));
 
-    value = 0;
+    value = session_.secrets.s1 ? htonl(32) : 0;
     cctx_.sha256->update((uint8_t *)&value, sizeof(value)); /* len(s1) */
+
+    if (session_.secrets.s1)
+        cctx_.sha256->update(session_.secrets.s1, 32);
+
+    value = 0;
     cctx_.sha256->update((uint8_t *)&value, sizeof(value)); /* len(s2) */
     cctx_.sha256->update((uint8_t *)&value, sizeof(value)); /* len(s3) */
 
@@ -229,6 +479,12 @@ void uvgrtp::zrtp::generate_shared_secrets_dh()
     cctx_.sha256->final((uint8_t *)session_.secrets.s0);
     memset(session_.dh_ctx.dh_result, 0, sizeof(session_.dh_ctx.dh_result));
 
+    derive_zrtp_keys();
+    return RTP_OK;
+}
+
+void uvgrtp::zrtp::derive_zrtp_keys()
+{
     /* Derive ZRTP Session Key and SAS hash */
     derive_key("ZRTP Session Key", 256, session_.key_ctx.zrtp_sess_key);
     derive_key("SAS",              256, session_.key_ctx.sas_hash); /* TODO: crc32? */
@@ -239,9 +495,11 @@ void uvgrtp::zrtp::generate_shared_secrets_dh()
     derive_key("Responder ZRTP key", 128, session_.key_ctx.zrtp_keyr);
     derive_key("Initiator HMAC key", 256, session_.key_ctx.hmac_keyi);
     derive_key("Responder HMAC key", 256, session_.key_ctx.hmac_keyr);
+
+    session_.key_ctx.srtp_key_len = 0;
 }
 
-void uvgrtp::zrtp::generate_shared_secrets_msm()
+void uvgrtp::zrtp::hash_hello_and_commit()
 {
     if (session_.role == INITIATOR) {
         cctx_.sha256->update((uint8_t *)session_.r_msg.hello.second,  session_.r_msg.hello.first);
@@ -251,6 +509,26 @@ void uvgrtp::zrtp::generate_shared_secrets_msm()
         cctx_.sha256->update((uint8_t *)session_.r_msg.commit.second, session_.r_msg.commit.first);
     }
     cctx_.sha256->final((uint8_t *)session_.hash_ctx.total_hash);
+}
+
+void uvgrtp::zrtp::generate_shared_secrets_prsh()
+{
+    uint8_t key[32];
+    uint8_t key_id[8];
+
+    hash_hello_and_commit();
+
+    /* s0 = KDF(preshared_key, "ZRTP PSK", ZIDi || ZIDr || total_hash, 256) (Section 4.4.2) */
+    preshared_key(session_.secrets.s1, key, key_id);
+    kdf(key, "ZRTP PSK", 256, session_.secrets.s0);
+    memset(key, 0, sizeof(key));
+
+    derive_zrtp_keys();
+}
+
+void uvgrtp::zrtp::generate_shared_secrets_msm()
+{
+    hash_hello_and_commit();
 
     /* Finally calculate s0 which is considered to be the final keying material (Section 4.4.3.2)
      *
@@ -281,6 +559,8 @@ void uvgrtp::zrtp::generate_shared_secrets_msm()
      *
      * Caller can now generate SRTP session keys for the media stream */
     cctx_.sha256->final((uint8_t *)session_.secrets.s0);
+
+    session_.key_ctx.srtp_key_len = 0;
 }
 
 rtp_error_t uvgrtp::zrtp::verify_hash(uint8_t *key, uint8_t *buf, size_t len, uint64_t mac)
@@ -337,6 +617,12 @@ rtp_error_t uvgrtp::zrtp::validate_session()
         }
     }
 
+    /* Multistream and Preshared modes do not exchange DHPart messages */
+    if (session_.key_agreement_type == MULT || session_.key_agreement_type == PRSH) {
+        UVG_LOG_DEBUG("All hashes match!");
+        return RTP_OK;
+    }
+
     /* DHPart1/DHPart2 message */
     if (RTP_INVALID_VALUE == verify_hash(
             (uint8_t *)hashes[0],
@@ -365,7 +651,8 @@ void uvgrtp::zrtp::init_session_hashes()
 
 bool uvgrtp::zrtp::are_we_initiator(uint8_t *our_hvi, uint8_t *their_hvi)
 {
-    const int bits = (session_.key_agreement_type == MULT) ? 15 : 31;
+    /* Multistream and Preshared modes compare 128-bit nonces instead of hvi */
+    const int bits = (session_.key_agreement_type == MULT || session_.key_agreement_type == PRSH) ? 15 : 31;
 
     for (int i = bits; i >= 0; --i) {
 
@@ -407,7 +694,10 @@ rtp_error_t uvgrtp::zrtp::begin_session()
 
                 /* Copy interesting information from receiver's
                     * message buffer to remote capabilities struct for later use */
-                hello.parse_msg(hello_, session_, hello_len_);
+                if (hello.parse_msg(hello_, session_, hello_len_) != RTP_OK) {
+                    UVG_LOG_ERROR("Failed to parse ZRTP Hello");
+                    return RTP_INVALID_VALUE;
+                }
                 UVG_LOG_DEBUG("ZRTP Hello parsed");
                 if (session_.capabilities.version != ZRTP_VERSION) {
 
@@ -460,7 +750,7 @@ rtp_error_t uvgrtp::zrtp::begin_session()
             }
         }
         else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(diff_ms));
+            wait_for_message(diff_ms);
         }
 
         if (i > 20) {
@@ -483,6 +773,11 @@ rtp_error_t uvgrtp::zrtp::init_session(int key_agreement)
 
     auto commit = uvgrtp::zrtp_msg::commit(session_);
 
+    /* We share no secret with remote, so its Preshared Commit is ignored. It falls
+     * back to DH mode when it sees our DH Commit (Section 4.2) */
+    if (commit_ != nullptr && commit_->key_agreement_type == PRSH)
+        commit_ = nullptr;
+
     /* First check if remote has already sent the message.
      * If so, they are the initiator and we're the responder */
     if (commit_ != nullptr) {
@@ -514,6 +809,9 @@ rtp_error_t uvgrtp::zrtp::init_session(int key_agreement)
             }
             ++i;
         }
+        if (commit_ != nullptr && commit_->key_agreement_type == PRSH)
+            commit_ = nullptr;
+
         if (commit_) {
             /* As per RFC 6189, if both parties have sent Commit message and the mode is DH,
              * hvi shall determine who is the initiator (the party with larger hvi is initiator) */
@@ -529,11 +827,13 @@ rtp_error_t uvgrtp::zrtp::init_session(int key_agreement)
                 return RTP_OK;
             }
         }
-        if (dh1_ || conf1_) {
+        /* Only Multistream mode goes straight to Confirm1 */
+        if (dh1_ || (conf1_ && key_agreement == MULT)) {
             return RTP_OK;
         }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        /* Wait for remote's Commit or DHPart1 until the next Commit is due */
+        wait_for_message(i * interval - (long int)uvgrtp::clock::hrc::diff_now(start));
         if (i > 10) {
             break;
         }
@@ -543,6 +843,77 @@ rtp_error_t uvgrtp::zrtp::init_session(int key_agreement)
     return RTP_TIMEOUT;
 }
 
+rtp_error_t uvgrtp::zrtp::init_session_preshared()
+{
+    uint8_t key[32];
+
+    session_.hash_algo = S256;
+    session_.cipher_algo = AES1;
+    session_.auth_tag_type = HS32;
+    session_.key_agreement_type = PRSH;
+    session_.sas_type = B32;
+
+    /* The keyID of our rs1 follows the nonce in the hvi field of Commit */
+    preshared_key(session_.secrets.rs1, key, session_.hash_ctx.o_hvi + 16);
+    memset(key, 0, sizeof(key));
+
+    auto commit = uvgrtp::zrtp_msg::commit(session_);
+
+    /* The initiator's keyID decides the secret, see select_preshared_secret() for the responder */
+    session_.role = INITIATOR;
+    session_.secrets.s1 = session_.secrets.rs1;
+
+    uvgrtp::clock::hrc::hrc_t start = uvgrtp::clock::hrc::now();
+    int interval = 150;
+    int i = 1;
+    bool commit_sent = false;
+
+    while (true) {
+        if (commit_) {
+            /* A DH Commit wins over a Preshared one (Section 4.2) */
+            if (commit_->key_agreement_type != PRSH)
+                return RTP_NOT_SUPPORTED;
+
+            commit.parse_msg(commit_, session_, commit_len_);
+
+            if (!commit_sent || !are_we_initiator(session_.hash_ctx.o_hvi, session_.hash_ctx.r_hvi)) {
+                session_.role = RESPONDER;
+                return select_preshared_secret() ? RTP_OK : RTP_NOT_SUPPORTED;
+            }
+
+            /* We are the initiator. Forget remote's Commit so that
+             * we notice if it falls back to DH mode */
+            commit_ = nullptr;
+        }
+        if (conf1_) {
+            return RTP_OK;
+        }
+
+        long int next_sendslot = i * interval;
+        long int run_time = (long int)uvgrtp::clock::hrc::diff_now(start);
+        long int diff_ms = next_sendslot - run_time;
+
+        if (diff_ms < 0) {
+            if (commit.send_msg(local_socket_, remote_addr_, remote_ip6_addr_) != RTP_OK) {
+                UVG_LOG_ERROR("Failed to send Commit message!");
+            }
+            UVG_LOG_DEBUG("Preshared Commit sent");
+            commit_sent = true;
+            if (interval < 1200) {
+                interval *= 2;
+            }
+            ++i;
+        }
+        else {
+            wait_for_message(diff_ms);
+        }
+        if (i > 10) {
+            break;
+        }
+    }
+    return RTP_TIMEOUT;
+}
+
 rtp_error_t uvgrtp::zrtp::dh_part1()
 {
     auto dhpart = uvgrtp::zrtp_msg::dh_key_exchange(session_, 1);
@@ -563,8 +934,7 @@ rtp_error_t uvgrtp::zrtp::dh_part1()
 
             /* parse_msg() above extracted the public key of remote and saved it to session_.
                 * Now we must generate shared secrets (DHResult, total_hash, and s0) */
-            generate_shared_secrets_dh();
-            return RTP_OK;
+            return generate_shared_secrets_dh();
         }
 
         long int next_sendslot = i * interval;
@@ -582,8 +952,7 @@ rtp_error_t uvgrtp::zrtp::dh_part1()
             ++i;
         }
         else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
+            wait_for_message(diff_ms);
         }
         if (i > 10) {
             break;
@@ -604,7 +973,8 @@ rtp_error_t uvgrtp::zrtp::dh_part2(uvgrtp::zrtp_msg::dh_key_exchange* dh)
     UVG_LOG_DEBUG("DHPart1 parsed");
     /* parse_msg() above extracted the public key of remote and saved it to session_.
      * Now we must generate shared secrets (DHResult, total_hash, and s0) */
-    generate_shared_secrets_dh();
+    if ((ret = generate_shared_secrets_dh()) != RTP_OK)
+        return ret;
 
     uvgrtp::clock::hrc::hrc_t start = uvgrtp::clock::hrc::now();
     int interval = 150;
@@ -632,7 +1002,7 @@ rtp_error_t uvgrtp::zrtp::dh_part2(uvgrtp::zrtp_msg::dh_key_exchange* dh)
             ++i;
         }
         else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            wait_for_message(diff_ms);
         }
         if (i > 10) {
             break;
@@ -686,7 +1056,7 @@ rtp_error_t uvgrtp::zrtp::responder_finalize_session()
             }
         }
         else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            wait_for_message(diff_ms);
         }
         if (i > 10) {
             break;
@@ -736,7 +1106,7 @@ rtp_error_t uvgrtp::zrtp::initiator_finalize_session()
             }
         }
         else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            wait_for_message(diff_ms);
         }
         if (i > 10) {
             break;
@@ -766,6 +1136,26 @@ rtp_error_t uvgrtp::zrtp::init(uint32_t ssrc, std::shared_ptr<uvgrtp::socket> so
     }
     else
     {
+        if (dh_session_)
+        {
+            /* Start from the session of the DH stream. The messages it has exchanged
+             * with remote are not ours to free, the stream exchanges its own */
+            std::lock_guard<std::mutex> lock(dh_session_->zrtp_mtx_);
+
+            if (dh_session_->initialized_)
+            {
+                cleanup_session();
+
+                session_ = dh_session_->session_;
+                session_.l_msg = {};
+                session_.r_msg = {};
+                session_.secrets.s1 = nullptr;
+                session_.secrets.s2 = nullptr;
+                session_.secrets.s3 = nullptr;
+                initialized_ = true;
+            }
+        }
+
         if (!initialized_)
         {
             UVG_LOG_ERROR("Attempted multistream mode for non initialized ZRTP");
@@ -801,9 +1191,8 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
     /* TODO: set all fields initially to zero */
     memset(session_.hash_ctx.o_hvi, 0, sizeof(session_.hash_ctx.o_hvi));
 
-    /* Generate ZID and random data for the retained secrets */
+    /* Generate ZID for the Hello message */
     generate_zid();
-    generate_secrets();
 
     /* Initialize the session hashes H0 - H3 defined in Section 9 of RFC 6189 */
     init_session_hashes();
@@ -824,6 +1213,20 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
         return ret;
     }
 
+    /* Now that remote's ZID is known, its retained secrets can be looked up. If we have
+     * one and remote offers Preshared mode, the DH exchange can be skipped altogether */
+    generate_secrets();
+
+    if (session_.secrets.rs1_retained &&
+        std::find(session_.capabilities.key_agreements.begin(),
+                  session_.capabilities.key_agreements.end(), (uint32_t)PRSH) != session_.capabilities.key_agreements.end())
+    {
+        if ((ret = init_psm()) != RTP_NOT_SUPPORTED)
+            return ret;
+
+        UVG_LOG_INFO("Remote does not share our retained secret, falling back to DHMode");
+    }
+
     /* After begin_session() we have remote's Hello message and we can craft
      * DHPart2 in the hopes that we're the Initiator.
      *
@@ -833,7 +1236,13 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
      * Commit message contains hash value of initiator (hvi) which is the
      * the hashed value of Initiators DHPart2 message and Responder's Hello
      * message. This should be calculated now because the next step is choosing
-     * the the roles for participants. */
+     * the the roles for participants.
+     *
+     * The key pair is generated for the key agreement type selected from remote's Hello */
+    uint32_t key_agreement = select_key_agreement();
+    session_.key_agreement_type = key_agreement;
+    generate_key_pair();
+
     auto dh_msg = uvgrtp::zrtp_msg::dh_key_exchange(session_, 2);
     cctx_.sha256->update((uint8_t *)session_.l_msg.dh.second,    session_.l_msg.dh.first);
     cctx_.sha256->update((uint8_t *)session_.r_msg.hello.second, session_.r_msg.hello.first);
@@ -848,11 +1257,24 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
      *
      * init_session() will exchange the Commit messages and select roles for the
      * participants (initiator/responder) based on rules determined in RFC 6189 */
-    if ((ret = init_session(DH3k)) != RTP_OK) {
+    if ((ret = init_session(key_agreement)) != RTP_OK) {
         UVG_LOG_ERROR("Could not agree on ZRTP session parameters or roles of participants!");
         return ret;
     }
 
+    /* The initiator's Commit decides the key agreement type. If remote's Commit
+     * asks for another type than ours, the responder needs a new key pair for it */
+    if (session_.role == INITIATOR) {
+        session_.key_agreement_type = key_agreement;
+    } else if (session_.key_agreement_type != key_agreement) {
+        if (session_.key_agreement_type != DH3k && session_.key_agreement_type != EC25) {
+            UVG_LOG_ERROR("Remote selected a key agreement type that is not supported");
+            return RTP_NOT_SUPPORTED;
+        }
+
+        generate_key_pair();
+    }
+
     /* From this point on, the execution deviates because both parties have their own roles
      * and different message that they need to send in order to finalize the ZRTP connection */
     if (session_.role == INITIATOR) {
@@ -877,6 +1299,8 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
             return ret;
         }
     }
+    update_retained_secrets();
+
     UVG_LOG_INFO("ZRTP has been initialized using DHMode");
     /* ZRTP has been initialized using DHMode */
     initialized_ = true;
@@ -884,6 +1308,40 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::zrtp::init_psm()
+{
+    rtp_error_t ret = RTP_OK;
+
+    UVG_LOG_DEBUG("Generating ZRTP keys in Preshared mode");
+
+    if ((ret = init_session_preshared()) != RTP_OK) {
+        if (ret != RTP_NOT_SUPPORTED)
+            UVG_LOG_ERROR("Could not agree on ZRTP session parameters or roles of participants!");
+        return ret;
+    }
+
+    generate_shared_secrets_prsh();
+
+    if (session_.role == INITIATOR) {
+        if ((ret = initiator_finalize_session()) != RTP_OK) {
+            UVG_LOG_ERROR("Failed to finalize session using Confirm2");
+            return ret;
+        }
+    } else {
+        if ((ret = responder_finalize_session()) != RTP_OK) {
+            UVG_LOG_ERROR("Failed to finalize session using Confirm1/Conf2ACK");
+            return ret;
+        }
+    }
+
+    /* Preshared mode updates the retained secrets like DH mode does */
+    update_retained_secrets();
+
+    UVG_LOG_INFO("ZRTP has been initialized using Preshared mode");
+    initialized_ = true;
+    return RTP_OK;
+}
+
 rtp_error_t uvgrtp::zrtp::init_msm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket> socket, sockaddr_in& addr, sockaddr_in6& addr6)
 {
     rtp_error_t ret;
@@ -950,6 +1408,31 @@ rtp_error_t uvgrtp::zrtp::get_srtp_keys(
     if (!initialized_)
         return RTP_NOT_INITIALIZED;
 
+    zrtp_key_ctx_t& keys = session_.key_ctx;
+
+    if (okey_len == tkey_len && osalt_len == tsalt_len &&
+        okey_len <= sizeof(keys.srtp_keyi) * 8 && osalt_len <= sizeof(keys.srtp_salti) * 8)
+    {
+        if (keys.srtp_key_len != okey_len || keys.srtp_salt_len != osalt_len) {
+            derive_key("Initiator SRTP master key",  okey_len,  keys.srtp_keyi);
+            derive_key("Initiator SRTP master salt", osalt_len, keys.srtp_salti);
+            derive_key("Responder SRTP master key",  okey_len,  keys.srtp_keyr);
+            derive_key("Responder SRTP master salt", osalt_len, keys.srtp_saltr);
+
+            keys.srtp_key_len  = okey_len;
+            keys.srtp_salt_len = osalt_len;
+        }
+
+        bool initiator = (session_.role == INITIATOR);
+
+        memcpy(our_mkey,    initiator ? keys.srtp_keyi  : keys.srtp_keyr,  okey_len / 8);
+        memcpy(our_msalt,   initiator ? keys.srtp_salti : keys.srtp_saltr, osalt_len / 8);
+        memcpy(their_mkey,  initiator ? keys.srtp_keyr  : keys.srtp_keyi,  tkey_len / 8);
+        memcpy(their_msalt, initiator ? keys.srtp_saltr : keys.srtp_salti, tsalt_len / 8);
+
+        return RTP_OK;
+    }
+
     if (session_.role == INITIATOR) {
         derive_key("Initiator SRTP master key",  okey_len,  our_mkey);
         derive_key("Initiator SRTP master salt", osalt_len, our_msalt);
@@ -997,7 +1480,7 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
             //UVG_LOG_DEBUG("ZRTP Hello message received, verify CRC32!");
             zrtp_hello* hello = (zrtp_hello*)msg;
 
-            if (!uvgrtp::crypto::crc32::verify_crc32(read_ptr, size - 4, hello->crc)) {
+            if (!uvgrtp::crypto::crc32::verify_crc32(read_ptr, size - 4, zrtp_message::get_crc(read_ptr, size))) {
                 return RTP_NOT_SUPPORTED;
             }
             if (hello_ != nullptr) {
@@ -1006,6 +1489,7 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
             }
             hello_ = hello;
             hello_len_ = size;
+            message_received();
             return RTP_OK;
         }
 
@@ -1029,6 +1513,7 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
                 return RTP_OK;
             }
             hello_ack_ = ha_msg;
+            message_received();
             return RTP_OK;
         }
 
@@ -1055,12 +1540,13 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
             }
             commit_ = commit;
             commit_len_ = size;
+            message_received();
             return RTP_OK;
         }
 
         case ZRTP_MSG_DH_PART1:
         {
-            // TODO: Check based on KA type
+            // the exact length depends on the key agreement type, see dh_key_exchange::parse_msg()
             if (msg->length < 21) // see rfc 6189 section 5.5
             {
                 UVG_LOG_WARN("ZRTP DH Part1 length field is wrong");
@@ -1071,7 +1557,7 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
 
             zrtp_dh* dh = (zrtp_dh*)msg;
 
-            if (!uvgrtp::crypto::crc32::verify_crc32(read_ptr, size - 4, dh->crc))
+            if (!uvgrtp::crypto::crc32::verify_crc32(read_ptr, size - 4, zrtp_message::get_crc(read_ptr, size)))
                 return RTP_NOT_SUPPORTED;
 
             if (dh1_ != nullptr) {
@@ -1080,12 +1566,13 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
             }
             dh1_ = dh;
             dh_len_ = size;
+            message_received();
             return RTP_OK;
         }
 
         case ZRTP_MSG_DH_PART2:
         {
-            // TODO: Check based on KA type
+            // the exact length depends on the key agreement type, see dh_key_exchange::parse_msg()
             if (msg->length < 21) // see rfc 6189 section 5.6
             {
                 UVG_LOG_WARN("ZRTP DH Part2 length field is wrong");
@@ -1096,7 +1583,7 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
 
             zrtp_dh* dh = (zrtp_dh*)msg;
 
-            if (!uvgrtp::crypto::crc32::verify_crc32(read_ptr, size - 4, dh->crc))
+            if (!uvgrtp::crypto::crc32::verify_crc32(read_ptr, size - 4, zrtp_message::get_crc(read_ptr, size)))
                 return RTP_NOT_SUPPORTED;
 
             if (dh2_ != nullptr) {
@@ -1105,6 +1592,7 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
             }
             dh2_ = dh;
             dh_len_ = size;
+            message_received();
             return RTP_OK;
         }
 
@@ -1128,6 +1616,7 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
                 return RTP_OK;
             }
             conf1_ = dh;
+            message_received();
             return RTP_OK;
         }
 
@@ -1152,6 +1641,7 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
                 return RTP_OK;
             }
             conf2_ = dh;
+            message_received();
             return RTP_OK;
         }
 
@@ -1175,6 +1665,7 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
                 return RTP_OK;
             }
             confack_ = ca;
+            message_received();
             return RTP_OK;
         }
 
@@ -9,6 +9,8 @@
 #include "zrtp/hello.hh"
 #include "zrtp/hello_ack.hh"
 
+#include "uvgrtp/zrtp_cache.hh"
+
 #ifdef _WIN32
 #include <winsock2.h>
 #include <mswsock.h>
@@ -22,6 +24,8 @@
 #include <netinet/in.h>
 #endif
 
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <vector>
 #include <memory>
@@ -33,16 +37,25 @@ namespace uvgrtp {
         struct rtp_frame;
     }
 
+    class key_pool;
+
     enum ZRTP_ROLE {
         INITIATOR,
         RESPONDER
     };
 
-    class zrtp {
+    class zrtp : public std::enable_shared_from_this<zrtp> {
         public:
             zrtp();
             ~zrtp();
 
+            /* Create the ZRTP state of a Multistream Mode stream of this session
+             *
+             * Each stream has its own messages and keys, so the Multistream Mode
+             * negotiations of different streams can run at the same time. The negotiation
+             * starts from the result of the DH Mode negotiation of this object */
+            std::shared_ptr<uvgrtp::zrtp> create_stream();
+
             /* Initialize ZRTP for a multimedia session
              *
              * If this the first ZRTP session initialization for this object,
@@ -53,10 +66,24 @@ namespace uvgrtp {
              * Return RTP_TIMEOUT if remote did not send messages in timely manner */
             rtp_error_t init(uint32_t ssrc, std::shared_ptr<uvgrtp::socket> socket, sockaddr_in& addr, sockaddr_in6& addr6, bool perform_dh, bool ipv6);
 
+            /* Keep our ZID and the secrets retained with each remote in "cache".
+             * Must be called before init(), nullptr disables the cache */
+            void set_cache(std::shared_ptr<uvgrtp::zrtp_cache> cache);
+
+            /* Take the key pairs from "pool" instead of generating them when the session
+             * starts. Must be called before init(), nullptr disables the pool */
+            void set_key_pool(std::shared_ptr<uvgrtp::key_pool> pool);
+
+            /* Offer EC25 in Hello and use it if remote offers it too. Must be called before init() */
+            void set_ec25(bool enable);
+
             /* Get SRTP keys for the session that was just initialized
              *
              * NOTE: "key_len" and "salt_len" denote the lengths in **bits**
              *
+             * The keys are derived once per ZRTP session and copied to the caller
+             * on later calls, as long as the same lengths are asked for
+             *
              * TODO are there any requirements (thinking of Multistream Mode and keys getting overwritten?)
              *
              * Return RTP_OK on success
@@ -78,7 +105,7 @@ namespace uvgrtp {
 
             inline bool has_dh_finished() const
             {
-                return dh_finished_;
+                return dh_session_ ? dh_session_->has_dh_finished() : dh_finished_.load();
             }
 
             inline void dh_has_finished()
@@ -86,15 +113,6 @@ namespace uvgrtp {
                 dh_finished_ = true;
             }
 
-            inline bool is_zrtp_busy() const
-            {
-                return zrtp_busy_;
-            }
-            inline void set_zrtp_busy(bool status)
-            {
-                zrtp_busy_ = status;
-            }
-
         private:
             /* Initialize ZRTP session between us and remote using Diffie-Hellman Mode
              *
@@ -108,19 +126,70 @@ namespace uvgrtp {
              * Return RTP_TIMEOUT if remote did not send messages in timely manner */
             rtp_error_t init_msm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket> socket, sockaddr_in& addr, sockaddr_in6& addr6);
 
-            /* Generate zid for this ZRTP instance. ZID is a unique, 96-bit long ID */
+            /* Initialize ZRTP session using Preshared mode after begin_session() has
+             * succeeded. The secret retained from the previous session replaces the
+             * Diffie-Hellman exchange
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if remote does not share the secret and DH mode must be used
+             * Return RTP_TIMEOUT if remote did not send messages in timely manner */
+            rtp_error_t init_psm();
+
+            /* Wait until packet_handler() has stored a new message or "timeout_ms" has passed */
+            void wait_for_message(long int timeout_ms);
+
+            /* Wake up the handshake waiting in wait_for_message() */
+            void message_received();
+
+            /* Generate zid for this ZRTP instance. ZID is a unique, 96-bit long ID.
+             * With a cache, the same ZID is used for all sessions */
             void generate_zid();
 
-            /* Create private/public key pair and generate random values for retained secrets */
+            /* Select DH3k or EC25 based on the key agreement types of remote's Hello */
+            uint32_t select_key_agreement() const;
+
+            /* Create private/public key pair for the key agreement type of the session,
+             * or take one from the key pool if there is one ready */
+            void generate_key_pair();
+
+            /* Load the secrets retained with remote from the cache and generate
+             * random values for the rest */
             void generate_secrets();
 
+            /* Find the retained secret that remote has as well from the rs1ID and rs2ID
+             * of its DHPart message and point s1 to it (Section 4.3) */
+            void select_retained_secret();
+
+            /* Find the retained secret whose keyID is in the Preshared Commit of remote
+             * and point s1 to it. Return false if neither rs1 nor rs2 matches */
+            bool select_preshared_secret();
+
+            /* Calculate the preshared key and its 64-bit keyID from a retained secret (Section 4.4.2) */
+            void preshared_key(const uint8_t *secret, uint8_t *key, uint8_t *key_id);
+
+            /* Replace rs1 of remote in the cache with a secret derived from s0 (Section 4.6.1) */
+            void update_retained_secrets();
+
             /* Calculate DHResult, total_hash, and s0
-             * according to rules defined in RFC 6189 for Diffie-Hellman mode*/
-            void generate_shared_secrets_dh();
+             * according to rules defined in RFC 6189 for Diffie-Hellman mode
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if remote's public value is not valid */
+            rtp_error_t generate_shared_secrets_dh();
 
             /* Calculate shared secrets for Multistream Mode */
             void generate_shared_secrets_msm();
 
+            /* Calculate total_hash, s0 and the ZRTP keys for Preshared mode */
+            void generate_shared_secrets_prsh();
+
+            /* Calculate total_hash from responder's Hello and the Commit, used by
+             * Multistream and Preshared modes */
+            void hash_hello_and_commit();
+
+            /* Derive ZRTP Session Key, SAS hash, and the keys of Confirm messages from s0 */
+            void derive_zrtp_keys();
+
             /* Compare our and remote's hvi values to determine who is the initiator */
             bool are_we_initiator(uint8_t *our_hvi, uint8_t *their_hvi);
 
@@ -130,6 +199,9 @@ namespace uvgrtp {
             /* Derive new key using s0 as HMAC key */
             void derive_key(const char *label, uint32_t key_len, uint8_t *key);
 
+            /* Derive new key using "ki" as HMAC key */
+            void kdf(const uint8_t *ki, const char *label, uint32_t key_len, uint8_t *key);
+
             /* Being the ZRTP session by sending a Hello message to remote,
              * and responding to remote's Hello message using HelloAck message
              *
@@ -147,6 +219,13 @@ namespace uvgrtp {
              * Return RTP_TIMEOUT if no message is received from remote before T2 expires */
             rtp_error_t init_session(int key_agreement);
 
+            /* Same as init_session() for Preshared mode
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if remote sent a DH Commit or a keyID we do not have
+             * Return RTP_TIMEOUT if no message is received from remote before T2 expires */
+            rtp_error_t init_session_preshared();
+
             void cleanup_session();
 
             /* Calculate HMAC-SHA256 using "key" for "buf" of "len" bytes
@@ -197,6 +276,9 @@ namespace uvgrtp {
             zrtp_crypto_ctx_t cctx_;
             zrtp_session_t session_;
 
+            std::shared_ptr<uvgrtp::zrtp_cache> cache_;
+            std::shared_ptr<uvgrtp::key_pool> key_pool_;
+
             std::mutex zrtp_mtx_;
 
             uvgrtp::zrtp_msg::zrtp_hello* hello_;
@@ -212,9 +294,17 @@ namespace uvgrtp {
             size_t commit_len_;
             size_t dh_len_;
 
+            /* Set by packet_handler() when it has stored a message, so that the
+             * handshake wakes up at once instead of at its next retransmission */
+            std::mutex msg_mutex_;
+            std::condition_variable msg_cond_;
+            bool msg_received_;
+
             std::mutex state_mutex_;
-            bool dh_finished_ = false;
-            bool zrtp_busy_;
+            std::atomic<bool> dh_finished_;
+
+            /* The DH Mode session of a stream created with create_stream() */
+            std::shared_ptr<uvgrtp::zrtp> dh_session_;
 
     };
 }
@@ -31,6 +31,13 @@ uvgrtp::zrtp_msg::commit::commit(zrtp_session_t& session):
         memset((uint8_t *)session.hash_ctx.o_hvi, 0, 32);
         uvgrtp::crypto::random::generate_random((uint8_t *)session.hash_ctx.o_hvi, 16);
         memcpy(msg->hvi, session.hash_ctx.o_hvi, 16); /* 128 bits */
+
+    /* So does Preshared mode, followed by the keyID that the caller has
+     * placed after the nonce (Section 5.4) */
+    } else if (session.key_agreement_type == PRSH) {
+        memset((uint8_t *)session.hash_ctx.o_hvi + 24, 0, 8);
+        uvgrtp::crypto::random::generate_random((uint8_t *)session.hash_ctx.o_hvi, 16);
+        memcpy(msg->hvi, session.hash_ctx.o_hvi, 24); /* 192 bits */
     } else {
         memcpy(msg->hvi, session.hash_ctx.o_hvi, 32); /* 256 bits */
     }
@@ -79,6 +86,8 @@ rtp_error_t uvgrtp::zrtp_msg::commit::parse_msg(uvgrtp::zrtp_msg::zrtp_commit* c
 
     if (session.key_agreement_type == MULT)
         memcpy(session.hash_ctx.r_hvi, msg->hvi, 16);
+    else if (session.key_agreement_type == PRSH)
+        memcpy(session.hash_ctx.r_hvi, msg->hvi, 24);
     else
         memcpy(session.hash_ctx.r_hvi, msg->hvi, 32);
 
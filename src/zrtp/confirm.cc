@@ -53,7 +53,7 @@ uvgrtp::zrtp_msg::confirm::confirm(zrtp_session_t& session, int part):
     msg->unused     = 0;
     msg->zeros      = 0;
     msg->sig_len    = 0;
-    msg->cache_expr = 0;
+    msg->cache_expr = session.retain_secrets ? 0xffffffff : 0; /* never expires */
 
     aes_cfb->encrypt((uint8_t *)msg->hash, (uint8_t *)msg->hash, 40);
 
@@ -120,6 +120,9 @@ rtp_error_t uvgrtp::zrtp_msg::confirm::parse_msg(uvgrtp::zrtp_msg::zrtp_confirm*
     memcpy(&session.hash_ctx.r_hash[0], &msg->hash, 32);
     session.hash_ctx.r_mac[0] = 0;
 
+    /* Remote keeps the new retained secret unless its cache expires at once (Section 4.9) */
+    session.remote_retains = (msg->cache_expr != 0);
+
     delete aes_cfb;
     delete hmac_sha256;
 
@@ -103,6 +103,18 @@ namespace uvgrtp {
             MULT = 0x746c754d
         };
 
+        /* Length of the public value and of the DHResult of a key agreement type in bytes,
+         * see RFC 6189 section 5.1.5 */
+        inline size_t pv_length(uint32_t key_agreement)
+        {
+            return (key_agreement == EC25) ? 64 : 384;
+        }
+
+        inline size_t dh_result_length(uint32_t key_agreement)
+        {
+            return (key_agreement == EC25) ? 32 : 384;
+        }
+
         enum SAS_TYPES {
             B32  = 0x20323342,
             B256 = 0x36353242
@@ -161,26 +173,32 @@ namespace uvgrtp {
 
         class sha256;
         class dh;
+        class ecdh;
     }
 
     typedef struct zrtp_crypto_ctx {
         uvgrtp::crypto::hmac::sha256* hmac_sha256 = nullptr;
         uvgrtp::crypto::sha256* sha256 = nullptr;
         uvgrtp::crypto::dh* dh = nullptr;
+        uvgrtp::crypto::ecdh* ecdh = nullptr;
     } zrtp_crypto_ctx_t;
 
     typedef struct zrtp_secrets {
-        /* Retained (for uvgRTP, preshared mode is not supported so we're
-         * going to generate just some random values for these) */
+        /* Retained secrets. rs1 and rs2 come from the ZRTP cache if an earlier session
+         * with remote has retained them, all the others are random values that never
+         * match the ones of remote */
         uint8_t rs1[32] = {};
         uint8_t rs2[32] = {};
         uint8_t raux[32] = {};
         uint8_t rpbx[32] = {};
 
+        bool rs1_retained = false;
+        bool rs2_retained = false;
+
         /* Shared secrets
          *
-         * Because uvgRTP supports only DH mode,
-         * other shared secrets (s1 - s3) are null */
+         * s1 points to the retained secret that matched the one of remote, if any.
+         * Auxiliary and PBX secrets are not supported so s2 and s3 are always null */
         uint8_t s0[32] = {};
         uint8_t* s1 = nullptr;
         uint8_t* s2 = nullptr;
@@ -205,11 +223,22 @@ namespace uvgrtp {
         /* HMAC keys used to authenticate Confirm1/Confirm2 messages */
         uint8_t hmac_keyi[32];
         uint8_t hmac_keyr[32];
+
+        /* SRTP master keys and salts, derived when they are first asked for and then
+         * reused, so that SRTP and SRTCP of a stream do not derive the same keys twice */
+        uint8_t srtp_keyi[32];
+        uint8_t srtp_keyr[32];
+        uint8_t srtp_salti[32];
+        uint8_t srtp_saltr[32];
+
+        uint32_t srtp_key_len;  /* in bits, zero until the keys have been derived */
+        uint32_t srtp_salt_len;
     } zrtp_key_ctx_t;
 
     /* Diffie-Hellman context for the ZRTP session */
     typedef struct zrtp_dh_ctx {
-        /* Our public/private key pair */
+        /* Our public/private key pair. The buffers are sized for DH3k, the shorter
+         * values of the other key agreement types are at the start of them */
         uint8_t private_key[22];
         uint8_t public_key[384];
 
@@ -262,6 +291,15 @@ namespace uvgrtp {
         /* Retained and shared secrets of the ZRTP session */
         zrtp_secrets_t secrets = {};
 
+        /* We have a ZRTP cache, so Preshared mode is offered in Hello and the new
+         * retained secret is kept. Remote keeps its secret if its Confirm says so */
+        bool retain_secrets = false;
+        bool remote_retains = false;
+
+        /* EC25 is offered in Hello, see uvgrtp::context::set_zrtp_ec25(). Without it Hello has
+         * no key agreement list unless Preshared mode is offered, like before EC25 was added */
+        bool offer_ec25 = false;
+
         uint8_t o_zid[12]; /* our ZID */
         uint8_t r_zid[12]; /* remote ZID */
 
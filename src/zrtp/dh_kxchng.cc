@@ -26,11 +26,12 @@ uvgrtp::zrtp_msg::dh_key_exchange::dh_key_exchange(zrtp_session_t& session, int
 
     UVG_LOG_DEBUG("Create ZRTP DHPart%d message", part);
 
-    allocate_frame(sizeof(zrtp_dh));
+    size_t pv_len = pv_length(session.key_agreement_type);
+
+    allocate_frame(sizeof(zrtp_dh) - sizeof(zrtp_dh::pk) + pv_len);
     zrtp_dh* msg = (zrtp_dh*)frame_;
     set_zrtp_start(msg->msg_start, session, strs[part - 1][0]);
 
-    msg->crc = 0;
     memcpy(msg->hash,                session.hash_ctx.o_hash[1], 32);
 
     /* Calculate hashes for the secrets (as defined in Section 4.3.1)
@@ -65,17 +66,18 @@ uvgrtp::zrtp_msg::dh_key_exchange::dh_key_exchange(zrtp_session_t& session, int
     memcpy(msg->pbx_secret, mac_full, 8);
 
     /* public key */
-    memcpy(msg->pk, session.dh_ctx.public_key, sizeof(session.dh_ctx.public_key));
+    memcpy(msg->pk, session.dh_ctx.public_key, pv_len);
 
     /* Calculate truncated HMAC-SHA256 for the Commit Message */
     hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.hash_ctx.o_hash[0], 32);
     hmac_sha256.update((uint8_t *)frame_, len_ - 8 - 4);
     hmac_sha256.final(mac_full);
 
-    memcpy(msg->mac, mac_full, 8);
+    memcpy(&msg->pk[pv_len], mac_full, 8);
 
     /* Calculate CRC32 for the whole ZRTP packet */
-    msg->crc = uvgrtp::crypto::crc32::calculate_crc32((uint8_t *)frame_, len_ - sizeof(uint32_t));
+    uint32_t crc = uvgrtp::crypto::crc32::calculate_crc32((uint8_t *)frame_, len_ - sizeof(uint32_t));
+    memcpy((uint8_t *)frame_ + len_ - sizeof(uint32_t), &crc, sizeof(uint32_t));
 
     /* Finally make a copy of the message and save it for later use */
     if (session.l_msg.dh.second)
@@ -101,19 +103,24 @@ rtp_error_t uvgrtp::zrtp_msg::dh_key_exchange::parse_msg(uvgrtp::zrtp_msg::zrtp_
 
     allocate_rframe(sizeof(zrtp_dh));
     zrtp_dh* msg = dh;
+    size_t pv_len = pv_length(session.key_agreement_type);
+
+    if (len != sizeof(zrtp_dh) - sizeof(zrtp_dh::pk) + pv_len) {
+        UVG_LOG_ERROR("DHPart1/DHPart2 length does not match the public value of the key agreement type");
+        return RTP_INVALID_VALUE;
+    }
 
-    memcpy(session.dh_ctx.remote_public, msg->pk, 384);
+    memcpy(session.dh_ctx.remote_public, msg->pk, pv_len);
 
-    /* Because uvgRTP only supports DH mode, the retained secrets sent in this
-     * DHPartN message are not going to match our own so there not point in parsing them.
-     *
-     * TODO support maybe preshared at some point? */
+    /* The rs1ID and rs2ID of remote are matched against our retained secrets
+     * from the saved copy of this message when the shared secrets are calculated.
+     * Auxiliary and PBX secrets are not supported */
     session.secrets.s1 = nullptr;
     session.secrets.s2 = nullptr;
     session.secrets.s3 = nullptr;
 
     /* Save the MAC value so we can check if later */
-    memcpy(&session.hash_ctx.r_mac[1], &msg->mac, 8);
+    memcpy(&session.hash_ctx.r_mac[1], &msg->pk[pv_len], 8);
     memcpy(&session.hash_ctx.r_hash[1], msg->hash, 32);
 
     if (session.r_msg.dh.second)
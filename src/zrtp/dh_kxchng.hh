@@ -23,6 +23,8 @@ namespace uvgrtp {
 
         class receiver;
 
+        /* DHPart1/DHPart2 with a DH3k public value. The public values of the other
+         * key agreement types are shorter and the MAC and CRC follow them directly */
         PACK(struct zrtp_dh {
             zrtp_msg msg_start;
             uint32_t hash[8];
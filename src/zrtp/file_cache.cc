@@ -0,0 +1,189 @@
+#include "file_cache.hh"
+
+#include "../debug.hh"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+static std::string to_hex(const uint8_t *data, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(len * 2, '0');
+
+    for (size_t i = 0; i < len; ++i) {
+        hex[2 * i]     = digits[data[i] >> 4];
+        hex[2 * i + 1] = digits[data[i] & 0xf];
+    }
+    return hex;
+}
+
+static bool from_hex(const std::string& hex, uint8_t *data, size_t len)
+{
+    if (hex.size() != len * 2)
+        return false;
+
+    for (size_t i = 0; i < len; ++i) {
+        unsigned int byte = 0;
+
+        if (sscanf(hex.c_str() + 2 * i, "%2x", &byte) != 1)
+            return false;
+        data[i] = (uint8_t)byte;
+    }
+    return true;
+}
+
+uvgrtp::zrtp_file_cache::zrtp_file_cache(std::string path):
+    path_(path),
+    has_zid_(false),
+    zid_(),
+    secrets_()
+{
+}
+
+uvgrtp::zrtp_file_cache::~zrtp_file_cache()
+{
+}
+
+rtp_error_t uvgrtp::zrtp_file_cache::load()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ifstream file(path_);
+
+    if (!file.is_open()) {
+        UVG_LOG_INFO("ZRTP cache %s does not exist yet, it is created after the first session", path_.c_str());
+        return RTP_OK;
+    }
+
+    /* Each line is either "zid <our ZID>" or "<remote ZID> <rs1> <rs2 or ->" in hex */
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string first, rs1, rs2;
+
+        if (!(fields >> first) || first[0] == '#')
+            continue;
+
+        if (first == "zid") {
+            if (!(fields >> rs1) || !from_hex(rs1, zid_.data(), zid_.size())) {
+                UVG_LOG_ERROR("Invalid ZID in ZRTP cache %s", path_.c_str());
+                return RTP_INVALID_VALUE;
+            }
+            has_zid_ = true;
+            continue;
+        }
+
+        zid_t remote;
+        zrtp_retained_secrets secrets = {};
+
+        if (!(fields >> rs1 >> rs2) ||
+            !from_hex(first, remote.data(), remote.size()) ||
+            !from_hex(rs1, secrets.rs1, sizeof(secrets.rs1)))
+        {
+            UVG_LOG_ERROR("Invalid entry in ZRTP cache %s", path_.c_str());
+            return RTP_INVALID_VALUE;
+        }
+
+        secrets.rs2_valid = (rs2 != "-");
+        if (secrets.rs2_valid && !from_hex(rs2, secrets.rs2, sizeof(secrets.rs2))) {
+            UVG_LOG_ERROR("Invalid entry in ZRTP cache %s", path_.c_str());
+            return RTP_INVALID_VALUE;
+        }
+
+        secrets_[remote] = secrets;
+    }
+
+    return RTP_OK;
+}
+
+bool uvgrtp::zrtp_file_cache::get_zid(uint8_t zid[ZRTP_ZID_LENGTH])
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!has_zid_)
+        return false;
+
+    memcpy(zid, zid_.data(), zid_.size());
+    return true;
+}
+
+void uvgrtp::zrtp_file_cache::set_zid(const uint8_t zid[ZRTP_ZID_LENGTH])
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    memcpy(zid_.data(), zid, zid_.size());
+    has_zid_ = true;
+    save();
+}
+
+bool uvgrtp::zrtp_file_cache::get_secrets(const uint8_t remote_zid[ZRTP_ZID_LENGTH], zrtp_retained_secrets& secrets)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    zid_t remote;
+
+    memcpy(remote.data(), remote_zid, remote.size());
+
+    auto it = secrets_.find(remote);
+    if (it == secrets_.end())
+        return false;
+
+    secrets = it->second;
+    return true;
+}
+
+void uvgrtp::zrtp_file_cache::set_secrets(const uint8_t remote_zid[ZRTP_ZID_LENGTH], const zrtp_retained_secrets& secrets)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    zid_t remote;
+
+    memcpy(remote.data(), remote_zid, remote.size());
+    secrets_[remote] = secrets;
+    save();
+}
+
+void uvgrtp::zrtp_file_cache::save()
+{
+    std::string tmp_path = path_ + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+
+        if (!file.is_open()) {
+            UVG_LOG_ERROR("Failed to write ZRTP cache %s", tmp_path.c_str());
+            return;
+        }
+
+#ifndef _WIN32
+        // the file holds the secrets of every remote endpoint
+        chmod(tmp_path.c_str(), S_IRUSR | S_IWUSR);
+#endif
+
+        file << "# uvgRTP ZRTP cache\n";
+
+        if (has_zid_)
+            file << "zid " << to_hex(zid_.data(), zid_.size()) << "\n";
+
+        for (auto& entry : secrets_) {
+            file << to_hex(entry.first.data(), entry.first.size()) << " "
+                 << to_hex(entry.second.rs1, sizeof(entry.second.rs1)) << " "
+                 << (entry.second.rs2_valid ? to_hex(entry.second.rs2, sizeof(entry.second.rs2)) : "-") << "\n";
+        }
+
+        if (!file.good()) {
+            UVG_LOG_ERROR("Failed to write ZRTP cache %s", tmp_path.c_str());
+            return;
+        }
+    }
+
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows
+    (void)remove(path_.c_str());
+#endif
+
+    if (rename(tmp_path.c_str(), path_.c_str()) != 0)
+        UVG_LOG_ERROR("Failed to replace ZRTP cache %s", path_.c_str());
+}
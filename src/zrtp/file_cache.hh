@@ -0,0 +1,50 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+#include "uvgrtp/zrtp_cache.hh"
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace uvgrtp {
+
+    /* ZRTP cache kept in a text file, see uvgrtp::context::set_zrtp_cache_file()
+     *
+     * The whole file is read when the cache is created and rewritten every time it
+     * changes, which is once per ZRTP session. The file is replaced atomically so that
+     * a crash in the middle of writing does not lose the secrets. */
+    class zrtp_file_cache : public zrtp_cache {
+        public:
+            zrtp_file_cache(std::string path);
+            ~zrtp_file_cache();
+
+            /* Read the cache file if it exists
+             *
+             * Return RTP_OK on success or if the file does not exist yet
+             * Return RTP_INVALID_VALUE if the file is malformed */
+            rtp_error_t load();
+
+            virtual bool get_zid(uint8_t zid[ZRTP_ZID_LENGTH]);
+            virtual void set_zid(const uint8_t zid[ZRTP_ZID_LENGTH]);
+
+            virtual bool get_secrets(const uint8_t remote_zid[ZRTP_ZID_LENGTH], zrtp_retained_secrets& secrets);
+            virtual void set_secrets(const uint8_t remote_zid[ZRTP_ZID_LENGTH], const zrtp_retained_secrets& secrets);
+
+        private:
+            typedef std::array<uint8_t, ZRTP_ZID_LENGTH> zid_t;
+
+            /* Write the cache to the file, called with "mutex_" held */
+            void save();
+
+            std::string path_;
+            std::mutex mutex_;
+
+            bool has_zid_;
+            zid_t zid_;
+            std::map<zid_t, zrtp_retained_secrets> secrets_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -15,19 +15,45 @@
 
 using namespace uvgrtp::zrtp_msg;
 
+/* Key agreement types we offer in addition to the mandatory ones, in order of preference.
+ * EC25 is offered only when it has been enabled and Preshared mode only when there is a
+ * ZRTP cache. Without either the list is left out, so that the Hello is the same as the one
+ * of the uvgRTP versions that read its MAC and CRC from fixed offsets */
+static const uint32_t KEY_AGREEMENTS[] = { EC25, DH3k, PRSH };
+static const size_t   KEY_AGREEMENT_COUNT = sizeof(KEY_AGREEMENTS) / sizeof(KEY_AGREEMENTS[0]);
+
+/* Shifts of the algorithm list lengths in the flags word of Hello */
+enum HELLO_COUNT_SHIFTS {
+    HELLO_HC_SHIFT = 16,
+    HELLO_CC_SHIFT = 12,
+    HELLO_AC_SHIFT = 8,
+    HELLO_KC_SHIFT = 4,
+    HELLO_SC_SHIFT = 0
+};
+
 uvgrtp::zrtp_msg::hello::hello(zrtp_session_t& session):
     zrtp_message()
 {
     /* temporary storage for the full hmac hash */
     uint8_t mac_full[32];
 
-    /* We support only the mandatory algorithms etc. defined in RFC 6189
-     * so for us all the hash algos and key agreement types are set to zero 
-     *
-     * We need to assume that remote supports everything and thus need to
-     * allocate the maximum amount of memory for the message  */
+    /* Apart from the key agreement types, we support only the mandatory algorithms
+     * defined in RFC 6189 so the other algorithm lists are empty */
+    uint8_t *algos = nullptr;
+    uint32_t offered[KEY_AGREEMENT_COUNT];
+    size_t key_agreements = 0;
+
+    if (session.offer_ec25 || session.retain_secrets) {
+        for (uint32_t key_agreement : KEY_AGREEMENTS) {
+            if ((key_agreement == EC25 && !session.offer_ec25) || (key_agreement == PRSH && !session.retain_secrets))
+                continue;
+
+            offered[key_agreements++] = key_agreement;
+        }
+    }
+    size_t algos_len = key_agreements * sizeof(uint32_t);
 
-    allocate_frame(sizeof(zrtp_hello));
+    allocate_frame(sizeof(zrtp_hello) + algos_len + sizeof(uint64_t) + sizeof(uint32_t));
 
     zrtp_hello* msg = (zrtp_hello*)frame_;
 
@@ -39,15 +65,10 @@ uvgrtp::zrtp_msg::hello::hello(zrtp_session_t& session):
     memcpy(&msg->hash,               session.hash_ctx.o_hash[3], 32); /* 256 bits */
     memcpy(&msg->zid,                session.o_zid,              12); /* 96 bits */
 
-    msg->zero   = 0;
-    msg->s      = 0;
-    msg->m      = 0;
-    msg->p      = 0;
-    msg->unused = 0;
-    msg->hc     = 0;
-    msg->ac     = 0;
-    msg->kc     = 0;
-    msg->sc     = 0;
+    msg->flags = htonl((uint32_t)key_agreements << HELLO_KC_SHIFT);
+
+    algos = (uint8_t *)frame_ + sizeof(zrtp_hello);
+    memcpy(algos, offered, algos_len);
 
     /* Calculate MAC for the Hello message (only the ZRTP message part) */
     auto hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.hash_ctx.o_hash[2], 32);
@@ -55,10 +76,11 @@ uvgrtp::zrtp_msg::hello::hello(zrtp_session_t& session):
     hmac_sha256.update((uint8_t *)frame_, 81);
     hmac_sha256.final(mac_full);
 
-    memcpy(&msg->mac, mac_full, sizeof(uint64_t));
+    memcpy(&algos[algos_len], mac_full, sizeof(uint64_t));
 
     /* Calculate CRC32 of the whole packet (excluding crc) */
-    msg->crc = uvgrtp::crypto::crc32::calculate_crc32((uint8_t *)frame_, len_ - sizeof(uint32_t));
+    uint32_t crc = uvgrtp::crypto::crc32::calculate_crc32((uint8_t *)frame_, len_ - sizeof(uint32_t));
+    memcpy((uint8_t *)frame_ + len_ - sizeof(uint32_t), &crc, sizeof(uint32_t));
 
     if (session.l_msg.hello.second)
     {
@@ -87,6 +109,39 @@ rtp_error_t uvgrtp::zrtp_msg::hello::parse_msg(uvgrtp::zrtp_msg::zrtp_hello* hel
         session.capabilities.version = 110;
     }
 
+    uint32_t flags = ntohl(msg->flags);
+    std::vector<uint32_t> *lists[5] = {
+        &session.capabilities.hash_algos,
+        &session.capabilities.cipher_algos,
+        &session.capabilities.auth_tags,
+        &session.capabilities.key_agreements,
+        &session.capabilities.sas_types
+    };
+    const int shifts[5] = { HELLO_HC_SHIFT, HELLO_CC_SHIFT, HELLO_AC_SHIFT, HELLO_KC_SHIFT, HELLO_SC_SHIFT };
+
+    size_t algo_count = 0;
+    for (int i = 0; i < 5; ++i) {
+        algo_count += (flags >> shifts[i]) & 0xf;
+    }
+
+    if (len < sizeof(zrtp_hello) + algo_count * sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t)) {
+        UVG_LOG_ERROR("The algorithm lists of ZRTP Hello do not fit in the message");
+        return RTP_INVALID_VALUE;
+    }
+
+    /* The lists follow each other in the order of their lengths in the flags word */
+    const uint8_t *algos = (const uint8_t *)msg + sizeof(zrtp_hello);
+    for (int i = 0; i < 5; ++i) {
+        lists[i]->clear();
+
+        for (uint32_t j = 0; j < ((flags >> shifts[i]) & 0xf); ++j) {
+            uint32_t algo = 0;
+            memcpy(&algo, algos, sizeof(uint32_t));
+            lists[i]->push_back(algo);
+            algos += sizeof(uint32_t);
+        }
+    }
+
     /* finally add mandatory algorithms required by the specification to remote capabilities */
     session.capabilities.hash_algos.push_back(S256);
     session.capabilities.cipher_algos.push_back(AES1);
@@ -96,7 +151,7 @@ rtp_error_t uvgrtp::zrtp_msg::hello::parse_msg(uvgrtp::zrtp_msg::zrtp_hello* hel
     session.capabilities.sas_types.push_back(B32);
 
     /* Save the MAC value so we can check if later */
-    memcpy(&session.hash_ctx.r_mac[3], &msg->mac, 8);
+    memcpy(&session.hash_ctx.r_mac[3], algos, 8);
     memcpy(&session.hash_ctx.r_hash[3], msg->hash, 32);
 
     /* Save ZID */
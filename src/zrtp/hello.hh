@@ -32,28 +32,19 @@ namespace uvgrtp {
             uint32_t hash[8];
             uint32_t zid[3];
 
-            uint32_t zero:1;
-            uint32_t s:1;
-            uint32_t m:1;
-            uint32_t p:1;
-            uint32_t unused:8;
-            uint32_t hc:4;
-            uint32_t cc:4;
-            uint32_t ac:4;
-            uint32_t kc:4;
-            uint32_t sc:4;
-
-            
-            /* The following fields could be here if they were not 0:
+            /* 0 | S | M | P | unused (8) | hc | cc | ac | kc | sc in network byte order,
+             * the last five are the lengths of the algorithm lists */
+            uint32_t flags = 0;
+
+            /* The following fields are variable length and not part of the struct:
             *  hash algorithms
             *  cipher algorithms
             *  auth tag types
             *  Key Agreement Types
             *  SAS Types
+            *  MAC (64 bits)
+            *  CRC (32 bits)
             */
-
-            uint64_t mac = 0;
-            uint32_t crc = 0;
         });
 
         class hello : public zrtp_message {
@@ -61,7 +52,10 @@ namespace uvgrtp {
                 hello(zrtp_session_t& session);
                 ~hello();
 
-                /* TODO:  */
+                /* Save the algorithms, MAC and ZID of remote's Hello to "session"
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_INVALID_VALUE if the algorithm lists do not fit in the message */
                 virtual rtp_error_t parse_msg(uvgrtp::zrtp_msg::zrtp_hello* hello, zrtp_session_t& session, size_t len);
         };
     }
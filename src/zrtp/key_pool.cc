@@ -0,0 +1,103 @@
+#include "key_pool.hh"
+
+#include "../crypto.hh"
+#include "../debug.hh"
+
+uvgrtp::key_pool::key_pool(size_t size):
+    size_(size),
+    dh_(),
+    ecdh_(),
+    active_(true),
+    thread_(nullptr)
+{
+    thread_ = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::key_pool::runner, this));
+}
+
+uvgrtp::key_pool::~key_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = false;
+    }
+    cond_.notify_all();
+
+    if (thread_ && thread_->joinable()) {
+        thread_->join();
+    }
+}
+
+std::unique_ptr<uvgrtp::crypto::dh> uvgrtp::key_pool::take_dh()
+{
+    std::unique_ptr<uvgrtp::crypto::dh> dh = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (dh_.empty()) {
+            UVG_LOG_DEBUG("ZRTP key pool has no DH3k key pairs left");
+            return nullptr;
+        }
+
+        dh = std::move(dh_.front());
+        dh_.pop_front();
+    }
+    cond_.notify_all();
+
+    return dh;
+}
+
+std::unique_ptr<uvgrtp::crypto::ecdh> uvgrtp::key_pool::take_ecdh()
+{
+    std::unique_ptr<uvgrtp::crypto::ecdh> ecdh = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (ecdh_.empty()) {
+            UVG_LOG_DEBUG("ZRTP key pool has no EC25 key pairs left");
+            return nullptr;
+        }
+
+        ecdh = std::move(ecdh_.front());
+        ecdh_.pop_front();
+    }
+    cond_.notify_all();
+
+    return ecdh;
+}
+
+void uvgrtp::key_pool::runner()
+{
+    UVG_LOG_DEBUG("Starting ZRTP key pool");
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (active_) {
+        if (ecdh_.size() >= size_ && dh_.size() >= size_) {
+            cond_.wait(lock, [this] { return ecdh_.size() < size_ || dh_.size() < size_ || !active_; });
+            continue;
+        }
+
+        /* EC25 is preferred and its key pairs are cheap, so they are refilled first */
+        bool ec = ecdh_.size() < size_;
+
+        /* The keys are generated without the lock so that taking a key pair never waits */
+        lock.unlock();
+
+        if (ec) {
+            auto ecdh = std::unique_ptr<uvgrtp::crypto::ecdh>(new uvgrtp::crypto::ecdh);
+            ecdh->generate_keys();
+
+            lock.lock();
+            ecdh_.push_back(std::move(ecdh));
+        } else {
+            auto dh = std::unique_ptr<uvgrtp::crypto::dh>(new uvgrtp::crypto::dh);
+            dh->generate_keys();
+
+            lock.lock();
+            dh_.push_back(std::move(dh));
+        }
+    }
+
+    UVG_LOG_DEBUG("Stopping ZRTP key pool");
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace uvgrtp {
+
+    namespace crypto {
+        class dh;
+        class ecdh;
+    }
+
+    /* Key pairs generated ahead of time for the ZRTP sessions of a context, see
+     * uvgrtp::context::set_zrtp_key_pool()
+     *
+     * A thread keeps "size" DH3k and EC25 key pairs ready so that the key pair of a
+     * session does not have to be generated while the remote waits for our DHPart
+     * message. A key pair is given to one session only and the thread generates a
+     * new one in its place. The thread is started when the pool is created. */
+    class key_pool {
+        public:
+            key_pool(size_t size);
+            ~key_pool();
+
+            /* Take a DH3k or EC25 context whose key pair has been generated
+             *
+             * Return nullptr if the pool is empty, in which case the caller
+             * generates the key pair itself */
+            std::unique_ptr<uvgrtp::crypto::dh> take_dh();
+            std::unique_ptr<uvgrtp::crypto::ecdh> take_ecdh();
+
+        private:
+            void runner();
+
+            size_t size_;
+
+            std::mutex mutex_;
+            std::condition_variable cond_;
+
+            std::deque<std::unique_ptr<uvgrtp::crypto::dh>> dh_;
+            std::deque<std::unique_ptr<uvgrtp::crypto::ecdh>> ecdh_;
+
+            bool active_;
+            std::unique_ptr<std::thread> thread_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -5,6 +5,7 @@
 #include "socket.hh"
 #include "debug.hh"
 
+#include <cstring>
 #include <string>
 #ifdef _WIN32
 #include <ws2ipdef.h>
@@ -82,6 +83,13 @@ ssize_t uvgrtp::zrtp_msg::zrtp_message::header_length_to_packet(uint16_t header_
     return ((ssize_t)header_len + 1)*4 + sizeof(zrtp_header);
 }
 
+uint32_t uvgrtp::zrtp_msg::zrtp_message::get_crc(const uint8_t *packet, size_t len)
+{
+    uint32_t crc = 0;
+    memcpy(&crc, &packet[len - sizeof(uint32_t)], sizeof(uint32_t));
+    return crc;
+}
+
 uint16_t uvgrtp::zrtp_msg::zrtp_message::packet_to_header_len(ssize_t packet)
 {
     if (packet % 4 != 0)
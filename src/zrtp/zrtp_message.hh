@@ -30,6 +30,9 @@ namespace uvgrtp {
             static ssize_t header_length_to_packet(uint16_t header_len);
             static uint16_t packet_to_header_len(ssize_t packet);
 
+            /* The CRC is the last word of every ZRTP message, whatever its length */
+            static uint32_t get_crc(const uint8_t *packet, size_t len);
+
         protected:
 
             void allocate_frame(size_t frame_size);
@@ -131,9 +131,7 @@ rtp_error_t uvgrtp::zrtp_msg::receiver::recv_msg(std::shared_ptr<uvgrtp::socket>
 
             UVG_LOG_DEBUG("ZRTP Hello message received, verify CRC32!");
 
-            zrtp_hello *hello = (zrtp_hello *)msg;
-
-            if (!uvgrtp::crypto::crc32::verify_crc32(mem_, rlen_ - 4, hello->crc))
+            if (!uvgrtp::crypto::crc32::verify_crc32(mem_, rlen_ - 4, zrtp_message::get_crc(mem_, rlen_)))
                 return RTP_NOT_SUPPORTED;
         }
         out_type = ZRTP_FT_HELLO;
@@ -179,7 +177,7 @@ rtp_error_t uvgrtp::zrtp_msg::receiver::recv_msg(std::shared_ptr<uvgrtp::socket>
 
         case ZRTP_MSG_DH_PART1:
         {
-            // TODO: Check based on KA type
+            // the exact length depends on the key agreement type, see dh_key_exchange::parse_msg()
             if (msg->length < 21) // see rfc 6189 section 5.5
             {
                 UVG_LOG_WARN("ZRTP DH Part1 length field is wrong");
@@ -188,9 +186,7 @@ rtp_error_t uvgrtp::zrtp_msg::receiver::recv_msg(std::shared_ptr<uvgrtp::socket>
 
             UVG_LOG_DEBUG("ZRTP DH Part1 message received, verify CRC32!");
 
-            zrtp_dh *dh = (zrtp_dh *)msg;
-
-            if (!uvgrtp::crypto::crc32::verify_crc32(mem_, rlen_ - 4, dh->crc))
+            if (!uvgrtp::crypto::crc32::verify_crc32(mem_, rlen_ - 4, zrtp_message::get_crc(mem_, rlen_)))
                 return RTP_NOT_SUPPORTED;
         }
         out_type = ZRTP_FT_DH_PART1;
@@ -198,7 +194,7 @@ rtp_error_t uvgrtp::zrtp_msg::receiver::recv_msg(std::shared_ptr<uvgrtp::socket>
 
         case ZRTP_MSG_DH_PART2:
         {
-            // TODO: Check based on KA type
+            // the exact length depends on the key agreement type, see dh_key_exchange::parse_msg()
             if (msg->length < 21) // see rfc 6189 section 5.6
             {
                 UVG_LOG_WARN("ZRTP DH Part2 length field is wrong");
@@ -207,9 +203,7 @@ rtp_error_t uvgrtp::zrtp_msg::receiver::recv_msg(std::shared_ptr<uvgrtp::socket>
 
             UVG_LOG_DEBUG("ZRTP DH Part2 message received, verify CRC32!");
 
-            zrtp_dh *dh = (zrtp_dh *)msg;
-
-            if (!uvgrtp::crypto::crc32::verify_crc32(mem_, rlen_ - 4, dh->crc))
+            if (!uvgrtp::crypto::crc32::verify_crc32(mem_, rlen_ - 4, zrtp_message::get_crc(mem_, rlen_)))
                 return RTP_NOT_SUPPORTED;
         }
         out_type = ZRTP_FT_DH_PART2;
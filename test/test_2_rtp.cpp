@@ -1,5 +1,18 @@
 #include "test_common.hh"
+#include "uvgrtp/wrapper_c.hh"
+#include <algorithm>
 #include <array>
+#include <map>
+#include <condition_variable>
+#include <mutex>
+#include <fstream>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 /* TODO: 1) Test only sending, 2) test sending with different configuration, 3) test receiving with different configurations, and 
  * 4) test sending and receiving within same test while checking frame size */
@@ -9,6 +22,9 @@ constexpr uint16_t SEND_PORT = 9300;
 
 constexpr char REMOTE_ADDRESS[] = "127.0.0.1";
 constexpr char MULTICAST_ADDRESS[] = "224.0.0.122";
+constexpr char MULTICAST_GROUP1[] = "224.0.0.123";
+constexpr char MULTICAST_GROUP2[] = "224.0.0.124";
+constexpr char ANY_ADDRESS[] = "0.0.0.0";
 constexpr uint16_t RECEIVE_PORT = 9302;
 
 void rtp_receive_hook(void* arg, uvgrtp::frame::rtp_frame* frame);
@@ -195,11 +211,10 @@ TEST(RTPTests, rtp_configuration)
     cleanup_sess(ctx, sess);
 }
 
-/*
-TEST(RTPTests, rtp_flags)
+TEST(RTPTests, rtp_recv_batch)
 {
-    // Tests installing a hook to uvgRTP
-    std::cout << "Starting RTP hook test" << std::endl;
+    // Tests receiving packet bursts with recvmmsg batching enabled
+    std::cout << "Starting RTP receive batch test" << std::endl;
     uvgrtp::context ctx;
     uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
 
@@ -213,70 +228,84 @@ TEST(RTPTests, rtp_flags)
         receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
     }
 
-    int test_packets = 10;
-    std::vector<size_t> sizes = { 1000, 2000 };
+    EXPECT_NE(nullptr, receiver);
+    if (receiver)
+    {
+        EXPECT_EQ(1, receiver->get_configuration_value(RCC_RECV_BATCH_SIZE));
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_RECV_BATCH_SIZE, 0));
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_RECV_BATCH_SIZE, 65));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_RECV_BATCH_SIZE, 16));
+        EXPECT_EQ(16, receiver->get_configuration_value(RCC_RECV_BATCH_SIZE));
+    }
 
-    int rtp_flags = RTP_COPY;
+    int test_packets = 10;
+    std::vector<size_t> sizes = { 1000, 50000 };
     for (size_t& size : sizes)
     {
-        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, rtp_flags);
-        test_packet_size(std::move(test_frame), test_packets, size, sess, sender, receiver, rtp_flags);
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame), test_packets, size, sess, sender, receiver, RTP_NO_FLAGS);
     }
 
+    cleanup_ms(sess, sender);
     cleanup_ms(sess, receiver);
     cleanup_sess(ctx, sess);
 }
-*/
 
-TEST(RTPTests, rtp_send_receive_only_flags)
+TEST(RTPTests, rtp_inline_reception)
 {
-    // Tests installing a hook to uvgRTP
-    std::cout << "Starting RTP hook test" << std::endl;
+    // Tests receiving with packet processing done in the receiver thread
+    std::cout << "Starting RTP inline reception test" << std::endl;
     uvgrtp::context ctx;
-    uvgrtp::session* send_sess = ctx.create_session(REMOTE_ADDRESS);
-    uvgrtp::session* receive_sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
 
     uvgrtp::media_stream* sender = nullptr;
     uvgrtp::media_stream* receiver = nullptr;
 
-    int send_flags = RCE_FRAGMENT_GENERIC | RCE_SEND_ONLY;
-    int receive_flags = RCE_FRAGMENT_GENERIC | RCE_RECEIVE_ONLY;
-    if (send_sess)
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
     {
-        sender = send_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, send_flags);
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
     }
 
-    if (receive_sess)
+    EXPECT_NE(nullptr, receiver);
+    if (receiver)
     {
-        receiver = receive_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, receive_flags);
+        EXPECT_EQ(0, receiver->get_configuration_value(RCC_INLINE_RECEPTION));
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_INLINE_RECEPTION, 2));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_INLINE_RECEPTION, 1));
+        EXPECT_EQ(1, receiver->get_configuration_value(RCC_INLINE_RECEPTION));
     }
 
     int test_packets = 10;
-    std::vector<size_t> sizes = { 1000, 2000 };
+    std::vector<size_t> sizes = { 1000, 50000 };
     for (size_t& size : sizes)
     {
         std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
-        test_packet_size(std::move(test_frame), test_packets, size, send_sess, sender, receiver, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame), test_packets, size, sess, sender, receiver, RTP_NO_FLAGS);
     }
 
-    cleanup_ms(send_sess, sender);
-    cleanup_ms(receive_sess, receiver);
-    cleanup_sess(ctx, send_sess);
-    cleanup_sess(ctx, receive_sess);
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
 }
 
-TEST(RTPTests, rtp_poll)
+TEST(RTPTests, rtp_io_engine)
 {
-    std::cout << "Starting RTP poll test" << std::endl;
+    // Tests receiving through the event loops of the context I/O engine
+    std::cout << "Starting RTP I/O engine test" << std::endl;
     uvgrtp::context ctx;
+
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.start_io_engine(0));
+    EXPECT_EQ(RTP_OK, ctx.start_io_engine(2));
+    EXPECT_EQ(RTP_INITIALIZED, ctx.start_io_engine(2));
+
     uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
 
     uvgrtp::media_stream* sender = nullptr;
     uvgrtp::media_stream* receiver = nullptr;
 
     int flags = RCE_FRAGMENT_GENERIC;
-
-    EXPECT_NE(nullptr, sess);
     if (sess)
     {
         sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
@@ -284,375 +313,3765 @@ TEST(RTPTests, rtp_poll)
     }
 
     int test_packets = 10;
-
-    EXPECT_NE(nullptr, receiver);
-    EXPECT_NE(nullptr, sender);
-    if (sender)
+    std::vector<size_t> sizes = { 1000, 50000 };
+    for (size_t& size : sizes)
     {
-        const int frame_size = 1500;
-        std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
-        memset(test_frame.get(), 'b', frame_size);
-        send_packets(std::move(test_frame), frame_size, sess, sender, test_packets, 0, true, RTP_NO_FLAGS);
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame), test_packets, size, sess, sender, receiver, RTP_NO_FLAGS);
+    }
 
-        uvgrtp::frame::rtp_frame* received_frame = nullptr;
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
 
-        auto start = std::chrono::steady_clock::now();
-        rtp_errno = RTP_OK;
+#ifdef __linux__
+TEST(RTPTests, rtp_external_event_loop)
+{
+    // Tests receiving from an event loop of the application with the descriptor of the context
+    std::cout << "Starting RTP external event loop test" << std::endl;
+    uvgrtp::context ctx;
 
-        std::cout << "Start pulling data" << std::endl;
+    EXPECT_EQ(-1, ctx.get_event_fd());
+    EXPECT_EQ(0, ctx.process_events(0));
+    EXPECT_EQ(RTP_OK, ctx.start_external_event_loop());
+    EXPECT_EQ(RTP_INITIALIZED, ctx.start_external_event_loop());
+    EXPECT_EQ(RTP_INITIALIZED, ctx.start_io_engine(1));
 
-        int received_packets_no_timeout = 0;
-        while (std::chrono::steady_clock::now() - start < std::chrono::seconds(1))
-        {
-            if (receiver)
-            {
-                received_frame = receiver->pull_frame(0);
-                EXPECT_EQ(RTP_OK, rtp_errno);
-            }
+    int fd = ctx.get_event_fd();
+    EXPECT_LE(0, fd);
 
-            if (received_frame)
-            {
-                ++received_packets_no_timeout;
-                process_rtp_frame(received_frame);
-            }
-        }
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
 
-        EXPECT_EQ(received_packets_no_timeout, test_packets);
-        int received_packets_timout = 0;
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
 
-        test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
-        memset(test_frame.get(), 'b', frame_size);
-        send_packets(std::move(test_frame), frame_size, sess, sender, test_packets, 0, true, RTP_NO_FLAGS);
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+    }
 
-        std::cout << "Start pulling data with 3 ms timout" << std::endl;
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        const int frames = 10;
+        const size_t budget = 3;
+        const std::thread::id loop_thread = std::this_thread::get_id();
 
-        while (std::chrono::steady_clock::now() - start < std::chrono::seconds(2))
+        int received = 0;
+        bool other_thread = false;
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook([&](uvgrtp::frame::rtp_frame* frame) {
+            ++received;
+            other_thread = other_thread || std::this_thread::get_id() != loop_thread;
+            uvgrtp::frame::dealloc_frame(frame);
+        }));
+
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, 1000, RTP_NO_FLAGS);
+        for (int i = 0; i < frames; ++i)
         {
-            if (receiver)
-            {
-                received_frame = receiver->pull_frame(3);
-                EXPECT_EQ(RTP_OK, rtp_errno);
-            }
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), 1000, RTP_NO_FLAGS));
+        }
 
-            if (received_frame)
+        // nothing is received until the application processes the events
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        EXPECT_EQ(0, received);
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (received < frames && std::chrono::steady_clock::now() < deadline)
+        {
+            pollfd pfd = {};
+            pfd.fd     = fd;
+            pfd.events = POLLIN;
+
+            if (::poll(&pfd, 1, 100) > 0)
             {
-                ++received_packets_timout;
-                process_rtp_frame(received_frame);
+                EXPECT_GE(budget, ctx.process_events(budget));
             }
         }
 
-        EXPECT_EQ(received_packets_timout, test_packets);
-
-        test_wait(10, receiver);
-        test_wait(100, receiver);
-        test_wait(500, receiver);
-
-        if (received_frame)
-            process_rtp_frame(received_frame);
+        EXPECT_EQ(frames, received);
+        EXPECT_FALSE(other_thread);
     }
 
-    std::cout << "Finished pulling data" << std::endl;
-
     cleanup_ms(sess, sender);
     cleanup_ms(sess, receiver);
     cleanup_sess(ctx, sess);
 }
+#endif
 
-TEST(RTPTests, send_large_amounts)
+TEST(RTPTests, rtp_frame_pool)
 {
-    // Tests sending large amounts of data to make sure nothing breaks because of it
+    // Tests that released frames and payloads are reused by the next allocation
+    uvgrtp::frame::rtp_frame* frame = uvgrtp::frame::alloc_rtp_frame(1000);
+    EXPECT_NE(nullptr, frame);
+    if (!frame)
+        return;
 
-    // TODO: Everything should actually be received even in this case but it probably isn't at the moment
-    std::cout << "Starting RTP send too much test" << std::endl;
+    memset(frame->payload, 0xab, frame->payload_len);
+    frame->header.seq = 55;
+
+    uvgrtp::frame::rtp_frame* old_frame = frame;
+    uint8_t* old_payload = frame->payload;
+    EXPECT_EQ(RTP_OK, uvgrtp::frame::dealloc_frame(frame));
+
+    frame = uvgrtp::frame::alloc_rtp_frame(900);
+    EXPECT_EQ(old_frame, frame);
+    EXPECT_EQ(old_payload, frame->payload);
+    EXPECT_EQ(900, frame->payload_len);
+    EXPECT_EQ(0, frame->header.seq);
+    EXPECT_EQ(nullptr, frame->csrc);
+    EXPECT_EQ(nullptr, frame->ext);
+    EXPECT_EQ(RTP_OK, uvgrtp::frame::dealloc_frame(frame));
+
+    // payloads larger than the largest size class bypass the pool
+    frame = uvgrtp::frame::alloc_rtp_frame(16 * 1024 * 1024);
+    EXPECT_NE(nullptr, frame);
+    EXPECT_EQ(RTP_OK, uvgrtp::frame::dealloc_frame(frame));
+}
+
+TEST(RTPTests, rtp_zero_copy_receive)
+{
+    // Tests receiving frames whose payloads are the receive buffers themselves
+    std::cout << "Starting RTP zero-copy receive test" << std::endl;
     uvgrtp::context ctx;
     uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
 
     uvgrtp::media_stream* sender = nullptr;
     uvgrtp::media_stream* receiver = nullptr;
 
-    int flags = RCE_FRAGMENT_GENERIC;
-
-    EXPECT_NE(nullptr, sess);
     if (sess)
     {
-        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
-        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC,
+            RCE_FRAGMENT_GENERIC | RCE_RECEIVE_ZERO_COPY);
     }
 
-    add_hook(nullptr, receiver, rtp_receive_hook);
-
-    // send 10000 small packets
-    size_t frame_size = 1000;
-    int test_packets  = 10000;
-    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
-    memset(test_frame.get(), 'b', frame_size);
-    send_packets(std::move(test_frame), frame_size, sess, sender, test_packets, 0, true, RTP_NO_FLAGS);
-
-    // send 2000 large packets
-    frame_size   = 20000;
-    test_packets = 2000;
-    test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
-    memset(test_frame.get(), 'b', frame_size);
-    send_packets(std::move(test_frame), frame_size, sess, sender, test_packets, 0, true, RTP_NO_FLAGS);
+    int test_packets = 10;
+    std::vector<size_t> sizes = { 1000, 50000 };
+    for (size_t& size : sizes)
+    {
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame), test_packets, size, sess, sender, receiver, RTP_NO_FLAGS);
+    }
 
     cleanup_ms(sess, sender);
     cleanup_ms(sess, receiver);
     cleanup_sess(ctx, sess);
 }
 
-TEST(RTPTests, rtp_multicast)
+struct async_send_state {
+    std::mutex lock;
+    std::condition_variable cond;
+    std::vector<uint8_t*> completed;
+    int failures = 0;
+};
+
+static void async_send_complete(void* arg, uint8_t* data, rtp_error_t result)
 {
-    // Tests with a multicast address
-    std::cout << "Starting RTP multicast test" << std::endl;
+    async_send_state* state = (async_send_state*)arg;
+
+    std::lock_guard<std::mutex> guard(state->lock);
+    state->completed.push_back(data);
+    if (result != RTP_OK)
+        ++state->failures;
+    state->cond.notify_all();
+}
+
+TEST(RTPTests, rtp_async_send)
+{
+    // Tests that frames pushed with RCE_ASYNC_SEND are sent from the send queue and completed with the hook
+    std::cout << "Starting RTP asynchronous send test" << std::endl;
     uvgrtp::context ctx;
-    uvgrtp::session* sess = ctx.create_session(MULTICAST_ADDRESS, MULTICAST_ADDRESS);
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
 
     uvgrtp::media_stream* sender = nullptr;
     uvgrtp::media_stream* receiver = nullptr;
 
-    int flags = RCE_FRAGMENT_GENERIC;
     if (sess)
     {
-        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
-        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC | RCE_ASYNC_SEND);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
     }
 
-    int test_packets = 10;
-    std::vector<size_t> sizes = { 1000, 2000 };
-    for (size_t& size : sizes)
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (!sender || !receiver)
     {
-        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
-        test_packet_size(std::move(test_frame), test_packets, size, sess, sender, receiver, RTP_NO_FLAGS);
+        cleanup_ms(sess, sender);
+        cleanup_ms(sess, receiver);
+        cleanup_sess(ctx, sess);
+        return;
     }
 
-    cleanup_ms(sess, sender);
-    cleanup_ms(sess, receiver);
-    cleanup_sess(ctx, sess);
-}
+    async_send_state state;
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->install_send_complete_hook(&state, nullptr));
+    EXPECT_EQ(RTP_NOT_SUPPORTED, receiver->install_send_complete_hook(&state, async_send_complete));
+    EXPECT_EQ(RTP_OK, sender->install_send_complete_hook(&state, async_send_complete));
 
-TEST(RTPTests, rtp_multicast_multiple)
-{
-    // Tests with a multicast address
-    std::cout << "Starting RTP multicast test" << std::endl;
-    uvgrtp::context ctx;
-    uvgrtp::session* sess = ctx.create_session(MULTICAST_ADDRESS, MULTICAST_ADDRESS);
+    EXPECT_EQ(8, sender->get_configuration_value(RCC_SEND_QUEUE_SIZE));
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_SEND_QUEUE_SIZE, 0));
+    EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_SEND_QUEUE_SIZE, 16));
+    EXPECT_EQ(16, sender->get_configuration_value(RCC_SEND_QUEUE_SIZE));
+    EXPECT_EQ(-1, receiver->get_configuration_value(RCC_SEND_QUEUE_SIZE));
 
-    EXPECT_NE(nullptr, sess);
-    if (!sess) return;
+    const size_t frame_size = 5000;
+    const int raw_frames = 4;
+    std::vector<std::unique_ptr<uint8_t[]>> buffers;
 
-    int flags = RCE_FRAGMENT_GENERIC;
+    for (int i = 0; i < raw_frames; ++i)
+    {
+        buffers.push_back(std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]));
+        memset(buffers.back().get(), i, frame_size);
+        EXPECT_EQ(RTP_OK, sender->push_frame(buffers.back().get(), frame_size, RTP_NO_FLAGS));
+    }
 
-    auto sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
-    std::vector<uvgrtp::media_stream*> receivers = {
-        sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags),
-        sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags)
-    };
+    // uvgRTP owns these, so they are completed without a pointer
+    std::unique_ptr<uint8_t[]> copied(new uint8_t[frame_size]);
+    memset(copied.get(), raw_frames, frame_size);
+    EXPECT_EQ(RTP_OK, sender->push_frame(copied.get(), frame_size, RTP_COPY));
+    memset(copied.get(), 0xff, frame_size);
 
-    int test_packets = 10;
-    std::vector<size_t> sizes = { 1000, 2000 };
-    for (size_t& size : sizes)
+    std::unique_ptr<uint8_t[]> owned(new uint8_t[frame_size]);
+    memset(owned.get(), raw_frames + 1, frame_size);
+    EXPECT_EQ(RTP_OK, sender->push_frame(std::move(owned), frame_size, 1234, RTP_NO_FLAGS));
+
+    const size_t total_frames = raw_frames + 2;
     {
-        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
-        test_packet_size(std::move(test_frame), test_packets, size, sess, sender, receivers, RTP_NO_FLAGS);
+        std::unique_lock<std::mutex> guard(state.lock);
+        state.cond.wait_for(guard, std::chrono::seconds(5), [&] { return state.completed.size() >= total_frames; });
+
+        EXPECT_EQ(total_frames, state.completed.size());
+        EXPECT_EQ(0, state.failures);
+
+        // the frames are sent in the order they were pushed
+        for (size_t i = 0; i < state.completed.size(); ++i)
+        {
+            uint8_t* expected = (i < (size_t)raw_frames) ? buffers.at(i).get() : nullptr;
+            EXPECT_EQ(expected, state.completed.at(i));
+        }
+    }
+
+    for (size_t i = 0; i < total_frames; ++i)
+    {
+        uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(1000);
+        EXPECT_NE(nullptr, frame);
+        if (!frame)
+            break;
+
+        EXPECT_EQ(frame_size, frame->payload_len);
+        EXPECT_EQ((uint8_t)i, frame->payload[0]);
+        EXPECT_EQ((uint8_t)i, frame->payload[frame_size - 1]);
+        if (i == total_frames - 1)
+            EXPECT_EQ(1234, frame->header.timestamp);
+
+        uvgrtp::frame::dealloc_frame(frame);
     }
 
     cleanup_ms(sess, sender);
-    for (auto receiver: receivers) cleanup_ms(sess, receiver);
+    cleanup_ms(sess, receiver);
     cleanup_sess(ctx, sess);
 }
 
-TEST(RTPTests, rtp_multiplex)
+TEST(RTPTests, rtp_async_pull_and_push)
 {
-    // Test multiplexing two RTP streams into a single socket
-    std::cout << "Starting RTP multiplexing test" << std::endl;
+    // Tests that async_push_frame() reports the sent frames and async_pull_frame() completes the pulls in order
+    std::cout << "Starting RTP asynchronous pull and push test" << std::endl;
     uvgrtp::context ctx;
-    uvgrtp::session* receiver_sess = ctx.create_session(REMOTE_ADDRESS);
-    uvgrtp::session* sender_sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
 
-    uvgrtp::media_stream* sender1 = nullptr;
-    uvgrtp::media_stream* receiver1 = nullptr;
-    uvgrtp::media_stream* sender2 = nullptr;
-    uvgrtp::media_stream* receiver2 = nullptr;
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
 
-    int flags = RCE_FRAGMENT_GENERIC;
-    if (sender_sess)
+    if (sess)
     {
-        sender1 = sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
-        sender1->configure_ctx(RCC_SSRC, 11);
-        sender1->configure_ctx(RCC_REMOTE_SSRC, 22);
-        sender2 = sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
-        sender2->configure_ctx(RCC_SSRC, 33);
-        sender2->configure_ctx(RCC_REMOTE_SSRC, 44);
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC | RCE_ASYNC_SEND);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
     }
-    if (receiver_sess)
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (!sender || !receiver)
     {
-        receiver1 = receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
-        receiver1->configure_ctx(RCC_SSRC, 22);
-        receiver1->configure_ctx(RCC_REMOTE_SSRC, 11);
-        receiver2 = receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
-        receiver2->configure_ctx(RCC_SSRC, 44);
-        receiver2->configure_ctx(RCC_REMOTE_SSRC, 33);
+        cleanup_ms(sess, sender);
+        cleanup_ms(sess, receiver);
+        cleanup_sess(ctx, sess);
+        return;
     }
 
-    int test_packets = 10;
-    std::vector<size_t> sizes = { 1000, 2000 };
-    for (size_t& size : sizes)
-    {
-        std::unique_ptr<uint8_t[]> test_frame1 = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
-        std::unique_ptr<uint8_t[]> test_frame2 = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
-        test_packet_size(std::move(test_frame1), test_packets, size, sender_sess, sender1, receiver1, RTP_NO_FLAGS);
-        test_packet_size(std::move(test_frame2), test_packets, size, sender_sess, sender2, receiver2, RTP_NO_FLAGS);
-    }
+    const size_t frame_size = 3000;
+    const int frames = 4;
 
-    cleanup_ms(sender_sess, sender1);
-    cleanup_ms(sender_sess, sender2);
-    cleanup_ms(receiver_sess, receiver1);
-    cleanup_ms(receiver_sess, receiver2);
-    cleanup_sess(ctx, sender_sess);
-    cleanup_sess(ctx, receiver_sess);
-}
+    std::mutex lock;
+    std::condition_variable cond;
+    std::vector<uvgrtp::frame::rtp_frame*> pulled;
+    std::vector<rtp_error_t> sent;
 
-TEST(RTPTests, rtp_multiplex_poll)
-{
-    std::cout << "Starting RTP multiplexing via pull_frame test" << std::endl;
-    uvgrtp::context ctx;
-    uvgrtp::session* receiver_sess = ctx.create_session(REMOTE_ADDRESS);
-    uvgrtp::session* sender_sess = ctx.create_session(REMOTE_ADDRESS);
+    EXPECT_EQ(RTP_INVALID_VALUE, receiver->async_pull_frame(std::function<void(uvgrtp::frame::rtp_frame*)>()));
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->async_push_frame(nullptr, 0, RTP_NO_FLAGS, std::function<void(rtp_error_t)>()));
 
-    uvgrtp::media_stream* sender1 = nullptr;
-    uvgrtp::media_stream* receiver1 = nullptr;
-    uvgrtp::media_stream* sender2 = nullptr;
-    uvgrtp::media_stream* receiver2 = nullptr;
+    // the pulls do not take the frames from a receive hook of the application
+    EXPECT_EQ(RTP_OK, sender->install_receive_hook([](uvgrtp::frame::rtp_frame* frame) {
+        uvgrtp::frame::dealloc_frame(frame);
+    }));
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->async_pull_frame([](uvgrtp::frame::rtp_frame*) {}));
 
-    int flags = RCE_FRAGMENT_GENERIC;
-    if (sender_sess)
+    for (int i = 0; i < frames; ++i)
     {
-        sender1 = sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
-        sender1->configure_ctx(RCC_SSRC, 11);
-        sender2 = sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
-        sender2->configure_ctx(RCC_SSRC, 22);
+        EXPECT_EQ(RTP_OK, receiver->async_pull_frame([&](uvgrtp::frame::rtp_frame* frame) {
+            std::lock_guard<std::mutex> guard(lock);
+            pulled.push_back(frame);
+            cond.notify_all();
+        }));
     }
-    if (receiver_sess)
+
+    std::vector<std::unique_ptr<uint8_t[]>> buffers;
+    for (int i = 0; i < frames; ++i)
     {
-        receiver1 = receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
-        receiver1->configure_ctx(RCC_REMOTE_SSRC, 11);
-        receiver2 = receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
-        receiver2->configure_ctx(RCC_REMOTE_SSRC, 22);
+        buffers.push_back(std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]));
+        memset(buffers.back().get(), i, frame_size);
+
+        EXPECT_EQ(RTP_OK, sender->async_push_frame(buffers.back().get(), frame_size, RTP_NO_FLAGS, [&](rtp_error_t ret) {
+            std::lock_guard<std::mutex> guard(lock);
+            sent.push_back(ret);
+            cond.notify_all();
+        }));
     }
 
-    int test_packets = 10;
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        cond.wait_for(guard, std::chrono::seconds(5), [&] {
+            return sent.size() >= (size_t)frames && pulled.size() >= (size_t)frames;
+        });
 
-    if (sender1 && sender2)
+        EXPECT_EQ((size_t)frames, sent.size());
+        for (auto ret : sent)
+            EXPECT_EQ(RTP_OK, ret);
+
+        EXPECT_EQ((size_t)frames, pulled.size());
+        for (size_t i = 0; i < pulled.size(); ++i)
+        {
+            EXPECT_NE(nullptr, pulled.at(i));
+            if (!pulled.at(i))
+                continue;
+
+            EXPECT_EQ(frame_size, pulled.at(i)->payload_len);
+            EXPECT_EQ((uint8_t)i, pulled.at(i)->payload[0]);
+            uvgrtp::frame::dealloc_frame(pulled.at(i));
+        }
+    }
+
+#ifndef UVGRTP_HAVE_COROUTINES
+    // a frame that arrives before it is pulled waits for the next pull
+    std::future<rtp_error_t> result = sender->async_push_frame(buffers.front().get(), frame_size, RTP_NO_FLAGS);
+    EXPECT_EQ(std::future_status::ready, result.wait_for(std::chrono::seconds(5)));
+    EXPECT_EQ(RTP_OK, result.get());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::future<uvgrtp::frame::rtp_frame*> frame = receiver->async_pull_frame();
+    EXPECT_EQ(std::future_status::ready, frame.wait_for(std::chrono::seconds(5)));
+
+    uvgrtp::frame::rtp_frame* received = frame.get();
+    EXPECT_NE(nullptr, received);
+    if (received)
     {
-        const int frame_size = 1500;
-        std::unique_ptr<uint8_t[]> test_frame1 = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
-        std::unique_ptr<uint8_t[]> test_frame2 = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
-        memset(test_frame1.get(), 'b', frame_size);
-        memset(test_frame2.get(), 'b', frame_size);
-        send_packets(std::move(test_frame1), frame_size, sender_sess, sender1, test_packets, 0, true, RTP_NO_FLAGS);
-        send_packets(std::move(test_frame2), frame_size, sender_sess, sender2, test_packets, 0, true, RTP_NO_FLAGS);
+        EXPECT_EQ(frame_size, received->payload_len);
+        uvgrtp::frame::dealloc_frame(received);
+    }
 
-        uvgrtp::frame::rtp_frame* received_frame1 = nullptr;
-        uvgrtp::frame::rtp_frame* received_frame2 = nullptr;
+    // the pulls that wait when the stream goes away are completed with nullptr
+    std::future<uvgrtp::frame::rtp_frame*> pending = receiver->async_pull_frame();
+    cleanup_ms(sess, receiver);
+    EXPECT_EQ(std::future_status::ready, pending.wait_for(std::chrono::seconds(1)));
+    EXPECT_EQ(nullptr, pending.get());
+#else
+    cleanup_ms(sess, receiver);
+#endif
 
-        auto start = std::chrono::steady_clock::now();
-        rtp_errno = RTP_OK;
+    cleanup_ms(sess, sender);
+    cleanup_sess(ctx, sess);
+}
 
-        std::cout << "Start pulling data in both streams" << std::endl;
+TEST(RTPTests, rtp_paced_sending)
+{
+    // Tests that the packets of a paced frame are spread over the pacing window
+    std::cout << "Starting RTP paced sending test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
 
-        int received_packets_no_timeout1 = 0;
-        int received_packets_no_timeout2 = 0;
-        while (std::chrono::steady_clock::now() - start < std::chrono::seconds(1))
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC | RCE_PACE_FRAGMENT_SENDING);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        EXPECT_EQ(1, sender->get_configuration_value(RCC_PACING_BURST));
+        EXPECT_EQ(0, sender->get_configuration_value(RCC_PACING_SPIN));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_PACING_BURST, 0));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_PACING_SPIN, -1));
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_PACING_BURST, 4));
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_PACING_SPIN, 50));
+        EXPECT_EQ(4, sender->get_configuration_value(RCC_PACING_BURST));
+        EXPECT_EQ(50, sender->get_configuration_value(RCC_PACING_SPIN));
+
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_FPS_NUMERATOR, 10));
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_FPS_DENOMINATOR, 1));
+
+        const size_t frame_size = 60000;
+        std::unique_ptr<uint8_t[]> frame_data(new uint8_t[frame_size]);
+        memset(frame_data.get(), 0x42, frame_size);
+
+        for (int i = 0; i < 3; ++i)
         {
-            if (receiver1)
-            {
-                received_frame1 = receiver1->pull_frame(0);
-                EXPECT_EQ(RTP_OK, rtp_errno);
-            }
-            if (receiver2)
-            {
-                received_frame2 = receiver2->pull_frame(0);
-                EXPECT_EQ(RTP_OK, rtp_errno);
-            }
-            if (received_frame1)
-            {
-                ++received_packets_no_timeout1;
-                process_rtp_frame(received_frame1);
-            }
-            if (received_frame2)
+            auto start = std::chrono::steady_clock::now();
+            EXPECT_EQ(RTP_OK, sender->push_frame(frame_data.get(), frame_size, RTP_NO_FLAGS));
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+            // 80% of the 100 ms frame interval is used for pacing and the first burst leaves at once
+            EXPECT_GE(elapsed.count(), 60);
+            EXPECT_LE(elapsed.count(), 150);
+
+            uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(1000);
+            EXPECT_NE(nullptr, frame);
+            if (frame)
             {
-                ++received_packets_no_timeout2;
-                process_rtp_frame(received_frame2);
+                EXPECT_EQ(frame_size, frame->payload_len);
+                EXPECT_EQ(0x42, frame->payload[frame_size - 1]);
+                uvgrtp::frame::dealloc_frame(frame);
             }
         }
+    }
 
-        EXPECT_EQ(received_packets_no_timeout1, test_packets);
-        EXPECT_EQ(received_packets_no_timeout2, test_packets);
-        int received_packets_timout1 = 0;
-        int received_packets_timout2 = 0;
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
 
-        test_frame1 = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
-        test_frame2 = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
-        memset(test_frame1.get(), 'b', frame_size);
-        memset(test_frame2.get(), 'b', frame_size);
-        send_packets(std::move(test_frame1), frame_size, sender_sess, sender1, test_packets, 0, true, RTP_NO_FLAGS);
-        send_packets(std::move(test_frame2), frame_size, sender_sess, sender2, test_packets, 0, true, RTP_NO_FLAGS);
+TEST(RTPTests, rtp_kernel_pacing)
+{
+    // Tests that frames paced by the kernel are handed over without waiting for the pacing window
+    std::cout << "Starting RTP kernel pacing test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
 
-        std::cout << "Start pulling data in both streams with 3 ms timout" << std::endl;
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
 
-        while (std::chrono::steady_clock::now() - start < std::chrono::seconds(2))
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC,
+            RCE_FRAGMENT_GENERIC | RCE_PACE_FRAGMENT_SENDING | RCE_PACE_KERNEL);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_FPS_NUMERATOR, 10));
+
+        const size_t frame_size = 60000;
+        std::unique_ptr<uint8_t[]> frame_data(new uint8_t[frame_size]);
+        memset(frame_data.get(), 0x24, frame_size);
+
+        for (int i = 0; i < 3; ++i)
         {
-            if (receiver1)
-            {
-                received_frame1 = receiver1->pull_frame(3);
-                EXPECT_EQ(RTP_OK, rtp_errno);
-            }
-            if (receiver2)
-            {
-                received_frame2 = receiver2->pull_frame(3);
-                EXPECT_EQ(RTP_OK, rtp_errno);
-            }
+            auto start = std::chrono::steady_clock::now();
+            EXPECT_EQ(RTP_OK, sender->push_frame(frame_data.get(), frame_size, RTP_NO_FLAGS));
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
 
-            if (received_frame1)
-            {
-                ++received_packets_timout1;
-                process_rtp_frame(received_frame1);
-            }
-            if (received_frame2)
+#ifdef __linux__
+            // pacing in user space would take 80 ms of the 100 ms frame interval
+            EXPECT_LT(elapsed.count(), 40);
+#else
+            (void)elapsed;
+#endif
+
+            uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(1000);
+            EXPECT_NE(nullptr, frame);
+            if (frame)
             {
-                ++received_packets_timout2;
-                process_rtp_frame(received_frame2);
+                EXPECT_EQ(frame_size, frame->payload_len);
+                EXPECT_EQ(0x24, frame->payload[frame_size - 1]);
+                uvgrtp::frame::dealloc_frame(frame);
             }
         }
+    }
 
-        EXPECT_EQ(received_packets_timout1, test_packets);
-        EXPECT_EQ(received_packets_timout2, test_packets);
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
 
-        test_wait(10, receiver1);
-        test_wait(100, receiver1);
-        test_wait(500, receiver1);
-        test_wait(10, receiver2);
-        test_wait(100, receiver2);
-        test_wait(500, receiver2);
+TEST(RTPTests, rtp_udp_gso)
+{
+    // Tests sending fragmented frames with UDP GSO
+    std::cout << "Starting RTP UDP GSO test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
 
-        if (received_frame1) {
-            process_rtp_frame(received_frame1);
-        }
-        if (received_frame2) {
-            process_rtp_frame(received_frame2);
-        }
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
 
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC | RCE_UDP_GSO);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
     }
 
-    std::cout << "Finished pulling data" << std::endl;
+    int test_packets = 10;
+    std::vector<size_t> sizes = { 1000, 20000, 100000 };
+    for (size_t& size : sizes)
+    {
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame), test_packets, size, sess, sender, receiver, RTP_NO_FLAGS);
+    }
 
-    cleanup_ms(sender_sess, sender1);
-    cleanup_ms(sender_sess, sender2);
-    cleanup_ms(receiver_sess, receiver1);
-    cleanup_ms(receiver_sess, receiver2);
-    cleanup_sess(ctx, sender_sess);
-    cleanup_sess(ctx, receiver_sess);
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_udp_gro)
+{
+    // Tests receiving coalesced datagrams with UDP GRO
+    std::cout << "Starting RTP UDP GRO test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC | RCE_UDP_GSO);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC | RCE_UDP_GRO);
+    }
+
+    int test_packets = 10;
+    std::vector<size_t> sizes = { 1000, 20000, 100000 };
+    for (size_t& size : sizes)
+    {
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame), test_packets, size, sess, sender, receiver, RTP_NO_FLAGS);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+/*
+TEST(RTPTests, rtp_flags)
+{
+    // Tests installing a hook to uvgRTP
+    std::cout << "Starting RTP hook test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    int test_packets = 10;
+    std::vector<size_t> sizes = { 1000, 2000 };
+
+    int rtp_flags = RTP_COPY;
+    for (size_t& size : sizes)
+    {
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, rtp_flags);
+        test_packet_size(std::move(test_frame), test_packets, size, sess, sender, receiver, rtp_flags);
+    }
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
 }
+*/
+
+TEST(RTPTests, rtp_send_receive_only_flags)
+{
+    // Tests installing a hook to uvgRTP
+    std::cout << "Starting RTP hook test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* send_sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* receive_sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int send_flags = RCE_FRAGMENT_GENERIC | RCE_SEND_ONLY;
+    int receive_flags = RCE_FRAGMENT_GENERIC | RCE_RECEIVE_ONLY;
+    if (send_sess)
+    {
+        sender = send_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, send_flags);
+    }
+
+    if (receive_sess)
+    {
+        receiver = receive_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, receive_flags);
+    }
+
+    int test_packets = 10;
+    std::vector<size_t> sizes = { 1000, 2000 };
+    for (size_t& size : sizes)
+    {
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame), test_packets, size, send_sess, sender, receiver, RTP_NO_FLAGS);
+    }
+
+    cleanup_ms(send_sess, sender);
+    cleanup_ms(receive_sess, receiver);
+    cleanup_sess(ctx, send_sess);
+    cleanup_sess(ctx, receive_sess);
+}
+
+TEST(RTPTests, rtp_poll)
+{
+    std::cout << "Starting RTP poll test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+
+    EXPECT_NE(nullptr, sess);
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    int test_packets = 10;
+
+    EXPECT_NE(nullptr, receiver);
+    EXPECT_NE(nullptr, sender);
+    if (sender)
+    {
+        const int frame_size = 1500;
+        std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
+        memset(test_frame.get(), 'b', frame_size);
+        send_packets(std::move(test_frame), frame_size, sess, sender, test_packets, 0, true, RTP_NO_FLAGS);
+
+        uvgrtp::frame::rtp_frame* received_frame = nullptr;
+
+        auto start = std::chrono::steady_clock::now();
+        rtp_errno = RTP_OK;
+
+        std::cout << "Start pulling data" << std::endl;
+
+        int received_packets_no_timeout = 0;
+        while (std::chrono::steady_clock::now() - start < std::chrono::seconds(1))
+        {
+            if (receiver)
+            {
+                received_frame = receiver->pull_frame(0);
+                EXPECT_EQ(RTP_OK, rtp_errno);
+            }
+
+            if (received_frame)
+            {
+                ++received_packets_no_timeout;
+                process_rtp_frame(received_frame);
+            }
+        }
+
+        EXPECT_EQ(received_packets_no_timeout, test_packets);
+        int received_packets_timout = 0;
+
+        test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
+        memset(test_frame.get(), 'b', frame_size);
+        send_packets(std::move(test_frame), frame_size, sess, sender, test_packets, 0, true, RTP_NO_FLAGS);
+
+        std::cout << "Start pulling data with 3 ms timout" << std::endl;
+
+        while (std::chrono::steady_clock::now() - start < std::chrono::seconds(2))
+        {
+            if (receiver)
+            {
+                received_frame = receiver->pull_frame(3);
+                EXPECT_EQ(RTP_OK, rtp_errno);
+            }
+
+            if (received_frame)
+            {
+                ++received_packets_timout;
+                process_rtp_frame(received_frame);
+            }
+        }
+
+        EXPECT_EQ(received_packets_timout, test_packets);
+
+        test_wait(10, receiver);
+        test_wait(100, receiver);
+        test_wait(500, receiver);
+
+        if (received_frame)
+            process_rtp_frame(received_frame);
+    }
+
+    std::cout << "Finished pulling data" << std::endl;
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+static void rtp_batch_hook(void* arg, uvgrtp::frame::rtp_frame** frames, size_t count)
+{
+    EXPECT_GE(count, 1u);
+    for (size_t i = 0; i < count; ++i) {
+        process_rtp_frame(frames[i]);
+    }
+    *(std::atomic<int>*)arg += (int)count;
+}
+
+TEST(RTPTests, rtp_pull_frames)
+{
+    // Tests pulling many frames with one call and receiving them through a batch hook
+    std::cout << "Starting RTP batched pull test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+
+    EXPECT_NE(nullptr, sess);
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    int test_packets = 10;
+
+    EXPECT_NE(nullptr, receiver);
+    EXPECT_NE(nullptr, sender);
+    if (sender && receiver)
+    {
+        const size_t frame_size = 200;
+        uvgrtp::frame::rtp_frame* frames[4] = {};
+        EXPECT_EQ(0u, receiver->pull_frames(frames, 4, 10));
+
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, frame_size, RTP_NO_FLAGS);
+        send_packets(std::move(test_frame), frame_size, sess, sender, test_packets, 0, true, RTP_NO_FLAGS);
+
+        int received = 0;
+        auto start = std::chrono::steady_clock::now();
+        while (received < test_packets && std::chrono::steady_clock::now() - start < std::chrono::seconds(1))
+        {
+            size_t count = receiver->pull_frames(frames, 4, 100);
+            EXPECT_LE(count, 4u);
+
+            for (size_t i = 0; i < count; ++i) {
+                process_rtp_frame(frames[i]);
+            }
+            received += (int)count;
+        }
+        EXPECT_EQ(test_packets, received);
+
+        std::atomic<int> hooked(0);
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->install_receive_batch_hook(nullptr, nullptr));
+        EXPECT_EQ(RTP_OK, receiver->install_receive_batch_hook(&hooked, rtp_batch_hook));
+
+        test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, frame_size, RTP_NO_FLAGS);
+        send_packets(std::move(test_frame), frame_size, sess, sender, test_packets, 0, true, RTP_NO_FLAGS);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        EXPECT_EQ(test_packets, hooked.load());
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+struct typed_hook_context {
+    std::atomic<int> received{0};
+};
+
+static void typed_receive_hook(typed_hook_context* context, uvgrtp::frame::rtp_frame* frame)
+{
+    ++context->received;
+    process_rtp_frame(frame);
+}
+
+TEST(RTPTests, rtp_function_hooks)
+{
+    // Tests receiving frames through a C++ function hook and a hook with a typed context
+    std::cout << "Starting RTP function hook test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+
+    EXPECT_NE(nullptr, sess);
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    int test_packets = 10;
+    const size_t frame_size = 200;
+
+    EXPECT_NE(nullptr, receiver);
+    EXPECT_NE(nullptr, sender);
+    if (sender && receiver)
+    {
+        std::atomic<int> received(0);
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>()));
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook([&received, frame_size](uvgrtp::frame::rtp_frame* frame) {
+            EXPECT_EQ(frame_size, frame->payload_len);
+            ++received;
+            process_rtp_frame(frame);
+        }));
+
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, frame_size, RTP_NO_FLAGS);
+        send_packets(std::move(test_frame), frame_size, sess, sender, test_packets, 0, true, RTP_NO_FLAGS);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        EXPECT_EQ(test_packets, received.load());
+
+        typed_hook_context context;
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(&context, typed_receive_hook));
+
+        test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, frame_size, RTP_NO_FLAGS);
+        send_packets(std::move(test_frame), frame_size, sess, sender, test_packets, 0, true, RTP_NO_FLAGS);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        EXPECT_EQ(test_packets, context.received.load());
+        EXPECT_EQ(test_packets, received.load());
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, send_large_amounts)
+{
+    // Tests sending large amounts of data to make sure nothing breaks because of it
+
+    // TODO: Everything should actually be received even in this case but it probably isn't at the moment
+    std::cout << "Starting RTP send too much test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+
+    EXPECT_NE(nullptr, sess);
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    add_hook(nullptr, receiver, rtp_receive_hook);
+
+    // send 10000 small packets
+    size_t frame_size = 1000;
+    int test_packets  = 10000;
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
+    memset(test_frame.get(), 'b', frame_size);
+    send_packets(std::move(test_frame), frame_size, sess, sender, test_packets, 0, true, RTP_NO_FLAGS);
+
+    // send 2000 large packets
+    frame_size   = 20000;
+    test_packets = 2000;
+    test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
+    memset(test_frame.get(), 'b', frame_size);
+    send_packets(std::move(test_frame), frame_size, sess, sender, test_packets, 0, true, RTP_NO_FLAGS);
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_multicast)
+{
+    // Tests with a multicast address
+    std::cout << "Starting RTP multicast test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(MULTICAST_ADDRESS, MULTICAST_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    int test_packets = 10;
+    std::vector<size_t> sizes = { 1000, 2000 };
+    for (size_t& size : sizes)
+    {
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame), test_packets, size, sess, sender, receiver, RTP_NO_FLAGS);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_multicast_multiple)
+{
+    // Tests with a multicast address
+    std::cout << "Starting RTP multicast test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(MULTICAST_ADDRESS, MULTICAST_ADDRESS);
+
+    EXPECT_NE(nullptr, sess);
+    if (!sess) return;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+
+    auto sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+    std::vector<uvgrtp::media_stream*> receivers = {
+        sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags),
+        sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags)
+    };
+
+    int test_packets = 10;
+    std::vector<size_t> sizes = { 1000, 2000 };
+    for (size_t& size : sizes)
+    {
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame), test_packets, size, sess, sender, receivers, RTP_NO_FLAGS);
+    }
+
+    cleanup_ms(sess, sender);
+    for (auto receiver: receivers) cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_multiplex)
+{
+    // Test multiplexing two RTP streams into a single socket
+    std::cout << "Starting RTP multiplexing test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* receiver_sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* sender_sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender1 = nullptr;
+    uvgrtp::media_stream* receiver1 = nullptr;
+    uvgrtp::media_stream* sender2 = nullptr;
+    uvgrtp::media_stream* receiver2 = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sender_sess)
+    {
+        sender1 = sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        sender1->configure_ctx(RCC_SSRC, 11);
+        sender1->configure_ctx(RCC_REMOTE_SSRC, 22);
+        sender2 = sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        sender2->configure_ctx(RCC_SSRC, 33);
+        sender2->configure_ctx(RCC_REMOTE_SSRC, 44);
+    }
+    if (receiver_sess)
+    {
+        receiver1 = receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver1->configure_ctx(RCC_SSRC, 22);
+        receiver1->configure_ctx(RCC_REMOTE_SSRC, 11);
+        receiver2 = receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver2->configure_ctx(RCC_SSRC, 44);
+        receiver2->configure_ctx(RCC_REMOTE_SSRC, 33);
+    }
+
+    int test_packets = 10;
+    std::vector<size_t> sizes = { 1000, 2000 };
+    for (size_t& size : sizes)
+    {
+        std::unique_ptr<uint8_t[]> test_frame1 = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        std::unique_ptr<uint8_t[]> test_frame2 = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame1), test_packets, size, sender_sess, sender1, receiver1, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame2), test_packets, size, sender_sess, sender2, receiver2, RTP_NO_FLAGS);
+    }
+
+    cleanup_ms(sender_sess, sender1);
+    cleanup_ms(sender_sess, sender2);
+    cleanup_ms(receiver_sess, receiver1);
+    cleanup_ms(receiver_sess, receiver2);
+    cleanup_sess(ctx, sender_sess);
+    cleanup_sess(ctx, receiver_sess);
+}
+
+TEST(RTPTests, rtp_receive_shards)
+{
+    // Test multiplexing two RTP streams into a port that is received with several sockets
+    std::cout << "Starting RTP receive shards test" << std::endl;
+    uvgrtp::context ctx;
+
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.set_receive_shards(0));
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.set_receive_shards(65));
+#ifdef __linux__
+    EXPECT_EQ(RTP_OK, ctx.set_receive_shards(4));
+#else
+    EXPECT_EQ(RTP_NOT_SUPPORTED, ctx.set_receive_shards(4));
+#endif
+
+    uvgrtp::session* receiver_sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* sender_sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender1 = nullptr;
+    uvgrtp::media_stream* receiver1 = nullptr;
+    uvgrtp::media_stream* sender2 = nullptr;
+    uvgrtp::media_stream* receiver2 = nullptr;
+
+    // the SSRCs of the senders are steered to different sockets
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sender_sess)
+    {
+        sender1 = sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        sender1->configure_ctx(RCC_SSRC, 11);
+        sender1->configure_ctx(RCC_REMOTE_SSRC, 22);
+        sender2 = sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        sender2->configure_ctx(RCC_SSRC, 33);
+        sender2->configure_ctx(RCC_REMOTE_SSRC, 44);
+    }
+    if (receiver_sess)
+    {
+        receiver1 = receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver1->configure_ctx(RCC_SSRC, 22);
+        receiver1->configure_ctx(RCC_REMOTE_SSRC, 11);
+        receiver2 = receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver2->configure_ctx(RCC_SSRC, 44);
+        receiver2->configure_ctx(RCC_REMOTE_SSRC, 33);
+    }
+
+    int test_packets = 10;
+    std::vector<size_t> sizes = { 1000, 20000 };
+    for (size_t& size : sizes)
+    {
+        std::unique_ptr<uint8_t[]> test_frame1 = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        std::unique_ptr<uint8_t[]> test_frame2 = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame1), test_packets, size, sender_sess, sender1, receiver1, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame2), test_packets, size, sender_sess, sender2, receiver2, RTP_NO_FLAGS);
+    }
+
+    cleanup_ms(sender_sess, sender1);
+    cleanup_ms(sender_sess, sender2);
+    cleanup_ms(receiver_sess, receiver1);
+    cleanup_ms(receiver_sess, receiver2);
+    cleanup_sess(ctx, sender_sess);
+    cleanup_sess(ctx, receiver_sess);
+}
+
+TEST(RTPTests, rtp_reserve_ports)
+{
+    // Test creating streams on ports that were reserved for them in one call
+    std::cout << "Starting RTP port reservation test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* receiver_sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* sender_sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender1 = nullptr;
+    uvgrtp::media_stream* receiver1 = nullptr;
+    uvgrtp::media_stream* sender2 = nullptr;
+    uvgrtp::media_stream* receiver2 = nullptr;
+
+    uint16_t first_port = 0;
+    uint16_t next_port = 0;
+
+    EXPECT_NE(nullptr, receiver_sess);
+    EXPECT_NE(nullptr, sender_sess);
+    if (receiver_sess && sender_sess)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver_sess->reserve_ports(0, first_port));
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver_sess->reserve_ports(1, first_port, 30001, 30002));
+
+        EXPECT_EQ(RTP_OK, receiver_sess->reserve_ports(3, first_port, 30001, 30100));
+        EXPECT_EQ(0, first_port % 2);
+        EXPECT_LE(30002, first_port);
+
+        // the reserved ports are not reserved again
+        EXPECT_EQ(RTP_OK, receiver_sess->reserve_ports(1, next_port, first_port, 30100));
+        EXPECT_LE(first_port + 6, next_port);
+
+        int flags = RCE_FRAGMENT_GENERIC;
+        sender1 = sender_sess->create_stream(RECEIVE_PORT, first_port, RTP_FORMAT_GENERIC, flags);
+        receiver1 = receiver_sess->create_stream(first_port, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        sender2 = sender_sess->create_stream(RECEIVE_PORT + 2, first_port + 2, RTP_FORMAT_GENERIC, flags);
+        receiver2 = receiver_sess->create_stream(first_port + 2, RECEIVE_PORT + 2, RTP_FORMAT_GENERIC, flags);
+    }
+
+    EXPECT_NE(nullptr, receiver1);
+    EXPECT_NE(nullptr, receiver2);
+    if (sender1 && receiver1 && sender2 && receiver2)
+    {
+        int test_packets = 10;
+        size_t size = 1000;
+        std::unique_ptr<uint8_t[]> test_frame1 = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        std::unique_ptr<uint8_t[]> test_frame2 = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame1), test_packets, size, sender_sess, sender1, receiver1, RTP_NO_FLAGS);
+        test_packet_size(std::move(test_frame2), test_packets, size, sender_sess, sender2, receiver2, RTP_NO_FLAGS);
+    }
+
+    cleanup_ms(sender_sess, sender1);
+    cleanup_ms(sender_sess, sender2);
+    cleanup_ms(receiver_sess, receiver1);
+    cleanup_ms(receiver_sess, receiver2);
+    cleanup_sess(ctx, sender_sess);
+    cleanup_sess(ctx, receiver_sess);
+}
+
+TEST(RTPTests, rtp_stream_stats)
+{
+    // Test that the counters of the data path follow the sent and received frames
+    std::cout << "Starting RTP stream statistics test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        int test_frames = 10;
+        size_t size = 4000;
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+        }
+
+        int received = 0;
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+        while (received < test_frames && (frame = receiver->pull_frame(500)) != nullptr) {
+            EXPECT_EQ(size, frame->payload_len);
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            ++received;
+        }
+        EXPECT_EQ(test_frames, received);
+
+        uvgrtp::stream_stats sent = sender->get_stats();
+        uvgrtp::stream_stats recv = receiver->get_stats();
+
+        EXPECT_EQ((uint64_t)test_frames, sent.sent_frames);
+        EXPECT_EQ((uint64_t)test_frames * size, sent.sent_bytes);
+        EXPECT_EQ(0u, sent.send_errors);
+        EXPECT_LT((uint64_t)test_frames, sent.sent_packets);
+        EXPECT_EQ((uint64_t)test_frames, sent.send_batch_size.count);
+        EXPECT_EQ(sent.sent_packets, sent.send_batch_size.sum);
+
+        EXPECT_EQ(sent.sent_packets, recv.received_packets);
+        EXPECT_LT((uint64_t)test_frames * size, recv.received_bytes);
+        EXPECT_EQ((uint64_t)test_frames, recv.received_frames);
+        EXPECT_EQ((uint64_t)test_frames, recv.reassembly_latency_us.count);
+        EXPECT_EQ((uint64_t)test_frames, recv.queue_depth.count);
+        EXPECT_EQ(0u, recv.duplicate_packets);
+        EXPECT_EQ(0u, recv.dropped_frames);
+
+        uint64_t in_buckets = 0;
+        for (size_t i = 0; i < uvgrtp::STATS_HISTOGRAM_BUCKETS; ++i) {
+            in_buckets += recv.reassembly_latency_us.buckets[i];
+        }
+        EXPECT_EQ(recv.reassembly_latency_us.count, in_buckets);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_stage_profiling)
+{
+    // Test that the sampled packets and frames are timed in the stage histograms
+    std::cout << "Starting RTP stage profiling test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        const int test_frames = 10;
+        const size_t size = 4000;
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_PROFILE_SAMPLING, -1));
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_PROFILE_SAMPLING, 2));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_PROFILE_SAMPLING, 1));
+        EXPECT_EQ(2, sender->get_configuration_value(RCC_PROFILE_SAMPLING));
+
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+        }
+
+        int received = 0;
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+        while (received < test_frames && (frame = receiver->pull_frame(500)) != nullptr) {
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            ++received;
+        }
+        EXPECT_EQ(test_frames, received);
+
+        uvgrtp::stream_stats sent = sender->get_stats();
+        uvgrtp::stream_stats recv = receiver->get_stats();
+
+        // every other frame is sampled on the sending side
+        EXPECT_EQ((uint64_t)test_frames / 2, sent.stage_packetize_ns.count);
+        EXPECT_EQ((uint64_t)test_frames / 2, sent.stage_send_ns.count);
+        EXPECT_EQ(0u, sent.stage_fanout_ns.count);
+        EXPECT_LT(0u, sent.stage_send_ns.sum);
+
+        EXPECT_EQ(recv.received_packets, recv.stage_demux_ns.count);
+        EXPECT_EQ(recv.received_packets, recv.stage_reassembly_ns.count);
+        EXPECT_EQ((uint64_t)test_frames, recv.stage_delivery_ns.count);
+        EXPECT_EQ(0u, recv.stage_srtp_ns.count);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_ring_growth)
+{
+    // Test that a ring buffer that falls behind is replaced with a larger one without losing packets
+    std::cout << "Starting RTP ring buffer growth test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_RING_BUFFER_MAX_SIZE, -1));
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_RING_BUFFER_WATERMARK, 101));
+
+        // a ring of a few dozen slots that may grow to a megabyte
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_RING_BUFFER_SIZE, 50000));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_RING_BUFFER_MAX_SIZE, 1000000));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_RING_BUFFER_WATERMARK, 50));
+        EXPECT_EQ(1000000, receiver->get_configuration_value(RCC_RING_BUFFER_MAX_SIZE));
+        EXPECT_EQ(50, receiver->get_configuration_value(RCC_RING_BUFFER_WATERMARK));
+
+        // the slow hook makes the packets pile up in the ring
+        std::atomic<int> received(0);
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook([&received](uvgrtp::frame::rtp_frame* frame) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            ++received;
+        }));
+
+        int test_frames = 100;
+        size_t size = 1000;
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+        }
+
+        for (int i = 0; i < 200 && received < test_frames; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_EQ(test_frames, received);
+
+        uvgrtp::stream_stats stats = receiver->get_stats();
+        EXPECT_LT(0u, stats.ring_watermark_events);
+        EXPECT_LT(0u, stats.ring_resizes);
+        EXPECT_EQ(0u, stats.kernel_drops);
+        EXPECT_EQ((uint64_t)test_frames, stats.received_frames);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_capture_replay)
+{
+    // Test that the captured datagrams of a stream can be replayed into a new receiver
+    std::cout << "Starting RTP capture and replay test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    const char* sent_file = "uvgrtp_test_sent.pcap";
+    const char* received_file = "uvgrtp_test_received.pcap";
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    int test_frames = 50;
+    size_t size = 1000;
+    std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+    std::atomic<int> received(0);
+    auto count_frame = [&received](uvgrtp::frame::rtp_frame* frame) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        ++received;
+    };
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->start_capture(sent_file, 0));
+        EXPECT_EQ(RTP_NOT_INITIALIZED, sender->stop_capture());
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->replay_capture(sent_file, -1));
+        EXPECT_EQ(RTP_GENERIC_ERROR, receiver->replay_capture("uvgrtp_test_missing.pcap", 0));
+
+        EXPECT_EQ(RTP_OK, sender->start_capture(sent_file, RTP_CAPTURE_SEND));
+        EXPECT_EQ(RTP_OK, receiver->start_capture(received_file, RTP_CAPTURE_RECEIVE));
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(count_frame));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+        }
+
+        for (int i = 0; i < 100 && received < test_frames; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_EQ(test_frames, received);
+
+        EXPECT_EQ(RTP_OK, sender->stop_capture());
+        EXPECT_EQ(RTP_OK, receiver->stop_capture());
+    }
+
+    // the frames have been received once, so a new receiver is given the captures
+    cleanup_ms(sess, receiver);
+    receiver = nullptr;
+
+    for (const char* file : { sent_file, received_file })
+    {
+        if (sess)
+        {
+            receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        }
+
+        EXPECT_NE(nullptr, receiver);
+        if (receiver)
+        {
+            received = 0;
+            EXPECT_EQ(RTP_OK, receiver->install_receive_hook(count_frame));
+
+            // as fast as possible from the sent datagrams and at twice the speed from the received ones
+            EXPECT_EQ(RTP_OK, receiver->replay_capture(file, file == sent_file ? 0 : 2));
+
+            for (int i = 0; i < 100 && received < test_frames; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            EXPECT_EQ(test_frames, received);
+            EXPECT_EQ((uint64_t)test_frames, receiver->get_stats().received_frames);
+        }
+
+        cleanup_ms(sess, receiver);
+        receiver = nullptr;
+        std::remove(file);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_recording)
+{
+    // Test that the received frames are written to the recording and its index
+    std::cout << "Starting RTP recording test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    const char* file = "uvgrtp_test_recording.bin";
+    const char* index_file = "uvgrtp_test_recording.bin.idx";
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    int test_frames = 20;
+    size_t size = 3000;
+    std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+    std::atomic<int> received(0);
+    auto count_frame = [&received](uvgrtp::frame::rtp_frame* frame) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        ++received;
+    };
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(count_frame));
+        EXPECT_EQ(RTP_NOT_INITIALIZED, receiver->stop_recording());
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->start_recording(file, 2));
+
+        // the frames are delivered only with RTP_RECORD_DELIVER
+        for (int deliver : { 0, (int)RTP_RECORD_DELIVER })
+        {
+            received = 0;
+            EXPECT_EQ(RTP_OK, receiver->start_recording(file, deliver));
+            EXPECT_EQ(RTP_INITIALIZED, receiver->start_recording(file, deliver));
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            for (int i = 0; i < test_frames; ++i) {
+                EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+            }
+
+            for (int i = 0; i < 100 && receiver->get_stats().received_frames < (uint64_t)test_frames * (deliver ? 2 : 1); ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            EXPECT_EQ(RTP_OK, receiver->stop_recording());
+            EXPECT_EQ(deliver ? test_frames : 0, received);
+
+            std::ifstream data(file, std::ios::binary | std::ios::ate);
+            EXPECT_EQ((std::streamoff)(test_frames * size), (std::streamoff)data.tellg());
+
+            std::ifstream index(index_file, std::ios::binary);
+            std::vector<char> entries((std::istreambuf_iterator<char>(index)), std::istreambuf_iterator<char>());
+            EXPECT_EQ(8 + test_frames * 24, (int)entries.size());
+
+            if (entries.size() == (size_t)(8 + test_frames * 24))
+            {
+                EXPECT_EQ(0, memcmp(entries.data(), "UVGRIDX1", 8));
+
+                // the last frame is at the end of the file
+                uint64_t offset = 0;
+                uint32_t frame_size = 0;
+                memcpy(&offset, &entries[8 + (test_frames - 1) * 24], sizeof(offset));
+                memcpy(&frame_size, &entries[8 + (test_frames - 1) * 24 + 16], sizeof(frame_size));
+                EXPECT_EQ((uint64_t)((test_frames - 1) * size), offset);
+                EXPECT_EQ(size, frame_size);
+            }
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+    std::remove(file);
+    std::remove(index_file);
+}
+
+TEST(RTPTests, rtp_memory_transport)
+{
+    // Test that the streams of one process with the memory transport receive each other's frames
+    std::cout << "Starting RTP memory transport test" << std::endl;
+    uvgrtp::context ctx;
+
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.set_transport(4));
+    EXPECT_EQ(RTP_OK, ctx.set_transport(RTP_TRANSPORT_MEMORY));
+
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    int test_frames = 100;
+    size_t size = 5000;
+    std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+    std::atomic<int> received(0);
+    auto count_frame = [&received, size](uvgrtp::frame::rtp_frame* frame) {
+        EXPECT_EQ(size, frame->payload_len);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        ++received;
+    };
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        // the datagrams given to the kernel would get a send timestamp
+        bool timestamps = sender->configure_ctx(RCC_TIMESTAMPING, RTP_TIMESTAMP_SEND) == RTP_OK;
+
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(count_frame));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+        }
+
+        for (int i = 0; i < 100 && received < test_frames; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_EQ(test_frames, received);
+        EXPECT_EQ((uint64_t)test_frames, receiver->get_stats().received_frames);
+
+        if (timestamps) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            EXPECT_EQ(0u, sender->get_stats().send_delay_us.count);
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_memory_impairment)
+{
+    // Test that the emulated link of the memory transport loses and reorders the same packets on every run
+    std::cout << "Starting RTP memory transport impairment test" << std::endl;
+
+    const int test_frames = 200;
+    const size_t size = 500;
+    std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+    // the RTP timestamps of the received frames in the order they arrived
+    auto run = [&](const uvgrtp::impairment& config) {
+        std::vector<uint32_t> timestamps;
+        std::mutex mutex;
+
+        uvgrtp::context ctx;
+        EXPECT_EQ(RTP_OK, ctx.set_transport(RTP_TRANSPORT_MEMORY));
+        EXPECT_EQ(RTP_OK, ctx.set_impairment(config));
+
+        uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+        uvgrtp::media_stream* sender = nullptr;
+        uvgrtp::media_stream* receiver = nullptr;
+
+        if (sess)
+        {
+            sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS);
+            receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS);
+        }
+
+        EXPECT_NE(nullptr, sender);
+        EXPECT_NE(nullptr, receiver);
+        if (sender && receiver)
+        {
+            EXPECT_EQ(RTP_OK, receiver->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+                [&](uvgrtp::frame::rtp_frame* frame) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    timestamps.push_back(frame->header.timestamp);
+                    (void)uvgrtp::frame::dealloc_frame(frame);
+                })));
+
+            for (int i = 0; i < test_frames; ++i) {
+                EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, (uint32_t)(i + 1), RTP_NO_FLAGS));
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        cleanup_ms(sess, sender);
+        cleanup_ms(sess, receiver);
+        cleanup_sess(ctx, sess);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        return timestamps;
+    };
+
+    uvgrtp::context ctx;
+    uvgrtp::impairment invalid;
+    invalid.loss_good = 1.5;
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.set_impairment(invalid));
+
+    // bursts of losses
+    uvgrtp::impairment lossy;
+    lossy.good_to_bad = 0.05;
+    lossy.bad_to_good = 0.3;
+    lossy.loss_bad = 0.8;
+    lossy.seed = 7;
+
+    std::vector<uint32_t> first = run(lossy);
+    std::vector<uint32_t> second = run(lossy);
+
+    EXPECT_LT(first.size(), (size_t)test_frames);
+    EXPECT_LT((size_t)test_frames / 2, first.size());
+    EXPECT_EQ(first, second);
+
+    // the held back packets arrive after the ones sent after them
+    uvgrtp::impairment reordering;
+    reordering.reorder = 0.1;
+    reordering.reorder_delay_us = 2000;
+    reordering.delay_us = 500;
+
+    std::vector<uint32_t> reordered = run(reordering);
+    EXPECT_EQ((size_t)test_frames, reordered.size());
+    EXPECT_FALSE(std::is_sorted(reordered.begin(), reordered.end()));
+}
+
+TEST(RTPTests, rtp_reorder_window)
+{
+    // Test that the reorder buffer of the receiver puts the packets reordered by the link back in order
+    std::cout << "Starting RTP reorder window test" << std::endl;
+
+    const int test_frames = 200;
+    const size_t size = 500;
+    std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+    uvgrtp::impairment reordering;
+    reordering.reorder = 0.1;
+    reordering.reorder_delay_us = 2000;
+    reordering.delay_us = 500;
+
+    std::vector<uint32_t> timestamps;
+    std::mutex mutex;
+
+    uvgrtp::context ctx;
+    EXPECT_EQ(RTP_OK, ctx.set_transport(RTP_TRANSPORT_MEMORY));
+    EXPECT_EQ(RTP_OK, ctx.set_impairment(reordering));
+
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_REORDER_WINDOW_MS, -1));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_REORDER_WINDOW_MS, 20));
+        EXPECT_EQ(20, receiver->get_configuration_value(RCC_REORDER_WINDOW_MS));
+
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&](uvgrtp::frame::rtp_frame* frame) {
+                std::lock_guard<std::mutex> lock(mutex);
+                timestamps.push_back(frame->header.timestamp);
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            })));
+
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, (uint32_t)(i + 1), RTP_NO_FLAGS));
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ((size_t)test_frames, timestamps.size());
+    EXPECT_TRUE(std::is_sorted(timestamps.begin(), timestamps.end()));
+}
+
+TEST(RTPTests, rtp_xdp_transport)
+{
+    // Test that the streams of a context with AF_XDP on the loopback interface receive each other's
+    // frames, in both directions so that the replies are sent through the AF_XDP socket as well
+    std::cout << "Starting RTP AF_XDP transport test" << std::endl;
+    uvgrtp::context ctx;
+
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.set_transport(RTP_TRANSPORT_XDP));
+    EXPECT_EQ(RTP_OK, ctx.set_xdp_interface("lo", 0));
+
+    // the build or the privileges of the test may not allow AF_XDP, the streams then use UDP
+    rtp_error_t ret = ctx.set_transport(RTP_TRANSPORT_XDP);
+    EXPECT_TRUE(ret == RTP_OK || ret == RTP_NOT_SUPPORTED);
+
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* first = nullptr;
+    uvgrtp::media_stream* second = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        first = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        second = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    int test_frames = 50;
+    size_t size = 3000;
+    std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+    std::atomic<int> received_first(0);
+    std::atomic<int> received_second(0);
+    auto count_first = [&received_first, size](uvgrtp::frame::rtp_frame* frame) {
+        EXPECT_EQ(size, frame->payload_len);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        ++received_first;
+    };
+    auto count_second = [&received_second, size](uvgrtp::frame::rtp_frame* frame) {
+        EXPECT_EQ(size, frame->payload_len);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        ++received_second;
+    };
+
+    EXPECT_NE(nullptr, first);
+    EXPECT_NE(nullptr, second);
+    if (first && second)
+    {
+        EXPECT_EQ(RTP_OK, first->install_receive_hook(count_first));
+        EXPECT_EQ(RTP_OK, second->install_receive_hook(count_second));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, first->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        for (int i = 0; i < 100 && received_second < test_frames; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, second->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        for (int i = 0; i < 100 && received_first < test_frames; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        EXPECT_EQ(test_frames, received_second);
+        EXPECT_EQ(test_frames, received_first);
+    }
+
+    cleanup_ms(sess, first);
+    cleanup_ms(sess, second);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_fanout)
+{
+    // Test that the frames of one stream reach the added destinations, one of them with an SSRC of its own
+    std::cout << "Starting RTP fanout test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    const uint16_t second_port = RECEIVE_PORT + 4;
+    const uint32_t second_ssrc = 0x1234;
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver1 = nullptr;
+    uvgrtp::media_stream* receiver2 = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags | RCE_SEND_ONLY);
+        receiver1 = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags | RCE_RECEIVE_ONLY);
+        receiver2 = sess->create_stream(second_port, SEND_PORT, RTP_FORMAT_GENERIC, flags | RCE_RECEIVE_ONLY);
+    }
+
+    int test_frames = 20;
+    size_t size = 3000;
+    std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+    std::atomic<int> received1(0);
+    std::atomic<int> received2(0);
+    uint32_t sender_ssrc = sender ? sender->get_ssrc() : 0;
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver1);
+    EXPECT_NE(nullptr, receiver2);
+    if (sender && receiver1 && receiver2)
+    {
+        EXPECT_EQ(RTP_OK, receiver1->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&received1, size, sender_ssrc](uvgrtp::frame::rtp_frame* frame) {
+                EXPECT_EQ(size, frame->payload_len);
+                EXPECT_EQ(sender_ssrc, frame->header.ssrc);
+                (void)uvgrtp::frame::dealloc_frame(frame);
+                ++received1;
+            })));
+        EXPECT_EQ(RTP_OK, receiver2->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&received2, size, second_ssrc](uvgrtp::frame::rtp_frame* frame) {
+                EXPECT_EQ(size, frame->payload_len);
+                EXPECT_EQ(second_ssrc, frame->header.ssrc);
+                (void)uvgrtp::frame::dealloc_frame(frame);
+                ++received2;
+            })));
+
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->add_destination("::1", second_port));
+        EXPECT_EQ(RTP_NOT_SUPPORTED, sender->add_destination(REMOTE_ADDRESS, second_port, second_ssrc,
+            test_frame.get(), test_frame.get()));
+        EXPECT_EQ(RTP_OK, sender->add_destination(REMOTE_ADDRESS, second_port, second_ssrc, nullptr, nullptr));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+
+        for (int i = 0; i < 100 && (received1 < test_frames || received2 < test_frames); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_EQ(test_frames, received1);
+        EXPECT_EQ(test_frames, received2);
+
+        // after removing the destination, only the remote address of the stream gets the frames
+        EXPECT_EQ(RTP_OK, sender->remove_destination(REMOTE_ADDRESS, second_port));
+        EXPECT_EQ(RTP_NOT_FOUND, sender->remove_destination(REMOTE_ADDRESS, second_port));
+
+        EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+        for (int i = 0; i < 100 && received1 <= test_frames; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        EXPECT_EQ(test_frames + 1, received1);
+        EXPECT_EQ(test_frames, received2);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver1);
+    cleanup_ms(sess, receiver2);
+    cleanup_sess(ctx, sess);
+}
+
+static int forward_and_deliver(void *arg, uint8_t *packet, size_t size)
+{
+    (void)packet;
+    (void)size;
+    ++*(std::atomic<int> *)arg;
+    return RTP_FORWARD_SEND | RTP_FORWARD_DELIVER;
+}
+
+TEST(RTPTests, rtp_forwarding)
+{
+    // Test that a relay forwards the received packets to another receiver as the packets of its sending stream
+    std::cout << "Starting RTP forwarding test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    const uint16_t relay_port = RECEIVE_PORT + 6;
+    const uint16_t final_port = RECEIVE_PORT + 4;
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* relay_in = nullptr;
+    uvgrtp::media_stream* relay_out = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags | RCE_SEND_ONLY);
+        relay_in = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags | RCE_RECEIVE_ONLY);
+        relay_out = sess->create_stream(relay_port, final_port, RTP_FORMAT_GENERIC, flags | RCE_SEND_ONLY);
+        receiver = sess->create_stream(final_port, relay_port, RTP_FORMAT_GENERIC, flags | RCE_RECEIVE_ONLY);
+    }
+
+    int test_frames = 20;
+    size_t size = 3000;
+    std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+    std::atomic<int> relayed(0);
+    std::atomic<int> received(0);
+    std::atomic<int> hooked(0);
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, relay_in);
+    EXPECT_NE(nullptr, relay_out);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && relay_in && relay_out && receiver)
+    {
+        uint32_t relay_ssrc = relay_out->get_ssrc();
+
+        EXPECT_EQ(RTP_OK, relay_in->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&relayed](uvgrtp::frame::rtp_frame* frame) {
+                (void)uvgrtp::frame::dealloc_frame(frame);
+                ++relayed;
+            })));
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&received, size, relay_ssrc](uvgrtp::frame::rtp_frame* frame) {
+                EXPECT_EQ(size, frame->payload_len);
+                EXPECT_EQ(relay_ssrc, frame->header.ssrc);
+                (void)uvgrtp::frame::dealloc_frame(frame);
+                ++received;
+            })));
+
+        EXPECT_EQ(RTP_INVALID_VALUE, relay_in->add_forward_target(relay_in));
+        EXPECT_EQ(RTP_NOT_SUPPORTED, relay_in->add_forward_target(receiver));
+        EXPECT_EQ(RTP_NOT_SUPPORTED, sender->add_forward_target(relay_out));
+        EXPECT_EQ(RTP_OK, relay_in->add_forward_target(relay_out));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+
+        for (int i = 0; i < 100 && received < test_frames; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_EQ(test_frames, received);
+
+        // the packets were only forwarded
+        EXPECT_EQ(0, relayed);
+
+        // with the hook the relay also returns the frames
+        EXPECT_EQ(RTP_OK, relay_in->install_forward_hook(&hooked, forward_and_deliver));
+        EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+
+        for (int i = 0; i < 100 && (received <= test_frames || relayed < 1); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_EQ(test_frames + 1, received);
+        EXPECT_EQ(1, relayed);
+        EXPECT_LT(0, hooked);
+
+        // after removing the target and the hook, the relay is a plain receiver again
+        EXPECT_EQ(RTP_OK, relay_in->install_forward_hook(nullptr, nullptr));
+        EXPECT_EQ(RTP_OK, relay_in->remove_forward_target(relay_out));
+        EXPECT_EQ(RTP_NOT_FOUND, relay_in->remove_forward_target(relay_out));
+
+        EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+        for (int i = 0; i < 100 && relayed < 2; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        EXPECT_EQ(2, relayed);
+        EXPECT_EQ(test_frames + 1, received);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, relay_in);
+    cleanup_ms(sess, relay_out);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_audio_batch)
+{
+    // Test sending one audio frame for each of several streams with one call
+    std::cout << "Starting RTP audio batch test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* receiver_sess = ctx.create_session(REMOTE_ADDRESS);
+
+    const uint16_t other_send_port = SEND_PORT + 6;
+    const uint16_t other_receive_port = RECEIVE_PORT + 6;
+
+    uvgrtp::media_stream* senders[3] = { nullptr, nullptr, nullptr };
+    uvgrtp::media_stream* receivers[3] = { nullptr, nullptr, nullptr };
+
+    if (sender_sess)
+    {
+        // the first two share a socket and are sent with one system call
+        senders[0] = sender_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_OPUS, RCE_SEND_ONLY);
+        senders[1] = sender_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_OPUS, RCE_SEND_ONLY);
+        senders[2] = sender_sess->create_stream(other_send_port, other_receive_port, RTP_FORMAT_OPUS, RCE_SEND_ONLY);
+    }
+    if (receiver_sess)
+    {
+        receivers[0] = receiver_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_OPUS, RCE_RECEIVE_ONLY);
+        receivers[1] = receiver_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_OPUS, RCE_RECEIVE_ONLY);
+        receivers[2] = receiver_sess->create_stream(other_receive_port, other_send_port, RTP_FORMAT_OPUS, RCE_RECEIVE_ONLY);
+    }
+
+    std::atomic<int> received[3] = { {0}, {0}, {0} };
+    const size_t size = 160;
+    const int ticks = 10;
+
+    bool created = true;
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_NE(nullptr, senders[i]);
+        EXPECT_NE(nullptr, receivers[i]);
+        created = created && senders[i] && receivers[i];
+    }
+
+    if (created)
+    {
+        for (int i = 0; i < 3; ++i) {
+            senders[i]->configure_ctx(RCC_SSRC, 100 + i);
+            receivers[i]->configure_ctx(RCC_REMOTE_SSRC, 100 + i);
+
+            std::atomic<int>* counter = &received[i];
+            EXPECT_EQ(RTP_OK, receivers[i]->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+                [counter, size, i](uvgrtp::frame::rtp_frame* frame) {
+                    EXPECT_EQ(size, frame->payload_len);
+                    EXPECT_EQ((uint32_t)(1000 * (*counter + 1)), frame->header.timestamp);
+                    EXPECT_EQ(i, frame->payload[0]);
+                    (void)uvgrtp::frame::dealloc_frame(frame);
+                    ++*counter;
+                })));
+        }
+
+        std::unique_ptr<uint8_t[]> frames[3];
+        uint8_t* frame_ptrs[3];
+        size_t sizes[3] = { size, size, size };
+
+        for (int i = 0; i < 3; ++i) {
+            frames[i] = create_test_packet(RTP_FORMAT_OPUS, 0, false, size, RTP_NO_FLAGS);
+            frames[i][0] = (uint8_t)i;
+            frame_ptrs[i] = frames[i].get();
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        for (int tick = 1; tick <= ticks; ++tick) {
+            uint32_t timestamps[3] = { 1000u * tick, 1000u * tick, 1000u * tick };
+            EXPECT_EQ(RTP_OK, ctx.push_audio_frames(senders, frame_ptrs, sizes, timestamps, 3));
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+
+        for (int i = 0; i < 100 && (received[0] < ticks || received[1] < ticks || received[2] < ticks); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        for (int i = 0; i < 3; ++i) {
+            EXPECT_EQ(ticks, received[i]);
+            EXPECT_EQ((uint64_t)ticks, senders[i]->get_stats().sent_frames);
+        }
+
+        // a stream given twice is rejected and the rest are still sent
+        uvgrtp::media_stream* twice[2] = { senders[0], senders[0] };
+        uint32_t timestamps[2] = { 1000u * (ticks + 1), 1000u * (ticks + 1) };
+        EXPECT_EQ(RTP_INVALID_VALUE, ctx.push_audio_frames(twice, frame_ptrs, sizes, timestamps, 2));
+        EXPECT_EQ(RTP_INVALID_VALUE, ctx.push_audio_frames(nullptr, frame_ptrs, sizes, nullptr, 1));
+
+        for (int i = 0; i < 100 && received[0] <= ticks; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_EQ(ticks + 1, received[0]);
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        cleanup_ms(sender_sess, senders[i]);
+        cleanup_ms(receiver_sess, receivers[i]);
+    }
+    cleanup_sess(ctx, sender_sess);
+    cleanup_sess(ctx, receiver_sess);
+}
+
+/* Find the element "id" from a header extension of the two-byte form, see RFC 8285 section 4.3 */
+static const uint8_t* find_two_byte_element(const uvgrtp::frame::ext_header* ext, uint8_t id, size_t& len)
+{
+    for (size_t i = 0; ext && i + 2 <= ext->len;) {
+        if (ext->data[i] == 0) {
+            ++i;
+            continue;
+        }
+        if (ext->data[i] == id) {
+            len = ext->data[i + 1];
+            return &ext->data[i + 2];
+        }
+        i += 2 + ext->data[i + 1];
+    }
+    return nullptr;
+}
+
+TEST(RTPTests, rtp_header_extensions)
+{
+    // Test sending the abs-send-time, audio level and frame marking elements in the two-byte form
+    std::cout << "Starting RTP header extension test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    const uint16_t send_port = SEND_PORT + 10;
+    const uint16_t receive_port = RECEIVE_PORT + 10;
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        // the receiver does not reassemble, so each packet is a frame of its own
+        sender = sess->create_stream(send_port, receive_port, RTP_FORMAT_GENERIC, RCE_SEND_ONLY | RCE_FRAGMENT_GENERIC);
+        receiver = sess->create_stream(receive_port, send_port, RTP_FORMAT_GENERIC, RCE_RECEIVE_ONLY);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+
+    if (sender && receiver)
+    {
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_ABS_SEND_TIME_EXT_ID, 3));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_AUDIO_LEVEL_EXT_ID, 3));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_AUDIO_LEVEL_EXT_ID, 256));
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_AUDIO_LEVEL_EXT_ID, 20));
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_FRAME_MARKING_EXT_ID, 4));
+        EXPECT_EQ(20, sender->get_configuration_value(RCC_AUDIO_LEVEL_EXT_ID));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->set_audio_level(128, false));
+        EXPECT_EQ(RTP_OK, sender->set_audio_level(30, true));
+
+        std::mutex mutex;
+        std::vector<std::vector<uint8_t>> markings;
+        std::vector<size_t> sizes;
+        int levels = 0;
+        int send_times = 0;
+
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&](uvgrtp::frame::rtp_frame* frame) {
+                std::lock_guard<std::mutex> lock(mutex);
+                size_t len = 0;
+
+                EXPECT_NE(nullptr, frame->ext);
+                if (frame->ext) {
+                    EXPECT_EQ(0x1000, frame->ext->type & 0xfff0);
+
+                    const uint8_t* level = find_two_byte_element(frame->ext, 20, len);
+                    if (level && len == 1 && level[0] == (0x80 | 30))
+                        ++levels;
+
+                    if (find_two_byte_element(frame->ext, 3, len) && len == 3)
+                        ++send_times;
+
+                    const uint8_t* marking = find_two_byte_element(frame->ext, 4, len);
+                    markings.push_back(marking ? std::vector<uint8_t>(marking, marking + len) : std::vector<uint8_t>());
+                }
+                sizes.push_back(frame->payload_len);
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            })));
+
+        // a small frame is sent as one packet and a large one is split into three
+        const size_t small = 100;
+        const size_t large = 3000;
+
+        std::unique_ptr<uint8_t[]> frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, large, RTP_NO_FLAGS);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), small, RTP_NO_FLAGS));
+        EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), large, RTP_NO_FLAGS));
+
+        for (int i = 0; i < 100; ++i) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (sizes.size() >= 4)
+                    break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(4, sizes.size());
+        EXPECT_EQ(4, levels);
+        EXPECT_EQ(4, send_times);
+
+        if (sizes.size() == 4 && markings.size() == 4)
+        {
+            // the extension is not left in the payload
+            EXPECT_EQ(small, sizes[0]);
+            EXPECT_EQ(large, sizes[1] + sizes[2] + sizes[3]);
+
+            const uint8_t start = 0x80;
+            const uint8_t end = 0x40;
+            const std::vector<uint8_t> expected[4] = { { start | end }, { start }, { 0 }, { end } };
+            for (int i = 0; i < 4; ++i) {
+                EXPECT_EQ(expected[i], markings[i]);
+            }
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_frame_marking_drop)
+{
+    // Test that the receiver leaves out the frames of the filtered temporal layers and the discardable
+    // frames of a congested delivery queue based on the frame marking
+    std::cout << "Starting RTP frame marking drop test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    const uint16_t send_port = SEND_PORT + 12;
+    const uint16_t receive_port = RECEIVE_PORT + 12;
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(send_port, receive_port, RTP_FORMAT_H265, RCE_SEND_ONLY);
+        receiver = sess->create_stream(receive_port, send_port, RTP_FORMAT_H265, RCE_RECEIVE_ONLY);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+
+    if (sender && receiver)
+    {
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_FRAME_MARKING_EXT_ID, 5));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_FRAME_MARKING_EXT_ID, 5));
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_MAX_TEMPORAL_ID, 8));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_MAX_TEMPORAL_ID, 0));
+        EXPECT_EQ(0, receiver->get_configuration_value(RCC_MAX_TEMPORAL_ID));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_DELIVERY_QUEUE_FRAMES, 4));
+
+        // fragmented TRAIL_R and TRAIL_N pictures, the first of the base layer and the second discardable
+        const size_t size = 5000;
+        auto send = [&](uint8_t nal_type, uint8_t tid) {
+            std::unique_ptr<uint8_t[]> frame = create_test_packet(RTP_FORMAT_H265, nal_type, true, size, RTP_NO_FLAGS);
+            frame[5] = tid + 1;
+            EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), size, RTP_NO_FLAGS));
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        };
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        // the frames of temporal layer 1 are left out
+        int received = 0;
+        for (int i = 0; i < 3; ++i) {
+            send(1, 0);
+            send(0, 1);
+
+            uvgrtp::frame::rtp_frame* frame = nullptr;
+            while ((frame = receiver->pull_frame(50)) != nullptr) {
+                EXPECT_EQ(1, (frame->payload[4] >> 1) & 0x3f);
+                ++received;
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            }
+        }
+        EXPECT_EQ(3, received);
+        EXPECT_EQ(3, receiver->get_stats().skipped_frames);
+
+        // three frames fill the queue past three quarters, after which the discardable frames are left out
+        for (int i = 0; i < 3; ++i)
+            send(1, 0);
+        for (int i = 0; i < 3; ++i)
+            send(0, 0);
+        send(1, 0);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        received = 0;
+
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+        while ((frame = receiver->pull_frame(50)) != nullptr) {
+            EXPECT_EQ(1, (frame->payload[4] >> 1) & 0x3f);
+            ++received;
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+        EXPECT_EQ(4, received);
+
+        uvgrtp::stream_stats stats = receiver->get_stats();
+        EXPECT_EQ(6, stats.skipped_frames);
+        EXPECT_EQ(0, stats.dropped_frames);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_scalable_layers)
+{
+    // Test the layer limits of a sender, a receiver and a destination of the sender
+    std::cout << "Starting RTP scalable layer test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    const uint16_t send_port = SEND_PORT + 14;
+    const uint16_t receive_port = RECEIVE_PORT + 14;
+    const uint16_t destination_port = RECEIVE_PORT + 16;
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+    uvgrtp::media_stream* destination = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(send_port, receive_port, RTP_FORMAT_H265, RCE_SEND_ONLY);
+        receiver = sess->create_stream(receive_port, send_port, RTP_FORMAT_H265, RCE_RECEIVE_ONLY);
+        destination = sess->create_stream(destination_port, send_port, RTP_FORMAT_H265, RCE_RECEIVE_ONLY);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    EXPECT_NE(nullptr, destination);
+
+    if (sender && receiver && destination)
+    {
+        std::mutex mutex;
+        std::vector<uint8_t> received;
+        std::vector<uint8_t> destination_received;
+        std::vector<uint16_t> destination_seqs;
+
+        // the second byte of the NAL unit header has the layer ID and the temporal ID plus one
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&](uvgrtp::frame::rtp_frame* frame) {
+                std::lock_guard<std::mutex> lock(mutex);
+                received.push_back(frame->payload[5]);
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            })));
+        EXPECT_EQ(RTP_OK, destination->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&](uvgrtp::frame::rtp_frame* frame) {
+                std::lock_guard<std::mutex> lock(mutex);
+                destination_received.push_back(frame->payload[5]);
+                destination_seqs.push_back(frame->header.seq);
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            })));
+
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_MAX_LAYER_ID, 64));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_MAX_LAYER_ID, 0));
+        EXPECT_EQ(0, receiver->get_configuration_value(RCC_MAX_LAYER_ID));
+
+        EXPECT_EQ(RTP_NOT_FOUND, sender->set_destination_layers(REMOTE_ADDRESS, destination_port, 0, 63));
+        EXPECT_EQ(RTP_OK, sender->add_destination(REMOTE_ADDRESS, destination_port));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->set_destination_layers(REMOTE_ADDRESS, destination_port, 8, 63));
+        EXPECT_EQ(RTP_OK, sender->set_destination_layers(REMOTE_ADDRESS, destination_port, 0, 63));
+
+        const size_t size = 100;
+        const uint8_t base = 1;
+        const uint8_t temporal = 2;
+        const uint8_t layer = (1 << 3) | 1;
+
+        auto send = [&](uint8_t ids) {
+            std::unique_ptr<uint8_t[]> frame = create_test_packet(RTP_FORMAT_H265, 1, true, size, RTP_NO_FLAGS);
+            frame[5] = ids;
+            EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), size, RTP_NO_FLAGS));
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        };
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        for (int i = 0; i < 3; ++i) {
+            send(base);
+            send(temporal);
+            send(layer);
+        }
+
+        // the sender leaves out the temporal layer from everyone
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_MAX_TEMPORAL_ID, 0));
+        send(temporal);
+        send(base);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        const std::vector<uint8_t> expected = { base, temporal, base, temporal, base, temporal, base };
+        const std::vector<uint8_t> expected_destination = { base, layer, base, layer, base, layer, base };
+
+        EXPECT_EQ(expected, received);
+        EXPECT_EQ(expected_destination, destination_received);
+        EXPECT_EQ(3, receiver->get_stats().skipped_frames);
+
+        // the destination sees no gaps in its sequence numbers
+        for (size_t i = 1; i < destination_seqs.size(); ++i) {
+            EXPECT_EQ((uint16_t)(destination_seqs[i - 1] + 1), destination_seqs[i]);
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_ms(sess, destination);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_c_api_batches)
+{
+    // Test handing the buffers over to uvgRTP and pulling the frames without copying them through the C API
+    std::cout << "Starting RTP C API batch test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    const uint16_t send_port = SEND_PORT + 18;
+    const uint16_t receive_port = RECEIVE_PORT + 18;
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(send_port, receive_port, RTP_FORMAT_GENERIC, RCE_SEND_ONLY);
+        receiver = sess->create_stream(receive_port, send_port, RTP_FORMAT_GENERIC, RCE_RECEIVE_ONLY);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+
+    if (sender && receiver)
+    {
+        const size_t frames = 4;
+        const size_t size = 100;
+
+        std::vector<uint8_t*> released;
+        uvgrtp_release_hook release = [](void* arg, uint8_t* data) {
+            static_cast<std::vector<uint8_t*>*>(arg)->push_back(data);
+            delete[] data;
+        };
+
+        std::vector<uvgrtp_push_request> requests(frames);
+        std::vector<uint8_t*> buffers;
+        for (size_t i = 0; i < frames; ++i) {
+            uint8_t* data = new uint8_t[size];
+            memset(data, (int)i, size);
+            buffers.push_back(data);
+
+            requests[i] = { data, size, RTP_NO_FLAGS, release, &released, -1 };
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        EXPECT_EQ(frames, uvgrtp_push_frames(sender, requests.data(), frames));
+        for (auto& request : requests) {
+            EXPECT_EQ(RTP_OK, request.result);
+        }
+        EXPECT_EQ(buffers, released);
+
+        // a failed call does not take the buffer
+        uint8_t copied[size] = {};
+        EXPECT_EQ(RTP_INVALID_VALUE, uvgrtp_push_frame_owned(sender, copied, size, RTP_COPY, release, &released));
+        EXPECT_EQ(frames, released.size());
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        uvgrtp_frame received[frames] = {};
+        size_t pulled = uvgrtp_pull_frames(receiver, received, 3, 100);
+        EXPECT_EQ(3u, pulled);
+
+        for (size_t i = 0; i < pulled; ++i) {
+            EXPECT_EQ(size, received[i].payload_len);
+            EXPECT_EQ(i, received[i].payload[0]);
+            EXPECT_NE(nullptr, received[i].handle);
+        }
+        uvgrtp_release_frames(received, pulled);
+
+        // a frame that does not fit is returned without copying it
+        uint8_t buffer[size] = {};
+        uvgrtp_frame frame = {};
+        EXPECT_EQ(RTP_MEMORY_ERROR, uvgrtp_pull_frame_into(receiver, buffer, size - 1, &frame, 100));
+        EXPECT_EQ(size, frame.payload_len);
+        uvgrtp_release_frames(&frame, 1);
+
+        // otherwise the payload is copied to the buffer of the caller
+        memset(copied, 7, size);
+        EXPECT_EQ(RTP_OK, sender->push_frame(copied, size, RTP_NO_FLAGS));
+        EXPECT_EQ(RTP_OK, uvgrtp_pull_frame_into(receiver, buffer, size, &frame, 100));
+        EXPECT_EQ(buffer, frame.payload);
+        EXPECT_EQ(7, buffer[size - 1]);
+        EXPECT_EQ(nullptr, frame.handle);
+        EXPECT_EQ(RTP_TIMEOUT, uvgrtp_pull_frame_into(receiver, buffer, size, &frame, 10));
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_kernel_timestamps)
+{
+    // Test that the received frames carry their receive time and that the send timestamps are counted
+    std::cout << "Starting RTP kernel timestamp test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_TIMESTAMPING, 8));
+
+        bool kernel = receiver->configure_ctx(RCC_TIMESTAMPING, RTP_TIMESTAMP_RECEIVE) == RTP_OK &&
+            sender->configure_ctx(RCC_TIMESTAMPING, RTP_TIMESTAMP_SEND) == RTP_OK;
+
+        if (kernel) {
+            EXPECT_EQ(RTP_TIMESTAMP_RECEIVE, receiver->get_configuration_value(RCC_TIMESTAMPING));
+        } else {
+            std::cout << "Kernel timestamps are not supported, testing the user space receive times" << std::endl;
+        }
+
+        int test_frames = 10;
+        size_t size = 4000;
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        uint64_t start = uvgrtp::clock::system_ns();
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+        }
+
+        int received = 0;
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+        while (received < test_frames && (frame = receiver->pull_frame(500)) != nullptr) {
+            // a frame cannot be received before it was sent or after it was pulled
+            EXPECT_LE(start, frame->recv_time);
+            EXPECT_GE(uvgrtp::clock::system_ns(), frame->recv_time);
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            ++received;
+        }
+        EXPECT_EQ(test_frames, received);
+
+        if (kernel) {
+            // the timestamps of the last frame may still be on their way
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+
+            uvgrtp::stream_stats sent = sender->get_stats();
+            EXPECT_LT(0u, sent.send_delay_us.count);
+            EXPECT_GE(sent.sent_packets, sent.send_delay_us.count);
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+struct trace_counts {
+    std::atomic<int> points[RTP_TRACE_LAST];
+    std::atomic<uint32_t> last_complete_ts;
+};
+
+static void count_trace_event(void* arg, const uvgrtp::trace_event* event)
+{
+    trace_counts* counts = (trace_counts*)arg;
+    if (event->point >= 0 && event->point < RTP_TRACE_LAST) {
+        ++counts->points[event->point];
+    }
+    if (event->point == RTP_TRACE_FRAME_COMPLETE) {
+        counts->last_complete_ts = event->timestamp;
+    }
+}
+
+TEST(RTPTests, rtp_trace_hook)
+{
+    // Test that the frames pass the tracepoints of the data path
+    std::cout << "Starting RTP tracing test" << std::endl;
+    uvgrtp::context ctx;
+
+    trace_counts counts;
+    for (auto& point : counts.points) {
+        point = 0;
+    }
+    counts.last_complete_ts = 0;
+
+    rtp_error_t ret = ctx.install_trace_hook(&counts, count_trace_event);
+    if (ret == RTP_NOT_SUPPORTED) {
+        std::cout << "uvgRTP has been built without UVGRTP_ENABLE_TRACING, skipping the test" << std::endl;
+        return;
+    }
+    EXPECT_EQ(RTP_OK, ret);
+
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        int test_frames = 5;
+        size_t size = 4000;
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, 1000 + i, RTP_NO_FLAGS));
+        }
+
+        int received = 0;
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+        while (received < test_frames && (frame = receiver->pull_frame(500)) != nullptr) {
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            ++received;
+        }
+        EXPECT_EQ(test_frames, received);
+
+        EXPECT_EQ(test_frames, counts.points[RTP_TRACE_FRAME_PUSHED].load());
+        EXPECT_EQ(test_frames, counts.points[RTP_TRACE_FRAME_SENT].load());
+        EXPECT_EQ(test_frames, counts.points[RTP_TRACE_FRAGMENT_FIRST].load());
+        EXPECT_EQ(test_frames, counts.points[RTP_TRACE_FRAME_COMPLETE].load());
+        EXPECT_EQ(test_frames, counts.points[RTP_TRACE_FRAME_PULLED].load());
+        EXPECT_LT(0, counts.points[RTP_TRACE_PACKETS_READ].load());
+        EXPECT_LT(0, counts.points[RTP_TRACE_PACKETS_PROCESSED].load());
+        EXPECT_EQ(1000u + test_frames - 1, counts.last_complete_ts.load());
+    }
+
+    EXPECT_EQ(RTP_OK, ctx.install_trace_hook(nullptr, nullptr));
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+#ifdef __linux__
+// count the threads of this process with the name "name"
+static int count_threads(const std::string& name)
+{
+    int count = 0;
+    DIR* tasks = opendir("/proc/self/task");
+    if (!tasks)
+        return 0;
+
+    while (struct dirent* task = readdir(tasks))
+    {
+        std::ifstream comm(std::string("/proc/self/task/") + task->d_name + "/comm");
+        std::string comm_name;
+        if (std::getline(comm, comm_name) && comm_name == name)
+            ++count;
+    }
+    closedir(tasks);
+    return count;
+}
+#endif
+
+TEST(RTPTests, rtp_thread_config)
+{
+    // Test sending and receiving with configured threads
+    std::cout << "Starting RTP thread configuration test" << std::endl;
+    uvgrtp::context ctx;
+
+    uvgrtp::thread_config config;
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.configure_threads(RTP_THREAD_LAST, config));
+
+    config.name = "name-that-is-too-long";
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.configure_threads(RTP_THREAD_RECEIVER, config));
+
+    config.name = "test-recv";
+    config.policy = RTP_SCHED_FIFO;
+    config.priority = 0;
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.configure_threads(RTP_THREAD_RECEIVER, config));
+
+    config.policy = RTP_SCHED_LAST;
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.configure_threads(RTP_THREAD_RECEIVER, config));
+
+    // normal scheduling works without privileges
+    config.policy = RTP_SCHED_OTHER;
+#if defined(__linux__) || defined(_WIN32)
+    config.cpus = { -1 };
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.configure_threads(RTP_THREAD_RECEIVER, config));
+    config.cpus = { 0 };
+#endif
+    EXPECT_EQ(RTP_OK, ctx.configure_threads(RTP_THREAD_RECEIVER, config));
+
+    config = uvgrtp::thread_config();
+    config.name = "test-proc";
+    EXPECT_EQ(RTP_OK, ctx.configure_threads(RTP_THREAD_PROCESSOR, config));
+
+    uvgrtp::session* sender_sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* receiver_sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sender_sess)
+    {
+        sender = sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+    if (receiver_sess)
+    {
+        receiver = receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+#ifdef __linux__
+    // each stream has a receiver and a processing thread
+    EXPECT_EQ(2, count_threads("test-recv"));
+    EXPECT_EQ(2, count_threads("test-proc"));
+#endif
+
+    int test_packets = 10;
+    size_t size = 20000;
+    std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+    test_packet_size(std::move(test_frame), test_packets, size, sender_sess, sender, receiver, RTP_NO_FLAGS);
+
+    cleanup_ms(sender_sess, sender);
+    cleanup_ms(receiver_sess, receiver);
+    cleanup_sess(ctx, sender_sess);
+    cleanup_sess(ctx, receiver_sess);
+}
+
+TEST(RTPTests, rtp_socket_profile)
+{
+    // Test sending and receiving with a socket profile for the audio streams
+    std::cout << "Starting RTP socket profile test" << std::endl;
+    uvgrtp::context ctx;
+
+    uvgrtp::socket_profile profile;
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.configure_sockets(RTP_SOCKET_LAST, profile));
+
+    profile.dscp = 64;
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.configure_sockets(RTP_SOCKET_AUDIO, profile));
+
+    // the options that the system refuses are left out, so the streams work anyway
+    profile.dscp = 46;
+    profile.priority = 6;
+    profile.busy_poll_us = 50;
+    profile.max_receive_buffer = 16 * 1024 * 1024;
+    EXPECT_EQ(RTP_OK, ctx.configure_sockets(RTP_SOCKET_AUDIO, profile));
+
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    int test_packets = 10;
+    size_t size = 20000;
+    std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+    test_packet_size(std::move(test_frame), test_packets, size, sess, sender, receiver, RTP_NO_FLAGS);
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_multiplex_poll)
+{
+    std::cout << "Starting RTP multiplexing via pull_frame test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* receiver_sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* sender_sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender1 = nullptr;
+    uvgrtp::media_stream* receiver1 = nullptr;
+    uvgrtp::media_stream* sender2 = nullptr;
+    uvgrtp::media_stream* receiver2 = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sender_sess)
+    {
+        sender1 = sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        sender1->configure_ctx(RCC_SSRC, 11);
+        sender2 = sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        sender2->configure_ctx(RCC_SSRC, 22);
+    }
+    if (receiver_sess)
+    {
+        receiver1 = receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver1->configure_ctx(RCC_REMOTE_SSRC, 11);
+        receiver2 = receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver2->configure_ctx(RCC_REMOTE_SSRC, 22);
+    }
+
+    int test_packets = 10;
+
+    if (sender1 && sender2)
+    {
+        const int frame_size = 1500;
+        std::unique_ptr<uint8_t[]> test_frame1 = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
+        std::unique_ptr<uint8_t[]> test_frame2 = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
+        memset(test_frame1.get(), 'b', frame_size);
+        memset(test_frame2.get(), 'b', frame_size);
+        send_packets(std::move(test_frame1), frame_size, sender_sess, sender1, test_packets, 0, true, RTP_NO_FLAGS);
+        send_packets(std::move(test_frame2), frame_size, sender_sess, sender2, test_packets, 0, true, RTP_NO_FLAGS);
+
+        uvgrtp::frame::rtp_frame* received_frame1 = nullptr;
+        uvgrtp::frame::rtp_frame* received_frame2 = nullptr;
+
+        auto start = std::chrono::steady_clock::now();
+        rtp_errno = RTP_OK;
+
+        std::cout << "Start pulling data in both streams" << std::endl;
+
+        int received_packets_no_timeout1 = 0;
+        int received_packets_no_timeout2 = 0;
+        while (std::chrono::steady_clock::now() - start < std::chrono::seconds(1))
+        {
+            if (receiver1)
+            {
+                received_frame1 = receiver1->pull_frame(0);
+                EXPECT_EQ(RTP_OK, rtp_errno);
+            }
+            if (receiver2)
+            {
+                received_frame2 = receiver2->pull_frame(0);
+                EXPECT_EQ(RTP_OK, rtp_errno);
+            }
+            if (received_frame1)
+            {
+                ++received_packets_no_timeout1;
+                process_rtp_frame(received_frame1);
+            }
+            if (received_frame2)
+            {
+                ++received_packets_no_timeout2;
+                process_rtp_frame(received_frame2);
+            }
+        }
+
+        EXPECT_EQ(received_packets_no_timeout1, test_packets);
+        EXPECT_EQ(received_packets_no_timeout2, test_packets);
+        int received_packets_timout1 = 0;
+        int received_packets_timout2 = 0;
+
+        test_frame1 = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
+        test_frame2 = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
+        memset(test_frame1.get(), 'b', frame_size);
+        memset(test_frame2.get(), 'b', frame_size);
+        send_packets(std::move(test_frame1), frame_size, sender_sess, sender1, test_packets, 0, true, RTP_NO_FLAGS);
+        send_packets(std::move(test_frame2), frame_size, sender_sess, sender2, test_packets, 0, true, RTP_NO_FLAGS);
+
+        std::cout << "Start pulling data in both streams with 3 ms timout" << std::endl;
+
+        while (std::chrono::steady_clock::now() - start < std::chrono::seconds(2))
+        {
+            if (receiver1)
+            {
+                received_frame1 = receiver1->pull_frame(3);
+                EXPECT_EQ(RTP_OK, rtp_errno);
+            }
+            if (receiver2)
+            {
+                received_frame2 = receiver2->pull_frame(3);
+                EXPECT_EQ(RTP_OK, rtp_errno);
+            }
+
+            if (received_frame1)
+            {
+                ++received_packets_timout1;
+                process_rtp_frame(received_frame1);
+            }
+            if (received_frame2)
+            {
+                ++received_packets_timout2;
+                process_rtp_frame(received_frame2);
+            }
+        }
+
+        EXPECT_EQ(received_packets_timout1, test_packets);
+        EXPECT_EQ(received_packets_timout2, test_packets);
+
+        test_wait(10, receiver1);
+        test_wait(100, receiver1);
+        test_wait(500, receiver1);
+        test_wait(10, receiver2);
+        test_wait(100, receiver2);
+        test_wait(500, receiver2);
+
+        if (received_frame1) {
+            process_rtp_frame(received_frame1);
+        }
+        if (received_frame2) {
+            process_rtp_frame(received_frame2);
+        }
+
+    }
+
+    std::cout << "Finished pulling data" << std::endl;
+
+    cleanup_ms(sender_sess, sender1);
+    cleanup_ms(sender_sess, sender2);
+    cleanup_ms(receiver_sess, receiver1);
+    cleanup_ms(receiver_sess, receiver2);
+    cleanup_sess(ctx, sender_sess);
+    cleanup_sess(ctx, receiver_sess);
+}
+TEST(RTPTests, rtp_receive_priority)
+{
+    // The frames of a priority stream multiplexed into a socket are returned ahead of a backlog of the other stream
+    std::cout << "Starting RTP receive priority test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* receiver_sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* sender_sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* bulk_sender = nullptr;
+    uvgrtp::media_stream* priority_sender = nullptr;
+    uvgrtp::media_stream* bulk_receiver = nullptr;
+    uvgrtp::media_stream* priority_receiver = nullptr;
+
+    int flags = RCE_FRAGMENT_GENERIC;
+    if (sender_sess)
+    {
+        bulk_sender = sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        bulk_sender->configure_ctx(RCC_SSRC, 11);
+        priority_sender = sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+        priority_sender->configure_ctx(RCC_SSRC, 22);
+    }
+    if (receiver_sess)
+    {
+        bulk_receiver = receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        bulk_receiver->configure_ctx(RCC_REMOTE_SSRC, 11);
+        priority_receiver = receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, flags);
+        priority_receiver->configure_ctx(RCC_REMOTE_SSRC, 22);
+    }
+
+    ASSERT_TRUE(bulk_sender && priority_sender && bulk_receiver && priority_receiver);
+    EXPECT_EQ(RTP_OK, priority_receiver->configure_ctx(RCC_RECEIVE_PRIORITY, 1));
+    EXPECT_EQ(1, priority_receiver->get_configuration_value(RCC_RECEIVE_PRIORITY));
+
+    std::mutex order_mutex;
+    std::vector<uint32_t> order;
+    std::atomic<bool> blocked(false);
+    std::atomic<bool> release(false);
+
+    // the first bulk frame holds up the processing, so the next frames pile up in the ring
+    EXPECT_EQ(RTP_OK, bulk_receiver->install_receive_hook([&](uvgrtp::frame::rtp_frame* frame) {
+        {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(frame->header.ssrc);
+        }
+        (void)uvgrtp::frame::dealloc_frame(frame);
+
+        if (!blocked.exchange(true)) {
+            while (!release.load())
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }));
+    EXPECT_EQ(RTP_OK, priority_receiver->install_receive_hook([&](uvgrtp::frame::rtp_frame* frame) {
+        std::lock_guard<std::mutex> lock(order_mutex);
+        order.push_back(frame->header.ssrc);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }));
+
+    const int backlog = 20;
+    uint8_t payload[200];
+    memset(payload, 'p', sizeof(payload));
+
+    EXPECT_EQ(RTP_OK, bulk_sender->push_frame(payload, sizeof(payload), RTP_NO_FLAGS));
+
+    auto start = std::chrono::steady_clock::now();
+    while (!blocked.load() && std::chrono::steady_clock::now() - start < std::chrono::seconds(1))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    ASSERT_TRUE(blocked.load());
+
+    for (int i = 0; i < backlog; ++i) {
+        EXPECT_EQ(RTP_OK, bulk_sender->push_frame(payload, sizeof(payload), RTP_NO_FLAGS));
+    }
+    EXPECT_EQ(RTP_OK, priority_sender->push_frame(payload, sizeof(payload), RTP_NO_FLAGS));
+
+    // let the receiver thread read them all before the processing goes on
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    release = true;
+
+    start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::seconds(1))
+    {
+        {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            if (order.size() == backlog + 2)
+                break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(order_mutex);
+        ASSERT_EQ((size_t)backlog + 2, order.size());
+        EXPECT_EQ(11u, order[0]);
+        EXPECT_EQ(22u, order[1]);
+
+        for (size_t i = 2; i < order.size(); ++i) {
+            EXPECT_EQ(11u, order[i]);
+        }
+    }
+
+    cleanup_ms(sender_sess, bulk_sender);
+    cleanup_ms(sender_sess, priority_sender);
+    cleanup_ms(receiver_sess, bulk_receiver);
+    cleanup_ms(receiver_sess, priority_receiver);
+    cleanup_sess(ctx, sender_sess);
+    cleanup_sess(ctx, receiver_sess);
+}
+
+TEST(RTPTests, rtp_multicast_groups)
+{
+    // Two groups received with one socket, the packets go to the stream of their group whatever their SSRC
+    std::cout << "Starting RTP multicast groups test" << std::endl;
+    uvgrtp::context receiver_ctx;
+    uvgrtp::context sender_ctx;
+    uvgrtp::session* receiver_sess = receiver_ctx.create_session(REMOTE_ADDRESS, ANY_ADDRESS);
+    uvgrtp::session* sender_sess1 = sender_ctx.create_session(MULTICAST_GROUP1);
+    uvgrtp::session* sender_sess2 = sender_ctx.create_session(MULTICAST_GROUP2);
+
+    EXPECT_NE(nullptr, receiver_sess);
+    EXPECT_NE(nullptr, sender_sess1);
+    EXPECT_NE(nullptr, sender_sess2);
+    if (!receiver_sess || !sender_sess1 || !sender_sess2) return;
+
+    const uint16_t receive_port = RECEIVE_PORT + 19;
+    int flags = RCE_FRAGMENT_GENERIC;
+
+    uvgrtp::media_stream* receiver1 = receiver_sess->create_stream(receive_port, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+    uvgrtp::media_stream* receiver2 = receiver_sess->create_stream(receive_port, SEND_PORT, RTP_FORMAT_GENERIC, flags);
+    uvgrtp::media_stream* sender1 = sender_sess1->create_stream(SEND_PORT + 19, receive_port, RTP_FORMAT_GENERIC, flags | RCE_SEND_ONLY);
+    uvgrtp::media_stream* sender2 = sender_sess2->create_stream(SEND_PORT + 20, receive_port, RTP_FORMAT_GENERIC, flags | RCE_SEND_ONLY);
+
+    EXPECT_NE(nullptr, receiver1);
+    EXPECT_NE(nullptr, receiver2);
+    EXPECT_NE(nullptr, sender1);
+    EXPECT_NE(nullptr, sender2);
+
+    if (receiver1 && receiver2 && sender1 && sender2)
+    {
+        receiver1->configure_ctx(RCC_REMOTE_SSRC, 11);
+        receiver2->configure_ctx(RCC_REMOTE_SSRC, 22);
+        sender1->configure_ctx(RCC_SSRC, 33);
+        sender2->configure_ctx(RCC_SSRC, 44);
+
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver1->join_multicast_group(REMOTE_ADDRESS));
+        EXPECT_EQ(RTP_NOT_SUPPORTED, sender1->join_multicast_group(MULTICAST_GROUP1));
+        EXPECT_EQ(RTP_OK, receiver1->join_multicast_group(MULTICAST_GROUP1));
+        EXPECT_EQ(RTP_OK, receiver2->join_multicast_group(MULTICAST_GROUP2));
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver2->join_multicast_group(MULTICAST_GROUP1));
+
+        // a source-specific join lets through only the packets of the source, which is not the sender here
+        EXPECT_EQ(RTP_OK, receiver1->join_multicast_group(MULTICAST_ADDRESS, REMOTE_ADDRESS));
+
+        const int test_packets = 10;
+        const size_t frame_size = 1000;
+
+        for (int i = 0; i < test_packets; ++i)
+        {
+            std::unique_ptr<uint8_t[]> frame1 = create_test_packet(RTP_FORMAT_GENERIC, 0, false, frame_size, RTP_NO_FLAGS);
+            std::unique_ptr<uint8_t[]> frame2 = create_test_packet(RTP_FORMAT_GENERIC, 0, false, frame_size, RTP_NO_FLAGS);
+            EXPECT_EQ(RTP_OK, sender1->push_frame(std::move(frame1), frame_size, RTP_NO_FLAGS));
+            EXPECT_EQ(RTP_OK, sender2->push_frame(std::move(frame2), frame_size, RTP_NO_FLAGS));
+        }
+
+        int received1 = 0;
+        int received2 = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        while ((received1 < test_packets || received2 < test_packets) &&
+            std::chrono::steady_clock::now() - start < std::chrono::seconds(2))
+        {
+            uvgrtp::frame::rtp_frame* frame = receiver1->pull_frame(5);
+            if (frame)
+            {
+                EXPECT_EQ(33u, frame->header.ssrc);
+                ++received1;
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            }
+
+            frame = receiver2->pull_frame(5);
+            if (frame)
+            {
+                EXPECT_EQ(44u, frame->header.ssrc);
+                ++received2;
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            }
+        }
+
+        EXPECT_EQ(test_packets, received1);
+        EXPECT_EQ(test_packets, received2);
+
+        EXPECT_EQ(RTP_OK, receiver1->leave_multicast_group(MULTICAST_GROUP1));
+        EXPECT_EQ(RTP_GENERIC_ERROR, receiver1->leave_multicast_group(MULTICAST_GROUP1));
+        EXPECT_EQ(RTP_OK, receiver1->leave_multicast_group(MULTICAST_ADDRESS, REMOTE_ADDRESS));
+        EXPECT_EQ(RTP_OK, receiver2->leave_multicast_group(MULTICAST_GROUP2));
+    }
+
+    cleanup_ms(sender_sess1, sender1);
+    cleanup_ms(sender_sess2, sender2);
+    cleanup_ms(receiver_sess, receiver1);
+    cleanup_ms(receiver_sess, receiver2);
+    cleanup_sess(sender_ctx, sender_sess1);
+    cleanup_sess(sender_ctx, sender_sess2);
+    cleanup_sess(receiver_ctx, receiver_sess);
+}
+
+TEST(RTPTests, rtp_path_mtu_discovery)
+{
+    // Tests growing the payloads to the path MTU of the loopback interface
+    std::cout << "Starting RTP path MTU discovery test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_FRAGMENT_GENERIC);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (!sender || !receiver)
+    {
+        cleanup_ms(sess, sender);
+        cleanup_ms(sess, receiver);
+        cleanup_sess(ctx, sess);
+        return;
+    }
+
+    const int default_payload = sender->get_configuration_value(RCC_MTU_SIZE);
+
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_PATH_MTU_DISCOVERY, 500));
+    EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_MTU_SIZE, 9000));
+    EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_PATH_MTU_DISCOVERY, 9000));
+    EXPECT_EQ(9000, sender->get_configuration_value(RCC_PATH_MTU_DISCOVERY));
+
+    // the loopback MTU is larger than the limit, so a frame of 8000 bytes goes in one packet
+    const size_t size = 8000;
+    std::unique_ptr<uint8_t[]> frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+    EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), size, RTP_NO_FLAGS));
+    EXPECT_EQ(9000 - 40, sender->get_configuration_value(RCC_MTU_SIZE));
+
+    uvgrtp::frame::rtp_frame* received = receiver->pull_frame(1000);
+    EXPECT_NE(nullptr, received);
+    if (received)
+    {
+        EXPECT_EQ(size, received->payload_len);
+        (void)uvgrtp::frame::dealloc_frame(received);
+    }
+
+    // disabling returns to the payload size of RCC_MTU_SIZE
+    EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_PATH_MTU_DISCOVERY, 0));
+    EXPECT_EQ(default_payload, sender->get_configuration_value(RCC_MTU_SIZE));
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_bundle_mid)
+{
+    // Tests binding the SSRCs of streams sharing a socket to them by their MID and RID
+    std::cout << "Starting RTP BUNDLE MID demultiplexing test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sender_sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* receiver_sess = ctx.create_session(REMOTE_ADDRESS);
+
+    const std::vector<std::pair<std::string, std::string>> ids = { { "0", "" }, { "1", "lo" }, { "1", "hi" } };
+    std::vector<uvgrtp::media_stream*> senders;
+    std::vector<uvgrtp::media_stream*> receivers;
+
+    for (auto& id : ids)
+    {
+        uvgrtp::media_stream* sender = sender_sess ?
+            sender_sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS) : nullptr;
+        uvgrtp::media_stream* receiver = receiver_sess ?
+            receiver_sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS) : nullptr;
+
+        EXPECT_NE(nullptr, sender);
+        EXPECT_NE(nullptr, receiver);
+        if (!sender || !receiver)
+            break;
+
+        for (auto stream : { sender, receiver })
+        {
+            EXPECT_EQ(RTP_OK, stream->configure_ctx(RCC_MID_EXT_ID, 1));
+            EXPECT_EQ(RTP_OK, stream->configure_ctx(RCC_RID_EXT_ID, 2));
+            EXPECT_EQ(RTP_OK, stream->set_mid(id.first, id.second));
+        }
+        senders.push_back(sender);
+        receivers.push_back(receiver);
+    }
+
+    if (senders.size() == ids.size())
+    {
+        EXPECT_EQ(1, receivers[0]->get_configuration_value(RCC_MID_EXT_ID));
+        EXPECT_EQ(RTP_INVALID_VALUE, receivers[0]->set_mid(""));
+        EXPECT_EQ(RTP_INVALID_VALUE, receivers[0]->set_mid("1", "lo"));
+        EXPECT_EQ(RTP_INVALID_VALUE, receivers[0]->set_mid("01234567890123456"));
+
+        // each stream gets the frames of its MID and RID, told apart by their sizes
+        for (size_t i = 0; i < senders.size(); ++i)
+        {
+            const size_t size = 100 + 100 * i;
+            std::unique_ptr<uint8_t[]> frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+            EXPECT_EQ(RTP_OK, senders[i]->push_frame(frame.get(), size, RTP_NO_FLAGS));
+
+            uvgrtp::frame::rtp_frame* received = receivers[i]->pull_frame(1000);
+            EXPECT_NE(nullptr, received);
+            if (received)
+            {
+                EXPECT_EQ(size, received->payload_len);
+                (void)uvgrtp::frame::dealloc_frame(received);
+            }
+
+            // the SSRC of the sender has become the remote SSRC of the receiver
+            EXPECT_EQ(senders[i]->get_configuration_value(RCC_SSRC), receivers[i]->get_configuration_value(RCC_REMOTE_SSRC));
+        }
+    }
+
+    for (auto stream : senders)
+        cleanup_ms(sender_sess, stream);
+    for (auto stream : receivers)
+        cleanup_ms(receiver_sess, stream);
+    cleanup_sess(ctx, sender_sess);
+    cleanup_sess(ctx, receiver_sess);
+}
+
+TEST(RTPTests, rtp_gop_cache)
+{
+    // Test that a destination added in the middle of a GOP first gets the frames since the key frame
+    std::cout << "Starting RTP GOP cache test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    const uint16_t send_port = SEND_PORT + 22;
+    const uint16_t receive_port = RECEIVE_PORT + 22;
+    const uint16_t destination_port = RECEIVE_PORT + 24;
+    const uint32_t destination_ssrc = 0x4321;
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+    uvgrtp::media_stream* destination = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(send_port, receive_port, RTP_FORMAT_H265, RCE_SEND_ONLY);
+        receiver = sess->create_stream(receive_port, send_port, RTP_FORMAT_H265, RCE_RECEIVE_ONLY);
+        destination = sess->create_stream(destination_port, send_port, RTP_FORMAT_H265, RCE_RECEIVE_ONLY);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    EXPECT_NE(nullptr, destination);
+
+    if (sender && receiver && destination)
+    {
+        std::mutex mutex;
+        std::vector<uint8_t> nal_types;
+        std::vector<uint16_t> seqs;
+
+        // the start code is followed by the NAL unit header with the NAL unit type
+        EXPECT_EQ(RTP_OK, destination->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&](uvgrtp::frame::rtp_frame* frame) {
+                std::lock_guard<std::mutex> lock(mutex);
+                EXPECT_EQ(destination_ssrc, frame->header.ssrc);
+                nal_types.push_back((frame->payload[4] >> 1) & 0x3f);
+                seqs.push_back(frame->header.seq);
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            })));
+
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_GOP_CACHE_SIZE, -1));
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_GOP_CACHE_SIZE, 100000));
+        EXPECT_EQ(100000, sender->get_configuration_value(RCC_GOP_CACHE_SIZE));
+
+        const uint8_t idr = 19;
+        const uint8_t trail = 1;
+
+        auto send = [&](uint8_t nal_type, size_t size) {
+            std::unique_ptr<uint8_t[]> frame = create_test_packet(RTP_FORMAT_H265, nal_type, true, size, RTP_NO_FLAGS);
+            EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), size, RTP_NO_FLAGS));
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        };
+
+        // the frames before the first key frame are not cached
+        send(trail, 1000);
+        send(idr, 5000);
+        send(trail, 1000);
+        send(trail, 1000);
+
+        EXPECT_EQ(RTP_OK, sender->add_destination(REMOTE_ADDRESS, destination_port, destination_ssrc, nullptr, nullptr));
+
+        send(trail, 1000);
+        send(trail, 1000);
+
+        for (int i = 0; i < 100; ++i) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (nal_types.size() >= 5)
+                    break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        const std::vector<uint8_t> expected = { idr, trail, trail, trail, trail };
+        EXPECT_EQ(expected, nal_types);
+
+        // the cached frames lead into the later frames without gaps in the sequence numbers
+        for (size_t i = 1; i < seqs.size(); ++i) {
+            EXPECT_EQ((uint16_t)(seqs[i - 1] + 1), seqs[i]);
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_ms(sess, destination);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_simulcast)
+{
+    // Test that the frames of the simulcast layers are sent with their own SSRCs from one stream
+    std::cout << "Starting RTP simulcast test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    const uint16_t send_port = SEND_PORT + 26;
+    const uint16_t receive_port = RECEIVE_PORT + 26;
+    const uint32_t low_ssrc = 0x1001;
+    const uint32_t mid_ssrc = 0x1002;
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(send_port, receive_port, RTP_FORMAT_H265, RCE_SEND_ONLY | RCE_PACE_FRAGMENT_SENDING);
+        receiver = sess->create_stream(receive_port, send_port, RTP_FORMAT_H265, RCE_RECEIVE_ONLY);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+
+    if (sender && receiver)
+    {
+        std::mutex mutex;
+        std::map<uint32_t, size_t> frames;
+
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&](uvgrtp::frame::rtp_frame* frame) {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++frames[frame->header.ssrc];
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            })));
+
+        EXPECT_EQ(RTP_OK, sender->add_simulcast_layer("l", low_ssrc));
+        EXPECT_EQ(RTP_OK, sender->add_simulcast_layer("m", mid_ssrc));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->add_simulcast_layer("m"));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->add_simulcast_layer(""));
+
+        const size_t sizes[] = { 20000, 1000, 5000 };
+        const int frame_count = 5;
+
+        for (int i = 0; i < frame_count; ++i) {
+            std::unique_ptr<uint8_t[]> high = create_test_packet(RTP_FORMAT_H265, 1, true, sizes[0], RTP_NO_FLAGS);
+            std::unique_ptr<uint8_t[]> low = create_test_packet(RTP_FORMAT_H265, 1, true, sizes[1], RTP_NO_FLAGS);
+            std::unique_ptr<uint8_t[]> mid = create_test_packet(RTP_FORMAT_H265, 1, true, sizes[2], RTP_NO_FLAGS);
+
+            std::vector<uvgrtp::simulcast_frame> layers = {
+                { high.get(), sizes[0] }, { low.get(), sizes[1] }, { mid.get(), sizes[2] }
+            };
+            EXPECT_EQ(RTP_OK, sender->push_simulcast_frames(layers, RTP_NO_FLAGS));
+
+            // more frames than layers
+            layers.push_back({ high.get(), sizes[0] });
+            EXPECT_EQ(RTP_INVALID_VALUE, sender->push_simulcast_frames(layers, RTP_NO_FLAGS));
+        }
+
+        for (int i = 0; i < 100; ++i) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (frames.size() == 3 && frames[low_ssrc] == frame_count && frames[mid_ssrc] == frame_count)
+                    break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(3u, frames.size());
+        EXPECT_EQ((size_t)frame_count, frames[low_ssrc]);
+        EXPECT_EQ((size_t)frame_count, frames[mid_ssrc]);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_multipath)
+{
+    // Test that the packets of a multipath stream are dealt to the paths by their weights and that
+    // the frames sent over two local addresses are put back together by the receiver
+    std::cout << "Starting RTP multipath test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    const uint16_t send_port = SEND_PORT + 28;
+    const uint16_t receive_port = RECEIVE_PORT + 28;
+    const uint16_t path_port = RECEIVE_PORT + 30;
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+    uvgrtp::media_stream* path_receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(send_port, receive_port, RTP_FORMAT_GENERIC, RCE_SEND_ONLY);
+        receiver = sess->create_stream(receive_port, send_port, RTP_FORMAT_GENERIC, RCE_RECEIVE_ONLY);
+        path_receiver = sess->create_stream(path_port, send_port, RTP_FORMAT_GENERIC, RCE_RECEIVE_ONLY);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    EXPECT_NE(nullptr, path_receiver);
+
+    if (sender && receiver && path_receiver)
+    {
+        std::atomic<size_t> received{0};
+        std::atomic<size_t> path_received{0};
+
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&](uvgrtp::frame::rtp_frame* frame) {
+                ++received;
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            })));
+        EXPECT_EQ(RTP_OK, path_receiver->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&](uvgrtp::frame::rtp_frame* frame) {
+                ++path_received;
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            })));
+
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->add_path("", "", 0, 0));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->add_path("::1"));
+        EXPECT_EQ(RTP_NOT_FOUND, sender->remove_path("127.0.0.1"));
+        EXPECT_EQ(RTP_NOT_SUPPORTED, receiver->add_path("127.0.0.1"));
+
+        // the path gets three packets for each one sent from the socket of the stream
+        EXPECT_EQ(RTP_OK, sender->add_path("127.0.0.1", REMOTE_ADDRESS, path_port, 3));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->add_path("127.0.0.1"));
+
+        const size_t size = 100;
+        const size_t frame_count = 40;
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+        for (size_t i = 0; i < frame_count; ++i) {
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+        }
+
+        for (int i = 0; i < 100 && received + path_received < frame_count; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        EXPECT_EQ(frame_count / 4, received.load());
+        EXPECT_EQ(frame_count * 3 / 4, path_received.load());
+
+        EXPECT_EQ(RTP_OK, sender->remove_path("127.0.0.1"));
+    }
+
+    cleanup_ms(sess, path_receiver);
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+
+    // a fragmented stream sent over two local addresses to one receiver
+    const uint16_t bonded_send_port = SEND_PORT + 32;
+    const uint16_t bonded_receive_port = RECEIVE_PORT + 32;
+
+    sender = nullptr;
+    receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(bonded_send_port, bonded_receive_port, RTP_FORMAT_H265, RCE_SEND_ONLY);
+        receiver = sess->create_stream(bonded_receive_port, bonded_send_port, RTP_FORMAT_H265, RCE_RECEIVE_ONLY);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+
+    if (sender && receiver)
+    {
+        const size_t size = 20000;
+        const int frame_count = 10;
+        std::atomic<int> received{0};
+
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_REORDER_WINDOW_MS, 60));
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&](uvgrtp::frame::rtp_frame* frame) {
+                // the start code of the test frame is given back in front of the NAL unit
+                if (frame->payload_len == size)
+                    ++received;
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            })));
+
+        EXPECT_EQ(RTP_OK, sender->add_path("127.0.0.2"));
+
+        for (int i = 0; i < frame_count; ++i) {
+            std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_H265, 1, true, size, RTP_NO_FLAGS);
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        for (int i = 0; i < 100 && received < frame_count; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_EQ(frame_count, received.load());
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(RTPTests, rtp_receive_paths)
+{
+    // Test that the copies of a stream that arrive over two sockets are merged into one
+    std::cout << "Starting RTP receive path test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    const uint16_t send_port = SEND_PORT + 36;
+    const uint16_t receive_port = RECEIVE_PORT + 36;
+    const uint16_t path_port = RECEIVE_PORT + 38;
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(send_port, receive_port, RTP_FORMAT_GENERIC, RCE_SEND_ONLY);
+        receiver = sess->create_stream(receive_port, send_port, RTP_FORMAT_GENERIC, RCE_RECEIVE_ONLY);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+
+    if (sender && receiver)
+    {
+        std::atomic<size_t> received{0};
+
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&](uvgrtp::frame::rtp_frame* frame) {
+                ++received;
+                (void)uvgrtp::frame::dealloc_frame(frame);
+            })));
+
+        EXPECT_EQ(RTP_NOT_SUPPORTED, sender->add_receive_path("127.0.0.1", path_port));
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->add_receive_path("::1", path_port));
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_REDUNDANCY_WINDOW, 10));
+        EXPECT_EQ(RTP_NOT_FOUND, receiver->remove_receive_path("127.0.0.1", path_port));
+
+        // the second network is emulated by sending a copy of each packet to the port of the path
+        EXPECT_EQ(RTP_OK, receiver->add_receive_path("127.0.0.1", path_port));
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->add_receive_path("127.0.0.1", path_port));
+        EXPECT_EQ(4096, receiver->get_configuration_value(RCC_REDUNDANCY_WINDOW));
+        EXPECT_EQ(RTP_OK, sender->add_destination(REMOTE_ADDRESS, path_port));
+
+        const size_t size = 100;
+        const size_t frame_count = 100;
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+        for (size_t i = 0; i < frame_count; ++i) {
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+        }
+
+        uvgrtp::stream_stats stats;
+        for (int i = 0; i < 100; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+            stats = receiver->get_stats();
+            if (received >= frame_count && stats.merged_packets >= frame_count)
+                break;
+        }
+
+        // each frame is given to the application once and each second copy is dropped
+        EXPECT_EQ(frame_count, received.load());
+        EXPECT_EQ(frame_count, stats.merged_packets);
+        EXPECT_EQ(2 * frame_count, stats.received_packets);
+
+        EXPECT_EQ(RTP_OK, receiver->remove_receive_path("127.0.0.1", path_port));
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+#ifdef __linux__
+// set in the environment of the process that rtp_shared_memory_transport starts as its peer
+constexpr char SHARED_MEMORY_PEER[] = "UVGRTP_SHARED_MEMORY_PEER";
+#endif
+
+TEST(RTPTests, rtp_shared_memory_transport)
+{
+    // Test that a stream of another process with the shared memory transport sends its frames through shared memory
+    std::cout << "Starting RTP shared memory transport test" << std::endl;
+
+#ifdef __linux__
+    const uint16_t send_port = SEND_PORT + 40;
+    const uint16_t receive_port = RECEIVE_PORT + 40;
+    const std::string segment = "/dev/shm/uvgrtp-4-7f000001-" + std::to_string(receive_port);
+
+    const int test_frames = 100;
+    const size_t size = 1000;
+
+    // a segment left by a crashed run would let the sender start before the receiver
+    (void)unlink(segment.c_str());
+
+    /* The sender is this test executable running only rtp_shared_memory_sender. It is started with
+     * exec, because the threads of the earlier tests do not exist in a forked child */
+    std::string filter = "--gtest_filter=RTPTests.rtp_shared_memory_sender";
+    std::string peer = std::string(SHARED_MEMORY_PEER) + "=1";
+    std::vector<char *> argv = { (char *)"uvgrtp_test", &filter[0], nullptr };
+    std::vector<char *> envp;
+
+    for (char **env = environ; *env; ++env) {
+        envp.push_back(*env);
+    }
+    envp.push_back(&peer[0]);
+    envp.push_back(nullptr);
+
+    pid_t pid = fork();
+    ASSERT_NE(-1, pid);
+
+    if (pid == 0) {
+        execve("/proc/self/exe", argv.data(), envp.data());
+        _exit(127);
+    }
+
+    uvgrtp::context ctx;
+    EXPECT_EQ(RTP_OK, ctx.set_transport(RTP_TRANSPORT_SHARED_MEMORY));
+
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+        receiver = sess->create_stream(receive_port, send_port, RTP_FORMAT_GENERIC, RCE_RECEIVE_ONLY);
+
+    EXPECT_NE(nullptr, receiver);
+    EXPECT_EQ(0, access(segment.c_str(), F_OK));
+
+    std::atomic<int> received(0);
+    if (receiver)
+    {
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&](uvgrtp::frame::rtp_frame* frame) {
+                EXPECT_EQ(size, frame->payload_len);
+                (void)uvgrtp::frame::dealloc_frame(frame);
+                ++received;
+            })));
+    }
+
+    int status = -1;
+    EXPECT_EQ(pid, waitpid(pid, &status, 0));
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+
+    for (int i = 0; i < 100 && received < test_frames; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(test_frames, received);
+
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+
+    // the segment is removed with the socket
+    EXPECT_NE(0, access(segment.c_str(), F_OK));
+#endif
+}
+
+TEST(RTPTests, rtp_shared_memory_sender)
+{
+    // The sending process of rtp_shared_memory_transport, does nothing when run on its own
+#ifdef __linux__
+    if (!getenv(SHARED_MEMORY_PEER))
+        return;
+
+    const uint16_t send_port = SEND_PORT + 40;
+    const uint16_t receive_port = RECEIVE_PORT + 40;
+    const std::string segment = "/dev/shm/uvgrtp-4-7f000001-" + std::to_string(receive_port);
+
+    const int test_frames = 100;
+    const size_t size = 1000;
+
+    for (int i = 0; i < 200 && access(segment.c_str(), F_OK) != 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(0, access(segment.c_str(), F_OK));
+
+    uvgrtp::context ctx;
+    EXPECT_EQ(RTP_OK, ctx.set_transport(RTP_TRANSPORT_SHARED_MEMORY));
+
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::media_stream* sender = nullptr;
+
+    if (sess)
+        sender = sess->create_stream(send_port, receive_port, RTP_FORMAT_GENERIC, RCE_SEND_ONLY);
+
+    EXPECT_NE(nullptr, sender);
+    if (sender)
+    {
+        // the datagrams given to the kernel would get a send timestamp
+        bool timestamps = sender->configure_ctx(RCC_TIMESTAMPING, RTP_TIMESTAMP_SEND) == RTP_OK;
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), size, RTP_NO_FLAGS));
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        if (timestamps)
+            EXPECT_EQ(0u, sender->get_stats().send_delay_us.count);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_sess(ctx, sess);
+#endif
+}
+
 /* User packets disabled for now
 TEST(RTPTests, uvgrtp_user_frames)
 {
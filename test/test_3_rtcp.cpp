@@ -16,6 +16,10 @@ void receiver_hook(uvgrtp::frame::rtcp_receiver_report* frame);
 void sender_hook(uvgrtp::frame::rtcp_sender_report* frame);
 void sdes_hook(uvgrtp::frame::rtcp_sdes_packet* frame);
 void app_hook(uvgrtp::frame::rtcp_app_packet* frame);
+void bitrate_hook(void* arg, uint32_t bitrate);
+void twcc_frame_hook(void* arg, uvgrtp::frame::rtp_frame* frame);
+void key_frame_request_hook(void* arg);
+void jitter_buffer_frame_hook(void* arg, uvgrtp::frame::rtp_frame* frame);
 void cleanup(uvgrtp::context& ctx, uvgrtp::session* local_session, uvgrtp::session* remote_session,
     uvgrtp::media_stream* send, uvgrtp::media_stream* receive);
 
@@ -134,6 +138,493 @@ TEST(RTCPTests, rtcp_app) {
     EXPECT_TRUE(received1 > 0);
 }
 
+TEST(RTCPTests, rtcp_cname) {
+    std::cout << "Starting uvgRTP RTCP CNAME test" << std::endl;
+
+    uvgrtp::context ctx;
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.set_cname(""));
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.set_cname(std::string(256, 'a')));
+    EXPECT_EQ(RTP_OK, ctx.set_cname("sender@uvgrtp"));
+
+    uvgrtp::session* local_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* remote_session = ctx.create_session(LOCAL_INTERFACE);
+
+    int flags = RCE_RTCP;
+
+    uvgrtp::media_stream* local_stream = nullptr;
+    if (local_session)
+    {
+        local_stream = local_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    uvgrtp::media_stream* remote_stream = nullptr;
+    if (remote_session)
+    {
+        remote_stream = remote_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    EXPECT_NE(nullptr, remote_stream);
+
+    std::mutex cname_mutex;
+    std::set<std::string> cnames;
+
+    if (remote_stream)
+    {
+        EXPECT_EQ(RTP_OK, remote_stream->get_rtcp()->install_sdes_hook(
+            [&](std::unique_ptr<uvgrtp::frame::rtcp_sdes_packet> frame) {
+                std::lock_guard<std::mutex> lock(cname_mutex);
+
+                for (auto& chunk : frame->chunks)
+                {
+                    for (auto& item : chunk.items)
+                    {
+                        if (item.type == 1)
+                            cnames.insert(std::string((char*)item.data, item.length));
+
+                        delete[] item.data;
+                    }
+                }
+            }));
+    }
+
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[PAYLOAD_LEN]);
+    memset(test_frame.get(), 'b', PAYLOAD_LEN);
+    send_packets(std::move(test_frame), PAYLOAD_LEN, local_session, local_stream, SEND_TEST_PACKETS, PACKET_INTERVAL_MS, true, RTP_NO_FLAGS);
+
+    cleanup(ctx, local_session, remote_session, local_stream, remote_stream);
+
+    std::lock_guard<std::mutex> lock(cname_mutex);
+    EXPECT_EQ(1u, cnames.size());
+    EXPECT_EQ(1u, cnames.count("sender@uvgrtp"));
+}
+
+TEST(RTCPTests, rtcp_view_hooks) {
+    // Test that the view hooks are given the SDES items and APP payloads in the received packets
+    std::cout << "Starting uvgRTP RTCP view hook tests" << std::endl;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* local_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* remote_session = ctx.create_session(LOCAL_INTERFACE);
+
+    int flags = RCE_RTCP;
+
+    uvgrtp::media_stream* local_stream = nullptr;
+    if (local_session)
+    {
+        local_stream = local_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_GENERIC, flags);
+        local_stream->configure_ctx(RCC_SESSION_BANDWIDTH, 3000);
+    }
+
+    uvgrtp::media_stream* remote_stream = nullptr;
+    if (remote_session)
+    {
+        remote_stream = remote_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+        remote_stream->configure_ctx(RCC_SESSION_BANDWIDTH, 3000);
+    }
+
+    EXPECT_NE(nullptr, remote_stream);
+
+    std::atomic<int> sdes_received(0);
+    std::atomic<int> app_received(0);
+
+    if (remote_stream)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, remote_stream->get_rtcp()->install_sdes_view_hook(nullptr));
+        EXPECT_EQ(RTP_OK, remote_stream->get_rtcp()->install_sdes_view_hook(
+            [&sdes_received](const uvgrtp::frame::rtcp_sdes_packet& frame) {
+                bool cname = false; // item type 1 is CNAME
+                for (auto& chunk : frame.chunks)
+                {
+                    for (auto& item : chunk.items)
+                    {
+                        if (item.type == 1 && item.length > 0 && item.data)
+                            cname = true;
+                    }
+                }
+                EXPECT_TRUE(cname);
+                ++sdes_received;
+            }));
+        EXPECT_EQ(RTP_OK, remote_stream->get_rtcp()->install_app_view_hook(
+            [&app_received](const uvgrtp::frame::rtcp_app_packet& frame) {
+                EXPECT_EQ("Test", std::string((const char*)frame.name, 4));
+                EXPECT_EQ("ABCD", std::string((const char*)frame.payload, frame.payload_len));
+                ++app_received;
+            }));
+    }
+
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[PAYLOAD_LEN]);
+    memset(test_frame.get(), 'b', PAYLOAD_LEN);
+    send_packets(std::move(test_frame), PAYLOAD_LEN, local_session, local_stream, SEND_TEST_PACKETS, PACKET_INTERVAL_MS, true, RTP_NO_FLAGS, true);
+
+    cleanup(ctx, local_session, remote_session, local_stream, remote_stream);
+
+    std::cout << "Received SDES packets: " << sdes_received << ", APP packets: " << app_received << std::endl;
+    EXPECT_TRUE(sdes_received > 0);
+    EXPECT_TRUE(app_received > 0);
+}
+
+TEST(RTCPTests, rtcp_xr) {
+    // Test that the receiver reports the XR blocks of the received stream and measures the
+    // round-trip time from the DLRR that the sender answers its RRT with
+    std::cout << "Starting uvgRTP RTCP XR test" << std::endl;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* local_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* remote_session = ctx.create_session(LOCAL_INTERFACE);
+
+    int flags = RCE_RTCP;
+
+    uvgrtp::media_stream* local_stream = nullptr;
+    if (local_session)
+    {
+        local_stream = local_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_GENERIC, flags);
+        local_stream->configure_ctx(RCC_SESSION_BANDWIDTH, 3000);
+    }
+
+    uvgrtp::media_stream* remote_stream = nullptr;
+    if (remote_session)
+    {
+        remote_stream = remote_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+        remote_stream->configure_ctx(RCC_SESSION_BANDWIDTH, 3000);
+    }
+
+    EXPECT_NE(nullptr, local_stream);
+    EXPECT_NE(nullptr, remote_stream);
+
+    std::atomic<int> xr_received(0);
+
+    if (local_stream && remote_stream)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, remote_stream->configure_ctx(RCC_RTCP_XR, RTP_RTCP_XR_ALL + 1));
+        EXPECT_EQ(RTP_OK, remote_stream->configure_ctx(RCC_RTCP_XR, RTP_RTCP_XR_LOSS_RLE |
+            RTP_RTCP_XR_STAT_SUMMARY | RTP_RTCP_XR_VOIP_METRICS | RTP_RTCP_XR_RRT));
+        EXPECT_EQ(RTP_RTCP_XR_ALL, remote_stream->get_configuration_value(RCC_RTCP_XR));
+
+        EXPECT_EQ(RTP_INVALID_VALUE, local_stream->get_rtcp()->install_xr_hook(nullptr));
+        EXPECT_EQ(RTP_OK, local_stream->get_rtcp()->install_xr_hook(
+            [&xr_received](const uvgrtp::frame::rtcp_xr_packet& frame) {
+                EXPECT_TRUE(frame.has_rrt);
+
+                // the blocks of the stream are only sent in the reports after packets have been received
+                if (frame.stat_summary.empty())
+                    return;
+
+                EXPECT_EQ(1u, frame.loss_rle.size());
+                EXPECT_EQ(1u, frame.voip_metrics.size());
+                EXPECT_FALSE(frame.loss_rle[0].chunks.empty());
+                EXPECT_EQ(0u, frame.stat_summary[0].lost_packets);
+                EXPECT_EQ(0, frame.voip_metrics[0].loss_rate);
+                EXPECT_EQ(16, frame.voip_metrics[0].gmin);
+                ++xr_received;
+            }));
+    }
+
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[PAYLOAD_LEN]);
+    memset(test_frame.get(), 'b', PAYLOAD_LEN);
+    send_packets(std::move(test_frame), PAYLOAD_LEN, local_session, local_stream, SEND_TEST_PACKETS, PACKET_INTERVAL_MS, true, RTP_NO_FLAGS);
+
+    double rtt_ms = remote_stream ? remote_stream->get_rtcp()->get_round_trip_time_ms() : -1;
+
+    cleanup(ctx, local_session, remote_session, local_stream, remote_stream);
+
+    std::cout << "Received XR packets: " << xr_received << ", round-trip time " << rtt_ms << " ms" << std::endl;
+    EXPECT_TRUE(xr_received > 0);
+    EXPECT_TRUE(rtt_ms >= 0);
+}
+
+TEST(RTCPTests, rtcp_twcc) {
+    std::cout << "Starting uvgRTP TWCC test" << std::endl;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* local_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* remote_session = ctx.create_session(LOCAL_INTERFACE);
+
+    int flags = RCE_RTCP;
+
+    // received1 is bitrate updates, received2 intact frames
+    received1 = 0;
+    received2 = 0;
+
+    uvgrtp::media_stream* local_stream = nullptr;
+    if (local_session)
+    {
+        local_stream = local_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    uvgrtp::media_stream* remote_stream = nullptr;
+    if (remote_session)
+    {
+        remote_stream = remote_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    EXPECT_NE(nullptr, remote_stream);
+
+    if (local_stream)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, local_stream->configure_ctx(RCC_TWCC_EXT_ID, 256));
+        EXPECT_EQ(RTP_OK, local_stream->configure_ctx(RCC_TWCC_EXT_ID, 5));
+        EXPECT_EQ(5, local_stream->get_configuration_value(RCC_TWCC_EXT_ID));
+        EXPECT_EQ(RTP_OK, local_stream->install_bitrate_hook(nullptr, bitrate_hook));
+    }
+
+    if (remote_stream)
+    {
+        EXPECT_EQ(RTP_OK, remote_stream->configure_ctx(RCC_TWCC_EXT_ID, 5));
+        EXPECT_EQ(RTP_OK, remote_stream->install_receive_hook(nullptr, twcc_frame_hook));
+    }
+
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[PAYLOAD_LEN]);
+    memset(test_frame.get(), 'b', PAYLOAD_LEN);
+    send_packets(std::move(test_frame), PAYLOAD_LEN, local_session, local_stream, FRAME_RATE, PACKET_INTERVAL_MS, false, RTP_NO_FLAGS);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    cleanup(ctx, local_session, remote_session, local_stream, remote_stream);
+    std::cout << "Bitrate updates: " << received1 << ", received frames: " << received2 << std::endl;
+    EXPECT_TRUE(received1 > 0);
+
+    // RTCP keeps a packet of a new source back while the source is on probation
+    EXPECT_TRUE(received2 >= FRAME_RATE - 1);
+}
+
+TEST(RTCPTests, rtcp_nack) {
+    std::cout << "Starting uvgRTP NACK test" << std::endl;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* local_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* remote_session = ctx.create_session(LOCAL_INTERFACE);
+
+    uvgrtp::media_stream* local_stream = nullptr;
+    uvgrtp::media_stream* no_rtcp_stream = nullptr;
+    if (local_session)
+    {
+        local_stream = local_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_H265, RCE_RTCP);
+        no_rtcp_stream = local_session->create_stream(LOCAL_PORT + 2, REMOTE_PORT + 2, RTP_FORMAT_H265, RCE_NO_FLAGS);
+    }
+
+    uvgrtp::media_stream* remote_stream = nullptr;
+    if (remote_session)
+    {
+        remote_stream = remote_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_H265, RCE_RTCP);
+    }
+
+    EXPECT_NE(nullptr, local_stream);
+    EXPECT_NE(nullptr, remote_stream);
+
+    if (no_rtcp_stream)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, no_rtcp_stream->configure_ctx(RCC_NACK, 1));
+        local_session->destroy_stream(no_rtcp_stream);
+    }
+
+    if (local_stream)
+    {
+        EXPECT_EQ(1024, local_stream->get_configuration_value(RCC_NACK_HISTORY_SIZE));
+        EXPECT_EQ(RTP_INVALID_VALUE, local_stream->configure_ctx(RCC_NACK, 2));
+        EXPECT_EQ(RTP_INVALID_VALUE, local_stream->configure_ctx(RCC_NACK_HISTORY_SIZE, 0));
+        EXPECT_EQ(RTP_OK, local_stream->configure_ctx(RCC_NACK_HISTORY_SIZE, 256));
+        EXPECT_EQ(RTP_OK, local_stream->configure_ctx(RCC_NACK, 1));
+        EXPECT_EQ(1, local_stream->get_configuration_value(RCC_NACK));
+        EXPECT_EQ(256, local_stream->get_configuration_value(RCC_NACK_HISTORY_SIZE));
+    }
+
+    if (remote_stream)
+    {
+        EXPECT_EQ(RTP_OK, remote_stream->configure_ctx(RCC_NACK, 1));
+    }
+
+    // without losses, the streams work as before
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[PAYLOAD_LEN]);
+    memset(test_frame.get(), 'b', PAYLOAD_LEN);
+    send_packets(std::move(test_frame), PAYLOAD_LEN, local_session, local_stream, FRAME_RATE, PACKET_INTERVAL_MS, false, RTP_NO_H26X_SCL);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    cleanup(ctx, local_session, remote_session, local_stream, remote_stream);
+}
+
+TEST(RTCPTests, rtcp_jitter_buffer) {
+    std::cout << "Starting uvgRTP jitter buffer test" << std::endl;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* local_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* remote_session = ctx.create_session(LOCAL_INTERFACE);
+
+    // received1 is released frames, received2 frames released out of order
+    received1 = 0;
+    received2 = 0;
+    uint32_t last_seq = 0;
+
+    uvgrtp::media_stream* local_stream = nullptr;
+    if (local_session)
+    {
+        local_stream = local_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_GENERIC, RCE_RTCP);
+    }
+
+    uvgrtp::media_stream* remote_stream = nullptr;
+    if (remote_session)
+    {
+        remote_stream = remote_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, RCE_RTCP);
+    }
+
+    EXPECT_NE(nullptr, local_stream);
+    EXPECT_NE(nullptr, remote_stream);
+
+    if (remote_stream)
+    {
+        EXPECT_EQ(0, remote_stream->get_configuration_value(RCC_JITTER_BUFFER));
+        EXPECT_EQ(10, remote_stream->get_configuration_value(RCC_JITTER_BUFFER_MIN_DELAY));
+        EXPECT_EQ(RTP_INVALID_VALUE, remote_stream->configure_ctx(RCC_JITTER_BUFFER, -1));
+        EXPECT_EQ(RTP_OK, remote_stream->configure_ctx(RCC_JITTER_BUFFER_MIN_DELAY, 20));
+        EXPECT_EQ(RTP_OK, remote_stream->configure_ctx(RCC_JITTER_BUFFER, 200));
+        EXPECT_EQ(200, remote_stream->get_configuration_value(RCC_JITTER_BUFFER));
+        EXPECT_EQ(20, remote_stream->get_configuration_value(RCC_JITTER_BUFFER_MIN_DELAY));
+        EXPECT_EQ(RTP_OK, remote_stream->install_receive_hook(&last_seq, jitter_buffer_frame_hook));
+    }
+
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[PAYLOAD_LEN]);
+    memset(test_frame.get(), 'b', PAYLOAD_LEN);
+    send_packets(std::move(test_frame), PAYLOAD_LEN, local_session, local_stream, FRAME_RATE, PACKET_INTERVAL_MS, false, RTP_NO_FLAGS);
+
+    // the last frames are still in the buffer until their playout time
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    cleanup(ctx, local_session, remote_session, local_stream, remote_stream);
+    std::cout << "Released frames: " << received1 << ", out of order: " << received2 << std::endl;
+
+    // RTCP keeps a packet of a new source back while the source is on probation
+    EXPECT_TRUE(received1 >= FRAME_RATE - 1);
+    EXPECT_EQ(0, received2);
+}
+
+TEST(RTCPTests, rtcp_key_frame_request) {
+    std::cout << "Starting uvgRTP key frame request test" << std::endl;
+
+    uvgrtp::context ctx;
+    uvgrtp::session* local_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* remote_session = ctx.create_session(LOCAL_INTERFACE);
+
+    // received1 is key frame requests
+    received1 = 0;
+
+    uvgrtp::media_stream* local_stream = nullptr;
+    if (local_session)
+    {
+        local_stream = local_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_H265, RCE_RTCP);
+    }
+
+    // the receiver drops the inter frames because it has not seen a key frame
+    uvgrtp::media_stream* remote_stream = nullptr;
+    if (remote_session)
+    {
+        remote_stream = remote_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_H265,
+            RCE_RTCP | RCE_H26X_DEPENDENCY_ENFORCEMENT);
+    }
+
+    EXPECT_NE(nullptr, local_stream);
+    EXPECT_NE(nullptr, remote_stream);
+
+    if (local_stream)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, local_stream->install_key_frame_request_hook(nullptr, nullptr));
+        EXPECT_EQ(RTP_OK, local_stream->install_key_frame_request_hook(nullptr, key_frame_request_hook));
+    }
+
+    if (remote_stream)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, remote_stream->configure_ctx(RCC_KEY_FRAME_REQUEST, 3));
+        EXPECT_EQ(RTP_OK, remote_stream->configure_ctx(RCC_KEY_FRAME_REQUEST, 1));
+        EXPECT_EQ(RTP_OK, remote_stream->configure_ctx(RCC_KEY_FRAME_REQUEST_INTERVAL, 400));
+        EXPECT_EQ(1, remote_stream->get_configuration_value(RCC_KEY_FRAME_REQUEST));
+        EXPECT_EQ(400, remote_stream->get_configuration_value(RCC_KEY_FRAME_REQUEST_INTERVAL));
+    }
+
+    // fragmented TRAIL_R pictures
+    const size_t frame_size = 5000;
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
+    memset(test_frame.get(), 'b', frame_size);
+    test_frame[0] = 1 << 1;
+    test_frame[1] = 1;
+    send_packets(std::move(test_frame), frame_size, local_session, local_stream, FRAME_RATE, PACKET_INTERVAL_MS, false, RTP_NO_H26X_SCL);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    cleanup(ctx, local_session, remote_session, local_stream, remote_stream);
+    std::cout << "Key frame requests: " << received1 << std::endl;
+
+    // every frame is dropped, but the requests of the second of frames are throttled to one in 400 ms
+    EXPECT_TRUE(received1 >= 1);
+    EXPECT_TRUE(received1 <= 4);
+}
+
+TEST(RTCPTests, rtcp_early_feedback) {
+    // Test that the key frame requests follow the early feedback rules of RFC 4585
+    std::cout << "Starting uvgRTP early feedback test" << std::endl;
+
+    for (int mode : { RTP_RTCP_FEEDBACK_EARLY, RTP_RTCP_FEEDBACK_EARLY_REDUCED_SIZE })
+    {
+        uvgrtp::context ctx;
+        uvgrtp::session* local_session = ctx.create_session(REMOTE_ADDRESS);
+        uvgrtp::session* remote_session = ctx.create_session(LOCAL_INTERFACE);
+
+        // received1 is key frame requests
+        received1 = 0;
+
+        uvgrtp::media_stream* local_stream = nullptr;
+        if (local_session)
+        {
+            local_stream = local_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_H265, RCE_RTCP);
+            local_stream->configure_ctx(RCC_SESSION_BANDWIDTH, 10);
+        }
+
+        uvgrtp::media_stream* remote_stream = nullptr;
+        if (remote_session)
+        {
+            remote_stream = remote_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_H265,
+                RCE_RTCP | RCE_H26X_DEPENDENCY_ENFORCEMENT);
+            remote_stream->configure_ctx(RCC_SESSION_BANDWIDTH, 10);
+        }
+
+        EXPECT_NE(nullptr, local_stream);
+        EXPECT_NE(nullptr, remote_stream);
+
+        if (local_stream)
+        {
+            EXPECT_EQ(RTP_OK, local_stream->install_key_frame_request_hook(nullptr, key_frame_request_hook));
+        }
+
+        if (remote_stream)
+        {
+            EXPECT_EQ(RTP_RTCP_FEEDBACK_IMMEDIATE, remote_stream->get_configuration_value(RCC_RTCP_FEEDBACK));
+            EXPECT_EQ(RTP_INVALID_VALUE, remote_stream->configure_ctx(RCC_RTCP_FEEDBACK, RTP_RTCP_FEEDBACK_LAST));
+            EXPECT_EQ(RTP_OK, remote_stream->configure_ctx(RCC_RTCP_FEEDBACK, mode));
+            EXPECT_EQ(mode, remote_stream->get_configuration_value(RCC_RTCP_FEEDBACK));
+
+            // every dropped frame asks for a key frame
+            EXPECT_EQ(RTP_OK, remote_stream->configure_ctx(RCC_KEY_FRAME_REQUEST, 1));
+            EXPECT_EQ(RTP_OK, remote_stream->configure_ctx(RCC_KEY_FRAME_REQUEST_INTERVAL, 0));
+        }
+
+        // fragmented TRAIL_R pictures
+        const size_t frame_size = 5000;
+        std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
+        memset(test_frame.get(), 'b', frame_size);
+        test_frame[0] = 1 << 1;
+        test_frame[1] = 1;
+        send_packets(std::move(test_frame), frame_size, local_session, local_stream, FRAME_RATE, PACKET_INTERVAL_MS, false, RTP_NO_H26X_SCL);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        cleanup(ctx, local_session, remote_session, local_stream, remote_stream);
+        std::cout << "Key frame requests: " << received1 << std::endl;
+
+        /* The first request goes in an early packet and the repeated ones wait for the regular
+         * reports, which send the same request once */
+        EXPECT_TRUE(received1 >= 1);
+        EXPECT_TRUE(received1 <= 4);
+    }
+}
+
 TEST(RTCP_reopen_receiver, rtcp) {
     std::cout << "Starting uvgRTP RTCP reopen receiver test" << std::endl;
 
@@ -367,6 +858,77 @@ TEST(RTCPTests, rtcp_multiplex2)
 
 }
 
+TEST(RTCPTests, rtcp_multiplex_io_engine)
+{
+    // Test that the RTCP socket shared by two streams is read by the I/O engine of the context
+    std::cout << "Starting RTCP socket multiplexing test with the I/O engine" << std::endl;
+    uvgrtp::context ctx;
+    EXPECT_EQ(RTP_OK, ctx.start_io_engine(1));
+
+    uvgrtp::session* receiver_sess = ctx.create_session(LOCAL_INTERFACE, REMOTE_ADDRESS);
+    uvgrtp::session* sender_sess = ctx.create_session(REMOTE_ADDRESS, LOCAL_INTERFACE);
+
+    uvgrtp::media_stream* sender1 = nullptr;
+    uvgrtp::media_stream* receiver1 = nullptr;
+    uvgrtp::media_stream* sender2 = nullptr;
+    uvgrtp::media_stream* receiver2 = nullptr;
+
+    received1 = 0;
+    received2 = 0;
+    received3 = 0;
+    received4 = 0;
+
+    int flags = RCE_FRAGMENT_GENERIC | RCE_RTCP;
+    if (sender_sess)
+    {
+        sender1 = sender_sess->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_GENERIC, flags);
+        sender1->configure_ctx(RCC_SSRC, 11);
+        sender1->configure_ctx(RCC_REMOTE_SSRC, 22);
+        sender2 = sender_sess->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_GENERIC, flags);
+        sender2->configure_ctx(RCC_SSRC, 33);
+        sender2->configure_ctx(RCC_REMOTE_SSRC, 44);
+    }
+    if (sender1 && sender2)
+    {
+        EXPECT_EQ(RTP_OK, sender1->get_rtcp()->install_receiver_hook(m_r_hook1));
+        EXPECT_EQ(RTP_OK, sender2->get_rtcp()->install_receiver_hook(m_r_hook2));
+    }
+    if (receiver_sess)
+    {
+        receiver1 = receiver_sess->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver1->configure_ctx(RCC_SSRC, 22);
+        receiver1->configure_ctx(RCC_REMOTE_SSRC, 11);
+        receiver2 = receiver_sess->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_GENERIC, flags);
+        receiver2->configure_ctx(RCC_SSRC, 44);
+        receiver2->configure_ctx(RCC_REMOTE_SSRC, 33);
+    }
+    if (receiver1 && receiver2)
+    {
+        EXPECT_EQ(RTP_OK, receiver1->get_rtcp()->install_sender_hook(m_s_hook1));
+        EXPECT_EQ(RTP_OK, receiver2->get_rtcp()->install_sender_hook(m_s_hook2));
+    }
+
+    std::vector<size_t> sizes = { 1000, 2000 };
+    for (size_t& size : sizes)
+    {
+        std::unique_ptr<uint8_t[]> test_frame1 = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        std::unique_ptr<uint8_t[]> test_frame2 = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        send_packets(std::move(test_frame1), PAYLOAD_LEN, sender_sess, sender1, SEND_TEST_PACKETS, PACKET_INTERVAL_MS, true, RTP_NO_FLAGS);
+        send_packets(std::move(test_frame2), PAYLOAD_LEN, sender_sess, sender2, SEND_TEST_PACKETS, PACKET_INTERVAL_MS, true, RTP_NO_FLAGS);
+    }
+
+    ASSERT_TRUE(received1 > 0);
+    ASSERT_TRUE(received2 > 0);
+    ASSERT_TRUE(received3 > 0);
+    ASSERT_TRUE(received4 > 0);
+    cleanup_ms(sender_sess, sender1);
+    cleanup_ms(sender_sess, sender2);
+    cleanup_ms(receiver_sess, receiver1);
+    cleanup_ms(receiver_sess, receiver2);
+    cleanup_sess(ctx, sender_sess);
+    cleanup_sess(ctx, receiver_sess);
+}
+
 void m_r_hook1(uvgrtp::frame::rtcp_receiver_report* frame)
 {
     //Hook for stream Sender1 ssrc 11 
@@ -491,6 +1053,46 @@ void app_hook(uvgrtp::frame::rtcp_app_packet* frame)
     delete frame;
 }
 
+void bitrate_hook(void* arg, uint32_t bitrate)
+{
+    (void)arg;
+    ++received1;
+    std::cout << "Target bitrate: " << bitrate << std::endl;
+}
+
+void twcc_frame_hook(void* arg, uvgrtp::frame::rtp_frame* frame)
+{
+    (void)arg;
+
+    // the header extension must not be left in the payload
+    if (frame->header.ext && frame->payload_len == PAYLOAD_LEN && frame->payload[0] == 'b' &&
+        frame->payload[PAYLOAD_LEN - 1] == 'b')
+    {
+        ++received2;
+    }
+    (void)uvgrtp::frame::dealloc_frame(frame);
+}
+
+void key_frame_request_hook(void* arg)
+{
+    (void)arg;
+    ++received1;
+}
+
+void jitter_buffer_frame_hook(void* arg, uvgrtp::frame::rtp_frame* frame)
+{
+    uint32_t* last_seq = (uint32_t*)arg;
+
+    // the frames must come out in order
+    if (received1 > 0 && (int16_t)(frame->header.seq - (uint16_t)*last_seq) <= 0) {
+        ++received2;
+    }
+    *last_seq = frame->header.seq;
+    ++received1;
+
+    (void)uvgrtp::frame::dealloc_frame(frame);
+}
+
 void cleanup(uvgrtp::context& ctx, uvgrtp::session* local_session, uvgrtp::session* remote_session,
     uvgrtp::media_stream* send, uvgrtp::media_stream* receive)
 {
@@ -500,4 +1102,4 @@ void cleanup(uvgrtp::context& ctx, uvgrtp::session* local_session, uvgrtp::sessi
     }
     cleanup_sess(ctx, local_session);
     cleanup_sess(ctx, remote_session);
-}
\ No newline at end of file
+}
@@ -225,6 +225,389 @@ TEST(FormatTests, h265_fragmentation)
     cleanup_sess(ctx, sess);
 }
 
+TEST(FormatTests, h265_flat_reassembly)
+{
+    // Tests reassembling fragmented frames by copying the fragments directly to the output buffer
+    std::cout << "Starting h265 flat reassembly test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_H26X_FLAT_REASSEMBLY);
+    }
+
+    if (sender && receiver)
+    {
+        // check that the fragments end up in the right places
+        const size_t frame_size = 100000;
+        std::unique_ptr<uint8_t[]> frame(new uint8_t[frame_size]);
+        for (size_t i = 0; i < frame_size; ++i)
+        {
+            frame[i] = (uint8_t)(i % 251 + 1);
+        }
+        frame[0] = 19 << 1; // IDR_W_RADL
+        frame[1] = 1;
+
+        std::vector<uvgrtp::frame::nal_unit> nal_units = { { 0, frame_size } };
+        EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), frame_size, nal_units, RTP_NO_FLAGS));
+
+        uvgrtp::frame::rtp_frame* received = receiver->pull_frame(1000);
+        EXPECT_NE(nullptr, received);
+        if (received)
+        {
+            EXPECT_EQ(frame_size + 4, received->payload_len);
+            if (received->payload_len == frame_size + 4)
+            {
+                EXPECT_EQ(0, memcmp(received->payload + 4, frame.get(), frame_size));
+            }
+            (void)uvgrtp::frame::dealloc_frame(received);
+        }
+    }
+
+    // the largest frame does not fit the initial output buffer
+    std::vector<size_t> test_sizes = { 1501, 1446 * 2 - 1, 1446 * 2, 1446 * 2 + 1, 5000, 50000, 200000 };
+
+    int rtp_flags = RTP_NO_FLAGS;
+    int nal_type = 5;
+    rtp_format_t format = RTP_FORMAT_H265;
+    int test_runs = 10;
+
+    for (auto& size : test_sizes)
+    {
+        std::unique_ptr<uint8_t[]> intra_frame = create_test_packet(format, nal_type, true, size, rtp_flags);
+        test_packet_size(std::move(intra_frame), test_runs, size, sess, sender, receiver, rtp_flags);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+struct nal_chunk_log
+{
+    std::vector<uint8_t> data;
+    size_t chunks = 0;
+    bool in_order = true;
+    bool last_seen = false;
+};
+
+static void nal_chunk_hook(void* arg, const uvgrtp::frame::nal_chunk* chunk)
+{
+    nal_chunk_log* log = (nal_chunk_log*)arg;
+
+    if (chunk->offset != log->data.size() || log->last_seen)
+    {
+        log->in_order = false;
+    }
+    log->data.insert(log->data.end(), chunk->data, chunk->data + chunk->len);
+    log->last_seen = chunk->last;
+    ++log->chunks;
+}
+
+TEST(FormatTests, h265_nal_chunks)
+{
+    // Tests getting a fragmented NAL unit piece by piece before it is complete
+    std::cout << "Starting h265 NAL chunk test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+    }
+
+    nal_chunk_log log;
+
+    if (receiver)
+    {
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->install_nal_chunk_hook(nullptr, nullptr));
+        EXPECT_EQ(RTP_OK, receiver->install_nal_chunk_hook(&log, nal_chunk_hook));
+    }
+
+    if (sender && receiver)
+    {
+        const size_t frame_size = 30000;
+        std::unique_ptr<uint8_t[]> frame(new uint8_t[frame_size]);
+        for (size_t i = 0; i < frame_size; ++i)
+        {
+            frame[i] = (uint8_t)(i % 251 + 1);
+        }
+        frame[0] = 1 << 1; // TRAIL_R
+        frame[1] = 1;
+
+        std::vector<uvgrtp::frame::nal_unit> nal_units = { { 0, frame_size } };
+        EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), frame_size, nal_units, RTP_NO_FLAGS));
+
+        uvgrtp::frame::rtp_frame* received = receiver->pull_frame(1000);
+        EXPECT_NE(nullptr, received);
+        if (received)
+        {
+            EXPECT_EQ(frame_size + 4, received->payload_len);
+            (void)uvgrtp::frame::dealloc_frame(received);
+        }
+
+        // the chunks are given before the complete NAL unit
+        EXPECT_TRUE(log.in_order);
+        EXPECT_TRUE(log.last_seen);
+        EXPECT_LT(1u, log.chunks);
+        EXPECT_EQ(frame_size, log.data.size());
+        if (log.data.size() == frame_size)
+        {
+            EXPECT_EQ(0, memcmp(log.data.data(), frame.get(), frame_size));
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_access_unit)
+{
+    // Tests receiving all NAL units of a picture as one frame
+    std::cout << "Starting h265 access unit test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_H26X_ACCESS_UNIT);
+    }
+
+    if (sender && receiver)
+    {
+        // VPS, SPS and PPS are aggregated into one packet and the slice is fragmented
+        const std::vector<std::pair<uint8_t, size_t>> nal_units = { { 32, 20 }, { 33, 40 }, { 34, 10 }, { 19, 20000 } };
+
+        std::vector<uint8_t> access_unit;
+        for (auto& nal : nal_units)
+        {
+            size_t start = access_unit.size();
+            access_unit.insert(access_unit.end(), { 0, 0, 0, 1 });
+            access_unit.resize(start + 4 + nal.second);
+
+            for (size_t i = start + 4; i < access_unit.size(); ++i)
+            {
+                access_unit[i] = (uint8_t)(i % 251 + 1);
+            }
+            access_unit[start + 4] = nal.first << 1;
+            access_unit[start + 5] = 1;
+        }
+
+        for (int i = 0; i < 3; ++i)
+        {
+            EXPECT_EQ(RTP_OK, sender->push_frame(access_unit.data(), access_unit.size(), RTP_NO_FLAGS));
+
+            uvgrtp::frame::rtp_frame* received = receiver->pull_frame(1000);
+            EXPECT_NE(nullptr, received);
+            if (received)
+            {
+                EXPECT_EQ(1, received->header.marker);
+                EXPECT_EQ(access_unit.size(), received->payload_len);
+                if (received->payload_len == access_unit.size())
+                {
+                    EXPECT_EQ(0, memcmp(received->payload, access_unit.data(), access_unit.size()));
+                }
+                (void)uvgrtp::frame::dealloc_frame(received);
+            }
+        }
+
+        // the whole access unit came in one frame
+        EXPECT_EQ(nullptr, receiver->pull_frame(100));
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_fragmented_nal_units)
+{
+    // Tests sending several fragmented NAL units of different types in one frame
+    std::cout << "Starting h265 fragmented NAL units test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        // the packets are received as they are to see the FU headers
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS);
+    }
+
+    if (sender && receiver)
+    {
+        const size_t nal_size = 5000;
+        const uint8_t nal_types[] = { 19, 1, 2 };
+        std::vector<uint8_t> frame(sizeof(nal_types) * nal_size);
+        std::vector<uvgrtp::frame::nal_unit> nal_units;
+
+        for (size_t i = 0; i < frame.size(); ++i)
+        {
+            frame[i] = (uint8_t)(i % 251 + 1);
+        }
+        for (size_t i = 0; i < sizeof(nal_types); ++i)
+        {
+            frame[i * nal_size] = nal_types[i] << 1;
+            frame[i * nal_size + 1] = 1;
+            nal_units.push_back({ i * nal_size, nal_size });
+        }
+
+        EXPECT_EQ(RTP_OK, sender->push_frame(frame.data(), frame.size(), nal_units, RTP_NO_FLAGS));
+
+        // each NAL unit must keep its own FU headers
+        size_t nal = 0;
+        size_t received_bytes = 0;
+        uvgrtp::frame::rtp_frame* received = nullptr;
+
+        while ((received = receiver->pull_frame(200)) != nullptr)
+        {
+            EXPECT_LT(3u, received->payload_len);
+            EXPECT_EQ(49, received->payload[0] >> 1);
+
+            uint8_t fu_header = received->payload[2];
+            if (fu_header & 0x80)
+            {
+                EXPECT_EQ(0u, received_bytes);
+            }
+            if (nal < sizeof(nal_types))
+            {
+                EXPECT_EQ(nal_types[nal], fu_header & 0x3f);
+                EXPECT_EQ(0, memcmp(received->payload + 3,
+                    &frame[nal * nal_size + 2 + received_bytes], received->payload_len - 3));
+            }
+            received_bytes += received->payload_len - 3;
+
+            if (fu_header & 0x40)
+            {
+                EXPECT_EQ(nal_size - 2, received_bytes);
+                received_bytes = 0;
+                ++nal;
+            }
+            (void)uvgrtp::frame::dealloc_frame(received);
+        }
+        EXPECT_EQ(sizeof(nal_types), nal);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+static uint8_t* raw_video_buffer(void* arg, uint32_t timestamp, size_t size)
+{
+    (void)timestamp;
+    std::vector<uint8_t>* buffer = (std::vector<uint8_t>*)arg;
+    buffer->resize(size);
+    return buffer->data();
+}
+
+TEST(FormatTests, raw_video_scanlines)
+{
+    // Tests sending raw video from separate scan lines and receiving it directly to an application buffer
+    std::cout << "Starting raw video scan line test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_RAW_VIDEO, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_RAW_VIDEO, RCE_NO_FLAGS);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (!sender || !receiver)
+    {
+        cleanup_ms(sess, sender);
+        cleanup_ms(sess, receiver);
+        cleanup_sess(ctx, sess);
+        return;
+    }
+
+    // 4:2:2 10-bit, so a line of 640 pixels is 1600 bytes and does not fit in one packet
+    const size_t width = 640;
+    const size_t height = 48;
+    const size_t line_len = width / 2 * 5;
+
+    for (auto& stream : { sender, receiver })
+    {
+        EXPECT_EQ(RTP_OK, stream->configure_ctx(RCC_VIDEO_WIDTH, width));
+        EXPECT_EQ(RTP_OK, stream->configure_ctx(RCC_VIDEO_HEIGHT, height));
+    }
+    EXPECT_EQ(5, receiver->get_configuration_value(RCC_VIDEO_PGROUP_SIZE));
+
+    std::vector<uint8_t> app_buffer;
+    EXPECT_EQ(RTP_OK, receiver->install_video_buffer_hook(&app_buffer, raw_video_buffer));
+
+    std::vector<std::unique_ptr<uint8_t[]>> storage;
+    std::vector<uint8_t*> lines;
+    for (size_t i = 0; i < height; ++i)
+    {
+        storage.emplace_back(new uint8_t[line_len]);
+        for (size_t j = 0; j < line_len; ++j)
+        {
+            storage.back()[j] = (uint8_t)(i * 3 + j);
+        }
+        lines.push_back(storage.back().get());
+    }
+
+    std::vector<uint8_t*> too_short(lines.begin(), lines.end() - 1);
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->push_scanlines(too_short, RTP_NO_FLAGS));
+    EXPECT_EQ(RTP_OK, sender->push_scanlines(lines, RTP_NO_FLAGS));
+
+    uvgrtp::frame::rtp_frame* received = receiver->pull_frame(1000);
+    EXPECT_NE(nullptr, received);
+    if (received)
+    {
+        EXPECT_EQ(app_buffer.data(), received->payload);
+        EXPECT_EQ(line_len * height, received->payload_len);
+
+        for (size_t i = 0; i < height && received->payload_len == line_len * height; ++i)
+        {
+            EXPECT_EQ(0, memcmp(received->payload + i * line_len, lines[i], line_len));
+        }
+        (void)uvgrtp::frame::dealloc_frame(received);
+    }
+
+    // a contiguous frame is packetized the same way
+    std::unique_ptr<uint8_t[]> frame(new uint8_t[line_len * height]);
+    memset(frame.get(), 0x3c, line_len * height);
+    EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), line_len * height, RTP_NO_FLAGS));
+
+    received = receiver->pull_frame(1000);
+    EXPECT_NE(nullptr, received);
+    if (received)
+    {
+        EXPECT_EQ(line_len * height, received->payload_len);
+        EXPECT_EQ(0, memcmp(received->payload, frame.get(), line_len * height));
+        (void)uvgrtp::frame::dealloc_frame(received);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
 TEST(FormatTests, h265_fps)
 {
     std::cout << "Starting h265 test" << std::endl;
@@ -506,4 +889,236 @@ TEST(FormatTests, h264_multiplex)
     cleanup_sess(ctx, sender_sess);
     cleanup_sess(ctx, receiver_sess);
 
-}
\ No newline at end of file
+}
+TEST(FormatTests, h265_nal_unit_index)
+{
+    // Tests sending a frame with NAL unit locations given by the application instead of start codes
+    std::cout << "Starting H265 NAL unit index test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (!sender || !receiver)
+    {
+        cleanup_ms(sess, sender);
+        cleanup_ms(sess, receiver);
+        cleanup_sess(ctx, sess);
+        return;
+    }
+
+    // two small NAL units that are aggregated and one that is fragmented, without any start codes
+    const size_t frame_size = 6000;
+    std::unique_ptr<uint8_t[]> frame(new uint8_t[frame_size]);
+    memset(frame.get(), 0x55, frame_size);
+
+    std::vector<uvgrtp::frame::nal_unit> nal_units = { { 10, 100 }, { 110, 200 }, { 400, 5000 } };
+    for (auto& nal : nal_units)
+    {
+        frame[nal.offset]     = 1 << 1; // NAL type 1
+        frame[nal.offset + 1] = 1;
+    }
+
+    std::vector<uvgrtp::frame::nal_unit> outside = { { 5000, 1001 } };
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->push_frame(frame.get(), frame_size, outside, RTP_NO_FLAGS));
+    EXPECT_EQ(RTP_OK, sender->push_frame(frame.get(), frame_size, nal_units, RTP_NO_FLAGS));
+
+    for (auto& nal : nal_units)
+    {
+        uvgrtp::frame::rtp_frame* received = receiver->pull_frame(1000);
+        EXPECT_NE(nullptr, received);
+        if (!received)
+            break;
+
+        // the receiver adds the start code back
+        EXPECT_EQ(nal.size + 4, received->payload_len);
+        if (received->payload_len == nal.size + 4)
+        {
+            EXPECT_EQ(0, memcmp(received->payload + 4, frame.get() + nal.offset, nal.size));
+        }
+        (void)uvgrtp::frame::dealloc_frame(received);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_aggregation_deadline)
+{
+    // Tests holding the small NAL units of separate push_frame() calls for one aggregation packet
+    std::cout << "Starting H265 aggregation deadline test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (!sender || !receiver)
+    {
+        cleanup_ms(sess, sender);
+        cleanup_ms(sess, receiver);
+        cleanup_sess(ctx, sess);
+        return;
+    }
+
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_AGGREGATION_DEADLINE, 1000001));
+    EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_AGGREGATION_DEADLINE, 20000));
+    EXPECT_EQ(20000, sender->get_configuration_value(RCC_AGGREGATION_DEADLINE));
+
+    // VPS, SPS and PPS are pushed separately with the timestamp of the picture
+    const std::vector<std::pair<uint8_t, size_t>> nal_units = { { 32, 20 }, { 33, 40 }, { 34, 10 } };
+    const uint32_t timestamp = 90000;
+
+    for (auto& nal : nal_units)
+    {
+        std::vector<uint8_t> frame(4 + nal.second, (uint8_t)nal.first);
+        frame[0] = frame[1] = frame[2] = 0;
+        frame[3] = 1;
+        frame[4] = nal.first << 1;
+        frame[5] = 1;
+
+        EXPECT_EQ(RTP_OK, sender->push_frame(frame.data(), frame.size(), timestamp, RTP_NO_FLAGS));
+    }
+
+    // the NAL units come from one aggregation packet when the deadline expires
+    uint16_t seq = 0;
+    for (size_t i = 0; i < nal_units.size(); ++i)
+    {
+        uvgrtp::frame::rtp_frame* received = receiver->pull_frame(1000);
+        EXPECT_NE(nullptr, received);
+        if (!received)
+            break;
+
+        if (i == 0)
+            seq = received->header.seq;
+
+        EXPECT_EQ(seq, received->header.seq);
+        EXPECT_EQ(timestamp, received->header.timestamp);
+        EXPECT_EQ(nal_units[i].second + 4, received->payload_len);
+        if (received->payload_len == nal_units[i].second + 4)
+        {
+            EXPECT_EQ(nal_units[i].first, received->payload[4 + 2]);
+        }
+        (void)uvgrtp::frame::dealloc_frame(received);
+    }
+
+    // a NAL unit with a new timestamp sends the held one, and a large one is not held
+    std::vector<uint8_t> small(30, 0x11);
+    small[0] = small[1] = small[2] = 0;
+    small[3] = 1;
+    small[4] = 1 << 1;
+    small[5] = 1;
+    std::vector<uint8_t> large(3000, 0x22);
+    large[0] = large[1] = large[2] = 0;
+    large[3] = 1;
+    large[4] = 1 << 1;
+    large[5] = 1;
+
+    EXPECT_EQ(RTP_OK, sender->push_frame(small.data(), small.size(), timestamp + 3000, RTP_NO_FLAGS));
+    EXPECT_EQ(RTP_OK, sender->push_frame(large.data(), large.size(), timestamp + 6000, RTP_NO_FLAGS));
+
+    for (uint32_t ts : { timestamp + 3000, timestamp + 6000 })
+    {
+        uvgrtp::frame::rtp_frame* received = receiver->pull_frame(10);
+        EXPECT_NE(nullptr, received);
+        if (received)
+        {
+            EXPECT_EQ(ts, received->header.timestamp);
+            (void)uvgrtp::frame::dealloc_frame(received);
+        }
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_play_file)
+{
+    // Tests sending the access units of an Annex-B file from its memory mapping
+    std::cout << "Starting H265 file playout test" << std::endl;
+    const char* file_name = "uvgrtp_test_play.h265";
+    const int access_units = 5;
+    const size_t loops = 2;
+
+    // each access unit is a parameter set and a slice, the slices of every other access unit are fragmented
+    std::vector<uint8_t> file;
+    for (int i = 0; i < access_units; ++i)
+    {
+        const uint8_t pps[] = { 0, 0, 0, 1, 34 << 1, 1, 0xc1, 0x72 };
+        file.insert(file.end(), std::begin(pps), std::end(pps));
+
+        const uint8_t slice[] = { 0, 0, 1, 1 << 1, 1, 0x80 };
+        file.insert(file.end(), std::begin(slice), std::end(slice));
+        file.insert(file.end(), (i % 2) ? 3000 : 200, 0x55);
+    }
+
+    FILE* out = fopen(file_name, "wb");
+    ASSERT_NE(nullptr, out);
+    fwrite(file.data(), 1, file.size(), out);
+    fclose(out);
+
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+    if (sender && receiver)
+    {
+        std::atomic<int> received(0);
+        EXPECT_EQ(RTP_OK, receiver->install_receive_hook([&received](uvgrtp::frame::rtp_frame* frame) {
+            (void)uvgrtp::frame::dealloc_frame(frame);
+            ++received;
+        }));
+
+        EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_FPS_NUMERATOR, 100));
+        EXPECT_EQ(RTP_GENERIC_ERROR, sender->play_file("uvgrtp_test_missing.h265", 1, RTP_NO_FLAGS));
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->play_file(file_name, 1, RTP_COPY));
+
+        auto start = std::chrono::steady_clock::now();
+        EXPECT_EQ(RTP_OK, sender->play_file(file_name, loops, RTP_NO_FLAGS));
+
+        // the access units are sent at the frame rate
+        EXPECT_LE(std::chrono::milliseconds((access_units * loops - 1) * 10), std::chrono::steady_clock::now() - start);
+
+        for (int i = 0; i < 100 && received < access_units * (int)loops * 2; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        // the parameter set and the slice are received as NAL units of their own
+        EXPECT_EQ(access_units * (int)loops * 2, received);
+        EXPECT_EQ((uint64_t)(access_units * loops), sender->get_stats().sent_frames);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+    std::remove(file_name);
+}
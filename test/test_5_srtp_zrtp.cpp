@@ -1,5 +1,11 @@
 #include "test_common.hh"
 
+#include "../src/crypto.hh"
+#include "../src/zrtp/hello.hh"
+
+#include <algorithm>
+#include <cstring>
+
 
 // network parameters of example
 constexpr char SENDER_ADDRESS[] = "127.0.0.1";
@@ -15,12 +21,12 @@ enum Key_length { SRTP_128 = 128, SRTP_196 = 196, SRTP_256 = 256 };
 constexpr int SALT_SIZE = 112;
 constexpr int SALT_SIZE_BYTES = SALT_SIZE / 8;
 
-void user_send_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_size);
-void user_receive_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_size);
+void user_send_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_size, unsigned extra_flags);
+void user_receive_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_size, unsigned extra_flags);
 void zrtp_sender_func(uvgrtp::session* sender_session, int sender_port, int receiver_port, unsigned int flags, bool mux);
 void zrtp_receive_func(uvgrtp::session* receiver_session, int sender_port, int receiver_port, unsigned int flags, bool mux);
 
-void test_user_key(Key_length len);
+void test_user_key(Key_length len, unsigned extra_flags = 0);
 int received_packets;
 // User key management test
 
@@ -39,7 +45,17 @@ TEST(EncryptionTests, srtp_user_key_256)
     test_user_key(SRTP_256);
 }
 
-void test_user_key(Key_length len)
+TEST(EncryptionTests, srtp_aes_gcm_128)
+{
+    test_user_key(SRTP_128, RCE_SRTP_AES_GCM);
+}
+
+TEST(EncryptionTests, srtp_aes_gcm_256)
+{
+    test_user_key(SRTP_256, RCE_SRTP_AES_GCM);
+}
+
+void test_user_key(Key_length len, unsigned extra_flags)
 {
     std::cout << "Starting ZRTP sender thread" << std::endl;
     uvgrtp::context ctx;
@@ -61,8 +77,8 @@ void test_user_key(Key_length len)
     for (int i = 0; i < SALT_SIZE_BYTES; ++i)
         salt[i] = i * 2;
 
-    std::unique_ptr<std::thread> sender_thread = std::unique_ptr<std::thread>(new std::thread(user_send_func, key, salt, len));
-    std::unique_ptr<std::thread> receiver_thread = std::unique_ptr<std::thread>(new std::thread(user_receive_func, key, salt, len));
+    std::unique_ptr<std::thread> sender_thread = std::unique_ptr<std::thread>(new std::thread(user_send_func, key, salt, len, extra_flags));
+    std::unique_ptr<std::thread> receiver_thread = std::unique_ptr<std::thread>(new std::thread(user_receive_func, key, salt, len, extra_flags));
 
     if (sender_thread && sender_thread->joinable())
     {
@@ -77,7 +93,7 @@ void test_user_key(Key_length len)
     delete[] key;
 }
 
-void user_send_func(uint8_t* key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_size)
+void user_send_func(uint8_t* key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_size, unsigned extra_flags)
 {
     uvgrtp::context ctx;
     uvgrtp::session* sender_session = nullptr;
@@ -86,7 +102,7 @@ void user_send_func(uint8_t* key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_siz
     sender_session = ctx.create_session(RECEIVER_ADDRESS);
 
     // Enable SRTP and let user manage the keys
-    unsigned flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER;
+    unsigned flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER | extra_flags;
     if (key_size == 192)
     {
         flags |= RCE_SRTP_KEYSIZE_192;
@@ -119,14 +135,14 @@ void user_send_func(uint8_t* key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_siz
     }
 }
 
-void user_receive_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_size)
+void user_receive_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_size, unsigned extra_flags)
 {
     /* See sending.cc for more details */
     uvgrtp::context ctx;
     uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS);
 
     /* Enable SRTP and let user manage keys */
-    unsigned flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER;
+    unsigned flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER | extra_flags;
     received_packets = 0;
 
     if (key_size == 192)
@@ -178,6 +194,193 @@ void user_receive_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_
 
 // ZRTP key management tests
 
+TEST(EncryptionTests, srtcp_aes_gcm)
+{
+    // Tests that the RTCP reports of a stream protected with AES-GCM are decrypted by the other end
+    uvgrtp::context ctx;
+
+    if (!ctx.crypto_enabled())
+    {
+        std::cout << "Please link crypto to uvgRTP library in order to tests its SRTP user keys!" << std::endl;
+        FAIL();
+        return;
+    }
+
+    uint8_t key[SRTP_128 / 8] = { 0 };
+    uint8_t salt[SALT_SIZE_BYTES] = { 0 };
+
+    for (size_t i = 0; i < sizeof(key); ++i)
+        key[i] = (uint8_t)i;
+
+    for (int i = 0; i < SALT_SIZE_BYTES; ++i)
+        salt[i] = (uint8_t)(i * 2);
+
+    unsigned flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_AES_GCM | RCE_RTCP;
+
+    uvgrtp::session* sender_session = ctx.create_session(RECEIVER_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS);
+    uvgrtp::media_stream* send = nullptr;
+    uvgrtp::media_stream* recv = nullptr;
+
+    if (sender_session && receiver_session)
+    {
+        send = sender_session->create_stream(SENDER_PORT, RECEIVER_PORT, RTP_FORMAT_GENERIC, flags);
+        recv = receiver_session->create_stream(RECEIVER_PORT, SENDER_PORT, RTP_FORMAT_GENERIC, flags);
+    }
+
+    std::atomic<int> frames(0);
+    std::atomic<int> sender_reports(0);
+
+    EXPECT_NE(nullptr, send);
+    EXPECT_NE(nullptr, recv);
+    if (send && recv)
+    {
+        EXPECT_EQ(RTP_OK, send->add_srtp_ctx(key, salt));
+        EXPECT_EQ(RTP_OK, recv->add_srtp_ctx(key, salt));
+
+        EXPECT_EQ(RTP_OK, recv->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(
+            [&](uvgrtp::frame::rtp_frame* frame) {
+                (void)uvgrtp::frame::dealloc_frame(frame);
+                ++frames;
+            })));
+        EXPECT_EQ(RTP_OK, recv->get_rtcp()->install_sender_hook(
+            std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_sender_report>)>(
+                [&](std::unique_ptr<uvgrtp::frame::rtcp_sender_report> sr) {
+                    EXPECT_EQ(send->get_ssrc(), sr->ssrc);
+                    ++sender_reports;
+                })));
+
+        size_t frame_size = strlen((char*)"Hello, world!");
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, frame_size, RTP_NO_FLAGS);
+        send_packets(std::move(test_frame), frame_size, sender_session, send, 100, 50, false, RTP_NO_FLAGS);
+
+        for (int i = 0; i < 100 && sender_reports == 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+
+    std::cout << frames << " frames and " << sender_reports << " sender reports received" << std::endl;
+    EXPECT_TRUE(frames > 90);
+    EXPECT_TRUE(sender_reports > 0);
+
+    cleanup_ms(sender_session, send);
+    cleanup_ms(receiver_session, recv);
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+}
+
+TEST(EncryptionTests, srtp_aes_gcm_replay)
+{
+    // Tests that a receiver with replay protection drops the AES-GCM packets it has already received
+    uvgrtp::context ctx;
+
+    if (!ctx.crypto_enabled())
+    {
+        std::cout << "Please link crypto to uvgRTP library in order to tests its SRTP user keys!" << std::endl;
+        FAIL();
+        return;
+    }
+
+    uint8_t key[SRTP_128 / 8] = { 0 };
+    uint8_t salt[SALT_SIZE_BYTES] = { 0 };
+
+    for (size_t i = 0; i < sizeof(key); ++i)
+        key[i] = (uint8_t)(0xff - i);
+
+    for (int i = 0; i < SALT_SIZE_BYTES; ++i)
+        salt[i] = (uint8_t)i;
+
+    const char* sent_file = "uvgrtp_test_gcm_sent.pcap";
+    unsigned flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_AES_GCM | RCE_SRTP_REPLAY_PROTECTION;
+
+    uvgrtp::session* sess = ctx.create_session(RECEIVER_ADDRESS);
+    uvgrtp::media_stream* send = nullptr;
+    uvgrtp::media_stream* recv = nullptr;
+
+    std::atomic<int> received(0);
+    auto count_frame = [&received](uvgrtp::frame::rtp_frame* frame) {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+        ++received;
+    };
+
+    auto create_receiver = [&]() {
+        uvgrtp::media_stream* stream = sess->create_stream(RECEIVER_PORT, SENDER_PORT, RTP_FORMAT_GENERIC, flags);
+        EXPECT_NE(nullptr, stream);
+
+        if (stream)
+        {
+            EXPECT_EQ(RTP_OK, stream->add_srtp_ctx(key, salt));
+            EXPECT_EQ(RTP_OK, stream->install_receive_hook(std::function<void(uvgrtp::frame::rtp_frame*)>(count_frame)));
+        }
+        return stream;
+    };
+
+    auto wait_for = [&](int frames) {
+        for (int i = 0; i < 100 && received < frames; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        // a replayed packet would arrive within this time too
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    };
+
+    const int test_frames = 20;
+
+    if (sess)
+    {
+        send = sess->create_stream(SENDER_PORT, RECEIVER_PORT, RTP_FORMAT_GENERIC, flags);
+        recv = create_receiver();
+    }
+
+    EXPECT_NE(nullptr, send);
+    if (send && recv)
+    {
+        EXPECT_EQ(RTP_OK, send->add_srtp_ctx(key, salt));
+        EXPECT_EQ(RTP_OK, send->start_capture(sent_file, RTP_CAPTURE_SEND));
+
+        size_t frame_size = strlen((char*)"Hello, world!");
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, frame_size, RTP_NO_FLAGS);
+
+        for (int i = 0; i < test_frames; ++i) {
+            EXPECT_EQ(RTP_OK, send->push_frame(test_frame.get(), frame_size, RTP_NO_FLAGS));
+        }
+
+        wait_for(test_frames);
+        EXPECT_EQ(test_frames, received);
+        EXPECT_EQ(RTP_OK, send->stop_capture());
+
+        // the encrypted packets sent again are dropped
+        EXPECT_EQ(RTP_OK, recv->replay_capture(sent_file, 0));
+        wait_for(2 * test_frames);
+        EXPECT_EQ(test_frames, received);
+    }
+
+    cleanup_ms(sess, recv);
+    recv = nullptr;
+
+    // a receiver that has not seen the packets accepts them once
+    if (sess && send)
+    {
+        received = 0;
+        recv = create_receiver();
+
+        if (recv)
+        {
+            EXPECT_EQ(RTP_OK, recv->replay_capture(sent_file, 0));
+            wait_for(test_frames);
+            EXPECT_EQ(test_frames, received);
+
+            EXPECT_EQ(RTP_OK, recv->replay_capture(sent_file, 0));
+            wait_for(2 * test_frames);
+            EXPECT_EQ(test_frames, received);
+        }
+        cleanup_ms(sess, recv);
+    }
+
+    std::remove(sent_file);
+    cleanup_ms(sess, send);
+    cleanup_sess(ctx, sess);
+}
+
 TEST(EncryptionTests, zrtp)
 {
     uvgrtp::context ctx;
@@ -218,6 +421,87 @@ TEST(EncryptionTests, zrtp)
     cleanup_sess(ctx, receiver_session);
 }
 
+TEST(EncryptionTests, zrtp_ec25)
+{
+    // Tests the ZRTP key exchange when both ends offer EC25 and when only one end does
+    for (bool remote_ec25 : { true, false })
+    {
+        uvgrtp::context send_ctx;
+        uvgrtp::context receive_ctx;
+
+        if (!send_ctx.crypto_enabled())
+        {
+            std::cout << "Please link crypto to uvgRTP library in order to tests its ZRTP feature!" << std::endl;
+            FAIL();
+            return;
+        }
+
+        EXPECT_EQ(RTP_OK, send_ctx.set_zrtp_ec25(true));
+        EXPECT_EQ(RTP_OK, receive_ctx.set_zrtp_ec25(remote_ec25));
+
+        uvgrtp::session* sender_session = send_ctx.create_session(RECEIVER_ADDRESS, SENDER_ADDRESS);
+        uvgrtp::session* receiver_session = receive_ctx.create_session(SENDER_ADDRESS, RECEIVER_ADDRESS);
+
+        unsigned zrtp_flags = RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP;
+        received_packets = 0;
+
+        std::thread sender_thread(zrtp_sender_func, sender_session, SENDER_PORT, RECEIVER_PORT, zrtp_flags, false);
+        std::thread receiver_thread(zrtp_receive_func, receiver_session, SENDER_PORT, RECEIVER_PORT, zrtp_flags, false);
+
+        sender_thread.join();
+        receiver_thread.join();
+
+        std::cout << received_packets << " / 10 packets received" << std::endl;
+        EXPECT_TRUE(received_packets > 5);
+
+        cleanup_sess(send_ctx, sender_session);
+        cleanup_sess(receive_ctx, receiver_session);
+    }
+}
+
+TEST(EncryptionTests, zrtp_key_pool)
+{
+    uvgrtp::context ctx;
+
+    if (!ctx.crypto_enabled())
+    {
+        std::cout << "Please link crypto to uvgRTP library in order to tests its ZRTP feature!" << std::endl;
+        FAIL();
+        return;
+    }
+
+    // both sessions take their key pairs from the pool of the context
+    EXPECT_EQ(RTP_OK, ctx.set_zrtp_key_pool(2));
+
+    uvgrtp::session* sender_session = ctx.create_session(RECEIVER_ADDRESS, SENDER_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS, RECEIVER_ADDRESS);
+
+    unsigned zrtp_flags = RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP;
+    received_packets = 0;
+
+    std::unique_ptr<std::thread> sender_thread =
+        std::unique_ptr<std::thread>(new std::thread(zrtp_sender_func, sender_session, SENDER_PORT, RECEIVER_PORT, zrtp_flags, false));
+
+    std::unique_ptr<std::thread> receiver_thread =
+        std::unique_ptr<std::thread>(new std::thread(zrtp_receive_func, receiver_session, SENDER_PORT, RECEIVER_PORT, zrtp_flags, false));
+
+    if (sender_thread && sender_thread->joinable())
+    {
+        sender_thread->join();
+    }
+
+    if (receiver_thread && receiver_thread->joinable())
+    {
+        receiver_thread->join();
+    }
+
+    std::cout << received_packets << " / 10 packets received" << std::endl;
+    EXPECT_TRUE(received_packets > 5);
+
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+}
+
 TEST(EncryptionTests, zrtp_authenticate)
 {
     uvgrtp::context ctx;
@@ -399,6 +683,75 @@ TEST(EncryptionTests, zrtp_multistream_mux)
     cleanup_sess(recv_ctx, receiver_session);
 }
 
+TEST(EncryptionTests, zrtp_multistream_concurrent)
+{
+    std::cout << "Testing concurrent ZRTP multistream negotiations" << std::endl;
+
+    uvgrtp::context ctx;
+
+    if (!ctx.crypto_enabled())
+    {
+        std::cout << "Please link crypto to uvgRTP library in order to tests its ZRTP feature!" << std::endl;
+        FAIL();
+        return;
+    }
+
+    unsigned zrtp_dh_flags = RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP | RCE_ZRTP_DIFFIE_HELLMAN_MODE;
+    unsigned int zrtp_multistream_flags = RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP | RCE_ZRTP_MULTISTREAM_MODE;
+
+    uvgrtp::session* sender_session = ctx.create_session(RECEIVER_ADDRESS, SENDER_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS, RECEIVER_ADDRESS);
+
+    /* The first pair performs DH, the rest negotiate their keys in Multistream Mode all at once */
+    constexpr int STREAMS = 8;
+    uvgrtp::media_stream* senders[STREAMS] = {};
+    uvgrtp::media_stream* receivers[STREAMS] = {};
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < STREAMS; ++i) {
+        unsigned int flags = (i == 0) ? zrtp_dh_flags : zrtp_multistream_flags;
+        uint16_t offset = (uint16_t)(10 + 2 * i);
+
+        threads.emplace_back([&, i, flags, offset] {
+            senders[i] = sender_session->create_stream(SENDER_PORT + offset, RECEIVER_PORT + offset, RTP_FORMAT_GENERIC, flags);
+        });
+        threads.emplace_back([&, i, flags, offset] {
+            receivers[i] = receiver_session->create_stream(RECEIVER_PORT + offset, SENDER_PORT + offset, RTP_FORMAT_GENERIC, flags);
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    for (int i = 0; i < STREAMS; ++i) {
+        EXPECT_NE(nullptr, senders[i]);
+        EXPECT_NE(nullptr, receivers[i]);
+    }
+
+    /* Every stream has its own keys, so a frame only decrypts on the stream it was sent to */
+    std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, 100, RTP_NO_FLAGS);
+
+    for (int i = 0; i < STREAMS; ++i) {
+        if (!senders[i] || !receivers[i])
+            continue;
+
+        EXPECT_EQ(RTP_OK, senders[i]->push_frame(test_frame.get(), 100, RTP_NO_FLAGS));
+
+        uvgrtp::frame::rtp_frame* frame = receivers[i]->pull_frame(1000);
+        EXPECT_NE(nullptr, frame);
+        if (frame)
+            process_rtp_frame(frame);
+    }
+
+    for (int i = 0; i < STREAMS; ++i) {
+        cleanup_ms(sender_session, senders[i]);
+        cleanup_ms(receiver_session, receivers[i]);
+    }
+
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+}
+
 void zrtp_sender_func(uvgrtp::session* sender_session, int sender_port, int receiver_port, unsigned int flags, bool mux)
 {
     std::cout << "Starting ZRTP sender thread" << std::endl;
@@ -479,4 +832,164 @@ void zrtp_receive_func(uvgrtp::session* receiver_session, int sender_port, int r
     }
 
     cleanup_ms(receiver_session, recv);
-}
\ No newline at end of file
+}
+#ifdef __RTP_CRYPTO__
+
+TEST(EncryptionTests, zrtp_hello_layout)
+{
+    // Tests that Hello lists the key agreement types only when EC25 is offered
+    for (bool ec25 : { false, true })
+    {
+        uvgrtp::zrtp_session_t session;
+        session.offer_ec25 = ec25;
+
+        uvgrtp::zrtp_msg::hello hello(session);
+
+        size_t list_len = ec25 ? 2 * sizeof(uint32_t) : 0;
+        EXPECT_EQ(sizeof(uvgrtp::zrtp_msg::zrtp_hello) + list_len + sizeof(uint64_t) + sizeof(uint32_t),
+            session.l_msg.hello.first);
+        EXPECT_EQ(ec25 ? htonl(2 << 4) : 0u, session.l_msg.hello.second->flags);
+
+        // the remote sees the mandatory DH3k and EC25 only if it was offered
+        uvgrtp::zrtp_session_t remote;
+        EXPECT_EQ(RTP_OK, hello.parse_msg(session.l_msg.hello.second, remote, session.l_msg.hello.first));
+
+        auto& offered = remote.capabilities.key_agreements;
+        EXPECT_EQ(ec25, std::find(offered.begin(), offered.end(), (uint32_t)uvgrtp::zrtp_msg::EC25) != offered.end());
+        EXPECT_NE(offered.end(), std::find(offered.begin(), offered.end(), (uint32_t)uvgrtp::zrtp_msg::DH3k));
+
+        delete[] (uint8_t *)session.l_msg.hello.second;
+    }
+}
+
+/* Known answer tests of the crypto backend. The expected outputs are the published test
+ * vectors, so both Crypto++ and OpenSSL have to produce them bit for bit */
+
+static std::vector<uint8_t> from_hex(const char *hex)
+{
+    std::vector<uint8_t> bytes;
+
+    for (size_t i = 0; hex[i] && hex[i + 1]; i += 2) {
+        bytes.push_back((uint8_t)std::stoul(std::string(hex + i, 2), nullptr, 16));
+    }
+    return bytes;
+}
+
+TEST(CryptoTests, aes_cm_keystream)
+{
+    // RFC 3711 appendix B.2
+    auto key      = from_hex("2B7E151628AED2A6ABF7158809CF4F3C");
+    auto iv       = from_hex("F0F1F2F3F4F5F6F7F8F9FAFBFCFD0000");
+    auto expected = from_hex("E03EAD0935C95E80E166B16DD92B4EB4"
+                             "D23513162B02D0F72A43A2FE4A5F97AB"
+                             "41E95B3BB0A2E8DD477901E4FCA894C0");
+
+    std::vector<uint8_t> zeros(expected.size(), 0);
+    std::vector<uint8_t> keystream(expected.size());
+
+    uvgrtp::crypto::aes::ctr ctr(key.data(), key.size(), iv.data());
+    ctr.encrypt(keystream.data(), zeros.data(), zeros.size());
+    EXPECT_EQ(expected, keystream);
+
+    // the key stream restarts from the IV given to resynchronize()
+    uvgrtp::crypto::aes::ctr resync(key.data(), key.size());
+    resync.resynchronize(iv.data());
+    resync.decrypt(keystream.data(), zeros.data(), zeros.size());
+    EXPECT_EQ(expected, keystream);
+}
+
+TEST(CryptoTests, hmac_sha1)
+{
+    // RFC 2202 test cases 1 and 2
+    std::vector<uint8_t> key1(20, 0x0b);
+    const char data1[] = "Hi There";
+    const char key2[]  = "Jefe";
+    const char data2[] = "what do ya want for nothing?";
+
+    std::vector<uint8_t> digest(20);
+
+    uvgrtp::crypto::hmac::sha1 first(key1.data(), key1.size());
+    first.update((const uint8_t *)data1, strlen(data1));
+    first.final(digest.data());
+    EXPECT_EQ(from_hex("b617318655057264e28bc0b6fb378c8ef146be00"), digest);
+
+    uvgrtp::crypto::hmac::sha1 second((const uint8_t *)key2, strlen(key2));
+    second.update((const uint8_t *)data2, 10);
+    second.update((const uint8_t *)data2 + 10, strlen(data2) - 10);
+    second.final(digest.data());
+    EXPECT_EQ(from_hex("effcdf6ae5eb2fa2d27416d5f184df9c259a7c79"), digest);
+
+    // SRTP truncates the tag to 80 bits
+    std::vector<uint8_t> truncated(10);
+    second.update((const uint8_t *)data2, strlen(data2));
+    second.final(truncated.data(), truncated.size());
+    EXPECT_EQ(from_hex("effcdf6ae5eb2fa2d274"), truncated);
+}
+
+TEST(CryptoTests, aes_gcm)
+{
+    // test case 4 of the GCM specification
+    auto key        = from_hex("feffe9928665731c6d6a8f9467308308");
+    auto iv         = from_hex("cafebabefacedbaddecaf888");
+    auto aad        = from_hex("feedfacedeadbeeffeedfacedeadbeefabaddad2");
+    auto plaintext  = from_hex("d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+                               "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39");
+    auto ciphertext = from_hex("42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+                               "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091");
+    auto tag        = from_hex("5bc94fbc3221a5db94fae95ae7121a47");
+
+    uvgrtp::crypto::aes::gcm gcm(key.data(), key.size());
+
+    std::vector<uint8_t> data = plaintext;
+    std::vector<uint8_t> out_tag(tag.size());
+
+    gcm.encrypt(iv.data(), iv.size(), aad.data(), aad.size(), data.data(), data.size(), out_tag.data(), out_tag.size());
+    EXPECT_EQ(ciphertext, data);
+    EXPECT_EQ(tag, out_tag);
+
+    EXPECT_TRUE(gcm.decrypt(iv.data(), iv.size(), aad.data(), aad.size(), data.data(), data.size(), tag.data(), tag.size()));
+    EXPECT_EQ(plaintext, data);
+
+    // a modified ciphertext must not authenticate
+    data = ciphertext;
+    data[0] ^= 1;
+    EXPECT_FALSE(gcm.decrypt(iv.data(), iv.size(), aad.data(), aad.size(), data.data(), data.size(), tag.data(), tag.size()));
+}
+
+TEST(CryptoTests, ecdh_p256)
+{
+    // the base point of P-256, X || Y
+    auto generator = from_hex("6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c296"
+                              "4fe342e2fe1a7f9b8ee7eb4a7c0f9e162bce33576b315ececbb6406837bf51f5");
+
+    uvgrtp::crypto::ecdh local;
+    uvgrtp::crypto::ecdh remote;
+
+    local.generate_keys();
+    remote.generate_keys();
+
+    std::vector<uint8_t> local_pk(64), remote_pk(64);
+    local.get_pk(local_pk.data(), local_pk.size());
+    remote.get_pk(remote_pk.data(), remote_pk.size());
+
+    // with the base point as the remote key the secret is the X of our own public key
+    std::vector<uint8_t> secret(32);
+    local.set_remote_pk(generator.data(), generator.size());
+    ASSERT_TRUE(local.get_shared_secret(secret.data(), secret.size()));
+    EXPECT_EQ(std::vector<uint8_t>(local_pk.begin(), local_pk.begin() + 32), secret);
+
+    // both ends derive the same secret
+    std::vector<uint8_t> local_secret(32), remote_secret(32);
+    local.set_remote_pk(remote_pk.data(), remote_pk.size());
+    remote.set_remote_pk(local_pk.data(), local_pk.size());
+    ASSERT_TRUE(local.get_shared_secret(local_secret.data(), local_secret.size()));
+    ASSERT_TRUE(remote.get_shared_secret(remote_secret.data(), remote_secret.size()));
+    EXPECT_EQ(local_secret, remote_secret);
+
+    // a point that is not on the curve is rejected
+    generator[63] ^= 1;
+    local.set_remote_pk(generator.data(), generator.size());
+    EXPECT_FALSE(local.get_shared_secret(secret.data(), secret.size()));
+}
+
+#endif
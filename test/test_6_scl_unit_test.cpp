@@ -6,8 +6,40 @@
 
 #include "test_common.hh"
 
+#include "uvgrtp/media_clock.hh"
 #include "../src/formats/h264.hh"
 #include "../src/formats/h266.hh"
+#include "../src/arena.hh"
+#include "../src/copy_pool.hh"
+#include "../src/delivery_queue.hh"
+#include "../src/fec.hh"
+#include "../src/header_batch.hh"
+#include "../src/header_extensions.hh"
+#include "../src/holepuncher.hh"
+#include "../src/jitter_buffer.hh"
+#include "../src/memory_budget.hh"
+#include "../src/nack.hh"
+#include "../src/pacer.hh"
+#include "../src/pipeline.hh"
+#include "../src/rtp.hh"
+#include "../src/rtcp_scheduler.hh"
+#include "../src/ssrc_demux.hh"
+#include "../src/stream_metrics.hh"
+#include "../src/srtp/base.hh"
+#include "../src/twcc.hh"
+#include "../src/uring.hh"
+#include "../src/worker_pool.hh"
+#include "../src/zrtp/file_cache.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 const int DATA_SIZE = 128;
 const int DATA_VALUE = 128;
@@ -110,4 +142,1611 @@ TEST(FormatTests, h266_scl) {
         EXPECT_EQ(4 + offset, (int)out);
         EXPECT_EQ(4, start_len);
     }
-}
\ No newline at end of file
+}
+TEST(FormatTests, h26x_scl_long) {
+    // Tests start code lookup over data long enough for the vectorized scanner,
+    // with single zero bytes that must not stop the lookup
+    std::shared_ptr<uvgrtp::rtp>    rtp_;
+    auto socket_ = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto format_26x = uvgrtp::formats::h266(socket_, rtp_, 0);
+
+    const size_t long_size = 4096;
+
+    for (uint8_t start_len_in = 3; start_len_in <= 4; ++start_len_in) {
+        for (size_t position = 0; position < 300; ++position) {
+            std::vector<uint8_t> data(long_size, DATA_VALUE);
+
+            // every tenth byte is zero, but there are no "00 00" pairs
+            for (size_t i = 5; i < long_size; i += 10) {
+                data[i] = 0;
+            }
+
+            // the bytes around the start code must not make it longer
+            if (position > 0)
+                data[position - 1] = DATA_VALUE;
+            data[position + start_len_in] = DATA_VALUE;
+
+            for (size_t i = 0; i < (size_t)start_len_in - 1; ++i) {
+                data[position + i] = 0;
+            }
+            data[position + start_len_in - 1] = 1;
+
+            uint8_t start_len = 0;
+            ssize_t out = format_26x.find_h26x_start_code(data.data(), long_size, 0, start_len);
+
+            EXPECT_EQ((ssize_t)(position + start_len_in), out);
+            EXPECT_EQ(start_len_in, start_len);
+        }
+    }
+}
+
+TEST(FormatTests, h26x_seq_bitmap) {
+    // Tests the fragment sequence number set with reordering and wraparound
+    uvgrtp::formats::seq_bitmap seqs;
+
+    std::vector<uint16_t> inserted = { 65530, 65535, 0, 3, 65500, 100 };
+    for (auto& seq : inserted)
+    {
+        EXPECT_TRUE(seqs.insert(seq));
+    }
+
+    EXPECT_FALSE(seqs.insert(0));
+    EXPECT_FALSE(seqs.insert(65500));
+    EXPECT_EQ(inserted.size(), seqs.size());
+
+    for (auto& seq : inserted)
+    {
+        EXPECT_TRUE(seqs.contains(seq));
+    }
+    EXPECT_FALSE(seqs.contains(1));
+    EXPECT_FALSE(seqs.contains(65499));
+    EXPECT_FALSE(seqs.contains(30000));
+
+    std::vector<uint16_t> visited;
+    seqs.for_each([&](uint16_t seq) { visited.push_back(seq); });
+
+    // sequence numbers are visited in the order they were sent
+    std::vector<uint16_t> expected = { 65500, 65530, 65535, 0, 3, 100 };
+    EXPECT_EQ(expected, visited);
+}
+
+TEST(FormatTests, h26x_seq_bitmap_span) {
+    // Tests that a frame cannot span half of the sequence number space
+    uvgrtp::formats::seq_bitmap seqs;
+
+    EXPECT_TRUE(seqs.insert(0));
+    EXPECT_FALSE(seqs.fits(32768));
+    EXPECT_FALSE(seqs.insert(32768));
+    EXPECT_FALSE(seqs.contains(32768));
+
+    // the rejected sequence number did not hide the ones already in the set
+    EXPECT_TRUE(seqs.contains(0));
+    EXPECT_FALSE(seqs.insert(0));
+    EXPECT_EQ(1u, seqs.size());
+
+    EXPECT_TRUE(seqs.insert(32767));
+    EXPECT_FALSE(seqs.insert(65535));
+    EXPECT_TRUE(seqs.contains(0));
+    EXPECT_TRUE(seqs.contains(32767));
+    EXPECT_EQ(2u, seqs.size());
+
+    size_t visited = 0;
+    seqs.for_each([&](uint16_t) { ++visited; });
+    EXPECT_EQ(2u, visited);
+
+    // the same holds when the bitmap grows backwards
+    seqs.clear();
+    EXPECT_TRUE(seqs.insert(40000));
+    EXPECT_FALSE(seqs.insert(7232));
+    EXPECT_TRUE(seqs.insert(7233 + 63));
+    EXPECT_TRUE(seqs.contains(40000));
+    EXPECT_EQ(2u, seqs.size());
+}
+
+TEST(FormatTests, generic_reassembly) {
+    // Tests reassembling a large generic frame whose fragments arrive reversed, duplicated and wrapping around
+    auto ssrc = std::make_shared<std::atomic<std::uint32_t>>(1);
+    auto rtp_ctx = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_GENERIC, ssrc, false);
+    uvgrtp::formats::media media(nullptr, rtp_ctx, RCE_FRAGMENT_GENERIC);
+
+    const size_t frag_size = 1400;
+    const size_t frame_size = 300 * 1000;
+    const size_t fragments = (frame_size + frag_size - 1) / frag_size;
+    const uint16_t first_seq = 65500;
+
+    std::vector<uint8_t> data(frame_size);
+    for (size_t i = 0; i < frame_size; ++i)
+    {
+        data[i] = (uint8_t)(i * 7 + i / 251);
+    }
+
+    auto make_fragment = [&](size_t index) {
+        size_t len = std::min(frag_size, frame_size - index * frag_size);
+        uvgrtp::frame::rtp_frame* frag = uvgrtp::frame::alloc_rtp_frame(len);
+
+        frag->header.timestamp = 1234;
+        frag->header.seq = (uint16_t)(first_seq + index);
+        frag->header.marker = (index == fragments - 1);
+        std::memcpy(frag->payload, data.data() + index * frag_size, len);
+        return frag;
+    };
+
+    std::vector<size_t> order;
+    for (size_t i = 0; i < fragments - 1; ++i)
+    {
+        order.push_back(fragments - 2 - i);
+    }
+    order.push_back(3); // duplicate
+    order.push_back(fragments - 1);
+
+    uvgrtp::frame::rtp_frame* out = nullptr;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        out = make_fragment(order[i]);
+        rtp_error_t ret = media.packet_handler(media.get_media_frame_info(), RCE_FRAGMENT_GENERIC, nullptr, 0, &out);
+
+        if (i + 1 < order.size())
+        {
+            EXPECT_EQ(RTP_OK, ret);
+            EXPECT_EQ(nullptr, out);
+        }
+        else
+        {
+            EXPECT_EQ(RTP_PKT_READY, ret);
+        }
+    }
+
+    ASSERT_NE(nullptr, out);
+    ASSERT_EQ(frame_size, out->payload_len);
+    EXPECT_EQ(0, std::memcmp(data.data(), out->payload, frame_size));
+    EXPECT_EQ(0u, media.get_media_frame_info()->frames.size());
+    EXPECT_EQ(RTP_OK, uvgrtp::frame::dealloc_frame(out));
+}
+
+TEST(FormatTests, srtp_worker_pool) {
+    // the decryption threads of RCC_SRTP_DECRYPT_THREADS must cover every packet exactly once
+    uvgrtp::worker_pool pool;
+    pool.resize(3);
+    EXPECT_EQ(3, pool.size());
+
+    for (size_t count : { 0, 1, 3, 4, 257 }) {
+        std::vector<std::atomic<int>> visits(count);
+        std::vector<int> workers(count, -1);
+
+        for (auto& visit : visits)
+            visit = 0;
+
+        pool.run(count, [&](size_t begin, size_t end, size_t worker) {
+            for (size_t i = begin; i < end; ++i) {
+                ++visits[i];
+                workers[i] = (int)worker;
+            }
+        });
+
+        for (size_t i = 0; i < count; ++i) {
+            EXPECT_EQ(1, visits[i].load());
+            EXPECT_LE(0, workers[i]);
+            EXPECT_GE(3, workers[i]);
+        }
+    }
+
+    pool.resize(0);
+    EXPECT_EQ(0, pool.size());
+
+    int sum = 0;
+    pool.run(10, [&](size_t begin, size_t end, size_t worker) {
+        EXPECT_EQ(0, worker);
+        for (size_t i = begin; i < end; ++i)
+            sum += (int)i;
+    });
+    EXPECT_EQ(45, sum);
+}
+
+TEST(FormatTests, srtp_replay_window) {
+    uvgrtp::replay_window window;
+
+    // in order, over the 16-bit sequence number wrap of the extended index
+    for (uint64_t index = 0xfff0; index < 0x10010; ++index)
+        EXPECT_FALSE(window.check_and_update(index));
+
+    EXPECT_TRUE(window.check_and_update(0xfff0));
+    EXPECT_TRUE(window.check_and_update(0x1000f));
+
+    // reordered packets within the window are accepted once
+    EXPECT_FALSE(window.check_and_update(0x10020));
+    EXPECT_FALSE(window.check_and_update(0x10015));
+    EXPECT_TRUE(window.check_and_update(0x10015));
+    EXPECT_FALSE(window.check_and_update(0x10016));
+
+    // the bits of skipped indices are cleared when the window moves
+    EXPECT_FALSE(window.check_and_update(0x10020 + UVG_REPLAY_WINDOW_SIZE - 1));
+    EXPECT_TRUE(window.check_and_update(0x10020));
+    EXPECT_TRUE(window.check_and_update(0x10016));
+    EXPECT_FALSE(window.check_and_update(0x10021));
+
+    // a jump past the whole window forgets everything before it
+    uint64_t far = 0x10020 + 10 * UVG_REPLAY_WINDOW_SIZE;
+    EXPECT_FALSE(window.check_and_update(far));
+    EXPECT_FALSE(window.check_and_update(far - 1));
+    EXPECT_FALSE(window.check_and_update(far - UVG_REPLAY_WINDOW_SIZE + 1));
+    EXPECT_TRUE(window.check_and_update(far - UVG_REPLAY_WINDOW_SIZE));
+    EXPECT_TRUE(window.check_and_update(far));
+}
+
+TEST(FormatTests, zrtp_file_cache) {
+    const std::string path = "uvgrtp_zrtp_cache_test.txt";
+    std::remove(path.c_str());
+
+    uint8_t zid[uvgrtp::ZRTP_ZID_LENGTH];
+    uint8_t remote[uvgrtp::ZRTP_ZID_LENGTH];
+    uvgrtp::zrtp_retained_secrets secrets = {};
+
+    for (size_t i = 0; i < sizeof(zid); ++i) {
+        zid[i] = (uint8_t)i;
+        remote[i] = (uint8_t)(0xf0 + i);
+    }
+    for (size_t i = 0; i < sizeof(secrets.rs1); ++i)
+        secrets.rs1[i] = (uint8_t)(i * 7);
+
+    {
+        uvgrtp::zrtp_file_cache cache(path);
+        ASSERT_EQ(RTP_OK, cache.load());
+
+        uint8_t out[uvgrtp::ZRTP_ZID_LENGTH];
+        uvgrtp::zrtp_retained_secrets found;
+        EXPECT_FALSE(cache.get_zid(out));
+        EXPECT_FALSE(cache.get_secrets(remote, found));
+
+        cache.set_zid(zid);
+        cache.set_secrets(remote, secrets);
+    }
+
+    // the secrets survive a new cache object through the file
+    uvgrtp::zrtp_file_cache cache(path);
+    ASSERT_EQ(RTP_OK, cache.load());
+
+    uint8_t out[uvgrtp::ZRTP_ZID_LENGTH];
+    uvgrtp::zrtp_retained_secrets found = {};
+    ASSERT_TRUE(cache.get_zid(out));
+    EXPECT_EQ(0, memcmp(zid, out, sizeof(zid)));
+    ASSERT_TRUE(cache.get_secrets(remote, found));
+    EXPECT_EQ(0, memcmp(secrets.rs1, found.rs1, sizeof(found.rs1)));
+    EXPECT_FALSE(found.rs2_valid);
+    EXPECT_FALSE(cache.get_secrets(zid, found));
+
+    std::ofstream(path) << "zid 0011\n";
+    uvgrtp::zrtp_file_cache broken(path);
+    EXPECT_EQ(RTP_INVALID_VALUE, broken.load());
+
+    std::remove(path.c_str());
+}
+
+TEST(FormatTests, rtcp_scheduler) {
+    uvgrtp::rtcp_scheduler scheduler;
+    std::atomic<int> fast(0);
+    std::atomic<int> slow(0);
+
+    // each report function returns the delay until its next call
+    uint64_t fast_id = scheduler.add([&fast]() { ++fast; return (uint32_t)20; }, 10);
+    uint64_t slow_id = scheduler.add([&slow]() { ++slow; return (uint32_t)200; }, 100);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(350));
+
+    scheduler.remove(fast_id);
+    int fast_calls = fast;
+    EXPECT_GE(fast_calls, 8);
+    EXPECT_LE(fast_calls, 18);
+    EXPECT_GE(slow.load(), 1);
+    EXPECT_LE(slow.load(), 2);
+
+    // a removed timer is no longer called
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(fast_calls, fast.load());
+
+    scheduler.remove(slow_id);
+}
+
+TEST(FormatTests, header_extensions) {
+    uvgrtp::header_extensions extensions;
+    EXPECT_EQ(0, extensions.size());
+
+    EXPECT_EQ(RTP_OK, extensions.set_id(uvgrtp::EXT_TRANSPORT_WIDE_SEQ, 5));
+    EXPECT_EQ(RTP_INVALID_VALUE, extensions.set_id(uvgrtp::EXT_AUDIO_LEVEL, 5));
+    EXPECT_EQ(RTP_OK, extensions.set_id(uvgrtp::EXT_AUDIO_LEVEL, 6));
+    EXPECT_EQ(RTP_OK, extensions.set_id(uvgrtp::EXT_FRAME_MARKING, 7));
+
+    // the one-byte form: the header, 3 + 2 + 2 bytes of elements and one byte of padding
+    ASSERT_EQ(12, extensions.size());
+    const uint8_t one_byte[12] = { 0xbe, 0xde, 0, 2, 0x51, 0, 0, 0x60, 0, 0x70, 0, 0 };
+    EXPECT_EQ(0, memcmp(one_byte, extensions.layout(), sizeof(one_byte)));
+    EXPECT_EQ(5, extensions.offset(uvgrtp::EXT_TRANSPORT_WIDE_SEQ));
+    EXPECT_EQ(8, extensions.offset(uvgrtp::EXT_AUDIO_LEVEL));
+    EXPECT_EQ(10, extensions.offset(uvgrtp::EXT_FRAME_MARKING));
+    EXPECT_EQ(0, extensions.offset(uvgrtp::EXT_ABS_SEND_TIME));
+
+    uint8_t ext[uvgrtp::MAX_HEADER_EXTENSION_SIZE];
+    memcpy(ext, extensions.layout(), extensions.size());
+    ext[extensions.offset(uvgrtp::EXT_AUDIO_LEVEL)] = 0x9e;
+
+    uvgrtp::frame::ext_header header;
+    header.type = 0xbede;
+    header.len  = (uint16_t)(extensions.size() - 4);
+    header.data = &ext[4];
+
+    size_t len = 0;
+    const uint8_t *level = uvgrtp::find_header_extension(&header, 6, len);
+    ASSERT_NE(nullptr, level);
+    EXPECT_EQ(1, len);
+    EXPECT_EQ(0x9e, level[0]);
+    EXPECT_EQ(nullptr, uvgrtp::find_header_extension(&header, 3, len));
+
+    uint16_t seq = 1;
+    EXPECT_TRUE(uvgrtp::read_twcc_extension(&header, 5, seq));
+    EXPECT_EQ(0, seq);
+
+    // an ID above 14 switches every element to the two-byte form
+    EXPECT_EQ(RTP_OK, extensions.set_id(uvgrtp::EXT_ABS_SEND_TIME, 200));
+    extensions.set_long_frame_marking(true);
+
+    ASSERT_EQ(20, extensions.size());
+    const uint8_t two_byte[20] = { 0x10, 0x00, 0, 4, 200, 3, 0, 0, 0, 5, 2, 0, 0, 6, 1, 0, 7, 2, 0, 0 };
+    EXPECT_EQ(0, memcmp(two_byte, extensions.layout(), sizeof(two_byte)));
+
+    memcpy(ext, extensions.layout(), extensions.size());
+    uvgrtp::write_abs_send_time(&ext[extensions.offset(uvgrtp::EXT_ABS_SEND_TIME)], (uint64_t)0x12345678abcdef00);
+
+    header.type = 0x1000;
+    header.len  = 16;
+
+    const uint8_t *send_time = uvgrtp::find_header_extension(&header, 200, len);
+    ASSERT_NE(nullptr, send_time);
+    EXPECT_EQ(3, len);
+    EXPECT_EQ(0xe2, send_time[0]);
+    EXPECT_EQ(0xaf, send_time[1]);
+    EXPECT_EQ(0x37, send_time[2]);
+
+    const uint8_t *marking = uvgrtp::find_header_extension(&header, 7, len);
+    ASSERT_NE(nullptr, marking);
+    EXPECT_EQ(2, len);
+
+    EXPECT_EQ(RTP_OK, extensions.set_id(uvgrtp::EXT_ABS_SEND_TIME, 0));
+    EXPECT_EQ(RTP_OK, extensions.set_id(uvgrtp::EXT_TRANSPORT_WIDE_SEQ, 0));
+    EXPECT_EQ(RTP_OK, extensions.set_id(uvgrtp::EXT_AUDIO_LEVEL, 0));
+    EXPECT_EQ(RTP_OK, extensions.set_id(uvgrtp::EXT_FRAME_MARKING, 0));
+    EXPECT_EQ(0, extensions.size());
+}
+
+/* Send 50 packets every 50 ms through the TWCC sender and receiver, "extra_delay" gives the
+ * queuing delay of each packet in microseconds and packets with a negative delay are lost */
+static void twcc_rounds(uvgrtp::twcc_sender& sender, uvgrtp::twcc_receiver& receiver, int rounds,
+    std::function<int64_t(int round, int packet)> extra_delay)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (int r = 0; r < rounds; ++r) {
+        auto sent = start + std::chrono::milliseconds(50 * r);
+
+        for (int i = 0; i < 50; ++i) {
+            uint8_t ext[uvgrtp::TWCC_EXTENSION_SIZE];
+            uvgrtp::write_twcc_extension(ext, 3, sender.add_packet(250));
+
+            uvgrtp::frame::ext_header header;
+            header.type = (uint16_t)((ext[0] << 8) | ext[1]);
+            header.len  = (uint16_t)(((ext[2] << 8) | ext[3]) * 4);
+            header.data = &ext[4];
+
+            uint16_t seq = 0;
+            ASSERT_TRUE(uvgrtp::read_twcc_extension(&header, 3, seq));
+            EXPECT_FALSE(uvgrtp::read_twcc_extension(&header, 4, seq));
+
+            int64_t delay = extra_delay(r, i);
+            if (delay >= 0) {
+                receiver.packet_received(0x1234, seq,
+                    sent + std::chrono::milliseconds(i) + std::chrono::microseconds(20000 + delay));
+            }
+        }
+        sender.packets_sent(sent, std::chrono::milliseconds(1));
+
+        uint32_t size = 0;
+        uint8_t *feedback = receiver.create_feedback(0x5678, 0, size);
+        ASSERT_NE(nullptr, feedback);
+        EXPECT_EQ(0, size % 4);
+        EXPECT_EQ(uvgrtp::frame::RTCP_RTPFB_TWCC, feedback[0] & 0x1f);
+        EXPECT_EQ(uvgrtp::frame::RTCP_FT_RTPFB, feedback[1]);
+        EXPECT_EQ(size / 4 - 1, (uint32_t)((feedback[2] << 8) | feedback[3]));
+
+        // the feedback control information starts after the two SSRCs
+        EXPECT_EQ(RTP_OK, sender.feedback_received(&feedback[12], size - 12));
+        delete[] feedback;
+
+        // everything has been reported
+        EXPECT_EQ(nullptr, receiver.create_feedback(0x5678, 0, size));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+}
+
+static void twcc_bitrate_hook(void *arg, uint32_t bitrate)
+{
+    *(uint32_t *)arg = bitrate;
+}
+
+TEST(FormatTests, twcc_estimate) {
+    // with a steady delay the estimate grows from the start bitrate
+    {
+        uvgrtp::twcc_sender sender;
+        uvgrtp::twcc_receiver receiver;
+        sender.set_bitrates(1000000, 0);
+
+        twcc_rounds(sender, receiver, 15, [](int, int) { return (int64_t)0; });
+        EXPECT_GT(sender.get_target_bitrate(), 1000000u);
+    }
+
+    // a queuing delay that keeps growing is overuse and the estimate drops
+    {
+        uvgrtp::twcc_sender sender;
+        uvgrtp::twcc_receiver receiver;
+        uint32_t reported = 0;
+
+        sender.set_bitrates(1000000, 0);
+        sender.install_bitrate_hook(&reported, twcc_bitrate_hook);
+
+        twcc_rounds(sender, receiver, 10, [](int r, int i) { return (int64_t)(r * 50 + i) * 500; });
+        EXPECT_LT(sender.get_target_bitrate(), 1000000u);
+        EXPECT_EQ(sender.get_target_bitrate(), reported);
+    }
+
+    // losses are reported and the maximum limits the estimate
+    {
+        uvgrtp::twcc_sender sender;
+        uvgrtp::twcc_receiver receiver;
+        sender.set_bitrates(1000000, 1000000);
+
+        twcc_rounds(sender, receiver, 5, [](int, int i) { return (i % 3 == 0) ? (int64_t)-1 : (int64_t)0; });
+        EXPECT_LT(sender.get_target_bitrate(), 1000000u);
+    }
+}
+
+TEST(FormatTests, nack_generator) {
+    using namespace std::chrono;
+
+    uvgrtp::nack_generator generator;
+    std::vector<uint16_t> seqs;
+    steady_clock::time_point start = steady_clock::now();
+
+    // the gap over the wrap-around of the sequence number is asked for right away
+    generator.packet_received(65534, start);
+    generator.packet_received(2, start);
+    EXPECT_EQ(3u, generator.missing());
+
+    generator.get_nacks(start, 500, seqs);
+    EXPECT_EQ((std::vector<uint16_t>{ 65535, 0, 1 }), seqs);
+
+    // a late packet is no longer asked for and the rest are asked again after the retry interval
+    generator.packet_received(0, start + milliseconds(5));
+
+    seqs.clear();
+    generator.get_nacks(start + milliseconds(10), 500, seqs);
+    EXPECT_TRUE(seqs.empty());
+
+    generator.get_nacks(start + milliseconds(40), 500, seqs);
+    EXPECT_EQ((std::vector<uint16_t>{ 65535, 1 }), seqs);
+
+    seqs.clear();
+    generator.get_nacks(start + milliseconds(80), 500, seqs);
+    EXPECT_EQ(2u, seqs.size());
+
+    // after the last retry the packets are given up
+    seqs.clear();
+    generator.get_nacks(start + milliseconds(120), 500, seqs);
+    EXPECT_TRUE(seqs.empty());
+    EXPECT_EQ(0u, generator.missing());
+
+    // packets that have waited longer than the receiver keeps frames are not asked for
+    generator.packet_received(10, start);
+    generator.get_nacks(start + milliseconds(200), 100, seqs);
+    EXPECT_TRUE(seqs.empty());
+    EXPECT_EQ(0u, generator.missing());
+
+    // a restart of the sender is not a loss
+    generator.packet_received(30000, start);
+    EXPECT_EQ(0u, generator.missing());
+}
+
+TEST(FormatTests, fec_recovery) {
+    // Tests rebuilding a burst of lost packets of a frame from interleaved repair packets
+    auto ssrc = std::make_shared<std::atomic<std::uint32_t>>(1);
+    uvgrtp::rtp rtp_ctx(RTP_FORMAT_H265, ssrc, false);
+
+    const size_t header_size = 12;
+    const size_t count = 10;
+    const uint16_t first_seq = 65530;
+
+    // the media packets as they are sent, the first one with a header extension
+    std::vector<std::vector<uint8_t>> sent(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::vector<uint8_t>& packet = sent[i];
+        packet.resize(header_size + 100 + i * 13);
+
+        packet[0] = (i == 0) ? 0x90 : 0x80;
+        packet[1] = (i == count - 1) ? 0x80 | 96 : 96;
+        *(uint16_t *)&packet[2] = htons((uint16_t)(first_seq + i));
+        *(uint32_t *)&packet[4] = htonl(123456);
+        *(uint32_t *)&packet[8] = htonl(1);
+
+        for (size_t b = header_size; b < packet.size(); ++b) {
+            packet[b] = (uint8_t)(b * 3 + i);
+        }
+
+        if (i == 0) {
+            *(uint16_t *)&packet[12] = htons(0xbede);
+            *(uint16_t *)&packet[14] = htons(1);
+        }
+    }
+
+    uvgrtp::pkt_vec packets(count);
+    for (size_t i = 0; i < count; ++i) {
+        packets[i].push_back({ header_size, sent[i].data() });
+        packets[i].push_back({ sent[i].size() - header_size, sent[i].data() + header_size });
+    }
+
+    const size_t repairs = uvgrtp::fec_repair_count(count, 30);
+    ASSERT_EQ(3u, repairs);
+
+    uvgrtp::fec_decoder decoder;
+    auto receive = [&](std::vector<uint8_t>& packet) {
+        uvgrtp::frame::rtp_frame *frame = nullptr;
+        EXPECT_EQ(RTP_PKT_MODIFIED, rtp_ctx.packet_handler(nullptr, 0, packet.data(), packet.size(), &frame));
+        return frame;
+    };
+
+    // packets 2, 3 and 4 are lost
+    for (size_t i = 0; i < count; ++i) {
+        if (i < 2 || i > 4) {
+            uvgrtp::frame::rtp_frame *frame = receive(sent[i]);
+            decoder.media_received(frame);
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> rebuilt;
+    for (size_t j = 0; j < repairs; ++j) {
+        std::vector<uint8_t> repair(header_size + uvgrtp::FEC_HEADER_SIZE + 1000);
+        size_t size = uvgrtp::write_fec_packet(packets, j, count - j, repairs, 0, repair.data() + header_size);
+        repair.resize(header_size + size);
+
+        repair[0] = 0x80;
+        repair[1] = 99;
+        *(uint16_t *)&repair[2] = htons((uint16_t)(first_seq + count + j));
+        *(uint32_t *)&repair[4] = htonl(123456);
+        *(uint32_t *)&repair[8] = htonl(1);
+
+        uvgrtp::frame::rtp_frame *frame = receive(repair);
+        decoder.fec_received(frame);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+
+        decoder.recover(rebuilt);
+    }
+
+    ASSERT_EQ(3u, rebuilt.size());
+    for (auto& packet : rebuilt) {
+        uint16_t seq = ntohs(*(uint16_t *)&packet[2]);
+        size_t index = (uint16_t)(seq - first_seq);
+
+        ASSERT_TRUE(index >= 2 && index <= 4);
+        EXPECT_EQ(sent[index], packet);
+    }
+
+    // nothing is left to rebuild
+    rebuilt.clear();
+    decoder.recover(rebuilt);
+    EXPECT_TRUE(rebuilt.empty());
+}
+
+TEST(FormatTests, jitter_buffer) {
+    // Tests that the frames are reordered, released at their playout time and the late ones dropped
+    std::mutex mutex;
+    std::vector<uint16_t> released;
+    std::vector<uvgrtp::clock::hrc::hrc_t> release_times;
+
+    uvgrtp::jitter_buffer buffer([&](uvgrtp::frame::rtp_frame *frame) {
+        std::lock_guard<std::mutex> lock(mutex);
+        released.push_back(frame->header.seq);
+        release_times.push_back(uvgrtp::clock::hrc::now());
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }, nullptr, 90000);
+    buffer.set_delay(50, 200);
+
+    // without the jitter of the source the shortest delay is used
+    EXPECT_EQ(50.0, buffer.get_delay_ms());
+
+    auto receive = [&](uint16_t seq, uint32_t timestamp) {
+        uvgrtp::frame::rtp_frame *frame = uvgrtp::frame::alloc_rtp_frame();
+        frame->header.ssrc = 1;
+        frame->header.seq = seq;
+        frame->header.timestamp = timestamp;
+        buffer.frame_received(frame);
+    };
+
+    auto start = uvgrtp::clock::hrc::now();
+
+    // the second frame is sent 20 ms after the first one and a packet of the first frame is reordered after it
+    receive(0, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    receive(2, 1800);
+    receive(1, 0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    // the first frame has been played out already
+    receive(65535, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(3u, released.size());
+    EXPECT_EQ(0, released[0]);
+    EXPECT_EQ(1, released[1]);
+    EXPECT_EQ(2, released[2]);
+
+    EXPECT_GE(uvgrtp::clock::hrc::diff(release_times[0], start), 45u);
+    EXPECT_GE(uvgrtp::clock::hrc::diff(release_times[2], start), 65u);
+    EXPECT_LT(uvgrtp::clock::hrc::diff(release_times[2], start), 200u);
+}
+
+TEST(FormatTests, ssrc_demux) {
+    // Tests finding the entries of many SSRCs and replacing the snapshot while it is in use
+    std::unordered_map<uint32_t, int> entries;
+    for (int i = 0; i < 60; ++i) {
+        entries[0x10000000u + (uint32_t)i * 2] = i;
+    }
+
+    uvgrtp::ssrc_demux<int> demux;
+    EXPECT_EQ(0u, demux.enter()->size());
+    EXPECT_EQ(nullptr, demux.enter()->find(1));
+    demux.leave();
+
+    demux.publish(entries);
+
+    uvgrtp::ssrc_demux<int>::snapshot *table = demux.enter();
+    ASSERT_EQ(60u, table->size());
+    for (int i = 0; i < 60; ++i) {
+        int *entry = table->find(0x10000000u + (uint32_t)i * 2);
+        ASSERT_NE(nullptr, entry);
+        EXPECT_EQ(i, *entry);
+        EXPECT_EQ(nullptr, table->find(0x10000000u + (uint32_t)i * 2 + 1));
+    }
+
+    // the snapshot in use stays valid when the entries change
+    entries.clear();
+    entries[5] = 42;
+    demux.publish(entries);
+    demux.publish(entries);
+
+    EXPECT_EQ(59, *table->find(0x10000000u + 59 * 2));
+    demux.leave();
+
+    table = demux.enter();
+    ASSERT_EQ(1u, table->size());
+    EXPECT_EQ(42, *table->first());
+    EXPECT_EQ(nullptr, table->find(0x10000000u));
+    demux.leave();
+}
+
+TEST(FormatTests, arena) {
+    // Tests allocating ring buffer arenas smaller and larger than a huge page
+    uvgrtp::arena arena;
+    EXPECT_EQ(nullptr, arena.allocate(0));
+
+    for (size_t size : { (size_t)1500, (size_t)3 * 1024 * 1024 + 100 }) {
+        uint8_t *memory = arena.allocate(size);
+        ASSERT_NE(nullptr, memory);
+        EXPECT_EQ(memory, arena.data());
+        EXPECT_GE(arena.size(), size);
+        EXPECT_EQ(0u, (uintptr_t)memory % uvgrtp::CACHE_LINE_SIZE);
+
+        if (arena.huge_pages()) {
+            EXPECT_EQ(0u, arena.size() % uvgrtp::HUGE_PAGE_SIZE);
+        }
+
+        // the whole block is usable
+        std::memset(memory, 0xab, size);
+        EXPECT_EQ(0xab, memory[size - 1]);
+    }
+
+    arena.release();
+    EXPECT_EQ(nullptr, arena.data());
+    EXPECT_EQ(0u, arena.size());
+
+    EXPECT_EQ(1408u, uvgrtp::align_up(1400, uvgrtp::CACHE_LINE_SIZE));
+    EXPECT_EQ(64u, uvgrtp::align_up(64, uvgrtp::CACHE_LINE_SIZE));
+}
+
+TEST(FormatTests, copy_pool) {
+    // Tests that the copies of RTP_COPY get the buffers of the earlier copies of their size class back
+    auto pool = std::make_shared<uvgrtp::copy_pool>();
+
+    for (size_t size : { (size_t)1500, (size_t)3 * 1024 * 1024 }) {
+        uvgrtp::pooled_buffer first = pool->alloc(size);
+        ASSERT_NE(nullptr, first.get());
+        EXPECT_EQ(0u, (uintptr_t)first.get() % uvgrtp::CACHE_LINE_SIZE);
+
+        // the whole copy is usable
+        std::memset(first.get(), 0xab, size);
+        uint8_t *memory = first.get();
+        first = nullptr;
+
+        uvgrtp::pooled_buffer second = pool->alloc(size - 100);
+        EXPECT_EQ(memory, second.get());
+    }
+    EXPECT_EQ(2u, pool->allocated());
+    EXPECT_EQ(2u, pool->reused());
+
+    // a class only keeps a few free buffers
+    std::vector<uvgrtp::pooled_buffer> buffers;
+    for (size_t i = 0; i < uvgrtp::COPY_POOL_FREE_BUFFERS + 2; ++i) {
+        buffers.push_back(pool->alloc(5000));
+    }
+    buffers.clear();
+
+    for (size_t i = 0; i < uvgrtp::COPY_POOL_FREE_BUFFERS + 2; ++i) {
+        buffers.push_back(pool->alloc(5000));
+    }
+    EXPECT_EQ(2 + 2 * (uvgrtp::COPY_POOL_FREE_BUFFERS + 2) - uvgrtp::COPY_POOL_FREE_BUFFERS, pool->allocated());
+    EXPECT_EQ(2 + uvgrtp::COPY_POOL_FREE_BUFFERS, pool->reused());
+
+    // the buffers keep the pool alive
+    pool = nullptr;
+    std::memset(buffers.back().get(), 0xab, 5000);
+    buffers.clear();
+}
+
+TEST(FormatTests, delivery_queue) {
+    // Tests the limits and the drop policies of the queue of received frames
+    auto make_frame = [](uint32_t ssrc, uint16_t seq, size_t size, bool key) {
+        uvgrtp::frame::rtp_frame *frame = uvgrtp::frame::alloc_rtp_frame(size);
+        frame->header.ssrc = ssrc;
+        frame->header.seq = seq;
+        frame->payload[0] = key ? 1 : 0;
+        return frame;
+    };
+    auto pop_seq = [](uvgrtp::delivery_queue& queue) {
+        uvgrtp::frame::rtp_frame *frame = queue.pop();
+        int seq = frame ? frame->header.seq : -1;
+        if (frame)
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        return seq;
+    };
+
+    uvgrtp::delivery_queue queue;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(uvgrtp::DEFAULT_DELIVERY_QUEUE_FRAMES, queue.get_max_frames());
+    EXPECT_EQ(nullptr, queue.pop());
+
+    // the oldest frames make room for the new ones
+    queue.set_limits(2, 0);
+    for (uint16_t seq = 0; seq < 4; ++seq) {
+        queue.push(make_frame(1, seq, 100, false));
+    }
+
+    uvgrtp::delivery_queue_stats stats = queue.get_stats();
+    EXPECT_EQ(2u, stats.queued_frames);
+    EXPECT_EQ(200u, stats.queued_bytes);
+    EXPECT_EQ(2u, stats.dropped_frames);
+    EXPECT_EQ(200u, stats.dropped_bytes);
+    EXPECT_EQ(2, pop_seq(queue));
+    EXPECT_EQ(3, pop_seq(queue));
+    EXPECT_TRUE(queue.empty());
+
+    // the byte limit drops the new frames
+    queue.set_limits(0, 250);
+    queue.set_policy(RTP_DROP_NEWEST);
+    for (uint16_t seq = 4; seq < 7; ++seq) {
+        queue.push(make_frame(1, seq, 100, false));
+    }
+    EXPECT_EQ(200u, queue.get_stats().queued_bytes);
+    EXPECT_EQ(4, pop_seq(queue));
+    EXPECT_EQ(5, pop_seq(queue));
+    EXPECT_EQ(3u, queue.get_stats().dropped_frames);
+
+    // only the frames of the given source are taken
+    std::atomic<uint32_t> other(2);
+    queue.push(make_frame(1, 7, 100, false));
+    EXPECT_EQ(nullptr, queue.pop(&other));
+    EXPECT_EQ(7, pop_seq(queue));
+
+    // after a dropped frame, the frames of the source are dropped until its next key frame
+    auto ssrc = std::make_shared<std::atomic<uint32_t>>(1);
+    queue.set_key_frame_classifier(ssrc, [](const uvgrtp::frame::rtp_frame *frame) {
+        return frame->payload[0] == 1;
+    });
+    queue.set_limits(2, 0);
+    queue.set_policy(RTP_DROP_NON_KEY_FRAMES);
+
+    queue.push(make_frame(1, 8, 100, true));
+    queue.push(make_frame(1, 9, 100, false));
+    queue.push(make_frame(1, 10, 100, false)); // dropped, the queue is full
+    EXPECT_EQ(8, pop_seq(queue));
+    queue.push(make_frame(1, 11, 100, false)); // dropped, refers to the dropped frame
+    queue.push(make_frame(1, 12, 100, true));
+    queue.push(make_frame(1, 13, 100, true));  // a key frame drops the oldest frame
+    queue.push(make_frame(1, 14, 100, false)); // dropped, the queue is full
+
+    EXPECT_EQ(12, pop_seq(queue));
+    EXPECT_EQ(13, pop_seq(queue));
+    EXPECT_EQ(-1, pop_seq(queue));
+    EXPECT_EQ(7u, queue.get_stats().dropped_frames);
+
+    queue.remove_key_frame_classifier(ssrc);
+    queue.push(make_frame(1, 15, 100, false));
+    queue.clear();
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(0u, queue.get_stats().queued_bytes);
+}
+
+TEST(FormatTests, pipeline) {
+    // Tests processing received packets through the pipelines of the generic and H.264 formats
+    auto ssrc = std::make_shared<std::atomic<uint32_t>>(1234);
+    auto rtp = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_GENERIC, ssrc, false);
+    auto socket = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+
+    uint8_t packet[12 + 4] = {
+        0x80, 96, 0x00, 0x07,       // version 2, sequence number 7
+        0x00, 0x00, 0x03, 0xe8,     // timestamp 1000
+        0x00, 0x00, 0x10, 0x92,     // SSRC 4242
+        0x65, 0x88, 0x84, 0x00      // H.264 IDR slice or generic payload
+    };
+
+    EXPECT_EQ(nullptr, uvgrtp::make_pipeline(0, RTP_FORMAT_GENERIC, rtp, nullptr, nullptr, nullptr, nullptr));
+
+    uvgrtp::formats::media generic(socket, rtp, 0);
+    std::shared_ptr<uvgrtp::pipeline> pipeline =
+        uvgrtp::make_pipeline(0, RTP_FORMAT_GENERIC, rtp, nullptr, nullptr, &generic, generic.get_media_frame_info());
+    ASSERT_NE(nullptr, pipeline);
+
+    uvgrtp::frame::rtp_frame *frame = nullptr;
+    bool buffer_taken = true;
+    EXPECT_EQ(RTP_PKT_READY, pipeline->process(0, packet, sizeof(packet), 123456789, &frame, buffer_taken));
+    EXPECT_FALSE(buffer_taken);
+    ASSERT_NE(nullptr, frame);
+    EXPECT_EQ(7, frame->header.seq);
+    EXPECT_EQ(4242u, frame->header.ssrc);
+    EXPECT_EQ(123456789u, frame->recv_time);
+    ASSERT_EQ(4u, frame->payload_len);
+    EXPECT_EQ(0x65, frame->payload[0]);
+    EXPECT_EQ(RTP_NOT_FOUND, pipeline->next_frame(&frame));
+    (void)uvgrtp::frame::dealloc_frame(frame);
+
+    // a packet that is not RTP stops at the header validation
+    uint8_t invalid[12] = { 0x40 };
+    frame = nullptr;
+    EXPECT_EQ(RTP_PKT_NOT_HANDLED, pipeline->process(0, invalid, sizeof(invalid), 0, &frame, buffer_taken));
+    EXPECT_EQ(nullptr, frame);
+
+    uvgrtp::formats::h264 h264(socket, rtp, RCE_NO_H26X_PREPEND_SC);
+    pipeline = uvgrtp::make_pipeline(RCE_NO_H26X_PREPEND_SC, RTP_FORMAT_H264, rtp, nullptr, nullptr, &h264, nullptr);
+    ASSERT_NE(nullptr, pipeline);
+
+    frame = nullptr;
+    EXPECT_EQ(RTP_PKT_READY, pipeline->process(RCE_NO_H26X_PREPEND_SC, packet, sizeof(packet), 0, &frame, buffer_taken));
+    ASSERT_NE(nullptr, frame);
+    EXPECT_TRUE(h264.is_key_frame(frame));
+    (void)uvgrtp::frame::dealloc_frame(frame);
+}
+
+TEST(FormatTests, stream_metrics) {
+    // the buckets grow in powers of two and the largest values go to the last bucket
+    EXPECT_EQ(0u, uvgrtp::stream_metrics::bucket(0));
+    EXPECT_EQ(1u, uvgrtp::stream_metrics::bucket(1));
+    EXPECT_EQ(2u, uvgrtp::stream_metrics::bucket(2));
+    EXPECT_EQ(2u, uvgrtp::stream_metrics::bucket(3));
+    EXPECT_EQ(3u, uvgrtp::stream_metrics::bucket(4));
+    EXPECT_EQ(11u, uvgrtp::stream_metrics::bucket(1500));
+    EXPECT_EQ(uvgrtp::STATS_HISTOGRAM_BUCKETS - 1, uvgrtp::stream_metrics::bucket(UINT64_MAX));
+
+    uvgrtp::stream_metrics metrics;
+    metrics.count(uvgrtp::stream_metrics::DUPLICATE_PACKETS);
+    metrics.count(uvgrtp::stream_metrics::RECEIVED_BYTES, 1500);
+    metrics.count(uvgrtp::stream_metrics::RECEIVED_BYTES, 500);
+    metrics.record(uvgrtp::stream_metrics::SEND_BATCH_SIZE, 0);
+    metrics.record(uvgrtp::stream_metrics::SEND_BATCH_SIZE, 3);
+    metrics.record(uvgrtp::stream_metrics::SEND_BATCH_SIZE, 3);
+
+    uvgrtp::stream_stats stats;
+    metrics.snapshot(stats);
+
+    EXPECT_EQ(1u, stats.duplicate_packets);
+    EXPECT_EQ(2000u, stats.received_bytes);
+    EXPECT_EQ(0u, stats.received_packets);
+    EXPECT_EQ(3u, stats.send_batch_size.count);
+    EXPECT_EQ(6u, stats.send_batch_size.sum);
+    EXPECT_EQ(1u, stats.send_batch_size.buckets[0]);
+    EXPECT_EQ(2u, stats.send_batch_size.buckets[2]);
+    EXPECT_EQ(0u, stats.queue_depth.count);
+}
+
+TEST(FormatTests, h26x_parameter_sets) {
+    // Tests caching the received parameter sets and prepending them to the key frame after a dropped frame
+    auto ssrc = std::make_shared<std::atomic<std::uint32_t>>(1);
+    auto rtp_ctx = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_H264, ssrc, false);
+    rtp_ctx->set_pkt_max_delay(10);
+
+    uvgrtp::formats::h264 h264(nullptr, rtp_ctx, RCE_NO_FLAGS);
+    h264.set_parameter_set_prepending(true);
+
+    uint16_t seq = 0;
+    auto receive = [&](uint32_t ts, std::vector<uint8_t> payload) {
+        uvgrtp::frame::rtp_frame* frame = uvgrtp::frame::alloc_rtp_frame(payload.size());
+        frame->header.timestamp = ts;
+        frame->header.seq = seq++;
+        std::memcpy(frame->payload, payload.data(), payload.size());
+
+        rtp_error_t ret = h264.packet_handler(nullptr, RCE_NO_FLAGS, nullptr, 0, &frame);
+        std::vector<uint8_t> out;
+        if (ret == RTP_PKT_READY) {
+            out.assign(frame->payload, frame->payload + frame->payload_len);
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+        return out;
+    };
+
+    const std::vector<uint8_t> sps = { 0x67, 0x42, 0x00, 0x1f };
+    const std::vector<uint8_t> pps = { 0x68, 0xce, 0x3c, 0x80 };
+    const std::vector<uint8_t> idr = { 0x65, 0x88, 0x84, 0x00 };
+    const std::vector<uint8_t> sc  = { 0, 0, 0, 1 };
+
+    std::vector<uint8_t> sets;
+    EXPECT_EQ(RTP_NOT_FOUND, h264.get_parameter_sets(sets));
+
+    // the sets in front of the first key frame are not prepended to it again, the received H.264
+    // NAL units get three-byte start codes
+    EXPECT_EQ(7u, receive(1, sps).size());
+    EXPECT_EQ(7u, receive(1, pps).size());
+    EXPECT_EQ(7u, receive(1, idr).size());
+
+    ASSERT_EQ(RTP_OK, h264.get_parameter_sets(sets));
+    std::vector<uint8_t> expected = sc;
+    expected.insert(expected.end(), sps.begin(), sps.end());
+    expected.insert(expected.end(), sc.begin(), sc.end());
+    expected.insert(expected.end(), pps.begin(), pps.end());
+    EXPECT_EQ(expected, sets);
+
+    // a fragment whose frame is never completed is dropped by the garbage collection
+    EXPECT_TRUE(receive(2, { 0x7c, 0x81, 0xaa, 0xaa }).empty());
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    EXPECT_TRUE(receive(3, { 0x7c, 0x81, 0xbb, 0xbb }).empty());
+
+    // the inter frames are delivered as they are and the next key frame gets the sets
+    EXPECT_EQ(7u, receive(4, { 0x41, 0x9a, 0x00, 0x00 }).size());
+
+    expected.insert(expected.end(), sc.begin() + 1, sc.end());
+    expected.insert(expected.end(), idr.begin(), idr.end());
+    EXPECT_EQ(expected, receive(5, idr));
+    EXPECT_EQ(7u, receive(6, idr).size());
+}
+
+TEST(FormatTests, h26x_reserved_state) {
+    // Tests that a receiver with reserved reassembly state completes and drops frames as before
+    auto ssrc = std::make_shared<std::atomic<std::uint32_t>>(1);
+    auto rtp_ctx = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_H264, ssrc, false);
+    rtp_ctx->set_pkt_max_delay(10);
+
+    uvgrtp::formats::h264 h264(nullptr, rtp_ctx, RCE_NO_FLAGS);
+    h264.reserve_receive_state(4096, 30, 0);
+
+    uint16_t seq = 0;
+    auto receive = [&](uint32_t ts, uint8_t fu_header, uint8_t value) {
+        const uint8_t payload[] = { 0x7c, fu_header, value, value };
+        uvgrtp::frame::rtp_frame* frame = uvgrtp::frame::alloc_rtp_frame(sizeof(payload));
+        frame->header.timestamp = ts;
+        frame->header.seq = seq++;
+        std::memcpy(frame->payload, payload, sizeof(payload));
+
+        rtp_error_t ret = h264.packet_handler(nullptr, RCE_NO_FLAGS, nullptr, 0, &frame);
+        std::vector<uint8_t> out;
+        if (ret == RTP_PKT_READY) {
+            out.assign(frame->payload, frame->payload + frame->payload_len);
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+        return out;
+    };
+
+    // IDR slices in three fragments each, so that a dropped frame does not hold back the next ones
+    auto send_frame = [&](uint32_t ts) {
+        EXPECT_TRUE(receive(ts, 0x85, (uint8_t)ts).empty());
+        EXPECT_TRUE(receive(ts, 0x05, (uint8_t)ts).empty());
+        return receive(ts, 0x45, (uint8_t)ts);
+    };
+
+    for (uint32_t round = 0; round < 3; ++round) {
+        for (uint32_t ts = round * 10 + 1; ts <= round * 10 + 5; ++ts) {
+            std::vector<uint8_t> expected = { 0x65 };
+            expected.insert(expected.end(), 6, (uint8_t)ts);
+
+            std::vector<uint8_t> out = send_frame(ts);
+            ASSERT_GE(out.size(), expected.size());
+            EXPECT_TRUE(std::equal(expected.begin(), expected.end(), out.end() - expected.size()));
+        }
+
+        // a frame without its end is dropped by the garbage collection and its state is reused
+        EXPECT_TRUE(receive(round * 10 + 9, 0x85, 0xee).empty());
+        std::this_thread::sleep_for(std::chrono::milliseconds(150));
+        EXPECT_FALSE(send_frame(round * 10 + 8).empty());
+
+        // the late end of the dropped frame is not delivered
+        EXPECT_TRUE(receive(round * 10 + 9, 0x45, 0xee).empty());
+    }
+}
+
+TEST(FormatTests, clock_sources) {
+    using namespace std::chrono;
+
+    int flags = uvgrtp::clock::get_flags();
+    uvgrtp::clock::set_flags(RTP_CLOCK_COARSE_TIMEOUTS | RTP_CLOCK_TSC_PACING | RTP_CLOCK_BATCH_SAMPLE);
+
+    // the coarse and TSC clocks have the epoch of the steady clock
+    steady_clock::time_point before = steady_clock::now();
+    steady_clock::time_point tsc    = uvgrtp::clock::tsc::now();
+    steady_clock::time_point coarse = uvgrtp::clock::coarse::now();
+
+    EXPECT_LT(std::abs(duration_cast<milliseconds>(coarse - before).count()), 50);
+    EXPECT_LT(std::abs(duration_cast<milliseconds>(tsc - before).count()), 5);
+
+    steady_clock::time_point previous = tsc;
+    for (int i = 0; i < 1000; ++i) {
+        steady_clock::time_point now = uvgrtp::clock::tsc::now();
+        EXPECT_GE(now, previous);
+        previous = now;
+    }
+
+    std::this_thread::sleep_for(milliseconds(30));
+    EXPECT_GE(uvgrtp::clock::coarse::diff_now(coarse), 20u);
+    EXPECT_LT(std::abs(duration_cast<milliseconds>(uvgrtp::clock::tsc::now() - steady_clock::now()).count()), 5);
+
+    // an arrival time converted with the sample of the batch matches the precise conversion
+    uint64_t received = uvgrtp::clock::system_ns() - 5000000;
+    steady_clock::time_point precise = uvgrtp::clock::steady_from_system_ns(received);
+
+    uvgrtp::clock::sample_batch();
+    steady_clock::time_point sampled = uvgrtp::clock::steady_from_system_ns(received);
+    uvgrtp::clock::hrc::hrc_t sampled_hrc = uvgrtp::clock::hrc::from_system_ns(received);
+
+    EXPECT_LT(std::abs(duration_cast<milliseconds>(sampled - precise).count()), 2);
+    EXPECT_GE(uvgrtp::clock::hrc::diff_now(sampled_hrc), 4u);
+    EXPECT_LT(uvgrtp::clock::hrc::diff_now(sampled_hrc), 50u);
+
+    uvgrtp::clock::set_flags(flags);
+}
+
+TEST(FormatTests, media_clock) {
+    auto ssrc = std::make_shared<std::atomic<uint32_t>>(0x1234);
+    uvgrtp::rtp rtp_ctx(RTP_FORMAT_OPUS, ssrc, false);
+
+    // half a second past 1000 seconds of NTP time is 45000 units of a 90 kHz clock past 90M
+    uvgrtp::function_media_clock ntp_clock([]() { return (1000ull << 32) | 0x80000000ull; });
+    uint64_t ntp = 0;
+    uint64_t units = 0;
+    ntp_clock.now(90000, ntp, units);
+    EXPECT_EQ((1000ull << 32) | 0x80000000ull, ntp);
+    EXPECT_EQ(90045000u, units);
+
+    // a 48 kHz sample counter stamps the frames with the count itself
+    auto counter = std::make_shared<std::atomic<uint64_t>>(1000);
+    rtp_ctx.set_media_clock(std::make_shared<uvgrtp::counter_media_clock>(counter, 48000));
+
+    uint8_t header[12] = {};
+    rtp_ctx.fill_header(header);
+    uint32_t first = ntohl(*(uint32_t *)&header[4]);
+
+    *counter = 1960;
+    rtp_ctx.fill_header(header);
+    EXPECT_EQ(first + 960, ntohl(*(uint32_t *)&header[4]));
+
+    // a sender report gives the time of the same clock: 48000 samples later is one second later
+    uint64_t first_ntp = 0;
+    uint32_t rtp_ts = 0;
+    EXPECT_TRUE(rtp_ctx.get_media_clock_time(first_ntp, rtp_ts));
+    EXPECT_EQ(first + 960, rtp_ts);
+
+    *counter = 1960 + 48000;
+    uint64_t second_ntp = 0;
+    EXPECT_TRUE(rtp_ctx.get_media_clock_time(second_ntp, rtp_ts));
+    EXPECT_EQ(first + 960 + 48000, rtp_ts);
+    EXPECT_EQ(1ull << 32, second_ntp - first_ntp);
+
+    // a timestamp given with the frame is kept
+    rtp_ctx.set_timestamp(77);
+    rtp_ctx.fill_header(header);
+    EXPECT_EQ(77u, ntohl(*(uint32_t *)&header[4]));
+    rtp_ctx.set_timestamp(UINT64_MAX);
+
+    rtp_ctx.set_media_clock(nullptr);
+    EXPECT_FALSE(rtp_ctx.get_media_clock_time(first_ntp, rtp_ts));
+}
+
+TEST(FormatTests, holepuncher_keepalives) {
+    const uint16_t port = 9290;
+
+    uvgrtp::socket receiver(0);
+    ASSERT_EQ(RTP_OK, receiver.init(AF_INET, SOCK_DGRAM, 0));
+    ASSERT_EQ(RTP_OK, receiver.bind(AF_INET, INADDR_LOOPBACK, port));
+
+    auto socket = std::make_shared<uvgrtp::socket>(0);
+    ASSERT_EQ(RTP_OK, socket->init(AF_INET, SOCK_DGRAM, 0));
+
+    auto scheduler = std::make_shared<uvgrtp::rtcp_scheduler>();
+    auto timer = std::make_shared<uvgrtp::keepalive_timer>(scheduler);
+
+    sockaddr_in addr = uvgrtp::socket::create_sockaddr(AF_INET, "127.0.0.1", port);
+    sockaddr_in6 addr6 = {};
+
+    // the holepunchers share a socket, so their keep-alives go out with one call
+    uvgrtp::holepuncher first(socket, timer);
+    uvgrtp::holepuncher second(socket, timer);
+    uvgrtp::holepuncher idle(socket, timer);
+    first.set_remote_address(addr, addr6);
+    second.set_remote_address(addr, addr6);
+    idle.set_remote_address(addr, addr6);
+
+    idle.notify();
+    EXPECT_EQ(RTP_OK, first.start());
+    EXPECT_EQ(RTP_OK, second.start());
+    EXPECT_EQ(RTP_OK, idle.start());
+
+    int keepalives = 0;
+    uint8_t buffer[16];
+    auto start = std::chrono::steady_clock::now();
+
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000)) {
+        int bytes = 0;
+        if (receiver.recvfrom(buffer, sizeof(buffer), MSG_DONTWAIT, &bytes) == RTP_OK && bytes > 0) {
+            EXPECT_EQ(1, bytes);
+            EXPECT_EQ(0b11000000, buffer[0]);
+            ++keepalives;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+
+    // the stream that has just sent is not due for a keep-alive yet
+    EXPECT_EQ(2, keepalives);
+
+    EXPECT_EQ(RTP_OK, first.stop());
+    EXPECT_EQ(RTP_OK, second.stop());
+    EXPECT_EQ(RTP_OK, idle.stop());
+}
+
+namespace {
+    struct handler_state {
+        std::atomic<bool> removed{ false };
+        std::atomic<int> late_calls{ 0 };
+    };
+
+    rtp_error_t counting_handler(void *arg, uvgrtp::buf_vec&)
+    {
+        handler_state *state = (handler_state *)arg;
+
+        // keep the handler running for a while so that the removals overlap the sends
+        auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+        while (std::chrono::steady_clock::now() < until)
+            ;
+
+        if (state->removed.load())
+            ++state->late_calls;
+        return RTP_OK;
+    }
+}
+
+TEST(FormatTests, socket_handler_removal) {
+    const uint16_t port = 9292;
+    const int rounds    = 200;
+
+    uvgrtp::socket receiver(0);
+    ASSERT_EQ(RTP_OK, receiver.init(AF_INET, SOCK_DGRAM, 0));
+    ASSERT_EQ(RTP_OK, receiver.bind(AF_INET, INADDR_LOOPBACK, port));
+
+    uvgrtp::socket socket(0);
+    ASSERT_EQ(RTP_OK, socket.init(AF_INET, SOCK_DGRAM, 0));
+
+    std::atomic<bool> sending(true);
+    std::vector<std::thread> senders;
+
+    for (int i = 0; i < 2; ++i) {
+        senders.emplace_back([&]() {
+            sockaddr_in addr = uvgrtp::socket::create_sockaddr(AF_INET, "127.0.0.1", port);
+            sockaddr_in6 addr6 = {};
+            uint8_t payload[32] = {};
+
+            while (sending.load()) {
+                uvgrtp::buf_vec buffers = { { sizeof(payload), payload } };
+                (void)socket.sendto(addr, addr6, buffers, 0);
+            }
+        });
+    }
+
+    // the states are kept until the end, so a handler called after its removal is counted instead of crashing
+    std::vector<std::unique_ptr<handler_state>> states;
+
+    for (int i = 0; i < rounds; ++i) {
+        auto first_ssrc  = std::make_shared<std::atomic<uint32_t>>(2 * i);
+        auto second_ssrc = std::make_shared<std::atomic<uint32_t>>(2 * i + 1);
+        states.emplace_back(new handler_state);
+        handler_state *first = states.back().get();
+        states.emplace_back(new handler_state);
+        handler_state *second = states.back().get();
+
+        // the second install publishes a new copy while the sends may still use the one with only the first
+        ASSERT_EQ(RTP_OK, socket.install_handler(first_ssrc, first, counting_handler));
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        ASSERT_EQ(RTP_OK, socket.install_handler(second_ssrc, second, counting_handler));
+
+        ASSERT_EQ(RTP_OK, socket.remove_handler(first_ssrc));
+        first->removed = true;
+        ASSERT_EQ(RTP_OK, socket.remove_handler(second_ssrc));
+        second->removed = true;
+    }
+
+    sending = false;
+    for (auto& sender : senders) {
+        sender.join();
+    }
+
+    for (auto& state : states) {
+        EXPECT_EQ(0, state->late_calls.load());
+    }
+}
+
+#ifdef UVGRTP_HAVE_IO_URING
+TEST(FormatTests, io_uring_round_trip) {
+    const uint16_t port    = 9296;
+    const unsigned packets = 4;
+
+    uvgrtp::uring send_ring;
+    uvgrtp::uring recv_ring;
+
+    if (send_ring.init(8) != RTP_OK || recv_ring.init(8) != RTP_OK)
+        GTEST_SKIP() << "io_uring is not available";
+
+    uvgrtp::socket receiver(0);
+    ASSERT_EQ(RTP_OK, receiver.init(AF_INET, SOCK_DGRAM, 0));
+    ASSERT_EQ(RTP_OK, receiver.bind(AF_INET, INADDR_LOOPBACK, port));
+
+    uvgrtp::socket sender(0);
+    ASSERT_EQ(RTP_OK, sender.init(AF_INET, SOCK_DGRAM, 0));
+
+    sockaddr_in addr = uvgrtp::socket::create_sockaddr(AF_INET, "127.0.0.1", port);
+
+    uint8_t sent[packets][100];
+    struct iovec send_chunks[packets];
+    struct mmsghdr send_headers[packets] = {};
+
+    for (unsigned i = 0; i < packets; ++i) {
+        memset(sent[i], 'a' + i, sizeof(sent[i]));
+        send_chunks[i] = { sent[i], sizeof(sent[i]) - i };
+
+        send_headers[i].msg_hdr.msg_name    = &addr;
+        send_headers[i].msg_hdr.msg_namelen = sizeof(addr);
+        send_headers[i].msg_hdr.msg_iov     = &send_chunks[i];
+        send_headers[i].msg_hdr.msg_iovlen  = 1;
+    }
+
+    ASSERT_EQ(RTP_OK, send_ring.sendmsg(sender.get_raw_socket(), send_headers, packets, 0));
+    for (unsigned i = 0; i < packets; ++i) {
+        EXPECT_EQ(sizeof(sent[i]) - i, send_headers[i].msg_len);
+    }
+
+    // more reads than datagrams, the first empty one ends the batch
+    uint8_t received[8][128];
+    struct iovec recv_chunks[8];
+    struct mmsghdr recv_headers[8] = {};
+
+    for (unsigned i = 0; i < 8; ++i) {
+        recv_chunks[i] = { received[i], sizeof(received[i]) };
+        recv_headers[i].msg_hdr.msg_iov    = &recv_chunks[i];
+        recv_headers[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int count = 0;
+    ASSERT_EQ(RTP_OK, recv_ring.recvmsg(receiver.get_raw_socket(), recv_headers, 8, MSG_DONTWAIT, &count));
+    ASSERT_EQ((int)packets, count);
+
+    for (unsigned i = 0; i < packets; ++i) {
+        ASSERT_EQ(sizeof(sent[i]) - i, recv_headers[i].msg_len);
+        EXPECT_EQ(0, memcmp(sent[i], received[i], recv_headers[i].msg_len));
+    }
+
+    // nothing is left to read
+    EXPECT_EQ(RTP_INTERRUPTED, recv_ring.recvmsg(receiver.get_raw_socket(), recv_headers, 8, MSG_DONTWAIT, &count));
+    EXPECT_EQ(0, count);
+}
+#endif
+
+namespace {
+    struct paced_stream {
+        int id = 0;
+        std::vector<std::pair<int, size_t>> *sent = nullptr;
+        std::atomic<bool> *started = nullptr;
+    };
+
+    // called by the pacer thread for each packet, in the order they are sent
+    rtp_error_t record_paced(void *arg, uvgrtp::buf_vec& packet)
+    {
+        paced_stream *stream = (paced_stream *)arg;
+        size_t size = 0;
+
+        // hold the first packet until both frames are in the pacer
+        while (!stream->started->load()) {
+            std::this_thread::yield();
+        }
+
+        for (auto& buffer : packet) {
+            size += buffer.first;
+        }
+        stream->sent->push_back({ stream->id, size });
+        return RTP_OK;
+    }
+}
+
+TEST(FormatTests, pacer_scheduling) {
+    const uint16_t port     = 9294;
+    const size_t packets    = 400;
+    const size_t packet_len = 1000;
+
+    uvgrtp::socket receiver(0);
+    ASSERT_EQ(RTP_OK, receiver.init(AF_INET, SOCK_DGRAM, 0));
+    ASSERT_EQ(RTP_OK, receiver.bind(AF_INET, INADDR_LOOPBACK, port));
+
+    sockaddr_in addr = uvgrtp::socket::create_sockaddr(AF_INET, "127.0.0.1", port);
+    sockaddr_in6 addr6 = {};
+
+    std::vector<uint8_t> payload(packet_len);
+    std::vector<std::pair<int, size_t>> sent;
+    std::atomic<bool> started(false);
+    paced_stream streams[2];
+    std::shared_ptr<uvgrtp::socket> sockets[2];
+    uvgrtp::pkt_vec frames[2];
+    uvgrtp::send_arrays arrays[2];
+
+    for (int i = 0; i < 2; ++i) {
+        streams[i] = { i, &sent, &started };
+        sockets[i] = std::make_shared<uvgrtp::socket>(0);
+        ASSERT_EQ(RTP_OK, sockets[i]->init(AF_INET, SOCK_DGRAM, 0));
+        ASSERT_EQ(RTP_OK, sockets[i]->install_handler(std::make_shared<std::atomic<uint32_t>>(i), &streams[i], record_paced));
+
+        frames[i].assign(packets, uvgrtp::buf_vec{ { packet_len, payload.data() } });
+    }
+
+    // the windows are so short that the packets of both frames are due at once
+    auto pace = [&](uvgrtp::pacing_bucket (&buckets)[2]) {
+        uvgrtp::pacer pacer;
+        uvgrtp::pacer::job jobs[2];
+
+        sent.clear();
+        started = false;
+        for (int i = 0; i < 2; ++i) {
+            pacer.start(jobs[i], buckets[i], sockets[i], addr, addr6, frames[i], arrays[i], std::chrono::microseconds(1));
+        }
+        started = true;
+        for (int i = 0; i < 2; ++i) {
+            EXPECT_EQ(RTP_OK, pacer.wait(jobs[i]));
+        }
+        ASSERT_EQ(2 * packets, sent.size());
+    };
+
+    // once the frame of the higher priority has started, the other one waits until it has been sent
+    {
+        uvgrtp::pacing_bucket buckets[2];
+        buckets[1].priority = 3;
+        pace(buckets);
+
+        auto first = std::find_if(sent.begin(), sent.end(), [](const std::pair<int, size_t>& p) { return p.first == 1; });
+        ASSERT_NE(sent.end(), first);
+        EXPECT_EQ((size_t)packets, (size_t)std::count_if(first, first + packets,
+            [](const std::pair<int, size_t>& p) { return p.first == 1; }));
+    }
+
+    // with the same priority, the streams share the pacer by weight while both are sending
+    {
+        uvgrtp::pacing_bucket buckets[2];
+        buckets[1].weight = 3;
+        pace(buckets);
+
+        auto first = std::find_if(sent.begin(), sent.end(), [](const std::pair<int, size_t>& p) { return p.first == 1; });
+        size_t bytes[2] = { 0, 0 };
+        size_t remaining[2] = { packets, packets };
+
+        for (auto it = sent.begin(); it != sent.end(); ++it) {
+            if (it >= first)
+                bytes[it->first] += it->second;
+            if (--remaining[it->first] == 0)
+                break;
+        }
+
+        ASSERT_GT(bytes[0], 0u);
+        double ratio = (double)bytes[1] / (double)bytes[0];
+        EXPECT_GT(ratio, 2.5);
+        EXPECT_LT(ratio, 3.5);
+    }
+}
+
+TEST(FormatTests, header_batch) {
+    const size_t count = 11;
+    uint8_t packets[count][64] = {};
+    size_t sizes[count];
+    uint8_t* pointers[count];
+
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t* p = packets[i];
+        p[0] = 0x80;
+        p[1] = (uint8_t)((i % 2 ? 0x80 : 0) | 96);
+        p[2] = 0x12;
+        p[3] = (uint8_t)i;
+        p[4] = 0xaa; p[5] = 0xbb; p[6] = 0xcc; p[7] = (uint8_t)i;
+        p[8] = 0x01; p[9] = 0x02; p[10] = 0x03; p[11] = (uint8_t)i;
+
+        sizes[i] = 40;
+        pointers[i] = p;
+    }
+
+    // two CSRCs, and a header extension of one word
+    packets[1][0] |= 2;
+    packets[2][0] |= 0x10;
+    packets[2][15] = 1;
+
+    // an extension longer than the packet, CSRCs past the end, a wrong version and a short packet
+    packets[3][0] |= 0x10;
+    packets[3][15] = 20;
+    packets[5][0] |= 15;
+    sizes[5] = 20;
+    packets[6][0] = 0x40;
+    sizes[9] = 8;
+
+    // a header of 14 bytes in a group of four leaves the group to the scalar parser
+    sizes[8] = 14;
+
+    uvgrtp::header_batch batch;
+    uvgrtp::parse_headers(pointers, sizes, count, batch);
+    ASSERT_EQ(count, batch.count);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (i == 9) {
+            EXPECT_EQ(0u, batch.ssrc[i]);
+            EXPECT_EQ(0u, batch.header_size[i]);
+            continue;
+        }
+
+        EXPECT_EQ(0x01020300u | (uint32_t)i, batch.ssrc[i]);
+        EXPECT_EQ(0xaabbcc00u | (uint32_t)i, batch.timestamp[i]);
+        EXPECT_EQ(0x1200u | (uint16_t)i, batch.seq[i]);
+        EXPECT_EQ(i % 2, batch.marker[i]);
+        EXPECT_EQ(96, batch.payload[i]);
+    }
+
+    EXPECT_EQ(12u, batch.header_size[0]);
+    EXPECT_EQ(20u, batch.header_size[1]);
+    EXPECT_EQ(20u, batch.header_size[2]);
+    EXPECT_EQ(0u, batch.header_size[3]);
+    EXPECT_EQ(0u, batch.header_size[5]);
+    EXPECT_EQ(1, batch.version[6]);
+    EXPECT_EQ(0u, batch.header_size[6]);
+    EXPECT_EQ(12u, batch.header_size[8]);
+    EXPECT_EQ(12u, batch.header_size[10]);
+}
+
+TEST(FormatTests, h26x_flat_bounds) {
+    // Tests that flat reassembly drops a frame whose fragments are too far apart or that has two ends
+    auto ssrc = std::make_shared<std::atomic<std::uint32_t>>(1);
+    auto rtp_ctx = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_H264, ssrc, false);
+
+    uvgrtp::formats::h264 h264(nullptr, rtp_ctx, RCE_H26X_FLAT_REASSEMBLY);
+
+    auto receive = [&](uint32_t ts, uint16_t seq, uint8_t fu_header, size_t len) {
+        std::vector<uint8_t> payload(len + 2, (uint8_t)ts);
+        payload[0] = 0x7c;
+        payload[1] = fu_header;
+
+        uvgrtp::frame::rtp_frame* frame = uvgrtp::frame::alloc_rtp_frame(payload.size());
+        frame->header.timestamp = ts;
+        frame->header.seq = seq;
+        std::memcpy(frame->payload, payload.data(), payload.size());
+
+        rtp_error_t ret = h264.packet_handler(nullptr, RCE_H26X_FLAT_REASSEMBLY, nullptr, 0, &frame);
+        if (ret == RTP_PKT_READY)
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        return ret;
+    };
+
+    auto send_frame = [&](uint32_t ts, uint16_t seq, size_t fragments, size_t len) {
+        EXPECT_EQ(RTP_OK, receive(ts, seq, 0x85, len));
+        for (size_t i = 1; i + 1 < fragments; ++i) {
+            EXPECT_EQ(RTP_OK, receive(ts, (uint16_t)(seq + i), 0x05, len));
+        }
+        return receive(ts, (uint16_t)(seq + fragments - 1), 0x45, len);
+    };
+
+    // a fragment half of the sequence number space away would reserve tens of megabytes
+    EXPECT_EQ(RTP_OK, receive(1, 0, 0x85, 1400));
+    EXPECT_EQ(RTP_OK, receive(1, 1, 0x05, 1400));
+    EXPECT_EQ(RTP_GENERIC_ERROR, receive(1, 32000, 0x05, 1400));
+
+    // the frame is dropped but the flat reassembly is still used
+    EXPECT_EQ(RTP_PKT_READY, send_frame(2, 100, 3, 1400));
+
+    // a second end fragment before the fragment size is known
+    EXPECT_EQ(RTP_OK, receive(3, 200, 0x45, 100));
+    EXPECT_EQ(RTP_GENERIC_ERROR, receive(3, 201, 0x45, 100));
+    EXPECT_EQ(RTP_PKT_READY, send_frame(4, 300, 3, 1400));
+
+    // the data area may not grow past RCC_H26X_MAX_FRAME_SIZE
+    h264.reserve_receive_state(4096, 30, 0);
+    EXPECT_EQ(RTP_PKT_READY, send_frame(5, 400, 2, 1400));
+    EXPECT_EQ(RTP_OK, receive(6, 500, 0x85, 1400));
+    EXPECT_EQ(RTP_OK, receive(6, 501, 0x05, 1400));
+    EXPECT_EQ(RTP_GENERIC_ERROR, receive(6, 502, 0x05, 1400));
+    EXPECT_EQ(RTP_PKT_READY, send_frame(7, 600, 2, 1400));
+}
+
+TEST(FormatTests, memory_budget) {
+    // Tests that the incomplete H26x frames are charged to the budgets and the oldest ones are shed first
+    auto ssrc = std::make_shared<std::atomic<std::uint32_t>>(1);
+    auto rtp_ctx = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_H264, ssrc, false);
+    auto metrics = std::make_shared<uvgrtp::stream_metrics>();
+    auto context_budget = std::make_shared<uvgrtp::memory_budget>();
+    auto stream_budget = std::make_shared<uvgrtp::memory_budget>(context_budget);
+
+    // a start fragment of FU-A
+    const std::vector<uint8_t> start = { 0x7c, 0x81, 0xaa, 0xaa };
+    const size_t charge = start.size() + sizeof(uvgrtp::frame::rtp_frame);
+    stream_budget->set_limit(2 * charge);
+
+    {
+        uvgrtp::formats::h264 h264(nullptr, rtp_ctx, RCE_NO_FLAGS);
+        h264.set_metrics(metrics);
+        h264.set_memory_budget(stream_budget);
+
+        uint16_t seq = 0;
+        auto receive = [&](uint32_t ts) {
+            uvgrtp::frame::rtp_frame* frame = uvgrtp::frame::alloc_rtp_frame(start.size());
+            frame->header.timestamp = ts;
+            frame->header.seq = seq++;
+            std::memcpy(frame->payload, start.data(), start.size());
+
+            return h264.packet_handler(nullptr, RCE_NO_FLAGS, nullptr, 0, &frame);
+        };
+
+        auto shed = [&]() {
+            uvgrtp::stream_stats stats;
+            metrics->snapshot(stats);
+            return stats.shed_frames;
+        };
+
+        EXPECT_EQ(RTP_OK, receive(1));
+        EXPECT_EQ(RTP_OK, receive(2));
+        EXPECT_EQ(2 * charge, stream_budget->used());
+        EXPECT_EQ(2 * charge, context_budget->used());
+        EXPECT_EQ(0u, shed());
+
+        // the oldest frame makes room for the new one
+        EXPECT_EQ(RTP_OK, receive(3));
+        EXPECT_EQ(2 * charge, stream_budget->used());
+        EXPECT_EQ(1u, shed());
+
+        // a fragment that does not fit alone is dropped after all the others
+        stream_budget->set_limit(charge / 2);
+        EXPECT_EQ(RTP_GENERIC_ERROR, receive(4));
+        EXPECT_EQ(0u, stream_budget->used());
+        EXPECT_EQ(0u, context_budget->used());
+        EXPECT_EQ(4u, shed());
+
+        // the limit of the context applies as well
+        stream_budget->set_limit(0);
+        context_budget->set_limit(charge);
+        EXPECT_EQ(RTP_OK, receive(5));
+        EXPECT_EQ(RTP_OK, receive(6));
+        EXPECT_EQ(charge, context_budget->used());
+        EXPECT_EQ(5u, shed());
+    }
+
+    // the frames left when the stream is destroyed are given back
+    EXPECT_EQ(0u, stream_budget->used());
+    EXPECT_EQ(0u, context_budget->used());
+}